@@ -0,0 +1,56 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#version 300 es
+
+// Draws the frame around every tracked image in one instanced call.  The four
+// corners are a single mesh; each vertex is moved from the image center by
+// half the extent of its image in the direction of its corner.
+
+uniform mat4 u_View;
+uniform mat4 u_Projection;
+
+in vec4 a_Position;
+in vec3 a_Normal;
+in vec2 a_TexCoord;
+// -1 or 1 for the x and z direction of the corner the vertex belongs to.
+in vec2 a_Corner;
+
+// Per image.
+in mat4 a_Model;
+in vec2 a_Extent;
+in vec4 a_ColorTint;
+
+out vec3 v_ViewPosition;
+out vec3 v_ViewNormal;
+out vec2 v_TexCoord;
+out vec3 v_ViewLightDirection;
+out vec4 v_ColorTint;
+
+void main() {
+  const vec4 kLightDirection = vec4(0.0, 1.0, 0.0, 0.0);
+
+  vec2 offset = 0.5 * a_Corner * a_Extent;
+  vec4 position = a_Position + vec4(offset.x, 0.0, offset.y, 0.0);
+  mat4 modelView = u_View * a_Model;
+
+  v_ViewPosition = (modelView * position).xyz;
+  v_ViewNormal = normalize((modelView * vec4(a_Normal, 0.0)).xyz);
+  v_ViewLightDirection = normalize((modelView * kLightDirection).xyz);
+  v_TexCoord = a_TexCoord;
+  v_ColorTint = a_ColorTint;
+  gl_Position = u_Projection * modelView * position;
+}
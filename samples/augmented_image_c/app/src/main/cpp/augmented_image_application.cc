@@ -16,11 +16,17 @@
 
 #include "augmented_image_application.h"
 
+#include <EGL/egl.h>
 #include <android/asset_manager.h>
+#include <algorithm>
 #include <array>
 #include <cstdint>
+#include <cstdio>
 #include <utility>
+#include <vector>
 
+#include "image_database_builder.h"
+#include "jni_interface.h"
 #include "obj_renderer.h"
 #include "util.h"
 
@@ -37,16 +43,78 @@ constexpr float kTintAlpha = 1.0f;
 constexpr float kTintIntensity = 0.1f;
 
 // AugmentedImage configuration and rendering.
-// Load a single image (true) or a pre-generated image database (false).
-constexpr bool kUseSingleImage = false;
+enum class ImageDatabaseSource {
+  // Add a single image at runtime.
+  kSingleImage,
+  // Add all images listed in kImageManifestName at runtime.
+  kImageManifest,
+  // Load a pre-generated image database.
+  kSerializedDatabase,
+};
+constexpr ImageDatabaseSource kImageDatabaseSource =
+    ImageDatabaseSource::kSerializedDatabase;
+constexpr char kImageManifestName[] = "reference_images.txt";
+// The image added by ImageDatabaseSource::kSingleImage.
+constexpr char kSingleImageName[] = "default.jpg";
+// Physical width of the printed kSingleImageName in meters, 0 if unknown.
+// ARCore only starts to track an image once it knows its size, so a known
+// size shortens the time to tracking.  Manifest images take theirs from the
+// manifest.
+constexpr float kSingleImagePhysicalWidthM = 0.f;
+
+// Images added at runtime are scaled down to at most this many pixels on
+// either side.  Larger reference images make ArAugmentedImageDatabase_addImage
+// slower without helping the detection, which needs about 300 x 300 pixels.
+constexpr int32_t kMaxReferenceImageDimension = 1024;
+
+// Manifest builds log their progress every this many images.
+constexpr int kManifestProgressInterval = 25;
+
+// SelectImageDatabaseShard() reads the shards from this asset directory.
+constexpr char kImageDatabaseShardDirectory[] = "image_databases/";
+
+// Images not tracked from the camera image for this long lose their anchor,
+// so that walking past many images keeps the anchor count bounded.  They get
+// a new one when the camera sees them again.
+constexpr std::chrono::seconds kUnseenImageTimeout(30);
+
+// Tint of the frame around the image at |image_index|.
+void GetTintColor(int32_t image_index, float* out_tint_color_rgba) {
+  const uint32_t tint_color_hex =
+      kTintColorRgba[image_index % kTintColorRgba.size()];
+  out_tint_color_rgba[0] =
+      ((tint_color_hex & 0xFF000000) >> 24) / 255.0f * kTintIntensity;
+  out_tint_color_rgba[1] =
+      ((tint_color_hex & 0x00FF0000) >> 16) / 255.0f * kTintIntensity;
+  out_tint_color_rgba[2] =
+      ((tint_color_hex & 0x0000FF00) >> 8) / 255.0f * kTintIntensity;
+  out_tint_color_rgba[3] = kTintAlpha;
+}
 
 }  // namespace
 
 AugmentedImageApplication::AugmentedImageApplication(
-    AAssetManager* asset_manager)
-    : asset_manager_(asset_manager) {}
+    AAssetManager* asset_manager, const std::string& cache_dir)
+    : asset_manager_(asset_manager), cache_dir_(cache_dir) {}
 
 AugmentedImageApplication::~AugmentedImageApplication() {
+  {
+    std::lock_guard<std::mutex> lock(database_mutex_);
+    stopping_database_thread_ = true;
+  }
+  database_request_changed_.notify_all();
+  if (database_thread_.joinable()) {
+    database_thread_.join();
+  }
+  if (built_database_ != nullptr) {
+    ArAugmentedImageDatabase_destroy(built_database_);
+  }
+  for (int32_t index : anchored_image_indices_) {
+    ArAnchor_release(tracked_images_[index].anchor);
+  }
+  for (const RetainedImage& image : retained_images_) {
+    ArAnchor_release(image.anchor);
+  }
   if (ar_session_ != nullptr) {
     ArSession_destroy(ar_session_);
     ArFrame_destroy(ar_frame_);
@@ -99,22 +167,30 @@ void AugmentedImageApplication::OnResume(JNIEnv* env, jobject context,
     ArConfig_create(ar_session_, &ar_config);
     CHECK(ar_config);
 
-    ArAugmentedImageDatabase* ar_augmented_image_database =
-        CreateAugmentedImageDatabase();
-    ArConfig_setAugmentedImageDatabase(ar_session_, ar_config,
-                                       ar_augmented_image_database);
-
+    // The augmented image database is added by ApplyAugmentedImageDatabase()
+    // once it is built.
     ArConfig_setFocusMode(ar_session_, ar_config, AR_FOCUS_MODE_AUTO);
     CHECKANDTHROW(ArSession_configure(ar_session_, ar_config) == AR_SUCCESS,
                   env, "Failed to configure AR session");
 
-    ArAugmentedImageDatabase_destroy(ar_augmented_image_database);
     ArConfig_destroy(ar_config);
 
     ArFrame_create(ar_session_, &ar_frame_);
 
+    if (!benchmark_dataset_uri_.empty()) {
+      // The dataset can only be set while the session has not been resumed.
+      CHECKANDTHROW(ArSession_setPlaybackDatasetUri(
+                        ar_session_, benchmark_dataset_uri_.c_str()) ==
+                        AR_SUCCESS,
+                    env, "Failed to set the playback benchmark dataset.");
+    }
+
     ArSession_setDisplayGeometry(ar_session_, display_rotation_, width_,
                                  height_);
+
+    session_start_ = std::chrono::steady_clock::now();
+    database_thread_ =
+        std::thread(&AugmentedImageApplication::DatabaseThreadLoop, this);
   }
 
   const ArStatus status = ArSession_resume(ar_session_);
@@ -122,59 +198,290 @@ void AugmentedImageApplication::OnResume(JNIEnv* env, jobject context,
 }
 
 ArAugmentedImageDatabase*
-AugmentedImageApplication::CreateAugmentedImageDatabase() const {
+AugmentedImageApplication::CreateAugmentedImageDatabase(
+    std::vector<ReferenceImageEntry>* out_entries) const {
   ArAugmentedImageDatabase* ar_augmented_image_database = nullptr;
   // There are two ways to configure a ArAugmentedImageDatabase:
-  // 1. Add Bitmap to DB directly
+  // 1. Add Bitmap to DB directly, one image or many of a manifest
   // 2. Load a pre-built AugmentedImageDatabase
   // Option 2) has
   // * shorter setup time
   // * doesn't require images to be packaged in apk.
-  if (kUseSingleImage) {
-    ArAugmentedImageDatabase_create(ar_session_, &ar_augmented_image_database);
+  if (kImageDatabaseSource == ImageDatabaseSource::kSerializedDatabase) {
+    // The database is read straight from the mapped asset.
+    util::AssetBuffer database_buffer;
+    const bool open_result =
+        database_buffer.Open(asset_manager_, "sample_database.imgdb");
+    CHECK(open_result);
+
+    const ArStatus status = ArAugmentedImageDatabase_deserialize(
+        ar_session_, database_buffer.GetData(), database_buffer.GetSize(),
+        &ar_augmented_image_database);
+    CHECK(status == AR_SUCCESS);
+    return ar_augmented_image_database;
+  }
+
+  std::vector<ReferenceImageEntry>& entries = *out_entries;
+  if (kImageDatabaseSource == ImageDatabaseSource::kSingleImage) {
+    ReferenceImageEntry entry;
+    entry.asset_path = kSingleImageName;
+    entry.physical_width_m = kSingleImagePhysicalWidthM;
+    entries.push_back(entry);
+  } else {
+    const bool load_manifest_result =
+        LoadImageManifest(asset_manager_, kImageManifestName, &entries);
+    CHECK(load_manifest_result);
+  }
+
+  // Building extracts the features of every image, which takes seconds, so
+  // the result is cached for the next launches with the same images.
+  const std::string cache_path = GetImageDatabaseCachePath(entries);
+  if (!cache_path.empty()) {
+    const auto load_start = std::chrono::steady_clock::now();
+    ar_augmented_image_database =
+        LoadImageDatabaseFile(ar_session_, cache_path);
+    if (ar_augmented_image_database != nullptr) {
+      LOGI("Loaded the cached image database in %.1f ms",
+           std::chrono::duration<float, std::milli>(
+               std::chrono::steady_clock::now() - load_start)
+               .count());
+      return ar_augmented_image_database;
+    }
+  }
+
+  ar_augmented_image_database = BuildAugmentedImageDatabase(entries);
+  if (!cache_path.empty() &&
+      !SaveImageDatabaseFile(ar_session_, ar_augmented_image_database,
+                             cache_path)) {
+    LOGE("Could not cache the image database at %s", cache_path.c_str());
+  }
+  return ar_augmented_image_database;
+}
+
+ArAugmentedImageDatabase*
+AugmentedImageApplication::BuildAugmentedImageDatabase(
+    const std::vector<ReferenceImageEntry>& entries) const {
+  ArAugmentedImageDatabase* ar_augmented_image_database = nullptr;
+  ArAugmentedImageDatabase_create(ar_session_, &ar_augmented_image_database);
 
+  if (kImageDatabaseSource == ImageDatabaseSource::kSingleImage) {
     int32_t width, height, stride, index;
     uint8_t* image_pixel_buffer;
-    constexpr const char kSampleImageName[] = "default.jpg";
+    const char* image_name = entries[0].asset_path.c_str();
     bool load_image_result = util::LoadImageFromAssetManager(
-        kSampleImageName, &width, &height, &stride, &image_pixel_buffer);
+        image_name, &width, &height, &stride, &image_pixel_buffer);
     CHECK(load_image_result);
 
-    uint8_t* grayscale_buffer;
+    const int32_t scale =
+        util::GetGrayscaleScale(width, height, kMaxReferenceImageDimension);
+    const int32_t grayscale_width = width / scale;
+    const int32_t grayscale_height = height / scale;
+    std::vector<uint8_t> grayscale_buffer(grayscale_width * grayscale_height);
     util::ConvertRgbaToGrayscale(image_pixel_buffer, width, height, stride,
-                                 &grayscale_buffer);
+                                 scale, grayscale_buffer.data(),
+                                 grayscale_width);
 
-    int32_t grayscale_stride = stride / 4;
-    const ArStatus status = ArAugmentedImageDatabase_addImage(
-        ar_session_, ar_augmented_image_database, kSampleImageName,
-        grayscale_buffer, width, height, grayscale_stride, &index);
-    CHECK(status == AR_SUCCESS);
-    // If the physical size of the image is known, you can instead use
-    //     ArStatus ArAugmentedImageDatabase_addImageWithPhysicalSize
-    // This will improve the initial detection speed. ARCore will still actively
-    // estimate the physical size of the image as it is viewed from multiple
+    // A known physical size improves the initial detection speed.  ARCore
+    // still refines the size as the image is viewed from multiple
     // viewpoints.
+    const float physical_width_m = entries[0].physical_width_m;
+    const ArStatus status =
+        physical_width_m > 0.f
+            ? ArAugmentedImageDatabase_addImageWithPhysicalSize(
+                  ar_session_, ar_augmented_image_database, image_name,
+                  grayscale_buffer.data(), grayscale_width, grayscale_height,
+                  grayscale_width, physical_width_m, &index)
+            : ArAugmentedImageDatabase_addImage(
+                  ar_session_, ar_augmented_image_database, image_name,
+                  grayscale_buffer.data(), grayscale_width, grayscale_height,
+                  grayscale_width, &index);
+    CHECK(status == AR_SUCCESS);
 
     delete[] image_pixel_buffer;
-    delete[] grayscale_buffer;
-  } else {
-    std::string database_buffer;
-    util::LoadFileFromAssetManager(asset_manager_, "sample_database.imgdb",
-                                   &database_buffer);
+    return ar_augmented_image_database;
+  }
 
-    uint8_t* raw_buffer = reinterpret_cast<uint8_t*>(&database_buffer.front());
-    const ArStatus status = ArAugmentedImageDatabase_deserialize(
-        ar_session_, raw_buffer, database_buffer.size(),
-        &ar_augmented_image_database);
-    CHECK(status == AR_SUCCESS);
+  // Leaves one core to the rendering.
+  const int num_workers =
+      static_cast<int>(std::thread::hardware_concurrency()) - 1;
+  const ImageDatabaseBuildStats stats = AddImagesToDatabase(
+      ar_session_, entries, kMaxReferenceImageDimension, num_workers,
+      [](int num_done, int num_images) {
+        if (num_done % kManifestProgressInterval == 0 ||
+            num_done == num_images) {
+          LOGI("Prepared %d of %d reference images", num_done, num_images);
+        }
+      },
+      ar_augmented_image_database);
+  LOGI(
+      "Added %d of %d reference images, %d with their physical size, in %.1f "
+      "ms: decode %.1f ms, grayscale %.1f ms on the workers, addImage %.1f ms",
+      stats.num_added, stats.num_images, stats.num_with_physical_size,
+      stats.total_ms, stats.decode_ms, stats.convert_ms, stats.add_ms);
+  return ar_augmented_image_database;
+}
+
+std::string AugmentedImageApplication::GetImageDatabaseCachePath(
+    const std::vector<ReferenceImageEntry>& entries) const {
+  uint64_t hash = 0;
+  if (cache_dir_.empty() ||
+      !HashReferenceImages(asset_manager_, entries,
+                           kMaxReferenceImageDimension, &hash)) {
+    return std::string();
   }
+  char file_name[40];
+  snprintf(file_name, sizeof(file_name), "/image_database_%016llx.imgdb",
+           static_cast<unsigned long long>(hash));
+  return cache_dir_ + file_name;
+}
 
+ArAugmentedImageDatabase* AugmentedImageApplication::LoadImageDatabaseShard(
+    const std::string& context_key) const {
+  const std::string asset_path =
+      kImageDatabaseShardDirectory + context_key + ".imgdb";
+  util::AssetBuffer database_buffer;
+  if (!database_buffer.Open(asset_manager_, asset_path.c_str())) {
+    return nullptr;
+  }
+  ArAugmentedImageDatabase* ar_augmented_image_database = nullptr;
+  const ArStatus status = ArAugmentedImageDatabase_deserialize(
+      ar_session_, database_buffer.GetData(), database_buffer.GetSize(),
+      &ar_augmented_image_database);
+  if (status != AR_SUCCESS) {
+    LOGE("Failed to deserialize database shard %s: %d", asset_path.c_str(),
+         status);
+    return nullptr;
+  }
   return ar_augmented_image_database;
 }
 
+void AugmentedImageApplication::SelectImageDatabaseShard(
+    const std::string& context_key) {
+  {
+    std::lock_guard<std::mutex> lock(database_mutex_);
+    requested_shard_ = context_key;
+    shard_requested_ = true;
+  }
+  database_request_changed_.notify_all();
+}
+
+std::string AugmentedImageApplication::GetDetectionLatencyReport() const {
+  return detection_telemetry_.GetReport();
+}
+
+void AugmentedImageApplication::DatabaseThreadLoop() {
+  std::vector<ReferenceImageEntry> entries;
+  ArAugmentedImageDatabase* database = CreateAugmentedImageDatabase(&entries);
+  // Loading single images decodes them through Java.
+  DetachJniEnv();
+  std::string context_key;
+
+  while (true) {
+    if (database != nullptr) {
+      {
+        // A database the OpenGL thread has not applied yet is outdated.
+        std::lock_guard<std::mutex> lock(database_mutex_);
+        std::swap(database, built_database_);
+        built_database_shard_ = context_key;
+        built_database_entries_ = std::move(entries);
+        entries.clear();
+      }
+      if (database != nullptr) {
+        ArAugmentedImageDatabase_destroy(database);
+        database = nullptr;
+      }
+    }
+
+    {
+      std::unique_lock<std::mutex> lock(database_mutex_);
+      database_request_changed_.wait(lock, [this] {
+        return stopping_database_thread_ || shard_requested_;
+      });
+      if (stopping_database_thread_) {
+        return;
+      }
+      context_key = requested_shard_;
+      shard_requested_ = false;
+    }
+    database = context_key.empty() ? CreateAugmentedImageDatabase(&entries)
+                                   : LoadImageDatabaseShard(context_key);
+    DetachJniEnv();
+  }
+}
+
+void AugmentedImageApplication::ApplyAugmentedImageDatabase() {
+  ArAugmentedImageDatabase* database = nullptr;
+  std::string shard_key;
+  std::vector<ReferenceImageEntry> entries;
+  {
+    std::lock_guard<std::mutex> lock(database_mutex_);
+    std::swap(database, built_database_);
+    shard_key = built_database_shard_;
+    entries = std::move(built_database_entries_);
+    built_database_entries_.clear();
+  }
+  if (database == nullptr) {
+    return;
+  }
+
+  // The images of the current database stop tracking with the new one.
+  RetainTrackedImages();
+  int32_t num_images = 0;
+  ArAugmentedImageDatabase_getNumImages(ar_session_, database, &num_images);
+  tracked_images_.resize(num_images);
+
+  ArConfig* ar_config = nullptr;
+  ArConfig_create(ar_session_, &ar_config);
+  CHECK(ar_config);
+  ArSession_getConfig(ar_session_, ar_config);
+  ArConfig_setAugmentedImageDatabase(ar_session_, ar_config, database);
+  const ArStatus status = ArSession_configure(ar_session_, ar_config);
+  if (status == AR_SUCCESS) {
+    LOGI("Augmented image database applied %.1f ms after the session start",
+         std::chrono::duration<float, std::milli>(
+             std::chrono::steady_clock::now() - session_start_)
+             .count());
+    detection_telemetry_.OnDatabaseApplied(shard_key, num_images, entries);
+  } else {
+    LOGE("Failed to configure the augmented image database: %d", status);
+  }
+  ArConfig_destroy(ar_config);
+  ArAugmentedImageDatabase_destroy(database);
+}
+
+void AugmentedImageApplication::RetainTrackedImages() {
+  for (int32_t index : anchored_image_indices_) {
+    const TrackedImage& image = tracked_images_[index];
+
+    ArTrackingState tracking_state;
+    ArAnchor_getTrackingState(ar_session_, image.anchor, &tracking_state);
+    RetainedImage retained;
+    if (tracking_state == AR_TRACKING_STATE_TRACKING) {
+      // A session anchor at the same pose no longer depends on the image.
+      util::ScopedArPose pose(ar_session_);
+      ArAnchor_getPose(ar_session_, image.anchor, pose.GetArPose());
+      if (ArSession_acquireNewAnchor(ar_session_, pose.GetArPose(),
+                                     &retained.anchor) == AR_SUCCESS) {
+        retained.extent_x = image.extent_x;
+        retained.extent_z = image.extent_z;
+        retained.image_index = index;
+        retained_images_.push_back(retained);
+      }
+    }
+    ArAnchor_release(image.anchor);
+  }
+  tracked_images_.clear();
+  anchored_image_indices_.clear();
+}
+
 void AugmentedImageApplication::OnSurfaceCreated() {
   LOGI("OnSurfaceCreated()");
 
+  if (playback_benchmark_.IsOpen()) {
+    // Frames are timed as fast as they can be drawn, not at display rate.
+    eglSwapInterval(eglGetCurrentDisplay(), 0);
+  }
+
   background_renderer_.InitializeGlContent(asset_manager_);
   image_renderer_.InitializeGlContent(asset_manager_);
 }
@@ -192,7 +499,53 @@ void AugmentedImageApplication::OnDisplayGeometryChanged(int display_rotation,
   }
 }
 
+bool AugmentedImageApplication::StartPlaybackBenchmark(
+    const std::string& dataset_uri, const std::string& csv_path) {
+  if (!playback_benchmark_.Open(csv_path)) {
+    return false;
+  }
+  LOGI("Playback benchmark of %s into %s", dataset_uri.c_str(),
+       csv_path.c_str());
+  benchmark_dataset_uri_ = dataset_uri;
+  benchmark_finished_ = false;
+  return true;
+}
+
 void AugmentedImageApplication::OnDrawFrame(void* activity) {
+  if (!playback_benchmark_.IsOpen()) {
+    DrawFrame(activity);
+    return;
+  }
+  const auto frame_start = std::chrono::steady_clock::now();
+  DrawFrame(activity);
+  // Waits for the GPU so the frame time includes the draw calls' execution,
+  // which would otherwise be hidden by the missing vsync throttling.
+  glFinish();
+  RecordBenchmarkFrame(std::chrono::steady_clock::now() - frame_start);
+}
+
+void AugmentedImageApplication::RecordBenchmarkFrame(
+    std::chrono::nanoseconds frame_time) {
+  if (ar_session_ == nullptr) {
+    return;
+  }
+  int64_t timestamp_ns = 0;
+  ArFrame_getTimestamp(ar_session_, ar_frame_, &timestamp_ns);
+  playback_benchmark_.RecordFrame(timestamp_ns, frame_time);
+
+  ArPlaybackStatus playback_status = AR_PLAYBACK_NONE;
+  ArSession_getPlaybackStatus(ar_session_, &playback_status);
+  if (playback_status == AR_PLAYBACK_FINISHED ||
+      playback_status == AR_PLAYBACK_IO_ERROR) {
+    if (playback_status == AR_PLAYBACK_IO_ERROR) {
+      LOGE("Playback benchmark stopped by a dataset read error");
+    }
+    playback_benchmark_.Finish();
+    benchmark_finished_ = true;
+  }
+}
+
+void AugmentedImageApplication::DrawFrame(void* activity) {
   // Render the scene.
   glClearColor(0.9f, 0.9f, 0.9f, 1.0f);
   glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
@@ -208,6 +561,8 @@ void AugmentedImageApplication::OnDrawFrame(void* activity) {
 
   if (ar_session_ == nullptr) return;
 
+  ApplyAugmentedImageDatabase();
+
   ArSession_setCameraTextureName(ar_session_,
                                  background_renderer_.GetTextureId());
 
@@ -215,6 +570,9 @@ void AugmentedImageApplication::OnDrawFrame(void* activity) {
   if (ArSession_update(ar_session_, ar_frame_) != AR_SUCCESS) {
     LOGE("AugmentedImageApplication::OnDrawFrame ArSession_update error");
   }
+  int64_t frame_timestamp_ns = 0;
+  ArFrame_getTimestamp(ar_session_, ar_frame_, &frame_timestamp_ns);
+  detection_telemetry_.OnFrame(frame_timestamp_ns);
 
   ArCamera* ar_camera;
   ArFrame_acquireCamera(ar_session_, ar_frame_, &ar_camera);
@@ -253,8 +611,9 @@ void AugmentedImageApplication::OnDrawFrame(void* activity) {
   ArLightEstimate_destroy(ar_light_estimate);
   ar_light_estimate = nullptr;
 
-  bool found_ar_image =
-      DrawAugmentedImage(view_mat, projection_mat, color_correction);
+  bool found_ar_image = DrawAugmentedImage(frame_timestamp_ns);
+  DrawRetainedImages();
+  image_renderer_.Draw(projection_mat, view_mat, color_correction);
 
   // Once we found the first image, hide the scan animation
   if (found_ar_image) {
@@ -263,8 +622,7 @@ void AugmentedImageApplication::OnDrawFrame(void* activity) {
 }
 
 bool AugmentedImageApplication::DrawAugmentedImage(
-    const glm::mat4& view_mat, const glm::mat4& projection_mat,
-    const float* color_correction) {
+    int64_t frame_timestamp_ns) {
   bool found_ar_image = false;
 
   ArTrackableList* updated_image_list = nullptr;
@@ -276,7 +634,7 @@ bool AugmentedImageApplication::DrawAugmentedImage(
   int32_t image_list_size;
   ArTrackableList_getSize(ar_session_, updated_image_list, &image_list_size);
 
-  // Find newly detected image, add it to map
+  // Apply the changes of this frame to tracked_images_.
   for (int i = 0; i < image_list_size; ++i) {
     ArTrackable* ar_trackable = nullptr;
     ArTrackableList_acquireItem(ar_session_, updated_image_list, i,
@@ -288,6 +646,13 @@ bool AugmentedImageApplication::DrawAugmentedImage(
 
     int image_index;
     ArAugmentedImage_getIndex(ar_session_, image, &image_index);
+    if (image_index >= static_cast<int>(tracked_images_.size())) {
+      tracked_images_.resize(image_index + 1);
+    }
+    TrackedImage& tracked = tracked_images_[image_index];
+    tracked.tracking_state = tracking_state;
+    detection_telemetry_.OnImageUpdated(ar_session_, image, image_index,
+                                        tracking_state);
 
     switch (tracking_state) {
       case AR_TRACKING_STATE_PAUSED:
@@ -298,69 +663,123 @@ bool AugmentedImageApplication::DrawAugmentedImage(
       case AR_TRACKING_STATE_TRACKING:
         found_ar_image = true;
 
-        if (augmented_image_map.find(image_index) ==
-            augmented_image_map.end()) {
+        ArAugmentedImage_getTrackingMethod(ar_session_, image,
+                                           &tracked.tracking_method);
+        if (tracked.tracking_method !=
+            AR_AUGMENTED_IMAGE_TRACKING_METHOD_FULL_TRACKING) {
+          // Neither the pose nor the extent change at the last known pose.
+          break;
+        }
+        tracked.last_seen_ns = frame_timestamp_ns;
+        tracked.has_model_mat = false;
+
+        // The extent is refined while the image tracks.
+        ArAugmentedImage_getExtentX(ar_session_, image, &tracked.extent_x);
+        ArAugmentedImage_getExtentZ(ar_session_, image, &tracked.extent_z);
+
+        if (tracked.anchor == nullptr) {
           // Record the image and its anchor.
           util::ScopedArPose scopedArPose(ar_session_);
           ArAugmentedImage_getCenterPose(ar_session_, image,
                                          scopedArPose.GetArPose());
 
-          ArAnchor* image_anchor = nullptr;
           const ArStatus status = ArTrackable_acquireNewAnchor(
               ar_session_, ar_trackable, scopedArPose.GetArPose(),
-              &image_anchor);
+              &tracked.anchor);
           CHECK(status == AR_SUCCESS);
-
-          // Now we have an Anchor, record this image.
-          augmented_image_map[image_index] =
-              std::pair<ArAugmentedImage*, ArAnchor*>(image, image_anchor);
+          anchored_image_indices_.push_back(image_index);
         }
         break;
 
-      case AR_TRACKING_STATE_STOPPED: {
-        std::pair<ArAugmentedImage*, ArAnchor*> record =
-            augmented_image_map[image_index];
-        ArTrackable_release(ArAsTrackable(record.first));
-        ArAnchor_release(record.second);
-        augmented_image_map.erase(image_index);
-      } break;
+      case AR_TRACKING_STATE_STOPPED:
+        tracked.tracking_method =
+            AR_AUGMENTED_IMAGE_TRACKING_METHOD_NOT_TRACKING;
+        if (tracked.anchor != nullptr) {
+          ArAnchor_release(tracked.anchor);
+          tracked.anchor = nullptr;
+          tracked.has_model_mat = false;
+          auto anchored =
+              std::find(anchored_image_indices_.begin(),
+                        anchored_image_indices_.end(), image_index);
+          *anchored = anchored_image_indices_.back();
+          anchored_image_indices_.pop_back();
+        }
+        break;
 
       default:
         break;
     }  // End of switch (tracking_state)
+    ArTrackable_release(ar_trackable);
   }    // End of for (int i = 0; i < image_list_size; ++i) {
 
   ArTrackableList_destroy(updated_image_list);
   updated_image_list = nullptr;
 
-  // Display all augmented images in augmented_image_map.
-  for (const auto& it : augmented_image_map) {
-    const std::pair<ArAugmentedImage*, ArAnchor*>& record = it.second;
-    ArAugmentedImage* ar_image = record.first;
-    ArAnchor* ar_anchor = record.second;
-    ArTrackingState tracking_state;
-    ArTrackable_getTrackingState(ar_session_, ArAsTrackable(ar_image),
-                                 &tracking_state);
+  // Queue the frames of the images that track, from their cached state.
+  const int64_t unseen_timeout_ns =
+      std::chrono::nanoseconds(kUnseenImageTimeout).count();
+  size_t anchored = 0;
+  while (anchored < anchored_image_indices_.size()) {
+    const int32_t index = anchored_image_indices_[anchored];
+    TrackedImage& tracked = tracked_images_[index];
+    const bool fully_tracking =
+        tracked.tracking_state == AR_TRACKING_STATE_TRACKING &&
+        tracked.tracking_method ==
+            AR_AUGMENTED_IMAGE_TRACKING_METHOD_FULL_TRACKING;
+    if (!fully_tracking &&
+        frame_timestamp_ns - tracked.last_seen_ns > unseen_timeout_ns) {
+      ArAnchor_release(tracked.anchor);
+      tracked.anchor = nullptr;
+      tracked.has_model_mat = false;
+      anchored_image_indices_[anchored] = anchored_image_indices_.back();
+      anchored_image_indices_.pop_back();
+      continue;
+    }
+    ++anchored;
+    if (tracked.tracking_state != AR_TRACKING_STATE_TRACKING) {
+      continue;
+    }
 
-    // Draw this image frame.
-    if (tracking_state == AR_TRACKING_STATE_TRACKING) {
-      // Use Index to get tint color.
-      int index;
-      ArAugmentedImage_getIndex(ar_session_, ar_image, &index);
-      int tint_index = index % kTintColorRgba.size();
-      uint32_t tint_color_hex = kTintColorRgba[tint_index];
-      float tint_color_rgba[4] = {
-          ((tint_color_hex & 0xFF000000) >> 24) / 255.0f * kTintIntensity,
-          ((tint_color_hex & 0x00FF0000) >> 16) / 255.0f * kTintIntensity,
-          ((tint_color_hex & 0x0000FF00) >> 8) / 255.0f * kTintIntensity,
-          kTintAlpha};
-
-      image_renderer_.Draw(projection_mat, view_mat, color_correction,
-                           tint_color_rgba, ar_session_, ar_image, ar_anchor);
+    // Use Index to get tint color.
+    float tint_color_rgba[4];
+    GetTintColor(index, tint_color_rgba);
+
+    if (fully_tracking) {
+      image_renderer_.AddImage(ar_session_, tracked.extent_x,
+                               tracked.extent_z, tracked.anchor,
+                               tint_color_rgba);
+      continue;
+    }
+    if (!tracked.has_model_mat) {
+      util::GetTransformMatrixFromAnchor(ar_session_, tracked.anchor,
+                                         &tracked.model_mat);
+      tracked.has_model_mat = true;
     }
+    image_renderer_.AddImage(tracked.extent_x, tracked.extent_z,
+                             tracked.model_mat, tint_color_rgba);
   }
 
   return found_ar_image;
 }
 
+void AugmentedImageApplication::DrawRetainedImages() {
+  auto image = retained_images_.begin();
+  while (image != retained_images_.end()) {
+    ArTrackingState tracking_state;
+    ArAnchor_getTrackingState(ar_session_, image->anchor, &tracking_state);
+    if (tracking_state == AR_TRACKING_STATE_STOPPED) {
+      ArAnchor_release(image->anchor);
+      image = retained_images_.erase(image);
+      continue;
+    }
+    if (tracking_state == AR_TRACKING_STATE_TRACKING) {
+      float tint_color_rgba[4];
+      GetTintColor(image->image_index, tint_color_rgba);
+      image_renderer_.AddImage(ar_session_, image->extent_x, image->extent_z,
+                               image->anchor, tint_color_rgba);
+    }
+    ++image;
+  }
+}
+
 }  // namespace augmented_image
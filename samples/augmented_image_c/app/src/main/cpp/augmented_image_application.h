@@ -21,15 +21,23 @@
 #include <GLES2/gl2ext.h>
 #include <android/asset_manager.h>
 #include <jni.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <memory>
+#include <mutex>  // NOLINT
 #include <set>
 #include <string>
-#include <unordered_map>
+#include <thread>  // NOLINT
+#include <vector>
 
 #include "arcore_c_api.h"
 #include "augmented_image_renderer.h"
 #include "background_renderer.h"
+#include "detection_telemetry.h"
 #include "glm.h"
+#include "image_database_builder.h"
+#include "playback_benchmark.h"
 #include "util.h"
 
 namespace augmented_image {
@@ -38,7 +46,11 @@ namespace augmented_image {
 class AugmentedImageApplication {
  public:
   // Constructor and deconstructor.
-  explicit AugmentedImageApplication(AAssetManager* asset_manager);
+  //
+  // @param cache_dir, writable directory where databases built from images at
+  // runtime are cached, or empty to always build them.
+  AugmentedImageApplication(AAssetManager* asset_manager,
+                            const std::string& cache_dir);
   ~AugmentedImageApplication();
 
   // OnPause is called on the UI thread from the Activity's onPause method.
@@ -62,14 +74,81 @@ class AugmentedImageApplication {
   // OnDrawFrame is called on the OpenGL thread to render the next frame.
   void OnDrawFrame(void* activity);
 
- private:
-  ArAugmentedImageDatabase* CreateAugmentedImageDatabase() const;
+  // Switches to the database shard of |context_key|, e.g. a venue or a
+  // section of it, read from the asset image_databases/<context_key>.imgdb.
+  // Keeping every shard small keeps the detection fast.  The shard is loaded
+  // on the database thread and the session reconfigured once it is ready;
+  // anchors of images already found stay in place.  An empty key returns to
+  // the database the app started with.  May be called from any thread.
+  void SelectImageDatabaseShard(const std::string& context_key);
+
+  // The detection latencies of the images of every database shard applied so
+  // far, see DetectionTelemetry.  May be called from any thread.
+  std::string GetDetectionLatencyReport() const;
+
+  // Switches the application to the playback benchmark mode: the session
+  // plays |dataset_uri| back instead of using the camera, and the time of
+  // every frame is written to |csv_path|.  Must be called before the first
+  // OnResume().  Returns false if the CSV file cannot be created.
+  bool StartPlaybackBenchmark(const std::string& dataset_uri,
+                              const std::string& csv_path);
 
-  // Draws frame on an AugmentedImage.
-  // @return true if there is an AugmentedImage, false otherwise.
-  bool DrawAugmentedImage(const glm::mat4& view_mat,
-                          const glm::mat4& projection_mat,
-                          const float* color_correction);
+  // Returns true once the whole benchmark recording has been played back.
+  bool IsPlaybackBenchmarkFinished() const { return benchmark_finished_; }
+
+ private:
+  // Renders one frame; OnDrawFrame() wraps it with the benchmark timing.
+  void DrawFrame(void* activity);
+
+  // Writes the time of the frame just drawn and stops the benchmark at the
+  // end of the recording.
+  void RecordBenchmarkFrame(std::chrono::nanoseconds frame_time);
+
+  // Loads the database of kImageDatabaseSource, from the cache in cache_dir_
+  // if it was built from the same images before.  |out_entries| receives the
+  // images it was built from, none if it was deserialized from the assets.
+  ArAugmentedImageDatabase* CreateAugmentedImageDatabase(
+      std::vector<ReferenceImageEntry>* out_entries) const;
+
+  // Adds |entries| to a new database: one image directly, or all images of
+  // the manifest on worker threads.
+  ArAugmentedImageDatabase* BuildAugmentedImageDatabase(
+      const std::vector<ReferenceImageEntry>& entries) const;
+
+  // Path of the cached database built from |entries|, or empty if there is
+  // no cache directory or an image cannot be read.
+  std::string GetImageDatabaseCachePath(
+      const std::vector<ReferenceImageEntry>& entries) const;
+
+  // Deserializes the shard of |context_key|, or returns null if it cannot be
+  // loaded.
+  ArAugmentedImageDatabase* LoadImageDatabaseShard(
+      const std::string& context_key) const;
+
+  // Runs on database_thread_: builds the initial database, then the shards
+  // selected with SelectImageDatabaseShard(), and hands each to the OpenGL
+  // thread.
+  void DatabaseThreadLoop();
+
+  // Reconfigures the session with the database once database_thread_ has
+  // built it.  Called on the OpenGL thread before ArSession_update.
+  void ApplyAugmentedImageDatabase();
+
+  // Moves the anchors of tracked_images_ to retained_images_, before the
+  // images of the current database stop tracking.
+  void RetainTrackedImages();
+
+  // Updates tracked_images_ from the trackables of the frame that changed
+  // and queues the frames on the tracked AugmentedImages with
+  // image_renderer_.  Releases the anchors of the images not tracked from the
+  // camera image for kUnseenImageTimeout before |frame_timestamp_ns|.
+  // @return true if an AugmentedImage started or kept tracking in this frame,
+  // false otherwise.
+  bool DrawAugmentedImage(int64_t frame_timestamp_ns);
+
+  // Queues the frames of the retained images whose anchors still track and
+  // releases the others.
+  void DrawRetainedImages();
 
   ArSession* ar_session_ = nullptr;
   ArFrame* ar_frame_ = nullptr;
@@ -80,13 +159,68 @@ class AugmentedImageApplication {
   int display_rotation_ = 0;
 
   AAssetManager* const asset_manager_;
-
-  // Stores the randomly-selected color each plane is drawn with
-  std::unordered_map<int32_t, std::pair<ArAugmentedImage*, ArAnchor*>>
-      augmented_image_map;
+  const std::string cache_dir_;
+
+  // The session starts without images while the database is built or
+  // deserialized on database_thread_, so that the camera starts as fast for
+  // a large database as for a small one.
+  std::thread database_thread_;
+  std::mutex database_mutex_;
+  std::condition_variable database_request_changed_;
+  // Guarded by database_mutex_: the built database not yet applied to the
+  // session, the latest shard request and whether the thread should stop.
+  ArAugmentedImageDatabase* built_database_ = nullptr;
+  std::string requested_shard_;
+  // The shard key of built_database_, empty for the initial database.
+  std::string built_database_shard_;
+  // The images built_database_ was built from, empty for shards.
+  std::vector<ReferenceImageEntry> built_database_entries_;
+  bool shard_requested_ = false;
+  bool stopping_database_thread_ = false;
+  std::chrono::steady_clock::time_point session_start_;
+
+  // An image of a previous database shard whose anchor was moved to the
+  // session, so that it is still drawn after the images of the database
+  // stopped tracking.
+  struct RetainedImage {
+    ArAnchor* anchor = nullptr;
+    float extent_x = 0.f;
+    float extent_z = 0.f;
+    int32_t image_index = 0;
+  };
+  std::vector<RetainedImage> retained_images_;
+
+  // The last state ARCore reported for an image of the current database.
+  // Only images that tracked at least once have an anchor.
+  struct TrackedImage {
+    ArAnchor* anchor = nullptr;
+    ArTrackingState tracking_state = AR_TRACKING_STATE_STOPPED;
+    ArAugmentedImageTrackingMethod tracking_method =
+        AR_AUGMENTED_IMAGE_TRACKING_METHOD_NOT_TRACKING;
+    float extent_x = 0.f;
+    float extent_z = 0.f;
+    // The anchor pose, queried once the image is at its last known pose and
+    // then reused until the camera sees it again.
+    glm::mat4 model_mat = glm::mat4(1.f);
+    bool has_model_mat = false;
+    // Timestamp of the last frame the image was tracked from the camera
+    // image.
+    int64_t last_seen_ns = 0;
+  };
+  // Indexed by image index, so that the frame loop touches only the images
+  // in ArFrame_getUpdatedTrackables() and never queries ARCore for the others.
+  std::vector<TrackedImage> tracked_images_;
+  // The indices of tracked_images_ with an anchor, in no particular order.
+  std::vector<int32_t> anchored_image_indices_;
 
   BackgroundRenderer background_renderer_;
   AugmentedImageRenderer image_renderer_;
+  DetectionTelemetry detection_telemetry_;
+
+  // Playback benchmark state, see StartPlaybackBenchmark().
+  std::string benchmark_dataset_uri_;
+  PlaybackBenchmark playback_benchmark_;
+  std::atomic<bool> benchmark_finished_{false};
 };
 }  // namespace augmented_image
 
@@ -15,57 +15,283 @@
  */
 
 #include "augmented_image_renderer.h"
+
+#include <algorithm>
+
 #include "util.h"
 
 namespace augmented_image {
+namespace {
+constexpr char kVertexShaderFilename[] = "shaders/image_frame.vert";
+constexpr char kFragmentShaderFilename[] = "shaders/image_frame.frag";
+constexpr char kFrameTextureFilename[] = "models/frame_base.png";
+
+// Same material as the ObjRenderer defaults the corners were drawn with.
+constexpr float kMaterialAmbient = 0.0f;
+constexpr float kMaterialDiffuse = 2.0f;
+constexpr float kMaterialSpecular = 0.5f;
+constexpr float kMaterialSpecularPower = 6.0f;
+
+// A corner model and the direction, in units of half the image extent, its
+// vertices are moved from the image center.
+struct FrameCorner {
+  const char* obj_file_name;
+  float sign_x;
+  float sign_z;
+};
+constexpr FrameCorner kFrameCorners[] = {
+    {"models/frame_upper_left.obj", -1.0f, -1.0f},
+    {"models/frame_upper_right.obj", 1.0f, -1.0f},
+    {"models/frame_lower_right.obj", 1.0f, 1.0f},
+    {"models/frame_lower_left.obj", -1.0f, 1.0f},
+};
+
+// Interleaved vertex layout: position (xyz), normal (xyz), uv (st), corner
+// sign (xz).
+constexpr int kPositionComponents = 3;
+constexpr int kNormalComponents = 3;
+constexpr int kUvComponents = 2;
+constexpr int kCornerComponents = 2;
+constexpr int kVertexComponents = kPositionComponents + kNormalComponents +
+                                  kUvComponents + kCornerComponents;
+constexpr GLsizei kVertexStride = kVertexComponents * sizeof(GLfloat);
+constexpr size_t kNormalOffset = kPositionComponents * sizeof(GLfloat);
+constexpr size_t kUvOffset =
+    (kPositionComponents + kNormalComponents) * sizeof(GLfloat);
+constexpr size_t kCornerOffset =
+    (kPositionComponents + kNormalComponents + kUvComponents) *
+    sizeof(GLfloat);
+
+// Per instance layout: model matrix (4 columns), extent (xz), tint (rgba).
+constexpr int kModelColumns = 4;
+constexpr int kModelComponents = 16;
+constexpr int kExtentComponents = 2;
+constexpr int kTintComponents = 4;
+constexpr int kInstanceComponents =
+    kModelComponents + kExtentComponents + kTintComponents;
+constexpr GLsizei kInstanceStride = kInstanceComponents * sizeof(GLfloat);
+constexpr size_t kExtentOffset = kModelComponents * sizeof(GLfloat);
+constexpr size_t kTintOffset =
+    (kModelComponents + kExtentComponents) * sizeof(GLfloat);
+
+// Appends the corner in |obj_file_name| to the interleaved |vertices| and
+// |indices| of the frame mesh.
+bool AppendFrameCorner(AAssetManager* asset_manager, const FrameCorner& corner,
+                       std::vector<GLfloat>* vertices,
+                       std::vector<GLushort>* indices) {
+  std::vector<GLfloat> positions;
+  std::vector<GLfloat> normals;
+  std::vector<GLfloat> uvs;
+  std::vector<GLushort> corner_indices;
+  if (!util::LoadObjFile(asset_manager, corner.obj_file_name, &positions,
+                         &normals, &uvs, &corner_indices)) {
+    LOGE("Could not load obj file %s.", corner.obj_file_name);
+    return false;
+  }
+
+  const size_t first_vertex = vertices->size() / kVertexComponents;
+  const size_t vertex_count = positions.size() / kPositionComponents;
+  // Attributes missing from the OBJ file are left zeroed.
+  vertices->resize((first_vertex + vertex_count) * kVertexComponents, 0.0f);
+  for (size_t i = 0; i < vertex_count; ++i) {
+    GLfloat* out = &(*vertices)[(first_vertex + i) * kVertexComponents];
+    std::copy_n(&positions[i * kPositionComponents], kPositionComponents, out);
+    if (normals.size() >= (i + 1) * kNormalComponents) {
+      std::copy_n(&normals[i * kNormalComponents], kNormalComponents,
+                  out + kPositionComponents);
+    }
+    if (uvs.size() >= (i + 1) * kUvComponents) {
+      std::copy_n(&uvs[i * kUvComponents], kUvComponents,
+                  out + kPositionComponents + kNormalComponents);
+    }
+    out[kCornerOffset / sizeof(GLfloat)] = corner.sign_x;
+    out[kCornerOffset / sizeof(GLfloat) + 1] = corner.sign_z;
+  }
+  for (GLushort index : corner_indices) {
+    indices->push_back(static_cast<GLushort>(first_vertex + index));
+  }
+  return true;
+}
+}  // namespace
 
 void AugmentedImageRenderer::InitializeGlContent(AAssetManager* asset_manager) {
-  image_frame_upper_left.InitializeGlContent(
-      asset_manager, "models/frame_upper_left.obj", "models/frame_base.png");
-  image_frame_upper_right.InitializeGlContent(
-      asset_manager, "models/frame_upper_right.obj", "models/frame_base.png");
-  image_frame_lower_left.InitializeGlContent(
-      asset_manager, "models/frame_lower_left.obj", "models/frame_base.png");
-  image_frame_lower_right.InitializeGlContent(
-      asset_manager, "models/frame_lower_right.obj", "models/frame_base.png");
+  shader_program_ = util::CreateProgram(asset_manager, kVertexShaderFilename,
+                                        kFragmentShaderFilename);
+  if (!shader_program_) {
+    LOGE("Could not create program.");
+  }
+
+  uniform_view_mat_ = glGetUniformLocation(shader_program_, "u_View");
+  uniform_projection_mat_ =
+      glGetUniformLocation(shader_program_, "u_Projection");
+  uniform_texture_ = glGetUniformLocation(shader_program_, "u_Texture");
+  uniform_material_param_ =
+      glGetUniformLocation(shader_program_, "u_MaterialParameters");
+  uniform_color_correction_param_ =
+      glGetUniformLocation(shader_program_, "u_ColorCorrectionParameters");
+
+  const GLint attri_vertices =
+      glGetAttribLocation(shader_program_, "a_Position");
+  const GLint attri_normals = glGetAttribLocation(shader_program_, "a_Normal");
+  const GLint attri_uvs = glGetAttribLocation(shader_program_, "a_TexCoord");
+  const GLint attri_corners = glGetAttribLocation(shader_program_, "a_Corner");
+  // A mat4 attribute takes four consecutive locations, one per column.
+  const GLint attri_models = glGetAttribLocation(shader_program_, "a_Model");
+  const GLint attri_extents = glGetAttribLocation(shader_program_, "a_Extent");
+  const GLint attri_tints = glGetAttribLocation(shader_program_, "a_ColorTint");
+
+  // All corners share one copy of the texture.
+  glGenTextures(1, &texture_id_);
+  glBindTexture(GL_TEXTURE_2D, texture_id_);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                  GL_LINEAR_MIPMAP_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  if (!util::LoadPngFromAssetManager(GL_TEXTURE_2D, kFrameTextureFilename)) {
+    LOGE("Could not load png texture for image frames.");
+  }
+  glGenerateMipmap(GL_TEXTURE_2D);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  std::vector<GLfloat> vertices;
+  std::vector<GLushort> indices;
+  for (const FrameCorner& corner : kFrameCorners) {
+    AppendFrameCorner(asset_manager, corner, &vertices, &indices);
+  }
+  index_count_ = static_cast<GLsizei>(indices.size());
+
+  glGenVertexArrays(1, &vertex_array_);
+  glGenBuffers(1, &vertex_buffer_);
+  glGenBuffers(1, &index_buffer_);
+  glGenBuffers(1, &instance_buffer_);
+
+  glBindVertexArray(vertex_array_);
+  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+  glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat),
+               vertices.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort),
+               indices.data(), GL_STATIC_DRAW);
+
+  glEnableVertexAttribArray(attri_vertices);
+  glVertexAttribPointer(attri_vertices, kPositionComponents, GL_FLOAT,
+                        GL_FALSE, kVertexStride, nullptr);
+  glEnableVertexAttribArray(attri_normals);
+  glVertexAttribPointer(attri_normals, kNormalComponents, GL_FLOAT, GL_FALSE,
+                        kVertexStride,
+                        reinterpret_cast<const void*>(kNormalOffset));
+  glEnableVertexAttribArray(attri_uvs);
+  glVertexAttribPointer(attri_uvs, kUvComponents, GL_FLOAT, GL_FALSE,
+                        kVertexStride,
+                        reinterpret_cast<const void*>(kUvOffset));
+  glEnableVertexAttribArray(attri_corners);
+  glVertexAttribPointer(attri_corners, kCornerComponents, GL_FLOAT, GL_FALSE,
+                        kVertexStride,
+                        reinterpret_cast<const void*>(kCornerOffset));
+
+  // The per image attributes advance once per instance.
+  glBindBuffer(GL_ARRAY_BUFFER, instance_buffer_);
+  for (int column = 0; column < kModelColumns; ++column) {
+    const GLuint location = attri_models + column;
+    glEnableVertexAttribArray(location);
+    glVertexAttribPointer(
+        location, kModelColumns, GL_FLOAT, GL_FALSE, kInstanceStride,
+        reinterpret_cast<const void*>(column * kModelColumns *
+                                      sizeof(GLfloat)));
+    glVertexAttribDivisor(location, 1);
+  }
+  glEnableVertexAttribArray(attri_extents);
+  glVertexAttribPointer(attri_extents, kExtentComponents, GL_FLOAT, GL_FALSE,
+                        kInstanceStride,
+                        reinterpret_cast<const void*>(kExtentOffset));
+  glVertexAttribDivisor(attri_extents, 1);
+  glEnableVertexAttribArray(attri_tints);
+  glVertexAttribPointer(attri_tints, kTintComponents, GL_FLOAT, GL_FALSE,
+                        kInstanceStride,
+                        reinterpret_cast<const void*>(kTintOffset));
+  glVertexAttribDivisor(attri_tints, 1);
+
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+  util::CheckGlError("augmented_image_renderer::InitializeGlContent()");
 }
 
-void AugmentedImageRenderer::Draw(const glm::mat4& projection_mat,
-                                  const glm::mat4& view_mat,
-                                  const float* color_correction4,
-                                  const float* color_tint_rgba,
-                                  const ArSession* ar_session,
-                                  const ArAugmentedImage* ar_image,
-                                  const ArAnchor* ar_anchor) const {
+void AugmentedImageRenderer::AddImage(const ArSession* ar_session,
+                                      const ArAugmentedImage* ar_image,
+                                      const ArAnchor* ar_anchor,
+                                      const float* color_tint_rgba) {
   // Get image extents.
   float extent_x, extent_z;
   ArAugmentedImage_getExtentX(ar_session, ar_image, &extent_x);
   ArAugmentedImage_getExtentZ(ar_session, ar_image, &extent_z);
+  AddImage(ar_session, extent_x, extent_z, ar_anchor, color_tint_rgba);
+}
 
-  glm::mat4 local_upper_left_matrix = glm::translate(
-      glm::mat4(1.0), glm::vec3(-0.5f * extent_x, 0.0f, -0.5f * extent_z));
-  glm::mat4 local_upper_right_matrix = glm::translate(
-      glm::mat4(1.0), glm::vec3(0.5f * extent_x, 0.0f, -0.5f * extent_z));
-  glm::mat4 local_lower_right_matrix = glm::translate(
-      glm::mat4(1.0), glm::vec3(0.5f * extent_x, 0.0f, 0.5f * extent_z));
-  glm::mat4 local_lower_left_matrix = glm::translate(
-      glm::mat4(1.0), glm::vec3(-0.5f * extent_x, 0.0f, 0.5f * extent_z));
-
+void AugmentedImageRenderer::AddImage(const ArSession* ar_session,
+                                      float extent_x, float extent_z,
+                                      const ArAnchor* ar_anchor,
+                                      const float* color_tint_rgba) {
   glm::mat4 center_matrix;
   util::GetTransformMatrixFromAnchor(ar_session, ar_anchor, &center_matrix);
+  AddImage(extent_x, extent_z, center_matrix, color_tint_rgba);
+}
+
+void AugmentedImageRenderer::AddImage(float extent_x, float extent_z,
+                                      const glm::mat4& model_mat,
+                                      const float* color_tint_rgba) {
+  const GLfloat* model = glm::value_ptr(model_mat);
+  instances_.insert(instances_.end(), model, model + kModelComponents);
+  instances_.push_back(extent_x);
+  instances_.push_back(extent_z);
+  instances_.insert(instances_.end(), color_tint_rgba,
+                    color_tint_rgba + kTintComponents);
+}
+
+void AugmentedImageRenderer::Draw(const glm::mat4& projection_mat,
+                                  const glm::mat4& view_mat,
+                                  const float* color_correction4) {
+  const GLsizei instance_count =
+      static_cast<GLsizei>(instances_.size() / kInstanceComponents);
+  if (instance_count == 0) {
+    return;
+  }
+  if (!shader_program_) {
+    LOGE("shader_program is null.");
+    instances_.clear();
+    return;
+  }
+
+  // Orphans the storage of the previous frame, which the GPU may still read.
+  glBindBuffer(GL_ARRAY_BUFFER, instance_buffer_);
+  glBufferData(GL_ARRAY_BUFFER, instances_.size() * sizeof(GLfloat),
+               instances_.data(), GL_STREAM_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  instances_.clear();
+
+  glUseProgram(shader_program_);
+
+  glActiveTexture(GL_TEXTURE0);
+  glUniform1i(uniform_texture_, 0);
+  glBindTexture(GL_TEXTURE_2D, texture_id_);
+
+  glUniformMatrix4fv(uniform_view_mat_, 1, GL_FALSE, glm::value_ptr(view_mat));
+  glUniformMatrix4fv(uniform_projection_mat_, 1, GL_FALSE,
+                     glm::value_ptr(projection_mat));
+  glUniform4f(uniform_material_param_, kMaterialAmbient, kMaterialDiffuse,
+              kMaterialSpecular, kMaterialSpecularPower);
+  glUniform4f(uniform_color_correction_param_, color_correction4[0],
+              color_correction4[1], color_correction4[2], color_correction4[3]);
+
+  glBindVertexArray(vertex_array_);
+  glDrawElementsInstanced(GL_TRIANGLES, index_count_, GL_UNSIGNED_SHORT,
+                          nullptr, instance_count);
+  glBindVertexArray(0);
 
-  image_frame_upper_left.Draw(projection_mat, view_mat,
-                              center_matrix * local_upper_left_matrix,
-                              color_correction4, color_tint_rgba);
-  image_frame_upper_right.Draw(projection_mat, view_mat,
-                               center_matrix * local_upper_right_matrix,
-                               color_correction4, color_tint_rgba);
-  image_frame_lower_left.Draw(projection_mat, view_mat,
-                              center_matrix * local_lower_left_matrix,
-                              color_correction4, color_tint_rgba);
-  image_frame_lower_right.Draw(projection_mat, view_mat,
-                               center_matrix * local_lower_right_matrix,
-                               color_correction4, color_tint_rgba);
+  glUseProgram(0);
+  util::CheckGlError("augmented_image_renderer::Draw()");
 }
 
 }  // namespace augmented_image
@@ -17,15 +17,21 @@
 #ifndef C_ARCORE_AUGMENTED_IMAGE_AUGMENTED_IMAGE_RENDERER_H_
 #define C_ARCORE_AUGMENTED_IMAGE_AUGMENTED_IMAGE_RENDERER_H_
 
+#include <GLES3/gl3.h>
 #include <android/asset_manager.h>
 
+#include <vector>
+
 #include "arcore_c_api.h"
 #include "glm.h"
-#include "obj_renderer.h"
 
 namespace augmented_image {
 
 // AugmentedImageRenderer handles the display of image frame on ArAugmentedImage
+//
+// The four corners of the frame are one mesh whose vertices the vertex shader
+// moves out by half the extent of the image.  Frames are queued with
+// AddImage() and all of them are drawn by a single instanced draw call.
 class AugmentedImageRenderer {
  public:
   AugmentedImageRenderer() = default;
@@ -35,17 +41,41 @@ class AugmentedImageRenderer {
   // other methods below.
   void InitializeGlContent(AAssetManager* asset_manager);
 
-  // Draws frames on ArAugmentedImage, with center location at ArAnchor.
+  // Queues a frame on ArAugmentedImage, with center location at ArAnchor.
+  void AddImage(const ArSession* ar_session, const ArAugmentedImage* ar_image,
+                const ArAnchor* ar_anchor, const float* color_tint_rgba);
+
+  // Queues a frame of |extent_x| x |extent_z| meters centered at |ar_anchor|,
+  // e.g. for an image that is no longer tracked.
+  void AddImage(const ArSession* ar_session, float extent_x, float extent_z,
+                const ArAnchor* ar_anchor, const float* color_tint_rgba);
+
+  // Queues a frame of |extent_x| x |extent_z| meters at |model_mat|, e.g. a
+  // pose cached while the image is not being tracked from the camera.
+  void AddImage(float extent_x, float extent_z, const glm::mat4& model_mat,
+                const float* color_tint_rgba);
+
+  // Draws the frames queued since the last call and empties the queue.
   void Draw(const glm::mat4& projection_mat, const glm::mat4& view_mat,
-            const float* color_correction4, const float* color_tint_rgba,
-            const ArSession* ar_session, const ArAugmentedImage* ar_image,
-            const ArAnchor* ar_anchor) const;
+            const float* color_correction4);
 
  private:
-  ObjRenderer image_frame_upper_left;
-  ObjRenderer image_frame_upper_right;
-  ObjRenderer image_frame_lower_left;
-  ObjRenderer image_frame_lower_right;
+  GLuint shader_program_ = 0;
+  GLuint texture_id_ = 0;
+  GLuint vertex_array_ = 0;
+  GLuint vertex_buffer_ = 0;
+  GLuint index_buffer_ = 0;
+  GLuint instance_buffer_ = 0;
+  GLsizei index_count_ = 0;
+
+  GLint uniform_view_mat_ = -1;
+  GLint uniform_projection_mat_ = -1;
+  GLint uniform_texture_ = -1;
+  GLint uniform_material_param_ = -1;
+  GLint uniform_color_correction_param_ = -1;
+
+  // Model matrix, extent and tint of every queued frame, see AddImage().
+  std::vector<GLfloat> instances_;
 };
 
 }  // namespace augmented_image
@@ -17,17 +17,10 @@
 // This modules handles drawing the passthrough camera image into the OpenGL
 // scene.
 
-#include <type_traits>
-
 #include "background_renderer.h"
 
 namespace augmented_image {
 namespace {
-// Positions of the quad vertices in clip space (X, Y).
-const GLfloat kVertices[] = {
-    -1.0f, -1.0f, +1.0f, -1.0f, -1.0f, +1.0f, +1.0f, +1.0f,
-};
-
 constexpr char kVertexShaderFilename[] = "shaders/screenquad.vert";
 constexpr char kFragmentShaderFilename[] = "shaders/screenquad.frag";
 }  // namespace
@@ -47,21 +40,21 @@ void BackgroundRenderer::InitializeGlContent(AAssetManager* asset_manager) {
   uniform_texture_ = glGetUniformLocation(shader_program_, "sTexture");
   attribute_vertices_ = glGetAttribLocation(shader_program_, "a_Position");
   attribute_uvs_ = glGetAttribLocation(shader_program_, "a_TexCoord");
+
+  quad_.InitializeGlContent(/*uv_set_count=*/1);
+  uvs_initialized_ = false;
 }
 
 void BackgroundRenderer::Draw(const ArSession* session, const ArFrame* frame) {
-  static_assert(std::extent<decltype(kVertices)>::value == kNumVertices * 2,
-                "Incorrect kVertices length");
-
   // If display rotation changed (also includes view size change), we need to
   // re-query the uv coordinates for the on-screen portion of the camera image.
   int32_t geometry_changed = 0;
   ArFrame_getDisplayGeometryChanged(session, frame, &geometry_changed);
   if (geometry_changed != 0 || !uvs_initialized_) {
-    ArFrame_transformCoordinates2d(
-        session, frame, AR_COORDINATES_2D_OPENGL_NORMALIZED_DEVICE_COORDINATES,
-        kNumVertices, kVertices, AR_COORDINATES_2D_TEXTURE_NORMALIZED,
-        transformed_uvs_);
+    float transformed_uvs[util::ScreenQuad::kNumUvComponents];
+    util::ScreenQuad::TransformCorners(
+        session, frame, AR_COORDINATES_2D_TEXTURE_NORMALIZED, transformed_uvs);
+    quad_.SetUvs(0, transformed_uvs);
     uvs_initialized_ = true;
   }
 
@@ -82,14 +75,8 @@ void BackgroundRenderer::Draw(const ArSession* session, const ArFrame* frame) {
   glBindTexture(GL_TEXTURE_EXTERNAL_OES, texture_id_);
 
   glEnableVertexAttribArray(attribute_vertices_);
-  glVertexAttribPointer(attribute_vertices_, 2, GL_FLOAT, GL_FALSE, 0,
-                        kVertices);
-
   glEnableVertexAttribArray(attribute_uvs_);
-  glVertexAttribPointer(attribute_uvs_, 2, GL_FLOAT, GL_FALSE, 0,
-                        transformed_uvs_);
-
-  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+  quad_.Draw(attribute_vertices_, &attribute_uvs_);
 
   glUseProgram(0);
   glDepthMask(GL_TRUE);
@@ -45,8 +45,6 @@ class BackgroundRenderer {
   GLuint GetTextureId() const;
 
  private:
-  static constexpr int kNumVertices = 4;
-
   GLuint shader_program_;
   GLuint texture_id_;
 
@@ -54,7 +52,7 @@ class BackgroundRenderer {
   GLuint attribute_uvs_;
   GLuint uniform_texture_;
 
-  float transformed_uvs_[kNumVertices * 2];
+  util::ScreenQuad quad_;
   bool uvs_initialized_ = false;
 };
 }  // namespace augmented_image
@@ -0,0 +1,219 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "detection_telemetry.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace augmented_image {
+namespace {
+constexpr int64_t kNanosPerMilli = 1000000;
+}  // namespace
+
+constexpr int DetectionTelemetry::kNumBuckets;
+constexpr std::array<int64_t, DetectionTelemetry::kNumBuckets - 1>
+    DetectionTelemetry::kBucketLimitsMs;
+constexpr int64_t DetectionTelemetry::kGoodTrackingMs;
+constexpr int64_t DetectionTelemetry::kPoorTrackingMs;
+constexpr int DetectionTelemetry::kPoorQualityScore;
+constexpr int DetectionTelemetry::kMinQualitySamples;
+
+void DetectionTelemetry::LatencyHistogram::Add(int64_t latency_ns) {
+  const int64_t latency_ms = latency_ns / kNanosPerMilli;
+  int bucket = 0;
+  while (bucket < kNumBuckets - 1 && latency_ms >= kBucketLimitsMs[bucket]) {
+    ++bucket;
+  }
+  ++counts[bucket];
+  ++num_samples;
+  sum_ms += latency_ms;
+}
+
+std::string DetectionTelemetry::LatencyHistogram::ToString() const {
+  if (num_samples == 0) {
+    return "none";
+  }
+  char text[32];
+  snprintf(text, sizeof(text), "mean %lld ms [",
+           static_cast<long long>(sum_ms / num_samples));
+  std::string result = text;
+  for (int bucket = 0; bucket < kNumBuckets; ++bucket) {
+    if (bucket < kNumBuckets - 1) {
+      snprintf(text, sizeof(text), "<%lld:%d ",
+               static_cast<long long>(kBucketLimitsMs[bucket]),
+               counts[bucket]);
+    } else {
+      snprintf(text, sizeof(text), ">=%lld:%d]",
+               static_cast<long long>(kBucketLimitsMs[bucket - 1]),
+               counts[bucket]);
+    }
+    result += text;
+  }
+  return result;
+}
+
+void DetectionTelemetry::ImageQuality::Add(int64_t latency_ns) {
+  ++num_samples;
+  sum_ms += latency_ns / kNanosPerMilli;
+}
+
+int DetectionTelemetry::ImageQuality::GetScore() const {
+  if (num_samples == 0) {
+    return -1;
+  }
+  const int64_t mean_ms = sum_ms / num_samples;
+  const int64_t score = 100 * (kPoorTrackingMs - mean_ms) /
+                        (kPoorTrackingMs - kGoodTrackingMs);
+  return static_cast<int>(std::min<int64_t>(std::max<int64_t>(score, 0), 100));
+}
+
+void DetectionTelemetry::OnDatabaseApplied(
+    const std::string& shard_key, int32_t num_images,
+    const std::vector<ReferenceImageEntry>& entries) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  RecordUntrackedImages();
+  current_shard_ = &shards_[shard_key];
+  current_shard_->num_images = num_images;
+  images_.assign(num_images, ImageTimes());
+  database_start_ns_ = -1;
+  sized_image_names_.clear();
+  for (const ReferenceImageEntry& entry : entries) {
+    if (entry.physical_width_m > 0.f) {
+      sized_image_names_.insert(entry.asset_path);
+    }
+  }
+}
+
+void DetectionTelemetry::RecordUntrackedImages() {
+  for (const ImageTimes& image : images_) {
+    if (image.quality != nullptr && image.first_paused_ns >= 0 &&
+        image.first_tracking_ns < 0) {
+      image.quality->Add(frame_timestamp_ns_ - image.first_paused_ns);
+      ++image.quality->num_never_tracked;
+    }
+  }
+}
+
+void DetectionTelemetry::OnFrame(int64_t timestamp_ns) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  frame_timestamp_ns_ = timestamp_ns;
+  if (current_shard_ != nullptr && database_start_ns_ < 0) {
+    database_start_ns_ = timestamp_ns;
+  }
+}
+
+void DetectionTelemetry::OnImageUpdated(const ArSession* session,
+                                        const ArAugmentedImage* ar_image,
+                                        int32_t image_index,
+                                        ArTrackingState tracking_state) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (current_shard_ == nullptr || database_start_ns_ < 0 ||
+      image_index < 0) {
+    return;
+  }
+  if (image_index >= static_cast<int32_t>(images_.size())) {
+    images_.resize(image_index + 1);
+  }
+  ImageTimes& image = images_[image_index];
+  const int64_t now_ns = frame_timestamp_ns_;
+  if (image.quality == nullptr) {
+    char* name = nullptr;
+    ArAugmentedImage_acquireName(session, ar_image, &name);
+    const std::string image_name = name != nullptr ? name : "";
+    ArString_release(name);
+    image.quality = &image_quality_[image_name];
+    image.quality->has_physical_size = sized_image_names_.count(image_name) > 0;
+  }
+
+  if (tracking_state != AR_TRACKING_STATE_STOPPED &&
+      image.first_paused_ns < 0 && image.first_tracking_ns < 0) {
+    current_shard_->detection.Add(now_ns - database_start_ns_);
+    ++current_shard_->num_detected;
+  }
+  switch (tracking_state) {
+    case AR_TRACKING_STATE_PAUSED:
+      if (image.first_paused_ns < 0 && image.first_tracking_ns < 0) {
+        image.first_paused_ns = now_ns;
+      }
+      break;
+    case AR_TRACKING_STATE_TRACKING:
+      if (image.first_tracking_ns < 0) {
+        image.first_tracking_ns = now_ns;
+        ++current_shard_->num_tracked;
+        if (image.first_paused_ns >= 0) {
+          const int64_t latency_ns = now_ns - image.first_paused_ns;
+          current_shard_->tracking.Add(latency_ns);
+          if (image.quality->has_physical_size) {
+            current_shard_->tracking_known_size.Add(latency_ns);
+          }
+          image.quality->Add(latency_ns);
+        }
+      } else if (image.lost_ns >= 0) {
+        current_shard_->recovery.Add(now_ns - image.lost_ns);
+        image.quality->Add(now_ns - image.lost_ns);
+      }
+      image.lost_ns = -1;
+      break;
+    default:
+      break;
+  }
+  if (image.tracking_state == AR_TRACKING_STATE_TRACKING &&
+      tracking_state != AR_TRACKING_STATE_TRACKING) {
+    image.lost_ns = now_ns;
+    ++current_shard_->num_losses;
+  }
+  image.tracking_state = tracking_state;
+}
+
+std::string DetectionTelemetry::GetReport() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::string report;
+  for (const auto& it : shards_) {
+    const ShardStats& shard = it.second;
+    char counts[96];
+    snprintf(counts, sizeof(counts),
+             "': %d images, %d detected, %d tracked, %d losses",
+             shard.num_images, shard.num_detected, shard.num_tracked,
+             shard.num_losses);
+    report += "shard '" + it.first + counts;
+    report += "; detection " + shard.detection.ToString();
+    report += "; tracking " + shard.tracking.ToString();
+    report += "; tracking with physical size " +
+              shard.tracking_known_size.ToString();
+    report += "; recovery " + shard.recovery.ToString();
+    report += "\n";
+  }
+  for (const auto& it : image_quality_) {
+    const ImageQuality& quality = it.second;
+    const int score = quality.GetScore();
+    if (score < 0) {
+      continue;
+    }
+    const bool is_poor = quality.num_samples >= kMinQualitySamples &&
+                         score < kPoorQualityScore;
+    char line[128];
+    snprintf(line, sizeof(line),
+             "': quality %d from %d samples, %d never tracked%s%s\n", score,
+             quality.num_samples, quality.num_never_tracked,
+             quality.has_physical_size ? ", physical size" : "",
+             is_poor ? ", POOR" : "");
+    report += "image '" + it.first + line;
+  }
+  return report;
+}
+
+}  // namespace augmented_image
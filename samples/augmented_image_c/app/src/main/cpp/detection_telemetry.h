@@ -0,0 +1,153 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_AUGMENTED_IMAGE_DETECTION_TELEMETRY_H_
+#define C_ARCORE_AUGMENTED_IMAGE_DETECTION_TELEMETRY_H_
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <mutex>  // NOLINT
+#include <set>
+#include <string>
+#include <vector>
+
+#include "arcore_c_api.h"
+#include "image_database_builder.h"
+
+namespace augmented_image {
+
+// Records how long the images of each database shard take to be detected and
+// tracked, so that the shard size and image quality can be tuned per device.
+//
+// For every image of the active database it records the frame in which the
+// image was first reported PAUSED (detected but not tracked yet) and first
+// TRACKING, and every loss of tracking.  Three latencies are aggregated into
+// histograms per shard:
+//   detection: database applied -> first PAUSED (or TRACKING if ARCore skips
+//              PAUSED), which includes the time the image was out of view.
+//   tracking:  first PAUSED -> first TRACKING.
+//   recovery:  loss of tracking -> TRACKING again.
+// The tracking latencies of images added with their physical size are also
+// aggregated on their own, as ARCore does not have to estimate their scale.
+//
+// Every image also gets a quality score from the tracking and recovery
+// latencies it had across all databases, by name: 100 at kGoodTrackingMs or
+// faster, 0 at kPoorTrackingMs or slower.  An image detected but never
+// tracked before its database was replaced counts with the time it was
+// waited for.  Images that score below kPoorQualityScore after
+// kMinQualitySamples samples are flagged, to be replaced or printed larger.
+//
+// The OnXxx() methods are called on the OpenGL thread, GetReport() may be
+// called from any thread.
+class DetectionTelemetry {
+ public:
+  // Upper bounds of the histogram buckets in ms; a last bucket holds the rest.
+  static constexpr int kNumBuckets = 9;
+  static constexpr std::array<int64_t, kNumBuckets - 1> kBucketLimitsMs = {
+      {50, 100, 200, 500, 1000, 2000, 5000, 10000}};
+
+  static constexpr int64_t kGoodTrackingMs = 200;
+  static constexpr int64_t kPoorTrackingMs = 2000;
+  static constexpr int kPoorQualityScore = 50;
+  static constexpr int kMinQualitySamples = 3;
+
+  // Starts recording the |num_images| images of the database of |shard_key|,
+  // the empty key for the database the app started with.  |entries| are the
+  // images the database was built from, empty if it was deserialized, and
+  // tell which images have a physical size.  The latencies count from the
+  // first frame passed to OnFrame() afterwards.
+  void OnDatabaseApplied(const std::string& shard_key, int32_t num_images,
+                         const std::vector<ReferenceImageEntry>& entries);
+
+  // Called with the timestamp of every frame before its images are reported.
+  void OnFrame(int64_t timestamp_ns);
+
+  // Records a tracking state from ArFrame_getUpdatedTrackables() for |image|,
+  // at |image_index| of the current database.  Its name is only read the
+  // first time.
+  void OnImageUpdated(const ArSession* session, const ArAugmentedImage* image,
+                      int32_t image_index, ArTrackingState tracking_state);
+
+  // One line per shard with the number of images detected, tracked and lost
+  // and the histograms of the three latencies, then one line per image with
+  // its quality score.
+  std::string GetReport() const;
+
+ private:
+  struct LatencyHistogram {
+    std::array<int, kNumBuckets> counts = {};
+    int num_samples = 0;
+    int64_t sum_ms = 0;
+
+    void Add(int64_t latency_ns);
+    std::string ToString() const;
+  };
+
+  struct ShardStats {
+    int num_images = 0;
+    int num_detected = 0;
+    int num_tracked = 0;
+    int num_losses = 0;
+    LatencyHistogram detection;
+    LatencyHistogram tracking;
+    // The subset of tracking of images with a physical size.
+    LatencyHistogram tracking_known_size;
+    LatencyHistogram recovery;
+  };
+
+  // Latencies until an image tracked, over all databases it was part of.
+  struct ImageQuality {
+    int num_samples = 0;
+    int64_t sum_ms = 0;
+    int num_never_tracked = 0;
+    bool has_physical_size = false;
+
+    void Add(int64_t latency_ns);
+    // 0 to 100, or -1 without samples.
+    int GetScore() const;
+  };
+
+  // Frame timestamps of one image of the current database, -1 until seen.
+  struct ImageTimes {
+    int64_t first_paused_ns = -1;
+    int64_t first_tracking_ns = -1;
+    int64_t lost_ns = -1;
+    ArTrackingState tracking_state = AR_TRACKING_STATE_STOPPED;
+    // Null until the image was first reported.
+    ImageQuality* quality = nullptr;
+  };
+
+  // Adds the wait of every image of the current database that was detected
+  // but never tracked.
+  void RecordUntrackedImages();
+
+  // Guards all members below; the OpenGL thread holds it only briefly.
+  mutable std::mutex mutex_;
+  std::map<std::string, ShardStats> shards_;
+  ShardStats* current_shard_ = nullptr;
+  std::vector<ImageTimes> images_;
+  // By image name.
+  std::map<std::string, ImageQuality> image_quality_;
+  // Names of the current database's images that have a physical size.
+  std::set<std::string> sized_image_names_;
+  int64_t database_start_ns_ = -1;
+  int64_t frame_timestamp_ns_ = -1;
+};
+
+}  // namespace augmented_image
+
+#endif  // C_ARCORE_AUGMENTED_IMAGE_DETECTION_TELEMETRY_H_
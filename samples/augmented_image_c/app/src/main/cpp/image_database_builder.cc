@@ -0,0 +1,284 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "image_database_builder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>  // NOLINT
+#include <sstream>
+#include <thread>  // NOLINT
+
+#include "jni_interface.h"
+#include "util.h"
+
+namespace augmented_image {
+namespace {
+// Workers stay at most this many images per worker ahead of the image being
+// added, which bounds the memory of the prepared images.
+constexpr int kMaxPreparedImagesPerWorker = 2;
+
+// Part of the database cache key, to be bumped whenever the way images are
+// prepared changes.
+constexpr uint64_t kImageDatabaseCacheVersion = 1;
+
+// 64-bit FNV-1a, stable across runs and devices.
+uint64_t HashBytes(const void* data, size_t size, uint64_t hash) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+float MillisecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<float, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+// A grayscale image a worker prepared for ArAugmentedImageDatabase_addImage.
+struct PreparedImage {
+  bool ready = false;
+  bool loaded = false;
+  int32_t width = 0;
+  int32_t height = 0;
+  std::vector<uint8_t> pixels;
+};
+
+// State shared by the workers and the thread adding the images.
+struct IngestionQueue {
+  std::mutex mutex;
+  std::condition_variable changed;
+  // Guarded by mutex.
+  std::vector<PreparedImage> images;
+  int next_to_add = 0;
+  float decode_ms = 0.f;
+  float convert_ms = 0.f;
+
+  std::atomic<int> next_to_prepare{0};
+};
+
+void PrepareImages(const std::vector<ReferenceImageEntry>& entries,
+                   int32_t max_image_dimension, int max_prepared_images,
+                   IngestionQueue* queue) {
+  const int num_images = static_cast<int>(entries.size());
+  while (true) {
+    const int index = queue->next_to_prepare.fetch_add(1);
+    if (index >= num_images) {
+      break;
+    }
+    {
+      std::unique_lock<std::mutex> lock(queue->mutex);
+      queue->changed.wait(lock, [queue, index, max_prepared_images] {
+        return index < queue->next_to_add + max_prepared_images;
+      });
+    }
+
+    PreparedImage image;
+    const auto decode_start = std::chrono::steady_clock::now();
+    float decode_ms = 0.f;
+    float convert_ms = 0.f;
+    {
+      util::ScopedAssetBitmap bitmap;
+      if (bitmap.Open(entries[index].asset_path)) {
+        decode_ms = MillisecondsSince(decode_start);
+        const auto convert_start = std::chrono::steady_clock::now();
+        const int32_t scale = util::GetGrayscaleScale(
+            bitmap.GetWidth(), bitmap.GetHeight(), max_image_dimension);
+        image.width = bitmap.GetWidth() / scale;
+        image.height = bitmap.GetHeight() / scale;
+        image.pixels.resize(image.width * image.height);
+        util::ConvertRgbaToGrayscale(bitmap.GetPixels(), bitmap.GetWidth(),
+                                     bitmap.GetHeight(), bitmap.GetStride(),
+                                     scale, image.pixels.data(), image.width);
+        convert_ms = MillisecondsSince(convert_start);
+        image.loaded = true;
+      }
+    }
+    image.ready = true;
+
+    {
+      std::lock_guard<std::mutex> lock(queue->mutex);
+      queue->images[index] = std::move(image);
+      queue->decode_ms += decode_ms;
+      queue->convert_ms += convert_ms;
+    }
+    queue->changed.notify_all();
+  }
+  // Decoding attached the worker to the JVM.
+  DetachJniEnv();
+}
+}  // namespace
+
+bool LoadImageManifest(AAssetManager* mgr, const char* file_name,
+                       std::vector<ReferenceImageEntry>* out_entries) {
+  std::string manifest;
+  if (!util::LoadFileFromAssetManager(mgr, file_name, &manifest)) {
+    return false;
+  }
+  std::istringstream lines(manifest);
+  std::string line;
+  while (std::getline(lines, line)) {
+    std::istringstream fields(line);
+    ReferenceImageEntry entry;
+    if (!(fields >> entry.asset_path) || entry.asset_path[0] == '#') {
+      continue;
+    }
+    std::string width;
+    if (fields >> width) {
+      char* end = nullptr;
+      entry.physical_width_m = strtof(width.c_str(), &end);
+      if (*end != '\0' || !(entry.physical_width_m > 0.f)) {
+        LOGE("%s: ignoring the physical width '%s' of %s", file_name,
+             width.c_str(), entry.asset_path.c_str());
+        entry.physical_width_m = 0.f;
+      }
+    }
+    out_entries->push_back(entry);
+  }
+  return true;
+}
+
+ImageDatabaseBuildStats AddImagesToDatabase(
+    const ArSession* session, const std::vector<ReferenceImageEntry>& entries,
+    int32_t max_image_dimension, int num_workers,
+    const ImageDatabaseProgressCallback& progress,
+    ArAugmentedImageDatabase* database) {
+  const auto start = std::chrono::steady_clock::now();
+  ImageDatabaseBuildStats stats;
+  stats.num_images = static_cast<int>(entries.size());
+  num_workers = std::min(std::max(1, num_workers), stats.num_images);
+
+  IngestionQueue queue;
+  queue.images.resize(entries.size());
+  std::vector<std::thread> workers;
+  for (int i = 0; i < num_workers; ++i) {
+    workers.emplace_back(PrepareImages, std::cref(entries),
+                         max_image_dimension,
+                         num_workers * kMaxPreparedImagesPerWorker, &queue);
+  }
+
+  for (int index = 0; index < stats.num_images; ++index) {
+    PreparedImage image;
+    {
+      std::unique_lock<std::mutex> lock(queue.mutex);
+      queue.changed.wait(lock,
+                         [&queue, index] { return queue.images[index].ready; });
+      image = std::move(queue.images[index]);
+      queue.next_to_add = index + 1;
+    }
+    queue.changed.notify_all();
+
+    if (image.loaded) {
+      const ReferenceImageEntry& entry = entries[index];
+      const auto add_start = std::chrono::steady_clock::now();
+      int32_t database_index = 0;
+      const ArStatus status =
+          entry.physical_width_m > 0.f
+              ? ArAugmentedImageDatabase_addImageWithPhysicalSize(
+                    session, database, entry.asset_path.c_str(),
+                    image.pixels.data(), image.width, image.height,
+                    image.width, entry.physical_width_m, &database_index)
+              : ArAugmentedImageDatabase_addImage(
+                    session, database, entry.asset_path.c_str(),
+                    image.pixels.data(), image.width, image.height,
+                    image.width, &database_index);
+      stats.add_ms += MillisecondsSince(add_start);
+      if (status == AR_SUCCESS) {
+        ++stats.num_added;
+        if (entry.physical_width_m > 0.f) {
+          ++stats.num_with_physical_size;
+        }
+      } else {
+        LOGE("Failed to add image %s to the database: %d",
+             entry.asset_path.c_str(), status);
+      }
+    }
+    if (progress) {
+      progress(index + 1, stats.num_images);
+    }
+  }
+
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+  stats.decode_ms = queue.decode_ms;
+  stats.convert_ms = queue.convert_ms;
+  stats.total_ms = MillisecondsSince(start);
+  return stats;
+}
+
+bool HashReferenceImages(AAssetManager* mgr,
+                         const std::vector<ReferenceImageEntry>& entries,
+                         int32_t max_image_dimension, uint64_t* out_hash) {
+  uint64_t hash = 14695981039346656037ull;
+  hash = HashBytes(&kImageDatabaseCacheVersion,
+                   sizeof(kImageDatabaseCacheVersion), hash);
+  hash = HashBytes(&max_image_dimension, sizeof(max_image_dimension), hash);
+  for (const ReferenceImageEntry& entry : entries) {
+    util::AssetBuffer image_file;
+    if (!image_file.Open(mgr, entry.asset_path.c_str())) {
+      return false;
+    }
+    // The terminating null separates the paths.
+    hash = HashBytes(entry.asset_path.c_str(), entry.asset_path.size() + 1,
+                     hash);
+    hash = HashBytes(&entry.physical_width_m, sizeof(entry.physical_width_m),
+                     hash);
+    hash = HashBytes(image_file.GetData(), image_file.GetSize(), hash);
+  }
+  *out_hash = hash;
+  return true;
+}
+
+ArAugmentedImageDatabase* LoadImageDatabaseFile(const ArSession* session,
+                                                const std::string& path) {
+  util::MappedFile file;
+  if (!file.Open(path)) {
+    return nullptr;
+  }
+  ArAugmentedImageDatabase* database = nullptr;
+  const ArStatus status = ArAugmentedImageDatabase_deserialize(
+      session, file.GetData(), file.GetSize(), &database);
+  if (status != AR_SUCCESS) {
+    // E.g. written by an ARCore version with another format; the caller
+    // rebuilds it.
+    LOGE("Failed to deserialize image database %s: %d", path.c_str(), status);
+    return nullptr;
+  }
+  return database;
+}
+
+bool SaveImageDatabaseFile(const ArSession* session,
+                           const ArAugmentedImageDatabase* database,
+                           const std::string& path) {
+  uint8_t* data = nullptr;
+  int64_t size = 0;
+  ArAugmentedImageDatabase_serialize(session, database, &data, &size);
+  if (data == nullptr) {
+    return false;
+  }
+  const bool write_ok = util::WriteFileAtomically(path, data, size);
+  ArByteArray_release(data);
+  return write_ok;
+}
+
+}  // namespace augmented_image
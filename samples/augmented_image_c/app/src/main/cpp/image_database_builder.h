@@ -0,0 +1,111 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_AUGMENTED_IMAGE_IMAGE_DATABASE_BUILDER_H_
+#define C_ARCORE_AUGMENTED_IMAGE_IMAGE_DATABASE_BUILDER_H_
+
+#include <android/asset_manager.h>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "arcore_c_api.h"
+
+namespace augmented_image {
+
+// One reference image of a manifest.
+struct ReferenceImageEntry {
+  // Path of the image file, relative to the assets folder.  Also the name of
+  // the image in the database.
+  std::string asset_path;
+  // Physical width of the image in meters, or 0 if unknown.
+  float physical_width_m = 0.f;
+};
+
+// Reads a manifest with one reference image per line: its asset path,
+// optionally followed by its physical width in meters.  Empty lines and lines
+// starting with '#' are skipped.  A width that is not a positive number is
+// logged and the image added without one.
+//
+// @param mgr, AAssetManager pointer.
+// @param file_name, path to the manifest, relative to the assets folder.
+// @param out_entries, the images in the order of the manifest.
+// @return true if the manifest is read, otherwise false.
+bool LoadImageManifest(AAssetManager* mgr, const char* file_name,
+                       std::vector<ReferenceImageEntry>* out_entries);
+
+// Result of AddImagesToDatabase().  The decode and convert times are summed
+// over all workers, so they can exceed the total time.
+struct ImageDatabaseBuildStats {
+  int num_images = 0;
+  int num_added = 0;
+  // Of the added images, those added with their physical width.
+  int num_with_physical_size = 0;
+  float decode_ms = 0.f;
+  float convert_ms = 0.f;
+  float add_ms = 0.f;
+  float total_ms = 0.f;
+};
+
+// Called after every image with the number of images done so far.
+using ImageDatabaseProgressCallback =
+    std::function<void(int num_done, int num_images)>;
+
+// Adds the images of |entries| to |database|.  They are decoded and converted
+// to grayscale, scaled down to at most |max_image_dimension| pixels on either
+// side, on |num_workers| threads.  ArAugmentedImageDatabase_addImage must not
+// run concurrently, so the images are added on the calling thread, in the
+// order of |entries|, while the workers prepare the next ones.  Images with a
+// physical width are added with their size, so ARCore does not need to
+// estimate their scale before tracking them.
+//
+// Images that fail to load or to be added are logged and skipped, so the
+// database indices follow |entries| only if none fails.  |progress| is called
+// on the calling thread and may be empty.
+ImageDatabaseBuildStats AddImagesToDatabase(
+    const ArSession* session, const std::vector<ReferenceImageEntry>& entries,
+    int32_t max_image_dimension, int num_workers,
+    const ImageDatabaseProgressCallback& progress,
+    ArAugmentedImageDatabase* database);
+
+// 64-bit hash of everything a database built by AddImagesToDatabase() from
+// |entries| depends on: the paths, physical widths and file contents of the
+// images and |max_image_dimension|.  Reading the compressed files is cheap
+// next to decoding them and extracting their features.
+//
+// @return true if every image could be read, otherwise false.
+bool HashReferenceImages(AAssetManager* mgr,
+                         const std::vector<ReferenceImageEntry>& entries,
+                         int32_t max_image_dimension, uint64_t* out_hash);
+
+// Deserializes a database written by SaveImageDatabaseFile() straight from
+// the mapped file.
+//
+// @return the database, or null if the file is missing or not accepted.
+ArAugmentedImageDatabase* LoadImageDatabaseFile(const ArSession* session,
+                                                const std::string& path);
+
+// Serializes |database| to |path|.
+//
+// @return true if the file is written, otherwise false.
+bool SaveImageDatabaseFile(const ArSession* session,
+                           const ArAugmentedImageDatabase* database,
+                           const std::string& path);
+
+}  // namespace augmented_image
+
+#endif  // C_ARCORE_AUGMENTED_IMAGE_IMAGE_DATABASE_BUILDER_H_
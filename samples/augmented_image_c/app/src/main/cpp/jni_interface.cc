@@ -31,6 +31,10 @@ namespace {
 // maintain a reference to the JVM so we can use it later.
 static JavaVM *g_vm = nullptr;
 
+// The JNIEnv of the current thread, so that GetJniEnv() only goes through
+// the JVM on a thread's first call.
+thread_local JNIEnv *t_env = nullptr;
+
 inline jlong jptr(augmented_image::AugmentedImageApplication
                       *native_augmented_image_application) {
   return reinterpret_cast<intptr_t>(native_augmented_image_application);
@@ -55,9 +59,13 @@ void JNI_OnUnload(JavaVM *vm, void *reserved) {
 }
 
 JNI_METHOD(jlong, createNativeApplication)
-(JNIEnv *env, jclass, jobject j_asset_manager) {
+(JNIEnv *env, jclass, jobject j_asset_manager, jstring j_cache_dir) {
   AAssetManager *asset_manager = AAssetManager_fromJava(env, j_asset_manager);
-  return jptr(new augmented_image::AugmentedImageApplication(asset_manager));
+  const char *cache_dir = env->GetStringUTFChars(j_cache_dir, nullptr);
+  jlong native_application = jptr(
+      new augmented_image::AugmentedImageApplication(asset_manager, cache_dir));
+  env->ReleaseStringUTFChars(j_cache_dir, cache_dir);
+  return native_application;
 }
 
 JNI_METHOD(void, destroyNativeApplication)
@@ -93,10 +101,57 @@ JNI_METHOD(void, onGlSurfaceDrawFrame)
   native(native_application)->OnDrawFrame(activity);
 }
 
+JNI_METHOD(void, selectImageDatabaseShard)
+(JNIEnv *env, jclass, jlong native_application, jstring context_key) {
+  const char *context_key_chars = env->GetStringUTFChars(context_key, nullptr);
+  native(native_application)->SelectImageDatabaseShard(context_key_chars);
+  env->ReleaseStringUTFChars(context_key, context_key_chars);
+}
+
+JNI_METHOD(jstring, getDetectionLatencyReport)
+(JNIEnv *env, jclass, jlong native_application) {
+  const std::string report =
+      native(native_application)->GetDetectionLatencyReport();
+  return env->NewStringUTF(report.c_str());
+}
+
+JNI_METHOD(jboolean, startPlaybackBenchmark)
+(JNIEnv *env, jclass, jlong native_application, jstring j_dataset_uri,
+ jstring j_csv_path) {
+  const char *dataset_uri = env->GetStringUTFChars(j_dataset_uri, nullptr);
+  const char *csv_path = env->GetStringUTFChars(j_csv_path, nullptr);
+  const bool started = native(native_application)
+                           ->StartPlaybackBenchmark(dataset_uri, csv_path);
+  env->ReleaseStringUTFChars(j_csv_path, csv_path);
+  env->ReleaseStringUTFChars(j_dataset_uri, dataset_uri);
+  return static_cast<jboolean>(started ? JNI_TRUE : JNI_FALSE);
+}
+
+JNI_METHOD(jboolean, isPlaybackBenchmarkFinished)
+(JNIEnv *, jclass, jlong native_application) {
+  return static_cast<jboolean>(
+      native(native_application)->IsPlaybackBenchmarkFinished() ? JNI_TRUE
+                                                                : JNI_FALSE);
+}
+
 JNIEnv *GetJniEnv() {
-  JNIEnv *env;
-  jint result = g_vm->AttachCurrentThread(&env, nullptr);
-  return result == JNI_OK ? env : nullptr;
+  if (t_env == nullptr) {
+    JNIEnv *env = nullptr;
+    if (g_vm->AttachCurrentThread(&env, nullptr) != JNI_OK) {
+      return nullptr;
+    }
+    t_env = env;
+  }
+  return t_env;
+}
+
+void DetachJniEnv() {
+  t_env = nullptr;
+  JNIEnv *env = nullptr;
+  if (g_vm->GetEnv(reinterpret_cast<void **>(&env), JNI_VERSION_1_6) ==
+      JNI_OK) {
+    g_vm->DetachCurrentThread();
+  }
 }
 
 jclass FindClass(const char *classname) {
@@ -24,11 +24,15 @@
 extern "C" {
 
 // Helper function used to access the jni environment on the current thread.
-// In this sample, no consideration is made for detaching the thread when the
-// thread exits. This can cause memory leaks, so production applications should
-// detach when the thread no longer needs access to the JVM.
+// Threads stay attached until they call DetachJniEnv(), which the threads the
+// JVM started must not do.
 JNIEnv *GetJniEnv();
 
+// Detaches the current thread from the JVM if it is attached.  Threads started
+// by the native code call it before they exit if they may have called
+// GetJniEnv().
+void DetachJniEnv();
+
 jclass FindClass(const char *classname);
 }  // extern "C"
 #endif
@@ -15,6 +15,9 @@
  */
 
 #include "obj_renderer.h"
+
+#include <algorithm>
+
 #include "util.h"
 
 namespace augmented_image {
@@ -23,6 +26,17 @@ const glm::vec4 kLightDirection(0.0f, 1.0f, 0.0f, 0.0f);
 const float kNoTintColor[4] = {0.0f, 0.0f, 0.0f, 1.0f};
 constexpr char kVertexShaderFilename[] = "shaders/object.vert";
 constexpr char kFragmentShaderFilename[] = "shaders/object.frag";
+
+// Interleaved vertex layout: position (xyz), normal (xyz), uv (st).
+constexpr int kPositionComponents = 3;
+constexpr int kNormalComponents = 3;
+constexpr int kUvComponents = 2;
+constexpr int kVertexComponents =
+    kPositionComponents + kNormalComponents + kUvComponents;
+constexpr GLsizei kVertexStride = kVertexComponents * sizeof(GLfloat);
+constexpr size_t kNormalOffset = kPositionComponents * sizeof(GLfloat);
+constexpr size_t kUvOffset =
+    (kPositionComponents + kNormalComponents) * sizeof(GLfloat);
 }  // namespace
 
 void ObjRenderer::InitializeGlContent(AAssetManager* asset_manager,
@@ -67,8 +81,62 @@ void ObjRenderer::InitializeGlContent(AAssetManager* asset_manager,
 
   glBindTexture(GL_TEXTURE_2D, 0);
 
-  util::LoadObjFile(asset_manager, obj_file_name, &vertices_, &normals_, &uvs_,
-                    &indices_);
+  std::vector<GLfloat> vertices;
+  std::vector<GLfloat> normals;
+  std::vector<GLfloat> uvs;
+  std::vector<GLushort> indices;
+  if (!util::LoadObjFile(asset_manager, obj_file_name, &vertices, &normals,
+                         &uvs, &indices)) {
+    LOGE("Could not load obj file %s.", obj_file_name.c_str());
+  }
+
+  // Interleaves the attributes so each vertex is fetched from one cache line.
+  // Attributes missing from the OBJ file are left zeroed.
+  const size_t vertex_count = vertices.size() / kPositionComponents;
+  std::vector<GLfloat> interleaved(vertex_count * kVertexComponents, 0.0f);
+  for (size_t i = 0; i < vertex_count; ++i) {
+    GLfloat* out = &interleaved[i * kVertexComponents];
+    std::copy_n(&vertices[i * kPositionComponents], kPositionComponents, out);
+    if (normals.size() >= (i + 1) * kNormalComponents) {
+      std::copy_n(&normals[i * kNormalComponents], kNormalComponents,
+                  out + kPositionComponents);
+    }
+    if (uvs.size() >= (i + 1) * kUvComponents) {
+      std::copy_n(&uvs[i * kUvComponents], kUvComponents,
+                  out + kPositionComponents + kNormalComponents);
+    }
+  }
+  index_count_ = static_cast<GLsizei>(indices.size());
+
+  glGenVertexArrays(1, &vertex_array_);
+  glGenBuffers(1, &vertex_buffer_);
+  glGenBuffers(1, &index_buffer_);
+
+  glBindVertexArray(vertex_array_);
+  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+  glBufferData(GL_ARRAY_BUFFER, interleaved.size() * sizeof(GLfloat),
+               interleaved.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort),
+               indices.data(), GL_STATIC_DRAW);
+
+  glEnableVertexAttribArray(attri_vertices_);
+  glVertexAttribPointer(attri_vertices_, kPositionComponents, GL_FLOAT,
+                        GL_FALSE, kVertexStride, nullptr);
+
+  glEnableVertexAttribArray(attri_normals_);
+  glVertexAttribPointer(attri_normals_, kNormalComponents, GL_FLOAT, GL_FALSE,
+                        kVertexStride,
+                        reinterpret_cast<const void*>(kNormalOffset));
+
+  glEnableVertexAttribArray(attri_uvs_);
+  glVertexAttribPointer(attri_uvs_, kUvComponents, GL_FLOAT, GL_FALSE,
+                        kVertexStride,
+                        reinterpret_cast<const void*>(kUvOffset));
+
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
   util::CheckGlError("obj_renderer::InitializeGlContent()");
 }
@@ -102,9 +170,11 @@ void ObjRenderer::Draw(const glm::mat4& projection_mat,
   glUniform1i(uniform_texture_, 0);
   glBindTexture(GL_TEXTURE_2D, texture_id_);
 
-  glm::mat4 mvp_mat = projection_mat * view_mat * model_mat;
-  glm::mat4 mv_mat = view_mat * model_mat;
-  glm::vec4 view_light_direction = glm::normalize(mv_mat * kLightDirection);
+  glm::mat4 mvp_mat =
+      util::MultiplyMatrices(projection_mat, view_mat, model_mat);
+  glm::mat4 mv_mat = util::MultiplyMatrices(view_mat, model_mat);
+  glm::vec4 view_light_direction =
+      util::NormalizeVector(mv_mat * kLightDirection);
 
   glUniform4f(uniform_lighting_param_, view_light_direction[0],
               view_light_direction[1], view_light_direction[2], 1.f);
@@ -120,26 +190,11 @@ void ObjRenderer::Draw(const glm::mat4& projection_mat,
   glUniformMatrix4fv(uniform_mvp_mat_, 1, GL_FALSE, glm::value_ptr(mvp_mat));
   glUniformMatrix4fv(uniform_mv_mat_, 1, GL_FALSE, glm::value_ptr(mv_mat));
 
-  // Note: for simplicity, we are uploading the model each time we draw it.  A
-  // real application should use vertex buffers to upload the geometry once.
-
-  glEnableVertexAttribArray(attri_vertices_);
-  glVertexAttribPointer(attri_vertices_, 3, GL_FLOAT, GL_FALSE, 0,
-                        vertices_.data());
-
-  glEnableVertexAttribArray(attri_normals_);
-  glVertexAttribPointer(attri_normals_, 3, GL_FLOAT, GL_FALSE, 0,
-                        normals_.data());
-
-  glEnableVertexAttribArray(attri_uvs_);
-  glVertexAttribPointer(attri_uvs_, 2, GL_FLOAT, GL_FALSE, 0, uvs_.data());
-
-  glDrawElements(GL_TRIANGLES, indices_.size(), GL_UNSIGNED_SHORT,
-                 indices_.data());
-
-  glDisableVertexAttribArray(attri_vertices_);
-  glDisableVertexAttribArray(attri_uvs_);
-  glDisableVertexAttribArray(attri_normals_);
+  // The geometry lives in GPU buffers recorded into the vertex array object,
+  // so nothing is uploaded here.
+  glBindVertexArray(vertex_array_);
+  glDrawElements(GL_TRIANGLES, index_count_, GL_UNSIGNED_SHORT, nullptr);
+  glBindVertexArray(0);
 
   glUseProgram(0);
   util::CheckGlError("obj_renderer::Draw()");
@@ -16,8 +16,10 @@
 
 #ifndef C_ARCORE_AUGMENTED_IMAGE_OBJ_RENDERER_
 #define C_ARCORE_AUGMENTED_IMAGE_OBJ_RENDERER_
-#include <GLES2/gl2.h>
+// clang-format off
+#include <GLES3/gl3.h>
 #include <GLES2/gl2ext.h>
+// clang-format on
 #include <android/asset_manager.h>
 #include <cstdint>
 #include <cstdlib>
@@ -36,7 +38,9 @@ class ObjRenderer {
   ~ObjRenderer() = default;
 
   // Loads the OBJ file and texture and sets up OpenGL resources used to draw
-  // the model.  Must be called on the OpenGL thread prior to any other calls.
+  // the model.  The mesh is uploaded once into an interleaved vertex buffer
+  // and an index buffer, which are recorded into a vertex array object.  Must
+  // be called on the OpenGL thread prior to any other calls.
   void InitializeGlContent(AAssetManager* asset_manager,
                            const std::string& obj_file_name,
                            const std::string& png_file_name);
@@ -62,13 +66,12 @@ class ObjRenderer {
   float specular_ = 0.5f;
   float specular_power_ = 6.0f;
 
-  // Model attribute arrays
-  std::vector<GLfloat> vertices_;
-  std::vector<GLfloat> uvs_;
-  std::vector<GLfloat> normals_;
-
-  // Model triangle indices
-  std::vector<GLushort> indices_;
+  // GPU-resident model geometry.  The vertex buffer holds interleaved
+  // position (3), normal (3) and uv (2) floats for each vertex.
+  GLuint vertex_array_ = 0;
+  GLuint vertex_buffer_ = 0;
+  GLuint index_buffer_ = 0;
+  GLsizei index_count_ = 0;
 
   // Loaded TEXTURE_2D object name
   GLuint texture_id_;
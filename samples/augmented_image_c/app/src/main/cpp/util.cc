@@ -16,7 +16,18 @@
 #include "util.h"
 
 #include <android/bitmap.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
 #include <sstream>
 #include <string>
 
@@ -217,6 +228,76 @@ bool LoadFileFromAssetManager(AAssetManager* mgr, const char* file_name,
   return true;
 }
 
+AssetBuffer::~AssetBuffer() {
+  if (asset_ != nullptr) {
+    AAsset_close(asset_);
+  }
+}
+
+bool AssetBuffer::Open(AAssetManager* mgr, const char* file_name) {
+  asset_ = AAssetManager_open(mgr, file_name, AASSET_MODE_BUFFER);
+  if (asset_ == nullptr) {
+    LOGE("Error opening asset %s", file_name);
+    return false;
+  }
+  data_ = static_cast<const uint8_t*>(AAsset_getBuffer(asset_));
+  size_ = AAsset_getLength64(asset_);
+  if (data_ == nullptr) {
+    LOGE("Could not map asset %s", file_name);
+    return false;
+  }
+  if (AAsset_isAllocated(asset_)) {
+    LOGI("Asset %s is compressed and was copied into memory", file_name);
+  }
+  return true;
+}
+
+MappedFile::~MappedFile() {
+  if (data_ != nullptr) {
+    munmap(data_, size_);
+  }
+}
+
+bool MappedFile::Open(const std::string& path) {
+  const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || file_stat.st_size <= 0) {
+    close(fd);
+    return false;
+  }
+  void* data = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping keeps the file alive.
+  close(fd);
+  if (data == MAP_FAILED) {
+    LOGE("Could not map %s: %s", path.c_str(), strerror(errno));
+    return false;
+  }
+  data_ = data;
+  size_ = file_stat.st_size;
+  return true;
+}
+
+bool WriteFileAtomically(const std::string& path, const uint8_t* data,
+                         int64_t size) {
+  const std::string temp_path = path + ".tmp";
+  FILE* file = fopen(temp_path.c_str(), "wb");
+  if (file == nullptr) {
+    LOGE("Could not write %s: %s", temp_path.c_str(), strerror(errno));
+    return false;
+  }
+  bool write_ok =
+      fwrite(data, 1, size, file) == static_cast<size_t>(size);
+  write_ok = (fclose(file) == 0) && write_ok;
+  if (!write_ok || rename(temp_path.c_str(), path.c_str()) != 0) {
+    unlink(temp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
 bool HideFitToScanImage(void* activity) {
   jobject activity_obj = static_cast<jobject>(activity);
   CallJavaHideFitToScanImage(activity_obj);
@@ -233,36 +314,59 @@ bool LoadPngFromAssetManager(int target, const std::string& path) {
   return true;
 }
 
-bool LoadImageFromAssetManager(const std::string& path, int* out_width,
-                               int* out_height, int* out_stride,
-                               uint8_t** out_pixel_buffer) {
-  JNIEnv* env = GetJniEnv();
-  jstring j_path = env->NewStringUTF(path.c_str());
-  jobject image_obj = CallJavaLoadImage(j_path);
-  env->DeleteLocalRef(j_path);
+ScopedAssetBitmap::~ScopedAssetBitmap() {
+  if (pixels_ != nullptr) {
+    AndroidBitmap_unlockPixels(env_, bitmap_);
+  }
+  if (bitmap_ != nullptr) {
+    // Native threads have no local frame that would release it.
+    env_->DeleteLocalRef(bitmap_);
+  }
+}
 
-  // image_obj contains a Bitmap Java object.
-  AndroidBitmapInfo bitmap_info;
-  AndroidBitmap_getInfo(env, image_obj, &bitmap_info);
+bool ScopedAssetBitmap::Open(const std::string& path) {
+  env_ = GetJniEnv();
+  jstring j_path = env_->NewStringUTF(path.c_str());
+  bitmap_ = CallJavaLoadImage(j_path);
+  env_->DeleteLocalRef(j_path);
+  if (bitmap_ == nullptr) {
+    LOGE("Failed to decode image %s", path.c_str());
+    return false;
+  }
 
   // Attention: We are only going to support RGBA_8888 format in this sample.
-  CHECK(bitmap_info.format == ANDROID_BITMAP_FORMAT_RGBA_8888);
-
-  *out_width = bitmap_info.width;
-  *out_height = bitmap_info.height;
-  *out_stride = bitmap_info.stride;
+  if (AndroidBitmap_getInfo(env_, bitmap_, &info_) !=
+          ANDROID_BITMAP_RESULT_SUCCESS ||
+      info_.format != ANDROID_BITMAP_FORMAT_RGBA_8888) {
+    LOGE("Image %s is not in RGBA_8888 format", path.c_str());
+    return false;
+  }
   void* jvm_buffer = nullptr;
-  CHECK(AndroidBitmap_lockPixels(env, image_obj, &jvm_buffer) ==
-        ANDROID_BITMAP_RESULT_SUCCESS);
+  if (AndroidBitmap_lockPixels(env_, bitmap_, &jvm_buffer) !=
+      ANDROID_BITMAP_RESULT_SUCCESS) {
+    LOGE("Failed to lock the pixels of image %s", path.c_str());
+    return false;
+  }
+  pixels_ = static_cast<const uint8_t*>(jvm_buffer);
+  return true;
+}
 
-  // Copy jvm_buffer_address to pixel_buffer_address
-  int32_t total_size_in_byte = bitmap_info.stride * bitmap_info.width;
-  *out_pixel_buffer = new uint8_t[total_size_in_byte];
-  memcpy(*out_pixel_buffer, jvm_buffer, total_size_in_byte);
+bool LoadImageFromAssetManager(const std::string& path, int* out_width,
+                               int* out_height, int* out_stride,
+                               uint8_t** out_pixel_buffer) {
+  ScopedAssetBitmap bitmap;
+  if (!bitmap.Open(path)) {
+    return false;
+  }
+  *out_width = bitmap.GetWidth();
+  *out_height = bitmap.GetHeight();
+  *out_stride = bitmap.GetStride();
 
-  // release jvm_buffer back to JVM
-  CHECK(AndroidBitmap_unlockPixels(env, image_obj) ==
-        ANDROID_BITMAP_RESULT_SUCCESS);
+  // Copy the locked pixels, which go back to the JVM with the bitmap.
+  const size_t total_size_in_byte =
+      static_cast<size_t>(bitmap.GetStride()) * bitmap.GetHeight();
+  *out_pixel_buffer = new uint8_t[total_size_in_byte];
+  memcpy(*out_pixel_buffer, bitmap.GetPixels(), total_size_in_byte);
   return true;
 }
 
@@ -453,6 +557,24 @@ bool LoadObjFile(AAssetManager* mgr, const std::string& file_name,
   return true;
 }
 
+glm::mat4 MultiplyMatrices(const glm::mat4& a, const glm::mat4& b) {
+  return glm::mat4(glm::aligned_mat4(a) * glm::aligned_mat4(b));
+}
+
+glm::mat4 MultiplyMatrices(const glm::mat4& a, const glm::mat4& b,
+                           const glm::mat4& c) {
+  return glm::mat4(glm::aligned_mat4(a) * glm::aligned_mat4(b) *
+                   glm::aligned_mat4(c));
+}
+
+glm::mat4 InvertMatrix(const glm::mat4& matrix) {
+  return glm::mat4(glm::inverse(glm::aligned_mat4(matrix)));
+}
+
+glm::vec4 NormalizeVector(const glm::vec4& vector) {
+  return glm::vec4(glm::normalize(glm::aligned_vec4(vector)));
+}
+
 void Log4x4Matrix(float raw_matrix[16]) {
   LOGI(
       "%f, %f, %f, %f\n"
@@ -478,22 +600,157 @@ void GetTransformMatrixFromAnchor(const ArSession* ar_session,
                    glm::value_ptr(*out_model_mat));
 }
 
+namespace {
+// Luma weights in 1/256, summing up to 256 so that white stays 255.
+constexpr uint8_t kLumaWeightR = 55;
+constexpr uint8_t kLumaWeightG = 183;
+constexpr uint8_t kLumaWeightB = 18;
+
+inline uint8_t RgbaToLuma(const uint8_t* pixel) {
+  return static_cast<uint8_t>((kLumaWeightR * pixel[0] +
+                               kLumaWeightG * pixel[1] +
+                               kLumaWeightB * pixel[2] + 128) >>
+                              8);
+}
+
+#if defined(__ARM_NEON)
+constexpr int32_t kNeonPixelsPerIteration = 16;
+
+// Luma of the 16 RGBA pixels at |pixels|, rounded like RgbaToLuma().
+inline uint8x16_t RgbaToLuma16(const uint8_t* pixels) {
+  const uint8x16x4_t rgba = vld4q_u8(pixels);
+  const uint8x8_t weight_r = vdup_n_u8(kLumaWeightR);
+  const uint8x8_t weight_g = vdup_n_u8(kLumaWeightG);
+  const uint8x8_t weight_b = vdup_n_u8(kLumaWeightB);
+  uint16x8_t low = vmull_u8(vget_low_u8(rgba.val[0]), weight_r);
+  low = vmlal_u8(low, vget_low_u8(rgba.val[1]), weight_g);
+  low = vmlal_u8(low, vget_low_u8(rgba.val[2]), weight_b);
+  uint16x8_t high = vmull_u8(vget_high_u8(rgba.val[0]), weight_r);
+  high = vmlal_u8(high, vget_high_u8(rgba.val[1]), weight_g);
+  high = vmlal_u8(high, vget_high_u8(rgba.val[2]), weight_b);
+  return vcombine_u8(vrshrn_n_u16(low, 8), vrshrn_n_u16(high, 8));
+}
+#endif  // __ARM_NEON
+
+// Converts the output columns [x, out_width) of one output row.
+void ConvertRowScalar(const uint8_t* input_row, int32_t stride, int32_t scale,
+                      int32_t x, int32_t out_width, uint8_t* output_row) {
+  const int32_t block_size = scale * scale;
+  for (; x < out_width; ++x) {
+    int32_t sum = 0;
+    for (int32_t j = 0; j < scale; ++j) {
+      const uint8_t* pixel = input_row + j * stride + x * scale * 4;
+      for (int32_t i = 0; i < scale; ++i) {
+        sum += RgbaToLuma(pixel + i * 4);
+      }
+    }
+    output_row[x] = static_cast<uint8_t>((sum + block_size / 2) / block_size);
+  }
+}
+}  // namespace
+
+int32_t GetGrayscaleScale(int32_t width, int32_t height,
+                          int32_t max_dimension) {
+  const int32_t dimension = std::max(width, height);
+  return std::max(1, (dimension + max_dimension - 1) / max_dimension);
+}
+
 void ConvertRgbaToGrayscale(const uint8_t* image_pixel_buffer, int32_t width,
-                            int32_t height, int32_t stride,
-                            uint8_t** out_grayscale_buffer) {
-  int32_t grayscale_stride = stride / 4;  // Only support RGBA_8888 format
-  uint8_t* grayscale_buffer = new uint8_t[grayscale_stride * height];
-  for (int h = 0; h < height; ++h) {
-    for (int w = 0; w < width; ++w) {
-      const uint8_t* pixel = &image_pixel_buffer[w * 4 + h * stride];
-      uint8_t r = *pixel;
-      uint8_t g = *(pixel + 1);
-      uint8_t b = *(pixel + 2);
-      grayscale_buffer[w + h * grayscale_stride] =
-          static_cast<uint8_t>(0.213f * r + 0.715 * g + 0.072 * b);
+                            int32_t height, int32_t stride, int32_t scale,
+                            uint8_t* out_grayscale_buffer,
+                            int32_t out_stride) {
+  const int32_t out_width = width / scale;
+  const int32_t out_height = height / scale;
+  for (int32_t y = 0; y < out_height; ++y) {
+    const uint8_t* input_row = image_pixel_buffer + y * scale * stride;
+    uint8_t* output_row = out_grayscale_buffer + y * out_stride;
+    int32_t x = 0;
+#if defined(__ARM_NEON)
+    if (scale == 1) {
+      for (; x + kNeonPixelsPerIteration <= out_width;
+           x += kNeonPixelsPerIteration) {
+        vst1q_u8(output_row + x, RgbaToLuma16(input_row + x * 4));
+      }
+    } else if (scale == 2) {
+      // Averages the luma of 2x2 blocks, 8 output pixels at a time.
+      constexpr int32_t kOutputPixels = kNeonPixelsPerIteration / 2;
+      for (; x + kOutputPixels <= out_width; x += kOutputPixels) {
+        const uint16x8_t sum =
+            vaddq_u16(vpaddlq_u8(RgbaToLuma16(input_row + x * 8)),
+                      vpaddlq_u8(RgbaToLuma16(input_row + stride + x * 8)));
+        vst1_u8(output_row + x, vrshrn_n_u16(sum, 2));
+      }
     }
+#endif  // __ARM_NEON
+    ConvertRowScalar(input_row, stride, scale, x, out_width, output_row);
+  }
+}
+
+namespace {
+// Positions of the quad vertices in clip space (X, Y).
+constexpr GLfloat kScreenQuadPositions[] = {
+    -1.0f, -1.0f, +1.0f, -1.0f, -1.0f, +1.0f, +1.0f, +1.0f,
+};
+constexpr GLsizeiptr kScreenQuadUvSetSize =
+    ScreenQuad::kNumUvComponents * sizeof(GLfloat);
+}  // namespace
+
+void ScreenQuad::InitializeGlContent(int uv_set_count) {
+  CHECK(uv_set_count >= 0 && uv_set_count <= kMaxUvSets);
+  static_assert(sizeof(kScreenQuadPositions) == kScreenQuadUvSetSize,
+                "Positions and texture coordinates must have the same size");
+  uv_set_count_ = uv_set_count;
+  for (auto& uvs : uvs_) {
+    std::fill(std::begin(uvs), std::end(uvs), 0.0f);
   }
-  *out_grayscale_buffer = grayscale_buffer;
+
+  // The positions never change; the texture coordinates start out zeroed and
+  // are filled in by SetUvs().
+  glGenBuffers(1, &vertex_buffer_);
+  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+  glBufferData(GL_ARRAY_BUFFER, (1 + uv_set_count) * kScreenQuadUvSetSize,
+               nullptr, GL_STATIC_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(kScreenQuadPositions),
+                  kScreenQuadPositions);
+  for (int i = 0; i < uv_set_count; ++i) {
+    glBufferSubData(GL_ARRAY_BUFFER, (1 + i) * kScreenQuadUvSetSize,
+                    kScreenQuadUvSetSize, uvs_[i]);
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void ScreenQuad::TransformCorners(const ArSession* session,
+                                  const ArFrame* frame,
+                                  ArCoordinates2dType uv_type,
+                                  float* out_uvs) {
+  ArFrame_transformCoordinates2d(
+      session, frame, AR_COORDINATES_2D_OPENGL_NORMALIZED_DEVICE_COORDINATES,
+      kNumVertices, kScreenQuadPositions, uv_type, out_uvs);
+}
+
+void ScreenQuad::SetUvs(int uv_set, const float* uvs) {
+  if (uv_set < 0 || uv_set >= uv_set_count_ ||
+      std::equal(uvs, uvs + kNumUvComponents, uvs_[uv_set])) {
+    return;
+  }
+  std::copy(uvs, uvs + kNumUvComponents, uvs_[uv_set]);
+  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+  glBufferSubData(GL_ARRAY_BUFFER, (1 + uv_set) * kScreenQuadUvSetSize,
+                  kScreenQuadUvSetSize, uvs);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void ScreenQuad::Draw(GLuint position_attrib, const GLuint* uv_attribs) const {
+  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+  glVertexAttribPointer(position_attrib, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+  for (int i = 0; i < uv_set_count_; ++i) {
+    glVertexAttribPointer(
+        uv_attribs[i], 2, GL_FLOAT, GL_FALSE, 0,
+        reinterpret_cast<const void*>((1 + i) * kScreenQuadUvSetSize));
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  glDrawArrays(GL_TRIANGLE_STRIP, 0, kNumVertices);
 }
 
 }  // namespace util
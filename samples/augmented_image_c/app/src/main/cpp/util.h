@@ -20,11 +20,13 @@
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
 #include <android/asset_manager.h>
+#include <android/bitmap.h>
 #include <android/log.h>
 #include <errno.h>
 #include <jni.h>
 #include <cstdint>
 #include <cstdlib>
+#include <string>
 #include <vector>
 
 #include "arcore_c_api.h"
@@ -115,6 +117,62 @@ GLuint CreateProgram(AAssetManager* mgr, const char* vertex_shader_file_name,
 bool LoadFileFromAssetManager(AAssetManager* mgr, const char* file_name,
                               std::string* out_file_text_string);
 
+// The contents of an asset, read in place with AAsset_getBuffer.  Assets
+// stored uncompressed in the APK are memory mapped, so their bytes are never
+// copied; compressed ones are decompressed into a single buffer owned by the
+// asset.  The data stays valid until the AssetBuffer is destroyed.
+class AssetBuffer {
+ public:
+  AssetBuffer() = default;
+  ~AssetBuffer();
+  AssetBuffer(const AssetBuffer&) = delete;
+  AssetBuffer& operator=(const AssetBuffer&) = delete;
+
+  // Opens the asset.
+  //
+  // @param mgr, AAssetManager pointer.
+  // @param file_name, path to the file, relative to the assets folder.
+  // @return true if the contents are available, otherwise false.
+  bool Open(AAssetManager* mgr, const char* file_name);
+
+  const uint8_t* GetData() const { return data_; }
+  int64_t GetSize() const { return size_; }
+
+ private:
+  AAsset* asset_ = nullptr;
+  const uint8_t* data_ = nullptr;
+  int64_t size_ = 0;
+};
+
+// The contents of a file in app storage, mapped read-only into memory like
+// AssetBuffer maps an asset.
+class MappedFile {
+ public:
+  MappedFile() = default;
+  ~MappedFile();
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  // Maps the file at |path|.
+  //
+  // @return true if the contents are available, otherwise false.
+  bool Open(const std::string& path);
+
+  const uint8_t* GetData() const { return static_cast<const uint8_t*>(data_); }
+  int64_t GetSize() const { return size_; }
+
+ private:
+  void* data_ = nullptr;
+  int64_t size_ = 0;
+};
+
+// Writes |size| bytes to |path| through a temporary file, so that a crash
+// never leaves a truncated file under the final name.
+//
+// @return true if the file is written, otherwise false.
+bool WriteFileAtomically(const std::string& path, const uint8_t* data,
+                         int64_t size);
+
 // Loads png file from assets folder and then assign it to the OpenGL target.
 // This method must be called from the renderer thread since it will result in
 // OpenGL calls to assign the image to the texture target.
@@ -124,6 +182,35 @@ bool LoadFileFromAssetManager(AAssetManager* mgr, const char* file_name,
 // @return true if png is loaded correctly, otherwise false.
 bool LoadPngFromAssetManager(int target, const std::string& path);
 
+// An image file from assets folder decoded by BitmapFactory.decodeStream,
+// whose pixels stay locked for reading until it is destroyed.  Holds a JNI
+// local reference, so it must be destroyed on the thread that opened it.
+class ScopedAssetBitmap {
+ public:
+  ScopedAssetBitmap() = default;
+  ~ScopedAssetBitmap();
+  ScopedAssetBitmap(const ScopedAssetBitmap&) = delete;
+  ScopedAssetBitmap& operator=(const ScopedAssetBitmap&) = delete;
+
+  // Decodes and locks the image.
+  //
+  // @param path, file path in asset directory.
+  // @return true if the image is decoded as RGBA_8888, otherwise false.
+  bool Open(const std::string& path);
+
+  const uint8_t* GetPixels() const { return pixels_; }
+  int32_t GetWidth() const { return info_.width; }
+  int32_t GetHeight() const { return info_.height; }
+  // Bytes per line.
+  int32_t GetStride() const { return info_.stride; }
+
+ private:
+  JNIEnv* env_ = nullptr;
+  jobject bitmap_ = nullptr;
+  AndroidBitmapInfo info_ = {};
+  const uint8_t* pixels_ = nullptr;
+};
+
 // Loads image file from assets folder, then return raw pixel content.
 // Support any images (png, jpg, etc) supported by BitmapFactory.decodeStream.
 //
@@ -161,6 +248,16 @@ bool LoadObjFile(AAssetManager* mgr, const std::string& file_name,
                  std::vector<GLfloat>* out_uv,
                  std::vector<GLushort>* out_indices);
 
+// Matrix math through glm's aligned types, which GLM implements with NEON
+// (SSE on x86) intrinsics.  glm::mat4 and glm::vec4 stay packed so vertex
+// layouts do not change, which keeps their operators scalar; use these on the
+// per-draw and per-frame paths instead.
+glm::mat4 MultiplyMatrices(const glm::mat4& a, const glm::mat4& b);
+glm::mat4 MultiplyMatrices(const glm::mat4& a, const glm::mat4& b,
+                           const glm::mat4& c);
+glm::mat4 InvertMatrix(const glm::mat4& matrix);
+glm::vec4 NormalizeVector(const glm::vec4& vector);
+
 // Formats and outputs the matrix to logcat file.
 // Note that this function output matrix in row major.
 void Log4x4Matrix(float raw_matrix[16]);
@@ -170,6 +267,10 @@ void GetTransformMatrixFromAnchor(const ArSession* ar_session,
                                   const ArAnchor* ar_anchor,
                                   glm::mat4* out_model_mat);
 
+// Returns the smallest integer factor that scales a |width| x |height| image
+// down to at most |max_dimension| pixels on either side.
+int32_t GetGrayscaleScale(int32_t width, int32_t height, int32_t max_dimension);
+
 // Converts image to grayscale.
 // The AugmentedImage API takes a grayscale image as input,
 // so we need to manually convert the image to grayscale
@@ -177,15 +278,61 @@ void GetTransformMatrixFromAnchor(const ArSession* ar_session,
 // with luma = 0.213 * R + 0.715 * G + 0.072 * B
 // ref: https://en.wikipedia.org/wiki/Grayscale
 //
+// The weights are applied in 8 bit fixed point, with NEON on 16 pixels at a
+// time where available.  The image is scaled down in the same pass by
+// averaging blocks of |scale| x |scale| pixels.
+//
 // @param image_pixel_buffer image raw pixel data, must be RGBA_8888 format.
 // @param width, the image width.
 // @param height, the image height
 // @param stride, the image size in bytes per line.
-// @param out_grayscale_buffer, the output image buffer in grayscale; it is
-// the caller's responsibility to release the memory using delete[].
+// @param scale, the downscale factor, e.g. from GetGrayscaleScale().
+// @param out_grayscale_buffer, the output image buffer of width / scale x
+// height / scale pixels, allocated by the caller.
+// @param out_stride, the output image size in bytes per line.
 void ConvertRgbaToGrayscale(const uint8_t* image_pixel_buffer, int32_t width,
-                            int32_t height, int32_t stride,
-                            uint8_t** out_grayscale_buffer);
+                            int32_t height, int32_t stride, int32_t scale,
+                            uint8_t* out_grayscale_buffer, int32_t out_stride);
+
+// Fullscreen quad drawn as a triangle strip from a static vertex buffer.  The
+// buffer holds the clip space corner positions followed by up to kMaxUvSets
+// sets of corner texture coordinates, which are only re-uploaded when they
+// change, e.g. after a display geometry change.
+class ScreenQuad {
+ public:
+  static constexpr int kNumVertices = 4;
+  // Number of floats in one set of corner texture coordinates.
+  static constexpr int kNumUvComponents = kNumVertices * 2;
+  static constexpr int kMaxUvSets = 2;
+
+  ScreenQuad() = default;
+
+  ScreenQuad(const ScreenQuad&) = delete;
+  ScreenQuad& operator=(const ScreenQuad&) = delete;
+
+  // Creates the vertex buffer with |uv_set_count| texture coordinate sets.
+  // Must be called on the OpenGL thread before any other method.
+  void InitializeGlContent(int uv_set_count);
+
+  // Maps the quad corners to |uv_type| coordinates of |frame|, writing
+  // kNumUvComponents floats to |out_uvs|.
+  static void TransformCorners(const ArSession* session, const ArFrame* frame,
+                               ArCoordinates2dType uv_type, float* out_uvs);
+
+  // Uploads |uvs| as texture coordinate set |uv_set| unless the buffer already
+  // holds them.
+  void SetUvs(int uv_set, const float* uvs);
+
+  // Points |position_attrib| at the corner positions and |uv_attribs[i]| at
+  // texture coordinate set i, then draws the quad.  The attrib arrays must be
+  // enabled by the caller.
+  void Draw(GLuint position_attrib, const GLuint* uv_attribs) const;
+
+ private:
+  GLuint vertex_buffer_ = 0;
+  int uv_set_count_ = 0;
+  float uvs_[kMaxUvSets][kNumUvComponents] = {};
+};
 
 }  // namespace util
 }  // namespace augmented_image
@@ -30,6 +30,7 @@ import androidx.appcompat.app.AppCompatActivity;
 import com.bumptech.glide.Glide;
 import com.bumptech.glide.RequestManager;
 import com.google.android.material.snackbar.Snackbar;
+import java.io.File;
 import javax.microedition.khronos.egl.EGLConfig;
 import javax.microedition.khronos.opengles.GL10;
 
@@ -47,6 +48,18 @@ public class AugmentedImageActivity extends AppCompatActivity
     implements GLSurfaceView.Renderer, DisplayManager.DisplayListener {
   private static final String TAG = AugmentedImageActivity.class.getSimpleName();
 
+  /**
+   * Intent extra with the URI of an MP4 dataset to benchmark. The results are written to
+   * playback_benchmark.csv in the app's external files directory, e.g. with {@code adb shell am
+   * start -n com.google.ar.core.examples.c.augmentedimage/.AugmentedImageActivity --es
+   * benchmark_dataset_uri file:///sdcard/dataset.mp4}.
+   */
+  public static final String EXTRA_BENCHMARK_DATASET_URI = "benchmark_dataset_uri";
+
+  private static final String BENCHMARK_CSV_FILE_NAME = "playback_benchmark.csv";
+
+  private boolean benchmarkRunning = false;
+
   private GLSurfaceView surfaceView;
   private ImageView fitToScanView;
   private RequestManager glideRequestManager;
@@ -67,14 +80,27 @@ public class AugmentedImageActivity extends AppCompatActivity
 
     // Set up renderer.
     surfaceView.setPreserveEGLContextOnPause(true);
-    surfaceView.setEGLContextClientVersion(2);
+    surfaceView.setEGLContextClientVersion(3);
     surfaceView.setEGLConfigChooser(8, 8, 8, 8, 16, 0); // Alpha used for plane blending.
     surfaceView.setRenderer(this);
     surfaceView.setRenderMode(GLSurfaceView.RENDERMODE_CONTINUOUSLY);
     surfaceView.setWillNotDraw(false);
 
     JniInterface.assetManager = getAssets();
-    nativeApplication = JniInterface.createNativeApplication(getAssets());
+    nativeApplication =
+        JniInterface.createNativeApplication(
+            getAssets(), getCacheDir().getAbsolutePath());
+
+    String benchmarkDatasetUri = getIntent().getStringExtra(EXTRA_BENCHMARK_DATASET_URI);
+    if (benchmarkDatasetUri != null) {
+      File csvFile = new File(getExternalFilesDir(null), BENCHMARK_CSV_FILE_NAME);
+      benchmarkRunning =
+          JniInterface.startPlaybackBenchmark(
+              nativeApplication, benchmarkDatasetUri, csvFile.getAbsolutePath());
+      if (!benchmarkRunning) {
+        Log.e(TAG, "Could not start the playback benchmark");
+      }
+    }
 
     fitToScanView = findViewById(R.id.image_view_fit_to_scan);
     glideRequestManager = Glide.with(this);
@@ -114,6 +140,8 @@ public class AugmentedImageActivity extends AppCompatActivity
     super.onPause();
     surfaceView.onPause();
     JniInterface.onPause(nativeApplication);
+    Log.i(TAG, "Image detection latencies:\n"
+        + JniInterface.getDetectionLatencyReport(nativeApplication));
 
     getSystemService(DisplayManager.class).unregisterDisplayListener(this);
   }
@@ -174,6 +202,11 @@ public class AugmentedImageActivity extends AppCompatActivity
         viewportChanged = false;
       }
       JniInterface.onGlSurfaceDrawFrame(nativeApplication, this);
+      if (benchmarkRunning && JniInterface.isPlaybackBenchmarkFinished(nativeApplication)) {
+        benchmarkRunning = false;
+        Log.i(TAG, "Playback benchmark finished");
+        runOnUiThread(this::finish);
+      }
     }
   }
 
@@ -33,7 +33,12 @@ public class JniInterface {
   private static final String TAG = "JniInterface";
   static AssetManager assetManager;
 
-  public static native long createNativeApplication(AssetManager assetManager);
+  /**
+   * Creates the native application. Image databases built at runtime are cached in {@code
+   * imageDatabaseCacheDirectory}.
+   */
+  public static native long createNativeApplication(
+      AssetManager assetManager, String imageDatabaseCacheDirectory);
 
   public static native void destroyNativeApplication(long nativeApplication);
 
@@ -55,6 +60,30 @@ public class JniInterface {
   public static native void onGlSurfaceDrawFrame(
       long nativeApplication, AugmentedImageActivity activity);
 
+  /**
+   * Switches to the image database shard for a context such as a venue, read from the asset
+   * image_databases/&lt;contextKey&gt;.imgdb. Images already found stay anchored. An empty key
+   * returns to the database the app started with.
+   */
+  public static native void selectImageDatabaseShard(long nativeApplication, String contextKey);
+
+  /**
+   * Returns one line per database shard applied so far with the number of images detected,
+   * tracked and lost, and histograms of the detection, tracking and recovery latencies.
+   */
+  public static native String getDetectionLatencyReport(long nativeApplication);
+
+  /**
+   * Plays back an MP4 dataset instead of the live camera and writes per-frame timings to a CSV
+   * file. Must be called before the first onResume. Returns false if the CSV file cannot be
+   * created.
+   */
+  public static native boolean startPlaybackBenchmark(
+      long nativeApplication, String datasetUri, String csvPath);
+
+  /** Returns true once the playback benchmark reached the end of the dataset. */
+  public static native boolean isPlaybackBenchmarkFinished(long nativeApplication);
+
   public static Bitmap loadImage(String imageName) {
 
     try {
@@ -26,6 +26,7 @@ void main() {
   if (v_TexCoord.x < s_SplitterPosition) {
     gl_FragColor = texture2D(TexVideo, v_TexCoord);
   } else {
-    gl_FragColor= texture2D(TexCpuImageGrayscale, v_ImgCoord);
+    // The overlay is a luminance texture or an R8 hardware buffer.
+    gl_FragColor = vec4(texture2D(TexCpuImageGrayscale, v_ImgCoord).rrr, 1.0);
   }
 }
@@ -0,0 +1,98 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "allocation_tracker.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace computer_vision {
+namespace {
+// Trivial thread locals, so reading them in operator new never allocates.
+thread_local bool thread_enabled = false;
+thread_local int64_t thread_count = 0;
+}  // namespace
+
+bool AllocationTracker::IsAvailable() {
+#ifndef NDEBUG
+  return true;
+#else
+  return false;
+#endif
+}
+
+void AllocationTracker::EnableForThread() {
+  thread_enabled = true;
+  thread_count = 0;
+}
+
+int64_t AllocationTracker::TakeThreadCount() {
+  const int64_t count = thread_count;
+  thread_count = 0;
+  return count;
+}
+
+#ifndef NDEBUG
+namespace {
+void* CountedAllocate(size_t size) {
+  if (thread_enabled) {
+    ++thread_count;
+  }
+  return std::malloc(size == 0 ? 1 : size);
+}
+}  // namespace
+#endif  // NDEBUG
+
+}  // namespace computer_vision
+
+#ifndef NDEBUG
+// The replacements keep the default behavior of allocating with malloc().
+void* operator new(size_t size) {
+  void* pointer = computer_vision::CountedAllocate(size);
+  if (pointer == nullptr) {
+    std::abort();
+  }
+  return pointer;
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return computer_vision::CountedAllocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return computer_vision::CountedAllocate(size);
+}
+
+void operator delete(void* pointer) noexcept { std::free(pointer); }
+
+void operator delete[](void* pointer) noexcept { std::free(pointer); }
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+  std::free(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+  std::free(pointer);
+}
+
+#if defined(__cpp_sized_deallocation)
+void operator delete(void* pointer, size_t) noexcept { std::free(pointer); }
+
+void operator delete[](void* pointer, size_t) noexcept { std::free(pointer); }
+#endif  // __cpp_sized_deallocation
+#endif  // NDEBUG
@@ -0,0 +1,46 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_COMPUTER_VISION_ALLOCATION_TRACKER_H_
+#define C_ARCORE_COMPUTER_VISION_ALLOCATION_TRACKER_H_
+
+#include <cstdint>
+
+namespace computer_vision {
+
+// Counts the heap allocations of the threads that asked for it, so a frame
+// loop that is meant to be allocation free reports the frames that are not.
+//
+// Debug builds replace the global operator new, which every container,
+// string and stream of the sample allocates through; release builds count
+// nothing.  Allocations ARCore, the driver or the JVM make with their own
+// allocators are not seen.
+class AllocationTracker {
+ public:
+  // Whether allocations are counted in this build.
+  static bool IsAvailable();
+
+  // Starts counting the allocations of the calling thread.
+  static void EnableForThread();
+
+  // Returns the allocations of the calling thread since the previous call,
+  // and restarts the count.
+  static int64_t TakeThreadCount();
+};
+
+}  // namespace computer_vision
+
+#endif  // C_ARCORE_COMPUTER_VISION_ALLOCATION_TRACKER_H_
@@ -0,0 +1,91 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "camera_config_governor.h"
+
+#include <algorithm>
+
+namespace computer_vision {
+namespace {
+// Stepping up needs the predicted processing time to stay this far below the
+// budget, which keeps the governor from oscillating between two levels.
+constexpr float kStepUpHeadroom = 0.25f;
+// Frames may take this much longer than the config's frame period before the
+// governor steps down, absorbing the jitter of the display and camera clocks.
+constexpr float kFrameOverrunFactor = 1.25f;
+constexpr int kPercentile = 90;
+}  // namespace
+
+constexpr int CameraConfigGovernor::kWindowSize;
+constexpr int CameraConfigGovernor::kNoChange;
+
+void CameraConfigGovernor::Reset(const std::vector<Level>& levels,
+                                 int current_level, float budget_ms) {
+  levels_ = levels;
+  budget_ms_ = budget_ms;
+  processing_samples_ms_.reserve(kWindowSize);
+  SwitchTo(current_level);
+}
+
+int CameraConfigGovernor::OnFrame(float processing_ms, float frame_ms) {
+  if (levels_.empty()) {
+    return kNoChange;
+  }
+  processing_samples_ms_.push_back(processing_ms);
+  frame_time_sum_ms_ += frame_ms;
+  if (static_cast<int>(processing_samples_ms_.size()) < kWindowSize) {
+    return kNoChange;
+  }
+
+  const size_t index = (kWindowSize - 1) * kPercentile / 100;
+  std::nth_element(processing_samples_ms_.begin(),
+                   processing_samples_ms_.begin() + index,
+                   processing_samples_ms_.end());
+  const float processing_p90_ms = processing_samples_ms_[index];
+  const float frame_average_ms = frame_time_sum_ms_ / kWindowSize;
+  const Level& level = levels_[current_level_];
+
+  if (current_level_ > 0 &&
+      (processing_p90_ms > budget_ms_ ||
+       frame_average_ms > level.frame_period_ms * kFrameOverrunFactor)) {
+    return SwitchTo(current_level_ - 1);
+  }
+
+  if (current_level_ + 1 < static_cast<int>(levels_.size())) {
+    const Level& next = levels_[current_level_ + 1];
+    const float predicted_ms =
+        processing_p90_ms * next.relative_cost / level.relative_cost;
+    const float limit_ms = std::min(budget_ms_, next.frame_period_ms);
+    if (predicted_ms < limit_ms * (1.f - kStepUpHeadroom)) {
+      return SwitchTo(current_level_ + 1);
+    }
+  }
+
+  // Slide to a new window at the same level.
+  processing_samples_ms_.clear();
+  frame_time_sum_ms_ = 0.f;
+  return kNoChange;
+}
+
+int CameraConfigGovernor::SwitchTo(int level) {
+  current_level_ = std::max(
+      0, std::min(level, static_cast<int>(levels_.size()) - 1));
+  processing_samples_ms_.clear();
+  frame_time_sum_ms_ = 0.f;
+  return current_level_;
+}
+
+}  // namespace computer_vision
@@ -0,0 +1,74 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_COMPUTER_VISION_CAMERA_CONFIG_GOVERNOR_H_
+#define C_ARCORE_COMPUTER_VISION_CAMERA_CONFIG_GOVERNOR_H_
+
+#include <vector>
+
+namespace computer_vision {
+
+// Picks the camera config whose CPU image processing fits a time budget.
+//
+// The configs are levels sorted by increasing cost.  Every frame reports its
+// CPU processing time and its total frame time.  Once a full window of samples
+// has been collected at the current level, the governor steps down if the 90th
+// percentile of the processing time exceeds the budget or frames take longer
+// than the config's frame rate allows.  It steps up if the processing time
+// extrapolated to the next level stays below the budget minus a headroom.
+//
+// The samples are discarded after every switch, so a new config always gets a
+// full window to show its cost before the governor moves again.
+class CameraConfigGovernor {
+ public:
+  // Number of frames the decisions are based on.
+  static constexpr int kWindowSize = 90;
+  // Returned by OnFrame() if the current level should be kept.
+  static constexpr int kNoChange = -1;
+
+  struct Level {
+    // Processing cost relative to the other levels, e.g. the pixel count.
+    float relative_cost = 1.f;
+    // Frame period at the level's target frame rate.
+    float frame_period_ms = 0.f;
+  };
+
+  CameraConfigGovernor() = default;
+
+  // Starts governing |levels| from |current_level| with a CPU processing
+  // budget of |budget_ms| per frame.
+  void Reset(const std::vector<Level>& levels, int current_level,
+             float budget_ms);
+
+  // Records the timings of one frame and returns the level to switch to, or
+  // kNoChange.
+  int OnFrame(float processing_ms, float frame_ms);
+
+  int GetCurrentLevel() const { return current_level_; }
+
+ private:
+  int SwitchTo(int level);
+
+  std::vector<Level> levels_;
+  int current_level_ = 0;
+  float budget_ms_ = 0.f;
+  std::vector<float> processing_samples_ms_;
+  float frame_time_sum_ms_ = 0.f;
+};
+
+}  // namespace computer_vision
+
+#endif  // C_ARCORE_COMPUTER_VISION_CAMERA_CONFIG_GOVERNOR_H_
@@ -0,0 +1,198 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "camera_hardware_buffer.h"
+
+#include <dlfcn.h>
+
+#include "util.h"
+
+namespace computer_vision {
+namespace {
+// Load hardware buffer symbols at runtime.
+using PFeglGetNativeClientBufferANDROID =
+    EGLClientBuffer (*)(const AHardwareBuffer* buffer);
+using PFeglCreateImageKHR = EGLImageKHR (*)(EGLDisplay dpy, EGLContext ctx,
+                                            EGLenum target,
+                                            EGLClientBuffer buffer,
+                                            const EGLint* attrib_list);
+using PFeglDestroyImageKHR = EGLBoolean (*)(EGLDisplay dpy,
+                                            EGLImageKHR image);
+using PFglEGLImageTargetTexture2DOES = void (*)(GLenum target,
+                                                GLeglImageOES image);
+using PFAHardwareBuffer_describe = void (*)(const AHardwareBuffer* buffer,
+                                            AHardwareBuffer_Desc* out_desc);
+using PFAHardwareBuffer_lockPlanes =
+    int (*)(AHardwareBuffer* buffer, uint64_t usage, int32_t fence,
+            const ARect* rect, AHardwareBuffer_Planes* out_planes);
+using PFAHardwareBuffer_unlock = int (*)(AHardwareBuffer* buffer,
+                                         int32_t* fence);
+
+struct HardwareBufferFunctions {
+  PFeglGetNativeClientBufferANDROID get_native_client_buffer = nullptr;
+  PFeglCreateImageKHR create_image = nullptr;
+  PFeglDestroyImageKHR destroy_image = nullptr;
+  PFglEGLImageTargetTexture2DOES image_target_texture = nullptr;
+  PFAHardwareBuffer_describe describe = nullptr;
+  PFAHardwareBuffer_lockPlanes lock_planes = nullptr;
+  PFAHardwareBuffer_unlock unlock = nullptr;
+
+  bool IsComplete() const {
+    return get_native_client_buffer != nullptr && create_image != nullptr &&
+           destroy_image != nullptr && image_target_texture != nullptr &&
+           describe != nullptr && lock_planes != nullptr && unlock != nullptr;
+  }
+};
+
+HardwareBufferFunctions LoadFunctions() {
+  HardwareBufferFunctions functions;
+  functions.get_native_client_buffer =
+      reinterpret_cast<PFeglGetNativeClientBufferANDROID>(
+          eglGetProcAddress("eglGetNativeClientBufferANDROID"));
+  functions.create_image = reinterpret_cast<PFeglCreateImageKHR>(
+      eglGetProcAddress("eglCreateImageKHR"));
+  functions.destroy_image = reinterpret_cast<PFeglDestroyImageKHR>(
+      eglGetProcAddress("eglDestroyImageKHR"));
+  functions.image_target_texture =
+      reinterpret_cast<PFglEGLImageTargetTexture2DOES>(
+          eglGetProcAddress("glEGLImageTargetTexture2DOES"));
+
+  // libandroid is already loaded by the app, this only takes a reference.
+  void* libandroid = dlopen("libandroid.so", RTLD_NOW | RTLD_NOLOAD);
+  if (libandroid != nullptr) {
+    functions.describe = reinterpret_cast<PFAHardwareBuffer_describe>(
+        dlsym(libandroid, "AHardwareBuffer_describe"));
+    functions.lock_planes = reinterpret_cast<PFAHardwareBuffer_lockPlanes>(
+        dlsym(libandroid, "AHardwareBuffer_lockPlanes"));
+    functions.unlock = reinterpret_cast<PFAHardwareBuffer_unlock>(
+        dlsym(libandroid, "AHardwareBuffer_unlock"));
+  }
+  return functions;
+}
+
+const HardwareBufferFunctions& GetFunctions() {
+  static const HardwareBufferFunctions functions = LoadFunctions();
+  return functions;
+}
+}  // namespace
+
+CameraHardwareBuffer::~CameraHardwareBuffer() {
+  Unlock();
+  ReleaseImage();
+}
+
+bool CameraHardwareBuffer::IsSupported() { return GetFunctions().IsComplete(); }
+
+bool CameraHardwareBuffer::BindToTexture(AHardwareBuffer* buffer,
+                                         GLuint texture_id) {
+  if (buffer == nullptr || !IsSupported()) {
+    return false;
+  }
+  if (buffer == bound_buffer_ && texture_id == bound_texture_) {
+    return true;
+  }
+  ReleaseImage();
+
+  const HardwareBufferFunctions& functions = GetFunctions();
+  EGLClientBuffer native_buffer = functions.get_native_client_buffer(buffer);
+  if (native_buffer == nullptr) {
+    LOGE("CameraHardwareBuffer: eglGetNativeClientBufferANDROID failed");
+    return false;
+  }
+  display_ = eglGetCurrentDisplay();
+  const EGLint attributes[] = {EGL_IMAGE_PRESERVED_KHR, EGL_TRUE, EGL_NONE};
+  image_ = functions.create_image(display_, EGL_NO_CONTEXT,
+                                  EGL_NATIVE_BUFFER_ANDROID, native_buffer,
+                                  attributes);
+  if (image_ == EGL_NO_IMAGE_KHR) {
+    LOGE("CameraHardwareBuffer: eglCreateImageKHR failed: 0x%x",
+         eglGetError());
+    return false;
+  }
+
+  glBindTexture(GL_TEXTURE_EXTERNAL_OES, texture_id);
+  functions.image_target_texture(GL_TEXTURE_EXTERNAL_OES, image_);
+  glBindTexture(GL_TEXTURE_EXTERNAL_OES, 0);
+  util::CheckGlError("CameraHardwareBuffer::BindToTexture() error");
+
+  bound_buffer_ = buffer;
+  bound_texture_ = texture_id;
+  return true;
+}
+
+bool CameraHardwareBuffer::LockLuminancePlane(AHardwareBuffer* buffer,
+                                              CpuImagePlane* out_plane) {
+  CHECK(locked_buffer_ == nullptr);
+  if (buffer == nullptr || !IsSupported()) {
+    return false;
+  }
+
+  const HardwareBufferFunctions& functions = GetFunctions();
+  AHardwareBuffer_Desc desc;
+  functions.describe(buffer, &desc);
+  if ((desc.usage & AHARDWAREBUFFER_USAGE_CPU_READ_MASK) == 0) {
+    if (!logged_cpu_read_unavailable_) {
+      LOGI(
+          "CameraHardwareBuffer: camera buffers are not CPU readable, using "
+          "ArFrame_acquireCameraImage instead.");
+      logged_cpu_read_unavailable_ = true;
+    }
+    return false;
+  }
+
+  // No fence: ARCore only hands out buffers the camera finished writing.
+  AHardwareBuffer_Planes planes;
+  if (functions.lock_planes(buffer, AHARDWAREBUFFER_USAGE_CPU_READ_OFTEN,
+                            /*fence=*/-1, /*rect=*/nullptr, &planes) != 0) {
+    LOGW("CameraHardwareBuffer: AHardwareBuffer_lockPlanes failed.");
+    return false;
+  }
+  locked_buffer_ = buffer;
+
+  // The edge detector reads tightly packed luminance rows.
+  if (planes.planeCount < 1 || planes.planes[0].pixelStride != 1) {
+    LOGE("CameraHardwareBuffer: expected a YUV buffer with a packed Y plane.");
+    Unlock();
+    return false;
+  }
+
+  out_plane->pixels = static_cast<const uint8_t*>(planes.planes[0].data);
+  out_plane->width = desc.width;
+  out_plane->height = desc.height;
+  out_plane->stride = planes.planes[0].rowStride;
+  return true;
+}
+
+void CameraHardwareBuffer::Unlock() {
+  if (locked_buffer_ == nullptr) {
+    return;
+  }
+  if (GetFunctions().unlock(locked_buffer_, /*fence=*/nullptr) != 0) {
+    LOGE("CameraHardwareBuffer: AHardwareBuffer_unlock failed.");
+  }
+  locked_buffer_ = nullptr;
+}
+
+void CameraHardwareBuffer::ReleaseImage() {
+  if (image_ != EGL_NO_IMAGE_KHR) {
+    GetFunctions().destroy_image(display_, image_);
+    image_ = EGL_NO_IMAGE_KHR;
+  }
+  bound_buffer_ = nullptr;
+  bound_texture_ = 0;
+}
+
+}  // namespace computer_vision
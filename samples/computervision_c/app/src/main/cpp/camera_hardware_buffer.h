@@ -0,0 +1,82 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_COMPUTER_VISION_CAMERA_HARDWARE_BUFFER_H_
+#define C_ARCORE_COMPUTER_VISION_CAMERA_HARDWARE_BUFFER_H_
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#include <android/hardware_buffer.h>
+
+#include "cpu_image_renderer.h"
+
+namespace computer_vision {
+
+// Shares the AHardwareBuffer ARCore exposes in
+// AR_TEXTURE_UPDATE_MODE_EXPOSE_HARDWARE_BUFFER between the GPU and the CPU
+// consumers of a camera frame.
+//
+// The GPU side samples the buffer through an EGLImage bound to the camera
+// texture.  The CPU side locks the same buffer and reads its Y plane in place,
+// which saves ARCore the copy into an ArImage.  Locking only works if the
+// buffer was allocated with CPU read usage, which is up to the device; callers
+// fall back to ArFrame_acquireCameraImage when LockLuminancePlane() fails.
+//
+// The hardware buffer functions are resolved at runtime since the sample
+// supports devices older than API level 29.
+class CameraHardwareBuffer {
+ public:
+  CameraHardwareBuffer() = default;
+  ~CameraHardwareBuffer();
+
+  CameraHardwareBuffer(const CameraHardwareBuffer&) = delete;
+  CameraHardwareBuffer& operator=(const CameraHardwareBuffer&) = delete;
+
+  // Returns true if this device provides everything the hardware buffer path
+  // needs.
+  static bool IsSupported();
+
+  // Points the GL_TEXTURE_EXTERNAL_OES |texture_id| at |buffer|.  The image is
+  // only recreated when ARCore moves on to another buffer.  Must be called on
+  // the OpenGL thread.
+  bool BindToTexture(AHardwareBuffer* buffer, GLuint texture_id);
+
+  // Locks |buffer| for reading and returns its Y plane.  The plane stays valid
+  // until Unlock().  Returns false if the buffer cannot be read by the CPU.
+  bool LockLuminancePlane(AHardwareBuffer* buffer, CpuImagePlane* out_plane);
+
+  // Unlocks the buffer locked by LockLuminancePlane(), if any.
+  void Unlock();
+
+  // Destroys the EGLImage, e.g. when the camera is reconfigured or the GL
+  // context is recreated.
+  void ReleaseImage();
+
+ private:
+  EGLDisplay display_ = EGL_NO_DISPLAY;
+  EGLImageKHR image_ = EGL_NO_IMAGE_KHR;
+  AHardwareBuffer* bound_buffer_ = nullptr;
+  GLuint bound_texture_ = 0;
+
+  AHardwareBuffer* locked_buffer_ = nullptr;
+  bool logged_cpu_read_unavailable_ = false;
+};
+
+}  // namespace computer_vision
+
+#endif  // C_ARCORE_COMPUTER_VISION_CAMERA_HARDWARE_BUFFER_H_
@@ -0,0 +1,116 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "camera_image_metadata.h"
+
+#include <camera/NdkCameraMetadata.h>
+
+#include <algorithm>
+#include <iterator>
+
+namespace computer_vision {
+namespace {
+// Camera2 tags of CameraImageMetadata::Tag, in its order.
+constexpr uint32_t kTags[] = {
+    ACAMERA_SENSOR_EXPOSURE_TIME, ACAMERA_SENSOR_FRAME_DURATION,
+    ACAMERA_SENSOR_SENSITIVITY, ACAMERA_CONTROL_POST_RAW_SENSITIVITY_BOOST};
+
+// Sensitivity boost of an image without gain after the RAW image.
+constexpr int64_t kUnboostedSensitivity = 100;
+
+// The first element of |entry| as an integer of any width, or false.
+bool ReadInteger(const ArImageMetadata_const_entry& entry, int64_t* value) {
+  if (entry.count == 0) {
+    return false;
+  }
+  switch (entry.type) {
+    case ACAMERA_TYPE_INT32:
+      *value = entry.data.i32[0];
+      return true;
+    case ACAMERA_TYPE_INT64:
+      *value = entry.data.i64[0];
+      return true;
+    default:
+      return false;
+  }
+}
+}  // namespace
+
+void CameraImageMetadata::Reset() {
+  keys_resolved_ = false;
+  available_tags_ = 0;
+  timestamp_ns_ = -1;
+  std::fill(std::begin(values_), std::end(values_), 0);
+}
+
+bool CameraImageMetadata::Update(const ArSession* session,
+                                 const ArFrame* frame) {
+  int64_t timestamp_ns = 0;
+  ArFrame_getTimestamp(session, frame, &timestamp_ns);
+  if (timestamp_ns == timestamp_ns_) {
+    return true;
+  }
+  ArImageMetadata* metadata = nullptr;
+  if (ArFrame_acquireImageMetadata(session, frame, &metadata) != AR_SUCCESS) {
+    return false;
+  }
+  if (!keys_resolved_) {
+    ResolveKeys(session, metadata);
+  }
+  for (int i = 0; i < kNumTags; ++i) {
+    if ((available_tags_ & (1u << i)) == 0) {
+      continue;
+    }
+    ArImageMetadata_const_entry entry;
+    if (ArImageMetadata_getConstEntry(session, metadata, kTags[i], &entry) !=
+            AR_SUCCESS ||
+        !ReadInteger(entry, &values_[i])) {
+      values_[i] = 0;
+    }
+  }
+  ArImageMetadata_release(metadata);
+  timestamp_ns_ = timestamp_ns;
+  return true;
+}
+
+int32_t CameraImageMetadata::GetSensitivityIso() const {
+  const int64_t boost = (available_tags_ & (1u << kPostRawSensitivityBoost))
+                            ? values_[kPostRawSensitivityBoost]
+                            : kUnboostedSensitivity;
+  return static_cast<int32_t>(values_[kSensitivity] * boost /
+                              kUnboostedSensitivity);
+}
+
+void CameraImageMetadata::ResolveKeys(const ArSession* session,
+                                      const ArImageMetadata* metadata) {
+  static_assert(sizeof(kTags) / sizeof(kTags[0]) == kNumTags,
+                "kTags needs one entry per Tag");
+  int32_t num_keys = 0;
+  const uint32_t* keys = nullptr;
+  ArImageMetadata_getAllKeys(session, metadata, &num_keys, &keys);
+  ++key_scan_count_;
+  available_tags_ = 0;
+  for (int32_t k = 0; k < num_keys; ++k) {
+    for (int i = 0; i < kNumTags; ++i) {
+      if (keys[k] == kTags[i]) {
+        available_tags_ |= 1u << i;
+      }
+    }
+  }
+  keys_resolved_ = true;
+}
+
+}  // namespace computer_vision
@@ -0,0 +1,82 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_COMPUTER_VISION_CAMERA_IMAGE_METADATA_H_
+#define C_ARCORE_COMPUTER_VISION_CAMERA_IMAGE_METADATA_H_
+
+#include <cstdint>
+
+#include "arcore_c_api.h"
+
+namespace computer_vision {
+
+// The few capture results of the camera images the CPU kernels adapt to,
+// read from ArImageMetadata.
+//
+// Which tags a camera reports does not change while its config stays the
+// same, so the key list of ArImageMetadata_getAllKeys() is only scanned on
+// the first frame after Reset().  Later frames look up just the entries that
+// are known to be there, and a frame whose camera image was read already is
+// not looked at again.
+//
+// Not thread safe.
+class CameraImageMetadata {
+ public:
+  CameraImageMetadata() = default;
+
+  // Forgets the key set and the values, e.g. after the camera config changed.
+  void Reset();
+
+  // Reads the values of the camera image of |frame|.  Returns false and
+  // keeps the previous values if the frame has no metadata.
+  bool Update(const ArSession* session, const ArFrame* frame);
+
+  // Exposure time of the image, or 0 if unknown.
+  int64_t GetExposureTimeNs() const { return values_[kExposureTime]; }
+  // Time from the start of the image to the start of the next, or 0 if
+  // unknown.
+  int64_t GetFrameDurationNs() const { return values_[kFrameDuration]; }
+  // ISO sensitivity of the image including the gain applied after the RAW
+  // image, or 0 if unknown.
+  int32_t GetSensitivityIso() const;
+
+  // Number of key list scans since the object was created.
+  int GetKeyScanCount() const { return key_scan_count_; }
+
+ private:
+  // The tags read, indexing values_.
+  enum Tag {
+    kExposureTime = 0,
+    kFrameDuration,
+    kSensitivity,
+    kPostRawSensitivityBoost,
+    kNumTags
+  };
+
+  // Sets the bits of available_tags_ for the tags of |metadata|.
+  void ResolveKeys(const ArSession* session, const ArImageMetadata* metadata);
+
+  bool keys_resolved_ = false;
+  // Bit i is set if the camera reports tag i.
+  uint32_t available_tags_ = 0;
+  int64_t timestamp_ns_ = -1;
+  int64_t values_[kNumTags] = {};
+  int key_scan_count_ = 0;
+};
+
+}  // namespace computer_vision
+
+#endif  // C_ARCORE_COMPUTER_VISION_CAMERA_IMAGE_METADATA_H_
@@ -15,17 +15,85 @@
  */
 
 #include "computer_vision_application.h"
+#include <EGL/egl.h>
+#include <algorithm>
 #include <array>
 #include <cmath>
-#include <iomanip>
 #include <sstream>
 
+#include "allocation_tracker.h"
+#include "text_buffer.h"
 #include "util.h"
 
 namespace computer_vision {
 namespace {
 constexpr float kRadiansToDegrees = static_cast<float>(180 / M_PI);
 
+// Reads camera frames from the hardware buffers ARCore exposes instead of
+// having ARCore update a texture and copy every frame into an ArImage.  The
+// CPU image is read from the locked buffer when its usage allows CPU reads and
+// from ArFrame_acquireCameraImage otherwise.
+constexpr bool kUseHardwareBufferCpuAccess = false;
+
+// Scales the edge thresholds of the CPU kernels with the sensor sensitivity
+// of each frame, so sensor noise in low light is not detected as edges.
+constexpr bool kUseExposureAdaptiveThresholds = true;
+
+// Further scales them with the contrast of each processed image, from a
+// luminance histogram computed before the kernels run.
+constexpr bool kUseContrastAdaptiveThresholds = true;
+
+// Stages each processed CPU image as a model input, the centered square of
+// the image rotated upright and scaled to kTensorSize, for a model run off
+// the processing thread.  The sample has no model, so the tensors are only
+// timed.
+constexpr bool kUseTensorStaging = false;
+constexpr int32_t kTensorSize = 256;
+// Allocates the tensors as hardware buffers delegates can import.
+constexpr bool kUseTensorHardwareBuffers = true;
+
+// Writes the processed CPU images into hardware buffers the overlay samples
+// in place, instead of uploading them every frame.  Falls back to the upload
+// where R8 buffers cannot be allocated or have padded rows.
+constexpr bool kUseOverlayHardwareBuffers = true;
+
+// Frames the OpenGL thread may allocate in while caches and arenas grow,
+// after which debug builds report every frame that allocates.  Reports are
+// logged for the first allocating frame and then every
+// kAllocationReportInterval of them.
+constexpr int kAllocationWarmupFrames = 300;
+constexpr int kAllocationReportInterval = 100;
+
+// Capacity of each status text, which is truncated beyond it.
+constexpr size_t kStatusTextCapacity = 2048;
+
+// Frames longer than this are not fed to the camera config governor.
+constexpr float kMaxGovernedFrameTimeMs = 500.f;
+
+// Weight of the latest sample in the edge detection time averages.
+constexpr float kTimingSmoothing = 0.1f;
+
+// The motion gate skips images while the camera has moved and turned less than
+// this since the last processed image...
+constexpr float kMotionGateMaxTranslationM = 0.002f;
+constexpr float kMotionGateMaxRotationRadians = 0.2f / kRadiansToDegrees;
+// ...but processes one at least this often for the motion in the scene.
+constexpr float kMotionGateMaxSkipMs = 1000.f;
+
+float ToMilliseconds(std::chrono::steady_clock::duration duration) {
+  return std::chrono::duration<float, std::milli>(duration).count();
+}
+
+float UpdateAverage(float average_ms, float sample_ms) {
+  if (sample_ms < 0.f) {
+    return average_ms;
+  }
+  if (average_ms < 0.f) {
+    return sample_ms;
+  }
+  return average_ms + kTimingSmoothing * (sample_ms - average_ms);
+}
+
 float GetViewportAspectRatio(int display_rotation, int viewport_width,
                              int viewport_height) {
   float aspect_ratio;
@@ -49,9 +117,26 @@ float GetViewportAspectRatio(int display_rotation, int viewport_width,
 
 ComputerVisionApplication::ComputerVisionApplication(
     AAssetManager* asset_manager)
-    : asset_manager_(asset_manager) {}
+    : asset_manager_(asset_manager) {
+  cpu_image_processor_.SetContrastAdaptiveThresholds(
+      kUseContrastAdaptiveThresholds);
+  if (kUseOverlayHardwareBuffers && OverlayHardwareBuffers::IsSupported()) {
+    cpu_image_renderer_.SetOverlayHardwareBuffers(&overlay_hardware_buffers_);
+    cpu_image_processor_.SetOverlayHardwareBuffers(&overlay_hardware_buffers_);
+  }
+  if (kUseTensorStaging) {
+    RgbConversion conversion;
+    conversion.output_width = kTensorSize;
+    conversion.output_height = kTensorSize;
+    conversion.format = RgbFormat::kRgbFloat;
+    if (tensor_stager_.Configure(conversion, kUseTensorHardwareBuffers)) {
+      cpu_image_processor_.SetTensorStager(&tensor_stager_);
+    }
+  }
+}
 
 ComputerVisionApplication::~ComputerVisionApplication() {
+  cpu_image_processor_.ReleaseImages();
   if (ar_session_ != nullptr) {
     destroyCameraConfigs();
     ArSession_destroy(ar_session_);
@@ -111,8 +196,26 @@ void ComputerVisionApplication::OnResume(JNIEnv* env, jobject context,
     ArConfig_create(ar_session_, &ar_config_);
     CHECK(ar_config_);
 
+    use_hardware_buffer_ =
+        kUseHardwareBufferCpuAccess && CameraHardwareBuffer::IsSupported();
+    if (use_hardware_buffer_) {
+      ArConfig_setTextureUpdateMode(
+          ar_session_, ar_config_,
+          AR_TEXTURE_UPDATE_MODE_EXPOSE_HARDWARE_BUFFER);
+      CHECK(ArSession_configure(ar_session_, ar_config_) == AR_SUCCESS);
+    }
+
     ArFrame_create(ar_session_, &ar_frame_);
     CHECK(ar_frame_);
+    camera_image_metadata_.Reset();
+
+    if (!benchmark_dataset_uri_.empty()) {
+      // The dataset can only be set while the session has not been resumed.
+      CHECKANDTHROW(ArSession_setPlaybackDatasetUri(
+                        ar_session_, benchmark_dataset_uri_.c_str()) ==
+                        AR_SUCCESS,
+                    env, "Failed to set the playback benchmark dataset.");
+    }
 
     obtainCameraConfigs();
 
@@ -129,7 +232,16 @@ void ComputerVisionApplication::OnResume(JNIEnv* env, jobject context,
 
 void ComputerVisionApplication::OnSurfaceCreated() {
   LOGI("OnSurfaceCreated()");
+  if (playback_benchmark_.IsOpen()) {
+    // Frames are timed as fast as they can be drawn, not at display rate.
+    eglSwapInterval(eglGetCurrentDisplay(), 0);
+  }
   cpu_image_renderer_.InitializeGlContent(asset_manager_);
+  // The image belonged to the camera texture of the previous context.
+  camera_hardware_buffer_.ReleaseImage();
+  // So did the processed image on screen.
+  std::lock_guard<std::mutex> lock(frame_image_in_use_mutex_);
+  last_cpu_image_submission_ = CpuImageSubmission();
 }
 
 void ComputerVisionApplication::OnDisplayGeometryChanged(
@@ -149,13 +261,22 @@ void ComputerVisionApplication::OnDisplayGeometryChanged(
 }
 
 void ComputerVisionApplication::OnDrawFrame(float split_position) {
+  const auto frame_start = std::chrono::steady_clock::now();
+  const float frame_ms = ToMilliseconds(frame_start - last_frame_start_);
+  last_frame_start_ = frame_start;
+
+  CheckFrameAllocations();
+  frame_arena_.Reset();
+
   // Render the scene.
   glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
 
   if (ar_session_ == nullptr) return;
 
-  ArSession_setCameraTextureName(ar_session_,
-                                 cpu_image_renderer_.GetTextureId());
+  if (!use_hardware_buffer_) {
+    ArSession_setCameraTextureName(ar_session_,
+                                   cpu_image_renderer_.GetTextureId());
+  }
 
   // Update session to get current frame and render camera background and cpu
   // image.
@@ -163,22 +284,298 @@ void ComputerVisionApplication::OnDrawFrame(float split_position) {
     LOGE("ComputerVisionApplication::OnDrawFrame ArSession_update error");
   }
 
-  // Lock the image use to avoid pausing & resuming session when the image is in
-  // use. This is because switching resolutions requires all images to be
-  // released before session.resume() is called.
-  std::lock_guard<std::mutex> lock(frame_image_in_use_mutex_);
+  const auto processing_start = std::chrono::steady_clock::now();
+  DrawCameraImages(split_position);
+  float processing_ms =
+      ToMilliseconds(std::chrono::steady_clock::now() - processing_start);
+  if (!gpu_edge_detection_active_ && last_cpu_processing_ms_ >= 0.f) {
+    processing_ms = last_cpu_processing_ms_;
+  }
+  UpdateCameraConfigGovernor(processing_ms, frame_ms);
+
+  if (playback_benchmark_.IsOpen()) {
+    // Waits for the GPU so the frame time includes the draw calls' execution,
+    // which would otherwise be hidden by the missing vsync throttling.  The
+    // CPU processing runs on its own thread and is not part of it.
+    glFinish();
+    RecordBenchmarkFrame(std::chrono::steady_clock::now() - frame_start);
+  }
+}
 
-  ArImage* image = nullptr;
-  ArStatus status = ArFrame_acquireCameraImage(ar_session_, ar_frame_, &image);
-  if (status != AR_SUCCESS) {
-    LOGW(
-        "ComputerVisionApplication::OnDrawFrame acquire camera image not "
-        "ready.");
+bool ComputerVisionApplication::StartPlaybackBenchmark(
+    const std::string& dataset_uri, const std::string& csv_path) {
+  if (!playback_benchmark_.Open(csv_path)) {
+    return false;
   }
+  LOGI("Playback benchmark of %s into %s", dataset_uri.c_str(),
+       csv_path.c_str());
+  benchmark_dataset_uri_ = dataset_uri;
+  benchmark_finished_ = false;
+  return true;
+}
 
-  cpu_image_renderer_.Draw(ar_session_, ar_frame_, image, aspect_ratio_,
-                           camera_to_display_rotation_, split_position);
-  ArImage_release(image);
+void ComputerVisionApplication::RecordBenchmarkFrame(
+    std::chrono::nanoseconds frame_time) {
+  int64_t timestamp_ns = 0;
+  ArFrame_getTimestamp(ar_session_, ar_frame_, &timestamp_ns);
+  playback_benchmark_.RecordFrame(timestamp_ns, frame_time);
+
+  ArPlaybackStatus playback_status = AR_PLAYBACK_NONE;
+  ArSession_getPlaybackStatus(ar_session_, &playback_status);
+  if (playback_status == AR_PLAYBACK_FINISHED ||
+      playback_status == AR_PLAYBACK_IO_ERROR) {
+    if (playback_status == AR_PLAYBACK_IO_ERROR) {
+      LOGE("Playback benchmark stopped by a dataset read error");
+    }
+    playback_benchmark_.Finish();
+    benchmark_finished_ = true;
+  }
+}
+
+void ComputerVisionApplication::CheckFrameAllocations() {
+  if (!AllocationTracker::IsAvailable()) {
+    return;
+  }
+  if (allocation_check_frames_ < kAllocationWarmupFrames) {
+    if (++allocation_check_frames_ == kAllocationWarmupFrames) {
+      AllocationTracker::EnableForThread();
+    }
+    return;
+  }
+  const int64_t count = AllocationTracker::TakeThreadCount();
+  if (count > 0 && allocating_frames_++ % kAllocationReportInterval == 0) {
+    LOGW("ComputerVisionApplication: The last frame made %lld heap "
+         "allocations on the OpenGL thread, %d allocating frames so far",
+         static_cast<long long>(count), allocating_frames_);
+  }
+}
+
+void ComputerVisionApplication::DrawCameraImages(float split_position) {
+  // The GPU path only needs the camera texture.
+  const bool use_gpu = use_gpu_edge_detection_ &&
+                       cpu_image_renderer_.IsGpuEdgeDetectionSupported();
+  cpu_image_renderer_.SetUseGpuEdgeDetection(use_gpu);
+  gpu_edge_detection_active_ = use_gpu;
+  // No need to process the CPU image if it is not displayed.
+  const bool process_cpu_image = !use_gpu && split_position < 1.0f;
+
+  {
+    // Lock the image use to avoid pausing & resuming session when the image is
+    // being acquired. This is because switching resolutions requires all
+    // images to be released before session.resume() is called.
+    std::lock_guard<std::mutex> lock(frame_image_in_use_mutex_);
+
+    if (use_gpu) {
+      // The GPU path draws over the processed image.
+      last_cpu_image_submission_ = CpuImageSubmission();
+    }
+    float camera_pose[7] = {};
+    const bool has_camera_pose = process_cpu_image && motion_gate_enabled_ &&
+                                 GetTrackedCameraPose(camera_pose);
+    const bool camera_still =
+        has_camera_pose && IsCameraStill(camera_pose, split_position);
+
+    bool processed = false;
+    if (use_hardware_buffer_) {
+      void* native_hardware_buffer = nullptr;
+      ArFrame_getHardwareBuffer(ar_session_, ar_frame_,
+                                &native_hardware_buffer);
+      AHardwareBuffer* hardware_buffer =
+          reinterpret_cast<AHardwareBuffer*>(native_hardware_buffer);
+      if (!camera_hardware_buffer_.BindToTexture(
+              hardware_buffer, cpu_image_renderer_.GetTextureId())) {
+        return;
+      }
+      // The buffer is only valid until the next ArSession_update, so it is
+      // processed right away instead of on the processing thread.
+      CpuImagePlane luminance;
+      if (process_cpu_image && !camera_still &&
+          camera_hardware_buffer_.LockLuminancePlane(hardware_buffer,
+                                                     &luminance)) {
+        // The buffer holds the image of the frame timestamp.
+        int64_t timestamp_ns = 0;
+        ArFrame_getTimestamp(ar_session_, ar_frame_, &timestamp_ns);
+        if (!IsCpuImageResultCurrent(timestamp_ns, luminance.width,
+                                     luminance.height, split_position)) {
+          const ImageRegion region = cpu_image_renderer_.GetVisibleImageRegion(
+              split_position, luminance.width, luminance.height);
+          cpu_image_processor_.Process(luminance, region, GetKernelParams(),
+                                       timestamp_ns);
+          RecordCpuImageSubmission(timestamp_ns, luminance.width,
+                                   luminance.height, region, has_camera_pose,
+                                   camera_pose);
+        }
+        camera_hardware_buffer_.Unlock();
+        processed = true;
+      }
+    }
+
+    if (process_cpu_image && !camera_still && !processed) {
+      ArImage* image = nullptr;
+      CpuImagePlane luminance;
+      int64_t timestamp_ns = 0;
+      if (ArFrame_acquireCameraImage(ar_session_, ar_frame_, &image) !=
+          AR_SUCCESS) {
+        LOGW(
+            "ComputerVisionApplication::OnDrawFrame acquire camera image not "
+            "ready.");
+      } else if (CpuImageRenderer::GetLuminancePlane(ar_session_, image,
+                                                     &luminance)) {
+        ArImage_getTimestamp(ar_session_, image, &timestamp_ns);
+        if (IsCpuImageResultCurrent(timestamp_ns, luminance.width,
+                                    luminance.height, split_position)) {
+          // ARCore has no newer image, the one on screen is up to date.
+          ArImage_release(image);
+        } else {
+          const ImageRegion region =
+              cpu_image_renderer_.GetVisibleImageRegion(
+                  split_position, luminance.width, luminance.height);
+          TensorSource tensor_source;
+          const bool stage_tensor =
+              tensor_stager_.IsConfigured() &&
+              GetTensorSource(image, timestamp_ns, has_camera_pose,
+                              camera_pose, &tensor_source);
+          // The processor releases the image once it is done with it.
+          cpu_image_processor_.Submit(image, luminance, region,
+                                      GetKernelParams(), timestamp_ns,
+                                      stage_tensor ? &tensor_source : nullptr);
+          RecordCpuImageSubmission(timestamp_ns, luminance.width,
+                                   luminance.height, region, has_camera_pose,
+                                   camera_pose);
+        }
+      } else {
+        ArImage_release(image);
+      }
+    }
+  }
+
+  ProcessedCpuImage processed_image;
+  const bool has_processed_image =
+      !use_gpu && cpu_image_processor_.TakeResult(&processed_image);
+  cpu_image_renderer_.Draw(ar_session_, ar_frame_,
+                           has_processed_image ? &processed_image : nullptr,
+                           aspect_ratio_, camera_to_display_rotation_,
+                           split_position);
+
+  if (use_gpu && split_position < 1.0f) {
+    gpu_edge_detection_ms_ =
+        UpdateAverage(gpu_edge_detection_ms_,
+                      cpu_image_renderer_.GetGpuEdgeDetectionTimeMs());
+  } else if (has_processed_image) {
+    last_cpu_processing_ms_ = processed_image.processing_ms;
+    last_cpu_contrast_ = processed_image.contrast;
+    last_cpu_params_ = processed_image.params;
+    cpu_edge_detection_ms_ =
+        UpdateAverage(cpu_edge_detection_ms_, processed_image.processing_ms);
+    const KernelTimings& timings = processed_image.timings;
+    for (int i = 0; i < timings.num_steps; ++i) {
+      // A new chain starts new averages.
+      if (i >= cpu_kernel_timings_.num_steps ||
+          cpu_kernel_timings_.names[i] != timings.names[i]) {
+        cpu_kernel_timings_ = timings;
+        break;
+      }
+      cpu_kernel_timings_.ms[i] =
+          UpdateAverage(cpu_kernel_timings_.ms[i], timings.ms[i]);
+    }
+    cpu_kernel_timings_.num_steps = timings.num_steps;
+  }
+}
+
+bool ComputerVisionApplication::IsCpuImageResultCurrent(
+    int64_t timestamp_ns, int32_t width, int32_t height,
+    float split_position) const {
+  const CpuImageSubmission& last = last_cpu_image_submission_;
+  return timestamp_ns == last.timestamp_ns && width == last.width &&
+         height == last.height &&
+         last.settings_generation == cpu_settings_generation_ &&
+         cpu_image_renderer_.GetVisibleImageRegion(split_position, width,
+                                                   height) == last.region;
+}
+
+bool ComputerVisionApplication::GetTrackedCameraPose(float* out_pose) const {
+  ArCamera* camera = nullptr;
+  ArFrame_acquireCamera(ar_session_, ar_frame_, &camera);
+  ArTrackingState tracking_state = AR_TRACKING_STATE_STOPPED;
+  ArCamera_getTrackingState(ar_session_, camera, &tracking_state);
+  const bool tracking = tracking_state == AR_TRACKING_STATE_TRACKING;
+  if (tracking) {
+    ArPose* pose = nullptr;
+    ArPose_create(ar_session_, nullptr, &pose);
+    ArCamera_getPose(ar_session_, camera, pose);
+    ArPose_getPoseRaw(ar_session_, pose, out_pose);
+    ArPose_destroy(pose);
+  }
+  ArCamera_release(camera);
+  return tracking;
+}
+
+bool ComputerVisionApplication::GetTensorSource(
+    const ArImage* image, int64_t timestamp_ns, bool has_camera_pose,
+    const float* camera_pose, TensorSource* out_source) const {
+  if (!GetYuvImage(ar_session_, image, &out_source->image)) {
+    return false;
+  }
+  TensorTag& tag = out_source->tag;
+  tag.timestamp_ns = timestamp_ns;
+  // The motion gate only looks the pose up when it is enabled.
+  if (has_camera_pose) {
+    std::copy(camera_pose, camera_pose + 7, tag.camera_pose);
+    tag.has_camera_pose = true;
+  } else {
+    tag.has_camera_pose = GetTrackedCameraPose(tag.camera_pose);
+  }
+  const int32_t width = out_source->image.width;
+  const int32_t height = out_source->image.height;
+  const int32_t side = std::min(width, height);
+  tag.crop.left = (width - side) / 2;
+  tag.crop.top = (height - side) / 2;
+  tag.crop.right = tag.crop.left + side;
+  tag.crop.bottom = tag.crop.top + side;
+  tag.quarter_turns = camera_to_display_rotation_;
+  return true;
+}
+
+bool ComputerVisionApplication::IsCameraStill(const float* camera_pose,
+                                              float split_position) const {
+  const CpuImageSubmission& last = last_cpu_image_submission_;
+  if (!last.has_camera_pose ||
+      ToMilliseconds(std::chrono::steady_clock::now() - last.time) >
+          kMotionGateMaxSkipMs ||
+      !IsCpuImageResultCurrent(last.timestamp_ns, last.width, last.height,
+                               split_position)) {
+    return false;
+  }
+  // The pose is a quaternion (x, y, z, w) followed by a translation.
+  float dot = 0.f;
+  for (int i = 0; i < 4; ++i) {
+    dot += camera_pose[i] * last.camera_pose[i];
+  }
+  const float rotation_radians =
+      2.f * std::acos(std::min(1.f, std::fabs(dot)));
+  float squared_translation = 0.f;
+  for (int i = 4; i < 7; ++i) {
+    const float delta = camera_pose[i] - last.camera_pose[i];
+    squared_translation += delta * delta;
+  }
+  return rotation_radians < kMotionGateMaxRotationRadians &&
+         squared_translation <
+             kMotionGateMaxTranslationM * kMotionGateMaxTranslationM;
+}
+
+void ComputerVisionApplication::RecordCpuImageSubmission(
+    int64_t timestamp_ns, int32_t width, int32_t height,
+    const ImageRegion& region, bool has_camera_pose,
+    const float* camera_pose) {
+  CpuImageSubmission& last = last_cpu_image_submission_;
+  last.timestamp_ns = timestamp_ns;
+  last.width = width;
+  last.height = height;
+  last.region = region;
+  last.settings_generation = cpu_settings_generation_;
+  last.has_camera_pose = has_camera_pose;
+  std::copy(camera_pose, camera_pose + 7, last.camera_pose);
+  last.time = std::chrono::steady_clock::now();
 }
 
 std::string ComputerVisionApplication::getCameraConfigLabel(
@@ -196,22 +593,32 @@ std::string ComputerVisionApplication::getCameraConfigLabel(
 }
 
 ArStatus ComputerVisionApplication::setCameraConfig(bool is_low_resolution) {
+  governor_enabled_ = false;
+  return ApplyCameraConfig(is_low_resolution
+                               ? cpu_low_resolution_camera_config_ptr_
+                               : cpu_high_resolution_camera_config_ptr_);
+}
+
+ArStatus ComputerVisionApplication::ApplyCameraConfig(CameraConfig* config) {
   // To change the AR camera config - first we pause the AR session, set the
   // desired camera config and then resume the AR session.
   CHECK(ar_session_)
+  CHECK(config);
 
   // Block here if the image is still being used.
   std::lock_guard<std::mutex> lock(frame_image_in_use_mutex_);
 
+  cpu_image_processor_.ReleaseImages();
+  // The queued image may have been released unprocessed.
+  last_cpu_image_submission_ = CpuImageSubmission();
   ArSession_pause(ar_session_);
+  // The camera restarts with new buffers.
+  camera_hardware_buffer_.ReleaseImage();
 
-  if (is_low_resolution) {
-    ArSession_setCameraConfig(ar_session_,
-                              cpu_low_resolution_camera_config_ptr_->config);
-  } else {
-    ArSession_setCameraConfig(ar_session_,
-                              cpu_high_resolution_camera_config_ptr_->config);
-  }
+  ArSession_setCameraConfig(ar_session_, config->config);
+  current_camera_config_ = config;
+  // Another camera config may report a different set of metadata keys.
+  camera_image_metadata_.Reset();
 
   ArStatus status = ArSession_resume(ar_session_);
   if (status != ArStatus::AR_SUCCESS) {
@@ -221,11 +628,142 @@ ArStatus ComputerVisionApplication::setCameraConfig(bool is_low_resolution) {
     ArSession_destroy(ar_session_);
     ArConfig_destroy(ar_config_);
     ArFrame_destroy(ar_frame_);
+    ar_session_ = nullptr;
+    ar_config_ = nullptr;
+    ar_frame_ = nullptr;
+    current_camera_config_ = nullptr;
   }
 
   return status;
 }
 
+void ComputerVisionApplication::SetCameraConfigGovernorEnabled(
+    bool enabled, float processing_budget_ms) {
+  governor_budget_ms_ = processing_budget_ms;
+  governor_enabled_ = enabled;
+}
+
+void ComputerVisionApplication::UpdateCameraConfigGovernor(float processing_ms,
+                                                           float frame_ms) {
+  if (!governor_enabled_) {
+    governor_running_ = false;
+    return;
+  }
+  if (governor_configs_.empty()) {
+    return;
+  }
+
+  if (!governor_running_) {
+    std::vector<CameraConfigGovernor::Level> levels;
+    int current_level = 0;
+    for (size_t i = 0; i < governor_configs_.size(); ++i) {
+      const CameraConfig* config = governor_configs_[i];
+      CameraConfigGovernor::Level level;
+      level.relative_cost = static_cast<float>(config->width * config->height);
+      level.frame_period_ms = 1000.f / std::max(config->max_fps, 1);
+      levels.push_back(level);
+      if (config == current_camera_config_) {
+        current_level = i;
+      }
+    }
+    camera_config_governor_.Reset(levels, current_level, governor_budget_ms_);
+    governor_running_ = true;
+    return;
+  }
+
+  // The first frame after a pause only measures the pause.
+  if (frame_ms > kMaxGovernedFrameTimeMs) {
+    return;
+  }
+  const int level = camera_config_governor_.OnFrame(processing_ms, frame_ms);
+  if (level == CameraConfigGovernor::kNoChange) {
+    return;
+  }
+  CameraConfig* config = governor_configs_[level];
+  LOGI("Camera config governor: switching to %s",
+       config->config_label.c_str());
+  if (ApplyCameraConfig(config) != AR_SUCCESS) {
+    governor_enabled_ = false;
+    governor_running_ = false;
+  }
+}
+
+void ComputerVisionApplication::SetUseGpuEdgeDetection(bool use_gpu) {
+  use_gpu_edge_detection_ = use_gpu;
+}
+
+void ComputerVisionApplication::SetPyramidLevel(int level) {
+  cpu_image_processor_.SetPyramidLevel(level);
+  ++cpu_settings_generation_;
+}
+
+bool ComputerVisionApplication::SetKernelChain(const std::string& chain) {
+  std::vector<std::string> names;
+  std::istringstream chain_stream(chain);
+  std::string name;
+  while (std::getline(chain_stream, name, ',')) {
+    names.push_back(name);
+  }
+  if (!cpu_image_processor_.SetKernelChain(names)) {
+    return false;
+  }
+  ++cpu_settings_generation_;
+  return true;
+}
+
+KernelParams ComputerVisionApplication::GetKernelParams() {
+  if (kUseExposureAdaptiveThresholds &&
+      camera_image_metadata_.Update(ar_session_, ar_frame_)) {
+    last_sensitivity_iso_ = camera_image_metadata_.GetSensitivityIso();
+    last_kernel_params_ = GetKernelParamsForSensitivity(last_sensitivity_iso_);
+  }
+  return last_kernel_params_;
+}
+
+void ComputerVisionApplication::SetMotionGateEnabled(bool enabled) {
+  motion_gate_enabled_ = enabled;
+}
+
+const char* ComputerVisionApplication::GetEdgeDetectionTimingText() {
+  TextBuffer timing_text(
+      reinterpret_cast<char*>(frame_arena_.Allocate(kStatusTextCapacity)),
+      kStatusTextCapacity);
+  timing_text.Append("Edge Detection:\n\tCPU: ");
+  if (cpu_edge_detection_ms_ >= 0.f) {
+    timing_text.Append("%.2f ms", cpu_edge_detection_ms_);
+    for (int i = 0; i < cpu_kernel_timings_.num_steps; ++i) {
+      timing_text.Append("\n\t\t%s: %.2f ms", cpu_kernel_timings_.names[i],
+                         cpu_kernel_timings_.ms[i]);
+    }
+  } else {
+    timing_text.Append("-");
+  }
+  if (kUseExposureAdaptiveThresholds && last_sensitivity_iso_ > 0) {
+    timing_text.Append("\n\tISO %d, edge threshold %d",
+                       last_sensitivity_iso_,
+                       last_kernel_params_.gradient_edge_threshold);
+  }
+  if (last_cpu_contrast_ >= 0) {
+    timing_text.Append("\n\tContrast %d, edge threshold %d",
+                       last_cpu_contrast_,
+                       last_cpu_params_.gradient_edge_threshold);
+  }
+  timing_text.Append("\n\tGPU: ");
+  if (!cpu_image_renderer_.IsGpuEdgeDetectionSupported()) {
+    timing_text.Append("not supported");
+  } else if (gpu_edge_detection_ms_ >= 0.f) {
+    timing_text.Append("%.2f ms", gpu_edge_detection_ms_);
+  } else {
+    timing_text.Append("-");
+  }
+  if (tensor_stager_.IsConfigured()) {
+    timing_text.Append("\n\tTensor staging: %.2f ms, %d dropped",
+                       tensor_stager_.GetLastStageMs(),
+                       tensor_stager_.GetDroppedCount());
+  }
+  return timing_text.c_str();
+}
+
 void ComputerVisionApplication::SetFocusMode(bool enable_auto_focus) {
   CHECK(ar_session_);
   CHECK(ar_config_);
@@ -273,6 +811,26 @@ void ComputerVisionApplication::obtainCameraConfigs() {
                      &camera_configs_[i]);
   }
 
+  // The governor steps through the configs from the cheapest to the most
+  // expensive one, ordered by resolution and then by frame rate.
+  governor_configs_.clear();
+  current_camera_config_ = nullptr;
+  governor_running_ = false;
+  for (CameraConfig& config : camera_configs_) {
+    governor_configs_.push_back(&config);
+  }
+  std::sort(governor_configs_.begin(), governor_configs_.end(),
+            [](const CameraConfig* a, const CameraConfig* b) {
+              const int64_t a_pixels =
+                  static_cast<int64_t>(a->width) * a->height;
+              const int64_t b_pixels =
+                  static_cast<int64_t>(b->width) * b->height;
+              if (a_pixels != b_pixels) {
+                return a_pixels < b_pixels;
+              }
+              return a->max_fps < b->max_fps;
+            });
+
   // Determine the highest and lowest CPU resolutions.
   cpu_low_resolution_camera_config_ptr_ = nullptr;
   cpu_high_resolution_camera_config_ptr_ = nullptr;
@@ -327,9 +885,13 @@ void ComputerVisionApplication::copyCameraConfig(
     ArCameraConfig_getImageDimensions(ar_session, camera_config->config,
                                       &camera_config->width,
                                       &camera_config->height);
-    camera_config->config_label = "(" + std::to_string(camera_config->width) +
-                                  "x" + std::to_string(camera_config->height) +
-                                  ")";
+    int32_t min_fps = 0;
+    ArCameraConfig_getFpsRange(ar_session, camera_config->config, &min_fps,
+                               &camera_config->max_fps);
+    camera_config->config_label =
+        "(" + std::to_string(camera_config->width) + "x" +
+        std::to_string(camera_config->height) + ", " +
+        std::to_string(camera_config->max_fps) + " fps)";
   }
 }
 
@@ -341,7 +903,7 @@ void ComputerVisionApplication::destroyCameraConfigs() {
   }
 }
 
-std::string ComputerVisionApplication::GetCameraIntrinsicsText(
+const char* ComputerVisionApplication::GetCameraIntrinsicsText(
     bool for_gpu_texture) {
   if (ar_session_ == nullptr) return "";
 
@@ -375,17 +937,17 @@ std::string ComputerVisionApplication::GetCameraIntrinsicsText(
   fov_x *= kRadiansToDegrees;
   fov_y *= kRadiansToDegrees;
 
-  std::ostringstream intrinsics_text;
-  intrinsics_text << std::fixed << std::setprecision(2) << "Unrotated Camera "
-                  << (for_gpu_texture ? "GPU Texture" : "CPU Image")
-                  << " Intrinsics:\n\tFocal Length: (" << fx << ", " << fy
-                  << ")\n\tPrincipal Point: (" << cx << ", " << cy << ")\n\t"
-                  << (for_gpu_texture ? "GPU" : "CPU") << " Image Dimensions: ("
-                  << image_width << ", " << image_height
-                  << ")\n\tUnrotated Field of View: (" << fov_x << "º, "
-                  << fov_y << "º)";
-
-  return intrinsics_text.str();
+  TextBuffer intrinsics_text(
+      reinterpret_cast<char*>(frame_arena_.Allocate(kStatusTextCapacity)),
+      kStatusTextCapacity);
+  intrinsics_text.Append(
+      "Unrotated Camera %s Intrinsics:\n\tFocal Length: (%.2f, %.2f)"
+      "\n\tPrincipal Point: (%.2f, %.2f)\n\t%s Image Dimensions: (%d, %d)"
+      "\n\tUnrotated Field of View: (%.2fº, %.2fº)",
+      for_gpu_texture ? "GPU Texture" : "CPU Image", fx, fy, cx, cy,
+      for_gpu_texture ? "GPU" : "CPU", image_width, image_height, fov_x,
+      fov_y);
+  return intrinsics_text.c_str();
 }
 
 }  // namespace computer_vision
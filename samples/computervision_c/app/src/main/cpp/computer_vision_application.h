@@ -21,6 +21,8 @@
 #include <GLES2/gl2ext.h>
 #include <android/asset_manager.h>
 #include <jni.h>
+#include <atomic>
+#include <chrono>
 #include <memory>
 #include <mutex>  // NOLINT
 #include <set>
@@ -29,7 +31,15 @@
 #include <vector>
 
 #include "arcore_c_api.h"
+#include "camera_config_governor.h"
+#include "camera_hardware_buffer.h"
+#include "camera_image_metadata.h"
+#include "cpu_image_processor.h"
 #include "cpu_image_renderer.h"
+#include "overlay_hardware_buffers.h"
+#include "playback_benchmark.h"
+#include "scratch_arena.h"
+#include "tensor_stager.h"
 #include "util.h"
 
 namespace computer_vision {
@@ -68,14 +78,58 @@ class ComputerVisionApplication {
   // Return an empty string if the camera config is not available.
   std::string getCameraConfigLabel(bool is_low_resolution);
 
-  // Set camera config with low or high resolution.
+  // Set camera config with low or high resolution.  Turns off the automatic
+  // camera config selection.
   ArStatus setCameraConfig(bool is_low_resolution);
 
+  // Lets the application step through all camera configs on its own, picking
+  // the most expensive one whose CPU image processing stays within
+  // |processing_budget_ms| per frame.  May be called from any thread.
+  void SetCameraConfigGovernorEnabled(bool enabled,
+                                      float processing_budget_ms);
+
+  // Switches the edge detection between the CPU image and the compute shader
+  // on the camera texture.  May be called from any thread.
+  void SetUseGpuEdgeDetection(bool use_gpu);
+
+  // Runs the CPU edge detection on |level| of the image pyramid, 0 being the
+  // full resolution and each further level halving it.  May be called from
+  // any thread.
+  void SetPyramidLevel(int level);
+
+  // Replaces the CPU kernel chain by the comma separated kernel names of
+  // |chain|, e.g. "box_blur,sobel_magnitude,threshold".  Returns false and
+  // keeps the current chain if it is not valid.  May be called from any
+  // thread.
+  bool SetKernelChain(const std::string& chain);
+
+  // Skips the CPU processing of camera images while the camera pose stays
+  // within a small distance of the one of the last processed image, reusing
+  // its result.  A still image is still processed again at a low rate to
+  // catch motion in the scene.  May be called from any thread.
+  void SetMotionGateEnabled(bool enabled);
+
+  // Get the text logs for the edge detection timings of both paths.  The
+  // text is in the frame arena, valid until the next OnDrawFrame().  Must be
+  // called on the OpenGL thread.
+  const char* GetEdgeDetectionTimingText();
+
   void SetFocusMode(bool enable_auto_focus);
   bool GetFocusMode();
 
-  // Get the text logs for the camera intrinsics.
-  std::string GetCameraIntrinsicsText(bool for_gpu_texture);
+  // Get the text logs for the camera intrinsics, with the same lifetime as
+  // GetEdgeDetectionTimingText().
+  const char* GetCameraIntrinsicsText(bool for_gpu_texture);
+
+  // Switches the application to the playback benchmark mode: the session
+  // plays |dataset_uri| back instead of using the camera, and the time of
+  // every frame is written to |csv_path|.  Must be called before the first
+  // OnResume().  Returns false if the CSV file cannot be created.
+  bool StartPlaybackBenchmark(const std::string& dataset_uri,
+                              const std::string& csv_path);
+
+  // Returns true once the whole benchmark recording has been played back.
+  bool IsPlaybackBenchmarkFinished() const { return benchmark_finished_; }
 
  private:
   ArSession* ar_session_ = nullptr;
@@ -92,22 +146,105 @@ class ComputerVisionApplication {
 
   AAssetManager* const asset_manager_;
 
+  // Overlay the processor writes and the renderer samples, see
+  // kUseOverlayHardwareBuffers.  Declared before both.
+  OverlayHardwareBuffers overlay_hardware_buffers_;
   CpuImageRenderer cpu_image_renderer_;
+  // Model inputs staged from the CPU images, see kUseTensorStaging.  Declared
+  // before cpu_image_processor_, which stages into it until it is destroyed.
+  TensorStager tensor_stager_;
+  // Detects the edges of the CPU images on its own thread.
+  CpuImageProcessor cpu_image_processor_;
+
+  // Set when the session runs in AR_TEXTURE_UPDATE_MODE_EXPOSE_HARDWARE_BUFFER
+  // and camera_hardware_buffer_ feeds both the camera texture and, where the
+  // buffer allows it, the CPU image.
+  bool use_hardware_buffer_ = false;
+  CameraHardwareBuffer camera_hardware_buffer_;
+
+  // Scratch memory of the current frame on the OpenGL thread, reset when a
+  // frame starts.  Once its size settles, frames allocate nothing.
+  ScratchArena frame_arena_;
+  int allocation_check_frames_ = 0;
+  int allocating_frames_ = 0;
+
+  std::atomic<bool> use_gpu_edge_detection_{false};
+  // Moving averages of the edge detection times in milliseconds, negative
+  // until the path has run.  Only used on the OpenGL thread.
+  float cpu_edge_detection_ms_ = -1.f;
+  float gpu_edge_detection_ms_ = -1.f;
+  // Duration of the latest CPU image processing, which runs off the OpenGL
+  // thread and so is not part of the frame time.
+  float last_cpu_processing_ms_ = -1.f;
+  // Contrast of the latest processed image and the kernel parameters it was
+  // processed with, see ProcessedCpuImage.
+  int32_t last_cpu_contrast_ = -1;
+  KernelParams last_cpu_params_;
+  // Moving averages of the CPU kernel chain steps.
+  KernelTimings cpu_kernel_timings_;
+  // Sensor settings of the latest frames, guarded by
+  // frame_image_in_use_mutex_, and the kernel parameters derived from them,
+  // which are only written on the OpenGL thread with the mutex held.
+  // last_sensitivity_iso_ is 0 until the metadata has been read.
+  CameraImageMetadata camera_image_metadata_;
+  int32_t last_sensitivity_iso_ = 0;
+  KernelParams last_kernel_params_;
+  bool gpu_edge_detection_active_ = false;
+
+  // The CPU image last handed to cpu_image_processor_.  Its result stays on
+  // screen, so a later image with the same timestamp, size and region needs
+  // no processing while the processing settings have not changed either.
+  // Guarded by frame_image_in_use_mutex_.
+  struct CpuImageSubmission {
+    int64_t timestamp_ns = -1;
+    int32_t width = 0;
+    int32_t height = 0;
+    ImageRegion region;
+    int settings_generation = -1;
+    // Raw camera pose when the motion gate is enabled, see ArPose_getPoseRaw.
+    bool has_camera_pose = false;
+    float camera_pose[7] = {};
+    std::chrono::steady_clock::time_point time;
+  };
+  CpuImageSubmission last_cpu_image_submission_;
+  // Incremented whenever a setting changes the result of the CPU processing.
+  std::atomic<int> cpu_settings_generation_{0};
+  std::atomic<bool> motion_gate_enabled_{false};
 
   struct CameraConfig {
     int32_t width = 0;
     int32_t height = 0;
+    int32_t max_fps = 0;
     std::string config_label;
     ArCameraConfig* config = nullptr;
   };
 
-  // This lock prevents changing resolution as the frame is being rendered.
-  // ARCore requires all cpu images to be released before changing resolution.
+  // This lock prevents changing resolution while a CPU image is acquired and
+  // handed to cpu_image_processor_.  ARCore requires all cpu images to be
+  // released before changing resolution.
   std::mutex frame_image_in_use_mutex_;
 
   std::vector<CameraConfig> camera_configs_;
   CameraConfig* cpu_low_resolution_camera_config_ptr_ = nullptr;
   CameraConfig* cpu_high_resolution_camera_config_ptr_ = nullptr;
+  // Config last set with ArSession_setCameraConfig, guarded by
+  // frame_image_in_use_mutex_.  Null while ARCore's default config is used.
+  CameraConfig* current_camera_config_ = nullptr;
+
+  // Automatic camera config selection, see SetCameraConfigGovernorEnabled().
+  // The governor itself is only used on the OpenGL thread.
+  std::atomic<bool> governor_enabled_{false};
+  std::atomic<float> governor_budget_ms_{0.f};
+  bool governor_running_ = false;
+  CameraConfigGovernor camera_config_governor_;
+  // camera_configs_ in the governor's level order.
+  std::vector<CameraConfig*> governor_configs_;
+  std::chrono::steady_clock::time_point last_frame_start_;
+
+  // Playback benchmark state, see StartPlaybackBenchmark().
+  std::string benchmark_dataset_uri_;
+  PlaybackBenchmark playback_benchmark_;
+  std::atomic<bool> benchmark_finished_{false};
 
   // Obtain all camera configs (and update camera_configs_) and sort out the
   // configs with lowest and highest image resolutions.
@@ -118,6 +255,58 @@ class ComputerVisionApplication {
                         const ArCameraConfigList* all_configs, int index,
                         int num_configs, CameraConfig* camera_config);
 
+  // Hands the CPU image of ar_frame_ to cpu_image_processor_ and draws the
+  // camera texture with the latest processed image.
+  void DrawCameraImages(float split_position);
+
+  // Reports the heap allocations the OpenGL thread made since the previous
+  // frame, once the frame loop had kAllocationWarmupFrames to settle.  Only
+  // counts in debug builds, see AllocationTracker.
+  void CheckFrameAllocations();
+
+  // Whether the result of last_cpu_image_submission_ is still the one an
+  // image of |timestamp_ns| and size |width| x |height| would produce with
+  // |split_position|.  Called with frame_image_in_use_mutex_ held.
+  bool IsCpuImageResultCurrent(int64_t timestamp_ns, int32_t width,
+                               int32_t height, float split_position) const;
+
+  // Returns the raw pose of the camera of ar_frame_ in |out_pose|, or false
+  // if the camera is not tracking.
+  bool GetTrackedCameraPose(float* out_pose) const;
+
+  // Describes |image| for tensor_stager_: its planes, and its timestamp and
+  // camera pose, |camera_pose| if |has_camera_pose| and looked up otherwise.
+  // Returns false if the planes cannot be read.
+  bool GetTensorSource(const ArImage* image, int64_t timestamp_ns,
+                       bool has_camera_pose, const float* camera_pose,
+                       TensorSource* out_source) const;
+
+  // Whether the camera is close enough to the pose of the last submitted image
+  // for the motion gate to skip |camera_pose|.  Called with
+  // frame_image_in_use_mutex_ held.
+  bool IsCameraStill(const float* camera_pose, float split_position) const;
+
+  // Kernel parameters for the sensor sensitivity of ar_frame_, or those of
+  // the last frame whose metadata could be read.  Called with
+  // frame_image_in_use_mutex_ held.
+  KernelParams GetKernelParams();
+
+  // Records an image handed to cpu_image_processor_.
+  void RecordCpuImageSubmission(int64_t timestamp_ns, int32_t width,
+                                int32_t height, const ImageRegion& region,
+                                bool has_camera_pose, const float* camera_pose);
+
+  // Pauses the session, switches to |config| and resumes the session.
+  ArStatus ApplyCameraConfig(CameraConfig* config);
+
+  // Feeds the timings of the frame just drawn to the governor and switches
+  // the camera config when it asks for it.  Called on the OpenGL thread.
+  void UpdateCameraConfigGovernor(float processing_ms, float frame_ms);
+
+  // Writes the time of the frame just drawn and stops the benchmark at the
+  // end of the recording.
+  void RecordBenchmarkFrame(std::chrono::nanoseconds frame_time);
+
   // Release memory in camera_configs_.
   void destroyCameraConfigs();
 
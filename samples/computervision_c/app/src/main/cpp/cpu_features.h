@@ -0,0 +1,29 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_COMPUTER_VISION_CPU_FEATURES_H_
+#define C_ARCORE_COMPUTER_VISION_CPU_FEATURES_H_
+
+namespace computer_vision {
+
+// Returns true if the CPU runs NEON instructions.  Always true on aarch64,
+// queried from the kernel on 32-bit ARM.  Only meaningful in code built with
+// __ARM_NEON.
+bool IsNeonSupported();
+
+}  // namespace computer_vision
+
+#endif  // C_ARCORE_COMPUTER_VISION_CPU_FEATURES_H_
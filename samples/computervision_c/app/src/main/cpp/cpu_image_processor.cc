@@ -0,0 +1,217 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cpu_image_processor.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace computer_vision {
+namespace {
+// Every second pixel of every second row is enough for the contrast.
+constexpr int32_t kHistogramStep = 2;
+}  // namespace
+
+CpuImageProcessor::CpuImageProcessor()
+    : thread_(&CpuImageProcessor::ThreadLoop, this) {}
+
+CpuImageProcessor::~CpuImageProcessor() {
+  {
+    std::lock_guard<std::mutex> lock(mailbox_mutex_);
+    stopping_ = true;
+  }
+  mailbox_changed_.notify_all();
+  thread_.join();
+  ArImage_release(queued_image_);
+}
+
+void CpuImageProcessor::Submit(ArImage* image, const CpuImagePlane& luminance,
+                               const ImageRegion& region,
+                               const KernelParams& params,
+                               int64_t timestamp_ns,
+                               const TensorSource* tensor_source) {
+  ArImage* stale_image = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(mailbox_mutex_);
+    stale_image = queued_image_;
+    queued_image_ = image;
+    queued_luminance_ = luminance;
+    queued_region_ = region;
+    queued_params_ = params;
+    queued_timestamp_ns_ = timestamp_ns;
+    has_queued_tensor_source_ = tensor_source != nullptr;
+    if (tensor_source != nullptr) {
+      queued_tensor_source_ = *tensor_source;
+    }
+  }
+  mailbox_changed_.notify_all();
+  ArImage_release(stale_image);
+}
+
+void CpuImageProcessor::Process(const CpuImagePlane& luminance,
+                                const ImageRegion& region,
+                                const KernelParams& params,
+                                int64_t timestamp_ns) {
+  std::lock_guard<std::mutex> lock(kernel_mutex_);
+  RunKernel(luminance, region, params, timestamp_ns);
+}
+
+bool CpuImageProcessor::TakeResult(ProcessedCpuImage* out_image) {
+  std::lock_guard<std::mutex> lock(result_mutex_);
+  if (!has_result_) {
+    return false;
+  }
+  *out_image = result_;
+  back_buffer_ = 1 - back_buffer_;
+  has_result_ = false;
+  return true;
+}
+
+bool CpuImageProcessor::SetKernelChain(const std::vector<std::string>& names) {
+  std::lock_guard<std::mutex> lock(kernel_mutex_);
+  return pipeline_.SetChain(names);
+}
+
+void CpuImageProcessor::ReleaseImages() {
+  ArImage* queued_image = nullptr;
+  {
+    std::unique_lock<std::mutex> lock(mailbox_mutex_);
+    queued_image = queued_image_;
+    queued_image_ = nullptr;
+    mailbox_changed_.wait(lock, [this] { return !processing_; });
+  }
+  ArImage_release(queued_image);
+}
+
+void CpuImageProcessor::ThreadLoop() {
+  while (true) {
+    ArImage* image = nullptr;
+    CpuImagePlane luminance;
+    ImageRegion region;
+    KernelParams params;
+    int64_t timestamp_ns = 0;
+    bool has_tensor_source = false;
+    TensorSource tensor_source;
+    {
+      std::unique_lock<std::mutex> lock(mailbox_mutex_);
+      mailbox_changed_.wait(
+          lock, [this] { return stopping_ || queued_image_ != nullptr; });
+      if (stopping_) {
+        return;
+      }
+      image = queued_image_;
+      luminance = queued_luminance_;
+      region = queued_region_;
+      params = queued_params_;
+      timestamp_ns = queued_timestamp_ns_;
+      has_tensor_source = has_queued_tensor_source_;
+      tensor_source = queued_tensor_source_;
+      queued_image_ = nullptr;
+      processing_ = true;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(kernel_mutex_);
+      RunKernel(luminance, region, params, timestamp_ns);
+      // Under kernel_mutex_ for the worker pool, which Process() shares.
+      if (has_tensor_source && tensor_stager_ != nullptr) {
+        tensor_stager_->Stage(tensor_source, &worker_pool_);
+      }
+    }
+    ArImage_release(image);
+
+    {
+      std::lock_guard<std::mutex> lock(mailbox_mutex_);
+      processing_ = false;
+    }
+    mailbox_changed_.notify_all();
+  }
+}
+
+void CpuImageProcessor::RunKernel(const CpuImagePlane& luminance,
+                                  const ImageRegion& region,
+                                  const KernelParams& params,
+                                  int64_t timestamp_ns) {
+  const auto start = std::chrono::steady_clock::now();
+  // The region is given in pixels of the full resolution image.
+  pyramid_.Reset(luminance);
+  const int level = pyramid_.BuildLevel(pyramid_level_);
+  const CpuImagePlane& plane = pyramid_.GetLevel(level);
+  const int32_t scale = 1 << level;
+  ImageRegion level_region;
+  level_region.left = region.left / scale;
+  level_region.top = region.top / scale;
+  level_region.right =
+      std::min(plane.width, (region.right + scale - 1) / scale);
+  level_region.bottom =
+      std::min(plane.height, (region.bottom + scale - 1) / scale);
+
+  int back_buffer = 0;
+  {
+    // A result nobody took yet is about to be overwritten.
+    std::lock_guard<std::mutex> lock(result_mutex_);
+    has_result_ = false;
+    back_buffer = back_buffer_;
+  }
+  // Without a result the back buffer cannot flip, so it is written without
+  // the mutex.  Locking a hardware buffer waits for the GPU to finish reading
+  // it.
+  uint8_t* output_pixels = nullptr;
+  if (overlay_buffers_ != nullptr) {
+    output_pixels =
+        overlay_buffers_->LockForWrite(back_buffer, plane.width, plane.height);
+  }
+  const bool in_hardware_buffer = output_pixels != nullptr;
+  if (!in_hardware_buffer) {
+    std::vector<uint8_t>& buffer = buffers_[back_buffer];
+    buffer.resize(plane.width * plane.height);
+    output_pixels = buffer.data();
+  }
+
+  KernelParams level_params = params;
+  int32_t contrast = -1;
+  if (contrast_adaptive_thresholds_) {
+    LuminanceStats stats;
+    histogram_.Compute(plane, level_region, kHistogramStep, &worker_pool_,
+                       &stats);
+    contrast = stats.GetContrast();
+    level_params = ScaleKernelParamsForContrast(params, contrast);
+  }
+
+  KernelTimings timings;
+  pipeline_.Run(plane, level_region, level_params, &worker_pool_,
+                output_pixels, &timings);
+  if (in_hardware_buffer) {
+    overlay_buffers_->Unlock(back_buffer);
+  }
+
+  std::lock_guard<std::mutex> lock(result_mutex_);
+  result_.pixels = in_hardware_buffer ? nullptr : output_pixels;
+  result_.hardware_buffer_index = in_hardware_buffer ? back_buffer : -1;
+  result_.width = plane.width;
+  result_.height = plane.height;
+  result_.region = level_region;
+  result_.timestamp_ns = timestamp_ns;
+  result_.timings = timings;
+  result_.params = level_params;
+  result_.contrast = contrast;
+  result_.processing_ms = std::chrono::duration<float, std::milli>(
+                              std::chrono::steady_clock::now() - start)
+                              .count();
+  has_result_ = true;
+}
+
+}  // namespace computer_vision
@@ -0,0 +1,163 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_COMPUTER_VISION_CPU_IMAGE_PROCESSOR_H_
+#define C_ARCORE_COMPUTER_VISION_CPU_IMAGE_PROCESSOR_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>  // NOLINT
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "arcore_c_api.h"
+#include "cpu_image_renderer.h"
+#include "edge_detector.h"
+#include "image_pyramid.h"
+#include "kernel_pipeline.h"
+#include "luminance_histogram.h"
+#include "tensor_stager.h"
+#include "worker_pool.h"
+
+namespace computer_vision {
+
+// Runs the kernel chain on camera images off the OpenGL thread, so that
+// rendering keeps the camera rate when the processing is slower.
+//
+// Images are handed over through a single-slot mailbox: an image that is still
+// waiting when a newer one arrives is released unprocessed.  Results are
+// written into the back one of two buffers and swapped to the front by
+// TakeResult(), a result that is not taken before the next one starts is
+// dropped as well.
+class CpuImageProcessor {
+ public:
+  CpuImageProcessor();
+  ~CpuImageProcessor();
+
+  CpuImageProcessor(const CpuImageProcessor&) = delete;
+  CpuImageProcessor& operator=(const CpuImageProcessor&) = delete;
+
+  // Queues |image| for processing and takes ownership of it.  |luminance| is
+  // its Y plane, e.g. from CpuImageRenderer::GetLuminancePlane().  Only the
+  // pixels in |region| are processed, with the kernels adapted to the image
+  // by |params|.  The result carries |timestamp_ns|, the camera timestamp of
+  // the image.  If |tensor_source| is given, its planes of |image| are staged
+  // into the tensor stager after the kernels ran, while the image is held.
+  void Submit(ArImage* image, const CpuImagePlane& luminance,
+              const ImageRegion& region, const KernelParams& params,
+              int64_t timestamp_ns,
+              const TensorSource* tensor_source = nullptr);
+
+  // Processes |region| of |luminance| on the calling thread, for planes that
+  // are only valid during the call such as a locked camera hardware buffer.
+  // The result is taken like the ones of Submit().
+  void Process(const CpuImagePlane& luminance, const ImageRegion& region,
+               const KernelParams& params, int64_t timestamp_ns);
+
+  // Returns the latest result in |out_image| if there is one that has not been
+  // taken yet.  The pixels stay valid until the next call.  Must only be
+  // called from one thread.
+  bool TakeResult(ProcessedCpuImage* out_image);
+
+  // Runs the edge detection on |level| of the image pyramid, 0 being the full
+  // resolution, each further level halving it.  Results then have the size of
+  // that level and are upsampled when drawn.  May be called from any thread.
+  void SetPyramidLevel(int level) { pyramid_level_ = level; }
+
+  // Scales the kernel parameters of every image with the contrast of the
+  // processed region, see ScaleKernelParamsForContrast().  May be called
+  // from any thread.
+  void SetContrastAdaptiveThresholds(bool enabled) {
+    contrast_adaptive_thresholds_ = enabled;
+  }
+
+  // Replaces the kernel chain, see KernelPipeline::SetChain().  Waits for the
+  // image being processed.  May be called from any thread.
+  bool SetKernelChain(const std::vector<std::string>& names);
+
+  // Stages the tensor sources of submitted images into |tensor_stager|,
+  // which must outlive the processor.  Must be called before the first
+  // Submit().
+  void SetTensorStager(TensorStager* tensor_stager) {
+    tensor_stager_ = tensor_stager;
+  }
+
+  // Writes the results into |overlay_buffers|, which must outlive the
+  // processor, when they can be, so the renderer samples them without an
+  // upload.  Must be called before the first Submit().
+  void SetOverlayHardwareBuffers(OverlayHardwareBuffers* overlay_buffers) {
+    overlay_buffers_ = overlay_buffers;
+  }
+
+  // Releases the queued image and waits for the one being processed, which
+  // ARCore requires before the camera config changes.  Images submitted
+  // afterwards are processed as usual.
+  void ReleaseImages();
+
+ private:
+  void ThreadLoop();
+
+  // Runs the kernel chain on |region| of |luminance| into the back buffer and
+  // publishes it.  Called with kernel_mutex_ held.
+  void RunKernel(const CpuImagePlane& luminance, const ImageRegion& region,
+                 const KernelParams& params, int64_t timestamp_ns);
+
+  // Runs the kernels over bands of image rows.
+  WorkerPool worker_pool_;
+  // Serializes RunKernel() between the processing thread and Process(), and
+  // guards pipeline_.
+  std::mutex kernel_mutex_;
+  KernelPipeline pipeline_;
+  // Pyramid of the image RunKernel() processes.
+  ImagePyramid pyramid_;
+  std::atomic<int> pyramid_level_{0};
+  // Luminance statistics of the image RunKernel() processes.
+  LuminanceHistogram histogram_;
+  std::atomic<bool> contrast_adaptive_thresholds_{false};
+  TensorStager* tensor_stager_ = nullptr;
+  OverlayHardwareBuffers* overlay_buffers_ = nullptr;
+
+  // Guards the mailbox below.
+  std::mutex mailbox_mutex_;
+  std::condition_variable mailbox_changed_;
+  ArImage* queued_image_ = nullptr;
+  CpuImagePlane queued_luminance_;
+  ImageRegion queued_region_;
+  KernelParams queued_params_;
+  int64_t queued_timestamp_ns_ = 0;
+  bool has_queued_tensor_source_ = false;
+  TensorSource queued_tensor_source_;
+  // Set while the processing thread holds an image.
+  bool processing_ = false;
+  bool stopping_ = false;
+
+  // Guards the result state below.  The front buffer, 1 - back_buffer_,
+  // belongs to the caller of TakeResult().  The same index selects the
+  // hardware buffer of overlay_buffers_ a result is written to.
+  std::mutex result_mutex_;
+  std::vector<uint8_t> buffers_[2];
+  int back_buffer_ = 0;
+  bool has_result_ = false;
+  ProcessedCpuImage result_;
+
+  std::thread thread_;
+};
+
+}  // namespace computer_vision
+
+#endif  // C_ARCORE_COMPUTER_VISION_CPU_IMAGE_PROCESSOR_H_
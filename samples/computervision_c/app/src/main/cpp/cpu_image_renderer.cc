@@ -18,66 +18,36 @@
 // scene.
 #include "cpu_image_renderer.h"
 
+#include <GLES3/gl3.h>
 #include <stdint.h>
 
 #include <algorithm>
+#include <cmath>
+#include <limits>
 
 namespace computer_vision {
 namespace {
-// Positions of the quad vertices in clip space (X, Y).
-const GLfloat kVertices[] = {
-    -1.0f, -1.0f, +1.0f, -1.0f, -1.0f, +1.0f, +1.0f, +1.0f,
-};
-
-constexpr int kSobelEdgeThreshold = 128 * 128;
-constexpr int kCoordsPerVertex = 2;
-constexpr int kTexCoordsPerVertex = 2;
 constexpr char kVertexShaderFilename[] = "shaders/cpu_image.vert";
 constexpr char kFragmentShaderFilename[] = "shaders/cpu_image.frag";
-
-void DetectEdge(const ArSession* session, const ArImage* image, int32_t width,
-                int32_t height, int32_t stride, uint8_t* output_pixels) {
-  const uint8_t* input_pixels = nullptr;
-  int32_t length = 0;
-  ArImage_getPlaneData(session, image, 0, &input_pixels, &length);
-
-  // Detect edges.
-  for (int j = 1; j < height - 1; j++) {
-    for (int i = 1; i < width - 1; i++) {
-      // Offset of the pixel at [i, j] of the input image.
-      int offset = (j * stride) + i;
-
-      // Neighbour pixels around the pixel at [i, j].
-      int a00 = input_pixels[offset - stride - 1];
-      int a01 = input_pixels[offset - stride];
-      int a02 = input_pixels[offset - stride + 1];
-      int a10 = input_pixels[offset - 1];
-      int a12 = input_pixels[offset + 1];
-      int a20 = input_pixels[offset + stride - 1];
-      int a21 = input_pixels[offset + stride];
-      int a22 = input_pixels[offset + stride + 1];
-
-      // Sobel X filter:
-      //   -1, 0, 1,
-      //   -2, 0, 2,
-      //   -1, 0, 1
-      int x_sum = -a00 - (2 * a10) - a20 + a02 + (2 * a12) + a22;
-
-      // Sobel Y filter:
-      //    1, 2, 1,
-      //    0, 0, 0,
-      //   -1, -2, -1
-      int y_sum = a00 + (2 * a01) + a02 - a20 - (2 * a21) - a22;
-
-      if ((x_sum * x_sum) + (y_sum * y_sum) > kSobelEdgeThreshold) {
-        output_pixels[(j * width) + i] = static_cast<uint8_t>(0xFF);
-      } else {
-        output_pixels[(j * width) + i] = static_cast<uint8_t>(0x1F);
-      }
-    }
-  }
+// Pixels processed around the visible region, which covers the rounding of
+// the nearest texture lookups at its edges.
+constexpr int32_t kVisibleRegionMargin = 2;
+// Outline of the screen quad as indices of its triangle strip corners.
+constexpr int kQuadOutline[] = {0, 1, 3, 2};
+
+// Dimensions of the CPU image, which the GPU path produces without ever
+// acquiring it.
+void GetCpuImageDimensions(const ArSession* session, const ArFrame* frame,
+                           int32_t* width, int32_t* height) {
+  ArCamera* camera = nullptr;
+  ArFrame_acquireCamera(session, frame, &camera);
+  ArCameraIntrinsics* intrinsics = nullptr;
+  ArCameraIntrinsics_create(session, &intrinsics);
+  ArCamera_getImageIntrinsics(session, camera, intrinsics);
+  ArCameraIntrinsics_getImageDimensions(session, intrinsics, width, height);
+  ArCameraIntrinsics_destroy(intrinsics);
+  ArCamera_release(camera);
 }
-
 }  // namespace
 
 void CpuImageRenderer::InitializeGlContent(AAssetManager* asset_manager) {
@@ -96,6 +66,14 @@ void CpuImageRenderer::InitializeGlContent(AAssetManager* asset_manager) {
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  // Results of the lower pyramid levels are upsampled by the sampler.
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  overlay_width_ = 0;
+  overlay_height_ = 0;
+  overlay_buffer_index_ = -1;
+  if (overlay_buffers_ != nullptr) {
+    overlay_buffers_->InitializeGlContent();
+  }
 
   shader_program_ = util::CreateProgram(asset_manager, kVertexShaderFilename,
                                         kFragmentShaderFilename);
@@ -113,39 +91,28 @@ void CpuImageRenderer::InitializeGlContent(AAssetManager* asset_manager) {
   glUniform1i(tex_loc, 0);
   tex_loc = glGetUniformLocation(shader_program_, "TexCpuImageGrayscale");
   glUniform1i(tex_loc, 1);
+
+  quad_.InitializeGlContent(kNumUvSets);
+  uvs_initialized_ = false;
+
+  gpu_edge_detector_.InitializeGlContent(asset_manager);
 }
 
 void CpuImageRenderer::Draw(const ArSession* session, const ArFrame* frame,
-                            const ArImage* image, float screen_aspect_ratio,
-                            int display_rotation, float splitter_pos) {
-  // Try to get the ar image and get the post-processed edge detection image.
-  ArImageFormat format;
-  int32_t width = 0, height = 0, num_plane = 0, stride = 0;
-  bool is_valid_cpu_image = false;
-  // No need to compute edge detection as it is not being displayed if the
-  // splitter position is one.
-  if ((image != nullptr) && (splitter_pos < 1.0)) {
-    ArImage_getFormat(session, image, &format);
-    ArImage_getWidth(session, image, &width);
-    ArImage_getHeight(session, image, &height);
-    ArImage_getNumberOfPlanes(session, image, &num_plane);
-    ArImage_getPlaneRowStride(session, image, 0, &stride);
-
-    if (format == AR_IMAGE_FORMAT_YUV_420_888) {
-      if (width > 0 || height > 0 || num_plane > 0 || stride > 0) {
-        if (processed_image_bytes_grayscale_ == nullptr ||
-            stride * height > cpu_image_buffer_size_) {
-          cpu_image_buffer_size_ = stride * height;
-          processed_image_bytes_grayscale_ =
-              std::unique_ptr<uint8_t[]>(new uint8_t[cpu_image_buffer_size_]);
-        }
-        DetectEdge(session, image, width, height, stride,
-                   processed_image_bytes_grayscale_.get());
-        is_valid_cpu_image = true;
-      }
-    } else {
-      LOGE("Expected image in YUV_420_888 format.");
+                            const ProcessedCpuImage* processed_image,
+                            float screen_aspect_ratio, int display_rotation,
+                            float splitter_pos) {
+  // Run the GPU edge detection.  No need to compute it as it is not being
+  // displayed if the splitter position is one.
+  GLuint gpu_overlay_texture = 0;
+  if (use_gpu_edge_detection_ && gpu_edge_detector_.IsSupported()) {
+    if (splitter_pos < 1.0) {
+      int32_t width = 0, height = 0;
+      GetCpuImageDimensions(session, frame, &width, &height);
+      gpu_overlay_texture =
+          gpu_edge_detector_.Run(session, frame, texture_id_, width, height);
     }
+    processed_image = nullptr;
   }
 
   // No need to test or write depth, the screen quad has arbitrary depth, and is
@@ -156,42 +123,86 @@ void CpuImageRenderer::Draw(const ArSession* session, const ArFrame* frame,
   glActiveTexture(GL_TEXTURE0);
   glBindTexture(GL_TEXTURE_EXTERNAL_OES, texture_id_);
 
-  // Update CPU image & GPU texture coordinates.
-  ArFrame_transformCoordinates2d(
-      session, frame, AR_COORDINATES_2D_OPENGL_NORMALIZED_DEVICE_COORDINATES,
-      kNumVertices, kVertices, AR_COORDINATES_2D_IMAGE_NORMALIZED,
-      transformed_img_coord_);
-  ArFrame_transformCoordinates2d(
-      session, frame, AR_COORDINATES_2D_OPENGL_NORMALIZED_DEVICE_COORDINATES,
-      kNumVertices, kVertices, AR_COORDINATES_2D_TEXTURE_NORMALIZED,
-      transformed_tex_coord_);
-
-  if (is_valid_cpu_image) {
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, overlay_texture_id_);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, width, height, 0, GL_LUMINANCE,
-                 GL_UNSIGNED_BYTE, processed_image_bytes_grayscale_.get());
+  // Update CPU image & GPU texture coordinates.  Both only change with the
+  // display rotation or the view size.
+  int32_t geometry_changed = 0;
+  ArFrame_getDisplayGeometryChanged(session, frame, &geometry_changed);
+  if (geometry_changed != 0 || !uvs_initialized_) {
+    float transformed_coords[util::ScreenQuad::kNumUvComponents];
+    util::ScreenQuad::TransformCorners(session, frame,
+                                       AR_COORDINATES_2D_TEXTURE_NORMALIZED,
+                                       transformed_coords);
+    quad_.SetUvs(kTexCoordUvSet, transformed_coords);
+    util::ScreenQuad::TransformCorners(session, frame,
+                                       AR_COORDINATES_2D_IMAGE_NORMALIZED,
+                                       transformed_coords);
+    quad_.SetUvs(kImgCoordUvSet, transformed_coords);
+    uvs_initialized_ = true;
   }
-  glUseProgram(shader_program_);
 
-  // Set the vertex positions.
-  glVertexAttribPointer(attribute_position_, kCoordsPerVertex, GL_FLOAT,
-                        GL_FALSE, 0, kVertices);
+  // The GPU output holds the same gray levels as the processed CPU image.
+  // A processed image in a hardware buffer is sampled where the kernels wrote
+  // it.
+  if (processed_image != nullptr) {
+    overlay_buffer_index_ = processed_image->hardware_buffer_index;
+  }
+  GLuint overlay_texture = overlay_texture_id_;
+  int sampled_buffer_index = -1;
+  if (gpu_overlay_texture != 0) {
+    overlay_texture = gpu_overlay_texture;
+  } else if (overlay_buffer_index_ >= 0 && overlay_buffers_ != nullptr) {
+    const GLuint buffer_texture =
+        overlay_buffers_->GetTexture(overlay_buffer_index_);
+    if (buffer_texture != 0) {
+      overlay_texture = buffer_texture;
+      sampled_buffer_index = overlay_buffer_index_;
+    }
+  }
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, overlay_texture);
+  if (processed_image != nullptr &&
+      processed_image->hardware_buffer_index < 0) {
+    if (processed_image->width != overlay_width_ ||
+        processed_image->height != overlay_height_) {
+      overlay_width_ = processed_image->width;
+      overlay_height_ = processed_image->height;
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, overlay_width_,
+                   overlay_height_, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, nullptr);
+    }
+    // Only the processed region is uploaded, its rows are a full image width
+    // apart.
+    const ImageRegion& region = processed_image->region;
+    if (!region.IsEmpty()) {
+      glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+      glPixelStorei(GL_UNPACK_ROW_LENGTH, processed_image->width);
+      glTexSubImage2D(
+          GL_TEXTURE_2D, 0, region.left, region.top,
+          region.right - region.left, region.bottom - region.top,
+          GL_LUMINANCE, GL_UNSIGNED_BYTE,
+          processed_image->pixels + region.top * processed_image->width +
+              region.left);
+      glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+      glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+  }
+  glUseProgram(shader_program_);
 
   // Set splitter position.
   glUniform1f(uniform_spliter_, splitter_pos);
-  glVertexAttribPointer(attribute_tex_coord_, kTexCoordsPerVertex, GL_FLOAT,
-                        GL_FALSE, 0, transformed_tex_coord_);
-
-  glVertexAttribPointer(attribute_img_coord_, kTexCoordsPerVertex, GL_FLOAT,
-                        GL_FALSE, 0, transformed_img_coord_);
 
   // Enable vertex arrays
   glEnableVertexAttribArray(attribute_position_);
   glEnableVertexAttribArray(attribute_tex_coord_);
   glEnableVertexAttribArray(attribute_img_coord_);
 
-  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+  const GLuint uv_attribs[kNumUvSets] = {attribute_tex_coord_,
+                                         attribute_img_coord_};
+  quad_.Draw(attribute_position_, uv_attribs);
+
+  // The processor must not write the buffer again before this draw read it.
+  if (sampled_buffer_index >= 0) {
+    overlay_buffers_->FenceRead(sampled_buffer_index);
+  }
 
   // Disable vertex arrays
   glDisableVertexAttribArray(attribute_position_);
@@ -204,6 +215,87 @@ void CpuImageRenderer::Draw(const ArSession* session, const ArFrame* frame,
   util::CheckGlError("CpuImageRenderer::Draw() error");
 }
 
+ImageRegion CpuImageRenderer::GetVisibleImageRegion(float splitter_pos,
+                                                    int32_t width,
+                                                    int32_t height) const {
+  ImageRegion region;
+  if (!uvs_initialized_) {
+    region.right = width;
+    region.bottom = height;
+    return region;
+  }
+
+  // The overlay is drawn where the texture x coordinate is at least
+  // |splitter_pos|.  Both coordinate sets are affine across the quad, so
+  // clipping its outline at that line and taking the image coordinates of the
+  // clipped outline bounds the visible part of the image.
+  const float* tex_coords = quad_.GetUvs(kTexCoordUvSet);
+  const float* img_coords = quad_.GetUvs(kImgCoordUvSet);
+  float min_x = std::numeric_limits<float>::max();
+  float min_y = std::numeric_limits<float>::max();
+  float max_x = std::numeric_limits<float>::lowest();
+  float max_y = std::numeric_limits<float>::lowest();
+  auto add_point = [&](float x, float y) {
+    min_x = std::min(min_x, x);
+    min_y = std::min(min_y, y);
+    max_x = std::max(max_x, x);
+    max_y = std::max(max_y, y);
+  };
+  const int num_corners = util::ScreenQuad::kNumVertices;
+  for (int i = 0; i < num_corners; ++i) {
+    const int a = kQuadOutline[i];
+    const int b = kQuadOutline[(i + 1) % num_corners];
+    const float distance_a = tex_coords[2 * a] - splitter_pos;
+    const float distance_b = tex_coords[2 * b] - splitter_pos;
+    if (distance_a >= 0.f) {
+      add_point(img_coords[2 * a], img_coords[2 * a + 1]);
+    }
+    if ((distance_a >= 0.f) != (distance_b >= 0.f)) {
+      const float t = distance_a / (distance_a - distance_b);
+      add_point(
+          img_coords[2 * a] + t * (img_coords[2 * b] - img_coords[2 * a]),
+          img_coords[2 * a + 1] +
+              t * (img_coords[2 * b + 1] - img_coords[2 * a + 1]));
+    }
+  }
+  if (min_x > max_x) {
+    return region;
+  }
+
+  const int32_t margin = kVisibleRegionMargin;
+  region.left =
+      std::max(0, static_cast<int32_t>(std::floor(min_x * width)) - margin);
+  region.top =
+      std::max(0, static_cast<int32_t>(std::floor(min_y * height)) - margin);
+  region.right =
+      std::min(width, static_cast<int32_t>(std::ceil(max_x * width)) + margin);
+  region.bottom = std::min(
+      height, static_cast<int32_t>(std::ceil(max_y * height)) + margin);
+  return region;
+}
+
+bool CpuImageRenderer::GetLuminancePlane(const ArSession* session,
+                                         const ArImage* image,
+                                         CpuImagePlane* out_plane) {
+  if (image == nullptr) {
+    return false;
+  }
+  ArImageFormat format;
+  int32_t num_plane = 0, length = 0;
+  ArImage_getFormat(session, image, &format);
+  if (format != AR_IMAGE_FORMAT_YUV_420_888) {
+    LOGE("Expected image in YUV_420_888 format.");
+    return false;
+  }
+  ArImage_getWidth(session, image, &out_plane->width);
+  ArImage_getHeight(session, image, &out_plane->height);
+  ArImage_getNumberOfPlanes(session, image, &num_plane);
+  ArImage_getPlaneRowStride(session, image, 0, &out_plane->stride);
+  ArImage_getPlaneData(session, image, 0, &out_plane->pixels, &length);
+  return out_plane->width > 0 && out_plane->height > 0 && num_plane > 0 &&
+         out_plane->stride > 0 && out_plane->pixels != nullptr;
+}
+
 GLuint CpuImageRenderer::GetTextureId() const { return texture_id_; }
 
 }  // namespace computer_vision
@@ -21,13 +21,49 @@
 #include <GLES2/gl2ext.h>
 #include <android/asset_manager.h>
 #include <media/NdkImage.h>
+#include <cstdint>
 #include <memory>
 
 #include "arcore_c_api.h"
+#include "edge_detector.h"
+#include "gpu_edge_detector.h"
+#include "overlay_hardware_buffers.h"
 #include "util.h"
+#include "vision_kernel.h"
 
 namespace computer_vision {
 
+// Luminance plane of a camera frame, read either from an ArImage or from a
+// locked camera AHardwareBuffer.
+struct CpuImagePlane {
+  const uint8_t* pixels = nullptr;
+  int32_t width = 0;
+  int32_t height = 0;
+  int32_t stride = 0;
+};
+
+// Edge detection result of one camera frame, rows of |width| bytes of which
+// only |region| is valid.
+struct ProcessedCpuImage {
+  const uint8_t* pixels = nullptr;
+  int32_t width = 0;
+  int32_t height = 0;
+  ImageRegion region;
+  // Camera timestamp of the processed image, in nanoseconds.
+  int64_t timestamp_ns = 0;
+  // Time the edge detection took, in milliseconds.
+  float processing_ms = 0.f;
+  // Time every step of the kernel chain took.
+  KernelTimings timings;
+  // The thresholds the chain ran with, and the contrast of the image they
+  // were adapted to, or -1 if they were not.
+  KernelParams params;
+  int32_t contrast = -1;
+  // Index of the OverlayHardwareBuffers buffer that holds the image instead
+  // of |pixels|, or -1.
+  int hardware_buffer_index = -1;
+};
+
 // This class renders both the pass through camera image and the post-processed
 // cpu image.
 class CpuImageRenderer {
@@ -39,31 +75,83 @@ class CpuImageRenderer {
   // other methods below.
   void InitializeGlContent(AAssetManager* asset_manager);
 
-  // Draws the pass through camera image and CPU image.
+  // Draws the pass through camera image and the processed CPU image.
+  // |processed_image| is uploaded if not null, or sampled in place if it is
+  // in a hardware buffer, otherwise the previous one is drawn again.  It is
+  // not used while the edges are detected on the GPU.
   void Draw(const ArSession* session, const ArFrame* frame,
-            const ArImage* image, float screen_aspect_ratio,
-            int display_rotation, float splitter_pos);
+            const ProcessedCpuImage* processed_image,
+            float screen_aspect_ratio, int display_rotation,
+            float splitter_pos);
+
+  // Returns the pixels of a |width| x |height| CPU image that are visible with
+  // |splitter_pos|, plus a margin for the rounding of the texture lookups.
+  // The whole image until the first Draw() call has set up the texture
+  // coordinates.  Only processing this region keeps the cost proportional to
+  // the area on screen.
+  ImageRegion GetVisibleImageRegion(float splitter_pos, int32_t width,
+                                    int32_t height) const;
+
+  // Returns the Y plane of |image| in |out_plane|, or false if |image| is not
+  // a valid YUV_420_888 image.
+  static bool GetLuminancePlane(const ArSession* session, const ArImage* image,
+                                CpuImagePlane* out_plane);
 
   // Returns the generated texture name for the GL_TEXTURE_EXTERNAL_OES target.
   GLuint GetTextureId() const;
 
+  // Whether the OpenGL context can run the compute shader edge detection.
+  bool IsGpuEdgeDetectionSupported() const {
+    return gpu_edge_detector_.IsSupported();
+  }
+
+  // Detects the edges with the compute shader on the camera texture instead of
+  // on the CPU image.  Ignored if IsGpuEdgeDetectionSupported() is false.
+  void SetUseGpuEdgeDetection(bool use_gpu) {
+    use_gpu_edge_detection_ = use_gpu;
+  }
+
+  // Samples processed images in |overlay_buffers|, which must outlive the
+  // renderer, instead of uploading them.  Must be called before
+  // InitializeGlContent().
+  void SetOverlayHardwareBuffers(OverlayHardwareBuffers* overlay_buffers) {
+    overlay_buffers_ = overlay_buffers;
+  }
+
+  // Duration of the latest compute dispatch as measured by the GPU, in
+  // milliseconds.  Negative until it is known.
+  float GetGpuEdgeDetectionTimeMs() const {
+    return gpu_edge_detector_.GetGpuTimeMs();
+  }
+
  private:
-  static constexpr int kNumVertices = 4;
+  // Texture coordinate sets of quad_.
+  enum UvSet { kTexCoordUvSet = 0, kImgCoordUvSet, kNumUvSets };
 
   GLuint shader_program_;
 
   GLuint texture_id_;
   GLuint overlay_texture_id_;
+  // Size of the overlay texture storage, only sub-rectangles are uploaded.
+  int32_t overlay_width_ = 0;
+  int32_t overlay_height_ = 0;
+  OverlayHardwareBuffers* overlay_buffers_ = nullptr;
+  // Hardware buffer the drawn processed image is in, or -1 if it was
+  // uploaded to overlay_texture_id_.
+  int overlay_buffer_index_ = -1;
 
   GLuint attribute_position_;
   GLuint attribute_tex_coord_;
   GLuint attribute_img_coord_;
   GLuint uniform_spliter_;
 
-  float transformed_tex_coord_[kNumVertices * 2];
-  float transformed_img_coord_[kNumVertices * 2];
-  std::unique_ptr<uint8_t[]> processed_image_bytes_grayscale_;
-  int cpu_image_buffer_size_ = 0;
+  // Holds a_TexCoord and a_ImgCoord, which only change with the display
+  // geometry.
+  util::ScreenQuad quad_;
+  bool uvs_initialized_ = false;
+
+  GpuEdgeDetector gpu_edge_detector_;
+  bool use_gpu_edge_detection_ = false;
 };
 }  // namespace computer_vision
 #endif  // C_ARCORE_COMPUTER_VISION_BACKGROUND_RENDERER_H_
@@ -0,0 +1,266 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "edge_detector.h"
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+
+#include "cpu_features.h"
+#include "util.h"
+
+namespace computer_vision {
+namespace {
+constexpr uint8_t kEdgeValue = 0xFF;
+constexpr uint8_t kNonEdgeValue = 0x1F;
+
+// Detects edges in the columns [i_begin, i_end) of row |j|.
+void DetectEdgeRowScalar(const uint8_t* input_pixels, int32_t width,
+                         int32_t stride, int32_t j, int32_t i_begin,
+                         int32_t i_end, int32_t threshold,
+                         uint8_t* output_pixels) {
+  for (int i = i_begin; i < i_end; i++) {
+    // Offset of the pixel at [i, j] of the input image.
+    int offset = (j * stride) + i;
+
+    // Neighbour pixels around the pixel at [i, j].
+    int a00 = input_pixels[offset - stride - 1];
+    int a01 = input_pixels[offset - stride];
+    int a02 = input_pixels[offset - stride + 1];
+    int a10 = input_pixels[offset - 1];
+    int a12 = input_pixels[offset + 1];
+    int a20 = input_pixels[offset + stride - 1];
+    int a21 = input_pixels[offset + stride];
+    int a22 = input_pixels[offset + stride + 1];
+
+    // Sobel X filter:
+    //   -1, 0, 1,
+    //   -2, 0, 2,
+    //   -1, 0, 1
+    int x_sum = -a00 - (2 * a10) - a20 + a02 + (2 * a12) + a22;
+
+    // Sobel Y filter:
+    //    1, 2, 1,
+    //    0, 0, 0,
+    //   -1, -2, -1
+    int y_sum = a00 + (2 * a01) + a02 - a20 - (2 * a21) - a22;
+
+    if ((x_sum * x_sum) + (y_sum * y_sum) > threshold) {
+      output_pixels[(j * width) + i] = kEdgeValue;
+    } else {
+      output_pixels[(j * width) + i] = kNonEdgeValue;
+    }
+  }
+}
+
+// Detects edges in |region|, which must not include the border pixels.
+void DetectEdgeScalar(const uint8_t* input_pixels, int32_t width,
+                      int32_t stride, const ImageRegion& region,
+                      int32_t threshold, uint8_t* output_pixels) {
+  for (int j = region.top; j < region.bottom; j++) {
+    DetectEdgeRowScalar(input_pixels, width, stride, j, region.left,
+                        region.right, threshold, output_pixels);
+  }
+}
+
+// |region| without the border pixels of a |width| x |height| image.
+ImageRegion GetInnerRegion(int32_t width, int32_t height,
+                           const ImageRegion& region) {
+  ImageRegion inner;
+  inner.left = std::max(region.left, 1);
+  inner.top = std::max(region.top, 1);
+  inner.right = std::min(region.right, width - 1);
+  inner.bottom = std::min(region.bottom, height - 1);
+  return inner;
+}
+
+#if defined(__ARM_NEON)
+constexpr int kNeonPixelsPerIteration = 16;
+
+// Difference of two byte vectors as signed 16 bit lanes.  Wrapping in the
+// unsigned subtraction yields the right two's complement value.
+inline int16x8_t SubtractWide(uint8x8_t a, uint8x8_t b) {
+  return vreinterpretq_s16_u16(vsubl_u8(a, b));
+}
+
+// Sobel response of 8 pixels from the differences of their neighbours:
+// |first| + 2 * |middle| + |last|, at most 4 * 255 in magnitude.
+inline int16x8_t SobelSum(int16x8_t first, int16x8_t middle, int16x8_t last) {
+  return vaddq_s16(vaddq_s16(first, last), vshlq_n_s16(middle, 1));
+}
+
+// All-ones lanes where x^2 + y^2 exceeds the threshold.  The squares need
+// 32 bits.
+inline uint16x8_t IsEdge(int16x8_t x_sum, int16x8_t y_sum,
+                         int32x4_t threshold) {
+  int32x4_t low = vmull_s16(vget_low_s16(x_sum), vget_low_s16(x_sum));
+  low = vmlal_s16(low, vget_low_s16(y_sum), vget_low_s16(y_sum));
+  int32x4_t high = vmull_s16(vget_high_s16(x_sum), vget_high_s16(x_sum));
+  high = vmlal_s16(high, vget_high_s16(y_sum), vget_high_s16(y_sum));
+  return vcombine_u16(vmovn_u32(vcgtq_s32(low, threshold)),
+                      vmovn_u32(vcgtq_s32(high, threshold)));
+}
+
+void DetectEdgeNeon(const uint8_t* input_pixels, int32_t width,
+                    int32_t stride, const ImageRegion& region,
+                    int32_t threshold, uint8_t* output_pixels) {
+  const int32x4_t threshold_lanes = vdupq_n_s32(threshold);
+  const uint8x16_t edge = vdupq_n_u8(kEdgeValue);
+  const uint8x16_t non_edge = vdupq_n_u8(kNonEdgeValue);
+  for (int j = region.top; j < region.bottom; j++) {
+    const uint8_t* above = input_pixels + (j - 1) * stride;
+    const uint8_t* row = input_pixels + j * stride;
+    const uint8_t* below = input_pixels + (j + 1) * stride;
+    uint8_t* output_row = output_pixels + j * width;
+
+    int i = region.left;
+    // The last vector reads up to column i + 16, which must be inside the row
+    // since region.right is at most width - 1.
+    for (; i + kNeonPixelsPerIteration <= region.right;
+         i += kNeonPixelsPerIteration) {
+      const uint8x16_t a00 = vld1q_u8(above + i - 1);
+      const uint8x16_t a01 = vld1q_u8(above + i);
+      const uint8x16_t a02 = vld1q_u8(above + i + 1);
+      const uint8x16_t a10 = vld1q_u8(row + i - 1);
+      const uint8x16_t a12 = vld1q_u8(row + i + 1);
+      const uint8x16_t a20 = vld1q_u8(below + i - 1);
+      const uint8x16_t a21 = vld1q_u8(below + i);
+      const uint8x16_t a22 = vld1q_u8(below + i + 1);
+
+      // Same filters as DetectEdgeRowScalar(), as differences of the
+      // opposite neighbours.
+      const int16x8_t x_low =
+          SobelSum(SubtractWide(vget_low_u8(a02), vget_low_u8(a00)),
+                   SubtractWide(vget_low_u8(a12), vget_low_u8(a10)),
+                   SubtractWide(vget_low_u8(a22), vget_low_u8(a20)));
+      const int16x8_t x_high =
+          SobelSum(SubtractWide(vget_high_u8(a02), vget_high_u8(a00)),
+                   SubtractWide(vget_high_u8(a12), vget_high_u8(a10)),
+                   SubtractWide(vget_high_u8(a22), vget_high_u8(a20)));
+      const int16x8_t y_low =
+          SobelSum(SubtractWide(vget_low_u8(a00), vget_low_u8(a20)),
+                   SubtractWide(vget_low_u8(a01), vget_low_u8(a21)),
+                   SubtractWide(vget_low_u8(a02), vget_low_u8(a22)));
+      const int16x8_t y_high =
+          SobelSum(SubtractWide(vget_high_u8(a00), vget_high_u8(a20)),
+                   SubtractWide(vget_high_u8(a01), vget_high_u8(a21)),
+                   SubtractWide(vget_high_u8(a02), vget_high_u8(a22)));
+
+      const uint8x16_t is_edge =
+          vcombine_u8(vmovn_u16(IsEdge(x_low, y_low, threshold_lanes)),
+                      vmovn_u16(IsEdge(x_high, y_high, threshold_lanes)));
+      vst1q_u8(output_row + i, vbslq_u8(is_edge, edge, non_edge));
+    }
+    DetectEdgeRowScalar(input_pixels, width, stride, j, i, region.right,
+                        threshold, output_pixels);
+  }
+}
+
+#ifndef NDEBUG
+// Checks once that the NEON path matches the scalar one on real input.
+void VerifyNeonEdgeDetection(const uint8_t* input_pixels, int32_t width,
+                             int32_t stride, const ImageRegion& region,
+                             int32_t threshold, const uint8_t* neon_output) {
+  static std::atomic<bool> verified{false};
+  if (region.IsEmpty() || verified.exchange(true)) {
+    return;
+  }
+  // The scalar rows are written at the same offsets as in the full image.
+  std::unique_ptr<uint8_t[]> scalar_output(new uint8_t[width * region.bottom]);
+  DetectEdgeScalar(input_pixels, width, stride, region, threshold,
+                   scalar_output.get());
+  for (int j = region.top; j < region.bottom; j++) {
+    const int offset = j * width + region.left;
+    if (memcmp(neon_output + offset, scalar_output.get() + offset,
+               region.right - region.left) != 0) {
+      LOGE("DetectEdge: NEON output differs from the scalar one in row %d", j);
+      return;
+    }
+  }
+}
+#endif  // NDEBUG
+#endif  // __ARM_NEON
+}  // namespace
+
+void DetectEdge(const uint8_t* input_pixels, int32_t width, int32_t height,
+                int32_t stride, uint8_t* output_pixels) {
+  ImageRegion region;
+  region.right = width;
+  region.bottom = height;
+  DetectEdgeRegion(input_pixels, width, height, stride, region,
+                   kSobelEdgeThreshold, output_pixels);
+}
+
+void DetectEdgeRegion(const uint8_t* input_pixels, int32_t width,
+                      int32_t height, int32_t stride,
+                      const ImageRegion& region, int32_t threshold,
+                      uint8_t* output_pixels) {
+  static const EdgeDetectorVariant variant =
+      IsEdgeDetectorVariantSupported(EdgeDetectorVariant::kNeon)
+          ? EdgeDetectorVariant::kNeon
+          : EdgeDetectorVariant::kScalar;
+  DetectEdgeRegionWithVariant(variant, input_pixels, width, height, stride,
+                              region, threshold, output_pixels);
+#if defined(__ARM_NEON) && !defined(NDEBUG)
+  if (variant == EdgeDetectorVariant::kNeon) {
+    const ImageRegion inner = GetInnerRegion(width, height, region);
+    VerifyNeonEdgeDetection(input_pixels, width, stride, inner, threshold,
+                            output_pixels);
+  }
+#endif  // __ARM_NEON && !NDEBUG
+}
+
+bool IsEdgeDetectorVariantSupported(EdgeDetectorVariant variant) {
+  switch (variant) {
+    case EdgeDetectorVariant::kScalar:
+      return true;
+    case EdgeDetectorVariant::kNeon:
+#if defined(__ARM_NEON)
+      return IsNeonSupported();
+#else
+      return false;
+#endif  // __ARM_NEON
+  }
+  return false;
+}
+
+void DetectEdgeRegionWithVariant(EdgeDetectorVariant variant,
+                                 const uint8_t* input_pixels, int32_t width,
+                                 int32_t height, int32_t stride,
+                                 const ImageRegion& region, int32_t threshold,
+                                 uint8_t* output_pixels) {
+  const ImageRegion inner = GetInnerRegion(width, height, region);
+  if (inner.IsEmpty()) {
+    return;
+  }
+#if defined(__ARM_NEON)
+  if (variant == EdgeDetectorVariant::kNeon) {
+    DetectEdgeNeon(input_pixels, width, stride, inner, threshold,
+                   output_pixels);
+    return;
+  }
+#endif  // __ARM_NEON
+  DetectEdgeScalar(input_pixels, width, stride, inner, threshold,
+                   output_pixels);
+}
+
+}  // namespace computer_vision
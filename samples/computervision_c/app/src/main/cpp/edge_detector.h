@@ -0,0 +1,82 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_COMPUTER_VISION_EDGE_DETECTOR_H_
+#define C_ARCORE_COMPUTER_VISION_EDGE_DETECTOR_H_
+
+#include <cstdint>
+
+namespace computer_vision {
+
+// Pixels [left, right) x [top, bottom) of an image.
+struct ImageRegion {
+  int32_t left = 0;
+  int32_t top = 0;
+  int32_t right = 0;
+  int32_t bottom = 0;
+
+  bool IsEmpty() const { return left >= right || top >= bottom; }
+
+  bool operator==(const ImageRegion& other) const {
+    return left == other.left && top == other.top && right == other.right &&
+           bottom == other.bottom;
+  }
+  bool operator!=(const ImageRegion& other) const { return !(*this == other); }
+};
+
+// Squared Sobel gradient magnitude above which DetectEdge() marks an edge.
+constexpr int32_t kSobelEdgeThreshold = 128 * 128;
+
+// Luminance difference to the center above which a pixel of the FAST circle
+// is brighter or darker, see ScoreFastCornersRegion().
+constexpr int32_t kFastThreshold = 20;
+
+// Marks the pixels of a luminance image whose Sobel gradient exceeds
+// kSobelEdgeThreshold with 0xFF and all others with 0x1F.  |input_pixels| has
+// rows of |stride| bytes, |output_pixels| rows of |width| bytes.  The border
+// pixels of the output are not written.
+//
+// Uses NEON when the CPU supports it, 16 pixels at a time, and the scalar loop
+// otherwise.  Both produce the same bytes.
+void DetectEdge(const uint8_t* input_pixels, int32_t width, int32_t height,
+                int32_t stride, uint8_t* output_pixels);
+
+// DetectEdge() for the output pixels in |region| only, which reads one pixel
+// of the input around them, with the squared gradient |threshold|, e.g. one
+// adapted to the image noise.  Disjoint regions can be processed
+// concurrently.
+void DetectEdgeRegion(const uint8_t* input_pixels, int32_t width,
+                      int32_t height, int32_t stride,
+                      const ImageRegion& region, int32_t threshold,
+                      uint8_t* output_pixels);
+
+// Implementations of DetectEdgeRegion(), which uses the fastest one the CPU
+// supports.  Exposed to compare them, e.g. in RunKernelBenchmark().
+enum class EdgeDetectorVariant { kScalar, kNeon };
+
+// Whether |variant| was compiled in and the CPU can run it.
+bool IsEdgeDetectorVariantSupported(EdgeDetectorVariant variant);
+
+// DetectEdgeRegion() with |variant|, which must be supported.
+void DetectEdgeRegionWithVariant(EdgeDetectorVariant variant,
+                                 const uint8_t* input_pixels, int32_t width,
+                                 int32_t height, int32_t stride,
+                                 const ImageRegion& region, int32_t threshold,
+                                 uint8_t* output_pixels);
+
+}  // namespace computer_vision
+
+#endif  // C_ARCORE_COMPUTER_VISION_EDGE_DETECTOR_H_
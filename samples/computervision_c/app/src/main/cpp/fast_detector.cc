@@ -0,0 +1,442 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fast_detector.h"
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+
+#include "cpu_features.h"
+#include "util.h"
+
+namespace computer_vision {
+
+constexpr int KeypointGridParams::kMaxKeypointsPerCell;
+
+namespace {
+// The Bresenham circle of radius 3, clockwise from the top.
+constexpr int kCircleSize = 16;
+constexpr int kCircleX[kCircleSize] = {0, 1,  2,  3,  3,  3,  2,  1,
+                                       0, -1, -2, -3, -3, -3, -2, -1};
+constexpr int kCircleY[kCircleSize] = {-3, -3, -2, -1, 0,  1,  2,  3,
+                                       3,  3,  2,  1,  0, -1, -2, -3};
+constexpr int kCircleRadius = 3;
+constexpr int kArcLength = 9;
+// The top, right, bottom and left points of the circle.  Any 9 contiguous
+// points include two of them.
+constexpr int kCompassPoints[] = {0, 4, 8, 12};
+constexpr int kMinCompassPoints = 2;
+
+// Bands of rows scored per thread of the worker pool, and the fewest rows
+// worth a band of their own.
+constexpr int kBandsPerThread = 4;
+constexpr int32_t kMinRowsPerBand = 32;
+
+// Byte offsets of the circle in an image with rows of |stride| bytes.
+void GetCircleOffsets(int32_t stride, int32_t* offsets) {
+  for (int k = 0; k < kCircleSize; ++k) {
+    offsets[k] = kCircleY[k] * stride + kCircleX[k];
+  }
+}
+
+// |region| without the pixels whose circle leaves a |width| x |height| image.
+ImageRegion GetInnerRegion(int32_t width, int32_t height,
+                           const ImageRegion& region) {
+  ImageRegion inner;
+  inner.left = std::max(region.left, kCircleRadius);
+  inner.top = std::max(region.top, kCircleRadius);
+  inner.right = std::min(region.right, width - kCircleRadius);
+  inner.bottom = std::min(region.bottom, height - kCircleRadius);
+  return inner;
+}
+
+bool PassesCompassTest(const uint8_t* pixel, const int32_t* offsets,
+                       int32_t threshold) {
+  const int center = *pixel;
+  int brighter = 0;
+  int darker = 0;
+  for (int k : kCompassPoints) {
+    const int value = pixel[offsets[k]];
+    brighter += value > center + threshold;
+    darker += value < center - threshold;
+  }
+  return brighter >= kMinCompassPoints || darker >= kMinCompassPoints;
+}
+
+// The score of |pixel|, the largest over all arcs of kArcLength points of the
+// smallest difference to the center along the arc, or 0 if that is not above
+// |threshold|.
+uint8_t ScoreCorner(const uint8_t* pixel, const int32_t* offsets,
+                    int32_t threshold) {
+  int differences[kCircleSize];
+  for (int k = 0; k < kCircleSize; ++k) {
+    differences[k] = pixel[offsets[k]] - *pixel;
+  }
+  int best = threshold;
+  for (int start = 0; start < kCircleSize; ++start) {
+    int brighter = 255;
+    int darker = 255;
+    for (int k = start; k < start + kArcLength; ++k) {
+      const int difference = differences[k % kCircleSize];
+      brighter = std::min(brighter, difference);
+      darker = std::min(darker, -difference);
+    }
+    best = std::max(best, std::max(brighter, darker));
+  }
+  return best > threshold ? static_cast<uint8_t>(best) : 0;
+}
+
+// Scores the inner pixels [i_begin, i_end) of row |j|.
+void ScoreRowScalar(const uint8_t* input_pixels, int32_t width,
+                    int32_t stride, const int32_t* offsets, int32_t j,
+                    int32_t i_begin, int32_t i_end, int32_t threshold,
+                    uint8_t* scores) {
+  const uint8_t* row = input_pixels + j * stride;
+  uint8_t* score_row = scores + j * width;
+  for (int32_t i = i_begin; i < i_end; ++i) {
+    if (PassesCompassTest(row + i, offsets, threshold)) {
+      score_row[i] = ScoreCorner(row + i, offsets, threshold);
+    }
+  }
+}
+
+// Scores |inner|, whose scores must be 0.
+void ScoreScalar(const uint8_t* input_pixels, int32_t width, int32_t stride,
+                 const ImageRegion& inner, int32_t threshold,
+                 uint8_t* scores) {
+  int32_t offsets[kCircleSize];
+  GetCircleOffsets(stride, offsets);
+  for (int32_t j = inner.top; j < inner.bottom; ++j) {
+    ScoreRowScalar(input_pixels, width, stride, offsets, j, inner.left,
+                   inner.right, threshold, scores);
+  }
+}
+
+#if defined(__ARM_NEON)
+constexpr int kNeonPixelsPerIteration = 16;
+
+inline bool AnyLane(uint8x16_t mask) {
+#if defined(__aarch64__)
+  return vmaxvq_u8(mask) != 0;
+#else
+  const uint64x2_t words = vreinterpretq_u64_u8(mask);
+  return (vgetq_lane_u64(words, 0) | vgetq_lane_u64(words, 1)) != 0;
+#endif  // __aarch64__
+}
+
+// Longest run of set lanes of |masks| around the circle, per lane.
+inline uint8x16_t LongestArc(const uint8x16_t* masks) {
+  const uint8x16_t one = vdupq_n_u8(1);
+  uint8x16_t run = vdupq_n_u8(0);
+  uint8x16_t longest = vdupq_n_u8(0);
+  // Once more around for the arcs that wrap, which 8 more points complete.
+  for (int k = 0; k < kCircleSize + kArcLength - 1; ++k) {
+    run = vandq_u8(vaddq_u8(run, one), masks[k % kCircleSize]);
+    longest = vmaxq_u8(longest, run);
+  }
+  return longest;
+}
+
+void ScoreNeon(const uint8_t* input_pixels, int32_t width, int32_t stride,
+               const ImageRegion& inner, int32_t threshold, uint8_t* scores) {
+  int32_t offsets[kCircleSize];
+  GetCircleOffsets(stride, offsets);
+  const uint8x16_t threshold_lanes =
+      vdupq_n_u8(static_cast<uint8_t>(std::min(threshold, 255)));
+  const uint8x16_t min_compass_points = vdupq_n_u8(kMinCompassPoints);
+  const uint8x16_t arc_length = vdupq_n_u8(kArcLength);
+  for (int32_t j = inner.top; j < inner.bottom; ++j) {
+    const uint8_t* row = input_pixels + j * stride;
+    int32_t i = inner.left;
+    // The last vector reads 3 columns past i + 15, which inner.right leaves
+    // inside the row.
+    for (; i + kNeonPixelsPerIteration <= inner.right;
+         i += kNeonPixelsPerIteration) {
+      const uint8_t* pixels = row + i;
+      const uint8x16_t center = vld1q_u8(pixels);
+      // Saturation keeps limits beyond 0 and 255 from passing any pixel.
+      const uint8x16_t bright_limit = vqaddq_u8(center, threshold_lanes);
+      const uint8x16_t dark_limit = vqsubq_u8(center, threshold_lanes);
+      uint8x16_t brighter[kCircleSize];
+      uint8x16_t darker[kCircleSize];
+      // Set lanes are all ones, so subtracting them counts.
+      uint8x16_t bright_count = vdupq_n_u8(0);
+      uint8x16_t dark_count = vdupq_n_u8(0);
+      for (int k : kCompassPoints) {
+        const uint8x16_t circle = vld1q_u8(pixels + offsets[k]);
+        brighter[k] = vcgtq_u8(circle, bright_limit);
+        darker[k] = vcltq_u8(circle, dark_limit);
+        bright_count = vsubq_u8(bright_count, brighter[k]);
+        dark_count = vsubq_u8(dark_count, darker[k]);
+      }
+      if (!AnyLane(vorrq_u8(vcgeq_u8(bright_count, min_compass_points),
+                            vcgeq_u8(dark_count, min_compass_points)))) {
+        continue;
+      }
+      for (int k = 0; k < kCircleSize; ++k) {
+        if (k % 4 != 0) {
+          const uint8x16_t circle = vld1q_u8(pixels + offsets[k]);
+          brighter[k] = vcgtq_u8(circle, bright_limit);
+          darker[k] = vcltq_u8(circle, dark_limit);
+        }
+      }
+      const uint8x16_t corners =
+          vorrq_u8(vcgeq_u8(LongestArc(brighter), arc_length),
+                   vcgeq_u8(LongestArc(darker), arc_length));
+      if (!AnyLane(corners)) {
+        continue;
+      }
+      uint8_t lanes[kNeonPixelsPerIteration];
+      vst1q_u8(lanes, corners);
+      uint8_t* score_row = scores + j * width + i;
+      for (int lane = 0; lane < kNeonPixelsPerIteration; ++lane) {
+        if (lanes[lane] != 0) {
+          score_row[lane] = ScoreCorner(pixels + lane, offsets, threshold);
+        }
+      }
+    }
+    ScoreRowScalar(input_pixels, width, stride, offsets, j, i, inner.right,
+                   threshold, scores);
+  }
+}
+
+#ifndef NDEBUG
+// Checks once that the NEON path matches the scalar one on real input.
+void VerifyNeonScores(const uint8_t* input_pixels, int32_t width,
+                      int32_t stride, const ImageRegion& inner,
+                      int32_t threshold, const uint8_t* neon_scores) {
+  static std::atomic<bool> verified{false};
+  if (inner.IsEmpty() || verified.exchange(true)) {
+    return;
+  }
+  // The scalar rows are written at the same offsets as in the full image.
+  std::unique_ptr<uint8_t[]> scalar_scores(new uint8_t[width * inner.bottom]);
+  memset(scalar_scores.get(), 0, width * inner.bottom);
+  ScoreScalar(input_pixels, width, stride, inner, threshold,
+              scalar_scores.get());
+  for (int32_t j = inner.top; j < inner.bottom; ++j) {
+    const int offset = j * width + inner.left;
+    if (memcmp(neon_scores + offset, scalar_scores.get() + offset,
+               inner.right - inner.left) != 0) {
+      LOGE("ScoreFastCorners: NEON scores differ from the scalar ones in row "
+           "%d", j);
+      return;
+    }
+  }
+}
+#endif  // NDEBUG
+#endif  // __ARM_NEON
+
+// Whether the score at |x|, |y| is above those of its neighbours in
+// |region|.
+bool IsLocalMaximum(const uint8_t* scores, int32_t width,
+                    const ImageRegion& region, int32_t x, int32_t y) {
+  const uint8_t score = scores[y * width + x];
+  for (int32_t j = std::max(y - 1, region.top);
+       j <= std::min(y + 1, region.bottom - 1); ++j) {
+    for (int32_t i = std::max(x - 1, region.left);
+         i <= std::min(x + 1, region.right - 1); ++i) {
+      if ((i != x || j != y) && scores[j * width + i] >= score) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Adds |keypoint| to the |*count| keypoints of a cell, strongest first, if
+// it is among the |capacity| strongest.
+void InsertKeypoint(const Keypoint& keypoint, int capacity,
+                    Keypoint* keypoints, int* count) {
+  int position = *count;
+  if (position == capacity) {
+    if (keypoints[capacity - 1].score >= keypoint.score) {
+      return;
+    }
+    --position;
+  } else {
+    ++*count;
+  }
+  for (; position > 0 && keypoints[position - 1].score < keypoint.score;
+       --position) {
+    keypoints[position] = keypoints[position - 1];
+  }
+  keypoints[position] = keypoint;
+}
+
+int GetCellCount(int32_t extent, int32_t cell_size) {
+  return (extent + cell_size - 1) / cell_size;
+}
+}  // namespace
+
+void ScoreFastCornersRegion(const uint8_t* input_pixels, int32_t width,
+                            int32_t height, int32_t stride,
+                            const ImageRegion& region, int32_t threshold,
+                            uint8_t* scores) {
+  static const FastCornerVariant variant =
+      IsFastCornerVariantSupported(FastCornerVariant::kNeon)
+          ? FastCornerVariant::kNeon
+          : FastCornerVariant::kScalar;
+  ScoreFastCornersRegionWithVariant(variant, input_pixels, width, height,
+                                    stride, region, threshold, scores);
+#if defined(__ARM_NEON) && !defined(NDEBUG)
+  if (variant == FastCornerVariant::kNeon) {
+    const ImageRegion inner = GetInnerRegion(width, height, region);
+    VerifyNeonScores(input_pixels, width, stride, inner, threshold, scores);
+  }
+#endif  // __ARM_NEON && !NDEBUG
+}
+
+bool IsFastCornerVariantSupported(FastCornerVariant variant) {
+  switch (variant) {
+    case FastCornerVariant::kScalar:
+      return true;
+    case FastCornerVariant::kNeon:
+#if defined(__ARM_NEON)
+      return IsNeonSupported();
+#else
+      return false;
+#endif  // __ARM_NEON
+  }
+  return false;
+}
+
+void ScoreFastCornersRegionWithVariant(FastCornerVariant variant,
+                                       const uint8_t* input_pixels,
+                                       int32_t width, int32_t height,
+                                       int32_t stride,
+                                       const ImageRegion& region,
+                                       int32_t threshold, uint8_t* scores) {
+  for (int32_t j = region.top; j < region.bottom; ++j) {
+    memset(scores + j * width + region.left, 0, region.right - region.left);
+  }
+  const ImageRegion inner = GetInnerRegion(width, height, region);
+  if (inner.IsEmpty()) {
+    return;
+  }
+#if defined(__ARM_NEON)
+  if (variant == FastCornerVariant::kNeon) {
+    ScoreNeon(input_pixels, width, stride, inner, threshold, scores);
+    return;
+  }
+#endif  // __ARM_NEON
+  ScoreScalar(input_pixels, width, stride, inner, threshold, scores);
+}
+
+int KeypointDetector::Detect(const CpuImagePlane& plane,
+                             const ImageRegion& region,
+                             const KeypointGridParams& params,
+                             WorkerPool* worker_pool, Keypoint* keypoints,
+                             int capacity) {
+  const FastCornerVariant variant =
+      IsFastCornerVariantSupported(FastCornerVariant::kNeon)
+          ? FastCornerVariant::kNeon
+          : FastCornerVariant::kScalar;
+  return DetectWithVariant(variant, plane, region, params, worker_pool,
+                           keypoints, capacity);
+}
+
+int KeypointDetector::DetectWithVariant(FastCornerVariant variant,
+                                        const CpuImagePlane& plane,
+                                        const ImageRegion& region,
+                                        const KeypointGridParams& params,
+                                        WorkerPool* worker_pool,
+                                        Keypoint* keypoints, int capacity) {
+  ImageRegion clipped;
+  clipped.left = std::max(region.left, 0);
+  clipped.top = std::max(region.top, 0);
+  clipped.right = std::min(region.right, plane.width);
+  clipped.bottom = std::min(region.bottom, plane.height);
+  const int per_cell = std::min(params.max_keypoints_per_cell,
+                                KeypointGridParams::kMaxKeypointsPerCell);
+  if (clipped.IsEmpty() || per_cell <= 0 || params.cell_size <= 0) {
+    return 0;
+  }
+
+  scores_.resize(plane.width * plane.height);
+  const int32_t height = clipped.bottom - clipped.top;
+  const int num_bands =
+      std::max(1, std::min(worker_pool->GetThreadCount() * kBandsPerThread,
+                           height / kMinRowsPerBand));
+  const int32_t rows_per_band = (height + num_bands - 1) / num_bands;
+  worker_pool->Run(num_bands, [&](int band) {
+    ImageRegion band_region = clipped;
+    band_region.top = clipped.top + band * rows_per_band;
+    band_region.bottom =
+        std::min(clipped.bottom, band_region.top + rows_per_band);
+    ScoreFastCornersRegionWithVariant(variant, plane.pixels, plane.width,
+                                      plane.height, plane.stride, band_region,
+                                      params.threshold, scores_.data());
+  });
+
+  const int32_t cell_size = params.cell_size;
+  const int cells_x = GetCellCount(clipped.right - clipped.left, cell_size);
+  const int cells_y = GetCellCount(height, cell_size);
+  cell_keypoints_.resize(cells_x * cells_y * per_cell);
+  cell_counts_.assign(cells_x * cells_y, 0);
+  worker_pool->Run(cells_y, [&](int cell_row) {
+    const int32_t top = clipped.top + cell_row * cell_size;
+    const int32_t bottom = std::min(clipped.bottom, top + cell_size);
+    for (int32_t y = top; y < bottom; ++y) {
+      const uint8_t* score_row = scores_.data() + y * plane.width;
+      for (int32_t x = clipped.left; x < clipped.right; ++x) {
+        if (score_row[x] == 0 ||
+            !IsLocalMaximum(scores_.data(), plane.width, clipped, x, y)) {
+          continue;
+        }
+        const int cell = cell_row * cells_x + (x - clipped.left) / cell_size;
+        Keypoint keypoint;
+        keypoint.x = x;
+        keypoint.y = y;
+        keypoint.score = score_row[x];
+        InsertKeypoint(keypoint, per_cell,
+                       cell_keypoints_.data() + cell * per_cell,
+                       &cell_counts_[cell]);
+      }
+    }
+  });
+
+  int count = 0;
+  for (int cell = 0; cell < cells_x * cells_y; ++cell) {
+    const int cell_count = std::min(cell_counts_[cell], capacity - count);
+    std::copy(cell_keypoints_.begin() + cell * per_cell,
+              cell_keypoints_.begin() + cell * per_cell + cell_count,
+              keypoints + count);
+    count += cell_count;
+  }
+  return count;
+}
+
+int KeypointDetector::GetMaxKeypoints(const ImageRegion& region,
+                                      const KeypointGridParams& params) {
+  if (region.IsEmpty() || params.cell_size <= 0) {
+    return 0;
+  }
+  const int per_cell =
+      std::max(0, std::min(params.max_keypoints_per_cell,
+                           KeypointGridParams::kMaxKeypointsPerCell));
+  return GetCellCount(region.right - region.left, params.cell_size) *
+         GetCellCount(region.bottom - region.top, params.cell_size) *
+         per_cell;
+}
+
+}  // namespace computer_vision
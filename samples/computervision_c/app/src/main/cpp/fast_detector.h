@@ -0,0 +1,122 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_COMPUTER_VISION_FAST_DETECTOR_H_
+#define C_ARCORE_COMPUTER_VISION_FAST_DETECTOR_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "cpu_image_renderer.h"
+#include "edge_detector.h"
+#include "worker_pool.h"
+
+namespace computer_vision {
+
+// Writes the FAST-9 corner score of every pixel of |region| to |scores|, a
+// plane of |width| x |height| with rows of |width| bytes.  A pixel is a
+// corner if 9 contiguous pixels of the circle of radius 3 around it are all
+// brighter or all darker than it by more than |threshold|.  Its score is the
+// smallest difference to it along the best such arc, and the score of all
+// other pixels, including those within 3 pixels of the image border, is 0.
+// |input_pixels| has rows of |stride| bytes.  Disjoint regions can be
+// processed concurrently.
+//
+// Pixels are first rejected unless two of the four compass points of the
+// circle pass, which 9 contiguous pixels always include.  NEON tests 16
+// pixels at a time and only scores the corners it finds; the scores are the
+// same as the scalar ones.
+void ScoreFastCornersRegion(const uint8_t* input_pixels, int32_t width,
+                            int32_t height, int32_t stride,
+                            const ImageRegion& region, int32_t threshold,
+                            uint8_t* scores);
+
+// Implementations of ScoreFastCornersRegion(), which uses the fastest one the
+// CPU supports.  Exposed to compare them, e.g. in RunKernelBenchmark().
+enum class FastCornerVariant { kScalar, kNeon };
+
+// Whether |variant| was compiled in and the CPU can run it.
+bool IsFastCornerVariantSupported(FastCornerVariant variant);
+
+// ScoreFastCornersRegion() with |variant|, which must be supported.
+void ScoreFastCornersRegionWithVariant(FastCornerVariant variant,
+                                       const uint8_t* input_pixels,
+                                       int32_t width, int32_t height,
+                                       int32_t stride,
+                                       const ImageRegion& region,
+                                       int32_t threshold, uint8_t* scores);
+
+// A corner and its FAST score.
+struct Keypoint {
+  int32_t x = 0;
+  int32_t y = 0;
+  int32_t score = 0;
+};
+
+struct KeypointGridParams {
+  static constexpr int kMaxKeypointsPerCell = 16;
+
+  int32_t threshold = kFastThreshold;
+  // Side of the square cells the region is divided into, from its top left.
+  int32_t cell_size = 32;
+  // Strongest keypoints kept per cell, at most kMaxKeypointsPerCell, so
+  // textured parts of the image cannot crowd out the rest.
+  int max_keypoints_per_cell = 4;
+};
+
+// Finds FAST-9 keypoints spread evenly over an image.
+//
+// The scores are computed in row bands on a WorkerPool, then every row of
+// cells keeps the corners that are strictly stronger than their 8 neighbours
+// and among the strongest of their cell.  The keypoints are written to
+// storage the caller owns, cell by cell from the top left and strongest
+// first within a cell.  The score plane and the cell lists are kept across
+// frames, so detection only allocates when the image grows.
+class KeypointDetector {
+ public:
+  KeypointDetector() = default;
+
+  KeypointDetector(const KeypointDetector&) = delete;
+  KeypointDetector& operator=(const KeypointDetector&) = delete;
+
+  // Detects the keypoints of |region| of |plane| and writes up to |capacity|
+  // of them to |keypoints|.  Returns how many were written; keypoints of the
+  // last cells are dropped if they do not fit.
+  int Detect(const CpuImagePlane& plane, const ImageRegion& region,
+             const KeypointGridParams& params, WorkerPool* worker_pool,
+             Keypoint* keypoints, int capacity);
+
+  // Detect() with |variant|, which must be supported.
+  int DetectWithVariant(FastCornerVariant variant, const CpuImagePlane& plane,
+                        const ImageRegion& region,
+                        const KeypointGridParams& params,
+                        WorkerPool* worker_pool, Keypoint* keypoints,
+                        int capacity);
+
+  // Storage Detect() needs for all keypoints of |region| with |params|.
+  static int GetMaxKeypoints(const ImageRegion& region,
+                             const KeypointGridParams& params);
+
+ private:
+  std::vector<uint8_t> scores_;
+  // max_keypoints_per_cell entries per cell, of which the counts are used.
+  std::vector<Keypoint> cell_keypoints_;
+  std::vector<int> cell_counts_;
+};
+
+}  // namespace computer_vision
+
+#endif  // C_ARCORE_COMPUTER_VISION_FAST_DETECTOR_H_
@@ -0,0 +1,189 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gpu_edge_detector.h"
+
+#include <EGL/egl.h>
+#include <GLES3/gl31.h>
+
+#include <cstdio>
+#include <cstring>
+
+#include "util.h"
+
+namespace computer_vision {
+namespace {
+constexpr char kComputeShaderFilename[] = "shaders/edge_detector.comp";
+// Must match TILE_SIZE of the compute shader.
+constexpr int32_t kTileSize = 16;
+
+PFNGLGETQUERYOBJECTUI64VEXTPROC get_query_object_ui64v = nullptr;
+
+bool HasExtension(const char* name) {
+  const char* extensions =
+      reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+  return extensions != nullptr && strstr(extensions, name) != nullptr;
+}
+
+bool IsContextVersionAtLeast31() {
+  const char* version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+  int major = 0, minor = 0;
+  if (version == nullptr ||
+      sscanf(version, "OpenGL ES %d.%d", &major, &minor) != 2) {
+    return false;
+  }
+  return major > 3 || (major == 3 && minor >= 1);
+}
+}  // namespace
+
+constexpr int GpuEdgeDetector::kNumTimerQueries;
+
+bool GpuEdgeDetector::InitializeGlContent(AAssetManager* asset_manager) {
+  // Names of a previous context are gone with it.
+  program_ = 0;
+  output_texture_ = 0;
+  output_width_ = 0;
+  output_height_ = 0;
+  has_timer_queries_ = false;
+  gpu_time_ms_ = -1.f;
+
+  if (!IsContextVersionAtLeast31() ||
+      !HasExtension("GL_OES_EGL_image_external_essl3")) {
+    LOGI("GpuEdgeDetector: OpenGL ES 3.1 compute path is not available.");
+    return false;
+  }
+  program_ = util::CreateComputeProgram(asset_manager, kComputeShaderFilename);
+  if (!program_) {
+    LOGE("GpuEdgeDetector: Could not create program.");
+    return false;
+  }
+  glUseProgram(program_);
+  glUniform1i(glGetUniformLocation(program_, "TexVideo"), 0);
+  uniform_image_size_ = glGetUniformLocation(program_, "u_ImageSize");
+  uniform_tex_origin_ = glGetUniformLocation(program_, "u_TexOrigin");
+  uniform_tex_step_x_ = glGetUniformLocation(program_, "u_TexStepX");
+  uniform_tex_step_y_ = glGetUniformLocation(program_, "u_TexStepY");
+
+  if (HasExtension("GL_EXT_disjoint_timer_query")) {
+    get_query_object_ui64v = reinterpret_cast<PFNGLGETQUERYOBJECTUI64VEXTPROC>(
+        eglGetProcAddress("glGetQueryObjectui64vEXT"));
+  }
+  if (get_query_object_ui64v != nullptr) {
+    glGenQueries(kNumTimerQueries, timer_queries_);
+    for (bool& pending : timer_query_pending_) {
+      pending = false;
+    }
+    next_timer_query_ = 0;
+    has_timer_queries_ = true;
+  }
+  util::CheckGlError("GpuEdgeDetector::InitializeGlContent()");
+  return true;
+}
+
+GLuint GpuEdgeDetector::Run(const ArSession* session, const ArFrame* frame,
+                            GLuint camera_texture, int32_t width,
+                            int32_t height) {
+  if (!IsSupported() || width <= 0 || height <= 0) {
+    return 0;
+  }
+  if (output_texture_ == 0 || width != output_width_ ||
+      height != output_height_) {
+    // Immutable storage is required for image units, so a new size needs a
+    // new texture.
+    if (output_texture_ != 0) {
+      glDeleteTextures(1, &output_texture_);
+    }
+    glGenTextures(1, &output_texture_);
+    glBindTexture(GL_TEXTURE_2D, output_texture_);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    output_width_ = width;
+    output_height_ = height;
+  }
+
+  // The CPU image is a crop of the camera texture, the corners of the image
+  // give the mapping of its pixels into the texture.
+  const float image_corners[6] = {0.f, 0.f, 1.f, 0.f, 0.f, 1.f};
+  float texture_corners[6];
+  ArFrame_transformCoordinates2d(
+      session, frame, AR_COORDINATES_2D_IMAGE_NORMALIZED, 3, image_corners,
+      AR_COORDINATES_2D_TEXTURE_NORMALIZED, texture_corners);
+
+  CollectTimerQueries();
+  const bool timed =
+      has_timer_queries_ && !timer_query_pending_[next_timer_query_];
+  if (timed) {
+    glBeginQuery(GL_TIME_ELAPSED_EXT, timer_queries_[next_timer_query_]);
+  }
+
+  glUseProgram(program_);
+  glUniform2i(uniform_image_size_, width, height);
+  glUniform2f(uniform_tex_origin_, texture_corners[0], texture_corners[1]);
+  glUniform2f(uniform_tex_step_x_,
+              (texture_corners[2] - texture_corners[0]) / width,
+              (texture_corners[3] - texture_corners[1]) / width);
+  glUniform2f(uniform_tex_step_y_,
+              (texture_corners[4] - texture_corners[0]) / height,
+              (texture_corners[5] - texture_corners[1]) / height);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_EXTERNAL_OES, camera_texture);
+  glBindImageTexture(0, output_texture_, 0, GL_FALSE, 0, GL_WRITE_ONLY,
+                     GL_RGBA8);
+  glDispatchCompute((width + kTileSize - 1) / kTileSize,
+                    (height + kTileSize - 1) / kTileSize, 1);
+  // The output is sampled by the draw calls that follow.
+  glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+  if (timed) {
+    glEndQuery(GL_TIME_ELAPSED_EXT);
+    timer_query_pending_[next_timer_query_] = true;
+    next_timer_query_ = (next_timer_query_ + 1) % kNumTimerQueries;
+  }
+  util::CheckGlError("GpuEdgeDetector::Run()");
+  return output_texture_;
+}
+
+void GpuEdgeDetector::CollectTimerQueries() {
+  if (!has_timer_queries_) {
+    return;
+  }
+  // A disjoint operation, e.g. a frequency change, invalidates all queries in
+  // flight.
+  GLint disjoint = 0;
+  glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+  for (int i = 0; i < kNumTimerQueries; ++i) {
+    if (!timer_query_pending_[i]) {
+      continue;
+    }
+    GLuint available = GL_FALSE;
+    glGetQueryObjectuiv(timer_queries_[i], GL_QUERY_RESULT_AVAILABLE,
+                        &available);
+    if (!available && !disjoint) {
+      continue;
+    }
+    if (available && !disjoint) {
+      GLuint64 elapsed_ns = 0;
+      get_query_object_ui64v(timer_queries_[i], GL_QUERY_RESULT, &elapsed_ns);
+      gpu_time_ms_ = static_cast<float>(elapsed_ns) * 1e-6f;
+    }
+    timer_query_pending_[i] = false;
+  }
+}
+
+}  // namespace computer_vision
@@ -0,0 +1,87 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_COMPUTER_VISION_GPU_EDGE_DETECTOR_H_
+#define C_ARCORE_COMPUTER_VISION_GPU_EDGE_DETECTOR_H_
+
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#include <android/asset_manager.h>
+
+#include "arcore_c_api.h"
+
+namespace computer_vision {
+
+// Runs the edge detection of DetectEdge() in a compute shader, directly on the
+// camera texture.  In AR_TEXTURE_UPDATE_MODE_EXPOSE_HARDWARE_BUFFER the camera
+// texture is the EGLImage of the camera's hardware buffer, so no frame ever
+// reaches the CPU.  The output has the size of the CPU image and is laid out
+// like it, so it can be sampled with the same image coordinates.
+//
+// Needs an OpenGL ES 3.1 context with GL_OES_EGL_image_external_essl3.  The GPU
+// time of every dispatch is measured with GL_EXT_disjoint_timer_query where
+// the driver has it.
+class GpuEdgeDetector {
+ public:
+  GpuEdgeDetector() = default;
+  ~GpuEdgeDetector() = default;
+
+  GpuEdgeDetector(const GpuEdgeDetector&) = delete;
+  GpuEdgeDetector& operator=(const GpuEdgeDetector&) = delete;
+
+  // Builds the compute program.  Must be called on the OpenGL thread.  Returns
+  // false, and leaves IsSupported() false, if the context cannot run it.
+  bool InitializeGlContent(AAssetManager* asset_manager);
+
+  bool IsSupported() const { return program_ != 0; }
+
+  // Detects the edges of the |camera_texture| of |frame| into a
+  // |width| x |height| texture and returns its name.  The texture is ready to
+  // be sampled by later draw calls.
+  GLuint Run(const ArSession* session, const ArFrame* frame,
+             GLuint camera_texture, int32_t width, int32_t height);
+
+  // GPU time of the latest dispatch whose timer query completed, in
+  // milliseconds, or a negative value if it is not known.
+  float GetGpuTimeMs() const { return gpu_time_ms_; }
+
+ private:
+  static constexpr int kNumTimerQueries = 3;
+
+  // Reads back the finished timer queries without waiting for the GPU.
+  void CollectTimerQueries();
+
+  GLuint program_ = 0;
+  GLint uniform_image_size_ = -1;
+  GLint uniform_tex_origin_ = -1;
+  GLint uniform_tex_step_x_ = -1;
+  GLint uniform_tex_step_y_ = -1;
+
+  GLuint output_texture_ = 0;
+  int32_t output_width_ = 0;
+  int32_t output_height_ = 0;
+
+  // Ring of timer queries, a query is reused once its result was read.
+  bool has_timer_queries_ = false;
+  GLuint timer_queries_[kNumTimerQueries] = {};
+  bool timer_query_pending_[kNumTimerQueries] = {};
+  int next_timer_query_ = 0;
+  float gpu_time_ms_ = -1.f;
+};
+
+}  // namespace computer_vision
+
+#endif  // C_ARCORE_COMPUTER_VISION_GPU_EDGE_DETECTOR_H_
@@ -0,0 +1,116 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "image_pyramid.h"
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include <algorithm>
+
+#include "cpu_features.h"
+
+namespace computer_vision {
+namespace {
+constexpr int32_t kMinLevelSize = 3;
+
+// Rounded average of the 2x2 blocks in the columns [i_begin, i_end) of an
+// output row, |top| and |bottom| being the two input rows.
+void DownsampleRowScalar(const uint8_t* top, const uint8_t* bottom,
+                         int32_t i_begin, int32_t i_end, uint8_t* output) {
+  for (int i = i_begin; i < i_end; i++) {
+    const int sum =
+        top[2 * i] + top[2 * i + 1] + bottom[2 * i] + bottom[2 * i + 1];
+    output[i] = static_cast<uint8_t>((sum + 2) >> 2);
+  }
+}
+
+#if defined(__ARM_NEON)
+constexpr int kNeonPixelsPerIteration = 16;
+
+// 16 output pixels per iteration: the pairwise widening adds sum the columns
+// of each row, the rounding narrowing shift divides by four like the scalar
+// loop.
+void DownsampleRowNeon(const uint8_t* top, const uint8_t* bottom,
+                       int32_t width, uint8_t* output) {
+  int i = 0;
+  for (; i + kNeonPixelsPerIteration <= width; i += kNeonPixelsPerIteration) {
+    const uint8x16x2_t top_pixels = {
+        {vld1q_u8(top + 2 * i), vld1q_u8(top + 2 * i + 16)}};
+    const uint8x16x2_t bottom_pixels = {
+        {vld1q_u8(bottom + 2 * i), vld1q_u8(bottom + 2 * i + 16)}};
+    const uint16x8_t low = vaddq_u16(vpaddlq_u8(top_pixels.val[0]),
+                                     vpaddlq_u8(bottom_pixels.val[0]));
+    const uint16x8_t high = vaddq_u16(vpaddlq_u8(top_pixels.val[1]),
+                                      vpaddlq_u8(bottom_pixels.val[1]));
+    vst1q_u8(output + i,
+             vcombine_u8(vrshrn_n_u16(low, 2), vrshrn_n_u16(high, 2)));
+  }
+  DownsampleRowScalar(top, bottom, i, width, output);
+}
+#endif  // __ARM_NEON
+}  // namespace
+
+constexpr int ImagePyramid::kMaxLevel;
+
+void ImagePyramid::Reset(const CpuImagePlane& base) {
+  levels_[0] = base;
+  num_levels_ = 1;
+}
+
+int ImagePyramid::BuildLevel(int level) {
+  level = std::max(0, std::min(level, kMaxLevel));
+  while (num_levels_ <= level) {
+    const CpuImagePlane& input = levels_[num_levels_ - 1];
+    if (input.width / 2 < kMinLevelSize || input.height / 2 < kMinLevelSize) {
+      break;
+    }
+    CpuImagePlane& output = levels_[num_levels_];
+    std::vector<uint8_t>& storage = storage_[num_levels_ - 1];
+    output.width = input.width / 2;
+    output.height = input.height / 2;
+    output.stride = output.width;
+    storage.resize(output.stride * output.height);
+    Downsample2x2(input, storage.data(), output.stride);
+    output.pixels = storage.data();
+    ++num_levels_;
+  }
+  return std::min(level, num_levels_ - 1);
+}
+
+void Downsample2x2(const CpuImagePlane& input, uint8_t* output,
+                   int32_t output_stride) {
+  const int32_t width = input.width / 2;
+  const int32_t height = input.height / 2;
+#if defined(__ARM_NEON)
+  static const bool use_neon = IsNeonSupported();
+#endif  // __ARM_NEON
+  for (int j = 0; j < height; j++) {
+    const uint8_t* top = input.pixels + (2 * j) * input.stride;
+    const uint8_t* bottom = top + input.stride;
+    uint8_t* output_row = output + j * output_stride;
+#if defined(__ARM_NEON)
+    if (use_neon) {
+      DownsampleRowNeon(top, bottom, width, output_row);
+      continue;
+    }
+#endif  // __ARM_NEON
+    DownsampleRowScalar(top, bottom, 0, width, output_row);
+  }
+}
+
+}  // namespace computer_vision
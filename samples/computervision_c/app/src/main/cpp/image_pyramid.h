@@ -0,0 +1,69 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_COMPUTER_VISION_IMAGE_PYRAMID_H_
+#define C_ARCORE_COMPUTER_VISION_IMAGE_PYRAMID_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "cpu_image_renderer.h"
+
+namespace computer_vision {
+
+// Box filtered pyramid of a luminance plane.  Level 0 is the plane itself and
+// every further level averages 2x2 pixels of the one before, so level n has
+// 1/2^n of the size in each dimension.
+//
+// Levels are only computed when first asked for and are then cached until the
+// next Reset(), so all kernels running on one frame share them.  The storage
+// is kept across frames.
+class ImagePyramid {
+ public:
+  static constexpr int kMaxLevel = 2;
+
+  ImagePyramid() = default;
+
+  ImagePyramid(const ImagePyramid&) = delete;
+  ImagePyramid& operator=(const ImagePyramid&) = delete;
+
+  // Starts a pyramid over |base|, which must stay valid while levels are
+  // read.
+  void Reset(const CpuImagePlane& base);
+
+  // Computes the levels up to |level| unless they are cached, and returns the
+  // highest level at most |level| that exists.  Levels stop before a dimension
+  // falls below three pixels, the smallest image the kernels process.
+  int BuildLevel(int level);
+
+  // Returns |level|, which BuildLevel() must have made available.
+  const CpuImagePlane& GetLevel(int level) const { return levels_[level]; }
+
+ private:
+  CpuImagePlane levels_[kMaxLevel + 1];
+  int num_levels_ = 0;
+  std::vector<uint8_t> storage_[kMaxLevel];
+};
+
+// Averages the 2x2 blocks of |input| into |output|, a plane of half the size
+// rounded down, with rows of |output_stride| bytes.  Uses NEON when the CPU
+// supports it, the results are the same byte for byte.
+void Downsample2x2(const CpuImagePlane& input, uint8_t* output,
+                   int32_t output_stride);
+
+}  // namespace computer_vision
+
+#endif  // C_ARCORE_COMPUTER_VISION_IMAGE_PYRAMID_H_
@@ -19,6 +19,7 @@
 #include <jni.h>
 
 #include "computer_vision_application.h"
+#include "kernel_benchmark.h"
 
 #define JNI_METHOD(return_type, method_name) \
   JNIEXPORT return_type JNICALL              \
@@ -30,6 +31,10 @@ namespace {
 // Maintain a reference to the JVM so we can use it later.
 static JavaVM *g_vm = nullptr;
 
+// The JNIEnv of the current thread, so that GetJniEnv() only goes through
+// the JVM on a thread's first call.
+thread_local JNIEnv *t_env = nullptr;
+
 inline jlong jptr(computer_vision::ComputerVisionApplication
                       *native_computer_vision_application) {
   return reinterpret_cast<intptr_t>(native_computer_vision_application);
@@ -87,9 +92,14 @@ JNI_METHOD(void, onGlSurfaceDrawFrame)
 }
 
 JNIEnv *GetJniEnv() {
-  JNIEnv *env;
-  jint result = g_vm->AttachCurrentThread(&env, nullptr);
-  return result == JNI_OK ? env : nullptr;
+  if (t_env == nullptr) {
+    JNIEnv *env = nullptr;
+    if (g_vm->AttachCurrentThread(&env, nullptr) != JNI_OK) {
+      return nullptr;
+    }
+    t_env = env;
+  }
+  return t_env;
 }
 
 jclass FindClass(const char *classname) {
@@ -111,11 +121,52 @@ JNI_METHOD(jint, setCameraConfig)
   return static_cast<jint>(status);
 }
 
+JNI_METHOD(void, setCameraConfigGovernorEnabled)
+(JNIEnv *, jclass, jlong native_application, jboolean enabled,
+ jfloat processing_budget_ms) {
+  native(native_application)
+      ->SetCameraConfigGovernorEnabled(enabled, processing_budget_ms);
+}
+
 JNI_METHOD(jstring, getCameraIntrinsicsText)
 (JNIEnv *env, jclass, jlong native_application, jboolean for_gpu_texture) {
-  auto label =
-      native(native_application)->GetCameraIntrinsicsText(for_gpu_texture);
-  return env->NewStringUTF(label.c_str());
+  return env->NewStringUTF(
+      native(native_application)->GetCameraIntrinsicsText(for_gpu_texture));
+}
+
+JNI_METHOD(void, setUseGpuEdgeDetection)
+(JNIEnv *, jclass, jlong native_application, jboolean use_gpu) {
+  native(native_application)->SetUseGpuEdgeDetection(use_gpu);
+}
+
+JNI_METHOD(void, setPyramidLevel)
+(JNIEnv *, jclass, jlong native_application, jint level) {
+  native(native_application)->SetPyramidLevel(level);
+}
+
+JNI_METHOD(jboolean, setKernelChain)
+(JNIEnv *env, jclass, jlong native_application, jstring chain) {
+  const char *chain_chars = env->GetStringUTFChars(chain, nullptr);
+  const bool result = native(native_application)->SetKernelChain(chain_chars);
+  env->ReleaseStringUTFChars(chain, chain_chars);
+  return result;
+}
+
+JNI_METHOD(void, setMotionGateEnabled)
+(JNIEnv *, jclass, jlong native_application, jboolean enabled) {
+  native(native_application)->SetMotionGateEnabled(enabled);
+}
+
+JNI_METHOD(jstring, runKernelBenchmark)
+(JNIEnv *env, jclass) {
+  const std::string report = computer_vision::RunKernelBenchmark();
+  return env->NewStringUTF(report.c_str());
+}
+
+JNI_METHOD(jstring, getEdgeDetectionTimingText)
+(JNIEnv *env, jclass, jlong native_application) {
+  return env->NewStringUTF(
+      native(native_application)->GetEdgeDetectionTimingText());
 }
 
 JNI_METHOD(void, setFocusMode)
@@ -128,4 +179,23 @@ JNI_METHOD(jboolean, getFocusMode)
   return native(native_application)->GetFocusMode();
 }
 
+JNI_METHOD(jboolean, startPlaybackBenchmark)
+(JNIEnv *env, jclass, jlong native_application, jstring j_dataset_uri,
+ jstring j_csv_path) {
+  const char *dataset_uri = env->GetStringUTFChars(j_dataset_uri, nullptr);
+  const char *csv_path = env->GetStringUTFChars(j_csv_path, nullptr);
+  const bool started = native(native_application)
+                           ->StartPlaybackBenchmark(dataset_uri, csv_path);
+  env->ReleaseStringUTFChars(j_csv_path, csv_path);
+  env->ReleaseStringUTFChars(j_dataset_uri, dataset_uri);
+  return static_cast<jboolean>(started ? JNI_TRUE : JNI_FALSE);
+}
+
+JNI_METHOD(jboolean, isPlaybackBenchmarkFinished)
+(JNIEnv *, jclass, jlong native_application) {
+  return static_cast<jboolean>(
+      native(native_application)->IsPlaybackBenchmarkFinished() ? JNI_TRUE
+                                                                : JNI_FALSE);
+}
+
 }  // extern "C"
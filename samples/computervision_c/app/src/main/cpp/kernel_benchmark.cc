@@ -0,0 +1,315 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "kernel_benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+#include "cpu_image_renderer.h"
+#include "edge_detector.h"
+#include "fast_detector.h"
+#include "image_pyramid.h"
+#include "kernel_pipeline.h"
+#include "luminance_histogram.h"
+#include "optical_flow.h"
+#include "worker_pool.h"
+#include "yuv_to_rgb_converter.h"
+
+namespace computer_vision {
+namespace {
+// Camera HALs commonly align the rows of the Y plane to this many bytes.
+constexpr int32_t kRowAlignment = 256;
+// Every kernel runs at least this long and this often after one warm-up run.
+constexpr float kMinBenchmarkMs = 250.f;
+constexpr int kMinIterations = 5;
+
+// Model input size of the YUV to RGB conversions.
+constexpr int32_t kTensorSize = 256;
+
+// The optical flow tracks a grid of this many points by this many pixels
+// between two views of a plane.
+constexpr int kFlowGridSize = 16;
+constexpr int32_t kFlowShiftX = 3;
+constexpr int32_t kFlowShiftY = 2;
+
+struct BenchmarkSize {
+  int32_t width;
+  int32_t height;
+};
+constexpr BenchmarkSize kBenchmarkSizes[] = {
+    {640, 480}, {1280, 720}, {1920, 1080}};
+
+// Blocks of random brightness with some noise, so that both the edge and the
+// non-edge branches of the scalar kernel are taken.
+std::vector<uint8_t> CreateSyntheticPlane(int32_t width, int32_t height,
+                                          int32_t stride) {
+  std::vector<uint8_t> pixels(stride * height);
+  uint32_t state = 12345;
+  const auto next_random = [&state]() {
+    state = state * 1664525u + 1013904223u;
+    return state >> 24;
+  };
+  constexpr int32_t kBlockSize = 16;
+  const int32_t blocks_per_row = (width + kBlockSize - 1) / kBlockSize;
+  std::vector<uint8_t> block_values(blocks_per_row);
+  for (int32_t y = 0; y < height; ++y) {
+    if (y % kBlockSize == 0) {
+      for (uint8_t& value : block_values) {
+        value = static_cast<uint8_t>(next_random());
+      }
+    }
+    for (int32_t x = 0; x < width; ++x) {
+      const int value = block_values[x / kBlockSize] + (next_random() & 0xF);
+      pixels[y * stride + x] = static_cast<uint8_t>(std::min(value, 255));
+    }
+  }
+  return pixels;
+}
+
+// Returns the median duration of |kernel| in milliseconds.
+float TimeKernel(const std::function<void()>& kernel) {
+  kernel();
+  std::vector<float> samples_ms;
+  float total_ms = 0.f;
+  while (total_ms < kMinBenchmarkMs ||
+         static_cast<int>(samples_ms.size()) < kMinIterations) {
+    const auto start = std::chrono::steady_clock::now();
+    kernel();
+    const float sample_ms = std::chrono::duration<float, std::milli>(
+                                std::chrono::steady_clock::now() - start)
+                                .count();
+    samples_ms.push_back(sample_ms);
+    total_ms += sample_ms;
+  }
+  std::nth_element(samples_ms.begin(),
+                   samples_ms.begin() + samples_ms.size() / 2,
+                   samples_ms.end());
+  return samples_ms[samples_ms.size() / 2];
+}
+
+void AppendResult(const CpuImagePlane& plane, const char* kernel_name,
+                  float median_ms, std::ostringstream* report) {
+  const float megapixels = plane.width * plane.height / 1e6f;
+  *report << plane.width << "x" << plane.height << " (stride "
+          << plane.stride << ") " << kernel_name << ": " << median_ms
+          << " ms, " << megapixels * 1000.f / median_ms << " Mpixel/s\n";
+}
+}  // namespace
+
+std::string RunKernelBenchmark() {
+  WorkerPool worker_pool;
+  KernelPipeline pipeline;
+  ImagePyramid pyramid;
+  KeypointDetector keypoint_detector;
+  LuminanceHistogram histogram;
+  std::ostringstream report;
+  report << std::fixed << std::setprecision(2);
+
+  for (const BenchmarkSize& size : kBenchmarkSizes) {
+    const int32_t stride =
+        (size.width + kRowAlignment - 1) / kRowAlignment * kRowAlignment;
+    const std::vector<uint8_t> input =
+        CreateSyntheticPlane(size.width, size.height, stride);
+    CpuImagePlane plane;
+    plane.pixels = input.data();
+    plane.width = size.width;
+    plane.height = size.height;
+    plane.stride = stride;
+    ImageRegion region;
+    region.right = size.width;
+    region.bottom = size.height;
+    std::vector<uint8_t> output(size.width * size.height);
+
+    const struct {
+      EdgeDetectorVariant variant;
+      const char* name;
+    } variants[] = {{EdgeDetectorVariant::kScalar, "DetectEdge scalar"},
+                    {EdgeDetectorVariant::kNeon, "DetectEdge NEON"}};
+    for (const auto& variant : variants) {
+      if (!IsEdgeDetectorVariantSupported(variant.variant)) {
+        continue;
+      }
+      AppendResult(plane, variant.name, TimeKernel([&]() {
+                     DetectEdgeRegionWithVariant(
+                         variant.variant, plane.pixels, plane.width,
+                         plane.height, plane.stride, region,
+                         kSobelEdgeThreshold, output.data());
+                   }),
+                   &report);
+    }
+
+    const struct {
+      FastCornerVariant variant;
+      const char* name;
+    } fast_variants[] = {{FastCornerVariant::kScalar, "FAST-9 scalar"},
+                         {FastCornerVariant::kNeon, "FAST-9 NEON"}};
+    for (const auto& variant : fast_variants) {
+      if (!IsFastCornerVariantSupported(variant.variant)) {
+        continue;
+      }
+      AppendResult(plane, variant.name, TimeKernel([&]() {
+                     ScoreFastCornersRegionWithVariant(
+                         variant.variant, plane.pixels, plane.width,
+                         plane.height, plane.stride, region, kFastThreshold,
+                         output.data());
+                   }),
+                   &report);
+    }
+    const KeypointGridParams grid_params;
+    std::vector<Keypoint> keypoints(
+        KeypointDetector::GetMaxKeypoints(region, grid_params));
+    const std::string keypoints_name =
+        "FAST-9 grid keypoints (threads: " +
+        std::to_string(worker_pool.GetThreadCount()) + ")";
+    AppendResult(plane, keypoints_name.c_str(), TimeKernel([&]() {
+                   keypoint_detector.Detect(
+                       plane, region, grid_params, &worker_pool,
+                       keypoints.data(), static_cast<int>(keypoints.size()));
+                 }),
+                 &report);
+
+    KernelTimings timings;
+    const std::string pipeline_name =
+        "sobel_edge pipeline (threads: " +
+        std::to_string(worker_pool.GetThreadCount()) + ")";
+    AppendResult(plane, pipeline_name.c_str(), TimeKernel([&]() {
+                   pipeline.Run(plane, region, KernelParams(), &worker_pool,
+                                output.data(), &timings);
+                 }),
+                 &report);
+
+    AppendResult(plane, "Downsample2x2", TimeKernel([&]() {
+                   pyramid.Reset(plane);
+                   pyramid.BuildLevel(1);
+                 }),
+                 &report);
+
+    const struct {
+      LuminanceHistogramVariant variant;
+      int32_t step;
+      const char* name;
+    } histogram_variants[] = {
+        {LuminanceHistogramVariant::kScalar, 1, "Histogram scalar"},
+        {LuminanceHistogramVariant::kNeon, 1, "Histogram NEON"},
+        {LuminanceHistogramVariant::kNeon, 2, "Histogram NEON, step 2"}};
+    LuminanceStats stats;
+    for (const auto& variant : histogram_variants) {
+      if (!LuminanceHistogram::IsVariantSupported(variant.variant)) {
+        continue;
+      }
+      AppendResult(plane, variant.name, TimeKernel([&]() {
+                     histogram.ComputeWithVariant(variant.variant, plane,
+                                                  region, variant.step,
+                                                  &worker_pool, &stats);
+                   }),
+                   &report);
+    }
+
+    // Frames alternate between two views of the plane that are shifted
+    // against each other, so every Track() follows a real motion.
+    CpuImagePlane flow_frames[2] = {plane, plane};
+    for (CpuImagePlane& frame : flow_frames) {
+      frame.width -= kFlowShiftX;
+      frame.height -= kFlowShiftY;
+    }
+    flow_frames[1].pixels += kFlowShiftY * stride + kFlowShiftX;
+    std::vector<FlowPoint> flow_points;
+    for (int i = 0; i < kFlowGridSize * kFlowGridSize; ++i) {
+      FlowPoint point;
+      point.x = (i % kFlowGridSize + 0.5f) * flow_frames[0].width /
+                kFlowGridSize;
+      point.y = (i / kFlowGridSize + 0.5f) * flow_frames[0].height /
+                kFlowGridSize;
+      flow_points.push_back(point);
+    }
+    std::vector<TrackedPoint> tracked_points(flow_points.size());
+    const struct {
+      OpticalFlowVariant variant;
+      const char* name;
+    } flow_variants[] = {
+        {OpticalFlowVariant::kScalar, "LucasKanade 256 points scalar"},
+        {OpticalFlowVariant::kNeon, "LucasKanade 256 points NEON"}};
+    OpticalFlowTracker tracker;
+    for (const auto& variant : flow_variants) {
+      if (!OpticalFlowTracker::IsVariantSupported(variant.variant)) {
+        continue;
+      }
+      int frame = 0;
+      pyramid.Reset(flow_frames[frame]);
+      tracker.SetPreviousFrame(&pyramid);
+      AppendResult(plane, variant.name, TimeKernel([&]() {
+                     frame = 1 - frame;
+                     pyramid.Reset(flow_frames[frame]);
+                     tracker.TrackWithVariant(
+                         variant.variant, &pyramid, flow_points.data(),
+                         static_cast<int>(flow_points.size()), &worker_pool,
+                         tracked_points.data());
+                   }),
+                   &report);
+    }
+
+    // Semi-planar chroma with the rows of the luminance plane, rotated for a
+    // portrait display.
+    const std::vector<uint8_t> chroma =
+        CreateSyntheticPlane(size.width, size.height / 2, stride);
+    YuvImage yuv;
+    yuv.y = plane.pixels;
+    yuv.u = chroma.data();
+    yuv.v = chroma.data() + 1;
+    yuv.width = size.width;
+    yuv.height = size.height;
+    yuv.y_stride = stride;
+    yuv.uv_stride = stride;
+    yuv.uv_pixel_stride = 2;
+    RgbConversion conversion;
+    conversion.crop = region;
+    conversion.quarter_turns = 1;
+    conversion.output_width = kTensorSize;
+    conversion.output_height = kTensorSize;
+    const struct {
+      YuvToRgbVariant variant;
+      RgbFormat format;
+      const char* name;
+    } conversions[] = {
+        {YuvToRgbVariant::kScalar, RgbFormat::kRgb8, "YuvToRgb RGB8 scalar"},
+        {YuvToRgbVariant::kNeon, RgbFormat::kRgb8, "YuvToRgb RGB8 NEON"},
+        {YuvToRgbVariant::kScalar, RgbFormat::kRgbFloat,
+         "YuvToRgb float scalar"},
+        {YuvToRgbVariant::kNeon, RgbFormat::kRgbFloat, "YuvToRgb float NEON"}};
+    YuvToRgbConverter converter;
+    for (const auto& variant : conversions) {
+      if (!YuvToRgbConverter::IsVariantSupported(variant.variant)) {
+        continue;
+      }
+      conversion.format = variant.format;
+      converter.Prepare(size.width, size.height, conversion);
+      std::vector<uint8_t> rgb(converter.GetOutputSize());
+      AppendResult(plane, variant.name, TimeKernel([&]() {
+                     converter.ConvertRowsWithVariant(variant.variant, yuv, 0,
+                                                      kTensorSize, rgb.data());
+                   }),
+                   &report);
+    }
+  }
+  return report.str();
+}
+
+}  // namespace computer_vision
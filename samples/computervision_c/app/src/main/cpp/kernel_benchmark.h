@@ -0,0 +1,38 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_COMPUTER_VISION_KERNEL_BENCHMARK_H_
+#define C_ARCORE_COMPUTER_VISION_KERNEL_BENCHMARK_H_
+
+#include <string>
+
+namespace computer_vision {
+
+// Times the CPU kernels on synthetic luminance planes of 640x480, 1280x720 and
+// 1920x1080 with padded rows like camera images have.  Compares the scalar and
+// the NEON edge detection and FAST-9 scoring on one thread, the grid
+// keypoints, the threaded kernel pipeline and luminance histogram, the
+// pyramid downsampling, the optical flow of 256 points and the YUV to RGB
+// conversion to a rotated 256x256 model input.  Returns one line per kernel
+// and size with the median time and the throughput in megapixels per second.
+//
+// Takes a few seconds and competes with the app for the cores, so it should
+// run on its own thread while nothing else is processed.
+std::string RunKernelBenchmark();
+
+}  // namespace computer_vision
+
+#endif  // C_ARCORE_COMPUTER_VISION_KERNEL_BENCHMARK_H_
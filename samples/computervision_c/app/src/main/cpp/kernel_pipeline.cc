@@ -0,0 +1,126 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "kernel_pipeline.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "util.h"
+
+namespace computer_vision {
+namespace {
+// Bands per thread, so threads finishing early pick up the remaining work.
+constexpr int kBandsPerThread = 4;
+// Keeps the per-band overhead small on low resolution images.
+constexpr int kMinRowsPerBand = 32;
+
+ImageRegion ExpandRegion(const ImageRegion& region, int32_t halo,
+                         int32_t width, int32_t height) {
+  ImageRegion expanded;
+  expanded.left = std::max(0, region.left - halo);
+  expanded.top = std::max(0, region.top - halo);
+  expanded.right = std::min(width, region.right + halo);
+  expanded.bottom = std::min(height, region.bottom + halo);
+  return expanded;
+}
+}  // namespace
+
+KernelPipeline::KernelPipeline() {
+  steps_.push_back(FindVisionKernel("sobel_edge"));
+}
+
+bool KernelPipeline::SetChain(const std::vector<std::string>& names) {
+  if (names.empty() || static_cast<int>(names.size()) > kMaxKernelSteps) {
+    LOGE("KernelPipeline: chains have 1 to %d steps.", kMaxKernelSteps);
+    return false;
+  }
+  std::vector<const VisionKernel*> steps;
+  PixelFormat format = PixelFormat::kLuminance;
+  for (const std::string& name : names) {
+    const VisionKernel* kernel = FindVisionKernel(name);
+    if (kernel == nullptr) {
+      LOGE("KernelPipeline: unknown kernel %s.", name.c_str());
+      return false;
+    }
+    if (kernel->GetSpec().input_format != format) {
+      LOGE("KernelPipeline: %s does not take the output of the step before.",
+           name.c_str());
+      return false;
+    }
+    format = kernel->GetSpec().output_format;
+    steps.push_back(kernel);
+  }
+  if (format != PixelFormat::kEdgeMask) {
+    LOGE("KernelPipeline: the last step must produce an edge mask.");
+    return false;
+  }
+  steps_.swap(steps);
+  return true;
+}
+
+void KernelPipeline::Run(const CpuImagePlane& input, const ImageRegion& region,
+                         const KernelParams& params, WorkerPool* worker_pool,
+                         uint8_t* output, KernelTimings* out_timings) {
+  arena_.Reset();
+  const int num_steps = static_cast<int>(steps_.size());
+  const int32_t width = input.width;
+  const int32_t height = input.height;
+
+  // Every step covers what the steps after it read.
+  ImageRegion regions[kMaxKernelSteps];
+  regions[num_steps - 1] = region;
+  for (int k = num_steps - 2; k >= 0; --k) {
+    regions[k] = ExpandRegion(regions[k + 1], steps_[k + 1]->GetSpec().halo,
+                              width, height);
+  }
+
+  const uint8_t* step_input = input.pixels;
+  int32_t step_input_stride = input.stride;
+  out_timings->num_steps = num_steps;
+  for (int k = 0; k < num_steps; ++k) {
+    const auto start = std::chrono::steady_clock::now();
+    const VisionKernel* kernel = steps_[k];
+    const ImageRegion& step_region = regions[k];
+    uint8_t* step_output =
+        k + 1 == num_steps ? output : arena_.Allocate(width * height);
+
+    // Each band reads its halo from the shared input and writes only its own
+    // rows.
+    const int32_t region_height = step_region.bottom - step_region.top;
+    const int num_bands =
+        std::max(1, std::min(worker_pool->GetThreadCount() * kBandsPerThread,
+                             region_height / kMinRowsPerBand));
+    const int rows_per_band = (region_height + num_bands - 1) / num_bands;
+    worker_pool->Run(num_bands, [&](int band) {
+      ImageRegion band_region = step_region;
+      band_region.top = step_region.top + band * rows_per_band;
+      band_region.bottom =
+          std::min(step_region.bottom, band_region.top + rows_per_band);
+      kernel->Process(step_input, step_input_stride, width, height,
+                      band_region, params, step_output);
+    });
+
+    out_timings->names[k] = kernel->GetSpec().name;
+    out_timings->ms[k] = std::chrono::duration<float, std::milli>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+    step_input = step_output;
+    step_input_stride = width;
+  }
+}
+
+}  // namespace computer_vision
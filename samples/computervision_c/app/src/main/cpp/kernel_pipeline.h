@@ -0,0 +1,66 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_COMPUTER_VISION_KERNEL_PIPELINE_H_
+#define C_ARCORE_COMPUTER_VISION_KERNEL_PIPELINE_H_
+
+#include <string>
+#include <vector>
+
+#include "cpu_image_renderer.h"
+#include "edge_detector.h"
+#include "scratch_arena.h"
+#include "vision_kernel.h"
+#include "worker_pool.h"
+
+namespace computer_vision {
+
+// Chain of VisionKernels run on the luminance plane of a frame, e.g.
+// box_blur -> sobel_magnitude -> threshold.
+//
+// Every step runs over row bands on the worker pool and is timed.  The
+// outputs of all but the last step are scratch planes from a per-frame arena,
+// and every step but the last covers the halo the steps after it read.  The
+// chain must start on luminance and end in an edge mask, which the renderer
+// draws.
+class KernelPipeline {
+ public:
+  // Starts out as the single step "sobel_edge".
+  KernelPipeline();
+
+  KernelPipeline(const KernelPipeline&) = delete;
+  KernelPipeline& operator=(const KernelPipeline&) = delete;
+
+  // Replaces the chain by the kernels called |names|.  Returns false and keeps
+  // the current chain if a name is unknown, the chain is longer than
+  // kMaxKernelSteps or the formats of two steps do not match.
+  bool SetChain(const std::vector<std::string>& names);
+
+  // Runs the chain with |params| on |region| of |input| and writes the result
+  // to the same region of |output|, a plane of the size of |input| with rows
+  // of its width.  Returns the duration of every step in |out_timings|.
+  void Run(const CpuImagePlane& input, const ImageRegion& region,
+           const KernelParams& params, WorkerPool* worker_pool,
+           uint8_t* output, KernelTimings* out_timings);
+
+ private:
+  std::vector<const VisionKernel*> steps_;
+  ScratchArena arena_;
+};
+
+}  // namespace computer_vision
+
+#endif  // C_ARCORE_COMPUTER_VISION_KERNEL_PIPELINE_H_
@@ -0,0 +1,218 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "luminance_histogram.h"
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "cpu_features.h"
+
+namespace computer_vision {
+
+constexpr int LuminanceStats::kNumBins;
+
+namespace {
+constexpr int kNumBins = LuminanceStats::kNumBins;
+// Histograms counted per band, see CountRowNeon().
+constexpr int kHistogramsPerBand = 4;
+constexpr int kBinsPerBand = kHistogramsPerBand * kNumBins;
+// The fewest sampled rows worth a band of their own.  Every band has its own
+// histograms, so there is only one band per thread.
+constexpr int32_t kMinRowsPerBand = 32;
+
+constexpr float kContrastLowFraction = 0.05f;
+constexpr float kContrastHighFraction = 0.95f;
+
+// Counts |count| pixels |step| bytes apart from |row| on.
+void CountRowScalar(const uint8_t* row, int32_t count, int32_t step,
+                    uint32_t* histogram) {
+  for (int32_t i = 0; i < count; ++i) {
+    ++histogram[row[i * step]];
+  }
+}
+
+// Adds the kHistogramsPerBand |partial| histograms of |num_bands| bands to
+// |histogram|.
+void MergeScalar(const uint32_t* partials, int num_bands,
+                 uint32_t* histogram) {
+  for (int h = 0; h < num_bands * kHistogramsPerBand; ++h) {
+    const uint32_t* partial = partials + h * kNumBins;
+    for (int bin = 0; bin < kNumBins; ++bin) {
+      histogram[bin] += partial[bin];
+    }
+  }
+}
+
+#if defined(__ARM_NEON)
+constexpr int kNeonPixelsPerIteration = 16;
+
+// Same as CountRowScalar(), spreading consecutive pixels over the
+// kHistogramsPerBand |histograms|.  The last vector must not read past the
+// |row_size| bytes of the row.
+void CountRowNeon(const uint8_t* row, int32_t count, int32_t step,
+                  int32_t row_size, uint32_t* histograms) {
+  uint32_t* const first = histograms;
+  uint32_t* const second = histograms + kNumBins;
+  uint32_t* const third = histograms + 2 * kNumBins;
+  uint32_t* const fourth = histograms + 3 * kNumBins;
+  uint8_t lanes[kNeonPixelsPerIteration];
+  int32_t i = 0;
+  if (step == 1 || step == 2 || step == 4) {
+    for (; (i + kNeonPixelsPerIteration) * step <= row_size;
+         i += kNeonPixelsPerIteration) {
+      const uint8_t* pixels = row + i * step;
+      uint8x16_t values;
+      if (step == 1) {
+        values = vld1q_u8(pixels);
+      } else if (step == 2) {
+        values = vld2q_u8(pixels).val[0];
+      } else {
+        values = vld4q_u8(pixels).val[0];
+      }
+      vst1q_u8(lanes, values);
+      for (int lane = 0; lane < kNeonPixelsPerIteration;
+           lane += kHistogramsPerBand) {
+        ++first[lanes[lane]];
+        ++second[lanes[lane + 1]];
+        ++third[lanes[lane + 2]];
+        ++fourth[lanes[lane + 3]];
+      }
+    }
+  }
+  for (; i < count; ++i) {
+    ++histograms[(i % kHistogramsPerBand) * kNumBins + row[i * step]];
+  }
+}
+
+void MergeNeon(const uint32_t* partials, int num_bands, uint32_t* histogram) {
+  for (int bin = 0; bin < kNumBins; bin += 4) {
+    uint32x4_t sum = vld1q_u32(histogram + bin);
+    for (int h = 0; h < num_bands * kHistogramsPerBand; ++h) {
+      sum = vaddq_u32(sum, vld1q_u32(partials + h * kNumBins + bin));
+    }
+    vst1q_u32(histogram + bin, sum);
+  }
+}
+#endif  // __ARM_NEON
+}  // namespace
+
+int32_t LuminanceStats::GetPercentile(float fraction) const {
+  const uint64_t target = static_cast<uint64_t>(
+      std::ceil(std::max(0.f, std::min(fraction, 1.f)) * count));
+  uint64_t cumulative = 0;
+  for (int bin = 0; bin < kNumBins; ++bin) {
+    cumulative += histogram[bin];
+    if (cumulative >= target && cumulative > 0) {
+      return bin;
+    }
+  }
+  return 0;
+}
+
+int32_t LuminanceStats::GetContrast() const {
+  return GetPercentile(kContrastHighFraction) -
+         GetPercentile(kContrastLowFraction);
+}
+
+void LuminanceHistogram::Compute(const CpuImagePlane& plane,
+                                 const ImageRegion& region, int32_t step,
+                                 WorkerPool* worker_pool,
+                                 LuminanceStats* out_stats) {
+  const LuminanceHistogramVariant variant =
+      IsVariantSupported(LuminanceHistogramVariant::kNeon)
+          ? LuminanceHistogramVariant::kNeon
+          : LuminanceHistogramVariant::kScalar;
+  ComputeWithVariant(variant, plane, region, step, worker_pool, out_stats);
+}
+
+void LuminanceHistogram::ComputeWithVariant(LuminanceHistogramVariant variant,
+                                            const CpuImagePlane& plane,
+                                            const ImageRegion& region,
+                                            int32_t step,
+                                            WorkerPool* worker_pool,
+                                            LuminanceStats* out_stats) {
+  *out_stats = LuminanceStats();
+  step = std::max(step, 1);
+  const int32_t left = std::max(region.left, 0);
+  const int32_t top = std::max(region.top, 0);
+  const int32_t row_size = std::min(region.right, plane.width) - left;
+  const int32_t height = std::min(region.bottom, plane.height) - top;
+  if (row_size <= 0 || height <= 0) {
+    return;
+  }
+  const int32_t columns = (row_size + step - 1) / step;
+  const int32_t rows = (height + step - 1) / step;
+  const int num_bands = std::max(
+      1, std::min(worker_pool->GetThreadCount(), rows / kMinRowsPerBand));
+  const int32_t rows_per_band = (rows + num_bands - 1) / num_bands;
+  partials_.resize(num_bands * kBinsPerBand);
+  worker_pool->Run(num_bands, [&](int band) {
+    uint32_t* histograms = partials_.data() + band * kBinsPerBand;
+    memset(histograms, 0, kBinsPerBand * sizeof(uint32_t));
+    const int32_t end = std::min(rows, (band + 1) * rows_per_band);
+    for (int32_t row = band * rows_per_band; row < end; ++row) {
+      const uint8_t* pixels =
+          plane.pixels + (top + row * step) * plane.stride + left;
+#if defined(__ARM_NEON)
+      if (variant == LuminanceHistogramVariant::kNeon) {
+        CountRowNeon(pixels, columns, step, row_size, histograms);
+        continue;
+      }
+#endif  // __ARM_NEON
+      CountRowScalar(pixels, columns, step, histograms);
+    }
+  });
+
+#if defined(__ARM_NEON)
+  if (variant == LuminanceHistogramVariant::kNeon) {
+    MergeNeon(partials_.data(), num_bands, out_stats->histogram);
+  } else {
+    MergeScalar(partials_.data(), num_bands, out_stats->histogram);
+  }
+#else
+  MergeScalar(partials_.data(), num_bands, out_stats->histogram);
+#endif  // __ARM_NEON
+
+  uint64_t sum = 0;
+  for (int bin = 0; bin < kNumBins; ++bin) {
+    sum += static_cast<uint64_t>(bin) * out_stats->histogram[bin];
+  }
+  out_stats->count = static_cast<uint32_t>(columns) * rows;
+  out_stats->mean = static_cast<float>(sum) / out_stats->count;
+}
+
+bool LuminanceHistogram::IsVariantSupported(
+    LuminanceHistogramVariant variant) {
+  switch (variant) {
+    case LuminanceHistogramVariant::kScalar:
+      return true;
+    case LuminanceHistogramVariant::kNeon:
+#if defined(__ARM_NEON)
+      return IsNeonSupported();
+#else
+      return false;
+#endif  // __ARM_NEON
+  }
+  return false;
+}
+
+}  // namespace computer_vision
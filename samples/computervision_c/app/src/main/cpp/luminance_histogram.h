@@ -0,0 +1,87 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_COMPUTER_VISION_LUMINANCE_HISTOGRAM_H_
+#define C_ARCORE_COMPUTER_VISION_LUMINANCE_HISTOGRAM_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "cpu_image_renderer.h"
+#include "edge_detector.h"
+#include "worker_pool.h"
+
+namespace computer_vision {
+
+// Distribution of the luminance of an image region.
+struct LuminanceStats {
+  static constexpr int kNumBins = 256;
+
+  uint32_t histogram[kNumBins] = {};
+  // Pixels counted, and their mean luminance.
+  uint32_t count = 0;
+  float mean = 0.f;
+
+  // The smallest luminance that at least |fraction| of the pixels are at or
+  // below, 0 for an empty histogram.
+  int32_t GetPercentile(float fraction) const;
+
+  // Spread of the middle 90% of the pixels, from the 5th to the 95th
+  // percentile.
+  int32_t GetContrast() const;
+};
+
+// Implementations of LuminanceHistogram::Compute().  Exposed to compare them,
+// e.g. in RunKernelBenchmark().
+enum class LuminanceHistogramVariant { kScalar, kNeon };
+
+// Counts the luminance of the pixels of a region, optionally of every
+// |step|-th pixel of every |step|-th row only.
+//
+// Row bands are counted on a WorkerPool into partial histograms of their own,
+// which are merged at the end, so the threads never share a counter.  NEON
+// loads 16 pixels at a time, deinterleaving the subsampled ones for steps of
+// 2 and 4, and spreads consecutive pixels over four histograms per band, so
+// runs of the same luminance do not wait on each other's increments.  The
+// partial histograms are kept across frames.
+class LuminanceHistogram {
+ public:
+  LuminanceHistogram() = default;
+
+  LuminanceHistogram(const LuminanceHistogram&) = delete;
+  LuminanceHistogram& operator=(const LuminanceHistogram&) = delete;
+
+  // Writes the histogram and mean of |region| of |plane| to |out_stats|,
+  // sampling every |step| pixels in both directions.
+  void Compute(const CpuImagePlane& plane, const ImageRegion& region,
+               int32_t step, WorkerPool* worker_pool,
+               LuminanceStats* out_stats);
+
+  // Compute() with |variant|, which must be supported.
+  void ComputeWithVariant(LuminanceHistogramVariant variant,
+                          const CpuImagePlane& plane,
+                          const ImageRegion& region, int32_t step,
+                          WorkerPool* worker_pool, LuminanceStats* out_stats);
+
+  static bool IsVariantSupported(LuminanceHistogramVariant variant);
+
+ private:
+  std::vector<uint32_t> partials_;
+};
+
+}  // namespace computer_vision
+
+#endif  // C_ARCORE_COMPUTER_VISION_LUMINANCE_HISTOGRAM_H_
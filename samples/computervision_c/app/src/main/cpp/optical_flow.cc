@@ -0,0 +1,553 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "optical_flow.h"
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+#include "cpu_features.h"
+#include "util.h"
+
+namespace computer_vision {
+
+constexpr int OpticalFlowParams::kMaxWindowRadius;
+
+namespace {
+// Window of the current frame, and the window of the previous frame with the
+// one pixel border its central differences read.
+constexpr int kMaxWindowSize = 2 * OpticalFlowParams::kMaxWindowRadius + 1;
+constexpr int kMaxPatchSize = kMaxWindowSize + 2;
+
+// Bilinear weights in 14 bit fixed point, so 255 times a weight sum to less
+// than 2^24 and convert to float exactly.
+constexpr int kWeightBits = 14;
+constexpr int kWeightOne = 1 << kWeightBits;
+constexpr float kInverseWeightOne = 1.f / kWeightOne;
+
+// Tasks per thread of the worker pool, and the fewest points worth a task.
+constexpr int kTasksPerThread = 4;
+constexpr int kMinPointsPerTask = 8;
+
+// Structure tensors with a smaller determinant are singular.
+constexpr float kMinDeterminant = 1e-6f;
+
+// Weights of the four pixels around a point, from the top left clockwise to
+// the bottom left, summing to kWeightOne.
+struct BilinearWeights {
+  uint16_t top_left;
+  uint16_t top_right;
+  uint16_t bottom_right;
+  uint16_t bottom_left;
+};
+
+// Splits |x|, |y| into the pixel at or before them and the weights of it and
+// its neighbours.
+BilinearWeights GetBilinearWeights(float x, float y, int32_t* out_x,
+                                   int32_t* out_y) {
+  const float floor_x = std::floor(x);
+  const float floor_y = std::floor(y);
+  *out_x = static_cast<int32_t>(floor_x);
+  *out_y = static_cast<int32_t>(floor_y);
+  const float a = x - floor_x;
+  const float b = y - floor_y;
+  BilinearWeights weights;
+  weights.top_left =
+      static_cast<uint16_t>(std::lround((1.f - a) * (1.f - b) * kWeightOne));
+  weights.top_right =
+      static_cast<uint16_t>(std::lround(a * (1.f - b) * kWeightOne));
+  weights.bottom_left =
+      static_cast<uint16_t>(std::lround((1.f - a) * b * kWeightOne));
+  weights.bottom_right = static_cast<uint16_t>(
+      kWeightOne - weights.top_left - weights.top_right -
+      weights.bottom_left);
+  return weights;
+}
+
+// Whether the |size| x |size| pixels starting at |x|, |y| and the row and
+// column after them, which the interpolation reads, are inside |plane|.
+bool IsInside(const CpuImagePlane& plane, int32_t x, int32_t y,
+              int32_t size) {
+  return x >= 0 && y >= 0 && x + size < plane.width &&
+         y + size < plane.height;
+}
+
+// Interpolates |size| x |size| pixels of |plane| from |x|, |y| on with
+// |weights| into |output|, which has rows of |output_stride| floats.
+void InterpolateScalar(const CpuImagePlane& plane, int32_t x, int32_t y,
+                       const BilinearWeights& weights, int size,
+                       float* output, int output_stride) {
+  for (int row = 0; row < size; ++row) {
+    const uint8_t* top = plane.pixels + (y + row) * plane.stride + x;
+    const uint8_t* bottom = top + plane.stride;
+    float* output_row = output + row * output_stride;
+    for (int column = 0; column < size; ++column) {
+      const uint32_t sum = weights.top_left * top[column] +
+                           weights.top_right * top[column + 1] +
+                           weights.bottom_right * bottom[column + 1] +
+                           weights.bottom_left * bottom[column];
+      output_row[column] = static_cast<float>(sum) * kInverseWeightOne;
+    }
+  }
+}
+
+// Sums of the gradient structure tensor of a window.
+struct WindowSums {
+  float xx = 0.f;
+  float xy = 0.f;
+  float yy = 0.f;
+};
+
+// Takes the central differences of the |size| x |size| window inside
+// |patch|, which has a one pixel border and rows of kMaxPatchSize floats, into
+// |gradient_x| and |gradient_y|, copies the window to |window| and returns
+// the structure tensor.  The outputs have rows of kMaxWindowSize floats.
+WindowSums AccumulateGradientsScalar(const float* patch, int size,
+                                     float* window, float* gradient_x,
+                                     float* gradient_y) {
+  WindowSums sums;
+  for (int row = 0; row < size; ++row) {
+    const float* above = patch + row * kMaxPatchSize + 1;
+    const float* center = above + kMaxPatchSize;
+    const float* below = center + kMaxPatchSize;
+    const int offset = row * kMaxWindowSize;
+    for (int column = 0; column < size; ++column) {
+      const float dx = (center[column + 1] - center[column - 1]) * 0.5f;
+      const float dy = (below[column] - above[column]) * 0.5f;
+      window[offset + column] = center[column];
+      gradient_x[offset + column] = dx;
+      gradient_y[offset + column] = dy;
+      sums.xx += dx * dx;
+      sums.xy += dx * dy;
+      sums.yy += dy * dy;
+    }
+  }
+  return sums;
+}
+
+// Mismatch of the current window against the previous one, projected on the
+// gradients, and the sum of its absolute values.
+struct MismatchSums {
+  float x = 0.f;
+  float y = 0.f;
+  float absolute = 0.f;
+};
+
+MismatchSums AccumulateMismatchScalar(const float* current,
+                                      const float* previous,
+                                      const float* gradient_x,
+                                      const float* gradient_y, int size) {
+  MismatchSums sums;
+  for (int row = 0; row < size; ++row) {
+    const int offset = row * kMaxWindowSize;
+    for (int column = 0; column < size; ++column) {
+      const int i = offset + column;
+      const float difference = current[i] - previous[i];
+      sums.x += difference * gradient_x[i];
+      sums.y += difference * gradient_y[i];
+      sums.absolute += std::fabs(difference);
+    }
+  }
+  return sums;
+}
+
+#if defined(__ARM_NEON)
+float HorizontalSum(float32x4_t values) {
+#if defined(__aarch64__)
+  return vaddvq_f32(values);
+#else
+  const float32x2_t pairs = vadd_f32(vget_low_f32(values),
+                                     vget_high_f32(values));
+  return vget_lane_f32(vpadd_f32(pairs, pairs), 0);
+#endif  // __aarch64__
+}
+
+// Same as InterpolateScalar(), 8 pixels of a row at a time as long as the
+// 9 bytes they read are inside the window, which makes the results the same.
+void InterpolateNeon(const CpuImagePlane& plane, int32_t x, int32_t y,
+                     const BilinearWeights& weights, int size, float* output,
+                     int output_stride) {
+  const float32x4_t scale = vdupq_n_f32(kInverseWeightOne);
+  for (int row = 0; row < size; ++row) {
+    const uint8_t* top = plane.pixels + (y + row) * plane.stride + x;
+    const uint8_t* bottom = top + plane.stride;
+    float* output_row = output + row * output_stride;
+    int column = 0;
+    for (; column + 8 <= size; column += 8) {
+      const uint16x8_t top_left = vmovl_u8(vld1_u8(top + column));
+      const uint16x8_t top_right = vmovl_u8(vld1_u8(top + column + 1));
+      const uint16x8_t bottom_left = vmovl_u8(vld1_u8(bottom + column));
+      const uint16x8_t bottom_right = vmovl_u8(vld1_u8(bottom + column + 1));
+      uint32x4_t low = vmull_n_u16(vget_low_u16(top_left), weights.top_left);
+      low = vmlal_n_u16(low, vget_low_u16(top_right), weights.top_right);
+      low = vmlal_n_u16(low, vget_low_u16(bottom_right),
+                        weights.bottom_right);
+      low = vmlal_n_u16(low, vget_low_u16(bottom_left), weights.bottom_left);
+      uint32x4_t high =
+          vmull_n_u16(vget_high_u16(top_left), weights.top_left);
+      high = vmlal_n_u16(high, vget_high_u16(top_right), weights.top_right);
+      high = vmlal_n_u16(high, vget_high_u16(bottom_right),
+                         weights.bottom_right);
+      high = vmlal_n_u16(high, vget_high_u16(bottom_left),
+                         weights.bottom_left);
+      vst1q_f32(output_row + column, vmulq_f32(vcvtq_f32_u32(low), scale));
+      vst1q_f32(output_row + column + 4,
+                vmulq_f32(vcvtq_f32_u32(high), scale));
+    }
+    for (; column < size; ++column) {
+      const uint32_t sum = weights.top_left * top[column] +
+                           weights.top_right * top[column + 1] +
+                           weights.bottom_right * bottom[column + 1] +
+                           weights.bottom_left * bottom[column];
+      output_row[column] = static_cast<float>(sum) * kInverseWeightOne;
+    }
+  }
+}
+
+// Same as AccumulateGradientsScalar(), 4 pixels at a time.  The sums differ
+// from the scalar ones by rounding.
+WindowSums AccumulateGradientsNeon(const float* patch, int size,
+                                   float* window, float* gradient_x,
+                                   float* gradient_y) {
+  const float32x4_t half = vdupq_n_f32(0.5f);
+  float32x4_t xx = vdupq_n_f32(0.f);
+  float32x4_t xy = vdupq_n_f32(0.f);
+  float32x4_t yy = vdupq_n_f32(0.f);
+  WindowSums sums;
+  for (int row = 0; row < size; ++row) {
+    const float* above = patch + row * kMaxPatchSize + 1;
+    const float* center = above + kMaxPatchSize;
+    const float* below = center + kMaxPatchSize;
+    const int offset = row * kMaxWindowSize;
+    int column = 0;
+    for (; column + 4 <= size; column += 4) {
+      const float32x4_t dx = vmulq_f32(
+          vsubq_f32(vld1q_f32(center + column + 1),
+                    vld1q_f32(center + column - 1)),
+          half);
+      const float32x4_t dy = vmulq_f32(
+          vsubq_f32(vld1q_f32(below + column), vld1q_f32(above + column)),
+          half);
+      vst1q_f32(window + offset + column, vld1q_f32(center + column));
+      vst1q_f32(gradient_x + offset + column, dx);
+      vst1q_f32(gradient_y + offset + column, dy);
+      xx = vmlaq_f32(xx, dx, dx);
+      xy = vmlaq_f32(xy, dx, dy);
+      yy = vmlaq_f32(yy, dy, dy);
+    }
+    for (; column < size; ++column) {
+      const float dx = (center[column + 1] - center[column - 1]) * 0.5f;
+      const float dy = (below[column] - above[column]) * 0.5f;
+      window[offset + column] = center[column];
+      gradient_x[offset + column] = dx;
+      gradient_y[offset + column] = dy;
+      sums.xx += dx * dx;
+      sums.xy += dx * dy;
+      sums.yy += dy * dy;
+    }
+  }
+  sums.xx += HorizontalSum(xx);
+  sums.xy += HorizontalSum(xy);
+  sums.yy += HorizontalSum(yy);
+  return sums;
+}
+
+MismatchSums AccumulateMismatchNeon(const float* current,
+                                    const float* previous,
+                                    const float* gradient_x,
+                                    const float* gradient_y, int size) {
+  float32x4_t x = vdupq_n_f32(0.f);
+  float32x4_t y = vdupq_n_f32(0.f);
+  float32x4_t absolute = vdupq_n_f32(0.f);
+  MismatchSums sums;
+  for (int row = 0; row < size; ++row) {
+    const int offset = row * kMaxWindowSize;
+    int column = 0;
+    for (; column + 4 <= size; column += 4) {
+      const int i = offset + column;
+      const float32x4_t difference =
+          vsubq_f32(vld1q_f32(current + i), vld1q_f32(previous + i));
+      x = vmlaq_f32(x, difference, vld1q_f32(gradient_x + i));
+      y = vmlaq_f32(y, difference, vld1q_f32(gradient_y + i));
+      absolute = vaddq_f32(absolute, vabsq_f32(difference));
+    }
+    for (; column < size; ++column) {
+      const int i = offset + column;
+      const float difference = current[i] - previous[i];
+      sums.x += difference * gradient_x[i];
+      sums.y += difference * gradient_y[i];
+      sums.absolute += std::fabs(difference);
+    }
+  }
+  sums.x += HorizontalSum(x);
+  sums.y += HorizontalSum(y);
+  sums.absolute += HorizontalSum(absolute);
+  return sums;
+}
+#endif  // __ARM_NEON
+
+void Interpolate(OpticalFlowVariant variant, const CpuImagePlane& plane,
+                 int32_t x, int32_t y, const BilinearWeights& weights,
+                 int size, float* output, int output_stride) {
+#if defined(__ARM_NEON)
+  if (variant == OpticalFlowVariant::kNeon) {
+    InterpolateNeon(plane, x, y, weights, size, output, output_stride);
+    return;
+  }
+#endif  // __ARM_NEON
+  InterpolateScalar(plane, x, y, weights, size, output, output_stride);
+}
+
+WindowSums AccumulateGradients(OpticalFlowVariant variant, const float* patch,
+                               int size, float* window, float* gradient_x,
+                               float* gradient_y) {
+#if defined(__ARM_NEON)
+  if (variant == OpticalFlowVariant::kNeon) {
+    return AccumulateGradientsNeon(patch, size, window, gradient_x,
+                                   gradient_y);
+  }
+#endif  // __ARM_NEON
+  return AccumulateGradientsScalar(patch, size, window, gradient_x,
+                                   gradient_y);
+}
+
+MismatchSums AccumulateMismatch(OpticalFlowVariant variant,
+                                const float* current, const float* previous,
+                                const float* gradient_x,
+                                const float* gradient_y, int size) {
+#if defined(__ARM_NEON)
+  if (variant == OpticalFlowVariant::kNeon) {
+    return AccumulateMismatchNeon(current, previous, gradient_x, gradient_y,
+                                  size);
+  }
+#endif  // __ARM_NEON
+  return AccumulateMismatchScalar(current, previous, gradient_x, gradient_y,
+                                  size);
+}
+
+// Tracks |point| from the |num_levels| levels of |previous| into those of
+// |current|.
+TrackedPoint TrackPoint(OpticalFlowVariant variant,
+                        const CpuImagePlane* previous,
+                        const CpuImagePlane* current, int num_levels,
+                        const OpticalFlowParams& params,
+                        const FlowPoint& point) {
+  const int radius = params.window_radius;
+  const int size = 2 * radius + 1;
+  const float inverse_area = 1.f / (size * size);
+  float patch[kMaxPatchSize * kMaxPatchSize];
+  float previous_window[kMaxWindowSize * kMaxWindowSize];
+  float current_window[kMaxWindowSize * kMaxWindowSize];
+  float gradient_x[kMaxWindowSize * kMaxWindowSize];
+  float gradient_y[kMaxWindowSize * kMaxWindowSize];
+
+  TrackedPoint result;
+  // Flow from the levels above, and the flow found on this level.
+  float guess_x = 0.f;
+  float guess_y = 0.f;
+  for (int level = num_levels - 1; level >= 0; --level) {
+    const float level_scale = 1.f / static_cast<float>(1 << level);
+    const float x = point.x * level_scale;
+    const float y = point.y * level_scale;
+
+    int32_t patch_x = 0;
+    int32_t patch_y = 0;
+    const BilinearWeights patch_weights = GetBilinearWeights(
+        x - radius - 1, y - radius - 1, &patch_x, &patch_y);
+    if (!IsInside(previous[level], patch_x, patch_y, size + 2)) {
+      return result;
+    }
+    Interpolate(variant, previous[level], patch_x, patch_y, patch_weights,
+                size + 2, patch, kMaxPatchSize);
+    const WindowSums tensor = AccumulateGradients(
+        variant, patch, size, previous_window, gradient_x, gradient_y);
+    const float determinant = tensor.xx * tensor.yy - tensor.xy * tensor.xy;
+    const float min_eigenvalue =
+        (tensor.xx + tensor.yy -
+         std::sqrt((tensor.xx - tensor.yy) * (tensor.xx - tensor.yy) +
+                   4.f * tensor.xy * tensor.xy)) *
+        0.5f * inverse_area;
+    if (min_eigenvalue < params.min_eigenvalue ||
+        determinant < kMinDeterminant) {
+      return result;
+    }
+    const float inverse_determinant = 1.f / determinant;
+
+    float flow_x = 0.f;
+    float flow_y = 0.f;
+    for (int iteration = 0; iteration < params.max_iterations; ++iteration) {
+      int32_t window_x = 0;
+      int32_t window_y = 0;
+      const BilinearWeights window_weights = GetBilinearWeights(
+          x + guess_x + flow_x - radius, y + guess_y + flow_y - radius,
+          &window_x, &window_y);
+      if (!IsInside(current[level], window_x, window_y, size)) {
+        return result;
+      }
+      Interpolate(variant, current[level], window_x, window_y,
+                  window_weights, size, current_window, kMaxWindowSize);
+      const MismatchSums mismatch =
+          AccumulateMismatch(variant, current_window, previous_window,
+                             gradient_x, gradient_y, size);
+      result.error = mismatch.absolute * inverse_area;
+      // Solves the structure tensor times the step for minus the mismatch.
+      const float step_x =
+          (tensor.xy * mismatch.y - tensor.yy * mismatch.x) *
+          inverse_determinant;
+      const float step_y =
+          (tensor.xy * mismatch.x - tensor.xx * mismatch.y) *
+          inverse_determinant;
+      flow_x += step_x;
+      flow_y += step_y;
+      if (step_x * step_x + step_y * step_y <
+          params.min_step * params.min_step) {
+        break;
+      }
+    }
+
+    if (level > 0) {
+      guess_x = 2.f * (guess_x + flow_x);
+      guess_y = 2.f * (guess_y + flow_y);
+    } else {
+      result.point.x = x + guess_x + flow_x;
+      result.point.y = y + guess_y + flow_y;
+    }
+  }
+  result.tracked = result.error <= params.max_error;
+  return result;
+}
+
+#if defined(__ARM_NEON) && !defined(NDEBUG)
+// Checks once that the NEON path finds the point the scalar one does, up to
+// the rounding of the sums.
+void VerifyNeonFlow(const CpuImagePlane* previous,
+                    const CpuImagePlane* current, int num_levels,
+                    const OpticalFlowParams& params, const FlowPoint& point,
+                    const TrackedPoint& neon_result) {
+  static std::atomic<bool> verified{false};
+  if (!neon_result.tracked || verified.exchange(true)) {
+    return;
+  }
+  const TrackedPoint scalar_result =
+      TrackPoint(OpticalFlowVariant::kScalar, previous, current, num_levels,
+                 params, point);
+  constexpr float kTolerance = 0.01f;
+  if (!scalar_result.tracked ||
+      std::fabs(scalar_result.point.x - neon_result.point.x) > kTolerance ||
+      std::fabs(scalar_result.point.y - neon_result.point.y) > kTolerance) {
+    LOGE("OpticalFlowTracker: NEON flow differs from the scalar one");
+  }
+}
+#endif  // __ARM_NEON && !NDEBUG
+}  // namespace
+
+void OpticalFlowTracker::SetParams(const OpticalFlowParams& params) {
+  params_ = params;
+  params_.window_radius = std::max(
+      1, std::min(params.window_radius, OpticalFlowParams::kMaxWindowRadius));
+  params_.max_level =
+      std::max(0, std::min(params.max_level, ImagePyramid::kMaxLevel));
+  params_.max_iterations = std::max(1, params.max_iterations);
+}
+
+bool OpticalFlowTracker::Track(ImagePyramid* pyramid,
+                               const FlowPoint* points, int count,
+                               WorkerPool* worker_pool,
+                               TrackedPoint* results) {
+  const OpticalFlowVariant variant =
+      IsVariantSupported(OpticalFlowVariant::kNeon)
+          ? OpticalFlowVariant::kNeon
+          : OpticalFlowVariant::kScalar;
+  return TrackWithVariant(variant, pyramid, points, count, worker_pool,
+                          results);
+}
+
+bool OpticalFlowTracker::TrackWithVariant(OpticalFlowVariant variant,
+                                          ImagePyramid* pyramid,
+                                          const FlowPoint* points, int count,
+                                          WorkerPool* worker_pool,
+                                          TrackedPoint* results) {
+  const int num_levels =
+      std::min(pyramid->BuildLevel(params_.max_level) + 1, num_levels_);
+  const CpuImagePlane& base = pyramid->GetLevel(0);
+  const bool has_previous = num_levels > 0 &&
+                            previous_[0].width == base.width &&
+                            previous_[0].height == base.height;
+  if (has_previous && count > 0) {
+    CpuImagePlane current[ImagePyramid::kMaxLevel + 1];
+    for (int level = 0; level < num_levels; ++level) {
+      current[level] = pyramid->GetLevel(level);
+    }
+    const int num_tasks = std::max(
+        1, std::min(worker_pool->GetThreadCount() * kTasksPerThread,
+                    (count + kMinPointsPerTask - 1) / kMinPointsPerTask));
+    const int points_per_task = (count + num_tasks - 1) / num_tasks;
+    worker_pool->Run(num_tasks, [&](int task) {
+      const int end = std::min(count, (task + 1) * points_per_task);
+      for (int i = task * points_per_task; i < end; ++i) {
+        results[i] = TrackPoint(variant, previous_, current, num_levels,
+                                params_, points[i]);
+      }
+    });
+#if defined(__ARM_NEON) && !defined(NDEBUG)
+    if (variant == OpticalFlowVariant::kNeon) {
+      VerifyNeonFlow(previous_, current, num_levels, params_, points[0],
+                     results[0]);
+    }
+#endif  // __ARM_NEON && !NDEBUG
+  }
+  SetPreviousFrame(pyramid);
+  return has_previous;
+}
+
+void OpticalFlowTracker::SetPreviousFrame(ImagePyramid* pyramid) {
+  num_levels_ = pyramid->BuildLevel(params_.max_level) + 1;
+  for (int level = 0; level < num_levels_; ++level) {
+    const CpuImagePlane& plane = pyramid->GetLevel(level);
+    std::vector<uint8_t>& storage = storage_[level];
+    storage.resize(plane.width * plane.height);
+    for (int32_t y = 0; y < plane.height; ++y) {
+      memcpy(storage.data() + y * plane.width,
+             plane.pixels + y * plane.stride, plane.width);
+    }
+    previous_[level].pixels = storage.data();
+    previous_[level].width = plane.width;
+    previous_[level].height = plane.height;
+    previous_[level].stride = plane.width;
+  }
+}
+
+bool OpticalFlowTracker::IsVariantSupported(OpticalFlowVariant variant) {
+  switch (variant) {
+    case OpticalFlowVariant::kScalar:
+      return true;
+    case OpticalFlowVariant::kNeon:
+#if defined(__ARM_NEON)
+      return IsNeonSupported();
+#else
+      return false;
+#endif  // __ARM_NEON
+  }
+  return false;
+}
+
+}  // namespace computer_vision
@@ -0,0 +1,126 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_COMPUTER_VISION_OPTICAL_FLOW_H_
+#define C_ARCORE_COMPUTER_VISION_OPTICAL_FLOW_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "cpu_image_renderer.h"
+#include "image_pyramid.h"
+#include "worker_pool.h"
+
+namespace computer_vision {
+
+// A point of a luminance plane, in pixels of pyramid level 0.
+struct FlowPoint {
+  float x = 0.f;
+  float y = 0.f;
+};
+
+// Where OpticalFlowTracker found a point in the current frame.
+struct TrackedPoint {
+  FlowPoint point;
+  // False if the window around the point left the image, was too flat to
+  // track or matched worse than max_error.  |point| is then unspecified.
+  bool tracked = false;
+  // Mean absolute difference of the matched windows, in luminance levels.
+  float error = 0.f;
+};
+
+struct OpticalFlowParams {
+  static constexpr int kMaxWindowRadius = 7;
+
+  // Half the side of the square window matched around every point, at most
+  // kMaxWindowRadius.
+  int window_radius = 7;
+  // Coarsest pyramid level the search starts on.  Motion of up to about
+  // window_radius * 2^max_level pixels is followed.
+  int max_level = ImagePyramid::kMaxLevel;
+  // Gauss-Newton iterations per level, which stop early once a step is
+  // shorter than |min_step| pixels.
+  int max_iterations = 10;
+  float min_step = 0.01f;
+  // Windows whose gradient structure tensor has a smaller eigenvalue, per
+  // pixel, do not constrain the flow in one direction and are not tracked.
+  float min_eigenvalue = 0.25f;
+  float max_error = 24.f;
+};
+
+// Implementations of OpticalFlowTracker::Track().  Exposed to compare them,
+// e.g. in RunKernelBenchmark().
+enum class OpticalFlowVariant { kScalar, kNeon };
+
+// Sparse pyramidal Lucas-Kanade optical flow between consecutive luminance
+// planes, e.g. to move 2D labels with the image between ARCore updates
+// without hit testing each of them.
+//
+// Each point is searched from the coarsest level of the pyramid down, the
+// flow found on one level being the start of the next.  On every level the
+// window of the previous frame is interpolated with its gradients once, and
+// the window of the current frame once per iteration, in 14 bit fixed point.
+// NEON interpolates 8 pixels of a row and accumulates 4 at a time, and the
+// points are spread over a WorkerPool.
+//
+// The tracker keeps a copy of the pyramid levels of the last frame, the
+// ImagePyramid the kernels share only holds the current one.  The copy is
+// only reallocated when the image grows.
+class OpticalFlowTracker {
+ public:
+  OpticalFlowTracker() = default;
+
+  OpticalFlowTracker(const OpticalFlowTracker&) = delete;
+  OpticalFlowTracker& operator=(const OpticalFlowTracker&) = delete;
+
+  // Clamps the window radius and level of |params| to what is supported.
+  void SetParams(const OpticalFlowParams& params);
+  const OpticalFlowParams& GetParams() const { return params_; }
+
+  // Tracks |count| points of the previous frame into the frame |pyramid| was
+  // last reset to, writing |results| in the order of |points|, and then keeps
+  // the frame as the previous one.  Builds the levels of |pyramid| it needs.
+  // Returns false and tracks nothing if there is no previous frame of the
+  // same size.
+  bool Track(ImagePyramid* pyramid, const FlowPoint* points, int count,
+             WorkerPool* worker_pool, TrackedPoint* results);
+
+  // Track() with |variant|, which must be supported.
+  bool TrackWithVariant(OpticalFlowVariant variant, ImagePyramid* pyramid,
+                        const FlowPoint* points, int count,
+                        WorkerPool* worker_pool, TrackedPoint* results);
+
+  // Keeps the frame of |pyramid| as the previous one without tracking, e.g.
+  // when points are first detected on it.
+  void SetPreviousFrame(ImagePyramid* pyramid);
+
+  bool HasPreviousFrame() const { return num_levels_ > 0; }
+
+  // Forgets the previous frame, e.g. when the camera config changes.
+  void Reset() { num_levels_ = 0; }
+
+  static bool IsVariantSupported(OpticalFlowVariant variant);
+
+ private:
+  OpticalFlowParams params_;
+  int num_levels_ = 0;
+  CpuImagePlane previous_[ImagePyramid::kMaxLevel + 1];
+  std::vector<uint8_t> storage_[ImagePyramid::kMaxLevel + 1];
+};
+
+}  // namespace computer_vision
+
+#endif  // C_ARCORE_COMPUTER_VISION_OPTICAL_FLOW_H_
@@ -0,0 +1,306 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "overlay_hardware_buffers.h"
+
+#include <dlfcn.h>
+#include <unistd.h>
+
+#include "util.h"
+
+namespace computer_vision {
+
+constexpr int OverlayHardwareBuffers::kNumBuffers;
+
+namespace {
+// Load hardware buffer and fence symbols at runtime, the sample supports
+// devices older than API level 26.
+using PFAHardwareBuffer_allocate = int (*)(const AHardwareBuffer_Desc* desc,
+                                           AHardwareBuffer** out_buffer);
+using PFAHardwareBuffer_release = void (*)(AHardwareBuffer* buffer);
+using PFAHardwareBuffer_describe = void (*)(const AHardwareBuffer* buffer,
+                                            AHardwareBuffer_Desc* out_desc);
+using PFAHardwareBuffer_lock = int (*)(AHardwareBuffer* buffer, uint64_t usage,
+                                       int32_t fence, const ARect* rect,
+                                       void** out_virtual_address);
+using PFAHardwareBuffer_unlock = int (*)(AHardwareBuffer* buffer,
+                                         int32_t* fence);
+using PFeglGetNativeClientBufferANDROID =
+    EGLClientBuffer (*)(const AHardwareBuffer* buffer);
+using PFeglCreateImageKHR = EGLImageKHR (*)(EGLDisplay dpy, EGLContext ctx,
+                                            EGLenum target,
+                                            EGLClientBuffer buffer,
+                                            const EGLint* attrib_list);
+using PFeglDestroyImageKHR = EGLBoolean (*)(EGLDisplay dpy,
+                                            EGLImageKHR image);
+using PFglEGLImageTargetTexture2DOES = void (*)(GLenum target,
+                                                GLeglImageOES image);
+using PFeglCreateSyncKHR = EGLSyncKHR (*)(EGLDisplay dpy, EGLenum type,
+                                          const EGLint* attrib_list);
+using PFeglDestroySyncKHR = EGLBoolean (*)(EGLDisplay dpy, EGLSyncKHR sync);
+using PFeglDupNativeFenceFDANDROID = EGLint (*)(EGLDisplay dpy,
+                                                EGLSyncKHR sync);
+
+struct OverlayFunctions {
+  PFAHardwareBuffer_allocate allocate = nullptr;
+  PFAHardwareBuffer_release release = nullptr;
+  PFAHardwareBuffer_describe describe = nullptr;
+  PFAHardwareBuffer_lock lock = nullptr;
+  PFAHardwareBuffer_unlock unlock = nullptr;
+  PFeglGetNativeClientBufferANDROID get_native_client_buffer = nullptr;
+  PFeglCreateImageKHR create_image = nullptr;
+  PFeglDestroyImageKHR destroy_image = nullptr;
+  PFglEGLImageTargetTexture2DOES image_target_texture = nullptr;
+  PFeglCreateSyncKHR create_sync = nullptr;
+  PFeglDestroySyncKHR destroy_sync = nullptr;
+  PFeglDupNativeFenceFDANDROID dup_native_fence = nullptr;
+
+  bool IsComplete() const {
+    return allocate != nullptr && release != nullptr && describe != nullptr &&
+           lock != nullptr && unlock != nullptr &&
+           get_native_client_buffer != nullptr && create_image != nullptr &&
+           destroy_image != nullptr && image_target_texture != nullptr &&
+           create_sync != nullptr && destroy_sync != nullptr &&
+           dup_native_fence != nullptr;
+  }
+};
+
+const OverlayFunctions& GetFunctions() {
+  static const OverlayFunctions functions = []() {
+    OverlayFunctions result;
+    // libandroid is already loaded by the app, this only takes a reference.
+    void* libandroid = dlopen("libandroid.so", RTLD_NOW | RTLD_NOLOAD);
+    if (libandroid != nullptr) {
+      result.allocate = reinterpret_cast<PFAHardwareBuffer_allocate>(
+          dlsym(libandroid, "AHardwareBuffer_allocate"));
+      result.release = reinterpret_cast<PFAHardwareBuffer_release>(
+          dlsym(libandroid, "AHardwareBuffer_release"));
+      result.describe = reinterpret_cast<PFAHardwareBuffer_describe>(
+          dlsym(libandroid, "AHardwareBuffer_describe"));
+      result.lock = reinterpret_cast<PFAHardwareBuffer_lock>(
+          dlsym(libandroid, "AHardwareBuffer_lock"));
+      result.unlock = reinterpret_cast<PFAHardwareBuffer_unlock>(
+          dlsym(libandroid, "AHardwareBuffer_unlock"));
+    }
+    result.get_native_client_buffer =
+        reinterpret_cast<PFeglGetNativeClientBufferANDROID>(
+            eglGetProcAddress("eglGetNativeClientBufferANDROID"));
+    result.create_image = reinterpret_cast<PFeglCreateImageKHR>(
+        eglGetProcAddress("eglCreateImageKHR"));
+    result.destroy_image = reinterpret_cast<PFeglDestroyImageKHR>(
+        eglGetProcAddress("eglDestroyImageKHR"));
+    result.image_target_texture =
+        reinterpret_cast<PFglEGLImageTargetTexture2DOES>(
+            eglGetProcAddress("glEGLImageTargetTexture2DOES"));
+    result.create_sync = reinterpret_cast<PFeglCreateSyncKHR>(
+        eglGetProcAddress("eglCreateSyncKHR"));
+    result.destroy_sync = reinterpret_cast<PFeglDestroySyncKHR>(
+        eglGetProcAddress("eglDestroySyncKHR"));
+    result.dup_native_fence = reinterpret_cast<PFeglDupNativeFenceFDANDROID>(
+        eglGetProcAddress("eglDupNativeFenceFDANDROID"));
+    return result;
+  }();
+  return functions;
+}
+}  // namespace
+
+OverlayHardwareBuffers::~OverlayHardwareBuffers() {
+  for (Buffer& buffer : buffers_) {
+    DestroyImage(&buffer);
+    if (buffer.read_fence >= 0) {
+      close(buffer.read_fence);
+    }
+    if (buffer.hardware_buffer != nullptr) {
+      GetFunctions().release(buffer.hardware_buffer);
+    }
+  }
+}
+
+bool OverlayHardwareBuffers::IsSupported() {
+  return GetFunctions().IsComplete();
+}
+
+uint8_t* OverlayHardwareBuffers::LockForWrite(int index, int32_t width,
+                                              int32_t height) {
+  if (index < 0 || index >= kNumBuffers || width <= 0 || height <= 0 ||
+      !IsSupported()) {
+    return nullptr;
+  }
+  const OverlayFunctions& functions = GetFunctions();
+  AHardwareBuffer* hardware_buffer = nullptr;
+  int read_fence = -1;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Buffer& buffer = buffers_[index];
+    if (buffer.width != width || buffer.height != height) {
+      // An image the GPU still samples keeps its own reference to the old
+      // buffer, so the fence of its last draw no longer matters.
+      if (buffer.read_fence >= 0) {
+        close(buffer.read_fence);
+        buffer.read_fence = -1;
+      }
+      if (buffer.hardware_buffer != nullptr) {
+        functions.release(buffer.hardware_buffer);
+        buffer.hardware_buffer = nullptr;
+      }
+      buffer.width = width;
+      buffer.height = height;
+      buffer.padded = false;
+      ++buffer.generation;
+
+      AHardwareBuffer_Desc desc = {};
+      desc.width = static_cast<uint32_t>(width);
+      desc.height = static_cast<uint32_t>(height);
+      desc.layers = 1;
+      desc.format = AHARDWAREBUFFER_FORMAT_R8_UNORM;
+      desc.usage = AHARDWAREBUFFER_USAGE_CPU_WRITE_OFTEN |
+                   AHARDWAREBUFFER_USAGE_GPU_SAMPLED_IMAGE;
+      if (functions.allocate(&desc, &buffer.hardware_buffer) != 0) {
+        LOGW("OverlayHardwareBuffers: Cannot allocate a %dx%d R8 buffer",
+             width, height);
+        buffer.hardware_buffer = nullptr;
+      } else {
+        functions.describe(buffer.hardware_buffer, &desc);
+        buffer.padded = desc.stride != desc.width;
+        if (buffer.padded && !logged_padded_rows_) {
+          LOGI("OverlayHardwareBuffers: Rows of %d pixels are padded to %u, "
+               "falling back to texture uploads",
+               width, desc.stride);
+          logged_padded_rows_ = true;
+        }
+      }
+    }
+    if (buffer.hardware_buffer == nullptr || buffer.padded) {
+      return nullptr;
+    }
+    hardware_buffer = buffer.hardware_buffer;
+    read_fence = buffer.read_fence;
+    buffer.read_fence = -1;
+  }
+
+  // Waits outside the mutex, so the OpenGL thread can fence the other buffer
+  // meanwhile.  The lock takes ownership of the fence.
+  void* pixels = nullptr;
+  if (functions.lock(hardware_buffer, AHARDWAREBUFFER_USAGE_CPU_WRITE_OFTEN,
+                     read_fence, /*rect=*/nullptr, &pixels) != 0) {
+    LOGE("OverlayHardwareBuffers: AHardwareBuffer_lock failed");
+    return nullptr;
+  }
+  return static_cast<uint8_t*>(pixels);
+}
+
+void OverlayHardwareBuffers::Unlock(int index) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Buffer& buffer = buffers_[index];
+  if (buffer.hardware_buffer != nullptr) {
+    GetFunctions().unlock(buffer.hardware_buffer, /*fence=*/nullptr);
+  }
+}
+
+GLuint OverlayHardwareBuffers::GetTexture(int index) {
+  if (index < 0 || index >= kNumBuffers || !IsSupported()) {
+    return 0;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  Buffer& buffer = buffers_[index];
+  if (buffer.hardware_buffer == nullptr || buffer.padded) {
+    return 0;
+  }
+  if (buffer.texture == 0) {
+    glGenTextures(1, &buffer.texture);
+    glBindTexture(GL_TEXTURE_2D, buffer.texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  }
+  if (buffer.image != EGL_NO_IMAGE_KHR &&
+      buffer.image_generation == buffer.generation) {
+    return buffer.texture;
+  }
+  DestroyImage(&buffer);
+
+  const OverlayFunctions& functions = GetFunctions();
+  EGLClientBuffer native_buffer =
+      functions.get_native_client_buffer(buffer.hardware_buffer);
+  if (native_buffer == nullptr) {
+    LOGE("OverlayHardwareBuffers: eglGetNativeClientBufferANDROID failed");
+    return 0;
+  }
+  display_ = eglGetCurrentDisplay();
+  const EGLint attributes[] = {EGL_IMAGE_PRESERVED_KHR, EGL_TRUE, EGL_NONE};
+  buffer.image = functions.create_image(display_, EGL_NO_CONTEXT,
+                                        EGL_NATIVE_BUFFER_ANDROID,
+                                        native_buffer, attributes);
+  if (buffer.image == EGL_NO_IMAGE_KHR) {
+    LOGE("OverlayHardwareBuffers: eglCreateImageKHR failed: 0x%x",
+         eglGetError());
+    return 0;
+  }
+  glBindTexture(GL_TEXTURE_2D, buffer.texture);
+  functions.image_target_texture(GL_TEXTURE_2D, buffer.image);
+  util::CheckGlError("OverlayHardwareBuffers::GetTexture() error");
+  buffer.image_generation = buffer.generation;
+  return buffer.texture;
+}
+
+void OverlayHardwareBuffers::FenceRead(int index) {
+  if (index < 0 || index >= kNumBuffers || !IsSupported()) {
+    return;
+  }
+  const OverlayFunctions& functions = GetFunctions();
+  EGLDisplay display = eglGetCurrentDisplay();
+  EGLSyncKHR sync =
+      functions.create_sync(display, EGL_SYNC_NATIVE_FENCE_ANDROID, nullptr);
+  if (sync == EGL_NO_SYNC_KHR) {
+    // Without a fence the next write must not start before the GPU is done.
+    glFinish();
+    return;
+  }
+  // The fence only gets a file descriptor once it is flushed to the GPU.
+  glFlush();
+  const int fence = functions.dup_native_fence(display, sync);
+  functions.destroy_sync(display, sync);
+  if (fence == EGL_NO_NATIVE_FENCE_FD_ANDROID) {
+    glFinish();
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  Buffer& buffer = buffers_[index];
+  // The new fence signals after the draws the previous one covered.
+  if (buffer.read_fence >= 0) {
+    close(buffer.read_fence);
+  }
+  buffer.read_fence = fence;
+}
+
+void OverlayHardwareBuffers::InitializeGlContent() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (Buffer& buffer : buffers_) {
+    DestroyImage(&buffer);
+    buffer.texture = 0;
+  }
+}
+
+void OverlayHardwareBuffers::DestroyImage(Buffer* buffer) {
+  if (buffer->image != EGL_NO_IMAGE_KHR) {
+    GetFunctions().destroy_image(display_, buffer->image);
+    buffer->image = EGL_NO_IMAGE_KHR;
+  }
+}
+
+}  // namespace computer_vision
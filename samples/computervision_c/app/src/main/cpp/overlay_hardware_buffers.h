@@ -0,0 +1,113 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_COMPUTER_VISION_OVERLAY_HARDWARE_BUFFERS_H_
+#define C_ARCORE_COMPUTER_VISION_OVERLAY_HARDWARE_BUFFERS_H_
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#include <android/hardware_buffer.h>
+
+#include <cstdint>
+#include <mutex>  // NOLINT
+
+namespace computer_vision {
+
+// Two R8 AHardwareBuffers the kernels write the processed CPU image into and
+// the renderer samples as the overlay texture, instead of writing to memory
+// that glTexSubImage2D() then copies to the driver.
+//
+// Buffer i backs ProcessedCpuImage buffer i of CpuImageProcessor, which
+// writes into the back one while the renderer draws the front one.  Each
+// buffer is bound once to a GL_TEXTURE_2D through an EGLImage, and again only
+// when the processor reallocates it for a new image size.  After a draw that
+// sampled a buffer the renderer adds a native fence, which the next lock of
+// the buffer for writing waits on, so the CPU never overwrites pixels the GPU
+// has yet to read.
+//
+// The kernels write rows of the image width, so a buffer the allocator pads
+// cannot be written directly and the processor falls back to its own memory.
+// R8 buffers need API level 31 and the functions are resolved at runtime.
+class OverlayHardwareBuffers {
+ public:
+  static constexpr int kNumBuffers = 2;
+
+  OverlayHardwareBuffers() = default;
+  ~OverlayHardwareBuffers();
+
+  OverlayHardwareBuffers(const OverlayHardwareBuffers&) = delete;
+  OverlayHardwareBuffers& operator=(const OverlayHardwareBuffers&) = delete;
+
+  // Returns true if this device provides the functions the buffers need.
+  // Whether R8 buffers can be allocated only shows in LockForWrite().
+  static bool IsSupported();
+
+  // Locks buffer |index| for writing a |width| x |height| image with rows of
+  // |width| bytes and returns its pixels, reallocating the buffer if its size
+  // differs.  Waits for the GPU to finish sampling the buffer.  Returns null
+  // if the buffer cannot be allocated, has padded rows or cannot be locked.
+  // Called on the processing thread.
+  uint8_t* LockForWrite(int index, int32_t width, int32_t height);
+
+  // Unlocks buffer |index| after LockForWrite() returned its pixels.
+  void Unlock(int index);
+
+  // Returns the texture that samples buffer |index|, or 0 if it cannot be
+  // bound.  Must be called on the OpenGL thread.
+  GLuint GetTexture(int index);
+
+  // Fences the draw calls issued so far, which sampled buffer |index|.  Must
+  // be called on the OpenGL thread.
+  void FenceRead(int index);
+
+  // Forgets the textures of the previous OpenGL context.  Must be called on
+  // the OpenGL thread when a context is created.
+  void InitializeGlContent();
+
+ private:
+  struct Buffer {
+    // Guarded by mutex_.
+    AHardwareBuffer* hardware_buffer = nullptr;
+    int32_t width = 0;
+    int32_t height = 0;
+    // Whether the rows of |hardware_buffer| are wider than |width|.
+    bool padded = false;
+    // Incremented with every allocation, so the OpenGL thread can tell when
+    // to recreate its image.
+    uint32_t generation = 0;
+    // Native fence of the last draw that sampled the buffer, or -1.
+    int read_fence = -1;
+
+    // Only used on the OpenGL thread.
+    GLuint texture = 0;
+    EGLImageKHR image = EGL_NO_IMAGE_KHR;
+    uint32_t image_generation = 0;
+  };
+
+  // Destroys the image of |buffer|.
+  void DestroyImage(Buffer* buffer);
+
+  std::mutex mutex_;
+  Buffer buffers_[kNumBuffers];
+  EGLDisplay display_ = EGL_NO_DISPLAY;
+  bool logged_padded_rows_ = false;
+};
+
+}  // namespace computer_vision
+
+#endif  // C_ARCORE_COMPUTER_VISION_OVERLAY_HARDWARE_BUFFERS_H_
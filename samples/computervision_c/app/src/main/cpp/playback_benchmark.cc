@@ -0,0 +1,126 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "playback_benchmark.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <numeric>
+
+#include "util.h"
+
+namespace computer_vision {
+namespace {
+float ToMilliseconds(std::chrono::nanoseconds duration) {
+  return std::chrono::duration<float, std::milli>(duration).count();
+}
+
+// Returns the |percent| percentile of |values|, reordering them.
+float Percentile(std::vector<float>* values, int percent) {
+  const size_t index = (values->size() - 1) * percent / 100;
+  std::nth_element(values->begin(), values->begin() + index, values->end());
+  return (*values)[index];
+}
+
+// Current resident set size of the process, or -1 if it cannot be read.
+int64_t ReadResidentSetKb() {
+  FILE* file = fopen("/proc/self/statm", "r");
+  if (file == nullptr) {
+    return -1;
+  }
+  long long size_pages = 0;
+  long long resident_pages = 0;
+  const bool read =
+      fscanf(file, "%lld %lld", &size_pages, &resident_pages) == 2;
+  fclose(file);
+  return read ? resident_pages * (sysconf(_SC_PAGESIZE) / 1024) : -1;
+}
+
+// Largest resident set size the process ever had, or -1 if it cannot be read.
+int64_t ReadPeakResidentSetKb() {
+  FILE* file = fopen("/proc/self/status", "r");
+  if (file == nullptr) {
+    return -1;
+  }
+  int64_t peak_kb = -1;
+  char line[128];
+  while (fgets(line, sizeof(line), file) != nullptr) {
+    long long value_kb = 0;
+    if (sscanf(line, "VmHWM: %lld kB", &value_kb) == 1) {
+      peak_kb = value_kb;
+      break;
+    }
+  }
+  fclose(file);
+  return peak_kb;
+}
+}  // namespace
+
+PlaybackBenchmark::~PlaybackBenchmark() { Finish(); }
+
+bool PlaybackBenchmark::Open(const std::string& csv_path) {
+  Finish();
+  file_ = fopen(csv_path.c_str(), "w");
+  if (file_ == nullptr) {
+    LOGE("PlaybackBenchmark: cannot open %s", csv_path.c_str());
+    return false;
+  }
+  frame_count_ = 0;
+  frame_times_ms_.clear();
+  fprintf(file_, "frame,timestamp_ns,total_ms,rss_kb\n");
+  return true;
+}
+
+void PlaybackBenchmark::RecordFrame(int64_t timestamp_ns,
+                                    std::chrono::nanoseconds total) {
+  if (file_ == nullptr) {
+    return;
+  }
+  const float total_ms = ToMilliseconds(total);
+  fprintf(file_, "%lld,%lld,%.3f,%lld\n", static_cast<long long>(frame_count_),
+          static_cast<long long>(timestamp_ns), total_ms,
+          static_cast<long long>(ReadResidentSetKb()));
+  frame_times_ms_.push_back(total_ms);
+  ++frame_count_;
+}
+
+void PlaybackBenchmark::Finish() {
+  if (file_ == nullptr) {
+    return;
+  }
+  const float total_ms =
+      std::accumulate(frame_times_ms_.begin(), frame_times_ms_.end(), 0.f);
+  const int64_t peak_kb = ReadPeakResidentSetKb();
+  fprintf(file_, "total,,%.3f,%lld\n", total_ms,
+          static_cast<long long>(peak_kb));
+  fclose(file_);
+  file_ = nullptr;
+
+  if (!frame_times_ms_.empty()) {
+    const float average_ms = total_ms / frame_times_ms_.size();
+    const float p50_ms = Percentile(&frame_times_ms_, 50);
+    const float p90_ms = Percentile(&frame_times_ms_, 90);
+    const float p99_ms = Percentile(&frame_times_ms_, 99);
+    LOGI(
+        "PlaybackBenchmark: %lld frames, avg %.3f ms, p50 %.3f ms, p90 %.3f "
+        "ms, p99 %.3f ms, peak RSS %lld KiB",
+        static_cast<long long>(frame_count_), average_ms, p50_ms, p90_ms,
+        p99_ms, static_cast<long long>(peak_kb));
+  }
+}
+
+}  // namespace computer_vision
@@ -0,0 +1,53 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "scratch_arena.h"
+
+namespace computer_vision {
+namespace {
+uint8_t* AlignUp(uint8_t* pointer, size_t alignment) {
+  const uintptr_t address = reinterpret_cast<uintptr_t>(pointer);
+  return reinterpret_cast<uint8_t*>((address + alignment - 1) &
+                                    ~(alignment - 1));
+}
+}  // namespace
+
+constexpr size_t ScratchArena::kAlignment;
+
+uint8_t* ScratchArena::Allocate(size_t size) {
+  const size_t aligned_size = (size + kAlignment - 1) & ~(kAlignment - 1);
+  requested_ += aligned_size;
+  if (used_ + aligned_size <= capacity_) {
+    uint8_t* allocation = aligned_buffer_ + used_;
+    used_ += aligned_size;
+    return allocation;
+  }
+  overflow_blocks_.emplace_back(new uint8_t[aligned_size + kAlignment]);
+  return AlignUp(overflow_blocks_.back().get(), kAlignment);
+}
+
+void ScratchArena::Reset() {
+  if (requested_ > capacity_) {
+    buffer_.reset(new uint8_t[requested_ + kAlignment]);
+    aligned_buffer_ = AlignUp(buffer_.get(), kAlignment);
+    capacity_ = requested_;
+  }
+  overflow_blocks_.clear();
+  used_ = 0;
+  requested_ = 0;
+}
+
+}  // namespace computer_vision
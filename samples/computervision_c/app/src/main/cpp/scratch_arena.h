@@ -0,0 +1,60 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_COMPUTER_VISION_SCRATCH_ARENA_H_
+#define C_ARCORE_COMPUTER_VISION_SCRATCH_ARENA_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace computer_vision {
+
+// Bump allocator for the scratch buffers of one frame.  Allocations are only
+// freed all at once by Reset().
+//
+// A frame that needs more than the buffer holds gets separate blocks for the
+// excess, and the next Reset() grows the buffer to what that frame used.  Once
+// the image size settles, frames allocate nothing from the heap.
+class ScratchArena {
+ public:
+  ScratchArena() = default;
+
+  ScratchArena(const ScratchArena&) = delete;
+  ScratchArena& operator=(const ScratchArena&) = delete;
+
+  // Returns |size| bytes aligned to a cache line, valid until Reset().
+  uint8_t* Allocate(size_t size);
+
+  // Frees all allocations.  Must not be called while they are in use.
+  void Reset();
+
+ private:
+  static constexpr size_t kAlignment = 64;
+
+  std::unique_ptr<uint8_t[]> buffer_;
+  uint8_t* aligned_buffer_ = nullptr;
+  size_t capacity_ = 0;
+  size_t used_ = 0;
+  // Bytes asked for since the last Reset(), including the overflow blocks.
+  size_t requested_ = 0;
+  std::vector<std::unique_ptr<uint8_t[]>> overflow_blocks_;
+};
+
+}  // namespace computer_vision
+
+#endif  // C_ARCORE_COMPUTER_VISION_SCRATCH_ARENA_H_
@@ -0,0 +1,316 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tensor_stager.h"
+
+#include <dlfcn.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "util.h"
+
+namespace computer_vision {
+
+constexpr int TensorStager::kNumBuffers;
+
+namespace {
+// Tensors are aligned for the vector loads of the model's first layer.
+constexpr size_t kAlignment = 64;
+// Bands of rows converted per thread of the worker pool, and the fewest rows
+// worth a band of their own.
+constexpr int kBandsPerThread = 4;
+constexpr int32_t kMinRowsPerBand = 32;
+
+// Load hardware buffer symbols at runtime, the sample supports devices older
+// than API level 26.
+using PFAHardwareBuffer_allocate = int (*)(const AHardwareBuffer_Desc* desc,
+                                           AHardwareBuffer** out_buffer);
+using PFAHardwareBuffer_release = void (*)(AHardwareBuffer* buffer);
+using PFAHardwareBuffer_lock = int (*)(AHardwareBuffer* buffer, uint64_t usage,
+                                       int32_t fence, const ARect* rect,
+                                       void** out_virtual_address);
+using PFAHardwareBuffer_unlock = int (*)(AHardwareBuffer* buffer,
+                                         int32_t* fence);
+
+struct HardwareBufferFunctions {
+  PFAHardwareBuffer_allocate allocate = nullptr;
+  PFAHardwareBuffer_release release = nullptr;
+  PFAHardwareBuffer_lock lock = nullptr;
+  PFAHardwareBuffer_unlock unlock = nullptr;
+
+  bool IsComplete() const {
+    return allocate != nullptr && release != nullptr && lock != nullptr &&
+           unlock != nullptr;
+  }
+};
+
+const HardwareBufferFunctions& GetFunctions() {
+  static const HardwareBufferFunctions functions = []() {
+    HardwareBufferFunctions result;
+    // libandroid is already loaded by the app, this only takes a reference.
+    void* libandroid = dlopen("libandroid.so", RTLD_NOW | RTLD_NOLOAD);
+    if (libandroid != nullptr) {
+      result.allocate = reinterpret_cast<PFAHardwareBuffer_allocate>(
+          dlsym(libandroid, "AHardwareBuffer_allocate"));
+      result.release = reinterpret_cast<PFAHardwareBuffer_release>(
+          dlsym(libandroid, "AHardwareBuffer_release"));
+      result.lock = reinterpret_cast<PFAHardwareBuffer_lock>(
+          dlsym(libandroid, "AHardwareBuffer_lock"));
+      result.unlock = reinterpret_cast<PFAHardwareBuffer_unlock>(
+          dlsym(libandroid, "AHardwareBuffer_unlock"));
+    }
+    return result;
+  }();
+  return functions;
+}
+
+// A blob the CPU writes every frame and delegates read as a GPU buffer or
+// NNAPI memory.
+AHardwareBuffer* AllocateHardwareBuffer(size_t size) {
+  const HardwareBufferFunctions& functions = GetFunctions();
+  if (!functions.IsComplete()) {
+    return nullptr;
+  }
+  AHardwareBuffer_Desc desc = {};
+  desc.width = static_cast<uint32_t>(size);
+  desc.height = 1;
+  desc.layers = 1;
+  desc.format = AHARDWAREBUFFER_FORMAT_BLOB;
+  desc.usage = AHARDWAREBUFFER_USAGE_CPU_WRITE_OFTEN |
+               AHARDWAREBUFFER_USAGE_CPU_READ_RARELY |
+               AHARDWAREBUFFER_USAGE_GPU_DATA_BUFFER;
+  AHardwareBuffer* buffer = nullptr;
+  if (functions.allocate(&desc, &buffer) != 0) {
+    return nullptr;
+  }
+  return buffer;
+}
+
+uint8_t* AlignUp(uint8_t* pointer) {
+  const uintptr_t address = reinterpret_cast<uintptr_t>(pointer);
+  return reinterpret_cast<uint8_t*>((address + kAlignment - 1) &
+                                    ~(kAlignment - 1));
+}
+}  // namespace
+
+void StagedTensor::ToImageCoordinates(float x, float y, float* image_x,
+                                      float* image_y) const {
+  const ImageRegion& crop = tag.crop;
+  const float crop_width = static_cast<float>(crop.right - crop.left);
+  const float crop_height = static_cast<float>(crop.bottom - crop.top);
+  // The rotated crop spans the tensor.
+  const bool transposed = tag.quarter_turns % 2 == 1;
+  const float a = x * (transposed ? crop_height : crop_width) / width;
+  const float b = y * (transposed ? crop_width : crop_height) / height;
+  float crop_x = a;
+  float crop_y = b;
+  switch (tag.quarter_turns) {
+    case 1:
+      crop_x = b;
+      crop_y = crop_height - a;
+      break;
+    case 2:
+      crop_x = crop_width - a;
+      crop_y = crop_height - b;
+      break;
+    case 3:
+      crop_x = crop_width - b;
+      crop_y = a;
+      break;
+    default:
+      break;
+  }
+  *image_x = crop.left + crop_x;
+  *image_y = crop.top + crop_y;
+}
+
+TensorStager::~TensorStager() { FreeBuffers(); }
+
+bool TensorStager::Configure(const RgbConversion& conversion,
+                             bool use_hardware_buffers) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  FreeBuffers();
+  const size_t size =
+      static_cast<size_t>(conversion.output_width) *
+      conversion.output_height * 3 *
+      (conversion.format == RgbFormat::kRgb8 ? sizeof(uint8_t)
+                                             : sizeof(float));
+  if (size == 0) {
+    return false;
+  }
+  bool hardware_buffers = use_hardware_buffers;
+  if (hardware_buffers) {
+    for (Buffer& buffer : buffers_) {
+      buffer.hardware_buffer = AllocateHardwareBuffer(size);
+      if (buffer.hardware_buffer == nullptr) {
+        LOGW("TensorStager: no hardware buffers, staging in memory.");
+        hardware_buffers = false;
+        FreeBuffers();
+        break;
+      }
+    }
+  }
+  for (Buffer& buffer : buffers_) {
+    if (!hardware_buffers) {
+      buffer.storage.reset(new uint8_t[size + kAlignment]);
+      buffer.data = AlignUp(buffer.storage.get());
+    }
+    buffer.tensor = StagedTensor();
+    buffer.tensor.width = conversion.output_width;
+    buffer.tensor.height = conversion.output_height;
+    buffer.tensor.format = conversion.format;
+    buffer.tensor.size = size;
+    buffer.tensor.data = buffer.data;
+    buffer.tensor.hardware_buffer = buffer.hardware_buffer;
+    buffer.state = BufferState::kFree;
+  }
+  conversion_ = conversion;
+  size_ = size;
+  return true;
+}
+
+void TensorStager::FreeBuffers() {
+  for (Buffer& buffer : buffers_) {
+    if (buffer.hardware_buffer != nullptr) {
+      GetFunctions().release(buffer.hardware_buffer);
+      buffer.hardware_buffer = nullptr;
+    }
+    buffer.storage.reset();
+    buffer.data = nullptr;
+    buffer.state = BufferState::kFree;
+  }
+  size_ = 0;
+}
+
+uint8_t* TensorStager::BeginWrite(Buffer* buffer) {
+  if (buffer->hardware_buffer == nullptr) {
+    return buffer->data;
+  }
+  // No fence: a buffer is only written once its consumer released it.
+  void* address = nullptr;
+  if (GetFunctions().lock(buffer->hardware_buffer,
+                          AHARDWAREBUFFER_USAGE_CPU_WRITE_OFTEN,
+                          /*fence=*/-1, /*rect=*/nullptr, &address) != 0) {
+    LOGW("TensorStager: AHardwareBuffer_lock failed.");
+    return nullptr;
+  }
+  return static_cast<uint8_t*>(address);
+}
+
+void TensorStager::EndWrite(Buffer* buffer) {
+  if (buffer->hardware_buffer != nullptr) {
+    GetFunctions().unlock(buffer->hardware_buffer, /*fence=*/nullptr);
+  }
+}
+
+bool TensorStager::Stage(const TensorSource& source,
+                         WorkerPool* worker_pool) {
+  const auto start = std::chrono::steady_clock::now();
+  RgbConversion conversion = conversion_;
+  conversion.crop = source.tag.crop;
+  conversion.quarter_turns = source.tag.quarter_turns;
+  if (!IsConfigured() || !converter_.Prepare(source.image.width,
+                                             source.image.height,
+                                             conversion)) {
+    return false;
+  }
+
+  Buffer* buffer = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (Buffer& candidate : buffers_) {
+      if (candidate.state == BufferState::kFree) {
+        buffer = &candidate;
+        break;
+      }
+    }
+    if (buffer == nullptr) {
+      ++dropped_count_;
+      return false;
+    }
+    buffer->state = BufferState::kStaging;
+  }
+
+  uint8_t* data = BeginWrite(buffer);
+  if (data != nullptr) {
+    const int32_t height = conversion.output_height;
+    const int num_bands =
+        std::max(1, std::min(worker_pool->GetThreadCount() * kBandsPerThread,
+                             height / kMinRowsPerBand));
+    const int32_t rows_per_band = (height + num_bands - 1) / num_bands;
+    worker_pool->Run(num_bands, [&](int band) {
+      const int32_t row_begin = band * rows_per_band;
+      converter_.ConvertRows(source.image, row_begin,
+                             std::min(height, row_begin + rows_per_band),
+                             data);
+    });
+    EndWrite(buffer);
+    buffer->tensor.tag = source.tag;
+    buffer->tensor.tag.quarter_turns =
+        converter_.GetConversion().quarter_turns;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (data == nullptr) {
+    buffer->state = BufferState::kFree;
+    return false;
+  }
+  for (Buffer& other : buffers_) {
+    if (other.state == BufferState::kReady) {
+      other.state = BufferState::kFree;
+    }
+  }
+  buffer->state = BufferState::kReady;
+  last_stage_ms_ = std::chrono::duration<float, std::milli>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  return true;
+}
+
+const StagedTensor* TensorStager::AcquireLatest() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (Buffer& buffer : buffers_) {
+    if (buffer.state == BufferState::kReady) {
+      buffer.state = BufferState::kAcquired;
+      return &buffer.tensor;
+    }
+  }
+  return nullptr;
+}
+
+void TensorStager::Release(const StagedTensor* tensor) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (Buffer& buffer : buffers_) {
+    if (&buffer.tensor == tensor) {
+      CHECK(buffer.state == BufferState::kAcquired);
+      buffer.state = BufferState::kFree;
+      return;
+    }
+  }
+}
+
+int TensorStager::GetDroppedCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return dropped_count_;
+}
+
+float TensorStager::GetLastStageMs() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return last_stage_ms_;
+}
+
+}  // namespace computer_vision
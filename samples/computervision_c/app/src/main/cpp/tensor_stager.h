@@ -0,0 +1,150 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_COMPUTER_VISION_TENSOR_STAGER_H_
+#define C_ARCORE_COMPUTER_VISION_TENSOR_STAGER_H_
+
+#include <android/hardware_buffer.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>  // NOLINT
+
+#include "edge_detector.h"
+#include "worker_pool.h"
+#include "yuv_to_rgb_converter.h"
+
+namespace computer_vision {
+
+// Where and when the camera image of a tensor was taken and which part of it
+// the tensor shows, so model results can be mapped back onto the image and,
+// with the pose, into the world after the camera moved on.
+struct TensorTag {
+  int64_t timestamp_ns = 0;
+  // Raw camera pose, see ArPose_getPoseRaw, if the camera was tracking.
+  bool has_camera_pose = false;
+  float camera_pose[7] = {};
+  // The pixels of the camera image and the clockwise quarter turns they were
+  // rotated by, see RgbConversion.
+  ImageRegion crop;
+  int32_t quarter_turns = 0;
+};
+
+// A camera image to stage, see TensorStager::Stage().
+struct TensorSource {
+  YuvImage image;
+  TensorTag tag;
+};
+
+// A model input staged by TensorStager.
+struct StagedTensor {
+  TensorTag tag;
+  int32_t width = 0;
+  int32_t height = 0;
+  RgbFormat format = RgbFormat::kRgb8;
+  size_t size = 0;
+  // The channels of the pixels, aligned to a cache line.  Null if the tensor
+  // is in |hardware_buffer|, which delegates can import without a copy and
+  // which has to be locked to be read on the CPU.
+  const void* data = nullptr;
+  AHardwareBuffer* hardware_buffer = nullptr;
+
+  // Maps a point of the tensor, in its pixels, onto the camera image.
+  void ToImageCoordinates(float x, float y, float* image_x,
+                          float* image_y) const;
+};
+
+// Preallocated model inputs filled from camera images, handed between the
+// thread that stages them and the one that runs the model without copying.
+//
+// Stage() converts an image into a free buffer, in row bands on a
+// WorkerPool, and publishes it as the latest tensor, which frees the previous
+// one if it was not acquired.  The model thread acquires the latest tensor,
+// reads it in place and releases it.  With kNumBuffers buffers a consumer
+// holding one tensor never makes Stage() wait or drop; a consumer holding
+// more makes Stage() drop images while no buffer is free.
+//
+// Buffers are AHardwareBuffer blobs for NNAPI and GPU delegates if asked
+// for and available, and aligned heap memory otherwise.  Nothing is allocated
+// after Configure().
+class TensorStager {
+ public:
+  static constexpr int kNumBuffers = 3;
+
+  TensorStager() = default;
+  ~TensorStager();
+
+  TensorStager(const TensorStager&) = delete;
+  TensorStager& operator=(const TensorStager&) = delete;
+
+  // Allocates buffers for tensors of the output size, format and
+  // normalization of |conversion|, whose crop and rotation come with every
+  // Stage().  Must not be called while a tensor is acquired or staged.
+  // Returns false if the buffers cannot be allocated.
+  bool Configure(const RgbConversion& conversion, bool use_hardware_buffers);
+
+  bool IsConfigured() const { return size_ != 0; }
+
+  // Converts |source| into a free buffer on |worker_pool| and publishes it.
+  // Returns false if no buffer is free or the crop does not fit the image.
+  // Must only be called from one thread at a time.
+  bool Stage(const TensorSource& source, WorkerPool* worker_pool);
+
+  // Returns the latest tensor staged since the last call, or null, and keeps
+  // it from being overwritten until Release().  May be called from any
+  // thread.
+  const StagedTensor* AcquireLatest();
+  void Release(const StagedTensor* tensor);
+
+  // Images dropped because no buffer was free, and the time of the last
+  // Stage().
+  int GetDroppedCount() const;
+  float GetLastStageMs() const;
+
+ private:
+  enum class BufferState { kFree, kStaging, kReady, kAcquired };
+
+  struct Buffer {
+    StagedTensor tensor;
+    BufferState state = BufferState::kFree;
+    std::unique_ptr<uint8_t[]> storage;
+    uint8_t* data = nullptr;
+    AHardwareBuffer* hardware_buffer = nullptr;
+  };
+
+  // Releases the buffers.  Called with nothing acquired or staged.
+  void FreeBuffers();
+
+  // Locks a hardware buffer for writing, or returns the heap memory.
+  uint8_t* BeginWrite(Buffer* buffer);
+  void EndWrite(Buffer* buffer);
+
+  RgbConversion conversion_;
+  size_t size_ = 0;
+  // Only used by Stage().
+  YuvToRgbConverter converter_;
+
+  // Guards the buffer states and the statistics.
+  mutable std::mutex mutex_;
+  Buffer buffers_[kNumBuffers];
+  int dropped_count_ = 0;
+  float last_stage_ms_ = 0.f;
+};
+
+}  // namespace computer_vision
+
+#endif  // C_ARCORE_COMPUTER_VISION_TENSOR_STAGER_H_
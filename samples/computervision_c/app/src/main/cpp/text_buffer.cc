@@ -0,0 +1,49 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "text_buffer.h"
+
+#include <cstdarg>
+#include <cstdio>
+
+namespace computer_vision {
+
+TextBuffer::TextBuffer(char* buffer, size_t capacity)
+    : buffer_(buffer), capacity_(capacity) {
+  buffer_[0] = '\0';
+}
+
+void TextBuffer::Append(const char* format, ...) {
+  if (truncated_) {
+    return;
+  }
+  va_list arguments;
+  va_start(arguments, format);
+  const int length = vsnprintf(buffer_ + size_, capacity_ - size_, format,
+                               arguments);
+  va_end(arguments);
+  if (length < 0) {
+    return;
+  }
+  if (static_cast<size_t>(length) >= capacity_ - size_) {
+    size_ = capacity_ - 1;
+    truncated_ = true;
+  } else {
+    size_ += length;
+  }
+}
+
+}  // namespace computer_vision
@@ -0,0 +1,49 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_COMPUTER_VISION_TEXT_BUFFER_H_
+#define C_ARCORE_COMPUTER_VISION_TEXT_BUFFER_H_
+
+#include <cstddef>
+
+namespace computer_vision {
+
+// Formats text into a caller-owned buffer, e.g. from a ScratchArena, so the
+// status text built every frame never allocates.  Text beyond the capacity
+// is dropped, and the buffer always holds a terminated string.
+class TextBuffer {
+ public:
+  // |capacity| includes the terminating zero and must not be 0.
+  TextBuffer(char* buffer, size_t capacity);
+
+  // Appends the printf() style |format|.
+  void Append(const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+  const char* c_str() const { return buffer_; }
+  size_t size() const { return size_; }
+  // Whether text was dropped.
+  bool IsTruncated() const { return truncated_; }
+
+ private:
+  char* buffer_;
+  size_t capacity_;
+  size_t size_ = 0;
+  bool truncated_ = false;
+};
+
+}  // namespace computer_vision
+
+#endif  // C_ARCORE_COMPUTER_VISION_TEXT_BUFFER_H_
@@ -15,7 +15,10 @@
  */
 #include "util.h"
 
+#include <GLES3/gl31.h>
 #include <unistd.h>
+#include <algorithm>
+#include <iterator>
 #include <sstream>
 #include <string>
 
@@ -72,6 +75,38 @@ static GLuint LoadShader(GLenum shader_type, const char* shader_source) {
   return shader;
 }
 
+// Links |shader| and, if not 0, |other_shader| into a program.  Returns 0 on
+// failure.
+static GLuint LinkProgram(GLuint shader, GLuint other_shader) {
+  GLuint program = glCreateProgram();
+  if (program) {
+    glAttachShader(program, shader);
+    CheckGlError("computer_vision::util::glAttachShader");
+    if (other_shader) {
+      glAttachShader(program, other_shader);
+      CheckGlError("computer_vision::util::glAttachShader");
+    }
+    glLinkProgram(program);
+    GLint link_status = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &link_status);
+    if (link_status != GL_TRUE) {
+      GLint buf_length = 0;
+      glGetProgramiv(program, GL_INFO_LOG_LENGTH, &buf_length);
+      if (buf_length) {
+        char* buf = reinterpret_cast<char*>(malloc(buf_length));
+        if (buf) {
+          glGetProgramInfoLog(program, buf_length, nullptr, buf);
+          LOGE("computer_vision::util::Could not link program:\n%s\n", buf);
+          free(buf);
+        }
+      }
+      glDeleteProgram(program);
+      program = 0;
+    }
+  }
+  return program;
+}
+
 GLuint CreateProgram(AAssetManager* mgr, const char* vertex_shader_file_name,
                      const char* fragment_shader_file_name) {
   std::string VertexShaderContent;
@@ -100,31 +135,24 @@ GLuint CreateProgram(AAssetManager* mgr, const char* vertex_shader_file_name,
     return 0;
   }
 
-  GLuint program = glCreateProgram();
-  if (program) {
-    glAttachShader(program, vertexShader);
-    CheckGlError("computer_vision::util::glAttachShader");
-    glAttachShader(program, fragment_shader);
-    CheckGlError("computer_vision::util::glAttachShader");
-    glLinkProgram(program);
-    GLint link_status = GL_FALSE;
-    glGetProgramiv(program, GL_LINK_STATUS, &link_status);
-    if (link_status != GL_TRUE) {
-      GLint buf_length = 0;
-      glGetProgramiv(program, GL_INFO_LOG_LENGTH, &buf_length);
-      if (buf_length) {
-        char* buf = reinterpret_cast<char*>(malloc(buf_length));
-        if (buf) {
-          glGetProgramInfoLog(program, buf_length, nullptr, buf);
-          LOGE("computer_vision::util::Could not link program:\n%s\n", buf);
-          free(buf);
-        }
-      }
-      glDeleteProgram(program);
-      program = 0;
-    }
+  return LinkProgram(vertexShader, fragment_shader);
+}
+
+GLuint CreateComputeProgram(AAssetManager* mgr,
+                            const char* compute_shader_file_name) {
+  std::string ComputeShaderContent;
+  if (!LoadTextFileFromAssetManager(mgr, compute_shader_file_name,
+                                    &ComputeShaderContent)) {
+    LOGE("Failed to load file: %s", compute_shader_file_name);
+    return 0;
   }
-  return program;
+
+  GLuint compute_shader =
+      LoadShader(GL_COMPUTE_SHADER, ComputeShaderContent.c_str());
+  if (!compute_shader) {
+    return 0;
+  }
+  return LinkProgram(compute_shader, 0);
 }
 
 bool LoadTextFileFromAssetManager(AAssetManager* mgr, const char* file_name,
@@ -151,5 +179,73 @@ bool LoadTextFileFromAssetManager(AAssetManager* mgr, const char* file_name,
   AAsset_close(asset);
   return true;
 }
+
+namespace {
+// Positions of the quad vertices in clip space (X, Y).
+constexpr GLfloat kScreenQuadPositions[] = {
+    -1.0f, -1.0f, +1.0f, -1.0f, -1.0f, +1.0f, +1.0f, +1.0f,
+};
+constexpr GLsizeiptr kScreenQuadUvSetSize =
+    ScreenQuad::kNumUvComponents * sizeof(GLfloat);
+}  // namespace
+
+void ScreenQuad::InitializeGlContent(int uv_set_count) {
+  CHECK(uv_set_count >= 0 && uv_set_count <= kMaxUvSets);
+  static_assert(sizeof(kScreenQuadPositions) == kScreenQuadUvSetSize,
+                "Positions and texture coordinates must have the same size");
+  uv_set_count_ = uv_set_count;
+  for (auto& uvs : uvs_) {
+    std::fill(std::begin(uvs), std::end(uvs), 0.0f);
+  }
+
+  // The positions never change; the texture coordinates start out zeroed and
+  // are filled in by SetUvs().
+  glGenBuffers(1, &vertex_buffer_);
+  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+  glBufferData(GL_ARRAY_BUFFER, (1 + uv_set_count) * kScreenQuadUvSetSize,
+               nullptr, GL_STATIC_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(kScreenQuadPositions),
+                  kScreenQuadPositions);
+  for (int i = 0; i < uv_set_count; ++i) {
+    glBufferSubData(GL_ARRAY_BUFFER, (1 + i) * kScreenQuadUvSetSize,
+                    kScreenQuadUvSetSize, uvs_[i]);
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void ScreenQuad::TransformCorners(const ArSession* session,
+                                  const ArFrame* frame,
+                                  ArCoordinates2dType uv_type,
+                                  float* out_uvs) {
+  ArFrame_transformCoordinates2d(
+      session, frame, AR_COORDINATES_2D_OPENGL_NORMALIZED_DEVICE_COORDINATES,
+      kNumVertices, kScreenQuadPositions, uv_type, out_uvs);
+}
+
+void ScreenQuad::SetUvs(int uv_set, const float* uvs) {
+  if (uv_set < 0 || uv_set >= uv_set_count_ ||
+      std::equal(uvs, uvs + kNumUvComponents, uvs_[uv_set])) {
+    return;
+  }
+  std::copy(uvs, uvs + kNumUvComponents, uvs_[uv_set]);
+  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+  glBufferSubData(GL_ARRAY_BUFFER, (1 + uv_set) * kScreenQuadUvSetSize,
+                  kScreenQuadUvSetSize, uvs);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void ScreenQuad::Draw(GLuint position_attrib, const GLuint* uv_attribs) const {
+  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+  glVertexAttribPointer(position_attrib, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+  for (int i = 0; i < uv_set_count_; ++i) {
+    glVertexAttribPointer(
+        uv_attribs[i], 2, GL_FLOAT, GL_FALSE, 0,
+        reinterpret_cast<const void*>((1 + i) * kScreenQuadUvSetSize));
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  glDrawArrays(GL_TRIANGLE_STRIP, 0, kNumVertices);
+}
+
 }  // namespace util
 }  // namespace computer_vision
@@ -103,6 +103,13 @@ void ThrowJavaException(JNIEnv* env, const char* msg);
 GLuint CreateProgram(AAssetManager* mgr, const char* vertex_shader_file_name,
                      const char* fragment_shader_file_name);
 
+// Create a compute shader program ID.  Needs an OpenGL ES 3.1 context.
+//
+// @param compute_shader_file_name, the compute shader asset.
+// @return the program, or 0 if it could not be built.
+GLuint CreateComputeProgram(AAssetManager* mgr,
+                            const char* compute_shader_file_name);
+
 // Load a text file from assets folder.
 //
 // @param mgr, AAssetManager pointer.
@@ -112,6 +119,50 @@ GLuint CreateProgram(AAssetManager* mgr, const char* vertex_shader_file_name,
 bool LoadTextFileFromAssetManager(AAssetManager* mgr, const char* file_name,
                                   std::string* out_file_text_string);
 
+// Fullscreen quad drawn as a triangle strip from a static vertex buffer.  The
+// buffer holds the clip space corner positions followed by up to kMaxUvSets
+// sets of corner texture coordinates, which are only re-uploaded when they
+// change, e.g. after a display geometry change.
+class ScreenQuad {
+ public:
+  static constexpr int kNumVertices = 4;
+  // Number of floats in one set of corner texture coordinates.
+  static constexpr int kNumUvComponents = kNumVertices * 2;
+  static constexpr int kMaxUvSets = 2;
+
+  ScreenQuad() = default;
+
+  ScreenQuad(const ScreenQuad&) = delete;
+  ScreenQuad& operator=(const ScreenQuad&) = delete;
+
+  // Creates the vertex buffer with |uv_set_count| texture coordinate sets.
+  // Must be called on the OpenGL thread before any other method.
+  void InitializeGlContent(int uv_set_count);
+
+  // Maps the quad corners to |uv_type| coordinates of |frame|, writing
+  // kNumUvComponents floats to |out_uvs|.
+  static void TransformCorners(const ArSession* session, const ArFrame* frame,
+                               ArCoordinates2dType uv_type, float* out_uvs);
+
+  // Uploads |uvs| as texture coordinate set |uv_set| unless the buffer already
+  // holds them.
+  void SetUvs(int uv_set, const float* uvs);
+
+  // Returns the kNumUvComponents floats of texture coordinate set |uv_set|, in
+  // the order of the corners (-1, -1), (1, -1), (-1, 1) and (1, 1).
+  const float* GetUvs(int uv_set) const { return uvs_[uv_set]; }
+
+  // Points |position_attrib| at the corner positions and |uv_attribs[i]| at
+  // texture coordinate set i, then draws the quad.  The attrib arrays must be
+  // enabled by the caller.
+  void Draw(GLuint position_attrib, const GLuint* uv_attribs) const;
+
+ private:
+  GLuint vertex_buffer_ = 0;
+  int uv_set_count_ = 0;
+  float uvs_[kMaxUvSets][kNumUvComponents] = {};
+};
+
 }  // namespace util
 }  // namespace computer_vision
 
@@ -0,0 +1,214 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "vision_kernel.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "fast_detector.h"
+
+namespace computer_vision {
+namespace {
+// Sobel magnitudes go up to about 4 * 255 * sqrt(2), scaled into 8 bits.
+constexpr int kGradientScaleShift = 2;
+constexpr uint8_t kEdgeValue = 0xFF;
+constexpr uint8_t kNonEdgeValue = 0x1F;
+
+class BoxBlurKernel : public VisionKernel {
+ public:
+  const VisionKernelSpec& GetSpec() const override {
+    static const VisionKernelSpec spec = {"box_blur", PixelFormat::kLuminance,
+                                          PixelFormat::kLuminance, 1};
+    return spec;
+  }
+
+  // Writes every pixel of |region|, repeating the border pixels outwards.
+  void Process(const uint8_t* input, int32_t input_stride, int32_t width,
+               int32_t height, const ImageRegion& region,
+               const KernelParams& params, uint8_t* output) const override {
+    for (int j = region.top; j < region.bottom; j++) {
+      const uint8_t* rows[3] = {
+          input + std::max(j - 1, 0) * input_stride, input + j * input_stride,
+          input + std::min(j + 1, height - 1) * input_stride};
+      for (int i = region.left; i < region.right; i++) {
+        const int left = std::max(i - 1, 0);
+        const int right = std::min(i + 1, width - 1);
+        int sum = 0;
+        for (const uint8_t* row : rows) {
+          sum += row[left] + row[i] + row[right];
+        }
+        output[j * width + i] = static_cast<uint8_t>((sum + 4) / 9);
+      }
+    }
+  }
+};
+
+class SobelMagnitudeKernel : public VisionKernel {
+ public:
+  const VisionKernelSpec& GetSpec() const override {
+    static const VisionKernelSpec spec = {"sobel_magnitude",
+                                          PixelFormat::kLuminance,
+                                          PixelFormat::kGradient, 1};
+    return spec;
+  }
+
+  void Process(const uint8_t* input, int32_t input_stride, int32_t width,
+               int32_t height, const ImageRegion& region,
+               const KernelParams& params, uint8_t* output) const override {
+    const int top = std::max(region.top, 1);
+    const int bottom = std::min(region.bottom, height - 1);
+    const int left = std::max(region.left, 1);
+    const int right = std::min(region.right, width - 1);
+    for (int j = top; j < bottom; j++) {
+      const uint8_t* above = input + (j - 1) * input_stride;
+      const uint8_t* row = input + j * input_stride;
+      const uint8_t* below = input + (j + 1) * input_stride;
+      for (int i = left; i < right; i++) {
+        // Same filters as DetectEdge().
+        const int x_sum = -above[i - 1] - (2 * row[i - 1]) - below[i - 1] +
+                          above[i + 1] + (2 * row[i + 1]) + below[i + 1];
+        const int y_sum = above[i - 1] + (2 * above[i]) + above[i + 1] -
+                          below[i - 1] - (2 * below[i]) - below[i + 1];
+        const int magnitude =
+            static_cast<int>(std::sqrt(static_cast<float>(
+                (x_sum * x_sum) + (y_sum * y_sum)))) >>
+            kGradientScaleShift;
+        output[j * width + i] = static_cast<uint8_t>(std::min(magnitude, 255));
+      }
+    }
+  }
+};
+
+class ThresholdKernel : public VisionKernel {
+ public:
+  const VisionKernelSpec& GetSpec() const override {
+    static const VisionKernelSpec spec = {"threshold", PixelFormat::kGradient,
+                                          PixelFormat::kEdgeMask, 0};
+    return spec;
+  }
+
+  void Process(const uint8_t* input, int32_t input_stride, int32_t width,
+               int32_t height, const ImageRegion& region,
+               const KernelParams& params, uint8_t* output) const override {
+    for (int j = region.top; j < region.bottom; j++) {
+      const uint8_t* row = input + j * input_stride;
+      uint8_t* output_row = output + j * width;
+      for (int i = region.left; i < region.right; i++) {
+        output_row[i] =
+            row[i] > params.gradient_edge_threshold ? kEdgeValue
+                                                    : kNonEdgeValue;
+      }
+    }
+  }
+};
+
+class SobelEdgeKernel : public VisionKernel {
+ public:
+  const VisionKernelSpec& GetSpec() const override {
+    static const VisionKernelSpec spec = {"sobel_edge", PixelFormat::kLuminance,
+                                          PixelFormat::kEdgeMask, 1};
+    return spec;
+  }
+
+  void Process(const uint8_t* input, int32_t input_stride, int32_t width,
+               int32_t height, const ImageRegion& region,
+               const KernelParams& params, uint8_t* output) const override {
+    DetectEdgeRegion(input, width, height, input_stride, region,
+                     params.sobel_edge_threshold, output);
+  }
+};
+
+class FastCornerKernel : public VisionKernel {
+ public:
+  const VisionKernelSpec& GetSpec() const override {
+    static const VisionKernelSpec spec = {"fast_corner",
+                                          PixelFormat::kLuminance,
+                                          PixelFormat::kEdgeMask, 3};
+    return spec;
+  }
+
+  // Marks every corner, without the non-maximum suppression of
+  // KeypointDetector, which needs the scores around the band.
+  void Process(const uint8_t* input, int32_t input_stride, int32_t width,
+               int32_t height, const ImageRegion& region,
+               const KernelParams& params, uint8_t* output) const override {
+    ScoreFastCornersRegion(input, width, height, input_stride, region,
+                           params.fast_threshold, output);
+    for (int j = region.top; j < region.bottom; j++) {
+      uint8_t* output_row = output + j * width;
+      for (int i = region.left; i < region.right; i++) {
+        output_row[i] = output_row[i] != 0 ? kEdgeValue : kNonEdgeValue;
+      }
+    }
+  }
+};
+}  // namespace
+
+KernelParams GetKernelParamsForSensitivity(int32_t sensitivity_iso) {
+  KernelParams params;
+  if (sensitivity_iso <= kReferenceSensitivityIso) {
+    return params;
+  }
+  // Shot noise, which dominates until the gain gets very high, grows with
+  // the square root of the gain.
+  const float scale =
+      std::min(kMaxThresholdScale,
+               std::sqrt(static_cast<float>(sensitivity_iso) /
+                         kReferenceSensitivityIso));
+  params.sobel_edge_threshold = static_cast<int32_t>(
+      std::lround(params.sobel_edge_threshold * scale * scale));
+  params.gradient_edge_threshold = static_cast<int32_t>(
+      std::lround(params.gradient_edge_threshold * scale));
+  params.fast_threshold =
+      static_cast<int32_t>(std::lround(params.fast_threshold * scale));
+  return params;
+}
+
+KernelParams ScaleKernelParamsForContrast(const KernelParams& params,
+                                          int32_t contrast) {
+  const float scale = std::max(
+      kMinContrastScale,
+      std::min(kMaxContrastScale,
+               static_cast<float>(contrast) / kReferenceContrast));
+  KernelParams scaled = params;
+  // The Sobel threshold is on the squared gradient.
+  scaled.sobel_edge_threshold = static_cast<int32_t>(
+      std::lround(params.sobel_edge_threshold * scale * scale));
+  scaled.gradient_edge_threshold = static_cast<int32_t>(
+      std::lround(params.gradient_edge_threshold * scale));
+  scaled.fast_threshold =
+      static_cast<int32_t>(std::lround(params.fast_threshold * scale));
+  return scaled;
+}
+
+const VisionKernel* FindVisionKernel(const std::string& name) {
+  static const BoxBlurKernel box_blur;
+  static const SobelMagnitudeKernel sobel_magnitude;
+  static const ThresholdKernel threshold;
+  static const SobelEdgeKernel sobel_edge;
+  static const FastCornerKernel fast_corner;
+  static const VisionKernel* const kKernels[] = {
+      &box_blur, &sobel_magnitude, &threshold, &sobel_edge, &fast_corner};
+  for (const VisionKernel* kernel : kKernels) {
+    if (name == kernel->GetSpec().name) {
+      return kernel;
+    }
+  }
+  return nullptr;
+}
+
+}  // namespace computer_vision
@@ -0,0 +1,115 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_COMPUTER_VISION_VISION_KERNEL_H_
+#define C_ARCORE_COMPUTER_VISION_VISION_KERNEL_H_
+
+#include <cstdint>
+#include <string>
+
+#include "edge_detector.h"
+
+namespace computer_vision {
+
+// Contents of an 8 bit plane passed between kernels.
+enum class PixelFormat {
+  // Camera luminance, i.e. the Y plane of the CPU image or a filtered copy.
+  kLuminance,
+  // Gradient magnitude, 0 to 255.
+  kGradient,
+  // 0xFF on edges and 0x1F elsewhere, as drawn by the renderer.
+  kEdgeMask,
+};
+
+constexpr int kMaxKernelSteps = 4;
+
+// Durations of the steps of one run of a kernel chain.
+struct KernelTimings {
+  int num_steps = 0;
+  const char* names[kMaxKernelSteps] = {};
+  float ms[kMaxKernelSteps] = {};
+};
+
+// Values a kernel chain adapts to the image it runs on.  The defaults suit
+// images of a well lit scene.
+struct KernelParams {
+  // Squared gradient threshold of "sobel_edge", see DetectEdgeRegion().
+  int32_t sobel_edge_threshold = kSobelEdgeThreshold;
+  // Gradient above which "threshold" marks an edge, on the scale of
+  // "sobel_magnitude" about the one of "sobel_edge".
+  int32_t gradient_edge_threshold = 32;
+  // Difference to the center of "fast_corner", see ScoreFastCornersRegion().
+  int32_t fast_threshold = kFastThreshold;
+};
+
+// Image noise grows with the sensor gain, so the edge thresholds for an
+// image taken at |sensitivity_iso| are raised in proportion to the noise
+// level, from the defaults at kReferenceSensitivityIso and below up to
+// kMaxThresholdScale times them.  An unknown sensitivity of 0 keeps the
+// defaults.
+constexpr int32_t kReferenceSensitivityIso = 100;
+constexpr float kMaxThresholdScale = 2.f;
+KernelParams GetKernelParamsForSensitivity(int32_t sensitivity_iso);
+
+// The edges of a scene of little contrast are weak, those of a harsh one
+// strong, so on top of the sensitivity the thresholds for an image whose
+// luminance spreads over |contrast| levels, see LuminanceStats::GetContrast(),
+// scale with it relative to kReferenceContrast, by kMinContrastScale to
+// kMaxContrastScale.
+constexpr int32_t kReferenceContrast = 160;
+constexpr float kMinContrastScale = 0.5f;
+constexpr float kMaxContrastScale = 1.5f;
+KernelParams ScaleKernelParamsForContrast(const KernelParams& params,
+                                          int32_t contrast);
+
+// What a kernel consumes and produces, checked when kernels are chained.
+struct VisionKernelSpec {
+  const char* name;
+  PixelFormat input_format;
+  PixelFormat output_format;
+  // Pixels the kernel reads around each output pixel.
+  int32_t halo;
+};
+
+// A per-pixel CPU kernel of the processing chain.  Kernels are stateless, the
+// chain runs them over disjoint row bands concurrently.
+class VisionKernel {
+ public:
+  virtual ~VisionKernel() = default;
+
+  virtual const VisionKernelSpec& GetSpec() const = 0;
+
+  // Writes the pixels of |region| of |output|, a plane of |width| x |height|
+  // with rows of |width| bytes, from |input| with rows of |input_stride|
+  // bytes, adapted by |params|.  Kernels with a halo may leave the pixels
+  // within it of the image border unwritten.
+  virtual void Process(const uint8_t* input, int32_t input_stride,
+                       int32_t width, int32_t height,
+                       const ImageRegion& region, const KernelParams& params,
+                       uint8_t* output) const = 0;
+};
+
+// Returns the built-in kernel called |name|, or null if there is none:
+//   "box_blur"         3x3 box filter, luminance to luminance.
+//   "sobel_magnitude"  Sobel gradient magnitude, luminance to gradient.
+//   "threshold"        Gradient to edge mask.
+//   "sobel_edge"       DetectEdge(), the last two steps in one pass.
+//   "fast_corner"      FAST-9 corners, luminance to edge mask.
+const VisionKernel* FindVisionKernel(const std::string& name);
+
+}  // namespace computer_vision
+
+#endif  // C_ARCORE_COMPUTER_VISION_VISION_KERNEL_H_
@@ -0,0 +1,85 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_COMPUTER_VISION_WORKER_POOL_H_
+#define C_ARCORE_COMPUTER_VISION_WORKER_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>  // NOLINT
+#include <thread>  // NOLINT
+#include <vector>
+
+namespace computer_vision {
+
+// Persistent threads that run the independent tasks of a per-pixel kernel,
+// e.g. one band of image rows each.
+//
+// The thread calling Run() works on the tasks too, so a pool of N workers
+// keeps N + 1 cores busy.  Tasks are claimed from an atomic index and every
+// finished task decrements an atomic completion counter; the caller returns
+// once the counter reaches zero, without a barrier between the threads.
+class WorkerPool {
+ public:
+  // Starts GetDefaultWorkerCount() workers.
+  WorkerPool();
+  explicit WorkerPool(int num_workers);
+  ~WorkerPool();
+
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  // One worker less than the number of big cores, the calling thread is
+  // expected to run on the remaining one.  Falls back to all cores if the
+  // cores cannot be told apart.
+  static int GetDefaultWorkerCount();
+
+  // Number of threads working on the tasks of Run(), the caller included.
+  int GetThreadCount() const { return static_cast<int>(workers_.size()) + 1; }
+
+  // Calls |task| with every index in [0, num_tasks) and returns when all
+  // calls have finished.  The calls run concurrently, in no particular order.
+  // Must not be called concurrently or from inside a task.
+  void Run(int num_tasks, const std::function<void(int)>& task);
+
+ private:
+  void WorkerLoop();
+
+  // Claims and runs task indices until none are left.
+  void RunTasks(const std::function<void(int)>& task);
+
+  std::vector<std::thread> workers_;
+
+  // Guards the job description below and wakes the workers.
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  uint64_t generation_ = 0;
+  bool stopping_ = false;
+  const std::function<void(int)>* task_ = nullptr;
+  int num_tasks_ = 0;
+
+  std::atomic<int> next_task_{0};
+  // Tasks not yet finished.
+  std::atomic<int> pending_tasks_{0};
+  // Workers that joined the current job and may still read it.
+  std::atomic<int> workers_in_job_{0};
+};
+
+}  // namespace computer_vision
+
+#endif  // C_ARCORE_COMPUTER_VISION_WORKER_POOL_H_
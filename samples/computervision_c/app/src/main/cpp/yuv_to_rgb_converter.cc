@@ -0,0 +1,433 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "yuv_to_rgb_converter.h"
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <memory>
+
+#include "cpu_features.h"
+#include "util.h"
+
+namespace computer_vision {
+
+constexpr int YuvToRgbConverter::kWeightBits;
+constexpr int YuvToRgbConverter::kWeightOne;
+
+namespace {
+using Tap = YuvToRgbConverter::Tap;
+
+constexpr int kWeightBits = YuvToRgbConverter::kWeightBits;
+constexpr int kWeightOne = YuvToRgbConverter::kWeightOne;
+constexpr int kChannels = 3;
+
+// Full range BT.601 in 7 bit fixed point:
+//   R = Y + 1.402 (V - 128)
+//   G = Y - 0.344 (U - 128) - 0.714 (V - 128)
+//   B = Y + 1.772 (U - 128)
+// The products stay within 16 bits, so NEON computes them in 16 bit lanes.
+constexpr int kCoefficientBits = 7;
+constexpr int16_t kVToR = 179;
+constexpr int16_t kUToG = 44;
+constexpr int16_t kVToG = 91;
+constexpr int16_t kUToB = 227;
+
+// Output pixels gathered and converted at a time.
+constexpr int kLanes = 8;
+
+// The taps of the pixels of one output row.  Along one axis they advance with
+// the pixels, along the other they are the same for the whole row.
+struct RowTaps {
+  const Tap* x;
+  int32_t x_step;
+  const Tap* y;
+  int32_t y_step;
+};
+
+// The source samples and weights of up to kLanes output pixels, one lane each.
+// The four samples of a plane are the top left, top right, bottom left and
+// bottom right ones.
+struct SampleBlock {
+  uint8_t luma[4][kLanes];
+  uint8_t u[4][kLanes];
+  uint8_t v[4][kLanes];
+  uint8_t luma_weight_x[kLanes];
+  uint8_t luma_weight_y[kLanes];
+  uint8_t chroma_weight_x[kLanes];
+  uint8_t chroma_weight_y[kLanes];
+};
+
+// Fills the taps of |count| output coordinates that cover |crop_size| image
+// pixels from |crop_start|, of an axis of |size| pixels.  Pixel centers are
+// mapped onto each other, and the chroma samples are centered between the
+// two luma samples they cover.
+void BuildTaps(int32_t count, int32_t crop_start, int32_t crop_size,
+               int32_t size, bool reversed, std::vector<Tap>* taps) {
+  taps->resize(count);
+  const int32_t chroma_size = (size + 1) / 2;
+  const float step = static_cast<float>(crop_size) / count;
+  for (int32_t i = 0; i < count; ++i) {
+    float position = (i + 0.5f) * step - 0.5f;
+    if (reversed) {
+      position = crop_size - 1 - position;
+    }
+    const float luma = std::min(std::max(crop_start + position, 0.f),
+                                static_cast<float>(size - 1));
+    const float chroma = std::min(std::max((luma + 0.5f) * 0.5f - 0.5f, 0.f),
+                                  static_cast<float>(chroma_size - 1));
+    Tap& tap = (*taps)[i];
+    tap.luma = std::min(static_cast<int32_t>(luma), size - 2);
+    tap.chroma = std::min(static_cast<int32_t>(chroma), chroma_size - 2);
+    tap.luma_weight =
+        static_cast<uint8_t>(std::lround((luma - tap.luma) * kWeightOne));
+    tap.chroma_weight =
+        static_cast<uint8_t>(std::lround((chroma - tap.chroma) * kWeightOne));
+  }
+}
+
+inline void Gather(const YuvImage& image, const Tap& x, const Tap& y, int lane,
+                   SampleBlock* block) {
+  const uint8_t* luma_row = image.y + y.luma * image.y_stride + x.luma;
+  block->luma[0][lane] = luma_row[0];
+  block->luma[1][lane] = luma_row[1];
+  block->luma[2][lane] = luma_row[image.y_stride];
+  block->luma[3][lane] = luma_row[image.y_stride + 1];
+  const int32_t chroma =
+      y.chroma * image.uv_stride + x.chroma * image.uv_pixel_stride;
+  const int32_t offsets[4] = {
+      chroma, chroma + image.uv_pixel_stride, chroma + image.uv_stride,
+      chroma + image.uv_stride + image.uv_pixel_stride};
+  for (int i = 0; i < 4; ++i) {
+    block->u[i][lane] = image.u[offsets[i]];
+    block->v[i][lane] = image.v[offsets[i]];
+  }
+  block->luma_weight_x[lane] = x.luma_weight;
+  block->luma_weight_y[lane] = y.luma_weight;
+  block->chroma_weight_x[lane] = x.chroma_weight;
+  block->chroma_weight_y[lane] = y.chroma_weight;
+}
+
+void GatherBlock(const YuvImage& image, const RowTaps& taps, int32_t first,
+                 int count, SampleBlock* block) {
+  for (int lane = 0; lane < count; ++lane) {
+    const int32_t i = first + lane;
+    Gather(image, taps.x[i * taps.x_step], taps.y[i * taps.y_step], lane,
+           block);
+  }
+}
+
+inline int Lerp(int a, int b, int weight) {
+  return (a * (kWeightOne - weight) + b * weight + kWeightOne / 2) >>
+         kWeightBits;
+}
+
+inline int Bilinear(const uint8_t (&samples)[4][kLanes], int lane,
+                    int weight_x, int weight_y) {
+  return Lerp(Lerp(samples[0][lane], samples[1][lane], weight_x),
+              Lerp(samples[2][lane], samples[3][lane], weight_x), weight_y);
+}
+
+inline uint8_t ClampToByte(int value) {
+  return static_cast<uint8_t>(std::min(std::max(value, 0), 255));
+}
+
+// Writes the |rgb| bytes of pixel |i| of a row in |format|.
+inline void StorePixel(const uint8_t* rgb, const RgbConversion& conversion,
+                       int32_t i, void* row_output) {
+  if (conversion.format == RgbFormat::kRgb8) {
+    memcpy(static_cast<uint8_t*>(row_output) + i * kChannels, rgb, kChannels);
+    return;
+  }
+  float* output = static_cast<float*>(row_output) + i * kChannels;
+  for (int c = 0; c < kChannels; ++c) {
+    output[c] = rgb[c] * conversion.scale[c] + conversion.offset[c];
+  }
+}
+
+// Converts the pixels [first, first + count) of a row from |block|.
+void ConvertBlockScalar(const SampleBlock& block,
+                        const RgbConversion& conversion, int32_t first,
+                        int count, void* row_output) {
+  for (int lane = 0; lane < count; ++lane) {
+    const int y = Bilinear(block.luma, lane, block.luma_weight_x[lane],
+                           block.luma_weight_y[lane]);
+    const int u = Bilinear(block.u, lane, block.chroma_weight_x[lane],
+                           block.chroma_weight_y[lane]) -
+                  128;
+    const int v = Bilinear(block.v, lane, block.chroma_weight_x[lane],
+                           block.chroma_weight_y[lane]) -
+                  128;
+    constexpr int kRound = 1 << (kCoefficientBits - 1);
+    const uint8_t rgb[kChannels] = {
+        ClampToByte(y + ((kVToR * v + kRound) >> kCoefficientBits)),
+        ClampToByte(y - ((kUToG * u + kVToG * v + kRound) >> kCoefficientBits)),
+        ClampToByte(y + ((kUToB * u + kRound) >> kCoefficientBits))};
+    StorePixel(rgb, conversion, first + lane, row_output);
+  }
+}
+
+void ConvertRowScalar(const YuvImage& image, const RowTaps& taps,
+                      int32_t count, const RgbConversion& conversion,
+                      void* row_output) {
+  SampleBlock block;
+  for (int32_t i = 0; i < count; i += kLanes) {
+    const int lanes = std::min<int32_t>(kLanes, count - i);
+    GatherBlock(image, taps, i, lanes, &block);
+    ConvertBlockScalar(block, conversion, i, lanes, row_output);
+  }
+}
+
+#if defined(__ARM_NEON)
+// Same as Lerp() on 8 lanes.
+inline uint8x8_t LerpNeon(uint8x8_t a, uint8x8_t b, uint8x8_t weight) {
+  const uint8x8_t inverse = vsub_u8(vdup_n_u8(kWeightOne), weight);
+  return vrshrn_n_u16(vmlal_u8(vmull_u8(a, inverse), b, weight), kWeightBits);
+}
+
+inline uint8x8_t BilinearNeon(const uint8_t (&samples)[4][kLanes],
+                              uint8x8_t weight_x, uint8x8_t weight_y) {
+  return LerpNeon(LerpNeon(vld1_u8(samples[0]), vld1_u8(samples[1]), weight_x),
+                  LerpNeon(vld1_u8(samples[2]), vld1_u8(samples[3]), weight_x),
+                  weight_y);
+}
+
+// |value| - 128 as signed 16 bit lanes, see SubtractWide() of the edge
+// detector.
+inline int16x8_t CenterChroma(uint8x8_t value) {
+  return vreinterpretq_s16_u16(vsubl_u8(value, vdup_n_u8(128)));
+}
+
+inline float32x4x3_t NormalizeNeon(const uint16x4_t (&rgb)[kChannels],
+                                   const RgbConversion& conversion) {
+  float32x4x3_t result;
+  for (int c = 0; c < kChannels; ++c) {
+    result.val[c] = vmlaq_n_f32(vdupq_n_f32(conversion.offset[c]),
+                                vcvtq_f32_u32(vmovl_u16(rgb[c])),
+                                conversion.scale[c]);
+  }
+  return result;
+}
+
+void ConvertRowNeon(const YuvImage& image, const RowTaps& taps, int32_t count,
+                    const RgbConversion& conversion, void* row_output) {
+  SampleBlock block;
+  int32_t i = 0;
+  for (; i + kLanes <= count; i += kLanes) {
+    // NEON has no byte gathers, the rotation and scaling make the taps
+    // irregular.
+    GatherBlock(image, taps, i, kLanes, &block);
+    const int16x8_t y = vreinterpretq_s16_u16(vmovl_u8(
+        BilinearNeon(block.luma, vld1_u8(block.luma_weight_x),
+                     vld1_u8(block.luma_weight_y))));
+    const uint8x8_t chroma_weight_x = vld1_u8(block.chroma_weight_x);
+    const uint8x8_t chroma_weight_y = vld1_u8(block.chroma_weight_y);
+    const int16x8_t u = CenterChroma(
+        BilinearNeon(block.u, chroma_weight_x, chroma_weight_y));
+    const int16x8_t v = CenterChroma(
+        BilinearNeon(block.v, chroma_weight_x, chroma_weight_y));
+    uint8x8x3_t rgb;
+    rgb.val[0] = vqmovun_s16(vaddq_s16(
+        y, vrshrq_n_s16(vmulq_n_s16(v, kVToR), kCoefficientBits)));
+    rgb.val[1] = vqmovun_s16(vsubq_s16(
+        y, vrshrq_n_s16(vmlaq_n_s16(vmulq_n_s16(u, kUToG), v, kVToG),
+                        kCoefficientBits)));
+    rgb.val[2] = vqmovun_s16(vaddq_s16(
+        y, vrshrq_n_s16(vmulq_n_s16(u, kUToB), kCoefficientBits)));
+
+    if (conversion.format == RgbFormat::kRgb8) {
+      vst3_u8(static_cast<uint8_t*>(row_output) + i * kChannels, rgb);
+      continue;
+    }
+    uint16x4_t low[kChannels];
+    uint16x4_t high[kChannels];
+    for (int c = 0; c < kChannels; ++c) {
+      const uint16x8_t wide = vmovl_u8(rgb.val[c]);
+      low[c] = vget_low_u16(wide);
+      high[c] = vget_high_u16(wide);
+    }
+    float* output = static_cast<float*>(row_output) + i * kChannels;
+    vst3q_f32(output, NormalizeNeon(low, conversion));
+    vst3q_f32(output + 4 * kChannels, NormalizeNeon(high, conversion));
+  }
+  if (i < count) {
+    const int lanes = count - i;
+    GatherBlock(image, taps, i, lanes, &block);
+    ConvertBlockScalar(block, conversion, i, lanes, row_output);
+  }
+}
+
+#ifndef NDEBUG
+// Checks once that the NEON path matches the scalar one on real input.
+void VerifyNeonConversion(const YuvImage& image, const RowTaps& taps,
+                          int32_t count, const RgbConversion& conversion,
+                          const void* neon_output) {
+  static std::atomic<bool> verified{false};
+  if (conversion.format != RgbFormat::kRgb8 || verified.exchange(true)) {
+    return;
+  }
+  std::unique_ptr<uint8_t[]> scalar_output(new uint8_t[count * kChannels]);
+  ConvertRowScalar(image, taps, count, conversion, scalar_output.get());
+  if (memcmp(neon_output, scalar_output.get(), count * kChannels) != 0) {
+    LOGE("YuvToRgbConverter: NEON output differs from the scalar one");
+  }
+}
+#endif  // NDEBUG
+#endif  // __ARM_NEON
+}  // namespace
+
+bool GetYuvImage(const ArSession* session, const ArImage* image,
+                 YuvImage* out_image) {
+  ArImageFormat format;
+  ArImage_getFormat(session, image, &format);
+  int32_t num_planes = 0;
+  ArImage_getNumberOfPlanes(session, image, &num_planes);
+  if (format != AR_IMAGE_FORMAT_YUV_420_888 || num_planes != 3) {
+    LOGE("GetYuvImage: expected an image in YUV_420_888 format.");
+    return false;
+  }
+  YuvImage yuv;
+  ArImage_getWidth(session, image, &yuv.width);
+  ArImage_getHeight(session, image, &yuv.height);
+  int32_t length = 0;
+  ArImage_getPlaneData(session, image, 0, &yuv.y, &length);
+  ArImage_getPlaneData(session, image, 1, &yuv.u, &length);
+  ArImage_getPlaneData(session, image, 2, &yuv.v, &length);
+  ArImage_getPlaneRowStride(session, image, 0, &yuv.y_stride);
+  ArImage_getPlaneRowStride(session, image, 1, &yuv.uv_stride);
+  ArImage_getPlanePixelStride(session, image, 1, &yuv.uv_pixel_stride);
+  int32_t v_row_stride = 0;
+  int32_t v_pixel_stride = 0;
+  ArImage_getPlaneRowStride(session, image, 2, &v_row_stride);
+  ArImage_getPlanePixelStride(session, image, 2, &v_pixel_stride);
+  if (yuv.y == nullptr || yuv.u == nullptr || yuv.v == nullptr ||
+      v_row_stride != yuv.uv_stride || v_pixel_stride != yuv.uv_pixel_stride ||
+      (yuv.uv_pixel_stride != 1 && yuv.uv_pixel_stride != 2)) {
+    LOGE("GetYuvImage: unsupported plane layout, pixel stride %d.",
+         yuv.uv_pixel_stride);
+    return false;
+  }
+  *out_image = yuv;
+  return true;
+}
+
+bool YuvToRgbConverter::Prepare(int32_t width, int32_t height,
+                                const RgbConversion& conversion) {
+  const ImageRegion& crop = conversion.crop;
+  // Two chroma samples per axis are interpolated.
+  if (width < 4 || height < 4 || crop.IsEmpty() || crop.left < 0 ||
+      crop.top < 0 || crop.right > width || crop.bottom > height ||
+      conversion.output_width <= 0 || conversion.output_height <= 0) {
+    return false;
+  }
+  conversion_ = conversion;
+  conversion_.quarter_turns = (conversion.quarter_turns % 4 + 4) % 4;
+  width_ = width;
+  height_ = height;
+  const int32_t turns = conversion_.quarter_turns;
+  transposed_ = turns % 2 == 1;
+  // Where output columns and rows run in the image, e.g. for one clockwise
+  // turn the columns go up the image and the rows to the right.
+  const bool columns_reversed = turns == 1 || turns == 2;
+  const bool rows_reversed = turns == 2 || turns == 3;
+  const int32_t crop_width = crop.right - crop.left;
+  const int32_t crop_height = crop.bottom - crop.top;
+  if (transposed_) {
+    BuildTaps(conversion.output_width, crop.top, crop_height, height,
+              columns_reversed, &column_taps_);
+    BuildTaps(conversion.output_height, crop.left, crop_width, width,
+              rows_reversed, &row_taps_);
+  } else {
+    BuildTaps(conversion.output_width, crop.left, crop_width, width,
+              columns_reversed, &column_taps_);
+    BuildTaps(conversion.output_height, crop.top, crop_height, height,
+              rows_reversed, &row_taps_);
+  }
+  return true;
+}
+
+void YuvToRgbConverter::ConvertRows(const YuvImage& image, int32_t row_begin,
+                                    int32_t row_end, void* output) const {
+  static const YuvToRgbVariant variant =
+      IsVariantSupported(YuvToRgbVariant::kNeon) ? YuvToRgbVariant::kNeon
+                                                 : YuvToRgbVariant::kScalar;
+  ConvertRowsWithVariant(variant, image, row_begin, row_end, output);
+}
+
+void YuvToRgbConverter::ConvertRowsWithVariant(YuvToRgbVariant variant,
+                                               const YuvImage& image,
+                                               int32_t row_begin,
+                                               int32_t row_end,
+                                               void* output) const {
+  if (image.width != width_ || image.height != height_) {
+    LOGE("YuvToRgbConverter: image size changed since Prepare().");
+    return;
+  }
+  const int32_t count = conversion_.output_width;
+  const size_t row_size =
+      count * kChannels *
+      (conversion_.format == RgbFormat::kRgb8 ? sizeof(uint8_t)
+                                              : sizeof(float));
+  row_end = std::min(row_end, conversion_.output_height);
+  for (int32_t row = row_begin; row < row_end; ++row) {
+    RowTaps taps;
+    if (transposed_) {
+      taps = {&row_taps_[row], 0, column_taps_.data(), 1};
+    } else {
+      taps = {column_taps_.data(), 1, &row_taps_[row], 0};
+    }
+    void* row_output = static_cast<uint8_t*>(output) + row * row_size;
+#if defined(__ARM_NEON)
+    if (variant == YuvToRgbVariant::kNeon) {
+      ConvertRowNeon(image, taps, count, conversion_, row_output);
+#ifndef NDEBUG
+      VerifyNeonConversion(image, taps, count, conversion_, row_output);
+#endif  // NDEBUG
+      continue;
+    }
+#endif  // __ARM_NEON
+    ConvertRowScalar(image, taps, count, conversion_, row_output);
+  }
+}
+
+size_t YuvToRgbConverter::GetOutputSize() const {
+  return static_cast<size_t>(conversion_.output_width) *
+         conversion_.output_height * kChannels *
+         (conversion_.format == RgbFormat::kRgb8 ? sizeof(uint8_t)
+                                                 : sizeof(float));
+}
+
+bool YuvToRgbConverter::IsVariantSupported(YuvToRgbVariant variant) {
+  switch (variant) {
+    case YuvToRgbVariant::kScalar:
+      return true;
+    case YuvToRgbVariant::kNeon:
+#if defined(__ARM_NEON)
+      return IsNeonSupported();
+#else
+      return false;
+#endif  // __ARM_NEON
+  }
+  return false;
+}
+
+}  // namespace computer_vision
@@ -0,0 +1,141 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_COMPUTER_VISION_YUV_TO_RGB_CONVERTER_H_
+#define C_ARCORE_COMPUTER_VISION_YUV_TO_RGB_CONVERTER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "arcore_c_api.h"
+#include "edge_detector.h"
+
+namespace computer_vision {
+
+// The planes of a YUV_420_888 image.  U and V have half the resolution and
+// share their row and pixel strides; a pixel stride of 1 is planar (I420),
+// 2 semi-planar (NV12 or NV21, depending on which of U and V comes first).
+struct YuvImage {
+  const uint8_t* y = nullptr;
+  const uint8_t* u = nullptr;
+  const uint8_t* v = nullptr;
+  int32_t width = 0;
+  int32_t height = 0;
+  int32_t y_stride = 0;
+  int32_t uv_stride = 0;
+  int32_t uv_pixel_stride = 0;
+};
+
+// Fills |out_image| from the planes of |image|.  Returns false if it is not a
+// YUV_420_888 image or has a pixel stride other than 1 or 2.
+bool GetYuvImage(const ArSession* session, const ArImage* image,
+                 YuvImage* out_image);
+
+enum class RgbFormat {
+  // Three bytes per pixel.
+  kRgb8,
+  // Three floats per pixel, each channel mapped by scale * value + offset
+  // from its 0 to 255 value.
+  kRgbFloat,
+};
+
+// What YuvToRgbConverter writes.
+struct RgbConversion {
+  // The pixels of the camera image to convert.
+  ImageRegion crop;
+  // Clockwise quarter turns applied to the crop, e.g. the
+  // camera_to_display_rotation the activity passes, so the output is
+  // upright on screen.
+  int32_t quarter_turns = 0;
+  // Size of the output, into which the rotated crop is scaled.
+  int32_t output_width = 0;
+  int32_t output_height = 0;
+  RgbFormat format = RgbFormat::kRgb8;
+  // Normalization of kRgbFloat, [0, 1] by default.
+  float scale[3] = {1.f / 255.f, 1.f / 255.f, 1.f / 255.f};
+  float offset[3] = {0.f, 0.f, 0.f};
+};
+
+// Implementations of YuvToRgbConverter::ConvertRows().  Exposed to compare
+// them, e.g. in RunKernelBenchmark().
+enum class YuvToRgbVariant { kScalar, kNeon };
+
+// Crops, rotates, bilinearly scales and converts a YUV_420_888 camera image
+// to RGB in one pass over the output, so the image is read once and nothing
+// but the output is written.  Full range BT.601, which camera images use,
+// with 7 bit fixed point coefficients; RGB8 results are the same byte for
+// byte with and without NEON.
+//
+// Prepare() computes the source coordinates of every output row and column
+// for a conversion, and only allocates when the output grows.  The rows of
+// the output can then be converted concurrently, e.g. in bands on a
+// WorkerPool.
+class YuvToRgbConverter {
+ public:
+  YuvToRgbConverter() = default;
+
+  YuvToRgbConverter(const YuvToRgbConverter&) = delete;
+  YuvToRgbConverter& operator=(const YuvToRgbConverter&) = delete;
+
+  // Sets up |conversion| of images of |width| x |height|.  Returns false if
+  // the crop is empty or not inside the image, or the output is empty.
+  bool Prepare(int32_t width, int32_t height, const RgbConversion& conversion);
+
+  // Writes the output rows [row_begin, row_end) into |output|, which holds
+  // output_height rows of output_width pixels without padding.  |image| must
+  // have the size Prepare() was called with.  May be called concurrently for
+  // disjoint rows.
+  void ConvertRows(const YuvImage& image, int32_t row_begin, int32_t row_end,
+                   void* output) const;
+
+  // ConvertRows() with |variant|, which must be supported.
+  void ConvertRowsWithVariant(YuvToRgbVariant variant, const YuvImage& image,
+                              int32_t row_begin, int32_t row_end,
+                              void* output) const;
+
+  const RgbConversion& GetConversion() const { return conversion_; }
+
+  // Bytes of a converted image.
+  size_t GetOutputSize() const;
+
+  static bool IsVariantSupported(YuvToRgbVariant variant);
+
+  // Source taps of one output coordinate along one image axis: the first of
+  // the two luma and chroma samples it interpolates, and the weight of the
+  // second, 0 to kWeightOne.
+  struct Tap {
+    int32_t luma = 0;
+    int32_t chroma = 0;
+    uint8_t luma_weight = 0;
+    uint8_t chroma_weight = 0;
+  };
+  static constexpr int kWeightBits = 7;
+  static constexpr int kWeightOne = 1 << kWeightBits;
+
+ private:
+  RgbConversion conversion_;
+  int32_t width_ = 0;
+  int32_t height_ = 0;
+  // Whether output rows run along image columns, for odd quarter turns.
+  bool transposed_ = false;
+  std::vector<Tap> column_taps_;
+  std::vector<Tap> row_taps_;
+};
+
+}  // namespace computer_vision
+
+#endif  // C_ARCORE_COMPUTER_VISION_YUV_TO_RGB_CONVERTER_H_
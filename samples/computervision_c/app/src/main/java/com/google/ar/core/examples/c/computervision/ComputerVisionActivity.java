@@ -36,6 +36,7 @@ import android.widget.TextView;
 import android.widget.Toast;
 import androidx.appcompat.app.AppCompatActivity;
 import com.google.android.material.snackbar.Snackbar;
+import java.io.File;
 import javax.microedition.khronos.egl.EGLConfig;
 import javax.microedition.khronos.opengles.GL10;
 
@@ -46,9 +47,19 @@ import javax.microedition.khronos.opengles.GL10;
 public class ComputerVisionActivity extends AppCompatActivity
     implements GLSurfaceView.Renderer, DisplayManager.DisplayListener {
   private static final String TAG = ComputerVisionActivity.class.getSimpleName();
+  private static final String EXTRA_RUN_KERNEL_BENCHMARK = "run_kernel_benchmark";
+  // Intent extra with the URI of an MP4 dataset to benchmark, written to playback_benchmark.csv
+  // in the app's external files directory.
+  private static final String EXTRA_BENCHMARK_DATASET_URI = "benchmark_dataset_uri";
+  private static final String BENCHMARK_CSV_FILE_NAME = "playback_benchmark.csv";
+  // CPU image processing time per frame the automatic resolution keeps to, in milliseconds.
+  private static final float AUTO_RESOLUTION_PROCESSING_BUDGET_MS = 10.0f;
+  // Highest image pyramid level a long press cycles through, see ImagePyramid::kMaxLevel.
+  private static final int MAX_PYRAMID_LEVEL = 2;
 
   // Opaque native pointer to the native application instance.
   private long nativeApplication;
+  private boolean benchmarkRunning = false;
 
   private GLSurfaceView surfaceView;
   private boolean viewportChanged = false;
@@ -57,11 +68,15 @@ public class ComputerVisionActivity extends AppCompatActivity
   // Using float value to set the splitter position in shader in native code.
   private float splitterPosition = 0.0f;
   private boolean isLowResolutionSelected = true;
+  private boolean isAutoResolutionSelected = false;
+  // Image pyramid level the CPU edge detection runs on, 0 being the full resolution.
+  private int pyramidLevel = 0;
 
   // Camera intrinsics text elements.
   private TextView cameraIntrinsicsTextView;
 
   private Switch focusModeSwitch;
+  private Switch gpuEdgeDetectionSwitch;
   private GestureDetector gestureDetector;
   private Snackbar snackbar;
 
@@ -72,6 +87,8 @@ public class ComputerVisionActivity extends AppCompatActivity
     cameraIntrinsicsTextView = findViewById(R.id.camera_intrinsics_view);
     focusModeSwitch = (Switch) findViewById(R.id.switch_focus_mode);
     focusModeSwitch.setOnCheckedChangeListener(this::onFocusModeChanged);
+    gpuEdgeDetectionSwitch = (Switch) findViewById(R.id.switch_gpu_edge_detection);
+    gpuEdgeDetectionSwitch.setOnCheckedChangeListener(this::onGpuEdgeDetectionChanged);
 
     surfaceView = findViewById(R.id.surfaceview);
     gestureDetector =
@@ -87,6 +104,17 @@ public class ComputerVisionActivity extends AppCompatActivity
                 return true;
               }
 
+              @Override
+              public void onLongPress(MotionEvent e) {
+                pyramidLevel = (pyramidLevel + 1) % (MAX_PYRAMID_LEVEL + 1);
+                JniInterface.setPyramidLevel(nativeApplication, pyramidLevel);
+                Toast.makeText(
+                        ComputerVisionActivity.this,
+                        "CPU image processed at 1/" + (1 << pyramidLevel) + " resolution",
+                        Toast.LENGTH_SHORT)
+                    .show();
+              }
+
               @Override
               public boolean onDown(MotionEvent e) {
                 return true;
@@ -96,13 +124,42 @@ public class ComputerVisionActivity extends AppCompatActivity
 
     // Set up renderer.
     surfaceView.setPreserveEGLContextOnPause(true);
-    surfaceView.setEGLContextClientVersion(2);
+    // OpenGL ES 3 gives the compute shader edge detection a chance to run, on an OpenGL ES 3.1
+    // context.
+    surfaceView.setEGLContextClientVersion(3);
     surfaceView.setEGLConfigChooser(8, 8, 8, 8, 16, 0); // Alpha used for plane blending.
     surfaceView.setRenderer(this);
     surfaceView.setRenderMode(GLSurfaceView.RENDERMODE_CONTINUOUSLY);
     surfaceView.setWillNotDraw(false);
 
     nativeApplication = JniInterface.createNativeApplication(getAssets());
+
+    // Started with `adb shell am start -n <package>/.ComputerVisionActivity --es
+    // benchmark_dataset_uri file:///sdcard/dataset.mp4`, the dataset is played back and every
+    // frame is timed.
+    String benchmarkDatasetUri = getIntent().getStringExtra(EXTRA_BENCHMARK_DATASET_URI);
+    if (benchmarkDatasetUri != null) {
+      File csvFile = new File(getExternalFilesDir(null), BENCHMARK_CSV_FILE_NAME);
+      benchmarkRunning =
+          JniInterface.startPlaybackBenchmark(
+              nativeApplication, benchmarkDatasetUri, csvFile.getAbsolutePath());
+      if (!benchmarkRunning) {
+        Log.e(TAG, "Could not start the playback benchmark");
+      }
+    }
+
+    // Started with `adb shell am start -n <package>/.ComputerVisionActivity --ez
+    // run_kernel_benchmark true`, the CPU kernels are timed once and the results are logged.
+    if (getIntent().getBooleanExtra(EXTRA_RUN_KERNEL_BENCHMARK, false)) {
+      new Thread(
+              () -> {
+                for (String line : JniInterface.runKernelBenchmark().split("\n")) {
+                  Log.i(TAG, line);
+                }
+              },
+              "KernelBenchmark")
+          .start();
+    }
   }
 
   @Override
@@ -267,9 +324,16 @@ public class ComputerVisionActivity extends AppCompatActivity
       }
 
       JniInterface.onGlSurfaceDrawFrame(nativeApplication, splitterPosition);
+      if (benchmarkRunning && JniInterface.isPlaybackBenchmarkFinished(nativeApplication)) {
+        benchmarkRunning = false;
+        Log.i(TAG, "Playback benchmark finished");
+        runOnUiThread(this::finish);
+      }
       final String cameraIntrinsicsText =
           JniInterface.getCameraIntrinsicsText(
-              nativeApplication, /*forGpuTexture=*/ (splitterPosition > 0.5f));
+                  nativeApplication, /*forGpuTexture=*/ (splitterPosition > 0.5f))
+              + "\n"
+              + JniInterface.getEdgeDetectionTimingText(nativeApplication);
 
       runOnUiThread(() -> cameraIntrinsicsTextView.setText(cameraIntrinsicsText));
     }
@@ -303,9 +367,10 @@ public class ComputerVisionActivity extends AppCompatActivity
 
   public void onLowResolutionRadioButtonClicked(View view) {
     boolean checked = ((RadioButton) view).isChecked();
-    if (checked && !isLowResolutionSelected) {
+    if (checked && (!isLowResolutionSelected || isAutoResolutionSelected)) {
       // Display low resolution.
       isLowResolutionSelected = true;
+      isAutoResolutionSelected = false;
       String label = (String) ((RadioButton) view).getText();
       onCameraConfigChanged(isLowResolutionSelected, label);
     }
@@ -313,18 +378,35 @@ public class ComputerVisionActivity extends AppCompatActivity
 
   public void onHighResolutionRadioButtonClicked(View view) {
     boolean checked = ((RadioButton) view).isChecked();
-    if (checked && isLowResolutionSelected) {
+    if (checked && (isLowResolutionSelected || isAutoResolutionSelected)) {
       // Display high resolution
       isLowResolutionSelected = false;
+      isAutoResolutionSelected = false;
       String label = (String) ((RadioButton) view).getText();
       onCameraConfigChanged(isLowResolutionSelected, label);
     }
   }
 
+  public void onAutoResolutionRadioButtonClicked(View view) {
+    boolean checked = ((RadioButton) view).isChecked();
+    if (checked && !isAutoResolutionSelected) {
+      // Let the native application step through the camera configs.
+      isAutoResolutionSelected = true;
+      JniInterface.setCameraConfigGovernorEnabled(
+          nativeApplication, true, AUTO_RESOLUTION_PROCESSING_BUDGET_MS);
+      Toast.makeText(this, "Selecting the camera config automatically", Toast.LENGTH_SHORT)
+          .show();
+    }
+  }
+
   private void onFocusModeChanged(CompoundButton unusedButton, boolean isChecked) {
     JniInterface.setFocusMode(nativeApplication, isChecked);
   }
 
+  private void onGpuEdgeDetectionChanged(CompoundButton unusedButton, boolean isChecked) {
+    JniInterface.setUseGpuEdgeDetection(nativeApplication, isChecked);
+  }
+
   private void onCameraConfigChanged(boolean isLowResolution, String label) {
     int status = JniInterface.setCameraConfig(nativeApplication, isLowResolution);
     if (status == 0) {
@@ -78,6 +78,17 @@ public class JniInterface {
 
   static native int setCameraConfig(long nativeApplication, boolean isLowResolutionSelected);
 
+  /**
+   * Lets the native application pick the camera config on its own, keeping the CPU image processing
+   * of every frame within the given budget. Calling setCameraConfig turns it off again.
+   *
+   * @param nativeApplication the native application handle.
+   * @param enabled whether the camera config is selected automatically.
+   * @param processingBudgetMs the CPU image processing time allowed per frame, in milliseconds.
+   */
+  static native void setCameraConfigGovernorEnabled(
+      long nativeApplication, boolean enabled, float processingBudgetMs);
+
   /**
    * Retrieves the text for the intrinsic values of the current camera configuration.
    *
@@ -86,6 +97,69 @@ public class JniInterface {
    */
   static native String getCameraIntrinsicsText(long nativeApplication, boolean forGpuTexture);
 
+  /**
+   * Switches the edge detection between the CPU image and a compute shader on the camera texture.
+   * Falls back to the CPU image if the OpenGL context does not support compute shaders.
+   *
+   * @param nativeApplication the native application handle.
+   * @param useGpu whether the edges are detected on the GPU.
+   */
+  static native void setUseGpuEdgeDetection(long nativeApplication, boolean useGpu);
+
+  /**
+   * Runs the CPU edge detection on a level of the image pyramid, each level halving the resolution
+   * of the one before. The result is upsampled when drawn.
+   *
+   * @param nativeApplication the native application handle.
+   * @param level the pyramid level, 0 being the full resolution.
+   */
+  static native void setPyramidLevel(long nativeApplication, int level);
+
+  /**
+   * Replaces the chain of CPU kernels the edges are detected with, e.g.
+   * "box_blur,sobel_magnitude,threshold". The default chain is "sobel_edge".
+   *
+   * @param nativeApplication the native application handle.
+   * @param chain comma separated kernel names, starting on luminance and ending in an edge mask.
+   * @return false if the chain is not valid, in which case the current one is kept.
+   */
+  static native boolean setKernelChain(long nativeApplication, String chain);
+
+  /**
+   * Skips the CPU edge detection while the camera barely moves, reusing the result of the last
+   * processed image. Images with the timestamp of the last processed one are always skipped.
+   *
+   * @param nativeApplication the native application handle.
+   * @param enabled whether to skip images by the camera motion.
+   */
+  static native void setMotionGateEnabled(long nativeApplication, boolean enabled);
+
+  /**
+   * Times the CPU kernels on synthetic images of common camera sizes. Takes a few seconds, so it
+   * must not be called on the UI or the GL thread.
+   *
+   * @return one line per kernel and image size with its median time and throughput.
+   */
+  static native String runKernelBenchmark();
+
+  /**
+   * Plays back an MP4 dataset instead of the live camera and writes per-frame timings to a CSV
+   * file. Must be called before the first onResume. Returns false if the CSV file cannot be
+   * created.
+   */
+  static native boolean startPlaybackBenchmark(
+      long nativeApplication, String datasetUri, String csvPath);
+
+  /** Returns true once the playback benchmark reached the end of the dataset. */
+  static native boolean isPlaybackBenchmarkFinished(long nativeApplication);
+
+  /**
+   * Retrieves the text for the average edge detection time on the CPU and on the GPU.
+   *
+   * @param nativeApplication the native application handle.
+   */
+  static native String getEdgeDetectionTimingText(long nativeApplication);
+
   static native void setFocusMode(long nativeApplication, boolean isFixedFocus);
 
   static native boolean getFocusMode(long nativeApplication);
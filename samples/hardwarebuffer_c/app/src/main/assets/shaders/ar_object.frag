@@ -1,3 +1,4 @@
+#version 300 es
 /*
  * Copyright 2017 Google LLC
  *
@@ -16,11 +17,18 @@
 
 precision mediump float;
 
+// Per-frame values shared by all programs, see FrameUniforms.
+layout(std140) uniform FrameUniforms {
+  highp mat4 u_View[2];
+  highp mat4 u_Projection[2];
+  highp mat4 u_ViewProjection[2];
+  highp vec4 u_ColorCorrectionParameters;
+  highp vec4 u_ViewLightDirection[2];
+};
+
 uniform sampler2D u_Texture;
 
-uniform vec4 u_LightingParameters;
 uniform vec4 u_MaterialParameters;
-uniform vec4 u_ColorCorrectionParameters;
 
 #if USE_DEPTH_FOR_OCCLUSION
 uniform sampler2D u_DepthTexture;
@@ -28,18 +36,21 @@ uniform mat3 u_DepthUvTransform;
 uniform float u_DepthAspectRatio;
 #endif // USE_DEPTH_FOR_OCCLUSION
 
-varying vec3 v_ViewPosition;
-varying vec3 v_ViewNormal;
-varying vec2 v_TexCoord;
-varying vec3 v_ScreenSpacePosition;
+in vec3 v_ViewPosition;
+in vec3 v_ViewNormal;
+in vec2 v_TexCoord;
+in vec3 v_ScreenSpacePosition;
+flat in vec3 v_ViewLightDirection;
 uniform vec4 u_ObjColor;
 
+out vec4 o_FragColor;
+
 #if USE_DEPTH_FOR_OCCLUSION
 
 float DepthGetMillimeters(in sampler2D depth_texture, in vec2 depth_uv) {
   // Depth is packed into the red and green components of its texture.
   // The texture is a normalized format, storing millimeters.
-  vec3 packedDepthAndVisibility = texture2D(depth_texture, depth_uv).xyz;
+  vec3 packedDepthAndVisibility = texture(depth_texture, depth_uv).xyz;
   return dot(packedDepthAndVisibility.xy, vec2(255.0, 256.0 * 255.0));
 }
 
@@ -141,7 +152,7 @@ void main() {
     const float kMiddleGrayGamma = 0.466;
 
     // Unpack lighting and material parameters for better naming.
-    vec3 viewLightDirection = u_LightingParameters.xyz;
+    vec3 viewLightDirection = v_ViewLightDirection;
     vec3 colorShift = u_ColorCorrectionParameters.rgb;
     float averagePixelIntensity = u_ColorCorrectionParameters.a;
 
@@ -155,7 +166,7 @@ void main() {
     vec3 viewNormal = normalize(v_ViewNormal);
 
     // Flip the y-texture coordinate to address the texture from top-left.
-    vec4 objectColor = texture2D(u_Texture, vec2(v_TexCoord.x, 1.0 - v_TexCoord.y));
+    vec4 objectColor = texture(u_Texture, vec2(v_TexCoord.x, 1.0 - v_TexCoord.y));
 
     // Apply color to grayscale image only if the alpha of u_ObjColor is
     // greater and equal to 255.0.
@@ -185,8 +196,8 @@ void main() {
     color.rgb = pow(color, vec3(kGamma));
     // Apply average pixel intensity and color shift
     color *= colorShift * (averagePixelIntensity / kMiddleGrayGamma);
-    gl_FragColor.rgb = color;
-    gl_FragColor.a = objectColor.a;
+    o_FragColor.rgb = color;
+    o_FragColor.a = objectColor.a;
 
 #if USE_DEPTH_FOR_OCCLUSION
     const float kMetersToMillimeters = 1000.0;
@@ -196,7 +207,7 @@ void main() {
 
     // The following step is very costly. Replace the last line with the
     // commented line if it's too expensive.
-    // gl_FragColor *= DepthGetVisibility(u_DepthTexture, depth_uvs, asset_depth_mm);
-    gl_FragColor *= DepthGetBlurredVisibilityAroundUV(u_DepthTexture, depth_uvs, asset_depth_mm);
+    // o_FragColor *= DepthGetVisibility(u_DepthTexture, depth_uvs, asset_depth_mm);
+    o_FragColor *= DepthGetBlurredVisibilityAroundUV(u_DepthTexture, depth_uvs, asset_depth_mm);
 #endif // USE_DEPTH_FOR_OCCLUSION
 }
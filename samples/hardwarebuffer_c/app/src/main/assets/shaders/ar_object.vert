@@ -1,3 +1,4 @@
+#version 300 es
 /*
  * Copyright 2017 Google LLC
  *
@@ -14,22 +15,44 @@
  * limitations under the License.
  */
 
-uniform mat4 u_ModelView;
-uniform mat4 u_ModelViewProjection;
+#if STEREO
+#extension GL_OVR_multiview2 : require
+// Renders both eyes of a StereoTarget in one pass.
+layout(num_views = 2) in;
+#define VIEW_ID gl_ViewID_OVR
+#else
+#define VIEW_ID 0u
+#endif  // STEREO
 
-attribute vec4 a_Position;
-attribute vec3 a_Normal;
-attribute vec2 a_TexCoord;
+// Per-frame values shared by all programs, see FrameUniforms.
+layout(std140) uniform FrameUniforms {
+  highp mat4 u_View[2];
+  highp mat4 u_Projection[2];
+  highp mat4 u_ViewProjection[2];
+  highp vec4 u_ColorCorrectionParameters;
+  highp vec4 u_ViewLightDirection[2];
+};
 
-varying vec3 v_ViewPosition;
-varying vec3 v_ViewNormal;
-varying vec2 v_TexCoord;
-varying vec3 v_ScreenSpacePosition;
+uniform mat4 u_Model;
+
+in vec4 a_Position;
+in vec3 a_Normal;
+in vec2 a_TexCoord;
+
+out vec3 v_ViewPosition;
+out vec3 v_ViewNormal;
+out vec2 v_TexCoord;
+out vec3 v_ScreenSpacePosition;
+// Passed on since only the vertex shader knows the view.
+flat out vec3 v_ViewLightDirection;
 
 void main() {
-    v_ViewPosition = (u_ModelView * a_Position).xyz;
-    v_ViewNormal = normalize((u_ModelView * vec4(a_Normal, 0.0)).xyz);
+    vec4 view_position = u_View[VIEW_ID] * (u_Model * a_Position);
+    v_ViewPosition = view_position.xyz;
+    v_ViewNormal =
+        normalize(mat3(u_View[VIEW_ID]) * (mat3(u_Model) * a_Normal));
     v_TexCoord = a_TexCoord;
-    gl_Position = u_ModelViewProjection * a_Position;
+    v_ViewLightDirection = u_ViewLightDirection[VIEW_ID].xyz;
+    gl_Position = u_Projection[VIEW_ID] * view_position;
     v_ScreenSpacePosition = gl_Position.xyz / gl_Position.w;
 }
@@ -1,3 +1,4 @@
+#version 300 es
 /*
  * Copyright 2020 Google LLC
  *
@@ -19,7 +20,9 @@ precision mediump float;
 uniform sampler2D u_DepthTexture;
 uniform sampler2D u_ColorMap;
 
-varying vec2 v_TexCoord;
+in vec2 v_TexCoord;
+
+out vec4 o_FragColor;
 
 const float kMidDepthMeters = 8.0;
 const float kMaxDepthMeters = 30.0;
@@ -27,7 +30,7 @@ const float kMaxDepthMeters = 30.0;
 float DepthGetMillimeters(in sampler2D depth_texture, in vec2 depth_uv) {
   // Depth is packed into the red and green components of its texture.
   // The texture is a normalized format, storing millimeters.
-  vec3 packedDepthAndVisibility = texture2D(depth_texture, depth_uv).xyz;
+  vec3 packedDepthAndVisibility = texture(depth_texture, depth_uv).xyz;
   return dot(packedDepthAndVisibility.xy, vec2(255.0, 256.0 * 255.0));
 }
 
@@ -40,7 +43,7 @@ float InverseLerp(float value, float min_bound, float max_bound) {
 // Returns a color corresponding to the depth passed in.
 // The input x is normalized in range 0 to 1.
 vec3 DepthGetColorVisualization(in float x) {
-  return texture2D(u_ColorMap, vec2(x, 0.5)).rgb;
+  return texture(u_ColorMap, vec2(x, 0.5)).rgb;
 }
 
 void main() {
@@ -65,5 +68,5 @@ void main() {
 
   // Invalid depth (pixels with value 0) mapped to black.
   depth_color.rgb *= sign(depth_meters);
-  gl_FragColor = depth_color;
+  o_FragColor = depth_color;
 }
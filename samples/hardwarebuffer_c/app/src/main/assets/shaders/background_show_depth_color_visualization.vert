@@ -1,3 +1,4 @@
+#version 300 es
 /*
  * Copyright 2020 Google LLC
  *
@@ -14,10 +15,16 @@
  * limitations under the License.
  */
 
-attribute vec4 a_Position;
-attribute vec2 a_TexCoord;
+#if STEREO
+#extension GL_OVR_multiview2 : require
+// Duplicates the background into both eyes of a StereoTarget.
+layout(num_views = 2) in;
+#endif  // STEREO
 
-varying vec2 v_TexCoord;
+in vec4 a_Position;
+in vec2 a_TexCoord;
+
+out vec2 v_TexCoord;
 
 void main() {
    v_TexCoord = a_TexCoord;
@@ -1,3 +1,4 @@
+#version 300 es
 /*
  * Copyright 2018 Google LLC
  *
@@ -16,11 +17,13 @@
 
 precision highp float;
 precision highp int;
-uniform sampler2D texture;
-varying vec2 v_textureCoords;
-varying float v_alpha;
+uniform sampler2D u_Texture;
+in vec2 v_textureCoords;
+in float v_alpha;
+
+out vec4 o_FragColor;
 
 void main() {
-  float r = texture2D(texture, v_textureCoords).r;
-  gl_FragColor = vec4(r * v_alpha);
+  float r = texture(u_Texture, v_textureCoords).r;
+  o_FragColor = vec4(r * v_alpha);
 }
@@ -1,3 +1,4 @@
+#version 300 es
 /*
  * Copyright 2018 Google LLC
  *
@@ -13,14 +14,31 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
- 
+
+#if STEREO
+#extension GL_OVR_multiview2 : require
+// Renders both eyes of a StereoTarget in one pass.
+layout(num_views = 2) in;
+#define VIEW_ID gl_ViewID_OVR
+#else
+#define VIEW_ID 0u
+#endif  // STEREO
+
 precision highp float;
 precision highp int;
-attribute vec3 vertex;
-varying vec2 v_textureCoords;
-varying float v_alpha;
+in vec3 vertex;
+out vec2 v_textureCoords;
+out float v_alpha;
+
+// Per-frame values shared by all programs, see FrameUniforms.
+layout(std140) uniform FrameUniforms {
+  highp mat4 u_View[2];
+  highp mat4 u_Projection[2];
+  highp mat4 u_ViewProjection[2];
+  highp vec4 u_ColorCorrectionParameters;
+  highp vec4 u_ViewLightDirection[2];
+};
 
-uniform mat4 mvp;
 uniform mat4 model_mat;
 uniform vec3 normal;
 
@@ -29,8 +47,8 @@ void main() {
   v_alpha = vertex.z;
 
   vec4 local_pos = vec4(vertex.x, 0.0, vertex.y, 1.0);
-  gl_Position = mvp * local_pos;
   vec4 world_pos = model_mat * local_pos;
+  gl_Position = u_ViewProjection[VIEW_ID] * world_pos;
 
   // Construct two vectors that are orthogonal to the normal.
   // This arbitrary choice is not co-linear with either horizontal
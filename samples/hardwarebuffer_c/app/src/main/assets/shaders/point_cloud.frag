@@ -1,3 +1,4 @@
+#version 300 es
 /*
  * Copyright 2017 Google LLC
  *
@@ -15,8 +16,10 @@
  */
 
 precision mediump float;
-varying vec4 v_Color;
+in vec4 v_Color;
+
+out vec4 o_FragColor;
 
 void main() {
-    gl_FragColor = v_Color;
+    o_FragColor = v_Color;
 }
@@ -1,3 +1,4 @@
+#version 300 es
 /*
  * Copyright 2017 Google LLC
  *
@@ -14,16 +15,34 @@
  * limitations under the License.
  */
 
-uniform mat4 u_ModelViewProjection;
+#if STEREO
+#extension GL_OVR_multiview2 : require
+// Renders both eyes of a StereoTarget in one pass.
+layout(num_views = 2) in;
+#define VIEW_ID gl_ViewID_OVR
+#else
+#define VIEW_ID 0u
+#endif  // STEREO
+
+// Per-frame values shared by all programs, see FrameUniforms.
+layout(std140) uniform FrameUniforms {
+  highp mat4 u_View[2];
+  highp mat4 u_Projection[2];
+  highp mat4 u_ViewProjection[2];
+  highp vec4 u_ColorCorrectionParameters;
+  highp vec4 u_ViewLightDirection[2];
+};
+
 uniform vec4 u_Color;
 uniform float u_PointSize;
 
-attribute vec4 a_Position;
+in vec4 a_Position;
 
-varying vec4 v_Color;
+out vec4 v_Color;
 
 void main() {
    v_Color = u_Color;
-   gl_Position = u_ModelViewProjection * vec4(a_Position.xyz, 1.0);
+   // The points are given in world space.
+   gl_Position = u_ViewProjection[VIEW_ID] * vec4(a_Position.xyz, 1.0);
    gl_PointSize = u_PointSize;
 }
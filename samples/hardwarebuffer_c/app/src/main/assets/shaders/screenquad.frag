@@ -1,3 +1,4 @@
+#version 300 es
 /*
  * Copyright 2017 Google LLC
  *
@@ -13,13 +14,14 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
-#extension GL_OES_EGL_image_external : require
+#extension GL_OES_EGL_image_external_essl3 : require
 
 precision mediump float;
-varying vec2 v_TexCoord;
+in vec2 v_TexCoord;
 uniform samplerExternalOES sTexture;
 
+out vec4 o_FragColor;
 
 void main() {
-    gl_FragColor = texture2D(sTexture, v_TexCoord);
+    o_FragColor = texture(sTexture, v_TexCoord);
 }
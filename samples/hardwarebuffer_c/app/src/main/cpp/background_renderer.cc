@@ -19,6 +19,8 @@
 
 #include "background_renderer.h"
 
+#include <map>
+#include <string>
 #include <type_traits>
 
 #include "util.h"
@@ -39,20 +41,25 @@ constexpr char kDepthVisualizerFragmentShaderFilename[] =
     "shaders/background_show_depth_color_visualization.frag";
 constexpr char kDepthColorPaletteImageFilename[] =
     "models/depth_color_palette.png";
+constexpr char kStereoShaderFlag[] = "STEREO";
 
 }  // namespace
 
 void BackgroundRenderer::InitializeGlContent(AAssetManager* asset_manager,
-                                             int depth_texture_id) {
+                                             int depth_texture_id,
+                                             bool stereo) {
+  std::map<std::string, int> define_values_map;
+  define_values_map[kStereoShaderFlag] = stereo ? 1 : 0;
+
   // Defines the default background, which is the color camera image.
   glGenTextures(1, &camera_texture_id_);
   glBindTexture(GL_TEXTURE_EXTERNAL_OES, camera_texture_id_);
   glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
   glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-  camera_program_ =
-      util::CreateProgram(kCameraVertexShaderFilename,
-                          kCameraFragmentShaderFilename, asset_manager);
+  camera_program_ = util::CreateProgram(
+      kCameraVertexShaderFilename, kCameraFragmentShaderFilename,
+      asset_manager, define_values_map);
   if (!camera_program_) {
     LOGE("Could not create program.");
   }
@@ -76,7 +83,7 @@ void BackgroundRenderer::InitializeGlContent(AAssetManager* asset_manager,
   // Defines the depth visualization background, which shows the current depth.
   depth_program_ = util::CreateProgram(kDepthVisualizerVertexShaderFilename,
                                        kDepthVisualizerFragmentShaderFilename,
-                                       asset_manager);
+                                       asset_manager, define_values_map);
   if (!depth_program_) {
     LOGE("Could not create program.");
   }
@@ -35,8 +35,10 @@ class BackgroundRenderer {
   ~BackgroundRenderer() = default;
 
   // Sets up OpenGL state.  Must be called on the OpenGL thread and before any
-  // other methods below.
-  void InitializeGlContent(AAssetManager* asset_manager, int depthTextureId);
+  // other methods below.  |stereo| builds the programs for drawing into a
+  // StereoTarget, which shows the same background in both eyes.
+  void InitializeGlContent(AAssetManager* asset_manager, int depthTextureId,
+                           bool stereo);
 
   // Draws the background image.  This methods must be called for every ArFrame
   // returned by ArSession_update() to catch display geometry change events.
@@ -0,0 +1,247 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "camera_frame_pins.h"
+
+#include <algorithm>
+
+#include "util.h"
+
+namespace hello_ar {
+namespace {
+// Upper bound for a single fence wait, so a lost GPU context cannot hang the
+// render thread.
+constexpr EGLTimeKHR kFenceTimeoutNs = 100000000;  // 100 ms.
+
+constexpr uint32_t kAllStages = (1u << CameraFramePins::kStageCount) - 1;
+}  // namespace
+
+constexpr int CameraFramePins::kMaxBudget;
+constexpr int CameraFramePins::kNoPin;
+
+CameraFramePins::CameraFramePins(int budget)
+    : budget_(std::min(std::max(budget, 1), kMaxBudget)) {
+  for (PinState& state : pins_) {
+    state.fences.fill(EGL_NO_SYNC_KHR);
+  }
+}
+
+CameraFramePins::~CameraFramePins() { Clear(); }
+
+int CameraFramePins::Pin(ArSession* session, ArFrame* frame,
+                         AHardwareBuffer* buffer, uint32_t stage_mask,
+                         bool with_cpu_image) {
+  stage_mask &= kAllStages;
+  if (buffer == nullptr || stage_mask == 0) {
+    return kNoPin;
+  }
+  Collect();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  int free_pin = kNoPin;
+  int pinned_count = 0;
+  for (int i = 0; i < kMaxBudget; ++i) {
+    if (pins_[i].in_use) {
+      ++pinned_count;
+    } else if (free_pin == kNoPin) {
+      free_pin = i;
+    }
+  }
+  if (pinned_count >= budget_ || free_pin == kNoPin) {
+    return kNoPin;
+  }
+
+  PinState& state = pins_[free_pin];
+  if (with_cpu_image &&
+      ArFrame_acquireCameraImage(session, frame, &state.image) != AR_SUCCESS) {
+    state.image = nullptr;
+    return kNoPin;
+  }
+  AHardwareBuffer_acquire(buffer);
+  state.buffer = buffer;
+  ArFrame_getTimestamp(session, frame, &state.timestamp_ns);
+  state.stage_mask = stage_mask;
+  state.in_use = true;
+  return free_pin;
+}
+
+void CameraFramePins::Release(int pin, Stage stage) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    PinState& state = pins_[pin];
+    const uint32_t bit = 1u << stage;
+    if (!state.in_use || (state.stage_mask & bit) == 0 ||
+        state.fences[stage] != EGL_NO_SYNC_KHR) {
+      LOGE("CameraFramePins: stage %d does not hold pin %d", stage, pin);
+      return;
+    }
+    state.stage_mask &= ~bit;
+  }
+  released_.notify_all();
+}
+
+void CameraFramePins::ReleaseAfterGpu(int pin, Stage stage) {
+  if (display_ == EGL_NO_DISPLAY) {
+    display_ = eglGetCurrentDisplay();
+  }
+  const EGLSyncKHR fence =
+      eglCreateSyncKHR(display_, EGL_SYNC_FENCE_KHR, nullptr);
+  if (fence == EGL_NO_SYNC_KHR) {
+    // Without a fence only finishing the GPU work keeps the buffer safe.
+    glFinish();
+    Release(pin, stage);
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  PinState& state = pins_[pin];
+  if (!state.in_use || (state.stage_mask & (1u << stage)) == 0 ||
+      state.fences[stage] != EGL_NO_SYNC_KHR) {
+    LOGE("CameraFramePins: stage %d does not hold pin %d", stage, pin);
+    eglDestroySyncKHR(display_, fence);
+    return;
+  }
+  state.fences[stage] = fence;
+}
+
+void CameraFramePins::CollectFences(PinState* state, bool wait) {
+  for (int stage = 0; stage < kStageCount; ++stage) {
+    EGLSyncKHR& fence = state->fences[stage];
+    if (fence == EGL_NO_SYNC_KHR) {
+      continue;
+    }
+    if (wait) {
+      eglClientWaitSyncKHR(display_, fence, EGL_SYNC_FLUSH_COMMANDS_BIT_KHR,
+                           kFenceTimeoutNs);
+    }
+    EGLint status = EGL_UNSIGNALED_KHR;
+    eglGetSyncAttribKHR(display_, fence, EGL_SYNC_STATUS_KHR, &status);
+    if (status != EGL_SIGNALED_KHR) {
+      continue;
+    }
+    eglDestroySyncKHR(display_, fence);
+    fence = EGL_NO_SYNC_KHR;
+    state->stage_mask &= ~(1u << stage);
+  }
+}
+
+void CameraFramePins::Collect() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (PinState& state : pins_) {
+    if (!state.in_use) {
+      continue;
+    }
+    CollectFences(&state, /*wait=*/false);
+    if (state.stage_mask == 0) {
+      Free(&state);
+    }
+  }
+}
+
+bool CameraFramePins::WaitForFreePin(std::chrono::nanoseconds timeout) {
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+  bool throttled = false;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    int pinned_count = 0;
+    PinState* oldest_fenced = nullptr;
+    for (PinState& state : pins_) {
+      if (!state.in_use) {
+        continue;
+      }
+      CollectFences(&state, /*wait=*/false);
+      if (state.stage_mask == 0) {
+        Free(&state);
+        continue;
+      }
+      ++pinned_count;
+      const bool fenced = std::any_of(
+          state.fences.begin(), state.fences.end(),
+          [](EGLSyncKHR fence) { return fence != EGL_NO_SYNC_KHR; });
+      if (fenced && (oldest_fenced == nullptr ||
+                     state.timestamp_ns < oldest_fenced->timestamp_ns)) {
+        oldest_fenced = &state;
+      }
+    }
+    if (pinned_count < budget_) {
+      return true;
+    }
+    if (!throttled) {
+      throttled = true;
+      ++throttled_frames_;
+    }
+    if (std::chrono::steady_clock::now() >= deadline) {
+      LOGE("CameraFramePins: no pin freed within the timeout");
+      return false;
+    }
+
+    if (oldest_fenced != nullptr) {
+      // The GPU is the slowest stage.  Only this thread destroys fences, so
+      // they stay valid while other stages release with the mutex unlocked.
+      std::array<EGLSyncKHR, kStageCount> fences = oldest_fenced->fences;
+      lock.unlock();
+      for (EGLSyncKHR fence : fences) {
+        if (fence != EGL_NO_SYNC_KHR) {
+          eglClientWaitSyncKHR(display_, fence,
+                               EGL_SYNC_FLUSH_COMMANDS_BIT_KHR,
+                               kFenceTimeoutNs);
+        }
+      }
+      lock.lock();
+    } else {
+      released_.wait_until(lock, deadline);
+    }
+  }
+}
+
+void CameraFramePins::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (PinState& state : pins_) {
+    if (!state.in_use) {
+      continue;
+    }
+    CollectFences(&state, /*wait=*/true);
+    if (state.stage_mask != 0) {
+      LOGE("CameraFramePins: clearing a pin still held by stages 0x%x",
+           state.stage_mask);
+    }
+    Free(&state);
+  }
+}
+
+int CameraFramePins::GetPinnedCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return static_cast<int>(
+      std::count_if(pins_.begin(), pins_.end(),
+                    [](const PinState& state) { return state.in_use; }));
+}
+
+void CameraFramePins::Free(PinState* state) {
+  for (EGLSyncKHR& fence : state->fences) {
+    if (fence != EGL_NO_SYNC_KHR) {
+      eglDestroySyncKHR(display_, fence);
+      fence = EGL_NO_SYNC_KHR;
+    }
+  }
+  if (state->image != nullptr) {
+    ArImage_release(state->image);
+  }
+  AHardwareBuffer_release(state->buffer);
+  *state = PinState();
+  state->fences.fill(EGL_NO_SYNC_KHR);
+}
+
+}  // namespace hello_ar
@@ -0,0 +1,136 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_CAMERA_FRAME_PINS_H_
+#define C_ARCORE_HELLOE_AR_CAMERA_FRAME_PINS_H_
+
+#define EGL_EGLEXT_PROTOTYPES
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <android/hardware_buffer.h>
+
+#include <array>
+#include <chrono>
+#include <condition_variable>  // NOLINT
+#include <cstdint>
+#include <mutex>  // NOLINT
+
+#include "arcore_c_api.h"
+
+namespace hello_ar {
+
+// Keeps the camera buffer of a frame, and optionally its CPU image, alive
+// for the stages that consume it after ArSession_update() moved on, so that
+// every stage reads the same frame without copying it.
+//
+// A pin holds one reference per stage it was created for.  A stage drops
+// its reference with Release() when it is done on the CPU, from any thread,
+// or with ReleaseAfterGpu() once the GL commands it issued so far are done.
+// The buffer and image go back to ARCore when the last reference is gone.
+//
+// ARCore cycles through a small set of camera buffers and ArImages, so only
+// |budget| frames can be pinned at once.  WaitForFreePin() before
+// ArSession_update() keeps the session from running further ahead of the
+// slowest stage than that.
+//
+// Pin(), ReleaseAfterGpu(), Collect() and WaitForFreePin() must be called on
+// the OpenGL thread.
+class CameraFramePins {
+ public:
+  enum Stage {
+    kGpuBackground = 0,
+    kCpuKernels,
+    kEncoder,
+    kMlStaging,
+    kStageCount,
+  };
+  static constexpr int kMaxBudget = 6;
+  static constexpr int kNoPin = -1;
+
+  // |budget| is clamped to [1, kMaxBudget].
+  explicit CameraFramePins(int budget);
+  ~CameraFramePins();
+
+  CameraFramePins(const CameraFramePins&) = delete;
+  CameraFramePins& operator=(const CameraFramePins&) = delete;
+
+  // Pins |buffer|, the camera buffer of |frame|, for the stages in the
+  // |stage_mask| bits, and acquires its CPU image if |with_cpu_image|.
+  // Returns the pin, or kNoPin if the budget is used up or the image is not
+  // available.
+  int Pin(ArSession* session, ArFrame* frame, AHardwareBuffer* buffer,
+          uint32_t stage_mask, bool with_cpu_image);
+
+  // What a pin holds.  Valid until its last reference is released.
+  AHardwareBuffer* GetBuffer(int pin) const { return pins_[pin].buffer; }
+  const ArImage* GetImage(int pin) const { return pins_[pin].image; }
+  int64_t GetTimestamp(int pin) const { return pins_[pin].timestamp_ns; }
+
+  // Drops the reference of |stage|.  Thread safe.
+  void Release(int pin, Stage stage);
+
+  // Drops the reference of |stage| once the GPU finished the commands issued
+  // so far, e.g. right after the pass sampling the buffer.
+  void ReleaseAfterGpu(int pin, Stage stage);
+
+  // Drops the references whose fences signaled and hands the pins without
+  // references back to ARCore, without blocking.
+  void Collect();
+
+  // Blocks until fewer than |budget| frames are pinned, or |timeout|
+  // passed.  Returns false on timeout.
+  bool WaitForFreePin(std::chrono::nanoseconds timeout);
+
+  // Waits for all fences and hands every pin back to ARCore, whatever
+  // stages still hold it.  Must be called before the session is destroyed.
+  void Clear();
+
+  int GetPinnedCount() const;
+
+  // Frames WaitForFreePin() had to wait for, i.e. a stage held back the
+  // session.
+  int64_t GetThrottledFrames() const { return throttled_frames_; }
+
+ private:
+  struct PinState {
+    AHardwareBuffer* buffer = nullptr;
+    ArImage* image = nullptr;
+    int64_t timestamp_ns = 0;
+    // Stages holding a reference, including those waiting for a fence.
+    uint32_t stage_mask = 0;
+    std::array<EGLSyncKHR, kStageCount> fences;
+    bool in_use = false;
+  };
+
+  // Drops the stage bits of the signaled fences of |state|.  With |wait|,
+  // blocks until they signal first.  Called with mutex_ held.
+  void CollectFences(PinState* state, bool wait);
+  // Returns the buffer and image of |state| to ARCore.
+  void Free(PinState* state);
+
+  const int budget_;
+  EGLDisplay display_ = EGL_NO_DISPLAY;
+  std::array<PinState, kMaxBudget> pins_;
+  mutable std::mutex mutex_;
+  // Notified when a stage releases a pin on the CPU.
+  std::condition_variable released_;
+  int64_t throttled_frames_ = 0;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_CAMERA_FRAME_PINS_H_
@@ -0,0 +1,131 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_EGL_IMAGE_CACHE_H_
+#define C_ARCORE_HELLOE_AR_EGL_IMAGE_CACHE_H_
+
+#define EGL_EGLEXT_PROTOTYPES
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#include <android/hardware_buffer.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace hello_ar {
+
+// Keeps one EGLImage per camera AHardwareBuffer.
+//
+// ARCore cycles through a small fixed set of hardware buffers, so after the
+// first few frames every buffer already has an image and no EGL objects are
+// created or destroyed per frame.  Buffers are identified by pointer; each
+// cached buffer holds a reference, so a pointer cannot be reused for another
+// buffer while it is in the cache.  The least recently used image is evicted
+// once kCapacity buffers are cached.
+//
+// With EGL_ANDROID_native_fence_sync, a fence is inserted after every pass
+// that samples the camera texture.  A buffer is only released back, by
+// destroying its image and dropping its reference, once its fence signaled,
+// so no implicit driver synchronization is needed for it.
+class EglImageCache {
+ public:
+  static constexpr size_t kCapacity = 8;
+
+  struct FenceStats {
+    // Fences inserted by InsertReleaseFence().
+    int64_t fences_inserted = 0;
+    // Times a new camera buffer was bound while the GPU was still sampling the
+    // previous one, i.e. the two frames overlapped on the GPU.
+    int64_t overlapped_binds = 0;
+    // Times a buffer had to be waited for before it could be released, and
+    // the total CPU time spent blocked on those waits.
+    int64_t blocking_waits = 0;
+    std::chrono::nanoseconds gpu_wait_time = std::chrono::nanoseconds::zero();
+  };
+
+  EglImageCache() = default;
+  ~EglImageCache();
+
+  EglImageCache(const EglImageCache&) = delete;
+  EglImageCache& operator=(const EglImageCache&) = delete;
+
+  // Binds the image of |buffer| to the GL_TEXTURE_EXTERNAL_OES texture
+  // |texture_id|, creating the image on first use.  Nothing is rebound while
+  // the same buffer stays bound to the same texture.  Must be called on the
+  // OpenGL thread.  Returns false if no image could be created.
+  bool BindToTexture(AHardwareBuffer* buffer, GLuint texture_id);
+
+  // Asks for all images to be dropped before the next BindToTexture(), e.g.
+  // when the camera configuration changed.  May be called from any thread.
+  void RequestFlush() { flush_requested_ = true; }
+
+  // Destroys all images and releases the cached buffers.  Must be called on
+  // the OpenGL thread, e.g. when a new context was created.
+  void Flush();
+
+  // Inserts a native fence after the commands sampling the currently bound
+  // buffer, e.g. right after the background pass.  Does nothing if the
+  // extension is not supported.  Must be called on the OpenGL thread.
+  void InsertReleaseFence();
+
+  const FenceStats& GetFenceStats() const { return fence_stats_; }
+
+ private:
+  struct Entry {
+    AHardwareBuffer* buffer;
+    EGLImageKHR image;
+    uint64_t last_used;
+    // Signals when the GPU finished the last pass sampling the buffer.
+    EGLSyncKHR release_fence;
+  };
+
+  // Returns the cached entry of |buffer|, creating it and evicting the least
+  // recently used entry if needed.  Returns null on failure.
+  Entry* GetEntry(AHardwareBuffer* buffer);
+
+  // Returns the entry of |buffer| if it is cached.
+  Entry* FindEntry(AHardwareBuffer* buffer);
+
+  // Waits for the release fence of |entry|, then destroys its image and drops
+  // the buffer reference.
+  void ReleaseEntry(Entry* entry);
+
+  // Returns true if the fence of |entry| has not signaled yet.
+  bool IsFencePending(const Entry& entry) const;
+
+  // Initializes display_ and whether native fences can be used.
+  void InitializeDisplay();
+
+  std::vector<Entry> entries_;
+  EGLDisplay display_ = EGL_NO_DISPLAY;
+  bool supports_native_fences_ = false;
+  uint64_t use_count_ = 0;
+  FenceStats fence_stats_;
+
+  // Currently attached to bound_texture_, if any.
+  AHardwareBuffer* bound_buffer_ = nullptr;
+  GLuint bound_texture_ = 0;
+
+  std::atomic<bool> flush_requested_{false};
+};
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_EGL_IMAGE_CACHE_H_
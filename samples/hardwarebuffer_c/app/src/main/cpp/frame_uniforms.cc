@@ -0,0 +1,88 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "frame_uniforms.h"
+
+#include "util.h"
+
+namespace hello_ar {
+namespace {
+constexpr char kBlockName[] = "FrameUniforms";
+constexpr GLuint kBindingPoint = 0;
+// Direction towards the light in world space, straight up.
+const glm::vec4 kLightDirection(0.0f, 1.0f, 0.0f, 0.0f);
+}  // namespace
+
+constexpr int FrameUniforms::kMaxViewCount;
+
+void FrameUniforms::InitializeGlContent() {
+  static_assert(sizeof(Data) == kMaxViewCount * (3 * sizeof(glm::mat4) +
+                                                 sizeof(glm::vec4)) +
+                                    sizeof(glm::vec4),
+                "Data must match the std140 layout of the block");
+  glGenBuffers(1, &buffer_);
+  glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+  glBufferData(GL_UNIFORM_BUFFER, sizeof(Data), nullptr, GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  util::CheckGlError("FrameUniforms::InitializeGlContent()");
+}
+
+void FrameUniforms::Update(const glm::mat4& view_mat,
+                           const glm::mat4& projection_mat,
+                           const float* color_correction4) {
+  Upload(&view_mat, 1, projection_mat, color_correction4);
+}
+
+void FrameUniforms::UpdateStereo(const glm::mat4& left_view_mat,
+                                 const glm::mat4& right_view_mat,
+                                 const glm::mat4& projection_mat,
+                                 const float* color_correction4) {
+  const glm::mat4 view_mats[kMaxViewCount] = {left_view_mat, right_view_mat};
+  Upload(view_mats, kMaxViewCount, projection_mat, color_correction4);
+}
+
+void FrameUniforms::Upload(const glm::mat4* view_mats, int view_count,
+                           const glm::mat4& projection_mat,
+                           const float* color_correction4) {
+  Data data;
+  for (int i = 0; i < view_count; ++i) {
+    data.view_mat[i] = view_mats[i];
+    data.projection_mat[i] = projection_mat;
+    data.view_projection_mat[i] =
+        util::MultiplyMatrices(projection_mat, view_mats[i]);
+    data.view_light_direction[i] =
+        util::NormalizeVector(view_mats[i] * kLightDirection);
+  }
+  data.color_correction = glm::make_vec4(color_correction4);
+
+  // Orphans the previous contents so the upload does not wait for the draws
+  // of the last frame.
+  glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+  glBufferData(GL_UNIFORM_BUFFER, sizeof(Data), &data, GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  glBindBufferBase(GL_UNIFORM_BUFFER, kBindingPoint, buffer_);
+  util::CheckGlError("FrameUniforms::Upload()");
+}
+
+void FrameUniforms::BindToProgram(GLuint program) {
+  const GLuint block_index = glGetUniformBlockIndex(program, kBlockName);
+  if (block_index == GL_INVALID_INDEX) {
+    return;
+  }
+  glUniformBlockBinding(program, block_index, kBindingPoint);
+}
+
+}  // namespace hello_ar
@@ -0,0 +1,96 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_FRAME_UNIFORMS_H_
+#define C_ARCORE_HELLOE_AR_FRAME_UNIFORMS_H_
+
+#include <GLES3/gl3.h>
+
+#include "glm.h"
+
+namespace hello_ar {
+
+// Uniform buffer with the camera and lighting values that every draw of a
+// frame shares.  It is written once per frame and read by all programs that
+// declare the FrameUniforms block, so per-draw uniforms shrink to the values
+// that differ between objects, e.g. the model matrix.
+//
+// The view dependent values are stored once per eye, so a stereo program
+// rendering both eyes in one pass indexes them with gl_ViewID_OVR.  Mono
+// frames only use the first element.  The block must be declared identically
+// in every shader using it:
+//
+//   layout(std140) uniform FrameUniforms {
+//     highp mat4 u_View[2];
+//     highp mat4 u_Projection[2];
+//     highp mat4 u_ViewProjection[2];
+//     highp vec4 u_ColorCorrectionParameters;
+//     highp vec4 u_ViewLightDirection[2];
+//   };
+class FrameUniforms {
+ public:
+  // Number of views the block holds values for.
+  static constexpr int kMaxViewCount = 2;
+
+  FrameUniforms() = default;
+  ~FrameUniforms() = default;
+
+  FrameUniforms(const FrameUniforms&) = delete;
+  FrameUniforms& operator=(const FrameUniforms&) = delete;
+
+  // Creates the buffer.  Must be called on the OpenGL thread prior to any
+  // other calls.
+  void InitializeGlContent();
+
+  // Writes the values of this frame and binds the buffer to the block's
+  // binding point.  |color_correction4| is the color correction of the light
+  // estimate.
+  void Update(const glm::mat4& view_mat, const glm::mat4& projection_mat,
+              const float* color_correction4);
+
+  // Same as Update(), but with one view matrix per eye for stereo programs.
+  // Both eyes share |projection_mat|.
+  void UpdateStereo(const glm::mat4& left_view_mat,
+                    const glm::mat4& right_view_mat,
+                    const glm::mat4& projection_mat,
+                    const float* color_correction4);
+
+  // Connects the FrameUniforms block of |program| to the buffer, if the
+  // program declares it.  Needs to be called whenever a program is linked.
+  static void BindToProgram(GLuint program);
+
+ private:
+  // std140 layout of the block: only 16 byte aligned members, so the
+  // structure has no padding.
+  struct Data {
+    glm::mat4 view_mat[kMaxViewCount];
+    glm::mat4 projection_mat[kMaxViewCount];
+    glm::mat4 view_projection_mat[kMaxViewCount];
+    glm::vec4 color_correction;
+    // Direction towards the light in view space.
+    glm::vec4 view_light_direction[kMaxViewCount];
+  };
+
+  // Writes |view_count| views, the remaining ones are left unset.
+  void Upload(const glm::mat4* view_mats, int view_count,
+              const glm::mat4& projection_mat, const float* color_correction4);
+
+  GLuint buffer_ = 0;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_FRAME_UNIFORMS_H_
@@ -26,6 +26,8 @@
 #include <android/asset_manager.h>
 
 #include <array>
+#include <chrono>
+#include <cmath>
 #include <cstdint>
 
 #include "arcore_c_api.h"
@@ -35,14 +37,11 @@
 namespace hello_ar {
 namespace {
 
-// Load hardware buffer symbols at runtime.
-using PFeglGetNativeClientBufferANDROID =
-    EGLClientBuffer (*)(const AHardwareBuffer* buffer);
-
-PFeglGetNativeClientBufferANDROID eglGetNativeClientBufferANDROID = nullptr;
-
 constexpr size_t kMaxNumberOfAndroidsToRender = 20;
 
+// Number of frames between two logs of the camera buffer fence counters.
+constexpr int kFenceStatsLogInterval = 300;
+
 const glm::vec3 kWhite = {255, 255, 255};
 
 // Assumed distance from the device camera to the surface on which user will
@@ -56,6 +55,21 @@ const glm::vec3 kWhite = {255, 255, 255};
 // in front of them.
 constexpr float kApproximateDistanceMeters = 1.0f;
 
+// Renders the scene side by side for both eyes, e.g. for a phone in a
+// headset viewer, in one pass with GL_OVR_multiview2.  The camera image is
+// shown to both eyes; the virtual content is seen from two cameras
+// kInterpupillaryDistanceMeters apart.  Falls back to mono rendering where
+// the extension is not available.
+constexpr bool kUseStereoRendering = false;
+constexpr float kInterpupillaryDistanceMeters = 0.064f;
+
+// Camera frames that may be pinned at once.  Stays below the number of
+// buffers ARCore cycles through, so ArSession_update() always has one to
+// write the next frame into.
+constexpr int kCameraFramePinBudget = 3;
+// Bound for waiting on a pinned frame before updating the session anyway.
+constexpr std::chrono::milliseconds kCameraFramePinTimeout(100);
+
 void SetColor(float r, float g, float b, float a, float* color4f) {
   color4f[0] = r;
   color4f[1] = g;
@@ -66,9 +80,12 @@ void SetColor(float r, float g, float b, float a, float* color4f) {
 }  // namespace
 
 HelloArApplication::HelloArApplication(AAssetManager* asset_manager)
-    : asset_manager_(asset_manager) {}
+    : asset_manager_(asset_manager),
+      camera_frame_pins_(kCameraFramePinBudget) {}
 
 HelloArApplication::~HelloArApplication() {
+  // The pinned buffers and images belong to the session.
+  camera_frame_pins_.Clear();
   if (ar_session_ != nullptr) {
     ArSession_destroy(ar_session_);
     ArFrame_destroy(ar_frame_);
@@ -80,6 +97,9 @@ void HelloArApplication::OnPause() {
   if (ar_session_ != nullptr) {
     ArSession_pause(ar_session_);
   }
+  // The camera may come back with a different configuration and therefore a
+  // different set of buffers.
+  egl_image_cache_.RequestFlush();
 }
 
 void HelloArApplication::OnResume(JNIEnv* env, void* context, void* activity) {
@@ -119,37 +139,53 @@ void HelloArApplication::OnResume(JNIEnv* env, void* context, void* activity) {
     ConfigureSession();
     ArFrame_create(ar_session_, &ar_frame_);
 
-    ArSession_setDisplayGeometry(ar_session_, display_rotation_, width_,
-                                 height_);
+    if (!benchmark_dataset_uri_.empty()) {
+      // The dataset can only be set while the session has not been resumed.
+      CHECKANDTHROW(ArSession_setPlaybackDatasetUri(
+                        ar_session_, benchmark_dataset_uri_.c_str()) ==
+                        AR_SUCCESS,
+                    env, "Failed to set the playback benchmark dataset.");
+    }
+
+    ArSession_setDisplayGeometry(ar_session_, display_rotation_,
+                                 GetViewWidth(), height_);
   }
 
   const ArStatus status = ArSession_resume(ar_session_);
   CHECKANDTHROW(status == AR_SUCCESS, env, "Failed to resume AR session.");
-
-  if (eglGetNativeClientBufferANDROID == nullptr) {
-    eglGetNativeClientBufferANDROID =
-        reinterpret_cast<PFeglGetNativeClientBufferANDROID>(
-            eglGetProcAddress("eglGetNativeClientBufferANDROID"));
-    if (eglGetNativeClientBufferANDROID == nullptr) {
-      LOGE("eglGetNativeClientBufferANDROID symbol does not exist.");
-      return;
-    }
-  }
 }
 
 void HelloArApplication::OnSurfaceCreated() {
   LOGI("OnSurfaceCreated()");
 
+  // Images bound to textures of the previous context are not reused.
+  egl_image_cache_.Flush();
+  camera_frame_pins_.Clear();
+
+  if (playback_benchmark_.IsOpen()) {
+    // Frames are timed as fast as they can be drawn, not at display rate.
+    eglSwapInterval(eglGetCurrentDisplay(), 0);
+  }
+
+  use_stereo_ = kUseStereoRendering && StereoTarget::IsSupported();
+  if (kUseStereoRendering && !use_stereo_) {
+    LOGE("GL_OVR_multiview2 is not supported, rendering in mono.");
+  }
+  if (use_stereo_) {
+    stereo_target_.InitializeGlContent();
+  }
+
   depth_texture_.CreateOnGlThread();
-  background_renderer_.InitializeGlContent(asset_manager_,
-                                           depth_texture_.GetTextureId());
-  point_cloud_renderer_.InitializeGlContent(asset_manager_);
+  frame_uniforms_.InitializeGlContent();
+  background_renderer_.InitializeGlContent(
+      asset_manager_, depth_texture_.GetTextureId(), use_stereo_);
+  point_cloud_renderer_.InitializeGlContent(asset_manager_, use_stereo_);
   andy_renderer_.InitializeGlContent(asset_manager_, "models/andy.obj",
-                                     "models/andy.png");
+                                     "models/andy.png", use_stereo_);
   andy_renderer_.SetDepthTexture(depth_texture_.GetTextureId(),
                                  depth_texture_.GetWidth(),
                                  depth_texture_.GetHeight());
-  plane_renderer_.InitializeGlContent(asset_manager_);
+  plane_renderer_.InitializeGlContent(asset_manager_, use_stereo_);
 }
 
 void HelloArApplication::OnDisplayGeometryChanged(int display_rotation,
@@ -159,13 +195,70 @@ void HelloArApplication::OnDisplayGeometryChanged(int display_rotation,
   display_rotation_ = display_rotation;
   width_ = width;
   height_ = height;
+  // In stereo ARCore renders for one eye, and the camera image is fitted to
+  // it.
+  if (use_stereo_) {
+    stereo_target_.Resize(GetViewWidth(), height);
+  }
   if (ar_session_ != nullptr) {
-    ArSession_setDisplayGeometry(ar_session_, display_rotation, width, height);
+    ArSession_setDisplayGeometry(ar_session_, display_rotation,
+                                 GetViewWidth(), height);
+  }
+}
+
+bool HelloArApplication::StartPlaybackBenchmark(const std::string& dataset_uri,
+                                                const std::string& csv_path) {
+  if (!playback_benchmark_.Open(csv_path)) {
+    return false;
   }
+  LOGI("Playback benchmark of %s into %s", dataset_uri.c_str(),
+       csv_path.c_str());
+  benchmark_dataset_uri_ = dataset_uri;
+  benchmark_finished_ = false;
+  return true;
 }
 
 void HelloArApplication::OnDrawFrame(bool depthColorVisualizationEnabled,
                                      bool useDepthForOcclusion) {
+  const auto frame_start = std::chrono::steady_clock::now();
+  if (!use_stereo_) {
+    DrawScene(depthColorVisualizationEnabled, useDepthForOcclusion);
+  } else {
+    stereo_target_.Bind();
+    DrawScene(depthColorVisualizationEnabled, useDepthForOcclusion);
+    stereo_target_.Present();
+  }
+  if (playback_benchmark_.IsOpen()) {
+    // Waits for the GPU so the frame time includes the draw calls' execution,
+    // which would otherwise be hidden by the missing vsync throttling.
+    glFinish();
+    RecordBenchmarkFrame(std::chrono::steady_clock::now() - frame_start);
+  }
+}
+
+void HelloArApplication::RecordBenchmarkFrame(
+    std::chrono::nanoseconds frame_time) {
+  if (ar_session_ == nullptr) {
+    return;
+  }
+  int64_t timestamp_ns = 0;
+  ArFrame_getTimestamp(ar_session_, ar_frame_, &timestamp_ns);
+  playback_benchmark_.RecordFrame(timestamp_ns, frame_time);
+
+  ArPlaybackStatus playback_status = AR_PLAYBACK_NONE;
+  ArSession_getPlaybackStatus(ar_session_, &playback_status);
+  if (playback_status == AR_PLAYBACK_FINISHED ||
+      playback_status == AR_PLAYBACK_IO_ERROR) {
+    if (playback_status == AR_PLAYBACK_IO_ERROR) {
+      LOGE("Playback benchmark stopped by a dataset read error");
+    }
+    playback_benchmark_.Finish();
+    benchmark_finished_ = true;
+  }
+}
+
+void HelloArApplication::DrawScene(bool depthColorVisualizationEnabled,
+                                   bool useDepthForOcclusion) {
   // Render the scene.
   glClearColor(0.9f, 0.9f, 0.9f, 1.0f);
   glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
@@ -175,6 +268,9 @@ void HelloArApplication::OnDrawFrame(bool depthColorVisualizationEnabled,
 
   if (ar_session_ == nullptr) return;
 
+  // Do not let the session overwrite a frame a stage is still reading.
+  camera_frame_pins_.WaitForFreePin(kCameraFramePinTimeout);
+
   // Update session to get current frame and render camera background.
   if (ArSession_update(ar_session_, ar_frame_) != AR_SUCCESS) {
     LOGE("HelloArApplication::OnDrawFrame ArSession_update error");
@@ -183,35 +279,16 @@ void HelloArApplication::OnDrawFrame(bool depthColorVisualizationEnabled,
   void* native_hardware_buffer = nullptr;
   ArFrame_getHardwareBuffer(ar_session_, ar_frame_, &native_hardware_buffer);
 
-  if (eglGetNativeClientBufferANDROID == nullptr) {
-    LOGE("eglGetNativeClientBufferANDROID symbol does not exist.");
+  // Only rebinds the texture when ARCore moved on to another buffer.
+  if (!egl_image_cache_.BindToTexture(
+          reinterpret_cast<AHardwareBuffer*>(native_hardware_buffer),
+          background_renderer_.GetTextureId())) {
     return;
   }
-
-  EGLClientBuffer egl_client_buffer = eglGetNativeClientBufferANDROID(
-      reinterpret_cast<const AHardwareBuffer*>(native_hardware_buffer));
-
-  EGLint attr[] = {EGL_IMAGE_PRESERVED_KHR, EGL_TRUE, EGL_NONE};
-  EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
-  if (egl_image_ != nullptr && egl_image_ != EGL_NO_IMAGE) {
-    eglDestroyImageKHR(display, egl_image_);
-  }
-
-  egl_image_ =
-      eglCreateImageKHR(display, EGL_NO_CONTEXT, EGL_NATIVE_BUFFER_ANDROID,
-                        egl_client_buffer, attr);
-  if (egl_image_ == EGL_NO_IMAGE) {
-    LOGE("Failed to create egl image ");
-    return;
-  }
-
-  uint32_t texture_oes_id = background_renderer_.GetTextureId();
-  glBindTexture(GL_TEXTURE_EXTERNAL_OES, texture_oes_id);
-  util::CheckGlError("glBindTexture(GL_TEXTURE_EXTERNAL_OES, texture_oes_id)");
-  glEGLImageTargetTexture2DOES(GL_TEXTURE_EXTERNAL_OES, egl_image_);
-  util::CheckGlError("glEGLImageTargetTexture2DOES");
-  glBindTexture(GL_TEXTURE_EXTERNAL_OES, 0);
-  util::CheckGlError("glBindTexture(GL_TEXTURE_EXTERNAL_OES, 0)");
+  const int camera_frame_pin = camera_frame_pins_.Pin(
+      ar_session_, ar_frame_,
+      reinterpret_cast<AHardwareBuffer*>(native_hardware_buffer),
+      1u << CameraFramePins::kGpuBackground, /*with_cpu_image=*/false);
 
   andy_renderer_.SetDepthTexture(depth_texture_.GetTextureId(),
                                  depth_texture_.GetWidth(),
@@ -241,6 +318,13 @@ void HelloArApplication::OnDrawFrame(bool depthColorVisualizationEnabled,
 
   background_renderer_.Draw(ar_session_, ar_frame_,
                             depthColorVisualizationEnabled);
+  // The background pass is the only one sampling the camera buffer.
+  egl_image_cache_.InsertReleaseFence();
+  if (camera_frame_pin != CameraFramePins::kNoPin) {
+    camera_frame_pins_.ReleaseAfterGpu(camera_frame_pin,
+                                       CameraFramePins::kGpuBackground);
+  }
+  LogFenceStats();
 
   ArTrackingState camera_tracking_state;
   ArCamera_getTrackingState(ar_session_, ar_camera, &camera_tracking_state);
@@ -279,6 +363,20 @@ void HelloArApplication::OnDrawFrame(bool depthColorVisualizationEnabled,
   ArLightEstimate_destroy(ar_light_estimate);
   ar_light_estimate = nullptr;
 
+  // Written once, the draws below only upload their model matrices.
+  if (use_stereo_) {
+    // The eyes sit on either side of the device camera, so the world is
+    // shifted the other way in their views.
+    const glm::vec3 eye_offset(0.5f * kInterpupillaryDistanceMeters, 0.0f,
+                               0.0f);
+    frame_uniforms_.UpdateStereo(
+        glm::translate(glm::mat4(1.0f), eye_offset) * view_mat,
+        glm::translate(glm::mat4(1.0f), -eye_offset) * view_mat,
+        projection_mat, color_correction);
+  } else {
+    frame_uniforms_.Update(view_mat, projection_mat, color_correction);
+  }
+
   // Update and render planes.
   ArTrackableList* plane_list = nullptr;
   ArTrackableList_create(ar_session_, &plane_list);
@@ -312,7 +410,7 @@ void HelloArApplication::OnDrawFrame(bool depthColorVisualizationEnabled,
       continue;
     }
 
-    plane_renderer_.Draw(projection_mat, view_mat, *ar_session_, *ar_plane);
+    plane_renderer_.Draw(*ar_session_, *ar_plane);
     ArTrackable_release(ar_trackable);
   }
 
@@ -332,8 +430,7 @@ void HelloArApplication::OnDrawFrame(bool depthColorVisualizationEnabled,
       // Render object only if the tracking state is AR_TRACKING_STATE_TRACKING.
       util::GetTransformMatrixFromAnchor(*colored_anchor.anchor, ar_session_,
                                          &model_mat);
-      andy_renderer_.Draw(projection_mat, view_mat, model_mat, color_correction,
-                          colored_anchor.color);
+      andy_renderer_.Draw(model_mat, colored_anchor.color);
     }
   }
 
@@ -342,8 +439,7 @@ void HelloArApplication::OnDrawFrame(bool depthColorVisualizationEnabled,
   ArStatus point_cloud_status =
       ArFrame_acquirePointCloud(ar_session_, ar_frame_, &ar_point_cloud);
   if (point_cloud_status == AR_SUCCESS) {
-    point_cloud_renderer_.Draw(projection_mat * view_mat, ar_session_,
-                               ar_point_cloud);
+    point_cloud_renderer_.Draw(ar_session_, ar_point_cloud);
     ArPointCloud_release(ar_point_cloud);
   }
 }
@@ -380,6 +476,27 @@ void HelloArApplication::ConfigureSession() {
   CHECK(ar_config);
   CHECK(ArSession_configure(ar_session_, ar_config) == AR_SUCCESS);
   ArConfig_destroy(ar_config);
+
+  // A new configuration may restart the camera with other buffers.
+  egl_image_cache_.RequestFlush();
+}
+
+void HelloArApplication::LogFenceStats() {
+  if (++frames_since_fence_stats_ < kFenceStatsLogInterval) {
+    return;
+  }
+  frames_since_fence_stats_ = 0;
+  const EglImageCache::FenceStats& stats = egl_image_cache_.GetFenceStats();
+  LOGI(
+      "Camera buffer fences: %lld inserted, %lld overlapped binds, %lld "
+      "blocking waits, %.3f ms waited",
+      static_cast<long long>(stats.fences_inserted),
+      static_cast<long long>(stats.overlapped_binds),
+      static_cast<long long>(stats.blocking_waits),
+      std::chrono::duration<float, std::milli>(stats.gpu_wait_time).count());
+  LOGI("Camera frame pins: %d pinned, %lld throttled frames",
+       camera_frame_pins_.GetPinnedCount(),
+       static_cast<long long>(camera_frame_pins_.GetThrottledFrames()));
 }
 
 void HelloArApplication::OnSettingsChange(bool is_instant_placement_enabled) {
@@ -391,6 +508,11 @@ void HelloArApplication::OnSettingsChange(bool is_instant_placement_enabled) {
 }
 
 void HelloArApplication::OnTouched(float x, float y) {
+  // Both eyes show the same camera image, so a touch on either one hits the
+  // same point.
+  if (use_stereo_) {
+    x = std::fmod(x, static_cast<float>(GetViewWidth()));
+  }
   if (ar_frame_ != nullptr && ar_session_ != nullptr) {
     ArHitResultList* hit_result_list = nullptr;
     ArHitResultList_create(ar_session_, &hit_result_list);
@@ -26,6 +26,8 @@
 #include <android/asset_manager.h>
 #include <jni.h>
 
+#include <atomic>
+#include <chrono>
 #include <memory>
 #include <set>
 #include <string>
@@ -33,10 +35,15 @@
 
 #include "arcore_c_api.h"
 #include "background_renderer.h"
+#include "camera_frame_pins.h"
+#include "egl_image_cache.h"
+#include "frame_uniforms.h"
 #include "glm.h"
 #include "obj_renderer.h"
+#include "playback_benchmark.h"
 #include "plane_renderer.h"
 #include "point_cloud_renderer.h"
+#include "stereo_target.h"
 #include "texture.h"
 #include "util.h"
 
@@ -85,9 +92,32 @@ class HelloArApplication {
 
   void OnSettingsChange(bool is_instant_placement_enabled);
 
+  // Switches the application to the playback benchmark mode: the session
+  // plays |dataset_uri| back instead of using the camera, and the time of
+  // every frame is written to |csv_path|.  Must be called before the first
+  // OnResume().  Returns false if the CSV file cannot be created.
+  bool StartPlaybackBenchmark(const std::string& dataset_uri,
+                              const std::string& csv_path);
+
+  // Returns true once the whole benchmark recording has been played back.
+  bool IsPlaybackBenchmarkFinished() const { return benchmark_finished_; }
+
  private:
   glm::mat3 GetTextureTransformMatrix(const ArSession* session,
                                       const ArFrame* frame);
+
+  // Renders the frame into the bound framebuffer, one eye or both eyes of
+  // stereo_target_ at once.
+  void DrawScene(bool depthColorVisualizationEnabled,
+                 bool useDepthForOcclusion);
+
+  // Writes the time of the frame just drawn and stops the benchmark at the
+  // end of the recording.
+  void RecordBenchmarkFrame(std::chrono::nanoseconds frame_time);
+
+  // Width of the image ARCore renders for, i.e. of one eye in stereo mode.
+  int GetViewWidth() const { return use_stereo_ ? width_ / 2 : width_; }
+
   ArSession* ar_session_ = nullptr;
   ArFrame* ar_frame_ = nullptr;
 
@@ -97,6 +127,8 @@ class HelloArApplication {
   int height_ = 1;
   int display_rotation_ = 0;
   bool is_instant_placement_enabled_ = true;
+  // Set on the OpenGL thread when kUseStereoRendering is on and supported.
+  bool use_stereo_ = false;
 
   AAssetManager* const asset_manager_;
 
@@ -109,21 +141,36 @@ class HelloArApplication {
 
   std::vector<ColoredAnchor> anchors_;
 
+  // Camera and lighting values of the frame, read by all renderers below.
+  FrameUniforms frame_uniforms_;
   PointCloudRenderer point_cloud_renderer_;
   BackgroundRenderer background_renderer_;
   PlaneRenderer plane_renderer_;
   ObjRenderer andy_renderer_;
   Texture depth_texture_;
-  // This is the most recent frame created based on the output hardware buffer.
-  // In each OnDrawFrame, the old one will be clean and the new one will
-  // be created.
-  EGLImageKHR egl_image_ = EGL_NO_IMAGE;
+  StereoTarget stereo_target_;
+  // EGLImages of the camera hardware buffers ARCore cycles through, so they
+  // are not created and destroyed on every frame.
+  EglImageCache egl_image_cache_;
+  // Keeps each camera buffer alive until the passes sampling it are done, and
+  // holds the session back when they fall behind.
+  CameraFramePins camera_frame_pins_;
+  int frames_since_fence_stats_ = 0;
+
+  // Playback benchmark state, see StartPlaybackBenchmark().
+  std::string benchmark_dataset_uri_;
+  PlaybackBenchmark playback_benchmark_;
+  std::atomic<bool> benchmark_finished_{false};
 
   int32_t plane_count_ = 0;
 
   void ConfigureSession();
 
   void UpdateAnchorColor(ColoredAnchor* colored_anchor);
+
+  // Periodically logs the fence counters of egl_image_cache_, which show
+  // whether sampling the camera buffers overlaps the camera pipeline.
+  void LogFenceStats();
 };
 }  // namespace hello_ar
 
@@ -30,6 +30,10 @@ namespace {
 // maintain a reference to the JVM so we can use it later.
 static JavaVM *g_vm = nullptr;
 
+// The JNIEnv of the current thread, so that GetJniEnv() only goes through
+// the JVM on a thread's first call.
+thread_local JNIEnv *t_env = nullptr;
+
 inline jlong jptr(hello_ar::HelloArApplication *native_hello_ar_application) {
   return reinterpret_cast<intptr_t>(native_hello_ar_application);
 }
@@ -108,10 +112,34 @@ JNI_METHOD(jboolean, hasDetectedPlanes)
       native(native_application)->HasDetectedPlanes() ? JNI_TRUE : JNI_FALSE);
 }
 
+JNI_METHOD(jboolean, startPlaybackBenchmark)
+(JNIEnv *env, jclass, jlong native_application, jstring j_dataset_uri,
+ jstring j_csv_path) {
+  const char *dataset_uri = env->GetStringUTFChars(j_dataset_uri, nullptr);
+  const char *csv_path = env->GetStringUTFChars(j_csv_path, nullptr);
+  const bool started = native(native_application)
+                           ->StartPlaybackBenchmark(dataset_uri, csv_path);
+  env->ReleaseStringUTFChars(j_csv_path, csv_path);
+  env->ReleaseStringUTFChars(j_dataset_uri, dataset_uri);
+  return static_cast<jboolean>(started ? JNI_TRUE : JNI_FALSE);
+}
+
+JNI_METHOD(jboolean, isPlaybackBenchmarkFinished)
+(JNIEnv *, jclass, jlong native_application) {
+  return static_cast<jboolean>(
+      native(native_application)->IsPlaybackBenchmarkFinished() ? JNI_TRUE
+                                                                : JNI_FALSE);
+}
+
 JNIEnv *GetJniEnv() {
-  JNIEnv *env;
-  jint result = g_vm->AttachCurrentThread(&env, nullptr);
-  return result == JNI_OK ? env : nullptr;
+  if (t_env == nullptr) {
+    JNIEnv *env = nullptr;
+    if (g_vm->AttachCurrentThread(&env, nullptr) != JNI_OK) {
+      return nullptr;
+    }
+    t_env = env;
+  }
+  return t_env;
 }
 
 jclass FindClass(const char *classname) {
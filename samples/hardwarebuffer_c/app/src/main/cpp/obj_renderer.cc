@@ -16,23 +16,36 @@
 
 #include "obj_renderer.h"
 
+#include <algorithm>
+
+#include "frame_uniforms.h"
 #include "util.h"
 
 namespace hello_ar {
 namespace {
-const glm::vec4 kLightDirection(0.0f, 1.0f, 0.0f, 0.0f);
 constexpr char kVertexShaderFilename[] = "shaders/ar_object.vert";
 constexpr char kFragmentShaderFilename[] = "shaders/ar_object.frag";
 constexpr char kUseDepthForOcclusionShaderFlag[] = "USE_DEPTH_FOR_OCCLUSION";
+constexpr char kStereoShaderFlag[] = "STEREO";
+
+// Interleaved vertex layout: position (xyz), normal (xyz), uv (st).
+constexpr int kPositionComponents = 3;
+constexpr int kNormalComponents = 3;
+constexpr int kUvComponents = 2;
+constexpr int kVertexComponents =
+    kPositionComponents + kNormalComponents + kUvComponents;
+constexpr GLsizei kVertexStride = kVertexComponents * sizeof(GLfloat);
+constexpr size_t kNormalOffset = kPositionComponents * sizeof(GLfloat);
+constexpr size_t kUvOffset =
+    (kPositionComponents + kNormalComponents) * sizeof(GLfloat);
 }  // namespace
 
 void ObjRenderer::InitializeGlContent(AAssetManager* asset_manager,
                                       const std::string& obj_file_name,
-                                      const std::string& png_file_name) {
+                                      const std::string& png_file_name,
+                                      bool stereo) {
+  stereo_ = stereo;
   compileAndLoadShaderProgram(asset_manager);
-  position_attrib_ = glGetAttribLocation(shader_program_, "a_Position");
-  tex_coord_attrib_ = glGetAttribLocation(shader_program_, "a_TexCoord");
-  normal_attrib_ = glGetAttribLocation(shader_program_, "a_Normal");
 
   glGenTextures(1, &texture_id_);
   glBindTexture(GL_TEXTURE_2D, texture_id_);
@@ -49,8 +62,49 @@ void ObjRenderer::InitializeGlContent(AAssetManager* asset_manager,
 
   glBindTexture(GL_TEXTURE_2D, 0);
 
-  util::LoadObjFile(obj_file_name, asset_manager, &vertices_, &normals_, &uvs_,
-                    &indices_);
+  std::vector<GLfloat> vertices;
+  std::vector<GLfloat> normals;
+  std::vector<GLfloat> uvs;
+  std::vector<GLushort> indices;
+  if (!util::LoadObjFile(obj_file_name, asset_manager, &vertices, &normals,
+                         &uvs, &indices)) {
+    LOGE("Could not load obj file %s.", obj_file_name.c_str());
+  }
+
+  // Interleaves the attributes so each vertex is fetched from one cache line.
+  // Attributes missing from the OBJ file are left zeroed.
+  const size_t vertex_count = vertices.size() / kPositionComponents;
+  std::vector<GLfloat> interleaved(vertex_count * kVertexComponents, 0.0f);
+  for (size_t i = 0; i < vertex_count; ++i) {
+    GLfloat* out = &interleaved[i * kVertexComponents];
+    std::copy_n(&vertices[i * kPositionComponents], kPositionComponents, out);
+    if (normals.size() >= (i + 1) * kNormalComponents) {
+      std::copy_n(&normals[i * kNormalComponents], kNormalComponents,
+                  out + kPositionComponents);
+    }
+    if (uvs.size() >= (i + 1) * kUvComponents) {
+      std::copy_n(&uvs[i * kUvComponents], kUvComponents,
+                  out + kPositionComponents + kNormalComponents);
+    }
+  }
+  index_count_ = static_cast<GLsizei>(indices.size());
+
+  glGenVertexArrays(1, &vertex_array_);
+  glGenBuffers(1, &vertex_buffer_);
+  glGenBuffers(1, &index_buffer_);
+
+  glBindVertexArray(vertex_array_);
+  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+  glBufferData(GL_ARRAY_BUFFER, interleaved.size() * sizeof(GLfloat),
+               interleaved.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort),
+               indices.data(), GL_STATIC_DRAW);
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+  ConfigureVertexArray();
 
   util::CheckGlError("obj_renderer::InitializeGlContent()");
 }
@@ -71,6 +125,7 @@ void ObjRenderer::compileAndLoadShaderProgram(AAssetManager* asset_manager) {
   std::map<std::string, int> define_values_map;
   define_values_map[kUseDepthForOcclusionShaderFlag] =
       use_depth_for_occlusion_ ? 1 : 0;
+  define_values_map[kStereoShaderFlag] = stereo_ ? 1 : 0;
 
   shader_program_ =
       util::CreateProgram(kVertexShaderFilename, kFragmentShaderFilename,
@@ -78,18 +133,17 @@ void ObjRenderer::compileAndLoadShaderProgram(AAssetManager* asset_manager) {
   if (!shader_program_) {
     LOGE("Could not create program.");
   }
+  FrameUniforms::BindToProgram(shader_program_);
+
+  position_attrib_ = glGetAttribLocation(shader_program_, "a_Position");
+  tex_coord_attrib_ = glGetAttribLocation(shader_program_, "a_TexCoord");
+  normal_attrib_ = glGetAttribLocation(shader_program_, "a_Normal");
 
-  mvp_mat_uniform_ =
-      glGetUniformLocation(shader_program_, "u_ModelViewProjection");
-  mv_mat_uniform_ = glGetUniformLocation(shader_program_, "u_ModelView");
+  model_mat_uniform_ = glGetUniformLocation(shader_program_, "u_Model");
   texture_uniform_ = glGetUniformLocation(shader_program_, "u_Texture");
 
-  lighting_param_uniform_ =
-      glGetUniformLocation(shader_program_, "u_LightingParameters");
   material_param_uniform_ =
       glGetUniformLocation(shader_program_, "u_MaterialParameters");
-  color_correction_param_uniform_ =
-      glGetUniformLocation(shader_program_, "u_ColorCorrectionParameters");
   color_uniform_ = glGetUniformLocation(shader_program_, "u_ObjColor");
 
   // Occlusion Uniforms.
@@ -101,6 +155,51 @@ void ObjRenderer::compileAndLoadShaderProgram(AAssetManager* asset_manager) {
     depth_aspect_ratio_uniform_ =
         glGetUniformLocation(shader_program_, "u_DepthAspectRatio");
   }
+
+  // Uniform values are lost with the previous program.
+  glUseProgram(shader_program_);
+  UploadSharedUniforms();
+  glUseProgram(0);
+
+  ConfigureVertexArray();
+}
+
+void ObjRenderer::UploadSharedUniforms() const {
+  glUniform1i(texture_uniform_, 0);
+  glUniform4f(material_param_uniform_, ambient_, diffuse_, specular_,
+              specular_power_);
+  if (use_depth_for_occlusion_) {
+    glUniform1i(depth_texture_uniform_, 1);
+    glUniformMatrix3fv(depth_uv_transform_uniform_, 1, GL_FALSE,
+                       glm::value_ptr(uv_transform_));
+    glUniform1f(depth_aspect_ratio_uniform_, depth_aspect_ratio_);
+  }
+}
+
+void ObjRenderer::ConfigureVertexArray() {
+  if (!vertex_array_) {
+    return;  // Geometry is not uploaded yet.
+  }
+
+  glBindVertexArray(vertex_array_);
+  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+
+  glEnableVertexAttribArray(position_attrib_);
+  glVertexAttribPointer(position_attrib_, kPositionComponents, GL_FLOAT,
+                        GL_FALSE, kVertexStride, nullptr);
+
+  glEnableVertexAttribArray(normal_attrib_);
+  glVertexAttribPointer(normal_attrib_, kNormalComponents, GL_FLOAT, GL_FALSE,
+                        kVertexStride,
+                        reinterpret_cast<const void*>(kNormalOffset));
+
+  glEnableVertexAttribArray(tex_coord_attrib_);
+  glVertexAttribPointer(tex_coord_attrib_, kUvComponents, GL_FLOAT, GL_FALSE,
+                        kVertexStride,
+                        reinterpret_cast<const void*>(kUvOffset));
+
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 void ObjRenderer::SetMaterialProperty(float ambient, float diffuse,
@@ -109,11 +208,38 @@ void ObjRenderer::SetMaterialProperty(float ambient, float diffuse,
   diffuse_ = diffuse;
   specular_ = specular;
   specular_power_ = specular_power;
+  if (shader_program_) {
+    glUseProgram(shader_program_);
+    UploadSharedUniforms();
+    glUseProgram(0);
+  }
+}
+
+void ObjRenderer::SetUvTransformMatrix(const glm::mat3& uv_transform) {
+  uv_transform_ = uv_transform;
+  if (shader_program_ && use_depth_for_occlusion_) {
+    glUseProgram(shader_program_);
+    glUniformMatrix3fv(depth_uv_transform_uniform_, 1, GL_FALSE,
+                       glm::value_ptr(uv_transform_));
+    glUseProgram(0);
+  }
 }
 
-void ObjRenderer::Draw(const glm::mat4& projection_mat,
-                       const glm::mat4& view_mat, const glm::mat4& model_mat,
-                       const float* color_correction4,
+void ObjRenderer::SetDepthTexture(int texture_id, int width, int height) {
+  depth_texture_id_ = texture_id;
+  const float depth_aspect_ratio = (float)width / (float)height;
+  if (depth_aspect_ratio == depth_aspect_ratio_) {
+    return;
+  }
+  depth_aspect_ratio_ = depth_aspect_ratio;
+  if (shader_program_ && use_depth_for_occlusion_) {
+    glUseProgram(shader_program_);
+    glUniform1f(depth_aspect_ratio_uniform_, depth_aspect_ratio_);
+    glUseProgram(0);
+  }
+}
+
+void ObjRenderer::Draw(const glm::mat4& model_mat,
                        const float* object_color4) const {
   if (!shader_program_) {
     LOGE("shader_program is null.");
@@ -123,49 +249,21 @@ void ObjRenderer::Draw(const glm::mat4& projection_mat,
   glUseProgram(shader_program_);
 
   glActiveTexture(GL_TEXTURE0);
-  glUniform1i(texture_uniform_, 0);
   glBindTexture(GL_TEXTURE_2D, texture_id_);
-
-  glm::mat4 mvp_mat = projection_mat * view_mat * model_mat;
-  glm::mat4 mv_mat = view_mat * model_mat;
-  glm::vec4 view_light_direction = glm::normalize(mv_mat * kLightDirection);
-
-  glUniform4f(lighting_param_uniform_, view_light_direction[0],
-              view_light_direction[1], view_light_direction[2], 1.f);
-  glUniform4f(material_param_uniform_, ambient_, diffuse_, specular_,
-              specular_power_);
-  glUniform4fv(color_correction_param_uniform_, 1, color_correction4);
-  glUniform4fv(color_uniform_, 1, object_color4);
-
-  glUniformMatrix4fv(mvp_mat_uniform_, 1, GL_FALSE, glm::value_ptr(mvp_mat));
-  glUniformMatrix4fv(mv_mat_uniform_, 1, GL_FALSE, glm::value_ptr(mv_mat));
-
-  // Occlusion parameters.
   if (use_depth_for_occlusion_) {
-    // Attach the depth texture.
     glActiveTexture(GL_TEXTURE1);
     glBindTexture(GL_TEXTURE_2D, depth_texture_id_);
-    glUniform1i(depth_texture_uniform_, 1);
-
-    // Set the depth texture uv transform.
-    glUniformMatrix3fv(depth_uv_transform_uniform_, 1, GL_FALSE,
-                       glm::value_ptr(uv_transform_));
-    glUniform1f(depth_aspect_ratio_uniform_, depth_aspect_ratio_);
   }
 
-  // Note: for simplicity, we are uploading the model each time we draw it.  A
-  // real application should use vertex buffers to upload the geometry once.
-  glEnableVertexAttribArray(position_attrib_);
-  glVertexAttribPointer(position_attrib_, 3, GL_FLOAT, GL_FALSE, 0,
-                        vertices_.data());
-
-  glEnableVertexAttribArray(normal_attrib_);
-  glVertexAttribPointer(normal_attrib_, 3, GL_FLOAT, GL_FALSE, 0,
-                        normals_.data());
+  // The view and projection matrices come from the FrameUniforms block, the
+  // model-view matrix is applied in the vertex shader.
+  glUniformMatrix4fv(model_mat_uniform_, 1, GL_FALSE,
+                     glm::value_ptr(model_mat));
+  glUniform4fv(color_uniform_, 1, object_color4);
 
-  glEnableVertexAttribArray(tex_coord_attrib_);
-  glVertexAttribPointer(tex_coord_attrib_, 2, GL_FLOAT, GL_FALSE, 0,
-                        uvs_.data());
+  // The geometry lives in GPU buffers recorded into the vertex array object,
+  // so nothing is uploaded here.
+  glBindVertexArray(vertex_array_);
 
   glDepthMask(GL_TRUE);
   glEnable(GL_BLEND);
@@ -175,13 +273,10 @@ void ObjRenderer::Draw(const glm::mat4& projection_mat,
   // so we use the premultiplied alpha blend factors.
   glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
 
-  glDrawElements(GL_TRIANGLES, indices_.size(), GL_UNSIGNED_SHORT,
-                 indices_.data());
+  glDrawElements(GL_TRIANGLES, index_count_, GL_UNSIGNED_SHORT, nullptr);
 
   glDisable(GL_BLEND);
-  glDisableVertexAttribArray(position_attrib_);
-  glDisableVertexAttribArray(tex_coord_attrib_);
-  glDisableVertexAttribArray(normal_attrib_);
+  glBindVertexArray(0);
 
   glUseProgram(0);
   util::CheckGlError("obj_renderer::Draw()");
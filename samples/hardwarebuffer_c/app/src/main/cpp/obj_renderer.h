@@ -16,8 +16,10 @@
 
 #ifndef C_ARCORE_HELLOE_AR_OBJ_RENDERER_
 #define C_ARCORE_HELLOE_AR_OBJ_RENDERER_
-#include <GLES2/gl2.h>
+// clang-format off
+#include <GLES3/gl3.h>
 #include <GLES2/gl2ext.h>
+// clang-format on
 #include <android/asset_manager.h>
 
 #include <cstdint>
@@ -37,29 +39,29 @@ class ObjRenderer {
   ~ObjRenderer() = default;
 
   // Loads the OBJ file and texture and sets up OpenGL resources used to draw
-  // the model.  Must be called on the OpenGL thread prior to any other calls.
+  // the model.  The mesh is uploaded once into an interleaved vertex buffer
+  // and an index buffer, which are recorded into a vertex array object.  Must
+  // be called on the OpenGL thread prior to any other calls.  |stereo| builds
+  // the program for drawing into a StereoTarget.
   void InitializeGlContent(AAssetManager* asset_manager,
                            const std::string& obj_file_name,
-                           const std::string& png_file_name);
+                           const std::string& png_file_name, bool stereo);
 
   // Sets the surface's lighting reflectace properties.  Diffuse is modulated by
-  // the texture's color.
+  // the texture's color.  Must be called on the OpenGL thread.
   void SetMaterialProperty(float ambient, float diffuse, float specular,
                            float specular_power);
 
-  // Draws the model.
-  void Draw(const glm::mat4& projection_mat, const glm::mat4& view_mat,
-            const glm::mat4& model_mat, const float* color_correction4,
-            const float* object_color4) const;
+  // Draws the model.  The camera matrices, light direction and color
+  // correction are read from the FrameUniforms buffer of the frame, so only
+  // |model_mat| and |object_color4| are uploaded per draw.
+  void Draw(const glm::mat4& model_mat, const float* object_color4) const;
 
-  void SetUvTransformMatrix(const glm::mat3& uv_transform) {
-    uv_transform_ = uv_transform;
-  }
-
-  void SetDepthTexture(int texture_id, int width, int height) {
-    depth_texture_id_ = texture_id;
-    depth_aspect_ratio_ = (float)width / (float)height;
-  }
+  // The depth occlusion parameters.  Both only change with the display
+  // geometry or the depth image, so they are uploaded here instead of in
+  // every Draw().  Must be called on the OpenGL thread.
+  void SetUvTransformMatrix(const glm::mat3& uv_transform);
+  void SetDepthTexture(int texture_id, int width, int height);
 
   // Specifies whether to use the depth texture to perform depth-based occlusion
   // of virtual objects from real-world geometry.
@@ -79,41 +81,48 @@ class ObjRenderer {
  private:
   void compileAndLoadShaderProgram(AAssetManager* asset_manager);
 
+  // Records the vertex attribute layout of the interleaved vertex buffer into
+  // the vertex array object.  Needs to be re-run whenever the shader program
+  // is relinked, since attribute locations may change.
+  void ConfigureVertexArray();
+
+  // Uploads the uniforms that are the same for all draws of the model to the
+  // current shader program.
+  void UploadSharedUniforms() const;
+
   // Shader material lighting pateremrs
   float ambient_ = 0.0f;
   float diffuse_ = 2.0f;
   float specular_ = 0.5f;
   float specular_power_ = 6.0f;
 
-  // Model attribute arrays
-  std::vector<GLfloat> vertices_;
-  std::vector<GLfloat> uvs_;
-  std::vector<GLfloat> normals_;
-
-  // Model triangle indices
-  std::vector<GLushort> indices_;
+  // GPU-resident model geometry.  The vertex buffer holds interleaved
+  // position (3), normal (3) and uv (2) floats for each vertex.
+  GLuint vertex_array_ = 0;
+  GLuint vertex_buffer_ = 0;
+  GLuint index_buffer_ = 0;
+  GLsizei index_count_ = 0;
 
   // Loaded TEXTURE_2D object name
   GLuint texture_id_;
-  GLuint depth_texture_id_;
+  GLuint depth_texture_id_ = 0;
 
   // Shader program details
-  GLuint shader_program_;
+  GLuint shader_program_ = 0;
   GLint position_attrib_;
   GLint tex_coord_attrib_;
   GLint normal_attrib_;
-  GLint mvp_mat_uniform_;
-  GLint mv_mat_uniform_;
+  GLint model_mat_uniform_;
   GLint texture_uniform_;
-  GLint lighting_param_uniform_;
   GLint material_param_uniform_;
-  GLint color_correction_param_uniform_;
   GLint color_uniform_;
   GLint depth_texture_uniform_;
   GLint depth_uv_transform_uniform_;
   GLint depth_aspect_ratio_uniform_;
 
   bool use_depth_for_occlusion_ = false;
+  // Whether the program renders both eyes of a StereoTarget.
+  bool stereo_ = false;
   float depth_aspect_ratio_ = 0.0f;
   glm::mat3 uv_transform_ = glm::mat3(1.0f);
 };
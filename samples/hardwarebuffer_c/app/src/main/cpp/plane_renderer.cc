@@ -16,29 +16,40 @@
 
 #include "plane_renderer.h"
 
+#include <map>
 #include <string>
 
+#include "frame_uniforms.h"
 #include "util.h"
 
 namespace hello_ar {
 namespace {
 constexpr char kVertexShaderFilename[] = "shaders/plane.vert";
 constexpr char kFragmentShaderFilename[] = "shaders/plane.frag";
+constexpr char kStereoShaderFlag[] = "STEREO";
 }  // namespace
 
-void PlaneRenderer::InitializeGlContent(AAssetManager* asset_manager) {
-  shader_program_ = util::CreateProgram(kVertexShaderFilename,
-                                        kFragmentShaderFilename, asset_manager);
+void PlaneRenderer::InitializeGlContent(AAssetManager* asset_manager,
+                                        bool stereo) {
+  std::map<std::string, int> define_values_map;
+  define_values_map[kStereoShaderFlag] = stereo ? 1 : 0;
+  shader_program_ =
+      util::CreateProgram(kVertexShaderFilename, kFragmentShaderFilename,
+                          asset_manager, define_values_map);
   if (!shader_program_) {
     LOGE("Could not create program.");
   }
+  FrameUniforms::BindToProgram(shader_program_);
 
-  uniform_mvp_mat_ = glGetUniformLocation(shader_program_, "mvp");
-  uniform_texture_ = glGetUniformLocation(shader_program_, "texture");
+  uniform_texture_ = glGetUniformLocation(shader_program_, "u_Texture");
   uniform_model_mat_ = glGetUniformLocation(shader_program_, "model_mat");
   uniform_normal_vec_ = glGetUniformLocation(shader_program_, "normal");
   attri_vertices_ = glGetAttribLocation(shader_program_, "vertex");
 
+  glUseProgram(shader_program_);
+  glUniform1i(uniform_texture_, 0);
+  glUseProgram(0);
+
   glGenTextures(1, &texture_id_);
   glBindTexture(GL_TEXTURE_2D, texture_id_);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -58,8 +69,7 @@ void PlaneRenderer::InitializeGlContent(AAssetManager* asset_manager) {
   util::CheckGlError("plane_renderer::InitializeGlContent()");
 }
 
-void PlaneRenderer::Draw(const glm::mat4& projection_mat,
-                         const glm::mat4& view_mat, const ArSession& ar_session,
+void PlaneRenderer::Draw(const ArSession& ar_session,
                          const ArPlane& ar_plane) {
   if (!shader_program_) {
     LOGE("shader_program is null.");
@@ -72,13 +82,8 @@ void PlaneRenderer::Draw(const glm::mat4& projection_mat,
   glDepthMask(GL_FALSE);
 
   glActiveTexture(GL_TEXTURE0);
-  glUniform1i(uniform_texture_, 0);
   glBindTexture(GL_TEXTURE_2D, texture_id_);
 
-  // Compose final mvp matrix for this plane renderer.
-  glUniformMatrix4fv(uniform_mvp_mat_, 1, GL_FALSE,
-                     glm::value_ptr(projection_mat * view_mat * model_mat_));
-
   glUniformMatrix4fv(uniform_model_mat_, 1, GL_FALSE,
                      glm::value_ptr(model_mat_));
   glUniform3f(uniform_normal_vec_, normal_vec_.x, normal_vec_.y, normal_vec_.z);
@@ -128,15 +133,16 @@ void PlaneRenderer::UpdateForPlane(const ArSession& ar_session,
   }
 
   const int32_t vertices_size = polygon_length / 2;
-  std::vector<glm::vec2> raw_vertices(vertices_size);
+  raw_vertices_.resize(vertices_size);
   ArPlane_getPolygon(&ar_session, &ar_plane,
-                     glm::value_ptr(raw_vertices.front()));
+                     glm::value_ptr(raw_vertices_.front()));
 
   // Fill vertex 0 to 3. Note that the vertex.xy are used for x and z
   // position. vertex.z is used for alpha. The outer polygon's alpha
   // is 0.
   for (int32_t i = 0; i < vertices_size; ++i) {
-    vertices_.push_back(glm::vec3(raw_vertices[i].x, raw_vertices[i].y, 0.0f));
+    vertices_.push_back(
+        glm::vec3(raw_vertices_[i].x, raw_vertices_[i].y, 0.0f));
   }
 
   util::ScopedArPose scopedArPose(&ar_session);
@@ -153,7 +159,7 @@ void PlaneRenderer::UpdateForPlane(const ArSession& ar_session,
   // Fill vertex 4 to 7, with alpha set to 1.
   for (int32_t i = 0; i < vertices_size; ++i) {
     // Vector from plane center to current point.
-    glm::vec2 v = raw_vertices[i];
+    glm::vec2 v = raw_vertices_[i];
     const float scale =
         1.0f - std::min((kFeatherLength / glm::length(v)), kFeatherScale);
     const glm::vec2 result_v = scale * v;
@@ -17,7 +17,7 @@
 #ifndef C_ARCORE_HELLOE_AR_PLANE_RENDERER_H_
 #define C_ARCORE_HELLOE_AR_PLANE_RENDERER_H_
 
-#include <GLES2/gl2.h>
+#include <GLES3/gl3.h>
 #include <GLES2/gl2ext.h>
 #include <android/asset_manager.h>
 
@@ -38,16 +38,19 @@ class PlaneRenderer {
   ~PlaneRenderer() = default;
 
   // Sets up OpenGL state used by the plane renderer.  Must be called on the
-  // OpenGL thread.
-  void InitializeGlContent(AAssetManager* asset_manager);
+  // OpenGL thread.  |stereo| builds the program for drawing into a
+  // StereoTarget.
+  void InitializeGlContent(AAssetManager* asset_manager, bool stereo);
 
-  // Draws the provided plane.
-  void Draw(const glm::mat4& projection_mat, const glm::mat4& view_mat,
-            const ArSession& ar_session, const ArPlane& ar_plane);
+  // Draws the provided plane with the view-projection matrix of the
+  // FrameUniforms buffer.
+  void Draw(const ArSession& ar_session, const ArPlane& ar_plane);
 
  private:
   void UpdateForPlane(const ArSession& ar_session, const ArPlane& ar_plane);
 
+  // Polygon of the plane being updated, kept so its capacity is reused.
+  std::vector<glm::vec2> raw_vertices_;
   std::vector<glm::vec3> vertices_;
   std::vector<GLushort> triangles_;
   glm::mat4 model_mat_ = glm::mat4(1.0f);
@@ -57,7 +60,6 @@ class PlaneRenderer {
 
   GLuint shader_program_;
   GLint attri_vertices_;
-  GLint uniform_mvp_mat_;
   GLint uniform_texture_;
   GLint uniform_model_mat_;
   GLint uniform_normal_vec_;
@@ -16,32 +16,45 @@
 
 #include "point_cloud_renderer.h"
 
+#include <map>
+#include <string>
+
+#include "frame_uniforms.h"
 #include "util.h"
 
 namespace hello_ar {
 namespace {
 constexpr char kVertexShaderFilename[] = "shaders/point_cloud.vert";
 constexpr char kFragmentShaderFilename[] = "shaders/point_cloud.frag";
+constexpr char kStereoShaderFlag[] = "STEREO";
 }  // namespace
 
-void PointCloudRenderer::InitializeGlContent(AAssetManager* asset_manager) {
-  shader_program_ = util::CreateProgram(kVertexShaderFilename,
-                                        kFragmentShaderFilename, asset_manager);
+void PointCloudRenderer::InitializeGlContent(AAssetManager* asset_manager,
+                                             bool stereo) {
+  std::map<std::string, int> define_values_map;
+  define_values_map[kStereoShaderFlag] = stereo ? 1 : 0;
+  shader_program_ =
+      util::CreateProgram(kVertexShaderFilename, kFragmentShaderFilename,
+                          asset_manager, define_values_map);
   if (!shader_program_) {
     LOGE("Could not create program.");
   }
+  FrameUniforms::BindToProgram(shader_program_);
 
   attribute_vertices_ = glGetAttribLocation(shader_program_, "a_Position");
-  uniform_mvp_mat_ =
-      glGetUniformLocation(shader_program_, "u_ModelViewProjection");
-  uniform_color_ = glGetUniformLocation(shader_program_, "u_Color");
-  uniform_point_size_ = glGetUniformLocation(shader_program_, "u_PointSize");
+
+  // The color and size never change, so they are set once.
+  glUseProgram(shader_program_);
+  // Set cyan color to the point cloud.
+  glUniform4f(glGetUniformLocation(shader_program_, "u_Color"),
+              31.0f / 255.0f, 188.0f / 255.0f, 210.0f / 255.0f, 1.0f);
+  glUniform1f(glGetUniformLocation(shader_program_, "u_PointSize"), 5.0f);
+  glUseProgram(0);
 
   util::CheckGlError("point_cloud_renderer::InitializeGlContent()");
 }
 
-void PointCloudRenderer::Draw(const glm::mat4& mvp_matrix,
-                              ArSession* ar_session,
+void PointCloudRenderer::Draw(ArSession* ar_session,
                               ArPointCloud* ar_point_cloud) const {
   CHECK(shader_program_);
 
@@ -56,17 +69,10 @@ void PointCloudRenderer::Draw(const glm::mat4& mvp_matrix,
   const float* point_cloud_data;
   ArPointCloud_getData(ar_session, ar_point_cloud, &point_cloud_data);
 
-  glUniformMatrix4fv(uniform_mvp_mat_, 1, GL_FALSE, glm::value_ptr(mvp_matrix));
-
   glEnableVertexAttribArray(attribute_vertices_);
   glVertexAttribPointer(attribute_vertices_, 4, GL_FLOAT, GL_FALSE, 0,
                         point_cloud_data);
 
-  // Set cyan color to the point cloud.
-  glUniform4f(uniform_color_, 31.0f / 255.0f, 188.0f / 255.0f, 210.0f / 255.0f,
-              1.0f);
-  glUniform1f(uniform_point_size_, 5.0f);
-
   glDrawArrays(GL_POINTS, 0, number_of_points);
 
   glUseProgram(0);
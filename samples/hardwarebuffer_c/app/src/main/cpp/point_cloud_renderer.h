@@ -17,7 +17,7 @@
 #ifndef C_ARCORE_HELLOE_AR_POINT_CLOUD_RENDERER_H_
 #define C_ARCORE_HELLOE_AR_POINT_CLOUD_RENDERER_H_
 
-#include <GLES2/gl2.h>
+#include <GLES3/gl3.h>
 #include <GLES2/gl2ext.h>
 #include <android/asset_manager.h>
 
@@ -37,24 +37,21 @@ class PointCloudRenderer {
   // Default deconstructor of PointCloudRenderer.
   ~PointCloudRenderer() = default;
 
-  // Initialize the GL content, needs to be called on GL thread.
-  void InitializeGlContent(AAssetManager* asset_manager);
+  // Initialize the GL content, needs to be called on GL thread.  |stereo|
+  // builds the program for drawing into a StereoTarget.
+  void InitializeGlContent(AAssetManager* asset_manager, bool stereo);
 
-  // Render the AR point cloud.
+  // Render the AR point cloud with the view-projection matrix of the
+  // FrameUniforms buffer.
   //
-  // @param mvp_matrix, the model view projection matrix of point cloud.
   // @param ar_session, the session that is used to query point cloud points
   //     from ar_point_cloud.
   // @param ar_point_cloud, point cloud data to for rendering.
-  void Draw(const glm::mat4& mvp_matrix, ArSession* ar_session,
-            ArPointCloud* ar_point_cloud) const;
+  void Draw(ArSession* ar_session, ArPointCloud* ar_point_cloud) const;
 
  private:
   GLuint shader_program_;
   GLint attribute_vertices_;
-  GLint uniform_mvp_mat_;
-  GLint uniform_color_;
-  GLint uniform_point_size_;
 };
 }  // namespace hello_ar
 
@@ -0,0 +1,108 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "stereo_target.h"
+
+#include <EGL/egl.h>
+
+#include "util.h"
+
+namespace hello_ar {
+namespace {
+constexpr GLsizei kViewCount = 2;
+}  // namespace
+
+bool StereoTarget::IsSupported() {
+  // The background shaders also need to sample the camera image from GLSL ES
+  // 3.00, which has its own extension.
+  if (!util::HasGlExtension("GL_OVR_multiview2") ||
+      !util::HasGlExtension("GL_OES_EGL_image_external_essl3")) {
+    return false;
+  }
+  GLint max_views = 0;
+  glGetIntegerv(GL_MAX_VIEWS_OVR, &max_views);
+  return max_views >= kViewCount &&
+         eglGetProcAddress("glFramebufferTextureMultiviewOVR") != nullptr;
+}
+
+void StereoTarget::InitializeGlContent() {
+  framebuffer_texture_multiview_ =
+      reinterpret_cast<PFNGLFRAMEBUFFERTEXTUREMULTIVIEWOVRPROC>(
+          eglGetProcAddress("glFramebufferTextureMultiviewOVR"));
+  glGenFramebuffers(1, &multiview_framebuffer_);
+  glGenFramebuffers(1, &read_framebuffer_);
+  util::CheckGlError("StereoTarget::InitializeGlContent()");
+}
+
+void StereoTarget::Resize(int eye_width, int eye_height) {
+  if (eye_width == eye_width_ && eye_height == eye_height_) {
+    return;
+  }
+  eye_width_ = eye_width;
+  eye_height_ = eye_height;
+
+  // Texture storage is immutable, so the textures are replaced.
+  glDeleteTextures(1, &color_texture_);
+  glDeleteTextures(1, &depth_texture_);
+  glGenTextures(1, &color_texture_);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, color_texture_);
+  glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_RGBA8, eye_width, eye_height,
+                 kViewCount);
+  glGenTextures(1, &depth_texture_);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, depth_texture_);
+  glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_DEPTH_COMPONENT24, eye_width,
+                 eye_height, kViewCount);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, multiview_framebuffer_);
+  framebuffer_texture_multiview_(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                 color_texture_, 0, 0, kViewCount);
+  framebuffer_texture_multiview_(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                                 depth_texture_, 0, 0, kViewCount);
+  const GLenum status = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    LOGE("StereoTarget: incomplete multiview framebuffer (0x%x)", status);
+  }
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+  util::CheckGlError("StereoTarget::Resize()");
+}
+
+void StereoTarget::Bind() const {
+  glBindFramebuffer(GL_FRAMEBUFFER, multiview_framebuffer_);
+  glViewport(0, 0, eye_width_, eye_height_);
+}
+
+void StereoTarget::Present() const {
+  // The depth of the eyes is not needed anymore, which spares tiled GPUs from
+  // writing it back to memory.
+  const GLenum depth_attachment = GL_DEPTH_ATTACHMENT;
+  glBindFramebuffer(GL_FRAMEBUFFER, multiview_framebuffer_);
+  glInvalidateFramebuffer(GL_FRAMEBUFFER, 1, &depth_attachment);
+
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, read_framebuffer_);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+  for (GLint eye = 0; eye < kViewCount; ++eye) {
+    glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                              color_texture_, 0, eye);
+    glBlitFramebuffer(0, 0, eye_width_, eye_height_, eye * eye_width_, 0,
+                      (eye + 1) * eye_width_, eye_height_,
+                      GL_COLOR_BUFFER_BIT, GL_NEAREST);
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  util::CheckGlError("StereoTarget::Present()");
+}
+
+}  // namespace hello_ar
@@ -0,0 +1,74 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_STEREO_TARGET_H_
+#define C_ARCORE_HELLOE_AR_STEREO_TARGET_H_
+
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+
+namespace hello_ar {
+
+// Offscreen render target for drawing both eyes in a single pass with
+// GL_OVR_multiview2.  The eyes are the two layers of a color and a depth
+// texture array, attached to one framebuffer as two views: every draw into it
+// runs once and is broadcast to both layers, with programs selecting their
+// per-eye values by gl_ViewID_OVR, see FrameUniforms.  Present() then copies
+// the eyes side by side into the left and right halves of the window.
+class StereoTarget {
+ public:
+  StereoTarget() = default;
+  ~StereoTarget() = default;
+
+  StereoTarget(const StereoTarget&) = delete;
+  StereoTarget& operator=(const StereoTarget&) = delete;
+
+  // Returns true if the current context can render two views in one pass.
+  // Must be called on the OpenGL thread.
+  static bool IsSupported();
+
+  // Creates the framebuffers.  Must be called on the OpenGL thread prior to
+  // any other calls, and only if IsSupported().
+  void InitializeGlContent();
+
+  // (Re)allocates the eye textures for eyes of |eye_width| x |eye_height|
+  // pixels.  Must be called on the OpenGL thread.
+  void Resize(int eye_width, int eye_height);
+
+  // Binds the multiview framebuffer and sets the viewport to one eye.
+  void Bind() const;
+
+  // Copies the left and right eye into the two halves of the default
+  // framebuffer, which is left bound.
+  void Present() const;
+
+ private:
+  PFNGLFRAMEBUFFERTEXTUREMULTIVIEWOVRPROC framebuffer_texture_multiview_ =
+      nullptr;
+
+  GLuint color_texture_ = 0;
+  GLuint depth_texture_ = 0;
+  // Renders into both layers at once.
+  GLuint multiview_framebuffer_ = 0;
+  // Reads one eye layer at a time for Present().
+  GLuint read_framebuffer_ = 0;
+  int eye_width_ = 0;
+  int eye_height_ = 0;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_STEREO_TARGET_H_
@@ -15,8 +15,10 @@
  */
 #include "util.h"
 
+#include <GLES3/gl3.h>
 #include <unistd.h>
 
+#include <cstring>
 #include <sstream>
 #include <string>
 
@@ -36,12 +38,39 @@ void CheckGlError(const char* operation) {
   }
 }
 
+bool HasGlExtension(const char* name) {
+  GLint num_extensions = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &num_extensions);
+  for (GLint i = 0; i < num_extensions; ++i) {
+    const char* extension = reinterpret_cast<const char*>(
+        glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i)));
+    if (extension != nullptr && strcmp(extension, name) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
 void ThrowJavaException(JNIEnv* env, const char* msg) {
   LOGE("Throw Java exception: %s", msg);
   jclass c = env->FindClass("java/lang/RuntimeException");
   env->ThrowNew(c, msg);
 }
 
+// Returns |source| with |defines| inserted after its #version line, which has
+// to stay the first line of the shader.
+static std::string InsertDefines(const std::string& source,
+                                 const std::string& defines) {
+  if (source.compare(0, 8, "#version") != 0) {
+    return defines + source;
+  }
+  const size_t line_end = source.find('\n');
+  if (line_end == std::string::npos) {
+    return source + "\n" + defines;
+  }
+  return source.substr(0, line_end + 1) + defines + source.substr(line_end + 1);
+}
+
 // Convenience function used in CreateProgram below.
 static GLuint LoadShader(GLenum shader_type, const char* shader_source) {
   GLuint shader = glCreateShader(shader_type);
@@ -108,8 +137,8 @@ GLuint CreateProgram(const char* vertex_shader_file_name,
   for (const auto& entry : define_values_map) {
     defines << "#define " << entry.first << " " << entry.second << "\n";
   }
-  fragmentShaderContent = defines.str() + fragmentShaderContent;
-  vertexShaderContent = defines.str() + vertexShaderContent;
+  fragmentShaderContent = InsertDefines(fragmentShaderContent, defines.str());
+  vertexShaderContent = InsertDefines(vertexShaderContent, defines.str());
 
   // Compiles shader code.
   GLuint vertexShader =
@@ -416,6 +445,24 @@ bool LoadObjFile(const std::string& file_name, AAssetManager* asset_manager,
   return true;
 }
 
+glm::mat4 MultiplyMatrices(const glm::mat4& a, const glm::mat4& b) {
+  return glm::mat4(glm::aligned_mat4(a) * glm::aligned_mat4(b));
+}
+
+glm::mat4 MultiplyMatrices(const glm::mat4& a, const glm::mat4& b,
+                           const glm::mat4& c) {
+  return glm::mat4(glm::aligned_mat4(a) * glm::aligned_mat4(b) *
+                   glm::aligned_mat4(c));
+}
+
+glm::mat4 InvertMatrix(const glm::mat4& matrix) {
+  return glm::mat4(glm::inverse(glm::aligned_mat4(matrix)));
+}
+
+glm::vec4 NormalizeVector(const glm::vec4& vector) {
+  return glm::vec4(glm::normalize(glm::aligned_vec4(vector)));
+}
+
 void Log4x4Matrix(const float raw_matrix[16]) {
   LOGI(
       "%f, %f, %f, %f\n"
@@ -86,6 +86,10 @@ class ScopedArPose {
 // @param operation, the name of the GL function call.
 void CheckGlError(const char* operation);
 
+// Returns true if the current OpenGL ES context exposes the extension |name|.
+// Must be called on the OpenGL thread.
+bool HasGlExtension(const char* name);
+
 // Throw a Java exception.
 //
 // @param env, the JNIEnv.
@@ -149,6 +153,16 @@ bool LoadObjFile(const std::string& file_name, AAssetManager* asset_manager,
                  std::vector<GLfloat>* out_uv,
                  std::vector<GLushort>* out_indices);
 
+// Matrix math through glm's aligned types, which GLM implements with NEON
+// (SSE on x86) intrinsics.  glm::mat4 and glm::vec4 stay packed so vertex
+// layouts do not change, which keeps their operators scalar; use these on the
+// per-draw and per-frame paths instead.
+glm::mat4 MultiplyMatrices(const glm::mat4& a, const glm::mat4& b);
+glm::mat4 MultiplyMatrices(const glm::mat4& a, const glm::mat4& b,
+                           const glm::mat4& c);
+glm::mat4 InvertMatrix(const glm::mat4& matrix);
+glm::vec4 NormalizeVector(const glm::vec4& vector);
+
 // Format and output the matrix to logcat file.
 // Note that this function output matrix in row major.
 void Log4x4Matrix(const float raw_matrix[16]);
@@ -35,6 +35,7 @@ import android.widget.Toast;
 import androidx.appcompat.app.AlertDialog;
 import androidx.appcompat.app.AppCompatActivity;
 import com.google.android.material.snackbar.Snackbar;
+import java.io.File;
 import javax.microedition.khronos.egl.EGLConfig;
 import javax.microedition.khronos.opengles.GL10;
 
@@ -49,8 +50,20 @@ public class HelloArActivity extends AppCompatActivity
   private static final int NUM_DEPTH_SETTINGS_CHECKBOXES = 2;
   private static final int NUM_INSTANT_PLACEMENT_SETTINGS_CHECKBOXES = 1;
 
+  /**
+   * Intent extra with the URI of an MP4 dataset to benchmark. The results are written to
+   * playback_benchmark.csv in the app's external files directory, e.g. with {@code adb shell am
+   * start -n com.google.ar.core.examples.c.helloarhardwarebuffer/.HelloArActivity --es
+   * benchmark_dataset_uri file:///sdcard/dataset.mp4}.
+   */
+  public static final String EXTRA_BENCHMARK_DATASET_URI = "benchmark_dataset_uri";
+
+  private static final String BENCHMARK_CSV_FILE_NAME = "playback_benchmark.csv";
+
   private GLSurfaceView surfaceView;
 
+  private boolean benchmarkRunning = false;
+
   private boolean viewportChanged = false;
   private int viewportWidth;
   private int viewportHeight;
@@ -122,7 +135,7 @@ public class HelloArActivity extends AppCompatActivity
 
     // Set up renderer.
     surfaceView.setPreserveEGLContextOnPause(true);
-    surfaceView.setEGLContextClientVersion(2);
+    surfaceView.setEGLContextClientVersion(3);
     surfaceView.setEGLConfigChooser(8, 8, 8, 8, 16, 0); // Alpha used for plane blending.
     surfaceView.setRenderer(this);
     surfaceView.setRenderMode(GLSurfaceView.RENDERMODE_CONTINUOUSLY);
@@ -131,6 +144,17 @@ public class HelloArActivity extends AppCompatActivity
     JniInterface.assetManager = getAssets();
     nativeApplication = JniInterface.createNativeApplication(getAssets());
 
+    String benchmarkDatasetUri = getIntent().getStringExtra(EXTRA_BENCHMARK_DATASET_URI);
+    if (benchmarkDatasetUri != null) {
+      File csvFile = new File(getExternalFilesDir(null), BENCHMARK_CSV_FILE_NAME);
+      benchmarkRunning =
+          JniInterface.startPlaybackBenchmark(
+              nativeApplication, benchmarkDatasetUri, csvFile.getAbsolutePath());
+      if (!benchmarkRunning) {
+        Log.e(TAG, "Could not start the playback benchmark");
+      }
+    }
+
     planeStatusCheckingHandler = new Handler();
 
     depthSettings.onCreate(this);
@@ -260,6 +284,11 @@ public class HelloArActivity extends AppCompatActivity
           nativeApplication,
           depthSettings.depthColorVisualizationEnabled(),
           depthSettings.useDepthForOcclusion());
+      if (benchmarkRunning && JniInterface.isPlaybackBenchmarkFinished(nativeApplication)) {
+        benchmarkRunning = false;
+        Log.i(TAG, "Playback benchmark finished");
+        runOnUiThread(this::finish);
+      }
     }
   }
 
@@ -66,6 +66,17 @@ public class JniInterface {
   public static native void onSettingsChange(
       long nativeApplication, boolean isInstantPlacementEnabled);
 
+  /**
+   * Plays back an MP4 dataset instead of the live camera and writes per-frame timings to a CSV
+   * file. Must be called before the first onResume. Returns false if the CSV file cannot be
+   * created.
+   */
+  public static native boolean startPlaybackBenchmark(
+      long nativeApplication, String datasetUri, String csvPath);
+
+  /** Returns true once the playback benchmark reached the end of the dataset. */
+  public static native boolean isPlaybackBenchmarkFinished(long nativeApplication);
+
   public static Bitmap loadImage(String imageName) {
 
     try {
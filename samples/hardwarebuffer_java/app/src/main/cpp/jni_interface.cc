@@ -40,6 +40,10 @@ extern "C" {
 namespace {
 // maintain a reference to the JVM and OpenGlHelper so we can use it later.
 static JavaVM *g_vm = nullptr;
+
+// The JNIEnv of the current thread, so that GetJniEnv() only goes through
+// the JVM on a thread's first call.
+thread_local JNIEnv *t_env = nullptr;
 static hello_ar::OpenGlHelper *opengl_helper = nullptr;
 }  // namespace
 
@@ -49,37 +53,31 @@ jint JNI_OnLoad(JavaVM *vm, void *) {
   return JNI_VERSION_1_6;
 }
 
-JNI_METHOD(jlong, createEglImage)
-(JNIEnv *env, jclass, jobject hardware_buffer) {
+JNI_METHOD(jboolean, updateCameraTexture)
+(JNIEnv *env, jclass, jobject hardware_buffer, jint texture_id) {
 #if (__ANDROID_API__ >= 26)
-  EGLImageKHR image = opengl_helper->CreateEglImage(
-      AHardwareBuffer_fromHardwareBuffer(env, hardware_buffer));
-
-  return image == EGL_NO_IMAGE ? 0 : reinterpret_cast<intptr_t>(image);
+  return opengl_helper->UpdateCameraTexture(
+      AHardwareBuffer_fromHardwareBuffer(env, hardware_buffer), texture_id);
 #else
   jclass jcls = env->FindClass("java/lang/UnsupportedOperationException");
   env->ThrowNew(jcls,
                 "Hardware Buffer is not supported on compiled NDK level.");
-  return 0;
+  return false;
 #endif
 }
 
-JNI_METHOD(void, destroyEglImage)
-(JNIEnv *env, jclass, jlong image_address) {
-  if (image_address == 0) return;
-  opengl_helper->DestroyEglImage(reinterpret_cast<EGLImageKHR>(image_address));
-}
-
-JNI_METHOD(void, bindEglImageToTexture)
-(JNIEnv *env, jclass, jlong image_address, jlong texture_id) {
-  opengl_helper->BindEglImageToTexture(
-      reinterpret_cast<EGLImageKHR>(image_address), texture_id);
-}
+JNI_METHOD(void, clearCameraTextureCache)
+(JNIEnv *env, jclass) { opengl_helper->ClearCameraTextureCache(); }
 
 JNIEnv *GetJniEnv() {
-  JNIEnv *env;
-  jint result = g_vm->AttachCurrentThread(&env, nullptr);
-  return result == JNI_OK ? env : nullptr;
+  if (t_env == nullptr) {
+    JNIEnv *env = nullptr;
+    if (g_vm->AttachCurrentThread(&env, nullptr) != JNI_OK) {
+      return nullptr;
+    }
+    t_env = env;
+  }
+  return t_env;
 }
 
 jclass FindClass(const char *classname) {
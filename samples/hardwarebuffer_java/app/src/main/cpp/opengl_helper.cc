@@ -25,6 +25,7 @@
 #include <GLES3/gl3.h>
 #include <android/asset_manager.h>
 
+#include <algorithm>
 #include <array>
 #include <cstdint>
 
@@ -53,7 +54,9 @@ OpenGlHelper::OpenGlHelper() {
   }
 }
 
-OpenGlHelper::~OpenGlHelper() {}
+constexpr size_t OpenGlHelper::kMaxCachedImages;
+
+OpenGlHelper::~OpenGlHelper() { ClearCameraTextureCache(); }
 
 EGLImageKHR OpenGlHelper::CreateEglImage(AHardwareBuffer* buffer) {
   if (eglGetNativeClientBufferANDROID == nullptr) {
@@ -85,4 +88,58 @@ void OpenGlHelper::BindEglImageToTexture(EGLImageKHR image,
   util::CheckGlError("glBindTexture(GL_TEXTURE_EXTERNAL_OES, 0)");
 }
 
+bool OpenGlHelper::UpdateCameraTexture(AHardwareBuffer* buffer,
+                                       uint32_t texture_oes_id) {
+  if (buffer == nullptr) {
+    return false;
+  }
+  if (buffer == bound_buffer_ && texture_oes_id == bound_texture_id_) {
+    return true;
+  }
+
+  ++use_count_;
+  auto cached = std::find_if(
+      cached_images_.begin(), cached_images_.end(),
+      [buffer](const CachedImage& entry) { return entry.buffer == buffer; });
+  if (cached == cached_images_.end()) {
+    EGLImageKHR image = CreateEglImage(buffer);
+    if (image == EGL_NO_IMAGE) {
+      LOGE("Failed to create egl image ");
+      return false;
+    }
+    if (cached_images_.size() >= kMaxCachedImages) {
+      auto oldest = std::min_element(
+          cached_images_.begin(), cached_images_.end(),
+          [](const CachedImage& a, const CachedImage& b) {
+            return a.last_used < b.last_used;
+          });
+      if (oldest->buffer == bound_buffer_) {
+        bound_buffer_ = nullptr;
+      }
+      DestroyEglImage(oldest->image);
+      AHardwareBuffer_release(oldest->buffer);
+      cached_images_.erase(oldest);
+    }
+    AHardwareBuffer_acquire(buffer);
+    cached_images_.push_back({buffer, image, use_count_});
+    cached = cached_images_.end() - 1;
+  }
+  cached->last_used = use_count_;
+
+  BindEglImageToTexture(cached->image, texture_oes_id);
+  bound_buffer_ = buffer;
+  bound_texture_id_ = texture_oes_id;
+  return true;
+}
+
+void OpenGlHelper::ClearCameraTextureCache() {
+  for (const CachedImage& entry : cached_images_) {
+    DestroyEglImage(entry.image);
+    AHardwareBuffer_release(entry.buffer);
+  }
+  cached_images_.clear();
+  bound_buffer_ = nullptr;
+  bound_texture_id_ = 0;
+}
+
 }  // namespace hello_ar
@@ -24,12 +24,15 @@
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
 #include <android/asset_manager.h>
+#include <android/hardware_buffer.h>
 #include <jni.h>
 
+#include <cstdint>
 #include <memory>
 #include <set>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "util.h"
 
@@ -57,6 +60,38 @@ class OpenGlHelper {
   // @param image, the Egl image.
   // @param texture_oes_id, id of the external OES texture.
   void BindEglImageToTexture(EGLImageKHR image, uint32_t texture_oes_id);
+
+  // Attaches the camera image in |buffer| to the external OES texture.
+  //
+  // EGL images are cached per hardware buffer, so the small set of buffers
+  // ARCore cycles through each get their image once, and the texture is only
+  // rebound when the buffer changed.  Must be called on the OpenGL thread.
+  //
+  // @param buffer, the hardware buffer of the current frame.
+  // @param texture_oes_id, id of the external OES texture.
+  // @return false if no Egl image could be created for the buffer.
+  bool UpdateCameraTexture(AHardwareBuffer* buffer, uint32_t texture_oes_id);
+
+  // Destroys the cached Egl images and releases their hardware buffers, e.g.
+  // when the OpenGL context was recreated.  Must be called on the OpenGL
+  // thread.
+  void ClearCameraTextureCache();
+
+ private:
+  // Maximum number of cached hardware buffers.
+  static constexpr size_t kMaxCachedImages = 8;
+
+  struct CachedImage {
+    // Holds a reference, so the pointer identifies the buffer while cached.
+    AHardwareBuffer* buffer;
+    EGLImageKHR image;
+    uint64_t last_used;
+  };
+
+  std::vector<CachedImage> cached_images_;
+  uint64_t use_count_ = 0;
+  AHardwareBuffer* bound_buffer_ = nullptr;
+  uint32_t bound_texture_id_ = 0;
 };
 }  // namespace hello_ar
 
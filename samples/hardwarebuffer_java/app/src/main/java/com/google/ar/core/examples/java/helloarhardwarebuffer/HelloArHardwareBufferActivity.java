@@ -167,8 +167,6 @@ public class HelloArHardwareBufferActivity extends AppCompatActivity
   private Texture dfgTexture;
   private SpecularCubemapFilter cubemapFilter;
 
-  private long imageAddress = 0;
-
   // Temporary matrix allocated here to reduce number of allocations for each frame.
   private final float[] modelMatrix = new float[16];
   private final float[] viewMatrix = new float[16];
@@ -347,6 +345,9 @@ public class HelloArHardwareBufferActivity extends AppCompatActivity
 
   @Override
   public void onSurfaceCreated(SampleRender render) {
+    // EGL images cached for the textures of a previous context are stale.
+    JniInterface.clearCameraTextureCache();
+
     // Prepare the rendering objects. This involves reading shaders and 3D model files, so may throw
     // an IOException.
     try {
@@ -508,14 +509,11 @@ public class HelloArHardwareBufferActivity extends AppCompatActivity
       return;
     }
 
-    if (imageAddress != 0) {
-      JniInterface.destroyEglImage(imageAddress);
+    if (!JniInterface.updateCameraTexture(
+        hardwareBuffer, backgroundRenderer.getCameraColorTexture().getTextureId())) {
+      return;
     }
 
-    imageAddress = JniInterface.createEglImage(hardwareBuffer);
-    JniInterface.bindEglImageToTexture(
-        imageAddress, backgroundRenderer.getCameraColorTexture().getTextureId());
-
     if (camera.getTrackingState() == TrackingState.TRACKING
         && (depthSettings.useDepthForOcclusion()
             || depthSettings.depthColorVisualizationEnabled())) {
@@ -23,9 +23,14 @@ public class JniInterface {
 
   private static final String TAG = "JniInterface";
 
-  public static native long createEglImage(Object buffer);
+  /**
+   * Attaches the camera image in {@code buffer} to the external OES texture {@code textureId}.
+   * EGL images are cached natively per hardware buffer, so this is the only call needed per frame.
+   *
+   * @return false if the buffer could not be attached.
+   */
+  public static native boolean updateCameraTexture(Object buffer, int textureId);
 
-  public static native void destroyEglImage(long imageAddress);
-
-  public static native void bindEglImageToTexture(long imageAddress, long textureId);
+  /** Drops the cached EGL images, e.g. when the GL context was recreated. Call on the GL thread. */
+  public static native void clearCameraTextureCache();
 }
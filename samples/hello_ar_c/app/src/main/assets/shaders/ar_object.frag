@@ -14,33 +14,95 @@
  * limitations under the License.
  */
 
+#ifdef GL_EXT_shader_texture_lod
+#extension GL_EXT_shader_texture_lod : enable
+#endif
+
 precision mediump float;
 
 uniform sampler2D u_Texture;
 
-uniform vec4 u_LightingParameters;
 uniform vec4 u_MaterialParameters;
 uniform vec4 u_ColorCorrectionParameters;
 
+// Environmental HDR lighting, see EnvironmentalHdrLighting.  Replaces the
+// directional light and the color correction while set.
+uniform bool u_UseEnvironmentalHdr;
+uniform samplerCube u_EnvironmentCubemap;
+// Level of u_EnvironmentCubemap prefiltered for the material's roughness.
+uniform float u_EnvironmentLevel;
+uniform vec3 u_SphericalHarmonics[9];
+// Shared with ar_object.vert, so it needs the same precision.
+uniform highp mat4 u_View;
+
 #if USE_DEPTH_FOR_OCCLUSION
 uniform sampler2D u_DepthTexture;
 uniform mat3 u_DepthUvTransform;
 uniform float u_DepthAspectRatio;
+// Depth samples whose confidence, in the green component of the depth texture,
+// is below this do not occlude.  Zero for depth without confidence.
+uniform float u_DepthConfidenceThreshold;
+// Coarse min and max depth, see DepthPyramidTexture.  Only read while
+// u_UseDepthPyramid is set.
+uniform bool u_UseDepthPyramid;
+uniform sampler2D u_DepthPyramid;
+uniform vec2 u_DepthTextureSize;
+// Depth texels a side covered by one pyramid texel (x), and the size of the
+// pyramid level (yz).
+uniform vec3 u_DepthPyramidLayout;
+// Depth blurred once per depth image, see OcclusionBlurTexture.  Only read
+// while u_UseOcclusionBlur is set, and replaces the blurred comparison.
+uniform bool u_UseOcclusionBlur;
+uniform sampler2D u_OcclusionBlur;
 #endif // USE_DEPTH_FOR_OCCLUSION
 
+#if USE_OCCLUSION_MASK
+// Visibility resolved at reduced resolution by occlusion_mask.frag.
+uniform sampler2D u_OcclusionMask;
+#endif // USE_OCCLUSION_MASK
+
 varying vec3 v_ViewPosition;
 varying vec3 v_ViewNormal;
 varying vec2 v_TexCoord;
 varying vec3 v_ScreenSpacePosition;
-uniform vec4 u_ObjColor;
+varying vec3 v_ViewLightDirection;
+varying vec4 v_ObjColor;
+
+// The view matrix is rigid, so its transposed rotation takes view space
+// directions back to world space.
+vec3 ViewToWorldDirection(in vec3 direction) {
+  return vec3(dot(u_View[0].xyz, direction), dot(u_View[1].xyz, direction),
+              dot(u_View[2].xyz, direction));
+}
+
+vec3 GetIrradiance(in vec3 n) {
+  vec3 irradiance = u_SphericalHarmonics[0] + u_SphericalHarmonics[1] * n.y +
+                    u_SphericalHarmonics[2] * n.z +
+                    u_SphericalHarmonics[3] * n.x +
+                    u_SphericalHarmonics[4] * (n.y * n.x) +
+                    u_SphericalHarmonics[5] * (n.y * n.z) +
+                    u_SphericalHarmonics[6] * (3.0 * n.z * n.z - 1.0) +
+                    u_SphericalHarmonics[7] * (n.z * n.x) +
+                    u_SphericalHarmonics[8] * (n.x * n.x - n.y * n.y);
+  return max(irradiance, 0.0);
+}
+
+vec3 GetEnvironmentRadiance(in vec3 direction) {
+#ifdef GL_EXT_shader_texture_lod
+  return textureCubeLodEXT(u_EnvironmentCubemap, direction,
+                           u_EnvironmentLevel).rgb;
+#else
+  // Only biases the level picked from the derivatives, which is close to 0
+  // for a cubemap this small.
+  return textureCube(u_EnvironmentCubemap, direction, u_EnvironmentLevel).rgb;
+#endif
+}
 
 #if USE_DEPTH_FOR_OCCLUSION
 
 float DepthGetMillimeters(in sampler2D depth_texture, in vec2 depth_uv) {
-  // Depth is packed into the red and green components of its texture.
-  // The texture is a normalized format, storing millimeters.
-  vec3 packedDepthAndVisibility = texture2D(depth_texture, depth_uv).xyz;
-  return dot(packedDepthAndVisibility.xy, vec2(255.0, 256.0 * 255.0));
+  // Depth is stored in meters in the red component of its texture.
+  return texture2D(depth_texture, depth_uv).r * 1000.0;
 }
 
 // Returns linear interpolation position of value between min and max bounds.
@@ -54,6 +116,10 @@ float DepthInverseLerp(in float value, in float min_bound, in float max_bound) {
 // depth map.
 float DepthGetVisibility(in sampler2D depth_texture, in vec2 depth_uv,
                          in float asset_depth_mm) {
+  float depth_confidence = texture2D(depth_texture, depth_uv).g;
+  if (depth_confidence < u_DepthConfidenceThreshold) {
+    return 1.0;
+  }
   float depth_mm = DepthGetMillimeters(depth_texture, depth_uv);
 
   // Instead of a hard z-buffer test, allow the asset to fade into the
@@ -132,6 +198,74 @@ float DepthGetBlurredVisibilityAroundUV(in sampler2D depth_texture, in vec2 uv,
   return sum / kKernelTotalWeights;
 }
 
+// Approximates DepthGetBlurredVisibilityAroundUV() with one lookup of the
+// precomputed blur.  The kernel's depth is summarized by its mean and spread
+// and the share of it that can occlude, and the asset fades out over the
+// depth tolerance widened by that spread.
+float DepthGetPrecomputedVisibility(in vec2 uv, in float asset_depth_mm) {
+  // Mean depth and standard deviation in meters and the occluding share,
+  // the first two premultiplied by the last.
+  vec3 blurred = texture2D(u_OcclusionBlur, uv).rgb;
+  if (blurred.z <= 0.0) {
+    return 1.0;
+  }
+  float mean_mm = blurred.x / blurred.z * 1000.0;
+  float deviation_mm = blurred.y / blurred.z * 1000.0;
+
+  // A ramp with the variance of the per-sample ramp of DepthGetVisibility()
+  // over depth spread by deviation_mm.
+  const float kDepthTolerancePerMm = 0.015;
+  float tolerance_mm = kDepthTolerancePerMm * asset_depth_mm;
+  float half_width_mm = sqrt(tolerance_mm * tolerance_mm +
+                             3.0 * deviation_mm * deviation_mm);
+  float visibility_occlusion = clamp(
+      0.5 * (mean_mm - asset_depth_mm) / half_width_mm + 0.5, 0.0, 1.0);
+  return mix(1.0, visibility_occlusion, blurred.z);
+}
+
+// Min (x) and max (y) depth of the pyramid texel covering depth_uv.
+vec2 DepthGetCoarseMinMax(in vec2 depth_uv) {
+  vec2 depth_texel = clamp(floor(depth_uv * u_DepthTextureSize), vec2(0.0),
+                           u_DepthTextureSize - 1.0);
+  // The last pyramid texel also covers the remainder of the depth texture.
+  vec2 pyramid_texel = min(floor(depth_texel / u_DepthPyramidLayout.x),
+                           u_DepthPyramidLayout.yz - 1.0);
+  vec2 pyramid_uv = (pyramid_texel + 0.5) / u_DepthPyramidLayout.yz;
+  vec4 packed_min_max = texture2D(u_DepthPyramid, pyramid_uv);
+  return vec2(dot(packed_min_max.xy, vec2(255.0, 256.0 * 255.0)),
+              dot(packed_min_max.zw, vec2(255.0, 256.0 * 255.0)));
+}
+
+// Returns the visibility DepthGetBlurredVisibilityAroundUV() would, if the
+// coarse min and max depth of the area it reads already decide it, or -1.0.
+// A pyramid texel covers the whole area, so its four corners find every
+// texel that overlaps it.
+float DepthGetCoarseVisibility(in vec2 uv, in float asset_depth_mm) {
+  const float kOcclusionBlurAmount = 0.01;
+  vec2 extent = 2.0 * vec2(kOcclusionBlurAmount,
+                           kOcclusionBlurAmount * u_DepthAspectRatio) +
+                1.0 / u_DepthTextureSize;
+  vec2 min_max_00 = DepthGetCoarseMinMax(uv - extent);
+  vec2 min_max_10 = DepthGetCoarseMinMax(uv + vec2(extent.x, -extent.y));
+  vec2 min_max_01 = DepthGetCoarseMinMax(uv + vec2(-extent.x, extent.y));
+  vec2 min_max_11 = DepthGetCoarseMinMax(uv + extent);
+  float min_mm = min(min(min_max_00.x, min_max_10.x),
+                     min(min_max_01.x, min_max_11.x));
+  float max_mm = max(max(min_max_00.y, min_max_10.y),
+                     max(min_max_01.y, min_max_11.y));
+
+  // The bounds of DepthGetVisibility().
+  const float kDepthTolerancePerMm = 0.015;
+  if (min_mm >= asset_depth_mm * (1.0 + kDepthTolerancePerMm)) {
+    return 1.0;
+  }
+  if (min_mm >= 200.0 && max_mm <= 7500.0 &&
+      max_mm <= asset_depth_mm * (1.0 - kDepthTolerancePerMm)) {
+    return 0.0;
+  }
+  return -1.0;
+}
+
 #endif // USE_DEPTH_FOR_OCCLUSION
 
 void main() {
@@ -141,7 +275,7 @@ void main() {
     const float kMiddleGrayGamma = 0.466;
 
     // Unpack lighting and material parameters for better naming.
-    vec3 viewLightDirection = u_LightingParameters.xyz;
+    vec3 viewLightDirection = normalize(v_ViewLightDirection);
     vec3 colorShift = u_ColorCorrectionParameters.rgb;
     float averagePixelIntensity = u_ColorCorrectionParameters.a;
 
@@ -157,10 +291,10 @@ void main() {
     // Flip the y-texture coordinate to address the texture from top-left.
     vec4 objectColor = texture2D(u_Texture, vec2(v_TexCoord.x, 1.0 - v_TexCoord.y));
 
-    // Apply color to grayscale image only if the alpha of u_ObjColor is
+    // Apply color to grayscale image only if the alpha of v_ObjColor is
     // greater and equal to 255.0.
-    objectColor.rgb *= mix(vec3(1.0), u_ObjColor.rgb / 255.0,
-                           step(255.0, u_ObjColor.a));
+    objectColor.rgb *= mix(vec3(1.0), v_ObjColor.rgb / 255.0,
+                           step(255.0, v_ObjColor.a));
 
     // Apply inverse SRGB gamma to the texture before making lighting calculations.
     objectColor.rgb = pow(objectColor.rgb, vec3(kInverseGamma));
@@ -181,10 +315,21 @@ void main() {
             pow(specularStrength, materialSpecularPower);
 
     vec3 color = objectColor.rgb * (ambient + diffuse) + specular;
+    if (u_UseEnvironmentalHdr) {
+      // The estimate is in linear HDR and already carries the light's color
+      // and intensity.
+      vec3 irradiance = GetIrradiance(ViewToWorldDirection(viewNormal));
+      vec3 radiance = GetEnvironmentRadiance(ViewToWorldDirection(
+          reflect(viewFragmentDirection, viewNormal)));
+      color = objectColor.rgb * (ambient + materialDiffuse * irradiance) +
+              objectColor.a * materialSpecular * radiance;
+    }
     // Apply SRGB gamma before writing the fragment color.
     color.rgb = pow(color, vec3(kGamma));
-    // Apply average pixel intensity and color shift
-    color *= colorShift * (averagePixelIntensity / kMiddleGrayGamma);
+    if (!u_UseEnvironmentalHdr) {
+      // Apply average pixel intensity and color shift
+      color *= colorShift * (averagePixelIntensity / kMiddleGrayGamma);
+    }
     gl_FragColor.rgb = color;
     gl_FragColor.a = objectColor.a;
 
@@ -197,6 +342,21 @@ void main() {
     // The following step is very costly. Replace the last line with the
     // commented line if it's too expensive.
     // gl_FragColor *= DepthGetVisibility(u_DepthTexture, depth_uvs, asset_depth_mm);
-    gl_FragColor *= DepthGetBlurredVisibilityAroundUV(u_DepthTexture, depth_uvs, asset_depth_mm);
+    float visibility = -1.0;
+    if (u_UseOcclusionBlur) {
+      visibility = DepthGetPrecomputedVisibility(depth_uvs, asset_depth_mm);
+    } else if (u_UseDepthPyramid) {
+      visibility = DepthGetCoarseVisibility(depth_uvs, asset_depth_mm);
+    }
+    if (visibility < 0.0) {
+      visibility = DepthGetBlurredVisibilityAroundUV(u_DepthTexture, depth_uvs,
+                                                     asset_depth_mm);
+    }
+    gl_FragColor *= visibility;
 #endif // USE_DEPTH_FOR_OCCLUSION
+
+#if USE_OCCLUSION_MASK
+    gl_FragColor *= texture2D(u_OcclusionMask,
+                              v_ScreenSpacePosition.xy * 0.5 + 0.5).r;
+#endif // USE_OCCLUSION_MASK
 }
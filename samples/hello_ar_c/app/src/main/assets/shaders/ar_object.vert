@@ -14,22 +14,50 @@
  * limitations under the License.
  */
 
-uniform mat4 u_ModelView;
-uniform mat4 u_ModelViewProjection;
+uniform mat4 u_View;
+uniform mat4 u_Projection;
+// Light direction in model space.
+uniform vec4 u_LightDirection;
+// Bounding box of the mesh decoding the quantized positions.
+uniform vec3 u_PositionOffset;
+uniform vec3 u_PositionScale;
 
+// Unsigned normalized position in the bounding box.
 attribute vec4 a_Position;
-attribute vec3 a_Normal;
+// Octahedral encoded normal.
+attribute vec2 a_Normal;
 attribute vec2 a_TexCoord;
 
+// Per-instance attributes, advanced once per drawn copy of the model.
+attribute mat4 a_ModelMatrix;
+attribute vec4 a_ObjColor;
+
 varying vec3 v_ViewPosition;
 varying vec3 v_ViewNormal;
 varying vec2 v_TexCoord;
 varying vec3 v_ScreenSpacePosition;
+varying vec3 v_ViewLightDirection;
+varying vec4 v_ObjColor;
+
+vec3 DecodeOctahedral(vec2 encoded) {
+    vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    // Folds the lower half back from the corners.
+    float fold = max(-normal.z, 0.0);
+    normal.x += normal.x >= 0.0 ? -fold : fold;
+    normal.y += normal.y >= 0.0 ? -fold : fold;
+    return normal;
+}
 
 void main() {
-    v_ViewPosition = (u_ModelView * a_Position).xyz;
-    v_ViewNormal = normalize((u_ModelView * vec4(a_Normal, 0.0)).xyz);
+    mat4 modelView = u_View * a_ModelMatrix;
+    vec4 position = vec4(u_PositionOffset + u_PositionScale * a_Position.xyz,
+                         1.0);
+    v_ViewPosition = (modelView * position).xyz;
+    v_ViewNormal =
+        normalize((modelView * vec4(DecodeOctahedral(a_Normal), 0.0)).xyz);
+    v_ViewLightDirection = normalize((modelView * u_LightDirection).xyz);
+    v_ObjColor = a_ObjColor;
     v_TexCoord = a_TexCoord;
-    gl_Position = u_ModelViewProjection * a_Position;
+    gl_Position = u_Projection * vec4(v_ViewPosition, 1.0);
     v_ScreenSpacePosition = gl_Position.xyz / gl_Position.w;
 }
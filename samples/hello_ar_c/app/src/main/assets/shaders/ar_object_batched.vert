@@ -0,0 +1,49 @@
+#version 300 es
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+uniform mat4 u_View;
+uniform mat4 u_Projection;
+// Light direction in model space.
+uniform vec4 u_LightDirection;
+
+in vec4 a_Position;
+in vec3 a_Normal;
+in vec2 a_TexCoord;
+
+// Per-instance attributes, advanced once per drawn copy of a model.
+in mat4 a_ModelMatrix;
+in vec4 a_ObjColor;
+// Layer of the bound array texture holding the model's albedo.
+in float a_Layer;
+
+out vec3 v_ViewPosition;
+out vec3 v_ViewNormal;
+out vec2 v_TexCoord;
+out vec3 v_ViewLightDirection;
+out vec4 v_ObjColor;
+flat out float v_Layer;
+
+void main() {
+  mat4 modelView = u_View * a_ModelMatrix;
+  v_ViewPosition = (modelView * a_Position).xyz;
+  v_ViewNormal = normalize((modelView * vec4(a_Normal, 0.0)).xyz);
+  v_ViewLightDirection = normalize((modelView * u_LightDirection).xyz);
+  v_ObjColor = a_ObjColor;
+  v_TexCoord = a_TexCoord;
+  v_Layer = a_Layer;
+  gl_Position = u_Projection * vec4(v_ViewPosition, 1.0);
+}
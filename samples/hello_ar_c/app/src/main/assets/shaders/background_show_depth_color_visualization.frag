@@ -24,11 +24,9 @@ varying vec2 v_TexCoord;
 const float kMidDepthMeters = 8.0;
 const float kMaxDepthMeters = 30.0;
 
-float DepthGetMillimeters(in sampler2D depth_texture, in vec2 depth_uv) {
-  // Depth is packed into the red and green components of its texture.
-  // The texture is a normalized format, storing millimeters.
-  vec3 packedDepthAndVisibility = texture2D(depth_texture, depth_uv).xyz;
-  return dot(packedDepthAndVisibility.xy, vec2(255.0, 256.0 * 255.0));
+float DepthGetMeters(in sampler2D depth_texture, in vec2 depth_uv) {
+  // Depth is stored in meters in the red component of its texture.
+  return texture2D(depth_texture, depth_uv).r;
 }
 
 // Returns linear interpolation position of value between min and max bounds.
@@ -46,8 +44,7 @@ vec3 DepthGetColorVisualization(in float x) {
 void main() {
   // Interpolating in units of meters is more stable, due to limited floating
   // point precision on GPU.
-  float depth_mm = DepthGetMillimeters(u_DepthTexture, v_TexCoord.xy);
-  float depth_meters = depth_mm * 0.001;
+  float depth_meters = DepthGetMeters(u_DepthTexture, v_TexCoord.xy);
 
   // Selects the portion of the color palette to use.
   float normalized_depth = 0.0;
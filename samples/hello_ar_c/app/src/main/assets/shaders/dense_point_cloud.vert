@@ -0,0 +1,59 @@
+#version 300 es
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Draws one point per depth texel, unprojected into world space, without any
+// vertex attributes.  gl_VertexID selects the texel.
+
+uniform mat4 u_ModelViewProjection;
+uniform sampler2D u_DepthTexture;
+// Width and height of the depth texture in texels.
+uniform ivec2 u_DepthSize;
+// Focal length (xy) and principal point (zw) in depth texels.
+uniform vec4 u_DepthIntrinsics;
+// Texels with a lower confidence are dropped.  Only raw depth textures carry
+// a confidence, in the green channel.
+uniform float u_DepthConfidenceThreshold;
+uniform float u_MaxDepthMm;
+uniform vec4 u_Color;
+uniform float u_PointSize;
+
+out vec4 v_Color;
+
+void main() {
+  ivec2 texel = ivec2(gl_VertexID % u_DepthSize.x, gl_VertexID / u_DepthSize.x);
+  // Meters and confidence, see Texture.
+  vec2 depth_and_confidence = texelFetch(u_DepthTexture, texel, 0).xy;
+  float depth_mm = depth_and_confidence.x * 1000.0;
+  if (depth_mm <= 0.0 || depth_mm > u_MaxDepthMm ||
+      depth_and_confidence.y < u_DepthConfidenceThreshold) {
+    // Outside of the clip volume, so the point is culled.
+    gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+    gl_PointSize = 0.0;
+    v_Color = vec4(0.0);
+    return;
+  }
+
+  float depth_m = depth_mm * 0.001;
+  vec2 image_xy = (vec2(texel) - u_DepthIntrinsics.zw) /
+                  u_DepthIntrinsics.xy * depth_m;
+  // Image rows grow downwards and the camera looks along -z.
+  vec4 camera_position = vec4(image_xy.x, -image_xy.y, -depth_m, 1.0);
+
+  v_Color = u_Color;
+  gl_Position = u_ModelViewProjection * camera_position;
+  gl_PointSize = u_PointSize;
+}
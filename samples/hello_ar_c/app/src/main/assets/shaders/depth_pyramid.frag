@@ -0,0 +1,85 @@
+#version 300 es
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Reduces one level of the min/max depth pyramid, see DepthPyramidTexture.
+precision highp float;
+
+// The depth texture for the first level, the previous level otherwise, as
+// the only level that can be sampled.
+uniform sampler2D u_Source;
+uniform bool u_FromDepth;
+uniform ivec2 u_DestinationSize;
+// Depth samples whose confidence, in the green component of the depth texture,
+// is below this count as unknown.  Zero for depth without confidence.
+uniform float u_DepthConfidenceThreshold;
+
+out vec4 o_MinMax;
+
+// Unknown depth never occludes, so it is the farthest depth in both the min
+// and the max.
+const float kUnknownDepthMm = 65535.0;
+
+float DecodeMillimeters(in vec2 packed_depth) {
+  return dot(packed_depth, vec2(255.0, 256.0 * 255.0));
+}
+
+vec2 EncodeMillimeters(in float depth_mm) {
+  float high = floor(depth_mm / 256.0);
+  return vec2(depth_mm - high * 256.0, high) / 255.0;
+}
+
+// Min and max depth of one source texel.
+vec2 ReadMinMax(in ivec2 texel) {
+  vec4 source = texelFetch(u_Source, texel, 0);
+  if (u_FromDepth) {
+    // Meters and confidence, see Texture.  Rounded to millimeters like the
+    // depth image, which the 16 bits of the pyramid levels hold exactly.
+    float depth_mm = min(floor(source.x * 1000.0 + 0.5), kUnknownDepthMm);
+    if (depth_mm <= 0.0 || source.y < u_DepthConfidenceThreshold) {
+      depth_mm = kUnknownDepthMm;
+    }
+    return vec2(depth_mm);
+  }
+  return vec2(DecodeMillimeters(source.xy), DecodeMillimeters(source.zw));
+}
+
+void main() {
+  ivec2 destination = ivec2(gl_FragCoord.xy);
+  ivec2 source_size = textureSize(u_Source, 0);
+  ivec2 first = 2 * destination;
+  // The last row and column also cover the odd one out of the source.
+  ivec2 last = min(first + 1, source_size - 1);
+  if (destination.x == u_DestinationSize.x - 1) {
+    last.x = source_size.x - 1;
+  }
+  if (destination.y == u_DestinationSize.y - 1) {
+    last.y = source_size.y - 1;
+  }
+
+  vec2 min_max = vec2(kUnknownDepthMm, 0.0);
+  for (int y = 0; y < 3; ++y) {
+    for (int x = 0; x < 3; ++x) {
+      ivec2 texel = first + ivec2(x, y);
+      if (texel.x <= last.x && texel.y <= last.y) {
+        vec2 texel_min_max = ReadMinMax(texel);
+        min_max = vec2(min(min_max.x, texel_min_max.x),
+                       max(min_max.y, texel_min_max.y));
+      }
+    }
+  }
+  o_MinMax = vec4(EncodeMillimeters(min_max.x), EncodeMillimeters(min_max.y));
+}
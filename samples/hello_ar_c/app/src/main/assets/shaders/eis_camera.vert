@@ -0,0 +1,34 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Draws the warp mesh of the stabilized camera image, see
+// BackgroundRenderer::EisWarp.
+attribute vec3 a_Position;
+// Homogeneous texture coordinates, which keep the perspective of the
+// stabilization.
+attribute vec3 a_TexCoord;
+
+// Moves the mesh the way BackgroundRenderer::SetReprojection() moves the
+// camera image.
+uniform mat3 u_ScreenWarp;
+
+varying vec3 v_TexCoord;
+
+void main() {
+   vec3 position = u_ScreenWarp * vec3(a_Position.xy, 1.0);
+   gl_Position = vec4(position.xy / position.z, a_Position.z, 1.0);
+   v_TexCoord = a_TexCoord;
+}
@@ -0,0 +1,38 @@
+#version 300 es
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+precision mediump float;
+
+in vec3 v_Normal;
+in vec2 v_TexCoord;
+
+out vec4 o_FragColor;
+
+// Straight alpha color of the mesh and its texture coordinate grid.
+const vec4 kFaceColor = vec4(0.3, 0.75, 0.95, 0.35);
+const vec4 kGridColor = vec4(1.0, 1.0, 1.0, 0.7);
+const float kGridCells = 24.0;
+
+void main() {
+  // Lit from above, since the view direction is not known here.
+  float shade = 0.6 + 0.4 * normalize(v_Normal).y;
+  // Lines along the texture coordinates show how the mesh deforms.
+  vec2 cell = fract(v_TexCoord * kGridCells);
+  float line = step(min(cell.x, cell.y), 0.06);
+  vec4 color = mix(kFaceColor, kGridColor, line);
+  o_FragColor = vec4(color.rgb * shade * color.a, color.a);
+}
@@ -0,0 +1,34 @@
+#version 300 es
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+uniform mat4 u_Model;
+uniform mat4 u_ViewProjection;
+
+// In the space of the face center pose.
+in vec3 a_Position;
+in vec3 a_Normal;
+in vec2 a_TexCoord;
+
+out vec3 v_Normal;
+out vec2 v_TexCoord;
+
+void main() {
+  // The center pose is rigid, so it also rotates the normals.
+  v_Normal = mat3(u_Model) * a_Normal;
+  v_TexCoord = a_TexCoord;
+  gl_Position = u_ViewProjection * u_Model * vec4(a_Position, 1.0);
+}
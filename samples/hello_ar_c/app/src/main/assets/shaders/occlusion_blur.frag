@@ -0,0 +1,89 @@
+#version 300 es
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// One pass of the separable occlusion blur, see OcclusionBlurTexture.
+precision highp float;
+
+// The depth texture for the horizontal pass, the horizontal result for the
+// vertical pass.  Both have the size of the destination.
+uniform sampler2D u_Source;
+uniform bool u_FromDepth;
+// Texture coordinate step between two of the five taps.
+uniform vec2 u_Step;
+// Depth samples whose confidence, in the green component of the depth texture,
+// is below this do not occlude.  Zero for depth without confidence.
+uniform float u_DepthConfidenceThreshold;
+
+out vec4 o_Blurred;
+
+// Returns linear interpolation position of value between min and max bounds.
+float DepthInverseLerp(in float value, in float min_bound, in float max_bound) {
+  return clamp((value - min_bound) / (max_bound - min_bound), 0.0, 1.0);
+}
+
+// Weight (x), mean depth (y) and mean squared depth (z) in meters of the
+// occluding depth around one tap.
+vec3 ReadMoments(in vec2 uv) {
+  vec4 source = texture(u_Source, uv);
+  if (u_FromDepth) {
+    // Meters and confidence, see Texture.  Depth that DepthGetVisibility()
+    // in ar_object.frag fades out near and far occludes only partly.
+    float depth_mm = source.x * 1000.0;
+    float weight = source.y < u_DepthConfidenceThreshold ? 0.0
+        : (1.0 - DepthInverseLerp(depth_mm, 150.0, 200.0)) *
+          (1.0 - DepthInverseLerp(depth_mm, 7500.0, 8000.0));
+    return vec3(weight, source.x, source.x * source.x);
+  }
+  // Weighted mean depth (x), standard deviation (y) and weight (z), see
+  // main().
+  if (source.z <= 0.0) {
+    return vec3(0.0);
+  }
+  float mean_m = source.x / source.z;
+  float deviation_m = source.y / source.z;
+  return vec3(source.z, mean_m, deviation_m * deviation_m + mean_m * mean_m);
+}
+
+void main() {
+  vec2 uv = gl_FragCoord.xy / vec2(textureSize(u_Source, 0));
+  // The row sums of the 5x5 kernel of DepthGetBlurredVisibilityAroundUV(),
+  // so both passes together spread depth as far as it does.
+  const float kWeights[5] = float[5](15.0, 66.0, 107.0, 66.0, 15.0);
+  const float kKernelTotalWeights = 269.0;
+
+  float weight = 0.0;
+  float depth_sum = 0.0;
+  float squared_depth_sum = 0.0;
+  for (int i = 0; i < 5; ++i) {
+    vec3 moments = ReadMoments(uv + float(i - 2) * u_Step);
+    float tap_weight = kWeights[i] * moments.x;
+    weight += tap_weight;
+    depth_sum += tap_weight * moments.y;
+    squared_depth_sum += tap_weight * moments.z;
+  }
+  if (weight <= 0.0) {
+    o_Blurred = vec4(0.0, 0.0, 0.0, 1.0);
+    return;
+  }
+  float mean_m = depth_sum / weight;
+  float deviation_m =
+      sqrt(max(squared_depth_sum / weight - mean_m * mean_m, 0.0));
+  float coverage = weight / kKernelTotalWeights;
+  // Premultiplied by the coverage, so bilinear filtering does not pull the
+  // mean towards the zero of texels without occluding depth.
+  o_Blurred = vec4(vec3(mean_m, deviation_m, 1.0) * coverage, 1.0);
+}
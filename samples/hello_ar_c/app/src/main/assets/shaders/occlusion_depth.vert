@@ -0,0 +1,32 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Depth-only pass of the occlusion mask.  Only the position is transformed;
+// the layout of the per-instance attributes matches ar_object.vert.
+uniform mat4 u_View;
+uniform mat4 u_Projection;
+// Decodes the quantized positions, see ar_object.vert.
+uniform vec3 u_PositionOffset;
+uniform vec3 u_PositionScale;
+
+attribute vec4 a_Position;
+attribute mat4 a_ModelMatrix;
+
+void main() {
+    vec4 position = vec4(u_PositionOffset + u_PositionScale * a_Position.xyz,
+                         1.0);
+    gl_Position = u_Projection * (u_View * (a_ModelMatrix * position));
+}
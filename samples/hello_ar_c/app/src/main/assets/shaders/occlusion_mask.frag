@@ -0,0 +1,242 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Resolves the occlusion mask sampled by the USE_OCCLUSION_MASK variant of
+// ar_object.frag.  Runs once per mask texel, so the cost of the blurred depth
+// comparison no longer depends on how many objects overlap.
+precision highp float;
+
+// Depth buffer of the virtual objects at mask resolution; 1.0 where there is
+// no object.
+uniform sampler2D u_VirtualDepth;
+uniform sampler2D u_DepthTexture;
+uniform mat3 u_DepthUvTransform;
+uniform float u_DepthAspectRatio;
+// Depth samples whose confidence, in the green component of the depth texture,
+// is below this do not occlude.  Zero for depth without confidence.
+uniform float u_DepthConfidenceThreshold;
+// Coarse min and max depth, see DepthPyramidTexture.  Only read while
+// u_UseDepthPyramid is set.
+uniform bool u_UseDepthPyramid;
+uniform sampler2D u_DepthPyramid;
+uniform vec2 u_DepthTextureSize;
+// Depth texels a side covered by one pyramid texel (x), and the size of the
+// pyramid level (yz).
+uniform vec3 u_DepthPyramidLayout;
+// Depth blurred once per depth image, see OcclusionBlurTexture.  Only read
+// while u_UseOcclusionBlur is set, and replaces the blurred comparison.
+uniform bool u_UseOcclusionBlur;
+uniform sampler2D u_OcclusionBlur;
+// Projection matrix elements [2][2] and [3][2], which map the depth buffer
+// value back to view space distance.
+uniform vec2 u_DepthLinearization;
+
+varying vec2 v_TexCoord;
+
+// The visibility functions are kept identical to ar_object.frag.
+float DepthGetMillimeters(in sampler2D depth_texture, in vec2 depth_uv) {
+  // Depth is stored in meters in the red component of its texture.
+  return texture2D(depth_texture, depth_uv).r * 1000.0;
+}
+
+// Returns linear interpolation position of value between min and max bounds.
+// E.g., DepthInverseLerp(1100, 1000, 2000) returns 0.1.
+float DepthInverseLerp(in float value, in float min_bound, in float max_bound) {
+  return clamp((value - min_bound) / (max_bound - min_bound), 0.0, 1.0);
+}
+
+// Returns a value between 0.0 (not visible) and 1.0 (completely visible)
+// Which represents how visible or occluded is the pixel in relation to the
+// depth map.
+float DepthGetVisibility(in sampler2D depth_texture, in vec2 depth_uv,
+                         in float asset_depth_mm) {
+  float depth_confidence = texture2D(depth_texture, depth_uv).g;
+  if (depth_confidence < u_DepthConfidenceThreshold) {
+    return 1.0;
+  }
+  float depth_mm = DepthGetMillimeters(depth_texture, depth_uv);
+
+  // Instead of a hard z-buffer test, allow the asset to fade into the
+  // background along a 2 * kDepthTolerancePerMm * asset_depth_mm
+  // range centered on the background depth.
+  const float kDepthTolerancePerMm = 0.015;
+  float visibility_occlusion = clamp(0.5 * (depth_mm - asset_depth_mm) /
+    (kDepthTolerancePerMm * asset_depth_mm) + 0.5, 0.0, 1.0);
+
+  // Depth close to zero is most likely invalid, do not use it for occlusions.
+  float visibility_depth_near = 1.0 - DepthInverseLerp(
+      depth_mm, /*min_depth_mm=*/150.0, /*max_depth_mm=*/200.0);
+
+  // Same for very high depth values.
+  float visibility_depth_far = DepthInverseLerp(
+      depth_mm, /*min_depth_mm=*/7500.0, /*max_depth_mm=*/8000.0);
+
+  const float kOcclusionAlpha = 0.0;
+  float visibility =
+      max(max(visibility_occlusion, kOcclusionAlpha),
+          max(visibility_depth_near, visibility_depth_far));
+
+  return visibility;
+}
+
+float DepthGetBlurredVisibilityAroundUV(in sampler2D depth_texture, in vec2 uv,
+                                        in float asset_depth_mm) {
+  // Kernel used:
+  // 0   4   7   4   0
+  // 4   16  26  16  4
+  // 7   26  41  26  7
+  // 4   16  26  16  4
+  // 0   4   7   4   0
+  const float kKernelTotalWeights = 269.0;
+  float sum = 0.0;
+
+  const float kOcclusionBlurAmount = 0.01;
+  vec2 blurriness = vec2(kOcclusionBlurAmount,
+                         kOcclusionBlurAmount * u_DepthAspectRatio);
+
+  float current = 0.0;
+
+  current += DepthGetVisibility(depth_texture, uv + vec2(-1.0, -2.0) * blurriness, asset_depth_mm);
+  current += DepthGetVisibility(depth_texture, uv + vec2(+1.0, -2.0) * blurriness, asset_depth_mm);
+  current += DepthGetVisibility(depth_texture, uv + vec2(-1.0, +2.0) * blurriness, asset_depth_mm);
+  current += DepthGetVisibility(depth_texture, uv + vec2(+1.0, +2.0) * blurriness, asset_depth_mm);
+  current += DepthGetVisibility(depth_texture, uv + vec2(-2.0, +1.0) * blurriness, asset_depth_mm);
+  current += DepthGetVisibility(depth_texture, uv + vec2(+2.0, +1.0) * blurriness, asset_depth_mm);
+  current += DepthGetVisibility(depth_texture, uv + vec2(-2.0, -1.0) * blurriness, asset_depth_mm);
+  current += DepthGetVisibility(depth_texture, uv + vec2(+2.0, -1.0) * blurriness, asset_depth_mm);
+  sum += current * 4.0;
+
+  current = 0.0;
+  current += DepthGetVisibility(depth_texture, uv + vec2(-2.0, -0.0) * blurriness, asset_depth_mm);
+  current += DepthGetVisibility(depth_texture, uv + vec2(+2.0, +0.0) * blurriness, asset_depth_mm);
+  current += DepthGetVisibility(depth_texture, uv + vec2(+0.0, +2.0) * blurriness, asset_depth_mm);
+  current += DepthGetVisibility(depth_texture, uv + vec2(-0.0, -2.0) * blurriness, asset_depth_mm);
+  sum += current * 7.0;
+
+  current = 0.0;
+  current += DepthGetVisibility(depth_texture, uv + vec2(-1.0, -1.0) * blurriness, asset_depth_mm);
+  current += DepthGetVisibility(depth_texture, uv + vec2(+1.0, -1.0) * blurriness, asset_depth_mm);
+  current += DepthGetVisibility(depth_texture, uv + vec2(-1.0, +1.0) * blurriness, asset_depth_mm);
+  current += DepthGetVisibility(depth_texture, uv + vec2(+1.0, +1.0) * blurriness, asset_depth_mm);
+  sum += current * 16.0;
+
+  current = 0.0;
+  current += DepthGetVisibility(depth_texture, uv + vec2(+0.0, +1.0) * blurriness, asset_depth_mm);
+  current += DepthGetVisibility(depth_texture, uv + vec2(-0.0, -1.0) * blurriness, asset_depth_mm);
+  current += DepthGetVisibility(depth_texture, uv + vec2(-1.0, -0.0) * blurriness, asset_depth_mm);
+  current += DepthGetVisibility(depth_texture, uv + vec2(+1.0, +0.0) * blurriness, asset_depth_mm);
+  sum += current * 26.0;
+
+  sum += DepthGetVisibility(depth_texture, uv , asset_depth_mm) * 41.0;
+
+  return sum / kKernelTotalWeights;
+}
+
+// Approximates DepthGetBlurredVisibilityAroundUV() with one lookup of the
+// precomputed blur.  The kernel's depth is summarized by its mean and spread
+// and the share of it that can occlude, and the asset fades out over the
+// depth tolerance widened by that spread.
+float DepthGetPrecomputedVisibility(in vec2 uv, in float asset_depth_mm) {
+  // Mean depth and standard deviation in meters and the occluding share,
+  // the first two premultiplied by the last.
+  vec3 blurred = texture2D(u_OcclusionBlur, uv).rgb;
+  if (blurred.z <= 0.0) {
+    return 1.0;
+  }
+  float mean_mm = blurred.x / blurred.z * 1000.0;
+  float deviation_mm = blurred.y / blurred.z * 1000.0;
+
+  // A ramp with the variance of the per-sample ramp of DepthGetVisibility()
+  // over depth spread by deviation_mm.
+  const float kDepthTolerancePerMm = 0.015;
+  float tolerance_mm = kDepthTolerancePerMm * asset_depth_mm;
+  float half_width_mm = sqrt(tolerance_mm * tolerance_mm +
+                             3.0 * deviation_mm * deviation_mm);
+  float visibility_occlusion = clamp(
+      0.5 * (mean_mm - asset_depth_mm) / half_width_mm + 0.5, 0.0, 1.0);
+  return mix(1.0, visibility_occlusion, blurred.z);
+}
+
+// Min (x) and max (y) depth of the pyramid texel covering depth_uv.
+vec2 DepthGetCoarseMinMax(in vec2 depth_uv) {
+  vec2 depth_texel = clamp(floor(depth_uv * u_DepthTextureSize), vec2(0.0),
+                           u_DepthTextureSize - 1.0);
+  // The last pyramid texel also covers the remainder of the depth texture.
+  vec2 pyramid_texel = min(floor(depth_texel / u_DepthPyramidLayout.x),
+                           u_DepthPyramidLayout.yz - 1.0);
+  vec2 pyramid_uv = (pyramid_texel + 0.5) / u_DepthPyramidLayout.yz;
+  vec4 packed_min_max = texture2D(u_DepthPyramid, pyramid_uv);
+  return vec2(dot(packed_min_max.xy, vec2(255.0, 256.0 * 255.0)),
+              dot(packed_min_max.zw, vec2(255.0, 256.0 * 255.0)));
+}
+
+// Returns the visibility DepthGetBlurredVisibilityAroundUV() would, if the
+// coarse min and max depth of the area it reads already decide it, or -1.0.
+// A pyramid texel covers the whole area, so its four corners find every
+// texel that overlaps it.
+float DepthGetCoarseVisibility(in vec2 uv, in float asset_depth_mm) {
+  const float kOcclusionBlurAmount = 0.01;
+  vec2 extent = 2.0 * vec2(kOcclusionBlurAmount,
+                           kOcclusionBlurAmount * u_DepthAspectRatio) +
+                1.0 / u_DepthTextureSize;
+  vec2 min_max_00 = DepthGetCoarseMinMax(uv - extent);
+  vec2 min_max_10 = DepthGetCoarseMinMax(uv + vec2(extent.x, -extent.y));
+  vec2 min_max_01 = DepthGetCoarseMinMax(uv + vec2(-extent.x, extent.y));
+  vec2 min_max_11 = DepthGetCoarseMinMax(uv + extent);
+  float min_mm = min(min(min_max_00.x, min_max_10.x),
+                     min(min_max_01.x, min_max_11.x));
+  float max_mm = max(max(min_max_00.y, min_max_10.y),
+                     max(min_max_01.y, min_max_11.y));
+
+  // The bounds of DepthGetVisibility().
+  const float kDepthTolerancePerMm = 0.015;
+  if (min_mm >= asset_depth_mm * (1.0 + kDepthTolerancePerMm)) {
+    return 1.0;
+  }
+  if (min_mm >= 200.0 && max_mm <= 7500.0 &&
+      max_mm <= asset_depth_mm * (1.0 - kDepthTolerancePerMm)) {
+    return 0.0;
+  }
+  return -1.0;
+}
+
+void main() {
+    float virtual_depth = texture2D(u_VirtualDepth, v_TexCoord).r;
+    if (virtual_depth >= 1.0) {
+        // No virtual object covers this texel.
+        gl_FragColor = vec4(1.0);
+        return;
+    }
+
+    const float kMetersToMillimeters = 1000.0;
+    float ndc_depth = virtual_depth * 2.0 - 1.0;
+    float asset_depth_mm = kMetersToMillimeters * u_DepthLinearization.y /
+        (ndc_depth + u_DepthLinearization.x);
+
+    vec2 screen_space_position = v_TexCoord * 2.0 - 1.0;
+    vec2 depth_uvs = (u_DepthUvTransform * vec3(screen_space_position, 1)).xy;
+    float visibility = -1.0;
+    if (u_UseOcclusionBlur) {
+      visibility = DepthGetPrecomputedVisibility(depth_uvs, asset_depth_mm);
+    } else if (u_UseDepthPyramid) {
+      visibility = DepthGetCoarseVisibility(depth_uvs, asset_depth_mm);
+    }
+    if (visibility < 0.0) {
+      visibility = DepthGetBlurredVisibilityAroundUV(u_DepthTexture, depth_uvs,
+                                                     asset_depth_mm);
+    }
+    gl_FragColor = vec4(visibility);
+}
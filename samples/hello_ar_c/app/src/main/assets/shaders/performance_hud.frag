@@ -0,0 +1,32 @@
+#version 300 es
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Draws the bitmap font glyphs and solid quads of PerformanceHud, blended as
+// premultiplied alpha.
+precision mediump float;
+
+uniform sampler2D u_Font;
+
+in vec2 v_TexCoord;
+in vec4 v_Color;
+
+out vec4 o_FragColor;
+
+void main() {
+  float alpha = v_Color.a * texture(u_Font, v_TexCoord).r;
+  o_FragColor = vec4(v_Color.rgb * alpha, alpha);
+}
@@ -0,0 +1,35 @@
+#version 300 es
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Quads of PerformanceHud, positioned in pixels from the top left corner of
+// the surface.
+
+uniform vec2 u_SurfaceSize;
+
+in vec2 a_Position;
+in vec2 a_TexCoord;
+in vec4 a_Color;
+
+out vec2 v_TexCoord;
+out vec4 v_Color;
+
+void main() {
+  vec2 ndc = a_Position / u_SurfaceSize * 2.0 - 1.0;
+  gl_Position = vec4(ndc.x, -ndc.y, 0.0, 1.0);
+  v_TexCoord = a_TexCoord;
+  v_Color = a_Color;
+}
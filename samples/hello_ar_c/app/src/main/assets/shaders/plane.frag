@@ -14,13 +14,65 @@
  * limitations under the License.
  */
 
+// For fwidth(), which keeps the grid lines antialiased at any distance.
+#extension GL_OES_standard_derivatives : enable
+
 precision highp float;
 precision highp int;
-uniform sampler2D texture;
 varying vec2 v_textureCoords;
 varying float v_alpha;
 
+// The triangle grid, in plane coordinates in meters: rows of vertices
+// kGridCell.y apart, kGridCell.x apart within a row and shifted by half of
+// that from one row to the next, connected by one horizontal and two
+// diagonal families of lines.
+const vec2 kGridCell = vec2(1.0 / 7.0, 1.0 / 8.0);
+const float kLineHalfWidthM = 0.001;
+const float kVertexRadiusM = 0.006;
+const float kBackgroundIntensity = 0.25;
+const float kLineIntensity = 0.44;
+const float kVertexIntensity = 1.0;
+
+// Coverage of a pixel |pixel_m| wide by a feature within |half_width_m| of
+// the point |distance_m| away, fading distant features to their average.
+float GetCoverage(float distance_m, float half_width_m, float pixel_m) {
+  float edge = 1.0 - smoothstep(half_width_m, half_width_m + pixel_m,
+                                distance_m);
+  return edge * min(2.0 * half_width_m / pixel_m, 1.0);
+}
+
+float GetGridIntensity(vec2 position) {
+  vec2 cell = position / kGridCell;
+  float pixel_m = max(length(fwidth(position)), 1e-6);
+
+  float row_distance_m = abs(fract(cell.y + 0.5) - 0.5) * kGridCell.y;
+  // Vertex j of row i is at (j + i / 2, i) in cells, so the diagonals
+  // through the vertices are where x - y / 2 or x + y / 2 is whole.
+  float diagonal_scale = kGridCell.x * kGridCell.y /
+                         length(vec2(0.5 * kGridCell.x, kGridCell.y));
+  float rising = cell.x - 0.5 * cell.y;
+  float falling = cell.x + 0.5 * cell.y;
+  float diagonal_distance_m = min(abs(fract(rising + 0.5) - 0.5),
+                                  abs(fract(falling + 0.5) - 0.5)) *
+                              diagonal_scale;
+  float line = GetCoverage(min(row_distance_m, diagonal_distance_m),
+                           kLineHalfWidthM, pixel_m);
+
+  // The nearest vertex is in the row below or above.
+  float row_below = floor(cell.y);
+  float row_above = row_below + 1.0;
+  vec2 below = vec2(floor(cell.x - 0.5 * row_below + 0.5) + 0.5 * row_below,
+                    row_below);
+  vec2 above = vec2(floor(cell.x - 0.5 * row_above + 0.5) + 0.5 * row_above,
+                    row_above);
+  float vertex_distance_m = min(length((cell - below) * kGridCell),
+                                length((cell - above) * kGridCell));
+  float vertex = GetCoverage(vertex_distance_m, kVertexRadiusM, pixel_m);
+
+  return mix(mix(kBackgroundIntensity, kLineIntensity, line),
+             kVertexIntensity, vertex);
+}
+
 void main() {
-  float r = texture2D(texture, v_textureCoords).r;
-  gl_FragColor = vec4(r * v_alpha);
+  gl_FragColor = vec4(GetGridIntensity(v_textureCoords) * v_alpha);
 }
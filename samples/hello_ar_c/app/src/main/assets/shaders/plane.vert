@@ -16,21 +16,67 @@
  
 precision highp float;
 precision highp int;
-attribute vec3 vertex;
 varying vec2 v_textureCoords;
 varying float v_alpha;
 
+// Drawn once per edge of the plane outline; see PlaneRenderer.  corner.x
+// selects the end of the edge and corner.y the ring: 0 on the outline, 1 on
+// the inner feather ring, 2 at the plane center.
+attribute vec2 corner;
+
+#if PLANE_BATCHED
+// Outlines of all planes are pre-transformed to world space and drawn in one
+// call, so mvp only holds the view projection matrix.  edge_start.w is 0 for
+// the edge between two planes.
+attribute vec4 edge_start;
+attribute vec4 edge_end;
+attribute vec3 plane_center;
+attribute vec3 vertex_normal;
+
+uniform mat4 mvp;
+#else
+attribute vec2 edge_start;
+attribute vec2 edge_end;
+
 uniform mat4 mvp;
 uniform mat4 model_mat;
 uniform vec3 normal;
+#endif  // PLANE_BATCHED
 
-void main() {
-  // Vertex Z value is used as the alpha in this shader.
-  v_alpha = vertex.z;
+// Feather distance 0.2 meters.
+const float kFeatherLength = 0.2;
+// Feather scale over the distance between plane center and vertices.
+const float kFeatherScale = 0.2;
+
+// Offset of the corner from the plane center, given the offset of the
+// outline vertex it derives from.
+vec3 GetCornerOffset(vec3 outline_offset) {
+  if (corner.y < 0.5) {
+    return outline_offset;
+  } else if (corner.y < 1.5) {
+    return outline_offset *
+           (1.0 - min(kFeatherLength / length(outline_offset), kFeatherScale));
+  }
+  return vec3(0.0);
+}
 
-  vec4 local_pos = vec4(vertex.x, 0.0, vertex.y, 1.0);
+void main() {
+  // The outline has alpha 0, the inner ring and the center 1.
+  v_alpha = corner.y < 0.5 ? 0.0 : 1.0;
+#if PLANE_BATCHED
+  vec3 outline_pos = mix(edge_start.xyz, edge_end.xyz, corner.x);
+  vec4 world_pos = vec4(plane_center +
+                        GetCornerOffset(outline_pos - plane_center), 1.0);
+  // Collapses the edge between two planes to a point.
+  gl_Position = edge_start.w > 0.0 ? mvp * world_pos : vec4(0.0);
+  vec3 normal = vertex_normal;
+#else
+  vec2 outline_pos = mix(edge_start, edge_end, corner.x);
+  vec3 local = GetCornerOffset(vec3(outline_pos.x, 0.0, outline_pos.y));
+  vec4 local_pos = vec4(local, 1.0);
   gl_Position = mvp * local_pos;
   vec4 world_pos = model_mat * local_pos;
+#endif  // PLANE_BATCHED
 
   // Construct two vectors that are orthogonal to the normal.
   // This arbitrary choice is not co-linear with either horizontal
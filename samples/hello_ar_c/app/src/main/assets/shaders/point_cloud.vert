@@ -17,6 +17,9 @@
 uniform mat4 u_ModelViewProjection;
 uniform vec4 u_Color;
 uniform float u_PointSize;
+// Depth up to which points keep u_PointSize and the smallest scale of the
+// size beyond it.  Zero keeps every point at u_PointSize.
+uniform vec2 u_PointSizeAttenuation;
 
 attribute vec4 a_Position;
 
@@ -25,5 +28,12 @@ varying vec4 v_Color;
 void main() {
    v_Color = u_Color;
    gl_Position = u_ModelViewProjection * vec4(a_Position.xyz, 1.0);
-   gl_PointSize = u_PointSize;
+   float point_size = u_PointSize;
+   if (u_PointSizeAttenuation.x > 0.0) {
+      // Shrinks distant points, and less confident ones down to half size.
+      float scale = clamp(u_PointSizeAttenuation.x / max(gl_Position.w, 0.001),
+                          u_PointSizeAttenuation.y, 1.0);
+      point_size *= scale * mix(0.5, 1.0, clamp(a_Position.w, 0.0, 1.0));
+   }
+   gl_PointSize = max(point_size, 1.0);
 }
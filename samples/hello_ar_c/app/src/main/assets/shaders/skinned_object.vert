@@ -0,0 +1,84 @@
+#version 300 es
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+uniform mat4 u_View;
+uniform mat4 u_Projection;
+// Light direction in model space.
+uniform vec4 u_LightDirection;
+// Bounding box of the mesh decoding the quantized positions.
+uniform vec3 u_PositionOffset;
+uniform vec3 u_PositionScale;
+// Skinning matrices of the copies of this draw, those of copy i in row i:
+// the top three rows of the matrix of joint j in texels 3j to 3j + 2.
+uniform highp sampler2D u_JointPalette;
+
+// Unsigned normalized position in the bounding box.
+in vec4 a_Position;
+// Octahedral encoded normal.
+in vec2 a_Normal;
+in vec2 a_TexCoord;
+// The four joints moving the vertex and their weights, summing to one.
+in uvec4 a_Joints;
+in vec4 a_Weights;
+
+// Per-instance attributes, advanced once per drawn copy of the model.
+in mat4 a_ModelMatrix;
+in vec4 a_ObjColor;
+
+out vec3 v_ViewPosition;
+out vec3 v_ViewNormal;
+out vec2 v_TexCoord;
+out vec3 v_ViewLightDirection;
+out vec4 v_ObjColor;
+
+vec3 DecodeOctahedral(vec2 encoded) {
+  vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+  // Folds the lower half back from the corners.
+  float fold = max(-normal.z, 0.0);
+  normal.x += normal.x >= 0.0 ? -fold : fold;
+  normal.y += normal.y >= 0.0 ? -fold : fold;
+  return normal;
+}
+
+// The rows of the skinning matrix of |joint| for this copy.
+mat3x4 FetchJoint(uint joint) {
+  int x = int(joint) * 3;
+  return mat3x4(texelFetch(u_JointPalette, ivec2(x, gl_InstanceID), 0),
+                texelFetch(u_JointPalette, ivec2(x + 1, gl_InstanceID), 0),
+                texelFetch(u_JointPalette, ivec2(x + 2, gl_InstanceID), 0));
+}
+
+void main() {
+  // Blending the rows is linear like blending the matrices.
+  mat3x4 skin = a_Weights.x * FetchJoint(a_Joints.x) +
+                a_Weights.y * FetchJoint(a_Joints.y) +
+                a_Weights.z * FetchJoint(a_Joints.z) +
+                a_Weights.w * FetchJoint(a_Joints.w);
+  vec4 bindPosition =
+      vec4(u_PositionOffset + u_PositionScale * a_Position.xyz, 1.0);
+  // A vector times the rows, stored as columns, is the matrix times it.
+  vec4 position = vec4(bindPosition * skin, 1.0);
+  vec3 normal = vec4(DecodeOctahedral(a_Normal), 0.0) * skin;
+
+  mat4 modelView = u_View * a_ModelMatrix;
+  v_ViewPosition = (modelView * position).xyz;
+  v_ViewNormal = normalize((modelView * vec4(normal, 0.0)).xyz);
+  v_ViewLightDirection = normalize((modelView * u_LightDirection).xyz);
+  v_ObjColor = a_ObjColor;
+  v_TexCoord = a_TexCoord;
+  gl_Position = u_Projection * vec4(v_ViewPosition, 1.0);
+}
@@ -0,0 +1,34 @@
+#version 300 es
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+precision mediump float;
+
+// Straight alpha color, premultiplied when written.
+uniform vec4 u_Color;
+
+in highp vec3 v_WorldPosition;
+
+out vec4 o_FragColor;
+
+void main() {
+  // Face normal from the screen space derivatives, as the mesh has none.
+  // Walls and roofs are told apart by how vertical the normal is.
+  highp vec3 normal =
+      normalize(cross(dFdx(v_WorldPosition), dFdy(v_WorldPosition)));
+  float shade = 0.5 + 0.5 * abs(normal.y);
+  o_FragColor = vec4(u_Color.rgb * shade * u_Color.a, u_Color.a);
+}
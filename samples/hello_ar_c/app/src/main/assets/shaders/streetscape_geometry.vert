@@ -0,0 +1,30 @@
+#version 300 es
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+uniform mat4 u_Model;
+uniform mat4 u_ViewProjection;
+
+// In the space of the geometry's mesh pose.
+in vec3 a_Position;
+
+out vec3 v_WorldPosition;
+
+void main() {
+  vec4 world_position = u_Model * vec4(a_Position, 1.0);
+  v_WorldPosition = world_position.xyz;
+  gl_Position = u_ViewProjection * world_position;
+}
@@ -0,0 +1,119 @@
+#version 300 es
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Blends a new depth image with the reprojected filtered depth of the
+// previous one, see TemporalDepthFilter.
+precision highp float;
+
+// The new depth texture, in the format written by Texture.
+uniform sampler2D u_Depth;
+// Filtered depth of the previous image in meters (x) and confidence (y), of
+// the same size.  Only read while u_HasHistory is set.
+uniform sampler2D u_History;
+uniform bool u_HasHistory;
+// Whether the green component of u_Depth holds confidence.  Smoothed depth
+// has none, and its known samples count as fully confident.
+uniform bool u_HasConfidence;
+// Focal length (xy) and principal point (zw) in depth pixels.
+uniform vec4 u_Intrinsics;
+// From the camera of the new image to the camera of the previous one.
+uniform mat4 u_PreviousFromCurrent;
+
+out vec4 o_Depth;
+
+// How much the history outweighs a new sample of the same confidence.  The
+// filtered depth follows the new images with a factor of 1 / (1 + 2).
+const float kHistoryWeight = 2.0;
+// Confidence the history loses with every image it is carried over without
+// being observed again, so depth that is no longer seen fades out.
+const float kHistoryConfidenceDecay = 0.8;
+// History that decayed below this confidence is dropped.
+const float kMinHistoryConfidence = 0.05;
+// Reprojected history further than this share of its depth from where it is
+// expected was seen on a different surface and is dropped.
+const float kDepthTolerance = 0.05;
+// Closer reprojected points are discarded, like in DepthPyramid.
+const float kMinDepthM = 0.1;
+
+void main() {
+  ivec2 texel = ivec2(gl_FragCoord.xy);
+  vec2 new_sample = texelFetch(u_Depth, texel, 0).rg;
+  float new_depth_m = new_sample.x;
+  float new_confidence = new_depth_m > 0.0
+      ? (u_HasConfidence ? new_sample.y : 1.0) : 0.0;
+  o_Depth = vec4(new_depth_m, new_confidence, 0.0, 0.0);
+  if (!u_HasHistory) {
+    return;
+  }
+
+  // The point seen through the texel, at the new depth or, where there is
+  // none, at the depth the history has for the texel.
+  float depth_m = new_confidence > 0.0
+      ? new_depth_m : texelFetch(u_History, texel, 0).x;
+  if (depth_m <= kMinDepthM) {
+    return;
+  }
+  // Pixel centers are at integer coordinates, and image rows grow downwards
+  // while the camera's y axis points up.
+  vec2 pixel = vec2(texel);
+  vec3 point = vec3((pixel.x - u_Intrinsics.z) / u_Intrinsics.x * depth_m,
+                    -(pixel.y - u_Intrinsics.w) / u_Intrinsics.y * depth_m,
+                    -depth_m);
+  vec3 previous_point = (u_PreviousFromCurrent * vec4(point, 1.0)).xyz;
+  float previous_depth_m = -previous_point.z;
+  if (previous_depth_m <= kMinDepthM) {
+    return;
+  }
+  vec2 previous_pixel = vec2(
+      u_Intrinsics.x * previous_point.x / previous_depth_m + u_Intrinsics.z,
+      -u_Intrinsics.y * previous_point.y / previous_depth_m + u_Intrinsics.w);
+  // Nearest texel rather than bilinear filtering, which would invent depth
+  // between the surfaces at an edge.
+  ivec2 history_texel = ivec2(floor(previous_pixel + 0.5));
+  ivec2 size = textureSize(u_History, 0);
+  if (any(lessThan(history_texel, ivec2(0))) ||
+      any(greaterThanEqual(history_texel, size))) {
+    return;
+  }
+  vec2 history = texelFetch(u_History, history_texel, 0).xy;
+  if (history.x <= 0.0 || history.y <= 0.0) {
+    return;
+  }
+
+  // Where the new depth has the point, the history must have it near the
+  // same distance from the previous camera.  Without new depth the point came
+  // from the history itself, so there is nothing to compare against.
+  float consistency = new_confidence > 0.0
+      ? 1.0 - clamp(abs(history.x - previous_depth_m) /
+                    (kDepthTolerance * previous_depth_m), 0.0, 1.0)
+      : 1.0;
+  float carried_confidence =
+      history.y * consistency * kHistoryConfidenceDecay;
+  if (carried_confidence < kMinHistoryConfidence) {
+    return;
+  }
+  float history_weight = kHistoryWeight * history.y * consistency;
+  float total_weight = new_confidence + history_weight;
+  // The history moved into the new camera by the change in the point's
+  // distance.
+  float history_depth_m = history.x + (depth_m - previous_depth_m);
+  float filtered_depth_m =
+      (new_confidence * new_depth_m + history_weight * history_depth_m) /
+      total_weight;
+  o_Depth = vec4(filtered_depth_m, max(new_confidence, carried_confidence),
+                 0.0, 0.0);
+}
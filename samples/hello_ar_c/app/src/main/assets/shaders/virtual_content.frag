@@ -0,0 +1,30 @@
+#version 300 es
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Blends the virtual content drawn at a lower resolution over the camera
+// image, see VirtualContentTarget.  The premultiplied color is written as is.
+precision mediump float;
+
+uniform sampler2D u_VirtualContent;
+
+in vec2 v_TexCoord;
+
+out vec4 o_FragColor;
+
+void main() {
+  o_FragColor = texture(u_VirtualContent, v_TexCoord);
+}
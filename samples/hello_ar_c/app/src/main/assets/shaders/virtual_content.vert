@@ -0,0 +1,27 @@
+#version 300 es
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Fullscreen triangle without vertex attributes, see VirtualContentTarget.
+
+out vec2 v_TexCoord;
+
+void main() {
+  vec2 position = vec2(float((gl_VertexID & 1) << 2),
+                       float((gl_VertexID & 2) << 1)) - 1.0;
+  v_TexCoord = position * 0.5 + 0.5;
+  gl_Position = vec4(position, 0.0, 1.0);
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_ANCHOR_REQUEST_BUDGET_H_
+#define C_ARCORE_HELLOE_AR_ANCHOR_REQUEST_BUDGET_H_
+
+namespace hello_ar {
+
+// Bounds the network futures for anchors in flight across the classes that
+// start them, e.g. CloudAnchorPipeline and AnchorResolveScheduler, which
+// keep their own, smaller caps on top.  A burst of Geospatial resolves then
+// leaves no room for Cloud Anchors and the other way around, but the two
+// together never exceed the budget.
+//
+// TryAcquire() before starting a future and Release() once it is done,
+// cancelled or released.  Not thread safe; all users must run on the thread
+// that updates the session.
+class AnchorRequestBudget {
+ public:
+  explicit AnchorRequestBudget(int max_in_flight)
+      : max_in_flight_(max_in_flight) {}
+
+  AnchorRequestBudget(const AnchorRequestBudget&) = delete;
+  AnchorRequestBudget& operator=(const AnchorRequestBudget&) = delete;
+
+  // Claims one future, or returns false if the budget is used up.
+  bool TryAcquire() {
+    if (in_flight_ >= max_in_flight_) {
+      ++denied_count_;
+      return false;
+    }
+    ++in_flight_;
+    if (in_flight_ > peak_in_flight_) {
+      peak_in_flight_ = in_flight_;
+    }
+    return true;
+  }
+
+  void Release() { --in_flight_; }
+
+  int GetInFlight() const { return in_flight_; }
+  int GetPeakInFlight() const { return peak_in_flight_; }
+  // TryAcquire() calls that found the budget used up.
+  int GetDeniedCount() const { return denied_count_; }
+
+ private:
+  const int max_in_flight_;
+  int in_flight_ = 0;
+  int peak_in_flight_ = 0;
+  int denied_count_ = 0;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_ANCHOR_REQUEST_BUDGET_H_
@@ -0,0 +1,250 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "anchor_resolve_scheduler.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "util.h"
+
+namespace hello_ar {
+namespace {
+constexpr double kEarthRadiusM = 6371000.0;
+constexpr double kRadiansPerDegree = M_PI / 180.0;
+
+// Equirectangular approximation of the distance on the ground, which is
+// plenty for ranking anchors a few hundred meters apart.
+double GetGroundDistanceM(double latitude_a, double longitude_a,
+                          double latitude_b, double longitude_b) {
+  double delta_longitude = longitude_b - longitude_a;
+  if (delta_longitude > 180.0) {
+    delta_longitude -= 360.0;
+  } else if (delta_longitude < -180.0) {
+    delta_longitude += 360.0;
+  }
+  const double x = delta_longitude * kRadiansPerDegree *
+                   std::cos((latitude_a + latitude_b) * 0.5 *
+                            kRadiansPerDegree);
+  const double y = (latitude_b - latitude_a) * kRadiansPerDegree;
+  return kEarthRadiusM * std::sqrt(x * x + y * y);
+}
+}  // namespace
+
+constexpr double AnchorResolveScheduler::kStartDistanceM;
+constexpr double AnchorResolveScheduler::kCancelDistanceM;
+
+AnchorResolveScheduler::AnchorResolveScheduler(int max_outstanding,
+                                               AnchorRequestBudget* budget)
+    : max_outstanding_(max_outstanding), budget_(budget) {}
+
+AnchorResolveScheduler::~AnchorResolveScheduler() {
+  // Clear() must have run while the session was alive.
+  for (Entry& entry : outstanding_) {
+    ArFuture_release(entry.future);
+  }
+}
+
+uint32_t AnchorResolveScheduler::Submit(const Request& request) {
+  Entry entry;
+  entry.id = next_id_++;
+  entry.request = request;
+  entry.submit_time = std::chrono::steady_clock::now();
+  queued_.push_back(entry);
+  return entry.id;
+}
+
+void AnchorResolveScheduler::Update(ArSession* session, ArEarth* earth,
+                                    ArGeospatialPose* scratch_pose,
+                                    std::vector<Result>* results) {
+  PollOutstanding(session, results);
+  if (earth == nullptr) {
+    return;
+  }
+  ArTrackingState tracking_state = AR_TRACKING_STATE_STOPPED;
+  ArTrackable_getTrackingState(session, reinterpret_cast<ArTrackable*>(earth),
+                               &tracking_state);
+  if (tracking_state != AR_TRACKING_STATE_TRACKING) {
+    return;
+  }
+  ArEarth_getCameraGeospatialPose(session, earth, scratch_pose);
+  double camera_latitude = 0.0;
+  double camera_longitude = 0.0;
+  ArGeospatialPose_getLatitudeLongitude(session, scratch_pose,
+                                        &camera_latitude, &camera_longitude);
+  const auto update_distance = [&](Entry* entry) {
+    entry->distance_m =
+        GetGroundDistanceM(camera_latitude, camera_longitude,
+                           entry->request.latitude, entry->request.longitude);
+  };
+
+  // Requests the user walked away from give their slot to nearer ones.  A
+  // future that could not be cancelled any more is picked up by the next
+  // poll.
+  for (Entry& entry : outstanding_) {
+    update_distance(&entry);
+    if (entry.distance_m > kCancelDistanceM) {
+      int32_t was_cancelled = 0;
+      ArFuture_cancel(session, entry.future, &was_cancelled);
+    }
+  }
+
+  if (queued_.empty() ||
+      outstanding_.size() >= static_cast<size_t>(max_outstanding_)) {
+    return;
+  }
+  for (Entry& entry : queued_) {
+    update_distance(&entry);
+  }
+  // Nearest last, so started entries pop off the back.
+  std::sort(queued_.begin(), queued_.end(),
+            [](const Entry& a, const Entry& b) {
+              return a.distance_m > b.distance_m;
+            });
+  while (!queued_.empty() &&
+         outstanding_.size() < static_cast<size_t>(max_outstanding_) &&
+         queued_.back().distance_m <= kStartDistanceM) {
+    if (budget_ != nullptr && !budget_->TryAcquire()) {
+      break;
+    }
+    Entry& entry = queued_.back();
+    const ArStatus status = Start(session, earth, &entry);
+    if (status != AR_SUCCESS && budget_ != nullptr) {
+      budget_->Release();
+    }
+    if (status == AR_ERROR_RESOURCE_EXHAUSTED) {
+      // ARCore holds too many Geospatial anchors; retried next frame.
+      break;
+    }
+    if (status == AR_SUCCESS) {
+      outstanding_.push_back(entry);
+    } else {
+      LOGE("AnchorResolveScheduler: request %u failed to start: %d",
+           entry.id, status);
+      Result result;
+      result.id = entry.id;
+      result.latitude = entry.request.latitude;
+      result.longitude = entry.request.longitude;
+      result.altitude_m = entry.request.altitude_m;
+      result.latency = std::chrono::steady_clock::now() - entry.submit_time;
+      results->push_back(result);
+    }
+    queued_.pop_back();
+  }
+}
+
+void AnchorResolveScheduler::Clear(const ArSession* session) {
+  for (Entry& entry : outstanding_) {
+    int32_t was_cancelled = 0;
+    ArFuture_cancel(session, entry.future, &was_cancelled);
+    ArFuture_release(entry.future);
+    if (budget_ != nullptr) {
+      budget_->Release();
+    }
+  }
+  outstanding_.clear();
+  queued_.clear();
+}
+
+void AnchorResolveScheduler::PollOutstanding(const ArSession* session,
+                                             std::vector<Result>* results) {
+  auto it = outstanding_.begin();
+  while (it != outstanding_.end()) {
+    ArFutureState state = AR_FUTURE_STATE_PENDING;
+    ArFuture_getState(session, it->future, &state);
+    if (state == AR_FUTURE_STATE_PENDING) {
+      ++it;
+      continue;
+    }
+    if (budget_ != nullptr) {
+      budget_->Release();
+    }
+
+    if (state == AR_FUTURE_STATE_CANCELLED) {
+      // Only Update() cancels, so the request goes back into the queue.
+      ArFuture_release(it->future);
+      it->future = nullptr;
+      queued_.push_back(*it);
+      it = outstanding_.erase(it);
+      continue;
+    }
+
+    Result result;
+    result.id = it->id;
+    result.latitude = it->request.latitude;
+    result.longitude = it->request.longitude;
+    result.altitude_m = it->request.altitude_m;
+    result.latency = std::chrono::steady_clock::now() - it->submit_time;
+    bool succeeded = false;
+    if (it->request.type == AnchorType::kTerrain) {
+      const auto* future =
+          reinterpret_cast<const ArResolveAnchorOnTerrainFuture*>(it->future);
+      ArTerrainAnchorState anchor_state = AR_TERRAIN_ANCHOR_STATE_NONE;
+      ArResolveAnchorOnTerrainFuture_getResultTerrainAnchorState(
+          session, future, &anchor_state);
+      ArResolveAnchorOnTerrainFuture_acquireResultAnchor(session, future,
+                                                         &result.anchor);
+      succeeded = anchor_state == AR_TERRAIN_ANCHOR_STATE_SUCCESS;
+      if (!succeeded) {
+        LOGE("AnchorResolveScheduler: terrain anchor %u failed: %d",
+             it->id, anchor_state);
+      }
+    } else {
+      const auto* future =
+          reinterpret_cast<const ArResolveAnchorOnRooftopFuture*>(it->future);
+      ArRooftopAnchorState anchor_state = AR_ROOFTOP_ANCHOR_STATE_NONE;
+      ArResolveAnchorOnRooftopFuture_getResultRooftopAnchorState(
+          session, future, &anchor_state);
+      ArResolveAnchorOnRooftopFuture_acquireResultAnchor(session, future,
+                                                         &result.anchor);
+      succeeded = anchor_state == AR_ROOFTOP_ANCHOR_STATE_SUCCESS;
+      if (!succeeded) {
+        LOGE("AnchorResolveScheduler: rooftop anchor %u failed: %d",
+             it->id, anchor_state);
+      }
+    }
+    if (!succeeded && result.anchor != nullptr) {
+      ArAnchor_release(result.anchor);
+      result.anchor = nullptr;
+    }
+    results->push_back(result);
+    ArFuture_release(it->future);
+    it = outstanding_.erase(it);
+  }
+}
+
+ArStatus AnchorResolveScheduler::Start(ArSession* session, ArEarth* earth,
+                                       Entry* entry) {
+  const Request& request = entry->request;
+  if (request.type == AnchorType::kTerrain) {
+    ArResolveAnchorOnTerrainFuture* future = nullptr;
+    const ArStatus status = ArEarth_resolveAnchorOnTerrainAsync(
+        session, earth, request.latitude, request.longitude,
+        request.altitude_m, request.eus_quaternion, /*context=*/nullptr,
+        /*callback=*/nullptr, &future);
+    entry->future = status == AR_SUCCESS ? ArAsFuture(future) : nullptr;
+    return status;
+  }
+  ArResolveAnchorOnRooftopFuture* future = nullptr;
+  const ArStatus status = ArEarth_resolveAnchorOnRooftopAsync(
+      session, earth, request.latitude, request.longitude, request.altitude_m,
+      request.eus_quaternion, /*context=*/nullptr, /*callback=*/nullptr,
+      &future);
+  entry->future = status == AR_SUCCESS ? ArAsFuture(future) : nullptr;
+  return status;
+}
+
+}  // namespace hello_ar
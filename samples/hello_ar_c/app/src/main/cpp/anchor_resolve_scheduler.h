@@ -0,0 +1,132 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_ANCHOR_RESOLVE_SCHEDULER_H_
+#define C_ARCORE_HELLOE_AR_ANCHOR_RESOLVE_SCHEDULER_H_
+
+#include <chrono>  // NOLINT
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "anchor_request_budget.h"
+#include "arcore_c_api.h"
+
+namespace hello_ar {
+
+// Resolves Terrain and Rooftop anchors a bounded number at a time, nearest
+// first.
+//
+// Submit() only queues a request.  Update(), called once per frame after
+// ArSession_update, does all the work on the calling thread: it polls the
+// outstanding futures with ArFuture_getState, cancels the ones whose
+// location moved beyond kCancelDistanceM of the camera, and starts the
+// queued requests closest to the camera's Geospatial pose until
+// max_outstanding futures, or the shared AnchorRequestBudget, are in flight.
+// Keeping the futures few bounds the network and CPU load, and starting with
+// the nearest anchors shows the content around the user first.  Cancelled
+// requests are queued again, so they resolve once the user comes back.
+//
+// No callbacks are used, so results are only ever handled on the thread
+// calling Update().  Not thread safe.
+class AnchorResolveScheduler {
+ public:
+  enum class AnchorType { kTerrain, kRooftop };
+
+  struct Request {
+    AnchorType type = AnchorType::kTerrain;
+    double latitude = 0.0;
+    double longitude = 0.0;
+    // Above the terrain or the rooftop at the location, in meters.
+    double altitude_m = 0.0;
+    // Orientation in the East-Up-South frame as qx, qy, qz, qw.
+    float eus_quaternion[4] = {0.f, 0.f, 0.f, 1.f};
+  };
+
+  struct Result {
+    // As returned by Submit().
+    uint32_t id = 0;
+    // The resolved anchor, whose reference passes to the caller, or nullptr
+    // if the request failed.
+    ArAnchor* anchor = nullptr;
+    // The location of the request.
+    double latitude = 0.0;
+    double longitude = 0.0;
+    double altitude_m = 0.0;
+    // From Submit() until the result arrived, including the time queued.
+    std::chrono::steady_clock::duration latency{};
+  };
+
+  // Requests starting no farther than this from the camera.
+  static constexpr double kStartDistanceM = 150.0;
+  // Outstanding requests farther than this are cancelled.  Larger than
+  // kStartDistanceM, so a request near the limit is not cancelled right
+  // after it started.
+  static constexpr double kCancelDistanceM = 250.0;
+
+  // Each outstanding future also holds one of |budget|, which may be nullptr
+  // and must outlive the scheduler otherwise.
+  AnchorResolveScheduler(int max_outstanding, AnchorRequestBudget* budget);
+  ~AnchorResolveScheduler();
+
+  AnchorResolveScheduler(const AnchorResolveScheduler&) = delete;
+  AnchorResolveScheduler& operator=(const AnchorResolveScheduler&) = delete;
+
+  // Queues |request| and returns its id.
+  uint32_t Submit(const Request& request);
+
+  // Polls, cancels and starts requests as described above, and appends the
+  // requests that finished to |results|.  Nothing is started while |earth|
+  // is nullptr or not tracking, since the distances are unknown then.
+  // |scratch_pose| receives the camera's Geospatial pose.
+  void Update(ArSession* session, ArEarth* earth,
+              ArGeospatialPose* scratch_pose, std::vector<Result>* results);
+
+  // Cancels and releases every outstanding future and drops the queue.  Must
+  // be called before the session is destroyed.
+  void Clear(const ArSession* session);
+
+  size_t GetQueuedCount() const { return queued_.size(); }
+  size_t GetOutstandingCount() const { return outstanding_.size(); }
+
+ private:
+  struct Entry {
+    uint32_t id = 0;
+    Request request;
+    std::chrono::steady_clock::time_point submit_time;
+    // Distance from the camera as of the last Update().
+    double distance_m = 0.0;
+    // Only set while outstanding.
+    ArFuture* future = nullptr;
+  };
+
+  // Moves the futures that are done or cancelled out of outstanding_.
+  void PollOutstanding(const ArSession* session, std::vector<Result>* results);
+
+  // Starts |entry|.  Returns the error of ARCore, in which case |entry| was
+  // not started.
+  ArStatus Start(ArSession* session, ArEarth* earth, Entry* entry);
+
+  const int max_outstanding_;
+  AnchorRequestBudget* const budget_;
+  uint32_t next_id_ = 1;
+  std::vector<Entry> queued_;
+  std::vector<Entry> outstanding_;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_ANCHOR_RESOLVE_SCHEDULER_H_
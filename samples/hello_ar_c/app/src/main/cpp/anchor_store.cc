@@ -0,0 +1,328 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "anchor_store.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "resource_accounting.h"
+
+namespace hello_ar {
+namespace {
+constexpr int kCellCoordinateBits = 21;
+constexpr uint64_t kCellCoordinateMask = (1ull << kCellCoordinateBits) - 1;
+}  // namespace
+
+constexpr uint32_t AnchorStore::kInvalidSlot;
+
+AnchorStore::AnchorStore(size_t capacity, EvictionPolicy policy,
+                         float cell_size_m)
+    : capacity_(std::max<size_t>(capacity, 1)),
+      policy_(policy),
+      cell_size_m_(cell_size_m) {
+  entries_.reserve(capacity_);
+  slots_.reserve(capacity_);
+}
+
+AnchorStore::~AnchorStore() { Clear(); }
+
+AnchorStore::Handle AnchorStore::Add(const ArSession* session,
+                                     ArPose* scratch_pose, ArAnchor* anchor,
+                                     ArTrackable* trackable) {
+  if (entries_.size() >= capacity_) {
+    Remove(SelectEviction());
+  }
+
+  uint32_t slot_index;
+  if (!free_slots_.empty()) {
+    slot_index = free_slots_.back();
+    free_slots_.pop_back();
+  } else {
+    slot_index = static_cast<uint32_t>(slots_.size());
+    slots_.emplace_back();
+  }
+  Slot& slot = slots_[slot_index];
+  slot.entry_index = static_cast<uint32_t>(entries_.size());
+
+  Entry entry;
+  entry.anchor = anchor;
+  entry.trackable = trackable;
+  entry.handle.slot = slot_index;
+  entry.handle.generation = slot.generation;
+  entry.sequence = next_sequence_++;
+  // New anchors count as visible so they are not the first to go.
+  entry.last_visible_frame = frame_;
+  entries_.push_back(entry);
+  poses_.Resize(entries_.size());
+  ReadEntry(session, scratch_pose, slot.entry_index);
+  model_matrices_.push_back(poses_.GetMatrix(slot.entry_index));
+  InsertIntoCell(slot.entry_index);
+
+  insertion_order_.push_back(entry.handle);
+  if (insertion_order_.size() > 2 * capacity_) {
+    // Drops the handles of anchors removed out of order.
+    insertion_order_.erase(
+        std::remove_if(insertion_order_.begin(), insertion_order_.end(),
+                       [this](Handle handle) { return !Get(handle); }),
+        insertion_order_.end());
+  }
+
+  ResourceAccounting::Get().AddArHandles(ArHandleType::kAnchor, 1);
+  if (trackable != nullptr) {
+    ResourceAccounting::Get().AddArHandles(ArHandleType::kTrackable, 1);
+  }
+  return entry.handle;
+}
+
+bool AnchorStore::Remove(Handle handle) {
+  if (Get(handle) == nullptr) {
+    return false;
+  }
+  Slot& slot = slots_[handle.slot];
+  const uint32_t index = slot.entry_index;
+  ReleaseEntry(entries_[index]);
+  RemoveFromCell(index);
+
+  // Moves the last entry into the hole.
+  const uint32_t last = static_cast<uint32_t>(entries_.size() - 1);
+  if (index != last) {
+    RenameInCell(last, index);
+    entries_[index] = entries_[last];
+    poses_.Copy(last, index);
+    model_matrices_[index] = model_matrices_[last];
+    slots_[entries_[index].handle.slot].entry_index = index;
+  }
+  entries_.pop_back();
+  poses_.Resize(entries_.size());
+  model_matrices_.pop_back();
+
+  ++slot.generation;
+  free_slots_.push_back(handle.slot);
+  return true;
+}
+
+void AnchorStore::Clear() {
+  for (const Entry& entry : entries_) {
+    ReleaseEntry(entry);
+  }
+  entries_.clear();
+  poses_.Resize(0);
+  model_matrices_.clear();
+  cells_.clear();
+  insertion_order_.clear();
+  free_slots_.clear();
+  for (uint32_t i = 0; i < slots_.size(); ++i) {
+    ++slots_[i].generation;
+    free_slots_.push_back(i);
+  }
+}
+
+uint32_t AnchorStore::FindEntryIndex(Handle handle) const {
+  if (handle.slot >= slots_.size()) {
+    return kInvalidSlot;
+  }
+  const Slot& slot = slots_[handle.slot];
+  if (slot.generation != handle.generation ||
+      slot.entry_index >= entries_.size()) {
+    return kInvalidSlot;
+  }
+  return slot.entry_index;
+}
+
+AnchorStore::Entry* AnchorStore::Get(Handle handle) {
+  const uint32_t index = FindEntryIndex(handle);
+  return index == kInvalidSlot ? nullptr : &entries_[index];
+}
+
+const AnchorStore::Entry* AnchorStore::Get(Handle handle) const {
+  const uint32_t index = FindEntryIndex(handle);
+  return index == kInvalidSlot ? nullptr : &entries_[index];
+}
+
+int AnchorStore::BeginFrame(const ArSession* session, ArPose* scratch_pose,
+                            const glm::vec3& camera_position) {
+  ++frame_;
+  camera_position_ = camera_position;
+  int tracking = 0;
+  for (uint32_t i = 0; i < entries_.size(); ++i) {
+    if (entries_[i].deferred
+            ? entries_[i].tracking_state == AR_TRACKING_STATE_TRACKING
+            : ReadEntry(session, scratch_pose, i)) {
+      ++tracking;
+    }
+  }
+  poses_.GetMatrices(model_matrices_.data());
+  for (uint32_t i = 0; i < entries_.size(); ++i) {
+    UpdateCell(i);
+  }
+  return tracking;
+}
+
+bool AnchorStore::Refresh(const ArSession* session, ArPose* scratch_pose,
+                          Handle handle) {
+  const uint32_t index = FindEntryIndex(handle);
+  if (index == kInvalidSlot) {
+    return false;
+  }
+  ReadEntry(session, scratch_pose, index);
+  return true;
+}
+
+void AnchorStore::QueryFrustum(const util::Frustum& frustum, float margin_m,
+                               std::vector<Entry*>* entries) {
+  const float half_size = 0.5f * cell_size_m_;
+  // Sphere around the cube of a cell, grown by the margin.
+  const float radius = half_size * std::sqrt(3.0f) + margin_m;
+  for (auto& key_and_cell : cells_) {
+    const Cell& cell = key_and_cell.second;
+    const glm::vec3 center =
+        glm::vec3(cell.coordinates) * cell_size_m_ + glm::vec3(half_size);
+    if (!util::IsSphereInFrustum(frustum, center, radius)) {
+      continue;
+    }
+    for (uint32_t index : cell.entry_indices) {
+      entries->push_back(&entries_[index]);
+    }
+  }
+}
+
+bool AnchorStore::ReadEntry(const ArSession* session, ArPose* scratch_pose,
+                            uint32_t entry_index) {
+  Entry& entry = entries_[entry_index];
+  ArAnchor_getTrackingState(session, entry.anchor, &entry.tracking_state);
+  if (entry.tracking_state != AR_TRACKING_STATE_TRACKING) {
+    // Keeps the last tracked pose.
+    return false;
+  }
+  poses_.ReadAnchorPose(session, entry.anchor, scratch_pose, entry_index);
+  return true;
+}
+
+void AnchorStore::UpdateCell(uint32_t entry_index) {
+  const glm::ivec3 coordinates =
+      GetCellCoordinates(poses_.GetTranslation(entry_index));
+  if (GetCellKey(coordinates) != entries_[entry_index].cell_key) {
+    RemoveFromCell(entry_index);
+    InsertIntoCell(entry_index);
+  }
+}
+
+glm::ivec3 AnchorStore::GetCellCoordinates(const glm::vec3& position) const {
+  return glm::ivec3(glm::floor(position / cell_size_m_));
+}
+
+uint64_t AnchorStore::GetCellKey(const glm::ivec3& coordinates) {
+  // Cells 2^21 apart share a key, thousands of kilometers at the cell sizes
+  // in use, far beyond what a session tracks.
+  return ((static_cast<uint64_t>(coordinates.x) & kCellCoordinateMask)
+          << (2 * kCellCoordinateBits)) |
+         ((static_cast<uint64_t>(coordinates.y) & kCellCoordinateMask)
+          << kCellCoordinateBits) |
+         (static_cast<uint64_t>(coordinates.z) & kCellCoordinateMask);
+}
+
+void AnchorStore::InsertIntoCell(uint32_t entry_index) {
+  Entry& entry = entries_[entry_index];
+  const glm::ivec3 coordinates =
+      GetCellCoordinates(poses_.GetTranslation(entry_index));
+  entry.cell_key = GetCellKey(coordinates);
+  Cell& cell = cells_[entry.cell_key];
+  if (cell.entry_indices.empty()) {
+    cell.coordinates = coordinates;
+  }
+  cell.entry_indices.push_back(entry_index);
+}
+
+void AnchorStore::RemoveFromCell(uint32_t entry_index) {
+  auto it = cells_.find(entries_[entry_index].cell_key);
+  if (it == cells_.end()) {
+    return;
+  }
+  std::vector<uint32_t>& indices = it->second.entry_indices;
+  auto index = std::find(indices.begin(), indices.end(), entry_index);
+  if (index != indices.end()) {
+    *index = indices.back();
+    indices.pop_back();
+  }
+  if (indices.empty()) {
+    cells_.erase(it);
+  }
+}
+
+void AnchorStore::RenameInCell(uint32_t old_index, uint32_t new_index) {
+  auto it = cells_.find(entries_[old_index].cell_key);
+  if (it == cells_.end()) {
+    return;
+  }
+  std::vector<uint32_t>& indices = it->second.entry_indices;
+  std::replace(indices.begin(), indices.end(), old_index, new_index);
+}
+
+AnchorStore::Handle AnchorStore::SelectEviction() {
+  if (entries_.empty()) {
+    return Handle();
+  }
+  switch (policy_) {
+    case EvictionPolicy::kOldest:
+      while (!insertion_order_.empty()) {
+        const Handle handle = insertion_order_.front();
+        insertion_order_.pop_front();
+        if (Get(handle) != nullptr) {
+          return handle;
+        }
+      }
+      break;
+    case EvictionPolicy::kLeastRecentlyVisible: {
+      // Ties go to the older anchor, so anchors that were never visible
+      // leave in the order they came.
+      const Entry* selected = &entries_[0];
+      for (const Entry& entry : entries_) {
+        if (entry.last_visible_frame < selected->last_visible_frame ||
+            (entry.last_visible_frame == selected->last_visible_frame &&
+             entry.sequence < selected->sequence)) {
+          selected = &entry;
+        }
+      }
+      return selected->handle;
+    }
+    case EvictionPolicy::kFarthestFromCamera: {
+      size_t selected = 0;
+      float selected_distance2 = -1.0f;
+      for (size_t i = 0; i < entries_.size(); ++i) {
+        const glm::vec3 offset = poses_.GetTranslation(i) - camera_position_;
+        const float distance2 = glm::dot(offset, offset);
+        if (distance2 > selected_distance2) {
+          selected = i;
+          selected_distance2 = distance2;
+        }
+      }
+      return entries_[selected].handle;
+    }
+  }
+  return entries_[0].handle;
+}
+
+void AnchorStore::ReleaseEntry(const Entry& entry) {
+  ArAnchor_release(entry.anchor);
+  ResourceAccounting::Get().AddArHandles(ArHandleType::kAnchor, -1);
+  if (entry.trackable != nullptr) {
+    ArTrackable_release(entry.trackable);
+    ResourceAccounting::Get().AddArHandles(ArHandleType::kTrackable, -1);
+  }
+}
+
+}  // namespace hello_ar
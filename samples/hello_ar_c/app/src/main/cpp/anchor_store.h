@@ -0,0 +1,220 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_ANCHOR_STORE_H_
+#define C_ARCORE_HELLOE_AR_ANCHOR_STORE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+#include "arcore_c_api.h"
+#include "glm.h"
+#include "pose_batch.h"
+#include "util.h"
+
+namespace hello_ar {
+
+// The anchors the app placed, up to a fixed capacity.
+//
+// Anchors live in a slot map: the entries are a dense array that is iterated
+// every frame, handles stay valid until their anchor is removed, and adding
+// or removing an anchor is O(1) whatever the number of anchors.  When the
+// store is full, Add() evicts an anchor chosen by the eviction policy.
+//
+// BeginFrame() asks ARCore for the tracking state and pose of every anchor
+// once, so the rest of the frame reads them from the store.  The poses are
+// kept as a PoseBatch in the order of the entries and converted to model
+// matrices in one pass.  The anchors
+// are also hashed into cubic cells by their position, which lets
+// QueryFrustum() skip whole cells outside the view.
+//
+// The store owns the anchor and trackable references it is given.  Not
+// thread safe.
+class AnchorStore {
+ public:
+  enum class EvictionPolicy {
+    // The anchor added first.
+    kOldest,
+    // The anchor that has not been marked visible for the most frames.
+    kLeastRecentlyVisible,
+    // The anchor farthest from the camera position of the last BeginFrame().
+    kFarthestFromCamera,
+  };
+
+  static constexpr uint32_t kInvalidSlot = UINT32_MAX;
+
+  // Refers to an anchor until it is removed, after which Get() returns
+  // nullptr for it, even if its slot was reused.
+  struct Handle {
+    uint32_t slot = kInvalidSlot;
+    uint32_t generation = 0;
+
+    bool IsValid() const { return slot != kInvalidSlot; }
+  };
+
+  struct Entry {
+    ArAnchor* anchor = nullptr;
+    ArTrackable* trackable = nullptr;
+    Handle handle;
+
+    // As of the last BeginFrame().
+    ArTrackingState tracking_state = AR_TRACKING_STATE_STOPPED;
+
+    // Drawing state of the app.
+    float color[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    // Level of detail the anchor was last drawn with, kept for hysteresis.
+    int lod = 0;
+    // Node of the content drawn at the anchor, see SceneGraph.
+    uint32_t scene_node = UINT32_MAX;
+    // Skipped by BeginFrame(); the app refreshes the anchor with Refresh()
+    // when it wants to, e.g. from a GeospatialAnchorIndex.
+    bool deferred = false;
+
+    // Bookkeeping of the store.
+    uint64_t sequence = 0;
+    int64_t last_visible_frame = 0;
+    uint64_t cell_key = 0;
+  };
+
+  AnchorStore(size_t capacity, EvictionPolicy policy, float cell_size_m);
+  ~AnchorStore();
+
+  AnchorStore(const AnchorStore&) = delete;
+  AnchorStore& operator=(const AnchorStore&) = delete;
+
+  void SetEvictionPolicy(EvictionPolicy policy) { policy_ = policy; }
+
+  // Takes over the references of |anchor| and |trackable|, evicting an
+  // anchor first if the store is full.  |trackable| may be nullptr.
+  Handle Add(const ArSession* session, ArPose* scratch_pose, ArAnchor* anchor,
+             ArTrackable* trackable);
+
+  // Releases the anchor of |handle|.  Returns false if it was removed
+  // already.
+  bool Remove(Handle handle);
+
+  // Releases all anchors.  Must be called before the session is destroyed.
+  void Clear();
+
+  // The entry of |handle|, or nullptr if it was removed.  Valid until the
+  // next Add() or Remove().
+  Entry* Get(Handle handle);
+  const Entry* Get(Handle handle) const;
+
+  // Refreshes the tracking state and pose of every anchor that is not
+  // deferred and moves the anchors ARCore refined to their new cells.
+  // Returns the number of anchors that are tracking, deferred ones as of
+  // their last refresh.
+  int BeginFrame(const ArSession* session, ArPose* scratch_pose,
+                  const glm::vec3& camera_position);
+
+  // Refreshes the tracking state and pose of the deferred anchor of
+  // |handle|, whose model matrix follows in the next BeginFrame().  Returns
+  // false if it was removed.
+  bool Refresh(const ArSession* session, ArPose* scratch_pose, Handle handle);
+
+  // The pose of |entry| as of the last BeginFrame(), or the last one it
+  // was tracking in.
+  const glm::mat4& GetModelMatrix(const Entry& entry) const {
+    return model_matrices_[GetIndex(entry)];
+  }
+  glm::vec3 GetPosition(const Entry& entry) const {
+    return poses_.GetTranslation(GetIndex(entry));
+  }
+  // The same pose in the order of ArPose_getPoseRaw(), seven floats, e.g. to
+  // tell whether it changed.
+  void GetRawPose(const Entry& entry, float* pose_raw) const {
+    poses_.GetRaw(GetIndex(entry), pose_raw);
+  }
+
+  // Marks |entry| visible in the current frame, see
+  // EvictionPolicy::kLeastRecentlyVisible.
+  void MarkVisible(Entry* entry) { entry->last_visible_frame = frame_; }
+
+  // Appends the entries of the cells that |frustum| may see to |entries|.
+  // Cells are grown by |margin_m|, e.g. the radius of the content drawn at
+  // the anchors.  Valid until the next Add() or Remove().
+  void QueryFrustum(const util::Frustum& frustum, float margin_m,
+                    std::vector<Entry*>* entries);
+
+  size_t GetSize() const { return entries_.size(); }
+
+  // All entries, in no particular order.  Valid until the next Add() or
+  // Remove().
+  const std::vector<Entry>& GetEntries() const { return entries_; }
+  size_t GetCellCount() const { return cells_.size(); }
+
+ private:
+  struct Slot {
+    uint32_t entry_index = 0;
+    uint32_t generation = 0;
+  };
+
+  struct Cell {
+    glm::ivec3 coordinates = glm::ivec3(0);
+    std::vector<uint32_t> entry_indices;
+  };
+
+  size_t GetIndex(const Entry& entry) const { return &entry - &entries_[0]; }
+  // Index of the entry of |handle|, or kInvalidSlot if it was removed.
+  uint32_t FindEntryIndex(Handle handle) const;
+
+  // Reads the tracking state and, if tracking, the pose of the entry at
+  // |entry_index|.  Returns whether it is tracking.
+  bool ReadEntry(const ArSession* session, ArPose* scratch_pose,
+                 uint32_t entry_index);
+  // Moves the entry at |entry_index| to the cell of its position.
+  void UpdateCell(uint32_t entry_index);
+
+  glm::ivec3 GetCellCoordinates(const glm::vec3& position) const;
+  static uint64_t GetCellKey(const glm::ivec3& coordinates);
+
+  void InsertIntoCell(uint32_t entry_index);
+  void RemoveFromCell(uint32_t entry_index);
+  // Points the cell of the entry that moved to |entry_index| at it.
+  void RenameInCell(uint32_t old_index, uint32_t new_index);
+
+  // The handle of the anchor to evict according to |policy_|.
+  Handle SelectEviction();
+
+  void ReleaseEntry(const Entry& entry);
+
+  const size_t capacity_;
+  EvictionPolicy policy_;
+  const float cell_size_m_;
+
+  std::vector<Entry> entries_;
+  // Indexed like |entries_|.
+  PoseBatch poses_;
+  std::vector<glm::mat4> model_matrices_;
+  std::vector<Slot> slots_;
+  std::vector<uint32_t> free_slots_;
+  std::unordered_map<uint64_t, Cell> cells_;
+  // Handles in the order they were added, for EvictionPolicy::kOldest.  The
+  // handles of removed anchors are skipped when they reach the front.
+  std::deque<Handle> insertion_order_;
+
+  uint64_t next_sequence_ = 0;
+  int64_t frame_ = 0;
+  glm::vec3 camera_position_ = glm::vec3(0.0f);
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_ANCHOR_STORE_H_
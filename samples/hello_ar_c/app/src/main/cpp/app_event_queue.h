@@ -0,0 +1,57 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef C_ARCORE_HELLOE_AR_APP_EVENT_QUEUE_H_
+#define C_ARCORE_HELLOE_AR_APP_EVENT_QUEUE_H_
+
+#include <cstdint>
+#include <string>
+
+#include "anchor_resolve_scheduler.h"
+#include "spsc_queue.h"
+
+namespace hello_ar {
+
+// Input from the UI thread that is applied on the thread that updates the
+// session, at the start of its next frame, so the UI thread never calls into
+// the session while ArSession_update runs.
+struct AppEvent {
+  enum class Type {
+    // A screen touch at (x, y), hit tested against the next frame.
+    kTouch,
+    // New settings, which may need the session to be reconfigured.
+    kSettingsChange,
+    // A Geospatial anchor to resolve, see AnchorResolveScheduler.
+    kResolveGeospatialAnchor,
+    // A Cloud Anchor id to resolve, see CloudAnchorPipeline.
+    kResolveCloudAnchor
+  };
+
+  Type type = Type::kTouch;
+  float x = 0.f;
+  float y = 0.f;
+  bool is_instant_placement_enabled = false;
+  AnchorResolveScheduler::Request geospatial_anchor;
+  std::string cloud_anchor_id;
+};
+
+// Events are dropped when the queue is full, which only happens if no frame
+// was drawn for a long burst of input.
+constexpr uint32_t kAppEventQueueCapacity = 64;
+using AppEventQueue = SpscQueue<AppEvent, kAppEventQueueCapacity>;
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_APP_EVENT_QUEUE_H_
@@ -0,0 +1,71 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ar_capture_format.h"
+
+#include <cstring>
+
+namespace hello_ar {
+namespace capture {
+
+size_t EncodeDepth(const uint8_t* pixels, int32_t width, int32_t height,
+                   int32_t row_stride, uint8_t* out, size_t capacity) {
+  size_t size = 0;
+  int32_t row_start = 0;
+  for (int32_t y = 0; y < height; ++y) {
+    // Only rows whose every pixel takes the longest varint could overflow,
+    // so the check is per row.
+    if (size + width * kMaxVarintSize > capacity) {
+      return 0;
+    }
+    const uint8_t* row = pixels + static_cast<size_t>(y) * row_stride;
+    int32_t previous = row_start;
+    for (int32_t x = 0; x < width; ++x) {
+      uint16_t value;
+      memcpy(&value, row + 2 * x, sizeof(value));
+      size += WriteVarint(ZigZagEncode(value - previous), out + size);
+      previous = value;
+      if (x == 0) {
+        row_start = value;
+      }
+    }
+  }
+  return size;
+}
+
+bool DecodeDepth(const uint8_t* data, size_t size, int32_t width,
+                 int32_t height, uint16_t* out) {
+  const uint8_t* end = data + size;
+  int32_t row_start = 0;
+  for (int32_t y = 0; y < height; ++y) {
+    int32_t previous = row_start;
+    for (int32_t x = 0; x < width; ++x) {
+      uint32_t delta;
+      if (!ReadVarint(&data, end, &delta)) {
+        return false;
+      }
+      previous += ZigZagDecode(delta);
+      out[y * width + x] = static_cast<uint16_t>(previous);
+      if (x == 0) {
+        row_start = previous;
+      }
+    }
+  }
+  return true;
+}
+
+}  // namespace capture
+}  // namespace hello_ar
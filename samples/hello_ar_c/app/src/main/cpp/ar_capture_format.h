@@ -0,0 +1,241 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_AR_CAPTURE_FORMAT_H_
+#define C_ARCORE_HELLOE_AR_AR_CAPTURE_FORMAT_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace hello_ar {
+namespace capture {
+
+// File format of a session capture: the ARCore state of every frame, written
+// on the device and read back by the desktop replay of the ARCore C API in
+// tools/arcore_replay.
+//
+// A FileHeader is followed by records, each a RecordHeader and |size| bytes
+// of payload.  A kFrame record starts a frame and the records up to the next
+// one belong to it.  Only what changed is written: a plane when ARCore
+// updated it, the point cloud, depth image and light estimate when their
+// timestamp changed, the display geometry when it changed.  A reader keeps
+// the latest state of everything else.  Unknown record types are skipped, so
+// records can be added without a new version.
+//
+// Everything is little endian and read with memcpy, so the payloads need no
+// alignment.  Poses are ARCore's raw poses: the rotation quaternion x, y, z,
+// w, then the translation.
+
+constexpr char kMagic[8] = {'A', 'R', 'C', 'A', 'P', 'T', 'U', 'R'};
+constexpr uint32_t kVersion = 1;
+
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+};
+static_assert(sizeof(FileHeader) == 16, "FileHeader must be packed");
+
+enum RecordType : uint16_t {
+  kSessionInfo = 1,
+  kFrame = 2,
+  kCamera = 3,
+  kDisplayGeometry = 4,
+  kPlane = 5,
+  kPointCloud = 6,
+  kAnchor = 7,
+  kLightEstimate = 8,
+  kDepthImage = 9,
+};
+
+struct RecordHeader {
+  uint16_t type;
+  uint16_t flags;
+  uint32_t size;
+};
+static_assert(sizeof(RecordHeader) == 8, "RecordHeader must be packed");
+
+// Written before the first frame and whenever the camera config changes.
+struct SessionInfoRecord {
+  int32_t image_width;
+  int32_t image_height;
+  int32_t texture_width;
+  int32_t texture_height;
+  int32_t min_fps;
+  int32_t max_fps;
+  // Near and far plane of CameraRecord::projection.
+  float projection_near;
+  float projection_far;
+};
+static_assert(sizeof(SessionInfoRecord) == 32, "must be packed");
+
+struct FrameRecord {
+  int64_t timestamp_ns;
+  uint32_t frame_index;
+  uint32_t reserved;
+};
+static_assert(sizeof(FrameRecord) == 16, "must be packed");
+
+struct CameraIntrinsicsRecord {
+  float fx;
+  float fy;
+  float cx;
+  float cy;
+  int32_t width;
+  int32_t height;
+};
+
+// Written every frame.
+struct CameraRecord {
+  int32_t tracking_state;
+  // ArCamera_getPose() and ArFrame_getAndroidSensorPose().
+  float pose[7];
+  float android_sensor_pose[7];
+  // ArCamera_getProjectionMatrix() with the SessionInfoRecord planes.
+  float projection[16];
+  CameraIntrinsicsRecord image_intrinsics;
+  CameraIntrinsicsRecord texture_intrinsics;
+};
+static_assert(sizeof(CameraRecord) == 172, "must be packed");
+
+// The 2D affine transforms ArFrame_transformCoordinates2d() applies to
+// OpenGL normalized device coordinates, row major: u = m[0] x + m[1] y +
+// m[2], v = m[3] x + m[4] y + m[5].
+struct DisplayGeometryRecord {
+  int32_t rotation;
+  int32_t width;
+  int32_t height;
+  float ndc_to_texture_normalized[6];
+  float ndc_to_image_normalized[6];
+};
+static_assert(sizeof(DisplayGeometryRecord) == 60, "must be packed");
+
+// Polygon vertices are stored in kPolygonUnitM units as int16 x, z pairs,
+// the first one absolute and the others relative to the one before.
+constexpr float kPolygonUnitM = 0.001f;
+
+// Followed by |vertex_count| delta coded vertices.
+struct PlaneRecord {
+  // Number of the plane in the order the capture first saw the planes.
+  int32_t id;
+  int32_t type;
+  int32_t tracking_state;
+  // Id of the plane that subsumed this one, or -1.
+  int32_t subsumed_by;
+  float center_pose[7];
+  float extent_x;
+  float extent_z;
+  uint32_t vertex_count;
+};
+static_assert(sizeof(PlaneRecord) == 56, "must be packed");
+
+// Followed by |point_count| x, y, z, confidence floats, then the point ids
+// as zigzag varints, each relative to the id before it.
+struct PointCloudRecord {
+  int64_t timestamp_ns;
+  uint32_t point_count;
+  uint32_t reserved;
+};
+static_assert(sizeof(PointCloudRecord) == 16, "must be packed");
+
+// Written every frame for every anchor the capturing app holds.
+struct AnchorRecord {
+  // Number of the anchor in the order the capturing app created them.
+  int32_t id;
+  int32_t tracking_state;
+  float pose[7];
+};
+static_assert(sizeof(AnchorRecord) == 36, "must be packed");
+
+struct LightEstimateRecord {
+  int64_t timestamp_ns;
+  int32_t state;
+  float color_correction[4];
+  float spherical_harmonics[27];
+};
+static_assert(sizeof(LightEstimateRecord) == 136, "must be packed");
+
+// Followed by |encoded_size| bytes: the millimeters of every pixel as zigzag
+// varints relative to the pixel on its left, or above for the first pixel of
+// a row.
+struct DepthImageRecord {
+  int64_t timestamp_ns;
+  uint16_t width;
+  uint16_t height;
+  uint32_t encoded_size;
+};
+static_assert(sizeof(DepthImageRecord) == 16, "must be packed");
+
+// Largest varint, in bytes.
+constexpr size_t kMaxVarintSize = 5;
+
+inline uint32_t ZigZagEncode(int32_t value) {
+  return (static_cast<uint32_t>(value) << 1) ^
+         static_cast<uint32_t>(value >> 31);
+}
+
+inline int32_t ZigZagDecode(uint32_t value) {
+  return static_cast<int32_t>((value >> 1) ^ (~(value & 1) + 1));
+}
+
+// Writes |value| to |out|, which must have kMaxVarintSize bytes, and returns
+// the bytes written.
+inline size_t WriteVarint(uint32_t value, uint8_t* out) {
+  size_t size = 0;
+  while (value >= 0x80) {
+    out[size++] = static_cast<uint8_t>(value | 0x80);
+    value >>= 7;
+  }
+  out[size++] = static_cast<uint8_t>(value);
+  return size;
+}
+
+// Reads a varint at |*data| and advances it.  Returns false if the varint
+// does not end before |end|.
+inline bool ReadVarint(const uint8_t** data, const uint8_t* end,
+                       uint32_t* value) {
+  uint32_t result = 0;
+  for (int shift = 0; shift < 35 && *data < end; shift += 7) {
+    const uint8_t byte = *(*data)++;
+    result |= static_cast<uint32_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      *value = result;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Bytes EncodeDepth() may need for a |width| x |height| image.
+inline size_t GetMaxEncodedDepthSize(int32_t width, int32_t height) {
+  return static_cast<size_t>(width) * height * 3;
+}
+
+// Delta codes a DEPTH16 image whose rows are |row_stride| bytes apart into
+// |out|, which has |capacity| bytes.  Returns the encoded size, or 0 if it
+// does not fit.
+size_t EncodeDepth(const uint8_t* pixels, int32_t width, int32_t height,
+                   int32_t row_stride, uint8_t* out, size_t capacity);
+
+// Decodes |size| bytes of EncodeDepth() output into |width| x |height|
+// millimeters.  Returns false if the data is truncated.
+bool DecodeDepth(const uint8_t* data, size_t size, int32_t width,
+                 int32_t height, uint16_t* out);
+
+}  // namespace capture
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_AR_CAPTURE_FORMAT_H_
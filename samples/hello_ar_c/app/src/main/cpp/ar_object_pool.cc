@@ -0,0 +1,114 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ar_object_pool.h"
+
+#include "util.h"
+
+namespace hello_ar {
+
+ArObjectPool::~ArObjectPool() { Destroy(); }
+
+void ArObjectPool::Initialize(const ArSession* session) {
+  Destroy();
+  session_ = session;
+  allocations_this_frame_ = 0;
+  allocations_last_frame_ = 0;
+  total_allocations_ = 0;
+}
+
+void ArObjectPool::Destroy() {
+  DestroyAll(&trackable_lists_, ArTrackableList_destroy);
+  DestroyAll(&hit_result_lists_, ArHitResultList_destroy);
+  DestroyAll(&hit_results_, ArHitResult_destroy);
+  DestroyAll(&poses_, ArPose_destroy);
+  DestroyAll(&light_estimates_, ArLightEstimate_destroy);
+  DestroyAll(&camera_intrinsics_, ArCameraIntrinsics_destroy);
+  session_ = nullptr;
+}
+
+void ArObjectPool::BeginFrame() {
+  trackable_lists_.next = 0;
+  hit_result_lists_.next = 0;
+  hit_results_.next = 0;
+  poses_.next = 0;
+  light_estimates_.next = 0;
+  camera_intrinsics_.next = 0;
+  allocations_last_frame_ = allocations_this_frame_;
+  allocations_this_frame_ = 0;
+}
+
+ArTrackableList* ArObjectPool::AcquireTrackableList() {
+  return Acquire(&trackable_lists_, [this](ArTrackableList** out_list) {
+    ArTrackableList_create(session_, out_list);
+  });
+}
+
+ArHitResultList* ArObjectPool::AcquireHitResultList() {
+  return Acquire(&hit_result_lists_, [this](ArHitResultList** out_list) {
+    ArHitResultList_create(session_, out_list);
+  });
+}
+
+ArHitResult* ArObjectPool::AcquireHitResult() {
+  return Acquire(&hit_results_, [this](ArHitResult** out_hit_result) {
+    ArHitResult_create(session_, out_hit_result);
+  });
+}
+
+ArPose* ArObjectPool::AcquirePose() {
+  return Acquire(&poses_, [this](ArPose** out_pose) {
+    ArPose_create(session_, nullptr, out_pose);
+  });
+}
+
+ArLightEstimate* ArObjectPool::AcquireLightEstimate() {
+  return Acquire(&light_estimates_, [this](ArLightEstimate** out_estimate) {
+    ArLightEstimate_create(session_, out_estimate);
+  });
+}
+
+ArCameraIntrinsics* ArObjectPool::AcquireCameraIntrinsics() {
+  return Acquire(&camera_intrinsics_,
+                 [this](ArCameraIntrinsics** out_intrinsics) {
+                   ArCameraIntrinsics_create(session_, out_intrinsics);
+                 });
+}
+
+template <typename T, typename CreateFunction>
+T* ArObjectPool::Acquire(Slots<T>* slots, CreateFunction create) {
+  CHECK(session_ != nullptr);
+  if (slots->next == slots->handles.size()) {
+    T* handle = nullptr;
+    create(&handle);
+    CHECK(handle != nullptr);
+    slots->handles.push_back(handle);
+    ++allocations_this_frame_;
+    ++total_allocations_;
+  }
+  return slots->handles[slots->next++];
+}
+
+template <typename T, typename DestroyFunction>
+void ArObjectPool::DestroyAll(Slots<T>* slots, DestroyFunction destroy) {
+  for (T* handle : slots->handles) {
+    destroy(handle);
+  }
+  slots->handles.clear();
+  slots->next = 0;
+}
+
+}  // namespace hello_ar
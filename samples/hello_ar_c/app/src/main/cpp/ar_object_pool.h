@@ -0,0 +1,101 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_AR_OBJECT_POOL_H_
+#define C_ARCORE_HELLOE_AR_AR_OBJECT_POOL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "arcore_c_api.h"
+
+namespace hello_ar {
+
+// Session-scoped pool of the ARCore scratch handles used every frame.
+//
+// Handles are handed out by the Acquire*() methods and all of them are
+// recycled by the next BeginFrame(), so a handle must not be kept across
+// frames.  A handle is only created when the pool has no free one of that
+// type, which means that once the per-frame demand has been seen the ARCore
+// allocator is never hit again.  GetAllocationsLastFrame() reports how many
+// handles had to be created during the previous frame and should read zero
+// in steady state.
+//
+// The pool is not thread safe and is meant to be used on the OpenGL thread.
+class ArObjectPool {
+ public:
+  ArObjectPool() = default;
+  ~ArObjectPool();
+
+  ArObjectPool(const ArObjectPool&) = delete;
+  ArObjectPool& operator=(const ArObjectPool&) = delete;
+
+  // Binds the pool to |session|.  Must be called after ArSession_create and
+  // before any Acquire*() call.
+  void Initialize(const ArSession* session);
+
+  // Destroys all pooled handles.  Must be called before the session is
+  // destroyed.
+  void Destroy();
+
+  // Recycles every handle acquired since the previous call.
+  void BeginFrame();
+
+  ArTrackableList* AcquireTrackableList();
+  ArHitResultList* AcquireHitResultList();
+  ArHitResult* AcquireHitResult();
+  ArPose* AcquirePose();
+  ArLightEstimate* AcquireLightEstimate();
+  ArCameraIntrinsics* AcquireCameraIntrinsics();
+
+  // Number of ARCore handles created during the previous frame.
+  int GetAllocationsLastFrame() const { return allocations_last_frame_; }
+
+  // Number of ARCore handles created since Initialize().
+  int64_t GetTotalAllocations() const { return total_allocations_; }
+
+ private:
+  template <typename T>
+  struct Slots {
+    std::vector<T*> handles;
+    // Index of the next free handle in |handles|.
+    size_t next = 0;
+  };
+
+  template <typename T, typename CreateFunction>
+  T* Acquire(Slots<T>* slots, CreateFunction create);
+
+  template <typename T, typename DestroyFunction>
+  static void DestroyAll(Slots<T>* slots, DestroyFunction destroy);
+
+  const ArSession* session_ = nullptr;
+
+  Slots<ArTrackableList> trackable_lists_;
+  Slots<ArHitResultList> hit_result_lists_;
+  Slots<ArHitResult> hit_results_;
+  Slots<ArPose> poses_;
+  Slots<ArLightEstimate> light_estimates_;
+  Slots<ArCameraIntrinsics> camera_intrinsics_;
+
+  int allocations_this_frame_ = 0;
+  int allocations_last_frame_ = 0;
+  int64_t total_allocations_ = 0;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_AR_OBJECT_POOL_H_
@@ -0,0 +1,259 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ar_update_thread.h"
+
+#include <unistd.h>
+
+#include <chrono>
+
+#include "arcore_trace.h"
+#include "resource_accounting.h"
+#include "util.h"
+
+namespace hello_ar {
+namespace {
+// How long the update thread backs off after a failed ArSession_update.
+constexpr std::chrono::milliseconds kUpdateRetryDelay(5);
+// Upper bound for a single wait on the reader, so Stop() is never delayed by
+// a missed notification.
+constexpr std::chrono::milliseconds kReaderWaitTimeout(2);
+}  // namespace
+
+ArUpdateThread::~ArUpdateThread() { Stop(); }
+
+bool ArUpdateThread::Start(ArSession* session, ArFrame* frame,
+                           BeforeUpdateCallback before_update,
+                           UpdateCallback callback, FrameStageTimers* timers) {
+  Stop();
+  if (!CreateSharedContext()) {
+    return false;
+  }
+
+  session_ = session;
+  frame_ = frame;
+  before_update_ = std::move(before_update);
+  callback_ = std::move(callback);
+  timers_ = timers;
+
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
+  glGenTextures(kNumCameraTextures, camera_textures_.data());
+  for (GLuint texture : camera_textures_) {
+    gl_state.BindTexture(GL_TEXTURE_EXTERNAL_OES, texture);
+    glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  }
+  // The textures are deleted on the update thread, so no binding is left for
+  // the state cache to track.
+  gl_state.BindTexture(GL_TEXTURE_EXTERNAL_OES, 0);
+  // The update thread must see complete texture objects.
+  glFlush();
+
+  write_index_ = 0;
+  read_index_ = 1;
+  shared_state_.store(2, std::memory_order_relaxed);
+  published_sequence_ = 0;
+  displayed_sequence_.store(0, std::memory_order_relaxed);
+
+  running_ = true;
+  thread_ = std::thread(&ArUpdateThread::Run, this);
+  return true;
+}
+
+void ArUpdateThread::Stop() {
+  if (!thread_.joinable()) {
+    return;
+  }
+  running_ = false;
+  reader_advanced_.notify_all();
+  thread_.join();
+  thread_id_.store(0, std::memory_order_relaxed);
+
+  DestroySharedContext();
+  session_ = nullptr;
+  frame_ = nullptr;
+  callback_ = nullptr;
+  timers_ = nullptr;
+}
+
+const ArFrameSnapshot* ArUpdateThread::AcquireLatestSnapshot(
+    bool* out_is_new) {
+  *out_is_new = false;
+  if (shared_state_.load(std::memory_order_relaxed) & kFreshBit) {
+    const uint32_t previous = shared_state_.exchange(
+        static_cast<uint32_t>(read_index_), std::memory_order_acq_rel);
+    read_index_ = static_cast<int>(previous & kIndexMask);
+    *out_is_new = true;
+  }
+
+  const ArFrameSnapshot& snapshot = snapshots_[read_index_];
+  if (snapshot.sequence == 0) {
+    return nullptr;
+  }
+  if (*out_is_new) {
+    if (snapshot.ready_fence != nullptr) {
+      glWaitSync(snapshot.ready_fence, 0, GL_TIMEOUT_IGNORED);
+    }
+    displayed_sequence_.store(snapshot.sequence, std::memory_order_release);
+    reader_advanced_.notify_one();
+  }
+  return &snapshot;
+}
+
+void ArUpdateThread::Run() {
+  thread_id_.store(gettid(), std::memory_order_relaxed);
+  if (eglMakeCurrent(display_, surface_, surface_, context_) != EGL_TRUE) {
+    LOGE("ArUpdateThread::Run eglMakeCurrent error 0x%x", eglGetError());
+    return;
+  }
+  ArSession_setCameraTextureNames(session_, kNumCameraTextures,
+                                  camera_textures_.data());
+
+  while (running_) {
+    WaitForReader();
+    if (!running_) {
+      break;
+    }
+
+    RecycleSnapshot(write_index_);
+    before_update_();
+    ArStatus update_status;
+    {
+      ScopedFrameStageTimer timer(timers_, FrameStage::kArUpdate);
+      update_status = traced::ArSession_update(session_, frame_);
+    }
+    if (update_status != AR_SUCCESS) {
+      LOGE("ArUpdateThread::Run ArSession_update error");
+      std::this_thread::sleep_for(kUpdateRetryDelay);
+      continue;
+    }
+
+    ArFrameSnapshot& snapshot = snapshots_[write_index_];
+    uint32_t camera_texture_id = 0;
+    ArFrame_getCameraTextureName(session_, frame_, &camera_texture_id);
+    snapshot.camera_texture_id = camera_texture_id;
+    callback_(&snapshot);
+
+    // The fence orders the reader's sampling after ARCore's texture update
+    // in this context; the flush makes sure it is ever signaled.
+    snapshot.ready_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+    snapshot.sequence = ++published_sequence_;
+
+    const uint32_t previous =
+        shared_state_.exchange(static_cast<uint32_t>(write_index_) | kFreshBit,
+                               std::memory_order_acq_rel);
+    write_index_ = static_cast<int>(previous & kIndexMask);
+  }
+
+  // Stop() may run on a thread without a context, so the shared objects are
+  // released here, where the shared context is still current.
+  for (int i = 0; i < kNumSnapshots; ++i) {
+    RecycleSnapshot(i);
+    snapshots_[i].sequence = 0;
+  }
+  glDeleteTextures(kNumCameraTextures, camera_textures_.data());
+  camera_textures_.fill(0);
+  glFlush();
+  eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+}
+
+void ArUpdateThread::WaitForReader() {
+  // ARCore advances through the camera texture ring once per frame, so the
+  // next frame is safe to write while it stays within the textures that no
+  // snapshot the reader may still draw refers to.
+  const uint64_t max_frames_ahead = kNumCameraTextures - 2;
+  std::unique_lock<std::mutex> lock(reader_mutex_);
+  while (running_ &&
+         published_sequence_ + 1 -
+                 displayed_sequence_.load(std::memory_order_acquire) >
+             max_frames_ahead) {
+    reader_advanced_.wait_for(lock, kReaderWaitTimeout);
+  }
+}
+
+void ArUpdateThread::RecycleSnapshot(int index) {
+  ArFrameSnapshot& snapshot = snapshots_[index];
+  if (snapshot.depth_image != nullptr) {
+    ArImage_release(snapshot.depth_image);
+    ResourceAccounting::Get().AddArHandles(ArHandleType::kImage, -1);
+    snapshot.depth_image = nullptr;
+  }
+  if (snapshot.depth_confidence_image != nullptr) {
+    ArImage_release(snapshot.depth_confidence_image);
+    ResourceAccounting::Get().AddArHandles(ArHandleType::kImage, -1);
+    snapshot.depth_confidence_image = nullptr;
+  }
+  if (snapshot.ready_fence != nullptr) {
+    glDeleteSync(snapshot.ready_fence);
+    snapshot.ready_fence = nullptr;
+  }
+}
+
+bool ArUpdateThread::CreateSharedContext() {
+  display_ = eglGetCurrentDisplay();
+  const EGLContext share_context = eglGetCurrentContext();
+  if (display_ == EGL_NO_DISPLAY || share_context == EGL_NO_CONTEXT) {
+    LOGE("ArUpdateThread::Start requires a current EGL context");
+    return false;
+  }
+
+  const EGLint config_attributes[] = {EGL_RENDERABLE_TYPE,
+                                      EGL_OPENGL_ES3_BIT_KHR,
+                                      EGL_SURFACE_TYPE,
+                                      EGL_PBUFFER_BIT,
+                                      EGL_NONE};
+  EGLConfig config = nullptr;
+  EGLint num_configs = 0;
+  if (eglChooseConfig(display_, config_attributes, &config, 1,
+                      &num_configs) != EGL_TRUE ||
+      num_configs < 1) {
+    LOGE("ArUpdateThread::Start no pbuffer config");
+    display_ = EGL_NO_DISPLAY;
+    return false;
+  }
+
+  const EGLint context_attributes[] = {EGL_CONTEXT_CLIENT_VERSION, 3,
+                                       EGL_NONE};
+  context_ =
+      eglCreateContext(display_, config, share_context, context_attributes);
+  // ARCore needs a current surface, but never draws to it.
+  const EGLint surface_attributes[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+  surface_ = eglCreatePbufferSurface(display_, config, surface_attributes);
+  if (context_ == EGL_NO_CONTEXT || surface_ == EGL_NO_SURFACE) {
+    LOGE("ArUpdateThread::Start shared context error 0x%x", eglGetError());
+    DestroySharedContext();
+    return false;
+  }
+  return true;
+}
+
+void ArUpdateThread::DestroySharedContext() {
+  if (display_ == EGL_NO_DISPLAY) {
+    return;
+  }
+  if (surface_ != EGL_NO_SURFACE) {
+    eglDestroySurface(display_, surface_);
+    surface_ = EGL_NO_SURFACE;
+  }
+  if (context_ != EGL_NO_CONTEXT) {
+    eglDestroyContext(display_, context_);
+    context_ = EGL_NO_CONTEXT;
+  }
+  display_ = EGL_NO_DISPLAY;
+}
+
+}  // namespace hello_ar
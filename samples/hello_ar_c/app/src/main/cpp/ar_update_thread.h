@@ -0,0 +1,195 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_AR_UPDATE_THREAD_H_
+#define C_ARCORE_HELLOE_AR_AR_UPDATE_THREAD_H_
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+// clang-format off
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+// clang-format on
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "arcore_c_api.h"
+#include "background_renderer.h"
+#include "frame_context.h"
+#include "frame_stage_timers.h"
+#include "glm.h"
+#include "obj_renderer.h"
+#include "plane_renderer.h"
+#include "skinned_obj_renderer.h"
+
+namespace hello_ar {
+
+// Everything the OpenGL thread needs to draw one frame, captured on the
+// update thread right after ArSession_update.  A snapshot is immutable once
+// published and holds no handle the OpenGL thread has to query ARCore for,
+// except for the depth images, which are only read.
+struct ArFrameSnapshot {
+  FrameContext frame_context;
+
+  // Camera texture ARCore wrote this frame into, and the quad uvs to draw it.
+  GLuint camera_texture_id = 0;
+  float transformed_uvs[BackgroundRenderer::kNumUvComponents] = {};
+  glm::mat3 uv_transform = glm::mat3(1.0f);
+  // Stabilized camera image, drawn instead of the quad while EIS is on.
+  BackgroundRenderer::EisWarp eis_warp;
+
+  int32_t plane_count = 0;
+  PlaneRenderer::PlaneBatch plane_batch;
+  ObjRenderer::LodInstances andy_instances;
+  // Replace |andy_instances| while the anchors are drawn skinned.
+  std::vector<SkinnedObjRenderer::Instance> skinned_andy_instances;
+  // x, y, z, confidence tuples copied out of the frame's point cloud.
+  std::vector<float> point_cloud;
+  // Ids of the points, only copied with kUsePointCloudMap.
+  std::vector<int32_t> point_ids;
+  int64_t point_cloud_timestamp_ns = -1;
+  // Surface point under the screen centre, in the point cloud's format.
+  bool has_surface_reticle = false;
+  glm::vec4 surface_reticle = glm::vec4(0.0f);
+  // Depth image of the frame, or nullptr.  Owned and released by the update
+  // thread once the slot is written again.
+  ArImage* depth_image = nullptr;
+  // Confidence of |depth_image| if it is raw depth, or nullptr.  Owned like
+  // |depth_image|.
+  ArImage* depth_confidence_image = nullptr;
+
+  // Signaled once the camera texture update of this frame is complete.
+  GLsync ready_fence = nullptr;
+  // Number of snapshots published before and including this one.
+  uint64_t sequence = 0;
+};
+
+// Runs ArSession_update on a dedicated thread and hands the resulting frames
+// to the OpenGL thread through a lock-free triple buffer.
+//
+// The writer owns one snapshot, the reader owns another and the third is the
+// most recently published one.  Publishing and acquiring each swap a single
+// atomic index, so neither side ever waits on the other, and the reader
+// always gets the latest complete frame while frames it was too slow to see
+// are simply overwritten.
+//
+// The update thread uses its own EGL context shared with the OpenGL thread,
+// since ARCore writes the camera image into a texture of the context current
+// on the thread calling ArSession_update.  Camera images go to a ring of
+// textures set with ArSession_setCameraTextureNames, and the writer is held
+// back while it would wrap onto a texture the reader may still sample.
+class ArUpdateThread {
+ public:
+  // Fills |snapshot| from the current frame.  Runs on the update thread,
+  // after ArSession_update and with the shared context current.
+  using UpdateCallback = std::function<void(ArFrameSnapshot* snapshot)>;
+  // Runs on the update thread right before each ArSession_update, where the
+  // session may be reconfigured.
+  using BeforeUpdateCallback = std::function<void()>;
+
+  ArUpdateThread() = default;
+  ~ArUpdateThread();
+
+  ArUpdateThread(const ArUpdateThread&) = delete;
+  ArUpdateThread& operator=(const ArUpdateThread&) = delete;
+
+  // Starts updating |session| into |frame|.  Must be called on the OpenGL
+  // thread with its context current.  Returns false if the shared context
+  // could not be created.  ArSession_update is timed into |timers| if it is
+  // not null.
+  bool Start(ArSession* session, ArFrame* frame,
+             BeforeUpdateCallback before_update, UpdateCallback callback,
+             FrameStageTimers* timers);
+
+  // Joins the update thread and releases the snapshots.  Must be called
+  // before the session is paused or destroyed, while the OpenGL thread does
+  // not draw, e.g. from OnPause() once the GLSurfaceView is paused.
+  void Stop();
+
+  bool IsRunning() const { return thread_.joinable(); }
+
+  // Kernel thread id of the update thread, or 0 while it does not run.
+  // Thread safe.
+  int32_t GetThreadId() const {
+    return thread_id_.load(std::memory_order_relaxed);
+  }
+
+  // Returns the latest published snapshot, or nullptr if there is none yet.
+  // The snapshot stays valid until the next call.  |out_is_new| is set to
+  // false if it was already returned by the previous call.  Makes the OpenGL
+  // thread wait on the GPU for the camera texture of a new snapshot.
+  const ArFrameSnapshot* AcquireLatestSnapshot(bool* out_is_new);
+
+ private:
+  static constexpr int kNumSnapshots = 3;
+  // The reader's snapshot, the published one, the one being written and the
+  // previous reader snapshot still sampled by in-flight draws each need
+  // their own camera texture, plus one spare for frames ARCore repeats.
+  static constexpr int kNumCameraTextures = 5;
+
+  // Bit of |shared_state_| set while the published snapshot is unread.
+  static constexpr uint32_t kFreshBit = 0x4;
+  static constexpr uint32_t kIndexMask = 0x3;
+
+  void Run();
+
+  // Blocks while the next frame could overwrite a camera texture still in
+  // use by the reader.
+  void WaitForReader();
+
+  // Releases what the snapshot in |index| still holds from its last use.
+  void RecycleSnapshot(int index);
+
+  bool CreateSharedContext();
+  void DestroySharedContext();
+
+  ArSession* session_ = nullptr;
+  ArFrame* frame_ = nullptr;
+  BeforeUpdateCallback before_update_;
+  UpdateCallback callback_;
+  FrameStageTimers* timers_ = nullptr;
+
+  std::array<ArFrameSnapshot, kNumSnapshots> snapshots_;
+  // Index of the published snapshot, or'ed with kFreshBit while unread.
+  std::atomic<uint32_t> shared_state_{0};
+  int write_index_ = 0;
+  int read_index_ = 0;
+
+  std::array<GLuint, kNumCameraTextures> camera_textures_ = {};
+
+  EGLDisplay display_ = EGL_NO_DISPLAY;
+  EGLContext context_ = EGL_NO_CONTEXT;
+  EGLSurface surface_ = EGL_NO_SURFACE;
+
+  std::thread thread_;
+  std::atomic<int32_t> thread_id_{0};
+  std::atomic<bool> running_{false};
+  uint64_t published_sequence_ = 0;
+  std::atomic<uint64_t> displayed_sequence_{0};
+  std::mutex reader_mutex_;
+  std::condition_variable reader_advanced_;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_AR_UPDATE_THREAD_H_
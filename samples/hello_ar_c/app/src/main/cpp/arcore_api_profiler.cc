@@ -0,0 +1,334 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "arcore_api_profiler.h"
+
+#include <android/api-level.h>
+#include <sys/system_properties.h>
+
+#include <chrono>
+
+#include "util.h"
+
+namespace hello_ar {
+namespace {
+std::string GetSystemProperty(const char* name) {
+  char value[PROP_VALUE_MAX] = {};
+  __system_property_get(name, value);
+  return value;
+}
+
+// Writes |value| as a JSON string, escaping what needs it.
+void WriteJsonString(FILE* file, const std::string& value) {
+  fputc('"', file);
+  for (const char c : value) {
+    if (c == '"' || c == '\\') {
+      fputc('\\', file);
+      fputc(c, file);
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      fprintf(file, "\\u%04x", c);
+    } else {
+      fputc(c, file);
+    }
+  }
+  fputc('"', file);
+}
+
+// Acquires the planes of |list| into |planes|.
+void AcquirePlanes(const ArSession* session, const ArTrackableList* list,
+                   std::vector<ArPlane*>* planes) {
+  int32_t size = 0;
+  ArTrackableList_getSize(session, list, &size);
+  for (int32_t i = 0; i < size; ++i) {
+    ArTrackable* trackable = nullptr;
+    ArTrackableList_acquireItem(session, list, i, &trackable);
+    planes->push_back(ArAsPlane(trackable));
+  }
+}
+}  // namespace
+
+constexpr int ArCoreApiProfiler::kNumCalls;
+constexpr int ArCoreApiProfiler::kCallsPerSample;
+constexpr int ArCoreApiProfiler::kSamplesPerCall;
+constexpr int ArCoreApiProfiler::kTransformPoints;
+constexpr int ArCoreApiProfiler::kMaxFrames;
+
+const char* ArCoreApiProfiler::GetCallName(Call call) {
+  switch (call) {
+    case Call::kFrameAcquireCamera:
+      return "ArFrame_acquireCamera";
+    case Call::kCameraGetPose:
+      return "ArCamera_getPose";
+    case Call::kSessionGetAllTrackables:
+      return "ArSession_getAllTrackables";
+    case Call::kFrameGetUpdatedTrackables:
+      return "ArFrame_getUpdatedTrackables";
+    case Call::kFrameTransformCoordinates2d:
+      return "ArFrame_transformCoordinates2d";
+    case Call::kPlaneGetPolygon:
+      return "ArPlane_getPolygon";
+    case Call::kFrameAcquireCameraImage:
+      return "ArFrame_acquireCameraImage";
+    case Call::kImageGetPlaneData:
+      return "ArImage_getPlaneData";
+    case Call::kCount:
+      break;
+  }
+  return "unknown";
+}
+
+ArCoreApiProfiler::~ArCoreApiProfiler() {
+  if (file_ != nullptr) {
+    fclose(file_);
+  }
+}
+
+bool ArCoreApiProfiler::Start(const std::string& report_path,
+                              const std::string& arcore_version) {
+  if (file_ != nullptr) {
+    fclose(file_);
+  }
+  file_ = fopen(report_path.c_str(), "w");
+  if (file_ == nullptr) {
+    LOGE("ArCoreApiProfiler: cannot open %s", report_path.c_str());
+    return false;
+  }
+  arcore_version_ = arcore_version;
+  turn_ = 0;
+  frames_ = 0;
+  for (CallSamples& samples : samples_) {
+    samples = CallSamples();
+  }
+  // A grid over the viewport, as the background and depth passes transform.
+  transform_input_.resize(2 * kTransformPoints);
+  transform_output_.resize(2 * kTransformPoints);
+  constexpr int kGridSize = 16;
+  static_assert(kGridSize * kGridSize == kTransformPoints,
+                "the grid must have kTransformPoints points");
+  for (int i = 0; i < kTransformPoints; ++i) {
+    transform_input_[2 * i] = -1.f + 2.f * (i % kGridSize) / (kGridSize - 1);
+    transform_input_[2 * i + 1] =
+        -1.f + 2.f * (i / kGridSize) / (kGridSize - 1);
+  }
+  return true;
+}
+
+bool ArCoreApiProfiler::ProfileFrame(ArSession* session, ArFrame* frame) {
+  if (file_ == nullptr) {
+    return false;
+  }
+  // The call whose turn it is, skipping those that have their samples.
+  int index = turn_ % kNumCalls;
+  for (int i = 0; i < kNumCalls; ++i) {
+    if (static_cast<int>(samples_[index].call_ns.size()) < kSamplesPerCall) {
+      break;
+    }
+    index = (index + 1) % kNumCalls;
+  }
+  turn_ = index + 1;
+  CallSamples& samples = samples_[index];
+
+  int64_t num_calls = 0;
+  int64_t num_elements = 0;
+  const auto start = std::chrono::steady_clock::now();
+  const bool ran = RunCall(static_cast<Call>(index), session, frame,
+                           &num_calls, &num_elements);
+  const float elapsed_ns = std::chrono::duration<float, std::nano>(
+                               std::chrono::steady_clock::now() - start)
+                               .count();
+  if (ran && num_calls > 0) {
+    if (!samples.warmed_up) {
+      samples.warmed_up = true;
+    } else {
+      samples.call_ns.push_back(elapsed_ns / num_calls);
+      if (num_elements > 0) {
+        samples.element_ns.push_back(elapsed_ns / num_elements);
+      }
+    }
+  }
+
+  if (++frames_ >= kMaxFrames) {
+    return true;
+  }
+  for (const CallSamples& call_samples : samples_) {
+    if (static_cast<int>(call_samples.call_ns.size()) < kSamplesPerCall) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ArCoreApiProfiler::RunCall(Call call, ArSession* session, ArFrame* frame,
+                                int64_t* num_calls, int64_t* num_elements) {
+  // The objects a loop works on are created before and released after it,
+  // which the caller's timing includes; they are cheap next to the loop.
+  switch (call) {
+    case Call::kFrameAcquireCamera: {
+      for (int i = 0; i < kCallsPerSample; ++i) {
+        ArCamera* camera = nullptr;
+        ArFrame_acquireCamera(session, frame, &camera);
+        ArCamera_release(camera);
+      }
+      *num_calls = kCallsPerSample;
+      return true;
+    }
+    case Call::kCameraGetPose: {
+      ArCamera* camera = nullptr;
+      ArFrame_acquireCamera(session, frame, &camera);
+      ArPose* pose = nullptr;
+      ArPose_create(session, nullptr, &pose);
+      for (int i = 0; i < kCallsPerSample; ++i) {
+        ArCamera_getPose(session, camera, pose);
+      }
+      ArPose_destroy(pose);
+      ArCamera_release(camera);
+      *num_calls = kCallsPerSample;
+      return true;
+    }
+    case Call::kSessionGetAllTrackables:
+    case Call::kFrameGetUpdatedTrackables: {
+      ArTrackableList* list = nullptr;
+      ArTrackableList_create(session, &list);
+      for (int i = 0; i < kCallsPerSample; ++i) {
+        if (call == Call::kSessionGetAllTrackables) {
+          ArSession_getAllTrackables(session, AR_TRACKABLE_PLANE, list);
+        } else {
+          ArFrame_getUpdatedTrackables(session, frame, AR_TRACKABLE_PLANE,
+                                       list);
+        }
+      }
+      int32_t size = 0;
+      ArTrackableList_getSize(session, list, &size);
+      ArTrackableList_destroy(list);
+      *num_calls = kCallsPerSample;
+      *num_elements = static_cast<int64_t>(size) * kCallsPerSample;
+      return true;
+    }
+    case Call::kFrameTransformCoordinates2d: {
+      for (int i = 0; i < kCallsPerSample; ++i) {
+        ArFrame_transformCoordinates2d(
+            session, frame,
+            AR_COORDINATES_2D_OPENGL_NORMALIZED_DEVICE_COORDINATES,
+            kTransformPoints, transform_input_.data(),
+            AR_COORDINATES_2D_TEXTURE_NORMALIZED, transform_output_.data());
+      }
+      *num_calls = kCallsPerSample;
+      *num_elements = static_cast<int64_t>(kTransformPoints) * kCallsPerSample;
+      return true;
+    }
+    case Call::kPlaneGetPolygon: {
+      ArTrackableList* list = nullptr;
+      ArTrackableList_create(session, &list);
+      ArSession_getAllTrackables(session, AR_TRACKABLE_PLANE, list);
+      std::vector<ArPlane*> planes;
+      AcquirePlanes(session, list, &planes);
+      ArTrackableList_destroy(list);
+      // A call is one ArPlane_getPolygonSize() and ArPlane_getPolygon()
+      // pair, as the plane renderer makes them.
+      int64_t vertices = 0;
+      for (int i = 0; i < kCallsPerSample; ++i) {
+        for (ArPlane* plane : planes) {
+          int32_t polygon_size = 0;
+          ArPlane_getPolygonSize(session, plane, &polygon_size);
+          if (static_cast<size_t>(polygon_size) > polygon_.size()) {
+            polygon_.resize(polygon_size);
+          }
+          ArPlane_getPolygon(session, plane, polygon_.data());
+          vertices += polygon_size / 2;
+        }
+      }
+      for (ArPlane* plane : planes) {
+        ArTrackable_release(ArAsTrackable(plane));
+      }
+      *num_calls = static_cast<int64_t>(planes.size()) * kCallsPerSample;
+      *num_elements = vertices;
+      return !planes.empty();
+    }
+    case Call::kFrameAcquireCameraImage: {
+      for (int i = 0; i < kCallsPerSample; ++i) {
+        ArImage* image = nullptr;
+        if (ArFrame_acquireCameraImage(session, frame, &image) != AR_SUCCESS) {
+          return false;
+        }
+        ArImage_release(image);
+      }
+      *num_calls = kCallsPerSample;
+      return true;
+    }
+    case Call::kImageGetPlaneData: {
+      ArImage* image = nullptr;
+      if (ArFrame_acquireCameraImage(session, frame, &image) != AR_SUCCESS) {
+        return false;
+      }
+      int32_t num_planes = 0;
+      ArImage_getNumberOfPlanes(session, image, &num_planes);
+      for (int i = 0; i < kCallsPerSample; ++i) {
+        for (int32_t plane = 0; plane < num_planes; ++plane) {
+          const uint8_t* data = nullptr;
+          int32_t length = 0;
+          ArImage_getPlaneData(session, image, plane, &data, &length);
+        }
+      }
+      ArImage_release(image);
+      *num_calls = static_cast<int64_t>(num_planes) * kCallsPerSample;
+      return num_planes > 0;
+    }
+    case Call::kCount:
+      break;
+  }
+  return false;
+}
+
+void ArCoreApiProfiler::Finish() {
+  if (file_ == nullptr) {
+    return;
+  }
+  fprintf(file_, "{\n  \"device\": ");
+  WriteJsonString(file_, GetSystemProperty("ro.product.manufacturer") + " " +
+                             GetSystemProperty("ro.product.model"));
+  fprintf(file_, ",\n  \"platform\": ");
+  WriteJsonString(file_, GetSystemProperty("ro.board.platform"));
+  fprintf(file_, ",\n  \"android_api\": %d,\n  \"arcore_version\": ",
+          android_get_device_api_level());
+  WriteJsonString(file_, arcore_version_);
+  fprintf(file_,
+          ",\n  \"frames\": %d,\n  \"calls_per_sample\": %d,\n"
+          "  \"calls\": [",
+          frames_, kCallsPerSample);
+  for (int i = 0; i < kNumCalls; ++i) {
+    CallSamples& samples = samples_[i];
+    fprintf(file_, "%s\n    {\"name\": \"%s\", \"samples\": %zu",
+            i == 0 ? "" : ",", GetCallName(static_cast<Call>(i)),
+            samples.call_ns.size());
+    if (!samples.call_ns.empty()) {
+      const float p50 = util::Percentile(&samples.call_ns, 50);
+      const float p95 = util::Percentile(&samples.call_ns, 95);
+      fprintf(file_, ", \"ns_per_call_p50\": %.1f, \"ns_per_call_p95\": %.1f",
+              p50, p95);
+    }
+    if (!samples.element_ns.empty()) {
+      fprintf(file_, ", \"ns_per_element_p50\": %.2f",
+              util::Percentile(&samples.element_ns, 50));
+    }
+    fprintf(file_, "}");
+  }
+  fprintf(file_, "\n  ]\n}\n");
+  fclose(file_);
+  file_ = nullptr;
+  LOGI("ARCore API profile of %d frames written", frames_);
+}
+
+}  // namespace hello_ar
@@ -0,0 +1,119 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_ARCORE_API_PROFILER_H_
+#define C_ARCORE_HELLOE_AR_ARCORE_API_PROFILER_H_
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "arcore_c_api.h"
+
+namespace hello_ar {
+
+// Measures what single ARCore C API calls cost on the device and the ARCore
+// version it runs on, against the live session, to tell which of the
+// sample's caches and batches pay off there.
+//
+// Right after each ArSession_update(), one of the calls runs
+// kCallsPerSample times in a tight loop on the frame just updated, and the
+// mean time of a call in that loop is one sample.  The calls take turns
+// frame by frame, so they all see the same scene and thermal state, until
+// each has kSamplesPerCall samples.  The first turn of every call only warms
+// it up.  Calls on lists, e.g. of planes, polygon vertices or points to
+// transform, also get the time per element.  Finish() writes the report as
+// JSON: the device and ARCore version, then per call the sample count, the
+// median and p95 nanoseconds per call and the median nanoseconds per element.
+//
+// The calls are made directly rather than through the traced:: wrappers, so
+// HELLO_AR_TRACE_ARCORE builds measure the same.  All methods must be called
+// on the thread that updates the session.
+class ArCoreApiProfiler {
+ public:
+  enum class Call {
+    kFrameAcquireCamera = 0,
+    kCameraGetPose,
+    kSessionGetAllTrackables,
+    kFrameGetUpdatedTrackables,
+    kFrameTransformCoordinates2d,
+    kPlaneGetPolygon,
+    kFrameAcquireCameraImage,
+    kImageGetPlaneData,
+    kCount
+  };
+  static constexpr int kNumCalls = static_cast<int>(Call::kCount);
+
+  static constexpr int kCallsPerSample = 32;
+  static constexpr int kSamplesPerCall = 60;
+  // Points one ArFrame_transformCoordinates2d() call transforms.
+  static constexpr int kTransformPoints = 256;
+  // Calls that cannot run, e.g. ArPlane_getPolygon() while no plane is
+  // tracked, end up with fewer samples once this many frames were profiled.
+  static constexpr int kMaxFrames = 4 * kNumCalls * kSamplesPerCall;
+
+  static const char* GetCallName(Call call);
+
+  ArCoreApiProfiler() = default;
+  // Closes the report of an unfinished run without the results.
+  ~ArCoreApiProfiler();
+
+  ArCoreApiProfiler(const ArCoreApiProfiler&) = delete;
+  ArCoreApiProfiler& operator=(const ArCoreApiProfiler&) = delete;
+
+  // Starts a run that writes its report to |report_path|, noting
+  // |arcore_version| in it.  Returns false if the report cannot be written.
+  bool Start(const std::string& report_path,
+             const std::string& arcore_version);
+
+  bool IsRunning() const { return file_ != nullptr; }
+
+  // Profiles the call whose turn it is on |frame|, which |session| just
+  // updated.  Returns true once every call has its samples or kMaxFrames
+  // frames were profiled.
+  bool ProfileFrame(ArSession* session, ArFrame* frame);
+
+  // Writes the report and ends the run.
+  void Finish();
+
+ private:
+  struct CallSamples {
+    std::vector<float> call_ns;
+    std::vector<float> element_ns;
+    bool warmed_up = false;
+  };
+
+  // Runs the loop of |call|, adding the calls made and the elements they
+  // returned.  Returns false if the call cannot run on this frame.
+  bool RunCall(Call call, ArSession* session, ArFrame* frame,
+               int64_t* num_calls, int64_t* num_elements);
+
+  FILE* file_ = nullptr;
+  std::string arcore_version_;
+  int turn_ = 0;
+  int frames_ = 0;
+  std::array<CallSamples, kNumCalls> samples_;
+  // Inputs and outputs of the loops, reused across frames.
+  std::vector<float> transform_input_;
+  std::vector<float> transform_output_;
+  std::vector<float> polygon_;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_ARCORE_API_PROFILER_H_
@@ -0,0 +1,236 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_ARCORE_TRACE_H_
+#define C_ARCORE_HELLOE_AR_ARCORE_TRACE_H_
+
+#include <cstdint>
+
+#include "arcore_c_api.h"
+
+// Wrappers of the ARCore C API calls on the sample's hot paths, named like
+// the functions they call, e.g. traced::ArSession_update().
+//
+// Built with HELLO_AR_TRACE_ARCORE (the CMake option of the same name), every
+// call is an ATrace section named "ARCore::<function>" and bumps a counter
+// track "ARCore::<function> calls", so Perfetto traces show how much of the
+// frame is spent inside libarcore_sdk_c.so and how often each function runs.
+// Otherwise the wrappers are plain inline forwarding calls.
+#ifndef HELLO_AR_TRACE_ARCORE
+#define HELLO_AR_TRACE_ARCORE 0
+#endif
+
+#if HELLO_AR_TRACE_ARCORE
+#include <android/trace.h>
+#include <dlfcn.h>
+
+#include <atomic>
+
+namespace hello_ar {
+namespace traced {
+namespace internal {
+
+// ATrace_setCounter() needs API level 29, above the minSdkVersion, so it is
+// looked up at runtime.
+inline void SetTraceCounter(const char* name, int64_t value) {
+  using SetCounterFunction = void (*)(const char*, int64_t);
+  static const SetCounterFunction set_counter =
+      reinterpret_cast<SetCounterFunction>(
+          dlsym(RTLD_DEFAULT, "ATrace_setCounter"));
+  if (set_counter != nullptr) {
+    set_counter(name, value);
+  }
+}
+
+// Brackets one ARCore call with its trace section.
+class ScopedCall {
+ public:
+  ScopedCall(const char* section_name, const char* counter_name,
+             std::atomic<int64_t>* calls) {
+    const int64_t count = calls->fetch_add(1, std::memory_order_relaxed) + 1;
+    if (ATrace_isEnabled()) {
+      SetTraceCounter(counter_name, count);
+    }
+    ATrace_beginSection(section_name);
+  }
+  ~ScopedCall() { ATrace_endSection(); }
+
+  ScopedCall(const ScopedCall&) = delete;
+  ScopedCall& operator=(const ScopedCall&) = delete;
+};
+
+}  // namespace internal
+}  // namespace traced
+}  // namespace hello_ar
+
+// The count is kept per wrapper and shared by all threads calling it.
+#define HELLO_AR_TRACE_CALL(function)                                  \
+  static std::atomic<int64_t> function##_calls{0};                     \
+  const ::hello_ar::traced::internal::ScopedCall traced_call(          \
+      "ARCore::" #function, "ARCore::" #function " calls", &function##_calls)
+#else
+#define HELLO_AR_TRACE_CALL(function)
+#endif  // HELLO_AR_TRACE_ARCORE
+
+namespace hello_ar {
+namespace traced {
+
+inline ArStatus ArSession_update(ArSession* session, ArFrame* out_frame) {
+  HELLO_AR_TRACE_CALL(ArSession_update);
+  return ::ArSession_update(session, out_frame);
+}
+
+inline void ArFrame_acquireCamera(const ArSession* session,
+                                  const ArFrame* frame, ArCamera** out_camera) {
+  HELLO_AR_TRACE_CALL(ArFrame_acquireCamera);
+  ::ArFrame_acquireCamera(session, frame, out_camera);
+}
+
+inline ArStatus ArFrame_acquirePointCloud(const ArSession* session,
+                                          const ArFrame* frame,
+                                          ArPointCloud** out_point_cloud) {
+  HELLO_AR_TRACE_CALL(ArFrame_acquirePointCloud);
+  return ::ArFrame_acquirePointCloud(session, frame, out_point_cloud);
+}
+
+inline ArStatus ArFrame_acquireCameraImage(ArSession* session, ArFrame* frame,
+                                           ArImage** out_image) {
+  HELLO_AR_TRACE_CALL(ArFrame_acquireCameraImage);
+  return ::ArFrame_acquireCameraImage(session, frame, out_image);
+}
+
+inline ArStatus ArFrame_acquireDepthImage16Bits(const ArSession* session,
+                                                const ArFrame* frame,
+                                                ArImage** out_depth_image) {
+  HELLO_AR_TRACE_CALL(ArFrame_acquireDepthImage16Bits);
+  return ::ArFrame_acquireDepthImage16Bits(session, frame, out_depth_image);
+}
+
+inline ArStatus ArFrame_acquireRawDepthImage16Bits(const ArSession* session,
+                                                   const ArFrame* frame,
+                                                   ArImage** out_depth_image) {
+  HELLO_AR_TRACE_CALL(ArFrame_acquireRawDepthImage16Bits);
+  return ::ArFrame_acquireRawDepthImage16Bits(session, frame, out_depth_image);
+}
+
+inline ArStatus ArFrame_acquireRawDepthConfidenceImage(
+    const ArSession* session, const ArFrame* frame,
+    ArImage** out_confidence_image) {
+  HELLO_AR_TRACE_CALL(ArFrame_acquireRawDepthConfidenceImage);
+  return ::ArFrame_acquireRawDepthConfidenceImage(session, frame,
+                                                  out_confidence_image);
+}
+
+inline ArStatus ArFrame_acquireSemanticImage(const ArSession* session,
+                                             const ArFrame* frame,
+                                             ArImage** out_semantic_image) {
+  HELLO_AR_TRACE_CALL(ArFrame_acquireSemanticImage);
+  return ::ArFrame_acquireSemanticImage(session, frame, out_semantic_image);
+}
+
+inline ArStatus ArFrame_acquireSemanticConfidenceImage(
+    const ArSession* session, const ArFrame* frame,
+    ArImage** out_confidence_image) {
+  HELLO_AR_TRACE_CALL(ArFrame_acquireSemanticConfidenceImage);
+  return ::ArFrame_acquireSemanticConfidenceImage(session, frame,
+                                                  out_confidence_image);
+}
+
+inline ArStatus ArFrame_getSemanticLabelFraction(const ArSession* session,
+                                                 const ArFrame* frame,
+                                                 ArSemanticLabel query_label,
+                                                 float* out_fraction) {
+  HELLO_AR_TRACE_CALL(ArFrame_getSemanticLabelFraction);
+  return ::ArFrame_getSemanticLabelFraction(session, frame, query_label,
+                                            out_fraction);
+}
+
+inline void ArFrame_getUpdatedTrackables(const ArSession* session,
+                                         const ArFrame* frame,
+                                         ArTrackableType filter_type,
+                                         ArTrackableList* out_trackable_list) {
+  HELLO_AR_TRACE_CALL(ArFrame_getUpdatedTrackables);
+  ::ArFrame_getUpdatedTrackables(session, frame, filter_type,
+                                 out_trackable_list);
+}
+
+inline void ArFrame_hitTest(const ArSession* session, const ArFrame* frame,
+                            float pixel_x, float pixel_y,
+                            ArHitResultList* hit_result_list) {
+  HELLO_AR_TRACE_CALL(ArFrame_hitTest);
+  ::ArFrame_hitTest(session, frame, pixel_x, pixel_y, hit_result_list);
+}
+
+inline void ArFrame_hitTestInstantPlacement(
+    const ArSession* session, const ArFrame* frame, float pixel_x,
+    float pixel_y, float approximate_distance_meters,
+    ArHitResultList* hit_result_list) {
+  HELLO_AR_TRACE_CALL(ArFrame_hitTestInstantPlacement);
+  ::ArFrame_hitTestInstantPlacement(session, frame, pixel_x, pixel_y,
+                                    approximate_distance_meters,
+                                    hit_result_list);
+}
+
+inline void ArFrame_hitTestRay(const ArSession* session, const ArFrame* frame,
+                               const float* ray_origin_3,
+                               const float* ray_direction_3,
+                               ArHitResultList* hit_result_list) {
+  HELLO_AR_TRACE_CALL(ArFrame_hitTestRay);
+  ::ArFrame_hitTestRay(session, frame, ray_origin_3, ray_direction_3,
+                       hit_result_list);
+}
+
+inline void ArFrame_transformCoordinates3d(
+    const ArSession* session, const ArFrame* frame,
+    ArCoordinates2dType input_coordinates, int32_t number_of_vertices,
+    const float* vertices_2d, ArCoordinates3dType output_coordinates,
+    float* out_vertices_3d) {
+  HELLO_AR_TRACE_CALL(ArFrame_transformCoordinates3d);
+  ::ArFrame_transformCoordinates3d(session, frame, input_coordinates,
+                                   number_of_vertices, vertices_2d,
+                                   output_coordinates, out_vertices_3d);
+}
+
+inline void ArTrackableList_getSize(const ArSession* session,
+                                    const ArTrackableList* trackable_list,
+                                    int32_t* out_size) {
+  HELLO_AR_TRACE_CALL(ArTrackableList_getSize);
+  ::ArTrackableList_getSize(session, trackable_list, out_size);
+}
+
+inline void ArTrackableList_acquireItem(const ArSession* session,
+                                        const ArTrackableList* trackable_list,
+                                        int32_t index,
+                                        ArTrackable** out_trackable) {
+  HELLO_AR_TRACE_CALL(ArTrackableList_acquireItem);
+  ::ArTrackableList_acquireItem(session, trackable_list, index,
+                                out_trackable);
+}
+
+inline void ArImage_getPlaneData(const ArSession* session, const ArImage* image,
+                                 int32_t plane_index, const uint8_t** out_data,
+                                 int32_t* out_data_length) {
+  HELLO_AR_TRACE_CALL(ArImage_getPlaneData);
+  ::ArImage_getPlaneData(session, image, plane_index, out_data,
+                         out_data_length);
+}
+
+}  // namespace traced
+}  // namespace hello_ar
+
+#undef HELLO_AR_TRACE_CALL
+
+#endif  // C_ARCORE_HELLOE_AR_ARCORE_TRACE_H_
@@ -0,0 +1,115 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "asset_loader.h"
+
+#include <utility>
+
+namespace hello_ar {
+
+AssetLoader::AssetLoader() = default;
+
+AssetLoader::~AssetLoader() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  // Queued loads see |stopping_| and return without running.
+  util::JobSystem::Get().Wait(&jobs_);
+}
+
+void AssetLoader::Submit(Load load) {
+  uint64_t generation = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    generation = generation_;
+    ++pending_loads_;
+  }
+  util::JobSystem::Get().Submit(
+      [this, load = std::move(load), generation]() mutable {
+        RunLoad(std::move(load), generation);
+      },
+      &jobs_);
+}
+
+int AssetLoader::RunUploads(std::chrono::nanoseconds budget) {
+  const auto start = std::chrono::steady_clock::now();
+  // Publishing only hands over finished objects, so it is not budgeted.
+  int count = upload_thread_ != nullptr ? upload_thread_->RunPublishes() : 0;
+  while (true) {
+    Upload upload;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (uploads_.empty()) {
+        break;
+      }
+      upload = std::move(uploads_.front());
+      uploads_.pop_front();
+    }
+    upload();
+    ++count;
+    if (std::chrono::steady_clock::now() - start >= budget) {
+      break;
+    }
+  }
+  return count;
+}
+
+void AssetLoader::DiscardPending() {
+  std::deque<Upload> uploads;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::swap(uploads, uploads_);
+    ++generation_;
+  }
+  if (upload_thread_ != nullptr) {
+    upload_thread_->DiscardPending();
+  }
+  // The dropped uploads release what they hold outside of the lock.
+}
+
+int AssetLoader::GetPendingCount() const {
+  const int background =
+      upload_thread_ != nullptr ? upload_thread_->GetPendingCount() : 0;
+  std::lock_guard<std::mutex> lock(mutex_);
+  return static_cast<int>(uploads_.size()) + pending_loads_ + background;
+}
+
+void AssetLoader::RunLoad(Load load, uint64_t generation) {
+  bool discarded = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    discarded = stopping_ || generation != generation_;
+  }
+  Upload upload;
+  if (!discarded) {
+    upload = load();
+  }
+  load = nullptr;
+
+  Upload stale;
+  std::lock_guard<std::mutex> lock(mutex_);
+  --pending_loads_;
+  if (!upload) {
+    return;
+  }
+  if (generation == generation_ && !stopping_) {
+    uploads_.push_back(std::move(upload));
+  } else {
+    stale = std::move(upload);
+  }
+}
+
+}  // namespace hello_ar
@@ -0,0 +1,112 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef C_ARCORE_HELLOE_AR_ASSET_LOADER_H_
+#define C_ARCORE_HELLOE_AR_ASSET_LOADER_H_
+
+#include <chrono>  // NOLINT
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>  // NOLINT
+
+#include "gl_upload_thread.h"
+#include "job_system.h"
+
+namespace hello_ar {
+
+// Reads and decodes assets on the job system and hands the results to the
+// OpenGL thread, which uploads them a few at a time between frames.
+//
+// A job is split in two: a Load that runs on a worker, e.g. decoding an
+// image, and the Upload it returns, which RunUploads() calls on the OpenGL
+// thread.  Uploads run in the order their loads finished, and RunUploads()
+// stops once its time budget is spent, so a burst of finished assets is
+// spread over several frames instead of stalling one.
+//
+// Loads may run concurrently.  Decoding PNGs goes through Java, which attaches
+// the workers to the JVM; they detach before they exit.
+//
+// With a GlUploadThread, a load may hand its GL work to the thread with
+// GlUploadThread::Submit() and return no upload; RunUploads() then runs the
+// publishes of the thread as well.
+//
+// Submit(), RunUploads() and DiscardPending() must be called from the same
+// thread, usually the OpenGL thread.
+class AssetLoader {
+ public:
+  // Runs on the OpenGL thread.  Owns whatever the load produced, so dropping
+  // it unrun must release that too.
+  using Upload = std::function<void()>;
+  // Runs on a worker and returns the upload of its result, or an
+  // empty function if there is nothing to upload.
+  using Load = std::function<Upload()>;
+
+  AssetLoader();
+  ~AssetLoader();
+
+  AssetLoader(const AssetLoader&) = delete;
+  AssetLoader& operator=(const AssetLoader&) = delete;
+
+  void Submit(Load load);
+
+  // |upload_thread| must outlive the loader, or be nullptr.  Set before the
+  // first Submit().
+  void SetUploadThread(GlUploadThread* upload_thread) {
+    upload_thread_ = upload_thread;
+  }
+  // The upload thread if it runs, otherwise nullptr.  May be called from the
+  // loads.
+  GlUploadThread* GetUploadThread() const {
+    return upload_thread_ != nullptr && upload_thread_->IsRunning()
+               ? upload_thread_
+               : nullptr;
+  }
+
+  // Runs the publishes of the upload thread whose GPU work finished, then
+  // finished uploads until |budget| is spent or none are left, at least one
+  // if there is any.  Returns the number of uploads and publishes run.
+  int RunUploads(std::chrono::nanoseconds budget);
+
+  // Drops all loads not started yet and all uploads not run yet, e.g. when
+  // the context they were meant for is gone.  A load that is running
+  // finishes, but its upload is dropped too.
+  void DiscardPending();
+
+  // Loads and uploads that have not completed.
+  int GetPendingCount() const;
+
+ private:
+  // Runs |load| unless it was discarded since Submit() saw |generation|.
+  void RunLoad(Load load, uint64_t generation);
+
+  // Guards everything below.  Never held while a job runs.
+  mutable std::mutex mutex_;
+  bool stopping_ = false;
+  std::deque<Upload> uploads_;
+  // Bumped by DiscardPending(), so loads that are queued or running at the
+  // time can be recognized as stale.
+  uint64_t generation_ = 0;
+  // Submitted loads that have not returned yet.
+  int pending_loads_ = 0;
+
+  // Counts the submitted jobs, which the destructor waits for.
+  util::JobCounter jobs_;
+  GlUploadThread* upload_thread_ = nullptr;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_ASSET_LOADER_H_
@@ -0,0 +1,211 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "background_mesher.h"
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+#include "job_system.h"
+#include "mesh_simplifier.h"
+
+namespace hello_ar {
+namespace {
+// How long the mesher thread sleeps while the queue of finished updates is
+// full.
+constexpr std::chrono::milliseconds kQueueFullBackoff(2);
+// Block meshes simplified by one ParallelFor() chunk.
+constexpr int kMeshesPerJob = 4;
+}  // namespace
+
+constexpr uint32_t BackgroundMesher::kQueueCapacity;
+
+BackgroundMesher::BackgroundMesher() : BackgroundMesher(Options()) {}
+
+BackgroundMesher::BackgroundMesher(const Options& options)
+    : options_(options),
+      volume_(options.volume),
+      thread_(&BackgroundMesher::Run, this) {}
+
+BackgroundMesher::~BackgroundMesher() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_all();
+  thread_.join();
+}
+
+void BackgroundMesher::SubmitDepthImage(const uint16_t* depth_mm, int width,
+                                        int height, int row_stride,
+                                        const glm::vec4& intrinsics,
+                                        const glm::mat4& camera_pose_mat) {
+  // The copy drops the row padding, so the mesher reads rows of |width|.
+  DepthImage& image = staging_image_;
+  image.depth_mm.resize(static_cast<size_t>(width) * height);
+  for (int row = 0; row < height; ++row) {
+    const uint16_t* source = reinterpret_cast<const uint16_t*>(
+        reinterpret_cast<const uint8_t*>(depth_mm) + row * row_stride);
+    std::copy(source, source + width, image.depth_mm.data() + row * width);
+  }
+  image.width = width;
+  image.height = height;
+  image.intrinsics = intrinsics;
+  image.camera_pose_mat = camera_pose_mat;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (has_pending_image_) {
+      ++skipped_depth_images_;
+    }
+    // The replaced image's storage is reused by the next submission.
+    std::swap(pending_image_, staging_image_);
+    has_pending_image_ = true;
+  }
+  wake_.notify_one();
+}
+
+void BackgroundMesher::InvalidateMeshes() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    invalidate_pending_ = true;
+  }
+  wake_.notify_one();
+}
+
+void BackgroundMesher::ImportBlocks(const TsdfVolume::BlockVoxels* blocks,
+                                    size_t count, const glm::mat4& transform) {
+  if (count == 0) {
+    return;
+  }
+  BlockImport import;
+  import.blocks.assign(blocks, blocks + count);
+  import.transform = transform;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_imports_.push_back(std::move(import));
+  }
+  wake_.notify_one();
+}
+
+void BackgroundMesher::ExportBlocks(
+    std::vector<TsdfVolume::BlockVoxels>* blocks) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  pending_export_ = blocks;
+  wake_.notify_one();
+  export_done_.wait(lock, [this] { return pending_export_ == nullptr; });
+}
+
+bool BackgroundMesher::PopMeshUpdate(TsdfVolume::MeshUpdate* update) {
+  return finished_updates_.TryPop(update);
+}
+
+void BackgroundMesher::Run() {
+  DepthImage image;
+  std::vector<BlockImport> imports;
+  TsdfVolume::MeshUpdate update;
+  const float min_edge_length =
+      options_.min_edge_voxels * options_.volume.voxel_size_m;
+  const float block_extent =
+      options_.volume.voxel_size_m * TsdfVolume::kBlockSize;
+  while (true) {
+    bool has_image = false;
+    bool invalidate = false;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_.wait(lock, [this] {
+        return stopping_ || has_pending_image_ || invalidate_pending_ ||
+               !pending_imports_.empty() || pending_export_ != nullptr;
+      });
+      if (stopping_) {
+        return;
+      }
+      if (has_pending_image_) {
+        std::swap(image, pending_image_);
+        has_pending_image_ = false;
+        has_image = true;
+      }
+      invalidate = invalidate_pending_;
+      invalidate_pending_ = false;
+      std::swap(imports, pending_imports_);
+    }
+
+    if (invalidate) {
+      volume_.InvalidateMeshes();
+    }
+    for (const BlockImport& import : imports) {
+      volume_.ImportBlocks(import.blocks.data(), import.blocks.size(),
+                           import.transform);
+    }
+    imports.clear();
+    if (has_image) {
+      volume_.Integrate(image.depth_mm.data(), image.width, image.height,
+                        image.width * static_cast<int>(sizeof(uint16_t)),
+                        image.intrinsics, image.camera_pose_mat);
+    }
+    ServeExport();
+    volume_.ExtractUpdatedMeshes(&update);
+    if (update.meshes.empty() && update.removed.empty()) {
+      continue;
+    }
+    // Blocks are simplified independently, a few per job.
+    util::JobSystem::Get().ParallelFor(
+        0, static_cast<int>(update.meshes.size()), kMeshesPerJob,
+        [&](int begin, int end) {
+          for (int i = begin; i < end; ++i) {
+            TsdfVolume::BlockMesh& mesh = update.meshes[i];
+            // The cells of a block span its voxel centers up to those of the
+            // next block, see TsdfVolume::ExtractUpdatedMeshes().
+            const glm::vec3 bounds_min =
+                (glm::vec3(mesh.key * TsdfVolume::kBlockSize) + 0.5f) *
+                options_.volume.voxel_size_m;
+            SimplifyMesh(min_edge_length, bounds_min,
+                         bounds_min + glm::vec3(block_extent), &mesh.vertices);
+          }
+        });
+
+    while (!finished_updates_.TryPush(&update)) {
+      std::this_thread::sleep_for(kQueueFullBackoff);
+      // Nothing pops updates while the OpenGL thread is paused, which is
+      // when exports are asked for.
+      ServeExport();
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (stopping_) {
+        return;
+      }
+    }
+  }
+}
+
+void BackgroundMesher::ServeExport() {
+  std::vector<TsdfVolume::BlockVoxels>* blocks = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    blocks = pending_export_;
+  }
+  if (blocks == nullptr) {
+    return;
+  }
+  volume_.ExportBlocks(blocks);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_export_ = nullptr;
+  }
+  export_done_.notify_all();
+}
+
+}  // namespace hello_ar
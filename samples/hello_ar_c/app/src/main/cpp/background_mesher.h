@@ -0,0 +1,138 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_BACKGROUND_MESHER_H_
+#define C_ARCORE_HELLOE_AR_BACKGROUND_MESHER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>  // NOLINT
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "glm.h"
+#include "spsc_queue.h"
+#include "tsdf_volume.h"
+
+namespace hello_ar {
+
+// Fuses depth images into a TsdfVolume and meshes it on a dedicated thread,
+// so the OpenGL thread only pays for copying the depth image in and
+// uploading the finished block meshes.
+//
+// SubmitDepthImage() hands a copy of the image to the mesher thread through a
+// single slot; an image the thread has not picked up yet is replaced, so a
+// slow mesher skips depth images rather than falling behind.  The thread
+// integrates the image, extracts the blocks whose surface changed,
+// simplifies each block mesh with SimplifyMesh() and pushes the result to a
+// lock-free queue, which PopMeshUpdate() drains.  The thread waits while the
+// queue is full, bounding the memory held by finished updates.
+//
+// SubmitDepthImage(), InvalidateMeshes(), ImportBlocks() and PopMeshUpdate()
+// must be called from the same thread, usually the OpenGL thread.
+// ExportBlocks() may be called from any thread while that one is paused.
+class BackgroundMesher {
+ public:
+  struct Options {
+    TsdfVolume::Options volume;
+    // Edges shorter than this fraction of the voxel size are collapsed.
+    float min_edge_voxels = 0.5f;
+  };
+
+  BackgroundMesher();
+  explicit BackgroundMesher(const Options& options);
+  ~BackgroundMesher();
+
+  BackgroundMesher(const BackgroundMesher&) = delete;
+  BackgroundMesher& operator=(const BackgroundMesher&) = delete;
+
+  // Copies a depth image for the mesher thread.  Arguments as for
+  // TsdfVolume::Integrate().
+  void SubmitDepthImage(const uint16_t* depth_mm, int width, int height,
+                        int row_stride, const glm::vec4& intrinsics,
+                        const glm::mat4& camera_pose_mat);
+
+  // Makes the mesher re-send every block mesh, e.g. for a new GL context.
+  void InvalidateMeshes();
+
+  // Copies |count| blocks saved from another session for the mesher thread,
+  // which fuses them into the volume before the next depth image, see
+  // TsdfVolume::ImportBlocks().
+  void ImportBlocks(const TsdfVolume::BlockVoxels* blocks, size_t count,
+                    const glm::mat4& transform);
+
+  // Copies the observed blocks of the volume into |blocks|.  Blocks until
+  // the mesher thread got to it, so it is meant for OnPause() rather than
+  // for every frame.
+  void ExportBlocks(std::vector<TsdfVolume::BlockVoxels>* blocks);
+
+  // Moves the oldest finished update into |update|, or returns false if
+  // there is none.  Updates must be applied in the order they are popped.
+  bool PopMeshUpdate(TsdfVolume::MeshUpdate* update);
+
+  // Depth images replaced before the mesher thread picked them up.
+  int64_t GetSkippedDepthImages() const { return skipped_depth_images_; }
+
+ private:
+  static constexpr uint32_t kQueueCapacity = 4;
+
+  struct DepthImage {
+    std::vector<uint16_t> depth_mm;
+    int width = 0;
+    int height = 0;
+    glm::vec4 intrinsics = glm::vec4(0.0f);
+    glm::mat4 camera_pose_mat = glm::mat4(1.0f);
+  };
+
+  struct BlockImport {
+    std::vector<TsdfVolume::BlockVoxels> blocks;
+    glm::mat4 transform = glm::mat4(1.0f);
+  };
+
+  void Run();
+
+  // Exports the volume if ExportBlocks() waits for it.
+  void ServeExport();
+
+  const Options options_;
+  TsdfVolume volume_;
+
+  // Guards the pending job below.  Only held to swap it, never while the
+  // volume is worked on.
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  bool stopping_ = false;
+  bool has_pending_image_ = false;
+  bool invalidate_pending_ = false;
+  DepthImage pending_image_;
+  std::vector<BlockImport> pending_imports_;
+  // Set by ExportBlocks() and cleared once the mesher thread filled it.
+  std::vector<TsdfVolume::BlockVoxels>* pending_export_ = nullptr;
+  std::condition_variable export_done_;
+
+  // Filled by the submitting thread outside of the lock, then swapped in.
+  DepthImage staging_image_;
+  std::atomic<int64_t> skipped_depth_images_{0};
+
+  SpscQueue<TsdfVolume::MeshUpdate, kQueueCapacity> finished_updates_;
+  std::thread thread_;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_BACKGROUND_MESHER_H_
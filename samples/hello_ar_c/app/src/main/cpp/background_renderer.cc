@@ -19,40 +19,112 @@
 
 #include "background_renderer.h"
 
-#include <type_traits>
+#include <GLES3/gl31.h>
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+#include "arcore_trace.h"
+#include "resource_accounting.h"
 #include "util.h"
 
 namespace hello_ar {
 namespace {
-// Positions of the quad vertices in clip space (X, Y).
-const GLfloat kVertices[] = {
-    -1.0f, -1.0f, +1.0f, -1.0f, -1.0f, +1.0f, +1.0f, +1.0f,
-};
-
-constexpr char kCameraVertexShaderFilename[] = "shaders/screenquad.vert";
-constexpr char kCameraFragmentShaderFilename[] = "shaders/screenquad.frag";
-
-constexpr char kDepthVisualizerVertexShaderFilename[] =
-    "shaders/background_show_depth_color_visualization.vert";
-constexpr char kDepthVisualizerFragmentShaderFilename[] =
-    "shaders/background_show_depth_color_visualization.frag";
 constexpr char kDepthColorPaletteImageFilename[] =
     "models/depth_color_palette.png";
 
+// The texture id of a texture that was never set.
+constexpr GLuint kInvalidTextureId = static_cast<GLuint>(-1);
+
+constexpr char kEisWarpShaderFileName[] = "shaders/eis_warp.comp";
+constexpr char kEisOwner[] = "BackgroundRenderer EIS";
+constexpr char kCameraCopyOwner[] = "BackgroundRenderer camera copy";
+// Matches local_size_x of eis_warp.comp.
+constexpr GLuint kEisWarpWorkGroupSize = 64;
+constexpr int kNumEisCorners = util::ScreenQuad::kNumVertices;
+constexpr int kNumEisIndices =
+    (BackgroundRenderer::kEisGridSize - 1) *
+    (BackgroundRenderer::kEisGridSize - 1) * 6;
+constexpr size_t kEisVertexBufferSize =
+    BackgroundRenderer::kMaxEisWarpComponents * sizeof(GLfloat);
+
+// The quad corners in the order of ScreenQuad.
+constexpr float kCorners[kNumEisCorners][2] = {
+    {-1.f, -1.f}, {1.f, -1.f}, {-1.f, 1.f}, {1.f, 1.f}};
+
+int GetEisSampleCount(BackgroundRenderer::StabilizationMode mode) {
+  switch (mode) {
+    case BackgroundRenderer::StabilizationMode::kWarpMesh:
+      return BackgroundRenderer::kNumEisVertices;
+    case BackgroundRenderer::StabilizationMode::kComputeWarp:
+      return kNumEisCorners;
+    default:
+      return 0;
+  }
+}
+
+// Normalized device coordinates of the warp mesh vertices, row by row.
+const float* GetEisGridPositions() {
+  static const auto positions = [] {
+    constexpr int kSize = BackgroundRenderer::kEisGridSize;
+    std::array<float, BackgroundRenderer::kNumEisVertices * 2> grid;
+    for (int y = 0; y < kSize; ++y) {
+      for (int x = 0; x < kSize; ++x) {
+        grid[2 * (y * kSize + x)] = -1.f + 2.f * x / (kSize - 1);
+        grid[2 * (y * kSize + x) + 1] = -1.f + 2.f * y / (kSize - 1);
+      }
+    }
+    return grid;
+  }();
+  return positions.data();
+}
+
+// What eis_warp.comp computes: the warp mesh vertices interpolated
+// bilinearly between the sampled corners, positions and homogeneous texture
+// coordinates alike.
+void InterpolateEisCorners(const float* corner_samples, float* out_vertices) {
+  constexpr int kSize = BackgroundRenderer::kEisGridSize;
+  constexpr int kNumVertices = BackgroundRenderer::kNumEisVertices;
+  for (int y = 0; y < kSize; ++y) {
+    const float t = static_cast<float>(y) / (kSize - 1);
+    for (int x = 0; x < kSize; ++x) {
+      const float s = static_cast<float>(x) / (kSize - 1);
+      const float weights[kNumEisCorners] = {(1.f - s) * (1.f - t),
+                                             s * (1.f - t), (1.f - s) * t,
+                                             s * t};
+      const int index = y * kSize + x;
+      for (int c = 0; c < 3; ++c) {
+        float position = 0.f;
+        float tex_coord = 0.f;
+        for (int i = 0; i < kNumEisCorners; ++i) {
+          position += weights[i] * corner_samples[3 * i + c];
+          tex_coord +=
+              weights[i] * corner_samples[3 * (kNumEisCorners + i) + c];
+        }
+        out_vertices[3 * index + c] = position;
+        out_vertices[3 * (kNumVertices + index) + c] = tex_coord;
+      }
+    }
+  }
+}
 }  // namespace
 
+constexpr int BackgroundRenderer::kEisGridSize;
+constexpr int BackgroundRenderer::kNumEisVertices;
+constexpr int BackgroundRenderer::kMaxEisWarpComponents;
+
 void BackgroundRenderer::InitializeGlContent(AAssetManager* asset_manager,
                                              int depth_texture_id) {
   // Defines the default background, which is the color camera image.
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
   glGenTextures(1, &camera_texture_id_);
-  glBindTexture(GL_TEXTURE_EXTERNAL_OES, camera_texture_id_);
+  gl_state.BindTexture(GL_TEXTURE_EXTERNAL_OES, camera_texture_id_);
   glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
   glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
   camera_program_ =
-      util::CreateProgram(kCameraVertexShaderFilename,
-                          kCameraFragmentShaderFilename, asset_manager);
+      util::CreateProgram(ShaderVariant::kCamera, asset_manager);
   if (!camera_program_) {
     LOGE("Could not create program.");
   }
@@ -62,21 +134,12 @@ void BackgroundRenderer::InitializeGlContent(AAssetManager* asset_manager,
   camera_tex_coord_attrib_ = glGetAttribLocation(camera_program_, "a_TexCoord");
 
   // Defines the color palette to use when rendering depth.
-  glGenTextures(1, &depth_color_palette_id_);
-  glBindTexture(GL_TEXTURE_2D, depth_color_palette_id_);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  if (!util::LoadPngFromAssetManager(GL_TEXTURE_2D,
-                                     kDepthColorPaletteImageFilename)) {
-    LOGE("Could not load png texture for depth color palette.");
-  }
+  depth_color_palette_id_ = util::TextureCache::Get().Acquire(
+      kDepthColorPaletteImageFilename, GL_CLAMP_TO_EDGE, GL_LINEAR);
 
   // Defines the depth visualization background, which shows the current depth.
-  depth_program_ = util::CreateProgram(kDepthVisualizerVertexShaderFilename,
-                                       kDepthVisualizerFragmentShaderFilename,
-                                       asset_manager);
+  depth_program_ =
+      util::CreateProgram(ShaderVariant::kDepthVisualizer, asset_manager);
   if (!depth_program_) {
     LOGE("Could not create program.");
   }
@@ -89,88 +152,405 @@ void BackgroundRenderer::InitializeGlContent(AAssetManager* asset_manager,
   depth_tex_coord_attrib_ = glGetAttribLocation(depth_program_, "a_TexCoord");
 
   depth_texture_id_ = depth_texture_id;
+
+  quad_.InitializeGlContent(/*uv_set_count=*/1);
+  uvs_initialized_ = false;
+
+  // Names of a previous context are gone with it; the copy is allocated again
+  // at the size it had.
+  camera_copy_texture_ = 0;
+  camera_copy_framebuffer_ = 0;
+  camera_copy_timestamp_ns_ = 0;
+  camera_copy_quad_.InitializeGlContent(/*uv_set_count=*/1);
+
+  InitializeEisWarp(asset_manager);
+}
+
+void BackgroundRenderer::InitializeEisWarp(AAssetManager* asset_manager) {
+  eis_program_ = util::CreateProgram(ShaderVariant::kEisCamera, asset_manager);
+  if (!eis_program_) {
+    LOGE("Could not create program.");
+  }
+  eis_texture_uniform_ = glGetUniformLocation(eis_program_, "sTexture");
+  eis_screen_warp_uniform_ =
+      glGetUniformLocation(eis_program_, "u_ScreenWarp");
+  eis_position_attrib_ = glGetAttribLocation(eis_program_, "a_Position");
+  eis_tex_coord_attrib_ = glGetAttribLocation(eis_program_, "a_TexCoord");
+
+  // Two triangles per grid cell.  The topology never changes, only the
+  // vertices move with the stabilization.
+  uint16_t indices[kNumEisIndices];
+  int next = 0;
+  for (int y = 0; y + 1 < kEisGridSize; ++y) {
+    for (int x = 0; x + 1 < kEisGridSize; ++x) {
+      const uint16_t corner = static_cast<uint16_t>(y * kEisGridSize + x);
+      const uint16_t above = static_cast<uint16_t>(corner + kEisGridSize);
+      const uint16_t cell[6] = {corner,    static_cast<uint16_t>(corner + 1),
+                                above,     above,
+                                static_cast<uint16_t>(corner + 1),
+                                static_cast<uint16_t>(above + 1)};
+      std::copy(std::begin(cell), std::end(cell), indices + next);
+      next += 6;
+    }
+  }
+  ResourceAccounting& accounting = ResourceAccounting::Get();
+  glGenBuffers(1, &eis_index_buffer_);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, eis_index_buffer_);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices,
+               GL_STATIC_DRAW);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  accounting.Track(GpuResourceType::kBuffer, eis_index_buffer_,
+                   sizeof(indices), kEisOwner);
+
+  // Allocated once at the size of the whole mesh; every frame only replaces
+  // its contents.
+  glGenBuffers(1, &eis_vertex_buffer_);
+  glBindBuffer(GL_ARRAY_BUFFER, eis_vertex_buffer_);
+  glBufferData(GL_ARRAY_BUFFER, kEisVertexBufferSize, nullptr,
+               GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  accounting.Track(GpuResourceType::kBuffer, eis_vertex_buffer_,
+                   kEisVertexBufferSize, kEisOwner);
+
+  // Names of a previous context are gone with it.
+  eis_warp_program_ = 0;
+  if (util::IsContextVersionAtLeast31()) {
+    eis_warp_program_ =
+        util::CreateComputeProgram(kEisWarpShaderFileName, asset_manager);
+    if (!eis_warp_program_) {
+      LOGE("Could not create EIS warp program.");
+    }
+    eis_warp_grid_size_uniform_ =
+        glGetUniformLocation(eis_warp_program_, "u_GridSize");
+    eis_warp_corner_positions_uniform_ =
+        glGetUniformLocation(eis_warp_program_, "u_CornerPositions");
+    eis_warp_corner_tex_coords_uniform_ =
+        glGetUniformLocation(eis_warp_program_, "u_CornerTexCoords");
+  }
+  util::CheckGlError("BackgroundRenderer::InitializeEisWarp() error");
 }
 
 void BackgroundRenderer::Draw(const ArSession* session, const ArFrame* frame,
+                              const FrameContext& frame_context,
                               bool debug_show_depth_map) {
-  static_assert(std::extent<decltype(kVertices)>::value == kNumVertices * 2,
-                "Incorrect kVertices length");
-
   // If display rotation changed (also includes view size change), we need to
   // re-query the uv coordinates for the on-screen portion of the camera image.
-  int32_t geometry_changed = 0;
-  ArFrame_getDisplayGeometryChanged(session, frame, &geometry_changed);
-  if (geometry_changed != 0 || !uvs_initialized_) {
-    ArFrame_transformCoordinates2d(
-        session, frame, AR_COORDINATES_2D_OPENGL_NORMALIZED_DEVICE_COORDINATES,
-        kNumVertices, kVertices, AR_COORDINATES_2D_TEXTURE_NORMALIZED,
-        transformed_uvs_);
+  if (frame_context.display_geometry_changed || !uvs_initialized_) {
+    ComputeTransformedUvs(session, frame, frame_uvs_);
     uvs_initialized_ = true;
   }
+  // Only uploads when the reprojection or the display geometry changed.
+  float transformed_uvs[kNumUvComponents];
+  ReprojectUvs(transformed_uvs);
+  quad_.SetUvs(0, transformed_uvs);
+  if (frame_context.timestamp_ns == 0) {
+    // Suppress rendering if the camera did not produce the first frame yet.
+    // This is to avoid drawing possible leftover data from previous sessions if
+    // the texture is reused.
+    return;
+  }
+  // The copy is stabilized even while the depth map is shown instead.
+  const bool use_eis_warp = stabilization_mode_ != StabilizationMode::kOff;
+  if (use_eis_warp) {
+    SampleEisWarp(session, frame, stabilization_mode_, &eis_warp_);
+    UploadEisWarp(eis_warp_);
+  }
+  UpdateCameraCopy(frame_context.timestamp_ns, camera_texture_id_,
+                   use_eis_warp);
+  if (use_eis_warp && !debug_show_depth_map) {
+    DrawEisWarp(camera_texture_id_, glm::inverse(reprojection_));
+    return;
+  }
+  DrawQuad(camera_texture_id_, debug_show_depth_map);
+}
 
-  int64_t frame_timestamp;
-  ArFrame_getTimestamp(session, frame, &frame_timestamp);
-  if (frame_timestamp == 0) {
+void BackgroundRenderer::Draw(const FrameContext& frame_context,
+                              GLuint camera_texture_id,
+                              const float* transformed_uvs,
+                              const EisWarp& eis_warp,
+                              bool debug_show_depth_map) {
+  // Only uploads when the coordinates changed with the display geometry or
+  // the reprojection.
+  std::copy(transformed_uvs, transformed_uvs + kNumUvComponents, frame_uvs_);
+  float reprojected_uvs[kNumUvComponents];
+  ReprojectUvs(reprojected_uvs);
+  quad_.SetUvs(0, reprojected_uvs);
+  if (frame_context.timestamp_ns == 0) {
     // Suppress rendering if the camera did not produce the first frame yet.
     // This is to avoid drawing possible leftover data from previous sessions if
     // the texture is reused.
     return;
   }
+  const bool use_eis_warp = eis_warp.mode != StabilizationMode::kOff;
+  if (use_eis_warp) {
+    UploadEisWarp(eis_warp);
+  }
+  UpdateCameraCopy(frame_context.timestamp_ns, camera_texture_id,
+                   use_eis_warp);
+  if (use_eis_warp && !debug_show_depth_map) {
+    DrawEisWarp(camera_texture_id, glm::inverse(reprojection_));
+    return;
+  }
+  DrawQuad(camera_texture_id, debug_show_depth_map);
+}
+
+void BackgroundRenderer::ComputeTransformedUvs(const ArSession* session,
+                                               const ArFrame* frame,
+                                               float* out_uvs) {
+  util::ScreenQuad::TransformCorners(
+      session, frame, AR_COORDINATES_2D_TEXTURE_NORMALIZED, out_uvs);
+}
+
+void BackgroundRenderer::SampleEisWarp(const ArSession* session,
+                                       const ArFrame* frame,
+                                       StabilizationMode mode,
+                                       EisWarp* out_warp) {
+  out_warp->mode = mode;
+  const int count = GetEisSampleCount(mode);
+  if (count == 0) {
+    return;
+  }
+  const float* positions = mode == StabilizationMode::kComputeWarp
+                               ? &kCorners[0][0]
+                               : GetEisGridPositions();
+  traced::ArFrame_transformCoordinates3d(
+      session, frame, AR_COORDINATES_2D_OPENGL_NORMALIZED_DEVICE_COORDINATES,
+      count, positions, AR_COORDINATES_3D_EIS_NORMALIZED_DEVICE_COORDINATES,
+      out_warp->samples);
+  traced::ArFrame_transformCoordinates3d(
+      session, frame, AR_COORDINATES_2D_OPENGL_NORMALIZED_DEVICE_COORDINATES,
+      count, positions, AR_COORDINATES_3D_EIS_TEXTURE_NORMALIZED,
+      out_warp->samples + 3 * count);
+}
+
+void BackgroundRenderer::UploadEisWarp(const EisWarp& eis_warp) {
+  if (eis_warp.mode == StabilizationMode::kWarpMesh) {
+    glBindBuffer(GL_ARRAY_BUFFER, eis_vertex_buffer_);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, kEisVertexBufferSize,
+                    eis_warp.samples);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return;
+  }
+  if (eis_warp_program_ == 0) {
+    float vertices[kMaxEisWarpComponents];
+    InterpolateEisCorners(eis_warp.samples, vertices);
+    glBindBuffer(GL_ARRAY_BUFFER, eis_vertex_buffer_);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, kEisVertexBufferSize, vertices);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return;
+  }
+  // The vertex buffer is written in place, so nothing crosses the bus but
+  // the corners.
+  util::GlStateCache::Get().UseProgram(eis_warp_program_);
+  glUniform1i(eis_warp_grid_size_uniform_, kEisGridSize);
+  glUniform3fv(eis_warp_corner_positions_uniform_, kNumEisCorners,
+               eis_warp.samples);
+  glUniform3fv(eis_warp_corner_tex_coords_uniform_, kNumEisCorners,
+               eis_warp.samples + 3 * kNumEisCorners);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, eis_vertex_buffer_);
+  glDispatchCompute(
+      (kNumEisVertices + kEisWarpWorkGroupSize - 1) / kEisWarpWorkGroupSize,
+      1, 1);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+  // The draw reads the vertices as attributes.
+  glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+  util::CheckGlError("BackgroundRenderer::UploadEisWarp() error");
+}
+
+void BackgroundRenderer::DrawEisWarp(GLuint camera_texture_id,
+                                     const glm::mat3& screen_warp) {
+  if (eis_program_ == 0 || camera_texture_id == kInvalidTextureId) {
+    return;
+  }
 
-  if (depth_texture_id_ == -1 || depth_color_palette_id_ == -1 ||
-      camera_texture_id_ == -1) {
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
+  gl_state.DepthMask(GL_FALSE);
+  gl_state.SetCapability(GL_BLEND, false);
+  gl_state.ActiveTexture(GL_TEXTURE0);
+  gl_state.BindTexture(GL_TEXTURE_EXTERNAL_OES, camera_texture_id);
+  gl_state.UseProgram(eis_program_);
+  glUniform1i(eis_texture_uniform_, 0);
+  glUniformMatrix3fv(eis_screen_warp_uniform_, 1, GL_FALSE,
+                     glm::value_ptr(screen_warp));
+
+  gl_state.SetEnabledVertexAttribArrays((1u << eis_position_attrib_) |
+                                        (1u << eis_tex_coord_attrib_));
+  glBindBuffer(GL_ARRAY_BUFFER, eis_vertex_buffer_);
+  glVertexAttribPointer(eis_position_attrib_, 3, GL_FLOAT, GL_FALSE, 0,
+                        nullptr);
+  glVertexAttribPointer(
+      eis_tex_coord_attrib_, 3, GL_FLOAT, GL_FALSE, 0,
+      reinterpret_cast<const void*>(kNumEisVertices * 3 * sizeof(GLfloat)));
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, eis_index_buffer_);
+  glDrawElements(GL_TRIANGLES, kNumEisIndices, GL_UNSIGNED_SHORT, nullptr);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+  util::CheckGlError("BackgroundRenderer::DrawEisWarp() error");
+}
+
+void BackgroundRenderer::ReprojectUvs(float* out_uvs) const {
+  for (int i = 0; i < util::ScreenQuad::kNumVertices; ++i) {
+    const glm::vec3 point =
+        reprojection_ * glm::vec3(kCorners[i][0], kCorners[i][1], 1.f);
+    if (point.z <= 0.f) {
+      std::copy(frame_uvs_, frame_uvs_ + kNumUvComponents, out_uvs);
+      return;
+    }
+    // The corner's texture coordinates, interpolated bilinearly between
+    // those of the unwarped corners.
+    const float s = 0.5f * (point.x / point.z + 1.f);
+    const float t = 0.5f * (point.y / point.z + 1.f);
+    for (int c = 0; c < 2; ++c) {
+      out_uvs[2 * i + c] = (1.f - s) * (1.f - t) * frame_uvs_[c] +
+                           s * (1.f - t) * frame_uvs_[2 + c] +
+                           (1.f - s) * t * frame_uvs_[4 + c] +
+                           s * t * frame_uvs_[6 + c];
+    }
+  }
+}
+
+void BackgroundRenderer::DrawQuad(GLuint camera_texture_id,
+                                  bool debug_show_depth_map) {
+  if (depth_texture_id_ == kInvalidTextureId ||
+      depth_color_palette_id_ == kInvalidTextureId ||
+      camera_texture_id == kInvalidTextureId) {
     return;
   }
 
-  glDepthMask(GL_FALSE);
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
+  gl_state.DepthMask(GL_FALSE);
+  gl_state.SetCapability(GL_BLEND, false);
 
   if (debug_show_depth_map) {
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, depth_texture_id_);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, depth_color_palette_id_);
-    glUseProgram(depth_program_);
+    gl_state.ActiveTexture(GL_TEXTURE0);
+    gl_state.BindTexture(GL_TEXTURE_2D, depth_texture_id_);
+    gl_state.ActiveTexture(GL_TEXTURE1);
+    gl_state.BindTexture(GL_TEXTURE_2D, depth_color_palette_id_);
+    gl_state.UseProgram(depth_program_);
     glUniform1i(depth_texture_uniform_, 0);
     glUniform1i(depth_color_palette_uniform_, 1);
 
     // Set the vertex positions and texture coordinates.
-    glVertexAttribPointer(depth_position_attrib_, 2, GL_FLOAT, false, 0,
-                          kVertices);
-    glVertexAttribPointer(depth_tex_coord_attrib_, 2, GL_FLOAT, false, 0,
-                          transformed_uvs_);
-    glEnableVertexAttribArray(depth_position_attrib_);
-    glEnableVertexAttribArray(depth_tex_coord_attrib_);
+    gl_state.SetEnabledVertexAttribArrays((1u << depth_position_attrib_) |
+                                          (1u << depth_tex_coord_attrib_));
+    quad_.Draw(depth_position_attrib_, &depth_tex_coord_attrib_);
   } else {
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_EXTERNAL_OES, camera_texture_id_);
-    glUseProgram(camera_program_);
-    glUniform1i(camera_texture_uniform_, 0);
+    DrawCamera(quad_, camera_texture_id);
+  }
 
-    // Set the vertex positions and texture coordinates.
-    glVertexAttribPointer(camera_position_attrib_, 2, GL_FLOAT, false, 0,
-                          kVertices);
-    glVertexAttribPointer(camera_tex_coord_attrib_, 2, GL_FLOAT, false, 0,
-                          transformed_uvs_);
-    glEnableVertexAttribArray(camera_position_attrib_);
-    glEnableVertexAttribArray(camera_tex_coord_attrib_);
+  util::CheckGlError("BackgroundRenderer::Draw() error");
+}
+
+void BackgroundRenderer::DrawCamera(const util::ScreenQuad& quad,
+                                    GLuint camera_texture_id) {
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
+  gl_state.ActiveTexture(GL_TEXTURE0);
+  gl_state.BindTexture(GL_TEXTURE_EXTERNAL_OES, camera_texture_id);
+  gl_state.UseProgram(camera_program_);
+  glUniform1i(camera_texture_uniform_, 0);
+
+  // Set the vertex positions and texture coordinates.
+  gl_state.SetEnabledVertexAttribArrays((1u << camera_position_attrib_) |
+                                        (1u << camera_tex_coord_attrib_));
+  quad.Draw(camera_position_attrib_, &camera_tex_coord_attrib_);
+}
+
+GLuint BackgroundRenderer::GetTextureId() const { return camera_texture_id_; }
+
+void BackgroundRenderer::SetCameraCopySize(int width, int height) {
+  width = std::max(width, 0);
+  height = std::max(height, 0);
+  if (width == camera_copy_width_ && height == camera_copy_height_) {
+    return;
   }
+  DeleteCameraCopy();
+  camera_copy_width_ = width;
+  camera_copy_height_ = height;
+}
 
-  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+void BackgroundRenderer::DeleteCameraCopy() {
+  if (camera_copy_texture_) {
+    ResourceAccounting::Get().Untrack(GpuResourceType::kTexture,
+                                      camera_copy_texture_);
+    glDeleteTextures(1, &camera_copy_texture_);
+    glDeleteFramebuffers(1, &camera_copy_framebuffer_);
+  }
+  camera_copy_texture_ = 0;
+  camera_copy_framebuffer_ = 0;
+  camera_copy_timestamp_ns_ = 0;
+}
 
-  // Disable vertex arrays
-  if (debug_show_depth_map) {
-    glDisableVertexAttribArray(depth_position_attrib_);
-    glDisableVertexAttribArray(depth_tex_coord_attrib_);
+void BackgroundRenderer::UpdateCameraCopy(int64_t timestamp_ns,
+                                          GLuint camera_texture_id,
+                                          bool use_eis_warp) {
+  if (camera_copy_width_ == 0 || camera_copy_height_ == 0 ||
+      camera_texture_id == kInvalidTextureId) {
+    return;
+  }
+  // The background of every display frame of a camera frame shows the same
+  // image, only the reprojection differs.
+  if (timestamp_ns == camera_copy_timestamp_ns_ &&
+      std::equal(std::begin(frame_uvs_), std::end(frame_uvs_),
+                 camera_copy_uvs_)) {
+    return;
+  }
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
+  if (!camera_copy_texture_) {
+    // The full chain, down to 1 x 1.
+    int levels = 1;
+    while ((std::max(camera_copy_width_, camera_copy_height_) >> levels) > 0) {
+      ++levels;
+    }
+    glGenTextures(1, &camera_copy_texture_);
+    gl_state.BindTexture(GL_TEXTURE_2D, camera_copy_texture_);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                    GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexStorage2D(GL_TEXTURE_2D, levels, GL_RGBA8, camera_copy_width_,
+                   camera_copy_height_);
+    ResourceAccounting::Get().Track(
+        GpuResourceType::kTexture, camera_copy_texture_,
+        GetTextureBytes(GL_RGBA8, camera_copy_width_, camera_copy_height_,
+                        levels),
+        kCameraCopyOwner);
+
+    glGenFramebuffers(1, &camera_copy_framebuffer_);
+    glBindFramebuffer(GL_FRAMEBUFFER, camera_copy_framebuffer_);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                           camera_copy_texture_, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+      LOGE("BackgroundRenderer: camera copy framebuffer is incomplete.");
+    }
+  }
+
+  // The background pass draws into whatever target the frame graph bound.
+  GLint framebuffer = 0;
+  GLint viewport[4];
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer);
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  glBindFramebuffer(GL_FRAMEBUFFER, camera_copy_framebuffer_);
+  glViewport(0, 0, camera_copy_width_, camera_copy_height_);
+  gl_state.DepthMask(GL_FALSE);
+  gl_state.SetCapability(GL_BLEND, false);
+  if (use_eis_warp) {
+    DrawEisWarp(camera_texture_id, glm::mat3(1.f));
   } else {
-    glDisableVertexAttribArray(camera_position_attrib_);
-    glDisableVertexAttribArray(camera_tex_coord_attrib_);
+    camera_copy_quad_.SetUvs(0, frame_uvs_);
+    DrawCamera(camera_copy_quad_, camera_texture_id);
   }
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
 
-  glUseProgram(0);
-  glDepthMask(GL_TRUE);
-  util::CheckGlError("BackgroundRenderer::Draw() error");
-}
+  // The mipmaps are built once, however many effects read the copy.
+  gl_state.BindTexture(GL_TEXTURE_2D, camera_copy_texture_);
+  glGenerateMipmap(GL_TEXTURE_2D);
 
-GLuint BackgroundRenderer::GetTextureId() const { return camera_texture_id_; }
+  camera_copy_timestamp_ns_ = timestamp_ns;
+  std::copy(std::begin(frame_uvs_), std::end(frame_uvs_), camera_copy_uvs_);
+  util::CheckGlError("BackgroundRenderer::UpdateCameraCopy() error");
+}
 
 }  // namespace hello_ar
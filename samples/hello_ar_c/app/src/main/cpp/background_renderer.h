@@ -20,9 +20,12 @@
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
 #include <android/asset_manager.h>
+#include <cstdint>
 #include <cstdlib>
 
 #include "arcore_c_api.h"
+#include "frame_context.h"
+#include "glm.h"
 #include "util.h"
 
 namespace hello_ar {
@@ -30,6 +33,36 @@ namespace hello_ar {
 // This class renders the passthrough camera image into the OpenGL frame.
 class BackgroundRenderer {
  public:
+  // How the camera image is drawn while the session is configured with
+  // AR_IMAGE_STABILIZATION_MODE_EIS.  Both modes draw a warp mesh whose
+  // topology never changes, so only its vertices are uploaded each frame.
+  enum class StabilizationMode {
+    // Draws the unstabilized quad.  Must be used while EIS is off.
+    kOff = 0,
+    // ARCore transforms every vertex of the warp mesh on the CPU.
+    kWarpMesh,
+    // ARCore only transforms the corners, and a compute pass interpolates
+    // the vertices in between into the vertex buffer.  Needs OpenGL ES 3.1;
+    // the same interpolation runs on the CPU otherwise.
+    kComputeWarp,
+  };
+
+  // Vertices a side of the warp mesh.
+  static constexpr int kEisGridSize = 9;
+  static constexpr int kNumEisVertices = kEisGridSize * kEisGridSize;
+  // Floats of the largest EisWarp, which kWarpMesh writes.
+  static constexpr int kMaxEisWarpComponents = kNumEisVertices * 3 * 2;
+
+  // The stabilized image of one frame, as written by SampleEisWarp().
+  struct EisWarp {
+    StabilizationMode mode = StabilizationMode::kOff;
+    // The xyz EIS normalized device coordinates of the sampled vertices,
+    // then as many xyz EIS texture coordinates.  Sampled are the warp mesh
+    // vertices row by row for kWarpMesh, and the quad corners for
+    // kComputeWarp.
+    float samples[kMaxEisWarpComponents] = {};
+  };
+
   BackgroundRenderer() = default;
   ~BackgroundRenderer() = default;
 
@@ -39,16 +72,95 @@ class BackgroundRenderer {
 
   // Draws the background image.  This methods must be called for every ArFrame
   // returned by ArSession_update() to catch display geometry change events.
+  //  frame_context Display geometry and timestamp of |frame|.
   //  debugShowDepthMap Toggles whether to show the live camera feed or latest
   //  depth image.
   void Draw(const ArSession* session, const ArFrame* frame,
+            const FrameContext& frame_context, bool debug_show_depth_map);
+
+  // Draws a camera image captured elsewhere, e.g. on the AR update thread.
+  //  camera_texture_id GL_TEXTURE_EXTERNAL_OES texture holding the image.
+  //  transformed_uvs Texture coordinates of the quad corners, as written by
+  //  ComputeTransformedUvs().
+  //  eis_warp Stabilized image of the same frame, drawn instead of the
+  //  quad unless its mode is kOff.
+  void Draw(const FrameContext& frame_context, GLuint camera_texture_id,
+            const float* transformed_uvs, const EisWarp& eis_warp,
             bool debug_show_depth_map);
 
+  // Number of floats written by ComputeTransformedUvs().
+  static constexpr int kNumUvComponents = util::ScreenQuad::kNumUvComponents;
+
+  // Maps the full screen quad to the on-screen portion of the camera image of
+  // |frame|.  Only needs to be re-run when the display geometry changed.
+  static void ComputeTransformedUvs(const ArSession* session,
+                                    const ArFrame* frame, float* out_uvs);
+
+  // Samples the stabilized image of |frame| the way |mode| draws it.  Unlike
+  // the quad uvs the warp changes with every frame.
+  static void SampleEisWarp(const ArSession* session, const ArFrame* frame,
+                            StabilizationMode mode, EisWarp* out_warp);
+
+  // Mode the Draw() that takes the frame samples the warp with.  Must stay
+  // kOff unless the session is configured with EIS.
+  void SetStabilizationMode(StabilizationMode mode) {
+    stabilization_mode_ = mode;
+  }
+
+  // Warps the camera image of the next Draw() calls by
+  // |ndc_homography|, which maps a point of the screen in normalized device
+  // coordinates to where it was in the camera image, e.g. to follow a view
+  // corrected after the frame was taken.  Stays set until the next call;
+  // the identity draws the image as is.  A stabilized image is warped the
+  // same way.
+  void SetReprojection(const glm::mat3& ndc_homography) {
+    reprojection_ = ndc_homography;
+  }
+
   // Returns the generated texture name for the GL_TEXTURE_EXTERNAL_OES target.
   GLuint GetTextureId() const;
 
+  // Keeps a |width| x |height| mipmapped GL_TEXTURE_2D copy of the on-screen
+  // part of the camera image for the effects that sample it, so the external
+  // texture is only read once per camera frame and each effect picks the
+  // level it needs.  Draw() renders the copy when the camera image changed,
+  // stabilized like the background but without the reprojection.  A size of
+  // 0 stops copying.  Must be called on the OpenGL thread.
+  void SetCameraCopySize(int width, int height);
+
+  // The copy, or 0 until a Draw() rendered it.
+  GLuint GetCameraCopyTextureId() const {
+    return camera_copy_timestamp_ns_ != 0 ? camera_copy_texture_ : 0;
+  }
+
+  // Updates the depth texture shown by the depth visualization, e.g. after the
+  // depth texture was reallocated for a new resolution.
+  void SetDepthTexture(GLuint depth_texture_id) {
+    depth_texture_id_ = depth_texture_id;
+  }
+
  private:
-  static constexpr int kNumVertices = 4;
+  // Draws quad_ with the texture coordinates it currently holds.
+  void DrawQuad(GLuint camera_texture_id, bool debug_show_depth_map);
+  // Draws the camera image over |quad|.
+  void DrawCamera(const util::ScreenQuad& quad, GLuint camera_texture_id);
+
+  // Renders the camera image of |timestamp_ns| into camera_copy_texture_,
+  // through the uploaded warp mesh if |use_eis_warp|, unless the copy holds
+  // it already.
+  void UpdateCameraCopy(int64_t timestamp_ns, GLuint camera_texture_id,
+                        bool use_eis_warp);
+  void DeleteCameraCopy();
+
+  // frame_uvs_ as seen through reprojection_.
+  void ReprojectUvs(float* out_uvs) const;
+
+  // Creates the warp mesh buffers, and the compute pass if it is supported.
+  void InitializeEisWarp(AAssetManager* asset_manager);
+  // Writes the vertices of |eis_warp| into eis_vertex_buffer_.
+  void UploadEisWarp(const EisWarp& eis_warp);
+  // |screen_warp| maps the stabilized image to where it is drawn.
+  void DrawEisWarp(GLuint camera_texture_id, const glm::mat3& screen_warp);
 
   GLuint camera_program_;
   GLuint depth_program_;
@@ -66,8 +178,40 @@ class BackgroundRenderer {
   GLuint depth_position_attrib_;
   GLuint depth_tex_coord_attrib_;
 
-  float transformed_uvs_[kNumVertices * 2];
+  // Shared by the camera and the depth visualization programs.
+  util::ScreenQuad quad_;
   bool uvs_initialized_ = false;
+  // Texture coordinates of the quad corners for the display geometry.
+  float frame_uvs_[kNumUvComponents] = {};
+  glm::mat3 reprojection_ = glm::mat3(1.f);
+
+  StabilizationMode stabilization_mode_ = StabilizationMode::kOff;
+  // Sampled by the Draw() that takes the frame.
+  EisWarp eis_warp_;
+  GLuint eis_program_ = 0;
+  GLuint eis_position_attrib_;
+  GLuint eis_tex_coord_attrib_;
+  GLuint eis_texture_uniform_;
+  GLuint eis_screen_warp_uniform_;
+  // Planar positions, then texture coordinates of the warp mesh vertices.
+  GLuint eis_vertex_buffer_ = 0;
+  GLuint eis_index_buffer_ = 0;
+  // 0 without OpenGL ES 3.1.
+  GLuint eis_warp_program_ = 0;
+  GLuint eis_warp_grid_size_uniform_;
+  GLuint eis_warp_corner_positions_uniform_;
+  GLuint eis_warp_corner_tex_coords_uniform_;
+
+  int camera_copy_width_ = 0;
+  int camera_copy_height_ = 0;
+  GLuint camera_copy_texture_ = 0;
+  GLuint camera_copy_framebuffer_ = 0;
+  // Maps the copy to frame_uvs_, without the reprojection of quad_.
+  util::ScreenQuad camera_copy_quad_;
+  // Camera image and texture coordinates the copy holds, 0 while it holds
+  // none.
+  int64_t camera_copy_timestamp_ns_ = 0;
+  float camera_copy_uvs_[kNumUvComponents] = {};
 };
 }  // namespace hello_ar
 #endif  // C_ARCORE_HELLO_AR_BACKGROUND_RENDERER_H_
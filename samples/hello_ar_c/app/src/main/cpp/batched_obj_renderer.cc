@@ -0,0 +1,387 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "batched_obj_renderer.h"
+
+#include <algorithm>
+#include <cstddef>
+
+#include "resource_accounting.h"
+#include "util.h"
+
+namespace hello_ar {
+namespace {
+constexpr char kOwner[] = "BatchedObjRenderer";
+const glm::vec4 kLightDirection(0.0f, 1.0f, 0.0f, 0.0f);
+
+constexpr char kBinaryMeshExtension[] = ".mesh";
+
+// Interleaved vertex layout of ObjRenderer: position (xyz), normal (xyz),
+// uv (st).
+constexpr int kPositionComponents = 3;
+constexpr int kNormalComponents = 3;
+constexpr int kUvComponents = 2;
+constexpr int kVertexComponents =
+    kPositionComponents + kNormalComponents + kUvComponents;
+constexpr GLsizei kVertexStride = kVertexComponents * sizeof(GLfloat);
+constexpr size_t kNormalOffset = kPositionComponents * sizeof(GLfloat);
+constexpr size_t kUvOffset =
+    (kPositionComponents + kNormalComponents) * sizeof(GLfloat);
+
+// The merged geometry is drawn with 16-bit indices while it fits.
+constexpr size_t kMaxShortIndexedVertices = 65536;
+
+// A mat4 attribute occupies four consecutive vec4 attribute locations.
+constexpr int kMatrixColumns = 4;
+
+bool IsBinaryMesh(const std::string& file_name) {
+  const std::string extension = kBinaryMeshExtension;
+  return file_name.size() >= extension.size() &&
+         file_name.compare(file_name.size() - extension.size(),
+                           extension.size(), extension) == 0;
+}
+
+// Same bounding sphere as tools/obj_to_mesh.py: centered on the bounding
+// box, with the radius reaching the farthest vertex.
+glm::vec4 ComputeBoundingSphere(const ObjMesh& mesh) {
+  const size_t vertex_count = mesh.GetVertexCount();
+  glm::vec3 lower(0.0f);
+  glm::vec3 upper(0.0f);
+  for (size_t i = 0; i < vertex_count; ++i) {
+    const float* p = &mesh.vertices[i * kVertexComponents];
+    const glm::vec3 position(p[0], p[1], p[2]);
+    lower = i == 0 ? position : glm::min(lower, position);
+    upper = i == 0 ? position : glm::max(upper, position);
+  }
+  const glm::vec3 center = (lower + upper) * 0.5f;
+  float radius = 0.0f;
+  for (size_t i = 0; i < vertex_count; ++i) {
+    const float* p = &mesh.vertices[i * kVertexComponents];
+    radius =
+        std::max(radius, glm::length(glm::vec3(p[0], p[1], p[2]) - center));
+  }
+  return glm::vec4(center, radius);
+}
+}  // namespace
+
+void BatchedObjRenderer::InitializeGlContent(AAssetManager* asset_manager) {
+  shader_program_ =
+      util::CreateProgram(ShaderVariant::kObjectBatched, asset_manager);
+  if (!shader_program_) {
+    LOGE("Could not create program.");
+  }
+  position_attrib_ = glGetAttribLocation(shader_program_, "a_Position");
+  normal_attrib_ = glGetAttribLocation(shader_program_, "a_Normal");
+  tex_coord_attrib_ = glGetAttribLocation(shader_program_, "a_TexCoord");
+  model_mat_attrib_ = glGetAttribLocation(shader_program_, "a_ModelMatrix");
+  color_attrib_ = glGetAttribLocation(shader_program_, "a_ObjColor");
+  layer_attrib_ = glGetAttribLocation(shader_program_, "a_Layer");
+  view_mat_uniform_ = glGetUniformLocation(shader_program_, "u_View");
+  projection_mat_uniform_ =
+      glGetUniformLocation(shader_program_, "u_Projection");
+  textures_uniform_ = glGetUniformLocation(shader_program_, "u_Textures");
+  light_direction_uniform_ =
+      glGetUniformLocation(shader_program_, "u_LightDirection");
+  material_param_uniform_ =
+      glGetUniformLocation(shader_program_, "u_MaterialParameters");
+  color_correction_param_uniform_ =
+      glGetUniformLocation(shader_program_, "u_ColorCorrectionParameters");
+
+  // Objects of a previous context are gone with it, and the models have to
+  // be added again.
+  atlas_.InitializeGlContent();
+  models_.clear();
+  vertices_.clear();
+  indices_.clear();
+  geometry_dirty_ = false;
+  glGenVertexArrays(1, &vertex_array_);
+  glGenBuffers(1, &vertex_buffer_);
+  glGenBuffers(1, &index_buffer_);
+  glGenBuffers(1, &instance_buffer_);
+  util::CheckGlError("BatchedObjRenderer::InitializeGlContent()");
+}
+
+int BatchedObjRenderer::AddModel(AAssetManager* asset_manager,
+                                 const std::string& mesh_file_name,
+                                 const std::string& png_file_name) {
+  Model model;
+  if (IsBinaryMesh(mesh_file_name)) {
+    util::MeshAsset mesh;
+    if (!mesh.Open(mesh_file_name.c_str(), asset_manager)) {
+      LOGE("Could not load mesh %s.", mesh_file_name.c_str());
+      return -1;
+    }
+    const util::MeshFileHeader& header = mesh.GetHeader();
+    if (header.vertex_stride != kVertexStride) {
+      LOGE("Mesh %s has vertex stride %u, expected %d",
+           mesh_file_name.c_str(), header.vertex_stride, kVertexStride);
+      return -1;
+    }
+    const float* vertices = static_cast<const float*>(mesh.GetVertexData());
+    if (mesh.GetIndexType() == GL_UNSIGNED_SHORT) {
+      model = AppendMesh(vertices, header.vertex_count,
+                         static_cast<const uint16_t*>(mesh.GetIndexData()),
+                         header.index_count);
+    } else {
+      model = AppendMesh(vertices, header.vertex_count,
+                         static_cast<const uint32_t*>(mesh.GetIndexData()),
+                         header.index_count);
+    }
+    model.bounding_sphere =
+        glm::vec4(header.bounding_sphere[0], header.bounding_sphere[1],
+                  header.bounding_sphere[2], header.bounding_sphere[3]);
+  } else {
+    ObjMesh mesh;
+    if (!util::LoadObjFile(mesh_file_name, asset_manager, &mesh)) {
+      LOGE("Could not load obj file %s.", mesh_file_name.c_str());
+      return -1;
+    }
+    model = AppendMesh(mesh.vertices.data(), mesh.GetVertexCount(),
+                       mesh.indices.data(), mesh.indices.size());
+    model.bounding_sphere = ComputeBoundingSphere(mesh);
+  }
+  model.material = atlas_.AddMaterial(png_file_name);
+  models_.push_back(model);
+  return static_cast<int>(models_.size()) - 1;
+}
+
+template <typename Index>
+BatchedObjRenderer::Model BatchedObjRenderer::AppendMesh(
+    const float* vertices, size_t vertex_count, const Index* indices,
+    size_t index_count) {
+  const uint32_t base_vertex =
+      static_cast<uint32_t>(vertices_.size() / kVertexComponents);
+  Model model;
+  model.first_index = static_cast<GLuint>(indices_.size());
+  model.index_count = static_cast<GLsizei>(index_count);
+  vertices_.insert(vertices_.end(), vertices,
+                   vertices + vertex_count * kVertexComponents);
+  // Without base vertex draws the indices have to address the merged
+  // vertices themselves.
+  indices_.reserve(indices_.size() + index_count);
+  for (size_t i = 0; i < index_count; ++i) {
+    indices_.push_back(base_vertex + indices[i]);
+  }
+  geometry_dirty_ = true;
+  return model;
+}
+
+void BatchedObjRenderer::SetMaterialProperty(float ambient, float diffuse,
+                                             float specular,
+                                             float specular_power) {
+  ambient_ = ambient;
+  diffuse_ = diffuse;
+  specular_ = specular;
+  specular_power_ = specular_power;
+}
+
+void BatchedObjRenderer::UploadGeometry() {
+  if (!geometry_dirty_) {
+    return;
+  }
+  geometry_dirty_ = false;
+
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
+  gl_state.BindVertexArray(vertex_array_);
+  const size_t vertex_bytes = vertices_.size() * sizeof(GLfloat);
+  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+  glBufferData(GL_ARRAY_BUFFER, vertex_bytes, vertices_.data(),
+               GL_STATIC_DRAW);
+
+  // Narrows the indices when the merged vertices allow it, halving the index
+  // buffer.
+  size_t index_bytes = 0;
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_);
+  if (vertices_.size() / kVertexComponents <= kMaxShortIndexedVertices) {
+    const std::vector<GLushort> short_indices(indices_.begin(),
+                                              indices_.end());
+    index_type_ = GL_UNSIGNED_SHORT;
+    index_bytes = short_indices.size() * sizeof(GLushort);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_bytes, short_indices.data(),
+                 GL_STATIC_DRAW);
+  } else {
+    index_type_ = GL_UNSIGNED_INT;
+    index_bytes = indices_.size() * sizeof(GLuint);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_bytes, indices_.data(),
+                 GL_STATIC_DRAW);
+  }
+  ResourceAccounting& accounting = ResourceAccounting::Get();
+  accounting.Track(GpuResourceType::kBuffer, vertex_buffer_, vertex_bytes,
+                   kOwner);
+  accounting.Track(GpuResourceType::kBuffer, index_buffer_, index_bytes,
+                   kOwner);
+
+  glEnableVertexAttribArray(position_attrib_);
+  glVertexAttribPointer(position_attrib_, kPositionComponents, GL_FLOAT,
+                        GL_FALSE, kVertexStride, nullptr);
+  glEnableVertexAttribArray(normal_attrib_);
+  glVertexAttribPointer(normal_attrib_, kNormalComponents, GL_FLOAT, GL_FALSE,
+                        kVertexStride,
+                        reinterpret_cast<const void*>(kNormalOffset));
+  glEnableVertexAttribArray(tex_coord_attrib_);
+  glVertexAttribPointer(tex_coord_attrib_, kUvComponents, GL_FLOAT, GL_FALSE,
+                        kVertexStride,
+                        reinterpret_cast<const void*>(kUvOffset));
+
+  // The instanced attributes advance once per drawn copy; their pointers
+  // are set for every draw by SetInstanceAttributes().
+  for (int column = 0; column < kMatrixColumns; ++column) {
+    glEnableVertexAttribArray(model_mat_attrib_ + column);
+    glVertexAttribDivisor(model_mat_attrib_ + column, 1);
+  }
+  glEnableVertexAttribArray(color_attrib_);
+  glVertexAttribDivisor(color_attrib_, 1);
+  glEnableVertexAttribArray(layer_attrib_);
+  glVertexAttribDivisor(layer_attrib_, 1);
+
+  gl_state.BindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void BatchedObjRenderer::SetInstanceAttributes(size_t first_instance) const {
+  constexpr GLsizei kInstanceStride = sizeof(GpuInstance);
+  const size_t base = first_instance * sizeof(GpuInstance);
+  for (int column = 0; column < kMatrixColumns; ++column) {
+    glVertexAttribPointer(
+        model_mat_attrib_ + column, 4, GL_FLOAT, GL_FALSE, kInstanceStride,
+        reinterpret_cast<const void*>(base +
+                                      offsetof(GpuInstance, model_mat) +
+                                      column * sizeof(glm::vec4)));
+  }
+  glVertexAttribPointer(
+      color_attrib_, 4, GL_FLOAT, GL_FALSE, kInstanceStride,
+      reinterpret_cast<const void*>(base + offsetof(GpuInstance, color)));
+  glVertexAttribPointer(
+      layer_attrib_, 1, GL_FLOAT, GL_FALSE, kInstanceStride,
+      reinterpret_cast<const void*>(base + offsetof(GpuInstance, layer)));
+}
+
+void BatchedObjRenderer::Draw(const glm::mat4& projection_mat,
+                              const glm::mat4& view_mat,
+                              const Instance* instances,
+                              size_t instance_count,
+                              const float* color_correction4) {
+  draw_call_count_ = 0;
+  if (!shader_program_ || instance_count == 0 || models_.empty() ||
+      !atlas_.Pack()) {
+    return;
+  }
+  UploadGeometry();
+
+  // Counting sort of the instances into one bucket per (array, model) pair,
+  // so that each bucket is a contiguous run of the instance buffer.
+  const int model_count = static_cast<int>(models_.size());
+  const size_t bucket_count =
+      static_cast<size_t>(atlas_.GetArrayCount()) * model_count;
+  auto get_bucket = [&](const Instance& instance) -> int {
+    if (instance.model < 0 || instance.model >= model_count) {
+      return -1;
+    }
+    const MaterialAtlas::Location& location =
+        atlas_.GetLocation(models_[instance.model].material);
+    return location.array < 0 ? -1
+                              : location.array * model_count + instance.model;
+  };
+  bucket_offsets_.assign(bucket_count + 1, 0);
+  for (size_t i = 0; i < instance_count; ++i) {
+    const int bucket = get_bucket(instances[i]);
+    if (bucket >= 0) {
+      ++bucket_offsets_[bucket + 1];
+    }
+  }
+  for (size_t bucket = 0; bucket < bucket_count; ++bucket) {
+    bucket_offsets_[bucket + 1] += bucket_offsets_[bucket];
+  }
+  sorted_instances_.resize(bucket_offsets_[bucket_count]);
+  if (sorted_instances_.empty()) {
+    return;
+  }
+  // Advances every bucket's start to its end, which is where the next
+  // bucket starts.
+  for (size_t i = 0; i < instance_count; ++i) {
+    const int bucket = get_bucket(instances[i]);
+    if (bucket < 0) {
+      continue;
+    }
+    GpuInstance& gpu_instance = sorted_instances_[bucket_offsets_[bucket]++];
+    gpu_instance.model_mat = instances[i].model_mat;
+    gpu_instance.color = instances[i].color;
+    gpu_instance.layer = static_cast<float>(
+        atlas_.GetLocation(models_[instances[i].model].material).layer);
+  }
+
+  // Orphans the previous instance data so the upload does not wait for
+  // draws still in flight.
+  const size_t instance_bytes = sorted_instances_.size() * sizeof(GpuInstance);
+  glBindBuffer(GL_ARRAY_BUFFER, instance_buffer_);
+  glBufferData(GL_ARRAY_BUFFER, instance_bytes, sorted_instances_.data(),
+               GL_STREAM_DRAW);
+  ResourceAccounting::Get().Track(GpuResourceType::kBuffer, instance_buffer_,
+                                  instance_bytes, kOwner);
+
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
+  gl_state.UseProgram(shader_program_);
+  glUniformMatrix4fv(view_mat_uniform_, 1, GL_FALSE, glm::value_ptr(view_mat));
+  glUniformMatrix4fv(projection_mat_uniform_, 1, GL_FALSE,
+                     glm::value_ptr(projection_mat));
+  glUniform4fv(light_direction_uniform_, 1, glm::value_ptr(kLightDirection));
+  glUniform4f(material_param_uniform_, ambient_, diffuse_, specular_,
+              specular_power_);
+  glUniform4fv(color_correction_param_uniform_, 1, color_correction4);
+  gl_state.ActiveTexture(GL_TEXTURE0);
+  glUniform1i(textures_uniform_, 0);
+
+  gl_state.DepthMask(GL_TRUE);
+  gl_state.SetCapability(GL_BLEND, true);
+  // Same premultiplied alpha as the textures of ObjRenderer.
+  gl_state.BlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+  gl_state.BindVertexArray(vertex_array_);
+
+  const size_t index_size =
+      index_type_ == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+  for (int array = 0; array < atlas_.GetArrayCount(); ++array) {
+    bool array_bound = false;
+    for (int model = 0; model < model_count; ++model) {
+      const size_t bucket = static_cast<size_t>(array) * model_count + model;
+      const size_t first = bucket == 0 ? 0 : bucket_offsets_[bucket - 1];
+      const size_t count = bucket_offsets_[bucket] - first;
+      if (count == 0) {
+        continue;
+      }
+      if (!array_bound) {
+        glBindTexture(GL_TEXTURE_2D_ARRAY, atlas_.GetArrayTexture(array));
+        array_bound = true;
+      }
+      SetInstanceAttributes(first);
+      glDrawElementsInstanced(
+          GL_TRIANGLES, models_[model].index_count, index_type_,
+          reinterpret_cast<const void*>(models_[model].first_index *
+                                        index_size),
+          static_cast<GLsizei>(count));
+      ++draw_call_count_;
+    }
+  }
+
+  // Other renderers draw from client-side arrays, which requires the default
+  // vertex array object.
+  gl_state.BindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+  util::CheckGlError("BatchedObjRenderer::Draw()");
+}
+
+}  // namespace hello_ar
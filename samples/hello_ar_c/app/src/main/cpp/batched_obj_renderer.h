@@ -0,0 +1,172 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_BATCHED_OBJ_RENDERER_H_
+#define C_ARCORE_HELLOE_AR_BATCHED_OBJ_RENDERER_H_
+
+// clang-format off
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+// clang-format on
+#include <android/asset_manager.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "glm.h"
+#include "material_atlas.h"
+
+namespace hello_ar {
+
+// Draws copies of many different models, each with its own albedo texture,
+// from one merged vertex and index buffer and the array textures of a
+// MaterialAtlas.  A mixed scene then takes one draw call per model and array
+// texture in use, instead of a program, texture and buffer switch for every
+// model as with one ObjRenderer each.
+//
+// The meshes of all models are rebased into the shared buffers, and each
+// model is drawn as a range of the index buffer.  OpenGL ES 3.0 has neither
+// base vertex nor multi-draw calls, so the ranges take one
+// glDrawElementsInstanced each, with only the instance attributes moved
+// between them.
+//
+// Only the full resolution mesh of a model is used, and objects are lit like
+// by ObjRenderer with the directional light and color correction, without
+// depth occlusion or Environmental HDR.
+class BatchedObjRenderer {
+ public:
+  // One copy of a model.
+  struct Instance {
+    // Id returned by AddModel().
+    int model = 0;
+    glm::mat4 model_mat;
+    // Same as ObjRenderer::Instance::color.
+    glm::vec4 color;
+  };
+
+  BatchedObjRenderer() = default;
+  ~BatchedObjRenderer() = default;
+
+  // Builds the program and forgets the models of a previous context.  Must be
+  // called on the OpenGL thread prior to any other calls.
+  void InitializeGlContent(AAssetManager* asset_manager);
+
+  // Loads the mesh at |mesh_file_name|, a packed ".mesh" or an OBJ file like
+  // for ObjRenderer, and adds the albedo PNG at |png_file_name| to the
+  // atlas.  Returns the id of the model, or -1 if the mesh could not be
+  // loaded.  Models can only be added until the atlas is packed by the first
+  // Draw() whose textures are all ready.
+  int AddModel(AAssetManager* asset_manager, const std::string& mesh_file_name,
+               const std::string& png_file_name);
+
+  // See ObjRenderer::SetMaterialProperty(), shared by all models.
+  void SetMaterialProperty(float ambient, float diffuse, float specular,
+                           float specular_power);
+
+  // Draws every entry of |instances|, grouped by array texture and model.
+  // Nothing is drawn until the textures of all models are loaded, and copies
+  // of models whose texture got no layer are skipped.
+  void Draw(const glm::mat4& projection_mat, const glm::mat4& view_mat,
+            const Instance* instances, size_t instance_count,
+            const float* color_correction4);
+
+  int GetModelCount() const { return static_cast<int>(models_.size()); }
+
+  // Number of draw calls the last Draw() issued.
+  int GetDrawCallCount() const { return draw_call_count_; }
+
+  // Model-space bounding sphere of |model| as center (xyz) and radius (w).
+  const glm::vec4& GetBoundingSphere(int model) const {
+    return models_[model].bounding_sphere;
+  }
+
+ private:
+  // Range of the merged index buffer holding one model, with its indices
+  // already offset to the model's vertices.
+  struct Model {
+    GLuint first_index = 0;
+    GLsizei index_count = 0;
+    int material = -1;
+    glm::vec4 bounding_sphere = glm::vec4(0.0f);
+  };
+
+  // Per-instance attributes as streamed to the instance buffer, which
+  // a_ModelMatrix, a_ObjColor and a_Layer of ar_object_batched.vert read.
+  struct GpuInstance {
+    glm::mat4 model_mat;
+    glm::vec4 color;
+    float layer;
+  };
+
+  // Appends the interleaved |vertices| and the |indices| of one mesh to the
+  // merged geometry and returns the index range they landed in.
+  template <typename Index>
+  Model AppendMesh(const float* vertices, size_t vertex_count,
+                   const Index* indices, size_t index_count);
+
+  // Uploads the merged geometry if models were added since the last upload,
+  // and records the vertex array.
+  void UploadGeometry();
+
+  // Points the instanced attributes at the GpuInstance |first_instance| of
+  // instance_buffer_, which GLES 3.0 cannot offset in the draw call.
+  void SetInstanceAttributes(size_t first_instance) const;
+
+  MaterialAtlas atlas_;
+  std::vector<Model> models_;
+
+  // CPU copies of the merged geometry, kept so that models can be added
+  // after the first upload.
+  std::vector<float> vertices_;
+  std::vector<uint32_t> indices_;
+  bool geometry_dirty_ = false;
+  GLenum index_type_ = GL_UNSIGNED_SHORT;
+
+  GLuint vertex_array_ = 0;
+  GLuint vertex_buffer_ = 0;
+  GLuint index_buffer_ = 0;
+  GLuint instance_buffer_ = 0;
+
+  // Reused by Draw(): the instances sorted by array texture and model, and
+  // the number of them per (array, model) pair.
+  std::vector<GpuInstance> sorted_instances_;
+  std::vector<size_t> bucket_offsets_;
+  int draw_call_count_ = 0;
+
+  float ambient_ = 0.0f;
+  float diffuse_ = 2.0f;
+  float specular_ = 0.5f;
+  float specular_power_ = 6.0f;
+
+  GLuint shader_program_ = 0;
+  GLint position_attrib_ = -1;
+  GLint normal_attrib_ = -1;
+  GLint tex_coord_attrib_ = -1;
+  GLint model_mat_attrib_ = -1;
+  GLint color_attrib_ = -1;
+  GLint layer_attrib_ = -1;
+  GLint view_mat_uniform_ = -1;
+  GLint projection_mat_uniform_ = -1;
+  GLint textures_uniform_ = -1;
+  GLint light_direction_uniform_ = -1;
+  GLint material_param_uniform_ = -1;
+  GLint color_correction_param_uniform_ = -1;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_BATCHED_OBJ_RENDERER_H_
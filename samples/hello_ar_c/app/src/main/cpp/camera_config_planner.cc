@@ -0,0 +1,262 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "camera_config_planner.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include "util.h"
+
+namespace hello_ar {
+
+constexpr float CameraConfigPlanner::kFrameBudgetFraction;
+constexpr float CameraConfigPlanner::kDefaultGpuNsPerPixel;
+
+namespace {
+constexpr uint32_t kProfileMagic = 0x50434343;  // "CCCP"
+// Bumped when the benchmark changes, which makes older profiles stale.
+constexpr uint32_t kProfileVersion = 1;
+
+struct ProfileFile {
+  uint32_t magic;
+  uint32_t version;
+  CameraConfigPlanner::Profile profile;
+};
+
+// The benchmark runs a 2x2 box filter over a luminance plane of this size,
+// about what reading a CPU image for a vision pass costs, and takes the
+// median of its timed runs after one warm-up run.
+constexpr int kBenchmarkWidth = 640;
+constexpr int kBenchmarkHeight = 480;
+constexpr int kBenchmarkRuns = 15;
+
+float BenchmarkCpuNsPerPixel() {
+  std::vector<uint8_t> image(kBenchmarkWidth * kBenchmarkHeight);
+  for (size_t i = 0; i < image.size(); ++i) {
+    image[i] = static_cast<uint8_t>(i * 31);
+  }
+  std::vector<uint8_t> half(image.size() / 4);
+  std::vector<float> samples_ns;
+  samples_ns.reserve(kBenchmarkRuns);
+  uint32_t checksum = 0;
+  for (int run = 0; run <= kBenchmarkRuns; ++run) {
+    const auto start = std::chrono::steady_clock::now();
+    for (int y = 0; y < kBenchmarkHeight / 2; ++y) {
+      const uint8_t* row = &image[2 * y * kBenchmarkWidth];
+      const uint8_t* next_row = row + kBenchmarkWidth;
+      uint8_t* out = &half[y * kBenchmarkWidth / 2];
+      for (int x = 0; x < kBenchmarkWidth / 2; ++x) {
+        out[x] = static_cast<uint8_t>((row[2 * x] + row[2 * x + 1] +
+                                       next_row[2 * x] + next_row[2 * x + 1] +
+                                       2) /
+                                      4);
+      }
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    // Keeps the filter from being optimized away.
+    checksum += half[run % half.size()];
+    if (run > 0) {
+      samples_ns.push_back(
+          std::chrono::duration<float, std::nano>(elapsed).count() /
+          image.size());
+    }
+  }
+  std::nth_element(samples_ns.begin(),
+                   samples_ns.begin() + samples_ns.size() / 2,
+                   samples_ns.end());
+  LOGI("CameraConfigPlanner: benchmark checksum %u", checksum);
+  return samples_ns[samples_ns.size() / 2];
+}
+}  // namespace
+
+void CameraConfigPlanner::Load(const std::string& path) {
+  path_ = path;
+  ProfileFile file_content = {};
+  FILE* file = fopen(path.c_str(), "rb");
+  if (file != nullptr) {
+    const bool read_ok =
+        fread(&file_content, sizeof(file_content), 1, file) == 1;
+    fclose(file);
+    if (read_ok && file_content.magic == kProfileMagic &&
+        file_content.version == kProfileVersion &&
+        file_content.profile.cpu_ns_per_pixel > 0.f) {
+      profile_ = file_content.profile;
+      return;
+    }
+  }
+  profile_ = Profile();
+  profile_.cpu_ns_per_pixel = BenchmarkCpuNsPerPixel();
+  LOGI("CameraConfigPlanner: measured %.3f ns per CPU image pixel",
+       profile_.cpu_ns_per_pixel);
+  Save();
+}
+
+void CameraConfigPlanner::Save() const {
+  if (path_.empty()) {
+    return;
+  }
+  ProfileFile file_content = {kProfileMagic, kProfileVersion, profile_};
+  // Written next to the profile first, so a crash never leaves a truncated
+  // one behind.
+  const std::string temp_path = path_ + ".tmp";
+  FILE* file = fopen(temp_path.c_str(), "wb");
+  if (file == nullptr) {
+    LOGE("CameraConfigPlanner: cannot write %s", temp_path.c_str());
+    return;
+  }
+  bool write_ok = fwrite(&file_content, sizeof(file_content), 1, file) == 1;
+  write_ok = (fclose(file) == 0) && write_ok;
+  if (!write_ok || rename(temp_path.c_str(), path_.c_str()) != 0) {
+    unlink(temp_path.c_str());
+  }
+}
+
+float CameraConfigPlanner::EstimateCostMs(const Candidate& candidate) const {
+  const float gpu_ns_per_pixel = profile_.gpu_sample_count > 0
+                                     ? profile_.gpu_ns_per_pixel
+                                     : kDefaultGpuNsPerPixel;
+  const float cpu_pixels =
+      static_cast<float>(candidate.image_width) * candidate.image_height;
+  const float gpu_pixels =
+      static_cast<float>(candidate.texture_width) * candidate.texture_height;
+  return (profile_.cpu_ns_per_pixel * cpu_pixels +
+          gpu_ns_per_pixel * gpu_pixels) *
+         1e-6f;
+}
+
+bool CameraConfigPlanner::IsBetter(const Candidate& a, const Candidate& b,
+                                   const Options& options) const {
+  const auto fits = [](const Candidate& candidate) {
+    return candidate.cost_ms <=
+           1000.f / std::max(candidate.max_fps, 1) * kFrameBudgetFraction;
+  };
+  const bool a_fits = fits(a);
+  if (a_fits != fits(b)) {
+    return a_fits;
+  }
+  if (!a_fits) {
+    return a.cost_ms * a.max_fps < b.cost_ms * b.max_fps;
+  }
+  const auto useful_pixels = [&options](const Candidate& candidate) {
+    const int64_t pixels =
+        static_cast<int64_t>(candidate.texture_width) * candidate.texture_height;
+    return std::min(pixels, options.max_useful_texture_pixels);
+  };
+  if (useful_pixels(a) != useful_pixels(b)) {
+    return useful_pixels(a) > useful_pixels(b);
+  }
+  if (a.max_fps != b.max_fps) {
+    return a.max_fps > b.max_fps;
+  }
+  return a.cost_ms < b.cost_ms;
+}
+
+bool CameraConfigPlanner::Apply(ArSession* session, const Options& options) {
+  has_chosen_ = false;
+  ArCameraConfigFilter* filter = nullptr;
+  ArCameraConfigFilter_create(session, &filter);
+  ArCameraConfigFilter_setFacingDirection(
+      session, filter, AR_CAMERA_CONFIG_FACING_DIRECTION_BACK);
+  ArCameraConfigFilter_setTargetFps(session, filter, options.target_fps);
+  ArCameraConfigFilter_setDepthSensorUsage(session, filter,
+                                           options.depth_sensor_usage);
+  ArCameraConfigFilter_setStereoCameraUsage(session, filter,
+                                            options.stereo_camera_usage);
+  ArCameraConfigList* configs = nullptr;
+  ArCameraConfigList_create(session, &configs);
+  ArSession_getSupportedCameraConfigsWithFilter(session, filter, configs);
+  ArCameraConfigFilter_destroy(filter);
+
+  int32_t num_configs = 0;
+  ArCameraConfigList_getSize(session, configs, &num_configs);
+  candidate_count_ = num_configs;
+  ArCameraConfig* config = nullptr;
+  ArCameraConfig_create(session, &config);
+  int32_t best_index = -1;
+  for (int32_t i = 0; i < num_configs; ++i) {
+    ArCameraConfigList_getItem(session, configs, i, config);
+    Candidate candidate;
+    ArCameraConfig_getImageDimensions(session, config, &candidate.image_width,
+                                      &candidate.image_height);
+    ArCameraConfig_getTextureDimensions(session, config,
+                                        &candidate.texture_width,
+                                        &candidate.texture_height);
+    int32_t min_fps = 0;
+    ArCameraConfig_getFpsRange(session, config, &min_fps, &candidate.max_fps);
+    candidate.cost_ms = EstimateCostMs(candidate);
+    if (best_index < 0 || IsBetter(candidate, chosen_, options)) {
+      chosen_ = candidate;
+      best_index = i;
+    }
+  }
+
+  bool applied = false;
+  if (best_index >= 0) {
+    ArCameraConfigList_getItem(session, configs, best_index, config);
+    applied = ArSession_setCameraConfig(session, config) == AR_SUCCESS;
+    if (!applied) {
+      LOGE("CameraConfigPlanner: ArSession_setCameraConfig error");
+    }
+  }
+  ArCameraConfig_destroy(config);
+  ArCameraConfigList_destroy(configs);
+  has_chosen_ = applied;
+  LOGI("CameraConfigPlanner: %s", GetReport().c_str());
+  return applied;
+}
+
+void CameraConfigPlanner::UpdateGpuCost(float background_gpu_ms) {
+  const float texture_pixels =
+      static_cast<float>(chosen_.texture_width) * chosen_.texture_height;
+  if (!has_chosen_ || background_gpu_ms <= 0.f || texture_pixels <= 0.f) {
+    return;
+  }
+  const float measured = background_gpu_ms * 1e6f / texture_pixels;
+  // Later sessions only nudge the cost, so one session at a throttled GPU
+  // clock does not flip the choice.
+  profile_.gpu_ns_per_pixel =
+      profile_.gpu_sample_count == 0
+          ? measured
+          : 0.75f * profile_.gpu_ns_per_pixel + 0.25f * measured;
+  ++profile_.gpu_sample_count;
+  Save();
+}
+
+std::string CameraConfigPlanner::GetReport() const {
+  char text[256];
+  if (!has_chosen_) {
+    snprintf(text, sizeof(text), "default config, %d candidates",
+             candidate_count_);
+    return text;
+  }
+  snprintf(text, sizeof(text),
+           "%dx%d texture, %dx%d CPU image, %d fps, %.2f ms per frame of %d "
+           "candidates; CPU %.3f ns/px, GPU %.3f ns/px (%u sessions)",
+           chosen_.texture_width, chosen_.texture_height, chosen_.image_width,
+           chosen_.image_height, chosen_.max_fps, chosen_.cost_ms,
+           candidate_count_, profile_.cpu_ns_per_pixel,
+           profile_.gpu_sample_count > 0 ? profile_.gpu_ns_per_pixel
+                                         : kDefaultGpuNsPerPixel,
+           profile_.gpu_sample_count);
+  return text;
+}
+
+}  // namespace hello_ar
@@ -0,0 +1,130 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_CAMERA_CONFIG_PLANNER_H_
+#define C_ARCORE_HELLOE_AR_CAMERA_CONFIG_PLANNER_H_
+
+#include <cstdint>
+#include <string>
+
+#include "arcore_c_api.h"
+
+namespace hello_ar {
+
+// Picks the camera config of a new session from what it costs on this
+// device, instead of taking ARCore's default.
+//
+// Apply() lists the back camera configs that pass the Options' filters and
+// estimates the per-frame cost of each as
+//
+//   cpu_ns_per_pixel * CPU image pixels + gpu_ns_per_pixel * texture pixels
+//
+// with the per-pixel costs of the device's Profile.  Of the configs whose
+// cost fits kFrameBudgetFraction of their frame time it takes the one with
+// the most texture pixels up to max_useful_texture_pixels, then the highest
+// frame rate, then the lowest cost.  If none fits, it takes the config with
+// the lowest cost per second.
+//
+// The Profile is kept in a small file.  Its CPU cost comes from a short
+// benchmark of a pass over a camera image that Load() runs when the file is
+// missing or stale; its GPU cost is the measured time of the background pass
+// divided by the texture pixels, which UpdateGpuCost() blends in after every
+// session.  Until the GPU cost has been measured once, kDefaultGpuNsPerPixel
+// stands in.
+//
+// Not thread safe; meant to be used on the thread that resumes the session.
+class CameraConfigPlanner {
+ public:
+  // The share of a frame the camera image may cost.
+  static constexpr float kFrameBudgetFraction = 0.2f;
+  static constexpr float kDefaultGpuNsPerPixel = 0.5f;
+
+  struct Options {
+    // Masks of ArCameraConfigTargetFps, ArCameraConfigDepthSensorUsage and
+    // ArCameraConfigStereoCameraUsage values for the filter.
+    uint32_t target_fps =
+        AR_CAMERA_CONFIG_TARGET_FPS_30 | AR_CAMERA_CONFIG_TARGET_FPS_60;
+    uint32_t depth_sensor_usage =
+        AR_CAMERA_CONFIG_DEPTH_SENSOR_USAGE_REQUIRE_AND_USE |
+        AR_CAMERA_CONFIG_DEPTH_SENSOR_USAGE_DO_NOT_USE;
+    uint32_t stereo_camera_usage =
+        AR_CAMERA_CONFIG_STEREO_CAMERA_USAGE_REQUIRE_AND_USE |
+        AR_CAMERA_CONFIG_STEREO_CAMERA_USAGE_DO_NOT_USE;
+    // Texture pixels beyond this buy nothing on screen.
+    int64_t max_useful_texture_pixels = 1920 * 1080;
+  };
+
+  // Per-pixel costs of a camera frame on this device, as stored.
+  struct Profile {
+    float cpu_ns_per_pixel = 0.f;
+    float gpu_ns_per_pixel = 0.f;
+    // Sessions UpdateGpuCost() measured, 0 until the first.
+    uint32_t gpu_sample_count = 0;
+  };
+
+  CameraConfigPlanner() = default;
+
+  CameraConfigPlanner(const CameraConfigPlanner&) = delete;
+  CameraConfigPlanner& operator=(const CameraConfigPlanner&) = delete;
+
+  // Reads the profile at |path|, or benchmarks the CPU cost and writes a new
+  // one there.
+  void Load(const std::string& path);
+
+  // Sets the best config for |options| on |session|, which must not have
+  // been resumed yet.  Returns false if no config passes the filter or
+  // ARCore rejects it, which leaves the default config.
+  bool Apply(ArSession* session, const Options& options);
+
+  // Blends the average time of the background pass during the session into
+  // the profile's GPU cost and persists it.  Skipped if the pass was not
+  // timed or Apply() set no config.
+  void UpdateGpuCost(float background_gpu_ms);
+
+  const Profile& GetProfile() const { return profile_; }
+
+  // The chosen config and its estimated cost, or why there is none.
+  std::string GetReport() const;
+
+ private:
+  struct Candidate {
+    int32_t image_width = 0;
+    int32_t image_height = 0;
+    int32_t texture_width = 0;
+    int32_t texture_height = 0;
+    int32_t max_fps = 0;
+    float cost_ms = 0.f;
+  };
+
+  // Cost of one frame of |candidate| with the current profile.
+  float EstimateCostMs(const Candidate& candidate) const;
+
+  // Whether |a| is a better pick than |b|, see the class comment.
+  bool IsBetter(const Candidate& a, const Candidate& b,
+                const Options& options) const;
+
+  void Save() const;
+
+  std::string path_;
+  Profile profile_;
+  Candidate chosen_;
+  bool has_chosen_ = false;
+  int candidate_count_ = 0;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_CAMERA_CONFIG_PLANNER_H_
@@ -0,0 +1,71 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "camera_pose_predictor.h"
+
+#include <algorithm>
+
+namespace hello_ar {
+
+constexpr int64_t CameraPosePredictor::kMaxPredictionNs;
+constexpr int64_t CameraPosePredictor::kMaxFrameIntervalNs;
+
+void CameraPosePredictor::AddPose(int64_t timestamp_ns,
+                                  const glm::quat& rotation,
+                                  const glm::vec3& position) {
+  if (pose_count_ > 0 && timestamp_ns <= poses_[1].timestamp_ns) {
+    return;
+  }
+  poses_[0] = poses_[1];
+  poses_[1].timestamp_ns = timestamp_ns;
+  poses_[1].rotation = rotation;
+  poses_[1].position = position;
+  pose_count_ = std::min(pose_count_ + 1, 2);
+}
+
+bool CameraPosePredictor::Predict(int64_t target_ns, glm::quat* rotation,
+                                  glm::vec3* translation) const {
+  if (pose_count_ < 2) {
+    return false;
+  }
+  const Pose& previous = poses_[0];
+  const Pose& last = poses_[1];
+  const int64_t frame_interval_ns = last.timestamp_ns - previous.timestamp_ns;
+  const int64_t prediction_ns = target_ns - last.timestamp_ns;
+  if (frame_interval_ns > kMaxFrameIntervalNs || prediction_ns < 0 ||
+      prediction_ns > kMaxPredictionNs) {
+    return false;
+  }
+  const float fraction =
+      static_cast<float>(prediction_ns) / static_cast<float>(frame_interval_ns);
+
+  // The turn from the previous to the last pose, in the previous pose's
+  // frame, which the same turn at the same rate continues.
+  glm::quat turn = glm::inverse(previous.rotation) * last.rotation;
+  // The shorter way round.
+  if (turn.w < 0.f) {
+    turn = -turn;
+  }
+  const float angle = glm::angle(turn);
+  *rotation = angle > 0.f
+                  ? glm::angleAxis(angle * fraction, glm::axis(turn))
+                  : glm::quat(1.f, 0.f, 0.f, 0.f);
+  *translation = glm::inverse(last.rotation) *
+                 ((last.position - previous.position) * fraction);
+  return true;
+}
+
+}  // namespace hello_ar
@@ -0,0 +1,72 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_CAMERA_POSE_PREDICTOR_H_
+#define C_ARCORE_HELLOE_AR_CAMERA_POSE_PREDICTOR_H_
+
+#include <cstdint>
+
+#include "glm.h"
+
+namespace hello_ar {
+
+// Extrapolates the camera pose between camera frames, so content can be
+// drawn at display rate with a camera that moves at camera rate.
+//
+// AddPose() takes the pose of each new camera frame.  Predict() continues
+// the motion between the last two at constant angular and linear velocity
+// and returns the predicted pose relative to the last one, in that pose's
+// frame.  Nothing is predicted past kMaxPredictionNs after the last frame,
+// e.g. while tracking stutters, or from frames further apart than
+// kMaxFrameIntervalNs.
+//
+// Not thread safe.
+class CameraPosePredictor {
+ public:
+  static constexpr int64_t kMaxPredictionNs = 70000000;
+  static constexpr int64_t kMaxFrameIntervalNs = 100000000;
+
+  CameraPosePredictor() = default;
+
+  // Adds the world space pose of the camera frame at |timestamp_ns|.  Frames
+  // already added are ignored.
+  void AddPose(int64_t timestamp_ns, const glm::quat& rotation,
+               const glm::vec3& position);
+
+  // Forgets the poses, e.g. when tracking is lost.
+  void Reset() { pose_count_ = 0; }
+
+  // The camera's motion from the last pose to |target_ns|: it turns by
+  // |*rotation| and moves by |*translation|, both in the last pose's frame.
+  // Returns false if there is nothing to extrapolate from.
+  bool Predict(int64_t target_ns, glm::quat* rotation,
+               glm::vec3* translation) const;
+
+ private:
+  struct Pose {
+    int64_t timestamp_ns = 0;
+    glm::quat rotation = glm::quat(1.f, 0.f, 0.f, 0.f);
+    glm::vec3 position = glm::vec3(0.f);
+  };
+
+  // The previous and the last pose.
+  Pose poses_[2];
+  int pose_count_ = 0;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_CAMERA_POSE_PREDICTOR_H_
@@ -0,0 +1,180 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "camera_texture_benchmark.h"
+
+#include <GLES3/gl3.h>
+#include <android/api-level.h>
+#include <sys/system_properties.h>
+
+#include <numeric>
+
+#include "util.h"
+
+namespace hello_ar {
+namespace {
+float ToMilliseconds(std::chrono::nanoseconds duration) {
+  return std::chrono::duration<float, std::milli>(duration).count();
+}
+
+float Mean(const std::vector<float>& values) {
+  return std::accumulate(values.begin(), values.end(), 0.f) / values.size();
+}
+
+std::string GetSystemProperty(const char* name) {
+  char value[PROP_VALUE_MAX] = {};
+  __system_property_get(name, value);
+  return value;
+}
+
+// Writes "<name> mean <m> p50 <p> p95 <p> ms", or that there were no samples.
+void WriteDistribution(FILE* file, const char* name,
+                       std::vector<float>* values) {
+  if (values->empty()) {
+    fprintf(file, "  %-18s n/a\n", name);
+    return;
+  }
+  const float mean = Mean(*values);
+  const float p50 = util::Percentile(values, 50);
+  const float p95 = util::Percentile(values, 95);
+  fprintf(file, "  %-18s mean %7.3f  p50 %7.3f  p95 %7.3f ms\n", name, mean,
+          p50, p95);
+}
+}  // namespace
+
+constexpr int CameraTextureBenchmark::kSegmentFrames;
+constexpr int CameraTextureBenchmark::kWarmupFrames;
+constexpr int CameraTextureBenchmark::kLiveSegmentsPerMode;
+
+const char* GetCameraTextureModeName(CameraTextureMode mode) {
+  switch (mode) {
+    case CameraTextureMode::kTextureName:
+      return "texture_name";
+    case CameraTextureMode::kHardwareBuffer:
+      return "hardware_buffer";
+    case CameraTextureMode::kCount:
+      break;
+  }
+  return "unknown";
+}
+
+CameraTextureBenchmark::~CameraTextureBenchmark() {
+  if (file_ != nullptr) {
+    fclose(file_);
+  }
+}
+
+bool CameraTextureBenchmark::Start(const std::string& report_path,
+                                   bool hardware_buffer_supported) {
+  if (file_ != nullptr) {
+    fclose(file_);
+  }
+  file_ = fopen(report_path.c_str(), "w");
+  if (file_ == nullptr) {
+    LOGE("CameraTextureBenchmark: cannot open %s", report_path.c_str());
+    return false;
+  }
+  num_modes_ = hardware_buffer_supported ? kNumCameraTextureModes : 1;
+  mode_index_ = 0;
+  segment_frame_ = 0;
+  for (ModeSamples& samples : samples_) {
+    samples = ModeSamples();
+  }
+  return true;
+}
+
+bool CameraTextureBenchmark::RecordFrame(const FrameSample& sample,
+                                         bool is_live) {
+  if (file_ == nullptr) {
+    return false;
+  }
+  if (segment_frame_ >= kWarmupFrames && sample.mode == GetMode()) {
+    ModeSamples& samples = samples_[mode_index_];
+    samples.update_cpu_ms.push_back(ToMilliseconds(sample.update_cpu));
+    samples.background_cpu_ms.push_back(ToMilliseconds(sample.background_cpu));
+    if (sample.background_gpu_ms >= 0.f) {
+      samples.background_gpu_ms.push_back(sample.background_gpu_ms);
+    }
+    samples.frame_ms.push_back(ToMilliseconds(sample.frame_time));
+    if (sample.camera_latency_ms >= 0.f) {
+      samples.camera_latency_ms.push_back(sample.camera_latency_ms);
+    }
+  }
+  if (++segment_frame_ < kSegmentFrames) {
+    return false;
+  }
+  segment_frame_ = 0;
+  ++samples_[mode_index_].segments;
+  mode_index_ = (mode_index_ + 1) % num_modes_;
+  return is_live && mode_index_ == 0 &&
+         samples_[0].segments >= kLiveSegmentsPerMode;
+}
+
+void CameraTextureBenchmark::Finish() {
+  if (file_ == nullptr) {
+    return;
+  }
+  const GLubyte* renderer = glGetString(GL_RENDERER);
+  fprintf(file_, "Camera texture mode benchmark\n");
+  fprintf(file_, "device: %s %s (%s), Android API %d\n",
+          GetSystemProperty("ro.product.manufacturer").c_str(),
+          GetSystemProperty("ro.product.model").c_str(),
+          GetSystemProperty("ro.board.platform").c_str(),
+          android_get_device_api_level());
+  fprintf(file_, "gl renderer: %s\n",
+          renderer != nullptr ? reinterpret_cast<const char*>(renderer)
+                              : "unknown");
+  fprintf(file_, "segments of %d frames, first %d of each not counted\n",
+          kSegmentFrames, kWarmupFrames);
+
+  int fastest = -1;
+  float fastest_mean_ms = 0.f;
+  for (int i = 0; i < kNumCameraTextureModes; ++i) {
+    const CameraTextureMode mode = static_cast<CameraTextureMode>(i);
+    ModeSamples& samples = samples_[i];
+    fprintf(file_, "\n%s: ", GetCameraTextureModeName(mode));
+    if (i >= num_modes_) {
+      fprintf(file_, "not supported\n");
+      continue;
+    }
+    fprintf(file_, "%zu frames in %d segments\n", samples.frame_ms.size(),
+            samples.segments);
+    if (!samples.frame_ms.empty()) {
+      const float mean_ms = Mean(samples.frame_ms);
+      if (fastest < 0 || mean_ms < fastest_mean_ms) {
+        fastest = i;
+        fastest_mean_ms = mean_ms;
+      }
+    }
+    WriteDistribution(file_, "update cpu", &samples.update_cpu_ms);
+    WriteDistribution(file_, "background cpu", &samples.background_cpu_ms);
+    WriteDistribution(file_, "background gpu", &samples.background_gpu_ms);
+    WriteDistribution(file_, "frame", &samples.frame_ms);
+    WriteDistribution(file_, "camera latency", &samples.camera_latency_ms);
+  }
+  if (fastest >= 0) {
+    fprintf(file_, "\nfastest: %s, mean frame %.3f ms\n",
+            GetCameraTextureModeName(static_cast<CameraTextureMode>(fastest)),
+            fastest_mean_ms);
+    LOGI("CameraTextureBenchmark: %s is fastest at a mean frame of %.3f ms",
+         GetCameraTextureModeName(static_cast<CameraTextureMode>(fastest)),
+         fastest_mean_ms);
+  }
+  fclose(file_);
+  file_ = nullptr;
+}
+
+}  // namespace hello_ar
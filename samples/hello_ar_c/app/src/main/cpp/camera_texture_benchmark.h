@@ -0,0 +1,127 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_CAMERA_TEXTURE_BENCHMARK_H_
+#define C_ARCORE_HELLOE_AR_CAMERA_TEXTURE_BENCHMARK_H_
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace hello_ar {
+
+// How ARCore hands the camera image to the renderer.
+enum class CameraTextureMode {
+  // ArSession_update() writes the image into the GL_TEXTURE_EXTERNAL_OES
+  // texture set with ArSession_setCameraTextureName().
+  kTextureName = 0,
+  // AR_TEXTURE_UPDATE_MODE_EXPOSE_HARDWARE_BUFFER: the frame's
+  // AHardwareBuffer is bound to the same texture through an EGLImage.
+  kHardwareBuffer,
+  kCount
+};
+
+constexpr int kNumCameraTextureModes =
+    static_cast<int>(CameraTextureMode::kCount);
+
+const char* GetCameraTextureModeName(CameraTextureMode mode);
+
+// Compares the camera texture modes on the device it runs on.
+//
+// The run alternates the modes in segments of kSegmentFrames frames, so
+// every mode sees the same parts of a played back dataset and the same
+// thermal state.  The first kWarmupFrames of a segment, while ARCore
+// reconfigures the camera and the EGLImage cache fills, are not counted.
+// Each counted frame adds the CPU time of the session update and of the
+// background pass, the GPU time of the background pass, the frame time up
+// to the GPU finishing the frame and, with a live camera, the latency from
+// the camera timestamp to then.  Finish() writes a report of the device and
+// the distributions of every mode, ending with the mode of the lowest mean
+// frame time.
+//
+// Start() must be called before the first frame; the other methods on the
+// OpenGL thread.
+class CameraTextureBenchmark {
+ public:
+  static constexpr int kSegmentFrames = 120;
+  static constexpr int kWarmupFrames = 20;
+  // Segments of every mode a live run takes.  A played back run lasts until
+  // the end of the dataset.
+  static constexpr int kLiveSegmentsPerMode = 4;
+
+  struct FrameSample {
+    // Mode the frame was drawn with.
+    CameraTextureMode mode = CameraTextureMode::kTextureName;
+    std::chrono::nanoseconds update_cpu = std::chrono::nanoseconds::zero();
+    std::chrono::nanoseconds background_cpu = std::chrono::nanoseconds::zero();
+    // Negative while no GPU timer result is available.
+    float background_gpu_ms = -1.f;
+    std::chrono::nanoseconds frame_time = std::chrono::nanoseconds::zero();
+    // Negative without a live camera.
+    float camera_latency_ms = -1.f;
+  };
+
+  CameraTextureBenchmark() = default;
+  // Closes the report of an unfinished run without the results.
+  ~CameraTextureBenchmark();
+
+  CameraTextureBenchmark(const CameraTextureBenchmark&) = delete;
+  CameraTextureBenchmark& operator=(const CameraTextureBenchmark&) = delete;
+
+  // Starts a run that writes its report to |report_path|.  Without
+  // |hardware_buffer_supported| only kTextureName is measured.  Returns
+  // false if the report cannot be written.
+  bool Start(const std::string& report_path, bool hardware_buffer_supported);
+
+  bool IsRunning() const { return file_ != nullptr; }
+
+  // The mode the next frame has to be drawn with.
+  CameraTextureMode GetMode() const {
+    return static_cast<CameraTextureMode>(mode_index_);
+  }
+
+  // Adds a frame.  Frames drawn with another mode than GetMode(), e.g.
+  // before the session picked up a switch, only advance the segment.
+  // Returns true once a live run measured all its segments.
+  bool RecordFrame(const FrameSample& sample, bool is_live);
+
+  // Writes the report and ends the run.  Reads the GL renderer, so it must
+  // be called with the context current.
+  void Finish();
+
+ private:
+  struct ModeSamples {
+    std::vector<float> update_cpu_ms;
+    std::vector<float> background_cpu_ms;
+    std::vector<float> background_gpu_ms;
+    std::vector<float> frame_ms;
+    std::vector<float> camera_latency_ms;
+    int segments = 0;
+  };
+
+  FILE* file_ = nullptr;
+  int num_modes_ = kNumCameraTextureModes;
+  int mode_index_ = 0;
+  int segment_frame_ = 0;
+  std::array<ModeSamples, kNumCameraTextureModes> samples_;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_CAMERA_TEXTURE_BENCHMARK_H_
@@ -0,0 +1,474 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cloud_anchor_pipeline.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "util.h"
+
+namespace hello_ar {
+namespace {
+// A new reference to |anchor|.  The C API only hands out references through
+// the acquire calls, and the anchors of a session list are the same objects
+// as the ones acquired elsewhere, so it is acquired again from there.
+ArAnchor* AcquireAnchorReference(const ArSession* session,
+                                 const ArAnchor* anchor) {
+  ArAnchorList* anchor_list = nullptr;
+  ArAnchorList_create(session, &anchor_list);
+  ArSession_getAllAnchors(session, anchor_list);
+  int32_t size = 0;
+  ArAnchorList_getSize(session, anchor_list, &size);
+  ArAnchor* reference = nullptr;
+  for (int32_t i = 0; i < size && reference == nullptr; ++i) {
+    ArAnchor* item = nullptr;
+    ArAnchorList_acquireItem(session, anchor_list, i, &item);
+    if (item == anchor) {
+      reference = item;
+    } else {
+      ArAnchor_release(item);
+    }
+  }
+  ArAnchorList_destroy(anchor_list);
+  return reference;
+}
+}  // namespace
+
+constexpr int CloudAnchorPipeline::kQualitySampleInterval;
+constexpr std::chrono::seconds CloudAnchorPipeline::kQualityTimeout;
+constexpr int CloudAnchorPipeline::kNumBuckets;
+constexpr std::array<int64_t, CloudAnchorPipeline::kNumBuckets - 1>
+    CloudAnchorPipeline::kBucketLimitsMs;
+
+void CloudAnchorPipeline::LatencyHistogram::Add(
+    std::chrono::steady_clock::duration latency) {
+  const int64_t latency_ms =
+      std::chrono::duration_cast<std::chrono::milliseconds>(latency).count();
+  int bucket = 0;
+  while (bucket < kNumBuckets - 1 && latency_ms >= kBucketLimitsMs[bucket]) {
+    ++bucket;
+  }
+  ++counts[bucket];
+  ++num_samples;
+  sum_ms += latency_ms;
+}
+
+std::string CloudAnchorPipeline::LatencyHistogram::ToString() const {
+  if (num_samples == 0) {
+    return "none";
+  }
+  char text[32];
+  snprintf(text, sizeof(text), "mean %lld ms [",
+           static_cast<long long>(sum_ms / num_samples));
+  std::string result = text;
+  for (int bucket = 0; bucket < kNumBuckets; ++bucket) {
+    if (bucket < kNumBuckets - 1) {
+      snprintf(text, sizeof(text), "<%lld:%d ",
+               static_cast<long long>(kBucketLimitsMs[bucket]),
+               counts[bucket]);
+    } else {
+      snprintf(text, sizeof(text), ">=%lld:%d]",
+               static_cast<long long>(kBucketLimitsMs[bucket - 1]),
+               counts[bucket]);
+    }
+    result += text;
+  }
+  return result;
+}
+
+CloudAnchorPipeline::CloudAnchorPipeline(int max_in_flight, int ttl_days,
+                                         AnchorRequestBudget* budget)
+    : max_in_flight_(max_in_flight), ttl_days_(ttl_days), budget_(budget) {}
+
+CloudAnchorPipeline::~CloudAnchorPipeline() {
+  // Clear() must have run while the session was alive.
+  for (Request& request : queued_) {
+    Release(&request);
+  }
+  for (Request& request : in_flight_) {
+    Release(&request);
+  }
+  for (const auto& entry : resolved_anchors_) {
+    ArAnchor_release(entry.second);
+  }
+  if (scratch_pose_ != nullptr) {
+    ArPose_destroy(scratch_pose_);
+  }
+}
+
+uint32_t CloudAnchorPipeline::Host(ArSession* session,
+                                   const ArAnchor* anchor) {
+  if (scratch_pose_ == nullptr) {
+    ArPose_create(session, nullptr, &scratch_pose_);
+  }
+  ArAnchor_getPose(session, anchor, scratch_pose_);
+  Request request;
+  if (ArSession_acquireNewAnchor(session, scratch_pose_, &request.anchor) !=
+      AR_SUCCESS) {
+    LOGE("CloudAnchorPipeline: cannot create the anchor to host");
+    return 0;
+  }
+  request.id = next_id_++;
+  request.type = Result::Type::kHosted;
+  request.queue_time = std::chrono::steady_clock::now();
+  queued_.push_back(request);
+  return request.id;
+}
+
+uint32_t CloudAnchorPipeline::Resolve(const std::string& cloud_anchor_id) {
+  const uint32_t id = next_id_++;
+  {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    ++resolve_calls_;
+  }
+  if (resolved_anchors_.count(cloud_anchor_id) != 0) {
+    cached_resolves_.emplace_back(id, cloud_anchor_id);
+  } else {
+    QueueResolve(id, cloud_anchor_id);
+  }
+  return id;
+}
+
+void CloudAnchorPipeline::QueueResolve(uint32_t id,
+                                       const std::string& cloud_anchor_id) {
+  const auto is_same_resolve = [&](const Request& request) {
+    return request.type == Result::Type::kResolved &&
+           request.cloud_anchor_id == cloud_anchor_id;
+  };
+  auto queued = std::find_if(queued_.begin(), queued_.end(), is_same_resolve);
+  auto in_flight =
+      std::find_if(in_flight_.begin(), in_flight_.end(), is_same_resolve);
+  Request* joined = queued != queued_.end()         ? &*queued
+                    : in_flight != in_flight_.end() ? &*in_flight
+                                                    : nullptr;
+  if (joined != nullptr) {
+    joined->joined_ids.push_back(id);
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    ++resolves_joined_;
+    return;
+  }
+  Request request;
+  request.id = id;
+  request.type = Result::Type::kResolved;
+  request.cloud_anchor_id = cloud_anchor_id;
+  request.queue_time = std::chrono::steady_clock::now();
+  queued_.push_back(request);
+}
+
+void CloudAnchorPipeline::Update(ArSession* session, const ArFrame* frame,
+                                 std::vector<Result>* results) {
+  if (--frames_until_sample_ <= 0) {
+    frames_until_sample_ = kQualitySampleInterval;
+    SampleFeatureMapQuality(session, frame);
+  }
+  ServeResolvedAnchors(session, results);
+  PollInFlight(session, results);
+  StartQueued(session, results);
+}
+
+void CloudAnchorPipeline::Clear(const ArSession* session) {
+  for (Request& request : in_flight_) {
+    int32_t was_cancelled = 0;
+    ArFuture_cancel(session, request.future, &was_cancelled);
+    Release(&request);
+    if (budget_ != nullptr) {
+      budget_->Release();
+    }
+  }
+  in_flight_.clear();
+  for (Request& request : queued_) {
+    Release(&request);
+  }
+  queued_.clear();
+  for (const auto& entry : resolved_anchors_) {
+    ArAnchor_release(entry.second);
+  }
+  resolved_anchors_.clear();
+  cached_resolves_.clear();
+}
+
+std::string CloudAnchorPipeline::GetReport() const {
+  std::lock_guard<std::mutex> lock(stats_mutex_);
+  char text[96];
+  snprintf(text, sizeof(text),
+           "hosted %d (%d after the quality timeout, %d failed), "
+           "resolved %d (%d failed)\n",
+           host_.num_samples - host_failures_, hosted_on_timeout_,
+           host_failures_, resolve_.num_samples - resolve_failures_,
+           resolve_failures_);
+  std::string report = text;
+  report += "quality gate: " + gate_wait_.ToString() + "\n";
+  report += "host: " + host_.ToString() + "\n";
+  report += "resolve: " + resolve_.ToString() + "\n";
+  snprintf(text, sizeof(text),
+           "resolve calls %d: %d sent, %d joined, %d from the cache",
+           resolve_calls_, resolves_sent_, resolves_joined_,
+           resolves_from_cache_);
+  report += text;
+  return report;
+}
+
+void CloudAnchorPipeline::SampleFeatureMapQuality(const ArSession* session,
+                                                  const ArFrame* frame) {
+  // Only hosts wait for the quality.
+  bool has_queued_host = false;
+  for (const Request& request : queued_) {
+    has_queued_host |= request.type == Result::Type::kHosted;
+  }
+  if (!has_queued_host) {
+    return;
+  }
+
+  ArCamera* camera = nullptr;
+  ArFrame_acquireCamera(session, frame, &camera);
+  ArTrackingState tracking_state = AR_TRACKING_STATE_STOPPED;
+  ArCamera_getTrackingState(session, camera, &tracking_state);
+  if (tracking_state == AR_TRACKING_STATE_TRACKING) {
+    if (scratch_pose_ == nullptr) {
+      ArPose_create(session, nullptr, &scratch_pose_);
+    }
+    ArCamera_getPose(session, camera, scratch_pose_);
+    ArFeatureMapQuality quality = AR_FEATURE_MAP_QUALITY_INSUFFICIENT;
+    if (ArSession_estimateFeatureMapQualityForHosting(
+            session, scratch_pose_, &quality) == AR_SUCCESS) {
+      quality_ = quality;
+    }
+  } else {
+    quality_ = AR_FEATURE_MAP_QUALITY_INSUFFICIENT;
+  }
+  ArCamera_release(camera);
+}
+
+void CloudAnchorPipeline::ServeResolvedAnchors(const ArSession* session,
+                                               std::vector<Result>* results) {
+  if (cached_resolves_.empty()) {
+    return;
+  }
+  std::vector<std::pair<uint32_t, std::string>> calls;
+  calls.swap(cached_resolves_);
+  for (const auto& call : calls) {
+    auto it = resolved_anchors_.find(call.second);
+    ArTrackingState tracking_state = AR_TRACKING_STATE_STOPPED;
+    if (it != resolved_anchors_.end()) {
+      ArAnchor_getTrackingState(session, it->second, &tracking_state);
+    }
+    if (tracking_state == AR_TRACKING_STATE_STOPPED) {
+      // Detached, so only resolving it again brings the anchor back.
+      if (it != resolved_anchors_.end()) {
+        ArAnchor_release(it->second);
+        resolved_anchors_.erase(it);
+      }
+      QueueResolve(call.first, call.second);
+      continue;
+    }
+    Result result;
+    result.type = Result::Type::kResolved;
+    result.id = call.first;
+    result.cloud_anchor_id = call.second;
+    result.anchor = AcquireAnchorReference(session, it->second);
+    result.state = result.anchor != nullptr
+                       ? AR_CLOUD_ANCHOR_STATE_SUCCESS
+                       : AR_CLOUD_ANCHOR_STATE_ERROR_INTERNAL;
+    results->push_back(result);
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    ++resolves_from_cache_;
+  }
+}
+
+void CloudAnchorPipeline::AddResults(const ArSession* session,
+                                     const Request& request,
+                                     const Result& result,
+                                     std::vector<Result>* results) {
+  // The pipeline keeps the reference of the future and hands out new ones.
+  ArAnchor* const anchor = result.anchor;
+  if (anchor != nullptr) {
+    ArAnchor*& cached = resolved_anchors_[result.cloud_anchor_id];
+    if (cached != nullptr) {
+      ArAnchor_release(cached);
+    }
+    cached = anchor;
+  }
+  const auto add = [&](uint32_t id) {
+    results->push_back(result);
+    Result& added = results->back();
+    added.id = id;
+    if (anchor != nullptr) {
+      added.anchor = AcquireAnchorReference(session, anchor);
+      if (added.anchor == nullptr) {
+        added.state = AR_CLOUD_ANCHOR_STATE_ERROR_INTERNAL;
+      }
+    }
+  };
+  add(request.id);
+  for (const uint32_t id : request.joined_ids) {
+    add(id);
+  }
+}
+
+void CloudAnchorPipeline::StartQueued(ArSession* session,
+                                      std::vector<Result>* results) {
+  const auto now = std::chrono::steady_clock::now();
+  const bool is_quality_sufficient =
+      quality_ >= AR_FEATURE_MAP_QUALITY_SUFFICIENT;
+  auto it = queued_.begin();
+  while (it != queued_.end() &&
+         in_flight_.size() < static_cast<size_t>(max_in_flight_)) {
+    const bool timed_out = now - it->queue_time >= kQualityTimeout;
+    if (it->type == Result::Type::kHosted && !is_quality_sufficient &&
+        !timed_out) {
+      ++it;
+      continue;
+    }
+
+    if (budget_ != nullptr && !budget_->TryAcquire()) {
+      break;
+    }
+    Result result;
+    if (!Start(session, &*it, &result)) {
+      if (budget_ != nullptr) {
+        budget_->Release();
+      }
+      AddResults(session, *it, result, results);
+      Release(&*it);
+      it = queued_.erase(it);
+      continue;
+    }
+    it->start_time = now;
+    if (it->type == Result::Type::kHosted) {
+      std::lock_guard<std::mutex> lock(stats_mutex_);
+      gate_wait_.Add(now - it->queue_time);
+      if (!is_quality_sufficient) {
+        ++hosted_on_timeout_;
+      }
+    }
+    in_flight_.push_back(*it);
+    it = queued_.erase(it);
+  }
+}
+
+bool CloudAnchorPipeline::Start(ArSession* session, Request* request,
+                                Result* result) {
+  ArStatus status = AR_SUCCESS;
+  if (request->type == Result::Type::kHosted) {
+    ArHostCloudAnchorFuture* future = nullptr;
+    status = ArSession_hostCloudAnchorAsync(session, request->anchor,
+                                            ttl_days_, /*context=*/nullptr,
+                                            /*callback=*/nullptr, &future);
+    request->future = status == AR_SUCCESS ? ArAsFuture(future) : nullptr;
+  } else {
+    {
+      std::lock_guard<std::mutex> lock(stats_mutex_);
+      ++resolves_sent_;
+    }
+    ArResolveCloudAnchorFuture* future = nullptr;
+    status = ArSession_resolveCloudAnchorAsync(
+        session, request->cloud_anchor_id.c_str(), /*context=*/nullptr,
+        /*callback=*/nullptr, &future);
+    request->future = status == AR_SUCCESS ? ArAsFuture(future) : nullptr;
+  }
+  if (status == AR_SUCCESS) {
+    return true;
+  }
+  LOGE("CloudAnchorPipeline: request %u failed to start: %d", request->id,
+       status);
+  result->type = request->type;
+  result->id = request->id;
+  result->state = AR_CLOUD_ANCHOR_STATE_ERROR_INTERNAL;
+  result->cloud_anchor_id = request->cloud_anchor_id;
+  std::lock_guard<std::mutex> lock(stats_mutex_);
+  if (request->type == Result::Type::kHosted) {
+    ++host_failures_;
+  } else {
+    ++resolve_failures_;
+  }
+  return false;
+}
+
+void CloudAnchorPipeline::PollInFlight(const ArSession* session,
+                                       std::vector<Result>* results) {
+  const auto now = std::chrono::steady_clock::now();
+  auto it = in_flight_.begin();
+  while (it != in_flight_.end()) {
+    ArFutureState future_state = AR_FUTURE_STATE_PENDING;
+    ArFuture_getState(session, it->future, &future_state);
+    if (future_state == AR_FUTURE_STATE_PENDING) {
+      ++it;
+      continue;
+    }
+    if (budget_ != nullptr) {
+      budget_->Release();
+    }
+
+    Result result;
+    result.type = it->type;
+    result.id = it->id;
+    result.state = AR_CLOUD_ANCHOR_STATE_ERROR_INTERNAL;
+    if (future_state == AR_FUTURE_STATE_DONE &&
+        it->type == Result::Type::kHosted) {
+      const auto* future =
+          reinterpret_cast<const ArHostCloudAnchorFuture*>(it->future);
+      ArHostCloudAnchorFuture_getResultCloudAnchorState(session, future,
+                                                        &result.state);
+      char* cloud_anchor_id = nullptr;
+      ArHostCloudAnchorFuture_acquireResultCloudAnchorId(session, future,
+                                                         &cloud_anchor_id);
+      if (cloud_anchor_id != nullptr) {
+        result.cloud_anchor_id = cloud_anchor_id;
+        ArString_release(cloud_anchor_id);
+      }
+    } else if (future_state == AR_FUTURE_STATE_DONE) {
+      const auto* future =
+          reinterpret_cast<const ArResolveCloudAnchorFuture*>(it->future);
+      ArResolveCloudAnchorFuture_getResultCloudAnchorState(session, future,
+                                                           &result.state);
+      ArResolveCloudAnchorFuture_acquireResultAnchor(session, future,
+                                                     &result.anchor);
+      result.cloud_anchor_id = it->cloud_anchor_id;
+    }
+    const bool succeeded = result.state == AR_CLOUD_ANCHOR_STATE_SUCCESS;
+    if (!succeeded && result.anchor != nullptr) {
+      ArAnchor_release(result.anchor);
+      result.anchor = nullptr;
+    }
+    {
+      std::lock_guard<std::mutex> lock(stats_mutex_);
+      LatencyHistogram& histogram =
+          it->type == Result::Type::kHosted ? host_ : resolve_;
+      histogram.Add(now - it->start_time);
+      if (!succeeded) {
+        ++(it->type == Result::Type::kHosted ? host_failures_
+                                             : resolve_failures_);
+      }
+    }
+    AddResults(session, *it, result, results);
+    Release(&*it);
+    it = in_flight_.erase(it);
+  }
+}
+
+void CloudAnchorPipeline::Release(Request* request) {
+  if (request->future != nullptr) {
+    ArFuture_release(request->future);
+    request->future = nullptr;
+  }
+  if (request->anchor != nullptr) {
+    ArAnchor_release(request->anchor);
+    request->anchor = nullptr;
+  }
+}
+
+}  // namespace hello_ar
@@ -0,0 +1,211 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_CLOUD_ANCHOR_PIPELINE_H_
+#define C_ARCORE_HELLOE_AR_CLOUD_ANCHOR_PIPELINE_H_
+
+#include <array>
+#include <chrono>  // NOLINT
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>  // NOLINT
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "anchor_request_budget.h"
+#include "arcore_c_api.h"
+
+namespace hello_ar {
+
+// Hosts and resolves Cloud Anchors a bounded number at a time, and hosts only
+// once the feature map is good enough.
+//
+// Host() does not upload right away: hosting while ARCore has seen little of
+// the scene mostly yields anchors that fail or resolve badly.  Every
+// kQualitySampleInterval frames, Update() estimates the quality of the
+// features seen from the camera with
+// ArSession_estimateFeatureMapQualityForHosting, and queued anchors are only
+// hosted while it is at least AR_FEATURE_MAP_QUALITY_SUFFICIENT, or once they
+// waited kQualityTimeout.  Hosts and resolves share max_in_flight futures,
+// and the AnchorRequestBudget of the app with its other anchor requests,
+// which bounds the bandwidth of a burst of requests.  The futures are polled
+// in Update(), so all results arrive on its thread.
+//
+// Any number of callers may resolve the same id while paying for a single
+// ArSession_resolveCloudAnchorAsync: Resolve() of an id that is queued or in
+// flight already joins that request, and every joined request gets the
+// result.  Resolved anchors are kept for the rest of the session, and
+// Resolve() of one of them is answered by the next Update() without a
+// network call, unless the anchor stopped tracking for good.  Every result
+// holds its own reference to the anchor.
+//
+// The time anchors wait for the quality gate, hosting and resolving take are
+// kept as histograms, see GetReport().  All methods but GetReport() must be
+// called on the thread that updates the session.
+class CloudAnchorPipeline {
+ public:
+  static constexpr int kQualitySampleInterval = 10;
+  static constexpr std::chrono::seconds kQualityTimeout{15};
+  // Upper bounds of the histogram buckets in ms; a last bucket holds the rest.
+  static constexpr int kNumBuckets = 9;
+  static constexpr std::array<int64_t, kNumBuckets - 1> kBucketLimitsMs = {
+      {500, 1000, 2000, 5000, 10000, 20000, 30000, 60000}};
+
+  struct Result {
+    enum class Type { kHosted, kResolved };
+
+    Type type = Type::kHosted;
+    // As returned by Host() or Resolve().
+    uint32_t id = 0;
+    ArCloudAnchorState state = AR_CLOUD_ANCHOR_STATE_NONE;
+    // The id of the hosted or resolved Cloud Anchor, empty if hosting failed.
+    std::string cloud_anchor_id;
+    // The resolved anchor, whose reference passes to the caller.  Always
+    // nullptr for hosts.
+    ArAnchor* anchor = nullptr;
+  };
+
+  // Each future also holds one of |budget|, which may be nullptr and must
+  // outlive the pipeline otherwise.
+  CloudAnchorPipeline(int max_in_flight, int ttl_days,
+                      AnchorRequestBudget* budget);
+  ~CloudAnchorPipeline();
+
+  CloudAnchorPipeline(const CloudAnchorPipeline&) = delete;
+  CloudAnchorPipeline& operator=(const CloudAnchorPipeline&) = delete;
+
+  // Queues the current pose of |anchor| for hosting and returns the request
+  // id.  The pipeline hosts an anchor of its own at that pose, so |anchor|
+  // may be released at any time.  Returns 0 if no anchor could be created.
+  uint32_t Host(ArSession* session, const ArAnchor* anchor);
+
+  // Queues |cloud_anchor_id| for resolving, or joins the request that
+  // resolves it already or answers it from the anchors resolved before, see
+  // the class comment.  Returns the request id.
+  uint32_t Resolve(const std::string& cloud_anchor_id);
+
+  // Samples the feature map quality from the camera of |frame|, polls the
+  // futures in flight, starts queued requests and appends the requests that
+  // finished to |results|.  Called once per frame after ArSession_update.
+  void Update(ArSession* session, const ArFrame* frame,
+              std::vector<Result>* results);
+
+  // Cancels every request and releases the anchors, including the resolved
+  // ones, and the futures.  Must be called before the session is destroyed.
+  void Clear(const ArSession* session);
+
+  // The last sampled feature map quality.
+  ArFeatureMapQuality GetFeatureMapQuality() const { return quality_; }
+
+  // Counts and latency histograms of the quality gate, hosts and resolves,
+  // and how many Resolve() calls were sent, joined or served from the
+  // resolved anchors.  May be called from any thread.
+  std::string GetReport() const;
+
+ private:
+  struct LatencyHistogram {
+    std::array<int, kNumBuckets> counts = {};
+    int num_samples = 0;
+    int64_t sum_ms = 0;
+
+    void Add(std::chrono::steady_clock::duration latency);
+    std::string ToString() const;
+  };
+
+  struct Request {
+    uint32_t id = 0;
+    Result::Type type = Result::Type::kHosted;
+    // The pipeline's anchor of a host request.
+    ArAnchor* anchor = nullptr;
+    // The id to resolve.
+    std::string cloud_anchor_id;
+    // Resolve() calls that joined this request and get its result as well.
+    std::vector<uint32_t> joined_ids;
+    // Queued by Host() or Resolve(), and started in ARCore.
+    std::chrono::steady_clock::time_point queue_time;
+    std::chrono::steady_clock::time_point start_time;
+    ArFuture* future = nullptr;
+  };
+
+  void SampleFeatureMapQuality(const ArSession* session, const ArFrame* frame);
+
+  // Joins the queued or in flight resolve of |cloud_anchor_id| under |id|,
+  // or queues a new one.
+  void QueueResolve(uint32_t id, const std::string& cloud_anchor_id);
+
+  // Answers the Resolve() calls of anchors resolved before.
+  void ServeResolvedAnchors(const ArSession* session,
+                            std::vector<Result>* results);
+
+  // Appends |result| for |request| and the requests that joined it.  A
+  // successful resolve caches |result.anchor| and hands out a reference of
+  // its own to each of them.
+  void AddResults(const ArSession* session, const Request& request,
+                  const Result& result, std::vector<Result>* results);
+
+  // Starts the queued requests that may go, up to max_in_flight_.
+  void StartQueued(ArSession* session, std::vector<Result>* results);
+
+  // Starts |request|.  Returns false, with |result| filled in, if ARCore
+  // refused it.
+  bool Start(ArSession* session, Request* request, Result* result);
+
+  // Moves the futures that completed out of in_flight_.
+  void PollInFlight(const ArSession* session, std::vector<Result>* results);
+
+  // Releases what |request| holds.
+  static void Release(Request* request);
+
+  const int max_in_flight_;
+  const int ttl_days_;
+  AnchorRequestBudget* const budget_;
+  uint32_t next_id_ = 1;
+  std::deque<Request> queued_;
+  std::vector<Request> in_flight_;
+
+  // One reference to every anchor resolved in the session, by id.
+  std::unordered_map<std::string, ArAnchor*> resolved_anchors_;
+  // Request ids and Cloud Anchor ids of the Resolve() calls that the next
+  // Update() answers from resolved_anchors_.
+  std::vector<std::pair<uint32_t, std::string>> cached_resolves_;
+
+  int frames_until_sample_ = 0;
+  ArFeatureMapQuality quality_ = AR_FEATURE_MAP_QUALITY_INSUFFICIENT;
+  // Receives the camera and anchor poses, created on first use.
+  ArPose* scratch_pose_ = nullptr;
+
+  // Guards the statistics below, which GetReport() reads.
+  mutable std::mutex stats_mutex_;
+  LatencyHistogram gate_wait_;
+  LatencyHistogram host_;
+  LatencyHistogram resolve_;
+  int host_failures_ = 0;
+  int resolve_failures_ = 0;
+  // Hosted after kQualityTimeout rather than at sufficient quality.
+  int hosted_on_timeout_ = 0;
+  // Resolve() calls, and how they were answered.
+  int resolve_calls_ = 0;
+  int resolves_sent_ = 0;
+  int resolves_joined_ = 0;
+  int resolves_from_cache_ = 0;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_CLOUD_ANCHOR_PIPELINE_H_
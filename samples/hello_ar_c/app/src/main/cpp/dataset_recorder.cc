@@ -0,0 +1,259 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "dataset_recorder.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "frame_telemetry.h"
+#include "util.h"
+
+namespace hello_ar {
+
+constexpr uint32_t DatasetRecorder::kMarkerCapacity;
+constexpr size_t DatasetRecorder::kMaxMarkerBytes;
+constexpr int DatasetRecorder::kMaxMarkersPerFrame;
+constexpr int DatasetRecorder::FrameTimeHistogram::kBucketUs;
+constexpr int DatasetRecorder::FrameTimeHistogram::kNumBuckets;
+
+const uint8_t DatasetRecorder::kMarkerTrackId[16] = {
+    0xc4, 0x17, 0x6e, 0x3a, 0x92, 0x0b, 0x4f, 0x58,
+    0xa1, 0x7d, 0x25, 0xe9, 0x3c, 0x80, 0xf6, 0x4b};
+const char DatasetRecorder::kMarkerMimeType[] = "text/plain";
+
+namespace {
+int64_t ToMilliseconds(std::chrono::steady_clock::duration duration) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(duration)
+      .count();
+}
+}  // namespace
+
+void DatasetRecorder::FrameTimeHistogram::Add(
+    std::chrono::nanoseconds frame_time) {
+  const int64_t us =
+      std::chrono::duration_cast<std::chrono::microseconds>(frame_time)
+          .count();
+  ++counts[std::min<int64_t>(us / kBucketUs, kNumBuckets - 1)];
+  ++num_samples;
+  sum_us += us;
+}
+
+float DatasetRecorder::FrameTimeHistogram::GetMeanMs() const {
+  return num_samples == 0 ? 0.f : sum_us / 1000.f / num_samples;
+}
+
+float DatasetRecorder::FrameTimeHistogram::GetPercentileMs(int percent) const {
+  const int rank = (num_samples - 1) * percent / 100;
+  int seen = 0;
+  for (int i = 0; i < kNumBuckets; ++i) {
+    seen += counts[i];
+    if (seen > rank) {
+      return (i + 1) * kBucketUs / 1000.f;
+    }
+  }
+  return 0.f;
+}
+
+std::string DatasetRecorder::FrameTimeHistogram::ToString() const {
+  if (num_samples == 0) {
+    return "no frames";
+  }
+  char text[96];
+  snprintf(text, sizeof(text),
+           "%d frames, mean %.2f ms, p50 %.2f ms, p95 %.2f ms, p99 %.2f ms",
+           num_samples, GetMeanMs(), GetPercentileMs(50), GetPercentileMs(95),
+           GetPercentileMs(99));
+  return text;
+}
+
+DatasetRecorder::~DatasetRecorder() { Close(); }
+
+bool DatasetRecorder::Start(ArSession* session,
+                            const std::string& dataset_uri) {
+  Command command;
+  command.type = Command::Type::kStart;
+  command.session = session;
+  command.dataset_uri = dataset_uri;
+  return Queue(std::move(command));
+}
+
+bool DatasetRecorder::Stop(ArSession* session) {
+  Command command;
+  command.type = Command::Type::kStop;
+  command.session = session;
+  return Queue(std::move(command));
+}
+
+bool DatasetRecorder::Queue(Command command) {
+  std::lock_guard<std::mutex> lock(command_mutex_);
+  if (closing_ || busy_.load(std::memory_order_relaxed)) {
+    return false;
+  }
+  if (!controller_thread_.joinable()) {
+    controller_thread_ = std::thread(&DatasetRecorder::RunCommands, this);
+  }
+  busy_.store(true, std::memory_order_release);
+  commands_.push_back(std::move(command));
+  command_ready_.notify_one();
+  return true;
+}
+
+void DatasetRecorder::Close() {
+  {
+    std::lock_guard<std::mutex> lock(command_mutex_);
+    closing_ = true;
+    command_ready_.notify_one();
+  }
+  if (controller_thread_.joinable()) {
+    controller_thread_.join();
+  }
+}
+
+void DatasetRecorder::RunCommands() {
+  std::unique_lock<std::mutex> lock(command_mutex_);
+  while (true) {
+    command_ready_.wait(lock,
+                        [this] { return closing_ || !commands_.empty(); });
+    if (commands_.empty()) {
+      return;
+    }
+    Command command = std::move(commands_.front());
+    commands_.pop_front();
+    lock.unlock();
+    RunCommand(command);
+    busy_.store(false, std::memory_order_release);
+    lock.lock();
+  }
+}
+
+void DatasetRecorder::RunCommand(const Command& command) {
+  const auto start_time = std::chrono::steady_clock::now();
+  if (command.type == Command::Type::kStop) {
+    const ArStatus status = ArSession_stopRecording(command.session);
+    const auto latency = std::chrono::steady_clock::now() - start_time;
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    last_stop_latency_ = latency;
+    LOGI("DatasetRecorder: stopped (%d) after %lld ms", status,
+         static_cast<long long>(ToMilliseconds(latency)));
+    return;
+  }
+
+  ArRecordingConfig* recording_config = nullptr;
+  ArRecordingConfig_create(command.session, &recording_config);
+  ArRecordingConfig_setMp4DatasetUri(command.session, recording_config,
+                                     command.dataset_uri.c_str());
+  ArRecordingConfig_setAutoStopOnPause(command.session, recording_config,
+                                       true);
+  ArTrack* track = nullptr;
+  ArTrack_create(command.session, &track);
+  ArTrack_setId(command.session, track, kMarkerTrackId);
+  ArTrack_setMimeType(command.session, track, kMarkerMimeType);
+  ArRecordingConfig_addTrack(command.session, recording_config, track);
+  ArTrack_destroy(track);
+  FrameTelemetryLog::AddTrack(command.session, recording_config);
+  const ArStatus status =
+      ArSession_startRecording(command.session, recording_config);
+  ArRecordingConfig_destroy(recording_config);
+
+  const auto latency = std::chrono::steady_clock::now() - start_time;
+  std::lock_guard<std::mutex> lock(stats_mutex_);
+  last_start_latency_ = latency;
+  if (status != AR_SUCCESS) {
+    ++failed_starts_;
+    LOGE("DatasetRecorder: cannot record to %s (%d)",
+         command.dataset_uri.c_str(), status);
+    return;
+  }
+  ++recordings_;
+  LOGI("DatasetRecorder: recording to %s after %lld ms",
+       command.dataset_uri.c_str(),
+       static_cast<long long>(ToMilliseconds(latency)));
+}
+
+bool DatasetRecorder::QueueMarker(const std::string& marker) {
+  Marker item;
+  item.size = std::min(marker.size(), kMaxMarkerBytes);
+  memcpy(item.data.data(), marker.data(), item.size);
+  if (!markers_.TryPush(&item)) {
+    dropped_markers_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+void DatasetRecorder::OnFrameDrawn(ArSession* session, const ArFrame* frame,
+                                   std::chrono::nanoseconds frame_time) {
+  ArRecordingStatus status = AR_RECORDING_NONE;
+  ArSession_getRecordingStatus(session, &status);
+  const bool is_recording = status == AR_RECORDING_OK;
+
+  // Markers queued while not recording fail with the next frames, so a
+  // recording never starts with stale ones.
+  int recorded = 0;
+  int failed = 0;
+  for (int i = 0; i < kMaxMarkersPerFrame && markers_.TryPop(&scratch_marker_);
+       ++i) {
+    if (!is_recording) {
+      ++failed;
+    } else if (ArFrame_recordTrackData(session, frame, kMarkerTrackId,
+                                       scratch_marker_.data.data(),
+                                       scratch_marker_.size) == AR_SUCCESS) {
+      ++recorded;
+    } else {
+      ++failed;
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(stats_mutex_);
+  (is_recording ? recording_frames_ : idle_frames_).Add(frame_time);
+  recorded_markers_ += recorded;
+  failed_markers_ += failed;
+}
+
+std::string DatasetRecorder::GetReport() const {
+  FrameTimeHistogram idle_frames;
+  FrameTimeHistogram recording_frames;
+  char text[160];
+  {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    idle_frames = idle_frames_;
+    recording_frames = recording_frames_;
+    snprintf(text, sizeof(text),
+             "%d recordings (%d failed), last start %lld ms, last stop "
+             "%lld ms\nmarkers: %d recorded, %d failed, %d dropped\n",
+             recordings_, failed_starts_,
+             static_cast<long long>(ToMilliseconds(last_start_latency_)),
+             static_cast<long long>(ToMilliseconds(last_stop_latency_)),
+             recorded_markers_, failed_markers_,
+             dropped_markers_.load(std::memory_order_relaxed));
+  }
+  std::string report = text;
+  report += "not recording: " + idle_frames.ToString() + "\n";
+  report += "recording: " + recording_frames.ToString();
+  if (idle_frames.num_samples > 0 && recording_frames.num_samples > 0) {
+    snprintf(text, sizeof(text),
+             "\nrecording costs %+.2f ms mean, %+.2f ms p95",
+             recording_frames.GetMeanMs() - idle_frames.GetMeanMs(),
+             recording_frames.GetPercentileMs(95) -
+                 idle_frames.GetPercentileMs(95));
+    report += text;
+  }
+  return report;
+}
+
+}  // namespace hello_ar
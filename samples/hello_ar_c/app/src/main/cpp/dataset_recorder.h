@@ -0,0 +1,161 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_DATASET_RECORDER_H_
+#define C_ARCORE_HELLOE_AR_DATASET_RECORDER_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <condition_variable>  // NOLINT
+#include <cstdint>
+#include <deque>
+#include <mutex>  // NOLINT
+#include <string>
+#include <thread>  // NOLINT
+
+#include "arcore_c_api.h"
+#include "spsc_queue.h"
+
+namespace hello_ar {
+
+// Records ARCore datasets without the video capture of SessionCapture, for
+// recording many sessions whose performance is measured at the same time.
+//
+// ArSession_startRecording and ArSession_stopRecording can take long enough
+// to drop frames, so Start() and Stop() only queue a command for a controller
+// thread of the recorder and return.  The recording config adds a marker
+// track and the FrameTelemetryLog track.  Markers are queued with
+// QueueMarker() into a ring of preallocated slots, which OnFrameDrawn()
+// drains into the current frame with ArFrame_recordTrackData, at most
+// kMaxMarkersPerFrame per frame.  Neither side allocates or waits; markers
+// that do not fit the ring are dropped and counted.
+//
+// OnFrameDrawn() also sorts the frame times into a histogram for the frames
+// drawn while recording and one for the others, so GetReport() shows what
+// recording costs.
+//
+// Start(), Stop() and GetReport() may be called from any thread.
+// QueueMarker() must always be called from the same thread, e.g. the UI
+// thread, and OnFrameDrawn() from the thread that updates the session.
+class DatasetRecorder {
+ public:
+  // Identify the marker track in ARCore datasets.  Its samples are the
+  // marker text in UTF-8, without a terminating zero.
+  static const uint8_t kMarkerTrackId[16];
+  static const char kMarkerMimeType[];
+  static constexpr uint32_t kMarkerCapacity = 64;
+  static constexpr size_t kMaxMarkerBytes = 256;
+  static constexpr int kMaxMarkersPerFrame = 4;
+
+  DatasetRecorder() = default;
+  ~DatasetRecorder();
+
+  DatasetRecorder(const DatasetRecorder&) = delete;
+  DatasetRecorder& operator=(const DatasetRecorder&) = delete;
+
+  // Queues starting a recording of |session| into the MP4 at |dataset_uri|.
+  // ARCore stops it when the session pauses.  Returns false if another
+  // command is still queued or running.
+  bool Start(ArSession* session, const std::string& dataset_uri);
+
+  // Queues stopping the recording of |session|.  Returns false if another
+  // command is still queued or running.
+  bool Stop(ArSession* session);
+
+  // Runs the queued command, if any, and joins the controller thread.  Must
+  // be called before the session is destroyed.
+  void Close();
+
+  // Queues |marker| for the next frames while recording, truncated to
+  // kMaxMarkerBytes.  Returns false if the ring is full.
+  bool QueueMarker(const std::string& marker);
+
+  // Records the queued markers on |frame|, which must be the current frame,
+  // and adds |frame_time| to the statistics.  Called once per frame.
+  void OnFrameDrawn(ArSession* session, const ArFrame* frame,
+                    std::chrono::nanoseconds frame_time);
+
+  // Whether the last command is still queued or running.
+  bool IsBusy() const { return busy_.load(std::memory_order_acquire); }
+
+  // The frame times while recording and not, the command latencies and the
+  // marker counts as text.
+  std::string GetReport() const;
+
+ private:
+  struct Command {
+    enum class Type { kStart, kStop } type = Type::kStart;
+    ArSession* session = nullptr;
+    std::string dataset_uri;
+  };
+
+  struct Marker {
+    std::array<uint8_t, kMaxMarkerBytes> data;
+    size_t size = 0;
+  };
+
+  // Frame times in kBucketUs buckets, the last one also holding longer
+  // frames.
+  struct FrameTimeHistogram {
+    static constexpr int kBucketUs = 250;
+    static constexpr int kNumBuckets = 256;
+
+    std::array<int, kNumBuckets> counts = {};
+    int num_samples = 0;
+    int64_t sum_us = 0;
+
+    void Add(std::chrono::nanoseconds frame_time);
+    float GetMeanMs() const;
+    // Upper end of the bucket holding the |percent| percentile, in ms.
+    float GetPercentileMs(int percent) const;
+    std::string ToString() const;
+  };
+
+  bool Queue(Command command);
+
+  // Runs on controller_thread_.
+  void RunCommands();
+  void RunCommand(const Command& command);
+
+  // Guards the command queue and the controller thread.
+  std::mutex command_mutex_;
+  std::condition_variable command_ready_;
+  std::deque<Command> commands_;
+  bool closing_ = false;
+  std::thread controller_thread_;
+  std::atomic<bool> busy_{false};
+
+  SpscQueue<Marker, kMarkerCapacity> markers_;
+  std::atomic<int> dropped_markers_{0};
+  // Thread that updates the session only.
+  Marker scratch_marker_;
+
+  // Guards the statistics below, which GetReport() reads.
+  mutable std::mutex stats_mutex_;
+  FrameTimeHistogram idle_frames_;
+  FrameTimeHistogram recording_frames_;
+  int recorded_markers_ = 0;
+  int failed_markers_ = 0;
+  int recordings_ = 0;
+  int failed_starts_ = 0;
+  std::chrono::steady_clock::duration last_start_latency_{0};
+  std::chrono::steady_clock::duration last_stop_latency_{0};
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_DATASET_RECORDER_H_
@@ -0,0 +1,313 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "depth_pyramid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "resource_accounting.h"
+#include "util.h"
+
+namespace hello_ar {
+namespace {
+constexpr char kOwner[] = "DepthPyramidTexture";
+
+constexpr uint16_t kUnknownDepthMm = std::numeric_limits<uint16_t>::max();
+// Points closer to the camera than this are not projected.
+constexpr float kMinDepthM = 0.1f;
+
+// These mirror DepthGetVisibility() and DepthGetBlurredVisibilityAroundUV()
+// in ar_object.frag and occlusion_mask.frag.  Depth outside of
+// [kMinValidDepthMm, kMaxValidDepthMm] never occludes, objects fade out over
+// kDepthTolerance of their depth, and the blur reads up to
+// 2 * kOcclusionBlurAmount of the texture width around a fragment.
+constexpr float kMinValidDepthMm = 200.f;
+constexpr float kMaxValidDepthMm = 7500.f;
+constexpr float kDepthTolerance = 0.015f;
+constexpr float kOcclusionBlurAmount = 0.01f;
+
+// Depth texels around a fragment read by its blurred visibility, including
+// the bilinear footprint of the samples.
+float GetBlurExtentTexels(int depth_width) {
+  return 2.f * kOcclusionBlurAmount * depth_width + 1.f;
+}
+}  // namespace
+
+void DepthPyramid::Build(const uint16_t* depth_mm, int width, int height,
+                         int row_stride, const uint8_t* confidence,
+                         int confidence_row_stride, float confidence_threshold,
+                         const glm::vec4& intrinsics,
+                         const glm::mat4& camera_pose_mat) {
+  if (depth_mm == nullptr || width <= 0 || height <= 0 ||
+      intrinsics.x <= 0.f || intrinsics.y <= 0.f) {
+    levels_.clear();
+    return;
+  }
+  intrinsics_ = intrinsics;
+  world_to_camera_ = glm::inverse(camera_pose_mat);
+
+  // Resizing keeps the storage of the levels across frames of the same size.
+  int level_count = 1;
+  while ((std::max(width, height) >> level_count) > 0) {
+    ++level_count;
+  }
+  levels_.resize(level_count);
+  for (int i = 0; i < level_count; ++i) {
+    Level& level = levels_[i];
+    level.width = std::max(width >> i, 1);
+    level.height = std::max(height >> i, 1);
+    level.min_mm.resize(level.width * level.height);
+    level.max_mm.resize(level.width * level.height);
+  }
+
+  const int min_confidence =
+      static_cast<int>(std::ceil(confidence_threshold * 255.f));
+  Level& base = levels_.front();
+  for (int row = 0; row < height; ++row) {
+    const uint16_t* depth_row = reinterpret_cast<const uint16_t*>(
+        reinterpret_cast<const uint8_t*>(depth_mm) + row * row_stride);
+    const uint8_t* confidence_row =
+        confidence ? confidence + row * confidence_row_stride : nullptr;
+    for (int column = 0; column < width; ++column) {
+      uint16_t value = depth_row[column];
+      if (value == 0 ||
+          (confidence_row && confidence_row[column] < min_confidence)) {
+        value = kUnknownDepthMm;
+      }
+      base.min_mm[row * width + column] = value;
+    }
+  }
+  base.max_mm = base.min_mm;
+
+  for (int i = 1; i < level_count; ++i) {
+    const Level& source = levels_[i - 1];
+    Level& level = levels_[i];
+    for (int y = 0; y < level.height; ++y) {
+      // The last row and column also cover the odd one out of the source.
+      const int y_end =
+          y == level.height - 1 ? source.height : std::min(2 * y + 2,
+                                                           source.height);
+      for (int x = 0; x < level.width; ++x) {
+        const int x_end =
+            x == level.width - 1 ? source.width : std::min(2 * x + 2,
+                                                           source.width);
+        uint16_t min_mm = kUnknownDepthMm;
+        uint16_t max_mm = 0;
+        for (int sy = 2 * y; sy < y_end; ++sy) {
+          for (int sx = 2 * x; sx < x_end; ++sx) {
+            min_mm = std::min(min_mm, source.min_mm[sy * source.width + sx]);
+            max_mm = std::max(max_mm, source.max_mm[sy * source.width + sx]);
+          }
+        }
+        level.min_mm[y * level.width + x] = min_mm;
+        level.max_mm[y * level.width + x] = max_mm;
+      }
+    }
+  }
+}
+
+bool DepthPyramid::IsOccluded(const glm::vec3& center, float radius) const {
+  if (levels_.empty()) {
+    return false;
+  }
+  const Level& base = levels_.front();
+
+  // Depth pixel bounds and the nearest depth of the sphere's bounding box.
+  float min_u = std::numeric_limits<float>::max();
+  float min_v = std::numeric_limits<float>::max();
+  float max_u = std::numeric_limits<float>::lowest();
+  float max_v = std::numeric_limits<float>::lowest();
+  float nearest_m = std::numeric_limits<float>::max();
+  for (int i = 0; i < 8; ++i) {
+    const glm::vec3 corner =
+        center + radius * glm::vec3(i & 1 ? 1.f : -1.f, i & 2 ? 1.f : -1.f,
+                                    i & 4 ? 1.f : -1.f);
+    const glm::vec3 p = glm::vec3(world_to_camera_ * glm::vec4(corner, 1.f));
+    const float depth = -p.z;
+    if (depth <= kMinDepthM) {
+      return false;
+    }
+    // Pixel centers are at integer coordinates, and image rows grow
+    // downwards.
+    const float u = intrinsics_.x * p.x / depth + intrinsics_.z;
+    const float v = -intrinsics_.y * p.y / depth + intrinsics_.w;
+    min_u = std::min(min_u, u);
+    max_u = std::max(max_u, u);
+    min_v = std::min(min_v, v);
+    max_v = std::max(max_v, v);
+    nearest_m = std::min(nearest_m, depth);
+  }
+
+  const float margin = GetBlurExtentTexels(base.width);
+  const int left = static_cast<int>(std::floor(min_u - margin));
+  const int top = static_cast<int>(std::floor(min_v - margin));
+  const int right = static_cast<int>(std::ceil(max_u + margin));
+  const int bottom = static_cast<int>(std::ceil(max_v + margin));
+  if (left < 0 || top < 0 || right >= base.width || bottom >= base.height) {
+    return false;
+  }
+
+  // The coarsest level at which the area spans at most three texels a side.
+  size_t level_index = 0;
+  while (level_index + 1 < levels_.size() &&
+         ((right >> level_index) - (left >> level_index) > 2 ||
+          (bottom >> level_index) - (top >> level_index) > 2)) {
+    ++level_index;
+  }
+  const Level& level = levels_[level_index];
+  const int x_begin = std::min(left >> level_index, level.width - 1);
+  const int x_end = std::min(right >> level_index, level.width - 1);
+  const int y_begin = std::min(top >> level_index, level.height - 1);
+  const int y_end = std::min(bottom >> level_index, level.height - 1);
+  uint16_t min_mm = kUnknownDepthMm;
+  uint16_t max_mm = 0;
+  for (int y = y_begin; y <= y_end; ++y) {
+    for (int x = x_begin; x <= x_end; ++x) {
+      min_mm = std::min(min_mm, level.min_mm[y * level.width + x]);
+      max_mm = std::max(max_mm, level.max_mm[y * level.width + x]);
+    }
+  }
+
+  const float nearest_mm = nearest_m * 1000.f;
+  return min_mm >= kMinValidDepthMm && max_mm <= kMaxValidDepthMm &&
+         max_mm <= nearest_mm * (1.f - kDepthTolerance);
+}
+
+glm::ivec2 DepthPyramidTexture::GetSampledLevelSize() const {
+  const int level = std::max(early_out_level_, 0);
+  return glm::ivec2(std::max(width_ >> level, 1), std::max(height_ >> level, 1));
+}
+
+void DepthPyramidTexture::InitializeGlContent(AAssetManager* asset_manager) {
+  shader_program_ =
+      util::CreateProgram(ShaderVariant::kDepthPyramid, asset_manager);
+  if (!shader_program_) {
+    LOGE("Could not create depth pyramid program.");
+  }
+  uniform_source_ = glGetUniformLocation(shader_program_, "u_Source");
+  uniform_from_depth_ = glGetUniformLocation(shader_program_, "u_FromDepth");
+  uniform_destination_size_ =
+      glGetUniformLocation(shader_program_, "u_DestinationSize");
+  uniform_confidence_threshold_ =
+      glGetUniformLocation(shader_program_, "u_DepthConfidenceThreshold");
+
+  // Objects of a previous context are gone with it.
+  texture_ = 0;
+  glGenFramebuffers(1, &framebuffer_);
+  depth_width_ = 0;
+  depth_height_ = 0;
+  early_out_level_ = -1;
+  util::CheckGlError("DepthPyramidTexture::InitializeGlContent()");
+}
+
+void DepthPyramidTexture::Allocate(int depth_width, int depth_height) {
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
+  if (texture_) {
+    gl_state.DeleteTexture(texture_);
+  }
+  depth_width_ = depth_width;
+  depth_height_ = depth_height;
+  width_ = (depth_width + 1) / 2;
+  height_ = (depth_height + 1) / 2;
+  level_count_ = 1;
+  while ((std::max(width_, height_) >> level_count_) > 0) {
+    ++level_count_;
+  }
+
+  // Level i has texels of 2^(i + 1) depth texels, the first of them covering
+  // the blur area is the one the shaders read.
+  const float blur_extent = 2.f * GetBlurExtentTexels(depth_width);
+  early_out_level_ = 0;
+  while ((2 << early_out_level_) < blur_extent) {
+    ++early_out_level_;
+  }
+  if (early_out_level_ >= level_count_) {
+    early_out_level_ = -1;
+  }
+
+  glGenTextures(1, &texture_);
+  gl_state.BindTexture(GL_TEXTURE_2D, texture_);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  // Without mipmap filtering a lookup only reads the base level.
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexStorage2D(GL_TEXTURE_2D, level_count_, GL_RGBA8, width_, height_);
+  ResourceAccounting::Get().Track(
+      GpuResourceType::kTexture, texture_,
+      GetTextureBytes(GL_RGBA8, width_, height_, level_count_), kOwner);
+}
+
+void DepthPyramidTexture::Update(GLuint depth_texture_id, int depth_width,
+                                 int depth_height,
+                                 float confidence_threshold) {
+  if (!shader_program_ || depth_texture_id == 0 || depth_width <= 0 ||
+      depth_height <= 0) {
+    return;
+  }
+  if (depth_width != depth_width_ || depth_height != depth_height_ ||
+      !texture_) {
+    Allocate(depth_width, depth_height);
+  }
+
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+  gl_state.SetCapability(GL_DEPTH_TEST, false);
+  gl_state.SetCapability(GL_BLEND, false);
+  gl_state.DepthMask(GL_FALSE);
+  gl_state.UseProgram(shader_program_);
+  // The fullscreen triangle comes from gl_VertexID.
+  gl_state.SetEnabledVertexAttribArrays(0);
+  gl_state.ActiveTexture(GL_TEXTURE0);
+  glUniform1i(uniform_source_, 0);
+  glUniform1f(uniform_confidence_threshold_, confidence_threshold);
+
+  for (int level = 0; level < level_count_; ++level) {
+    const int width = std::max(width_ >> level, 1);
+    const int height = std::max(height_ >> level, 1);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                           texture_, level);
+    glViewport(0, 0, width, height);
+    if (level == 0) {
+      gl_state.BindTexture(GL_TEXTURE_2D, depth_texture_id);
+    } else {
+      // Restricting the sampled levels to the previous one keeps the level
+      // being rendered out of the texture, so there is no feedback loop.
+      gl_state.BindTexture(GL_TEXTURE_2D, texture_);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+    }
+    glUniform1i(uniform_from_depth_, level == 0);
+    glUniform2i(uniform_destination_size_, width, height);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+  }
+
+  gl_state.BindTexture(GL_TEXTURE_2D, texture_);
+  const int sampled_level = std::max(early_out_level_, 0);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, sampled_level);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, sampled_level);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+  gl_state.SetCapability(GL_DEPTH_TEST, true);
+  util::CheckGlError("DepthPyramidTexture::Update()");
+}
+
+}  // namespace hello_ar
@@ -0,0 +1,133 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_DEPTH_PYRAMID_H_
+#define C_ARCORE_HELLOE_AR_DEPTH_PYRAMID_H_
+
+// clang-format off
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+// clang-format on
+#include <android/asset_manager.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "glm.h"
+
+namespace hello_ar {
+
+// Min and max depth over every 2^level x 2^level area of a depth image, built
+// on the CPU to answer occlusion queries without touching the GPU.
+//
+// Depth that is unknown, or below the confidence threshold, counts as
+// infinitely far in both the min and the max, since it never occludes.
+class DepthPyramid {
+ public:
+  DepthPyramid() = default;
+
+  // Rebuilds all levels from a depth image.
+  //
+  // @param depth_mm, rows of |row_stride| bytes of 16 bit depth in
+  //     millimeters.
+  // @param confidence, rows of |confidence_row_stride| bytes of 8 bit raw
+  //     depth confidence, or nullptr.
+  // @param intrinsics, focal length (xy) and principal point (zw) in depth
+  //     pixels.
+  // @param camera_pose_mat, the camera sensor pose of the image.
+  void Build(const uint16_t* depth_mm, int width, int height, int row_stride,
+             const uint8_t* confidence, int confidence_row_stride,
+             float confidence_threshold, const glm::vec4& intrinsics,
+             const glm::mat4& camera_pose_mat);
+
+  // Drops the levels, after which nothing is reported as occluded.
+  void Clear() { levels_.clear(); }
+
+  // Whether the world space sphere is hidden behind real geometry in every
+  // depth sample the occlusion shaders would read for it.  Conservative: a
+  // sphere that reaches outside the depth image or close to the camera is
+  // never occluded.
+  bool IsOccluded(const glm::vec3& center, float radius) const;
+
+ private:
+  struct Level {
+    int width = 0;
+    int height = 0;
+    std::vector<uint16_t> min_mm;
+    std::vector<uint16_t> max_mm;
+  };
+
+  // Level 0 is the depth image; level i + 1 halves level i, rounding down.
+  std::vector<Level> levels_;
+  glm::vec4 intrinsics_ = glm::vec4(0.0f);
+  glm::mat4 world_to_camera_ = glm::mat4(1.0f);
+};
+
+// The same min and max depth, reduced from the depth texture on the GPU into
+// the mip levels of an RGBA8 texture.
+//
+// Level 0 halves the depth texture.  Every level packs the min into the red
+// and green and the max into the blue and alpha components, in millimeters
+// like the depth texture.  After Update() the texture's base level is the
+// coarsest level at which one texel covers the whole area the occlusion
+// shaders blur over, so a texture2D() lookup with nearest filtering in any
+// shader reads that level.
+class DepthPyramidTexture {
+ public:
+  DepthPyramidTexture() = default;
+  ~DepthPyramidTexture() = default;
+
+  // Initialize the GL content, needs to be called on GL thread.
+  void InitializeGlContent(AAssetManager* asset_manager);
+
+  // Rebuilds the texture from |depth_texture_id|, which is in the format
+  // written by Texture, one render pass per level.
+  void Update(GLuint depth_texture_id, int depth_width, int depth_height,
+              float confidence_threshold);
+
+  // Texture to sample, or 0 until Update() succeeded at a depth resolution
+  // with enough levels.
+  GLuint GetTextureId() const { return early_out_level_ >= 0 ? texture_ : 0; }
+
+  // Depth texels a side that one texel of the sampled level covers, except
+  // for the last row and column which also cover the remainder.
+  int GetSampledTexelCoverage() const { return 2 << early_out_level_; }
+
+  // Size of the sampled level.
+  glm::ivec2 GetSampledLevelSize() const;
+
+ private:
+  void Allocate(int depth_width, int depth_height);
+
+  GLuint texture_ = 0;
+  GLuint framebuffer_ = 0;
+  int depth_width_ = 0;
+  int depth_height_ = 0;
+  int width_ = 0;
+  int height_ = 0;
+  int level_count_ = 0;
+  int early_out_level_ = -1;
+
+  GLuint shader_program_ = 0;
+  GLint uniform_source_ = -1;
+  GLint uniform_from_depth_ = -1;
+  GLint uniform_destination_size_ = -1;
+  GLint uniform_confidence_threshold_ = -1;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_DEPTH_PYRAMID_H_
@@ -0,0 +1,173 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "depth_query.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "arcore_trace.h"
+
+namespace hello_ar {
+
+void DepthQuery::UpdateGeometry(const ArSession* session,
+                                const ArFrame* frame) {
+  // The transform only rotates by multiples of 90 degrees, flips and crops,
+  // so three points determine it.
+  const float view_points[] = {0.f, 0.f, 1.f, 0.f, 0.f, 1.f};
+  float texture_points[6] = {};
+  ArFrame_transformCoordinates2d(session, frame,
+                                 AR_COORDINATES_2D_VIEW_NORMALIZED, 3,
+                                 view_points,
+                                 AR_COORDINATES_2D_TEXTURE_NORMALIZED,
+                                 texture_points);
+  const glm::vec2 origin(texture_points[0], texture_points[1]);
+  view_to_texture_ = glm::mat3(
+      glm::vec3(texture_points[2] - origin.x, texture_points[3] - origin.y,
+                0.f),
+      glm::vec3(texture_points[4] - origin.x, texture_points[5] - origin.y,
+                0.f),
+      glm::vec3(origin, 1.f));
+}
+
+void DepthQuery::Update(const ArSession* session, const ArImage& depth_image,
+                        const ArImage* confidence_image,
+                        float confidence_threshold,
+                        const glm::vec4& intrinsics,
+                        const glm::mat4& camera_pose_mat) {
+  int64_t timestamp_ns = 0;
+  ArImage_getTimestamp(session, &depth_image, &timestamp_ns);
+  if (timestamp_ns == timestamp_ns_ && width_ > 0) {
+    return;
+  }
+
+  const uint8_t* depth_data = nullptr;
+  int data_size = 0;
+  traced::ArImage_getPlaneData(session, &depth_image, /*plane_index=*/0,
+                               &depth_data, &data_size);
+  if (depth_data == nullptr || data_size <= 0) {
+    Clear();
+    return;
+  }
+  int width = 0;
+  int height = 0;
+  int row_stride = 0;
+  ArImage_getWidth(session, &depth_image, &width);
+  ArImage_getHeight(session, &depth_image, &height);
+  ArImage_getPlaneRowStride(session, &depth_image, 0, &row_stride);
+
+  const uint8_t* confidence_data = nullptr;
+  int confidence_row_stride = 0;
+  if (confidence_image != nullptr) {
+    traced::ArImage_getPlaneData(session, confidence_image, /*plane_index=*/0,
+                                 &confidence_data, &data_size);
+    ArImage_getPlaneRowStride(session, confidence_image, 0,
+                              &confidence_row_stride);
+  }
+  const int min_confidence =
+      static_cast<int>(std::ceil(confidence_threshold * 255.f));
+
+  // Resizing keeps the storage of the previous image of the same size.
+  depth_mm_.resize(static_cast<size_t>(width) * height);
+  for (int row = 0; row < height; ++row) {
+    const uint16_t* depth_row =
+        reinterpret_cast<const uint16_t*>(depth_data + row * row_stride);
+    uint16_t* destination = depth_mm_.data() + row * width;
+    std::copy(depth_row, depth_row + width, destination);
+    if (confidence_data == nullptr) {
+      continue;
+    }
+    const uint8_t* confidence_row =
+        confidence_data + row * confidence_row_stride;
+    for (int column = 0; column < width; ++column) {
+      if (confidence_row[column] < min_confidence) {
+        destination[column] = 0;
+      }
+    }
+  }
+  width_ = width;
+  height_ = height;
+  timestamp_ns_ = timestamp_ns;
+  intrinsics_ = intrinsics;
+  camera_pose_mat_ = camera_pose_mat;
+}
+
+bool DepthQuery::Sample(const glm::vec2& view_uv, glm::vec2* pixel,
+                        uint16_t* depth_mm) const {
+  if (width_ <= 0 || height_ <= 0) {
+    return false;
+  }
+  const glm::vec2 texture_uv =
+      glm::vec2(view_to_texture_ * glm::vec3(view_uv, 1.f));
+  const int center_x =
+      static_cast<int>(std::floor(texture_uv.x * static_cast<float>(width_)));
+  const int center_y =
+      static_cast<int>(std::floor(texture_uv.y * static_cast<float>(height_)));
+  if (center_x < 0 || center_x >= width_ || center_y < 0 ||
+      center_y >= height_) {
+    return false;
+  }
+
+  // Holes are common at depth edges, the nearest neighbour stands in.
+  uint16_t nearest_mm = 0;
+  for (int y = std::max(center_y - 1, 0);
+       y <= std::min(center_y + 1, height_ - 1); ++y) {
+    for (int x = std::max(center_x - 1, 0);
+         x <= std::min(center_x + 1, width_ - 1); ++x) {
+      const uint16_t depth = depth_mm_[y * width_ + x];
+      if (depth != 0 && (nearest_mm == 0 || depth < nearest_mm)) {
+        nearest_mm = depth;
+      }
+    }
+  }
+  if (nearest_mm == 0) {
+    return false;
+  }
+  *pixel = glm::vec2(center_x + 0.5f, center_y + 0.5f);
+  *depth_mm = nearest_mm;
+  return true;
+}
+
+bool DepthQuery::GetDepthAtView(const glm::vec2& view_uv,
+                                float* depth_m) const {
+  glm::vec2 pixel;
+  uint16_t depth_mm = 0;
+  if (!Sample(view_uv, &pixel, &depth_mm)) {
+    return false;
+  }
+  *depth_m = depth_mm * 0.001f;
+  return true;
+}
+
+bool DepthQuery::GetWorldPointAtView(const glm::vec2& view_uv,
+                                     glm::vec3* world_point) const {
+  glm::vec2 pixel;
+  uint16_t depth_mm = 0;
+  if (!Sample(view_uv, &pixel, &depth_mm) || intrinsics_.x <= 0.f ||
+      intrinsics_.y <= 0.f) {
+    return false;
+  }
+  // Same unprojection as the dense point cloud shader: the camera looks down
+  // -z and image rows grow downwards.
+  const float depth_m = depth_mm * 0.001f;
+  const glm::vec4 camera_point(
+      (pixel.x - intrinsics_.z) / intrinsics_.x * depth_m,
+      -(pixel.y - intrinsics_.w) / intrinsics_.y * depth_m, -depth_m, 1.f);
+  *world_point = glm::vec3(camera_pose_mat_ * camera_point);
+  return true;
+}
+
+}  // namespace hello_ar
@@ -0,0 +1,89 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_DEPTH_QUERY_H_
+#define C_ARCORE_HELLOE_AR_DEPTH_QUERY_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "arcore_c_api.h"
+#include "glm.h"
+
+namespace hello_ar {
+
+// Answers depth queries under view points from a CPU copy of the latest
+// depth image, for interactions that need one every frame, e.g. a reticle
+// following the surface under the screen centre, where ArFrame_hitTest would
+// be too expensive.
+//
+// The mapping from view to depth image coordinates is what
+// ArFrame_transformCoordinates2d computes, sampled once per display
+// geometry change in UpdateGeometry() and applied as an affine transform.
+// Placement that has to attach to a plane still needs ArFrame_hitTest.
+//
+// Not thread safe; meant for the thread that calls ArSession_update.
+class DepthQuery {
+ public:
+  DepthQuery() = default;
+
+  // Recomputes the view to depth image transform.  Must be called after the
+  // first ArSession_update and whenever the display geometry changed.
+  void UpdateGeometry(const ArSession* session, const ArFrame* frame);
+
+  // Copies |depth_image| unless it was copied already.
+  //
+  // @param confidence_image, raw depth confidence of |depth_image|, or
+  //     nullptr.  Depth below |confidence_threshold| is dropped.
+  // @param intrinsics, focal length (xy) and principal point (zw) in depth
+  //     pixels.
+  // @param camera_pose_mat, the camera sensor pose of the image.
+  void Update(const ArSession* session, const ArImage& depth_image,
+              const ArImage* confidence_image, float confidence_threshold,
+              const glm::vec4& intrinsics, const glm::mat4& camera_pose_mat);
+
+  // Drops the depth image, after which every query fails.
+  void Clear() { width_ = height_ = 0; }
+
+  // Distance in meters along the camera axis to the surface under
+  // |view_uv|, in normalized view coordinates with the origin at the top
+  // left.  Returns false where the depth is unknown.
+  bool GetDepthAtView(const glm::vec2& view_uv, float* depth_m) const;
+
+  // World position of the surface under |view_uv|.
+  bool GetWorldPointAtView(const glm::vec2& view_uv,
+                           glm::vec3* world_point) const;
+
+ private:
+  // Depth image pixel under |view_uv| and its depth in millimeters, from the
+  // nearest valid pixel of the 3x3 neighbourhood.
+  bool Sample(const glm::vec2& view_uv, glm::vec2* pixel,
+              uint16_t* depth_mm) const;
+
+  // Normalized view to normalized texture coordinates.
+  glm::mat3 view_to_texture_ = glm::mat3(1.0f);
+
+  std::vector<uint16_t> depth_mm_;
+  int width_ = 0;
+  int height_ = 0;
+  int64_t timestamp_ns_ = -1;
+  glm::vec4 intrinsics_ = glm::vec4(0.0f);
+  glm::mat4 camera_pose_mat_ = glm::mat4(1.0f);
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_DEPTH_QUERY_H_
@@ -0,0 +1,261 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "egl_image_cache.h"
+
+#include <android/api-level.h>
+#include <dlfcn.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "util.h"
+
+namespace hello_ar {
+namespace {
+// Load hardware buffer symbols at runtime.
+using PFeglGetNativeClientBufferANDROID =
+    EGLClientBuffer (*)(const AHardwareBuffer* buffer);
+
+PFeglGetNativeClientBufferANDROID LoadGetNativeClientBuffer() {
+  static PFeglGetNativeClientBufferANDROID function =
+      reinterpret_cast<PFeglGetNativeClientBufferANDROID>(
+          eglGetProcAddress("eglGetNativeClientBufferANDROID"));
+  return function;
+}
+
+// The app is not built with GL_GLEXT_PROTOTYPES.
+PFNGLEGLIMAGETARGETTEXTURE2DOESPROC LoadEglImageTargetTexture2D() {
+  static PFNGLEGLIMAGETARGETTEXTURE2DOESPROC function =
+      reinterpret_cast<PFNGLEGLIMAGETARGETTEXTURE2DOESPROC>(
+          eglGetProcAddress("glEGLImageTargetTexture2DOES"));
+  return function;
+}
+
+// AHardwareBuffer_acquire() and AHardwareBuffer_release(), which are only
+// linkable from Android 8.0.
+using HardwareBufferFunction = void (*)(AHardwareBuffer* buffer);
+
+struct HardwareBufferFunctions {
+  HardwareBufferFunction acquire = nullptr;
+  HardwareBufferFunction release = nullptr;
+};
+
+const HardwareBufferFunctions& LoadHardwareBufferFunctions() {
+  static const HardwareBufferFunctions functions = [] {
+    HardwareBufferFunctions loaded;
+    void* library = dlopen("libnativewindow.so", RTLD_NOW | RTLD_LOCAL);
+    if (library == nullptr) {
+      return loaded;
+    }
+    // The library stays loaded for the lifetime of the process.
+    loaded.acquire = reinterpret_cast<HardwareBufferFunction>(
+        dlsym(library, "AHardwareBuffer_acquire"));
+    loaded.release = reinterpret_cast<HardwareBufferFunction>(
+        dlsym(library, "AHardwareBuffer_release"));
+    return loaded;
+  }();
+  return functions;
+}
+
+// ArFrame_getHardwareBuffer() fails on earlier versions.
+constexpr int kMinHardwareBufferApiLevel = 27;
+
+constexpr char kNativeFenceSyncExtension[] = "EGL_ANDROID_native_fence_sync";
+
+// Upper bound for waiting on a release fence, so a lost GPU context cannot
+// hang the render thread.
+constexpr EGLTimeKHR kReleaseFenceTimeoutNs = 100000000;  // 100 ms.
+}  // namespace
+
+constexpr size_t EglImageCache::kCapacity;
+
+bool EglImageCache::IsSupported() {
+  const HardwareBufferFunctions& functions = LoadHardwareBufferFunctions();
+  return android_get_device_api_level() >= kMinHardwareBufferApiLevel &&
+         functions.acquire != nullptr && functions.release != nullptr &&
+         LoadGetNativeClientBuffer() != nullptr &&
+         LoadEglImageTargetTexture2D() != nullptr;
+}
+
+EglImageCache::~EglImageCache() { Flush(); }
+
+bool EglImageCache::BindToTexture(AHardwareBuffer* buffer, GLuint texture_id) {
+  if (flush_requested_.exchange(false)) {
+    Flush();
+  }
+  if (buffer == nullptr || !IsSupported()) {
+    return false;
+  }
+  if (buffer == bound_buffer_ && texture_id == bound_texture_) {
+    return true;
+  }
+
+  // A pending fence on the previous buffer means its pass is still running
+  // while the next camera frame is being prepared.
+  const Entry* previous = FindEntry(bound_buffer_);
+  if (previous != nullptr && IsFencePending(*previous)) {
+    ++fence_stats_.overlapped_binds;
+  }
+
+  Entry* entry = GetEntry(buffer);
+  if (entry == nullptr) {
+    return false;
+  }
+
+  // Bound through the state cache, which the renderers bind through as well.
+  util::GlStateCache::Get().BindTexture(GL_TEXTURE_EXTERNAL_OES, texture_id);
+  LoadEglImageTargetTexture2D()(GL_TEXTURE_EXTERNAL_OES, entry->image);
+  util::CheckGlError("glEGLImageTargetTexture2DOES");
+
+  bound_buffer_ = buffer;
+  bound_texture_ = texture_id;
+  return true;
+}
+
+void EglImageCache::InsertReleaseFence() {
+  Entry* entry = FindEntry(bound_buffer_);
+  if (entry == nullptr || !supports_native_fences_) {
+    return;
+  }
+  // The new fence signals after the previous one, so only the latest is kept.
+  if (entry->release_fence != EGL_NO_SYNC_KHR) {
+    eglDestroySyncKHR(display_, entry->release_fence);
+  }
+  const EGLint attribs[] = {EGL_SYNC_NATIVE_FENCE_FD_ANDROID,
+                            EGL_NO_NATIVE_FENCE_FD_ANDROID, EGL_NONE};
+  entry->release_fence =
+      eglCreateSyncKHR(display_, EGL_SYNC_NATIVE_FENCE_ANDROID, attribs);
+  if (entry->release_fence == EGL_NO_SYNC_KHR) {
+    LOGE("Failed to create native fence sync.");
+    return;
+  }
+  // Native fences only materialize once the commands before them are flushed.
+  glFlush();
+  ++fence_stats_.fences_inserted;
+}
+
+EglImageCache::Entry* EglImageCache::FindEntry(AHardwareBuffer* buffer) {
+  if (buffer == nullptr) {
+    return nullptr;
+  }
+  for (Entry& entry : entries_) {
+    if (entry.buffer == buffer) {
+      return &entry;
+    }
+  }
+  return nullptr;
+}
+
+EglImageCache::Entry* EglImageCache::GetEntry(AHardwareBuffer* buffer) {
+  ++use_count_;
+  Entry* cached = FindEntry(buffer);
+  if (cached != nullptr) {
+    cached->last_used = use_count_;
+    return cached;
+  }
+
+  PFeglGetNativeClientBufferANDROID get_native_client_buffer =
+      LoadGetNativeClientBuffer();
+  if (get_native_client_buffer == nullptr) {
+    LOGE("eglGetNativeClientBufferANDROID symbol does not exist.");
+    return nullptr;
+  }
+  if (display_ == EGL_NO_DISPLAY) {
+    InitializeDisplay();
+  }
+
+  EGLint attr[] = {EGL_IMAGE_PRESERVED_KHR, EGL_TRUE, EGL_NONE};
+  EGLImageKHR image = eglCreateImageKHR(
+      display_, EGL_NO_CONTEXT, EGL_NATIVE_BUFFER_ANDROID,
+      get_native_client_buffer(buffer), attr);
+  if (image == EGL_NO_IMAGE_KHR) {
+    LOGE("Failed to create egl image ");
+    return nullptr;
+  }
+
+  if (entries_.size() >= kCapacity) {
+    auto oldest = std::min_element(
+        entries_.begin(), entries_.end(),
+        [](const Entry& a, const Entry& b) {
+          return a.last_used < b.last_used;
+        });
+    if (oldest->buffer == bound_buffer_) {
+      // The texture keeps its storage, but it has to be rebound to be reused.
+      bound_buffer_ = nullptr;
+    }
+    ReleaseEntry(&*oldest);
+    entries_.erase(oldest);
+  }
+
+  LoadHardwareBufferFunctions().acquire(buffer);
+  Entry entry;
+  entry.buffer = buffer;
+  entry.image = image;
+  entry.last_used = use_count_;
+  entry.release_fence = EGL_NO_SYNC_KHR;
+  entries_.push_back(entry);
+  return &entries_.back();
+}
+
+bool EglImageCache::IsFencePending(const Entry& entry) const {
+  if (entry.release_fence == EGL_NO_SYNC_KHR) {
+    return false;
+  }
+  EGLint status = EGL_SIGNALED_KHR;
+  eglGetSyncAttribKHR(display_, entry.release_fence, EGL_SYNC_STATUS_KHR,
+                      &status);
+  return status != EGL_SIGNALED_KHR;
+}
+
+void EglImageCache::ReleaseEntry(Entry* entry) {
+  if (entry->release_fence != EGL_NO_SYNC_KHR) {
+    if (IsFencePending(*entry)) {
+      const auto start = std::chrono::steady_clock::now();
+      eglClientWaitSyncKHR(display_, entry->release_fence,
+                           EGL_SYNC_FLUSH_COMMANDS_BIT_KHR,
+                           kReleaseFenceTimeoutNs);
+      ++fence_stats_.blocking_waits;
+      fence_stats_.gpu_wait_time += std::chrono::steady_clock::now() - start;
+    }
+    eglDestroySyncKHR(display_, entry->release_fence);
+    entry->release_fence = EGL_NO_SYNC_KHR;
+  }
+  eglDestroyImageKHR(display_, entry->image);
+  LoadHardwareBufferFunctions().release(entry->buffer);
+}
+
+void EglImageCache::InitializeDisplay() {
+  display_ = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  const char* extensions = eglQueryString(display_, EGL_EXTENSIONS);
+  supports_native_fences_ = extensions != nullptr &&
+                            strstr(extensions, kNativeFenceSyncExtension);
+  if (!supports_native_fences_) {
+    LOGI("%s is not supported, camera buffers are not fenced.",
+         kNativeFenceSyncExtension);
+  }
+}
+
+void EglImageCache::Flush() {
+  for (Entry& entry : entries_) {
+    ReleaseEntry(&entry);
+  }
+  entries_.clear();
+  bound_buffer_ = nullptr;
+  bound_texture_ = 0;
+}
+
+}  // namespace hello_ar
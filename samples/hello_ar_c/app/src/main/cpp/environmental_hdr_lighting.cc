@@ -0,0 +1,328 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "environmental_hdr_lighting.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "glm.h"
+#include "resource_accounting.h"
+#include "util.h"
+
+namespace hello_ar {
+
+constexpr int EnvironmentalHdrLighting::kNumCoefficients;
+
+namespace {
+constexpr char kOwner[] = "EnvironmentalHdrLighting";
+constexpr int kNumFaces = 6;
+// Red, green, blue and alpha half floats per texel of the ARCore images.
+constexpr int kInputBytesPerTexel = 8;
+constexpr int kOutputChannels = 3;
+// Specular lobes sharper than this are as good as a single texel.
+constexpr float kMaxSpecularExponent = 10000.0f;
+
+// Premultiply the harmonics with their basis constants, the cosine
+// convolution and the Lambertian 1 / pi, like HelloArActivity in
+// hello_ar_java does.
+constexpr float kSphericalHarmonicFactors[9] = {
+    0.282095f, -0.325735f, 0.325735f,  -0.325735f, 0.273137f,
+    -0.273137f, 0.078848f, -0.273137f, 0.136569f};
+
+float HalfToFloat(uint16_t half) {
+  const uint32_t sign = static_cast<uint32_t>(half & 0x8000u) << 16;
+  const uint32_t exponent = (half >> 10) & 0x1fu;
+  const uint32_t mantissa = half & 0x3ffu;
+  if (exponent == 0) {
+    // Zero or subnormal, mantissa * 2^-24.
+    const float value = static_cast<float>(mantissa) / 16777216.0f;
+    return sign ? -value : value;
+  }
+  const uint32_t bits =
+      exponent == 0x1fu ? sign | 0x7f800000u | (mantissa << 13)
+                        : sign | ((exponent + 112u) << 23) | (mantissa << 13);
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+// Radiance is never negative, so this only handles positive values: those
+// below the smallest normal half float flush to zero, larger ones than the
+// largest clamp to it.
+uint16_t FloatToHalf(float value) {
+  if (!(value >= 6.103515625e-5f)) {
+    return 0;
+  }
+  value = std::min(value, 65504.0f);
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  // Rounds to nearest, which cannot carry past the largest half float.
+  return static_cast<uint16_t>(((bits + 0x1000u) >> 13) - (112u << 10));
+}
+
+// Direction through the center of texel (x, y) of a |size| square face, in
+// the face order and orientation of GL_TEXTURE_CUBE_MAP_POSITIVE_X onwards.
+glm::vec3 GetTexelDirection(int face, int size, int x, int y) {
+  const float u = 2.0f * (x + 0.5f) / size - 1.0f;
+  const float v = 2.0f * (y + 0.5f) / size - 1.0f;
+  switch (face) {
+    case 0:
+      return glm::normalize(glm::vec3(1.0f, -v, -u));
+    case 1:
+      return glm::normalize(glm::vec3(-1.0f, -v, u));
+    case 2:
+      return glm::normalize(glm::vec3(u, 1.0f, v));
+    case 3:
+      return glm::normalize(glm::vec3(u, -1.0f, -v));
+    case 4:
+      return glm::normalize(glm::vec3(u, -v, 1.0f));
+    default:
+      return glm::normalize(glm::vec3(-u, -v, -1.0f));
+  }
+}
+
+// Solid angle of texel (x, y), up to a factor that is the same for all
+// texels of a face.
+float GetTexelSolidAngle(int size, int x, int y) {
+  const float u = 2.0f * (x + 0.5f) / size - 1.0f;
+  const float v = 2.0f * (y + 0.5f) / size - 1.0f;
+  const float d = 1.0f + u * u + v * v;
+  return 1.0f / (d * std::sqrt(d));
+}
+
+// Phong exponent of the lobe for a perceptual |roughness|, from the GGX
+// alpha of roughness squared.  Zero for a roughness of 1, which weighs the
+// whole hemisphere the same.
+float GetSpecularExponent(float roughness) {
+  const float alpha = roughness * roughness;
+  if (alpha <= 0.0f) {
+    return kMaxSpecularExponent;
+  }
+  return std::min(2.0f / (alpha * alpha) - 2.0f, kMaxSpecularExponent);
+}
+
+int GetLevelCountForSize(int face_size) {
+  int levels = 1;
+  while ((face_size >> levels) > 0) {
+    ++levels;
+  }
+  return levels;
+}
+}  // namespace
+
+EnvironmentalHdrLighting::~EnvironmentalHdrLighting() { Finish(); }
+
+void EnvironmentalHdrLighting::InitializeGlContent() {
+  // The texture went away with the previous context.  A pending job still
+  // uploads into the new one.
+  texture_ = 0;
+  texture_face_size_ = 0;
+  level_count_ = 0;
+}
+
+void EnvironmentalHdrLighting::Update(const ArSession* session,
+                                      const ArLightEstimate* light_estimate) {
+  if (job_pending_) {
+    if (!job_.IsDone()) {
+      return;
+    }
+    job_pending_ = false;
+    if (prefiltered_face_size_ > 0) {
+      Upload();
+    }
+  }
+
+  int64_t timestamp_ns = 0;
+  ArLightEstimate_getTimestamp(session, light_estimate, &timestamp_ns);
+  if (timestamp_ns == processed_timestamp_ns_) {
+    return;
+  }
+  processed_timestamp_ns_ = timestamp_ns;
+
+  ArLightEstimate_getEnvironmentalHdrAmbientSphericalHarmonics(
+      session, light_estimate, pending_coefficients_.data());
+  ArLightEstimate_acquireEnvironmentalHdrCubemap(session, light_estimate,
+                                                 images_);
+  ResourceAccounting::Get().AddArHandles(ArHandleType::kImage, kNumFaces);
+  job_pending_ = true;
+  util::JobSystem::Get().Submit([this, session]() { Prefilter(session); },
+                                &job_);
+}
+
+void EnvironmentalHdrLighting::Finish() {
+  util::JobSystem::Get().Wait(&job_);
+  job_pending_ = false;
+}
+
+void EnvironmentalHdrLighting::Prefilter(const ArSession* session) {
+  prefiltered_face_size_ = 0;
+  int32_t face_size = 0;
+  ArImage_getWidth(session, images_[0], &face_size);
+  bool is_valid = face_size > 0;
+  for (int face = 0; face < kNumFaces; ++face) {
+    int32_t width = 0;
+    int32_t height = 0;
+    ArImageFormat format = AR_IMAGE_FORMAT_INVALID;
+    ArImage_getWidth(session, images_[face], &width);
+    ArImage_getHeight(session, images_[face], &height);
+    ArImage_getFormat(session, images_[face], &format);
+    is_valid = is_valid && width == face_size && height == face_size &&
+               format == AR_IMAGE_FORMAT_RGBA_FP16;
+  }
+
+  // Copy the faces out row by row, since rows may be padded, so the images
+  // can go back to ARCore before the prefiltering starts.
+  const int face_texels = face_size * face_size;
+  std::vector<glm::vec3> radiance;
+  if (is_valid) {
+    radiance.resize(kNumFaces * face_texels);
+    for (int face = 0; face < kNumFaces && is_valid; ++face) {
+      const uint8_t* data = nullptr;
+      int32_t data_length = 0;
+      int32_t row_stride = 0;
+      ArImage_getPlaneData(session, images_[face], 0, &data, &data_length);
+      ArImage_getPlaneRowStride(session, images_[face], 0, &row_stride);
+      if (data == nullptr ||
+          data_length < row_stride * (face_size - 1) +
+                            face_size * kInputBytesPerTexel) {
+        is_valid = false;
+        break;
+      }
+      for (int y = 0; y < face_size; ++y) {
+        uint16_t row[4];
+        for (int x = 0; x < face_size; ++x) {
+          memcpy(row, data + y * row_stride + x * kInputBytesPerTexel,
+                 sizeof(row));
+          radiance[face * face_texels + y * face_size + x] = glm::vec3(
+              HalfToFloat(row[0]), HalfToFloat(row[1]), HalfToFloat(row[2]));
+        }
+      }
+    }
+  }
+  for (ArImage*& image : images_) {
+    ArImage_release(image);
+    image = nullptr;
+  }
+  ResourceAccounting::Get().AddArHandles(ArHandleType::kImage, -kNumFaces);
+  if (!is_valid) {
+    LOGE("EnvironmentalHdrLighting: unexpected cubemap images.");
+    return;
+  }
+
+  std::vector<glm::vec3> directions(kNumFaces * face_texels);
+  std::vector<float> solid_angles(kNumFaces * face_texels);
+  for (int face = 0; face < kNumFaces; ++face) {
+    for (int y = 0; y < face_size; ++y) {
+      for (int x = 0; x < face_size; ++x) {
+        const int index = face * face_texels + y * face_size + x;
+        directions[index] = GetTexelDirection(face, face_size, x, y);
+        solid_angles[index] = GetTexelSolidAngle(face_size, x, y);
+      }
+    }
+  }
+
+  const int level_count = GetLevelCountForSize(face_size);
+  prefiltered_texels_.clear();
+  for (int level = 0; level < level_count; ++level) {
+    const int level_size = std::max(face_size >> level, 1);
+    const float exponent = GetSpecularExponent(
+        level_count > 1 ? static_cast<float>(level) / (level_count - 1) : 0.f);
+    for (int face = 0; face < kNumFaces; ++face) {
+      for (int y = 0; y < level_size; ++y) {
+        for (int x = 0; x < level_size; ++x) {
+          glm::vec3 color(0.0f);
+          if (level == 0) {
+            color = radiance[face * face_texels + y * face_size + x];
+          } else {
+            const glm::vec3 normal =
+                GetTexelDirection(face, level_size, x, y);
+            float total_weight = 0.0f;
+            for (size_t i = 0; i < directions.size(); ++i) {
+              const float cos_angle = glm::dot(normal, directions[i]);
+              if (cos_angle <= 0.0f) {
+                continue;
+              }
+              const float weight =
+                  solid_angles[i] * std::pow(cos_angle, exponent);
+              color += weight * radiance[i];
+              total_weight += weight;
+            }
+            if (total_weight > 0.0f) {
+              color /= total_weight;
+            }
+          }
+          prefiltered_texels_.push_back(FloatToHalf(color.r));
+          prefiltered_texels_.push_back(FloatToHalf(color.g));
+          prefiltered_texels_.push_back(FloatToHalf(color.b));
+        }
+      }
+    }
+  }
+  prefiltered_face_size_ = face_size;
+}
+
+void EnvironmentalHdrLighting::Upload() {
+  const int face_size = prefiltered_face_size_;
+  const int level_count = GetLevelCountForSize(face_size);
+  // Cube maps are not tracked by GlStateCache, so they are bound directly.
+  if (texture_ == 0 || texture_face_size_ != face_size) {
+    if (texture_ != 0) {
+      util::GlStateCache::Get().DeleteTexture(texture_);
+    }
+    glGenTextures(1, &texture_);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, texture_);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER,
+                    GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexStorage2D(GL_TEXTURE_CUBE_MAP, level_count, GL_RGB16F, face_size,
+                   face_size);
+    ResourceAccounting::Get().Track(
+        GpuResourceType::kTexture, texture_,
+        kNumFaces *
+            GetTextureBytes(GL_RGB16F, face_size, face_size, level_count),
+        kOwner);
+    texture_face_size_ = face_size;
+    level_count_ = level_count;
+  } else {
+    glBindTexture(GL_TEXTURE_CUBE_MAP, texture_);
+  }
+
+  // Rows of RGB16F texels are only aligned to 2 bytes.
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+  const uint16_t* texels = prefiltered_texels_.data();
+  for (int level = 0; level < level_count; ++level) {
+    const int level_size = std::max(face_size >> level, 1);
+    for (int face = 0; face < kNumFaces; ++face) {
+      glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, 0, 0,
+                      level_size, level_size, GL_RGB, GL_HALF_FLOAT, texels);
+      texels += level_size * level_size * kOutputChannels;
+    }
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+  for (int i = 0; i < kNumCoefficients; ++i) {
+    spherical_harmonics_[i] =
+        pending_coefficients_[i] * kSphericalHarmonicFactors[i / 3];
+  }
+  util::CheckGlError("EnvironmentalHdrLighting::Upload()");
+}
+
+}  // namespace hello_ar
@@ -0,0 +1,118 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_ENVIRONMENTAL_HDR_LIGHTING_H_
+#define C_ARCORE_HELLOE_AR_ENVIRONMENTAL_HDR_LIGHTING_H_
+
+#include <GLES3/gl3.h>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "arcore_c_api.h"
+#include "job_system.h"
+
+namespace hello_ar {
+
+// Environmental HDR light estimates as a prefiltered cubemap and irradiance
+// spherical harmonics, for image based lighting of the virtual objects.
+//
+// ARCore only produces a new estimate every few frames, so Update() does
+// nothing until ArLightEstimate_getTimestamp changes.  It then acquires the
+// six cubemap faces and hands them to a job, which copies them out of the
+// images, releases the images and prefilters one mip level per roughness:
+// level 0 is the estimate itself, each further level convolves it with a
+// wider specular lobe, up to a plain hemisphere average in the 1x1 level.
+// The OpenGL thread only uploads the finished levels into an RGB16F cubemap,
+// once per estimate, next to the spherical harmonics scaled for evaluating
+// irradiance.  A new estimate arriving while a job runs is picked up once the
+// job finished; estimates in between are never looked at.
+//
+// All methods except the destructor must be called on the OpenGL thread,
+// which must also be the thread that updates the session.
+class EnvironmentalHdrLighting {
+ public:
+  // Red, green and blue coefficients of the 9 spherical harmonics.
+  static constexpr int kNumCoefficients = 27;
+
+  EnvironmentalHdrLighting() = default;
+  // Waits for a running job.  Finish() must have been called before if the
+  // session went away already.
+  ~EnvironmentalHdrLighting();
+
+  EnvironmentalHdrLighting(const EnvironmentalHdrLighting&) = delete;
+  EnvironmentalHdrLighting& operator=(const EnvironmentalHdrLighting&) = delete;
+
+  // Forgets the cubemap of a previous context.  Must be called on the OpenGL
+  // thread whenever the context is created.
+  void InitializeGlContent();
+
+  // Uploads the levels of a finished job, then starts a job for
+  // |light_estimate| if it is newer than the last estimate processed and no
+  // job runs.  |light_estimate| must be valid.  Called once per frame.
+  void Update(const ArSession* session, const ArLightEstimate* light_estimate);
+
+  // Waits for a running job and drops its result.  Must be called before
+  // the session is destroyed, since the job reads the cubemap images.
+  void Finish();
+
+  // Cubemap of the latest uploaded estimate, or 0 before the first one.
+  GLuint GetCubemapTexture() const { return texture_; }
+  int GetLevelCount() const { return level_count_; }
+
+  // Coefficients of the latest uploaded estimate, laid out like ARCore's
+  // [r0, g0, b0, r1, ...] and scaled so the irradiance for a unit world
+  // space normal n is
+  //   c0 + c1 n.y + c2 n.z + c3 n.x + c4 n.x n.y + c5 n.y n.z
+  //      + c6 (3 n.z^2 - 1) + c7 n.x n.z + c8 (n.x^2 - n.y^2).
+  const std::array<float, kNumCoefficients>& GetSphericalHarmonics() const {
+    return spherical_harmonics_;
+  }
+
+ private:
+  // Runs on a worker: reads and releases images_, then fills
+  // prefiltered_texels_.
+  void Prefilter(const ArSession* session);
+
+  // Uploads prefiltered_texels_ into texture_, allocating it first if the
+  // face size changed.
+  void Upload();
+
+  // OpenGL thread only.
+  GLuint texture_ = 0;
+  int texture_face_size_ = 0;
+  int level_count_ = 0;
+  std::array<float, kNumCoefficients> spherical_harmonics_ = {};
+  int64_t processed_timestamp_ns_ = -1;
+  // Whether a job was started and its result not uploaded yet.
+  bool job_pending_ = false;
+
+  // Handed to the job while job_pending_ is set.
+  ArImageCubemap images_ = {};
+  std::array<float, kNumCoefficients> pending_coefficients_ = {};
+  // Written by the job: the face size, 0 if the images were unusable, and
+  // the RGB half floats of every level, each level holding the six faces in
+  // GL_TEXTURE_CUBE_MAP_POSITIVE_X order.
+  int prefiltered_face_size_ = 0;
+  std::vector<uint16_t> prefiltered_texels_;
+
+  util::JobCounter job_;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_ENVIRONMENTAL_HDR_LIGHTING_H_
@@ -0,0 +1,282 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "face_mesh_renderer.h"
+
+#include <EGL/egl.h>
+
+#include <cstring>
+
+#include "resource_accounting.h"
+#include "util.h"
+
+namespace hello_ar {
+namespace {
+constexpr char kOwner[] = "FaceMeshRenderer";
+
+constexpr int kPositionComponents = 3;
+constexpr int kNormalComponents = 3;
+constexpr int kUvComponents = 2;
+
+// Upper bound on how long to wait for the GPU to release a region, one frame
+// at 30 fps.  With two regions this is only reached if the GPU falls behind.
+constexpr GLuint64 kFenceTimeoutNs = 33 * 1000 * 1000;
+
+bool HasBufferStorageExtension() {
+  GLint num_extensions = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &num_extensions);
+  for (GLint i = 0; i < num_extensions; ++i) {
+    const char* extension = reinterpret_cast<const char*>(
+        glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i)));
+    if (extension != nullptr &&
+        strcmp(extension, "GL_EXT_buffer_storage") == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+}  // namespace
+
+constexpr int FaceMeshRenderer::kMaxFaces;
+constexpr int FaceMeshRenderer::kNumRegions;
+
+void FaceMeshRenderer::InitializeGlContent(AAssetManager* asset_manager) {
+  shader_program_ =
+      util::CreateProgram(ShaderVariant::kFaceMesh, asset_manager);
+  if (!shader_program_) {
+    LOGE("Could not create program.");
+  }
+  attribute_position_ = glGetAttribLocation(shader_program_, "a_Position");
+  attribute_normal_ = glGetAttribLocation(shader_program_, "a_Normal");
+  attribute_uv_ = glGetAttribLocation(shader_program_, "a_TexCoord");
+  uniform_model_mat_ = glGetUniformLocation(shader_program_, "u_Model");
+  uniform_view_projection_mat_ =
+      glGetUniformLocation(shader_program_, "u_ViewProjection");
+
+  // Buffers, mappings and fences of a previous context are gone with it.
+  index_buffer_ = 0;
+  uv_buffer_ = 0;
+  vertex_count_ = 0;
+  index_count_ = 0;
+  stream_buffer_ = 0;
+  persistent_mapping_ = nullptr;
+  fences_ = {};
+  current_region_ = 0;
+  buffer_storage_ = nullptr;
+  if (HasBufferStorageExtension()) {
+    buffer_storage_ = reinterpret_cast<PFNGLBUFFERSTORAGEEXTPROC>(
+        eglGetProcAddress("glBufferStorageEXT"));
+  }
+  use_buffer_storage_ = buffer_storage_ != nullptr;
+  if (!use_buffer_storage_) {
+    LOGI("FaceMeshRenderer: GL_EXT_buffer_storage is not supported, mapping "
+         "per frame");
+  }
+  util::CheckGlError("FaceMeshRenderer::InitializeGlContent()");
+}
+
+void FaceMeshRenderer::Draw(const ArSession& ar_session,
+                            const ArTrackableList& faces,
+                            const glm::mat4& view_projection_mat,
+                            ArPose* scratch_pose) {
+  streamed_bytes_ = 0;
+  if (!shader_program_) {
+    return;
+  }
+  int32_t face_count = 0;
+  ArTrackableList_getSize(&ar_session, &faces, &face_count);
+  if (face_count == 0) {
+    return;
+  }
+
+  current_region_ = (current_region_ + 1) % kNumRegions;
+  uint8_t* region = nullptr;
+  std::array<glm::mat4, kMaxFaces> model_mats;
+  int faces_written = 0;
+  for (int32_t i = 0; i < face_count && faces_written < kMaxFaces; ++i) {
+    ArTrackable* trackable = nullptr;
+    ArTrackableList_acquireItem(&ar_session, &faces, i, &trackable);
+    const ArAugmentedFace* face = ArAsFace(trackable);
+    ArTrackingState tracking_state = AR_TRACKING_STATE_STOPPED;
+    ArTrackable_getTrackingState(&ar_session, trackable, &tracking_state);
+    if (tracking_state == AR_TRACKING_STATE_TRACKING &&
+        (index_buffer_ != 0 || UploadTopology(ar_session, *face))) {
+      if (region == nullptr) {
+        region = MapRegion(current_region_);
+      }
+      const float* positions = nullptr;
+      const float* normals = nullptr;
+      int32_t position_count = 0;
+      int32_t normal_count = 0;
+      ArAugmentedFace_getMeshVertices(&ar_session, face, &positions,
+                                      &position_count);
+      ArAugmentedFace_getMeshNormals(&ar_session, face, &normals,
+                                     &normal_count);
+      // The topology is shared, so every face has the same vertex count.
+      if (region != nullptr && position_count == vertex_count_ &&
+          normal_count == vertex_count_) {
+        const size_t position_bytes =
+            vertex_count_ * kPositionComponents * sizeof(float);
+        uint8_t* slot = region + faces_written * slot_bytes_;
+        memcpy(slot, positions, position_bytes);
+        memcpy(slot + position_bytes, normals,
+               vertex_count_ * kNormalComponents * sizeof(float));
+        ArAugmentedFace_getCenterPose(&ar_session, face, scratch_pose);
+        ArPose_getMatrix(&ar_session, scratch_pose,
+                         glm::value_ptr(model_mats[faces_written]));
+        ++faces_written;
+      }
+    }
+    ArTrackable_release(trackable);
+  }
+
+  glBindBuffer(GL_ARRAY_BUFFER, stream_buffer_);
+  if (region != nullptr && !use_buffer_storage_) {
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+  }
+  if (faces_written == 0) {
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return;
+  }
+  streamed_bytes_ = faces_written * slot_bytes_;
+
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
+  gl_state.UseProgram(shader_program_);
+  gl_state.SetEnabledVertexAttribArrays((1u << attribute_position_) |
+                                        (1u << attribute_normal_) |
+                                        (1u << attribute_uv_));
+  glUniformMatrix4fv(uniform_view_projection_mat_, 1, GL_FALSE,
+                     glm::value_ptr(view_projection_mat));
+  glBindBuffer(GL_ARRAY_BUFFER, uv_buffer_);
+  glVertexAttribPointer(attribute_uv_, kUvComponents, GL_FLOAT, GL_FALSE, 0,
+                        nullptr);
+  glBindBuffer(GL_ARRAY_BUFFER, stream_buffer_);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_);
+  const size_t normal_offset =
+      vertex_count_ * kPositionComponents * sizeof(float);
+  for (int face = 0; face < faces_written; ++face) {
+    const size_t slot_offset =
+        current_region_ * region_bytes_ + face * slot_bytes_;
+    glVertexAttribPointer(attribute_position_, kPositionComponents, GL_FLOAT,
+                          GL_FALSE, 0,
+                          reinterpret_cast<const void*>(slot_offset));
+    glVertexAttribPointer(
+        attribute_normal_, kNormalComponents, GL_FLOAT, GL_FALSE, 0,
+        reinterpret_cast<const void*>(slot_offset + normal_offset));
+    glUniformMatrix4fv(uniform_model_mat_, 1, GL_FALSE,
+                       glm::value_ptr(model_mats[face]));
+    glDrawElements(GL_TRIANGLES, index_count_, GL_UNSIGNED_SHORT, nullptr);
+  }
+  // Marks when the GPU is done reading this region.
+  fences_[current_region_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  util::CheckGlError("FaceMeshRenderer::Draw()");
+}
+
+bool FaceMeshRenderer::UploadTopology(const ArSession& ar_session,
+                                      const ArAugmentedFace& face) {
+  const float* uvs = nullptr;
+  const uint16_t* indices = nullptr;
+  int32_t uv_count = 0;
+  int32_t triangle_count = 0;
+  ArAugmentedFace_getMeshTextureCoordinates(&ar_session, &face, &uvs,
+                                            &uv_count);
+  ArAugmentedFace_getMeshTriangleIndices(&ar_session, &face, &indices,
+                                         &triangle_count);
+  if (uvs == nullptr || indices == nullptr || uv_count == 0 ||
+      triangle_count == 0) {
+    return false;
+  }
+
+  ResourceAccounting& accounting = ResourceAccounting::Get();
+  glGenBuffers(1, &uv_buffer_);
+  const GLsizeiptr uv_bytes = uv_count * kUvComponents * sizeof(float);
+  glBindBuffer(GL_ARRAY_BUFFER, uv_buffer_);
+  glBufferData(GL_ARRAY_BUFFER, uv_bytes, uvs, GL_STATIC_DRAW);
+  accounting.Track(GpuResourceType::kBuffer, uv_buffer_, uv_bytes, kOwner);
+
+  glGenBuffers(1, &index_buffer_);
+  index_count_ = triangle_count * 3;
+  const GLsizeiptr index_bytes = index_count_ * sizeof(uint16_t);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_bytes, indices, GL_STATIC_DRAW);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  accounting.Track(GpuResourceType::kBuffer, index_buffer_, index_bytes,
+                   kOwner);
+
+  vertex_count_ = uv_count;
+  slot_bytes_ =
+      vertex_count_ * (kPositionComponents + kNormalComponents) * sizeof(float);
+  region_bytes_ = kMaxFaces * slot_bytes_;
+  const GLsizeiptr stream_bytes = kNumRegions * region_bytes_;
+  glGenBuffers(1, &stream_buffer_);
+  glBindBuffer(GL_ARRAY_BUFFER, stream_buffer_);
+  if (use_buffer_storage_) {
+    // Coherent, so the writes need no flush before the draws.
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT_EXT |
+                             GL_MAP_COHERENT_BIT_EXT;
+    buffer_storage_(GL_ARRAY_BUFFER, stream_bytes, nullptr, flags);
+    persistent_mapping_ = static_cast<uint8_t*>(
+        glMapBufferRange(GL_ARRAY_BUFFER, 0, stream_bytes, flags));
+    if (persistent_mapping_ == nullptr) {
+      LOGE("FaceMeshRenderer: persistent mapping failed, mapping per frame");
+      use_buffer_storage_ = false;
+    }
+  } else {
+    glBufferData(GL_ARRAY_BUFFER, stream_bytes, nullptr, GL_STREAM_DRAW);
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  accounting.Track(GpuResourceType::kBuffer, stream_buffer_, stream_bytes,
+                   kOwner);
+  util::CheckGlError("FaceMeshRenderer::UploadTopology()");
+  return true;
+}
+
+uint8_t* FaceMeshRenderer::MapRegion(int region) {
+  WaitForRegion(region);
+  if (use_buffer_storage_) {
+    return persistent_mapping_ + region * region_bytes_;
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, stream_buffer_);
+  uint8_t* mapped = static_cast<uint8_t*>(glMapBufferRange(
+      GL_ARRAY_BUFFER, region * region_bytes_, region_bytes_,
+      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
+          GL_MAP_UNSYNCHRONIZED_BIT));
+  if (mapped == nullptr) {
+    LOGE("FaceMeshRenderer::MapRegion glMapBufferRange failed.");
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  return mapped;
+}
+
+void FaceMeshRenderer::WaitForRegion(int region) {
+  GLsync fence = fences_[region];
+  if (fence == nullptr) {
+    return;
+  }
+  GLenum result =
+      glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, kFenceTimeoutNs);
+  if (result == GL_TIMEOUT_EXPIRED || result == GL_WAIT_FAILED) {
+    LOGE("FaceMeshRenderer: region %d fence wait failed (0x%x).", region,
+         result);
+  }
+  glDeleteSync(fence);
+  fences_[region] = nullptr;
+}
+
+}  // namespace hello_ar
@@ -0,0 +1,112 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_FACE_MESH_RENDERER_H_
+#define C_ARCORE_HELLOE_AR_FACE_MESH_RENDERER_H_
+
+// clang-format off
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+// clang-format on
+#include <android/asset_manager.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "arcore_c_api.h"
+#include "glm.h"
+
+namespace hello_ar {
+
+// Draws the meshes of the Augmented Faces API.
+//
+// Every face mesh shares one topology: the triangle indices and texture
+// coordinates never change, so they are uploaded once, with the first face.
+// Only the vertex positions and normals move, and they are written every
+// frame into one region of a double-buffered stream buffer.  A fence per
+// region keeps the CPU from overwriting a region the GPU still reads.
+//
+// With GL_EXT_buffer_storage the stream buffer is mapped once, persistently
+// and coherently, so a frame is a plain copy into mapped memory.  Without it
+// each region is mapped unsynchronized once per frame instead, which the
+// fences make just as safe.
+//
+// All methods must be called on the OpenGL thread, which must also be the
+// thread that updates the session.
+class FaceMeshRenderer {
+ public:
+  // Faces drawn per frame; more are skipped.
+  static constexpr int kMaxFaces = 3;
+
+  FaceMeshRenderer() = default;
+  ~FaceMeshRenderer() = default;
+
+  FaceMeshRenderer(const FaceMeshRenderer&) = delete;
+  FaceMeshRenderer& operator=(const FaceMeshRenderer&) = delete;
+
+  // Initialize the GL content, needs to be called on GL thread.
+  void InitializeGlContent(AAssetManager* asset_manager);
+
+  // Draws the tracking faces of |faces|, a list of AR_TRACKABLE_FACE
+  // trackables.  |scratch_pose| receives the face center poses.
+  void Draw(const ArSession& ar_session, const ArTrackableList& faces,
+            const glm::mat4& view_projection_mat, ArPose* scratch_pose);
+
+  // Bytes of positions and normals written during the last Draw().
+  size_t GetStreamedBytes() const { return streamed_bytes_; }
+
+ private:
+  static constexpr int kNumRegions = 2;
+
+  // Uploads the indices and texture coordinates of |face|, and allocates the
+  // stream buffer for its number of vertices.
+  bool UploadTopology(const ArSession& ar_session, const ArAugmentedFace& face);
+  // Returns the start of |region| for writing, or nullptr.
+  uint8_t* MapRegion(int region);
+  void WaitForRegion(int region);
+
+  GLuint shader_program_ = 0;
+  GLint attribute_position_ = -1;
+  GLint attribute_normal_ = -1;
+  GLint attribute_uv_ = -1;
+  GLint uniform_model_mat_ = -1;
+  GLint uniform_view_projection_mat_ = -1;
+
+  // The shared topology, 0 until the first face arrived.
+  GLuint index_buffer_ = 0;
+  GLuint uv_buffer_ = 0;
+  int32_t vertex_count_ = 0;
+  int32_t index_count_ = 0;
+
+  // kNumRegions regions of kMaxFaces slots, each slot the positions of one
+  // face followed by its normals.
+  GLuint stream_buffer_ = 0;
+  size_t slot_bytes_ = 0;
+  size_t region_bytes_ = 0;
+  // The persistent mapping of the whole stream buffer, or nullptr.
+  uint8_t* persistent_mapping_ = nullptr;
+  bool use_buffer_storage_ = false;
+  PFNGLBUFFERSTORAGEEXTPROC buffer_storage_ = nullptr;
+  std::array<GLsync, kNumRegions> fences_ = {};
+  int current_region_ = 0;
+
+  size_t streamed_bytes_ = 0;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_FACE_MESH_RENDERER_H_
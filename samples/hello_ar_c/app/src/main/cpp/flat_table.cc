@@ -0,0 +1,172 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flat_table.h"
+
+namespace hello_ar {
+
+namespace {
+// Root table offset and identifier.
+constexpr size_t kHeaderSize = 8;
+constexpr size_t kIdentifierSize = 4;
+// Vtable size and table size ahead of the field offsets.
+constexpr size_t kVtableHeaderSize = 4;
+
+template <typename T>
+T Load(const uint8_t* data) {
+  T value;
+  memcpy(&value, data, sizeof(T));
+  return value;
+}
+
+template <typename T>
+void Store(uint8_t* data, T value) {
+  memcpy(data, &value, sizeof(T));
+}
+
+size_t Align(size_t position, size_t alignment) {
+  return (position + alignment - 1) / alignment * alignment;
+}
+}  // namespace
+
+bool FlatTable::Parse(const uint8_t* data, size_t size, const char* identifier,
+                      FlatTable* table) {
+  if (data == nullptr || size < kHeaderSize ||
+      memcmp(data + 4, identifier, kIdentifierSize) != 0) {
+    return false;
+  }
+  const size_t root = Load<uint32_t>(data);
+  if (root < kHeaderSize || root > size - 4) {
+    return false;
+  }
+  // The vtable is before the table in what FlatTableBuilder writes, but may
+  // be anywhere in the buffer.
+  const int64_t vtable =
+      static_cast<int64_t>(root) - Load<int32_t>(data + root);
+  if (vtable < static_cast<int64_t>(kHeaderSize) ||
+      vtable > static_cast<int64_t>(size - kVtableHeaderSize)) {
+    return false;
+  }
+  const size_t vtable_size = Load<uint16_t>(data + vtable);
+  if (vtable_size < kVtableHeaderSize || vtable_size % 2 != 0 ||
+      vtable_size > size - vtable) {
+    return false;
+  }
+  table->data_ = data;
+  table->size_ = size;
+  table->table_ = root;
+  table->vtable_ = static_cast<size_t>(vtable);
+  table->field_count_ = static_cast<int>((vtable_size - kVtableHeaderSize) / 2);
+  return true;
+}
+
+size_t FlatTable::GetFieldPosition(int field, size_t field_size) const {
+  if (field < 0 || field >= field_count_) {
+    return 0;
+  }
+  const size_t offset =
+      Load<uint16_t>(data_ + vtable_ + kVtableHeaderSize + 2 * field);
+  if (offset == 0 || table_ + offset > size_ - field_size) {
+    return 0;
+  }
+  return table_ + offset;
+}
+
+uint32_t FlatTable::GetArrayPosition(int field, size_t element_size,
+                                     const uint8_t** elements) const {
+  const size_t position = GetFieldPosition(field, sizeof(uint32_t));
+  if (position == 0) {
+    return 0;
+  }
+  const size_t count_position = position + Load<uint32_t>(data_ + position);
+  if (count_position < position || count_position > size_ - 4) {
+    return 0;
+  }
+  const uint32_t count = Load<uint32_t>(data_ + count_position);
+  if (count > (size_ - count_position - 4) / element_size) {
+    return 0;
+  }
+  *elements = data_ + count_position + 4;
+  return count;
+}
+
+FlatTableBuilder::FlatTableBuilder(uint8_t* buffer, size_t capacity,
+                                   const char* identifier, int field_count)
+    : buffer_(buffer), capacity_(capacity), field_count_(field_count) {
+  vtable_ = kHeaderSize;
+  const size_t vtable_size = kVtableHeaderSize + 2 * field_count;
+  table_ = Align(vtable_ + vtable_size, 4);
+  end_ = table_ + sizeof(int32_t);
+  if (end_ > capacity_) {
+    overflowed_ = true;
+    return;
+  }
+  memset(buffer_, 0, end_);
+  memcpy(buffer_ + 4, identifier, kIdentifierSize);
+  Store<uint16_t>(buffer_ + vtable_, static_cast<uint16_t>(vtable_size));
+  Store<int32_t>(buffer_ + table_, static_cast<int32_t>(table_ - vtable_));
+}
+
+size_t FlatTableBuilder::Reserve(int field, size_t size, size_t alignment) {
+  if (field < 0 || field >= field_count_) {
+    overflowed_ = true;
+  }
+  if (overflowed_) {
+    return 0;
+  }
+  const size_t position = Align(end_, alignment);
+  if (position + size > capacity_ || position - table_ > UINT16_MAX) {
+    overflowed_ = true;
+    return 0;
+  }
+  memset(buffer_ + end_, 0, position - end_);
+  Store<uint16_t>(buffer_ + vtable_ + kVtableHeaderSize + 2 * field,
+                  static_cast<uint16_t>(position - table_));
+  end_ = position + size;
+  return position;
+}
+
+void FlatTableBuilder::WriteArray(int field, const void* values,
+                                  size_t element_size, uint32_t count) {
+  const size_t position = Reserve(field, sizeof(uint32_t), sizeof(uint32_t));
+  if (position == 0) {
+    return;
+  }
+  // The field is 4 byte aligned, so the count directly follows it.
+  const size_t count_position = end_;
+  const size_t array_end = count_position + 4 + count * element_size;
+  if (array_end > capacity_) {
+    overflowed_ = true;
+    return;
+  }
+  Store<uint32_t>(buffer_ + position,
+                  static_cast<uint32_t>(count_position - position));
+  Store<uint32_t>(buffer_ + count_position, count);
+  memcpy(buffer_ + count_position + 4, values, count * element_size);
+  end_ = array_end;
+}
+
+size_t FlatTableBuilder::Finish() {
+  if (overflowed_ || end_ - table_ > UINT16_MAX) {
+    return 0;
+  }
+  Store<uint32_t>(buffer_, static_cast<uint32_t>(table_));
+  Store<uint16_t>(buffer_ + vtable_ + 2,
+                  static_cast<uint16_t>(end_ - table_));
+  return end_;
+}
+
+}  // namespace hello_ar
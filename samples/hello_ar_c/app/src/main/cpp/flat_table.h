@@ -0,0 +1,153 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_FLAT_TABLE_H_
+#define C_ARCORE_HELLOE_AR_FLAT_TABLE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace hello_ar {
+
+// A single table in the little endian layout of a FlatBuffers buffer, for
+// payloads such as custom track data that have to be read where they are,
+// and that must stay readable when fields are added.
+//
+//   uint32 offset of the table, 4 byte identifier,
+//   vtable: uint16 vtable size, uint16 table size, uint16 field offsets,
+//   table: int32 distance back to the vtable, then the fields.
+//
+// A field offset is relative to the table and 0 for absent fields, which
+// read as their default.  Array fields hold the uint32 distance from the
+// field to a uint32 element count followed by the elements.  Only scalars
+// are supported, and nested tables, strings and unions are not.
+//
+// FlatTable reads a buffer in place and never copies it, so it is only valid
+// while the buffer is.  Values are read with memcpy, so the buffer needs no
+// alignment.
+class FlatTable {
+ public:
+  // Number of elements and the unaligned bytes of an array field.
+  template <typename T>
+  struct Array {
+    const uint8_t* data = nullptr;
+    uint32_t size = 0;
+
+    T operator[](uint32_t i) const {
+      T value;
+      memcpy(&value, data + i * sizeof(T), sizeof(T));
+      return value;
+    }
+  };
+
+  FlatTable() = default;
+
+  // Checks that |data| holds a table with |identifier| whose vtable and
+  // field offsets are within |size|.  Returns false and leaves |*table|
+  // untouched otherwise.
+  static bool Parse(const uint8_t* data, size_t size, const char* identifier,
+                    FlatTable* table);
+
+  template <typename T>
+  T Get(int field, T default_value) const {
+    static_assert(std::is_arithmetic<T>::value, "only scalars are supported");
+    const size_t offset = GetFieldPosition(field, sizeof(T));
+    if (offset == 0) {
+      return default_value;
+    }
+    T value;
+    memcpy(&value, data_ + offset, sizeof(T));
+    return value;
+  }
+
+  // The elements of an array field, empty if the field is absent or does
+  // not fit the buffer.
+  template <typename T>
+  Array<T> GetArray(int field) const {
+    static_assert(std::is_arithmetic<T>::value, "only scalars are supported");
+    Array<T> array;
+    const uint8_t* elements = nullptr;
+    const uint32_t count = GetArrayPosition(field, sizeof(T), &elements);
+    if (elements != nullptr) {
+      array.data = elements;
+      array.size = count;
+    }
+    return array;
+  }
+
+ private:
+  // Position of |field| in data_ if it is present and its |field_size|
+  // bytes fit, otherwise 0.
+  size_t GetFieldPosition(int field, size_t field_size) const;
+  uint32_t GetArrayPosition(int field, size_t element_size,
+                            const uint8_t** elements) const;
+
+  const uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+  size_t table_ = 0;
+  size_t vtable_ = 0;
+  int field_count_ = 0;
+};
+
+// Writes a FlatTable into a caller-owned buffer, e.g. on the stack, so
+// building a payload never allocates.  Fields are written in the order they
+// are added, each aligned to its size, and arrays right after their field.
+class FlatTableBuilder {
+ public:
+  // |field_count| is the number of fields the vtable has slots for.
+  FlatTableBuilder(uint8_t* buffer, size_t capacity, const char* identifier,
+                   int field_count);
+
+  template <typename T>
+  void Add(int field, T value) {
+    static_assert(std::is_arithmetic<T>::value, "only scalars are supported");
+    const size_t position = Reserve(field, sizeof(T), sizeof(T));
+    if (position != 0) {
+      memcpy(buffer_ + position, &value, sizeof(T));
+    }
+  }
+
+  template <typename T>
+  void AddArray(int field, const T* values, uint32_t count) {
+    static_assert(std::is_arithmetic<T>::value, "only scalars are supported");
+    WriteArray(field, values, sizeof(T), count);
+  }
+
+  // Completes the vtable.  Returns the size of the payload, or 0 if it did
+  // not fit the buffer.
+  size_t Finish();
+
+ private:
+  // Aligns the end of the payload to |alignment|, claims |size| bytes for
+  // |field| and returns their position, or 0 if they do not fit.
+  size_t Reserve(int field, size_t size, size_t alignment);
+  void WriteArray(int field, const void* values, size_t element_size,
+                  uint32_t count);
+
+  uint8_t* buffer_;
+  size_t capacity_;
+  int field_count_;
+  size_t vtable_ = 0;
+  size_t table_ = 0;
+  size_t end_ = 0;
+  bool overflowed_ = false;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_FLAT_TABLE_H_
@@ -0,0 +1,85 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_FRAME_CONTEXT_H_
+#define C_ARCORE_HELLOE_AR_FRAME_CONTEXT_H_
+
+#include <cstdint>
+
+#include "arcore_c_api.h"
+#include "glm.h"
+
+namespace hello_ar {
+
+// Per-frame values queried from ARCore once, right after ArSession_update,
+// and then read by all renderers and input handlers of that frame instead of
+// going back to the C API for each of them.
+struct FrameContext {
+  // Timestamp of the camera image, 0 until the camera produced a frame.
+  int64_t timestamp_ns = 0;
+  // True if the display rotation or viewport changed in this frame.
+  bool display_geometry_changed = false;
+
+  ArTrackingState camera_tracking_state = AR_TRACKING_STATE_STOPPED;
+  // Camera pose in world space as qx, qy, qz, qw, tx, ty, tz.  Only valid
+  // while the camera is tracking.
+  float camera_pose_raw[7] = {0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f};
+  // The same pose as a matrix from the camera sensor frame to world space.
+  glm::mat4 camera_pose_mat = glm::mat4(1.0f);
+  // Pose of the Android sensor frame, in the format of camera_pose_raw.
+  // Only queried for the late pose correction while tracking.
+  float android_sensor_pose_raw[7] = {0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f};
+  // Intrinsics of the camera texture in its pixels, only valid while the
+  // camera is tracking: focal length (xy) and principal point (zw).
+  glm::vec4 camera_texture_intrinsics = glm::vec4(0.0f);
+  glm::vec2 camera_texture_size = glm::vec2(0.0f);
+  glm::mat4 view_mat = glm::mat4(1.0f);
+  glm::mat4 projection_mat = glm::mat4(1.0f);
+  glm::mat4 view_projection_mat = glm::mat4(1.0f);
+
+  ArLightEstimateState light_estimate_state =
+      AR_LIGHT_ESTIMATE_STATE_NOT_VALID;
+  // Color correction from the light estimate, or all ones if it is invalid.
+  float color_correction[4] = {1.f, 1.f, 1.f, 1.f};
+
+  // Session capability flags, refreshed whenever the session is configured.
+  bool is_depth_supported = false;
+
+  bool IsTracking() const {
+    return camera_tracking_state == AR_TRACKING_STATE_TRACKING;
+  }
+
+  // camera_texture_intrinsics scaled to a depth image covering the same
+  // field of view at |depth_width| x |depth_height|.
+  glm::vec4 GetDepthIntrinsics(int depth_width, int depth_height) const {
+    if (camera_texture_size.x <= 0.f || camera_texture_size.y <= 0.f) {
+      return glm::vec4(0.f);
+    }
+    const glm::vec2 scale =
+        glm::vec2(depth_width, depth_height) / camera_texture_size;
+    return camera_texture_intrinsics *
+           glm::vec4(scale.x, scale.y, scale.x, scale.y);
+  }
+
+  glm::vec3 GetCameraPosition() const {
+    return glm::vec3(camera_pose_raw[4], camera_pose_raw[5],
+                     camera_pose_raw[6]);
+  }
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_FRAME_CONTEXT_H_
@@ -0,0 +1,108 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "frame_graph.h"
+
+#include <algorithm>
+#include <tuple>
+#include <utility>
+
+#include "util.h"
+
+namespace hello_ar {
+
+void FrameGraph::AddPass(Pass pass) { passes_.push_back(std::move(pass)); }
+
+void FrameGraph::Execute(const PassHook& hook) {
+  order_.clear();
+  for (int i = 0; i < static_cast<int>(passes_.size()); ++i) {
+    order_.push_back(i);
+  }
+  std::stable_sort(order_.begin(), order_.end(), [this](int a, int b) {
+    return RunsBefore(passes_[a], passes_[b]);
+  });
+
+  int state_changes = 0;
+  const PassState* previous_state = nullptr;
+  for (int index : order_) {
+    const Pass& pass = passes_[index];
+    if (previous_state != nullptr) {
+      state_changes += CountStateChanges(*previous_state, pass.state);
+    }
+    previous_state = &pass.state;
+
+    const std::function<void()> run = [&pass] {
+      ApplyState(pass.state);
+      pass.execute();
+    };
+    if (hook) {
+      hook(pass, run);
+    } else {
+      run();
+    }
+  }
+  state_changes_last_frame_ = state_changes;
+  passes_last_frame_ = static_cast<int>(order_.size());
+  passes_.clear();
+}
+
+void FrameGraph::ApplyState(const PassState& state) {
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
+  if (state.program != 0) {
+    gl_state.UseProgram(state.program);
+  }
+  gl_state.SetCapability(GL_DEPTH_TEST, state.depth_test);
+  gl_state.DepthMask(state.depth_write ? GL_TRUE : GL_FALSE);
+  gl_state.SetCapability(GL_CULL_FACE, state.cull_face);
+  switch (state.blend) {
+    case BlendMode::kNone:
+      gl_state.SetCapability(GL_BLEND, false);
+      break;
+    case BlendMode::kPremultipliedAlpha:
+      gl_state.SetCapability(GL_BLEND, true);
+      gl_state.BlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+      break;
+    case BlendMode::kAdditive:
+      gl_state.SetCapability(GL_BLEND, true);
+      gl_state.BlendFunc(GL_ONE, GL_ONE);
+      break;
+  }
+}
+
+int FrameGraph::CountStateChanges(const PassState& from, const PassState& to) {
+  return (from.program != to.program ? 1 : 0) +
+         (from.depth_test != to.depth_test ? 1 : 0) +
+         (from.depth_write != to.depth_write ? 1 : 0) +
+         (from.cull_face != to.cull_face ? 1 : 0) +
+         (from.blend != to.blend ? 1 : 0);
+}
+
+bool FrameGraph::RunsBefore(const Pass& a, const Pass& b) {
+  if (a.phase != b.phase) {
+    return a.phase < b.phase;
+  }
+  if (a.phase != Phase::kOpaque) {
+    return false;
+  }
+  // Program switches cost the most, then the blend and depth state.
+  const PassState& x = a.state;
+  const PassState& y = b.state;
+  return std::make_tuple(x.program, x.blend, x.depth_write, x.depth_test,
+                         x.cull_face) <
+         std::make_tuple(y.program, y.blend, y.depth_write, y.depth_test,
+                         y.cull_face);
+}
+
+}  // namespace hello_ar
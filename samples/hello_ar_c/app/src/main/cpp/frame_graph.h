@@ -0,0 +1,116 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef C_ARCORE_HELLOE_AR_FRAME_GRAPH_H_
+#define C_ARCORE_HELLOE_AR_FRAME_GRAPH_H_
+
+#include <GLES2/gl2.h>
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "frame_stage_timers.h"
+
+namespace hello_ar {
+
+// The draw passes of one frame, declared by the renderers with the fixed
+// function state they need and run in an order that keeps GL state changes
+// low.
+//
+// Passes are grouped by Phase.  Opaque passes go through the depth buffer and
+// may run in any order, so they are sorted by their state and program; passes
+// of the other phases blend over what is already drawn and keep the order
+// they were added in.  Before each pass the graph applies its PassState
+// through util::GlStateCache, which drops whatever is already set, so a pass
+// starts from its declared state no matter what the previous one left behind.
+//
+// Execute() hands every pass to a PassHook, e.g. to time it as a frame stage.
+// All calls must come from the GL thread.
+class FrameGraph {
+ public:
+  enum class Phase {
+    // The camera image, drawn before everything else.
+    kBackground = 0,
+    kOpaque,
+    kTransparent,
+    // Drawn last and in order, e.g. screen space effects.
+    kOverlay
+  };
+
+  enum class BlendMode { kNone, kPremultipliedAlpha, kAdditive };
+
+  struct PassState {
+    bool depth_test = true;
+    bool depth_write = true;
+    bool cull_face = true;
+    BlendMode blend = BlendMode::kNone;
+    // The program most of the pass draws with, used to sort passes.  Set by
+    // the pass itself if 0.
+    GLuint program = 0;
+  };
+
+  struct Pass {
+    const char* name = "";
+    Phase phase = Phase::kOpaque;
+    PassState state;
+    // The stage the pass is timed as.
+    FrameStage stage = FrameStage::kCount;
+    std::function<void()> execute;
+  };
+
+  // Runs |run|, which applies the state of |pass| and executes it.
+  using PassHook =
+      std::function<void(const Pass& pass, const std::function<void()>& run)>;
+
+  FrameGraph() = default;
+
+  FrameGraph(const FrameGraph&) = delete;
+  FrameGraph& operator=(const FrameGraph&) = delete;
+
+  void AddPass(Pass pass);
+
+  // Runs the passes added since the last call in their sorted order and
+  // removes them.  |hook| may be empty.
+  void Execute(const PassHook& hook);
+
+  // Number of PassState fields that differed between consecutive passes of
+  // the last Execute() call.
+  int GetStateChangesLastFrame() const { return state_changes_last_frame_; }
+
+  // Number of passes the last Execute() call ran.
+  int GetPassesLastFrame() const { return passes_last_frame_; }
+
+  // Sets |state| through util::GlStateCache.  Also used by RenderQueue for
+  // the draws within a pass.
+  static void ApplyState(const PassState& state);
+  // Number of fields that differ between |from| and |to|.
+  static int CountStateChanges(const PassState& from, const PassState& to);
+
+ private:
+  // Whether |a| runs before |b|.  Orders passes of a phase that keeps its
+  // insertion order as equal, which the stable sort preserves.
+  static bool RunsBefore(const Pass& a, const Pass& b);
+
+  std::vector<Pass> passes_;
+  // Indices into passes_ in execution order, kept to reuse the allocation.
+  std::vector<int> order_;
+  int state_changes_last_frame_ = 0;
+  int passes_last_frame_ = 0;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_FRAME_GRAPH_H_
@@ -0,0 +1,91 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "frame_image_cache.h"
+
+#include "arcore_trace.h"
+#include "resource_accounting.h"
+
+namespace hello_ar {
+
+constexpr int FrameImageCache::kNumImageTypes;
+
+FrameImageCache::~FrameImageCache() { ReleaseAll(); }
+
+void FrameImageCache::BeginFrame(ArSession* session, ArFrame* frame) {
+  ReleaseAll();
+  session_ = session;
+  frame_ = frame;
+  acquisitions_last_frame_ = acquisitions_this_frame_;
+  acquisitions_this_frame_ = 0;
+}
+
+void FrameImageCache::ReleaseAll() {
+  for (Entry& entry : entries_) {
+    if (entry.image != nullptr) {
+      ArImage_release(entry.image);
+      ResourceAccounting::Get().AddArHandles(ArHandleType::kImage, -1);
+    }
+    entry = Entry();
+  }
+}
+
+const ArImage* FrameImageCache::Get(ImageType type) {
+  Entry& entry = entries_[static_cast<int>(type)];
+  if (entry.acquired || session_ == nullptr) {
+    return entry.image;
+  }
+  entry.acquired = true;
+  ++acquisitions_this_frame_;
+
+  ArStatus status = AR_ERROR_NOT_YET_AVAILABLE;
+  switch (type) {
+    case ImageType::kCamera:
+      status = traced::ArFrame_acquireCameraImage(session_, frame_,
+                                                  &entry.image);
+      break;
+    case ImageType::kDepth:
+      status =
+          traced::ArFrame_acquireDepthImage16Bits(session_, frame_,
+                                                  &entry.image);
+      break;
+    case ImageType::kRawDepth:
+      status =
+          traced::ArFrame_acquireRawDepthImage16Bits(session_, frame_,
+                                                     &entry.image);
+      break;
+    case ImageType::kRawDepthConfidence:
+      status = traced::ArFrame_acquireRawDepthConfidenceImage(session_, frame_,
+                                                              &entry.image);
+      break;
+    case ImageType::kSemantic:
+      status = traced::ArFrame_acquireSemanticImage(session_, frame_,
+                                                    &entry.image);
+      break;
+    case ImageType::kSemanticConfidence:
+      status = traced::ArFrame_acquireSemanticConfidenceImage(session_, frame_,
+                                                              &entry.image);
+      break;
+  }
+  if (status != AR_SUCCESS) {
+    entry.image = nullptr;
+  } else {
+    ResourceAccounting::Get().AddArHandles(ArHandleType::kImage, 1);
+  }
+  return entry.image;
+}
+
+}  // namespace hello_ar
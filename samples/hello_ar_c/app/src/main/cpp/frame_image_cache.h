@@ -0,0 +1,89 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_FRAME_IMAGE_CACHE_H_
+#define C_ARCORE_HELLOE_AR_FRAME_IMAGE_CACHE_H_
+
+#include <array>
+
+#include "arcore_c_api.h"
+
+namespace hello_ar {
+
+// Images of the current frame, acquired at most once per ArSession_update
+// however many consumers read them, e.g. the depth texture upload, the
+// depth pyramid and TSDF fusion.
+//
+// Each image is acquired on first use and handed out as a borrowed
+// reference that stays valid until the next BeginFrame() or ReleaseAll().
+// A failed acquisition is remembered as well, so it is not retried within
+// the frame.  ARCore limits the number of camera images held at once and
+// requires them to be released before the camera config changes, so
+// ReleaseAll() must also be called before that and before the session is
+// paused or destroyed.
+//
+// Not thread safe; meant for the thread that calls ArSession_update.
+class FrameImageCache {
+ public:
+  enum class ImageType {
+    kCamera,
+    kDepth,
+    kRawDepth,
+    kRawDepthConfidence,
+    kSemantic,
+    kSemanticConfidence,
+  };
+
+  FrameImageCache() = default;
+  ~FrameImageCache();
+
+  FrameImageCache(const FrameImageCache&) = delete;
+  FrameImageCache& operator=(const FrameImageCache&) = delete;
+
+  // Releases the images of the previous frame.  Must be called before each
+  // ArSession_update of |frame|.
+  void BeginFrame(ArSession* session, ArFrame* frame);
+
+  // Releases every image acquired since BeginFrame().
+  void ReleaseAll();
+
+  // The image of |type| of the current frame, or nullptr if the frame has
+  // none, e.g. while depth or semantics are off.
+  const ArImage* Get(ImageType type);
+
+  // Number of ArFrame_acquire* calls during the previous frame, at most one
+  // per image type.
+  int GetAcquisitionsLastFrame() const { return acquisitions_last_frame_; }
+
+ private:
+  static constexpr int kNumImageTypes =
+      static_cast<int>(ImageType::kSemanticConfidence) + 1;
+
+  struct Entry {
+    ArImage* image = nullptr;
+    bool acquired = false;
+  };
+
+  ArSession* session_ = nullptr;
+  ArFrame* frame_ = nullptr;
+  std::array<Entry, kNumImageTypes> entries_ = {};
+  int acquisitions_this_frame_ = 0;
+  int acquisitions_last_frame_ = 0;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_FRAME_IMAGE_CACHE_H_
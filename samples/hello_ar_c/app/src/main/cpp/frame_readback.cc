@@ -0,0 +1,222 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "frame_readback.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "resource_accounting.h"
+#include "util.h"
+
+namespace hello_ar {
+namespace {
+constexpr char kOwner[] = "FrameReadback";
+constexpr int kBytesPerPixel = 4;
+}  // namespace
+
+constexpr int FrameReadback::kNumBuffers;
+constexpr int FrameReadback::kMapLatencyFrames;
+
+FrameReadback::~FrameReadback() {
+  // Release() or Reset() must have run; the consumers may still read the
+  // mapped buffers otherwise.
+  WaitForConsumers();
+}
+
+bool FrameReadback::Capture(int width, int height, float scale,
+                            int64_t timestamp_ns, Consumer consumer) {
+  auto free_buffer =
+      std::find_if(buffers_.begin(), buffers_.end(), [](const Buffer& buffer) {
+        return buffer.state == State::kFree;
+      });
+  if (free_buffer == buffers_.end() || width <= 0 || height <= 0) {
+    ++dropped_count_;
+    return false;
+  }
+  Buffer& buffer = *free_buffer;
+  scale = std::min(std::max(scale, 0.f), 1.f);
+  buffer.width = std::max(1, static_cast<int>(width * scale));
+  buffer.height = std::max(1, static_cast<int>(height * scale));
+  const size_t size =
+      static_cast<size_t>(buffer.width) * buffer.height * kBytesPerPixel;
+
+  if (buffer.pbo == 0) {
+    glGenBuffers(1, &buffer.pbo);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.pbo);
+  if (buffer.capacity != size) {
+    glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+    buffer.capacity = size;
+    ResourceAccounting::Get().Track(GpuResourceType::kBuffer, buffer.pbo,
+                                    size, kOwner);
+  }
+
+  const bool scaled = buffer.width != width || buffer.height != height;
+  if (scaled) {
+    ResizeScaledFramebuffer(buffer.width, buffer.height);
+    // The blit is clipped by the scissor, glReadPixels is not.
+    util::GlStateCache::Get().SetCapability(GL_SCISSOR_TEST, false);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, scaled_framebuffer_);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, buffer.width, buffer.height,
+                      GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, scaled_framebuffer_);
+  } else {
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+  }
+  // Into the bound pack buffer, so this only queues the copy.  Rows of RGBA
+  // pixels meet the default pack alignment.
+  glReadPixels(0, 0, buffer.width, buffer.height, GL_RGBA, GL_UNSIGNED_BYTE,
+               nullptr);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+  buffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  buffer.state = State::kPending;
+  buffer.timestamp_ns = timestamp_ns;
+  buffer.capture_frame = frame_;
+  buffer.consumer = std::move(consumer);
+  return true;
+}
+
+void FrameReadback::Update() {
+  ++frame_;
+  for (Buffer& buffer : buffers_) {
+    if (buffer.state == State::kConsuming && buffer.counter.IsDone()) {
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.pbo);
+      glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+      buffer.consumer = nullptr;
+      buffer.state = State::kFree;
+      ++delivered_count_;
+    }
+    if (buffer.state != State::kPending ||
+        frame_ - buffer.capture_frame < kMapLatencyFrames) {
+      continue;
+    }
+    // Flushes nothing and never waits; a late buffer is tried again in the
+    // next frame.
+    if (glClientWaitSync(buffer.fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+      continue;
+    }
+    glDeleteSync(buffer.fence);
+    buffer.fence = nullptr;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.pbo);
+    const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+                                          buffer.capacity, GL_MAP_READ_BIT);
+    if (pixels == nullptr) {
+      LOGE("FrameReadback: glMapBufferRange error 0x%x", glGetError());
+      buffer.consumer = nullptr;
+      buffer.state = State::kFree;
+      ++dropped_count_;
+      continue;
+    }
+    Image image;
+    image.pixels = static_cast<const uint8_t*>(pixels);
+    image.width = buffer.width;
+    image.height = buffer.height;
+    image.timestamp_ns = buffer.timestamp_ns;
+    buffer.state = State::kConsuming;
+    Buffer* consumed = &buffer;
+    util::JobSystem::Get().Submit(
+        [consumed, image] { consumed->consumer(image); }, &buffer.counter);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void FrameReadback::Release() {
+  WaitForConsumers();
+  for (Buffer& buffer : buffers_) {
+    if (buffer.state == State::kConsuming) {
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.pbo);
+      glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    if (buffer.fence != nullptr) {
+      glDeleteSync(buffer.fence);
+    }
+    if (buffer.pbo != 0) {
+      ResourceAccounting::Get().Untrack(GpuResourceType::kBuffer, buffer.pbo);
+      glDeleteBuffers(1, &buffer.pbo);
+    }
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  if (scaled_framebuffer_ != 0) {
+    glDeleteFramebuffers(1, &scaled_framebuffer_);
+  }
+  if (scaled_renderbuffer_ != 0) {
+    ResourceAccounting::Get().Untrack(GpuResourceType::kRenderbuffer,
+                                      scaled_renderbuffer_);
+    glDeleteRenderbuffers(1, &scaled_renderbuffer_);
+  }
+  Reset();
+}
+
+void FrameReadback::Reset() {
+  WaitForConsumers();
+  for (Buffer& buffer : buffers_) {
+    buffer.pbo = 0;
+    buffer.capacity = 0;
+    buffer.fence = nullptr;
+    buffer.state = State::kFree;
+    buffer.consumer = nullptr;
+  }
+  scaled_framebuffer_ = 0;
+  scaled_renderbuffer_ = 0;
+  scaled_width_ = 0;
+  scaled_height_ = 0;
+}
+
+std::string FrameReadback::GetReport() const {
+  char text[96];
+  snprintf(text, sizeof(text), "%lld frames delivered, %lld dropped",
+           static_cast<long long>(delivered_count_),
+           static_cast<long long>(dropped_count_));
+  return text;
+}
+
+void FrameReadback::ResizeScaledFramebuffer(int width, int height) {
+  if (scaled_framebuffer_ == 0) {
+    glGenFramebuffers(1, &scaled_framebuffer_);
+    glGenRenderbuffers(1, &scaled_renderbuffer_);
+  }
+  if (width == scaled_width_ && height == scaled_height_) {
+    return;
+  }
+  scaled_width_ = width;
+  scaled_height_ = height;
+  glBindRenderbuffer(GL_RENDERBUFFER, scaled_renderbuffer_);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+  ResourceAccounting::Get().Track(GpuResourceType::kRenderbuffer,
+                                  scaled_renderbuffer_,
+                                  GetTextureBytes(GL_RGBA8, width, height),
+                                  kOwner);
+  glBindFramebuffer(GL_FRAMEBUFFER, scaled_framebuffer_);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                            GL_RENDERBUFFER, scaled_renderbuffer_);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void FrameReadback::WaitForConsumers() {
+  for (Buffer& buffer : buffers_) {
+    if (buffer.state == State::kConsuming) {
+      util::JobSystem::Get().Wait(&buffer.counter);
+    }
+  }
+}
+
+}  // namespace hello_ar
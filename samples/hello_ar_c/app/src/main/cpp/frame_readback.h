@@ -0,0 +1,122 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_FRAME_READBACK_H_
+#define C_ARCORE_HELLOE_AR_FRAME_READBACK_H_
+
+#include <GLES3/gl3.h>
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "job_system.h"
+
+namespace hello_ar {
+
+// Reads the composited frame back to the CPU without stalling the OpenGL
+// thread on glReadPixels, e.g. for screenshots or streaming to a remote
+// assistant.
+//
+// Capture() issues glReadPixels of the surface into one of a ring of pixel
+// pack buffers, optionally blitting it to a smaller framebuffer first, and
+// fences it.  Update() maps the buffer once kMapLatencyFrames frames passed
+// and the fence signaled, and hands the pixels to the consumer on a worker
+// of util::JobSystem.  The buffer stays mapped, without a copy, until the
+// consumer returned.  Captures while every buffer is in use are dropped.
+//
+// Must be used on the OpenGL thread.
+class FrameReadback {
+ public:
+  struct Image {
+    // RGBA, tightly packed rows, the bottom row first like glReadPixels.
+    const uint8_t* pixels = nullptr;
+    int width = 0;
+    int height = 0;
+    int64_t timestamp_ns = 0;
+  };
+
+  // Runs on a worker thread.  |image| is only valid during the call.
+  using Consumer = std::function<void(const Image& image)>;
+
+  static constexpr int kNumBuffers = 3;
+  // Frames from a capture until its buffer is mapped, enough for the GPU to
+  // have finished it in a pipelined frame loop.
+  static constexpr int kMapLatencyFrames = 2;
+
+  FrameReadback() = default;
+  ~FrameReadback();
+
+  FrameReadback(const FrameReadback&) = delete;
+  FrameReadback& operator=(const FrameReadback&) = delete;
+
+  // Queues a read back of the |width| x |height| surface, framebuffer 0, as
+  // drawn so far, scaled by |scale| in (0, 1], for |consumer|.  Returns
+  // false if the capture was dropped.  Leaves framebuffer 0 bound.
+  bool Capture(int width, int height, float scale, int64_t timestamp_ns,
+               Consumer consumer);
+
+  // Hands the captures that are done to their consumers and unmaps the
+  // buffers whose consumers returned.  Called once per frame.
+  void Update();
+
+  // Waits for the consumers and deletes the GL objects.  Must be called
+  // with the context current.
+  void Release();
+
+  // Waits for the consumers and forgets the GL objects, which went away
+  // with the previous context.
+  void Reset();
+
+  // Captures delivered and dropped.
+  std::string GetReport() const;
+
+ private:
+  enum class State { kFree, kPending, kConsuming };
+
+  struct Buffer {
+    GLuint pbo = 0;
+    size_t capacity = 0;
+    GLsync fence = nullptr;
+    State state = State::kFree;
+    int width = 0;
+    int height = 0;
+    int64_t timestamp_ns = 0;
+    int64_t capture_frame = 0;
+    Consumer consumer;
+    // The consumer job of kConsuming.
+    util::JobCounter counter;
+  };
+
+  // Ensures the framebuffer Capture() scales into is |width| x |height|.
+  void ResizeScaledFramebuffer(int width, int height);
+  void WaitForConsumers();
+
+  std::array<Buffer, kNumBuffers> buffers_;
+  GLuint scaled_framebuffer_ = 0;
+  GLuint scaled_renderbuffer_ = 0;
+  int scaled_width_ = 0;
+  int scaled_height_ = 0;
+
+  int64_t frame_ = 0;
+  int64_t delivered_count_ = 0;
+  int64_t dropped_count_ = 0;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_FRAME_READBACK_H_
@@ -0,0 +1,116 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "frame_stage_timers.h"
+
+#include <android/trace.h>
+
+#include <algorithm>
+
+#include "gpu_stage_timers.h"
+
+namespace hello_ar {
+namespace {
+constexpr const char* kFrameStageNames[kNumFrameStages] = {
+    "HelloAr::ArSession_update", "HelloAr::Background",
+    "HelloAr::DepthUpload",      "HelloAr::Planes",
+    "HelloAr::Anchors",          "HelloAr::PointCloud"};
+
+constexpr float kNanosecondsPerMillisecond = 1e6f;
+}  // namespace
+
+const char* GetFrameStageName(FrameStage stage) {
+  return kFrameStageNames[static_cast<int>(stage)];
+}
+
+void FrameStageTimers::Record(FrameStage stage,
+                              std::chrono::nanoseconds duration) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Window& window = windows_[static_cast<int>(stage)];
+  window.samples_ns[window.next] = duration.count();
+  window.next = (window.next + 1) % kWindowSize;
+  window.count = std::min(window.count + 1, kWindowSize);
+  frame_durations_[static_cast<int>(stage)] += duration;
+}
+
+void FrameStageTimers::BeginFrame() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  frame_durations_.fill(std::chrono::nanoseconds::zero());
+}
+
+std::array<std::chrono::nanoseconds, kNumFrameStages>
+FrameStageTimers::GetFrameDurations() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return frame_durations_;
+}
+
+std::array<FrameStageTimers::Summary, kNumFrameStages>
+FrameStageTimers::GetSummaries() const {
+  std::array<Summary, kNumFrameStages> summaries;
+  std::array<int64_t, kWindowSize> sorted;
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (int i = 0; i < kNumFrameStages; ++i) {
+    const Window& window = windows_[i];
+    if (window.count == 0) {
+      continue;
+    }
+    // Before the window wrapped the samples are its prefix; afterwards all
+    // of it is valid, so the prefix is always the right range.
+    std::copy(window.samples_ns.begin(),
+              window.samples_ns.begin() + window.count, sorted.begin());
+    int64_t sum_ns = 0;
+    for (int j = 0; j < window.count; ++j) {
+      sum_ns += sorted[j];
+    }
+    const int p95_index = (window.count - 1) * 95 / 100;
+    std::nth_element(sorted.begin(), sorted.begin() + p95_index,
+                     sorted.begin() + window.count);
+
+    Summary& summary = summaries[i];
+    summary.p95_ms = sorted[p95_index] / kNanosecondsPerMillisecond;
+    summary.min_ms =
+        *std::min_element(sorted.begin(), sorted.begin() + p95_index + 1) /
+        kNanosecondsPerMillisecond;
+    summary.avg_ms = sum_ns / window.count / kNanosecondsPerMillisecond;
+    summary.sample_count = window.count;
+  }
+  return summaries;
+}
+
+ScopedFrameStageTimer::ScopedFrameStageTimer(FrameStageTimers* timers,
+                                             FrameStage stage,
+                                             GpuStageTimers* gpu_timers)
+    : timers_(timers),
+      stage_(stage),
+      gpu_timers_(gpu_timers),
+      start_(std::chrono::steady_clock::now()) {
+  ATrace_beginSection(GetFrameStageName(stage));
+  if (gpu_timers_ != nullptr) {
+    gpu_timers_->BeginStage(stage);
+  }
+}
+
+ScopedFrameStageTimer::~ScopedFrameStageTimer() {
+  if (gpu_timers_ != nullptr) {
+    gpu_timers_->EndStage(stage_);
+  }
+  ATrace_endSection();
+  if (timers_ != nullptr) {
+    timers_->Record(stage_, std::chrono::steady_clock::now() - start_);
+  }
+}
+
+}  // namespace hello_ar
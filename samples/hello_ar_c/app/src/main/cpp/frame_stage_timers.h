@@ -0,0 +1,113 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_FRAME_STAGE_TIMERS_H_
+#define C_ARCORE_HELLOE_AR_FRAME_STAGE_TIMERS_H_
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+namespace hello_ar {
+
+class GpuStageTimers;
+
+// Stages of OnDrawFrame that are timed.  The order is also the order of the
+// values returned to Java, so new stages go last.
+enum class FrameStage {
+  kArUpdate = 0,
+  kBackground,
+  kDepthUpload,
+  kPlanes,
+  kAnchors,
+  kPointCloud,
+  kCount
+};
+
+constexpr int kNumFrameStages = static_cast<int>(FrameStage::kCount);
+
+// Returns the name used for the stage's systrace section.
+const char* GetFrameStageName(FrameStage stage);
+
+// Rolling duration statistics for each frame stage.  Record() may be called
+// from any thread, e.g. from the AR update thread for kArUpdate.
+class FrameStageTimers {
+ public:
+  // Number of most recent samples the statistics are computed over.
+  static constexpr int kWindowSize = 240;
+
+  struct Summary {
+    float min_ms = 0.f;
+    float avg_ms = 0.f;
+    float p95_ms = 0.f;
+    // Number of samples in the window, 0 if the stage never ran.
+    int sample_count = 0;
+  };
+
+  FrameStageTimers() = default;
+
+  FrameStageTimers(const FrameStageTimers&) = delete;
+  FrameStageTimers& operator=(const FrameStageTimers&) = delete;
+
+  void Record(FrameStage stage, std::chrono::nanoseconds duration);
+
+  // Computes the statistics of every stage, indexed by FrameStage.
+  std::array<Summary, kNumFrameStages> GetSummaries() const;
+
+  // Restarts the per-frame totals returned by GetFrameDurations().
+  void BeginFrame();
+
+  // Time spent in each stage since the last BeginFrame(), indexed by
+  // FrameStage.  Stages that did not run read zero.
+  std::array<std::chrono::nanoseconds, kNumFrameStages> GetFrameDurations()
+      const;
+
+ private:
+  struct Window {
+    std::array<int64_t, kWindowSize> samples_ns = {};
+    int next = 0;
+    int count = 0;
+  };
+
+  mutable std::mutex mutex_;
+  std::array<Window, kNumFrameStages> windows_;
+  std::array<std::chrono::nanoseconds, kNumFrameStages> frame_durations_ = {};
+};
+
+// Times its scope as one sample of |stage| and marks it as a systrace section.
+// |timers| may be null, in which case only the trace section is emitted.  If
+// |gpu_timers| is set, the GL commands issued in the scope are timed on the GPU
+// as well, so it must only be set on the GL thread.
+class ScopedFrameStageTimer {
+ public:
+  ScopedFrameStageTimer(FrameStageTimers* timers, FrameStage stage,
+                        GpuStageTimers* gpu_timers = nullptr);
+  ~ScopedFrameStageTimer();
+
+  ScopedFrameStageTimer(const ScopedFrameStageTimer&) = delete;
+  ScopedFrameStageTimer& operator=(const ScopedFrameStageTimer&) = delete;
+
+ private:
+  FrameStageTimers* const timers_;
+  const FrameStage stage_;
+  GpuStageTimers* const gpu_timers_;
+  const std::chrono::steady_clock::time_point start_;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_FRAME_STAGE_TIMERS_H_
@@ -0,0 +1,269 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "frame_telemetry.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstring>
+
+#include "flat_table.h"
+#include "util.h"
+
+namespace hello_ar {
+
+constexpr uint16_t FrameTelemetryLog::kVersion;
+constexpr uint32_t FrameTelemetryLog::kMagic;
+constexpr uint32_t FrameTelemetryLog::kCapacity;
+constexpr std::chrono::milliseconds FrameTelemetryLog::kFlushInterval;
+constexpr uint32_t FrameTelemetryLog::kQueueCapacity;
+constexpr uint8_t FrameTelemetryRecord::kFlagReplayed;
+constexpr uint8_t FrameTelemetryRecord::kFlagRecorded;
+constexpr uint8_t FrameTelemetryLog::kTrackVersion;
+
+// Random UUID of the track.
+const uint8_t FrameTelemetryLog::kTrackId[16] = {
+    0x5b, 0x2e, 0x0c, 0x91, 0x7a, 0x43, 0x4e, 0x1d,
+    0x9f, 0x36, 0xc8, 0x52, 0x0e, 0xa7, 0x64, 0xb3};
+const char FrameTelemetryLog::kMimeType[] =
+    "application/x-hello-ar-frame-telemetry";
+const char FrameTelemetryLog::kTrackIdentifier[] = "FTL2";
+
+namespace {
+// FlatTable fields of the track payloads.  New fields go last.
+enum TrackField {
+  kTimestampField = 0,
+  kFrameIndexField,
+  kFrameUsField,
+  kStageUsField,
+  kPlaneCountField,
+  kAnchorCountField,
+  kTrackingStateField,
+  kThermalStatusField,
+  kQualityLevelField,
+  kHitTestQueriesField,
+  kHitTestCallsField,
+  kNumTrackFields
+};
+
+// Room for every field of a FrameTelemetryRecord, with the table overhead.
+constexpr size_t kMaxTrackPayloadSize = 144 + 4 * kNumFrameStages;
+
+// Size of the raw records of version 1 payloads.
+constexpr size_t kVersion1RecordSize =
+    offsetof(FrameTelemetryRecord, hit_test_queries);
+}  // namespace
+
+FrameTelemetryLog::~FrameTelemetryLog() { Stop(); }
+
+bool FrameTelemetryLog::Start(const std::string& path) {
+  Stop();
+  fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd_ < 0) {
+    LOGE("FrameTelemetryLog: cannot create %s", path.c_str());
+    return false;
+  }
+  mapping_size_ =
+      sizeof(FileHeader) + kCapacity * sizeof(FrameTelemetryRecord);
+  if (ftruncate(fd_, mapping_size_) != 0) {
+    LOGE("FrameTelemetryLog: cannot size %s", path.c_str());
+    Stop();
+    return false;
+  }
+  void* mapping = mmap(nullptr, mapping_size_, PROT_READ | PROT_WRITE,
+                       MAP_SHARED, fd_, 0);
+  if (mapping == MAP_FAILED) {
+    LOGE("FrameTelemetryLog: cannot map %s", path.c_str());
+    Stop();
+    return false;
+  }
+  mapping_ = mapping;
+  header_ = static_cast<FileHeader*>(mapping_);
+  header_->magic = kMagic;
+  header_->version = kVersion;
+  header_->record_size = sizeof(FrameTelemetryRecord);
+  header_->capacity = kCapacity;
+  header_->dropped_count = 0;
+  header_->record_count = 0;
+  records_ = reinterpret_cast<FrameTelemetryRecord*>(
+      static_cast<uint8_t*>(mapping_) + sizeof(FileHeader));
+
+  // Records pushed after the previous Stop() belong to no file.
+  FrameTelemetryRecord stale;
+  while (queue_.TryPop(&stale)) {
+  }
+  dropped_count_ = 0;
+  stopping_ = false;
+  flush_thread_ = std::thread(&FrameTelemetryLog::RunFlushLoop, this);
+  LOGI("FrameTelemetryLog: logging to %s", path.c_str());
+  return true;
+}
+
+void FrameTelemetryLog::Stop() {
+  if (flush_thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    wake_.notify_one();
+    flush_thread_.join();
+    // Records pushed while the thread stopped.
+    Flush();
+    LOGI("FrameTelemetryLog: %llu records, %u dropped",
+         static_cast<unsigned long long>(header_->record_count),
+         header_->dropped_count);
+  }
+  if (mapping_ != nullptr) {
+    msync(mapping_, mapping_size_, MS_SYNC);
+    munmap(mapping_, mapping_size_);
+    mapping_ = nullptr;
+  }
+  header_ = nullptr;
+  records_ = nullptr;
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+  track_reader_.Release();
+}
+
+void FrameTelemetryLog::Push(const FrameTelemetryRecord& record) {
+  FrameTelemetryRecord copy = record;
+  if (!queue_.TryPush(&copy)) {
+    dropped_count_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void FrameTelemetryLog::AddTrack(const ArSession* session,
+                                 ArRecordingConfig* recording_config) {
+  ArTrack* track = nullptr;
+  ArTrack_create(session, &track);
+  ArTrack_setId(session, track, kTrackId);
+  ArTrack_setMimeType(session, track, kMimeType);
+  // Lets tools check the layout before parsing the samples.
+  const uint8_t metadata[] = {kTrackVersion,
+                              static_cast<uint8_t>(kNumTrackFields)};
+  ArTrack_setMetadata(session, track, metadata, sizeof(metadata));
+  ArRecordingConfig_addTrack(session, recording_config, track);
+  ArTrack_destroy(track);
+}
+
+bool FrameTelemetryLog::RecordTrackData(ArSession* session,
+                                        const ArFrame* frame,
+                                        const FrameTelemetryRecord& record) {
+  ArRecordingStatus status = AR_RECORDING_NONE;
+  ArSession_getRecordingStatus(session, &status);
+  if (status != AR_RECORDING_OK) {
+    return false;
+  }
+  uint8_t payload[kMaxTrackPayloadSize];
+  FlatTableBuilder builder(payload, sizeof(payload), kTrackIdentifier,
+                           kNumTrackFields);
+  builder.Add(kTimestampField, record.timestamp_ns);
+  builder.Add(kFrameIndexField, record.frame_index);
+  builder.Add(kFrameUsField, record.frame_us);
+  builder.AddArray(kStageUsField, record.stage_us, kNumFrameStages);
+  builder.Add(kPlaneCountField, record.plane_count);
+  builder.Add(kAnchorCountField, record.anchor_count);
+  builder.Add(kTrackingStateField, record.tracking_state);
+  builder.Add(kThermalStatusField, record.thermal_status);
+  builder.Add(kQualityLevelField, record.quality_level);
+  builder.Add(kHitTestQueriesField, record.hit_test_queries);
+  builder.Add(kHitTestCallsField, record.hit_test_calls);
+  const size_t payload_size = builder.Finish();
+  // Fails for the odd frame while ARCore is under load; that frame's record
+  // is only in the log then.
+  return payload_size > 0 &&
+         ArFrame_recordTrackData(session, frame, kTrackId, payload,
+                                 payload_size) == AR_SUCCESS;
+}
+
+bool FrameTelemetryLog::DecodeTrackPayload(const uint8_t* data, size_t size,
+                                           FrameTelemetryRecord* record) {
+  FlatTable table;
+  if (!FlatTable::Parse(data, size, kTrackIdentifier, &table)) {
+    // Version 1 datasets.
+    if (size != kVersion1RecordSize) {
+      return false;
+    }
+    *record = {};
+    memcpy(record, data, kVersion1RecordSize);
+    return true;
+  }
+  *record = {};
+  record->timestamp_ns = table.Get<int64_t>(kTimestampField, 0);
+  record->frame_index = table.Get<uint32_t>(kFrameIndexField, 0);
+  record->frame_us = table.Get<uint32_t>(kFrameUsField, 0);
+  const FlatTable::Array<uint32_t> stage_us =
+      table.GetArray<uint32_t>(kStageUsField);
+  // Stages recorded by another version line up as far as they match.
+  for (uint32_t i = 0; i < stage_us.size && i < kNumFrameStages; ++i) {
+    record->stage_us[i] = stage_us[i];
+  }
+  record->plane_count = table.Get<uint16_t>(kPlaneCountField, 0);
+  record->anchor_count = table.Get<uint16_t>(kAnchorCountField, 0);
+  record->tracking_state = table.Get<int8_t>(kTrackingStateField, 0);
+  record->thermal_status = table.Get<int8_t>(kThermalStatusField, 0);
+  record->quality_level = table.Get<uint8_t>(kQualityLevelField, 0);
+  record->hit_test_queries = table.Get<uint32_t>(kHitTestQueriesField, 0);
+  record->hit_test_calls = table.Get<uint32_t>(kHitTestCallsField, 0);
+  return true;
+}
+
+int FrameTelemetryLog::ReplayTrackData(const ArSession* session,
+                                       const ArFrame* frame) {
+  const int payload_count = track_reader_.Read(session, frame, kTrackId);
+  int replayed = 0;
+  for (int i = 0; i < payload_count; ++i) {
+    const TrackDataReader::Payload& payload = track_reader_.GetPayload(i);
+    FrameTelemetryRecord record;
+    if (DecodeTrackPayload(payload.data, payload.size, &record)) {
+      record.flags |= FrameTelemetryRecord::kFlagReplayed;
+      Push(record);
+      ++replayed;
+    }
+  }
+  // The payloads are not needed past this frame.
+  track_reader_.ReleasePayloads();
+  return replayed;
+}
+
+void FrameTelemetryLog::RunFlushLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stopping_) {
+    wake_.wait_for(lock, kFlushInterval, [this] { return stopping_; });
+    lock.unlock();
+    Flush();
+    lock.lock();
+  }
+}
+
+void FrameTelemetryLog::Flush() {
+  uint64_t count = header_->record_count;
+  FrameTelemetryRecord record;
+  while (queue_.TryPop(&record)) {
+    records_[count % kCapacity] = record;
+    ++count;
+  }
+  // The count is stored after the records, so a reader of a file whose
+  // writer died never counts a slot that was not written yet.
+  header_->record_count = count;
+  header_->dropped_count = dropped_count_.load(std::memory_order_relaxed);
+}
+
+}  // namespace hello_ar
@@ -0,0 +1,189 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_FRAME_TELEMETRY_H_
+#define C_ARCORE_HELLOE_AR_FRAME_TELEMETRY_H_
+
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>  // NOLINT
+#include <string>
+#include <thread>  // NOLINT
+#include <type_traits>
+
+#include "arcore_c_api.h"
+#include "frame_stage_timers.h"
+#include "spsc_queue.h"
+#include "track_data_reader.h"
+
+namespace hello_ar {
+
+// What the app and ARCore did in one frame, in the binary layout of the
+// telemetry file and of the recorded track data.  Fields are ordered so the
+// struct has no padding; new fields go last and bump kVersion.
+struct FrameTelemetryRecord {
+  // Set on records read back from the track data of a played back dataset,
+  // as opposed to records of the frames drawn now.
+  static constexpr uint8_t kFlagReplayed = 1 << 0;
+  // Set if the record was also embedded into an ARCore recording.
+  static constexpr uint8_t kFlagRecorded = 1 << 1;
+
+  // Camera timestamp of the frame, see ArFrame_getTimestamp.
+  int64_t timestamp_ns;
+  // Counts the records of a log from 0.
+  uint32_t frame_index;
+  // Time the app spent on the frame, and the part of it in each FrameStage.
+  uint32_t frame_us;
+  uint32_t stage_us[kNumFrameStages];
+  // Planes in the session and anchors in the AnchorStore.
+  uint16_t plane_count;
+  uint16_t anchor_count;
+  // ArTrackingState of the camera and AThermalStatus of the device.
+  int8_t tracking_state;
+  int8_t thermal_status;
+  // Quality level of the ThermalGovernor.
+  uint8_t quality_level;
+  uint8_t flags;
+  // Hit tests asked of the HitTestCache, and ARCore calls they took.
+  uint32_t hit_test_queries;
+  uint32_t hit_test_calls;
+};
+
+static_assert(std::is_trivially_copyable<FrameTelemetryRecord>::value,
+              "records are written as raw bytes");
+static_assert(sizeof(FrameTelemetryRecord) == 32 + 4 * kNumFrameStages,
+              "FrameTelemetryRecord must not have padding");
+
+// Logs one FrameTelemetryRecord per frame into a memory-mapped file, to line
+// up frame time spikes with the state of the session after a field test.
+//
+// Push() only copies the record into a lock-free queue, so the OpenGL thread
+// never touches the file.  A flush thread wakes every kFlushInterval and
+// moves the queued records into the mapping, which the kernel writes back on
+// its own.  The file is a FileHeader followed by a ring of kCapacity
+// records: record n is at slot n % kCapacity and the header counts the
+// records written, so a long session keeps its last kCapacity frames.
+// Records are dropped and counted if the queue is full.
+//
+// While an ARCore recording is running, RecordTrackData() embeds the record
+// in the dataset as well, on the track SessionCapture adds with AddTrack().
+// ReplayTrackData() reads those records back during playback, so a recorded
+// session brings its original telemetry along.  The track stores each record
+// as a FlatTable with one field per record member, so fields can be added
+// without breaking older datasets, and payloads are decoded where ARCore
+// keeps them.
+//
+// All methods except Push() must be called on the same thread, which must
+// also be the one that calls Push().
+class FrameTelemetryLog {
+ public:
+  // File layout version, see FileHeader.  Version 2 added the hit test
+  // counts.
+  static constexpr uint16_t kVersion = 2;
+  static constexpr uint32_t kMagic = 0x4d4c5446;  // "FTLM"
+  static constexpr uint32_t kCapacity = 1 << 16;
+  static constexpr std::chrono::milliseconds kFlushInterval{50};
+  // Identify the track of the records in ARCore datasets.
+  static const uint8_t kTrackId[16];
+  static const char kMimeType[];
+  // Layout version of the track's payloads, in the track metadata.  Version
+  // 1 stored the raw FrameTelemetryRecord up to |flags|, which is still read
+  // back.
+  static constexpr uint8_t kTrackVersion = 2;
+  // FlatTable identifier of the payloads.
+  static const char kTrackIdentifier[];
+
+  // Start of the telemetry file.
+  struct FileHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t capacity;
+    // Records lost because the flush thread fell behind.
+    uint32_t dropped_count;
+    // Records written since Start(), including the overwritten ones.
+    uint64_t record_count;
+  };
+
+  FrameTelemetryLog() = default;
+  ~FrameTelemetryLog();
+
+  FrameTelemetryLog(const FrameTelemetryLog&) = delete;
+  FrameTelemetryLog& operator=(const FrameTelemetryLog&) = delete;
+
+  // Creates or truncates |path| and starts the flush thread.  Returns false
+  // if the file cannot be created or mapped.
+  bool Start(const std::string& path);
+
+  // Flushes the queued records and closes the file.
+  void Stop();
+
+  bool IsRunning() const { return records_ != nullptr; }
+
+  // Queues |record| for the flush thread.
+  void Push(const FrameTelemetryRecord& record);
+
+  // Adds the telemetry track to |recording_config|.
+  static void AddTrack(const ArSession* session,
+                       ArRecordingConfig* recording_config);
+
+  // Embeds |record| in the recording of |session| on |frame|, which must be
+  // the current frame.  Returns false if the session is not recording.
+  static bool RecordTrackData(ArSession* session, const ArFrame* frame,
+                              const FrameTelemetryRecord& record);
+
+  // Pushes the records of the telemetry track that |session| played back
+  // with |frame|, flagged as replayed.  Returns the number of records.
+  int ReplayTrackData(const ArSession* session, const ArFrame* frame);
+
+  // Decodes one payload of the telemetry track, in either layout version.
+  // Returns false if it is neither.
+  static bool DecodeTrackPayload(const uint8_t* data, size_t size,
+                                 FrameTelemetryRecord* record);
+
+ private:
+  static constexpr uint32_t kQueueCapacity = 256;
+
+  // Runs on flush_thread_.
+  void RunFlushLoop();
+
+  // Moves the queued records into the mapping.
+  void Flush();
+
+  SpscQueue<FrameTelemetryRecord, kQueueCapacity> queue_;
+  std::atomic<uint32_t> dropped_count_{0};
+
+  int fd_ = -1;
+  void* mapping_ = nullptr;
+  size_t mapping_size_ = 0;
+  FileHeader* header_ = nullptr;
+  FrameTelemetryRecord* records_ = nullptr;
+
+  // Reused by ReplayTrackData().
+  TrackDataReader track_reader_;
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  bool stopping_ = false;
+  std::thread flush_thread_;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_FRAME_TELEMETRY_H_
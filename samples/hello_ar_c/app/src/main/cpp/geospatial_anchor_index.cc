@@ -0,0 +1,226 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "geospatial_anchor_index.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+namespace hello_ar {
+namespace {
+// WGS84 ellipsoid.
+constexpr double kSemiMajorAxisM = 6378137.0;
+constexpr double kEccentricitySquared = 6.69437999014e-3;
+constexpr double kRadiansPerDegree = M_PI / 180.0;
+
+// Cells 2^21 apart share a key, more than the diameter of the Earth for
+// cells of 10 m and up.
+constexpr int kCellCoordinateBits = 21;
+constexpr uint64_t kCellCoordinateMask = (1ull << kCellCoordinateBits) - 1;
+}  // namespace
+
+constexpr double GeospatialAnchorIndex::kNearRadiusM;
+constexpr double GeospatialAnchorIndex::kViewRadiusM;
+constexpr double GeospatialAnchorIndex::kConeHalfAngleDegrees;
+
+GeospatialAnchorIndex::GeospatialAnchorIndex(double cell_size_m,
+                                             int far_refreshes_per_frame)
+    : cell_size_m_(cell_size_m),
+      far_refreshes_per_frame_(far_refreshes_per_frame) {}
+
+void GeospatialAnchorIndex::Add(AnchorStore::Handle handle, double latitude,
+                                double longitude, double altitude_m) {
+  Item item;
+  item.handle = handle;
+  item.ecef = ToEcef(latitude, longitude, altitude_m);
+  item.cell_key = GetCellKey(GetCellCoordinates(item.ecef));
+  cells_[item.cell_key].push_back(static_cast<uint32_t>(items_.size()));
+  items_.push_back(item);
+}
+
+void GeospatialAnchorIndex::Update(const ArSession* session,
+                                   const ArGeospatialPose* camera_pose,
+                                   const AnchorStore& store,
+                                   std::vector<AnchorStore::Handle>* handles) {
+  ++update_;
+  selected_count_ = 0;
+  if (items_.empty()) {
+    return;
+  }
+
+  double latitude = 0.0;
+  double longitude = 0.0;
+  double altitude_m = 0.0;
+  ArGeospatialPose_getLatitudeLongitude(session, camera_pose, &latitude,
+                                        &longitude);
+  ArGeospatialPose_getAltitude(session, camera_pose, &altitude_m);
+  float eus_quaternion[4] = {0.f, 0.f, 0.f, 1.f};
+  ArGeospatialPose_getEastUpSouthQuaternion(session, camera_pose,
+                                            eus_quaternion);
+  const glm::dvec3 camera = ToEcef(latitude, longitude, altitude_m);
+
+  // The camera looks down its -Z axis.  Rotated into the East-Up-South
+  // frame, then into ECEF.
+  const glm::dquat orientation(eus_quaternion[3], eus_quaternion[0],
+                               eus_quaternion[1], eus_quaternion[2]);
+  const glm::dvec3 forward_eus = orientation * glm::dvec3(0.0, 0.0, -1.0);
+  const double sin_latitude = std::sin(latitude * kRadiansPerDegree);
+  const double cos_latitude = std::cos(latitude * kRadiansPerDegree);
+  const double sin_longitude = std::sin(longitude * kRadiansPerDegree);
+  const double cos_longitude = std::cos(longitude * kRadiansPerDegree);
+  const glm::dvec3 east(-sin_longitude, cos_longitude, 0.0);
+  const glm::dvec3 up(cos_latitude * cos_longitude,
+                      cos_latitude * sin_longitude, sin_latitude);
+  const glm::dvec3 south(sin_latitude * cos_longitude,
+                         sin_latitude * sin_longitude, -cos_latitude);
+  const glm::dvec3 forward =
+      east * forward_eus.x + up * forward_eus.y + south * forward_eus.z;
+  const double cos_cone =
+      std::cos(kConeHalfAngleDegrees * kRadiansPerDegree);
+
+  // Anchors the store removed are dropped after the walk, as dropping one
+  // renames another.  Marking them selected keeps them out of the turns.
+  stale_items_.clear();
+  const auto is_stale = [&](uint32_t item_index) {
+    Item& item = items_[item_index];
+    if (store.Get(item.handle) != nullptr) {
+      return false;
+    }
+    item.selected_update = update_;
+    stale_items_.push_back(item_index);
+    return true;
+  };
+
+  const glm::ivec3 min_cell =
+      GetCellCoordinates(camera - glm::dvec3(kViewRadiusM));
+  const glm::ivec3 max_cell =
+      GetCellCoordinates(camera + glm::dvec3(kViewRadiusM));
+  for (int x = min_cell.x; x <= max_cell.x; ++x) {
+    for (int y = min_cell.y; y <= max_cell.y; ++y) {
+      for (int z = min_cell.z; z <= max_cell.z; ++z) {
+        auto it = cells_.find(GetCellKey(glm::ivec3(x, y, z)));
+        if (it == cells_.end()) {
+          continue;
+        }
+        for (uint32_t item_index : it->second) {
+          if (items_[item_index].selected_update == update_ ||
+              is_stale(item_index)) {
+            continue;
+          }
+          Item& item = items_[item_index];
+          const glm::dvec3 offset = item.ecef - camera;
+          const double distance = glm::length(offset);
+          if (distance > kViewRadiusM ||
+              (distance > kNearRadiusM &&
+               glm::dot(offset, forward) < distance * cos_cone)) {
+            continue;
+          }
+          item.selected_update = update_;
+          handles->push_back(item.handle);
+          ++selected_count_;
+        }
+      }
+    }
+  }
+
+  int refreshed = 0;
+  for (size_t step = 0;
+       step < items_.size() && refreshed < far_refreshes_per_frame_;
+       ++step) {
+    if (round_robin_cursor_ >= items_.size()) {
+      round_robin_cursor_ = 0;
+    }
+    const uint32_t item_index = static_cast<uint32_t>(round_robin_cursor_++);
+    if (items_[item_index].selected_update == update_ ||
+        is_stale(item_index)) {
+      continue;
+    }
+    handles->push_back(items_[item_index].handle);
+    ++refreshed;
+  }
+
+  // Highest first, so the items swapped into the holes are live ones.
+  std::sort(stale_items_.begin(), stale_items_.end(),
+            std::greater<uint32_t>());
+  for (uint32_t item_index : stale_items_) {
+    RemoveItem(item_index);
+  }
+}
+
+void GeospatialAnchorIndex::Clear() {
+  items_.clear();
+  cells_.clear();
+  round_robin_cursor_ = 0;
+  selected_count_ = 0;
+}
+
+glm::dvec3 GeospatialAnchorIndex::ToEcef(double latitude, double longitude,
+                                         double altitude_m) {
+  const double sin_latitude = std::sin(latitude * kRadiansPerDegree);
+  const double cos_latitude = std::cos(latitude * kRadiansPerDegree);
+  // Radius of curvature in the prime vertical.
+  const double normal_radius =
+      kSemiMajorAxisM /
+      std::sqrt(1.0 - kEccentricitySquared * sin_latitude * sin_latitude);
+  const double horizontal = (normal_radius + altitude_m) * cos_latitude;
+  return glm::dvec3(
+      horizontal * std::cos(longitude * kRadiansPerDegree),
+      horizontal * std::sin(longitude * kRadiansPerDegree),
+      (normal_radius * (1.0 - kEccentricitySquared) + altitude_m) *
+          sin_latitude);
+}
+
+glm::ivec3 GeospatialAnchorIndex::GetCellCoordinates(
+    const glm::dvec3& ecef) const {
+  return glm::ivec3(glm::floor(ecef / cell_size_m_));
+}
+
+uint64_t GeospatialAnchorIndex::GetCellKey(const glm::ivec3& coordinates) {
+  return ((static_cast<uint64_t>(coordinates.x) & kCellCoordinateMask)
+          << (2 * kCellCoordinateBits)) |
+         ((static_cast<uint64_t>(coordinates.y) & kCellCoordinateMask)
+          << kCellCoordinateBits) |
+         (static_cast<uint64_t>(coordinates.z) & kCellCoordinateMask);
+}
+
+void GeospatialAnchorIndex::RemoveItem(uint32_t item_index) {
+  auto it = cells_.find(items_[item_index].cell_key);
+  if (it != cells_.end()) {
+    std::vector<uint32_t>& indices = it->second;
+    auto found = std::find(indices.begin(), indices.end(), item_index);
+    if (found != indices.end()) {
+      *found = indices.back();
+      indices.pop_back();
+    }
+    if (indices.empty()) {
+      cells_.erase(it);
+    }
+  }
+
+  // Moves the last item into the hole.
+  const uint32_t last = static_cast<uint32_t>(items_.size() - 1);
+  if (item_index != last) {
+    it = cells_.find(items_[last].cell_key);
+    if (it != cells_.end()) {
+      std::replace(it->second.begin(), it->second.end(), last, item_index);
+    }
+    items_[item_index] = items_[last];
+  }
+  items_.pop_back();
+}
+
+}  // namespace hello_ar
@@ -0,0 +1,114 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_GEOSPATIAL_ANCHOR_INDEX_H_
+#define C_ARCORE_HELLOE_AR_GEOSPATIAL_ANCHOR_INDEX_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "anchor_store.h"
+#include "arcore_c_api.h"
+#include "glm.h"
+
+namespace hello_ar {
+
+// Picks the Geospatial anchors of an AnchorStore worth refreshing in a
+// frame, so that thousands of anchors across a city do not cost thousands of
+// ARCore queries each frame.
+//
+// The anchors are hashed into cubic cells of Earth-centered, Earth-fixed
+// (ECEF) coordinates by the location they were resolved at.  Update() walks
+// the cells within kViewRadiusM of the camera's Geospatial pose and selects
+// the anchors closer than kNearRadiusM or inside the view cone of the
+// camera.  The anchors it did not select are refreshed a few at a time, in
+// turn, so their tracking state does not go stale.
+//
+// Only refers to the anchors by handle; the store owns them, and handles of
+// anchors the store removed are dropped when Update() comes across them.
+// Not thread safe.
+class GeospatialAnchorIndex {
+ public:
+  // Anchors this close are selected whichever way the camera faces.
+  static constexpr double kNearRadiusM = 30.0;
+  // Anchors farther than this are only refreshed in turn.
+  static constexpr double kViewRadiusM = 200.0;
+  // Half the opening angle of the view cone, wider than the camera's field
+  // of view so that anchors are fresh before they turn into view.
+  static constexpr double kConeHalfAngleDegrees = 60.0;
+
+  // |far_refreshes_per_frame| anchors outside the view are refreshed each
+  // frame.
+  GeospatialAnchorIndex(double cell_size_m, int far_refreshes_per_frame);
+
+  GeospatialAnchorIndex(const GeospatialAnchorIndex&) = delete;
+  GeospatialAnchorIndex& operator=(const GeospatialAnchorIndex&) = delete;
+
+  // Indexes the anchor of |handle| at the WGS84 location, the altitude
+  // above the ellipsoid.
+  void Add(AnchorStore::Handle handle, double latitude, double longitude,
+           double altitude_m);
+
+  // Appends the handles of the anchors to refresh this frame to |handles|.
+  void Update(const ArSession* session, const ArGeospatialPose* camera_pose,
+              const AnchorStore& store,
+              std::vector<AnchorStore::Handle>* handles);
+
+  void Clear();
+
+  size_t GetSize() const { return items_.size(); }
+  size_t GetCellCount() const { return cells_.size(); }
+  // Anchors the last Update() selected in view, without the ones refreshed
+  // in turn.
+  size_t GetSelectedCount() const { return selected_count_; }
+
+  // The ECEF position in meters of the WGS84 location.
+  static glm::dvec3 ToEcef(double latitude, double longitude,
+                           double altitude_m);
+
+ private:
+  struct Item {
+    AnchorStore::Handle handle;
+    glm::dvec3 ecef = glm::dvec3(0.0);
+    uint64_t cell_key = 0;
+    // Update() call the anchor was last selected in.
+    int64_t selected_update = 0;
+  };
+
+  glm::ivec3 GetCellCoordinates(const glm::dvec3& ecef) const;
+  static uint64_t GetCellKey(const glm::ivec3& coordinates);
+
+  // Swaps the last item into |item_index|.
+  void RemoveItem(uint32_t item_index);
+
+  const double cell_size_m_;
+  const int far_refreshes_per_frame_;
+
+  std::vector<Item> items_;
+  std::unordered_map<uint64_t, std::vector<uint32_t>> cells_;
+  // Next item to refresh in turn.
+  size_t round_robin_cursor_ = 0;
+  int64_t update_ = 0;
+  size_t selected_count_ = 0;
+  // Scratch of Update().
+  std::vector<uint32_t> stale_items_;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_GEOSPATIAL_ANCHOR_INDEX_H_
@@ -0,0 +1,226 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gl_upload_thread.h"
+
+#include <EGL/eglext.h>
+
+#include <utility>
+
+#include "jni_interface.h"
+#include "util.h"
+
+namespace hello_ar {
+
+GlUploadThread::~GlUploadThread() { Stop(); }
+
+bool GlUploadThread::Start() {
+  if (thread_.joinable()) {
+    return true;
+  }
+  if (!CreateSharedContext()) {
+    return false;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = false;
+  }
+  running_.store(true, std::memory_order_release);
+  thread_ = std::thread(&GlUploadThread::Run, this);
+  return true;
+}
+
+void GlUploadThread::Stop() {
+  if (!thread_.joinable()) {
+    return;
+  }
+  running_.store(false, std::memory_order_release);
+  std::deque<Upload> uploads;
+  std::deque<Finished> finished;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    std::swap(uploads, uploads_);
+    std::swap(finished, finished_);
+    ++generation_;
+  }
+  wake_.notify_all();
+  thread_.join();
+  DestroySharedContext();
+  // The dropped uploads and publishes release what they hold outside of the
+  // lock.
+}
+
+bool GlUploadThread::Submit(Upload upload) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_ || !IsRunning()) {
+      return false;
+    }
+    uploads_.push_back(std::move(upload));
+  }
+  wake_.notify_one();
+  return true;
+}
+
+int GlUploadThread::RunPublishes() {
+  int count = 0;
+  while (true) {
+    Finished finished;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (finished_.empty()) {
+        break;
+      }
+      // Fences signal in the order the thread inserted them, so the first
+      // one that did not stops the rest.
+      Finished& first = finished_.front();
+      if (glClientWaitSync(first.fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+        break;
+      }
+      finished = std::move(first);
+      finished_.pop_front();
+    }
+    glDeleteSync(finished.fence);
+    finished.publish();
+    ++count;
+  }
+  return count;
+}
+
+void GlUploadThread::DiscardPending() {
+  std::deque<Upload> uploads;
+  std::deque<Finished> finished;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::swap(uploads, uploads_);
+    std::swap(finished, finished_);
+    ++generation_;
+  }
+}
+
+int GlUploadThread::GetPendingCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return static_cast<int>(uploads_.size() + finished_.size()) +
+         (uploading_ ? 1 : 0);
+}
+
+void GlUploadThread::Run() {
+  if (eglMakeCurrent(display_, surface_, surface_, context_) != EGL_TRUE) {
+    LOGE("GlUploadThread::Run eglMakeCurrent error 0x%x", eglGetError());
+    running_.store(false, std::memory_order_release);
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    wake_.wait(lock, [this] { return stopping_ || !uploads_.empty(); });
+    if (stopping_) {
+      break;
+    }
+    Upload upload = std::move(uploads_.front());
+    uploads_.pop_front();
+    const uint64_t generation = generation_;
+    uploading_ = true;
+    lock.unlock();
+
+    Finished finished;
+    finished.publish = upload();
+    upload = nullptr;
+    if (finished.publish) {
+      finished.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+      // The OpenGL thread only sees the fence signal once the commands
+      // before it were submitted.
+      glFlush();
+    }
+
+    lock.lock();
+    uploading_ = false;
+    if (finished.fence != nullptr && generation == generation_) {
+      finished_.push_back(std::move(finished));
+      continue;
+    }
+    // Discarded meanwhile, or without a fence to tell when the objects are
+    // safe to use.  The publish releases what it holds outside of the lock.
+    lock.unlock();
+    if (finished.fence != nullptr) {
+      glDeleteSync(finished.fence);
+    }
+    finished = Finished();
+    lock.lock();
+  }
+  lock.unlock();
+
+  eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  // Uploads of PNG textures go through Java.
+  DetachJniEnv();
+}
+
+bool GlUploadThread::CreateSharedContext() {
+  display_ = eglGetCurrentDisplay();
+  const EGLContext share_context = eglGetCurrentContext();
+  if (display_ == EGL_NO_DISPLAY || share_context == EGL_NO_CONTEXT) {
+    LOGE("GlUploadThread::Start requires a current EGL context");
+    display_ = EGL_NO_DISPLAY;
+    return false;
+  }
+
+  const EGLint config_attributes[] = {EGL_RENDERABLE_TYPE,
+                                      EGL_OPENGL_ES3_BIT_KHR,
+                                      EGL_SURFACE_TYPE,
+                                      EGL_PBUFFER_BIT,
+                                      EGL_NONE};
+  EGLConfig config = nullptr;
+  EGLint num_configs = 0;
+  if (eglChooseConfig(display_, config_attributes, &config, 1,
+                      &num_configs) != EGL_TRUE ||
+      num_configs < 1) {
+    LOGE("GlUploadThread::Start no pbuffer config");
+    display_ = EGL_NO_DISPLAY;
+    return false;
+  }
+
+  const EGLint context_attributes[] = {EGL_CONTEXT_CLIENT_VERSION, 3,
+                                       EGL_NONE};
+  context_ =
+      eglCreateContext(display_, config, share_context, context_attributes);
+  // Never drawn to; some drivers cannot make a context current without one.
+  const EGLint surface_attributes[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+  surface_ = eglCreatePbufferSurface(display_, config, surface_attributes);
+  if (context_ == EGL_NO_CONTEXT || surface_ == EGL_NO_SURFACE) {
+    LOGE("GlUploadThread::Start shared context error 0x%x", eglGetError());
+    DestroySharedContext();
+    return false;
+  }
+  return true;
+}
+
+void GlUploadThread::DestroySharedContext() {
+  if (display_ == EGL_NO_DISPLAY) {
+    return;
+  }
+  if (surface_ != EGL_NO_SURFACE) {
+    eglDestroySurface(display_, surface_);
+    surface_ = EGL_NO_SURFACE;
+  }
+  if (context_ != EGL_NO_CONTEXT) {
+    eglDestroyContext(display_, context_);
+    context_ = EGL_NO_CONTEXT;
+  }
+  display_ = EGL_NO_DISPLAY;
+}
+
+}  // namespace hello_ar
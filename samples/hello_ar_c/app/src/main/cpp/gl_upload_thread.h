@@ -0,0 +1,124 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_GL_UPLOAD_THREAD_H_
+#define C_ARCORE_HELLOE_AR_GL_UPLOAD_THREAD_H_
+
+#include <EGL/egl.h>
+#include <GLES3/gl3.h>
+
+#include <atomic>
+#include <condition_variable>  // NOLINT
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>  // NOLINT
+#include <thread>  // NOLINT
+
+namespace hello_ar {
+
+// A thread with an EGL context shared with the OpenGL thread, which fills
+// buffers and textures there so that large glBufferData() and
+// glCompressedTexImage2D() calls never take the OpenGL thread's time.
+//
+// An Upload runs on the upload thread, creates or fills GL objects and
+// returns the Publish that hands them to the OpenGL thread.  After each
+// upload the thread inserts a fence; RunPublishes() polls the fences without
+// blocking and runs the publishes of the uploads the GPU finished, in the
+// order they were submitted, so nothing is drawn from an object before its
+// data arrived.
+//
+// Sharing a context shares object names but no bindings, and vertex arrays
+// are not shared at all, so uploads bind what they fill themselves, never
+// through util::GlStateCache, and the OpenGL thread sets up vertex arrays
+// in the publish.
+//
+// Submit() may be called from any thread, the rest from the OpenGL thread.
+class GlUploadThread {
+ public:
+  // Runs on the OpenGL thread.  Owns the objects the upload filled, so
+  // dropping it unrun must leave them to the context, see DiscardPending().
+  using Publish = std::function<void()>;
+  // Runs on the upload thread with the shared context current and returns
+  // the publish of what it filled, or an empty function.
+  using Upload = std::function<Publish()>;
+
+  GlUploadThread() = default;
+  ~GlUploadThread();
+
+  GlUploadThread(const GlUploadThread&) = delete;
+  GlUploadThread& operator=(const GlUploadThread&) = delete;
+
+  // Creates a context shared with the current one and starts the thread.
+  // Must be called on the OpenGL thread with its context current.  Returns
+  // false if the context could not be created.
+  bool Start();
+
+  // Drops the uploads not run yet and the publishes pending, joins the
+  // thread and destroys its context.
+  void Stop();
+
+  bool IsRunning() const { return running_.load(std::memory_order_acquire); }
+
+  // Queues |upload|.  Returns false, dropping it, if the thread does not
+  // run, in which case the caller uploads on the OpenGL thread instead.
+  bool Submit(Upload upload);
+
+  // Runs the publishes whose fences signaled.  Returns the number run.
+  int RunPublishes();
+
+  // Drops all uploads not started yet and all publishes not run yet, e.g.
+  // when the context they were meant for is gone.  Their fences are not
+  // deleted, they went away with the context.
+  void DiscardPending();
+
+  // Uploads and publishes that have not completed.
+  int GetPendingCount() const;
+
+ private:
+  struct Finished {
+    GLsync fence = nullptr;
+    Publish publish;
+  };
+
+  void Run();
+
+  bool CreateSharedContext();
+  void DestroySharedContext();
+
+  EGLDisplay display_ = EGL_NO_DISPLAY;
+  EGLContext context_ = EGL_NO_CONTEXT;
+  EGLSurface surface_ = EGL_NO_SURFACE;
+
+  // Guards everything below.  Never held while an upload or publish runs.
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;
+  bool stopping_ = false;
+  std::deque<Upload> uploads_;
+  std::deque<Finished> finished_;
+  // Bumped by DiscardPending(), so the upload running at the time can be
+  // recognized as stale.
+  uint64_t generation_ = 0;
+  // An upload is running on the thread.
+  bool uploading_ = false;
+
+  std::atomic<bool> running_{false};
+  std::thread thread_;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_GL_UPLOAD_THREAD_H_
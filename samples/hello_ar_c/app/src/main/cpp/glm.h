@@ -20,6 +20,7 @@
 #define GLM_ENABLE_EXPERIMENTAL
 #include "glm.hpp"
 #include "gtc/matrix_transform.hpp"
+#include "gtc/type_aligned.hpp"
 #include "gtc/type_ptr.hpp"
 #include "gtx/quaternion.hpp"
 
@@ -0,0 +1,153 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gpu_stage_timers.h"
+
+#include <EGL/egl.h>
+#include <GLES2/gl2ext.h>
+
+#include <cstring>
+
+#include "util.h"
+
+namespace hello_ar {
+namespace {
+// The 64 bit result getter is only part of the extension, not of GLES 3.0.
+PFNGLGETQUERYOBJECTUI64VEXTPROC LoadGetQueryObjectui64v() {
+  static PFNGLGETQUERYOBJECTUI64VEXTPROC function =
+      reinterpret_cast<PFNGLGETQUERYOBJECTUI64VEXTPROC>(
+          eglGetProcAddress("glGetQueryObjectui64vEXT"));
+  return function;
+}
+
+bool HasTimerQueryExtension() {
+  GLint num_extensions = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &num_extensions);
+  for (GLint i = 0; i < num_extensions; ++i) {
+    const char* extension = reinterpret_cast<const char*>(
+        glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i)));
+    if (extension != nullptr &&
+        strcmp(extension, "GL_EXT_disjoint_timer_query") == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+}  // namespace
+
+constexpr int GpuStageTimers::kFramesInFlight;
+
+bool GpuStageTimers::InitializeGlContent() {
+  frames_ = {};
+  current_frame_ = 0;
+  recent_totals_ = {};
+  recent_counts_ = {};
+  supported_ = HasTimerQueryExtension() && LoadGetQueryObjectui64v() != nullptr;
+  if (!supported_) {
+    LOGI("GpuStageTimers: GL_EXT_disjoint_timer_query is not supported");
+    return false;
+  }
+  for (FrameQueries& frame : frames_) {
+    glGenQueries(kNumFrameStages, frame.queries.data());
+  }
+  // Clears a disjoint state left over from before the queries existed.
+  GLint disjoint = 0;
+  glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+  return true;
+}
+
+void GpuStageTimers::BeginFrame() {
+  if (!supported_) {
+    return;
+  }
+  // Reading the flag also resets it, so it covers every query that finished
+  // since the previous frame.
+  GLint disjoint = 0;
+  glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+  for (FrameQueries& frame : frames_) {
+    CollectResults(&frame, disjoint != 0);
+  }
+
+  current_frame_ = (current_frame_ + 1) % kFramesInFlight;
+  // Results that are still not available after kFramesInFlight frames are
+  // given up rather than waited for.
+  frames_[current_frame_].pending.fill(false);
+}
+
+void GpuStageTimers::CollectResults(FrameQueries* frame, bool disjoint) {
+  for (int i = 0; i < kNumFrameStages; ++i) {
+    if (!frame->pending[i]) {
+      continue;
+    }
+    GLuint available = GL_FALSE;
+    glGetQueryObjectuiv(frame->queries[i], GL_QUERY_RESULT_AVAILABLE,
+                        &available);
+    if (available == GL_FALSE) {
+      continue;
+    }
+    frame->pending[i] = false;
+    if (disjoint) {
+      continue;
+    }
+    GLuint64 elapsed_ns = 0;
+    LoadGetQueryObjectui64v()(frame->queries[i], GL_QUERY_RESULT,
+                              &elapsed_ns);
+    timers_.Record(static_cast<FrameStage>(i),
+                   std::chrono::nanoseconds(elapsed_ns));
+    recent_totals_[i] += std::chrono::nanoseconds(elapsed_ns);
+    ++recent_counts_[i];
+  }
+}
+
+float GpuStageTimers::TakeRecentAverageMs(FrameStage stage) {
+  const int index = static_cast<int>(stage);
+  if (recent_counts_[index] == 0) {
+    return -1.f;
+  }
+  const float average_ms =
+      std::chrono::duration<float, std::milli>(recent_totals_[index]).count() /
+      recent_counts_[index];
+  recent_totals_[index] = std::chrono::nanoseconds(0);
+  recent_counts_[index] = 0;
+  return average_ms;
+}
+
+void GpuStageTimers::BeginStage(FrameStage stage) {
+  if (!supported_) {
+    return;
+  }
+  FrameQueries& frame = frames_[current_frame_];
+  const int index = static_cast<int>(stage);
+  if (frame.pending[index]) {
+    return;
+  }
+  glBeginQuery(GL_TIME_ELAPSED_EXT, frame.queries[index]);
+}
+
+void GpuStageTimers::EndStage(FrameStage stage) {
+  if (!supported_) {
+    return;
+  }
+  FrameQueries& frame = frames_[current_frame_];
+  const int index = static_cast<int>(stage);
+  if (frame.pending[index]) {
+    return;
+  }
+  glEndQuery(GL_TIME_ELAPSED_EXT);
+  frame.pending[index] = true;
+}
+
+}  // namespace hello_ar
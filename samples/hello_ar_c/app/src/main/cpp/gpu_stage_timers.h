@@ -0,0 +1,95 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_GPU_STAGE_TIMERS_H_
+#define C_ARCORE_HELLOE_AR_GPU_STAGE_TIMERS_H_
+
+#include <GLES3/gl3.h>
+
+#include <array>
+#include <chrono>
+
+#include "frame_stage_timers.h"
+
+namespace hello_ar {
+
+// GPU execution time of the frame stages, measured with GL_TIME_ELAPSED_EXT
+// queries of GL_EXT_disjoint_timer_query.
+//
+// Each frame uses its own set of queries and their results are only read
+// once available, kFramesInFlight frames later at most, so the GL thread
+// never waits for the GPU.  Results of frames that were disjoint, e.g. due to
+// a GPU frequency change, are dropped.  All methods but GetSummaries() must
+// be called on the GL thread.
+class GpuStageTimers {
+ public:
+  static constexpr int kFramesInFlight = 4;
+
+  GpuStageTimers() = default;
+
+  GpuStageTimers(const GpuStageTimers&) = delete;
+  GpuStageTimers& operator=(const GpuStageTimers&) = delete;
+
+  // Creates the queries in the current GL context.  The previous ones are
+  // abandoned with their context.  Returns false if the context has no timer
+  // queries, in which case nothing is measured.
+  bool InitializeGlContent();
+
+  // Whether the last InitializeGlContent() found timer queries.
+  bool IsSupported() const { return supported_; }
+
+  // Collects the available results of previous frames and moves on to the
+  // next set of queries.
+  void BeginFrame();
+
+  // Brackets the GL commands of |stage|.  Only one stage may be measured at a
+  // time, and each at most once per frame.
+  void BeginStage(FrameStage stage);
+  void EndStage(FrameStage stage);
+
+  // Rolling statistics of the measured GPU times, indexed by FrameStage.  May
+  // be called from any thread.
+  std::array<FrameStageTimers::Summary, kNumFrameStages> GetSummaries() const {
+    return timers_.GetSummaries();
+  }
+
+  // Average GPU time of |stage| in milliseconds over the results collected
+  // since the previous call for it, or a negative value if there were none.
+  // Unlike GetSummaries() this follows changes within a few frames, e.g. to
+  // adapt the rendering to them.
+  float TakeRecentAverageMs(FrameStage stage);
+
+ private:
+  struct FrameQueries {
+    std::array<GLuint, kNumFrameStages> queries = {};
+    // Whether the query was issued and its result not collected yet.
+    std::array<bool, kNumFrameStages> pending = {};
+  };
+
+  void CollectResults(FrameQueries* frame, bool disjoint);
+
+  bool supported_ = false;
+  std::array<FrameQueries, kFramesInFlight> frames_;
+  int current_frame_ = 0;
+  FrameStageTimers timers_;
+  // Results collected since the last TakeRecentAverageMs(), per stage.
+  std::array<std::chrono::nanoseconds, kNumFrameStages> recent_totals_ = {};
+  std::array<int, kNumFrameStages> recent_counts_ = {};
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_GPU_STAGE_TIMERS_H_
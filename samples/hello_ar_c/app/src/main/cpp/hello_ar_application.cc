@@ -16,20 +16,317 @@
 
 #include "hello_ar_application.h"
 
+#include <EGL/egl.h>
 #include <android/asset_manager.h>
+#include <time.h>
+#include <unistd.h>
 
+#include <algorithm>
 #include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <iterator>
+#include <utility>
 
 #include "arcore_c_api.h"
+#include "arcore_trace.h"
+#include "job_system.h"
 #include "plane_renderer.h"
+#include "resource_accounting.h"
 #include "util.h"
 
 namespace hello_ar {
 namespace {
-constexpr size_t kMaxNumberOfAndroidsToRender = 20;
+// All androids are drawn with a single instanced draw call, so the limit is
+// bound by per-anchor pose queries rather than by draw call count.
+constexpr size_t kMaxNumberOfAndroidsToRender = 2000;
+// Which anchor a new one replaces once there are that many.
+constexpr AnchorStore::EvictionPolicy kAnchorEvictionPolicy =
+    AnchorStore::EvictionPolicy::kOldest;
+// Edge of the cells anchors are hashed into, which the view frustum is tested
+// against before the anchors inside.  A few androids wide, so a cell is
+// either well inside the view or skips several anchors.
+constexpr float kAnchorCellSizeM = 1.0f;
+
+// Draws all visible planes with one draw call instead of one call per plane.
+constexpr bool kUseBatchedPlaneRendering = true;
+
+// Shades each pixel once where batched planes overlap at different depths,
+// by writing the depth of their insides before shading them.  Coplanar
+// planes still blend over each other.  Planes then hide what is drawn after
+// them.
+constexpr bool kUsePlaneDepthPrepass = false;
+
+// On OpenGL ES 3.1 devices, culls the anchors and the edges of the plane batch
+// in compute shaders and draws what remains with indirect draws, so the CPU
+// cost stays flat as the number of anchors grows.  The level of detail no
+// longer has hysteresis, and the anchor counters only tell the coarsely
+// culled candidates apart, since nothing is read back.
+constexpr bool kUseGpuCulling = false;
+
+// Plane polygons are simplified to within this many meters before they are
+// triangulated.
+constexpr float kPlanePolygonToleranceM =
+    PlaneRenderer::kDefaultPolygonToleranceM;
+
+// Runs ArSession_update on a dedicated thread and renders the most recent
+// frame it published, so update spikes no longer stall rendering.  Frames are
+// displayed up to one camera frame later than in the default mode.
+constexpr bool kUseArUpdateThread = false;
+
+// Corrects the view of the virtual content and the camera image for how far
+// the device turned since the camera frame was taken, right before the frame
+// is submitted, see LatePoseReprojector.  With kUseArUpdateThread, only
+// used by kUseDisplayRatePrediction.
+constexpr bool kUseLatePoseReprojection = false;
+// How far past the latch the rotation is predicted, about until the frame
+// is on the display.
+constexpr int64_t kLatePosePredictionNs = 16000000;
+// With kUseArUpdateThread, draws the snapshots, which are redrawn at display
+// rate until the next camera frame, with the camera pose predicted for
+// their display time, see CameraPosePredictor.  The turn comes from the
+// gyroscope instead with kUseLatePoseReprojection.  The activity asks for
+// the highest refresh rate of the display then.
+constexpr bool kUseDisplayRatePrediction = false;
+
+// Renders from a native thread paced by vsync, see NativeFrameLoop, instead
+// of the activity's GLSurfaceView.  Devices older than Android 10 keep the
+// GLSurfaceView.
+constexpr bool kUseNativeFrameLoop = false;
+
+// Skips the frames that would show the same camera image and content as the
+// previous one, and updates at a low rate while tracking is lost, see
+// RedrawGate.  The GLSurfaceView swaps after every frame, so it cannot keep
+// the previous frame; there the activity only lowers the frame rate while
+// the gate is idle.
+constexpr bool kUseRedrawGate = true;
+
+// Stabilizes the camera image with EIS where the camera config supports it.
+// Virtual content keeps the unstabilized camera matrices.  With
+// kUseComputeEisWarp, ARCore only transforms the corners of the image and a
+// compute pass fills in the warp mesh; otherwise ARCore transforms every
+// vertex of it.
+constexpr bool kUseImageStabilization = false;
+constexpr bool kUseComputeEisWarp = true;
+
+// While ArSession_update runs on the OpenGL thread, stops blocking in it for
+// the next camera image once frames take well under the camera period, and
+// redraws the latest image at display rate instead, see
+// UpdateModeController.  The blocking times are logged on pause.
+constexpr bool kUseUpdateModeController = false;
+
+// Stops plane finding once the planes found cover enough area, and turns
+// depth off while nothing drawn needs it, see SessionFeaturePolicy.  The
+// session is reconfigured with the other changes of ApplyPendingEvents().
+constexpr bool kUseSessionFeaturePolicy = false;
+
+// Creates, configures and resumes the session on a worker thread, so
+// onResume returns right away and the surface and assets come up meanwhile.
+// Off by default since a failed start then only shows in the log, where the
+// synchronous path throws to Java.
+constexpr bool kUseAsyncSessionStart = false;
+
+// Resolves depth occlusion into a half resolution mask in one fullscreen pass
+// instead of blurring the depth comparison in every object fragment.  Object
+// edges are occluded slightly softer.
+constexpr bool kUseOcclusionMask = false;
+
+// Occludes with raw depth instead of smoothed depth.  Raw depth reaches the
+// screen with less latency, which keeps fast moving occluders like hands in
+// place, and its texels below kRawDepthConfidenceThreshold do not occlude.
+constexpr bool kUseRawDepth = false;
+constexpr float kRawDepthConfidenceThreshold = 0.5f;
+
+// Draws the depth image as a dense point cloud, unprojected on the GPU,
+// instead of the sparse feature points when depth is supported.
+constexpr bool kUseDensePointCloud = false;
+
+// Draws the feature points accumulated over all frames instead of only
+// those of the current frame.
+constexpr bool kUsePointCloudMap = false;
+
+// Fuses every depth image into a voxel volume and draws the reconstructed
+// surface.  Integration and meshing run on a background thread; the OpenGL
+// thread only copies the depth image and uploads the changed block meshes.
+constexpr bool kUseTsdfFusion = false;
+
+// Draws the terrain and building meshes from the Streetscape Geometry API.
+// Turns on the Geospatial API, so the app then needs the location permission
+// and an API key like the geospatial_java sample.  Each mesh is uploaded
+// once and only again when ARCore updates it.  Only drawn while
+// ArSession_update runs on the OpenGL thread.
+constexpr bool kUseStreetscapeGeometry = false;
+
+// Resolves the Terrain and Rooftop anchors of ResolveGeospatialAnchor() with
+// an AnchorResolveScheduler, which also needs the Geospatial API.
+constexpr bool kUseGeospatialAnchors = false;
+// Resolve requests in flight at once.
+constexpr int kMaxOutstandingAnchorResolves = 4;
+// Refreshes the resolved anchors around and ahead of the camera each frame
+// through a GeospatialAnchorIndex, and the rest a few at a time, instead of
+// querying every anchor in AnchorStore::BeginFrame().
+constexpr bool kUseGeospatialAnchorIndex = true;
+constexpr double kGeospatialAnchorCellSizeM = 50.0;
+constexpr int kFarGeospatialAnchorRefreshesPerFrame = 8;
+// Checks the VPS availability around the camera through a
+// VpsAvailabilityCache, so each cell costs one network request per TTL and
+// launches in a known place answer right away.
+constexpr bool kUseVpsAvailabilityCache = true;
+constexpr std::chrono::hours kVpsAvailabilityTtl{24};
+constexpr char kVpsAvailabilityCacheName[] = "/vps_availability.bin";
+
+// Hosts every placed anchor as a Cloud Anchor and resolves the ids passed to
+// ResolveCloudAnchor() with a CloudAnchorPipeline.  Needs the ARCore API
+// authorization of the cloud_anchor_java sample.
+constexpr bool kUseCloudAnchors = false;
+// Hosts and resolves in flight at once.
+constexpr int kMaxCloudAnchorsInFlight = 4;
+constexpr int kCloudAnchorTtlDays = 1;
+// Geospatial resolves and Cloud Anchor requests in flight at once, together.
+constexpr int kMaxAnchorRequestsInFlight = 6;
+
+// Saves the point map and the fused volume under the first Cloud Anchor a
+// session hosts or resolves when the app pauses, and restores them into a
+// later session that resolves the same anchor, moved by where the anchor is
+// now.  Needs kUseCloudAnchors and kUsePointCloudMap or kUseTsdfFusion.
+constexpr bool kUseSpatialMapCache = false;
+constexpr char kSpatialMapCacheName[] = "/spatial_maps.bin";
+// Each restored chunk is paged in and, for blocks, copied for the mesher
+// thread, so a map is restored over a number of frames.
+constexpr int kSpatialMapChunksPerFrame = 2;
+
+// Builds min/max depth pyramids of every depth image: on the CPU to skip the
+// anchors hidden behind real geometry, and on the GPU so the occlusion
+// shaders resolve fully hidden and fully visible fragments with one lookup.
+// Only used while depth occlusion is on.
+constexpr bool kUseDepthPyramid = false;
+
+// Blurs every depth image once, in two separable passes, so the occlusion
+// shaders take one sample per fragment instead of 25.  The result
+// approximates the per-fragment blur, see OcclusionBlurTexture.  Only used
+// while depth occlusion is on.
+constexpr bool kUseOcclusionBlurTexture = false;
+
+// Blends every depth image with the previous ones, reprojected with the
+// camera motion, before the occlusion shaders read it, so depth at edges does
+// not flicker from image to image.  Only used while depth occlusion is on.
+constexpr bool kUseTemporalDepthFilter = false;
+
+// Switches the session to the front camera and draws the Augmented Faces
+// meshes.  The front camera finds no planes and has no depth, so the rest of
+// the scene stays empty.
+constexpr bool kUseAugmentedFaces = false;
+
+// Picks the back camera config of new sessions by its cost on the device,
+// see CameraConfigPlanner, instead of taking ARCore's default.  The stereo
+// camera is left out, since nothing here uses its second stream.
+constexpr bool kUseCameraConfigPlanner = true;
+constexpr char kCameraConfigProfileName[] = "/camera_config_profile.bin";
+
+// Runs the Scene Semantics API where supported and uploads each semantic
+// image into a texture.  Logs the sky fraction of the image and the ground
+// fraction of the lower third of the screen, counted on the GPU.  Only
+// while ArSession_update runs on the OpenGL thread.
+constexpr bool kUseSemantics = false;
+// Labels below this confidence are not counted as ground.
+constexpr float kSemanticConfidenceThreshold = 0.5f;
+// Min (xy) and max (zw) corners in normalized device coordinates.
+const glm::vec4 kGroundRoiNdc(-1.0f, -1.0f, 1.0f, -1.0f / 3.0f);
+constexpr int kSemanticImagesPerLog = 30;
+
+// Lights the Andy models with Environmental HDR light estimates, prefiltered
+// into a cubemap on a worker whenever ARCore produces a new one, instead of
+// the color correction.  Only while ArSession_update runs on the OpenGL
+// thread.
+constexpr bool kUseEnvironmentalHdr = false;
+
+// Draws a reticle on the surface under the screen centre, looked up every
+// frame in a CPU copy of the depth image instead of hit testing the frame.
+constexpr bool kUseDepthQuery = false;
+
+// Mirrors the planes into a CPU index raycast by the reticle where depth has
+// no answer, instead of hit testing the frame.
+constexpr bool kUsePlaneIndex = false;
+
+// Time each frame may spend uploading textures the asset loader decoded.
+constexpr std::chrono::milliseconds kAssetUploadBudget(2);
+
+// Submits the programs of all renderers before any of them waits for a link
+// status, so the driver can compile them in parallel.  OnSurfaceCreated()
+// logs how long it took, to compare with this turned off.
+constexpr bool kStartProgramsEarly = true;
+
+// Steps the quality down while the device heats up, see ThermalGovernor and
+// ApplyQualityLevel().
+constexpr bool kUseThermalGovernor = true;
+constexpr std::chrono::seconds kThermalUpdateInterval(1);
+// Frames overrunning the period of the 30 fps camera count as throttled.
+constexpr float kThermalFrameBudgetMs = 1000.f / 30.f;
+// Frames longer than this, e.g. after a pause, are not a sign of throttling.
+constexpr float kMaxGovernedFrameTimeMs = 500.f;
+// Scale of the frames CaptureScreenshot() writes.
+constexpr float kScreenshotScale = 1.f;
+
+// Uploads the decoded textures and meshes on a thread with a shared GL
+// context, so DrawFrame() only publishes them once their fences signaled.
+constexpr bool kUseGlUploadThread = true;
+
+// Reports the CPU time of every drawn frame against the camera frame period
+// through a PerformanceHintSession, so the system clocks the rendering
+// threads up only as far as they need to keep up.
+constexpr bool kUsePerformanceHints = true;
+constexpr std::chrono::nanoseconds kPerformanceHintTarget(1000000000 / 30);
+// The session is paused after this long without a drawn frame.
+constexpr std::chrono::milliseconds kPerformanceHintIdleTimeout(500);
+// Draws the virtual content at a resolution scale that keeps its GPU time
+// within kVirtualContentGpuBudgetMs, see RenderScaleGovernor.  Needs GPU
+// timer queries, otherwise the content stays at full resolution.
+constexpr bool kUseDynamicRenderScale = true;
+constexpr std::chrono::milliseconds kRenderScaleUpdateInterval(500);
+// Leaves the rest of a 60 Hz frame to the camera image, the depth upload and
+// the compositing.
+constexpr float kVirtualContentGpuBudgetMs = 8.f;
+// Keeps a mipmapped copy of the camera image at 1 / kCameraCopyDownscale
+// of the surface for post-effects, see BackgroundRenderer::SetCameraCopySize().
+// Off while no effect samples it, since it costs a render pass per camera
+// frame.
+constexpr bool kUseCameraCopy = false;
+constexpr int kCameraCopyDownscale = 4;
+// Draws the anchors animated, skinned on the GPU, when the skinned model is
+// bundled.  The anchors then skip the LODs and the GPU culling pass.
+constexpr bool kUseSkinnedAnchors = true;
+constexpr char kSkinnedAndyModel[] = "models/andy_skinned.mesh";
+// Offsets the clip of each anchor, so they do not all move in step.
+constexpr float kSkinnedAnchorPhaseStepS = 0.37f;
+
+// Load and store actions of the frame's passes, see RenderPass.  Each one can
+// be switched off to A/B test it against the GPU's external memory traffic.
+// Skips the color clear of the surface while the camera image covers it.
+constexpr bool kSkipCoveredColorClear = true;
+// Invalidates depth after the last draw, so tile based GPUs never write it
+// back.
+constexpr bool kInvalidateDepthAfterFrame = true;
+// Samples per pixel the virtual content is antialiased with through
+// EXT_multisampled_render_to_texture, 1 for none.  More than 1 keeps
+// virtual_content_target_ active at full resolution, which adds a composite
+// pass, so the saved resolve has to pay for that.
+constexpr int kVirtualContentSamples = 1;
+
+// Quality of the steps the thermal governor takes.
+constexpr int kThrottledPointStride = 2;
+// Scales the screen size of the anchors when picking their level of detail,
+// so coarser levels are used closer to the camera.
+constexpr float kThrottledLodScreenFractionScale = 0.5f;
+constexpr float kThrottledRenderScale = 0.75f;
 
 const glm::vec3 kWhite = {255, 255, 255};
 
+// Clip planes of the camera projection, also those of state captures.
+constexpr float kProjectionNear = 0.1f;
+constexpr float kProjectionFar = 100.f;
+
 // Assumed distance from the device camera to the surface on which user will
 // try to place objects. This value affects the apparent scale of objects
 // while the tracking method of the Instant Placement point is
@@ -48,13 +345,162 @@ void SetColor(float r, float g, float b, float a, float* color4f) {
   color4f[3] = a;
 }
 
+FrameGraph::Pass MakePass(const char* name, FrameGraph::Phase phase,
+                          const FrameGraph::PassState& state, FrameStage stage,
+                          std::function<void()> execute) {
+  FrameGraph::Pass pass;
+  pass.name = name;
+  pass.phase = phase;
+  pass.state = state;
+  pass.stage = stage;
+  pass.execute = std::move(execute);
+  return pass;
+}
+
+// The camera image covers the screen without writing depth.
+FrameGraph::PassState GetBackgroundPassState() {
+  FrameGraph::PassState state;
+  state.depth_write = false;
+  return state;
+}
+
+// Planes blend over the scene without occluding it.
+FrameGraph::PassState GetPlanePassState() {
+  FrameGraph::PassState state;
+  state.depth_write = false;
+  state.blend = FrameGraph::BlendMode::kPremultipliedAlpha;
+  return state;
+}
+
+// Textures are loaded with premultiplied alpha, and the objects occlude what
+// is drawn after them.
+FrameGraph::PassState GetObjectPassState(GLuint program) {
+  FrameGraph::PassState state;
+  state.blend = FrameGraph::BlendMode::kPremultipliedAlpha;
+  state.program = program;
+  return state;
+}
+
+FrameGraph::PassState GetPointCloudPassState(GLuint program) {
+  FrameGraph::PassState state;
+  state.program = program;
+  return state;
+}
+
+// Face meshes are tinted over the camera image of the face.
+FrameGraph::PassState GetFaceMeshPassState() {
+  FrameGraph::PassState state;
+  state.depth_write = false;
+  state.blend = FrameGraph::BlendMode::kPremultipliedAlpha;
+  return state;
+}
+
+// Streetscape Geometry is tinted over the scene and seen from both sides.
+FrameGraph::PassState GetStreetscapePassState() {
+  FrameGraph::PassState state;
+  state.depth_write = false;
+  state.cull_face = false;
+  state.blend = FrameGraph::BlendMode::kPremultipliedAlpha;
+  return state;
+}
+
+// Writes the RGBA pixels of |image| as a binary PPM, top row first.
+bool WritePpm(const std::string& path, const FrameReadback::Image& image) {
+  FILE* file = fopen(path.c_str(), "wb");
+  if (file == nullptr) {
+    LOGE("Could not open %s", path.c_str());
+    return false;
+  }
+  fprintf(file, "P6\n%d %d\n255\n", image.width, image.height);
+  std::vector<uint8_t> row(static_cast<size_t>(image.width) * 3);
+  bool written = true;
+  for (int y = image.height - 1; y >= 0 && written; --y) {
+    const uint8_t* pixel =
+        image.pixels + static_cast<size_t>(y) * image.width * 4;
+    for (int x = 0; x < image.width; ++x, pixel += 4) {
+      row[x * 3] = pixel[0];
+      row[x * 3 + 1] = pixel[1];
+      row[x * 3 + 2] = pixel[2];
+    }
+    written = fwrite(row.data(), 1, row.size(), file) == row.size();
+  }
+  if (fclose(file) != 0 || !written) {
+    LOGE("Could not write %s", path.c_str());
+    return false;
+  }
+  return true;
+}
+
 }  // namespace
 
-HelloArApplication::HelloArApplication(AAssetManager* asset_manager)
-    : asset_manager_(asset_manager) {}
+HelloArApplication::HelloArApplication(AAssetManager* asset_manager,
+                                       const std::string& cache_dir)
+    : performance_hint_session_(kPerformanceHintTarget),
+      asset_manager_(asset_manager),
+      anchor_store_(kMaxNumberOfAndroidsToRender, kAnchorEvictionPolicy,
+                    kAnchorCellSizeM),
+      anchor_request_budget_(kMaxAnchorRequestsInFlight),
+      anchor_resolve_scheduler_(kMaxOutstandingAnchorResolves,
+                                &anchor_request_budget_),
+      geospatial_anchor_index_(kGeospatialAnchorCellSizeM,
+                               kFarGeospatialAnchorRefreshesPerFrame),
+      vps_availability_cache_(kVpsAvailabilityTtl),
+      cloud_anchor_pipeline_(kMaxCloudAnchorsInFlight, kCloudAnchorTtlDays,
+                             &anchor_request_budget_) {
+  util::SetProgramCacheDirectory(cache_dir);
+  asset_loader_.SetUploadThread(&gl_upload_thread_);
+  if (kUseCameraConfigPlanner) {
+    camera_config_planner_.Load(cache_dir + kCameraConfigProfileName);
+  }
+  if (kUseGeospatialAnchors && kUseVpsAvailabilityCache) {
+    vps_availability_cache_.Load(cache_dir + kVpsAvailabilityCacheName);
+  }
+  if (kUseTsdfFusion) {
+    background_mesher_ = std::make_unique<BackgroundMesher>();
+  }
+  if (kUseCloudAnchors && kUseSpatialMapCache) {
+    spatial_map_cache_.Load(cache_dir + kSpatialMapCacheName);
+  }
+  thermal_governor_.Reset(kThermalFrameBudgetMs);
+  render_scale_governor_.Reset(kVirtualContentGpuBudgetMs);
+
+  RenderPass::Options render_pass_options;
+  render_pass_options.skip_covered_color_clear = kSkipCoveredColorClear;
+  render_pass_options.invalidate_depth_stencil = kInvalidateDepthAfterFrame;
+  surface_render_pass_.SetOptions(render_pass_options);
+  virtual_content_target_.SetRenderPassOptions(render_pass_options);
+}
 
 HelloArApplication::~HelloArApplication() {
+  // Nothing is drawn anymore, and nothing else uses the loop's context.
+  frame_loop_.Stop();
+  ar_update_thread_.Stop();
+  gl_upload_thread_.Stop();
+  session_capture_.Stop();
+  dataset_recorder_.Close();
+  telemetry_log_.Stop();
+  state_capture_.Stop();
+  // The start may still be configuring through this object.
+  session_starter_.Wait();
+  AdoptStartedSession();
   if (ar_session_ != nullptr) {
+    frame_image_cache_.ReleaseAll();
+    plane_registry_.Clear();
+    streetscape_geometry_renderer_.Clear();
+    anchor_resolve_scheduler_.Clear(ar_session_);
+    vps_availability_cache_.Clear(ar_session_);
+    if (camera_geospatial_pose_ != nullptr) {
+      ArGeospatialPose_destroy(camera_geospatial_pose_);
+    }
+    cloud_anchor_pipeline_.Clear(ar_session_);
+    environmental_hdr_lighting_.Finish();
+    anchor_store_.Clear();
+    geospatial_anchor_index_.Clear();
+    scene_graph_.Clear();
+    ar_object_pool_.Destroy();
+    if (unthrottled_camera_config_ != nullptr) {
+      ArCameraConfig_destroy(unthrottled_camera_config_);
+    }
     ArSession_destroy(ar_session_);
     ArFrame_destroy(ar_frame_);
   }
@@ -62,13 +508,88 @@ HelloArApplication::~HelloArApplication() {
 
 void HelloArApplication::OnPause() {
   LOGI("OnPause()");
+  // The GLSurfaceView is paused by now, the native frame loop is paused
+  // here; the thread restarts with the next drawn frame.
+  frame_loop_.SetPaused(true);
+  ar_update_thread_.Stop();
+  // Reopened by the first frame drawn after the resume.
+  performance_hint_session_.Pause();
+  session_capture_.Stop();
+  state_capture_.Stop();
+  late_pose_reprojector_.Stop();
+  // A session still starting is resumed before it can be paused, and the
+  // GL thread, which would have adopted it, is paused already.
+  session_starter_.Wait();
+  AdoptStartedSession();
   if (ar_session_ != nullptr) {
+    frame_image_cache_.ReleaseAll();
+    if (kUseCloudAnchors && kUseSpatialMapCache) {
+      SaveSpatialMap();
+    }
     ArSession_pause(ar_session_);
   }
+  // The camera may come back with a different configuration and therefore a
+  // different set of buffers.
+  egl_image_cache_.RequestFlush();
+  if (kUseCameraConfigPlanner) {
+    // The next launch plans with the background pass this session measured.
+    const FrameStageTimers::Summary background =
+        gpu_stage_timers_.GetSummaries()[static_cast<int>(
+            FrameStage::kBackground)];
+    if (background.sample_count > 0) {
+      camera_config_planner_.UpdateGpuCost(background.avg_ms);
+    }
+  }
+  // Comparing the reports of successive pauses shows what leaks.
+  LOGI("Resources held:\n%s",
+       ResourceAccounting::Get().GetReport().c_str());
+  if (kUseCloudAnchors) {
+    LOGI("Cloud Anchors:\n%s", cloud_anchor_pipeline_.GetReport().c_str());
+  }
+  if (kUseCloudAnchors || kUseGeospatialAnchors) {
+    LOGI("Anchor requests: at most %d in flight, %d held back",
+         anchor_request_budget_.GetPeakInFlight(),
+         anchor_request_budget_.GetDeniedCount());
+  }
+  if (kUseCloudAnchors && kUseSpatialMapCache) {
+    LOGI("Spatial maps: %s", spatial_map_cache_.GetReport().c_str());
+  }
+  if (kUseGeospatialAnchors && kUseVpsAvailabilityCache) {
+    LOGI("VPS availability: %s", vps_availability_cache_.GetReport().c_str());
+  }
+  if (kUseUpdateModeController) {
+    LOGI("ArSession_update:\n%s",
+         update_mode_controller_.GetReport().c_str());
+  }
+  if (kUseSessionFeaturePolicy) {
+    LOGI("Session features: %s", session_feature_policy_.GetReport().c_str());
+  }
+  if (frame_loop_.IsRunning()) {
+    LOGI("Frame loop: %s", frame_loop_.GetReport().c_str());
+  }
+  if (kUseRedrawGate) {
+    LOGI("Redraw gate: %s", redraw_gate_.GetReport().c_str());
+  }
+  if (kUsePerformanceHints) {
+    LOGI("Performance hints: %s",
+         performance_hint_session_.GetReport().c_str());
+  }
+  LOGI("Frame readback: %s", frame_readback_.GetReport().c_str());
 }
 
 void HelloArApplication::OnResume(JNIEnv* env, void* context, void* activity) {
   LOGI("OnResume()");
+  resume_time_ns_ = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now().time_since_epoch())
+                        .count();
+  // Nothing consumes the events while the GLSurfaceView is paused, so the
+  // settings queued just before are applied here and configure a new session
+  // right away.
+  ApplyPendingEvents();
+  // Neither thread draws yet.  The first frames are drawn at full rate.
+  redraw_gate_.Reset();
+  // Draws without a session until it is resumed, like the GLSurfaceView.
+  frame_loop_.SetPaused(false);
 
   if (ar_session_ == nullptr) {
     ArInstallStatus install_status;
@@ -94,16 +615,29 @@ void HelloArApplication::OnResume(JNIEnv* env, void* context, void* activity) {
         return;
     }
 
+    if (kUseAsyncSessionStart) {
+      if (session_starter_.GetState() == SessionStarter::State::kFailed) {
+        LOGE("Retrying the AR session start that failed with %d",
+             session_starter_.GetFailure());
+      }
+      // DrawFrame() adopts the session once it is resumed.
+      session_starter_.Start(env, static_cast<jobject>(context),
+                             [this](ArSession* session) {
+                               return PrepareSession(session);
+                             });
+      return;
+    }
+
     // === ATTENTION!  ATTENTION!  ATTENTION! ===
     // This method can and will fail in user-facing situations.  Your
     // application must handle these cases at least somewhat gracefully.  See
     // HelloAR Java sample code for reasonable behavior.
     CHECKANDTHROW(ArSession_create(env, context, &ar_session_) == AR_SUCCESS,
                   env, "Failed to create AR session.");
-
-    ConfigureSession();
+    CHECKANDTHROW(PrepareSession(ar_session_), env,
+                  "Failed to set the playback benchmark dataset.");
     ArFrame_create(ar_session_, &ar_frame_);
-
+    background_covers_surface_ = false;
     ArSession_setDisplayGeometry(ar_session_, display_rotation_, width_,
                                  height_);
   }
@@ -112,19 +646,136 @@ void HelloArApplication::OnResume(JNIEnv* env, void* context, void* activity) {
   CHECKANDTHROW(status == AR_SUCCESS, env, "Failed to resume AR session.");
 }
 
+bool HelloArApplication::PrepareSession(ArSession* session) {
+  ar_object_pool_.Initialize(session);
+  update_mode_controller_.Reset();
+  session_feature_policy_.Reset(SessionFeaturePolicy::Options(),
+                                std::chrono::steady_clock::now());
+  if (kUseAugmentedFaces) {
+    UseFrontCamera(session);
+  } else if (kUseCameraConfigPlanner) {
+    CameraConfigPlanner::Options options;
+    options.stereo_camera_usage =
+        AR_CAMERA_CONFIG_STEREO_CAMERA_USAGE_DO_NOT_USE;
+    camera_config_planner_.Apply(session, options);
+  }
+  ConfigureSession(session);
+
+  // The dataset can only be set while the session has not been resumed.
+  if (!benchmark_dataset_uri_.empty() &&
+      ArSession_setPlaybackDatasetUri(
+          session, benchmark_dataset_uri_.c_str()) != AR_SUCCESS) {
+    LOGE("Cannot play back %s", benchmark_dataset_uri_.c_str());
+    return false;
+  }
+  return true;
+}
+
+void HelloArApplication::AdoptStartedSession() {
+  if (ar_session_ != nullptr ||
+      session_starter_.GetState() != SessionStarter::State::kResumed) {
+    return;
+  }
+  ar_session_ = session_starter_.TakeSession();
+  ArFrame_create(ar_session_, &ar_frame_);
+  background_covers_surface_ = false;
+  ArSession_setDisplayGeometry(ar_session_, display_rotation_, width_,
+                               height_);
+  LOGI("Adopted the AR session: %s", session_starter_.GetReport().c_str());
+}
+
 void HelloArApplication::OnSurfaceCreated() {
   LOGI("OnSurfaceCreated()");
+  const auto start = std::chrono::steady_clock::now();
+  // Nothing was drawn into the new surface yet.
+  redraw_gate_.Reset();
+  // The buffers went away with the previous context.
+  frame_readback_.Reset();
+
+  if (IsBenchmarkRunning()) {
+    // Frames are timed as fast as they can be drawn, not at display rate.
+    eglSwapInterval(eglGetCurrentDisplay(), 0);
+  }
+
+  // The GLSurfaceView preserves the context over a pause, so this normally
+  // only runs again once the context was lost.  A new surface of the same
+  // context keeps everything.  Texture names are not valid in a new context
+  // until generated, so the camera texture tells a reused handle apart.
+  const EGLContext context = eglGetCurrentContext();
+  if (context != EGL_NO_CONTEXT && context == gl_content_context_ &&
+      glIsTexture(background_renderer_.GetTextureId())) {
+    LOGI("OnSurfaceCreated() kept the GL content");
+    return;
+  }
+  gl_content_context_ = context;
+  // Images bound to textures of the previous context are not reused.
+  egl_image_cache_.Flush();
+
+  // A new surface may come with a new GL context whose state is unknown.
+  util::GlStateCache::Get().Reset();
+  ResourceAccounting::Get().Reset();
+  // Uploads meant for the previous context are of no use anymore, and the
+  // upload thread's context is shared with it.
+  asset_loader_.DiscardPending();
+  gl_upload_thread_.Stop();
+  if (kUseGlUploadThread) {
+    gl_upload_thread_.Start();
+  }
+  util::TextureCache::Get().Reset(asset_manager_, &asset_loader_);
+  // The update thread's context is shared with the previous one.
+  ar_update_thread_.Stop();
+
+  util::ResetStartedPrograms();
+  if (kStartProgramsEarly) {
+    util::StartAllPrograms(asset_manager_);
+  }
 
+  gpu_stage_timers_.InitializeGlContent();
   depth_texture_.CreateOnGlThread();
+  depth_texture_.SetDepthSource(kUseRawDepth
+                                    ? Texture::DepthSource::kRawWithConfidence
+                                    : Texture::DepthSource::kSmoothed);
   background_renderer_.InitializeGlContent(asset_manager_,
                                            depth_texture_.GetTextureId());
   point_cloud_renderer_.InitializeGlContent(asset_manager_);
-  andy_renderer_.InitializeGlContent(asset_manager_, "models/andy.obj",
-                                     "models/andy.png");
+  andy_renderer_.InitializeGlContent(asset_manager_, "models/andy.mesh",
+                                     "models/andy.png", &asset_loader_);
   andy_renderer_.SetDepthTexture(depth_texture_.GetTextureId(),
                                  depth_texture_.GetWidth(),
                                  depth_texture_.GetHeight());
+  andy_renderer_.SetUseOcclusionMask(kUseOcclusionMask);
+  andy_renderer_.SetDepthConfidenceThreshold(
+      kUseRawDepth ? kRawDepthConfidenceThreshold : 0.0f);
+  skinned_andy_loaded_ =
+      kUseSkinnedAnchors &&
+      skinned_andy_renderer_.InitializeGlContent(
+          asset_manager_, kSkinnedAndyModel, "models/andy.png");
   plane_renderer_.InitializeGlContent(asset_manager_);
+  plane_renderer_.SetPolygonTolerance(kPlanePolygonToleranceM);
+  plane_renderer_.SetUseGpuCulling(kUseGpuCulling);
+  plane_renderer_.SetUseDepthPrepass(kUsePlaneDepthPrepass);
+  tsdf_mesh_renderer_.InitializeGlContent(asset_manager_);
+  streetscape_geometry_renderer_.InitializeGlContent(asset_manager_);
+  depth_pyramid_texture_.InitializeGlContent(asset_manager_);
+  occlusion_blur_texture_.InitializeGlContent(asset_manager_);
+  temporal_depth_filter_.InitializeGlContent(asset_manager_);
+  semantics_pipeline_.InitializeGlContent(asset_manager_);
+  environmental_hdr_lighting_.InitializeGlContent();
+  face_mesh_renderer_.InitializeGlContent(asset_manager_);
+  virtual_content_target_.InitializeGlContent(asset_manager_);
+  virtual_content_target_.SetSamples(kVirtualContentSamples);
+  if (virtual_content_target_.GetSamples() > 1) {
+    LOGI("Virtual content at %dx MSAA", virtual_content_target_.GetSamples());
+  }
+  performance_hud_.InitializeGlContent(asset_manager_);
+  if (background_mesher_ != nullptr) {
+    // The block buffers went away with the previous context.
+    background_mesher_->InvalidateMeshes();
+  }
+  LOGI("OnSurfaceCreated() took %.1f ms",
+       std::chrono::duration<float, std::milli>(
+           std::chrono::steady_clock::now() - start)
+           .count());
 }
 
 void HelloArApplication::OnDisplayGeometryChanged(int display_rotation,
@@ -134,333 +785,2524 @@ void HelloArApplication::OnDisplayGeometryChanged(int display_rotation,
   display_rotation_ = display_rotation;
   width_ = width;
   height_ = height;
+  state_capture_.SetDisplayGeometry(display_rotation, width, height);
+  SetVirtualContentScale(render_scale_governor_.GetScale());
+  if (kUseCameraCopy) {
+    background_renderer_.SetCameraCopySize(width / kCameraCopyDownscale,
+                                           height / kCameraCopyDownscale);
+  }
   if (ar_session_ != nullptr) {
     ArSession_setDisplayGeometry(ar_session_, display_rotation, width, height);
   }
 }
 
-void HelloArApplication::OnDrawFrame(bool depthColorVisualizationEnabled,
-                                     bool useDepthForOcclusion) {
-  // Render the scene.
-  glClearColor(0.9f, 0.9f, 0.9f, 1.0f);
-  glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+template <typename PlaneVisitor>
+int32_t HelloArApplication::ForEachVisiblePlane(PlaneVisitor visit) {
+  for (const ArPlane* ar_plane : plane_registry_.GetRenderablePlanes()) {
+    visit(*ar_plane);
+  }
+  return static_cast<int32_t>(plane_registry_.GetPlaneCount());
+}
 
-  glEnable(GL_CULL_FACE);
-  glEnable(GL_DEPTH_TEST);
+bool HelloArApplication::StartPlaybackBenchmark(const std::string& dataset_uri,
+                                                const std::string& csv_path) {
+  if (!playback_benchmark_.Open(csv_path)) {
+    return false;
+  }
+  LOGI("Playback benchmark of %s into %s", dataset_uri.c_str(),
+       csv_path.c_str());
+  benchmark_dataset_uri_ = dataset_uri;
+  benchmark_finished_ = false;
+  return true;
+}
 
-  if (ar_session_ == nullptr) return;
+bool HelloArApplication::StartCameraTextureBenchmark(
+    const std::string& dataset_uri, const std::string& report_path) {
+  if (kUseArUpdateThread) {
+    LOGE("The camera texture benchmark needs the session updated on the GL "
+         "thread");
+    return false;
+  }
+  const bool hardware_buffer_supported = EglImageCache::IsSupported();
+  if (!camera_texture_benchmark_.Start(report_path,
+                                       hardware_buffer_supported)) {
+    return false;
+  }
+  LOGI("Camera texture benchmark of %s into %s%s",
+       dataset_uri.empty() ? "the camera" : dataset_uri.c_str(),
+       report_path.c_str(),
+       hardware_buffer_supported ? "" : ", without hardware buffers");
+  benchmark_dataset_uri_ = dataset_uri;
+  benchmark_finished_ = false;
+  return true;
+}
 
-  ArSession_setCameraTextureName(ar_session_,
-                                 background_renderer_.GetTextureId());
+bool HelloArApplication::StartArCoreApiProfiler(
+    const std::string& report_path, const std::string& arcore_version) {
+  if (kUseArUpdateThread) {
+    LOGE("The ARCore API profiler needs the session updated on the GL thread");
+    return false;
+  }
+  if (!arcore_api_profiler_.Start(report_path, arcore_version)) {
+    return false;
+  }
+  LOGI("Profiling ARCore %s API calls into %s", arcore_version.c_str(),
+       report_path.c_str());
+  benchmark_finished_ = false;
+  return true;
+}
 
-  // Update session to get current frame and render camera background.
-  if (ArSession_update(ar_session_, ar_frame_) != AR_SUCCESS) {
-    LOGE("HelloArApplication::OnDrawFrame ArSession_update error");
+bool HelloArApplication::StartCapture(const std::string& video_path,
+                                      const std::string& dataset_uri) {
+  if (ar_session_ == nullptr) {
+    return false;
   }
+  return session_capture_.Start(ar_session_, video_path, dataset_uri, width_,
+                                height_);
+}
 
-  andy_renderer_.SetDepthTexture(depth_texture_.GetTextureId(),
-                                 depth_texture_.GetWidth(),
-                                 depth_texture_.GetHeight());
+bool HelloArApplication::OnDrawFrame(bool depthColorVisualizationEnabled,
+                                     bool useDepthForOcclusion,
+                                     bool can_skip_frame) {
+  gpu_stage_timers_.BeginFrame();
+  frame_stage_timers_.BeginFrame();
+  const auto frame_start = std::chrono::steady_clock::now();
+  const int64_t resume_time_ns = resume_time_ns_.exchange(0);
+  if (resume_time_ns != 0) {
+    LOGI("First frame %.1f ms after OnResume()",
+         (std::chrono::duration_cast<std::chrono::nanoseconds>(
+              frame_start.time_since_epoch())
+              .count() -
+          resume_time_ns) *
+             1e-6f);
+  }
+  if (!IsBenchmarkRunning()) {
+    // Idle frames are not even updated.  The update thread decides on its
+    // own when to publish.
+    if (kUseRedrawGate && can_skip_frame && !kUseArUpdateThread &&
+        !redraw_gate_.IsFrameDue(frame_start)) {
+      IdlePerformanceHint(frame_start);
+      return false;
+    }
+    if (kUseThermalGovernor) {
+      UpdateThermalGovernor();
+    }
+    // The benchmark measures the content at full resolution.
+    if (kUseDynamicRenderScale) {
+      UpdateRenderScale();
+    }
+    if (!DrawFrame(depthColorVisualizationEnabled, useDepthForOcclusion,
+                   can_skip_frame)) {
+      surface_render_pass_.End();
+      IdlePerformanceHint(frame_start);
+      return false;
+    }
+    const auto frame_time = std::chrono::steady_clock::now() - frame_start;
+    if (kUsePerformanceHints) {
+      ReportPerformanceHint(frame_time);
+    }
+    RecordTelemetry(frame_time);
+    RecordDatasetFrame(frame_time);
+    CaptureState();
+    PublishUiState(frame_time);
+    session_capture_.CaptureFrame();
+    UpdateFrameReadback();
+    // Drawn after the capture, so recordings show the scene only.  The
+    // benchmark frames below are never covered by it.
+    DrawPerformanceHud();
+    surface_render_pass_.End();
+    return true;
+  }
 
-  ArCamera* ar_camera;
-  ArFrame_acquireCamera(ar_session_, ar_frame_, &ar_camera);
+  // Every frame of the benchmark is timed.
+  DrawFrame(depthColorVisualizationEnabled, useDepthForOcclusion,
+            /*can_skip_frame=*/false);
+  surface_render_pass_.End();
+  // Waits for the GPU so the frame time includes the draw calls' execution,
+  // which would otherwise be hidden by the missing vsync throttling.
+  glFinish();
+  const auto frame_time = std::chrono::steady_clock::now() - frame_start;
+  RecordBenchmarkFrame(frame_time);
+  RecordTelemetry(frame_time);
+  RecordDatasetFrame(frame_time);
+  CaptureState();
+  PublishUiState(frame_time);
+  session_capture_.CaptureFrame();
+  UpdateFrameReadback();
+  return true;
+}
 
-  int32_t geometry_changed = 0;
-  ArFrame_getDisplayGeometryChanged(ar_session_, ar_frame_, &geometry_changed);
-  if (geometry_changed != 0 || !calculate_uv_transform_) {
-    // The UV Transform represents the transformation between screenspace in
-    // normalized units and screenspace in units of pixels.  Having the size of
-    // each pixel is necessary in the virtual object shader, to perform
-    // kernel-based blur effects.
-    calculate_uv_transform_ = false;
-    glm::mat3 transform = GetTextureTransformMatrix(ar_session_, ar_frame_);
-    andy_renderer_.SetUvTransformMatrix(transform);
+void HelloArApplication::ReportPerformanceHint(
+    std::chrono::nanoseconds frame_time) {
+  // The threads come and go with OnPause() and OnResume(); the session only
+  // changes when they did.
+  performance_hint_thread_ids_.clear();
+  performance_hint_thread_ids_.push_back(gettid());
+  const int32_t update_thread_id = ar_update_thread_.GetThreadId();
+  if (update_thread_id != 0) {
+    performance_hint_thread_ids_.push_back(update_thread_id);
   }
+  util::JobSystem::Get().GetWorkerThreadIds(&performance_hint_thread_ids_);
+  performance_hint_session_.SetThreads(performance_hint_thread_ids_);
+  performance_hint_session_.ReportActualWork(frame_time);
+  last_performance_hint_ = std::chrono::steady_clock::now();
+}
 
-  glm::mat4 view_mat;
-  glm::mat4 projection_mat;
-  ArCamera_getViewMatrix(ar_session_, ar_camera, glm::value_ptr(view_mat));
-  ArCamera_getProjectionMatrix(ar_session_, ar_camera,
-                               /*near=*/0.1f, /*far=*/100.f,
-                               glm::value_ptr(projection_mat));
+void HelloArApplication::IdlePerformanceHint(
+    std::chrono::steady_clock::time_point now) {
+  if (kUsePerformanceHints &&
+      now - last_performance_hint_ >= kPerformanceHintIdleTimeout) {
+    performance_hint_session_.Pause();
+  }
+}
 
-  background_renderer_.Draw(ar_session_, ar_frame_,
-                            depthColorVisualizationEnabled);
+bool HelloArApplication::StartDatasetRecording(const std::string& dataset_uri) {
+  if (ar_session_ == nullptr) {
+    return false;
+  }
+  return dataset_recorder_.Start(ar_session_, dataset_uri);
+}
 
-  ArTrackingState camera_tracking_state;
-  ArCamera_getTrackingState(ar_session_, ar_camera, &camera_tracking_state);
-  ArCamera_release(ar_camera);
+bool HelloArApplication::StopDatasetRecording() {
+  if (ar_session_ == nullptr) {
+    return false;
+  }
+  return dataset_recorder_.Stop(ar_session_);
+}
 
-  // If the camera isn't tracking don't bother rendering other objects.
-  if (camera_tracking_state != AR_TRACKING_STATE_TRACKING) {
+void HelloArApplication::RecordDatasetFrame(
+    std::chrono::nanoseconds frame_time) {
+  // With the update thread, the frame belongs to that thread.
+  if (ar_session_ == nullptr || kUseArUpdateThread) {
     return;
   }
+  dataset_recorder_.OnFrameDrawn(ar_session_, ar_frame_, frame_time);
+}
 
-  int32_t is_depth_supported = 0;
-  ArSession_isDepthModeSupported(ar_session_, AR_DEPTH_MODE_AUTOMATIC,
-                                 &is_depth_supported);
-  if (is_depth_supported) {
-    depth_texture_.UpdateWithDepthImageOnGlThread(*ar_session_, *ar_frame_);
+bool HelloArApplication::StartStateCapture(const std::string& path) {
+  if (ar_session_ == nullptr) {
+    return false;
   }
+  StateCapture::Options options;
+  options.projection_near = kProjectionNear;
+  options.projection_far = kProjectionFar;
+  options.spherical_harmonics = kUseEnvironmentalHdr;
+  return state_capture_.Start(ar_session_, path, options);
+}
 
-  // Get light estimation value.
-  ArLightEstimate* ar_light_estimate;
-  ArLightEstimateState ar_light_estimate_state;
-  ArLightEstimate_create(ar_session_, &ar_light_estimate);
-
-  ArFrame_getLightEstimate(ar_session_, ar_frame_, ar_light_estimate);
-  ArLightEstimate_getState(ar_session_, ar_light_estimate,
-                           &ar_light_estimate_state);
-
-  // Set light intensity to default. Intensity value ranges from 0.0f to 1.0f.
-  // The first three components are color scaling factors.
-  // The last one is the average pixel intensity in gamma space.
-  float color_correction[4] = {1.f, 1.f, 1.f, 1.f};
-  if (ar_light_estimate_state == AR_LIGHT_ESTIMATE_STATE_VALID) {
-    ArLightEstimate_getColorCorrection(ar_session_, ar_light_estimate,
-                                       color_correction);
+void HelloArApplication::UpdateFrameReadback() {
+  frame_readback_.Update();
+  if (screenshot_path_.empty()) {
+    return;
   }
+  std::string path;
+  path.swap(screenshot_path_);
+  frame_readback_.Capture(
+      width_, height_, kScreenshotScale, frame_context_.timestamp_ns,
+      [path](const FrameReadback::Image& image) {
+        if (WritePpm(path, image)) {
+          LOGI("Screenshot of %dx%d written to %s", image.width, image.height,
+               path.c_str());
+        }
+      });
+}
 
-  ArLightEstimate_destroy(ar_light_estimate);
-  ar_light_estimate = nullptr;
+void HelloArApplication::CaptureState() {
+  // With the update thread, the frame belongs to that thread.
+  if (!state_capture_.IsRunning() || ar_session_ == nullptr ||
+      kUseArUpdateThread) {
+    return;
+  }
+  const ArImage* depth_image =
+      is_depth_supported_
+          ? frame_image_cache_.Get(FrameImageCache::ImageType::kDepth)
+          : nullptr;
+  state_capture_.CaptureFrame(ar_session_, ar_frame_, depth_image,
+                              anchor_store_);
+}
 
-  // Update and render planes.
-  ArTrackableList* plane_list = nullptr;
-  ArTrackableList_create(ar_session_, &plane_list);
-  CHECK(plane_list != nullptr);
+void HelloArApplication::PublishUiState(std::chrono::nanoseconds frame_time) {
+  UiState state;
+  state.frame_timestamp_ns = frame_context_.timestamp_ns;
+  state.frame_count = ++ui_state_frame_count_;
+  state.plane_count = plane_count_;
+  state.tracking_state = frame_context_.camera_tracking_state;
+  if (is_depth_supported_) {
+    state.flags |= UiState::kFlagDepthSupported;
+  }
+  if (benchmark_finished_) {
+    state.flags |= UiState::kFlagPlaybackBenchmarkFinished;
+  }
+  state.render_scale = GetRenderScale();
+  state.anchors_drawn = anchors_drawn_last_frame_;
+  state.anchors_culled = anchors_culled_last_frame_;
+  state.depth_uploads_per_second = depth_uploads_per_second_;
+  state.frame_ms =
+      std::chrono::duration_cast<std::chrono::microseconds>(frame_time)
+          .count() /
+      1000.f;
+  state.idle_frame_interval_ms =
+      static_cast<int32_t>(redraw_gate_.GetFrameInterval().count());
+  ui_state_channel_.Publish(state);
+}
 
-  ArTrackableType plane_tracked_type = AR_TRACKABLE_PLANE;
-  ArSession_getAllTrackables(ar_session_, plane_tracked_type, plane_list);
+void HelloArApplication::RecordTelemetry(std::chrono::nanoseconds frame_time) {
+  // With the update thread, the frame and the counts belong to that thread.
+  if (!telemetry_log_.IsRunning() || ar_session_ == nullptr ||
+      kUseArUpdateThread) {
+    return;
+  }
+  // The governor reads the thermal status itself when it runs.
+  const auto now = std::chrono::steady_clock::now();
+  if (!kUseThermalGovernor &&
+      now - last_thermal_update_ >= kThermalUpdateInterval) {
+    last_thermal_update_ = now;
+    thermal_reading_ = thermal_monitor_.Read();
+  }
 
-  int32_t plane_list_size = 0;
-  ArTrackableList_getSize(ar_session_, plane_list, &plane_list_size);
-  plane_count_ = plane_list_size;
+  FrameTelemetryRecord record = {};
+  record.timestamp_ns = frame_context_.timestamp_ns;
+  record.frame_index = telemetry_frame_index_++;
+  record.frame_us = static_cast<uint32_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(frame_time)
+          .count());
+  const auto stages = frame_stage_timers_.GetFrameDurations();
+  for (int i = 0; i < kNumFrameStages; ++i) {
+    record.stage_us[i] = static_cast<uint32_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(stages[i])
+            .count());
+  }
+  record.plane_count = static_cast<uint16_t>(
+      std::min<size_t>(plane_registry_.GetPlaneCount(), UINT16_MAX));
+  record.anchor_count = static_cast<uint16_t>(
+      std::min<size_t>(anchor_store_.GetSize(), UINT16_MAX));
+  record.tracking_state =
+      static_cast<int8_t>(frame_context_.camera_tracking_state);
+  record.thermal_status = static_cast<int8_t>(thermal_reading_.status);
+  record.quality_level =
+      static_cast<uint8_t>(quality_level_.load(std::memory_order_relaxed));
+  record.hit_test_queries =
+      static_cast<uint32_t>(hit_test_cache_.GetQueryCount());
+  record.hit_test_calls = static_cast<uint32_t>(hit_test_cache_.GetCallCount());
+  if (FrameTelemetryLog::RecordTrackData(ar_session_, ar_frame_, record)) {
+    record.flags |= FrameTelemetryRecord::kFlagRecorded;
+  }
+  telemetry_log_.Push(record);
 
-  for (int i = 0; i < plane_list_size; ++i) {
-    ArTrackable* ar_trackable = nullptr;
-    ArTrackableList_acquireItem(ar_session_, plane_list, i, &ar_trackable);
-    ArPlane* ar_plane = ArAsPlane(ar_trackable);
-    ArTrackingState out_tracking_state;
-    ArTrackable_getTrackingState(ar_session_, ar_trackable,
-                                 &out_tracking_state);
+  ArPlaybackStatus playback_status = AR_PLAYBACK_NONE;
+  ArSession_getPlaybackStatus(ar_session_, &playback_status);
+  if (playback_status == AR_PLAYBACK_OK) {
+    telemetry_log_.ReplayTrackData(ar_session_, ar_frame_);
+  }
+}
 
-    ArPlane* subsume_plane;
-    ArPlane_acquireSubsumedBy(ar_session_, ar_plane, &subsume_plane);
-    if (subsume_plane != nullptr) {
-      ArTrackable_release(ArAsTrackable(subsume_plane));
-      ArTrackable_release(ar_trackable);
-      continue;
+void HelloArApplication::RecordBenchmarkFrame(
+    std::chrono::nanoseconds frame_time) {
+  if (ar_session_ == nullptr) {
+    return;
+  }
+  // The render scale governor, which also takes the GPU times, is not run
+  // during the benchmark.  The results trail the frames by a few frames.
+  std::array<float, kNumFrameStages> gpu_stages_ms;
+  for (int i = 0; i < kNumFrameStages; ++i) {
+    gpu_stages_ms[i] =
+        gpu_stage_timers_.TakeRecentAverageMs(static_cast<FrameStage>(i));
+  }
+  const auto stages = frame_stage_timers_.GetFrameDurations();
+  playback_benchmark_.RecordFrame(frame_context_.timestamp_ns, stages,
+                                  gpu_stages_ms, frame_time);
+
+  ArPlaybackStatus playback_status = AR_PLAYBACK_NONE;
+  ArSession_getPlaybackStatus(ar_session_, &playback_status);
+  bool finished = false;
+  if (camera_texture_benchmark_.IsRunning()) {
+    const int background = static_cast<int>(FrameStage::kBackground);
+    CameraTextureBenchmark::FrameSample sample;
+    sample.mode = camera_texture_mode_;
+    sample.update_cpu = stages[static_cast<int>(FrameStage::kArUpdate)];
+    sample.background_cpu = stages[background];
+    sample.background_gpu_ms = gpu_stages_ms[background];
+    sample.frame_time = frame_time;
+    const bool is_live = playback_status == AR_PLAYBACK_NONE;
+    // The camera timestamps are close to CLOCK_BOOTTIME, but those of a
+    // played back dataset are the recorded ones.
+    if (is_live && frame_context_.timestamp_ns != 0) {
+      timespec now;
+      clock_gettime(CLOCK_BOOTTIME, &now);
+      const int64_t latency_ns = now.tv_sec * 1000000000LL + now.tv_nsec -
+                                 frame_context_.timestamp_ns;
+      if (latency_ns > 0 && latency_ns < 1000000000LL) {
+        sample.camera_latency_ms = latency_ns * 1e-6f;
+      }
     }
-
-    if (ArTrackingState::AR_TRACKING_STATE_TRACKING != out_tracking_state) {
-      ArTrackable_release(ar_trackable);
-      continue;
+    finished = camera_texture_benchmark_.RecordFrame(sample, is_live);
+  }
+  if (playback_status == AR_PLAYBACK_FINISHED ||
+      playback_status == AR_PLAYBACK_IO_ERROR) {
+    if (playback_status == AR_PLAYBACK_IO_ERROR) {
+      LOGE("Playback benchmark stopped by a dataset read error");
     }
+    finished = true;
+  }
+  if (finished) {
+    playback_benchmark_.Finish();
+    camera_texture_benchmark_.Finish();
+    benchmark_finished_ = true;
+  }
+}
 
-    plane_renderer_.Draw(projection_mat, view_mat, *ar_session_, *ar_plane);
-    ArTrackable_release(ar_trackable);
+bool HelloArApplication::DrawFrame(bool depthColorVisualizationEnabled,
+                                   bool useDepthForOcclusion,
+                                   bool can_skip_frame) {
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
+  gl_state.BeginFrame();
+  // Renderers draw once their textures arrive and switch to finer levels of
+  // detail as they stream in; neither holds up the camera image.
+  asset_uploads_last_frame_ = asset_loader_.RunUploads(kAssetUploadBudget);
+  andy_renderer_.UpdateStreamedLods();
+
+  if (kUseAsyncSessionStart) {
+    AdoptStartedSession();
   }
 
-  ArTrackableList_destroy(plane_list);
-  plane_list = nullptr;
+  // Render the scene.  The camera image overwrites the color unless there
+  // is none yet.
+  static constexpr GLfloat kClearColor[4] = {0.9f, 0.9f, 0.9f, 1.0f};
+  surface_render_pass_.Begin(
+      ar_session_ != nullptr && background_covers_surface_, kClearColor);
 
-  andy_renderer_.setUseDepthForOcclusion(asset_manager_, useDepthForOcclusion);
+  gl_state.SetCapability(GL_CULL_FACE, true);
+  gl_state.SetCapability(GL_DEPTH_TEST, true);
 
-  // Render Andy objects.
-  glm::mat4 model_mat(1.0f);
-  for (auto& colored_anchor : anchors_) {
-    ArTrackingState tracking_state = AR_TRACKING_STATE_STOPPED;
-    ArAnchor_getTrackingState(ar_session_, colored_anchor.anchor,
-                              &tracking_state);
-    if (tracking_state == AR_TRACKING_STATE_TRACKING) {
-      UpdateAnchorColor(&colored_anchor);
-      // Render object only if the tracking state is AR_TRACKING_STATE_TRACKING.
-      util::GetTransformMatrixFromAnchor(*colored_anchor.anchor, ar_session_,
-                                         &model_mat);
-      andy_renderer_.Draw(projection_mat, view_mat, model_mat, color_correction,
-                          colored_anchor.color);
-    }
-  }
+  if (ar_session_ == nullptr) return true;
 
-  // Update and render point cloud.
-  ArPointCloud* ar_point_cloud = nullptr;
-  ArStatus point_cloud_status =
-      ArFrame_acquirePointCloud(ar_session_, ar_frame_, &ar_point_cloud);
-  if (point_cloud_status == AR_SUCCESS) {
-    point_cloud_renderer_.Draw(projection_mat * view_mat, ar_session_,
-                               ar_point_cloud);
-    ArPointCloud_release(ar_point_cloud);
-  }
-}
+  const bool depth_settings_changed =
+      depth_visualization_enabled_ != depthColorVisualizationEnabled ||
+      use_depth_for_occlusion_ != useDepthForOcclusion;
+  // The thread that updates the session culls the anchors with these and
+  // decides from them whether depth is needed.
+  depth_visualization_enabled_ = depthColorVisualizationEnabled;
+  use_depth_for_occlusion_ = useDepthForOcclusion;
 
-bool HelloArApplication::IsDepthSupported() {
-  int32_t is_supported = 0;
-  ArSession_isDepthModeSupported(ar_session_, AR_DEPTH_MODE_AUTOMATIC,
-                                 &is_supported);
-  return is_supported;
-}
+  if (kUseArUpdateThread) {
+    DrawLatestSnapshot(depthColorVisualizationEnabled, useDepthForOcclusion);
+    return true;
+  }
 
-void HelloArApplication::ConfigureSession() {
-  const bool is_depth_supported = IsDepthSupported();
+  // Scratch ARCore handles from the previous frame are reused from here on,
+  // and its images released before the session moves to the next one.
+  ar_object_pool_.BeginFrame();
+  frame_image_cache_.BeginFrame(ar_session_, ar_frame_);
 
-  ArConfig* ar_config = nullptr;
-  ArConfig_create(ar_session_, &ar_config);
-  if (is_depth_supported) {
-    ArConfig_setDepthMode(ar_session_, ar_config, AR_DEPTH_MODE_AUTOMATIC);
-  } else {
-    ArConfig_setDepthMode(ar_session_, ar_config, AR_DEPTH_MODE_DISABLED);
+  UpdateCameraTextureMode();
+  if (camera_texture_mode_ == CameraTextureMode::kTextureName) {
+    ArSession_setCameraTextureName(ar_session_,
+                                   background_renderer_.GetTextureId());
   }
 
-  if (is_instant_placement_enabled_) {
-    ArConfig_setInstantPlacementMode(ar_session_, ar_config,
-                                     AR_INSTANT_PLACEMENT_MODE_LOCAL_Y_UP);
-  } else {
-    ArConfig_setInstantPlacementMode(ar_session_, ar_config,
-                                     AR_INSTANT_PLACEMENT_MODE_DISABLED);
+  ApplyPendingEvents();
+
+  // Update session to get current frame and render camera background.
+  const auto update_start = std::chrono::steady_clock::now();
+  {
+    ScopedFrameStageTimer timer(&frame_stage_timers_, FrameStage::kArUpdate);
+    if (traced::ArSession_update(ar_session_, ar_frame_) != AR_SUCCESS) {
+      LOGE("HelloArApplication::DrawFrame ArSession_update error");
+    }
   }
-  CHECK(ar_config);
-  CHECK(ArSession_configure(ar_session_, ar_config) == AR_SUCCESS);
-  ArConfig_destroy(ar_config);
-}
+  const auto update_duration = std::chrono::steady_clock::now() - update_start;
 
-void HelloArApplication::OnSettingsChange(bool is_instant_placement_enabled) {
-  is_instant_placement_enabled_ = is_instant_placement_enabled;
+  UpdateFrameContext();
+  const FrameContext& frame_context = frame_context_;
 
-  if (ar_session_ != nullptr) {
-    ConfigureSession();
+  if (arcore_api_profiler_.IsRunning() &&
+      arcore_api_profiler_.ProfileFrame(ar_session_, ar_frame_)) {
+    arcore_api_profiler_.Finish();
+    benchmark_finished_ = true;
   }
-}
 
-void HelloArApplication::OnTouched(float x, float y) {
-  if (ar_frame_ != nullptr && ar_session_ != nullptr) {
-    ArHitResultList* hit_result_list = nullptr;
-    ArHitResultList_create(ar_session_, &hit_result_list);
-    CHECK(hit_result_list);
-    if (is_instant_placement_enabled_) {
-      ArFrame_hitTestInstantPlacement(ar_session_, ar_frame_, x, y,
-                                      kApproximateDistanceMeters,
-                                      hit_result_list);
-    } else {
-      ArFrame_hitTest(ar_session_, ar_frame_, x, y, hit_result_list);
+  // Played back datasets are benchmarked frame by frame.
+  if (kUseUpdateModeController && !IsBenchmarkRunning() &&
+      update_mode_controller_.RecordUpdate(update_start, update_duration,
+                                           frame_context.timestamp_ns)) {
+    ConfigureSession(ar_session_);
+  }
+
+  if (kUseRedrawGate) {
+    // Nothing the frame draws changes without a new camera image, except
+    // through these.
+    RedrawGate::FrameState state;
+    state.timestamp_ns = frame_context.timestamp_ns;
+    state.tracking_state = frame_context.camera_tracking_state;
+    state.must_draw = !can_skip_frame || !frame_touches_.empty() ||
+                      frame_context.display_geometry_changed ||
+                      depth_settings_changed || performance_hud_enabled_ ||
+                      session_capture_.IsCapturing();
+    if (!redraw_gate_.ShouldDraw(state, update_start + update_duration)) {
+      return false;
     }
+  }
+
+  // Anchors for the touches since the previous frame are placed before
+  // anything is drawn, so they show up in this frame.
+  ProcessPendingTouches();
 
-    int32_t hit_result_list_size = 0;
-    ArHitResultList_getSize(ar_session_, hit_result_list,
-                            &hit_result_list_size);
+  if (frame_context.display_geometry_changed || !calculate_uv_transform_) {
+    // The UV Transform represents the transformation between screenspace in
+    // normalized units and screenspace in units of pixels.  Having the size of
+    // each pixel is necessary in the virtual object shader, to perform
+    // kernel-based blur effects.
+    calculate_uv_transform_ = true;
+    glm::mat3 transform = GetTextureTransformMatrix(ar_session_, ar_frame_);
+    andy_renderer_.SetUvTransformMatrix(transform);
+  }
 
-    // The hitTest method sorts the resulting list by distance from the camera,
-    // increasing.  The first hit result will usually be the most relevant when
-    // responding to user input.
+  const glm::mat4& view_mat = frame_context.view_mat;
+  const glm::mat4& projection_mat = frame_context.projection_mat;
+
+  // The passes run in ExecuteFrameGraph(), after the depth texture below got
+  // this frame's image.
+  frame_graph_.AddPass(MakePass(
+      "background", FrameGraph::Phase::kBackground, GetBackgroundPassState(),
+      FrameStage::kBackground, [&] {
+        // Timed with the background, so the modes compare by the stages
+        // they spend the camera image's cost in.
+        const bool uses_hardware_buffer =
+            camera_texture_mode_ == CameraTextureMode::kHardwareBuffer;
+        if (uses_hardware_buffer) {
+          BindCameraHardwareBuffer();
+        }
+        background_renderer_.SetStabilizationMode(stabilization_mode_);
+        background_renderer_.Draw(ar_session_, ar_frame_, frame_context,
+                                  depthColorVisualizationEnabled);
+        if (uses_hardware_buffer) {
+          // The background pass is the only one sampling the camera buffer.
+          egl_image_cache_.InsertReleaseFence();
+        }
+        background_covers_surface_ = frame_context.timestamp_ns != 0;
+      }));
 
-    ArHitResult* ar_hit_result = nullptr;
-    for (int32_t i = 0; i < hit_result_list_size; ++i) {
-      ArHitResult* ar_hit = nullptr;
-      ArHitResult_create(ar_session_, &ar_hit);
-      ArHitResultList_getItem(ar_session_, hit_result_list, i, ar_hit);
+  // Refresh the cached meshes of planes that changed since the last update,
+  // and drop the ones that will not be drawn again.  Updates are reported
+  // once, so this runs even while not tracking.
+  ProcessUpdatedPlanes(/*update_meshes=*/true);
+  ProcessUpdatedStreetscapeGeometry();
+  UpdateGeospatialAnchors();
+  UpdateCloudAnchors();
 
-      if (ar_hit == nullptr) {
-        LOGE("HelloArApplication::OnTouched ArHitResultList_getItem error");
-        return;
-      }
+  // If the camera isn't tracking don't bother rendering other objects.
+  if (!frame_context.IsTracking()) {
+    // Poses from before tracking was lost would misplace the depth history.
+    temporal_depth_filter_.Reset();
+    ApplyLatePose();
+    ExecuteFrameGraph();
+    return true;
+  }
 
-      ArTrackable* ar_trackable = nullptr;
-      ArHitResult_acquireTrackable(ar_session_, ar_hit, &ar_trackable);
-      ArTrackableType ar_trackable_type = AR_TRACKABLE_NOT_VALID;
-      ArTrackable_getType(ar_session_, ar_trackable, &ar_trackable_type);
-      // Creates an anchor if a plane or an oriented point was hit.
-      if (AR_TRACKABLE_PLANE == ar_trackable_type) {
-        ArPose* hit_pose = nullptr;
-        ArPose_create(ar_session_, nullptr, &hit_pose);
-        ArHitResult_getHitPose(ar_session_, ar_hit, hit_pose);
-        int32_t in_polygon = 0;
-        ArPlane* ar_plane = ArAsPlane(ar_trackable);
-        ArPlane_isPoseInPolygon(ar_session_, ar_plane, hit_pose, &in_polygon);
-
-        // Use hit pose and camera pose to check if hittest is from the
-        // back of the plane, if it is, no need to create the anchor.
-        ArPose* camera_pose = nullptr;
-        ArPose_create(ar_session_, nullptr, &camera_pose);
-        ArCamera* ar_camera;
-        ArFrame_acquireCamera(ar_session_, ar_frame_, &ar_camera);
-        ArCamera_getPose(ar_session_, ar_camera, camera_pose);
-        ArCamera_release(ar_camera);
-        float normal_distance_to_plane = util::CalculateDistanceToPlane(
-            *ar_session_, *hit_pose, *camera_pose);
-
-        ArPose_destroy(hit_pose);
-        ArPose_destroy(camera_pose);
-
-        if (!in_polygon || normal_distance_to_plane < 0) {
-          continue;
+  if (frame_context.is_depth_supported) {
+    ScopedFrameStageTimer timer(&frame_stage_timers_,
+                                FrameStage::kDepthUpload, &gpu_stage_timers_);
+    // Depth arrives at a lower rate than frames.  Everything derived from
+    // it is only refreshed when the texture got a new image, otherwise the
+    // previous one is still current.
+    const bool depth_uploaded =
+        depth_texture_.UpdateWithDepthImageOnGlThread(*ar_session_,
+                                                      &frame_image_cache_);
+    depth_uploads_per_second_ = depth_texture_.GetUploadsPerSecond();
+    if (depth_uploaded) {
+      // The texture object is replaced when the depth resolution changes.
+      background_renderer_.SetDepthTexture(depth_texture_.GetTextureId());
+      UpdateOcclusionDepth(frame_context, useDepthForOcclusion);
+      UpdateDepthConsumers(frame_context, useDepthForOcclusion);
+    }
+  } else {
+    depth_pyramid_.Clear();
+    depth_query_.Clear();
+  }
+  UpdateSemantics();
+  UpdateEnvironmentalHdr();
+
+  // The TSDF mesh is timed with the planes and sets its own culling.
+  frame_graph_.AddPass(MakePass(
+      "planes", FrameGraph::Phase::kTransparent, GetPlanePassState(),
+      FrameStage::kPlanes, [&] {
+        // Update and render planes.  The planes overlap and blend, so they
+        // are drawn, or added to the batch, back to front.
+        const GLuint plane_program =
+            plane_renderer_.GetProgram(kUseBatchedPlaneRendering);
+        plane_count_ = ForEachVisiblePlane([&](const ArPlane& ar_plane) {
+          const glm::vec3 center =
+              plane_renderer_.GetPlaneCenter(*ar_session_, ar_plane);
+          RenderQueue::Packet packet;
+          packet.key = RenderQueue::MakeKey(
+              FrameGraph::Phase::kTransparent, plane_program, 0, 0,
+              -(view_mat * glm::vec4(center, 1.0f)).z);
+          packet.state = GetPlanePassState();
+          // Small enough captures for std::function to store in place.
+          const ArPlane* plane = &ar_plane;
+          if (kUseBatchedPlaneRendering) {
+            packet.draw = [this, plane] {
+              plane_renderer_.AddToBatch(*ar_session_, *plane);
+            };
+          } else {
+            packet.draw = [this, plane] {
+              plane_renderer_.Draw(frame_context_.projection_mat,
+                                   frame_context_.view_mat, *ar_session_,
+                                   *plane);
+            };
+          }
+          render_queue_.Add(std::move(packet));
+        });
+        render_queue_.Submit();
+
+        if (kUseBatchedPlaneRendering) {
+          plane_renderer_.DrawBatch(projection_mat, view_mat);
         }
-
-        ar_hit_result = ar_hit;
-        break;
-      } else if (AR_TRACKABLE_POINT == ar_trackable_type) {
-        ArPoint* ar_point = ArAsPoint(ar_trackable);
-        ArPointOrientationMode mode;
-        ArPoint_getOrientationMode(ar_session_, ar_point, &mode);
-        if (AR_POINT_ORIENTATION_ESTIMATED_SURFACE_NORMAL == mode) {
-          ar_hit_result = ar_hit;
-          break;
+        if (background_mesher_ != nullptr) {
+          UpdateTsdfMeshes();
+          tsdf_mesh_renderer_.Draw(frame_context.view_projection_mat);
         }
-      } else if (AR_TRACKABLE_INSTANT_PLACEMENT_POINT == ar_trackable_type) {
-        ar_hit_result = ar_hit;
-      } else if (AR_TRACKABLE_DEPTH_POINT == ar_trackable_type) {
-        // ArDepthPoints are only returned if ArConfig_setDepthMode() is called
-        // with AR_DEPTH_MODE_AUTOMATIC.
-        ar_hit_result = ar_hit;
-      }
-    }
+      }));
+
+  if (kUseStreetscapeGeometry) {
+    // Timed with the planes, the other geometry of the environment.
+    frame_graph_.AddPass(MakePass(
+        "streetscape", FrameGraph::Phase::kTransparent,
+        GetStreetscapePassState(), FrameStage::kPlanes, [&] {
+          streetscape_geometry_renderer_.Draw(
+              *ar_session_, frame_context.view_projection_mat,
+              ar_object_pool_.AcquirePose());
+        }));
+  }
 
-    if (ar_hit_result) {
-      // Note that the application is responsible for releasing the anchor
-      // pointer after using it. Call ArAnchor_release(anchor) to release.
-      ArAnchor* anchor = nullptr;
-      if (ArHitResult_acquireNewAnchor(ar_session_, ar_hit_result, &anchor) !=
-          AR_SUCCESS) {
-        LOGE(
-            "HelloArApplication::OnTouched ArHitResult_acquireNewAnchor error");
-        return;
-      }
+  if (kUseAugmentedFaces) {
+    frame_graph_.AddPass(MakePass(
+        "faces", FrameGraph::Phase::kTransparent, GetFaceMeshPassState(),
+        FrameStage::kAnchors, [&] {
+          ArTrackableList* faces = ar_object_pool_.AcquireTrackableList();
+          ArSession_getAllTrackables(ar_session_, AR_TRACKABLE_FACE, faces);
+          face_mesh_renderer_.Draw(*ar_session_, *faces,
+                                   frame_context.view_projection_mat,
+                                   ar_object_pool_.AcquirePose());
+        }));
+  }
 
-      ArTrackingState tracking_state = AR_TRACKING_STATE_STOPPED;
-      ArAnchor_getTrackingState(ar_session_, anchor, &tracking_state);
-      if (tracking_state != AR_TRACKING_STATE_TRACKING) {
-        ArAnchor_release(anchor);
-        return;
-      }
+  andy_renderer_.setUseDepthForOcclusion(useDepthForOcclusion);
+  frame_graph_.AddPass(MakePass(
+      "anchors", FrameGraph::Phase::kOpaque,
+      GetObjectPassState(GetAnchorProgram()), FrameStage::kAnchors, [&] {
+        // Render Andy objects.
+        CollectAndyInstances(&andy_instances_, &skinned_andy_instances_);
+        DrawAndyInstances(projection_mat, view_mat, frame_context,
+                          andy_instances_, skinned_andy_instances_);
+      }));
+
+  frame_graph_.AddPass(MakePass(
+      "point_cloud", FrameGraph::Phase::kOpaque,
+      GetPointCloudPassState(point_cloud_renderer_.GetProgram()),
+      FrameStage::kPointCloud, [&] { DrawPointCloud(frame_context); }));
+
+  // The passes read the view from frame_context_ when they run.
+  ApplyLatePose();
+  ExecuteFrameGraph();
+  return true;
+}
 
-      if (anchors_.size() >= kMaxNumberOfAndroidsToRender) {
-        ArAnchor_release(anchors_[0].anchor);
-        ArTrackable_release(anchors_[0].trackable);
-        anchors_.erase(anchors_.begin());
-      }
+void HelloArApplication::ApplyLatePose() {
+  if (!kUseLatePoseReprojection) {
+    return;
+  }
+  background_renderer_.SetReprojection(glm::mat3(1.f));
+  glm::quat rotation;
+  if (frame_context_.IsTracking() &&
+      PredictGyroCameraRotation(
+          frame_context_, LatePoseReprojector::Now() + kLatePosePredictionNs,
+          &rotation)) {
+    CorrectView(rotation, glm::vec3(0.f), &frame_context_);
+  }
+}
+
+void HelloArApplication::PredictSnapshotView(FrameContext* context) {
+  background_renderer_.SetReprojection(glm::mat3(1.f));
+  if (!context->IsTracking()) {
+    camera_pose_predictor_.Reset();
+    return;
+  }
+  // Snapshots drawn again add nothing.
+  const glm::mat4 camera_pose = glm::inverse(context->view_mat);
+  camera_pose_predictor_.AddPose(context->timestamp_ns,
+                                 glm::quat_cast(glm::mat3(camera_pose)),
+                                 glm::vec3(camera_pose[3]));
+
+  const int64_t target_ns = LatePoseReprojector::Now() + kLatePosePredictionNs;
+  glm::quat rotation(1.f, 0.f, 0.f, 0.f);
+  glm::vec3 translation(0.f);
+  bool has_prediction =
+      camera_pose_predictor_.Predict(target_ns, &rotation, &translation);
+  // The gyroscope knows the turn better than the last two frames.
+  glm::quat gyro_rotation;
+  if (kUseLatePoseReprojection &&
+      PredictGyroCameraRotation(*context, target_ns, &gyro_rotation)) {
+    rotation = gyro_rotation;
+    has_prediction = true;
+  }
+  if (has_prediction) {
+    CorrectView(rotation, translation, context);
+  }
+}
+
+bool HelloArApplication::PredictGyroCameraRotation(const FrameContext& context,
+                                                   int64_t target_ns,
+                                                   glm::quat* rotation) {
+  glm::quat sensor_rotation;
+  if (!late_pose_reprojector_.Start() ||
+      !late_pose_reprojector_.PredictSensorRotation(
+          context.timestamp_ns, target_ns, &sensor_rotation)) {
+    return false;
+  }
+  const float* sensor_pose_raw = context.android_sensor_pose_raw;
+  const glm::quat world_from_sensor(sensor_pose_raw[3], sensor_pose_raw[0],
+                                    sensor_pose_raw[1], sensor_pose_raw[2]);
+  // The view is the inverse of the display oriented camera pose.
+  const glm::quat world_from_camera =
+      glm::quat_cast(glm::transpose(glm::mat3(context.view_mat)));
+  const glm::quat sensor_from_camera =
+      glm::inverse(world_from_sensor) * world_from_camera;
+  // The turn of the camera since the frame, in its frame then.
+  *rotation = glm::inverse(sensor_from_camera) * sensor_rotation *
+              sensor_from_camera;
+  return true;
+}
+
+void HelloArApplication::CorrectView(const glm::quat& rotation,
+                                     const glm::vec3& translation,
+                                     FrameContext* context) {
+  context->view_mat = glm::mat4_cast(glm::inverse(rotation)) *
+                      glm::translate(glm::mat4(1.f), -translation) *
+                      context->view_mat;
+  context->view_projection_mat =
+      util::MultiplyMatrices(context->projection_mat, context->view_mat);
+
+  // Screen points of the corrected view are where the turn moved them in
+  // the camera image: K * rotation * K^-1 with K the projection's 3x3 part
+  // for camera space directions.  The image has no depth to follow the
+  // translation with.
+  const glm::mat4& projection = context->projection_mat;
+  const glm::mat3 k(projection[0][0], 0.f, 0.f, 0.f, projection[1][1], 0.f,
+                    projection[2][0], projection[2][1], -1.f);
+  background_renderer_.SetReprojection(k * glm::mat3_cast(rotation) *
+                                       glm::inverse(k));
+}
 
-      ArTrackable* ar_trackable = nullptr;
-      ArHitResult_acquireTrackable(ar_session_, ar_hit_result, &ar_trackable);
-      // Assign a color to the object for rendering based on the trackable type
-      // this anchor attached to. For AR_TRACKABLE_POINT, it's blue color, and
-      // for AR_TRACKABLE_PLANE, it's green color.
-      ColoredAnchor colored_anchor;
-      colored_anchor.anchor = anchor;
-      colored_anchor.trackable = ar_trackable;
+void HelloArApplication::DrawPointCloud(const FrameContext& frame_context) {
+  glm::vec4 surface_reticle;
+  if (GetSurfaceReticle(frame_context, &surface_reticle)) {
+    point_cloud_renderer_.Draw(frame_context.view_projection_mat,
+                               glm::value_ptr(surface_reticle), 1);
+  }
+  if (kUseDensePointCloud && frame_context.is_depth_supported) {
+    DrawDensePointCloud(frame_context);
+    return;
+  }
+  ArPointCloud* ar_point_cloud = nullptr;
+  ArStatus point_cloud_status =
+      traced::ArFrame_acquirePointCloud(ar_session_, ar_frame_,
+                                        &ar_point_cloud);
+  if (point_cloud_status == AR_SUCCESS) {
+    if (kUsePointCloudMap) {
+      point_cloud_map_.Update(ar_session_, ar_point_cloud);
+    } else {
+      point_cloud_renderer_.Draw(frame_context.view_projection_mat,
+                                 ar_session_, ar_point_cloud);
+    }
+    ArPointCloud_release(ar_point_cloud);
+  }
+  if (kUsePointCloudMap) {
+    point_cloud_renderer_.DrawMap(frame_context.view_projection_mat,
+                                  &point_cloud_map_);
+  }
+}
 
-      UpdateAnchorColor(&colored_anchor);
-      anchors_.push_back(colored_anchor);
+void HelloArApplication::DrawLatestSnapshot(bool depthColorVisualizationEnabled,
+                                            bool useDepthForOcclusion) {
+  if (!ar_update_thread_.IsRunning() &&
+      !ar_update_thread_.Start(
+          ar_session_, ar_frame_, [this] { ApplyPendingEvents(); },
+          [this](ArFrameSnapshot* snapshot) { FillSnapshot(snapshot); },
+          &frame_stage_timers_)) {
+    return;
+  }
 
-      ArHitResult_destroy(ar_hit_result);
-      ar_hit_result = nullptr;
+  bool is_new_snapshot = false;
+  const ArFrameSnapshot* snapshot =
+      ar_update_thread_.AcquireLatestSnapshot(&is_new_snapshot);
+  if (snapshot == nullptr) {
+    return;
+  }
+  // The view of the display time, while the data stays that of the frame.
+  FrameContext frame_context = snapshot->frame_context;
+  if (kUseDisplayRatePrediction) {
+    PredictSnapshotView(&frame_context);
+  }
+  const glm::mat4& view_mat = frame_context.view_mat;
+  const glm::mat4& projection_mat = frame_context.projection_mat;
+
+  andy_renderer_.SetUvTransformMatrix(snapshot->uv_transform);
+  frame_graph_.AddPass(MakePass(
+      "background", FrameGraph::Phase::kBackground, GetBackgroundPassState(),
+      FrameStage::kBackground, [&] {
+        background_renderer_.Draw(frame_context, snapshot->camera_texture_id,
+                                  snapshot->transformed_uvs,
+                                  snapshot->eis_warp,
+                                  depthColorVisualizationEnabled);
+      }));
+
+  plane_count_ = snapshot->plane_count;
+  if (!frame_context.IsTracking()) {
+    temporal_depth_filter_.Reset();
+    ExecuteFrameGraph();
+    return;
+  }
 
-      ArHitResultList_destroy(hit_result_list);
-      hit_result_list = nullptr;
+  // A snapshot drawn again has nothing new for the depth texture.
+  if (is_new_snapshot && snapshot->depth_image != nullptr) {
+    ScopedFrameStageTimer timer(&frame_stage_timers_,
+                                FrameStage::kDepthUpload, &gpu_stage_timers_);
+    // Consecutive snapshots often share a depth image.
+    const bool depth_uploaded =
+        snapshot->depth_confidence_image != nullptr
+            ? depth_texture_.UpdateWithRawDepthImagesOnGlThread(
+                  *ar_session_, *snapshot->depth_image,
+                  *snapshot->depth_confidence_image)
+            : depth_texture_.UpdateWithDepthImageOnGlThread(
+                  *ar_session_, *snapshot->depth_image);
+    depth_uploads_per_second_ = depth_texture_.GetUploadsPerSecond();
+    if (depth_uploaded) {
+      background_renderer_.SetDepthTexture(depth_texture_.GetTextureId());
+      UpdateOcclusionDepth(snapshot->frame_context, useDepthForOcclusion);
+    }
+    if (depth_uploaded && background_mesher_ != nullptr) {
+      FuseDepthImage(snapshot->frame_context, *snapshot->depth_image);
     }
   }
+
+  frame_graph_.AddPass(MakePass(
+      "planes", FrameGraph::Phase::kTransparent, GetPlanePassState(),
+      FrameStage::kPlanes, [&] {
+        plane_renderer_.DrawBatch(projection_mat, view_mat,
+                                  snapshot->plane_batch);
+        if (background_mesher_ != nullptr) {
+          UpdateTsdfMeshes();
+          tsdf_mesh_renderer_.Draw(frame_context.view_projection_mat);
+        }
+      }));
+
+  andy_renderer_.setUseDepthForOcclusion(useDepthForOcclusion);
+  frame_graph_.AddPass(MakePass(
+      "anchors", FrameGraph::Phase::kOpaque,
+      GetObjectPassState(GetAnchorProgram()), FrameStage::kAnchors, [&] {
+        DrawAndyInstances(projection_mat, view_mat, frame_context,
+                          snapshot->andy_instances,
+                          snapshot->skinned_andy_instances);
+      }));
+
+  frame_graph_.AddPass(MakePass(
+      "point_cloud", FrameGraph::Phase::kOpaque,
+      GetPointCloudPassState(point_cloud_renderer_.GetProgram()),
+      FrameStage::kPointCloud,
+      [&] { DrawSnapshotPointCloud(*snapshot, frame_context); }));
+
+  ExecuteFrameGraph();
 }
 
-void HelloArApplication::UpdateAnchorColor(ColoredAnchor* colored_anchor) {
-  ArTrackable* ar_trackable = colored_anchor->trackable;
-  float* color = colored_anchor->color;
+void HelloArApplication::DrawSnapshotPointCloud(
+    const ArFrameSnapshot& snapshot, const FrameContext& frame_context) {
+  if (snapshot.has_surface_reticle) {
+    point_cloud_renderer_.Draw(frame_context.view_projection_mat,
+                               glm::value_ptr(snapshot.surface_reticle), 1);
+  }
+  if (kUseDensePointCloud && frame_context.is_depth_supported) {
+    DrawDensePointCloud(frame_context);
+    return;
+  }
+  const int32_t number_of_points =
+      static_cast<int32_t>(snapshot.point_cloud.size() / 4);
+  if (kUsePointCloudMap) {
+    // Skips snapshots drawn again through their timestamp.
+    point_cloud_map_.Update(snapshot.point_cloud_timestamp_ns,
+                            snapshot.point_cloud.data(),
+                            snapshot.point_ids.data(),
+                            static_cast<int32_t>(snapshot.point_ids.size()));
+    point_cloud_renderer_.DrawMap(frame_context.view_projection_mat,
+                                  &point_cloud_map_);
+    return;
+  }
+  point_cloud_renderer_.Draw(frame_context.view_projection_mat,
+                             snapshot.point_cloud.data(), number_of_points);
+}
+
+void HelloArApplication::ExecuteFrameGraph() {
+  if (virtual_content_target_.IsActive()) {
+    FrameGraph::PassState state;
+    state.depth_test = false;
+    state.depth_write = false;
+    state.cull_face = false;
+    state.blend = FrameGraph::BlendMode::kPremultipliedAlpha;
+    state.program = virtual_content_target_.GetProgram();
+    frame_graph_.AddPass(MakePass(
+        "composite", FrameGraph::Phase::kOverlay, state, FrameStage::kCount,
+        [this] {
+          // Nothing was drawn into the target, e.g. while not tracking.
+          if (is_virtual_content_target_bound_) {
+            virtual_content_target_.Composite();
+            is_virtual_content_target_bound_ = false;
+          }
+        }));
+  }
+  frame_graph_.Execute([this](const FrameGraph::Pass& pass,
+                              const std::function<void()>& run) {
+    if (!is_virtual_content_target_bound_ &&
+        (pass.phase == FrameGraph::Phase::kOpaque ||
+         pass.phase == FrameGraph::Phase::kTransparent) &&
+        virtual_content_target_.IsActive()) {
+      is_virtual_content_target_bound_ = virtual_content_target_.Bind();
+    }
+    if (pass.stage == FrameStage::kCount) {
+      run();
+      return;
+    }
+    ScopedFrameStageTimer timer(&frame_stage_timers_, pass.stage,
+                                &gpu_stage_timers_);
+    run();
+  });
+}
+
+void HelloArApplication::DrawPerformanceHud() {
+  if (!performance_hud_enabled_) {
+    performance_hud_shown_ = false;
+    return;
+  }
+  if (!performance_hud_shown_) {
+    performance_hud_.Reset();
+    performance_hud_shown_ = true;
+  }
+  performance_hud_.Draw(width_, height_, [this] {
+    PerformanceHud::Stats stats;
+    stats.cpu_stages = frame_stage_timers_.GetSummaries();
+    stats.gpu_stages = gpu_stage_timers_.GetSummaries();
+    stats.has_gpu_timers = gpu_stage_timers_.IsSupported();
+    stats.passes = frame_graph_.GetPassesLastFrame();
+    stats.pass_state_changes = frame_graph_.GetStateChangesLastFrame();
+    stats.eliminated_gl_calls =
+        util::GlStateCache::Get().GetEliminatedCallsLastFrame();
+    stats.anchors_drawn = anchors_drawn_last_frame_;
+    stats.anchors_culled = anchors_culled_last_frame_;
+    stats.asset_uploads = asset_uploads_last_frame_;
+    stats.depth_uploads_per_second = depth_uploads_per_second_;
+    return stats;
+  });
+}
+
+void HelloArApplication::UpdateRenderScale() {
+  const auto now = std::chrono::steady_clock::now();
+  if (now - last_render_scale_update_ < kRenderScaleUpdateInterval) {
+    return;
+  }
+  last_render_scale_update_ = now;
+
+  // The stages of the passes drawn into virtual_content_target_.
+  float gpu_ms = 0.f;
+  bool has_results = false;
+  for (FrameStage stage :
+       {FrameStage::kPlanes, FrameStage::kAnchors, FrameStage::kPointCloud}) {
+    const float stage_ms = gpu_stage_timers_.TakeRecentAverageMs(stage);
+    if (stage_ms >= 0.f) {
+      gpu_ms += stage_ms;
+      has_results = true;
+    }
+  }
+  if (!has_results) {
+    return;
+  }
+  const float scale = render_scale_governor_.Update(gpu_ms);
+  if (scale != RenderScaleGovernor::kNoChange) {
+    LOGI("Virtual content at %.0f%% resolution, %.1f ms on the GPU",
+         scale * 100.f, gpu_ms);
+    SetVirtualContentScale(scale);
+  }
+}
+
+void HelloArApplication::SetVirtualContentScale(float scale) {
+  virtual_content_target_.SetSize(width_, height_, scale);
+  andy_renderer_.SetViewportSize(virtual_content_target_.GetWidth(),
+                                 virtual_content_target_.GetHeight());
+}
+
+void HelloArApplication::FuseDepthImage(const FrameContext& frame_context,
+                                        const ArImage& depth_image) {
+  int64_t timestamp_ns = 0;
+  ArImage_getTimestamp(ar_session_, &depth_image, &timestamp_ns);
+  if (timestamp_ns == last_fused_depth_timestamp_) {
+    return;
+  }
+  last_fused_depth_timestamp_ = timestamp_ns;
+
+  const uint8_t* depth_data = nullptr;
+  int data_size = 0;
+  traced::ArImage_getPlaneData(ar_session_, &depth_image, /*plane_index=*/0,
+                               &depth_data, &data_size);
+  if (depth_data == nullptr || data_size <= 0) {
+    return;
+  }
+  int width = 0;
+  int height = 0;
+  int row_stride = 0;
+  ArImage_getWidth(ar_session_, &depth_image, &width);
+  ArImage_getHeight(ar_session_, &depth_image, &height);
+  ArImage_getPlaneRowStride(ar_session_, &depth_image, 0, &row_stride);
+
+  background_mesher_->SubmitDepthImage(
+      reinterpret_cast<const uint16_t*>(depth_data), width, height, row_stride,
+      frame_context.GetDepthIntrinsics(width, height),
+      frame_context.camera_pose_mat);
+}
+
+void HelloArApplication::UpdateTsdfMeshes() {
+  while (background_mesher_->PopMeshUpdate(&tsdf_mesh_update_)) {
+    tsdf_mesh_renderer_.Update(tsdf_mesh_update_);
+  }
+}
+
+void HelloArApplication::UpdateDepthConsumers(
+    const FrameContext& frame_context, bool use_depth_for_occlusion) {
+  if (background_mesher_ == nullptr && !kUseDepthPyramid && !kUseDepthQuery) {
+    return;
+  }
+  // The same images the depth texture was just updated with.
+  using ImageType = FrameImageCache::ImageType;
+  const ArImage* depth_image = frame_image_cache_.Get(
+      kUseRawDepth ? ImageType::kRawDepth : ImageType::kDepth);
+  const ArImage* depth_confidence_image =
+      kUseRawDepth ? frame_image_cache_.Get(ImageType::kRawDepthConfidence)
+                   : nullptr;
+  if (depth_image == nullptr ||
+      (kUseRawDepth && depth_confidence_image == nullptr)) {
+    depth_pyramid_.Clear();
+    depth_query_.Clear();
+    return;
+  }
+  if (background_mesher_ != nullptr) {
+    FuseDepthImage(frame_context, *depth_image);
+  }
+  BuildDepthPyramid(frame_context, depth_image, depth_confidence_image,
+                    use_depth_for_occlusion);
+  UpdateDepthQuery(frame_context, *depth_image, depth_confidence_image);
+}
+
+bool HelloArApplication::AcquireDepthImages(ArImage** depth_image,
+                                            ArImage** confidence_image) {
+  *depth_image = nullptr;
+  *confidence_image = nullptr;
+  if (!kUseRawDepth) {
+    if (traced::ArFrame_acquireDepthImage16Bits(ar_session_, ar_frame_,
+                                                depth_image) != AR_SUCCESS) {
+      *depth_image = nullptr;
+    } else {
+      ResourceAccounting::Get().AddArHandles(ArHandleType::kImage, 1);
+    }
+    return *depth_image != nullptr;
+  }
+  // Both images or neither, so the depth texture never mixes frames.
+  if (traced::ArFrame_acquireRawDepthImage16Bits(ar_session_, ar_frame_,
+                                                 depth_image) != AR_SUCCESS) {
+    *depth_image = nullptr;
+  } else if (traced::ArFrame_acquireRawDepthConfidenceImage(
+                 ar_session_, ar_frame_, confidence_image) != AR_SUCCESS) {
+    *confidence_image = nullptr;
+    ArImage_release(*depth_image);
+    *depth_image = nullptr;
+  } else {
+    ResourceAccounting::Get().AddArHandles(ArHandleType::kImage, 2);
+  }
+  return *depth_image != nullptr;
+}
+
+void HelloArApplication::BuildDepthPyramid(const FrameContext& frame_context,
+                                           const ArImage* depth_image,
+                                           const ArImage* confidence_image,
+                                           bool use_depth_for_occlusion) {
+  if (!kUseDepthPyramid || !use_depth_for_occlusion) {
+    depth_pyramid_.Clear();
+    return;
+  }
+  const uint8_t* depth_data = nullptr;
+  int data_size = 0;
+  traced::ArImage_getPlaneData(ar_session_, depth_image, /*plane_index=*/0,
+                               &depth_data, &data_size);
+  if (depth_data == nullptr || data_size <= 0) {
+    depth_pyramid_.Clear();
+    return;
+  }
+  int width = 0;
+  int height = 0;
+  int row_stride = 0;
+  ArImage_getWidth(ar_session_, depth_image, &width);
+  ArImage_getHeight(ar_session_, depth_image, &height);
+  ArImage_getPlaneRowStride(ar_session_, depth_image, 0, &row_stride);
+
+  const uint8_t* confidence_data = nullptr;
+  int confidence_row_stride = 0;
+  if (confidence_image != nullptr) {
+    traced::ArImage_getPlaneData(ar_session_, confidence_image,
+                                 /*plane_index=*/0, &confidence_data,
+                                 &data_size);
+    ArImage_getPlaneRowStride(ar_session_, confidence_image, 0,
+                              &confidence_row_stride);
+  }
+
+  depth_pyramid_.Build(reinterpret_cast<const uint16_t*>(depth_data), width,
+                       height, row_stride, confidence_data,
+                       confidence_row_stride,
+                       kUseRawDepth ? kRawDepthConfidenceThreshold : 0.0f,
+                       frame_context.GetDepthIntrinsics(width, height),
+                       frame_context.camera_pose_mat);
+}
+
+void HelloArApplication::UpdateDepthQuery(const FrameContext& frame_context,
+                                          const ArImage& depth_image,
+                                          const ArImage* confidence_image) {
+  if (!kUseDepthQuery) {
+    return;
+  }
+  int width = 0;
+  int height = 0;
+  ArImage_getWidth(ar_session_, &depth_image, &width);
+  ArImage_getHeight(ar_session_, &depth_image, &height);
+  depth_query_.Update(ar_session_, depth_image, confidence_image,
+                      kUseRawDepth ? kRawDepthConfidenceThreshold : 0.0f,
+                      frame_context.GetDepthIntrinsics(width, height),
+                      frame_context.camera_pose_mat);
+}
+
+bool HelloArApplication::GetSurfaceReticle(const FrameContext& frame_context,
+                                           glm::vec4* reticle) const {
+  glm::vec3 world_point;
+  if (kUseDepthQuery &&
+      depth_query_.GetWorldPointAtView(glm::vec2(0.5f), &world_point)) {
+    // Drawn as a point of full confidence.
+    *reticle = glm::vec4(world_point, 1.f);
+    return true;
+  }
+  if (!kUsePlaneIndex) {
+    return false;
+  }
+  // The ray through the screen centre, from the near to the far plane.
+  const glm::mat4 inverse_view_projection =
+      util::InvertMatrix(frame_context.view_projection_mat);
+  const glm::vec4 near_point =
+      inverse_view_projection * glm::vec4(0.f, 0.f, -1.f, 1.f);
+  const glm::vec4 far_point =
+      inverse_view_projection * glm::vec4(0.f, 0.f, 1.f, 1.f);
+  PlaneIndex::Ray ray;
+  ray.origin = glm::vec3(near_point) / near_point.w;
+  ray.direction = glm::vec3(far_point) / far_point.w - ray.origin;
+  PlaneIndex::Hit hit;
+  plane_index_.Raycast(&ray, 1, &hit);
+  if (hit.plane == nullptr) {
+    return false;
+  }
+  *reticle = glm::vec4(hit.position, 1.f);
+  return true;
+}
+
+void HelloArApplication::UpdateOcclusionDepth(
+    const FrameContext& frame_context, bool use_depth_for_occlusion) {
+  if (kUseTemporalDepthFilter && use_depth_for_occlusion) {
+    const int width = static_cast<int>(depth_texture_.GetWidth());
+    const int height = static_cast<int>(depth_texture_.GetHeight());
+    temporal_depth_filter_.Update(
+        depth_texture_.GetTextureId(), width, height, kUseRawDepth,
+        frame_context.GetDepthIntrinsics(width, height),
+        frame_context.camera_pose_mat);
+  } else {
+    temporal_depth_filter_.Reset();
+  }
+  andy_renderer_.SetDepthTexture(GetOcclusionDepthTextureId(),
+                                 depth_texture_.GetWidth(),
+                                 depth_texture_.GetHeight());
+  UpdateDepthPyramidTexture(use_depth_for_occlusion);
+  UpdateOcclusionBlurTexture(use_depth_for_occlusion);
+}
+
+GLuint HelloArApplication::GetOcclusionDepthTextureId() {
+  const GLuint filtered_texture = temporal_depth_filter_.GetTextureId();
+  return filtered_texture ? filtered_texture : depth_texture_.GetTextureId();
+}
+
+void HelloArApplication::UpdateDepthPyramidTexture(
+    bool use_depth_for_occlusion) {
+  if (!kUseDepthPyramid || !use_depth_for_occlusion) {
+    andy_renderer_.SetDepthPyramid(0, 0, glm::ivec2(0));
+    return;
+  }
+  depth_pyramid_texture_.Update(
+      GetOcclusionDepthTextureId(), depth_texture_.GetWidth(),
+      depth_texture_.GetHeight(),
+      kUseRawDepth ? kRawDepthConfidenceThreshold : 0.0f);
+  andy_renderer_.SetDepthPyramid(
+      depth_pyramid_texture_.GetTextureId(),
+      depth_pyramid_texture_.GetSampledTexelCoverage(),
+      depth_pyramid_texture_.GetSampledLevelSize());
+}
+
+void HelloArApplication::UpdateOcclusionBlurTexture(
+    bool use_depth_for_occlusion) {
+  if (!kUseOcclusionBlurTexture || !use_depth_for_occlusion) {
+    andy_renderer_.SetOcclusionBlur(0);
+    return;
+  }
+  occlusion_blur_texture_.Update(
+      GetOcclusionDepthTextureId(), depth_texture_.GetWidth(),
+      depth_texture_.GetHeight(),
+      kUseRawDepth ? kRawDepthConfidenceThreshold : 0.0f);
+  andy_renderer_.SetOcclusionBlur(occlusion_blur_texture_.GetTextureId());
+}
+
+void HelloArApplication::DrawDensePointCloud(
+    const FrameContext& frame_context) {
+  point_cloud_renderer_.DrawDense(
+      frame_context, depth_texture_.GetTextureId(), depth_texture_.GetWidth(),
+      depth_texture_.GetHeight(),
+      kUseRawDepth ? kRawDepthConfidenceThreshold : 0.0f);
+}
+
+void HelloArApplication::FillSnapshot(ArFrameSnapshot* snapshot) {
+  ar_object_pool_.BeginFrame();
+  UpdateFrameContext();
+  const FrameContext& frame_context = frame_context_;
+  snapshot->frame_context = frame_context;
+
+  if (frame_context.display_geometry_changed || !calculate_uv_transform_) {
+    calculate_uv_transform_ = true;
+    BackgroundRenderer::ComputeTransformedUvs(ar_session_, ar_frame_,
+                                              snapshot_uvs_);
+    snapshot_uv_transform_ = GetTextureTransformMatrix(ar_session_, ar_frame_);
+  }
+  std::copy(std::begin(snapshot_uvs_), std::end(snapshot_uvs_),
+            snapshot->transformed_uvs);
+  snapshot->uv_transform = snapshot_uv_transform_;
+  BackgroundRenderer::SampleEisWarp(ar_session_, ar_frame_,
+                                    stabilization_mode_, &snapshot->eis_warp);
+
+  ProcessPendingTouches();
+
+  snapshot->plane_count = 0;
+  snapshot->plane_batch.Clear();
+  for (auto& lod_instances : snapshot->andy_instances) {
+    lod_instances.clear();
+  }
+  snapshot->skinned_andy_instances.clear();
+  snapshot->point_cloud.clear();
+  snapshot->point_ids.clear();
+  snapshot->point_cloud_timestamp_ns = -1;
+  snapshot->has_surface_reticle = false;
+  ProcessUpdatedPlanes(/*update_meshes=*/false);
+  if (!frame_context.IsTracking()) {
+    return;
+  }
+
+  if (frame_context.is_depth_supported) {
+    AcquireDepthImages(&snapshot->depth_image,
+                       &snapshot->depth_confidence_image);
+  }
+  if (snapshot->depth_image != nullptr) {
+    BuildDepthPyramid(frame_context, snapshot->depth_image,
+                      snapshot->depth_confidence_image,
+                      use_depth_for_occlusion_);
+    UpdateDepthQuery(frame_context, *snapshot->depth_image,
+                     snapshot->depth_confidence_image);
+  } else {
+    depth_pyramid_.Clear();
+    depth_query_.Clear();
+  }
+  snapshot->has_surface_reticle =
+      GetSurfaceReticle(frame_context, &snapshot->surface_reticle);
+
+  // Cached plane meshes live in GL buffers, so planes are triangulated
+  // straight into the snapshot instead.
+  snapshot->plane_count =
+      ForEachVisiblePlane([this, snapshot](const ArPlane& ar_plane) {
+        PlaneRenderer::AppendPlaneToBatch(*ar_session_, ar_plane,
+                                          kPlanePolygonToleranceM,
+                                          &snapshot->plane_batch);
+      });
+
+  CollectAndyInstances(&snapshot->andy_instances,
+                       &snapshot->skinned_andy_instances);
+
+  ArPointCloud* ar_point_cloud = nullptr;
+  if (traced::ArFrame_acquirePointCloud(ar_session_, ar_frame_,
+                                        &ar_point_cloud) ==
+      AR_SUCCESS) {
+    int32_t number_of_points = 0;
+    const float* point_cloud_data = nullptr;
+    ArPointCloud_getNumberOfPoints(ar_session_, ar_point_cloud,
+                                   &number_of_points);
+    ArPointCloud_getData(ar_session_, ar_point_cloud, &point_cloud_data);
+    if (point_cloud_data != nullptr && number_of_points > 0) {
+      snapshot->point_cloud.assign(point_cloud_data,
+                                   point_cloud_data + number_of_points * 4);
+      if (kUsePointCloudMap) {
+        const int32_t* point_ids = nullptr;
+        ArPointCloud_getPointIds(ar_session_, ar_point_cloud, &point_ids);
+        if (point_ids != nullptr) {
+          snapshot->point_ids.assign(point_ids, point_ids + number_of_points);
+        }
+      }
+    }
+    ArPointCloud_getTimestamp(ar_session_, ar_point_cloud,
+                              &snapshot->point_cloud_timestamp_ns);
+    ArPointCloud_release(ar_point_cloud);
+  }
+}
+
+void HelloArApplication::AttachAnchorContent(AnchorStore::Handle handle) {
+  AnchorStore::Entry* entry = anchor_store_.Get(handle);
+  if (entry == nullptr) {
+    return;
+  }
+  // The root carries the anchor pose and the model hangs below it, so more
+  // content can later be placed relative to the anchor.
+  const uint32_t root = scene_graph_.AddAnchorNode(handle);
+  entry->scene_node = scene_graph_.AddNode(root, glm::mat4(1.0f));
+}
+
+void HelloArApplication::CollectAndyInstances(
+    ObjRenderer::LodInstances* instances,
+    std::vector<SkinnedObjRenderer::Instance>* skinned_instances) {
+  for (auto& lod_instances : *instances) {
+    lod_instances.clear();
+  }
+  skinned_instances->clear();
+  for (auto& depth_keys : andy_depth_keys_) {
+    depth_keys.clear();
+  }
+
+  // Anchor poses are rigid, so the model space bounding sphere only needs to
+  // be moved, not scaled, to test it against the frustum.
+  const util::Frustum frustum =
+      util::ExtractFrustum(frame_context_.view_projection_mat);
+  const bool skinned = DrawsSkinnedAnchors();
+  // The skinned sphere bounds every frame of every clip.
+  const glm::vec4& bounding_sphere =
+      skinned ? skinned_andy_renderer_.GetBoundingSphere()
+              : andy_renderer_.GetBoundingSphere();
+  const glm::vec3 sphere_center(bounding_sphere);
+  const glm::vec3 camera_position = frame_context_.GetCameraPosition();
+  // Viewport height covered by a sphere of unit radius at unit distance.
+  const float unit_screen_fraction = frame_context_.projection_mat[1][1];
+  const float lod_screen_fraction_scale = GetLodScreenFractionScale();
+  const bool cull_on_gpu = CullsAnchorsOnGpu();
+
+  const int tracking = anchor_store_.BeginFrame(
+      ar_session_, ar_object_pool_.AcquirePose(), camera_position);
+  scene_graph_.Update(anchor_store_);
+  // The model reaches this far from the anchor whichever way it is rotated.
+  const float model_radius = glm::length(sphere_center) + bounding_sphere.w;
+  anchor_candidates_.clear();
+  anchor_store_.QueryFrustum(frustum, model_radius, &anchor_candidates_);
+
+  int drawn = 0;
+  float distance = 0.f;
+  for (AnchorStore::Entry* anchor : anchor_candidates_) {
+    if (anchor->tracking_state != AR_TRACKING_STATE_TRACKING) {
+      // Render object only if the tracking state is AR_TRACKING_STATE_TRACKING.
+      continue;
+    }
+
+    const glm::mat4& model_mat =
+        scene_graph_.IsAlive(anchor->scene_node)
+            ? scene_graph_.GetWorldMatrix(anchor->scene_node)
+            : anchor_store_.GetModelMatrix(*anchor);
+    if (!cull_on_gpu) {
+      const glm::vec3 world_center =
+          glm::vec3(model_mat * glm::vec4(sphere_center, 1.0f));
+      if (!util::IsSphereInFrustum(frustum, world_center, bounding_sphere.w) ||
+          depth_pyramid_.IsOccluded(world_center, bounding_sphere.w)) {
+        continue;
+      }
+
+      distance = glm::distance(camera_position, world_center);
+      const float screen_fraction =
+          (distance <= bounding_sphere.w
+               ? 1.f
+               : bounding_sphere.w * unit_screen_fraction / distance) *
+          lod_screen_fraction_scale;
+      anchor->lod = andy_renderer_.SelectLod(screen_fraction, anchor->lod);
+    }
+    // Without a read back, every candidate of the GPU pass counts as visible.
+    anchor_store_.MarkVisible(anchor);
+
+    UpdateAnchorColor(anchor);
+    if (skinned) {
+      SkinnedObjRenderer::Instance skinned_instance;
+      skinned_instance.model_mat = model_mat;
+      skinned_instance.color = glm::make_vec4(anchor->color);
+      skinned_instance.clip = static_cast<int>(
+          anchor->sequence % skinned_andy_renderer_.GetClipCount());
+      const float duration =
+          skinned_andy_renderer_.GetClipDuration(skinned_instance.clip);
+      if (duration > 0.f) {
+        const double time_s = frame_context_.timestamp_ns * 1e-9 +
+                              anchor->sequence * kSkinnedAnchorPhaseStepS;
+        skinned_instance.time_s =
+            static_cast<float>(std::fmod(time_s, duration));
+      }
+      skinned_instances->push_back(skinned_instance);
+      ++drawn;
+      continue;
+    }
+    ObjRenderer::Instance instance;
+    instance.model_mat = model_mat;
+    instance.color = glm::make_vec4(anchor->color);
+    std::vector<ObjRenderer::Instance>& lod_instances =
+        (*instances)[cull_on_gpu ? 0 : anchor->lod];
+    if (!cull_on_gpu) {
+      andy_depth_keys_[anchor->lod].push_back(
+          {RenderQueue::MakeDepthKey(distance),
+           static_cast<uint32_t>(lod_instances.size())});
+    }
+    lod_instances.push_back(instance);
+    ++drawn;
+  }
+  anchors_culled_last_frame_ = tracking - drawn;
+  anchors_drawn_last_frame_ = drawn;
+
+  // The culling pass compacts the candidates in any order, so only the
+  // levels drawn from the CPU are sorted front to back.  The skinned
+  // instances all go in one draw and are not sorted either.
+  if (cull_on_gpu || skinned) {
+    return;
+  }
+  for (int lod = 0; lod < ObjRenderer::kMaxLodCount; ++lod) {
+    std::vector<RadixSorter::Item>& depth_keys = andy_depth_keys_[lod];
+    std::vector<ObjRenderer::Instance>& lod_instances = (*instances)[lod];
+    if (lod_instances.size() < 2) {
+      continue;
+    }
+    andy_sorter_.Sort(&depth_keys);
+    sorted_andy_instances_.clear();
+    for (const RadixSorter::Item& item : depth_keys) {
+      sorted_andy_instances_.push_back(lod_instances[item.index]);
+    }
+    lod_instances.swap(sorted_andy_instances_);
+  }
+}
+
+void HelloArApplication::DrawAndyInstances(
+    const glm::mat4& projection_mat, const glm::mat4& view_mat,
+    const FrameContext& frame_context,
+    const ObjRenderer::LodInstances& instances,
+    const std::vector<SkinnedObjRenderer::Instance>& skinned_instances) {
+  if (DrawsSkinnedAnchors()) {
+    skinned_andy_renderer_.SampleAnimations(skinned_instances.data(),
+                                            skinned_instances.size());
+    skinned_andy_renderer_.Draw(projection_mat, view_mat,
+                                frame_context.color_correction);
+    return;
+  }
+  if (!CullsAnchorsOnGpu()) {
+    andy_renderer_.DrawInstanced(projection_mat, view_mat, instances,
+                                 frame_context.color_correction);
+    return;
+  }
+  const std::vector<ObjRenderer::Instance>& candidates = instances[0];
+  andy_renderer_.CullAndDrawInstanced(
+      projection_mat, view_mat, candidates.data(), candidates.size(),
+      frame_context.GetCameraPosition(), GetLodScreenFractionScale(),
+      frame_context.color_correction);
+}
+
+bool HelloArApplication::CullsAnchorsOnGpu() const {
+  return kUseGpuCulling && !DrawsSkinnedAnchors() &&
+         andy_renderer_.IsGpuCullingSupported();
+}
+
+bool HelloArApplication::DrawsSkinnedAnchors() const {
+  return kUseSkinnedAnchors && skinned_andy_loaded_;
+}
+
+GLuint HelloArApplication::GetAnchorProgram() const {
+  return DrawsSkinnedAnchors() ? skinned_andy_renderer_.GetProgram()
+                               : andy_renderer_.GetProgram();
+}
+
+float HelloArApplication::GetLodScreenFractionScale() const {
+  return IsQualityStepTaken(quality_level_.load(std::memory_order_relaxed),
+                            QualityStep::kLodBias)
+             ? kThrottledLodScreenFractionScale
+             : 1.f;
+}
+
+void HelloArApplication::UpdateFrameContext() {
+  FrameContext& context = frame_context_;
+  ArFrame_getTimestamp(ar_session_, ar_frame_, &context.timestamp_ns);
+  int32_t geometry_changed = 0;
+  ArFrame_getDisplayGeometryChanged(ar_session_, ar_frame_, &geometry_changed);
+  context.display_geometry_changed = geometry_changed != 0;
+  if (kUseDepthQuery && context.display_geometry_changed) {
+    depth_query_.UpdateGeometry(ar_session_, ar_frame_);
+  }
+  context.is_depth_supported = is_depth_supported_;
+
+  ArCamera* ar_camera = nullptr;
+  traced::ArFrame_acquireCamera(ar_session_, ar_frame_, &ar_camera);
+  ArCamera_getTrackingState(ar_session_, ar_camera,
+                            &context.camera_tracking_state);
+  ArCamera_getViewMatrix(ar_session_, ar_camera,
+                         glm::value_ptr(context.view_mat));
+  ArCamera_getProjectionMatrix(ar_session_, ar_camera, kProjectionNear,
+                               kProjectionFar,
+                               glm::value_ptr(context.projection_mat));
+  context.view_projection_mat =
+      util::MultiplyMatrices(context.projection_mat, context.view_mat);
+  if (context.IsTracking()) {
+    ArPose* camera_pose = ar_object_pool_.AcquirePose();
+    ArCamera_getPose(ar_session_, ar_camera, camera_pose);
+    ArPose_getPoseRaw(ar_session_, camera_pose, context.camera_pose_raw);
+    ArPose_getMatrix(ar_session_, camera_pose,
+                     glm::value_ptr(context.camera_pose_mat));
+    if (kUseLatePoseReprojection) {
+      ArPose* sensor_pose = ar_object_pool_.AcquirePose();
+      ArFrame_getAndroidSensorPose(ar_session_, ar_frame_, sensor_pose);
+      ArPose_getPoseRaw(ar_session_, sensor_pose,
+                        context.android_sensor_pose_raw);
+    }
+
+    ArCameraIntrinsics* intrinsics = ar_object_pool_.AcquireCameraIntrinsics();
+    ArCamera_getTextureIntrinsics(ar_session_, ar_camera, intrinsics);
+    float focal_length[2] = {};
+    float principal_point[2] = {};
+    int32_t dimensions[2] = {};
+    ArCameraIntrinsics_getFocalLength(ar_session_, intrinsics, &focal_length[0],
+                                      &focal_length[1]);
+    ArCameraIntrinsics_getPrincipalPoint(ar_session_, intrinsics,
+                                         &principal_point[0],
+                                         &principal_point[1]);
+    ArCameraIntrinsics_getImageDimensions(ar_session_, intrinsics,
+                                          &dimensions[0], &dimensions[1]);
+    context.camera_texture_intrinsics =
+        glm::vec4(focal_length[0], focal_length[1], principal_point[0],
+                  principal_point[1]);
+    context.camera_texture_size = glm::vec2(dimensions[0], dimensions[1]);
+  }
+  ArCamera_release(ar_camera);
+
+  // Set light intensity to default. Intensity value ranges from 0.0f to 1.0f.
+  // The first three components are color scaling factors.
+  // The last one is the average pixel intensity in gamma space.
+  std::fill(context.color_correction, context.color_correction + 4, 1.f);
+  context.light_estimate_state = AR_LIGHT_ESTIMATE_STATE_NOT_VALID;
+  if (context.IsTracking()) {
+    ArLightEstimate* ar_light_estimate =
+        ar_object_pool_.AcquireLightEstimate();
+    ArFrame_getLightEstimate(ar_session_, ar_frame_, ar_light_estimate);
+    ArLightEstimate_getState(ar_session_, ar_light_estimate,
+                             &context.light_estimate_state);
+    if (context.light_estimate_state == AR_LIGHT_ESTIMATE_STATE_VALID) {
+      ArLightEstimate_getColorCorrection(ar_session_, ar_light_estimate,
+                                         context.color_correction);
+    }
+  }
+}
+
+void HelloArApplication::ProcessUpdatedPlanes(bool update_meshes) {
+  ArTrackableList* updated_plane_list = ar_object_pool_.AcquireTrackableList();
+  traced::ArFrame_getUpdatedTrackables(ar_session_, ar_frame_,
+                                       AR_TRACKABLE_PLANE, updated_plane_list);
+
+  int32_t updated_plane_list_size = 0;
+  traced::ArTrackableList_getSize(ar_session_, updated_plane_list,
+                                  &updated_plane_list_size);
+
+  for (int i = 0; i < updated_plane_list_size; ++i) {
+    ArTrackable* ar_trackable = nullptr;
+    traced::ArTrackableList_acquireItem(ar_session_, updated_plane_list, i,
+                                        &ar_trackable);
+    ArPlane* ar_plane = ArAsPlane(ar_trackable);
+
+    ArTrackingState tracking_state;
+    ArTrackable_getTrackingState(ar_session_, ar_trackable, &tracking_state);
+    ArPlane* subsume_plane = nullptr;
+    ArPlane_acquireSubsumedBy(ar_session_, ar_plane, &subsume_plane);
+
+    const bool dropped = subsume_plane != nullptr ||
+                         tracking_state == AR_TRACKING_STATE_STOPPED;
+    PlaneRegistry::PlaneState state = PlaneRegistry::PlaneState::kTracking;
+    if (dropped) {
+      state = PlaneRegistry::PlaneState::kDropped;
+    } else if (tracking_state != AR_TRACKING_STATE_TRACKING) {
+      state = PlaneRegistry::PlaneState::kPaused;
+    }
+    if (subsume_plane != nullptr) {
+      ArTrackable_release(ArAsTrackable(subsume_plane));
+    }
+    if (update_meshes && dropped) {
+      plane_renderer_.EvictPlane(*ar_plane);
+    } else if (update_meshes) {
+      plane_renderer_.UpdatePlane(*ar_session_, *ar_plane);
+    }
+    if (kUsePlaneIndex && dropped) {
+      plane_index_.RemovePlane(*ar_plane);
+    } else if (kUsePlaneIndex) {
+      plane_index_.UpdatePlane(*ar_session_, *ar_plane);
+    }
+    // Hands the reference over, which must come last.
+    plane_registry_.UpdatePlane(ar_plane, state);
+  }
+}
+
+void HelloArApplication::ProcessUpdatedStreetscapeGeometry() {
+  if (!kUseStreetscapeGeometry) {
+    return;
+  }
+  ArTrackableList* updated_list = ar_object_pool_.AcquireTrackableList();
+  traced::ArFrame_getUpdatedTrackables(ar_session_, ar_frame_,
+                                       AR_TRACKABLE_STREETSCAPE_GEOMETRY,
+                                       updated_list);
+  int32_t updated_list_size = 0;
+  traced::ArTrackableList_getSize(ar_session_, updated_list,
+                                  &updated_list_size);
+  for (int i = 0; i < updated_list_size; ++i) {
+    ArTrackable* ar_trackable = nullptr;
+    traced::ArTrackableList_acquireItem(ar_session_, updated_list, i,
+                                        &ar_trackable);
+    // Hands the reference over.
+    streetscape_geometry_renderer_.UpdateGeometry(
+        *ar_session_, ArAsStreetscapeGeometry(ar_trackable));
+  }
+}
+
+void HelloArApplication::UpdateGeospatialAnchors() {
+  if (!kUseGeospatialAnchors) {
+    return;
+  }
+  if (camera_geospatial_pose_ == nullptr) {
+    ArGeospatialPose_create(ar_session_, &camera_geospatial_pose_);
+  }
+  // Null while the Geospatial API is off, which only polls the futures.
+  ArEarth* earth = nullptr;
+  ArSession_acquireEarth(ar_session_, &earth);
+  resolve_results_.clear();
+  anchor_resolve_scheduler_.Update(ar_session_, earth, camera_geospatial_pose_,
+                                   &resolve_results_);
+  if (kUseVpsAvailabilityCache) {
+    UpdateVpsAvailability(earth);
+  }
+  if (kUseGeospatialAnchorIndex) {
+    UpdateGeospatialAnchorIndex(earth);
+  }
+  if (earth != nullptr) {
+    ArTrackable_release(reinterpret_cast<ArTrackable*>(earth));
+  }
+
+  for (const AnchorResolveScheduler::Result& result : resolve_results_) {
+    if (result.anchor == nullptr) {
+      continue;
+    }
+    LOGI("Geospatial anchor %u resolved after %.0f ms", result.id,
+         std::chrono::duration<float, std::milli>(result.latency).count());
+    const AnchorStore::Handle handle =
+        anchor_store_.Add(ar_session_, ar_object_pool_.AcquirePose(),
+                          result.anchor, /*trackable=*/nullptr);
+    AttachAnchorContent(handle);
+    // Geospatial anchors have no trackable to pick a color from.
+    SetColor(255.0f, 167.0f, 38.0f, 255.0f, anchor_store_.Get(handle)->color);
+    if (kUseGeospatialAnchorIndex) {
+      anchor_store_.Get(handle)->deferred = true;
+      // The height of the surface under a Terrain or Rooftop anchor is not
+      // known here; the altitude of the camera stands in for it, which the
+      // radii of the index are generous enough to absorb.
+      geospatial_anchor_index_.Add(handle, result.latitude, result.longitude,
+                                   camera_altitude_m_ + result.altitude_m);
+    }
+  }
+}
+
+void HelloArApplication::UpdateGeospatialAnchorIndex(ArEarth* earth) {
+  ArTrackingState tracking_state = AR_TRACKING_STATE_STOPPED;
+  if (earth != nullptr) {
+    ArTrackable_getTrackingState(
+        ar_session_, reinterpret_cast<ArTrackable*>(earth), &tracking_state);
+  }
+  geospatial_refresh_handles_.clear();
+  if (tracking_state == AR_TRACKING_STATE_TRACKING) {
+    ArEarth_getCameraGeospatialPose(ar_session_, earth,
+                                    camera_geospatial_pose_);
+    ArGeospatialPose_getAltitude(ar_session_, camera_geospatial_pose_,
+                                 &camera_altitude_m_);
+    geospatial_anchor_index_.Update(ar_session_, camera_geospatial_pose_,
+                                    anchor_store_,
+                                    &geospatial_refresh_handles_);
+  } else {
+    // Without a camera location to select by, only the anchors that would
+    // be drawn are refreshed, so they stop when ARCore stops tracking them.
+    for (const AnchorStore::Entry& entry : anchor_store_.GetEntries()) {
+      if (entry.deferred &&
+          entry.tracking_state == AR_TRACKING_STATE_TRACKING) {
+        geospatial_refresh_handles_.push_back(entry.handle);
+      }
+    }
+  }
+  ArPose* scratch_pose = ar_object_pool_.AcquirePose();
+  for (AnchorStore::Handle handle : geospatial_refresh_handles_) {
+    anchor_store_.Refresh(ar_session_, scratch_pose, handle);
+  }
+}
+
+void HelloArApplication::UpdateVpsAvailability(ArEarth* earth) {
+  vps_availability_cache_.Update(ar_session_);
+  ArTrackingState tracking_state = AR_TRACKING_STATE_STOPPED;
+  if (earth != nullptr) {
+    ArTrackable_getTrackingState(
+        ar_session_, reinterpret_cast<ArTrackable*>(earth), &tracking_state);
+  }
+  if (tracking_state != AR_TRACKING_STATE_TRACKING) {
+    return;
+  }
+  ArEarth_getCameraGeospatialPose(ar_session_, earth, camera_geospatial_pose_);
+  double latitude = 0.0;
+  double longitude = 0.0;
+  ArGeospatialPose_getLatitudeLongitude(ar_session_, camera_geospatial_pose_,
+                                        &latitude, &longitude);
+  // A cache hit in all but the frames that enter a new cell.
+  const ArVpsAvailability availability =
+      vps_availability_cache_.Check(ar_session_, latitude, longitude);
+  if (availability != AR_VPS_AVAILABILITY_UNKNOWN &&
+      availability != camera_vps_availability_) {
+    LOGI("VPS availability at the camera: %d", availability);
+    camera_vps_availability_ = availability;
+  }
+}
+
+void HelloArApplication::UpdateCloudAnchors() {
+  if (!kUseCloudAnchors) {
+    return;
+  }
+  cloud_anchor_results_.clear();
+  cloud_anchor_pipeline_.Update(ar_session_, ar_frame_,
+                                &cloud_anchor_results_);
+  for (const CloudAnchorPipeline::Result& result : cloud_anchor_results_) {
+    const bool keys_spatial_map = result.id == spatial_map_host_request_;
+    if (keys_spatial_map) {
+      spatial_map_host_request_ = 0;
+    }
+    if (result.state != AR_CLOUD_ANCHOR_STATE_SUCCESS) {
+      LOGE("Cloud Anchor request %u failed: %d", result.id, result.state);
+      continue;
+    }
+    if (result.type == CloudAnchorPipeline::Result::Type::kHosted) {
+      LOGI("Cloud Anchor request %u hosted as %s", result.id,
+           result.cloud_anchor_id.c_str());
+      if (keys_spatial_map) {
+        SetSpatialMapAnchor(result.cloud_anchor_id, spatial_map_host_anchor_);
+      }
+      continue;
+    }
+    LOGI("Cloud Anchor %s resolved", result.cloud_anchor_id.c_str());
+    const AnchorStore::Handle handle =
+        anchor_store_.Add(ar_session_, ar_object_pool_.AcquirePose(),
+                          result.anchor, /*trackable=*/nullptr);
+    AttachAnchorContent(handle);
+    SetColor(171.0f, 71.0f, 188.0f, 255.0f, anchor_store_.Get(handle)->color);
+    if (kUseSpatialMapCache && spatial_map_anchor_id_.empty()) {
+      SetSpatialMapAnchor(result.cloud_anchor_id, handle);
+    }
+  }
+  if (kUseSpatialMapCache) {
+    RestoreSpatialMapChunks();
+  }
+}
+
+void HelloArApplication::SetSpatialMapAnchor(
+    const std::string& cloud_anchor_id, AnchorStore::Handle handle) {
+  spatial_map_anchor_id_ = cloud_anchor_id;
+  spatial_map_anchor_ = handle;
+  // A host request still waiting no longer keys the map.
+  spatial_map_host_request_ = 0;
+  if (spatial_map_cache_.FindMap(cloud_anchor_id, &spatial_map_restore_)) {
+    LOGI("Restoring %zu chunks of the spatial map of %s",
+         spatial_map_restore_.chunks.size(), cloud_anchor_id.c_str());
+  }
+}
+
+void HelloArApplication::RestoreSpatialMapChunks() {
+  std::vector<SpatialMapCache::Chunk>& chunks = spatial_map_restore_.chunks;
+  if (chunks.empty()) {
+    return;
+  }
+  const AnchorStore::Entry* anchor = anchor_store_.Get(spatial_map_anchor_);
+  if (anchor == nullptr) {
+    LOGE("Spatial map anchor removed, %zu chunks not restored",
+         chunks.size());
+    chunks.clear();
+    return;
+  }
+  if (anchor->tracking_state != AR_TRACKING_STATE_TRACKING) {
+    return;
+  }
+  // Recomputed every frame, so later chunks follow the anchor as ARCore
+  // refines it.
+  glm::mat4 anchor_pose_mat(1.0f);
+  util::GetTransformMatrixFromAnchor(*anchor->anchor, ar_session_,
+                                     ar_object_pool_.AcquirePose(),
+                                     &anchor_pose_mat);
+  const glm::mat4 transform =
+      anchor_pose_mat * glm::inverse(spatial_map_restore_.anchor_pose_mat);
+  const glm::vec3 camera_position = frame_context_.GetCameraPosition();
+  const auto distance_squared = [&](const SpatialMapCache::Chunk& chunk) {
+    const glm::vec3 offset =
+        glm::vec3(transform * glm::vec4(chunk.center, 1.0f)) - camera_position;
+    return glm::dot(offset, offset);
+  };
+
+  for (int i = 0; i < kSpatialMapChunksPerFrame && !chunks.empty(); ++i) {
+    auto nearest = std::min_element(
+        chunks.begin(), chunks.end(),
+        [&](const SpatialMapCache::Chunk& a, const SpatialMapCache::Chunk& b) {
+          return distance_squared(a) < distance_squared(b);
+        });
+    // Reading the chunk pages it in.
+    if (nearest->type == SpatialMapCache::ChunkType::kPoints) {
+      if (kUsePointCloudMap) {
+        point_cloud_map_.AddRestoredPoints(
+            static_cast<const float*>(nearest->data),
+            static_cast<int32_t>(nearest->count), transform);
+      }
+    } else if (background_mesher_ != nullptr) {
+      background_mesher_->ImportBlocks(
+          static_cast<const TsdfVolume::BlockVoxels*>(nearest->data),
+          nearest->count, transform);
+    }
+    *nearest = chunks.back();
+    chunks.pop_back();
+  }
+  if (chunks.empty()) {
+    LOGI("Spatial map of %s restored", spatial_map_anchor_id_.c_str());
+  }
+}
+
+void HelloArApplication::SaveSpatialMap() {
+  if (spatial_map_anchor_id_.empty()) {
+    return;
+  }
+  if (!spatial_map_restore_.chunks.empty()) {
+    // Saving now would replace the map with the part restored so far.
+    LOGI("Spatial map of %s not saved, %zu chunks not restored yet",
+         spatial_map_anchor_id_.c_str(), spatial_map_restore_.chunks.size());
+    return;
+  }
+  const AnchorStore::Entry* anchor = anchor_store_.Get(spatial_map_anchor_);
+  if (anchor == nullptr ||
+      anchor->tracking_state != AR_TRACKING_STATE_TRACKING) {
+    return;
+  }
+  glm::mat4 anchor_pose_mat(1.0f);
+  util::GetTransformMatrixFromAnchor(*anchor->anchor, ar_session_,
+                                     &anchor_pose_mat);
+  std::vector<TsdfVolume::BlockVoxels> blocks;
+  if (background_mesher_ != nullptr) {
+    background_mesher_->ExportBlocks(&blocks);
+  }
+  const float* points = nullptr;
+  int32_t number_of_points = 0;
+  if (kUsePointCloudMap) {
+    points = point_cloud_map_.GetSlotData();
+    number_of_points = point_cloud_map_.GetSlotCount();
+  }
+  if (!spatial_map_cache_.Save(spatial_map_anchor_id_, anchor_pose_mat,
+                               points, number_of_points, blocks)) {
+    LOGE("Spatial map of %s not saved", spatial_map_anchor_id_.c_str());
+  }
+}
+
+void HelloArApplication::UpdateEnvironmentalHdr() {
+  if (!kUseEnvironmentalHdr ||
+      frame_context_.light_estimate_state != AR_LIGHT_ESTIMATE_STATE_VALID) {
+    return;
+  }
+  ArLightEstimate* ar_light_estimate = ar_object_pool_.AcquireLightEstimate();
+  ArFrame_getLightEstimate(ar_session_, ar_frame_, ar_light_estimate);
+  environmental_hdr_lighting_.Update(ar_session_, ar_light_estimate);
+  andy_renderer_.SetEnvironmentalHdr(
+      environmental_hdr_lighting_.GetCubemapTexture(),
+      environmental_hdr_lighting_.GetLevelCount(),
+      environmental_hdr_lighting_.GetSphericalHarmonics().data());
+}
+
+void HelloArApplication::UpdateSemantics() {
+  if (!kUseSemantics ||
+      !semantics_pipeline_.Update(ar_session_, ar_frame_,
+                                  &frame_image_cache_)) {
+    return;
+  }
+  // The ground only changes with the image, so it is counted once per
+  // image.
+  semantics_pipeline_.RequestRoiFractions(kGroundRoiNdc,
+                                          kSemanticConfidenceThreshold);
+  std::array<float, SemanticsPipeline::kNumLabels> roi_fractions;
+  if (++semantic_images_since_log_ < kSemanticImagesPerLog ||
+      !semantics_pipeline_.GetRoiFractions(&roi_fractions)) {
+    return;
+  }
+  semantic_images_since_log_ = 0;
+  const float ground_fraction = roi_fractions[AR_SEMANTIC_LABEL_ROAD] +
+                                roi_fractions[AR_SEMANTIC_LABEL_SIDEWALK] +
+                                roi_fractions[AR_SEMANTIC_LABEL_TERRAIN];
+  LOGI("Semantics: sky %.2f of the image, ground %.2f of the lower third",
+       semantics_pipeline_.GetLabelFraction(AR_SEMANTIC_LABEL_SKY),
+       ground_fraction);
+}
+
+bool HelloArApplication::UsesGeospatialMode(const ArSession* session) {
+  if (!(kUseStreetscapeGeometry || kUseGeospatialAnchors) ||
+      !use_geospatial_mode_) {
+    return false;
+  }
+  int32_t is_supported = 0;
+  ArSession_isGeospatialModeSupported(session, AR_GEOSPATIAL_MODE_ENABLED,
+                                      &is_supported);
+  return is_supported;
+}
+
+bool HelloArApplication::IsDepthSupported() {
+  return IsDepthSupported(ar_session_);
+}
+
+bool HelloArApplication::IsDepthSupported(const ArSession* session) {
+  int32_t is_supported = 0;
+  ArSession_isDepthModeSupported(session, AR_DEPTH_MODE_AUTOMATIC,
+                                 &is_supported);
+  return is_supported;
+}
+
+void HelloArApplication::ConfigureSession(ArSession* session) {
+  // Depth the thermal governor or the feature policy turned off counts as
+  // unsupported, so nothing waits for depth images.
+  const bool is_depth_supported = IsDepthEnabled(session);
+  is_depth_supported_ = is_depth_supported;
+
+  ArConfig* ar_config = nullptr;
+  ArConfig_create(session, &ar_config);
+  if (kUseSessionFeaturePolicy) {
+    ArConfig_setPlaneFindingMode(session, ar_config,
+                                 session_feature_policy_.GetPlaneFindingMode());
+  }
+  if (is_depth_supported) {
+    ArConfig_setDepthMode(session, ar_config, AR_DEPTH_MODE_AUTOMATIC);
+  } else {
+    ArConfig_setDepthMode(session, ar_config, AR_DEPTH_MODE_DISABLED);
+  }
+
+  if (IsInstantPlacementActive()) {
+    ArConfig_setInstantPlacementMode(session, ar_config,
+                                     AR_INSTANT_PLACEMENT_MODE_LOCAL_Y_UP);
+  } else {
+    ArConfig_setInstantPlacementMode(session, ar_config,
+                                     AR_INSTANT_PLACEMENT_MODE_DISABLED);
+  }
+  const bool uses_geospatial_mode = UsesGeospatialMode(session);
+  if (uses_geospatial_mode) {
+    ArConfig_setGeospatialMode(session, ar_config,
+                               AR_GEOSPATIAL_MODE_ENABLED);
+    if (kUseStreetscapeGeometry) {
+      ArConfig_setStreetscapeGeometryMode(
+          session, ar_config, AR_STREETSCAPE_GEOMETRY_MODE_ENABLED);
+    }
+  }
+  if (kUseAugmentedFaces) {
+    ArConfig_setAugmentedFaceMode(session, ar_config,
+                                  AR_AUGMENTED_FACE_MODE_MESH3D);
+  }
+  if (kUseSemantics) {
+    int32_t is_semantic_mode_supported = 0;
+    ArSession_isSemanticModeSupported(session, AR_SEMANTIC_MODE_ENABLED,
+                                      &is_semantic_mode_supported);
+    ArConfig_setSemanticMode(session, ar_config,
+                             is_semantic_mode_supported
+                                 ? AR_SEMANTIC_MODE_ENABLED
+                                 : AR_SEMANTIC_MODE_DISABLED);
+  }
+  if (kUseEnvironmentalHdr) {
+    ArConfig_setLightEstimationMode(session, ar_config,
+                                    AR_LIGHT_ESTIMATION_MODE_ENVIRONMENTAL_HDR);
+  }
+  if (kUseCloudAnchors) {
+    ArConfig_setCloudAnchorMode(session, ar_config,
+                                AR_CLOUD_ANCHOR_MODE_ENABLED);
+  }
+  if (kUseUpdateModeController && !kUseArUpdateThread) {
+    ArConfig_setUpdateMode(session, ar_config,
+                           update_mode_controller_.GetMode());
+  }
+  stabilization_mode_ = BackgroundRenderer::StabilizationMode::kOff;
+  if (kUseImageStabilization) {
+    // Support depends on the camera config, which is already selected.
+    int32_t is_eis_supported = 0;
+    ArSession_isImageStabilizationModeSupported(
+        session, AR_IMAGE_STABILIZATION_MODE_EIS, &is_eis_supported);
+    if (is_eis_supported) {
+      ArConfig_setImageStabilizationMode(session, ar_config,
+                                         AR_IMAGE_STABILIZATION_MODE_EIS);
+      stabilization_mode_ =
+          kUseComputeEisWarp
+              ? BackgroundRenderer::StabilizationMode::kComputeWarp
+              : BackgroundRenderer::StabilizationMode::kWarpMesh;
+    }
+  }
+  ArConfig_setTextureUpdateMode(
+      session, ar_config,
+      camera_texture_mode_ == CameraTextureMode::kHardwareBuffer
+          ? AR_TEXTURE_UPDATE_MODE_EXPOSE_HARDWARE_BUFFER
+          : AR_TEXTURE_UPDATE_MODE_BIND_TO_TEXTURE_EXTERNAL_OES);
+  CHECK(ar_config);
+  ArStatus status = ArSession_configure(session, ar_config);
+  if (status != AR_SUCCESS && uses_geospatial_mode) {
+    // E.g. no location permission or API key; the rest still works.
+    LOGE("Geospatial API unavailable (%d), running without it", status);
+    use_geospatial_mode_ = false;
+    ArConfig_setGeospatialMode(session, ar_config,
+                               AR_GEOSPATIAL_MODE_DISABLED);
+    ArConfig_setStreetscapeGeometryMode(
+        session, ar_config, AR_STREETSCAPE_GEOMETRY_MODE_DISABLED);
+    status = ArSession_configure(session, ar_config);
+  }
+  CHECK(status == AR_SUCCESS);
+  ArConfig_destroy(ar_config);
+  // A new configuration may restart the camera with other buffers.
+  egl_image_cache_.RequestFlush();
+}
+
+void HelloArApplication::UpdateCameraTextureMode() {
+  CameraTextureMode mode = camera_texture_benchmark_.IsRunning()
+                               ? camera_texture_benchmark_.GetMode()
+                               : requested_camera_texture_mode_.load();
+  if (mode == CameraTextureMode::kHardwareBuffer &&
+      !EglImageCache::IsSupported()) {
+    mode = CameraTextureMode::kTextureName;
+  }
+  if (mode == camera_texture_mode_) {
+    return;
+  }
+  LOGI("Camera texture mode %s", GetCameraTextureModeName(mode));
+  camera_texture_mode_ = mode;
+  ConfigureSession(ar_session_);
+}
+
+void HelloArApplication::BindCameraHardwareBuffer() {
+  void* hardware_buffer = nullptr;
+  if (ArFrame_getHardwareBuffer(ar_session_, ar_frame_, &hardware_buffer) !=
+      AR_SUCCESS) {
+    return;
+  }
+  // Only rebinds the texture when ARCore moved on to another buffer.  Until
+  // the first buffer arrives the texture keeps the previous image.
+  egl_image_cache_.BindToTexture(
+      static_cast<AHardwareBuffer*>(hardware_buffer),
+      background_renderer_.GetTextureId());
+}
+
+void HelloArApplication::UseFrontCamera(ArSession* session) {
+  ArCameraConfigFilter* filter = nullptr;
+  ArCameraConfigFilter_create(session, &filter);
+  ArCameraConfigFilter_setFacingDirection(
+      session, filter, AR_CAMERA_CONFIG_FACING_DIRECTION_FRONT);
+  ArCameraConfigList* configs = nullptr;
+  ArCameraConfigList_create(session, &configs);
+  ArSession_getSupportedCameraConfigsWithFilter(session, filter, configs);
+  int32_t num_configs = 0;
+  ArCameraConfigList_getSize(session, configs, &num_configs);
+  if (num_configs > 0) {
+    ArCameraConfig* config = nullptr;
+    ArCameraConfig_create(session, &config);
+    ArCameraConfigList_getItem(session, configs, 0, config);
+    if (ArSession_setCameraConfig(session, config) != AR_SUCCESS) {
+      LOGE("HelloArApplication::UseFrontCamera ArSession_setCameraConfig "
+           "error");
+    }
+    ArCameraConfig_destroy(config);
+  } else {
+    LOGE("HelloArApplication::UseFrontCamera no front camera config");
+  }
+  ArCameraConfigList_destroy(configs);
+  ArCameraConfigFilter_destroy(filter);
+}
+
+void HelloArApplication::OnSettingsChange(bool is_instant_placement_enabled) {
+  AppEvent event;
+  event.type = AppEvent::Type::kSettingsChange;
+  event.is_instant_placement_enabled = is_instant_placement_enabled;
+  if (!pending_events_.TryPush(&event)) {
+    LOGE("HelloArApplication::OnSettingsChange event queue full, dropped");
+  }
+}
+
+void HelloArApplication::OnTouched(float x, float y) {
+  AppEvent event;
+  event.type = AppEvent::Type::kTouch;
+  event.x = x;
+  event.y = y;
+  if (!pending_events_.TryPush(&event)) {
+    LOGE("HelloArApplication::OnTouched event queue full, touch dropped");
+  }
+}
+
+void HelloArApplication::ResolveGeospatialAnchor(bool on_rooftop,
+                                                 double latitude,
+                                                 double longitude,
+                                                 double altitude_m,
+                                                 float heading_degrees) {
+  if (!kUseGeospatialAnchors) {
+    LOGE("ResolveGeospatialAnchor needs kUseGeospatialAnchors");
+    return;
+  }
+  AppEvent event;
+  event.type = AppEvent::Type::kResolveGeospatialAnchor;
+  AnchorResolveScheduler::Request& request = event.geospatial_anchor;
+  request.type = on_rooftop ? AnchorResolveScheduler::AnchorType::kRooftop
+                            : AnchorResolveScheduler::AnchorType::kTerrain;
+  request.latitude = latitude;
+  request.longitude = longitude;
+  request.altitude_m = altitude_m;
+  // Rotates +Z to face the heading in the East-Up-South frame, see
+  // ArEarth_resolveAnchorOnTerrainAsync.
+  const float angle = (180.0f - heading_degrees) * M_PI / 180.0f;
+  request.eus_quaternion[1] = std::sin(angle / 2.0f);
+  request.eus_quaternion[3] = std::cos(angle / 2.0f);
+  if (!pending_events_.TryPush(&event)) {
+    LOGE("ResolveGeospatialAnchor: event queue full, request dropped");
+  }
+}
+
+void HelloArApplication::ResolveCloudAnchor(
+    const std::string& cloud_anchor_id) {
+  if (!kUseCloudAnchors) {
+    LOGE("ResolveCloudAnchor needs kUseCloudAnchors");
+    return;
+  }
+  AppEvent event;
+  event.type = AppEvent::Type::kResolveCloudAnchor;
+  event.cloud_anchor_id = cloud_anchor_id;
+  if (!pending_events_.TryPush(&event)) {
+    LOGE("ResolveCloudAnchor: event queue full, request dropped");
+  }
+}
+
+std::string HelloArApplication::GetCloudAnchorReport() const {
+  return cloud_anchor_pipeline_.GetReport();
+}
+
+void HelloArApplication::ApplyPendingEvents() {
+  bool is_instant_placement_enabled = is_instant_placement_enabled_;
+  AppEvent event;
+  while (pending_events_.TryPop(&event)) {
+    switch (event.type) {
+      case AppEvent::Type::kTouch:
+        // Touches wait for frames that were never hit tested, e.g. while
+        // there is no session, only up to the capacity of the queue.
+        if (frame_touches_.size() < kAppEventQueueCapacity) {
+          frame_touches_.push_back(glm::vec2(event.x, event.y));
+        }
+        break;
+      case AppEvent::Type::kSettingsChange:
+        is_instant_placement_enabled = event.is_instant_placement_enabled;
+        break;
+      case AppEvent::Type::kResolveGeospatialAnchor:
+        anchor_resolve_scheduler_.Submit(event.geospatial_anchor);
+        break;
+      case AppEvent::Type::kResolveCloudAnchor:
+        cloud_anchor_pipeline_.Resolve(event.cloud_anchor_id);
+        break;
+    }
+  }
+
+  // The policy sees the planes and content of the previous frame.
+  const bool was_feature_policy_depth_enabled =
+      session_feature_policy_.IsDepthEnabled();
+  const bool feature_policy_changed =
+      kUseSessionFeaturePolicy && ar_session_ != nullptr &&
+      session_feature_policy_.Update(
+          ar_session_, plane_registry_.GetRenderablePlanes(), IsDepthNeeded(),
+          std::chrono::steady_clock::now());
+
+  // Only the last of several changes counts, and none if they cancel out.
+  // The same goes for the quality level.
+  const int quality_level = quality_level_.load(std::memory_order_relaxed);
+  if (is_instant_placement_enabled == is_instant_placement_enabled_ &&
+      quality_level == session_quality_level_ && !feature_policy_changed) {
+    return;
+  }
+  const bool was_instant_placement_active = IsInstantPlacementActive();
+  const bool was_camera_throttled =
+      IsQualityStepTaken(session_quality_level_, QualityStep::kCameraFps);
+  const bool was_depth_enabled =
+      !IsQualityStepTaken(session_quality_level_, QualityStep::kDepth) &&
+      (!kUseSessionFeaturePolicy || was_feature_policy_depth_enabled);
+  is_instant_placement_enabled_ = is_instant_placement_enabled;
+  session_quality_level_ = quality_level;
+  if (ar_session_ == nullptr) {
+    return;
+  }
+
+  // Changing the camera config pauses the session, which the update thread
+  // must not do to itself, and would end a capture.
+  const bool is_camera_throttled =
+      IsQualityStepTaken(quality_level, QualityStep::kCameraFps);
+  if (is_camera_throttled != was_camera_throttled && !kUseArUpdateThread &&
+      !session_capture_.IsCapturing()) {
+    ApplyCameraFrameRate(is_camera_throttled);
+  }
+  const bool is_depth_enabled =
+      !IsQualityStepTaken(quality_level, QualityStep::kDepth) &&
+      (!kUseSessionFeaturePolicy || session_feature_policy_.IsDepthEnabled());
+  // A plane finding change always reconfigures, together with the rest.
+  if (IsInstantPlacementActive() != was_instant_placement_active ||
+      is_depth_enabled != was_depth_enabled || feature_policy_changed) {
+    ConfigureSession(ar_session_);
+  }
+}
+
+void HelloArApplication::UpdateThermalGovernor() {
+  const auto now = std::chrono::steady_clock::now();
+  if (last_frame_time_ != std::chrono::steady_clock::time_point()) {
+    const float frame_ms =
+        std::chrono::duration<float, std::milli>(now - last_frame_time_)
+            .count();
+    if (frame_ms < kMaxGovernedFrameTimeMs) {
+      frame_time_sum_ms_ += frame_ms;
+      ++frame_time_count_;
+    }
+  }
+  last_frame_time_ = now;
+  if (now - last_thermal_update_ < kThermalUpdateInterval ||
+      frame_time_count_ == 0) {
+    return;
+  }
+
+  const float average_frame_ms = frame_time_sum_ms_ / frame_time_count_;
+  frame_time_sum_ms_ = 0.f;
+  frame_time_count_ = 0;
+  last_thermal_update_ = now;
+  thermal_reading_ = thermal_monitor_.Read();
+  const int level =
+      thermal_governor_.Update(thermal_reading_, average_frame_ms, now);
+  if (level != ThermalGovernor::kNoChange) {
+    ApplyQualityLevel(level);
+  }
+}
+
+void HelloArApplication::ApplyQualityLevel(int level) {
+  LOGI("Thermal governor: quality level %d of %d", level, kNumQualitySteps);
+  point_cloud_renderer_.SetPointStride(
+      IsQualityStepTaken(level, QualityStep::kPointCloudDensity)
+          ? kThrottledPointStride
+          : 1);
+  // The LOD bias and the render scale are read where they are used, the
+  // session steps by the thread that updates the session.
+  quality_level_.store(level, std::memory_order_relaxed);
+}
+
+bool HelloArApplication::IsDepthEnabled(const ArSession* session) {
+  if (kUseSessionFeaturePolicy && !session_feature_policy_.IsDepthEnabled()) {
+    return false;
+  }
+  return IsDepthSupported(session) &&
+         !IsQualityStepTaken(session_quality_level_, QualityStep::kDepth);
+}
+
+bool HelloArApplication::IsDepthNeeded() const {
+  // These consume every depth image, whatever is on screen.
+  if (kUseDensePointCloud || kUseTsdfFusion || kUseDepthQuery) {
+    return true;
+  }
+  // Anchors near the view count before occlusion culling, which stops
+  // with depth.
+  return depth_visualization_enabled_ ||
+         (use_depth_for_occlusion_ && !anchor_candidates_.empty());
+}
+
+bool HelloArApplication::IsInstantPlacementActive() const {
+  return is_instant_placement_enabled_ &&
+         !IsQualityStepTaken(session_quality_level_,
+                             QualityStep::kInstantPlacement);
+}
+
+float HelloArApplication::GetRenderScale() const {
+  return IsQualityStepTaken(quality_level_.load(std::memory_order_relaxed),
+                            QualityStep::kRenderResolution)
+             ? kThrottledRenderScale
+             : 1.f;
+}
+
+bool HelloArApplication::RendersAtDisplayRate() {
+  return kUseArUpdateThread && kUseDisplayRatePrediction;
+}
+
+bool HelloArApplication::UsesNativeFrameLoop() {
+  return kUseNativeFrameLoop && NativeFrameLoop::IsSupported();
+}
+
+void HelloArApplication::OnNativeWindowChanged(ANativeWindow* window,
+                                               int display_rotation,
+                                               int width, int height) {
+  if (window != nullptr && !frame_loop_.IsRunning()) {
+    // The loop thread is attached from native code, so the Java methods
+    // have to be looked up here.
+    util::InitializePngJniIds();
+    NativeFrameLoop::Callbacks callbacks;
+    callbacks.surface_created = [this] { OnSurfaceCreated(); };
+    callbacks.draw_frame = [this] {
+      return OnDrawFrame(frame_loop_depth_visualization_enabled_,
+                         frame_loop_use_depth_for_occlusion_,
+                         /*can_skip_frame=*/true);
+    };
+    if (!frame_loop_.Start(std::move(callbacks))) {
+      ANativeWindow_release(window);
+      return;
+    }
+  }
+  frame_loop_.SetWindow(window);
+  if (window != nullptr) {
+    frame_loop_.Post([this, display_rotation, width, height] {
+      OnDisplayGeometryChanged(display_rotation, width, height);
+    });
+  }
+}
+
+void HelloArApplication::SetFrameLoopDepthSettings(
+    bool depth_color_visualization_enabled, bool use_depth_for_occlusion) {
+  frame_loop_depth_visualization_enabled_ = depth_color_visualization_enabled;
+  frame_loop_use_depth_for_occlusion_ = use_depth_for_occlusion;
+}
+
+void HelloArApplication::ApplyCameraFrameRate(bool throttled) {
+  ArCameraConfig* target_config = nullptr;
+  if (throttled) {
+    ArCameraConfig* current_config = nullptr;
+    ArCameraConfig_create(ar_session_, &current_config);
+    ArSession_getCameraConfig(ar_session_, current_config);
+    int32_t width = 0;
+    int32_t height = 0;
+    ArCameraConfig_getTextureDimensions(ar_session_, current_config, &width,
+                                        &height);
+    int32_t min_fps = 0;
+    int32_t max_fps = 0;
+    ArCameraConfig_getFpsRange(ar_session_, current_config, &min_fps,
+                               &max_fps);
+    // A camera at 30 fps already has nothing to give up.
+    if (max_fps <= 30) {
+      ArCameraConfig_destroy(current_config);
+      return;
+    }
+
+    ArCameraConfigFilter* filter = nullptr;
+    ArCameraConfigFilter_create(ar_session_, &filter);
+    ArCameraConfigFilter_setTargetFps(ar_session_, filter,
+                                      AR_CAMERA_CONFIG_TARGET_FPS_30);
+    ArCameraConfigList* configs = nullptr;
+    ArCameraConfigList_create(ar_session_, &configs);
+    ArSession_getSupportedCameraConfigsWithFilter(ar_session_, filter,
+                                                  configs);
+    int32_t num_configs = 0;
+    ArCameraConfigList_getSize(ar_session_, configs, &num_configs);
+    ArCameraConfig* candidate = nullptr;
+    ArCameraConfig_create(ar_session_, &candidate);
+    for (int32_t i = 0; i < num_configs; ++i) {
+      ArCameraConfigList_getItem(ar_session_, configs, i, candidate);
+      int32_t candidate_width = 0;
+      int32_t candidate_height = 0;
+      ArCameraConfig_getTextureDimensions(ar_session_, candidate,
+                                          &candidate_width, &candidate_height);
+      if (candidate_width == width && candidate_height == height) {
+        target_config = candidate;
+        candidate = nullptr;
+        unthrottled_camera_config_ = current_config;
+        current_config = nullptr;
+        break;
+      }
+    }
+    if (candidate != nullptr) {
+      ArCameraConfig_destroy(candidate);
+    }
+    if (current_config != nullptr) {
+      ArCameraConfig_destroy(current_config);
+    }
+    ArCameraConfigList_destroy(configs);
+    ArCameraConfigFilter_destroy(filter);
+  } else {
+    target_config = unthrottled_camera_config_;
+    unthrottled_camera_config_ = nullptr;
+  }
+  if (target_config == nullptr) {
+    return;
+  }
+
+  LOGI("Thermal governor: switching the camera to %s",
+       throttled ? "30 fps" : "its previous frame rate");
+  frame_image_cache_.ReleaseAll();
+  ArSession_pause(ar_session_);
+  ArSession_setCameraConfig(ar_session_, target_config);
+  if (ArSession_resume(ar_session_) != AR_SUCCESS) {
+    LOGE("HelloArApplication::ApplyCameraFrameRate ArSession_resume error");
+  }
+  ArCameraConfig_destroy(target_config);
+}
+
+void HelloArApplication::ProcessPendingTouches() {
+  if (ar_frame_ == nullptr || ar_session_ == nullptr) {
+    return;
+  }
+  // The hits of the previous frame are stale from here on.
+  hit_test_cache_.BeginFrame(ar_session_, ar_frame_, &ar_object_pool_);
+  if (frame_touches_.empty()) {
+    return;
+  }
+
+  // All touches of the frame share one set of scratch handles.
+  HitTestScratch scratch;
+  scratch.candidate = ar_object_pool_.AcquireHitResult();
+  scratch.selected = ar_object_pool_.AcquireHitResult();
+  scratch.hit_pose = ar_object_pool_.AcquirePose();
+  for (const glm::vec2& touch : frame_touches_) {
+    HandleTouch(touch.x, touch.y, &scratch);
+  }
+  frame_touches_.clear();
+}
+
+void HelloArApplication::HandleTouch(float x, float y,
+                                     HitTestScratch* scratch) {
+  // Touches of the same pixel share the hit test.
+  const ArHitResultList* hit_result_list =
+      IsInstantPlacementActive()
+          ? hit_test_cache_.HitTestInstantPlacement(x, y,
+                                                    kApproximateDistanceMeters)
+          : hit_test_cache_.HitTest(x, y);
+  PlaceAnchorAtBestHit(hit_result_list, scratch);
+}
+
+void HelloArApplication::PlaceAnchorAtBestHit(
+    const ArHitResultList* hit_result_list, HitTestScratch* scratch) {
+  int32_t hit_result_list_size = 0;
+  ArHitResultList_getSize(ar_session_, hit_result_list, &hit_result_list_size);
+
+  // The hitTest method sorts the resulting list by distance from the camera,
+  // increasing.  The first hit result will usually be the most relevant when
+  // responding to user input.
+
+  // Each hit is read into |candidate|; a chosen hit is swapped into
+  // |selected| so later items cannot overwrite it.
+  bool has_selection = false;
+  for (int32_t i = 0; i < hit_result_list_size; ++i) {
+    ArHitResult* ar_hit = scratch->candidate;
+    ArHitResultList_getItem(ar_session_, hit_result_list, i, ar_hit);
+
+    ArTrackable* ar_trackable = nullptr;
+    ArHitResult_acquireTrackable(ar_session_, ar_hit, &ar_trackable);
+    ArTrackableType ar_trackable_type = AR_TRACKABLE_NOT_VALID;
+    ArTrackable_getType(ar_session_, ar_trackable, &ar_trackable_type);
+
+    bool select = false;
+    bool stop = false;
+    // Creates an anchor if a plane or an oriented point was hit.
+    if (AR_TRACKABLE_PLANE == ar_trackable_type) {
+      ArPose* hit_pose = scratch->hit_pose;
+      ArHitResult_getHitPose(ar_session_, ar_hit, hit_pose);
+      int32_t in_polygon = 0;
+      ArPlane* ar_plane = ArAsPlane(ar_trackable);
+      ArPlane_isPoseInPolygon(ar_session_, ar_plane, hit_pose, &in_polygon);
+
+      // Use hit pose and camera pose to check if hittest is from the
+      // back of the plane, if it is, no need to create the anchor.
+      float normal_distance_to_plane = util::CalculateDistanceToPlane(
+          *ar_session_, *hit_pose, frame_context_.GetCameraPosition());
+
+      select = stop = in_polygon && normal_distance_to_plane >= 0;
+    } else if (AR_TRACKABLE_POINT == ar_trackable_type) {
+      ArPoint* ar_point = ArAsPoint(ar_trackable);
+      ArPointOrientationMode mode;
+      ArPoint_getOrientationMode(ar_session_, ar_point, &mode);
+      select = stop = AR_POINT_ORIENTATION_ESTIMATED_SURFACE_NORMAL == mode;
+    } else if (AR_TRACKABLE_INSTANT_PLACEMENT_POINT == ar_trackable_type) {
+      select = true;
+    } else if (AR_TRACKABLE_DEPTH_POINT == ar_trackable_type) {
+      // ArDepthPoints are only returned if ArConfig_setDepthMode() is called
+      // with AR_DEPTH_MODE_AUTOMATIC.
+      select = true;
+    }
+    ArTrackable_release(ar_trackable);
+
+    if (select) {
+      std::swap(scratch->candidate, scratch->selected);
+      has_selection = true;
+    }
+    if (stop) {
+      break;
+    }
+  }
+
+  if (!has_selection) {
+    return;
+  }
+  ArHitResult* ar_hit_result = scratch->selected;
+
+  // Note that the application is responsible for releasing the anchor
+  // pointer after using it. Call ArAnchor_release(anchor) to release.
+  ArAnchor* anchor = nullptr;
+  if (ArHitResult_acquireNewAnchor(ar_session_, ar_hit_result, &anchor) !=
+      AR_SUCCESS) {
+    LOGE("HelloArApplication::PlaceAnchorAtBestHit "
+         "ArHitResult_acquireNewAnchor error");
+    return;
+  }
+
+  ArTrackingState tracking_state = AR_TRACKING_STATE_STOPPED;
+  ArAnchor_getTrackingState(ar_session_, anchor, &tracking_state);
+  if (tracking_state != AR_TRACKING_STATE_TRACKING) {
+    ArAnchor_release(anchor);
+    return;
+  }
+
+  ArTrackable* ar_trackable = nullptr;
+  ArHitResult_acquireTrackable(ar_session_, ar_hit_result, &ar_trackable);
+  // The store evicts an anchor by kAnchorEvictionPolicy if it is full.
+  const AnchorStore::Handle handle = anchor_store_.Add(
+      ar_session_, scratch->hit_pose, anchor, ar_trackable);
+  AttachAnchorContent(handle);
+  // Assign a color to the object for rendering based on the trackable type
+  // this anchor attached to. For AR_TRACKABLE_POINT, it's blue color, and
+  // for AR_TRACKABLE_PLANE, it's green color.
+  UpdateAnchorColor(anchor_store_.Get(handle));
+
+  if (kUseCloudAnchors) {
+    const uint32_t request = cloud_anchor_pipeline_.Host(ar_session_, anchor);
+    if (request == 0) {
+      LOGE("HelloArApplication::PlaceAnchorAtBestHit cannot queue the Cloud "
+           "Anchor");
+    } else if (kUseSpatialMapCache && spatial_map_anchor_id_.empty() &&
+               spatial_map_host_request_ == 0) {
+      spatial_map_host_request_ = request;
+      spatial_map_host_anchor_ = handle;
+    }
+  }
+}
+
+void HelloArApplication::UpdateAnchorColor(AnchorStore::Entry* anchor) {
+  ArTrackable* ar_trackable = anchor->trackable;
+  // Anchors without a trackable keep the color they were added with.
+  if (ar_trackable == nullptr) {
+    return;
+  }
+  float* color = anchor->color;
 
   ArTrackableType ar_trackable_type;
   ArTrackable_getType(ar_session_, ar_trackable, &ar_trackable_type);
@@ -17,24 +17,89 @@
 #ifndef C_ARCORE_HELLOE_AR_HELLO_AR_APPLICATION_H_
 #define C_ARCORE_HELLOE_AR_HELLO_AR_APPLICATION_H_
 
+#include <EGL/egl.h>
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
 #include <android/asset_manager.h>
+#include <android/native_window.h>
 #include <jni.h>
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <memory>
 #include <set>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
+#include "anchor_request_budget.h"
+#include "anchor_resolve_scheduler.h"
+#include "anchor_store.h"
+#include "app_event_queue.h"
+#include "ar_object_pool.h"
+#include "asset_loader.h"
+#include "ar_update_thread.h"
+#include "arcore_api_profiler.h"
 #include "arcore_c_api.h"
+#include "background_mesher.h"
 #include "background_renderer.h"
+#include "camera_config_planner.h"
+#include "camera_texture_benchmark.h"
+#include "camera_pose_predictor.h"
+#include "cloud_anchor_pipeline.h"
+#include "dataset_recorder.h"
+#include "depth_pyramid.h"
+#include "depth_query.h"
+#include "egl_image_cache.h"
+#include "environmental_hdr_lighting.h"
+#include "face_mesh_renderer.h"
+#include "frame_context.h"
+#include "frame_graph.h"
+#include "frame_readback.h"
+#include "frame_image_cache.h"
+#include "frame_stage_timers.h"
+#include "frame_telemetry.h"
+#include "geospatial_anchor_index.h"
+#include "gl_upload_thread.h"
 #include "glm.h"
+#include "gpu_stage_timers.h"
+#include "hit_test_cache.h"
+#include "late_pose_reprojector.h"
+#include "native_frame_loop.h"
 #include "obj_renderer.h"
+#include "occlusion_blur.h"
+#include "performance_hint_session.h"
+#include "performance_hud.h"
+#include "plane_index.h"
+#include "plane_registry.h"
 #include "plane_renderer.h"
+#include "playback_benchmark.h"
+#include "point_cloud_map.h"
 #include "point_cloud_renderer.h"
+#include "redraw_gate.h"
+#include "render_pass.h"
+#include "render_queue.h"
+#include "scene_graph.h"
+#include "semantics_pipeline.h"
+#include "session_capture.h"
+#include "session_feature_policy.h"
+#include "session_starter.h"
+#include "skinned_obj_renderer.h"
+#include "spatial_map_cache.h"
+#include "state_capture.h"
+#include "streetscape_geometry_renderer.h"
+#include "temporal_depth_filter.h"
 #include "texture.h"
+#include "thermal_governor.h"
+#include "tsdf_mesh_renderer.h"
+#include "tsdf_volume.h"
+#include "ui_state_channel.h"
+#include "update_mode_controller.h"
 #include "util.h"
+#include "virtual_content_target.h"
+#include "vps_availability_cache.h"
 
 namespace hello_ar {
 
@@ -42,7 +107,11 @@ namespace hello_ar {
 class HelloArApplication {
  public:
   // Constructor and deconstructor.
-  explicit HelloArApplication(AAssetManager* asset_manager);
+  // @param asset_manager, AAssetManager pointer.
+  // @param cache_dir, writable directory used to persist compiled shader
+  // programs between runs.
+  HelloArApplication(AAssetManager* asset_manager,
+                     const std::string& cache_dir);
   ~HelloArApplication();
 
   // OnPause is called on the UI thread from the Activity's onPause method.
@@ -52,7 +121,8 @@ class HelloArApplication {
   void OnResume(JNIEnv* env, void* context, void* activity);
 
   // OnSurfaceCreated is called on the OpenGL thread when GLSurfaceView
-  // is created.
+  // is created.  The GL content is only rebuilt if the context it was made
+  // in is gone.
   void OnSurfaceCreated();
 
   // OnDisplayGeometryChanged is called on the OpenGL thread when the
@@ -64,10 +134,15 @@ class HelloArApplication {
   void OnDisplayGeometryChanged(int display_rotation, int width, int height);
 
   // OnDrawFrame is called on the OpenGL thread to render the next frame.
-  void OnDrawFrame(bool depthColorVisualizationEnabled,
-                   bool useDepthForOcclusion);
+  // If |can_skip_frame|, the caller can keep the previous frame on the
+  // display, and false is returned for frames that would show the same, see
+  // RedrawGate.
+  bool OnDrawFrame(bool depthColorVisualizationEnabled,
+                   bool useDepthForOcclusion, bool can_skip_frame);
 
-  // OnTouched is called on the OpenGL thread after the user touches the screen.
+  // OnTouched is called on the UI thread after the user touches the screen.
+  // The touch is queued and hit tested against the next frame, together with
+  // all other touches since the previous frame.
   // @param x: x position on the screen (pixels).
   // @param y: y position on the screen (pixels).
   void OnTouched(float x, float y);
@@ -78,44 +153,823 @@ class HelloArApplication {
 
   // Returns true if depth is supported.
   bool IsDepthSupported();
+  static bool IsDepthSupported(const ArSession* session);
 
+  // Called on the UI thread.  The change is queued like a touch and applied
+  // before the next ArSession_update; several changes in between reconfigure
+  // the session once.
   void OnSettingsChange(bool is_instant_placement_enabled);
 
+  // Called on the UI thread.  Queues a Terrain or Rooftop anchor at the
+  // location, |altitude_m| above the surface and facing |heading_degrees|
+  // clockwise from north.  The anchors nearest to the user are resolved
+  // first; an Andy is drawn at each one resolved.  Ignored unless the app is
+  // built with kUseGeospatialAnchors.
+  void ResolveGeospatialAnchor(bool on_rooftop, double latitude,
+                               double longitude, double altitude_m,
+                               float heading_degrees);
+
+  // Called on the UI thread.  Queues |cloud_anchor_id| for resolving; an
+  // Andy is drawn at the anchor once it resolved.  Ignored unless the app is
+  // built with kUseCloudAnchors, which also hosts every placed anchor.
+  void ResolveCloudAnchor(const std::string& cloud_anchor_id);
+
+  // The counts and latencies of CloudAnchorPipeline as text.  Can be called
+  // from any thread.
+  std::string GetCloudAnchorReport() const;
+
+  // Returns the number of ARCore handles created during the previous frame.
+  // Reads zero once every scratch handle the app needs has been pooled.
+  int GetArAllocationsLastFrame() const {
+    return ar_object_pool_.GetAllocationsLastFrame();
+  }
+
+  // Switches the application to the playback benchmark mode: the session
+  // plays |dataset_uri|, an MP4 recording, instead of the live camera, frames
+  // are drawn without vsync, and the stage timings of every frame are written
+  // to |csv_path| until the recording ends.  Must be called before the first
+  // OnResume() and OnSurfaceCreated().  Returns false if |csv_path| cannot be
+  // written.
+  bool StartPlaybackBenchmark(const std::string& dataset_uri,
+                              const std::string& csv_path);
+
+  // Returns true once the whole benchmark recording has been played back.
+  bool IsPlaybackBenchmarkFinished() const { return benchmark_finished_; }
+
+  // Runs a CameraTextureBenchmark, which alternates the camera texture modes
+  // and writes the per-device comparison to |report_path|.  Frames are drawn
+  // the way the playback benchmark draws them.  The session plays
+  // |dataset_uri| unless it is empty, in which case the live camera is
+  // measured for a fixed number of frames.  Must be called before the first
+  // OnResume() and OnSurfaceCreated().  Returns false if the report cannot be
+  // written or the session is updated on the AR update thread, which binds
+  // its own textures.  The end is reported like that of the playback
+  // benchmark.
+  bool StartCameraTextureBenchmark(const std::string& dataset_uri,
+                                   const std::string& report_path);
+
+  // Runs an ArCoreApiProfiler against the live session, which times single
+  // ARCore C API calls in tight loops after each update and writes the
+  // report, noting |arcore_version|, to |report_path| as JSON.  Returns false
+  // if the report cannot be written or the session is updated on the AR
+  // update thread, whose frames this thread must not touch.  The end is
+  // reported like that of the playback benchmark.
+  bool StartArCoreApiProfiler(const std::string& report_path,
+                              const std::string& arcore_version);
+
+  // Switches how the camera image reaches the background texture from the
+  // next frame on.  kHardwareBuffer falls back to kTextureName where it is
+  // not supported, and neither applies with the AR update thread.  May be
+  // called from any thread.
+  void SetCameraTextureMode(CameraTextureMode mode) {
+    requested_camera_texture_mode_ = mode;
+  }
+
+  // Starts recording the composited output to |video_path| with the hardware
+  // encoder and, if |dataset_uri| is not empty, an ARCore dataset of the
+  // session next to it.  Must be called on the OpenGL thread.  Returns false if
+  // the recording cannot be started.
+  bool StartCapture(const std::string& video_path,
+                    const std::string& dataset_uri);
+
+  // Finishes the files written since StartCapture().  Must be called on the
+  // OpenGL thread; pausing the application stops the capture as well.
+  void StopCapture() { session_capture_.Stop(); }
+
+  bool IsCapturing() const { return session_capture_.IsCapturing(); }
+
+  // Starts and stops an ARCore dataset recording without the video, see
+  // DatasetRecorder.  Called on the UI thread; the session is only told on
+  // the recorder's own thread, so the frames drawn meanwhile are not held
+  // up.  Return false if the previous start or stop is still running.
+  bool StartDatasetRecording(const std::string& dataset_uri);
+  bool StopDatasetRecording();
+
+  // Called on the UI thread.  Embeds |marker| in the running dataset
+  // recording with one of the next frames.  Returns false if too many
+  // markers are queued.
+  bool RecordDatasetMarker(const std::string& marker) {
+    return dataset_recorder_.QueueMarker(marker);
+  }
+
+  // Frame times with and without a dataset recording, and the recordings'
+  // start and stop latencies, as text.  Can be called from any thread.
+  std::string GetDatasetRecordingReport() const {
+    return dataset_recorder_.GetReport();
+  }
+
+  // Starts logging a FrameTelemetryRecord of every frame to |path|, which is
+  // also embedded in ARCore recordings made meanwhile.  Only frames drawn
+  // while ArSession_update runs on the OpenGL thread are logged.  Must be
+  // called on the OpenGL thread.  Returns false if |path| cannot be written.
+  bool StartTelemetryLog(const std::string& path) {
+    telemetry_frame_index_ = 0;
+    return telemetry_log_.Start(path);
+  }
+
+  // Closes the file written since StartTelemetryLog().  Must be called on
+  // the OpenGL thread.
+  void StopTelemetryLog() { telemetry_log_.Stop(); }
+
+  // Starts capturing the ARCore state of every frame to |path| for the
+  // desktop replay in tools/arcore_replay, see StateCapture.  Only frames
+  // drawn while ArSession_update runs on the OpenGL thread are captured.
+  // Must be called on the OpenGL thread.  Returns false if |path| cannot be
+  // written.
+  bool StartStateCapture(const std::string& path);
+
+  // Finishes the file written since StartStateCapture().  Must be called on
+  // the OpenGL thread; pausing the application stops the capture as well.
+  void StopStateCapture() { state_capture_.Stop(); }
+
+  // Writes the next drawn frame, without the performance overlay, to |path|
+  // as a binary PPM.  The pixels are read back and written without blocking
+  // the OpenGL thread, see FrameReadback.  Must be called on the OpenGL
+  // thread.
+  void CaptureScreenshot(const std::string& path) { screenshot_path_ = path; }
+
+  // Number of tracking anchors drawn and skipped by frustum culling in the
+  // last frame.  May be called from any thread.
+  int GetAnchorsDrawnLastFrame() const { return anchors_drawn_last_frame_; }
+  int GetAnchorsCulledLastFrame() const { return anchors_culled_last_frame_; }
+
+  // Depth images uploaded to the depth texture per second.  Depth images are
+  // only uploaded once, however many frames share them.  May be called from
+  // any thread.
+  float GetDepthUploadsPerSecond() const { return depth_uploads_per_second_; }
+
+  // Returns rolling timing statistics of the OnDrawFrame stages, indexed by
+  // FrameStage.  May be called from any thread.
+  std::array<FrameStageTimers::Summary, kNumFrameStages>
+  GetFrameStageSummaries() const {
+    return frame_stage_timers_.GetSummaries();
+  }
+
+  // Same as GetFrameStageSummaries() for the GPU execution time of the stages
+  // drawn on the GL thread.  Stages without samples, e.g. when the GPU has no
+  // timer queries, read zero.  May be called from any thread.
+  std::array<FrameStageTimers::Summary, kNumFrameStages>
+  GetGpuFrameStageSummaries() const {
+    return gpu_stage_timers_.GetSummaries();
+  }
+
+  // Fraction of the view size the GL surface should be rendered at, lowered
+  // by the thermal governor.  The activity polls it and resizes the surface.
+  // May be called from any thread.
+  float GetRenderScale() const;
+
+  // Whether frames are drawn with predicted poses at display rate, so the
+  // activity should ask for the display's highest refresh rate.
+  static bool RendersAtDisplayRate();
+
+  // Whether the activity renders through OnNativeWindowChanged() instead of
+  // a GLSurfaceView, see NativeFrameLoop.
+  static bool UsesNativeFrameLoop();
+
+  // With the native frame loop, called on the UI thread with the activity's
+  // window, whose reference it takes over, whenever the surface or the
+  // display rotation changes, and with nullptr from surfaceDestroyed().
+  // The first window starts the loop, which then calls OnSurfaceCreated()
+  // and OnDrawFrame() on its thread.
+  void OnNativeWindowChanged(ANativeWindow* window, int display_rotation,
+                             int width, int height);
+
+  // The depth options the native frame loop passes to OnDrawFrame().  May be
+  // called from any thread.
+  void SetFrameLoopDepthSettings(bool depth_color_visualization_enabled,
+                                 bool use_depth_for_occlusion);
+
+  // Runs |task| on the native frame loop before its next frame, like
+  // GLSurfaceView.queueEvent().  May be called from any thread.
+  void PostToFrameLoop(std::function<void()> task) {
+    frame_loop_.Post(std::move(task));
+  }
+
+  // Shows or hides the performance overlay drawn over the scene, see
+  // PerformanceHud.  May be called from any thread.
+  void SetPerformanceHudEnabled(bool enabled) {
+    performance_hud_enabled_ = enabled;
+  }
+
+  // The state published to the Java UI after every frame.  Its buffer stays
+  // valid until the application is destroyed.
+  UiStateChannel* GetUiStateChannel() { return &ui_state_channel_; }
+
  private:
   glm::mat3 GetTextureTransformMatrix(const ArSession* session,
                                       const ArFrame* frame);
+
+  // Renders one frame; OnDrawFrame() wraps it with the benchmark timing.
+  // Returns false if |can_skip_frame| and the frame was skipped after the
+  // update.
+  bool DrawFrame(bool depthColorVisualizationEnabled, bool useDepthForOcclusion,
+                 bool can_skip_frame);
+
+  // Writes the timings of the frame just drawn and stops the benchmark at the
+  // end of the recording.
+  void RecordBenchmarkFrame(std::chrono::nanoseconds frame_time);
+
+  // Whether either benchmark times the frames.
+  bool IsBenchmarkRunning() const {
+    return playback_benchmark_.IsOpen() ||
+           camera_texture_benchmark_.IsRunning() ||
+           arcore_api_profiler_.IsRunning();
+  }
+
+  // Reconfigures the session when the benchmark or SetCameraTextureMode()
+  // asks for another camera texture mode.
+  void UpdateCameraTextureMode();
+
+  // Binds the camera hardware buffer of ar_frame_ to the background texture
+  // in kHardwareBuffer mode.
+  void BindCameraHardwareBuffer();
+
+  // Logs the frame just drawn to telemetry_log_ while it runs, embeds it in
+  // a running recording and logs the records played back with the frame.
+  void RecordTelemetry(std::chrono::nanoseconds frame_time);
+
+  // Records the queued markers on the frame just drawn and its time in the
+  // dataset recorder's statistics.
+  void RecordDatasetFrame(std::chrono::nanoseconds frame_time);
+
+  // Adds the frame just drawn to state_capture_ while it runs.
+  void CaptureState();
+
+  // Publishes the state of the frame just drawn to ui_state_channel_.
+  void PublishUiState(std::chrono::nanoseconds frame_time);
+
+  // Reports the CPU time of the frame just drawn to
+  // performance_hint_session_, with the threads that worked on it.
+  void ReportPerformanceHint(std::chrono::nanoseconds frame_time);
+  // Pauses performance_hint_session_ once no frame was drawn for
+  // kPerformanceHintIdleTimeout.  Called for the frames that are skipped.
+  void IdlePerformanceHint(std::chrono::steady_clock::time_point now);
+
+  // Feeds the frame time to thermal_governor_ and reads the thermal status
+  // once per kThermalUpdateInterval.  Called on the GL thread every frame.
+  void UpdateThermalGovernor();
+
+  // The policy of the thermal governor: applies quality |level| to the
+  // renderers right away, and to the session at the next ApplyPendingEvents().
+  // Called on the GL thread.
+  void ApplyQualityLevel(int level);
+
+  // Whether the quality level leaves depth and Instant Placement on.
+  bool IsDepthEnabled(const ArSession* session);
+  bool IsInstantPlacementActive() const;
+  // Whether the last frame drew something that needs depth, for
+  // session_feature_policy_.
+  bool IsDepthNeeded() const;
+
+  // Switches to a 30 fps camera config of the same resolution, or back to
+  // the config from before.  Pauses the session, so it must not be called
+  // while capturing or from the AR update thread.
+  void ApplyCameraFrameRate(bool throttled);
+
   ArSession* ar_session_ = nullptr;
   ArFrame* ar_frame_ = nullptr;
 
   bool install_requested_ = false;
+  // The context the GL content was last built in, only used on the OpenGL
+  // thread.
+  EGLContext gl_content_context_ = EGL_NO_CONTEXT;
+  // steady_clock time of the last OnResume() in nanoseconds, until the first
+  // frame after it logs the time to it, 0 otherwise.
+  std::atomic<int64_t> resume_time_ns_{0};
   bool calculate_uv_transform_ = false;
   int width_ = 1;
   int height_ = 1;
   int display_rotation_ = 0;
   bool is_instant_placement_enabled_ = true;
 
+  ThermalMonitor thermal_monitor_;
+  ThermalGovernor thermal_governor_;
+  std::chrono::steady_clock::time_point last_frame_time_;
+  std::chrono::steady_clock::time_point last_thermal_update_;
+  float frame_time_sum_ms_ = 0.f;
+  int frame_time_count_ = 0;
+  // The last reading, logged with the telemetry of every frame.
+  ThermalMonitor::Reading thermal_reading_;
+  // Set by ApplyQualityLevel() and applied to the session by the thread that
+  // updates it, which keeps the level it applied last.
+  std::atomic<int> quality_level_{0};
+  int session_quality_level_ = 0;
+  // The camera config from before the frame rate step, restored after it.
+  ArCameraConfig* unthrottled_camera_config_ = nullptr;
+  // Covers the GL thread, the update thread and the job system workers,
+  // with kUsePerformanceHints.  Used on the GL thread, and in OnPause()
+  // while it does not draw.
+  PerformanceHintSession performance_hint_session_;
+  std::vector<int32_t> performance_hint_thread_ids_;
+  std::chrono::steady_clock::time_point last_performance_hint_;
+
   AAssetManager* const asset_manager_;
 
   // The anchors at which we are drawing android models using given colors.
-  struct ColoredAnchor {
-    ArAnchor* anchor;
-    ArTrackable* trackable;
-    float color[4];
-  };
+  AnchorStore anchor_store_;
+  // Anchors in the cells the camera sees, reused across frames.
+  std::vector<AnchorStore::Entry*> anchor_candidates_;
+  // What is drawn at the anchors, only recomputed for anchors that moved.
+  SceneGraph scene_graph_;
+
+  // Per-frame instance data for the tracking anchors, kept as a member so its
+  // capacity is reused across frames.
+  ObjRenderer::LodInstances andy_instances_;
+  // Same for the anchors drawn by skinned_andy_renderer_.
+  std::vector<SkinnedObjRenderer::Instance> skinned_andy_instances_;
+  // Depth keys of andy_instances_, which orders each level front to back so
+  // that nearer copies hide the fragments of farther ones.
+  std::array<std::vector<RadixSorter::Item>, ObjRenderer::kMaxLodCount>
+      andy_depth_keys_;
+  std::vector<ObjRenderer::Instance> sorted_andy_instances_;
+  RadixSorter andy_sorter_;
+
+  // Scratch ARCore handles reused across frames instead of being created and
+  // destroyed on every use.  Only used by the thread calling ArSession_update.
+  ArObjectPool ar_object_pool_;
+
+  // Hit tests of the current frame, shared by the touches and anything else
+  // that casts rays, and counted in the telemetry.  Takes its lists from
+  // ar_object_pool_, on the same thread.
+  HitTestCache hit_test_cache_;
+
+  // Gyroscope samples of ApplyLatePose() and PredictSnapshotView(), on the
+  // OpenGL thread.
+  LatePoseReprojector late_pose_reprojector_;
+  // Camera poses of the snapshots PredictSnapshotView() drew.
+  CameraPosePredictor camera_pose_predictor_;
+
+  // Images of the current frame shared by the depth texture and the depth
+  // consumers when ArSession_update runs on the OpenGL thread.  Snapshots
+  // own their images instead, since they outlive the update.
+  FrameImageCache frame_image_cache_;
+
+  // Runs ArSession_update off the OpenGL thread if kUseArUpdateThread is set.
+  // The session, ar_frame_, anchor_store_ and the pool then belong to the
+  // update thread and the OpenGL thread only draws the published snapshots.
+  ArUpdateThread ar_update_thread_;
+
+  // Draws the frames instead of the GLSurfaceView if UsesNativeFrameLoop().
+  NativeFrameLoop frame_loop_;
+  // Which frames are drawn, see kUseRedrawGate.  Belongs to the OpenGL
+  // thread.
+  RedrawGate redraw_gate_;
+  std::atomic<bool> frame_loop_depth_visualization_enabled_{false};
+  std::atomic<bool> frame_loop_use_depth_for_occlusion_{false};
 
-  std::vector<ColoredAnchor> anchors_;
+  // Events queued by OnTouched() and OnSettingsChange() until the next
+  // ArSession_update.
+  AppEventQueue pending_events_;
+  // Touches taken from pending_events_ for the next frame's hit tests.
+  std::vector<glm::vec2> frame_touches_;
 
+  // Background quad uvs and uv transform for the current display geometry,
+  // refreshed by the update thread and copied into each snapshot.
+  float snapshot_uvs_[BackgroundRenderer::kNumUvComponents] = {};
+  glm::mat3 snapshot_uv_transform_ = glm::mat3(1.0f);
+
+  // Uploads the textures and meshes asset_loader_ decoded on a context
+  // shared with the GL thread's, with kUseGlUploadThread.
+  GlUploadThread gl_upload_thread_;
+  // Decodes textures off the GL thread; DrawFrame() uploads what it finished.
+  AssetLoader asset_loader_;
+  FrameGraph frame_graph_;
+  // The draws within a pass that are ordered by depth, e.g. the planes.
+  RenderQueue render_queue_;
+  VirtualContentTarget virtual_content_target_;
+  RenderScaleGovernor render_scale_governor_;
+  std::chrono::steady_clock::time_point last_render_scale_update_;
+  // Whether virtual_content_target_ is bound for the frame graph's passes.
+  bool is_virtual_content_target_bound_ = false;
+  // The draws of a frame into the surface, from DrawFrame() to the end of
+  // OnDrawFrame().
+  RenderPass surface_render_pass_;
+  // Whether the last frame drew the camera image, which then covers the
+  // surface in the next one as well.  Cleared with each new ar_frame_.
+  bool background_covers_surface_ = false;
   PointCloudRenderer point_cloud_renderer_;
+  // Feature points of all frames, only updated with kUsePointCloudMap.
+  PointCloudMap point_cloud_map_;
   BackgroundRenderer background_renderer_;
   PlaneRenderer plane_renderer_;
   ObjRenderer andy_renderer_;
+  // Draws the anchors animated instead of andy_renderer_ while
+  // DrawsSkinnedAnchors().
+  SkinnedObjRenderer skinned_andy_renderer_;
+  // Set on the GL thread once skinned_andy_renderer_ loaded its model, read
+  // by the thread that collects the instances.
+  std::atomic<bool> skinned_andy_loaded_{false};
   Texture depth_texture_;
+  // Depth steadied over time for occlusion, only updated with
+  // kUseTemporalDepthFilter.
+  TemporalDepthFilter temporal_depth_filter_;
+
+  // Surface fused from the depth images, only created with kUseTsdfFusion.
+  std::unique_ptr<BackgroundMesher> background_mesher_;
+  TsdfMeshRenderer tsdf_mesh_renderer_;
+  TsdfVolume::MeshUpdate tsdf_mesh_update_;
+  int64_t last_fused_depth_timestamp_ = -1;
+
+  // Terrain and buildings around the user, only with kUseStreetscapeGeometry.
+  StreetscapeGeometryRenderer streetscape_geometry_renderer_;
+  // Cleared if the session cannot be configured for the Geospatial API.
+  bool use_geospatial_mode_ = true;
+
+  // Futures in flight of anchor_resolve_scheduler_ and
+  // cloud_anchor_pipeline_ together.  Belongs to the thread that updates the
+  // session.
+  AnchorRequestBudget anchor_request_budget_;
+  // Resolves the anchors of ResolveGeospatialAnchor(), only used with
+  // kUseGeospatialAnchors.  Same thread.
+  AnchorResolveScheduler anchor_resolve_scheduler_;
+  std::vector<AnchorResolveScheduler::Result> resolve_results_;
+  ArGeospatialPose* camera_geospatial_pose_ = nullptr;
+  // The resolved anchors refreshed by it instead of AnchorStore, with
+  // kUseGeospatialAnchorIndex.  Same thread.
+  GeospatialAnchorIndex geospatial_anchor_index_;
+  std::vector<AnchorStore::Handle> geospatial_refresh_handles_;
+  // Of the camera, as of the last frame the Earth was tracking.
+  double camera_altitude_m_ = 0.0;
+  // VPS availability of the cells the camera enters, with
+  // kUseVpsAvailabilityCache.  Same thread.
+  VpsAvailabilityCache vps_availability_cache_;
+  ArVpsAvailability camera_vps_availability_ = AR_VPS_AVAILABILITY_UNKNOWN;
+
+  // Hosts the placed anchors and resolves the ids of ResolveCloudAnchor(),
+  // only used with kUseCloudAnchors.  Belongs to the thread that updates the
+  // session.
+  CloudAnchorPipeline cloud_anchor_pipeline_;
+  std::vector<CloudAnchorPipeline::Result> cloud_anchor_results_;
+
+  // Maps of past sessions by Cloud Anchor id, only used with
+  // kUseSpatialMapCache.  The first anchor hosted or resolved in a session
+  // keys its map; spatial_map_host_request_ is the host request of the
+  // placed anchor spatial_map_host_anchor_ until then.  Chunks of a resolved
+  // anchor's map wait in spatial_map_restore_ until they are restored.
+  SpatialMapCache spatial_map_cache_;
+  uint32_t spatial_map_host_request_ = 0;
+  AnchorStore::Handle spatial_map_host_anchor_;
+  std::string spatial_map_anchor_id_;
+  AnchorStore::Handle spatial_map_anchor_;
+  SpatialMapCache::Map spatial_map_restore_;
+
+  // Min/max depth of the latest depth image, only built with
+  // kUseDepthPyramid.  The CPU one belongs to the thread that collects the
+  // anchors, the texture to the OpenGL thread.
+  DepthPyramid depth_pyramid_;
+  DepthPyramidTexture depth_pyramid_texture_;
+  // Blurred depth for the occlusion shaders, only updated with
+  // kUseOcclusionBlurTexture.
+  OcclusionBlurTexture occlusion_blur_texture_;
+  // Meshes of the tracked faces, only drawn with kUseAugmentedFaces.
+  FaceMeshRenderer face_mesh_renderer_;
+  // Semantic images and label statistics, only used with kUseSemantics.
+  SemanticsPipeline semantics_pipeline_;
+  int semantic_images_since_log_ = 0;
+  // Prefiltered light estimates, only used with kUseEnvironmentalHdr.
+  EnvironmentalHdrLighting environmental_hdr_lighting_;
+  // CPU copy of the latest depth image, only kept with kUseDepthQuery.
+  // Belongs to the thread that calls ArSession_update.
+  DepthQuery depth_query_;
+  // Tracked planes for CPU raycasts, only kept with kUsePlaneIndex.  Belongs
+  // to the thread that calls ArSession_update, like depth_query_.
+  PlaneIndex plane_index_;
+  // The planes of the session and which of them are drawn, kept up to date by
+  // ProcessUpdatedPlanes().  Belongs to the thread that calls ArSession_update.
+  PlaneRegistry plane_registry_;
+  // Last useDepthForOcclusion and depthColorVisualizationEnabled passed to
+  // OnDrawFrame(), read by the update thread.
+  std::atomic<bool> use_depth_for_occlusion_{false};
+  std::atomic<bool> depth_visualization_enabled_{false};
 
   int32_t plane_count_ = 0;
 
-  void ConfigureSession();
+  // Whether the session supports AR_DEPTH_MODE_AUTOMATIC, refreshed when the
+  // session is configured.
+  bool is_depth_supported_ = false;
+  // How the background draws the camera image, kOff unless the session is
+  // configured with EIS.  Refreshed when the session is configured.
+  BackgroundRenderer::StabilizationMode stabilization_mode_ =
+      BackgroundRenderer::StabilizationMode::kOff;
+  // The mode the session is configured with.  Only changed on the OpenGL
+  // thread, but read when a session is prepared on another one.
+  std::atomic<CameraTextureMode> camera_texture_mode_{
+      CameraTextureMode::kTextureName};
+  std::atomic<CameraTextureMode> requested_camera_texture_mode_{
+      CameraTextureMode::kTextureName};
+  // Images of the camera hardware buffers in kHardwareBuffer mode.
+  EglImageCache egl_image_cache_;
+
+  // Snapshot of the current frame shared by everything drawn or handled in it.
+  FrameContext frame_context_;
+
+  FrameStageTimers frame_stage_timers_;
+  GpuStageTimers gpu_stage_timers_;
+  std::atomic<int> anchors_drawn_last_frame_{0};
+  std::atomic<int> anchors_culled_last_frame_{0};
+  std::atomic<float> depth_uploads_per_second_{0.f};
+  // Assets uploaded by the last DrawFrame().
+  int asset_uploads_last_frame_ = 0;
+
+  PerformanceHud performance_hud_;
+  std::atomic<bool> performance_hud_enabled_{false};
+  // Whether the overlay was drawn in the previous frame.
+  bool performance_hud_shown_ = false;
+
+  UiStateChannel ui_state_channel_;
+  int32_t ui_state_frame_count_ = 0;
+
+  // Playback benchmark state, see StartPlaybackBenchmark().
+  std::string benchmark_dataset_uri_;
+  PlaybackBenchmark playback_benchmark_;
+  CameraTextureBenchmark camera_texture_benchmark_;
+  ArCoreApiProfiler arcore_api_profiler_;
+  std::atomic<bool> benchmark_finished_{false};
+
+  // Hardware-encoded recording of the composited output, see StartCapture().
+  SessionCapture session_capture_;
+  // Dataset recordings of StartDatasetRecording().
+  DatasetRecorder dataset_recorder_;
+  // Camera config of new sessions, used on the UI thread.
+  CameraConfigPlanner camera_config_planner_;
+  // Update mode of the session, reset on the UI thread when the session is
+  // created and then fed on the OpenGL thread.
+  UpdateModeController update_mode_controller_;
+  // Plane finding and depth of the session, reset on the UI thread when the
+  // session is created and then updated by ApplyPendingEvents().
+  SessionFeaturePolicy session_feature_policy_;
+
+  // Per-frame telemetry, see StartTelemetryLog().
+  FrameTelemetryLog telemetry_log_;
+  uint32_t telemetry_frame_index_ = 0;
+
+  // Session capture for the desktop replay, see StartStateCapture().
+  StateCapture state_capture_;
+
+  // Reads frames back for CaptureScreenshot().  Used on the GL thread.
+  FrameReadback frame_readback_;
+  // Of the next screenshot, empty if none was asked for.
+  std::string screenshot_path_;
+  // Runs frame_readback_ and starts the screenshot asked for, once per drawn
+  // frame.
+  void UpdateFrameReadback();
+
+  void ConfigureSession(ArSession* session);
+
+  // Sets up a new |session| before its first resume: the camera config, the
+  // configuration and the playback dataset, and resets what is kept per
+  // session.  Runs on the UI thread, or on session_starter_'s worker while
+  // nothing else uses the session.  Returns false if the dataset cannot be
+  // played back.
+  bool PrepareSession(ArSession* session);
+
+  // Takes the session from session_starter_ once it is resumed and creates
+  // the frame for it.  Called on the GL thread, or while it is paused.
+  void AdoptStartedSession();
+
+  // Brings up the session with kUseAsyncSessionStart.  The session it hands
+  // out belongs to the thread that updates it.
+  SessionStarter session_starter_;
+
+  // Queries everything the renderers and input handlers need from the
+  // current frame into frame_context_.  Called right after ArSession_update.
+  void UpdateFrameContext();
+
+  // Mirrors the planes updated in the current frame into plane_registry_ and
+  // plane_index_ and, with |update_meshes|, re-triangulates their cached
+  // meshes.  Subsumed and stopped planes are dropped from all of them.  Must
+  // run after every ArSession_update, tracking or not, since updates are only
+  // reported once.
+  void ProcessUpdatedPlanes(bool update_meshes);
+
+  // Hands the Streetscape Geometry updated in the current frame to
+  // streetscape_geometry_renderer_, only with kUseStreetscapeGeometry.  Runs
+  // after every ArSession_update, like ProcessUpdatedPlanes().
+  void ProcessUpdatedStreetscapeGeometry();
+
+  // Runs anchor_resolve_scheduler_ for the current frame and adds the
+  // anchors it resolved to anchor_store_, only with kUseGeospatialAnchors.
+  void UpdateGeospatialAnchors();
+
+  // Refreshes the anchors geospatial_anchor_index_ selects for the camera
+  // pose, or those last tracking while |earth| is not.
+  void UpdateGeospatialAnchorIndex(ArEarth* earth);
+
+  // Polls vps_availability_cache_ and checks the cell of the camera while
+  // |earth| is tracking.
+  void UpdateVpsAvailability(ArEarth* earth);
+
+  // Runs cloud_anchor_pipeline_ for the current frame and adds the anchors
+  // it resolved to anchor_store_, only with kUseCloudAnchors.
+  void UpdateCloudAnchors();
+
+  // Makes the anchor of |handle| the one this session's map is saved under,
+  // and starts restoring the map saved under |cloud_anchor_id| if there is
+  // one.
+  void SetSpatialMapAnchor(const std::string& cloud_anchor_id,
+                           AnchorStore::Handle handle);
+
+  // Restores the kSpatialMapChunksPerFrame chunks of spatial_map_restore_
+  // closest to the camera while the map's anchor is tracking.
+  void RestoreSpatialMapChunks();
+
+  // Saves the point map and the volume under spatial_map_anchor_id_.  Must
+  // be called while the OpenGL thread is paused.
+  void SaveSpatialMap();
+
+  // Whether the session should run the Geospatial API, which needs the
+  // ACCESS_FINE_LOCATION permission and an API key in the manifest.
+  bool UsesGeospatialMode(const ArSession* session);
+
+  // Selects a front camera config, which Augmented Faces needs.  Must be
+  // called before the session is first resumed.
+  void UseFrontCamera(ArSession* session);
+
+  // Calls |visit| with every tracking plane that is not subsumed by another
+  // one and returns the number of planes in the session, all from
+  // plane_registry_ without asking ARCore.
+  template <typename PlaneVisitor>
+  int32_t ForEachVisiblePlane(PlaneVisitor visit);
+
+  // Hangs the content drawn at an anchor just added to anchor_store_ off it
+  // in scene_graph_.
+  void AttachAnchorContent(AnchorStore::Handle handle);
+
+  // Refreshes the anchor colors and fills |instances| with the model matrix of
+  // every tracking anchor whose bounds intersect the view frustum and are not
+  // hidden behind depth_pyramid_, grouped by the level of detail picked from
+  // its projected size.  If CullsAnchorsOnGpu(), only the coarse culling by
+  // cell runs and every remaining anchor is put in the first group.  If
+  // DrawsSkinnedAnchors(), the anchors go to |skinned_instances| instead,
+  // each playing a clip at a phase of its own.
+  void CollectAndyInstances(
+      ObjRenderer::LodInstances* instances,
+      std::vector<SkinnedObjRenderer::Instance>* skinned_instances);
+
+  // Draws the instances from CollectAndyInstances(), culling them first if
+  // CullsAnchorsOnGpu(), or samples the animations of |skinned_instances|
+  // and draws those.
+  void DrawAndyInstances(
+      const glm::mat4& projection_mat, const glm::mat4& view_mat,
+      const FrameContext& frame_context,
+      const ObjRenderer::LodInstances& instances,
+      const std::vector<SkinnedObjRenderer::Instance>& skinned_instances);
+
+  // Whether the anchors are drawn by skinned_andy_renderer_, with
+  // kUseSkinnedAnchors once its model loaded.
+  bool DrawsSkinnedAnchors() const;
+
+  // The program of the renderer drawing the anchors.
+  GLuint GetAnchorProgram() const;
+
+  // Whether the anchors are culled and their levels of detail picked by the
+  // compute pass of ObjRenderer::CullAndDrawInstanced().
+  bool CullsAnchorsOnGpu() const;
+
+  // Scales the screen fractions the levels of detail are selected with.
+  float GetLodScreenFractionScale() const;
+
+  // Pooled handles used by the hit tests of one frame.
+  struct HitTestScratch {
+    ArHitResult* candidate = nullptr;
+    ArHitResult* selected = nullptr;
+    ArPose* hit_pose = nullptr;
+  };
+
+  // Takes the events queued since the last call, keeps the touches for
+  // ProcessPendingTouches() and reconfigures the session once if the
+  // settings changed.  Called before ArSession_update on the thread that
+  // updates the session.
+  void ApplyPendingEvents();
+
+  // Hit tests every queued touch against the current frame in one pass.
+  // Called right after the frame context has been updated.
+  void ProcessPendingTouches();
+
+  // Hit tests the current frame and places an anchor at the best hit.
+  void HandleTouch(float x, float y, HitTestScratch* scratch);
+
+  // Places an anchor at the best of |hit_result_list|, e.g. a touch's or a
+  // ray's hits from hit_test_cache_.
+  void PlaceAnchorAtBestHit(const ArHitResultList* hit_result_list,
+                            HitTestScratch* scratch);
+
+  // OnDrawFrame() for the AR update thread mode: draws the latest snapshot,
+  // starting the update thread on first use.
+  void DrawLatestSnapshot(bool depthColorVisualizationEnabled,
+                          bool useDepthForOcclusion);
+
+  // The point cloud passes of DrawFrame() and DrawLatestSnapshot().
+  void DrawPointCloud(const FrameContext& frame_context);
+  void DrawSnapshotPointCloud(const ArFrameSnapshot& snapshot,
+                              const FrameContext& frame_context);
+
+  // Runs the passes added to frame_graph_, each timed as its frame stage.
+  // The passes after the background are drawn into virtual_content_target_
+  // while it is active.
+  void ExecuteFrameGraph();
+
+  // Draws performance_hud_ over the finished frame while it is enabled.
+  void DrawPerformanceHud();
+
+  // Feeds the GPU time of the virtual content to render_scale_governor_ once
+  // per kRenderScaleUpdateInterval and resizes virtual_content_target_ when
+  // the scale changes.  Called on the GL thread every frame.
+  void UpdateRenderScale();
+
+  // Sizes virtual_content_target_ for the surface at |scale|, and the
+  // occlusion mask for the size the objects are drawn at.
+  void SetVirtualContentScale(float scale);
+
+  // Hands |depth_image| to background_mesher_ unless it was fused already.
+  void FuseDepthImage(const FrameContext& frame_context,
+                      const ArImage& depth_image);
+
+  // Uploads the block meshes background_mesher_ finished since the last call.
+  void UpdateTsdfMeshes();
+
+  // Feeds the current depth image from frame_image_cache_ to
+  // background_mesher_, depth_pyramid_ and depth_query_, whichever are used.
+  // Called on the OpenGL thread when ArSession_update runs there.
+  void UpdateDepthConsumers(const FrameContext& frame_context,
+                            bool use_depth_for_occlusion);
+
+  // Acquires the current depth image, with its confidence image in raw depth
+  // mode, or sets both to nullptr and returns false.  The caller owns the
+  // images, which lets snapshots keep them past the next ArSession_update.
+  bool AcquireDepthImages(ArImage** depth_image, ArImage** confidence_image);
+
+  // Rebuilds depth_pyramid_ from |depth_image|, or clears it if the pyramid
+  // is off.
+  void BuildDepthPyramid(const FrameContext& frame_context,
+                         const ArImage* depth_image,
+                         const ArImage* confidence_image,
+                         bool use_depth_for_occlusion);
+
+  // Copies |depth_image| into depth_query_ if it is used.
+  void UpdateDepthQuery(const FrameContext& frame_context,
+                        const ArImage& depth_image,
+                        const ArImage* confidence_image);
+
+  // Surface point under the screen centre as a point cloud point, if
+  // depth_query_ knows it, or else if a ray hits a plane of plane_index_.
+  bool GetSurfaceReticle(const FrameContext& frame_context,
+                         glm::vec4* reticle) const;
+
+  // Uploads the semantic image of the current frame and logs the label
+  // fractions now and then, only with kUseSemantics.
+  void UpdateSemantics();
+
+  // Hands the latest light estimate to environmental_hdr_lighting_ and its
+  // latest cubemap to the Andy renderer, only with kUseEnvironmentalHdr.
+  void UpdateEnvironmentalHdr();
+
+  // Turns the view in frame_context_ and the camera image of the background
+  // by the rotation late_pose_reprojector_ predicts since the frame, with
+  // kUseLatePoseReprojection.  Called right before the frame graph runs.
+  void ApplyLatePose();
+
+  // Moves the view of a snapshot's |context| to where the camera is
+  // predicted to be when the frame is displayed, and the camera image with
+  // it.  Must be called for every snapshot drawn.
+  void PredictSnapshotView(FrameContext* context);
+
+  // The turn late_pose_reprojector_ predicts for the camera of |context|
+  // from its frame to |target_ns|, in the camera's frame.  Returns false
+  // without gyroscope samples for it.
+  bool PredictGyroCameraRotation(const FrameContext& context,
+                                 int64_t target_ns, glm::quat* rotation);
+
+  // Moves the view of |context| as if the camera turned by |rotation| and
+  // moved by |translation| in its frame, and warps the background by the
+  // turn.
+  void CorrectView(const glm::quat& rotation, const glm::vec3& translation,
+                   FrameContext* context);
+
+  // Hands a new depth image to the occlusion shaders and the textures derived
+  // from it for them, after filtering it with temporal_depth_filter_.
+  void UpdateOcclusionDepth(const FrameContext& frame_context,
+                            bool use_depth_for_occlusion);
+
+  // The depth texture the occlusion shaders read: temporal_depth_filter_'s
+  // if it is in use, otherwise depth_texture_.
+  GLuint GetOcclusionDepthTextureId();
+
+  // Reduces the occlusion depth texture into depth_pyramid_texture_ and hands
+  // it to the occlusion shaders, or stops them from using it.
+  void UpdateDepthPyramidTexture(bool use_depth_for_occlusion);
+
+  // Blurs the occlusion depth texture into occlusion_blur_texture_ and hands
+  // it to the occlusion shaders, or stops them from using it.
+  void UpdateOcclusionBlurTexture(bool use_depth_for_occlusion);
+
+  // Draws the current depth texture as a dense point cloud.
+  void DrawDensePointCloud(const FrameContext& frame_context);
+
+  // Runs on the update thread after each ArSession_update.
+  void FillSnapshot(ArFrameSnapshot* snapshot);
 
-  void UpdateAnchorColor(ColoredAnchor* colored_anchor);
+  void UpdateAnchorColor(AnchorStore::Entry* anchor);
 };
 }  // namespace hello_ar
 
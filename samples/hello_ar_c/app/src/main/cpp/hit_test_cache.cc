@@ -0,0 +1,109 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "hit_test_cache.h"
+
+#include <cmath>
+
+#include "arcore_trace.h"
+
+namespace hello_ar {
+
+constexpr int HitTestCache::kMaxEntries;
+constexpr float HitTestCache::kPixelStep;
+constexpr float HitTestCache::kOriginStep;
+constexpr float HitTestCache::kDirectionStep;
+constexpr float HitTestCache::kDistanceStep;
+
+namespace {
+int32_t Quantize(float value, float step) {
+  return static_cast<int32_t>(std::lround(value / step));
+}
+}  // namespace
+
+void HitTestCache::BeginFrame(const ArSession* session, const ArFrame* frame,
+                              ArObjectPool* pool) {
+  session_ = session;
+  frame_ = frame;
+  pool_ = pool;
+  entry_count_ = 0;
+  query_count_ = 0;
+  call_count_ = 0;
+}
+
+const ArHitResultList* HitTestCache::Find(const Key& key,
+                                          ArHitResultList** hit_result_list) {
+  ++query_count_;
+  for (int i = 0; i < entry_count_; ++i) {
+    if (entries_[i].key == key) {
+      return entries_[i].hit_result_list;
+    }
+  }
+  ++call_count_;
+  *hit_result_list = pool_->AcquireHitResultList();
+  if (entry_count_ < kMaxEntries) {
+    entries_[entry_count_++] = {key, *hit_result_list};
+  }
+  return nullptr;
+}
+
+const ArHitResultList* HitTestCache::HitTest(float x, float y) {
+  const Key key = {Kind::kScreen,
+                   {Quantize(x, kPixelStep), Quantize(y, kPixelStep)}};
+  ArHitResultList* hit_result_list = nullptr;
+  if (const ArHitResultList* cached = Find(key, &hit_result_list)) {
+    return cached;
+  }
+  traced::ArFrame_hitTest(session_, frame_, x, y, hit_result_list);
+  return hit_result_list;
+}
+
+const ArHitResultList* HitTestCache::HitTestInstantPlacement(
+    float x, float y, float approximate_distance_meters) {
+  const Key key = {Kind::kInstantPlacement,
+                   {Quantize(x, kPixelStep), Quantize(y, kPixelStep),
+                    Quantize(approximate_distance_meters, kDistanceStep)}};
+  ArHitResultList* hit_result_list = nullptr;
+  if (const ArHitResultList* cached = Find(key, &hit_result_list)) {
+    return cached;
+  }
+  traced::ArFrame_hitTestInstantPlacement(session_, frame_, x, y,
+                                          approximate_distance_meters,
+                                          hit_result_list);
+  return hit_result_list;
+}
+
+const ArHitResultList* HitTestCache::HitTestRay(const glm::vec3& origin,
+                                                const glm::vec3& direction) {
+  const glm::vec3 unit_direction = glm::normalize(direction);
+  const Key key = {Kind::kRay,
+                   {Quantize(origin.x, kOriginStep),
+                    Quantize(origin.y, kOriginStep),
+                    Quantize(origin.z, kOriginStep),
+                    Quantize(unit_direction.x, kDirectionStep),
+                    Quantize(unit_direction.y, kDirectionStep),
+                    Quantize(unit_direction.z, kDirectionStep)}};
+  ArHitResultList* hit_result_list = nullptr;
+  if (const ArHitResultList* cached = Find(key, &hit_result_list)) {
+    return cached;
+  }
+  // The first query of a key is issued with its own, unquantized ray.
+  traced::ArFrame_hitTestRay(session_, frame_, glm::value_ptr(origin),
+                             glm::value_ptr(unit_direction), hit_result_list);
+  return hit_result_list;
+}
+
+}  // namespace hello_ar
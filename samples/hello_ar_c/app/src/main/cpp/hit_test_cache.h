@@ -0,0 +1,111 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_HIT_TEST_CACHE_H_
+#define C_ARCORE_HELLOE_AR_HIT_TEST_CACHE_H_
+
+#include <array>
+#include <cstdint>
+
+#include "ar_object_pool.h"
+#include "arcore_c_api.h"
+#include "glm.h"
+
+namespace hello_ar {
+
+// Hit tests of the current frame from screen points or from arbitrary rays,
+// e.g. of a controller, shared by everything that asks in the same frame.
+//
+// Each query is keyed by its kind and its quantized inputs: screen points to
+// kPixelStep pixels, ray origins to kOriginStep meters and ray directions,
+// once normalized, to kDirectionStep.  A query that matches an earlier one
+// of the frame returns that query's result list instead of calling ARCore
+// again.  Lists come from the ArObjectPool and are only valid until the
+// next BeginFrame(), as are the counts.  Once kMaxEntries results are cached,
+// further queries still call ARCore but are not remembered.
+//
+// ArFrame_hitTestRay() never returns instant placement points, so rays only
+// hit what ARCore tracks already.
+//
+// Not thread safe; must be used on the thread that updates the session.
+class HitTestCache {
+ public:
+  static constexpr int kMaxEntries = 16;
+  static constexpr float kPixelStep = 1.f;
+  static constexpr float kOriginStep = 0.001f;
+  static constexpr float kDirectionStep = 1.f / 1024.f;
+  static constexpr float kDistanceStep = 0.01f;
+
+  HitTestCache() = default;
+
+  HitTestCache(const HitTestCache&) = delete;
+  HitTestCache& operator=(const HitTestCache&) = delete;
+
+  // Forgets the results of the previous frame.  Must be called after
+  // ArSession_update and before the pool's next BeginFrame().
+  void BeginFrame(const ArSession* session, const ArFrame* frame,
+                  ArObjectPool* pool);
+
+  // ArFrame_hitTest() at the screen point (|x|, |y|).
+  const ArHitResultList* HitTest(float x, float y);
+
+  // ArFrame_hitTestInstantPlacement() at the screen point (|x|, |y|).
+  const ArHitResultList* HitTestInstantPlacement(
+      float x, float y, float approximate_distance_meters);
+
+  // ArFrame_hitTestRay() along |direction| from |origin|, both in world
+  // space.  |direction| need not be normalized.
+  const ArHitResultList* HitTestRay(const glm::vec3& origin,
+                                    const glm::vec3& direction);
+
+  // Queries and ARCore hit test calls since BeginFrame().
+  int GetQueryCount() const { return query_count_; }
+  int GetCallCount() const { return call_count_; }
+
+ private:
+  enum class Kind : int32_t { kScreen, kInstantPlacement, kRay };
+
+  struct Key {
+    Kind kind;
+    std::array<int32_t, 6> values;
+
+    bool operator==(const Key& other) const {
+      return kind == other.kind && values == other.values;
+    }
+  };
+
+  struct Entry {
+    Key key;
+    ArHitResultList* hit_result_list;
+  };
+
+  // The cached list for |key|, or nullptr after acquiring an empty one into
+  // |*hit_result_list| that the caller must fill.
+  const ArHitResultList* Find(const Key& key,
+                              ArHitResultList** hit_result_list);
+
+  const ArSession* session_ = nullptr;
+  const ArFrame* frame_ = nullptr;
+  ArObjectPool* pool_ = nullptr;
+  std::array<Entry, kMaxEntries> entries_;
+  int entry_count_ = 0;
+  int query_count_ = 0;
+  int call_count_ = 0;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_HIT_TEST_CACHE_H_
@@ -14,22 +14,42 @@
  * limitations under the License.
  */
 
+#include <android/api-level.h>
 #include <android/asset_manager.h>
 #include <android/asset_manager_jni.h>
+#include <android/native_window_jni.h>
 #include <jni.h>
 
+#include <memory>
+
 #include "hello_ar_application.h"
+#include "jni_interface.h"
+#include "math_benchmark.h"
+#include "resource_accounting.h"
+#include "util.h"
 
-#define JNI_METHOD(return_type, method_name) \
-  JNIEXPORT return_type JNICALL              \
-      Java_com_google_ar_core_examples_c_helloar_JniInterface_##method_name
+// The natives are registered with RegisterNatives() in JNI_OnLoad, so they
+// need neither exported nor mangled names.
+#define JNI_METHOD(return_type, method_name) return_type JNICALL method_name
 
-extern "C" {
+#define NATIVE_METHOD(method_name, signature) \
+  { #method_name, signature, reinterpret_cast<void *>(method_name) }
 
 namespace {
 // maintain a reference to the JVM so we can use it later.
 static JavaVM *g_vm = nullptr;
 
+// The JNIEnv of the current thread, so that GetJniEnv() only goes through
+// the JVM on a thread's first call.
+thread_local JNIEnv *t_env = nullptr;
+
+constexpr char kJniInterfaceClassName[] =
+    "com/google/ar/core/examples/c/helloar/JniInterface";
+
+// Android 8.0 is the first to honor @CriticalNative.  Older versions call
+// the methods with the JNIEnv and class like any other native.
+constexpr int kCriticalNativeApiLevel = 26;
+
 inline jlong jptr(hello_ar::HelloArApplication *native_hello_ar_application) {
   return reinterpret_cast<intptr_t>(native_hello_ar_application);
 }
@@ -38,17 +58,38 @@ inline hello_ar::HelloArApplication *native(jlong ptr) {
   return reinterpret_cast<hello_ar::HelloArApplication *>(ptr);
 }
 
-}  // namespace
-
-jint JNI_OnLoad(JavaVM *vm, void *) {
-  g_vm = vm;
-  return JNI_VERSION_1_6;
+// Flattens |summaries| into min, avg and p95 in ms and the sample count of
+// every stage.
+jfloatArray ToJavaStageStats(
+    JNIEnv *env, const std::array<hello_ar::FrameStageTimers::Summary,
+                                  hello_ar::kNumFrameStages> &summaries) {
+  constexpr int kValuesPerStage = 4;
+  jfloat values[hello_ar::kNumFrameStages * kValuesPerStage];
+  for (int i = 0; i < hello_ar::kNumFrameStages; ++i) {
+    values[i * kValuesPerStage + 0] = summaries[i].min_ms;
+    values[i * kValuesPerStage + 1] = summaries[i].avg_ms;
+    values[i * kValuesPerStage + 2] = summaries[i].p95_ms;
+    values[i * kValuesPerStage + 3] =
+        static_cast<jfloat>(summaries[i].sample_count);
+  }
+  jfloatArray result = env->NewFloatArray(hello_ar::kNumFrameStages *
+                                          kValuesPerStage);
+  if (result != nullptr) {
+    env->SetFloatArrayRegion(result, 0,
+                             hello_ar::kNumFrameStages * kValuesPerStage,
+                             values);
+  }
+  return result;
 }
 
 JNI_METHOD(jlong, createNativeApplication)
-(JNIEnv *env, jclass, jobject j_asset_manager) {
+(JNIEnv *env, jclass, jobject j_asset_manager, jstring j_cache_dir) {
   AAssetManager *asset_manager = AAssetManager_fromJava(env, j_asset_manager);
-  return jptr(new hello_ar::HelloArApplication(asset_manager));
+  const char *cache_dir = env->GetStringUTFChars(j_cache_dir, nullptr);
+  hello_ar::HelloArApplication *application =
+      new hello_ar::HelloArApplication(asset_manager, cache_dir);
+  env->ReleaseStringUTFChars(j_cache_dir, cache_dir);
+  return jptr(application);
 }
 
 JNI_METHOD(jboolean, isDepthSupported)
@@ -62,6 +103,81 @@ JNI_METHOD(void, onSettingsChange)
   native(native_application)->OnSettingsChange(is_instant_placement_enabled);
 }
 
+// The @CriticalNative methods get neither the JNIEnv nor the class, so
+// they must not call back into Java, and as the thread cannot be suspended
+// for the garbage collector meanwhile, they must return right away.
+jfloat JNICALL CriticalGetRenderScale(jlong native_application) {
+  return native(native_application)->GetRenderScale();
+}
+
+JNI_METHOD(jfloat, getRenderScale)
+(JNIEnv *, jclass, jlong native_application) {
+  return CriticalGetRenderScale(native_application);
+}
+
+JNI_METHOD(jboolean, rendersAtDisplayRate)
+(JNIEnv *, jclass) {
+  return hello_ar::HelloArApplication::RendersAtDisplayRate();
+}
+
+JNI_METHOD(jboolean, usesNativeFrameLoop)
+(JNIEnv *, jclass) {
+  return hello_ar::HelloArApplication::UsesNativeFrameLoop();
+}
+
+JNI_METHOD(void, onNativeWindowChanged)
+(JNIEnv *env, jclass, jlong native_application, jobject surface,
+ jint display_rotation, jint width, jint height) {
+  ANativeWindow *window =
+      surface != nullptr ? ANativeWindow_fromSurface(env, surface) : nullptr;
+  native(native_application)
+      ->OnNativeWindowChanged(window, display_rotation, width, height);
+}
+
+JNI_METHOD(void, setFrameLoopDepthSettings)
+(JNIEnv *, jclass, jlong native_application,
+ jboolean depth_color_visualization_enabled, jboolean use_depth_for_occlusion) {
+  native(native_application)
+      ->SetFrameLoopDepthSettings(depth_color_visualization_enabled,
+                                  use_depth_for_occlusion);
+}
+
+JNI_METHOD(void, postToFrameLoop)
+(JNIEnv *env, jclass, jlong native_application, jobject runnable) {
+  jclass runnable_class = env->GetObjectClass(runnable);
+  const jmethodID run_method = env->GetMethodID(runnable_class, "run", "()V");
+  env->DeleteLocalRef(runnable_class);
+  // Shared, since the task is copyable, and released on whichever thread
+  // drops it.
+  const std::shared_ptr<_jobject> global_runnable(
+      env->NewGlobalRef(runnable),
+      [](jobject ref) { GetJniEnv()->DeleteGlobalRef(ref); });
+  native(native_application)->PostToFrameLoop([global_runnable, run_method] {
+    JNIEnv *loop_env = GetJniEnv();
+    loop_env->CallVoidMethod(global_runnable.get(), run_method);
+    if (loop_env->ExceptionCheck()) {
+      loop_env->ExceptionDescribe();
+      loop_env->ExceptionClear();
+    }
+  });
+}
+
+JNI_METHOD(void, setPerformanceHudEnabled)
+(JNIEnv *, jclass, jlong native_application, jboolean enabled) {
+  native(native_application)->SetPerformanceHudEnabled(enabled);
+}
+
+JNI_METHOD(jstring, getResourceReport)
+(JNIEnv *env, jclass) {
+  return env->NewStringUTF(
+      hello_ar::ResourceAccounting::Get().GetReport().c_str());
+}
+
+JNI_METHOD(jstring, runMathBenchmark)
+(JNIEnv *env, jclass) {
+  return env->NewStringUTF(hello_ar::RunMathBenchmark().c_str());
+}
+
 JNI_METHOD(void, destroyNativeApplication)
 (JNIEnv *, jclass, jlong native_application) {
   delete native(native_application);
@@ -94,24 +210,343 @@ JNI_METHOD(void, onGlSurfaceDrawFrame)
 (JNIEnv *, jclass, jlong native_application,
  jboolean depth_color_visualization_enabled, jboolean use_depth_for_occlusion) {
   native(native_application)
-      ->OnDrawFrame(depth_color_visualization_enabled, use_depth_for_occlusion);
+      ->OnDrawFrame(depth_color_visualization_enabled, use_depth_for_occlusion,
+                    /*can_skip_frame=*/false);
+}
+
+void JNICALL CriticalOnTouched(jlong native_application, jfloat x, jfloat y) {
+  native(native_application)->OnTouched(x, y);
 }
 
 JNI_METHOD(void, onTouched)
 (JNIEnv *, jclass, jlong native_application, jfloat x, jfloat y) {
-  native(native_application)->OnTouched(x, y);
+  CriticalOnTouched(native_application, x, y);
+}
+
+JNI_METHOD(void, resolveGeospatialAnchor)
+(JNIEnv *, jclass, jlong native_application, jboolean on_rooftop,
+ jdouble latitude, jdouble longitude, jdouble altitude, jfloat heading) {
+  native(native_application)
+      ->ResolveGeospatialAnchor(on_rooftop, latitude, longitude, altitude,
+                                heading);
+}
+
+JNI_METHOD(void, resolveCloudAnchor)
+(JNIEnv *env, jclass, jlong native_application, jstring j_cloud_anchor_id) {
+  const char *cloud_anchor_id =
+      env->GetStringUTFChars(j_cloud_anchor_id, nullptr);
+  native(native_application)->ResolveCloudAnchor(cloud_anchor_id);
+  env->ReleaseStringUTFChars(j_cloud_anchor_id, cloud_anchor_id);
+}
+
+JNI_METHOD(jstring, getCloudAnchorReport)
+(JNIEnv *env, jclass, jlong native_application) {
+  return env->NewStringUTF(
+      native(native_application)->GetCloudAnchorReport().c_str());
+}
+
+jboolean JNICALL CriticalHasDetectedPlanes(jlong native_application) {
+  return static_cast<jboolean>(
+      native(native_application)->HasDetectedPlanes() ? JNI_TRUE : JNI_FALSE);
 }
 
 JNI_METHOD(jboolean, hasDetectedPlanes)
+(JNIEnv *, jclass, jlong native_application) {
+  return CriticalHasDetectedPlanes(native_application);
+}
+
+JNI_METHOD(jboolean, startPlaybackBenchmark)
+(JNIEnv *env, jclass, jlong native_application, jstring j_dataset_uri,
+ jstring j_csv_path) {
+  const char *dataset_uri = env->GetStringUTFChars(j_dataset_uri, nullptr);
+  const char *csv_path = env->GetStringUTFChars(j_csv_path, nullptr);
+  const bool started = native(native_application)
+                           ->StartPlaybackBenchmark(dataset_uri, csv_path);
+  env->ReleaseStringUTFChars(j_csv_path, csv_path);
+  env->ReleaseStringUTFChars(j_dataset_uri, dataset_uri);
+  return static_cast<jboolean>(started ? JNI_TRUE : JNI_FALSE);
+}
+
+JNI_METHOD(jboolean, isPlaybackBenchmarkFinished)
 (JNIEnv *, jclass, jlong native_application) {
   return static_cast<jboolean>(
-      native(native_application)->HasDetectedPlanes() ? JNI_TRUE : JNI_FALSE);
+      native(native_application)->IsPlaybackBenchmarkFinished() ? JNI_TRUE
+                                                                : JNI_FALSE);
+}
+
+JNI_METHOD(jboolean, startArCoreApiProfiler)
+(JNIEnv *env, jclass, jlong native_application, jstring j_report_path,
+ jstring j_arcore_version) {
+  const char *report_path = env->GetStringUTFChars(j_report_path, nullptr);
+  const char *arcore_version =
+      env->GetStringUTFChars(j_arcore_version, nullptr);
+  const bool started =
+      native(native_application)
+          ->StartArCoreApiProfiler(report_path, arcore_version);
+  env->ReleaseStringUTFChars(j_arcore_version, arcore_version);
+  env->ReleaseStringUTFChars(j_report_path, report_path);
+  return static_cast<jboolean>(started ? JNI_TRUE : JNI_FALSE);
+}
+
+JNI_METHOD(jboolean, startCameraTextureBenchmark)
+(JNIEnv *env, jclass, jlong native_application, jstring j_dataset_uri,
+ jstring j_report_path) {
+  const char *dataset_uri = env->GetStringUTFChars(j_dataset_uri, nullptr);
+  const char *report_path = env->GetStringUTFChars(j_report_path, nullptr);
+  const bool started =
+      native(native_application)
+          ->StartCameraTextureBenchmark(dataset_uri, report_path);
+  env->ReleaseStringUTFChars(j_report_path, report_path);
+  env->ReleaseStringUTFChars(j_dataset_uri, dataset_uri);
+  return static_cast<jboolean>(started ? JNI_TRUE : JNI_FALSE);
+}
+
+JNI_METHOD(void, setCameraTextureMode)
+(JNIEnv *, jclass, jlong native_application, jint mode) {
+  if (mode < 0 || mode >= hello_ar::kNumCameraTextureModes) {
+    LOGE("No camera texture mode %d", mode);
+    return;
+  }
+  native(native_application)
+      ->SetCameraTextureMode(static_cast<hello_ar::CameraTextureMode>(mode));
+}
+
+JNI_METHOD(jboolean, startCapture)
+(JNIEnv *env, jclass, jlong native_application, jstring j_video_path,
+ jstring j_dataset_uri) {
+  const char *video_path = env->GetStringUTFChars(j_video_path, nullptr);
+  std::string dataset_uri;
+  if (j_dataset_uri != nullptr) {
+    const char *uri = env->GetStringUTFChars(j_dataset_uri, nullptr);
+    dataset_uri = uri;
+    env->ReleaseStringUTFChars(j_dataset_uri, uri);
+  }
+  const bool started =
+      native(native_application)->StartCapture(video_path, dataset_uri);
+  env->ReleaseStringUTFChars(j_video_path, video_path);
+  return static_cast<jboolean>(started ? JNI_TRUE : JNI_FALSE);
+}
+
+JNI_METHOD(void, stopCapture)
+(JNIEnv *, jclass, jlong native_application) {
+  native(native_application)->StopCapture();
+}
+
+JNI_METHOD(jboolean, startDatasetRecording)
+(JNIEnv *env, jclass, jlong native_application, jstring j_dataset_uri) {
+  const char *dataset_uri = env->GetStringUTFChars(j_dataset_uri, nullptr);
+  const bool started =
+      native(native_application)->StartDatasetRecording(dataset_uri);
+  env->ReleaseStringUTFChars(j_dataset_uri, dataset_uri);
+  return static_cast<jboolean>(started ? JNI_TRUE : JNI_FALSE);
+}
+
+JNI_METHOD(jboolean, stopDatasetRecording)
+(JNIEnv *, jclass, jlong native_application) {
+  return static_cast<jboolean>(
+      native(native_application)->StopDatasetRecording() ? JNI_TRUE
+                                                         : JNI_FALSE);
+}
+
+JNI_METHOD(jboolean, recordDatasetMarker)
+(JNIEnv *env, jclass, jlong native_application, jstring j_marker) {
+  const char *marker = env->GetStringUTFChars(j_marker, nullptr);
+  const bool queued = native(native_application)->RecordDatasetMarker(marker);
+  env->ReleaseStringUTFChars(j_marker, marker);
+  return static_cast<jboolean>(queued ? JNI_TRUE : JNI_FALSE);
+}
+
+JNI_METHOD(jstring, getDatasetRecordingReport)
+(JNIEnv *env, jclass, jlong native_application) {
+  return env->NewStringUTF(
+      native(native_application)->GetDatasetRecordingReport().c_str());
+}
+
+JNI_METHOD(jboolean, startTelemetryLog)
+(JNIEnv *env, jclass, jlong native_application, jstring j_path) {
+  const char *path = env->GetStringUTFChars(j_path, nullptr);
+  const bool started = native(native_application)->StartTelemetryLog(path);
+  env->ReleaseStringUTFChars(j_path, path);
+  return started;
+}
+
+JNI_METHOD(void, stopTelemetryLog)
+(JNIEnv *, jclass, jlong native_application) {
+  native(native_application)->StopTelemetryLog();
+}
+
+JNI_METHOD(jboolean, startStateCapture)
+(JNIEnv *env, jclass, jlong native_application, jstring j_path) {
+  const char *path = env->GetStringUTFChars(j_path, nullptr);
+  const bool started = native(native_application)->StartStateCapture(path);
+  env->ReleaseStringUTFChars(j_path, path);
+  return started;
+}
+
+JNI_METHOD(void, stopStateCapture)
+(JNIEnv *, jclass, jlong native_application) {
+  native(native_application)->StopStateCapture();
+}
+
+JNI_METHOD(void, captureScreenshot)
+(JNIEnv *env, jclass, jlong native_application, jstring j_path) {
+  const char *path = env->GetStringUTFChars(j_path, nullptr);
+  native(native_application)->CaptureScreenshot(path);
+  env->ReleaseStringUTFChars(j_path, path);
+}
+
+JNI_METHOD(jfloatArray, getFrameStageStats)
+(JNIEnv *env, jclass, jlong native_application) {
+  return ToJavaStageStats(
+      env, native(native_application)->GetFrameStageSummaries());
+}
+
+JNI_METHOD(jfloatArray, getGpuFrameStageStats)
+(JNIEnv *env, jclass, jlong native_application) {
+  return ToJavaStageStats(
+      env, native(native_application)->GetGpuFrameStageSummaries());
+}
+
+JNI_METHOD(jintArray, getAnchorCullingStats)
+(JNIEnv *env, jclass, jlong native_application) {
+  const hello_ar::HelloArApplication *application = native(native_application);
+  const jint values[2] = {application->GetAnchorsDrawnLastFrame(),
+                          application->GetAnchorsCulledLastFrame()};
+  jintArray result = env->NewIntArray(2);
+  if (result != nullptr) {
+    env->SetIntArrayRegion(result, 0, 2, values);
+  }
+  return result;
+}
+
+JNI_METHOD(jfloat, getDepthUploadsPerSecond)
+(JNIEnv *, jclass, jlong native_application) {
+  return native(native_application)->GetDepthUploadsPerSecond();
+}
+
+JNI_METHOD(jobject, getUiStateBuffer)
+(JNIEnv *env, jclass, jlong native_application) {
+  hello_ar::UiStateChannel *channel =
+      native(native_application)->GetUiStateChannel();
+  return env->NewDirectByteBuffer(channel->GetData(), channel->GetSize());
+}
+
+const JNINativeMethod kNativeMethods[] = {
+    NATIVE_METHOD(createNativeApplication,
+                  "(Landroid/content/res/AssetManager;Ljava/lang/String;)J"),
+    NATIVE_METHOD(isDepthSupported, "(J)Z"),
+    NATIVE_METHOD(onSettingsChange, "(JZ)V"),
+    NATIVE_METHOD(rendersAtDisplayRate, "()Z"),
+    NATIVE_METHOD(usesNativeFrameLoop, "()Z"),
+    NATIVE_METHOD(onNativeWindowChanged, "(JLandroid/view/Surface;III)V"),
+    NATIVE_METHOD(setFrameLoopDepthSettings, "(JZZ)V"),
+    NATIVE_METHOD(postToFrameLoop, "(JLjava/lang/Runnable;)V"),
+    NATIVE_METHOD(setPerformanceHudEnabled, "(JZ)V"),
+    NATIVE_METHOD(getResourceReport, "()Ljava/lang/String;"),
+    NATIVE_METHOD(runMathBenchmark, "()Ljava/lang/String;"),
+    NATIVE_METHOD(destroyNativeApplication, "(J)V"),
+    NATIVE_METHOD(onPause, "(J)V"),
+    NATIVE_METHOD(onResume,
+                  "(JLandroid/content/Context;Landroid/app/Activity;)V"),
+    NATIVE_METHOD(onGlSurfaceCreated, "(J)V"),
+    NATIVE_METHOD(onDisplayGeometryChanged, "(JIII)V"),
+    NATIVE_METHOD(onGlSurfaceDrawFrame, "(JZZ)V"),
+    NATIVE_METHOD(resolveGeospatialAnchor, "(JZDDDF)V"),
+    NATIVE_METHOD(resolveCloudAnchor, "(JLjava/lang/String;)V"),
+    NATIVE_METHOD(getCloudAnchorReport, "(J)Ljava/lang/String;"),
+    NATIVE_METHOD(startPlaybackBenchmark,
+                  "(JLjava/lang/String;Ljava/lang/String;)Z"),
+    NATIVE_METHOD(isPlaybackBenchmarkFinished, "(J)Z"),
+    NATIVE_METHOD(startCameraTextureBenchmark,
+                  "(JLjava/lang/String;Ljava/lang/String;)Z"),
+    NATIVE_METHOD(setCameraTextureMode, "(JI)V"),
+    NATIVE_METHOD(startArCoreApiProfiler,
+                  "(JLjava/lang/String;Ljava/lang/String;)Z"),
+    NATIVE_METHOD(startCapture, "(JLjava/lang/String;Ljava/lang/String;)Z"),
+    NATIVE_METHOD(stopCapture, "(J)V"),
+    NATIVE_METHOD(startDatasetRecording, "(JLjava/lang/String;)Z"),
+    NATIVE_METHOD(stopDatasetRecording, "(J)Z"),
+    NATIVE_METHOD(recordDatasetMarker, "(JLjava/lang/String;)Z"),
+    NATIVE_METHOD(getDatasetRecordingReport, "(J)Ljava/lang/String;"),
+    NATIVE_METHOD(startTelemetryLog, "(JLjava/lang/String;)Z"),
+    NATIVE_METHOD(stopTelemetryLog, "(J)V"),
+    NATIVE_METHOD(startStateCapture, "(JLjava/lang/String;)Z"),
+    NATIVE_METHOD(stopStateCapture, "(J)V"),
+    NATIVE_METHOD(captureScreenshot, "(JLjava/lang/String;)V"),
+    NATIVE_METHOD(getFrameStageStats, "(J)[F"),
+    NATIVE_METHOD(getGpuFrameStageStats, "(J)[F"),
+    NATIVE_METHOD(getAnchorCullingStats, "(J)[I"),
+    NATIVE_METHOD(getDepthUploadsPerSecond, "(J)F"),
+    NATIVE_METHOD(getUiStateBuffer, "(J)Ljava/nio/ByteBuffer;"),
+};
+
+// The methods annotated with @CriticalNative, called on the UI thread or
+// every frame, and their fallbacks for older Android versions.
+const JNINativeMethod kCriticalNativeMethods[] = {
+    {"getRenderScale", "(J)F",
+     reinterpret_cast<void *>(CriticalGetRenderScale)},
+    {"onTouched", "(JFF)V", reinterpret_cast<void *>(CriticalOnTouched)},
+    {"hasDetectedPlanes", "(J)Z",
+     reinterpret_cast<void *>(CriticalHasDetectedPlanes)},
+};
+const JNINativeMethod kCriticalNativeFallbackMethods[] = {
+    NATIVE_METHOD(getRenderScale, "(J)F"),
+    NATIVE_METHOD(onTouched, "(JFF)V"),
+    NATIVE_METHOD(hasDetectedPlanes, "(J)Z"),
+};
+static_assert(sizeof(kCriticalNativeMethods) ==
+                  sizeof(kCriticalNativeFallbackMethods),
+              "every @CriticalNative method needs a fallback");
+
+}  // namespace
+
+extern "C" {
+
+jint JNI_OnLoad(JavaVM *vm, void *) {
+  g_vm = vm;
+  JNIEnv *env = nullptr;
+  if (vm->GetEnv(reinterpret_cast<void **>(&env), JNI_VERSION_1_6) != JNI_OK) {
+    return JNI_ERR;
+  }
+  jclass jni_interface = env->FindClass(kJniInterfaceClassName);
+  if (jni_interface == nullptr) {
+    LOGE("JNI_OnLoad: cannot find %s", kJniInterfaceClassName);
+    return JNI_ERR;
+  }
+  const bool critical_natives =
+      android_get_device_api_level() >= kCriticalNativeApiLevel;
+  const JNINativeMethod *critical_methods =
+      critical_natives ? kCriticalNativeMethods
+                       : kCriticalNativeFallbackMethods;
+  const jint result =
+      env->RegisterNatives(jni_interface, kNativeMethods,
+                           sizeof(kNativeMethods) / sizeof(kNativeMethods[0]));
+  const jint critical_result = env->RegisterNatives(
+      jni_interface, critical_methods,
+      sizeof(kCriticalNativeMethods) / sizeof(kCriticalNativeMethods[0]));
+  env->DeleteLocalRef(jni_interface);
+  if (result != JNI_OK || critical_result != JNI_OK) {
+    LOGE("JNI_OnLoad: cannot register the natives of %s",
+         kJniInterfaceClassName);
+    return JNI_ERR;
+  }
+  return JNI_VERSION_1_6;
 }
 
 JNIEnv *GetJniEnv() {
-  JNIEnv *env;
-  jint result = g_vm->AttachCurrentThread(&env, nullptr);
-  return result == JNI_OK ? env : nullptr;
+  if (t_env == nullptr) {
+    JNIEnv *env = nullptr;
+    if (g_vm->AttachCurrentThread(&env, nullptr) != JNI_OK) {
+      return nullptr;
+    }
+    t_env = env;
+  }
+  return t_env;
+}
+
+void DetachJniEnv() {
+  t_env = nullptr;
+  g_vm->DetachCurrentThread();
 }
 
 jclass FindClass(const char *classname) {
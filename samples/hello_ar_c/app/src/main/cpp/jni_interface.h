@@ -24,11 +24,16 @@
 extern "C" {
 
 // Helper function used to access the jni environment on the current thread.
+// The environment is cached per thread, so only the first call attaches.
 // In this sample, no consideration is made for detaching the thread when the
 // thread exits. This can cause memory leaks, so production applications should
 // detach when the thread no longer needs access to the JVM.
 JNIEnv *GetJniEnv();
 
+// Detaches the current thread from the JVM.  Native threads that called
+// GetJniEnv() must call this before they exit.
+void DetachJniEnv();
+
 jclass FindClass(const char *classname);
 }  // extern "C"
 #endif
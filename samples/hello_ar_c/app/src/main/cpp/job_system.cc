@@ -0,0 +1,404 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "job_system.h"
+
+#include <sched.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <utility>
+
+#include "jni_interface.h"
+#include "util.h"
+
+namespace hello_ar {
+namespace util {
+namespace {
+// The job system and worker index of the calling thread, if it is a worker.
+thread_local const JobSystem* tls_job_system = nullptr;
+thread_local int tls_worker_index = -1;
+
+// Returns the maximum frequency of |cpu| in kHz, or 0 if it is unknown.
+int64_t GetCpuMaxFrequency(int cpu) {
+  const std::string path = "/sys/devices/system/cpu/cpu" +
+                           std::to_string(cpu) + "/cpufreq/cpuinfo_max_freq";
+  FILE* file = fopen(path.c_str(), "r");
+  if (file == nullptr) {
+    return 0;
+  }
+  long long frequency = 0;
+  if (fscanf(file, "%lld", &frequency) != 1) {
+    frequency = 0;
+  }
+  fclose(file);
+  return frequency;
+}
+
+// Every core but those of the slowest cluster counts as a big core.  Returns
+// all cores if they cannot be told apart.
+std::vector<int> GetBigCores() {
+  const int num_cores =
+      std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  std::vector<int64_t> frequencies;
+  for (int cpu = 0; cpu < num_cores; ++cpu) {
+    frequencies.push_back(GetCpuMaxFrequency(cpu));
+  }
+  const int64_t slowest =
+      *std::min_element(frequencies.begin(), frequencies.end());
+  std::vector<int> big_cores;
+  for (int cpu = 0; cpu < num_cores; ++cpu) {
+    if (frequencies[cpu] > slowest) {
+      big_cores.push_back(cpu);
+    }
+  }
+  if (slowest == 0 || big_cores.empty()) {
+    big_cores.clear();
+    for (int cpu = 0; cpu < num_cores; ++cpu) {
+      big_cores.push_back(cpu);
+    }
+  }
+  return big_cores;
+}
+
+void PinCurrentThread(const std::vector<int>& cpus) {
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (int cpu : cpus) {
+    CPU_SET(cpu, &cpu_set);
+  }
+  // Only a hint; the thread keeps running wherever the kernel allows.
+  if (sched_setaffinity(0, sizeof(cpu_set), &cpu_set) != 0) {
+    LOGE("JobSystem: could not pin a worker to the big cores");
+  }
+}
+}  // namespace
+
+constexpr int64_t JobSystem::WorkDeque::kCapacity;
+constexpr size_t JobSystem::InjectionQueue::kCapacity;
+
+bool JobSystem::WorkDeque::Push(QueuedJob* job) {
+  const int64_t bottom = bottom_.load(std::memory_order_relaxed);
+  const int64_t top = top_.load(std::memory_order_acquire);
+  if (bottom - top >= kCapacity) {
+    return false;
+  }
+  slots_[bottom & (kCapacity - 1)].store(job, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  bottom_.store(bottom + 1, std::memory_order_relaxed);
+  return true;
+}
+
+JobSystem::QueuedJob* JobSystem::WorkDeque::Take() {
+  const int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+  bottom_.store(bottom, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int64_t top = top_.load(std::memory_order_relaxed);
+  if (top > bottom) {
+    bottom_.store(bottom + 1, std::memory_order_relaxed);
+    return nullptr;
+  }
+  QueuedJob* job =
+      slots_[bottom & (kCapacity - 1)].load(std::memory_order_relaxed);
+  if (top == bottom) {
+    // The last job, which a thief may be taking at the same time.
+    if (!top_.compare_exchange_strong(top, top + 1,
+                                      std::memory_order_seq_cst,
+                                      std::memory_order_relaxed)) {
+      job = nullptr;
+    }
+    bottom_.store(bottom + 1, std::memory_order_relaxed);
+  }
+  return job;
+}
+
+JobSystem::QueuedJob* JobSystem::WorkDeque::Steal() {
+  int64_t top = top_.load(std::memory_order_acquire);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  const int64_t bottom = bottom_.load(std::memory_order_acquire);
+  if (top >= bottom) {
+    return nullptr;
+  }
+  QueuedJob* job =
+      slots_[top & (kCapacity - 1)].load(std::memory_order_relaxed);
+  if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                    std::memory_order_relaxed)) {
+    // Lost to the owner or another thief.
+    return nullptr;
+  }
+  return job;
+}
+
+JobSystem::InjectionQueue::InjectionQueue() {
+  for (size_t i = 0; i < kCapacity; ++i) {
+    cells_[i].sequence.store(i, std::memory_order_relaxed);
+    cells_[i].job = nullptr;
+  }
+}
+
+bool JobSystem::InjectionQueue::Push(QueuedJob* job) {
+  size_t position = enqueue_position_.load(std::memory_order_relaxed);
+  Cell* cell = nullptr;
+  while (true) {
+    cell = &cells_[position & (kCapacity - 1)];
+    const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+    const intptr_t difference =
+        static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+    if (difference == 0) {
+      if (enqueue_position_.compare_exchange_weak(
+              position, position + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (difference < 0) {
+      return false;
+    } else {
+      position = enqueue_position_.load(std::memory_order_relaxed);
+    }
+  }
+  cell->job = job;
+  cell->sequence.store(position + 1, std::memory_order_release);
+  return true;
+}
+
+JobSystem::QueuedJob* JobSystem::InjectionQueue::Pop() {
+  size_t position = dequeue_position_.load(std::memory_order_relaxed);
+  Cell* cell = nullptr;
+  while (true) {
+    cell = &cells_[position & (kCapacity - 1)];
+    const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+    const intptr_t difference =
+        static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+    if (difference == 0) {
+      if (dequeue_position_.compare_exchange_weak(
+              position, position + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (difference < 0) {
+      return nullptr;
+    } else {
+      position = dequeue_position_.load(std::memory_order_relaxed);
+    }
+  }
+  QueuedJob* job = cell->job;
+  cell->sequence.store(position + kCapacity, std::memory_order_release);
+  return job;
+}
+
+JobSystem& JobSystem::Get() {
+  static JobSystem job_system{Options()};
+  return job_system;
+}
+
+JobSystem::JobSystem(const Options& options) {
+  // Jobs submitted without waiting for them need at least one worker.
+  const int num_workers = options.num_workers >= 0
+                              ? options.num_workers
+                              : std::max(1, GetDefaultWorkerCount());
+  std::vector<int> cpus;
+  if (options.pin_to_big_cores) {
+    cpus = GetBigCores();
+  }
+  // All deques exist before the first worker may steal from them.
+  for (int i = 0; i < num_workers; ++i) {
+    deques_.push_back(std::make_unique<WorkDeque>());
+  }
+  worker_thread_ids_ = std::make_unique<std::atomic<int32_t>[]>(num_workers);
+  for (int i = 0; i < num_workers; ++i) {
+    worker_thread_ids_[i].store(0, std::memory_order_relaxed);
+  }
+  for (int i = 0; i < num_workers; ++i) {
+    workers_.emplace_back(&JobSystem::WorkerLoop, this, i, cpus);
+  }
+}
+
+JobSystem::~JobSystem() {
+  stopping_.store(true, std::memory_order_seq_cst);
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+  }
+  wake_.notify_all();
+  for (std::thread& worker : workers_) {
+    worker.join();
+  }
+  // Nobody can wait for the jobs still queued anymore.
+  while (QueuedJob* job = injection_queue_.Pop()) {
+    delete job;
+  }
+  for (auto& deque : deques_) {
+    while (QueuedJob* job = deque->Steal()) {
+      delete job;
+    }
+  }
+}
+
+void JobSystem::GetWorkerThreadIds(std::vector<int32_t>* thread_ids) const {
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    const int32_t thread_id =
+        worker_thread_ids_[i].load(std::memory_order_relaxed);
+    if (thread_id != 0) {
+      thread_ids->push_back(thread_id);
+    }
+  }
+}
+
+int JobSystem::GetDefaultWorkerCount() {
+  return static_cast<int>(GetBigCores().size()) - 1;
+}
+
+void JobSystem::Submit(Job job, JobCounter* counter) {
+  QueuedJob* queued = new QueuedJob;
+  queued->job = std::move(job);
+  queued->counter = counter;
+  if (counter != nullptr) {
+    counter->count_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  const int index = GetWorkerIndex();
+  const bool pushed = index >= 0 ? deques_[index]->Push(queued)
+                                 : injection_queue_.Push(queued);
+  if (!pushed) {
+    // The queue is full, which only a runaway producer gets to.
+    Run(queued);
+    return;
+  }
+
+  // Pairs with the sleep check in WorkerLoop(): either the worker sees the
+  // new count before it sleeps, or this sees the sleeping worker.
+  submissions_.fetch_add(1, std::memory_order_seq_cst);
+  if (sleeping_workers_.load(std::memory_order_seq_cst) > 0) {
+    {
+      std::lock_guard<std::mutex> lock(sleep_mutex_);
+    }
+    wake_.notify_one();
+  }
+}
+
+void JobSystem::Wait(JobCounter* counter) {
+  const int index = GetWorkerIndex();
+  while (!counter->IsDone()) {
+    QueuedJob* job = FindJob(index);
+    if (job != nullptr) {
+      Run(job);
+    } else {
+      std::this_thread::yield();
+    }
+  }
+}
+
+void JobSystem::ParallelFor(int begin, int end, int grain,
+                            const RangeJob& job) {
+  if (end <= begin) {
+    return;
+  }
+  grain = std::max(grain, 1);
+  const int num_chunks = (end - begin + grain - 1) / grain;
+  if (num_chunks == 1) {
+    job(begin, end);
+    return;
+  }
+
+  // Chunks are claimed from a shared index rather than submitted one by
+  // one, so a fine grain costs an atomic increment per chunk, not a job.
+  std::atomic<int> next_chunk{0};
+  auto run_chunks = [&] {
+    while (true) {
+      const int chunk = next_chunk.fetch_add(1, std::memory_order_relaxed);
+      if (chunk >= num_chunks) {
+        return;
+      }
+      const int chunk_begin = begin + chunk * grain;
+      job(chunk_begin, std::min(end, chunk_begin + grain));
+    }
+  };
+  JobCounter counter;
+  const int num_helpers = std::min(num_chunks, GetThreadCount()) - 1;
+  for (int i = 0; i < num_helpers; ++i) {
+    Submit(run_chunks, &counter);
+  }
+  run_chunks();
+  Wait(&counter);
+}
+
+void JobSystem::WorkerLoop(int index, const std::vector<int>& cpus) {
+  tls_job_system = this;
+  tls_worker_index = index;
+  worker_thread_ids_[index].store(gettid(), std::memory_order_relaxed);
+  if (!cpus.empty()) {
+    PinCurrentThread(cpus);
+  }
+  while (!stopping_.load(std::memory_order_acquire)) {
+    const uint64_t seen_submissions =
+        submissions_.load(std::memory_order_seq_cst);
+    QueuedJob* job = FindJob(index);
+    if (job != nullptr) {
+      Run(job);
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    sleeping_workers_.fetch_add(1, std::memory_order_seq_cst);
+    wake_.wait(lock, [this, seen_submissions] {
+      return stopping_.load(std::memory_order_acquire) ||
+             submissions_.load(std::memory_order_seq_cst) != seen_submissions;
+    });
+    sleeping_workers_.fetch_sub(1, std::memory_order_relaxed);
+  }
+  // Jobs may have attached the thread to the JVM, e.g. to decode PNGs, which
+  // must not outlive it.
+  DetachJniEnv();
+}
+
+JobSystem::QueuedJob* JobSystem::FindJob(int index) {
+  if (index >= 0) {
+    if (QueuedJob* job = deques_[index]->Take()) {
+      return job;
+    }
+  }
+  if (QueuedJob* job = injection_queue_.Pop()) {
+    return job;
+  }
+  const int num_deques = static_cast<int>(deques_.size());
+  const int first_victim = index + 1;
+  for (int i = 0; i < num_deques; ++i) {
+    const int victim = (first_victim + i) % num_deques;
+    if (victim == index) {
+      continue;
+    }
+    if (QueuedJob* job = deques_[victim]->Steal()) {
+      return job;
+    }
+  }
+  return nullptr;
+}
+
+void JobSystem::Run(QueuedJob* job) {
+  job->job();
+  // Whatever the job holds is released before a waiter may return.
+  job->job = nullptr;
+  JobCounter* counter = job->counter;
+  delete job;
+  if (counter != nullptr) {
+    counter->count_.fetch_sub(1, std::memory_order_release);
+  }
+}
+
+int JobSystem::GetWorkerIndex() const {
+  return tls_job_system == this ? tls_worker_index : -1;
+}
+
+}  // namespace util
+}  // namespace hello_ar
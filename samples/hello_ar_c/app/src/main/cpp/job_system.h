@@ -0,0 +1,189 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef C_ARCORE_HELLOE_AR_JOB_SYSTEM_H_
+#define C_ARCORE_HELLOE_AR_JOB_SYSTEM_H_
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <thread>  // NOLINT
+#include <vector>
+
+namespace hello_ar {
+namespace util {
+
+// Number of jobs submitted with it that have not finished.  JobSystem::Wait()
+// on a counter is how a job depends on others: submit them with a counter and
+// wait for it before using their results.
+class JobCounter {
+ public:
+  JobCounter() = default;
+  JobCounter(const JobCounter&) = delete;
+  JobCounter& operator=(const JobCounter&) = delete;
+
+  bool IsDone() const { return count_.load(std::memory_order_acquire) == 0; }
+
+ private:
+  friend class JobSystem;
+  std::atomic<int> count_{0};
+};
+
+// Persistent worker threads shared by everything in the sample that runs in
+// parallel, e.g. TSDF fusion, mesh simplification and asset decoding, instead
+// of each of them starting threads of its own.
+//
+// Every worker owns a work-stealing deque: jobs a worker submits go to the
+// bottom of its own deque, where it takes them back from in LIFO order while
+// idle workers steal from the top.  Jobs submitted from other threads go
+// through a bounded lock-free queue that all workers drain.  Neither path
+// takes a lock; sleeping workers are woken through a condition variable only
+// when there are any.
+//
+// Wait() runs queued jobs on the waiting thread until its counter drops to
+// zero, so waiting inside a job, or on a thread that is not a worker, never
+// leaves a core idle while work is queued.
+//
+// Jobs may attach the workers to the JVM, which they detach from before they
+// exit.
+class JobSystem {
+ public:
+  using Job = std::function<void()>;
+  // Called with a subrange [begin, end) of a ParallelFor() range.
+  using RangeJob = std::function<void(int begin, int end)>;
+
+  struct Options {
+    // Worker threads to start, or -1 for GetDefaultWorkerCount().
+    int num_workers = -1;
+    // Restricts the workers to the big cores, which keeps latency sensitive
+    // jobs off the efficiency cores where the scheduler would otherwise
+    // migrate them under load.
+    bool pin_to_big_cores = false;
+  };
+
+  // The instance shared by the sample, started with default Options on first
+  // use.
+  static JobSystem& Get();
+
+  explicit JobSystem(const Options& options);
+  ~JobSystem();
+
+  JobSystem(const JobSystem&) = delete;
+  JobSystem& operator=(const JobSystem&) = delete;
+
+  // One worker less than the number of big cores, the thread that submits
+  // and waits is expected to run on the remaining one.  Falls back to all
+  // cores if the cores cannot be told apart.
+  static int GetDefaultWorkerCount();
+
+  // Number of threads that run jobs, a waiting caller included.
+  int GetThreadCount() const { return static_cast<int>(workers_.size()) + 1; }
+
+  // Appends the kernel thread ids of the workers that started so far to
+  // |thread_ids|, e.g. for a PerformanceHintSession.  Thread safe.
+  void GetWorkerThreadIds(std::vector<int32_t>* thread_ids) const;
+
+  // Queues |job|, adding it to |counter| if that is not null.  May be called
+  // from any thread, including from inside a job.
+  void Submit(Job job, JobCounter* counter);
+
+  // Returns once |counter| is done, running queued jobs meanwhile.
+  void Wait(JobCounter* counter);
+
+  // Calls |job| with consecutive subranges of [begin, end) of |grain|
+  // elements, the last one possibly shorter, and returns when all calls have
+  // finished.  The calls run concurrently on the workers and the calling
+  // thread, in no particular order.
+  void ParallelFor(int begin, int end, int grain, const RangeJob& job);
+
+ private:
+  struct QueuedJob {
+    Job job;
+    JobCounter* counter = nullptr;
+  };
+
+  // Chase-Lev deque of a single worker, see "Correct and Efficient
+  // Work-Stealing for Weak Memory Models" by Le et al.  Push() and Take() may
+  // only be called by the owning worker, Steal() by any thread.
+  class WorkDeque {
+   public:
+    static constexpr int64_t kCapacity = 1024;
+
+    bool Push(QueuedJob* job);
+    QueuedJob* Take();
+    QueuedJob* Steal();
+
+   private:
+    std::atomic<int64_t> top_{0};
+    std::atomic<int64_t> bottom_{0};
+    std::array<std::atomic<QueuedJob*>, kCapacity> slots_;
+  };
+
+  // Bounded multi-producer, multi-consumer queue of jobs submitted from
+  // threads that are not workers, after Dmitry Vyukov's design.
+  class InjectionQueue {
+   public:
+    static constexpr size_t kCapacity = 1024;
+
+    InjectionQueue();
+    bool Push(QueuedJob* job);
+    QueuedJob* Pop();
+
+   private:
+    struct Cell {
+      std::atomic<size_t> sequence;
+      QueuedJob* job;
+    };
+    std::array<Cell, kCapacity> cells_;
+    std::atomic<size_t> enqueue_position_{0};
+    std::atomic<size_t> dequeue_position_{0};
+  };
+
+  void WorkerLoop(int index, const std::vector<int>& cpus);
+
+  // Returns the next job for the thread with worker |index|, -1 for threads
+  // that are not workers, or nullptr if there is none.
+  QueuedJob* FindJob(int index);
+
+  // Runs |job|, finishes it on its counter and deletes it.
+  static void Run(QueuedJob* job);
+
+  // Index of the calling thread among the workers of this system, or -1.
+  int GetWorkerIndex() const;
+
+  std::vector<std::unique_ptr<WorkDeque>> deques_;
+  InjectionQueue injection_queue_;
+
+  // Bumped after every submission; sleeping workers wait for it to change.
+  std::atomic<uint64_t> submissions_{0};
+  std::atomic<int> sleeping_workers_{0};
+  std::mutex sleep_mutex_;
+  std::condition_variable wake_;
+  std::atomic<bool> stopping_{false};
+
+  std::vector<std::thread> workers_;
+  // Indexed like |workers_|, 0 until the worker started.
+  std::unique_ptr<std::atomic<int32_t>[]> worker_thread_ids_;
+};
+
+}  // namespace util
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_JOB_SYSTEM_H_
@@ -0,0 +1,157 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "late_pose_reprojector.h"
+
+#include <time.h>
+
+#include <algorithm>
+
+#include "util.h"
+
+namespace hello_ar {
+
+constexpr int LatePoseReprojector::kMaxSamples;
+constexpr int64_t LatePoseReprojector::kMaxPredictionNs;
+
+namespace {
+constexpr int kLooperId = 1;
+constexpr int kEventBatchSize = 16;
+// Samples older than this mean the sensor stopped delivering.
+constexpr int64_t kMaxSampleAgeNs = 50000000;
+#if __ANDROID_API__ >= 26
+// The applicationId of build.gradle.
+constexpr char kPackageName[] = "com.google.ar.core.examples.c.helloar";
+#endif
+}  // namespace
+
+LatePoseReprojector::~LatePoseReprojector() { Stop(); }
+
+bool LatePoseReprojector::Start() {
+  if (queue_ != nullptr || is_unavailable_) {
+    return !is_unavailable_;
+  }
+  // Not retried, so a device without a gyroscope logs once.
+  is_unavailable_ = true;
+#if __ANDROID_API__ >= 26
+  manager_ = ASensorManager_getInstanceForPackage(kPackageName);
+#else
+  // ASensorManager_getInstanceForPackage() needs API level 26, above the
+  // minSdkVersion. Older NDKs mark the only call left deprecated anyway.
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wdeprecated-declarations"
+  manager_ = ASensorManager_getInstance();
+#pragma clang diagnostic pop
+#endif
+  gyroscope_ =
+      ASensorManager_getDefaultSensor(manager_, ASENSOR_TYPE_GYROSCOPE);
+  if (gyroscope_ == nullptr) {
+    LOGE("LatePoseReprojector: no gyroscope");
+    return false;
+  }
+  ALooper* looper = ALooper_prepare(ALOOPER_PREPARE_ALLOW_NON_CALLBACKS);
+  queue_ = ASensorManager_createEventQueue(manager_, looper, kLooperId,
+                                           nullptr, nullptr);
+  if (queue_ == nullptr) {
+    LOGE("LatePoseReprojector: cannot create the sensor event queue");
+    return false;
+  }
+  ASensorEventQueue_enableSensor(queue_, gyroscope_);
+  ASensorEventQueue_setEventRate(queue_, gyroscope_,
+                                 ASensor_getMinDelay(gyroscope_));
+  sample_count_ = 0;
+  is_unavailable_ = false;
+  return true;
+}
+
+void LatePoseReprojector::Stop() {
+  if (queue_ == nullptr) {
+    return;
+  }
+  ASensorEventQueue_disableSensor(queue_, gyroscope_);
+  ASensorManager_destroyEventQueue(manager_, queue_);
+  queue_ = nullptr;
+  sample_count_ = 0;
+}
+
+int64_t LatePoseReprojector::Now() {
+  timespec now;
+  clock_gettime(CLOCK_BOOTTIME, &now);
+  return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+void LatePoseReprojector::DrainEvents() {
+  ASensorEvent events[kEventBatchSize];
+  ssize_t count = 0;
+  while ((count = ASensorEventQueue_getEvents(queue_, events,
+                                              kEventBatchSize)) > 0) {
+    for (ssize_t i = 0; i < count; ++i) {
+      if (events[i].type != ASENSOR_TYPE_GYROSCOPE) {
+        continue;
+      }
+      Sample& sample = samples_[next_sample_];
+      sample.timestamp_ns = events[i].timestamp;
+      sample.angular_velocity =
+          glm::vec3(events[i].vector.x, events[i].vector.y,
+                    events[i].vector.z);
+      next_sample_ = (next_sample_ + 1) % kMaxSamples;
+      sample_count_ = std::min(sample_count_ + 1, kMaxSamples);
+    }
+  }
+}
+
+bool LatePoseReprojector::PredictSensorRotation(int64_t frame_timestamp_ns,
+                                                int64_t target_ns,
+                                                glm::quat* rotation) {
+  if (queue_ == nullptr) {
+    return false;
+  }
+  DrainEvents();
+  if (sample_count_ == 0 || target_ns < frame_timestamp_ns ||
+      target_ns - frame_timestamp_ns > kMaxPredictionNs ||
+      GetSample(sample_count_ - 1).timestamp_ns > frame_timestamp_ns ||
+      target_ns - GetSample(0).timestamp_ns > kMaxSampleAgeNs) {
+    return false;
+  }
+
+  // Each sample's velocity holds from the previous sample to its own
+  // timestamp, and the newest one's up to the target.
+  glm::quat result(1.f, 0.f, 0.f, 0.f);
+  const auto integrate = [&result](const glm::vec3& angular_velocity,
+                                   int64_t duration_ns) {
+    const float angle = glm::length(angular_velocity) * duration_ns * 1e-9f;
+    if (angle > 0.f) {
+      result = result * glm::angleAxis(angle, glm::normalize(angular_velocity));
+    }
+  };
+  int64_t time_ns = frame_timestamp_ns;
+  for (int age = sample_count_ - 2; age >= 0; --age) {
+    const Sample& sample = GetSample(age);
+    if (sample.timestamp_ns <= time_ns) {
+      continue;
+    }
+    const int64_t end_ns = std::min(sample.timestamp_ns, target_ns);
+    integrate(sample.angular_velocity, end_ns - time_ns);
+    time_ns = end_ns;
+  }
+  if (time_ns < target_ns) {
+    integrate(GetSample(0).angular_velocity, target_ns - time_ns);
+  }
+  *rotation = result;
+  return true;
+}
+
+}  // namespace hello_ar
@@ -0,0 +1,100 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_LATE_POSE_REPROJECTOR_H_
+#define C_ARCORE_HELLOE_AR_LATE_POSE_REPROJECTOR_H_
+
+#include <android/looper.h>
+#include <android/sensor.h>
+
+#include <array>
+#include <cstdint>
+
+#include "glm.h"
+
+namespace hello_ar {
+
+// Predicts how far the device has turned since the camera frame was taken,
+// so the view can be corrected just before the frame is submitted rather
+// than when ArSession_update sampled it.
+//
+// Start() subscribes to the gyroscope at its fastest rate.  The events are
+// not polled: PredictSensorRotation() drains what arrived since the last
+// call into a ring of kMaxSamples samples, integrates the angular velocity
+// from the frame's timestamp to the last sample and extrapolates the last
+// sample's velocity to the target time.  ARCore frame timestamps and sensor
+// events are both on the CLOCK_BOOTTIME time base.
+//
+// Start() and PredictSensorRotation() must be called on the same thread,
+// which gets a looper if it has none.  Stop() may be called from another
+// thread while that one is not in PredictSensorRotation(), e.g. while the
+// GLSurfaceView is paused.
+class LatePoseReprojector {
+ public:
+  // About 300 ms of samples at 200 Hz.
+  static constexpr int kMaxSamples = 64;
+  // Frames older than this are not corrected.
+  static constexpr int64_t kMaxPredictionNs = 100000000;
+
+  LatePoseReprojector() = default;
+  ~LatePoseReprojector();
+
+  LatePoseReprojector(const LatePoseReprojector&) = delete;
+  LatePoseReprojector& operator=(const LatePoseReprojector&) = delete;
+
+  // Returns false if the device has no gyroscope, also on later calls.
+  bool Start();
+  void Stop();
+
+  bool IsRunning() const { return queue_ != nullptr; }
+
+  // The rotation of the Android sensor frame from |frame_timestamp_ns| to
+  // |target_ns|, relative to its orientation at |frame_timestamp_ns|.
+  // Returns false if the samples do not reach back to the frame or the frame
+  // is more than kMaxPredictionNs before |target_ns|.
+  bool PredictSensorRotation(int64_t frame_timestamp_ns, int64_t target_ns,
+                             glm::quat* rotation);
+
+  // Current time on the time base of the frame timestamps.
+  static int64_t Now();
+
+ private:
+  struct Sample {
+    int64_t timestamp_ns = 0;
+    // rad/s about the sensor axes.
+    glm::vec3 angular_velocity = glm::vec3(0.f);
+  };
+
+  // Moves the queued gyroscope events into samples_.
+  void DrainEvents();
+
+  // Sample |age| samples before the newest one.
+  const Sample& GetSample(int age) const {
+    return samples_[(next_sample_ - 1 - age + kMaxSamples) % kMaxSamples];
+  }
+
+  ASensorManager* manager_ = nullptr;
+  const ASensor* gyroscope_ = nullptr;
+  ASensorEventQueue* queue_ = nullptr;
+  std::array<Sample, kMaxSamples> samples_;
+  int next_sample_ = 0;
+  int sample_count_ = 0;
+  bool is_unavailable_ = false;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_LATE_POSE_REPROJECTOR_H_
@@ -0,0 +1,169 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "material_atlas.h"
+
+#include <algorithm>
+
+#include "resource_accounting.h"
+#include "util.h"
+
+namespace hello_ar {
+namespace {
+constexpr char kOwner[] = "MaterialAtlas";
+
+// Textures are sampled like those of ObjRenderer.
+constexpr GLint kWrapMode = GL_REPEAT;
+constexpr GLint kMinFilter = GL_LINEAR_MIPMAP_NEAREST;
+
+// Levels of a full mip chain down to 1x1.
+int GetMipLevelCount(int width, int height) {
+  int level_count = 1;
+  for (int size = std::max(width, height); size > 1; size >>= 1) {
+    ++level_count;
+  }
+  return level_count;
+}
+}  // namespace
+
+void MaterialAtlas::InitializeGlContent() {
+  // Names of a previous context are not valid in this one.
+  materials_.clear();
+  arrays_.clear();
+  packed_ = false;
+}
+
+int MaterialAtlas::AddMaterial(const std::string& png_file_name) {
+  for (size_t i = 0; i < materials_.size(); ++i) {
+    if (materials_[i].png_file_name == png_file_name) {
+      return static_cast<int>(i);
+    }
+  }
+  if (packed_) {
+    LOGE("MaterialAtlas is packed, cannot add %s.", png_file_name.c_str());
+    return -1;
+  }
+  Material material;
+  material.png_file_name = png_file_name;
+  material.source_texture = util::TextureCache::Get().Acquire(
+      png_file_name.c_str(), kWrapMode, kMinFilter);
+  materials_.push_back(material);
+  return static_cast<int>(materials_.size()) - 1;
+}
+
+void MaterialAtlas::AssignLayers() {
+  GLint max_layers = 0;
+  glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers);
+  const util::TextureCache& cache = util::TextureCache::Get();
+  for (Material& material : materials_) {
+    int width = 0;
+    int height = 0;
+    if (!cache.GetUncompressedSize(material.source_texture, &width, &height)) {
+      LOGI("MaterialAtlas: %s has no layer, its image cannot be copied.",
+           material.png_file_name.c_str());
+      continue;
+    }
+    auto array = std::find_if(arrays_.begin(), arrays_.end(),
+                              [&](const ArrayTexture& candidate) {
+                                return candidate.width == width &&
+                                       candidate.height == height &&
+                                       candidate.layer_count < max_layers;
+                              });
+    if (array == arrays_.end()) {
+      ArrayTexture new_array;
+      new_array.width = width;
+      new_array.height = height;
+      array = arrays_.insert(arrays_.end(), new_array);
+    }
+    material.location.array = static_cast<int>(array - arrays_.begin());
+    material.location.layer = array->layer_count++;
+  }
+}
+
+bool MaterialAtlas::Pack() {
+  if (packed_) {
+    return true;
+  }
+  util::TextureCache& cache = util::TextureCache::Get();
+  for (const Material& material : materials_) {
+    if (!cache.IsReady(material.source_texture)) {
+      return false;
+    }
+  }
+  AssignLayers();
+
+  for (ArrayTexture& array : arrays_) {
+    const int level_count = GetMipLevelCount(array.width, array.height);
+    glGenTextures(1, &array.texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, level_count, GL_RGBA8, array.width,
+                   array.height, array.layer_count);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, kWrapMode);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, kWrapMode);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, kMinFilter);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    ResourceAccounting::Get().Track(
+        GpuResourceType::kTexture, array.texture,
+        GetTextureBytes(GL_RGBA8, array.width, array.height, level_count) *
+            array.layer_count,
+        kOwner);
+  }
+
+  // Each image is read back from its 2D texture into its layer on the GPU,
+  // so the PNGs are decoded once however they were loaded.
+  GLint previous_read_framebuffer = 0;
+  glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previous_read_framebuffer);
+  GLuint read_framebuffer = 0;
+  glGenFramebuffers(1, &read_framebuffer);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, read_framebuffer);
+  for (Material& material : materials_) {
+    if (material.location.array < 0) {
+      continue;
+    }
+    const ArrayTexture& array = arrays_[material.location.array];
+    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                           GL_TEXTURE_2D, material.source_texture, 0);
+    if (glCheckFramebufferStatus(GL_READ_FRAMEBUFFER) !=
+        GL_FRAMEBUFFER_COMPLETE) {
+      LOGE("MaterialAtlas: Could not read %s.",
+           material.png_file_name.c_str());
+      material.location.array = -1;
+      continue;
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+    glCopyTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, material.location.layer,
+                        0, 0, array.width, array.height);
+  }
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, previous_read_framebuffer);
+  glDeleteFramebuffers(1, &read_framebuffer);
+
+  for (const ArrayTexture& array : arrays_) {
+    glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+  }
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+  // The layers hold the only copy that is sampled from now on.
+  for (Material& material : materials_) {
+    cache.Release(material.source_texture);
+    material.source_texture = 0;
+  }
+  packed_ = true;
+  util::CheckGlError("MaterialAtlas::Pack()");
+  return true;
+}
+
+}  // namespace hello_ar
@@ -0,0 +1,105 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_MATERIAL_ATLAS_H_
+#define C_ARCORE_HELLOE_AR_MATERIAL_ATLAS_H_
+
+#include <GLES3/gl3.h>
+
+#include <string>
+#include <vector>
+
+namespace hello_ar {
+
+// The albedo textures of many materials, packed into the layers of a few
+// GL_TEXTURE_2D_ARRAY textures with one array per image size.  Models with
+// different materials can then be drawn from the same bound array, with the
+// layer picked per instance.
+//
+// The textures are loaded through the TextureCache like any other, so they
+// may load asynchronously.  Once all of them are ready, Pack() copies each
+// image into its layer through a framebuffer and drops the 2D textures.
+// Images of KTX2 assets are compressed and cannot be copied, so they and
+// images that failed to load get no layer.
+//
+// All methods must be called on the OpenGL thread.
+class MaterialAtlas {
+ public:
+  // Where the albedo of a material ended up.
+  struct Location {
+    // Index of the array texture in GetArrayTexture(), -1 if the material
+    // has no layer.
+    int array = -1;
+    int layer = 0;
+  };
+
+  MaterialAtlas() = default;
+  ~MaterialAtlas() = default;
+
+  MaterialAtlas(const MaterialAtlas&) = delete;
+  MaterialAtlas& operator=(const MaterialAtlas&) = delete;
+
+  // Forgets the materials and arrays of a previous context.
+  void InitializeGlContent();
+
+  // Starts loading the albedo PNG at |png_file_name| and returns the id of
+  // its material.  Adding the same file again returns the same id.  Must be
+  // called before Pack() succeeds, further materials are rejected with -1.
+  int AddMaterial(const std::string& png_file_name);
+
+  // Packs the materials if all of their textures are ready, and returns
+  // whether the atlas is packed.  Cheap enough to call every frame.
+  bool Pack();
+
+  bool IsPacked() const { return packed_; }
+
+  int GetMaterialCount() const { return static_cast<int>(materials_.size()); }
+
+  // Only meaningful once IsPacked().
+  const Location& GetLocation(int material) const {
+    return materials_[material].location;
+  }
+
+  int GetArrayCount() const { return static_cast<int>(arrays_.size()); }
+  GLuint GetArrayTexture(int array) const { return arrays_[array].texture; }
+
+ private:
+  struct Material {
+    std::string png_file_name;
+    // From the TextureCache, released once packed.
+    GLuint source_texture = 0;
+    Location location;
+  };
+
+  struct ArrayTexture {
+    GLuint texture = 0;
+    int width = 0;
+    int height = 0;
+    int layer_count = 0;
+  };
+
+  // Assigns every copyable material a layer of an array of its size,
+  // starting a new array when one is full.
+  void AssignLayers();
+
+  std::vector<Material> materials_;
+  std::vector<ArrayTexture> arrays_;
+  bool packed_ = false;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_MATERIAL_ATLAS_H_
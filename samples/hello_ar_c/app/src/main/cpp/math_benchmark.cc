@@ -0,0 +1,161 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "math_benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+#include "glm.h"
+#include "util.h"
+
+namespace hello_ar {
+namespace {
+// Operations per timed run, on as many different inputs, so that the results
+// cannot be hoisted out of the loop.
+constexpr int kBatchSize = 1024;
+// Every operation runs at least this long and this often after one warm-up
+// run.
+constexpr float kMinBenchmarkMs = 100.f;
+constexpr int kMinIterations = 5;
+
+// Rigid transforms and projections like the ones the renderers combine.
+std::vector<glm::mat4> CreateMatrices() {
+  std::vector<glm::mat4> matrices;
+  matrices.reserve(kBatchSize);
+  for (int i = 0; i < kBatchSize; ++i) {
+    const float t = static_cast<float>(i) / kBatchSize;
+    if (i % 2 == 0) {
+      glm::mat4 pose = glm::rotate(glm::mat4(1.0f), 6.28f * t,
+                                   glm::normalize(glm::vec3(t, 1.0f, 0.5f)));
+      pose[3] = glm::vec4(t, 1.0f - t, -2.0f * t, 1.0f);
+      matrices.push_back(pose);
+    } else {
+      matrices.push_back(
+          glm::perspective(0.8f + 0.4f * t, 0.5f + t, 0.1f, 100.0f));
+    }
+  }
+  return matrices;
+}
+
+// Returns the median duration of one call of |operation| in nanoseconds,
+// where |operation| runs kBatchSize calls.
+float TimeOperation(const std::function<void()>& operation) {
+  operation();
+  std::vector<float> samples_ns;
+  float total_ms = 0.f;
+  while (total_ms < kMinBenchmarkMs ||
+         static_cast<int>(samples_ns.size()) < kMinIterations) {
+    const auto start = std::chrono::steady_clock::now();
+    operation();
+    const float sample_ms = std::chrono::duration<float, std::milli>(
+                                std::chrono::steady_clock::now() - start)
+                                .count();
+    samples_ns.push_back(sample_ms * 1e6f / kBatchSize);
+    total_ms += sample_ms;
+  }
+  std::nth_element(samples_ns.begin(),
+                   samples_ns.begin() + samples_ns.size() / 2,
+                   samples_ns.end());
+  return samples_ns[samples_ns.size() / 2];
+}
+
+void AppendResult(const char* name, float packed_ns, float simd_ns,
+                  std::ostringstream* report) {
+  *report << name << ": packed " << packed_ns << " ns, SIMD " << simd_ns
+          << " ns, " << packed_ns / simd_ns << "x\n";
+}
+}  // namespace
+
+std::string RunMathBenchmark() {
+  const std::vector<glm::mat4> matrices = CreateMatrices();
+  std::vector<glm::mat4> results(kBatchSize);
+  std::vector<glm::vec4> vectors(kBatchSize);
+  for (int i = 0; i < kBatchSize; ++i) {
+    vectors[i] = matrices[i][i % 4] + glm::vec4(1.0f);
+  }
+  std::vector<glm::vec4> vector_results(kBatchSize);
+  std::ostringstream report;
+  report << std::fixed << std::setprecision(2);
+
+  // projection * view * model, as in the per-draw MVP matrices.
+  AppendResult(
+      "mat4 * mat4 * mat4",
+      TimeOperation([&]() {
+        for (int i = 0; i < kBatchSize; ++i) {
+          results[i] = matrices[i] * matrices[(i + 1) % kBatchSize] *
+                       matrices[(i + 2) % kBatchSize];
+        }
+      }),
+      TimeOperation([&]() {
+        for (int i = 0; i < kBatchSize; ++i) {
+          results[i] = util::MultiplyMatrices(
+              matrices[i], matrices[(i + 1) % kBatchSize],
+              matrices[(i + 2) % kBatchSize]);
+        }
+      }),
+      &report);
+
+  AppendResult("inverse(mat4)",
+               TimeOperation([&]() {
+                 for (int i = 0; i < kBatchSize; ++i) {
+                   results[i] = glm::inverse(matrices[i]);
+                 }
+               }),
+               TimeOperation([&]() {
+                 for (int i = 0; i < kBatchSize; ++i) {
+                   results[i] = util::InvertMatrix(matrices[i]);
+                 }
+               }),
+               &report);
+
+  AppendResult("normalize(vec4)",
+               TimeOperation([&]() {
+                 for (int i = 0; i < kBatchSize; ++i) {
+                   vector_results[i] = glm::normalize(vectors[i]);
+                 }
+               }),
+               TimeOperation([&]() {
+                 for (int i = 0; i < kBatchSize; ++i) {
+                   vector_results[i] = util::NormalizeVector(vectors[i]);
+                 }
+               }),
+               &report);
+
+  // The SIMD paths must compute the same results, up to rounding.
+  float max_error = 0.0f;
+  for (int i = 0; i < kBatchSize; ++i) {
+    const glm::mat4 packed = glm::inverse(matrices[i]);
+    const glm::mat4 simd = util::InvertMatrix(matrices[i]);
+    for (int column = 0; column < 4; ++column) {
+      const glm::vec4 error = glm::abs(packed[column] - simd[column]) /
+                              glm::max(glm::abs(packed[column]),
+                                       glm::vec4(1.0f));
+      max_error = std::max(
+          max_error, std::max(std::max(error.x, error.y),
+                              std::max(error.z, error.w)));
+    }
+  }
+  report << "inverse(mat4) max relative difference: " << std::scientific
+         << max_error << "\n";
+  return report.str();
+}
+
+}  // namespace hello_ar
@@ -0,0 +1,34 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_MATH_BENCHMARK_H_
+#define C_ARCORE_HELLOE_AR_MATH_BENCHMARK_H_
+
+#include <string>
+
+namespace hello_ar {
+
+// Times the matrix math of the draw paths: 4x4 matrix products, inverses and
+// vec4 normalization, once with the packed glm types and once through
+// util::MultiplyMatrices() and friends, which use glm's SIMD code.  Returns
+// one line per operation with the median time per call in nanoseconds.
+//
+// Takes about a second, so it should run on its own thread.
+std::string RunMathBenchmark();
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_MATH_BENCHMARK_H_
@@ -0,0 +1,142 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mesh_simplifier.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+
+namespace hello_ar {
+namespace {
+constexpr int kPositionComponents = 3;
+constexpr int kMaxPasses = 4;
+// Positions closer than this are the same vertex.  Shared edges of the
+// extracted cells are interpolated from the same corners, so their
+// crossings only differ by rounding.
+constexpr float kWeldTolerance = 1e-5f;
+
+uint64_t GetWeldKey(const glm::vec3& position) {
+  const glm::ivec3 cell(glm::round(position / kWeldTolerance));
+  // 21 bits per axis cover +-10 meters at the weld tolerance.
+  constexpr uint64_t kMask = (1u << 21) - 1;
+  return (static_cast<uint64_t>(cell.x) & kMask) |
+         ((static_cast<uint64_t>(cell.y) & kMask) << 21) |
+         ((static_cast<uint64_t>(cell.z) & kMask) << 42);
+}
+
+int FindRoot(std::vector<int>* parents, int vertex) {
+  std::vector<int>& parent = *parents;
+  while (parent[vertex] != vertex) {
+    parent[vertex] = parent[parent[vertex]];
+    vertex = parent[vertex];
+  }
+  return vertex;
+}
+}  // namespace
+
+void SimplifyMesh(float min_edge_length, const glm::vec3& bounds_min,
+                  const glm::vec3& bounds_max, std::vector<float>* vertices) {
+  const int num_corners =
+      static_cast<int>(vertices->size()) / kPositionComponents;
+  if (num_corners < 3 || min_edge_length <= 0.f) {
+    return;
+  }
+
+  // Welds the corners of the soup into shared vertices.
+  std::vector<glm::vec3> positions;
+  std::vector<int> indices(num_corners);
+  std::unordered_map<uint64_t, int> welded;
+  welded.reserve(num_corners);
+  for (int i = 0; i < num_corners; ++i) {
+    const glm::vec3 position = glm::make_vec3(&(*vertices)[i * 3]);
+    auto inserted = welded.emplace(GetWeldKey(position),
+                                   static_cast<int>(positions.size()));
+    if (inserted.second) {
+      positions.push_back(position);
+    }
+    indices[i] = inserted.first->second;
+  }
+
+  const int num_vertices = static_cast<int>(positions.size());
+  std::vector<bool> pinned(num_vertices);
+  const float bound_tolerance = min_edge_length * 1e-3f;
+  for (int v = 0; v < num_vertices; ++v) {
+    const glm::vec3& p = positions[v];
+    pinned[v] = glm::any(glm::lessThan(glm::abs(p - bounds_min),
+                                       glm::vec3(bound_tolerance))) ||
+                glm::any(glm::lessThan(glm::abs(p - bounds_max),
+                                       glm::vec3(bound_tolerance)));
+  }
+
+  std::vector<int> parents(num_vertices);
+  for (int v = 0; v < num_vertices; ++v) {
+    parents[v] = v;
+  }
+  std::vector<bool> moved(num_vertices);
+  const float min_length_squared = min_edge_length * min_edge_length;
+  for (int pass = 0; pass < kMaxPasses; ++pass) {
+    std::fill(moved.begin(), moved.end(), false);
+    bool collapsed = false;
+    for (int corner = 0; corner < num_corners; ++corner) {
+      // The edge from this corner to the next one of its triangle.
+      const int next = corner % 3 == 2 ? corner - 2 : corner + 1;
+      int a = FindRoot(&parents, indices[corner]);
+      int b = FindRoot(&parents, indices[next]);
+      if (a == b || moved[a] || moved[b] || (pinned[a] && pinned[b])) {
+        continue;
+      }
+      const glm::vec3 edge = positions[b] - positions[a];
+      if (glm::dot(edge, edge) >= min_length_squared) {
+        continue;
+      }
+      // A pinned end keeps its position and absorbs the other one.
+      if (pinned[b]) {
+        std::swap(a, b);
+      }
+      if (!pinned[a]) {
+        positions[a] = 0.5f * (positions[a] + positions[b]);
+      }
+      parents[b] = a;
+      moved[a] = true;
+      collapsed = true;
+    }
+    if (!collapsed) {
+      break;
+    }
+  }
+
+  // Writes the triangles that still have three distinct vertices back.
+  std::vector<float>& output = *vertices;
+  size_t written = 0;
+  for (int corner = 0; corner + 2 < num_corners; corner += 3) {
+    const int a = FindRoot(&parents, indices[corner]);
+    const int b = FindRoot(&parents, indices[corner + 1]);
+    const int c = FindRoot(&parents, indices[corner + 2]);
+    if (a == b || b == c || a == c) {
+      continue;
+    }
+    for (const int v : {a, b, c}) {
+      output[written++] = positions[v].x;
+      output[written++] = positions[v].y;
+      output[written++] = positions[v].z;
+    }
+  }
+  output.resize(written);
+}
+
+}  // namespace hello_ar
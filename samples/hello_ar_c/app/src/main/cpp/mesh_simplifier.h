@@ -0,0 +1,43 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_MESH_SIMPLIFIER_H_
+#define C_ARCORE_HELLOE_AR_MESH_SIMPLIFIER_H_
+
+#include <vector>
+
+#include "glm.h"
+
+namespace hello_ar {
+
+// Reduces a triangle soup, as extracted by TsdfVolume, by collapsing its
+// edges shorter than |min_edge_length|.
+//
+// Vertices are welded first, so that triangles share them, and every collapse
+// merges the two ends of an edge into its midpoint.  A vertex moves at most
+// once per pass, and up to four passes run while edges are short enough.
+// Vertices on the faces of the box [|bounds_min|, |bounds_max|] stay where
+// they are, so the mesh still meets the meshes of the neighbouring boxes
+// without cracks.  Triangles that collapsed are dropped.
+//
+// @param vertices, x, y, z positions, three vertices per triangle, replaced
+//     by the simplified triangles in the same layout.
+void SimplifyMesh(float min_edge_length, const glm::vec3& bounds_min,
+                  const glm::vec3& bounds_max, std::vector<float>* vertices);
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_MESH_SIMPLIFIER_H_
@@ -0,0 +1,537 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "native_frame_loop.h"
+
+#include <android/api-level.h>
+#include <dlfcn.h>
+#include <time.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include "jni_interface.h"
+#include "util.h"
+
+namespace hello_ar {
+namespace {
+// AChoreographer_postFrameCallback64 is the first to report the vsync time
+// in 64 bits on every ABI.
+constexpr int kMinApiLevel = 29;
+// Assumed until the vsync callbacks tell.
+constexpr int64_t kDefaultRefreshPeriodNs = 16666667;
+// Added to the frame time estimate for the swap and the scheduler.
+constexpr int64_t kSafetyMarginNs = 2000000;
+// Inverse weights of the new sample in the frame time mean and deviation,
+// as in TCP's round trip time estimate.
+constexpr int64_t kMeanWeight = 8;
+constexpr int64_t kDeviationWeight = 4;
+// Deviations the estimate stays above the mean.
+constexpr int64_t kEstimateDeviations = 2;
+
+// Looked up at runtime, the sample supports Android releases without them.
+using GetInstanceFunction = AChoreographer* (*)();
+using PostFrameCallback64Function =
+    void (*)(AChoreographer* choreographer,
+             AChoreographer_frameCallback64 callback, void* data);
+
+struct ChoreographerFunctions {
+  GetInstanceFunction get_instance = nullptr;
+  PostFrameCallback64Function post_frame_callback64 = nullptr;
+};
+
+const ChoreographerFunctions& GetChoreographerFunctions() {
+  static const ChoreographerFunctions functions = []() {
+    ChoreographerFunctions result;
+    void* library = dlopen("libandroid.so", RTLD_NOW | RTLD_LOCAL);
+    if (library == nullptr) {
+      return result;
+    }
+    result.get_instance = reinterpret_cast<GetInstanceFunction>(
+        dlsym(library, "AChoreographer_getInstance"));
+    result.post_frame_callback64 =
+        reinterpret_cast<PostFrameCallback64Function>(
+            dlsym(library, "AChoreographer_postFrameCallback64"));
+    return result;
+  }();
+  return functions;
+}
+
+int64_t NowNs() {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+// Choreographer reports vsyncs in CLOCK_MONOTONIC.
+void SleepUntilNs(int64_t time_ns) {
+  timespec time;
+  time.tv_sec = static_cast<time_t>(time_ns / 1000000000);
+  time.tv_nsec = static_cast<long>(time_ns % 1000000000);  // NOLINT
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &time, nullptr) ==
+         EINTR) {
+  }
+}
+
+bool HasExtension(const char* extensions, const char* name) {
+  return extensions != nullptr && strstr(extensions, name) != nullptr;
+}
+}  // namespace
+
+constexpr int NativeFrameLoop::kNumPeriodSamples;
+constexpr int NativeFrameLoop::kMaxPendingFrames;
+
+NativeFrameLoop::~NativeFrameLoop() { Stop(); }
+
+bool NativeFrameLoop::IsSupported() {
+  if (android_get_device_api_level() < kMinApiLevel) {
+    return false;
+  }
+  const ChoreographerFunctions& functions = GetChoreographerFunctions();
+  return functions.get_instance != nullptr &&
+         functions.post_frame_callback64 != nullptr;
+}
+
+bool NativeFrameLoop::Start(Callbacks callbacks) {
+  if (thread_.joinable()) {
+    return true;
+  }
+  if (!IsSupported()) {
+    LOGE("NativeFrameLoop::Start needs Android %d", kMinApiLevel);
+    return false;
+  }
+  callbacks_ = std::move(callbacks);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = true;
+    started_ = false;
+    start_failed_ = false;
+  }
+  thread_ = std::thread(&NativeFrameLoop::Run, this);
+  std::unique_lock<std::mutex> lock(mutex_);
+  commands_applied_.wait(lock, [this] { return started_; });
+  if (!start_failed_) {
+    return true;
+  }
+  ALooper_release(looper_);
+  looper_ = nullptr;
+  lock.unlock();
+  thread_.join();
+  return false;
+}
+
+void NativeFrameLoop::Stop() {
+  if (!thread_.joinable()) {
+    return;
+  }
+  ALooper* looper = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = false;
+    looper = looper_;
+  }
+  ALooper_wake(looper);
+  thread_.join();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  ALooper_release(looper_);
+  looper_ = nullptr;
+  if (pending_window_ != nullptr) {
+    ANativeWindow_release(pending_window_);
+    pending_window_ = nullptr;
+  }
+  window_changed_ = false;
+  tasks_.clear();
+  applied_generation_ = queued_generation_;
+}
+
+void NativeFrameLoop::SetWindow(ANativeWindow* window) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (!running_) {
+    if (window != nullptr) {
+      ANativeWindow_release(window);
+    }
+    return;
+  }
+  if (pending_window_ != nullptr) {
+    ANativeWindow_release(pending_window_);
+  }
+  pending_window_ = window;
+  window_changed_ = true;
+  WaitForCommands(&lock);
+}
+
+void NativeFrameLoop::SetPaused(bool paused) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  paused_ = paused;
+  if (running_) {
+    WaitForCommands(&lock);
+  }
+}
+
+void NativeFrameLoop::Post(std::function<void()> task) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!running_) {
+    return;
+  }
+  tasks_.push_back(std::move(task));
+  ALooper_wake(looper_);
+}
+
+void NativeFrameLoop::WaitForCommands(std::unique_lock<std::mutex>* lock) {
+  const uint64_t generation = ++queued_generation_;
+  ALooper_wake(looper_);
+  commands_applied_.wait(*lock, [this, generation] {
+    return applied_generation_ >= generation || !running_;
+  });
+}
+
+NativeFrameLoop::Stats NativeFrameLoop::GetStats() const {
+  std::lock_guard<std::mutex> lock(stats_mutex_);
+  return stats_;
+}
+
+std::string NativeFrameLoop::GetReport() const {
+  const Stats stats = GetStats();
+  char text[192];
+  snprintf(text, sizeof(text),
+           "%lld frames at %.2f ms, started %.2f ms ahead of vsync, "
+           "%lld of %lld presented late, latency %.2f ms mean, %.2f ms max",
+           static_cast<long long>(stats.frame_count), stats.refresh_period_ms,
+           stats.frame_time_estimate_ms + kSafetyMarginNs / 1e6f,
+           static_cast<long long>(stats.late_count),
+           static_cast<long long>(stats.presented_count),
+           stats.mean_latency_ms, stats.max_latency_ms);
+  return text;
+}
+
+void NativeFrameLoop::Run() {
+  ALooper* looper = ALooper_prepare(0);
+  ALooper_acquire(looper);
+  choreographer_ = GetChoreographerFunctions().get_instance();
+  const bool created = choreographer_ != nullptr && CreateContext();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    looper_ = looper;
+    started_ = true;
+    start_failed_ = !created;
+    running_ = created;
+  }
+  commands_applied_.notify_all();
+
+  while (created) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!running_) {
+        break;
+      }
+    }
+    ApplyCommands();
+    ALooper_pollOnce(-1, nullptr, nullptr, nullptr);
+  }
+
+  ReplaceSurface(nullptr);
+  DestroyContext();
+  commands_applied_.notify_all();
+  // The callbacks may have called into Java.
+  DetachJniEnv();
+}
+
+bool NativeFrameLoop::CreateContext() {
+  display_ = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  if (display_ == EGL_NO_DISPLAY ||
+      eglInitialize(display_, nullptr, nullptr) != EGL_TRUE) {
+    LOGE("NativeFrameLoop: no EGL display");
+    display_ = EGL_NO_DISPLAY;
+    return false;
+  }
+
+  // What the GLSurfaceView is configured with; alpha is used for plane
+  // blending.
+  const EGLint config_attributes[] = {EGL_RENDERABLE_TYPE,
+                                      EGL_OPENGL_ES3_BIT_KHR,
+                                      EGL_SURFACE_TYPE,
+                                      EGL_WINDOW_BIT,
+                                      EGL_RED_SIZE,
+                                      8,
+                                      EGL_GREEN_SIZE,
+                                      8,
+                                      EGL_BLUE_SIZE,
+                                      8,
+                                      EGL_ALPHA_SIZE,
+                                      8,
+                                      EGL_DEPTH_SIZE,
+                                      16,
+                                      EGL_STENCIL_SIZE,
+                                      0,
+                                      EGL_NONE};
+  EGLint num_configs = 0;
+  if (eglChooseConfig(display_, config_attributes, &config_, 1,
+                      &num_configs) != EGL_TRUE ||
+      num_configs < 1) {
+    LOGE("NativeFrameLoop: no window config");
+    display_ = EGL_NO_DISPLAY;
+    return false;
+  }
+  const EGLint context_attributes[] = {EGL_CONTEXT_CLIENT_VERSION, 3,
+                                       EGL_NONE};
+  context_ =
+      eglCreateContext(display_, config_, EGL_NO_CONTEXT, context_attributes);
+  if (context_ == EGL_NO_CONTEXT) {
+    LOGE("NativeFrameLoop: context error 0x%x", eglGetError());
+    display_ = EGL_NO_DISPLAY;
+    return false;
+  }
+
+  const char* extensions = eglQueryString(display_, EGL_EXTENSIONS);
+  if (HasExtension(extensions, "EGL_ANDROID_presentation_time")) {
+    presentation_time_ = reinterpret_cast<PFNEGLPRESENTATIONTIMEANDROIDPROC>(
+        eglGetProcAddress("eglPresentationTimeANDROID"));
+  }
+  if (HasExtension(extensions, "EGL_ANDROID_get_frame_timestamps")) {
+    get_next_frame_id_ = reinterpret_cast<PFNEGLGETNEXTFRAMEIDANDROIDPROC>(
+        eglGetProcAddress("eglGetNextFrameIdANDROID"));
+    get_frame_timestamps_ =
+        reinterpret_cast<PFNEGLGETFRAMETIMESTAMPSANDROIDPROC>(
+            eglGetProcAddress("eglGetFrameTimestampsANDROID"));
+  }
+  if (get_next_frame_id_ == nullptr || get_frame_timestamps_ == nullptr) {
+    LOGI("NativeFrameLoop: presentation times are not reported");
+    get_next_frame_id_ = nullptr;
+    get_frame_timestamps_ = nullptr;
+  }
+  return true;
+}
+
+void NativeFrameLoop::DestroyContext() {
+  if (display_ == EGL_NO_DISPLAY) {
+    return;
+  }
+  eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  eglDestroyContext(display_, context_);
+  context_ = EGL_NO_CONTEXT;
+  // Not terminated, the display is the one of the whole process.
+  display_ = EGL_NO_DISPLAY;
+}
+
+void NativeFrameLoop::ApplyCommands() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  const uint64_t generation = queued_generation_;
+  if (window_changed_) {
+    ANativeWindow* window = pending_window_;
+    pending_window_ = nullptr;
+    window_changed_ = false;
+    lock.unlock();
+    ReplaceSurface(window);
+    lock.lock();
+  }
+  const bool has_surface = surface_ != EGL_NO_SURFACE;
+  drawing_ = has_surface && !paused_;
+  if (has_surface) {
+    running_tasks_.swap(tasks_);
+  }
+  applied_generation_ = generation;
+  lock.unlock();
+  commands_applied_.notify_all();
+
+  for (const std::function<void()>& task : running_tasks_) {
+    task();
+  }
+  running_tasks_.clear();
+  if (!drawing_) {
+    // The next vsync after a pause tells nothing about the period.
+    last_vsync_ns_ = 0;
+  } else if (!callback_pending_) {
+    PostFrameCallback();
+  }
+}
+
+void NativeFrameLoop::ReplaceSurface(ANativeWindow* window) {
+  if (window != nullptr && window == window_) {
+    // The same window again, e.g. after a resize.
+    ANativeWindow_release(window);
+    return;
+  }
+  if (surface_ != EGL_NO_SURFACE) {
+    eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroySurface(display_, surface_);
+    surface_ = EGL_NO_SURFACE;
+    pending_count_ = 0;
+  }
+  if (window_ != nullptr) {
+    ANativeWindow_release(window_);
+    window_ = nullptr;
+  }
+  if (window == nullptr) {
+    return;
+  }
+
+  window_ = window;
+  surface_ = eglCreateWindowSurface(display_, config_, window_, nullptr);
+  if (surface_ == EGL_NO_SURFACE ||
+      eglMakeCurrent(display_, surface_, surface_, context_) != EGL_TRUE) {
+    LOGE("NativeFrameLoop: window surface error 0x%x", eglGetError());
+    if (surface_ != EGL_NO_SURFACE) {
+      eglDestroySurface(display_, surface_);
+      surface_ = EGL_NO_SURFACE;
+    }
+    ANativeWindow_release(window_);
+    window_ = nullptr;
+    return;
+  }
+  if (get_frame_timestamps_ != nullptr) {
+    eglSurfaceAttrib(display_, surface_, EGL_TIMESTAMPS_ANDROID, EGL_TRUE);
+  }
+  callbacks_.surface_created();
+}
+
+void NativeFrameLoop::PostFrameCallback() {
+  GetChoreographerFunctions().post_frame_callback64(choreographer_, &OnVsync,
+                                                    this);
+  callback_pending_ = true;
+}
+
+void NativeFrameLoop::OnVsync(int64_t frame_time_ns, void* data) {
+  NativeFrameLoop* loop = static_cast<NativeFrameLoop*>(data);
+  loop->callback_pending_ = false;
+  if (!loop->drawing_) {
+    return;
+  }
+  loop->UpdateRefreshPeriod(frame_time_ns);
+  // Asked for before drawing, so a long frame delays the next callback
+  // rather than skipping a vsync.
+  loop->PostFrameCallback();
+  loop->DrawFrame(frame_time_ns);
+}
+
+void NativeFrameLoop::DrawFrame(int64_t vsync_ns) {
+  const int64_t period_ns =
+      period_ns_ != 0 ? period_ns_ : kDefaultRefreshPeriodNs;
+  const int64_t target_present_ns = vsync_ns + period_ns;
+  // Started later, the frame is likely to miss the next vsync; started
+  // earlier, it shows an older camera image and pose than it could.  If a
+  // frame takes longer than a period, it starts right away.
+  const int64_t frame_estimate_ns =
+      mean_frame_ns_ + kEstimateDeviations * frame_deviation_ns_;
+  const int64_t start_ns =
+      target_present_ns - frame_estimate_ns - kSafetyMarginNs;
+  if (start_ns > NowNs()) {
+    SleepUntilNs(start_ns);
+  }
+
+  // Only the CPU time of the frame is estimated; the swap may block on the
+  // buffer queue, which starting earlier would not help with.
+  const int64_t frame_start_ns = NowNs();
+  if (!callbacks_.draw_frame()) {
+    // Skipped frames say little about the time of a drawn one.
+    return;
+  }
+  UpdateFrameTimeEstimate(NowNs() - frame_start_ns);
+
+  if (presentation_time_ != nullptr) {
+    presentation_time_(display_, surface_, target_present_ns);
+  }
+  EGLuint64KHR frame_id = 0;
+  const bool has_frame_id =
+      get_next_frame_id_ != nullptr &&
+      get_next_frame_id_(display_, surface_, &frame_id) == EGL_TRUE;
+  if (eglSwapBuffers(display_, surface_) != EGL_TRUE) {
+    LOGE("NativeFrameLoop: swap error 0x%x", eglGetError());
+  }
+  if (has_frame_id) {
+    if (pending_count_ == kMaxPendingFrames) {
+      // The oldest was never reported; EGL only keeps a few frames.
+      pending_begin_ = (pending_begin_ + 1) % kMaxPendingFrames;
+      --pending_count_;
+    }
+    PendingFrame& pending = pending_frames_[(pending_begin_ + pending_count_) %
+                                            kMaxPendingFrames];
+    pending.frame_id = frame_id;
+    pending.vsync_ns = vsync_ns;
+    pending.target_present_ns = target_present_ns;
+    ++pending_count_;
+  }
+
+  std::lock_guard<std::mutex> lock(stats_mutex_);
+  ++stats_.frame_count;
+  stats_.refresh_period_ms = period_ns / 1e6f;
+  stats_.frame_time_estimate_ms = frame_estimate_ns / 1e6f;
+  ReadFrameTimestamps();
+}
+
+void NativeFrameLoop::UpdateRefreshPeriod(int64_t vsync_ns) {
+  if (last_vsync_ns_ != 0 && vsync_ns > last_vsync_ns_) {
+    period_samples_[period_sample_index_] = vsync_ns - last_vsync_ns_;
+    period_sample_index_ = (period_sample_index_ + 1) % kNumPeriodSamples;
+    // Skipped vsyncs only make samples longer, so the shortest one is the
+    // period, and a switch to a higher refresh rate shows right away.
+    int64_t period_ns = 0;
+    for (const int64_t sample : period_samples_) {
+      if (sample != 0 && (period_ns == 0 || sample < period_ns)) {
+        period_ns = sample;
+      }
+    }
+    period_ns_ = period_ns;
+  }
+  last_vsync_ns_ = vsync_ns;
+}
+
+void NativeFrameLoop::UpdateFrameTimeEstimate(int64_t frame_time_ns) {
+  if (mean_frame_ns_ == 0) {
+    mean_frame_ns_ = frame_time_ns;
+    frame_deviation_ns_ = frame_time_ns / 2;
+    return;
+  }
+  const int64_t error = frame_time_ns - mean_frame_ns_;
+  mean_frame_ns_ += error / kMeanWeight;
+  frame_deviation_ns_ +=
+      ((error < 0 ? -error : error) - frame_deviation_ns_) / kDeviationWeight;
+}
+
+void NativeFrameLoop::ReadFrameTimestamps() {
+  static const EGLint kTimestampNames[] = {EGL_DISPLAY_PRESENT_TIME_ANDROID};
+  while (pending_count_ > 0) {
+    const PendingFrame& pending = pending_frames_[pending_begin_];
+    EGLnsecsANDROID present_ns = EGL_TIMESTAMP_PENDING_ANDROID;
+    const bool queried =
+        get_frame_timestamps_(display_, surface_, pending.frame_id, 1,
+                              kTimestampNames, &present_ns) == EGL_TRUE;
+    if (queried && present_ns == EGL_TIMESTAMP_PENDING_ANDROID) {
+      // Frames are presented in order.
+      break;
+    }
+    pending_begin_ = (pending_begin_ + 1) % kMaxPendingFrames;
+    --pending_count_;
+    if (!queried || present_ns == EGL_TIMESTAMP_INVALID_ANDROID) {
+      continue;
+    }
+
+    const float latency_ms = (present_ns - pending.vsync_ns) / 1e6f;
+    ++stats_.presented_count;
+    latency_sum_ms_ += latency_ms;
+    stats_.mean_latency_ms =
+        static_cast<float>(latency_sum_ms_ / stats_.presented_count);
+    stats_.max_latency_ms = std::max(stats_.max_latency_ms, latency_ms);
+    // Half a period absorbs the jitter of the present fence.
+    if (present_ns > pending.target_present_ns + period_ns_ / 2) {
+      ++stats_.late_count;
+    }
+  }
+}
+
+}  // namespace hello_ar
@@ -0,0 +1,195 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_NATIVE_FRAME_LOOP_H_
+#define C_ARCORE_HELLOE_AR_NATIVE_FRAME_LOOP_H_
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <android/choreographer.h>
+#include <android/looper.h>
+#include <android/native_window.h>
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace hello_ar {
+
+// A render thread that owns its EGL context and window surface and draws
+// from AChoreographer vsync callbacks, instead of the GLSurfaceView thread
+// drawing as fast as the buffer queue lets it.
+//
+// On every vsync the loop waits until the measured CPU time of a frame, with
+// a margin, before the next vsync, so the frame reads the newest camera
+// image and pose and still makes that vsync.  Its presentation time is set
+// to that vsync as well.  Where EGL_ANDROID_get_frame_timestamps is
+// available, the time from the vsync to the frame being on the display and
+// the frames that missed their vsync are measured.
+//
+// Like the GLSurfaceView with a preserved context, the context outlives the
+// window surfaces, and surface_created runs for every new one.  Needs
+// Android 10 for AChoreographer_postFrameCallback64, see IsSupported().
+class NativeFrameLoop {
+ public:
+  // All run on the loop thread with the context current.
+  struct Callbacks {
+    // A new window surface was made current.
+    std::function<void()> surface_created;
+    // Draws the frame and returns true for the loop to swap the buffers, or
+    // false to keep the previous frame on the display.
+    std::function<bool()> draw_frame;
+  };
+
+  struct Stats {
+    float refresh_period_ms = 0.f;
+    // CPU time a frame is expected to take, which it is started ahead of
+    // the vsync by.
+    float frame_time_estimate_ms = 0.f;
+    int64_t frame_count = 0;
+    // Frames whose presentation was reported, and those of them that were
+    // shown later than the vsync they were scheduled for.
+    int64_t presented_count = 0;
+    int64_t late_count = 0;
+    // From the vsync a frame was started on to it being on the display.
+    float mean_latency_ms = 0.f;
+    float max_latency_ms = 0.f;
+  };
+
+  NativeFrameLoop() = default;
+  ~NativeFrameLoop();
+
+  NativeFrameLoop(const NativeFrameLoop&) = delete;
+  NativeFrameLoop& operator=(const NativeFrameLoop&) = delete;
+
+  // Whether the vsync callbacks the loop needs are available.
+  static bool IsSupported();
+
+  // Starts the thread and creates the context.  Frames are drawn once a
+  // window is set.  Returns false if the context cannot be created.
+  bool Start(Callbacks callbacks);
+
+  // Finishes the current frame, destroys the surface and the context and
+  // joins the thread.  Tasks that did not run yet are dropped.
+  void Stop();
+
+  bool IsRunning() const { return thread_.joinable(); }
+
+  // Takes over the reference to |window| and draws into it from the next
+  // vsync on, or stops drawing if it is nullptr.  Returns once the previous
+  // window is not used anymore, so it can be called from
+  // surfaceDestroyed().
+  void SetWindow(ANativeWindow* window);
+
+  // Stops or restarts the vsync callbacks, like GLSurfaceView.onPause().
+  // Returns once the current frame is finished.
+  void SetPaused(bool paused);
+
+  // Runs |task| on the loop thread ahead of the next frame, the counterpart
+  // of GLSurfaceView.queueEvent().  Tasks wait for a surface to be current.
+  void Post(std::function<void()> task);
+
+  // May be called from any thread.
+  Stats GetStats() const;
+  std::string GetReport() const;
+
+ private:
+  // A swapped frame whose presentation was not reported yet.
+  struct PendingFrame {
+    EGLuint64KHR frame_id = 0;
+    int64_t vsync_ns = 0;
+    int64_t target_present_ns = 0;
+  };
+
+  static constexpr int kNumPeriodSamples = 16;
+  static constexpr int kMaxPendingFrames = 8;
+
+  static void OnVsync(int64_t frame_time_ns, void* data);
+
+  void Run();
+  bool CreateContext();
+  void DestroyContext();
+  // Applies the window, pause and tasks queued by the other threads, and
+  // asks for the next vsync if frames are to be drawn.
+  void ApplyCommands();
+  void ReplaceSurface(ANativeWindow* window);
+  void DrawFrame(int64_t vsync_ns);
+  void PostFrameCallback();
+  // Waits until the loop thread has applied the commands queued so far.
+  void WaitForCommands(std::unique_lock<std::mutex>* lock);
+
+  void UpdateRefreshPeriod(int64_t vsync_ns);
+  void UpdateFrameTimeEstimate(int64_t frame_time_ns);
+  // Counts the frames whose presentation got reported, with stats_mutex_
+  // held.
+  void ReadFrameTimestamps();
+
+  std::thread thread_;
+  // Set by Start(), then only used on the loop thread.
+  Callbacks callbacks_;
+  // Set by the loop thread once it runs, for ALooper_wake().
+  ALooper* looper_ = nullptr;
+
+  // Commands for the loop thread, under mutex_.
+  mutable std::mutex mutex_;
+  std::condition_variable commands_applied_;
+  bool running_ = false;
+  bool started_ = false;
+  bool start_failed_ = false;
+  bool window_changed_ = false;
+  ANativeWindow* pending_window_ = nullptr;
+  bool paused_ = false;
+  std::vector<std::function<void()>> tasks_;
+  uint64_t queued_generation_ = 0;
+  uint64_t applied_generation_ = 0;
+
+  // Only used on the loop thread.
+  AChoreographer* choreographer_ = nullptr;
+  EGLDisplay display_ = EGL_NO_DISPLAY;
+  EGLConfig config_ = nullptr;
+  EGLContext context_ = EGL_NO_CONTEXT;
+  EGLSurface surface_ = EGL_NO_SURFACE;
+  ANativeWindow* window_ = nullptr;
+  bool drawing_ = false;
+  bool callback_pending_ = false;
+  std::vector<std::function<void()>> running_tasks_;
+  int64_t last_vsync_ns_ = 0;
+  int64_t period_ns_ = 0;
+  std::array<int64_t, kNumPeriodSamples> period_samples_ = {};
+  int period_sample_index_ = 0;
+  int64_t mean_frame_ns_ = 0;
+  int64_t frame_deviation_ns_ = 0;
+  std::array<PendingFrame, kMaxPendingFrames> pending_frames_;
+  int pending_begin_ = 0;
+  int pending_count_ = 0;
+  PFNEGLPRESENTATIONTIMEANDROIDPROC presentation_time_ = nullptr;
+  PFNEGLGETNEXTFRAMEIDANDROIDPROC get_next_frame_id_ = nullptr;
+  PFNEGLGETFRAMETIMESTAMPSANDROIDPROC get_frame_timestamps_ = nullptr;
+
+  // Written on the loop thread, read by GetStats().
+  mutable std::mutex stats_mutex_;
+  Stats stats_;
+  double latency_sum_ms_ = 0.0;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_NATIVE_FRAME_LOOP_H_
@@ -0,0 +1,314 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "obj_parser.h"
+
+#include <charconv>
+#include <cmath>
+#include <unordered_map>
+
+namespace hello_ar {
+namespace {
+
+// Powers of ten that are exactly representable as doubles.
+constexpr int kMaxExactPowerOfTen = 22;
+constexpr double kPowersOfTen[kMaxExactPowerOfTen + 1] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+// Index triple of one face corner.  Missing uv or normal indices are -1.
+struct CornerKey {
+  int32_t position;
+  int32_t uv;
+  int32_t normal;
+
+  bool operator==(const CornerKey& other) const {
+    return position == other.position && uv == other.uv &&
+           normal == other.normal;
+  }
+};
+
+struct CornerKeyHash {
+  size_t operator()(const CornerKey& key) const {
+    // Multiplicative mixing; the triples are small dense integers.
+    uint64_t hash = static_cast<uint32_t>(key.position);
+    hash = hash * 0x9E3779B97F4A7C15ull + static_cast<uint32_t>(key.uv);
+    hash = hash * 0x9E3779B97F4A7C15ull + static_cast<uint32_t>(key.normal);
+    return static_cast<size_t>(hash ^ (hash >> 32));
+  }
+};
+
+// Walks the OBJ text.  All parse functions advance |cursor_| past what they
+// consumed and never read at or beyond |end_|.
+class ObjReader {
+ public:
+  ObjReader(const char* data, size_t size)
+      : cursor_(data), end_(data + size) {}
+
+  bool AtEnd() const { return cursor_ >= end_; }
+
+  char Peek(size_t offset = 0) const {
+    return cursor_ + offset < end_ ? cursor_[offset] : '\0';
+  }
+
+  void Advance(size_t count) { cursor_ += count; }
+
+  void SkipSpaces() {
+    while (cursor_ < end_ && (*cursor_ == ' ' || *cursor_ == '\t' ||
+                              *cursor_ == '\r')) {
+      ++cursor_;
+    }
+  }
+
+  // Skips the rest of the current line including the line break.
+  void SkipLine() {
+    while (cursor_ < end_ && *cursor_ != '\n') {
+      ++cursor_;
+    }
+    if (cursor_ < end_) {
+      ++cursor_;
+    }
+  }
+
+  bool AtLineEnd() const { return cursor_ >= end_ || *cursor_ == '\n'; }
+
+  bool ParseInt(int32_t* out_value) {
+    // std::from_chars rejects a leading '+', which some exporters write.
+    if (cursor_ < end_ && *cursor_ == '+') {
+      ++cursor_;
+    }
+    std::from_chars_result result = std::from_chars(cursor_, end_, *out_value);
+    if (result.ec != std::errc()) {
+      return false;
+    }
+    cursor_ = result.ptr;
+    return true;
+  }
+
+  // Decimal floats with an optional exponent.  The NDK's std::from_chars has
+  // no floating point overload, so the mantissa is accumulated as an integer
+  // and scaled once by an exactly representable power of ten, which rounds
+  // correctly to float for the 6-9 significant digits OBJ exporters write.
+  bool ParseFloat(float* out_value) {
+    SkipSpaces();
+    bool negative = false;
+    if (cursor_ < end_ && (*cursor_ == '-' || *cursor_ == '+')) {
+      negative = *cursor_ == '-';
+      ++cursor_;
+    }
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    int digits = 0;
+    const char* start = cursor_;
+    while (cursor_ < end_ && IsDigit(*cursor_)) {
+      AccumulateDigit(*cursor_, &mantissa, &exponent, &digits);
+      ++cursor_;
+    }
+    if (cursor_ < end_ && *cursor_ == '.') {
+      ++cursor_;
+      while (cursor_ < end_ && IsDigit(*cursor_)) {
+        AccumulateDigit(*cursor_, &mantissa, &exponent, &digits);
+        --exponent;
+        ++cursor_;
+      }
+    }
+    if (cursor_ == start || (cursor_ == start + 1 && *start == '.')) {
+      return false;
+    }
+    if (cursor_ < end_ && (*cursor_ == 'e' || *cursor_ == 'E')) {
+      ++cursor_;
+      int32_t explicit_exponent = 0;
+      if (!ParseInt(&explicit_exponent)) {
+        return false;
+      }
+      exponent += explicit_exponent;
+    }
+    double value = static_cast<double>(mantissa);
+    if (exponent < 0 && exponent >= -kMaxExactPowerOfTen) {
+      value /= kPowersOfTen[-exponent];
+    } else if (exponent > 0 && exponent <= kMaxExactPowerOfTen) {
+      value *= kPowersOfTen[exponent];
+    } else if (exponent != 0) {
+      value *= std::pow(10.0, exponent);
+    }
+    *out_value = static_cast<float>(negative ? -value : value);
+    return true;
+  }
+
+ private:
+  static bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+
+  // Keeps the first 19 significant digits, which is all a uint64_t holds;
+  // later integer digits only scale the result.
+  static void AccumulateDigit(char c, uint64_t* mantissa, int* exponent,
+                              int* digits) {
+    if (*digits < 19) {
+      *mantissa = *mantissa * 10 + static_cast<uint64_t>(c - '0');
+      if (*mantissa != 0) {
+        ++*digits;
+      }
+    } else {
+      ++*exponent;
+    }
+  }
+
+  const char* cursor_;
+  const char* end_;
+};
+
+// Converts a 1-based or negative (relative to the end) OBJ index into a
+// 0-based one.  Returns -1 when the index is out of range.
+int32_t ResolveIndex(int32_t index, size_t count) {
+  const int64_t resolved =
+      index > 0 ? index - 1 : static_cast<int64_t>(count) + index;
+  return (resolved >= 0 && resolved < static_cast<int64_t>(count))
+             ? static_cast<int32_t>(resolved)
+             : -1;
+}
+
+bool Fail(const char* message, size_t line, std::string* out_error) {
+  if (out_error != nullptr) {
+    *out_error = std::string(message) + " on line " + std::to_string(line);
+  }
+  return false;
+}
+
+}  // namespace
+
+bool ParseObj(const char* data, size_t size, ObjMesh* out_mesh,
+              std::string* out_error) {
+  std::vector<float> positions;
+  std::vector<float> normals;
+  std::vector<float> uvs;
+  // A rough size estimate avoids most reallocations: typical OBJ lines are
+  // 30-40 bytes and roughly half the lines are faces.
+  const size_t estimated_lines = size / 32;
+  positions.reserve(estimated_lines);
+  normals.reserve(estimated_lines);
+  uvs.reserve(estimated_lines);
+
+  ObjMesh mesh;
+  mesh.indices.reserve(estimated_lines * 3 / 2);
+  std::unordered_map<CornerKey, uint32_t, CornerKeyHash> corner_lookup;
+  corner_lookup.reserve(estimated_lines / 2);
+  std::vector<uint32_t> face_corners;
+
+  ObjReader reader(data, size);
+  size_t line = 0;
+  while (!reader.AtEnd()) {
+    ++line;
+    reader.SkipSpaces();
+    const char tag = reader.Peek();
+    const char tag_suffix = reader.Peek(1);
+    const bool tag_ends = tag_suffix == ' ' || tag_suffix == '\t';
+
+    if (tag == 'v' && tag_ends) {
+      reader.Advance(1);
+      float position[3];
+      if (!reader.ParseFloat(&position[0]) ||
+          !reader.ParseFloat(&position[1]) ||
+          !reader.ParseFloat(&position[2])) {
+        return Fail("Format of 'v float float float' required", line,
+                    out_error);
+      }
+      positions.insert(positions.end(), position, position + 3);
+    } else if (tag == 'v' && tag_suffix == 'n') {
+      reader.Advance(2);
+      float normal[3];
+      if (!reader.ParseFloat(&normal[0]) || !reader.ParseFloat(&normal[1]) ||
+          !reader.ParseFloat(&normal[2])) {
+        return Fail("Format of 'vn float float float' required", line,
+                    out_error);
+      }
+      normals.insert(normals.end(), normal, normal + 3);
+    } else if (tag == 'v' && tag_suffix == 't') {
+      reader.Advance(2);
+      float uv[2];
+      if (!reader.ParseFloat(&uv[0]) || !reader.ParseFloat(&uv[1])) {
+        return Fail("Format of 'vt float float' required", line, out_error);
+      }
+      uvs.insert(uvs.end(), uv, uv + 2);
+    } else if (tag == 'f' && tag_ends) {
+      reader.Advance(1);
+      face_corners.clear();
+      const size_t position_count = positions.size() / 3;
+      const size_t normal_count = normals.size() / 3;
+      const size_t uv_count = uvs.size() / 2;
+      for (reader.SkipSpaces(); !reader.AtLineEnd(); reader.SkipSpaces()) {
+        CornerKey key = {-1, -1, -1};
+        int32_t index = 0;
+        if (!reader.ParseInt(&index) ||
+            (key.position = ResolveIndex(index, position_count)) < 0) {
+          return Fail("Invalid face vertex index", line, out_error);
+        }
+        if (reader.Peek() == '/') {
+          reader.Advance(1);
+          if (reader.Peek() != '/') {
+            if (!reader.ParseInt(&index) ||
+                (key.uv = ResolveIndex(index, uv_count)) < 0) {
+              return Fail("Invalid face uv index", line, out_error);
+            }
+          }
+          if (reader.Peek() == '/') {
+            reader.Advance(1);
+            if (!reader.ParseInt(&index) ||
+                (key.normal = ResolveIndex(index, normal_count)) < 0) {
+              return Fail("Invalid face normal index", line, out_error);
+            }
+          }
+        }
+
+        auto inserted = corner_lookup.emplace(
+            key, static_cast<uint32_t>(mesh.GetVertexCount()));
+        if (inserted.second) {
+          const float* position = &positions[key.position * 3];
+          mesh.vertices.insert(mesh.vertices.end(), position, position + 3);
+          if (key.normal >= 0) {
+            const float* normal = &normals[key.normal * 3];
+            mesh.vertices.insert(mesh.vertices.end(), normal, normal + 3);
+            mesh.has_normals = true;
+          } else {
+            mesh.vertices.insert(mesh.vertices.end(), 3, 0.0f);
+          }
+          if (key.uv >= 0) {
+            const float* uv = &uvs[key.uv * 2];
+            mesh.vertices.insert(mesh.vertices.end(), uv, uv + 2);
+            mesh.has_uvs = true;
+          } else {
+            mesh.vertices.insert(mesh.vertices.end(), 2, 0.0f);
+          }
+        }
+        face_corners.push_back(inserted.first->second);
+      }
+      if (face_corners.size() < 3) {
+        return Fail("Faces require at least three corners", line, out_error);
+      }
+      for (size_t i = 2; i < face_corners.size(); ++i) {
+        mesh.indices.push_back(face_corners[0]);
+        mesh.indices.push_back(face_corners[i - 1]);
+        mesh.indices.push_back(face_corners[i]);
+      }
+    }
+    // Comments, groups, materials and smoothing records are ignored, as is
+    // anything trailing the values parsed above.
+    reader.SkipLine();
+  }
+
+  *out_mesh = std::move(mesh);
+  return true;
+}
+
+}  // namespace hello_ar
@@ -0,0 +1,61 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_OBJ_PARSER_H_
+#define C_ARCORE_HELLOE_AR_OBJ_PARSER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace hello_ar {
+
+// Triangle mesh decoded from a Wavefront OBJ file.
+struct ObjMesh {
+  // Number of floats per vertex in |vertices|.
+  static constexpr int kVertexComponents = 8;
+
+  // Interleaved position (3), normal (3) and uv (2) floats per vertex.
+  // Attributes missing from the file are zero.
+  std::vector<float> vertices;
+  // Triangle list indices into |vertices|.
+  std::vector<uint32_t> indices;
+  bool has_normals = false;
+  bool has_uvs = false;
+
+  size_t GetVertexCount() const { return vertices.size() / kVertexComponents; }
+};
+
+// Parses OBJ text in a single pass without copying or tokenizing it.
+//
+// Supports 'v', 'vt', 'vn' and 'f' records, with face corners in any of the
+// v, v/vt, v//vn and v/vt/vn forms, negative (relative) indices and polygons
+// with any number of corners, which are triangulated as fans. Corners that
+// share the same (v, vt, vn) triple are emitted as one vertex. Other records
+// are ignored.
+//
+// @param data, OBJ text; it does not need to be null terminated.
+// @param size, length of |data| in bytes.
+// @param out_mesh, output mesh, overwritten on success.
+// @param out_error, if not null, receives a description of the first error.
+// @return true if the text is parsed correctly, otherwise false.
+bool ParseObj(const char* data, size_t size, ObjMesh* out_mesh,
+              std::string* out_error);
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_OBJ_PARSER_H_
@@ -16,91 +16,731 @@
 
 #include "obj_renderer.h"
 
+#include <GLES3/gl31.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+#include "asset_loader.h"
+#include "gl_upload_thread.h"
+#include "resource_accounting.h"
 #include "util.h"
 
 namespace hello_ar {
 namespace {
+constexpr char kOwner[] = "ObjRenderer";
 const glm::vec4 kLightDirection(0.0f, 1.0f, 0.0f, 0.0f);
-constexpr char kVertexShaderFilename[] = "shaders/ar_object.vert";
-constexpr char kFragmentShaderFilename[] = "shaders/ar_object.frag";
-constexpr char kUseDepthForOcclusionShaderFlag[] = "USE_DEPTH_FOR_OCCLUSION";
+
+// The occlusion mask has half the width and height of the viewport, a quarter
+// of its pixels.  The visibility varies slowly apart from object edges, which
+// the linear filtering of the mask softens like the blur it replaces.
+constexpr int kOcclusionMaskDownscale = 2;
+
+// Fullscreen quad of the mask resolve pass, drawn as a triangle strip.
+constexpr GLfloat kQuadPositions[] = {-1.0f, -1.0f, +1.0f, -1.0f,
+                                      -1.0f, +1.0f, +1.0f, +1.0f};
+constexpr GLfloat kQuadUvs[] = {0.0f, 0.0f, 1.0f, 0.0f,
+                                0.0f, 1.0f, 1.0f, 1.0f};
+// Models with this extension use the packed format from tools/obj_to_mesh.py.
+constexpr char kBinaryMeshExtension[] = ".mesh";
+
+// Vertices are uploaded as util::QuantizedVertex and decoded by the vertex
+// shaders: unsigned normalized position (xyz and w = 1), octahedral normal
+// and half float uv.
+constexpr int kPositionComponents = 4;
+constexpr int kNormalComponents = 2;
+constexpr int kUvComponents = 2;
+constexpr GLsizei kVertexStride = sizeof(util::QuantizedVertex);
+constexpr size_t kNormalOffset = offsetof(util::QuantizedVertex, normal);
+constexpr size_t kUvOffset = offsetof(util::QuantizedVertex, uv);
+// Interleaved position (3), normal (3) and uv (2) floats of version 1 meshes
+// and OBJ files, quantized on load.
+constexpr GLsizei kFloatVertexStride =
+    ObjMesh::kVertexComponents * sizeof(GLfloat);
+
+// Suffixes of the optional reduced level of detail variants of a model.
+constexpr const char* kLodSuffixes[ObjRenderer::kMaxLodCount - 1] = {"_lod1",
+                                                                     "_lod2"};
+
+// Screen height fraction below which a copy switches from level i to level
+// i + 1, and the relative margin around it that has to be crossed before the
+// level changes again.
+constexpr float kLodSwitchFractions[ObjRenderer::kMaxLodCount - 1] = {0.2f,
+                                                                      0.07f};
+constexpr float kLodHysteresis = 0.15f;
+
+// Culls the instances and selects their level of detail on the GPU.
+constexpr char kInstanceCullShaderFileName[] = "shaders/instance_cull.comp";
+// Must match local_size_x of the culling shader.
+constexpr GLuint kCullWorkGroupSize = 64;
+// The culling shader writes one buffer block per level.
+static_assert(ObjRenderer::kMaxLodCount == 3,
+              "instance_cull.comp needs one output block per level");
+static_assert(sizeof(ObjRenderer::Instance) == 20 * sizeof(float),
+              "ObjRenderer::Instance must match its std430 layout");
+
+// Meshes with at most this many vertices are drawn with 16-bit indices.
+constexpr size_t kMaxShortIndexedVertices = 65536;
+
+// A mat4 attribute occupies four consecutive vec4 attribute locations.
+constexpr int kMatrixColumns = 4;
+constexpr GLsizei kInstanceStride = sizeof(ObjRenderer::Instance);
+
+// Points the four vec4 locations of a mat4 instanced attribute at the model
+// matrix of the instance buffer bound to GL_ARRAY_BUFFER.
+void SetModelMatrixAttribute(GLint model_mat_attrib) {
+  for (int column = 0; column < kMatrixColumns; ++column) {
+    const GLuint location = model_mat_attrib + column;
+    glEnableVertexAttribArray(location);
+    glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, kInstanceStride,
+                          reinterpret_cast<const void*>(
+                              offsetof(ObjRenderer::Instance, model_mat) +
+                              column * sizeof(glm::vec4)));
+    glVertexAttribDivisor(location, 1);
+  }
+}
+
+// Allocates storage for a mask target texture and sets nearest filtering,
+// leaving the texture bound to GL_TEXTURE_2D.
+void AllocateTargetTexture(GLuint texture, GLint internal_format,
+                           GLenum format, GLenum type, GLenum filter,
+                           int width, int height) {
+  util::GlStateCache::Get().BindTexture(GL_TEXTURE_2D, texture);
+  glTexImage2D(GL_TEXTURE_2D, 0, internal_format, width, height, 0, format,
+               type, nullptr);
+  ResourceAccounting::Get().Track(
+      GpuResourceType::kTexture, texture,
+      GetTextureBytes(internal_format, width, height), kOwner);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
 }  // namespace
 
+// A level of detail read into memory, on any thread, ready to be uploaded.
+// Binary meshes in the GPU layout stay mapped; the vertices of others are
+// quantized into |vertices|.
+struct ObjRenderer::MeshData {
+  util::MeshAsset asset;
+  std::vector<util::QuantizedVertex> vertices;
+  std::vector<GLushort> short_indices;
+  std::vector<GLuint> indices;
+
+  const void* vertex_data = nullptr;
+  size_t vertex_data_size = 0;
+  const void* index_data = nullptr;
+  size_t index_data_size = 0;
+  GLenum index_type = GL_UNSIGNED_SHORT;
+  GLsizei index_count = 0;
+  glm::vec3 position_offset = glm::vec3(0.0f);
+  glm::vec3 position_scale = glm::vec3(1.0f);
+  glm::vec4 bounding_sphere = glm::vec4(0.0f);
+};
+
 void ObjRenderer::InitializeGlContent(AAssetManager* asset_manager,
                                       const std::string& obj_file_name,
-                                      const std::string& png_file_name) {
-  compileAndLoadShaderProgram(asset_manager);
-  position_attrib_ = glGetAttribLocation(shader_program_, "a_Position");
-  tex_coord_attrib_ = glGetAttribLocation(shader_program_, "a_TexCoord");
-  normal_attrib_ = glGetAttribLocation(shader_program_, "a_Normal");
+                                      const std::string& png_file_name,
+                                      AssetLoader* asset_loader) {
+  compileAndLoadShaderPrograms(asset_manager);
+
+  // Models that share a material share its texture.
+  texture_id_ = util::TextureCache::Get().Acquire(
+      png_file_name.c_str(), GL_REPEAT, GL_LINEAR_MIPMAP_NEAREST);
 
-  glGenTextures(1, &texture_id_);
-  glBindTexture(GL_TEXTURE_2D, texture_id_);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
-                  GL_LINEAR_MIPMAP_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glGenBuffers(1, &instance_buffer_);
+  InitializeGpuCulling(asset_manager);
 
-  if (!util::LoadPngFromAssetManager(GL_TEXTURE_2D, png_file_name.c_str())) {
-    LOGE("Could not load png texture for planes.");
+  // Levels still streaming for a previous context are not uploaded.
+  ++stream_generation_;
+  lods_.clear();
+  std::vector<std::string> file_names = {obj_file_name};
+  const size_t extension_start = obj_file_name.rfind('.');
+  const std::string stem = obj_file_name.substr(0, extension_start);
+  const std::string extension = extension_start == std::string::npos
+                                    ? std::string()
+                                    : obj_file_name.substr(extension_start);
+  for (const char* suffix : kLodSuffixes) {
+    const std::string lod_file_name = stem + suffix + extension;
+    AAsset* asset = AAssetManager_open(asset_manager, lod_file_name.c_str(),
+                                       AASSET_MODE_UNKNOWN);
+    if (asset == nullptr) {
+      break;  // Levels are only used in order.
+    }
+    AAsset_close(asset);
+    file_names.push_back(lod_file_name);
+  }
+  lods_.resize(file_names.size());
+  for (MeshLod& lod : lods_) {
+    CreateVertexArrays(&lod);
   }
-  glGenerateMipmap(GL_TEXTURE_2D);
 
-  glBindTexture(GL_TEXTURE_2D, 0);
+  // With a loader only the coarsest level blocks, and the finer ones follow
+  // from the coarsest up, so that a copy always has something to draw.
+  const int coarsest = static_cast<int>(file_names.size()) - 1;
+  const int first_blocking = asset_loader != nullptr ? coarsest : 0;
+  for (int lod = first_blocking; lod <= coarsest; ++lod) {
+    MeshData mesh;
+    if (!ReadMesh(asset_manager, file_names[lod], &mesh)) {
+      LOGE("Could not load obj file %s.", file_names[lod].c_str());
+      continue;
+    }
+    UploadMesh(lod, mesh, /*fenced=*/false);
+  }
+  for (int lod = first_blocking - 1; lod >= 0; --lod) {
+    SubmitLodLoad(asset_loader, asset_manager, file_names[lod], lod);
+  }
+  UpdateDrawnLods();
 
-  util::LoadObjFile(obj_file_name, asset_manager, &vertices_, &normals_, &uvs_,
-                    &indices_);
+  glGenTextures(1, &occlusion_depth_texture_);
+  glGenTextures(1, &occlusion_mask_texture_);
+  glGenFramebuffers(1, &occlusion_depth_framebuffer_);
+  glGenFramebuffers(1, &occlusion_mask_framebuffer_);
+  if (viewport_width_ > 0 && viewport_height_ > 0) {
+    CreateOcclusionMaskTargets();
+  }
 
   util::CheckGlError("obj_renderer::InitializeGlContent()");
 }
 
-void ObjRenderer::setUseDepthForOcclusion(AAssetManager* asset_manager,
-                                          bool use_depth_for_occlusion) {
+void ObjRenderer::UpdateStreamedLods() {
+  bool became_resident = false;
+  for (MeshLod& lod : lods_) {
+    if (lod.upload_fence == nullptr) {
+      continue;
+    }
+    const GLenum status = glClientWaitSync(lod.upload_fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+      continue;
+    }
+    glDeleteSync(lod.upload_fence);
+    lod.upload_fence = nullptr;
+    lod.resident = true;
+    became_resident = true;
+  }
+  if (became_resident) {
+    UpdateDrawnLods();
+  }
+}
+
+void ObjRenderer::SubmitLodLoad(AssetLoader* asset_loader,
+                                AAssetManager* asset_manager,
+                                const std::string& file_name, int lod) {
+  const uint64_t generation = stream_generation_;
+  asset_loader->Submit([this, asset_manager, file_name, lod, generation,
+                        asset_loader]() -> AssetLoader::Upload {
+    auto mesh = std::make_shared<MeshData>();
+    if (!ReadMesh(asset_manager, file_name, mesh.get())) {
+      LOGE("Could not load level of detail %s.", file_name.c_str());
+      return AssetLoader::Upload();
+    }
+
+    GlUploadThread* upload_thread = asset_loader->GetUploadThread();
+    if (upload_thread != nullptr &&
+        upload_thread->Submit([this, mesh, lod,
+                               generation]() -> GlUploadThread::Publish {
+          GLuint vertex_buffer = 0;
+          GLuint index_buffer = 0;
+          CreateMeshBuffers(*mesh, &vertex_buffer, &index_buffer);
+          // The publish runs once the GPU has the data, so the level is
+          // resident right away.
+          return [this, mesh, lod, generation, vertex_buffer, index_buffer] {
+            if (generation != stream_generation_) {
+              ResourceAccounting& accounting = ResourceAccounting::Get();
+              accounting.Untrack(GpuResourceType::kBuffer, vertex_buffer);
+              accounting.Untrack(GpuResourceType::kBuffer, index_buffer);
+              const GLuint buffers[] = {vertex_buffer, index_buffer};
+              glDeleteBuffers(2, buffers);
+              return;
+            }
+            AdoptMesh(lod, *mesh, vertex_buffer, index_buffer);
+            lods_[lod].resident = true;
+            UpdateDrawnLods();
+          };
+        })) {
+      return AssetLoader::Upload();
+    }
+    return [this, mesh, lod, generation] {
+      if (generation == stream_generation_) {
+        UploadMesh(lod, *mesh, /*fenced=*/true);
+      }
+    };
+  });
+}
+
+bool ObjRenderer::ReadMesh(AAssetManager* asset_manager,
+                           const std::string& file_name, MeshData* out_mesh) {
+  const std::string mesh_extension = kBinaryMeshExtension;
+  const bool is_binary_mesh =
+      file_name.size() >= mesh_extension.size() &&
+      file_name.compare(file_name.size() - mesh_extension.size(),
+                        mesh_extension.size(), mesh_extension) == 0;
+  return is_binary_mesh ? ReadBinaryMesh(asset_manager, file_name, out_mesh)
+                        : ReadObjMesh(asset_manager, file_name, out_mesh);
+}
+
+bool ObjRenderer::ReadBinaryMesh(AAssetManager* asset_manager,
+                                 const std::string& mesh_file_name,
+                                 MeshData* out_mesh) {
+  util::MeshAsset& mesh = out_mesh->asset;
+  if (!mesh.Open(mesh_file_name.c_str(), asset_manager)) {
+    return false;
+  }
+  const util::MeshFileHeader& header = mesh.GetHeader();
+  if (header.vertex_stride == kVertexStride && header.version >= 2) {
+    // The mapped asset is already in the GPU layout, so it is uploaded as is.
+    out_mesh->vertex_data = mesh.GetVertexData();
+    out_mesh->vertex_data_size = mesh.GetVertexDataSize();
+    out_mesh->position_offset = glm::make_vec3(header.position_offset);
+    out_mesh->position_scale = glm::make_vec3(header.position_scale);
+  } else if (header.vertex_stride == kFloatVertexStride) {
+    util::QuantizeVertices(static_cast<const float*>(mesh.GetVertexData()),
+                           header.vertex_count, &out_mesh->vertices,
+                           &out_mesh->position_offset,
+                           &out_mesh->position_scale);
+    out_mesh->vertex_data = out_mesh->vertices.data();
+    out_mesh->vertex_data_size =
+        out_mesh->vertices.size() * sizeof(util::QuantizedVertex);
+  } else {
+    LOGE("Mesh %s has vertex stride %u, expected %d or %d",
+         mesh_file_name.c_str(), header.vertex_stride, kVertexStride,
+         kFloatVertexStride);
+    return false;
+  }
+  out_mesh->index_data = mesh.GetIndexData();
+  out_mesh->index_data_size = mesh.GetIndexDataSize();
+  out_mesh->index_type = mesh.GetIndexType();
+  out_mesh->index_count = static_cast<GLsizei>(header.index_count);
+  out_mesh->bounding_sphere =
+      glm::vec4(header.bounding_sphere[0], header.bounding_sphere[1],
+                header.bounding_sphere[2], header.bounding_sphere[3]);
+  return true;
+}
+
+bool ObjRenderer::ReadObjMesh(AAssetManager* asset_manager,
+                              const std::string& obj_file_name,
+                              MeshData* out_mesh) {
+  ObjMesh mesh;
+  if (!util::LoadObjFile(obj_file_name, asset_manager, &mesh)) {
+    return false;
+  }
+  // Same bounding sphere as tools/obj_to_mesh.py: centered on the bounding
+  // box, with the radius reaching the farthest vertex.
+  const size_t vertex_count = mesh.GetVertexCount();
+  glm::vec3 lower(0.0f);
+  glm::vec3 upper(0.0f);
+  for (size_t i = 0; i < vertex_count; ++i) {
+    const float* p = &mesh.vertices[i * ObjMesh::kVertexComponents];
+    const glm::vec3 position(p[0], p[1], p[2]);
+    lower = i == 0 ? position : glm::min(lower, position);
+    upper = i == 0 ? position : glm::max(upper, position);
+  }
+  const glm::vec3 center = (lower + upper) * 0.5f;
+  float radius = 0.0f;
+  for (size_t i = 0; i < vertex_count; ++i) {
+    const float* p = &mesh.vertices[i * ObjMesh::kVertexComponents];
+    radius = std::max(radius, glm::length(glm::vec3(p[0], p[1], p[2]) - center));
+  }
+  out_mesh->bounding_sphere = glm::vec4(center, radius);
+
+  util::QuantizeVertices(mesh.vertices.data(), vertex_count,
+                         &out_mesh->vertices, &out_mesh->position_offset,
+                         &out_mesh->position_scale);
+  out_mesh->vertex_data = out_mesh->vertices.data();
+  out_mesh->vertex_data_size =
+      out_mesh->vertices.size() * sizeof(util::QuantizedVertex);
+
+  // Narrows the indices when they fit, halving the index buffer.
+  out_mesh->index_count = static_cast<GLsizei>(mesh.indices.size());
+  if (vertex_count <= kMaxShortIndexedVertices) {
+    out_mesh->short_indices.assign(mesh.indices.begin(), mesh.indices.end());
+    out_mesh->index_data = out_mesh->short_indices.data();
+    out_mesh->index_data_size =
+        out_mesh->short_indices.size() * sizeof(GLushort);
+    out_mesh->index_type = GL_UNSIGNED_SHORT;
+  } else {
+    out_mesh->indices = std::move(mesh.indices);
+    out_mesh->index_data = out_mesh->indices.data();
+    out_mesh->index_data_size = out_mesh->indices.size() * sizeof(GLuint);
+    out_mesh->index_type = GL_UNSIGNED_INT;
+  }
+  return true;
+}
+
+void ObjRenderer::CreateVertexArrays(MeshLod* lod) const {
+  glGenVertexArrays(1, &lod->vertex_array);
+  glGenVertexArrays(1, &lod->depth_pass_vertex_array);
+  if (IsGpuCullingSupported()) {
+    glGenVertexArrays(1, &lod->indirect_vertex_array);
+    glGenVertexArrays(1, &lod->indirect_depth_pass_vertex_array);
+  }
+}
+
+void ObjRenderer::UploadMesh(int lod_index, const MeshData& mesh,
+                             bool fenced) {
+  // The element array binding belongs to the bound vertex array, which has
+  // to be the default one to be left as the other renderers expect.
+  util::GlStateCache::Get().BindVertexArray(0);
+  GLuint vertex_buffer = 0;
+  GLuint index_buffer = 0;
+  CreateMeshBuffers(mesh, &vertex_buffer, &index_buffer);
+  AdoptMesh(lod_index, mesh, vertex_buffer, index_buffer);
+
+  MeshLod& lod = lods_[lod_index];
+  if (!fenced) {
+    lod.resident = true;
+    return;
+  }
+  // Drawn from once the copies are done, so that no draw waits for them.
+  lod.upload_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  if (lod.upload_fence == nullptr) {
+    lod.resident = true;
+    UpdateDrawnLods();
+  }
+}
+
+void ObjRenderer::CreateMeshBuffers(const MeshData& mesh,
+                                    GLuint* vertex_buffer,
+                                    GLuint* index_buffer) {
+  glGenBuffers(1, vertex_buffer);
+  glGenBuffers(1, index_buffer);
+  glBindBuffer(GL_ARRAY_BUFFER, *vertex_buffer);
+  glBufferData(GL_ARRAY_BUFFER, mesh.vertex_data_size, mesh.vertex_data,
+               GL_STATIC_DRAW);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, *index_buffer);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.index_data_size, mesh.index_data,
+               GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  ResourceAccounting& accounting = ResourceAccounting::Get();
+  accounting.Track(GpuResourceType::kBuffer, *vertex_buffer,
+                   mesh.vertex_data_size, kOwner);
+  accounting.Track(GpuResourceType::kBuffer, *index_buffer,
+                   mesh.index_data_size, kOwner);
+}
+
+void ObjRenderer::AdoptMesh(int lod_index, const MeshData& mesh,
+                            GLuint vertex_buffer, GLuint index_buffer) {
+  MeshLod& lod = lods_[lod_index];
+  lod.index_type = mesh.index_type;
+  lod.index_count = mesh.index_count;
+  lod.position_offset = mesh.position_offset;
+  lod.position_scale = mesh.position_scale;
+  lod.bounding_sphere = mesh.bounding_sphere;
+  lod.vertex_buffer = vertex_buffer;
+  lod.index_buffer = index_buffer;
+}
+
+void ObjRenderer::UpdateDrawnLods() {
+  const int lod_count = static_cast<int>(lods_.size());
+  for (int i = 0; i < lod_count; ++i) {
+    // The nearest resident level, preferring the coarser ones.
+    int drawn = -1;
+    for (int j = i; j < lod_count && drawn < 0; ++j) {
+      drawn = lods_[j].resident ? j : -1;
+    }
+    for (int j = i - 1; j >= 0 && drawn < 0; --j) {
+      drawn = lods_[j].resident ? j : -1;
+    }
+    lods_[i].drawn_lod = drawn;
+  }
+  // Culling uses the bounds of the finest level there is.
+  for (const MeshLod& lod : lods_) {
+    if (lod.resident) {
+      bounding_sphere_ = lod.bounding_sphere;
+      break;
+    }
+  }
+  ConfigureVertexArray();
+}
+
+void ObjRenderer::setUseDepthForOcclusion(bool use_depth_for_occlusion) {
   if (use_depth_for_occlusion_ == use_depth_for_occlusion) {
     return;  // No change, does nothing.
   }
 
-  // Toggles the occlusion rendering mode and recompiles the shader.
+  // Toggles the occlusion rendering mode by switching to the prebuilt variant.
   use_depth_for_occlusion_ = use_depth_for_occlusion;
-  compileAndLoadShaderProgram(asset_manager);
+  selectShaderProgram();
 }
 
-void ObjRenderer::compileAndLoadShaderProgram(AAssetManager* asset_manager) {
-  // Compiles and loads the shader program based on the selected mode.
-  std::map<std::string, int> define_values_map;
-  define_values_map[kUseDepthForOcclusionShaderFlag] =
-      use_depth_for_occlusion_ ? 1 : 0;
+void ObjRenderer::SetUseOcclusionMask(bool use_occlusion_mask) {
+  if (use_occlusion_mask_ == use_occlusion_mask) {
+    return;
+  }
+  use_occlusion_mask_ = use_occlusion_mask;
+  selectShaderProgram();
+}
 
-  shader_program_ =
-      util::CreateProgram(kVertexShaderFilename, kFragmentShaderFilename,
-                          asset_manager, define_values_map);
-  if (!shader_program_) {
-    LOGE("Could not create program.");
+void ObjRenderer::SetViewportSize(int width, int height) {
+  if (width == viewport_width_ && height == viewport_height_) {
+    return;
+  }
+  viewport_width_ = width;
+  viewport_height_ = height;
+  if (occlusion_depth_texture_) {
+    CreateOcclusionMaskTargets();
   }
+}
+
+void ObjRenderer::CreateOcclusionMaskTargets() {
+  const int width = std::max(viewport_width_ / kOcclusionMaskDownscale, 1);
+  const int height = std::max(viewport_height_ / kOcclusionMaskDownscale, 1);
+
+  // Depth values are read back exactly, while the visibility is filtered
+  // when objects sample it at full resolution.
+  AllocateTargetTexture(occlusion_depth_texture_, GL_DEPTH_COMPONENT24,
+                        GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, GL_NEAREST, width,
+                        height);
+  AllocateTargetTexture(occlusion_mask_texture_, GL_R8, GL_RED,
+                        GL_UNSIGNED_BYTE, GL_LINEAR, width, height);
 
-  mvp_mat_uniform_ =
-      glGetUniformLocation(shader_program_, "u_ModelViewProjection");
-  mv_mat_uniform_ = glGetUniformLocation(shader_program_, "u_ModelView");
+  glBindFramebuffer(GL_FRAMEBUFFER, occlusion_depth_framebuffer_);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D,
+                         occlusion_depth_texture_, 0);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    LOGE("ObjRenderer: occlusion depth framebuffer is incomplete.");
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, occlusion_mask_framebuffer_);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                         occlusion_mask_texture_, 0);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    LOGE("ObjRenderer: occlusion mask framebuffer is incomplete.");
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  util::CheckGlError("obj_renderer::CreateOcclusionMaskTargets()");
+}
+
+ShaderVariant ObjRenderer::GetVariantShader(int variant) {
+  switch (variant) {
+    case kPerFragmentOcclusion:
+      return ShaderVariant::kObjectPerFragmentOcclusion;
+    case kMaskOcclusion:
+      return ShaderVariant::kObjectMaskOcclusion;
+    default:
+      return ShaderVariant::kObject;
+  }
+}
+
+void ObjRenderer::compileAndLoadShaderPrograms(AAssetManager* asset_manager) {
+  // Compiles every variant now so that switching modes later is free.  The
+  // util program cache makes this a binary reload after the first run.
+  for (int variant = 0; variant < kNumOcclusionVariants; ++variant) {
+    shader_programs_[variant] =
+        util::CreateProgram(GetVariantShader(variant), asset_manager);
+    if (!shader_programs_[variant]) {
+      LOGE("Could not create program.");
+    }
+  }
+
+  depth_pass_program_ =
+      util::CreateProgram(ShaderVariant::kOcclusionDepth, asset_manager);
+  if (!depth_pass_program_) {
+    LOGE("Could not create occlusion depth program.");
+  }
+  depth_pass_position_attrib_ =
+      glGetAttribLocation(depth_pass_program_, "a_Position");
+  depth_pass_model_mat_attrib_ =
+      glGetAttribLocation(depth_pass_program_, "a_ModelMatrix");
+  depth_pass_view_mat_uniform_ =
+      glGetUniformLocation(depth_pass_program_, "u_View");
+  depth_pass_projection_mat_uniform_ =
+      glGetUniformLocation(depth_pass_program_, "u_Projection");
+  depth_pass_position_offset_uniform_ =
+      glGetUniformLocation(depth_pass_program_, "u_PositionOffset");
+  depth_pass_position_scale_uniform_ =
+      glGetUniformLocation(depth_pass_program_, "u_PositionScale");
+
+  resolve_program_ =
+      util::CreateProgram(ShaderVariant::kOcclusionResolve, asset_manager);
+  if (!resolve_program_) {
+    LOGE("Could not create occlusion mask program.");
+  }
+  resolve_position_attrib_ = glGetAttribLocation(resolve_program_, "a_Position");
+  resolve_tex_coord_attrib_ =
+      glGetAttribLocation(resolve_program_, "a_TexCoord");
+  resolve_virtual_depth_uniform_ =
+      glGetUniformLocation(resolve_program_, "u_VirtualDepth");
+  resolve_depth_texture_uniform_ =
+      glGetUniformLocation(resolve_program_, "u_DepthTexture");
+  resolve_depth_uv_transform_uniform_ =
+      glGetUniformLocation(resolve_program_, "u_DepthUvTransform");
+  resolve_depth_aspect_ratio_uniform_ =
+      glGetUniformLocation(resolve_program_, "u_DepthAspectRatio");
+  resolve_depth_confidence_threshold_uniform_ =
+      glGetUniformLocation(resolve_program_, "u_DepthConfidenceThreshold");
+  resolve_depth_linearization_uniform_ =
+      glGetUniformLocation(resolve_program_, "u_DepthLinearization");
+  resolve_use_depth_pyramid_uniform_ =
+      glGetUniformLocation(resolve_program_, "u_UseDepthPyramid");
+  resolve_depth_pyramid_uniform_ =
+      glGetUniformLocation(resolve_program_, "u_DepthPyramid");
+  resolve_depth_texture_size_uniform_ =
+      glGetUniformLocation(resolve_program_, "u_DepthTextureSize");
+  resolve_depth_pyramid_layout_uniform_ =
+      glGetUniformLocation(resolve_program_, "u_DepthPyramidLayout");
+  resolve_use_occlusion_blur_uniform_ =
+      glGetUniformLocation(resolve_program_, "u_UseOcclusionBlur");
+  resolve_occlusion_blur_uniform_ =
+      glGetUniformLocation(resolve_program_, "u_OcclusionBlur");
+
+  selectShaderProgram();
+}
+
+void ObjRenderer::selectShaderProgram() {
+  OcclusionVariant variant = kNoOcclusion;
+  if (use_depth_for_occlusion_) {
+    variant = use_occlusion_mask_ ? kMaskOcclusion : kPerFragmentOcclusion;
+  }
+  shader_program_ = shader_programs_[variant];
+
+  position_attrib_ = glGetAttribLocation(shader_program_, "a_Position");
+  tex_coord_attrib_ = glGetAttribLocation(shader_program_, "a_TexCoord");
+  normal_attrib_ = glGetAttribLocation(shader_program_, "a_Normal");
+
+  model_mat_attrib_ = glGetAttribLocation(shader_program_, "a_ModelMatrix");
+  color_attrib_ = glGetAttribLocation(shader_program_, "a_ObjColor");
+
+  view_mat_uniform_ = glGetUniformLocation(shader_program_, "u_View");
+  projection_mat_uniform_ =
+      glGetUniformLocation(shader_program_, "u_Projection");
+  position_offset_uniform_ =
+      glGetUniformLocation(shader_program_, "u_PositionOffset");
+  position_scale_uniform_ =
+      glGetUniformLocation(shader_program_, "u_PositionScale");
   texture_uniform_ = glGetUniformLocation(shader_program_, "u_Texture");
 
-  lighting_param_uniform_ =
-      glGetUniformLocation(shader_program_, "u_LightingParameters");
+  light_direction_uniform_ =
+      glGetUniformLocation(shader_program_, "u_LightDirection");
   material_param_uniform_ =
       glGetUniformLocation(shader_program_, "u_MaterialParameters");
   color_correction_param_uniform_ =
       glGetUniformLocation(shader_program_, "u_ColorCorrectionParameters");
-  color_uniform_ = glGetUniformLocation(shader_program_, "u_ObjColor");
+  use_environmental_hdr_uniform_ =
+      glGetUniformLocation(shader_program_, "u_UseEnvironmentalHdr");
+  environment_cubemap_uniform_ =
+      glGetUniformLocation(shader_program_, "u_EnvironmentCubemap");
+  environment_level_uniform_ =
+      glGetUniformLocation(shader_program_, "u_EnvironmentLevel");
+  spherical_harmonics_uniform_ =
+      glGetUniformLocation(shader_program_, "u_SphericalHarmonics");
 
   // Occlusion Uniforms.
-  if (use_depth_for_occlusion_) {
+  if (variant == kMaskOcclusion) {
+    occlusion_mask_uniform_ =
+        glGetUniformLocation(shader_program_, "u_OcclusionMask");
+  } else if (variant == kPerFragmentOcclusion) {
     depth_texture_uniform_ =
         glGetUniformLocation(shader_program_, "u_DepthTexture");
     depth_uv_transform_uniform_ =
         glGetUniformLocation(shader_program_, "u_DepthUvTransform");
     depth_aspect_ratio_uniform_ =
         glGetUniformLocation(shader_program_, "u_DepthAspectRatio");
+    depth_confidence_threshold_uniform_ =
+        glGetUniformLocation(shader_program_, "u_DepthConfidenceThreshold");
+    use_depth_pyramid_uniform_ =
+        glGetUniformLocation(shader_program_, "u_UseDepthPyramid");
+    depth_pyramid_uniform_ =
+        glGetUniformLocation(shader_program_, "u_DepthPyramid");
+    depth_texture_size_uniform_ =
+        glGetUniformLocation(shader_program_, "u_DepthTextureSize");
+    depth_pyramid_layout_uniform_ =
+        glGetUniformLocation(shader_program_, "u_DepthPyramidLayout");
+    use_occlusion_blur_uniform_ =
+        glGetUniformLocation(shader_program_, "u_UseOcclusionBlur");
+    occlusion_blur_uniform_ =
+        glGetUniformLocation(shader_program_, "u_OcclusionBlur");
+  }
+
+  ConfigureVertexArray();
+}
+
+void ObjRenderer::ConfigureVertexArray() {
+  // Nothing to do while the geometry is not uploaded yet.
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
+  for (size_t i = 0; i < lods_.size(); ++i) {
+    const MeshLod& lod = lods_[i];
+    if (lod.drawn_lod < 0) {
+      continue;
+    }
+    // The arrays of a level read the geometry of the level drawn in its
+    // place, and the level's own instances.
+    const MeshLod& geometry = lods_[lod.drawn_lod];
+    gl_state.BindVertexArray(lod.vertex_array);
+    glBindBuffer(GL_ARRAY_BUFFER, geometry.vertex_buffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, geometry.index_buffer);
+    ConfigureVertexAttributes(instance_buffer_);
+
+    gl_state.BindVertexArray(lod.depth_pass_vertex_array);
+    glBindBuffer(GL_ARRAY_BUFFER, geometry.vertex_buffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, geometry.index_buffer);
+    ConfigureDepthPassVertexAttributes(instance_buffer_);
+
+    if (lod.indirect_vertex_array != 0) {
+      gl_state.BindVertexArray(lod.indirect_vertex_array);
+      glBindBuffer(GL_ARRAY_BUFFER, geometry.vertex_buffer);
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, geometry.index_buffer);
+      ConfigureVertexAttributes(lod_instance_buffers_[i]);
+
+      gl_state.BindVertexArray(lod.indirect_depth_pass_vertex_array);
+      glBindBuffer(GL_ARRAY_BUFFER, geometry.vertex_buffer);
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, geometry.index_buffer);
+      ConfigureDepthPassVertexAttributes(lod_instance_buffers_[i]);
+    }
   }
+  gl_state.BindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void ObjRenderer::ConfigureVertexAttributes(GLuint instance_buffer) {
+  glEnableVertexAttribArray(position_attrib_);
+  glVertexAttribPointer(position_attrib_, kPositionComponents,
+                        GL_UNSIGNED_SHORT, GL_TRUE, kVertexStride, nullptr);
+
+  glEnableVertexAttribArray(normal_attrib_);
+  glVertexAttribPointer(normal_attrib_, kNormalComponents, GL_SHORT, GL_TRUE,
+                        kVertexStride,
+                        reinterpret_cast<const void*>(kNormalOffset));
+
+  glEnableVertexAttribArray(tex_coord_attrib_);
+  glVertexAttribPointer(tex_coord_attrib_, kUvComponents, GL_HALF_FLOAT,
+                        GL_FALSE, kVertexStride,
+                        reinterpret_cast<const void*>(kUvOffset));
+
+  // Per-instance attributes advance once per drawn copy of the model.
+  glBindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+  SetModelMatrixAttribute(model_mat_attrib_);
+  glEnableVertexAttribArray(color_attrib_);
+  glVertexAttribPointer(
+      color_attrib_, 4, GL_FLOAT, GL_FALSE, kInstanceStride,
+      reinterpret_cast<const void*>(offsetof(Instance, color)));
+  glVertexAttribDivisor(color_attrib_, 1);
+}
+
+void ObjRenderer::ConfigureDepthPassVertexAttributes(GLuint instance_buffer) {
+  glEnableVertexAttribArray(depth_pass_position_attrib_);
+  glVertexAttribPointer(depth_pass_position_attrib_, kPositionComponents,
+                        GL_UNSIGNED_SHORT, GL_TRUE, kVertexStride, nullptr);
+
+  glBindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+  SetModelMatrixAttribute(depth_pass_model_mat_attrib_);
+}
+
+int ObjRenderer::SelectLod(float screen_fraction, int current_lod) const {
+  const int lod_count = GetLodCount();
+  int lod = std::min(std::max(current_lod, 0), lod_count - 1);
+  while (lod + 1 < lod_count &&
+         screen_fraction < kLodSwitchFractions[lod] * (1.0f - kLodHysteresis)) {
+    ++lod;
+  }
+  while (lod > 0 && screen_fraction >
+                        kLodSwitchFractions[lod - 1] * (1.0f + kLodHysteresis)) {
+    --lod;
+  }
+  return lod;
 }
 
 void ObjRenderer::SetMaterialProperty(float ambient, float diffuse,
@@ -111,80 +751,468 @@ void ObjRenderer::SetMaterialProperty(float ambient, float diffuse,
   specular_power_ = specular_power;
 }
 
+void ObjRenderer::SetEnvironmentalHdr(GLuint cubemap_texture, int level_count,
+                                      const float* spherical_harmonics27) {
+  environment_cubemap_texture_ = cubemap_texture;
+  environment_level_count_ = level_count;
+  if (cubemap_texture != 0) {
+    std::copy(spherical_harmonics27, spherical_harmonics27 + 27,
+              spherical_harmonics_.begin());
+  }
+}
+
 void ObjRenderer::Draw(const glm::mat4& projection_mat,
                        const glm::mat4& view_mat, const glm::mat4& model_mat,
                        const float* color_correction4,
                        const float* object_color4) const {
+  const Instance instance = {model_mat, glm::make_vec4(object_color4)};
+  DrawInstanced(projection_mat, view_mat, &instance, 1, color_correction4);
+}
+
+void ObjRenderer::DrawInstanced(const glm::mat4& projection_mat,
+                                const glm::mat4& view_mat,
+                                const Instance* instances,
+                                size_t instance_count,
+                                const float* color_correction4,
+                                int lod) const {
+  const InstanceGroup group = {instances, instance_count, lod};
+  DrawGroups(projection_mat, view_mat, &group, 1, color_correction4);
+}
+
+void ObjRenderer::DrawInstanced(const glm::mat4& projection_mat,
+                                const glm::mat4& view_mat,
+                                const LodInstances& instances,
+                                const float* color_correction4) const {
+  InstanceGroup groups[kMaxLodCount];
+  for (int lod = 0; lod < kMaxLodCount; ++lod) {
+    groups[lod] = {instances[lod].data(), instances[lod].size(), lod};
+  }
+  DrawGroups(projection_mat, view_mat, groups, kMaxLodCount,
+             color_correction4);
+}
+
+void ObjRenderer::CullAndDrawInstanced(const glm::mat4& projection_mat,
+                                       const glm::mat4& view_mat,
+                                       const Instance* candidates,
+                                       size_t candidate_count,
+                                       const glm::vec3& camera_position,
+                                       float lod_screen_fraction_scale,
+                                       const float* color_correction4) {
+  if (!IsGpuCullingSupported() || candidate_count == 0 || lods_.empty()) {
+    return;
+  }
+  CullInstances(projection_mat, view_mat, candidates, candidate_count,
+                camera_position, lod_screen_fraction_scale);
+
+  InstanceGroup groups[kMaxLodCount];
+  const int lod_count = GetLodCount();
+  for (int lod = 0; lod < lod_count; ++lod) {
+    groups[lod] = {nullptr, candidate_count, lod};
+  }
+  DrawGroups(projection_mat, view_mat, groups, lod_count, color_correction4);
+}
+
+void ObjRenderer::InitializeGpuCulling(AAssetManager* asset_manager) {
+  // Names of a previous context are gone with it.
+  cull_program_ = 0;
+  culled_instance_capacity_ = 0;
+  if (!util::IsContextVersionAtLeast31()) {
+    LOGI("ObjRenderer: OpenGL ES 3.1 is not available, culling stays on the "
+         "CPU.");
+    return;
+  }
+  cull_program_ =
+      util::CreateComputeProgram(kInstanceCullShaderFileName, asset_manager);
+  if (!cull_program_) {
+    LOGE("Could not create instance culling program.");
+    return;
+  }
+  cull_candidate_count_uniform_ =
+      glGetUniformLocation(cull_program_, "u_CandidateCount");
+  cull_view_projection_mat_uniform_ =
+      glGetUniformLocation(cull_program_, "u_ViewProjection");
+  cull_frustum_planes_uniform_ =
+      glGetUniformLocation(cull_program_, "u_FrustumPlanes");
+  cull_camera_position_uniform_ =
+      glGetUniformLocation(cull_program_, "u_CameraPosition");
+  cull_bounding_sphere_uniform_ =
+      glGetUniformLocation(cull_program_, "u_BoundingSphere");
+  cull_unit_screen_fraction_uniform_ =
+      glGetUniformLocation(cull_program_, "u_UnitScreenFraction");
+  cull_lod_screen_fraction_scale_uniform_ =
+      glGetUniformLocation(cull_program_, "u_LodScreenFractionScale");
+  cull_lod_count_uniform_ = glGetUniformLocation(cull_program_, "u_LodCount");
+  cull_lod_switch_fractions_uniform_ =
+      glGetUniformLocation(cull_program_, "u_LodSwitchFractions");
+  cull_use_depth_pyramid_uniform_ =
+      glGetUniformLocation(cull_program_, "u_UseDepthPyramid");
+  cull_depth_pyramid_uniform_ =
+      glGetUniformLocation(cull_program_, "u_DepthPyramid");
+  cull_depth_uv_transform_uniform_ =
+      glGetUniformLocation(cull_program_, "u_DepthUvTransform");
+  cull_depth_aspect_ratio_uniform_ =
+      glGetUniformLocation(cull_program_, "u_DepthAspectRatio");
+  cull_depth_texture_size_uniform_ =
+      glGetUniformLocation(cull_program_, "u_DepthTextureSize");
+  cull_depth_pyramid_layout_uniform_ =
+      glGetUniformLocation(cull_program_, "u_DepthPyramidLayout");
+
+  glGenBuffers(kMaxLodCount, lod_instance_buffers_);
+  glGenBuffers(1, &indirect_command_buffer_);
+  util::CheckGlError("obj_renderer::InitializeGpuCulling()");
+}
+
+void ObjRenderer::CullInstances(const glm::mat4& projection_mat,
+                                const glm::mat4& view_mat,
+                                const Instance* candidates,
+                                size_t candidate_count,
+                                const glm::vec3& camera_position,
+                                float lod_screen_fraction_scale) {
+  ResourceAccounting& accounting = ResourceAccounting::Get();
+  // Every candidate may end up in the same level.  The buffers only grow, so
+  // their names stay recorded in the indirect vertex arrays.
+  if (candidate_count > culled_instance_capacity_) {
+    culled_instance_capacity_ =
+        std::max(candidate_count, 2 * culled_instance_capacity_);
+    const size_t size = culled_instance_capacity_ * sizeof(Instance);
+    for (GLuint buffer : lod_instance_buffers_) {
+      glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+      glBufferData(GL_SHADER_STORAGE_BUFFER, size, nullptr, GL_DYNAMIC_COPY);
+      accounting.Track(GpuResourceType::kBuffer, buffer, size, kOwner);
+    }
+  }
+
+  glBindBuffer(GL_ARRAY_BUFFER, instance_buffer_);
+  glBufferData(GL_ARRAY_BUFFER, candidate_count * sizeof(Instance), candidates,
+               GL_STREAM_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  accounting.Track(GpuResourceType::kBuffer, instance_buffer_,
+                   candidate_count * sizeof(Instance), kOwner);
+
+  // The culling pass only counts the instances; the rest of each command is
+  // known up front.
+  DrawElementsIndirectCommand commands[kMaxLodCount] = {};
+  const int lod_count = GetLodCount();
+  for (int lod = 0; lod < lod_count; ++lod) {
+    const int drawn_lod = lods_[lod].drawn_lod;
+    commands[lod].count =
+        drawn_lod < 0 ? 0 : static_cast<GLuint>(lods_[drawn_lod].index_count);
+  }
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, indirect_command_buffer_);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(commands), commands,
+               GL_STREAM_DRAW);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  accounting.Track(GpuResourceType::kBuffer, indirect_command_buffer_,
+                   sizeof(commands), kOwner);
+
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
+  gl_state.UseProgram(cull_program_);
+  const glm::mat4 view_projection_mat =
+      util::MultiplyMatrices(projection_mat, view_mat);
+  const util::Frustum frustum = util::ExtractFrustum(view_projection_mat);
+  glUniform1ui(cull_candidate_count_uniform_,
+               static_cast<GLuint>(candidate_count));
+  glUniformMatrix4fv(cull_view_projection_mat_uniform_, 1, GL_FALSE,
+                     glm::value_ptr(view_projection_mat));
+  glUniform4fv(cull_frustum_planes_uniform_, 6,
+               glm::value_ptr(frustum.planes[0]));
+  glUniform3fv(cull_camera_position_uniform_, 1,
+               glm::value_ptr(camera_position));
+  glUniform4fv(cull_bounding_sphere_uniform_, 1,
+               glm::value_ptr(bounding_sphere_));
+  glUniform1f(cull_unit_screen_fraction_uniform_, projection_mat[1][1]);
+  glUniform1f(cull_lod_screen_fraction_scale_uniform_,
+              lod_screen_fraction_scale);
+  glUniform1i(cull_lod_count_uniform_, lod_count);
+  glUniform2fv(cull_lod_switch_fractions_uniform_, 1, kLodSwitchFractions);
+  if (use_depth_for_occlusion_) {
+    SetDepthPyramidUniforms(cull_use_depth_pyramid_uniform_,
+                            cull_depth_pyramid_uniform_,
+                            cull_depth_texture_size_uniform_,
+                            cull_depth_pyramid_layout_uniform_);
+    glUniformMatrix3fv(cull_depth_uv_transform_uniform_, 1, GL_FALSE,
+                       glm::value_ptr(uv_transform_));
+    glUniform1f(cull_depth_aspect_ratio_uniform_, depth_aspect_ratio_);
+  } else {
+    glUniform1i(cull_use_depth_pyramid_uniform_, 0);
+  }
+
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, instance_buffer_);
+  for (int lod = 0; lod < kMaxLodCount; ++lod) {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1 + lod,
+                     lod_instance_buffers_[lod]);
+  }
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1 + kMaxLodCount,
+                   indirect_command_buffer_);
+  const GLuint work_groups =
+      (static_cast<GLuint>(candidate_count) + kCullWorkGroupSize - 1) /
+      kCullWorkGroupSize;
+  glDispatchCompute(work_groups, 1, 1);
+  // The draws read the counts as commands and the instances as vertex
+  // attributes.
+  glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+  util::CheckGlError("obj_renderer::CullInstances()");
+}
+
+void ObjRenderer::DrawGroups(const glm::mat4& projection_mat,
+                             const glm::mat4& view_mat,
+                             const InstanceGroup* groups, int group_count,
+                             const float* color_correction4) const {
   if (!shader_program_) {
     LOGE("shader_program is null.");
     return;
   }
 
-  glUseProgram(shader_program_);
+  size_t instance_count = 0;
+  for (int i = 0; i < group_count; ++i) {
+    instance_count += groups[i].count;
+  }
+  if (instance_count == 0 || lods_.empty() ||
+      !util::TextureCache::Get().IsReady(texture_id_)) {
+    return;
+  }
 
-  glActiveTexture(GL_TEXTURE0);
-  glUniform1i(texture_uniform_, 0);
-  glBindTexture(GL_TEXTURE_2D, texture_id_);
+  const bool use_occlusion_mask =
+      use_depth_for_occlusion_ && use_occlusion_mask_;
+  if (use_occlusion_mask) {
+    DrawOcclusionMask(projection_mat, view_mat, groups, group_count);
+  }
+
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
+  gl_state.UseProgram(shader_program_);
 
-  glm::mat4 mvp_mat = projection_mat * view_mat * model_mat;
-  glm::mat4 mv_mat = view_mat * model_mat;
-  glm::vec4 view_light_direction = glm::normalize(mv_mat * kLightDirection);
+  gl_state.ActiveTexture(GL_TEXTURE0);
+  glUniform1i(texture_uniform_, 0);
+  gl_state.BindTexture(GL_TEXTURE_2D, texture_id_);
 
-  glUniform4f(lighting_param_uniform_, view_light_direction[0],
-              view_light_direction[1], view_light_direction[2], 1.f);
+  // The model-view and model-view-projection matrices and the view space
+  // light direction depend on the instance, so they are computed in the
+  // vertex shader.
+  glUniformMatrix4fv(view_mat_uniform_, 1, GL_FALSE, glm::value_ptr(view_mat));
+  glUniformMatrix4fv(projection_mat_uniform_, 1, GL_FALSE,
+                     glm::value_ptr(projection_mat));
+  glUniform4fv(light_direction_uniform_, 1, glm::value_ptr(kLightDirection));
   glUniform4f(material_param_uniform_, ambient_, diffuse_, specular_,
               specular_power_);
   glUniform4fv(color_correction_param_uniform_, 1, color_correction4);
-  glUniform4fv(color_uniform_, 1, object_color4);
 
-  glUniformMatrix4fv(mvp_mat_uniform_, 1, GL_FALSE, glm::value_ptr(mvp_mat));
-  glUniformMatrix4fv(mv_mat_uniform_, 1, GL_FALSE, glm::value_ptr(mv_mat));
+  // The cubemap sampler always gets a unit of its own, since samplers of
+  // different types must not share one even while unused.
+  glUniform1i(environment_cubemap_uniform_, 3);
+  glUniform1i(use_environmental_hdr_uniform_,
+              environment_cubemap_texture_ != 0);
+  if (environment_cubemap_texture_ != 0) {
+    gl_state.ActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, environment_cubemap_texture_);
+    // The level whose roughness matches the material's Phong exponent, with
+    // the GGX alpha of roughness squared.
+    const float roughness =
+        std::sqrt(std::sqrt(2.0f / (specular_power_ + 2.0f)));
+    glUniform1f(environment_level_uniform_,
+                roughness * (environment_level_count_ - 1));
+    glUniform3fv(spherical_harmonics_uniform_, 9,
+                 spherical_harmonics_.data());
+  }
 
   // Occlusion parameters.
-  if (use_depth_for_occlusion_) {
+  if (use_occlusion_mask) {
+    gl_state.ActiveTexture(GL_TEXTURE1);
+    gl_state.BindTexture(GL_TEXTURE_2D, occlusion_mask_texture_);
+    glUniform1i(occlusion_mask_uniform_, 1);
+  } else if (use_depth_for_occlusion_) {
     // Attach the depth texture.
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, depth_texture_id_);
+    gl_state.ActiveTexture(GL_TEXTURE1);
+    gl_state.BindTexture(GL_TEXTURE_2D, depth_texture_id_);
     glUniform1i(depth_texture_uniform_, 1);
 
     // Set the depth texture uv transform.
     glUniformMatrix3fv(depth_uv_transform_uniform_, 1, GL_FALSE,
                        glm::value_ptr(uv_transform_));
     glUniform1f(depth_aspect_ratio_uniform_, depth_aspect_ratio_);
+    glUniform1f(depth_confidence_threshold_uniform_,
+                depth_confidence_threshold_);
+    SetDepthPyramidUniforms(use_depth_pyramid_uniform_, depth_pyramid_uniform_,
+                            depth_texture_size_uniform_,
+                            depth_pyramid_layout_uniform_);
+    SetOcclusionBlurUniforms(use_occlusion_blur_uniform_,
+                             occlusion_blur_uniform_);
   }
 
-  // Note: for simplicity, we are uploading the model each time we draw it.  A
-  // real application should use vertex buffers to upload the geometry once.
-  glEnableVertexAttribArray(position_attrib_);
-  glVertexAttribPointer(position_attrib_, 3, GL_FLOAT, GL_FALSE, 0,
-                        vertices_.data());
-
-  glEnableVertexAttribArray(normal_attrib_);
-  glVertexAttribPointer(normal_attrib_, 3, GL_FLOAT, GL_FALSE, 0,
-                        normals_.data());
-
-  glEnableVertexAttribArray(tex_coord_attrib_);
-  glVertexAttribPointer(tex_coord_attrib_, 2, GL_FLOAT, GL_FALSE, 0,
-                        uvs_.data());
-
-  glDepthMask(GL_TRUE);
-  glEnable(GL_BLEND);
+  gl_state.DepthMask(GL_TRUE);
+  gl_state.SetCapability(GL_BLEND, true);
 
   // Textures are loaded with premultiplied alpha
   // (https://developer.android.com/reference/android/graphics/BitmapFactory.Options#inPremultiplied),
   // so we use the premultiplied alpha blend factors.
-  glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+  gl_state.BlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
 
-  glDrawElements(GL_TRIANGLES, indices_.size(), GL_UNSIGNED_SHORT,
-                 indices_.data());
+  for (int i = 0; i < group_count; ++i) {
+    DrawGroup(groups[i], /*depth_pass=*/false);
+  }
+
+  // Other renderers draw from client-side arrays, which requires the default
+  // vertex array object.
+  gl_state.BindVertexArray(0);
+  util::CheckGlError("obj_renderer::DrawInstanced()");
+}
+
+void ObjRenderer::DrawOcclusionMask(const glm::mat4& projection_mat,
+                                    const glm::mat4& view_mat,
+                                    const InstanceGroup* groups,
+                                    int group_count) const {
+  if (!depth_pass_program_ || !resolve_program_ || viewport_width_ <= 0 ||
+      viewport_height_ <= 0) {
+    return;
+  }
+  const int mask_width = std::max(viewport_width_ / kOcclusionMaskDownscale, 1);
+  const int mask_height =
+      std::max(viewport_height_ / kOcclusionMaskDownscale, 1);
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
+  // Objects may be drawn into an offscreen target, see VirtualContentTarget.
+  GLint target_framebuffer = 0;
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &target_framebuffer);
 
-  glDisable(GL_BLEND);
-  glDisableVertexAttribArray(position_attrib_);
-  glDisableVertexAttribArray(tex_coord_attrib_);
-  glDisableVertexAttribArray(normal_attrib_);
+  // Depth pass: only the nearest object surface of every mask texel survives,
+  // so the resolve below runs once per texel however many objects overlap.
+  glBindFramebuffer(GL_FRAMEBUFFER, occlusion_depth_framebuffer_);
+  glViewport(0, 0, mask_width, mask_height);
+  gl_state.DepthMask(GL_TRUE);
+  gl_state.SetCapability(GL_DEPTH_TEST, true);
+  gl_state.SetCapability(GL_BLEND, false);
+  glClear(GL_DEPTH_BUFFER_BIT);
 
-  glUseProgram(0);
-  util::CheckGlError("obj_renderer::Draw()");
+  gl_state.UseProgram(depth_pass_program_);
+  glUniformMatrix4fv(depth_pass_view_mat_uniform_, 1, GL_FALSE,
+                     glm::value_ptr(view_mat));
+  glUniformMatrix4fv(depth_pass_projection_mat_uniform_, 1, GL_FALSE,
+                     glm::value_ptr(projection_mat));
+  for (int i = 0; i < group_count; ++i) {
+    DrawGroup(groups[i], /*depth_pass=*/true);
+  }
+  gl_state.BindVertexArray(0);
+
+  // Resolve pass: compares every texel against the ARCore depth texture.
+  glBindFramebuffer(GL_FRAMEBUFFER, occlusion_mask_framebuffer_);
+  gl_state.SetCapability(GL_DEPTH_TEST, false);
+  gl_state.DepthMask(GL_FALSE);
+
+  gl_state.UseProgram(resolve_program_);
+  gl_state.ActiveTexture(GL_TEXTURE0);
+  gl_state.BindTexture(GL_TEXTURE_2D, occlusion_depth_texture_);
+  glUniform1i(resolve_virtual_depth_uniform_, 0);
+  gl_state.ActiveTexture(GL_TEXTURE1);
+  gl_state.BindTexture(GL_TEXTURE_2D, depth_texture_id_);
+  glUniform1i(resolve_depth_texture_uniform_, 1);
+  glUniformMatrix3fv(resolve_depth_uv_transform_uniform_, 1, GL_FALSE,
+                     glm::value_ptr(uv_transform_));
+  glUniform1f(resolve_depth_aspect_ratio_uniform_, depth_aspect_ratio_);
+  glUniform1f(resolve_depth_confidence_threshold_uniform_,
+              depth_confidence_threshold_);
+  glUniform2f(resolve_depth_linearization_uniform_, projection_mat[2][2],
+              projection_mat[3][2]);
+  SetDepthPyramidUniforms(resolve_use_depth_pyramid_uniform_,
+                          resolve_depth_pyramid_uniform_,
+                          resolve_depth_texture_size_uniform_,
+                          resolve_depth_pyramid_layout_uniform_);
+  SetOcclusionBlurUniforms(resolve_use_occlusion_blur_uniform_,
+                           resolve_occlusion_blur_uniform_);
+
+  gl_state.SetEnabledVertexAttribArrays((1u << resolve_position_attrib_) |
+                                        (1u << resolve_tex_coord_attrib_));
+  glVertexAttribPointer(resolve_position_attrib_, 2, GL_FLOAT, GL_FALSE, 0,
+                        kQuadPositions);
+  glVertexAttribPointer(resolve_tex_coord_attrib_, 2, GL_FLOAT, GL_FALSE, 0,
+                        kQuadUvs);
+  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, target_framebuffer);
+  glViewport(0, 0, viewport_width_, viewport_height_);
+  gl_state.SetCapability(GL_DEPTH_TEST, true);
+  util::CheckGlError("obj_renderer::DrawOcclusionMask()");
+}
+
+void ObjRenderer::DrawGroup(const InstanceGroup& group,
+                            bool depth_pass) const {
+  if (group.count == 0) {
+    return;
+  }
+  const MeshLod& lod =
+      lods_[std::min(std::max(group.lod, 0), GetLodCount() - 1)];
+  if (lod.drawn_lod < 0) {
+    return;  // No level loaded.
+  }
+  // The vertex arrays are those of the requested level, the geometry that of
+  // the level standing in while the requested one is still streaming.
+  const MeshLod& mesh = lods_[lod.drawn_lod];
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
+
+  // Every level is quantized to its own bounding box.
+  glUniform3fv(depth_pass ? depth_pass_position_offset_uniform_
+                          : position_offset_uniform_,
+               1, glm::value_ptr(mesh.position_offset));
+  glUniform3fv(
+      depth_pass ? depth_pass_position_scale_uniform_ : position_scale_uniform_,
+      1, glm::value_ptr(mesh.position_scale));
+
+  if (group.instances == nullptr) {
+    // The culling pass already wrote the instances and their count.
+    gl_state.BindVertexArray(depth_pass ? lod.indirect_depth_pass_vertex_array
+                                        : lod.indirect_vertex_array);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_command_buffer_);
+    glDrawElementsIndirect(
+        GL_TRIANGLES, mesh.index_type,
+        reinterpret_cast<const void*>(
+            static_cast<uintptr_t>(group.lod) *
+            sizeof(DrawElementsIndirectCommand)));
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    return;
+  }
+
+  // Orphans the previous instance data so the upload does not wait for
+  // draws still in flight.
+  glBindBuffer(GL_ARRAY_BUFFER, instance_buffer_);
+  glBufferData(GL_ARRAY_BUFFER, group.count * sizeof(Instance),
+               group.instances, GL_STREAM_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  ResourceAccounting::Get().Track(GpuResourceType::kBuffer, instance_buffer_,
+                                  group.count * sizeof(Instance), kOwner);
+
+  // The geometry lives in GPU buffers recorded into the vertex array
+  // object, so nothing besides the instance data is uploaded here.
+  gl_state.BindVertexArray(depth_pass ? lod.depth_pass_vertex_array
+                                      : lod.vertex_array);
+  glDrawElementsInstanced(GL_TRIANGLES, mesh.index_count, mesh.index_type,
+                          nullptr, static_cast<GLsizei>(group.count));
+}
+
+void ObjRenderer::SetDepthPyramidUniforms(GLint use_uniform,
+                                          GLint pyramid_uniform,
+                                          GLint texture_size_uniform,
+                                          GLint layout_uniform) const {
+  const bool use_depth_pyramid = depth_pyramid_texture_id_ != 0;
+  glUniform1i(use_uniform, use_depth_pyramid);
+  if (!use_depth_pyramid) {
+    return;
+  }
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
+  gl_state.ActiveTexture(GL_TEXTURE2);
+  gl_state.BindTexture(GL_TEXTURE_2D, depth_pyramid_texture_id_);
+  glUniform1i(pyramid_uniform, 2);
+  glUniform2fv(texture_size_uniform, 1, glm::value_ptr(depth_texture_size_));
+  glUniform3fv(layout_uniform, 1, glm::value_ptr(depth_pyramid_layout_));
+}
+
+void ObjRenderer::SetOcclusionBlurUniforms(GLint use_uniform,
+                                           GLint blur_uniform) const {
+  const bool use_occlusion_blur = occlusion_blur_texture_id_ != 0;
+  glUniform1i(use_uniform, use_occlusion_blur);
+  if (!use_occlusion_blur) {
+    return;
+  }
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
+  gl_state.ActiveTexture(GL_TEXTURE4);
+  gl_state.BindTexture(GL_TEXTURE_2D, occlusion_blur_texture_id_);
+  glUniform1i(blur_uniform, 4);
 }
 
 }  // namespace hello_ar
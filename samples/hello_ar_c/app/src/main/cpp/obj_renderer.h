@@ -16,10 +16,13 @@
 
 #ifndef C_ARCORE_HELLOE_AR_OBJ_RENDERER_
 #define C_ARCORE_HELLOE_AR_OBJ_RENDERER_
-#include <GLES2/gl2.h>
+// clang-format off
+#include <GLES3/gl3.h>
 #include <GLES2/gl2ext.h>
+// clang-format on
 #include <android/asset_manager.h>
 
+#include <array>
 #include <cstdint>
 #include <cstdlib>
 #include <string>
@@ -27,20 +30,55 @@
 
 #include "arcore_c_api.h"
 #include "glm.h"
+#include "shader_variants.h"
 
 namespace hello_ar {
 
+class AssetLoader;
+
 // PlaneRenderer renders ARCore plane type.
 class ObjRenderer {
  public:
+  // Per-instance data consumed by DrawInstanced().  The layout is mirrored by
+  // the a_ModelMatrix and a_ObjColor instanced attributes in ar_object.vert.
+  struct Instance {
+    glm::mat4 model_mat;
+    glm::vec4 color;
+  };
+
+  // Maximum number of levels of detail, including the full resolution one.
+  static constexpr int kMaxLodCount = 3;
+
+  // Instances grouped by the level of detail they are drawn with.
+  using LodInstances = std::array<std::vector<Instance>, kMaxLodCount>;
+
   ObjRenderer() = default;
   ~ObjRenderer() = default;
 
-  // Loads the OBJ file and texture and sets up OpenGL resources used to draw
-  // the model.  Must be called on the OpenGL thread prior to any other calls.
+  // Loads the model and texture and sets up OpenGL resources used to draw
+  // the model.  The mesh is uploaded once into an interleaved vertex buffer
+  // and an index buffer, which are recorded into a vertex array object.
+  // Models ending in ".mesh" are packed binary meshes that are uploaded
+  // straight from the mapped asset; anything else is parsed as OBJ.  Must be
+  // called on the OpenGL thread prior to any other calls.
+  //
+  // Reduced levels of detail are loaded from the optional "_lod1" and "_lod2"
+  // variants of the model, e.g. "models/andy_lod1.mesh" next to
+  // "models/andy.mesh".
+  //
+  // With an |asset_loader| only the coarsest level is loaded before this
+  // returns.  The finer ones are read on its workers and uploaded by its
+  // RunUploads(), and UpdateStreamedLods() swaps each in once its upload
+  // completed on the GPU.  Until then copies meant for a level are drawn with
+  // the nearest level already there.
   void InitializeGlContent(AAssetManager* asset_manager,
                            const std::string& obj_file_name,
-                           const std::string& png_file_name);
+                           const std::string& png_file_name,
+                           AssetLoader* asset_loader = nullptr);
+
+  // Starts drawing with the streamed levels whose uploads completed.  Call
+  // once per frame on the OpenGL thread, before drawing.
+  void UpdateStreamedLods();
 
   // Sets the surface's lighting reflectace properties.  Diffuse is modulated by
   // the texture's color.
@@ -52,6 +90,57 @@ class ObjRenderer {
             const glm::mat4& model_mat, const float* color_correction4,
             const float* object_color4) const;
 
+  // Draws one copy of the model per entry of |instances| with a single
+  // glDrawElementsInstanced call.  Program, textures and per-frame uniforms
+  // are bound once; the model matrices and colors are streamed into an
+  // instance buffer.
+  void DrawInstanced(const glm::mat4& projection_mat,
+                     const glm::mat4& view_mat, const Instance* instances,
+                     size_t instance_count, const float* color_correction4,
+                     int lod = 0) const;
+
+  // Draws each group of |instances| with its level of detail, one instanced
+  // draw call per non-empty group.
+  void DrawInstanced(const glm::mat4& projection_mat,
+                     const glm::mat4& view_mat, const LodInstances& instances,
+                     const float* color_correction4) const;
+
+  // Whether CullAndDrawInstanced() can be used, which needs an OpenGL ES 3.1
+  // context for its compute pass and indirect draws.
+  bool IsGpuCullingSupported() const { return cull_program_ != 0; }
+
+  // Culls |candidates| and picks their levels of detail in a compute shader,
+  // then draws the survivors with one glDrawElementsIndirect call per level.
+  // The CPU only uploads the candidates, so its cost stays flat however many
+  // of them the GPU drops.  Candidates only need to be culled coarsely: the
+  // compute pass tests the bounding sphere against the frustum and, while
+  // depth occlusion is on, the depth pyramid set by SetDepthPyramid(), and
+  // selects levels like SelectLod() but without hysteresis.  Nothing is read
+  // back.  Must only be called if IsGpuCullingSupported().
+  //
+  // @param camera_position, world space position the level of detail distance
+  //     is measured from.
+  // @param lod_screen_fraction_scale, scales the screen fractions the levels
+  //     are selected with, below one to switch to coarser levels sooner.
+  void CullAndDrawInstanced(const glm::mat4& projection_mat,
+                            const glm::mat4& view_mat,
+                            const Instance* candidates, size_t candidate_count,
+                            const glm::vec3& camera_position,
+                            float lod_screen_fraction_scale,
+                            const float* color_correction4);
+
+  // Number of levels of detail of the model, including those still
+  // streaming, at least 1.
+  int GetLodCount() const {
+    return lods_.empty() ? 1 : static_cast<int>(lods_.size());
+  }
+
+  // Picks the level of detail for a copy of the model whose bounding sphere
+  // covers |screen_fraction| of the viewport height.  |current_lod| is the
+  // level used so far; it is kept until the size moves past a switch point by
+  // a hysteresis margin, so objects near a switch distance do not pop.
+  int SelectLod(float screen_fraction, int current_lod) const;
+
   void SetUvTransformMatrix(const glm::mat3& uv_transform) {
     uv_transform_ = uv_transform;
   }
@@ -59,25 +148,211 @@ class ObjRenderer {
   void SetDepthTexture(int texture_id, int width, int height) {
     depth_texture_id_ = texture_id;
     depth_aspect_ratio_ = (float)width / (float)height;
+    depth_texture_size_ = glm::vec2(width, height);
+  }
+
+  // Lets the occlusion test skip the blurred depth comparison where the
+  // coarse min and max depth of a DepthPyramidTexture decide it.  A
+  // |texture_id| of 0 turns this off.
+  //
+  // @param texel_coverage, depth texels a side covered by one texel of the
+  //     sampled pyramid level.
+  // @param level_size, size of the sampled pyramid level.
+  void SetDepthPyramid(GLuint texture_id, int texel_coverage,
+                       const glm::ivec2& level_size) {
+    depth_pyramid_texture_id_ = texture_id;
+    depth_pyramid_layout_ =
+        glm::vec3(texel_coverage, level_size.x, level_size.y);
+  }
+
+  // Lets the occlusion test read the visibility inputs precomputed by an
+  // OcclusionBlurTexture with one lookup instead of blurring per fragment.
+  // Takes precedence over the depth pyramid.  A |texture_id| of 0 turns this
+  // off.
+  void SetOcclusionBlur(GLuint texture_id) {
+    occlusion_blur_texture_id_ = texture_id;
+  }
+
+  // Lights the objects with an Environmental HDR estimate instead of the
+  // directional light and color correction, see EnvironmentalHdrLighting.
+  // |cubemap_texture| holds |level_count| levels of rising roughness and
+  // |spherical_harmonics27| the irradiance coefficients.  A
+  // |cubemap_texture| of 0 turns this off.
+  void SetEnvironmentalHdr(GLuint cubemap_texture, int level_count,
+                           const float* spherical_harmonics27);
+
+  // Depth texels with a confidence below |threshold|, in [0, 1], are ignored
+  // by the occlusion test.  Only meaningful for raw depth; the default of zero
+  // uses every texel.
+  void SetDepthConfidenceThreshold(float threshold) {
+    depth_confidence_threshold_ = threshold;
   }
 
   // Specifies whether to use the depth texture to perform depth-based occlusion
   // of virtual objects from real-world geometry.
   //
   // This function is a no-op if the value provided is the same as what is
-  // already set. If the value changes, this function will recompile and reload
-  // the shader program to either enable/disable depth-based occlusion. NOTE:
-  // recompilation of the shader is inefficient. This code could be optimized to
-  // precompile both versions of the shader.
+  // already set. Both shader variants are built in InitializeGlContent(), so
+  // toggling only switches programs and never compiles on the render thread.
   //
-  // @param context Context for loading the shader.
   // @param useDepthForOcclusion Specifies whether to use the depth texture to
   // perform occlusion during rendering of virtual objects.
-  void setUseDepthForOcclusion(AAssetManager* asset_manager,
-                               bool use_depth_for_occlusion);
+  void setUseDepthForOcclusion(bool use_depth_for_occlusion);
+
+  // Selects how depth-based occlusion is computed.  By default every object
+  // fragment runs the blurred depth comparison.  With the occlusion mask, the
+  // objects' depth is first rendered at reduced resolution and the comparison
+  // runs once per mask texel in a single fullscreen pass; objects then sample
+  // the resolved mask, so the cost no longer scales with overdraw.
+  void SetUseOcclusionMask(bool use_occlusion_mask);
+
+  // Sizes the occlusion mask targets for a |width| x |height| viewport.  Must
+  // be called on the OpenGL thread whenever the viewport changes.
+  void SetViewportSize(int width, int height);
+
+  // Returns the model-space bounding sphere as center (xyz) and radius (w).
+  const glm::vec4& GetBoundingSphere() const { return bounding_sphere_; }
+
+  // The program the objects are currently drawn with, which depends on the
+  // occlusion settings.
+  GLuint GetProgram() const { return shader_program_; }
 
  private:
-  void compileAndLoadShaderProgram(AAssetManager* asset_manager);
+  // Occlusion variants of ar_object.frag, used to index shader_programs_.
+  enum OcclusionVariant {
+    kNoOcclusion = 0,
+    kPerFragmentOcclusion,
+    kMaskOcclusion,
+    kNumOcclusionVariants
+  };
+
+  // One instanced draw call worth of instances.  Groups without |instances|
+  // draw the instances the culling pass left in their level, for which
+  // |count| is only an upper bound.
+  struct InstanceGroup {
+    const Instance* instances;
+    size_t count;
+    int lod;
+  };
+
+  // Mirrors the command read by glDrawElementsIndirect, which the culling
+  // pass fills in one of per level of detail.
+  struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instance_count;
+    GLuint first_index;
+    GLint base_vertex;
+    GLuint reserved;
+  };
+
+  // Builds the program for every occlusion variant up front, plus the
+  // programs of the occlusion mask passes.
+  void compileAndLoadShaderPrograms(AAssetManager* asset_manager);
+  // The program of ar_object.frag for an OcclusionVariant.
+  static ShaderVariant GetVariantShader(int variant);
+
+  // Makes the variant matching use_depth_for_occlusion_ and
+  // use_occlusion_mask_ current and queries its attribute and uniform
+  // locations.
+  void selectShaderProgram();
+
+  // Builds the culling program and its buffers, if the context supports
+  // compute shaders.
+  void InitializeGpuCulling(AAssetManager* asset_manager);
+
+  // Runs the culling pass over |candidates| into lod_instance_buffers_ and
+  // indirect_command_buffer_.
+  void CullInstances(const glm::mat4& projection_mat, const glm::mat4& view_mat,
+                     const Instance* candidates, size_t candidate_count,
+                     const glm::vec3& camera_position,
+                     float lod_screen_fraction_scale);
+
+  // Draws |groups| with the current program, rendering the occlusion mask
+  // first if it is used.
+  void DrawGroups(const glm::mat4& projection_mat, const glm::mat4& view_mat,
+                  const InstanceGroup* groups, int group_count,
+                  const float* color_correction4) const;
+
+  // Renders the depth of |groups| into the mask resolution depth target and
+  // resolves it against the ARCore depth texture into the occlusion mask.
+  // Leaves the framebuffer that was bound before bound again, with the full
+  // viewport.
+  void DrawOcclusionMask(const glm::mat4& projection_mat,
+                         const glm::mat4& view_mat, const InstanceGroup* groups,
+                         int group_count) const;
+
+  // Draws one group with the bound program, through the vertex arrays of the
+  // depth pass if |depth_pass| is set.
+  void DrawGroup(const InstanceGroup& group, bool depth_pass) const;
+
+  // Binds the depth pyramid of the current program's occlusion test to
+  // texture unit 2, or turns its use off.
+  void SetDepthPyramidUniforms(GLint use_uniform, GLint pyramid_uniform,
+                               GLint texture_size_uniform,
+                               GLint layout_uniform) const;
+
+  // Binds the precomputed occlusion blur of the current program's occlusion
+  // test to texture unit 4, or turns its use off.
+  void SetOcclusionBlurUniforms(GLint use_uniform, GLint blur_uniform) const;
+
+  // Creates the occlusion mask textures and framebuffers, sized for the
+  // current viewport.
+  void CreateOcclusionMaskTargets();
+
+  struct MeshData;
+  struct MeshLod;
+
+  // Read a level of detail into |out_mesh|.  Thread safe.
+  static bool ReadMesh(AAssetManager* asset_manager,
+                       const std::string& file_name, MeshData* out_mesh);
+  static bool ReadBinaryMesh(AAssetManager* asset_manager,
+                             const std::string& mesh_file_name,
+                             MeshData* out_mesh);
+  static bool ReadObjMesh(AAssetManager* asset_manager,
+                          const std::string& obj_file_name,
+                          MeshData* out_mesh);
+
+  // Reads the level |lod| from |file_name| on a worker of |asset_loader| and
+  // uploads it with a fence, on the loader's GlUploadThread if that runs,
+  // unless InitializeGlContent() ran again since.
+  void SubmitLodLoad(AssetLoader* asset_loader, AAssetManager* asset_manager,
+                     const std::string& file_name, int lod);
+
+  void CreateVertexArrays(MeshLod* lod) const;
+
+  // Creates the vertex and index buffers of the level |lod_index| and
+  // uploads the util::QuantizedVertex data and the indices of |mesh|.  The
+  // level is drawn right away, or if |fenced| once UpdateStreamedLods() saw
+  // the upload complete.
+  void UploadMesh(int lod_index, const MeshData& mesh, bool fenced);
+
+  // Creates buffers holding the vertices and indices of |mesh| in the
+  // current context, whose default vertex array must be bound.  Does not
+  // touch the renderer, so it may run on a GlUploadThread.
+  static void CreateMeshBuffers(const MeshData& mesh, GLuint* vertex_buffer,
+                                GLuint* index_buffer);
+  // Makes the buffers of CreateMeshBuffers() those of the level |lod_index|.
+  void AdoptMesh(int lod_index, const MeshData& mesh, GLuint vertex_buffer,
+                 GLuint index_buffer);
+
+  // Picks the level drawn for each level from those that are resident, and
+  // re-records the vertex arrays.
+  void UpdateDrawnLods();
+
+  // Records the vertex attribute layout of the interleaved vertex buffer into
+  // the vertex array object of every level of detail.  Needs to be re-run
+  // whenever the shader program is relinked, since attribute locations may
+  // change.
+  void ConfigureVertexArray();
+
+  // Sets up the attributes of the bound vertex array, with the level's vertex
+  // buffer bound to GL_ARRAY_BUFFER and the per-instance attributes read from
+  // |instance_buffer|.
+  void ConfigureVertexAttributes(GLuint instance_buffer);
+
+  // Same for the depth-only program of the occlusion mask, which only
+  // consumes the position and the model matrix.
+  void ConfigureDepthPassVertexAttributes(GLuint instance_buffer);
 
   // Shader material lighting pateremrs
   float ambient_ = 0.0f;
@@ -85,36 +360,148 @@ class ObjRenderer {
   float specular_ = 0.5f;
   float specular_power_ = 6.0f;
 
-  // Model attribute arrays
-  std::vector<GLfloat> vertices_;
-  std::vector<GLfloat> uvs_;
-  std::vector<GLfloat> normals_;
+  // GPU-resident geometry of one level of detail.  The vertex buffer holds
+  // a util::QuantizedVertex for each vertex.
+  struct MeshLod {
+    GLuint vertex_array = 0;
+    // Vertex array of the occlusion mask depth pass over the same buffers.
+    GLuint depth_pass_vertex_array = 0;
+    // Same for the instances the culling pass leaves in this level, only
+    // created if IsGpuCullingSupported().
+    GLuint indirect_vertex_array = 0;
+    GLuint indirect_depth_pass_vertex_array = 0;
+    GLuint vertex_buffer = 0;
+    GLuint index_buffer = 0;
+    GLsizei index_count = 0;
+    GLenum index_type = GL_UNSIGNED_SHORT;
+    // Bounding box the positions are quantized to.
+    glm::vec3 position_offset = glm::vec3(0.0f);
+    glm::vec3 position_scale = glm::vec3(1.0f);
+    glm::vec4 bounding_sphere = glm::vec4(0.0f);
+    // Whether the buffers above can be drawn from.  A streamed level becomes
+    // resident once |upload_fence| signals.
+    bool resident = false;
+    GLsync upload_fence = nullptr;
+    // The resident level whose geometry the vertex arrays of this level
+    // read, -1 if there is none.
+    int drawn_lod = -1;
+  };
 
-  // Model triangle indices
-  std::vector<GLushort> indices_;
+  // Ordered from full resolution to coarsest, one per level found.
+  std::vector<MeshLod> lods_;
+  // Bounding sphere of the finest resident level, which the coarser levels
+  // are expected to stay within.
+  glm::vec4 bounding_sphere_ = glm::vec4(0.0f);
+  // Identifies the levels streamed for the current InitializeGlContent().
+  uint64_t stream_generation_ = 0;
+
+  // Streaming buffer holding one Instance per drawn copy of the model, or per
+  // candidate of the culling pass.
+  GLuint instance_buffer_ = 0;
+
+  // GPU culling.  Each level of detail has a buffer the culling pass appends
+  // its instances to, with room for every candidate, and a
+  // DrawElementsIndirectCommand in indirect_command_buffer_.
+  GLuint cull_program_ = 0;
+  GLint cull_candidate_count_uniform_;
+  GLint cull_view_projection_mat_uniform_;
+  GLint cull_frustum_planes_uniform_;
+  GLint cull_camera_position_uniform_;
+  GLint cull_bounding_sphere_uniform_;
+  GLint cull_unit_screen_fraction_uniform_;
+  GLint cull_lod_screen_fraction_scale_uniform_;
+  GLint cull_lod_count_uniform_;
+  GLint cull_lod_switch_fractions_uniform_;
+  GLint cull_use_depth_pyramid_uniform_;
+  GLint cull_depth_pyramid_uniform_;
+  GLint cull_depth_uv_transform_uniform_;
+  GLint cull_depth_aspect_ratio_uniform_;
+  GLint cull_depth_texture_size_uniform_;
+  GLint cull_depth_pyramid_layout_uniform_;
+  GLuint lod_instance_buffers_[kMaxLodCount] = {0, 0, 0};
+  GLuint indirect_command_buffer_ = 0;
+  size_t culled_instance_capacity_ = 0;
 
   // Loaded TEXTURE_2D object name
   GLuint texture_id_;
   GLuint depth_texture_id_;
 
   // Shader program details
+  // Indexed by OcclusionVariant.
+  GLuint shader_programs_[kNumOcclusionVariants] = {0, 0, 0};
   GLuint shader_program_;
   GLint position_attrib_;
   GLint tex_coord_attrib_;
   GLint normal_attrib_;
-  GLint mvp_mat_uniform_;
-  GLint mv_mat_uniform_;
+  GLint model_mat_attrib_;
+  GLint color_attrib_;
+  GLint view_mat_uniform_;
+  GLint projection_mat_uniform_;
+  GLint position_offset_uniform_;
+  GLint position_scale_uniform_;
   GLint texture_uniform_;
-  GLint lighting_param_uniform_;
+  GLint light_direction_uniform_;
   GLint material_param_uniform_;
   GLint color_correction_param_uniform_;
-  GLint color_uniform_;
   GLint depth_texture_uniform_;
   GLint depth_uv_transform_uniform_;
   GLint depth_aspect_ratio_uniform_;
+  GLint depth_confidence_threshold_uniform_;
+  GLint occlusion_mask_uniform_;
+  GLint use_depth_pyramid_uniform_;
+  GLint depth_pyramid_uniform_;
+  GLint depth_texture_size_uniform_;
+  GLint depth_pyramid_layout_uniform_;
+  GLint use_occlusion_blur_uniform_;
+  GLint occlusion_blur_uniform_;
+  GLint use_environmental_hdr_uniform_;
+  GLint environment_cubemap_uniform_;
+  GLint environment_level_uniform_;
+  GLint spherical_harmonics_uniform_;
+
+  // Occlusion mask passes.  The depth pass renders the objects into
+  // occlusion_depth_texture_, the resolve pass turns it into visibility in
+  // occlusion_mask_texture_.
+  GLuint depth_pass_program_ = 0;
+  GLint depth_pass_position_attrib_;
+  GLint depth_pass_model_mat_attrib_;
+  GLint depth_pass_view_mat_uniform_;
+  GLint depth_pass_projection_mat_uniform_;
+  GLint depth_pass_position_offset_uniform_;
+  GLint depth_pass_position_scale_uniform_;
+  GLuint resolve_program_ = 0;
+  GLint resolve_position_attrib_;
+  GLint resolve_tex_coord_attrib_;
+  GLint resolve_virtual_depth_uniform_;
+  GLint resolve_depth_texture_uniform_;
+  GLint resolve_depth_uv_transform_uniform_;
+  GLint resolve_depth_aspect_ratio_uniform_;
+  GLint resolve_depth_confidence_threshold_uniform_;
+  GLint resolve_depth_linearization_uniform_;
+  GLint resolve_use_depth_pyramid_uniform_;
+  GLint resolve_depth_pyramid_uniform_;
+  GLint resolve_depth_texture_size_uniform_;
+  GLint resolve_depth_pyramid_layout_uniform_;
+  GLint resolve_use_occlusion_blur_uniform_;
+  GLint resolve_occlusion_blur_uniform_;
+  GLuint occlusion_depth_texture_ = 0;
+  GLuint occlusion_depth_framebuffer_ = 0;
+  GLuint occlusion_mask_texture_ = 0;
+  GLuint occlusion_mask_framebuffer_ = 0;
+  int viewport_width_ = 0;
+  int viewport_height_ = 0;
 
   bool use_depth_for_occlusion_ = false;
+  bool use_occlusion_mask_ = false;
   float depth_aspect_ratio_ = 0.0f;
+  float depth_confidence_threshold_ = 0.0f;
+  glm::vec2 depth_texture_size_ = glm::vec2(0.0f);
+  GLuint depth_pyramid_texture_id_ = 0;
+  glm::vec3 depth_pyramid_layout_ = glm::vec3(0.0f);
+  GLuint occlusion_blur_texture_id_ = 0;
+  GLuint environment_cubemap_texture_ = 0;
+  int environment_level_count_ = 0;
+  std::array<float, 27> spherical_harmonics_ = {};
   glm::mat3 uv_transform_ = glm::mat3(1.0f);
 };
 }  // namespace hello_ar
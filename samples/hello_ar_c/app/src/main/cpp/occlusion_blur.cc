@@ -0,0 +1,150 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "occlusion_blur.h"
+
+#include <cstring>
+
+#include "resource_accounting.h"
+#include "util.h"
+
+namespace hello_ar {
+namespace {
+constexpr char kOwner[] = "OcclusionBlurTexture";
+
+// Mirrors DepthGetBlurredVisibilityAroundUV() in ar_object.frag and
+// occlusion_mask.frag, which spaces its taps kOcclusionBlurAmount of the
+// texture width apart.
+constexpr float kOcclusionBlurAmount = 0.01f;
+
+bool IsHalfFloatRenderable() {
+  GLint num_extensions = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &num_extensions);
+  for (GLint i = 0; i < num_extensions; ++i) {
+    const char* extension = reinterpret_cast<const char*>(
+        glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i)));
+    if (extension != nullptr &&
+        (strcmp(extension, "GL_EXT_color_buffer_half_float") == 0 ||
+         strcmp(extension, "GL_EXT_color_buffer_float") == 0)) {
+      return true;
+    }
+  }
+  return false;
+}
+}  // namespace
+
+void OcclusionBlurTexture::InitializeGlContent(AAssetManager* asset_manager) {
+  // Objects of a previous context are gone with it.
+  textures_[0] = textures_[1] = 0;
+  framebuffers_[0] = framebuffers_[1] = 0;
+  width_ = 0;
+  height_ = 0;
+  updated_ = false;
+  shader_program_ = 0;
+  if (!IsHalfFloatRenderable()) {
+    LOGI("Half float render targets are not supported, occlusion is blurred "
+         "per fragment.");
+    return;
+  }
+
+  shader_program_ =
+      util::CreateProgram(ShaderVariant::kOcclusionBlur, asset_manager);
+  if (!shader_program_) {
+    LOGE("Could not create occlusion blur program.");
+    return;
+  }
+  uniform_source_ = glGetUniformLocation(shader_program_, "u_Source");
+  uniform_from_depth_ = glGetUniformLocation(shader_program_, "u_FromDepth");
+  uniform_step_ = glGetUniformLocation(shader_program_, "u_Step");
+  uniform_confidence_threshold_ =
+      glGetUniformLocation(shader_program_, "u_DepthConfidenceThreshold");
+  glGenFramebuffers(2, framebuffers_);
+  util::CheckGlError("OcclusionBlurTexture::InitializeGlContent()");
+}
+
+void OcclusionBlurTexture::Allocate(int depth_width, int depth_height) {
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
+  width_ = depth_width;
+  height_ = depth_height;
+  for (int i = 0; i < 2; ++i) {
+    if (textures_[i]) {
+      gl_state.DeleteTexture(textures_[i]);
+    }
+    glGenTextures(1, &textures_[i]);
+    gl_state.BindTexture(GL_TEXTURE_2D, textures_[i]);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA16F, width_, height_);
+    ResourceAccounting::Get().Track(
+        GpuResourceType::kTexture, textures_[i],
+        GetTextureBytes(GL_RGBA16F, width_, height_), kOwner);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffers_[i]);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                           textures_[i], 0);
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void OcclusionBlurTexture::Update(GLuint depth_texture_id, int depth_width,
+                                  int depth_height,
+                                  float confidence_threshold) {
+  if (!shader_program_ || depth_texture_id == 0 || depth_width <= 0 ||
+      depth_height <= 0) {
+    return;
+  }
+  if (depth_width != width_ || depth_height != height_ || !textures_[0]) {
+    Allocate(depth_width, depth_height);
+  }
+
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
+  gl_state.SetCapability(GL_DEPTH_TEST, false);
+  gl_state.SetCapability(GL_BLEND, false);
+  gl_state.DepthMask(GL_FALSE);
+  gl_state.UseProgram(shader_program_);
+  // The fullscreen triangle comes from gl_VertexID.
+  gl_state.SetEnabledVertexAttribArrays(0);
+  gl_state.ActiveTexture(GL_TEXTURE0);
+  glUniform1i(uniform_source_, 0);
+  glUniform1f(uniform_confidence_threshold_, confidence_threshold);
+  glViewport(0, 0, width_, height_);
+
+  // The taps are as far apart in both directions on screen, like those of
+  // DepthGetBlurredVisibilityAroundUV().
+  const float aspect_ratio = static_cast<float>(depth_width) / depth_height;
+  const GLuint sources[2] = {depth_texture_id, textures_[0]};
+  const float steps[2][2] = {{kOcclusionBlurAmount, 0.f},
+                             {0.f, kOcclusionBlurAmount * aspect_ratio}};
+  for (int pass = 0; pass < 2; ++pass) {
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffers_[pass]);
+    gl_state.BindTexture(GL_TEXTURE_2D, sources[pass]);
+    glUniform1i(uniform_from_depth_, pass == 0);
+    glUniform2fv(uniform_step_, 1, steps[pass]);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+  }
+  updated_ = true;
+
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+  gl_state.SetCapability(GL_DEPTH_TEST, true);
+  util::CheckGlError("OcclusionBlurTexture::Update()");
+}
+
+}  // namespace hello_ar
@@ -0,0 +1,76 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_OCCLUSION_BLUR_H_
+#define C_ARCORE_HELLOE_AR_OCCLUSION_BLUR_H_
+
+// clang-format off
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+// clang-format on
+#include <android/asset_manager.h>
+
+namespace hello_ar {
+
+// The depth around every texel of the depth texture, blurred once per depth
+// image so the occlusion shaders read it with a single lookup instead of
+// running the 25 taps of DepthGetBlurredVisibilityAroundUV() per fragment.
+//
+// The visibility of a fragment depends on its own depth, so the blur cannot
+// be applied to visibility ahead of time.  Instead two separable render
+// passes, horizontal then vertical, gather the mean and standard deviation
+// of the occluding depth under the kernel and the share of the kernel that
+// occludes at all, which DepthGetPrecomputedVisibility() turns into
+// visibility.  The texture is RGBA16F with the mean and deviation in meters
+// premultiplied by the share, so it can be filtered linearly.  Rendering to
+// it needs GL_EXT_color_buffer_half_float or GL_EXT_color_buffer_float;
+// without either, GetTextureId() stays 0 and the shaders keep blurring per
+// fragment.
+class OcclusionBlurTexture {
+ public:
+  OcclusionBlurTexture() = default;
+  ~OcclusionBlurTexture() = default;
+
+  // Initialize the GL content, needs to be called on GL thread.
+  void InitializeGlContent(AAssetManager* asset_manager);
+
+  // Blurs |depth_texture_id|, which is in the format written by Texture.
+  void Update(GLuint depth_texture_id, int depth_width, int depth_height,
+              float confidence_threshold);
+
+  // Texture to sample, or 0 until Update() succeeded.
+  GLuint GetTextureId() const { return updated_ ? textures_[1] : 0; }
+
+ private:
+  void Allocate(int depth_width, int depth_height);
+
+  // The horizontal pass writes textures_[0], the vertical pass textures_[1].
+  GLuint textures_[2] = {0, 0};
+  GLuint framebuffers_[2] = {0, 0};
+  int width_ = 0;
+  int height_ = 0;
+  bool updated_ = false;
+
+  GLuint shader_program_ = 0;
+  GLint uniform_source_ = -1;
+  GLint uniform_from_depth_ = -1;
+  GLint uniform_step_ = -1;
+  GLint uniform_confidence_threshold_ = -1;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_OCCLUSION_BLUR_H_
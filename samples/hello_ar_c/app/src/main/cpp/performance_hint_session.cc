@@ -0,0 +1,152 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "performance_hint_session.h"
+
+#include <dlfcn.h>
+
+#include <algorithm>
+#include <cstdio>
+
+#include "util.h"
+
+namespace hello_ar {
+
+PerformanceHintSession::PerformanceHintSession(
+    std::chrono::nanoseconds target)
+    : target_(target) {
+  library_ = dlopen("libandroid.so", RTLD_NOW | RTLD_LOCAL);
+  if (library_ == nullptr) {
+    return;
+  }
+  const auto get_manager = reinterpret_cast<GetManagerFunction>(
+      dlsym(library_, "APerformanceHint_getManager"));
+  create_session_ = reinterpret_cast<CreateSessionFunction>(
+      dlsym(library_, "APerformanceHint_createSession"));
+  update_target_ = reinterpret_cast<UpdateTargetFunction>(
+      dlsym(library_, "APerformanceHint_updateTargetWorkDuration"));
+  report_actual_ = reinterpret_cast<ReportActualFunction>(
+      dlsym(library_, "APerformanceHint_reportActualWorkDuration"));
+  close_session_ = reinterpret_cast<CloseSessionFunction>(
+      dlsym(library_, "APerformanceHint_closeSession"));
+  set_threads_ = reinterpret_cast<SetThreadsFunction>(
+      dlsym(library_, "APerformanceHint_setThreads"));
+  if (get_manager == nullptr || create_session_ == nullptr ||
+      update_target_ == nullptr || report_actual_ == nullptr ||
+      close_session_ == nullptr) {
+    LOGI("PerformanceHintSession: the performance hint API is not "
+         "available");
+    return;
+  }
+  // Null if the device does not support performance hints.
+  manager_ = get_manager();
+}
+
+PerformanceHintSession::~PerformanceHintSession() {
+  Pause();
+  if (library_ != nullptr) {
+    dlclose(library_);
+  }
+}
+
+void PerformanceHintSession::SetThreads(
+    const std::vector<int32_t>& thread_ids) {
+  sorted_thread_ids_ = thread_ids;
+  std::sort(sorted_thread_ids_.begin(), sorted_thread_ids_.end());
+  if (sorted_thread_ids_ == thread_ids_) {
+    return;
+  }
+  thread_ids_.swap(sorted_thread_ids_);
+  open_failed_ = false;
+  if (session_ == nullptr) {
+    return;
+  }
+  if (set_threads_ != nullptr && !thread_ids_.empty() &&
+      set_threads_(session_, thread_ids_.data(), thread_ids_.size()) == 0) {
+    return;
+  }
+  // Reopened by the next report.
+  Pause();
+}
+
+void PerformanceHintSession::SetTarget(std::chrono::nanoseconds target) {
+  if (target == target_) {
+    return;
+  }
+  target_ = target;
+  if (session_ != nullptr) {
+    update_target_(session_, target_.count());
+  }
+}
+
+void PerformanceHintSession::ReportActualWork(
+    std::chrono::nanoseconds duration) {
+  if (manager_ == nullptr || duration.count() <= 0) {
+    return;
+  }
+  if (session_ == nullptr) {
+    Open();
+    if (session_ == nullptr) {
+      return;
+    }
+  }
+  report_actual_(session_, duration.count());
+  ++reported_frames_;
+  if (duration > target_) {
+    ++overrun_frames_;
+  }
+}
+
+void PerformanceHintSession::Pause() {
+  if (session_ == nullptr) {
+    return;
+  }
+  close_session_(session_);
+  session_ = nullptr;
+}
+
+std::string PerformanceHintSession::GetReport() const {
+  if (manager_ == nullptr) {
+    return "not supported";
+  }
+  char text[128];
+  snprintf(text, sizeof(text),
+           "%lld frames reported, %lld over the %.1f ms target, %lld "
+           "sessions opened",
+           static_cast<long long>(reported_frames_),
+           static_cast<long long>(overrun_frames_), target_.count() * 1e-6,
+           static_cast<long long>(opened_sessions_));
+  return text;
+}
+
+void PerformanceHintSession::Open() {
+  if (thread_ids_.empty() || open_failed_) {
+    return;
+  }
+  session_ = create_session_(manager_, thread_ids_.data(), thread_ids_.size(),
+                             target_.count());
+  if (session_ == nullptr) {
+    LOGE("PerformanceHintSession: could not create a session for %zu "
+         "threads",
+         thread_ids_.size());
+    // Not retried until the threads change.
+    open_failed_ = true;
+    return;
+  }
+  ++opened_sessions_;
+}
+
+}  // namespace hello_ar
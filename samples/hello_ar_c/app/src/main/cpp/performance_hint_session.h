@@ -0,0 +1,104 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_PERFORMANCE_HINT_SESSION_H_
+#define C_ARCORE_HELLOE_AR_PERFORMANCE_HINT_SESSION_H_
+
+#include <android/performance_hint.h>
+
+#include <chrono>  // NOLINT
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace hello_ar {
+
+// Reports how long the frames take against their target to the performance
+// hint API of Android 13 (ADPF), so the system raises the clocks of the
+// threads that produce the frames, or moves them to bigger cores, only as far
+// as the target needs.  The library is looked up at runtime like
+// ThermalMonitor; on older releases nothing is reported.
+//
+// The session covers the threads of the last SetThreads().  Pause() closes
+// it while the app does not draw, so idle threads hold no boost; the next
+// report opens a new one.
+//
+// Not thread safe; the app calls it on the OpenGL thread.
+class PerformanceHintSession {
+ public:
+  // |target| is the time a frame may take, e.g. the camera frame period.
+  explicit PerformanceHintSession(std::chrono::nanoseconds target);
+  ~PerformanceHintSession();
+
+  PerformanceHintSession(const PerformanceHintSession&) = delete;
+  PerformanceHintSession& operator=(const PerformanceHintSession&) = delete;
+
+  bool IsSupported() const { return manager_ != nullptr; }
+  bool IsOpen() const { return session_ != nullptr; }
+
+  // Kernel thread ids to cover, in no particular order.  An open session
+  // moves to the new threads if they changed.
+  void SetThreads(const std::vector<int32_t>& thread_ids);
+
+  void SetTarget(std::chrono::nanoseconds target);
+
+  // Reports the CPU time one frame took, opening the session if needed.
+  void ReportActualWork(std::chrono::nanoseconds duration);
+
+  // Closes the session until the next ReportActualWork().
+  void Pause();
+
+  // Frames reported, how many overran the target, and sessions opened.
+  std::string GetReport() const;
+
+ private:
+  using GetManagerFunction = APerformanceHintManager* (*)();
+  using CreateSessionFunction = APerformanceHintSession* (*)(
+      APerformanceHintManager*, const int32_t*, size_t, int64_t);
+  using UpdateTargetFunction = int (*)(APerformanceHintSession*, int64_t);
+  using ReportActualFunction = int (*)(APerformanceHintSession*, int64_t);
+  using CloseSessionFunction = void (*)(APerformanceHintSession*);
+  using SetThreadsFunction = int (*)(APerformanceHintSession*, const int32_t*,
+                                     size_t);
+
+  void Open();
+
+  void* library_ = nullptr;
+  APerformanceHintManager* manager_ = nullptr;
+  CreateSessionFunction create_session_ = nullptr;
+  UpdateTargetFunction update_target_ = nullptr;
+  ReportActualFunction report_actual_ = nullptr;
+  CloseSessionFunction close_session_ = nullptr;
+  // Only on Android 14 and later; sessions are reopened without it.
+  SetThreadsFunction set_threads_ = nullptr;
+
+  APerformanceHintSession* session_ = nullptr;
+  std::chrono::nanoseconds target_;
+  // Sorted, so that SetThreads() tells a new set from a reordered one.
+  std::vector<int32_t> thread_ids_;
+  // Scratch of SetThreads().
+  std::vector<int32_t> sorted_thread_ids_;
+  // Set when no session could be opened for |thread_ids_|.
+  bool open_failed_ = false;
+
+  int64_t reported_frames_ = 0;
+  int64_t overrun_frames_ = 0;
+  int64_t opened_sessions_ = 0;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_PERFORMANCE_HINT_SESSION_H_
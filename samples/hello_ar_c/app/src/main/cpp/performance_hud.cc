@@ -0,0 +1,429 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "performance_hud.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "resource_accounting.h"
+#include "shader_variants.h"
+#include "util.h"
+
+namespace hello_ar {
+namespace {
+constexpr char kOwner[] = "PerformanceHud";
+
+// Glyphs of the bitmap font, five rows of three pixels from the top left,
+// '#' for set pixels.  The last glyph is solid and used for the graph and
+// the background.
+struct Glyph {
+  char character;
+  const char* pixels;
+};
+constexpr Glyph kGlyphs[] = {
+    {' ', "..." "..." "..." "..." "..."},
+    {'0', "###" "#.#" "#.#" "#.#" "###"},
+    {'1', ".#." "##." ".#." ".#." "###"},
+    {'2', "###" "..#" "###" "#.." "###"},
+    {'3', "###" "..#" ".##" "..#" "###"},
+    {'4', "#.#" "#.#" "###" "..#" "..#"},
+    {'5', "###" "#.." "###" "..#" "###"},
+    {'6', "###" "#.." "###" "#.#" "###"},
+    {'7', "###" "..#" "..#" ".#." ".#."},
+    {'8', "###" "#.#" "###" "#.#" "###"},
+    {'9', "###" "#.#" "###" "..#" "###"},
+    {'A', ".#." "#.#" "###" "#.#" "#.#"},
+    {'B', "##." "#.#" "##." "#.#" "##."},
+    {'C', ".##" "#.." "#.." "#.." ".##"},
+    {'D', "##." "#.#" "#.#" "#.#" "##."},
+    {'E', "###" "#.." "##." "#.." "###"},
+    {'F', "###" "#.." "##." "#.." "#.."},
+    {'G', ".##" "#.." "#.#" "#.#" ".##"},
+    {'H', "#.#" "#.#" "###" "#.#" "#.#"},
+    {'I', "###" ".#." ".#." ".#." "###"},
+    {'J', "..#" "..#" "..#" "#.#" ".#."},
+    {'K', "#.#" "#.#" "##." "#.#" "#.#"},
+    {'L', "#.." "#.." "#.." "#.." "###"},
+    {'M', "#.#" "###" "###" "#.#" "#.#"},
+    {'N', "##." "#.#" "#.#" "#.#" "#.#"},
+    {'O', ".#." "#.#" "#.#" "#.#" ".#."},
+    {'P', "##." "#.#" "##." "#.." "#.."},
+    {'Q', ".#." "#.#" "#.#" "##." ".##"},
+    {'R', "##." "#.#" "##." "#.#" "#.#"},
+    {'S', ".##" "#.." ".#." "..#" "##."},
+    {'T', "###" ".#." ".#." ".#." ".#."},
+    {'U', "#.#" "#.#" "#.#" "#.#" "###"},
+    {'V', "#.#" "#.#" "#.#" "#.#" ".#."},
+    {'W', "#.#" "#.#" "###" "###" "#.#"},
+    {'X', "#.#" "#.#" ".#." "#.#" "#.#"},
+    {'Y', "#.#" "#.#" ".#." ".#." ".#."},
+    {'Z', "###" "..#" ".#." "#.." "###"},
+    {'.', "..." "..." "..." "..." ".#."},
+    {':', "..." ".#." "..." ".#." "..."},
+    {'-', "..." "..." "###" "..." "..."},
+    {'/', "..#" "..#" ".#." "#.." "#.."},
+    {'%', "#.#" "..#" ".#." "#.." "#.#"},
+    {'\0', "###" "###" "###" "###" "###"}};
+constexpr int kGlyphCount = sizeof(kGlyphs) / sizeof(kGlyphs[0]);
+constexpr int kSolidGlyph = kGlyphCount - 1;
+
+// Font texture layout: each glyph in a cell with a column and a row of
+// spacing, which also keeps the glyphs apart when filtered.
+constexpr int kGlyphWidth = 3;
+constexpr int kGlyphHeight = 5;
+constexpr int kCellWidth = kGlyphWidth + 1;
+constexpr int kCellHeight = kGlyphHeight + 1;
+constexpr int kFontTextureWidth = kGlyphCount * kCellWidth;
+
+// Layout of the overlay, in font pixels.
+constexpr float kPadding = 4.f;
+constexpr float kLineHeight = kGlyphHeight + 2.f;
+constexpr float kGraphHeight = 30.f;
+constexpr float kPanelWidth = PerformanceHud::kGraphFrameCount + 2 * kPadding;
+// Frame time at the top of the graph, and the lines drawn for 60 and 30 fps.
+constexpr float kGraphRangeMs = 50.f;
+constexpr float kFrameBudgetMs = 1000.f / 60.f;
+
+// Surfaces are assumed to be viewed at about this many font pixels across
+// their short side.
+constexpr float kPixelsPerShortSide = 360.f;
+
+// Display names of the frame stages, indexed by FrameStage.
+constexpr const char* kStageLabels[kNumFrameStages] = {
+    "AR UPDATE", "BACKGROUND", "DEPTH", "PLANES", "ANCHORS", "POINTS"};
+
+constexpr uint8_t kPanelColor[4] = {0, 0, 0, 160};
+constexpr uint8_t kTextColor[4] = {240, 240, 240, 255};
+constexpr uint8_t kHeaderColor[4] = {160, 200, 255, 255};
+constexpr uint8_t kBudgetLineColor[4] = {255, 255, 255, 90};
+constexpr uint8_t kFastFrameColor[4] = {76, 175, 80, 255};
+constexpr uint8_t kSlowFrameColor[4] = {255, 193, 7, 255};
+constexpr uint8_t kDroppedFrameColor[4] = {244, 67, 54, 255};
+
+int FindGlyph(char character) {
+  const char upper = (character >= 'a' && character <= 'z')
+                         ? static_cast<char>(character - 'a' + 'A')
+                         : character;
+  for (int i = 0; i < kSolidGlyph; ++i) {
+    if (kGlyphs[i].character == upper) {
+      return i;
+    }
+  }
+  return 0;
+}
+
+// Formats a stage time, or a dash if the stage has no samples.
+void FormatStageMs(const FrameStageTimers::Summary& summary, char* text,
+                   size_t size) {
+  if (summary.sample_count == 0) {
+    snprintf(text, size, "     -");
+  } else {
+    snprintf(text, size, "%6.2f", summary.avg_ms);
+  }
+}
+}  // namespace
+
+constexpr int PerformanceHud::kGraphFrameCount;
+constexpr std::chrono::milliseconds PerformanceHud::kTextRefreshInterval;
+
+void PerformanceHud::InitializeGlContent(AAssetManager* asset_manager) {
+  shader_program_ =
+      util::CreateProgram(ShaderVariant::kPerformanceHud, asset_manager);
+  if (!shader_program_) {
+    LOGE("Could not create performance HUD program.");
+  }
+  uniform_surface_size_ =
+      glGetUniformLocation(shader_program_, "u_SurfaceSize");
+  uniform_font_ = glGetUniformLocation(shader_program_, "u_Font");
+
+  std::vector<uint8_t> texels(kFontTextureWidth * kCellHeight, 0);
+  for (int glyph = 0; glyph < kGlyphCount; ++glyph) {
+    const char* pixels = kGlyphs[glyph].pixels;
+    for (int y = 0; y < kGlyphHeight; ++y) {
+      for (int x = 0; x < kGlyphWidth; ++x) {
+        if (pixels[y * kGlyphWidth + x] == '#') {
+          texels[y * kFontTextureWidth + glyph * kCellWidth + x] = 255;
+        }
+      }
+    }
+  }
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
+  // Objects of a previous context are gone with it.
+  glGenTextures(1, &font_texture_);
+  gl_state.ActiveTexture(GL_TEXTURE0);
+  gl_state.BindTexture(GL_TEXTURE_2D, font_texture_);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  // Font pixels are drawn at whole multiples, so they stay sharp.
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexStorage2D(GL_TEXTURE_2D, 1, GL_R8, kFontTextureWidth, kCellHeight);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, kFontTextureWidth, kCellHeight,
+                  GL_RED, GL_UNSIGNED_BYTE, texels.data());
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  ResourceAccounting::Get().Track(
+      GpuResourceType::kTexture, font_texture_,
+      GetTextureBytes(GL_R8, kFontTextureWidth, kCellHeight), kOwner);
+
+  glGenVertexArrays(1, &vertex_array_);
+  glGenBuffers(1, &vertex_buffer_);
+  vertex_buffer_capacity_ = 0;
+  gl_state.BindVertexArray(vertex_array_);
+  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+  const GLint position_attrib =
+      glGetAttribLocation(shader_program_, "a_Position");
+  const GLint tex_coord_attrib =
+      glGetAttribLocation(shader_program_, "a_TexCoord");
+  const GLint color_attrib = glGetAttribLocation(shader_program_, "a_Color");
+  if (position_attrib >= 0 && tex_coord_attrib >= 0 && color_attrib >= 0) {
+    glEnableVertexAttribArray(position_attrib);
+    glVertexAttribPointer(position_attrib, 2, GL_FLOAT, GL_FALSE,
+                          sizeof(Vertex),
+                          reinterpret_cast<void*>(offsetof(Vertex, x)));
+    glEnableVertexAttribArray(tex_coord_attrib);
+    glVertexAttribPointer(tex_coord_attrib, 2, GL_FLOAT, GL_FALSE,
+                          sizeof(Vertex),
+                          reinterpret_cast<void*>(offsetof(Vertex, u)));
+    glEnableVertexAttribArray(color_attrib);
+    glVertexAttribPointer(color_attrib, 4, GL_UNSIGNED_BYTE, GL_TRUE,
+                          sizeof(Vertex),
+                          reinterpret_cast<void*>(offsetof(Vertex, rgba)));
+  }
+  gl_state.BindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  text_vertices_.clear();
+  Reset();
+  util::CheckGlError("PerformanceHud::InitializeGlContent()");
+}
+
+void PerformanceHud::Reset() {
+  frame_times_ms_.fill(0.f);
+  next_frame_ = 0;
+  has_last_frame_ = false;
+}
+
+void PerformanceHud::Draw(int surface_width, int surface_height,
+                          const std::function<Stats()>& collect_stats) {
+  if (!shader_program_) {
+    return;
+  }
+  const auto start = std::chrono::steady_clock::now();
+  if (has_last_frame_) {
+    frame_times_ms_[next_frame_] =
+        std::chrono::duration<float, std::milli>(start - last_frame_time_)
+            .count();
+    next_frame_ = (next_frame_ + 1) % kGraphFrameCount;
+  }
+  last_frame_time_ = start;
+  has_last_frame_ = true;
+
+  const float pixel_scale = std::max(
+      2.f, std::floor(std::min(surface_width, surface_height) /
+                      kPixelsPerShortSide));
+  if (text_vertices_.empty() || pixel_scale != pixel_scale_ ||
+      start - last_text_refresh_ >= kTextRefreshInterval) {
+    pixel_scale_ = pixel_scale;
+    last_text_refresh_ = start;
+    if (draw_count_ > 0) {
+      average_draw_time_ms_ = draw_time_sum_ms_ / draw_count_;
+      draw_time_sum_ms_ = 0.f;
+      draw_count_ = 0;
+    }
+    RebuildText(collect_stats());
+  }
+
+  // The panel, the graph and then the text, in the order they are blended.
+  const float s = pixel_scale_;
+  const float left = kPadding * s;
+  const float top = kPadding * s;
+  const float graph_top = top + kPadding * s;
+  const float graph_bottom = graph_top + kGraphHeight * s;
+  const float text_height = text_line_count_ * kLineHeight * s;
+  vertices_.clear();
+  AddSolidQuad(left, top, kPanelWidth * s,
+               (3 * kPadding + kGraphHeight) * s + text_height, kPanelColor,
+               &vertices_);
+  const float graph_left = left + kPadding * s;
+  for (float budget_ms : {kFrameBudgetMs, 2 * kFrameBudgetMs}) {
+    AddSolidQuad(graph_left, graph_bottom - budget_ms / kGraphRangeMs *
+                                                 kGraphHeight * s,
+                 kGraphFrameCount * s, 1.f, kBudgetLineColor, &vertices_);
+  }
+  for (int i = 0; i < kGraphFrameCount; ++i) {
+    // Oldest frame on the left.
+    const float frame_ms =
+        frame_times_ms_[(next_frame_ + i) % kGraphFrameCount];
+    if (frame_ms <= 0.f) {
+      continue;
+    }
+    const float height =
+        std::min(frame_ms / kGraphRangeMs, 1.f) * kGraphHeight * s;
+    const uint8_t* color = frame_ms <= kFrameBudgetMs * 1.1f
+                               ? kFastFrameColor
+                               : frame_ms <= 2 * kFrameBudgetMs * 1.1f
+                                     ? kSlowFrameColor
+                                     : kDroppedFrameColor;
+    AddSolidQuad(graph_left + i * s, graph_bottom - height, s, height, color,
+                 &vertices_);
+  }
+  vertices_.insert(vertices_.end(), text_vertices_.begin(),
+                   text_vertices_.end());
+
+  // Orphans the previous contents, so the upload does not wait for the last
+  // frame's draw.
+  const size_t bytes = vertices_.size() * sizeof(Vertex);
+  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+  if (bytes > vertex_buffer_capacity_) {
+    vertex_buffer_capacity_ = std::max(bytes, 2 * vertex_buffer_capacity_);
+    ResourceAccounting::Get().Track(GpuResourceType::kBuffer, vertex_buffer_,
+                                    vertex_buffer_capacity_, kOwner);
+  }
+  glBufferData(GL_ARRAY_BUFFER, vertex_buffer_capacity_, nullptr,
+               GL_STREAM_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, vertices_.data());
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glViewport(0, 0, surface_width, surface_height);
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
+  gl_state.SetCapability(GL_DEPTH_TEST, false);
+  gl_state.SetCapability(GL_CULL_FACE, false);
+  gl_state.SetCapability(GL_BLEND, true);
+  gl_state.BlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+  gl_state.UseProgram(shader_program_);
+  gl_state.ActiveTexture(GL_TEXTURE0);
+  gl_state.BindTexture(GL_TEXTURE_2D, font_texture_);
+  glUniform1i(uniform_font_, 0);
+  glUniform2f(uniform_surface_size_, static_cast<float>(surface_width),
+              static_cast<float>(surface_height));
+  gl_state.BindVertexArray(vertex_array_);
+  glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(vertices_.size()));
+  gl_state.BindVertexArray(0);
+  util::CheckGlError("PerformanceHud::Draw()");
+
+  draw_time_sum_ms_ += std::chrono::duration<float, std::milli>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+  ++draw_count_;
+}
+
+void PerformanceHud::AddQuad(float left, float top, float width, float height,
+                             float u0, float v0, float u1, float v1,
+                             const uint8_t* rgba,
+                             std::vector<Vertex>* vertices) const {
+  const float right = left + width;
+  const float bottom = top + height;
+  const Vertex corners[4] = {{left, top, u0, v0, {}},
+                             {right, top, u1, v0, {}},
+                             {left, bottom, u0, v1, {}},
+                             {right, bottom, u1, v1, {}}};
+  for (int corner : {0, 2, 1, 1, 2, 3}) {
+    vertices->push_back(corners[corner]);
+    std::memcpy(vertices->back().rgba, rgba, 4);
+  }
+}
+
+void PerformanceHud::AddSolidQuad(float left, float top, float width,
+                                  float height, const uint8_t* rgba,
+                                  std::vector<Vertex>* vertices) const {
+  // Every corner samples the middle of the solid glyph.
+  const float u = (kSolidGlyph * kCellWidth + 0.5f * kGlyphWidth) /
+                  kFontTextureWidth;
+  const float v = 0.5f * kGlyphHeight / kCellHeight;
+  AddQuad(left, top, width, height, u, v, u, v, rgba, vertices);
+}
+
+void PerformanceHud::AddText(const char* text, float left, float top,
+                             const uint8_t* rgba,
+                             std::vector<Vertex>* vertices) const {
+  const float s = pixel_scale_;
+  for (float x = left; *text != '\0'; ++text, x += kCellWidth * s) {
+    const int glyph = FindGlyph(*text);
+    if (glyph == 0) {
+      continue;
+    }
+    const float u0 =
+        static_cast<float>(glyph * kCellWidth) / kFontTextureWidth;
+    const float u1 = u0 + static_cast<float>(kGlyphWidth) / kFontTextureWidth;
+    AddQuad(x, top, kGlyphWidth * s, kGlyphHeight * s, u0, 0.f, u1,
+            static_cast<float>(kGlyphHeight) / kCellHeight, rgba, vertices);
+  }
+}
+
+void PerformanceHud::RebuildText(const Stats& stats) {
+  float sum_ms = 0.f;
+  float worst_ms = 0.f;
+  int frames = 0;
+  for (float frame_ms : frame_times_ms_) {
+    if (frame_ms > 0.f) {
+      sum_ms += frame_ms;
+      worst_ms = std::max(worst_ms, frame_ms);
+      ++frames;
+    }
+  }
+  const float average_ms = frames > 0 ? sum_ms / frames : 0.f;
+
+  const float s = pixel_scale_;
+  const float left = 2 * kPadding * s;
+  float top = (3 * kPadding + kGraphHeight) * s;
+  text_vertices_.clear();
+  text_line_count_ = 0;
+  auto add_line = [&](const char* text, const uint8_t* rgba) {
+    AddText(text, left, top, rgba, &text_vertices_);
+    top += kLineHeight * s;
+    ++text_line_count_;
+  };
+
+  char line[64];
+  snprintf(line, sizeof(line), "FRAME %5.1f MS %4.0f FPS", average_ms,
+           average_ms > 0.f ? 1000.f / average_ms : 0.f);
+  add_line(line, kTextColor);
+  snprintf(line, sizeof(line), "WORST %5.1f MS", worst_ms);
+  add_line(line, kTextColor);
+  add_line(stats.has_gpu_timers ? "STAGE       CPU MS GPU MS"
+                                : "STAGE       CPU MS GPU N/A",
+           kHeaderColor);
+  for (int i = 0; i < kNumFrameStages; ++i) {
+    char cpu_ms[16];
+    char gpu_ms[16];
+    FormatStageMs(stats.cpu_stages[i], cpu_ms, sizeof(cpu_ms));
+    FormatStageMs(stats.gpu_stages[i], gpu_ms, sizeof(gpu_ms));
+    snprintf(line, sizeof(line), "%-11s %s %s", kStageLabels[i], cpu_ms,
+             gpu_ms);
+    add_line(line, kTextColor);
+  }
+  snprintf(line, sizeof(line), "PASSES %d STATE CHANGES %d", stats.passes,
+           stats.pass_state_changes);
+  add_line(line, kTextColor);
+  snprintf(line, sizeof(line), "GL CALLS SKIPPED %d",
+           stats.eliminated_gl_calls);
+  add_line(line, kTextColor);
+  snprintf(line, sizeof(line), "ANCHORS %d CULLED %d", stats.anchors_drawn,
+           stats.anchors_culled);
+  add_line(line, kTextColor);
+  snprintf(line, sizeof(line), "UPLOADS %d DEPTH %.0f/S", stats.asset_uploads,
+           stats.depth_uploads_per_second);
+  add_line(line, kTextColor);
+  snprintf(line, sizeof(line), "HUD %.3f MS", average_draw_time_ms_);
+  add_line(line, kHeaderColor);
+}
+
+}  // namespace hello_ar
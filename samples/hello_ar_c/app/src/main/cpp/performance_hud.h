@@ -0,0 +1,137 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_PERFORMANCE_HUD_H_
+#define C_ARCORE_HELLOE_AR_PERFORMANCE_HUD_H_
+
+#include <GLES3/gl3.h>
+#include <android/asset_manager.h>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "frame_stage_timers.h"
+
+namespace hello_ar {
+
+// On-device overlay with a graph of the recent frame times and a table of
+// the frame stage timings and counters, for profiling without a trace.
+//
+// Everything is drawn as quads from one dynamic vertex buffer in a single
+// draw call.  Text uses a 3x5 pixel bitmap font, which is uploaded once as a
+// small texture; the same texture has a solid glyph for the untextured
+// quads.  The graph is updated every frame, the text only every
+// kTextRefreshInterval so its values stay readable and the statistics are
+// not collected on every frame.
+class PerformanceHud {
+ public:
+  static constexpr int kGraphFrameCount = 120;
+  static constexpr std::chrono::milliseconds kTextRefreshInterval{250};
+
+  // Values shown in the text, collected when it is refreshed.
+  struct Stats {
+    std::array<FrameStageTimers::Summary, kNumFrameStages> cpu_stages = {};
+    std::array<FrameStageTimers::Summary, kNumFrameStages> gpu_stages = {};
+    // Whether gpu_stages can have samples at all.
+    bool has_gpu_timers = false;
+    int passes = 0;
+    int pass_state_changes = 0;
+    int eliminated_gl_calls = 0;
+    int anchors_drawn = 0;
+    int anchors_culled = 0;
+    int asset_uploads = 0;
+    float depth_uploads_per_second = 0.f;
+  };
+
+  PerformanceHud() = default;
+
+  PerformanceHud(const PerformanceHud&) = delete;
+  PerformanceHud& operator=(const PerformanceHud&) = delete;
+
+  // Creates the program, font texture and vertex buffer.  Must be called on
+  // the OpenGL thread prior to Draw().
+  void InitializeGlContent(AAssetManager* asset_manager);
+
+  // Records the time since the previous call into the graph and draws the
+  // overlay into the top left corner of the default framebuffer, which is
+  // |surface_width| x |surface_height| pixels.  |collect_stats| is only called
+  // when the text is refreshed.  Must be called on the OpenGL thread once per
+  // frame, after everything else was drawn.
+  void Draw(int surface_width, int surface_height,
+            const std::function<Stats()>& collect_stats);
+
+  // Forgets the frame times, e.g. while the overlay was hidden, so the next
+  // frame does not record the gap as a long frame.
+  void Reset();
+
+ private:
+  // Interleaved vertex of the quads, with its position in pixels from the top
+  // left corner of the surface.
+  struct Vertex {
+    float x;
+    float y;
+    float u;
+    float v;
+    uint8_t rgba[4];
+  };
+
+  void AddQuad(float left, float top, float width, float height, float u0,
+               float v0, float u1, float v1, const uint8_t* rgba,
+               std::vector<Vertex>* vertices) const;
+  void AddSolidQuad(float left, float top, float width, float height,
+                    const uint8_t* rgba, std::vector<Vertex>* vertices) const;
+  // Adds |text| with its top left corner at (|left|, |top|).  Lower case
+  // letters are drawn as upper case, characters without glyph as spaces.
+  void AddText(const char* text, float left, float top, const uint8_t* rgba,
+               std::vector<Vertex>* vertices) const;
+
+  // Lays out the text lines of |stats| into text_vertices_.
+  void RebuildText(const Stats& stats);
+
+  GLuint shader_program_ = 0;
+  GLint uniform_surface_size_ = -1;
+  GLint uniform_font_ = -1;
+  GLuint font_texture_ = 0;
+  GLuint vertex_array_ = 0;
+  GLuint vertex_buffer_ = 0;
+  size_t vertex_buffer_capacity_ = 0;
+
+  // Size of a font pixel on screen, in pixels.
+  float pixel_scale_ = 1.f;
+  int text_line_count_ = 0;
+  // Frame times in milliseconds, a ring starting at next_frame_.
+  std::array<float, kGraphFrameCount> frame_times_ms_ = {};
+  int next_frame_ = 0;
+  std::chrono::steady_clock::time_point last_frame_time_;
+  std::chrono::steady_clock::time_point last_text_refresh_;
+  bool has_last_frame_ = false;
+  // CPU time of the last Draw() calls, to show the overlay's own cost.
+  float draw_time_sum_ms_ = 0.f;
+  int draw_count_ = 0;
+  float average_draw_time_ms_ = 0.f;
+
+  // Reused across frames: the text quads from the last refresh, and all
+  // quads of the current frame.
+  std::vector<Vertex> text_vertices_;
+  std::vector<Vertex> vertices_;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_PERFORMANCE_HUD_H_
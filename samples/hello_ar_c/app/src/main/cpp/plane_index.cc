@@ -0,0 +1,231 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "plane_index.h"
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+#include "util.h"
+
+namespace hello_ar {
+namespace {
+constexpr int kLanes = 4;
+// Planes are flat, so their bounds are padded to keep the slab test away
+// from zero-width slabs.
+constexpr float kBoundsPadding = 1e-3f;
+// Rays this close to parallel to a plane miss it.
+constexpr float kMinCosine = 1e-6f;
+
+// Even-odd test of |point| against |polygon|.
+bool IsInPolygon(const std::vector<glm::vec2>& polygon,
+                 const glm::vec2& point) {
+  bool inside = false;
+  const size_t size = polygon.size();
+  for (size_t i = 0, j = size - 1; i < size; j = i++) {
+    const glm::vec2& a = polygon[i];
+    const glm::vec2& b = polygon[j];
+    if ((a.y > point.y) != (b.y > point.y) &&
+        point.x < (b.x - a.x) * (point.y - a.y) / (b.y - a.y) + a.x) {
+      inside = !inside;
+    }
+  }
+  return inside;
+}
+}  // namespace
+
+void PlaneIndex::UpdatePlane(const ArSession& ar_session,
+                             const ArPlane& ar_plane) {
+  int32_t polygon_length = 0;
+  ArPlane_getPolygonSize(&ar_session, &ar_plane, &polygon_length);
+  if (polygon_length < 6) {
+    RemovePlane(ar_plane);
+    return;
+  }
+
+  auto inserted = plane_indices_.emplace(&ar_plane, planes_.size());
+  if (inserted.second) {
+    planes_.emplace_back();
+    if (planes_.size() > bounds_.size() * kLanes) {
+      bounds_.emplace_back();
+    }
+  }
+  const size_t index = inserted.first->second;
+  Plane& plane = planes_[index];
+  plane.handle = &ar_plane;
+  plane.polygon.resize(polygon_length / 2);
+  ArPlane_getPolygon(&ar_session, &ar_plane,
+                     glm::value_ptr(plane.polygon.front()));
+
+  util::ScopedArPose pose(&ar_session);
+  ArPlane_getCenterPose(&ar_session, &ar_plane, pose.GetArPose());
+  glm::mat4 world_from_plane(1.0f);
+  ArPose_getMatrix(&ar_session, pose.GetArPose(),
+                   glm::value_ptr(world_from_plane));
+  plane.plane_from_world = glm::inverse(world_from_plane);
+  plane.center = glm::vec3(world_from_plane[3]);
+  plane.normal = glm::normalize(glm::vec3(world_from_plane[1]));
+
+  glm::vec3 min(std::numeric_limits<float>::max());
+  glm::vec3 max(-std::numeric_limits<float>::max());
+  for (const glm::vec2& vertex : plane.polygon) {
+    const glm::vec3 world(world_from_plane *
+                          glm::vec4(vertex.x, 0.0f, vertex.y, 1.0f));
+    min = glm::min(min, world);
+    max = glm::max(max, world);
+  }
+  SetBounds(index, min - kBoundsPadding, max + kBoundsPadding);
+}
+
+void PlaneIndex::RemovePlane(const ArPlane& ar_plane) {
+  auto it = plane_indices_.find(&ar_plane);
+  if (it == plane_indices_.end()) {
+    return;
+  }
+  // Moves the last plane into the gap.
+  const size_t index = it->second;
+  const size_t last = planes_.size() - 1;
+  plane_indices_.erase(it);
+  if (index != last) {
+    planes_[index] = std::move(planes_[last]);
+    plane_indices_[planes_[index].handle] = index;
+    const Bounds4& last_bounds = bounds_[last / kLanes];
+    const int lane = last % kLanes;
+    SetBounds(index,
+              glm::vec3(last_bounds.min[0][lane], last_bounds.min[1][lane],
+                        last_bounds.min[2][lane]),
+              glm::vec3(last_bounds.max[0][lane], last_bounds.max[1][lane],
+                        last_bounds.max[2][lane]));
+  }
+  planes_.pop_back();
+  if (bounds_.size() * kLanes >= planes_.size() + kLanes) {
+    bounds_.pop_back();
+  }
+}
+
+void PlaneIndex::Clear() {
+  planes_.clear();
+  bounds_.clear();
+  plane_indices_.clear();
+}
+
+void PlaneIndex::Raycast(const Ray* rays, int count, Hit* hits) const {
+  for (int r = 0; r < count; ++r) {
+    const Ray& ray = rays[r];
+    Hit& hit = hits[r];
+    hit = Hit();
+    hit.distance = std::numeric_limits<float>::max();
+    const glm::vec3 inverse_direction = 1.0f / ray.direction;
+    for (size_t group = 0; group < bounds_.size(); ++group) {
+      unsigned int mask = IntersectBounds(bounds_[group], ray,
+                                          inverse_direction, hit.distance);
+      const size_t remaining = planes_.size() - group * kLanes;
+      if (remaining < kLanes) {
+        mask &= (1u << remaining) - 1u;
+      }
+      for (int lane = 0; mask != 0; ++lane, mask >>= 1) {
+        if (mask & 1u) {
+          IntersectPlane(planes_[group * kLanes + lane], ray, &hit);
+        }
+      }
+    }
+    if (hit.plane == nullptr) {
+      hit.distance = 0.0f;
+    }
+  }
+}
+
+unsigned int PlaneIndex::IntersectBounds(const Bounds4& bounds,
+                                         const Ray& ray,
+                                         const glm::vec3& inverse_direction,
+                                         float max_distance) {
+#if defined(__ARM_NEON)
+  float32x4_t near = vdupq_n_f32(0.0f);
+  float32x4_t far = vdupq_n_f32(max_distance);
+  for (int axis = 0; axis < 3; ++axis) {
+    const float32x4_t origin = vdupq_n_f32(ray.origin[axis]);
+    const float32x4_t t0 = vmulq_n_f32(
+        vsubq_f32(vld1q_f32(bounds.min[axis]), origin),
+        inverse_direction[axis]);
+    const float32x4_t t1 = vmulq_n_f32(
+        vsubq_f32(vld1q_f32(bounds.max[axis]), origin),
+        inverse_direction[axis]);
+    near = vmaxq_f32(near, vminq_f32(t0, t1));
+    far = vminq_f32(far, vmaxq_f32(t0, t1));
+  }
+  uint32_t lanes[kLanes];
+  vst1q_u32(lanes, vcleq_f32(near, far));
+  return (lanes[0] & 1u) | (lanes[1] & 2u) | (lanes[2] & 4u) |
+         (lanes[3] & 8u);
+#else
+  unsigned int mask = 0;
+  for (int lane = 0; lane < kLanes; ++lane) {
+    float near = 0.0f;
+    float far = max_distance;
+    for (int axis = 0; axis < 3; ++axis) {
+      const float t0 =
+          (bounds.min[axis][lane] - ray.origin[axis]) * inverse_direction[axis];
+      const float t1 =
+          (bounds.max[axis][lane] - ray.origin[axis]) * inverse_direction[axis];
+      near = std::max(near, std::min(t0, t1));
+      far = std::min(far, std::max(t0, t1));
+    }
+    if (near <= far) {
+      mask |= 1u << lane;
+    }
+  }
+  return mask;
+#endif  // __ARM_NEON
+}
+
+void PlaneIndex::IntersectPlane(const Plane& plane, const Ray& ray,
+                                Hit* hit) {
+  // Rays from behind the plane, or along it, do not hit it.
+  const float cosine = glm::dot(plane.normal, ray.direction);
+  if (cosine > -kMinCosine) {
+    return;
+  }
+  const float distance =
+      glm::dot(plane.normal, plane.center - ray.origin) / cosine;
+  if (distance < 0.0f || distance >= hit->distance) {
+    return;
+  }
+  const glm::vec3 position = ray.origin + distance * ray.direction;
+  const glm::vec4 local = plane.plane_from_world * glm::vec4(position, 1.0f);
+  if (!IsInPolygon(plane.polygon, glm::vec2(local.x, local.z))) {
+    return;
+  }
+  hit->plane = plane.handle;
+  hit->distance = distance;
+  hit->position = position;
+}
+
+void PlaneIndex::SetBounds(size_t index, const glm::vec3& min,
+                           const glm::vec3& max) {
+  Bounds4& bounds = bounds_[index / kLanes];
+  const int lane = index % kLanes;
+  for (int axis = 0; axis < 3; ++axis) {
+    bounds.min[axis][lane] = min[axis];
+    bounds.max[axis][lane] = max[axis];
+  }
+}
+
+}  // namespace hello_ar
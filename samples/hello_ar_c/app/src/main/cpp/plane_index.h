@@ -0,0 +1,108 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_PLANE_INDEX_H_
+#define C_ARCORE_HELLOE_AR_PLANE_INDEX_H_
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+#include "arcore_c_api.h"
+#include "glm.h"
+
+namespace hello_ar {
+
+// CPU copy of the tracked planes for raycasts that do not go through
+// ArFrame_hitTest, e.g. for a reticle or simulation queries many times per
+// frame.
+//
+// Every plane keeps its polygon and center pose as of its last
+// UpdatePlane(), which should be called for the planes reported by
+// ArFrame_getUpdatedTrackables().  The world space bounds of the planes are
+// stored as struct of arrays, so that Raycast() tests four planes at a time,
+// with NEON where available; only the planes whose bounds a ray enters are
+// tested exactly.
+//
+// A hit follows the rules HelloArApplication applies to ArFrame_hitTest
+// results: the ray must hit the front of the plane and the hit must be
+// inside the polygon, as ArPlane_isPoseInPolygon() would report.
+//
+// Not thread safe.
+class PlaneIndex {
+ public:
+  struct Ray {
+    glm::vec3 origin = glm::vec3(0.0f);
+    // Need not be normalized; hit distances are in units of its length.
+    glm::vec3 direction = glm::vec3(0.0f, 0.0f, -1.0f);
+  };
+
+  struct Hit {
+    // The nearest plane hit, or nullptr.  Only valid while the plane is.
+    const ArPlane* plane = nullptr;
+    float distance = 0.0f;
+    glm::vec3 position = glm::vec3(0.0f);
+  };
+
+  // Mirrors the polygon and pose of |ar_plane|, adding it if needed.
+  void UpdatePlane(const ArSession& ar_session, const ArPlane& ar_plane);
+
+  // Forgets |ar_plane|, e.g. once it was subsumed or stopped tracking.
+  void RemovePlane(const ArPlane& ar_plane);
+
+  void Clear();
+
+  // Writes the nearest hit of each of the |count| rays to |hits|.
+  void Raycast(const Ray* rays, int count, Hit* hits) const;
+
+  size_t GetPlaneCount() const { return planes_.size(); }
+
+ private:
+  struct Plane {
+    const ArPlane* handle = nullptr;
+    glm::mat4 plane_from_world = glm::mat4(1.0f);
+    glm::vec3 center = glm::vec3(0.0f);
+    glm::vec3 normal = glm::vec3(0.0f, 1.0f, 0.0f);
+    // Polygon in plane space, x and z.
+    std::vector<glm::vec2> polygon;
+  };
+
+  // Bounds of four planes, one plane per lane.  Lanes past the last plane
+  // are ignored.
+  struct Bounds4 {
+    float min[3][4];
+    float max[3][4];
+  };
+
+  // Returns a mask of the lanes of |bounds| that |ray| enters before
+  // |max_distance|.
+  static unsigned int IntersectBounds(const Bounds4& bounds, const Ray& ray,
+                                      const glm::vec3& inverse_direction,
+                                      float max_distance);
+
+  // Exact test of |ray| against |plane|, updating |hit| if it is nearer.
+  static void IntersectPlane(const Plane& plane, const Ray& ray, Hit* hit);
+
+  void SetBounds(size_t index, const glm::vec3& min, const glm::vec3& max);
+
+  std::vector<Plane> planes_;
+  std::vector<Bounds4> bounds_;
+  std::unordered_map<const ArPlane*, size_t> plane_indices_;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_PLANE_INDEX_H_
@@ -0,0 +1,91 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "plane_registry.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "resource_accounting.h"
+
+namespace hello_ar {
+
+PlaneRegistry::~PlaneRegistry() { Clear(); }
+
+void PlaneRegistry::UpdatePlane(ArPlane* ar_plane, PlaneState state) {
+  auto it = planes_.find(ar_plane);
+  if (it == planes_.end()) {
+    if (state == PlaneState::kDropped) {
+      ArTrackable_release(ArAsTrackable(ar_plane));
+      return;
+    }
+    Entry entry;
+    entry.plane = ar_plane;
+    entry.state = state;
+    entry.sequence = next_sequence_++;
+    planes_.emplace(ar_plane, entry);
+    ResourceAccounting::Get().AddArHandles(ArHandleType::kTrackable, 1);
+    if (state == PlaneState::kTracking) {
+      renderable_planes_.push_back(ar_plane);
+    }
+    return;
+  }
+
+  // ARCore hands out the same handle for a plane every time, so this is a
+  // second reference to the one the entry holds.
+  ArTrackable_release(ArAsTrackable(ar_plane));
+  Entry& entry = it->second;
+  if (entry.state == state) {
+    return;
+  }
+  const bool was_renderable = entry.state == PlaneState::kTracking;
+  if (state == PlaneState::kDropped) {
+    ArTrackable_release(ArAsTrackable(entry.plane));
+    ResourceAccounting::Get().AddArHandles(ArHandleType::kTrackable, -1);
+    planes_.erase(it);
+  } else {
+    entry.state = state;
+  }
+  if (was_renderable || state == PlaneState::kTracking) {
+    RebuildRenderablePlanes();
+  }
+}
+
+void PlaneRegistry::Clear() {
+  for (auto& plane : planes_) {
+    ArTrackable_release(ArAsTrackable(plane.second.plane));
+  }
+  ResourceAccounting::Get().AddArHandles(
+      ArHandleType::kTrackable, -static_cast<int>(planes_.size()));
+  planes_.clear();
+  renderable_planes_.clear();
+}
+
+void PlaneRegistry::RebuildRenderablePlanes() {
+  std::vector<std::pair<uint64_t, const ArPlane*>> ordered;
+  ordered.reserve(planes_.size());
+  for (const auto& plane : planes_) {
+    if (plane.second.state == PlaneState::kTracking) {
+      ordered.emplace_back(plane.second.sequence, plane.second.plane);
+    }
+  }
+  std::sort(ordered.begin(), ordered.end());
+  renderable_planes_.clear();
+  for (const auto& plane : ordered) {
+    renderable_planes_.push_back(plane.second);
+  }
+}
+
+}  // namespace hello_ar
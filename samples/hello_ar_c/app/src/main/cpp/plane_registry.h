@@ -0,0 +1,89 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef C_ARCORE_HELLOE_AR_PLANE_REGISTRY_H_
+#define C_ARCORE_HELLOE_AR_PLANE_REGISTRY_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "arcore_c_api.h"
+
+namespace hello_ar {
+
+// The planes of a session and which of them are worth drawing, maintained
+// from ArFrame_getUpdatedTrackables() alone.
+//
+// Iterating ArSession_getAllTrackables() and asking every plane for its
+// tracking state and subsuming plane costs a handful of ARCore calls per
+// plane and frame, although planes rarely change state.  The registry keeps
+// the answers of the last update of each plane instead, and a flat array of
+// the planes that are tracking and not subsumed, which is all the renderer
+// iterates.
+//
+// The registry owns one reference to each of its planes, so the pointers it
+// hands out stay valid until the plane is dropped.  Not thread safe.
+class PlaneRegistry {
+ public:
+  enum class PlaneState {
+    kTracking,
+    // Paused planes may resume tracking, so they are kept but not drawn.
+    kPaused,
+    // Subsumed or stopped planes never come back.
+    kDropped,
+  };
+
+  PlaneRegistry() = default;
+  ~PlaneRegistry();
+
+  PlaneRegistry(const PlaneRegistry&) = delete;
+  PlaneRegistry& operator=(const PlaneRegistry&) = delete;
+
+  // Records the state of an updated plane.  Takes over the reference
+  // |ar_plane| was acquired with, e.g. from ArTrackableList_acquireItem().
+  void UpdatePlane(ArPlane* ar_plane, PlaneState state);
+
+  // Releases all planes.  Must be called before the session is destroyed.
+  void Clear();
+
+  // The planes that are tracking and not subsumed, in the order they were
+  // first seen.
+  const std::vector<const ArPlane*>& GetRenderablePlanes() const {
+    return renderable_planes_;
+  }
+
+  // Planes that were not dropped, including the paused ones.
+  size_t GetPlaneCount() const { return planes_.size(); }
+
+ private:
+  struct Entry {
+    ArPlane* plane = nullptr;
+    PlaneState state = PlaneState::kTracking;
+    // Order of the first update, which keeps the draw order stable.
+    uint64_t sequence = 0;
+  };
+
+  void RebuildRenderablePlanes();
+
+  std::unordered_map<const ArPlane*, Entry> planes_;
+  std::vector<const ArPlane*> renderable_planes_;
+  uint64_t next_sequence_ = 0;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_PLANE_REGISTRY_H_
@@ -15,43 +15,207 @@
  */
 
 #include "plane_renderer.h"
+#include <GLES3/gl31.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
 #include <string>
+#include <utility>
+#include "resource_accounting.h"
 #include "util.h"
 
 namespace hello_ar {
 namespace {
-constexpr char kVertexShaderFilename[] = "shaders/plane.vert";
-constexpr char kFragmentShaderFilename[] = "shaders/plane.frag";
+constexpr char kOwner[] = "PlaneRenderer";
+
+// Corners of the triangles drawn for every outline edge: x selects the end
+// of the edge, y the ring, with 0 on the outline, 1 on the inner feather
+// ring and 2 at the plane center.  The first triangle fills the inside of
+// the inner ring, the other two the feathered band.
+constexpr GLfloat kEdgeTemplate[] = {
+    0.0f, 2.0f, 0.0f, 1.0f, 1.0f, 1.0f,  // center, inner start, inner end
+    0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f,  // outer start, outer end, inner start
+    0.0f, 1.0f, 1.0f, 0.0f, 1.0f, 1.0f,  // inner start, outer end, inner end
+};
+constexpr int kCornerComponents = 2;
+constexpr GLsizei kTemplateVertexCount =
+    sizeof(kEdgeTemplate) / sizeof(kEdgeTemplate[0]) / kCornerComponents;
+// The leading triangle of the template, inside the inner ring.
+constexpr GLsizei kInteriorVertexCount = 3;
+
+// Culls the edges of a batch on the GPU.
+constexpr char kEdgeCullShaderFileName[] = "shaders/plane_edge_cull.comp";
+// Must match local_size_x of the culling shader.
+constexpr GLuint kCullWorkGroupSize = 64;
+
+// Points |corner| at the template buffer bound to GL_ARRAY_BUFFER.
+void SetCornerAttribute(GLint corner) {
+  glEnableVertexAttribArray(corner);
+  glVertexAttribPointer(corner, kCornerComponents, GL_FLOAT, GL_FALSE, 0,
+                        nullptr);
+}
+
+// Points |edge_start| and |edge_end| at consecutive elements of the outline
+// bound to GL_ARRAY_BUFFER, advancing once per instance.
+void SetEdgeAttributes(GLint edge_start, GLint edge_end, GLint components,
+                       GLsizei stride) {
+  glEnableVertexAttribArray(edge_start);
+  glVertexAttribPointer(edge_start, components, GL_FLOAT, GL_FALSE, stride,
+                        nullptr);
+  glVertexAttribDivisor(edge_start, 1);
+  glEnableVertexAttribArray(edge_end);
+  glVertexAttribPointer(edge_end, components, GL_FLOAT, GL_FALSE, stride,
+                        reinterpret_cast<const void*>(
+                            static_cast<uintptr_t>(stride)));
+  glVertexAttribDivisor(edge_end, 1);
+}
+
+// Squared distance of |p| to the segment from |a| to |b|.
+float GetSegmentDistanceSquared(const glm::vec2& p, const glm::vec2& a,
+                                const glm::vec2& b) {
+  const glm::vec2 ab = b - a;
+  const float length_squared = glm::dot(ab, ab);
+  const float t =
+      length_squared > 0.0f
+          ? glm::clamp(glm::dot(p - a, ab) / length_squared, 0.0f, 1.0f)
+          : 0.0f;
+  const glm::vec2 offset = p - (a + t * ab);
+  return glm::dot(offset, offset);
+}
+
+// Douglas-Peucker simplification of a closed polygon.  The ring is split at
+// its first vertex and the vertex farthest from it, which are always kept,
+// and each half is simplified on its own.  Keeps the polygon as is if fewer
+// than three vertices would remain.
+void SimplifyPolygon(float tolerance, std::vector<glm::vec2>* polygon) {
+  const int size = static_cast<int>(polygon->size());
+  if (tolerance <= 0.0f || size <= 3) {
+    return;
+  }
+  const std::vector<glm::vec2>& points = *polygon;
+  int farthest = 0;
+  float farthest_distance_squared = 0.0f;
+  for (int i = 1; i < size; ++i) {
+    const glm::vec2 offset = points[i] - points[0];
+    const float distance_squared = glm::dot(offset, offset);
+    if (distance_squared > farthest_distance_squared) {
+      farthest = i;
+      farthest_distance_squared = distance_squared;
+    }
+  }
+  if (farthest == 0) {
+    return;
+  }
+
+  std::vector<bool> keep(size, false);
+  keep[0] = true;
+  keep[farthest] = true;
+  int kept = 2;
+  // Spans of the ring as [first, last], with |size| standing for vertex 0.
+  std::vector<std::pair<int, int>> spans = {{0, farthest}, {farthest, size}};
+  const float tolerance_squared = tolerance * tolerance;
+  while (!spans.empty()) {
+    const int first = spans.back().first;
+    const int last = spans.back().second;
+    spans.pop_back();
+    const glm::vec2& a = points[first];
+    const glm::vec2& b = points[last % size];
+    int split = -1;
+    float split_distance_squared = tolerance_squared;
+    for (int i = first + 1; i < last; ++i) {
+      const float distance_squared = GetSegmentDistanceSquared(points[i], a, b);
+      if (distance_squared > split_distance_squared) {
+        split = i;
+        split_distance_squared = distance_squared;
+      }
+    }
+    if (split >= 0) {
+      keep[split] = true;
+      ++kept;
+      spans.push_back({first, split});
+      spans.push_back({split, last});
+    }
+  }
+  if (kept < 3) {
+    return;
+  }
+
+  int written = 0;
+  for (int i = 0; i < size; ++i) {
+    if (keep[i]) {
+      (*polygon)[written++] = points[i];
+    }
+  }
+  polygon->resize(written);
+}
 }  // namespace
 
+constexpr float PlaneRenderer::kDefaultPolygonToleranceM;
+
 void PlaneRenderer::InitializeGlContent(AAssetManager* asset_manager) {
-  shader_program_ = util::CreateProgram(kVertexShaderFilename,
-                                        kFragmentShaderFilename, asset_manager);
+  shader_program_ =
+      util::CreateProgram(ShaderVariant::kPlane, asset_manager);
   if (!shader_program_) {
     LOGE("Could not create program.");
   }
 
   uniform_mvp_mat_ = glGetUniformLocation(shader_program_, "mvp");
-  uniform_texture_ = glGetUniformLocation(shader_program_, "texture");
   uniform_model_mat_ = glGetUniformLocation(shader_program_, "model_mat");
   uniform_normal_vec_ = glGetUniformLocation(shader_program_, "normal");
-  attri_vertices_ = glGetAttribLocation(shader_program_, "vertex");
-
-  glGenTextures(1, &texture_id_);
-  glBindTexture(GL_TEXTURE_2D, texture_id_);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
-                  GL_LINEAR_MIPMAP_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-  if (!util::LoadPngFromAssetManager(GL_TEXTURE_2D, "models/trigrid.png")) {
-    LOGE("Could not load png texture for planes.");
+  attri_corner_ = glGetAttribLocation(shader_program_, "corner");
+  attri_edge_start_ = glGetAttribLocation(shader_program_, "edge_start");
+  attri_edge_end_ = glGetAttribLocation(shader_program_, "edge_end");
+
+  batch_shader_program_ =
+      util::CreateProgram(ShaderVariant::kPlaneBatched, asset_manager);
+  if (!batch_shader_program_) {
+    LOGE("Could not create batched program.");
   }
 
-  glGenerateMipmap(GL_TEXTURE_2D);
-
-  glBindTexture(GL_TEXTURE_2D, 0);
+  batch_uniform_view_projection_mat_ =
+      glGetUniformLocation(batch_shader_program_, "mvp");
+  batch_attri_corner_ = glGetAttribLocation(batch_shader_program_, "corner");
+  batch_attri_edge_start_ =
+      glGetAttribLocation(batch_shader_program_, "edge_start");
+  batch_attri_edge_end_ =
+      glGetAttribLocation(batch_shader_program_, "edge_end");
+  batch_attri_center_ =
+      glGetAttribLocation(batch_shader_program_, "plane_center");
+  batch_attri_normal_ =
+      glGetAttribLocation(batch_shader_program_, "vertex_normal");
+
+  glGenBuffers(1, &template_buffer_);
+  glBindBuffer(GL_ARRAY_BUFFER, template_buffer_);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(kEdgeTemplate), kEdgeTemplate,
+               GL_STATIC_DRAW);
+  ResourceAccounting::Get().Track(GpuResourceType::kBuffer, template_buffer_,
+                                  sizeof(kEdgeTemplate), kOwner);
+
+  // The batch buffer keeps its name when it is orphaned, so the vertex array
+  // is only set up once.
+  glGenBuffers(1, &batch_vertex_buffer_);
+  glGenVertexArrays(1, &batch_vertex_array_);
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
+  gl_state.BindVertexArray(batch_vertex_array_);
+  SetCornerAttribute(batch_attri_corner_);
+  glBindBuffer(GL_ARRAY_BUFFER, batch_vertex_buffer_);
+  const GLsizei stride = sizeof(BatchVertex);
+  SetEdgeAttributes(batch_attri_edge_start_, batch_attri_edge_end_, 4,
+                    stride);
+  glEnableVertexAttribArray(batch_attri_center_);
+  glVertexAttribPointer(
+      batch_attri_center_, 3, GL_FLOAT, GL_FALSE, stride,
+      reinterpret_cast<const void*>(offsetof(BatchVertex, center)));
+  glVertexAttribDivisor(batch_attri_center_, 1);
+  glEnableVertexAttribArray(batch_attri_normal_);
+  glVertexAttribPointer(
+      batch_attri_normal_, 3, GL_FLOAT, GL_FALSE, stride,
+      reinterpret_cast<const void*>(offsetof(BatchVertex, normal)));
+  glVertexAttribDivisor(batch_attri_normal_, 1);
+  gl_state.BindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  InitializeGpuCulling(asset_manager);
 
   util::CheckGlError("plane_renderer::InitializeGlContent()");
 }
@@ -64,58 +228,357 @@ void PlaneRenderer::Draw(const glm::mat4& projection_mat,
     return;
   }
 
-  UpdateForPlane(ar_session, ar_plane);
-
-  glUseProgram(shader_program_);
-  glDepthMask(GL_FALSE);
+  const PlaneMesh& mesh = GetPlaneMesh(ar_session, ar_plane);
+  if (mesh.edge_count == 0) {
+    return;
+  }
 
-  glActiveTexture(GL_TEXTURE0);
-  glUniform1i(uniform_texture_, 0);
-  glBindTexture(GL_TEXTURE_2D, texture_id_);
+  PrepareDraw(shader_program_);
 
   // Compose final mvp matrix for this plane renderer.
-  glUniformMatrix4fv(uniform_mvp_mat_, 1, GL_FALSE,
-                     glm::value_ptr(projection_mat * view_mat * model_mat_));
+  glm::mat4 mvp_mat =
+      util::MultiplyMatrices(projection_mat, view_mat, mesh.model_mat);
+  glUniformMatrix4fv(uniform_mvp_mat_, 1, GL_FALSE, glm::value_ptr(mvp_mat));
 
   glUniformMatrix4fv(uniform_model_mat_, 1, GL_FALSE,
-                     glm::value_ptr(model_mat_));
-  glUniform3f(uniform_normal_vec_, normal_vec_.x, normal_vec_.y, normal_vec_.z);
+                     glm::value_ptr(mesh.model_mat));
+  glUniform3f(uniform_normal_vec_, mesh.normal_vec.x, mesh.normal_vec.y,
+              mesh.normal_vec.z);
+
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
+  gl_state.BindVertexArray(mesh.vertex_array);
+  glDrawArraysInstanced(GL_TRIANGLES, 0, kTemplateVertexCount,
+                        mesh.edge_count);
+  gl_state.BindVertexArray(0);
+  util::CheckGlError("plane_renderer::Draw()");
+}
 
-  glEnableVertexAttribArray(attri_vertices_);
-  glVertexAttribPointer(attri_vertices_, 3, GL_FLOAT, GL_FALSE, 0,
-                        vertices_.data());
+void PlaneRenderer::AddToBatch(const ArSession& ar_session,
+                               const ArPlane& ar_plane) {
+  const PlaneMesh& mesh = GetPlaneMesh(ar_session, ar_plane);
+  batch_.vertices.insert(batch_.vertices.end(), mesh.batch_vertices.begin(),
+                         mesh.batch_vertices.end());
+}
 
-  glEnable(GL_BLEND);
+void PlaneRenderer::DrawBatch(const glm::mat4& projection_mat,
+                              const glm::mat4& view_mat) {
+  SubmitBatch(projection_mat, view_mat, batch_.vertices);
+  batch_.Clear();
+}
 
-  // Textures are loaded with premultiplied alpha
-  // (https://developer.android.com/reference/android/graphics/BitmapFactory.Options#inPremultiplied),
-  // so we use the premultiplied alpha blend factors.
-  glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
-  glDrawElements(GL_TRIANGLES, triangles_.size(), GL_UNSIGNED_SHORT,
-                 triangles_.data());
+void PlaneRenderer::DrawBatch(const glm::mat4& projection_mat,
+                              const glm::mat4& view_mat,
+                              const PlaneBatch& batch) {
+  SubmitBatch(projection_mat, view_mat, batch.vertices);
+}
 
-  glDisable(GL_BLEND);
-  glUseProgram(0);
-  glDepthMask(GL_TRUE);
-  util::CheckGlError("plane_renderer::Draw()");
+void PlaneRenderer::AppendPlaneToBatch(const ArSession& ar_session,
+                                       const ArPlane& ar_plane,
+                                       float polygon_tolerance_m,
+                                       PlaneBatch* batch) {
+  std::vector<glm::vec2> outline;
+  glm::mat4 model_mat(1.0f);
+  glm::vec3 normal_vec(0.0f);
+  GetPlaneOutline(ar_session, ar_plane, polygon_tolerance_m, &outline,
+                  &model_mat, &normal_vec);
+  AppendWorldOutline(outline, model_mat, normal_vec, &batch->vertices);
+}
+
+void PlaneRenderer::AppendWorldOutline(const std::vector<glm::vec2>& outline,
+                                       const glm::mat4& model_mat,
+                                       const glm::vec3& normal_vec,
+                                       std::vector<BatchVertex>* vertices) {
+  if (outline.size() < 3) {
+    return;
+  }
+  const glm::vec3 center(model_mat[3]);
+  for (const glm::vec2& vertex : outline) {
+    glm::vec4 world_position =
+        model_mat * glm::vec4(vertex.x, 0.0f, vertex.y, 1.0f);
+    vertices->push_back({world_position, center, normal_vec});
+  }
+  // Closes the outline.  The edge from the repeated vertex leads to the next
+  // plane and is dropped by the shader.
+  BatchVertex closing = (*vertices)[vertices->size() - outline.size()];
+  closing.world_position.w = 0.0f;
+  vertices->push_back(closing);
+}
+
+void PlaneRenderer::PrepareDraw(GLuint program) {
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
+  gl_state.UseProgram(program);
+  gl_state.DepthMask(GL_FALSE);
+  gl_state.SetCapability(GL_BLEND, true);
+  // The fragment shader writes premultiplied alpha.
+  gl_state.BlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+void PlaneRenderer::SubmitBatch(const glm::mat4& projection_mat,
+                                const glm::mat4& view_mat,
+                                const std::vector<BatchVertex>& vertices) {
+  if (!batch_shader_program_) {
+    LOGE("batch_shader_program is null.");
+    return;
+  }
+
+  // Every vertex but the last starts an edge.
+  if (vertices.size() < 2) {
+    return;
+  }
+
+  // Orphans last frame's storage so the upload does not wait on the GPU.
+  glBindBuffer(GL_ARRAY_BUFFER, batch_vertex_buffer_);
+  glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(BatchVertex),
+               vertices.data(), GL_STREAM_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  ResourceAccounting::Get().Track(GpuResourceType::kBuffer,
+                                  batch_vertex_buffer_,
+                                  vertices.size() * sizeof(BatchVertex),
+                                  kOwner);
+
+  // Vertices are already in world space, so only the view projection matrix
+  // is needed.
+  glm::mat4 view_projection_mat =
+      util::MultiplyMatrices(projection_mat, view_mat);
+  // Culling switches programs, so it runs before the draw is set up.
+  const bool cull_on_gpu = use_gpu_culling_ && IsGpuCullingSupported();
+  if (cull_on_gpu) {
+    CullBatchEdges(view_projection_mat, vertices.size() - 1);
+  }
+
+  PrepareDraw(batch_shader_program_);
+  glUniformMatrix4fv(batch_uniform_view_projection_mat_, 1, GL_FALSE,
+                     glm::value_ptr(view_projection_mat));
+
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
+  gl_state.BindVertexArray(cull_on_gpu ? culled_edge_vertex_array_
+                                       : batch_vertex_array_);
+  const GLsizei edge_count = static_cast<GLsizei>(vertices.size() - 1);
+  if (use_depth_prepass_) {
+    // The inside of the inner rings, the first triangle of every edge, is
+    // fully opaque.  Its depth alone is written, so where planes lie at
+    // different depths the nearest one claims the pixel and the color pass
+    // shades it once.  Coplanar planes tie at the same depth, pass the
+    // GL_LEQUAL test below together and still blend over each other.  The
+    // feathered bands write no depth and blend where planes meet.
+    //
+    // GlStateCache does not track the color mask and the depth function,
+    // so they are set directly and restored to the GL defaults here.
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    gl_state.DepthMask(GL_TRUE);
+    DrawBatchEdges(cull_on_gpu, kInteriorVertexCount, edge_count);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    gl_state.DepthMask(GL_FALSE);
+    // The same program and vertices rasterize to the same depth.
+    glDepthFunc(GL_LEQUAL);
+  }
+  DrawBatchEdges(cull_on_gpu, kTemplateVertexCount, edge_count);
+  if (use_depth_prepass_) {
+    glDepthFunc(GL_LESS);
+  }
+  gl_state.BindVertexArray(0);
+  util::CheckGlError("plane_renderer::DrawBatch()");
+}
+
+void PlaneRenderer::DrawBatchEdges(bool cull_on_gpu, GLsizei vertex_count,
+                                   GLsizei edge_count) {
+  if (!cull_on_gpu) {
+    glDrawArraysInstanced(GL_TRIANGLES, 0, vertex_count, edge_count);
+    return;
+  }
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_command_buffer_);
+  // The culling pass only writes the instance count, the vertex count is
+  // set here per draw.
+  const GLuint count = static_cast<GLuint>(vertex_count);
+  glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(count), &count);
+  glDrawArraysIndirect(GL_TRIANGLES, nullptr);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void PlaneRenderer::InitializeGpuCulling(AAssetManager* asset_manager) {
+  // Names of a previous context are gone with it.
+  edge_cull_program_ = 0;
+  culled_edge_capacity_ = 0;
+  if (!util::IsContextVersionAtLeast31()) {
+    return;
+  }
+  edge_cull_program_ =
+      util::CreateComputeProgram(kEdgeCullShaderFileName, asset_manager);
+  if (!edge_cull_program_) {
+    LOGE("Could not create plane edge culling program.");
+    return;
+  }
+  edge_cull_edge_count_uniform_ =
+      glGetUniformLocation(edge_cull_program_, "u_EdgeCount");
+  edge_cull_frustum_planes_uniform_ =
+      glGetUniformLocation(edge_cull_program_, "u_FrustumPlanes");
+
+  glGenBuffers(1, &culled_edge_buffer_);
+  glGenBuffers(1, &indirect_command_buffer_);
+  glGenVertexArrays(1, &culled_edge_vertex_array_);
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
+  gl_state.BindVertexArray(culled_edge_vertex_array_);
+  glBindBuffer(GL_ARRAY_BUFFER, template_buffer_);
+  SetCornerAttribute(batch_attri_corner_);
+  glBindBuffer(GL_ARRAY_BUFFER, culled_edge_buffer_);
+  const GLsizei stride = sizeof(CulledEdge);
+  const struct {
+    GLint attrib;
+    GLint components;
+    size_t offset;
+  } edge_attributes[] = {
+      {batch_attri_edge_start_, 4, offsetof(CulledEdge, edge_start)},
+      {batch_attri_edge_end_, 4, offsetof(CulledEdge, edge_end)},
+      {batch_attri_center_, 3, offsetof(CulledEdge, plane_center)},
+      {batch_attri_normal_, 3, offsetof(CulledEdge, normal)},
+  };
+  for (const auto& attribute : edge_attributes) {
+    glEnableVertexAttribArray(attribute.attrib);
+    glVertexAttribPointer(attribute.attrib, attribute.components, GL_FLOAT,
+                          GL_FALSE, stride,
+                          reinterpret_cast<const void*>(attribute.offset));
+    glVertexAttribDivisor(attribute.attrib, 1);
+  }
+  gl_state.BindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  util::CheckGlError("plane_renderer::InitializeGpuCulling()");
+}
+
+void PlaneRenderer::CullBatchEdges(const glm::mat4& view_projection_mat,
+                                   size_t edge_count) {
+  ResourceAccounting& accounting = ResourceAccounting::Get();
+  // The buffer only grows, so its name stays recorded in the vertex array.
+  if (edge_count > culled_edge_capacity_) {
+    culled_edge_capacity_ = std::max(edge_count, 2 * culled_edge_capacity_);
+    const size_t size = culled_edge_capacity_ * sizeof(CulledEdge);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, culled_edge_buffer_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, size, nullptr, GL_DYNAMIC_COPY);
+    accounting.Track(GpuResourceType::kBuffer, culled_edge_buffer_, size,
+                     kOwner);
+  }
+  const DrawArraysIndirectCommand command = {kTemplateVertexCount, 0, 0, 0};
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, indirect_command_buffer_);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(command), &command,
+               GL_STREAM_DRAW);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  accounting.Track(GpuResourceType::kBuffer, indirect_command_buffer_,
+                   sizeof(command), kOwner);
+
+  util::GlStateCache::Get().UseProgram(edge_cull_program_);
+  const util::Frustum frustum = util::ExtractFrustum(view_projection_mat);
+  glUniform1ui(edge_cull_edge_count_uniform_, static_cast<GLuint>(edge_count));
+  glUniform4fv(edge_cull_frustum_planes_uniform_, 6,
+               glm::value_ptr(frustum.planes[0]));
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, batch_vertex_buffer_);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, culled_edge_buffer_);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, indirect_command_buffer_);
+  glDispatchCompute(
+      (static_cast<GLuint>(edge_count) + kCullWorkGroupSize - 1) /
+          kCullWorkGroupSize,
+      1, 1);
+  // The draw reads the count as its command and the edges as vertex
+  // attributes.
+  glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+  util::CheckGlError("plane_renderer::CullBatchEdges()");
+}
+
+const PlaneRenderer::PlaneMesh& PlaneRenderer::GetPlaneMesh(
+    const ArSession& ar_session, const ArPlane& ar_plane) {
+  auto it = plane_meshes_.find(&ar_plane);
+  if (it == plane_meshes_.end()) {
+    it = plane_meshes_.emplace(&ar_plane, PlaneMesh()).first;
+    BuildPlaneMesh(ar_session, ar_plane, &it->second);
+  }
+  return it->second;
+}
+
+void PlaneRenderer::UpdatePlane(const ArSession& ar_session,
+                                const ArPlane& ar_plane) {
+  BuildPlaneMesh(ar_session, ar_plane, &plane_meshes_[&ar_plane]);
+}
+
+void PlaneRenderer::EvictPlane(const ArPlane& ar_plane) {
+  auto it = plane_meshes_.find(&ar_plane);
+  if (it == plane_meshes_.end()) {
+    return;
+  }
+  glDeleteVertexArrays(1, &it->second.vertex_array);
+  glDeleteBuffers(1, &it->second.vertex_buffer);
+  ResourceAccounting::Get().Untrack(GpuResourceType::kBuffer,
+                                    it->second.vertex_buffer);
+  plane_meshes_.erase(it);
+}
+
+void PlaneRenderer::BuildPlaneMesh(const ArSession& ar_session,
+                                   const ArPlane& ar_plane, PlaneMesh* mesh) {
+  UpdateForPlane(ar_session, ar_plane);
+
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
+  if (mesh->vertex_buffer == 0) {
+    glGenBuffers(1, &mesh->vertex_buffer);
+    glGenVertexArrays(1, &mesh->vertex_array);
+    gl_state.BindVertexArray(mesh->vertex_array);
+    glBindBuffer(GL_ARRAY_BUFFER, template_buffer_);
+    SetCornerAttribute(attri_corner_);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh->vertex_buffer);
+    SetEdgeAttributes(attri_edge_start_, attri_edge_end_, 2,
+                      sizeof(glm::vec2));
+    gl_state.BindVertexArray(0);
+  }
+
+  mesh->edge_count =
+      outline_.size() < 3 ? 0 : static_cast<GLsizei>(outline_.size());
+  if (mesh->edge_count > 0) {
+    // Closed by the first vertex, so the last edge reads it as its end.
+    outline_.push_back(outline_.front());
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, mesh->vertex_buffer);
+  glBufferData(GL_ARRAY_BUFFER, outline_.size() * sizeof(glm::vec2),
+               outline_.data(), GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  ResourceAccounting::Get().Track(GpuResourceType::kBuffer,
+                                  mesh->vertex_buffer,
+                                  outline_.size() * sizeof(glm::vec2), kOwner);
+  if (mesh->edge_count > 0) {
+    outline_.pop_back();
+  }
+
+  mesh->model_mat = model_mat_;
+  mesh->normal_vec = normal_vec_;
+
+  // Keeps a world space copy for batching.
+  mesh->batch_vertices.clear();
+  AppendWorldOutline(outline_, model_mat_, normal_vec_,
+                     &mesh->batch_vertices);
+  util::CheckGlError("plane_renderer::BuildPlaneMesh()");
 }
 
 void PlaneRenderer::UpdateForPlane(const ArSession& ar_session,
                                    const ArPlane& ar_plane) {
-  // The following code generates a triangle mesh filling a convex polygon,
-  // including a feathered edge for blending.
+  GetPlaneOutline(ar_session, ar_plane, polygon_tolerance_m_, &outline_,
+                  &model_mat_, &normal_vec_);
+}
+
+void PlaneRenderer::GetPlaneOutline(const ArSession& ar_session,
+                                    const ArPlane& ar_plane,
+                                    float polygon_tolerance_m,
+                                    std::vector<glm::vec2>* outline,
+                                    glm::mat4* model_mat,
+                                    glm::vec3* normal_vec) {
+  // Only the outer polygon is produced here; the shader derives the inner
+  // feather ring and the triangles from it.
   //
-  // The indices shown in the diagram are used in comments below.
   // _______________     0_______________1
   // |             |      |4___________5|
   // |             |      | |         | |
-  // |             | =>   | |         | |
+  // |             | =>   | |    c    | |
   // |             |      | |         | |
   // |             |      |7-----------6|
   // ---------------     3---------------2
+  //
+  // Edge (0, 1) is drawn as triangles (c, 4, 5), (0, 1, 4) and (4, 1, 5).
 
-  vertices_.clear();
-  triangles_.clear();
+  outline->clear();
 
   int32_t polygon_length;
   ArPlane_getPolygonSize(&ar_session, &ar_plane, &polygon_length);
@@ -125,62 +588,16 @@ void PlaneRenderer::UpdateForPlane(const ArSession& ar_session,
     return;
   }
 
-  const int32_t vertices_size = polygon_length / 2;
-  std::vector<glm::vec2> raw_vertices(vertices_size);
-  ArPlane_getPolygon(&ar_session, &ar_plane,
-                     glm::value_ptr(raw_vertices.front()));
-
-  // Fill vertex 0 to 3. Note that the vertex.xy are used for x and z
-  // position. vertex.z is used for alpha. The outer polygon's alpha
-  // is 0.
-  for (int32_t i = 0; i < vertices_size; ++i) {
-    vertices_.push_back(glm::vec3(raw_vertices[i].x, raw_vertices[i].y, 0.0f));
-  }
+  outline->resize(polygon_length / 2);
+  ArPlane_getPolygon(&ar_session, &ar_plane, glm::value_ptr(outline->front()));
+  // Nearly collinear vertices would each add an edge of three triangles.
+  SimplifyPolygon(polygon_tolerance_m, outline);
 
   util::ScopedArPose scopedArPose(&ar_session);
   ArPlane_getCenterPose(&ar_session, &ar_plane, scopedArPose.GetArPose());
   ArPose_getMatrix(&ar_session, scopedArPose.GetArPose(),
-                   glm::value_ptr(model_mat_));
-  normal_vec_ = util::GetPlaneNormal(ar_session, *scopedArPose.GetArPose());
-
-  // Feather distance 0.2 meters.
-  const float kFeatherLength = 0.2f;
-  // Feather scale over the distance between plane center and vertices.
-  const float kFeatherScale = 0.2f;
-
-  // Fill vertex 4 to 7, with alpha set to 1.
-  for (int32_t i = 0; i < vertices_size; ++i) {
-    // Vector from plane center to current point.
-    glm::vec2 v = raw_vertices[i];
-    const float scale =
-        1.0f - std::min((kFeatherLength / glm::length(v)), kFeatherScale);
-    const glm::vec2 result_v = scale * v;
-
-    vertices_.push_back(glm::vec3(result_v.x, result_v.y, 1.0f));
-  }
-
-  const int32_t vertices_length = vertices_.size();
-  const int32_t half_vertices_length = vertices_length / 2;
-
-  // Generate triangle (4, 5, 6) and (4, 6, 7).
-  for (int i = half_vertices_length + 1; i < vertices_length - 1; ++i) {
-    triangles_.push_back(half_vertices_length);
-    triangles_.push_back(i);
-    triangles_.push_back(i + 1);
-  }
-
-  // Generate triangle (0, 1, 4), (4, 1, 5), (5, 1, 2), (5, 2, 6),
-  // (6, 2, 3), (6, 3, 7), (7, 3, 0), (7, 0, 4)
-  for (int i = 0; i < half_vertices_length; ++i) {
-    triangles_.push_back(i);
-    triangles_.push_back((i + 1) % half_vertices_length);
-    triangles_.push_back(i + half_vertices_length);
-
-    triangles_.push_back(i + half_vertices_length);
-    triangles_.push_back((i + 1) % half_vertices_length);
-    triangles_.push_back((i + half_vertices_length + 1) % half_vertices_length +
-                         half_vertices_length);
-  }
+                   glm::value_ptr(*model_mat));
+  *normal_vec = util::GetPlaneNormal(ar_session, *scopedArPose.GetArPose());
 }
 
 }  // namespace hello_ar
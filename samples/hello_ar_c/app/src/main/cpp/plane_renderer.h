@@ -17,12 +17,15 @@
 #ifndef C_ARCORE_HELLOE_AR_PLANE_RENDERER_H_
 #define C_ARCORE_HELLOE_AR_PLANE_RENDERER_H_
 
-#include <GLES2/gl2.h>
+// clang-format off
+#include <GLES3/gl3.h>
 #include <GLES2/gl2ext.h>
+// clang-format on
 #include <android/asset_manager.h>
 #include <array>
 #include <cstdint>
 #include <cstdlib>
+#include <unordered_map>
 #include <vector>
 
 #include "arcore_c_api.h"
@@ -31,8 +34,36 @@
 namespace hello_ar {
 
 // PlaneRenderer renders ARCore plane type.
+//
+// Only the outline of a plane is stored and uploaded.  Every edge of the
+// outline is drawn as one instance of a fixed template of three triangles:
+// one from the plane center to the inner feather ring and two for the
+// feathered band between the rings.  The vertex shader places the inner ring
+// from the outline and the plane center, so the CPU no longer builds it.
 class PlaneRenderer {
  public:
+  // Outline vertex of the batched plane meshes.  Every vertex starts an edge
+  // that ends at the next one; the outline of each plane repeats its first
+  // vertex at the end, with world_position.w = 0 so that the edge from it to
+  // the next plane is dropped.  The plane center and normal are stored per
+  // vertex so planes with different orientations can share one draw call.
+  struct BatchVertex {
+    glm::vec4 world_position;
+    glm::vec3 center;
+    glm::vec3 normal;
+  };
+
+  // World space outlines of any number of planes, drawn with one call.
+  struct PlaneBatch {
+    std::vector<BatchVertex> vertices;
+
+    void Clear() { vertices.clear(); }
+  };
+
+  // Polygon vertices closer than this to the simplified outline are
+  // dropped, well below what is visible through the feathered edge.
+  static constexpr float kDefaultPolygonToleranceM = 0.01f;
+
   PlaneRenderer() = default;
   ~PlaneRenderer() = default;
 
@@ -40,26 +71,206 @@ class PlaneRenderer {
   // OpenGL thread.
   void InitializeGlContent(AAssetManager* asset_manager);
 
-  // Draws the provided plane.
+  // Draws the provided plane from its cached mesh.  The mesh is built on the
+  // first draw of a plane and afterwards only rebuilt by UpdatePlane().
   void Draw(const glm::mat4& projection_mat, const glm::mat4& view_mat,
             const ArSession& ar_session, const ArPlane& ar_plane);
 
+  // Appends the cached mesh of the provided plane, transformed to world space,
+  // to the batch that is submitted by DrawBatch().
+  void AddToBatch(const ArSession& ar_session, const ArPlane& ar_plane);
+
+  // Draws every plane added with AddToBatch() since the previous call with a
+  // single draw call, then clears the batch.  The output matches calling
+  // Draw() for each plane.
+  void DrawBatch(const glm::mat4& projection_mat, const glm::mat4& view_mat);
+
+  // Draws a batch built off the OpenGL thread with AppendPlaneToBatch().
+  void DrawBatch(const glm::mat4& projection_mat, const glm::mat4& view_mat,
+                 const PlaneBatch& batch);
+
+  // Triangulates |ar_plane| in world space and appends it to |batch|.  Makes
+  // no OpenGL calls, so it can run on any thread that may use the session.
+  //
+  // @param polygon_tolerance_m, see SetPolygonTolerance().
+  static void AppendPlaneToBatch(const ArSession& ar_session,
+                                 const ArPlane& ar_plane,
+                                 float polygon_tolerance_m, PlaneBatch* batch);
+
+  // Sets how far, in meters, the simplified plane polygon may deviate from
+  // the one reported by ARCore.  Zero keeps every vertex.  Applies to meshes
+  // built afterwards.
+  void SetPolygonTolerance(float tolerance_m) {
+    polygon_tolerance_m_ = tolerance_m;
+  }
+
+  // Re-triangulates the cached mesh of a plane.  Should be called for planes
+  // reported by ArFrame_getUpdatedTrackables(), since the polygon and center
+  // pose of other planes have not changed.
+  void UpdatePlane(const ArSession& ar_session, const ArPlane& ar_plane);
+
+  // Releases the cached mesh of a plane, e.g. once it has been subsumed or has
+  // stopped tracking.
+  void EvictPlane(const ArPlane& ar_plane);
+
+  // World space center of |ar_plane| from its cached mesh, which is built on
+  // a cache miss like for Draw().
+  glm::vec3 GetPlaneCenter(const ArSession& ar_session,
+                           const ArPlane& ar_plane) {
+    return glm::vec3(GetPlaneMesh(ar_session, ar_plane).model_mat[3]);
+  }
+
+  // The program of Draw(), or of DrawBatch() if |batched|.
+  GLuint GetProgram(bool batched) const {
+    return batched ? batch_shader_program_ : shader_program_;
+  }
+
+  // Returns the number of planes with a cached mesh.
+  size_t GetCachedPlaneCount() const { return plane_meshes_.size(); }
+
+  // Whether SetUseGpuCulling() can take effect, which needs an OpenGL ES 3.1
+  // context for its compute pass and indirect draw.
+  bool IsGpuCullingSupported() const { return edge_cull_program_ != 0; }
+
+  // Culls the edges of a batch against the view frustum in a compute shader
+  // and draws the rest with glDrawArraysIndirect, so edges outside the view
+  // cost no vertex work.  Only takes effect if IsGpuCullingSupported().
+  void SetUseGpuCulling(bool use_gpu_culling) {
+    use_gpu_culling_ = use_gpu_culling;
+  }
+
+  // Shades every pixel at most once across the planes of a batch where they
+  // overlap at different depths, instead of shading and blending each of
+  // them.  DrawBatch() first writes the depth of the opaque inside of every
+  // plane, then shades with the depth test passing only the nearest plane
+  // there.  Coplanar planes tie and are all still blended.  Leaves that
+  // depth in the depth buffer, so content drawn after the planes is hidden
+  // behind them.  Does not apply to Draw().
+  void SetUseDepthPrepass(bool use_depth_prepass) {
+    use_depth_prepass_ = use_depth_prepass;
+  }
+
  private:
+  // GPU-resident outline of a plane polygon in plane space, closed by
+  // repeating its first vertex, plus a world space copy used to build the
+  // batch.
+  struct PlaneMesh {
+    GLuint vertex_array = 0;
+    GLuint vertex_buffer = 0;
+    GLsizei edge_count = 0;
+    glm::mat4 model_mat = glm::mat4(1.0f);
+    glm::vec3 normal_vec = glm::vec3(0.0f);
+    std::vector<BatchVertex> batch_vertices;
+  };
+
+  // Returns the cached mesh of |ar_plane|, building it on a cache miss.
+  const PlaneMesh& GetPlaneMesh(const ArSession& ar_session,
+                                const ArPlane& ar_plane);
+
   void UpdateForPlane(const ArSession& ar_session, const ArPlane& ar_plane);
 
-  std::vector<glm::vec3> vertices_;
-  std::vector<GLushort> triangles_;
+  // Returns the polygon of |ar_plane| in plane space, simplified to
+  // |polygon_tolerance_m|.  vertex.xy holds the plane x and z coordinates.
+  static void GetPlaneOutline(const ArSession& ar_session,
+                              const ArPlane& ar_plane,
+                              float polygon_tolerance_m,
+                              std::vector<glm::vec2>* outline,
+                              glm::mat4* model_mat, glm::vec3* normal_vec);
+
+  // Appends |outline| in world space, closed, to |vertices|.
+  static void AppendWorldOutline(const std::vector<glm::vec2>& outline,
+                                 const glm::mat4& model_mat,
+                                 const glm::vec3& normal_vec,
+                                 std::vector<BatchVertex>* vertices);
+
+  // Uploads and draws world space plane outlines with the batch program.
+  void SubmitBatch(const glm::mat4& projection_mat, const glm::mat4& view_mat,
+                   const std::vector<BatchVertex>& vertices);
+
+  // Mirrors the edge records the culling pass writes, read by the batch
+  // program like consecutive BatchVertex entries.
+  struct CulledEdge {
+    glm::vec4 edge_start;
+    glm::vec4 edge_end;
+    glm::vec4 plane_center;
+    glm::vec4 normal;
+  };
+
+  // Mirrors the command read by glDrawArraysIndirect.
+  struct DrawArraysIndirectCommand {
+    GLuint count;
+    GLuint instance_count;
+    GLuint first;
+    GLuint reserved;
+  };
+
+  // Builds the culling program and its buffers, if the context supports
+  // compute shaders.
+  void InitializeGpuCulling(AAssetManager* asset_manager);
+
+  // Culls the |edge_count| edges uploaded to batch_vertex_buffer_ into
+  // culled_edge_buffer_ and indirect_command_buffer_.
+  void CullBatchEdges(const glm::mat4& view_projection_mat, size_t edge_count);
+
+  // Sets up blending for drawing planes with |program|.
+  void PrepareDraw(GLuint program);
+
+  // Draws the first |vertex_count| template vertices for the edges of the
+  // bound batch vertex array: |edge_count| of them, or those the culling
+  // pass kept if |cull_on_gpu|.
+  void DrawBatchEdges(bool cull_on_gpu, GLsizei vertex_count,
+                      GLsizei edge_count);
+
+  // Gets the outline of |ar_plane| and uploads it into |mesh|.
+  void BuildPlaneMesh(const ArSession& ar_session, const ArPlane& ar_plane,
+                      PlaneMesh* mesh);
+
+  // Cached meshes keyed by plane handle.  ARCore returns the same handle for
+  // a plane for as long as the session tracks it.
+  std::unordered_map<const ArPlane*, PlaneMesh> plane_meshes_;
+
+  // Scratch storage for the outlines, reused across planes.
+  std::vector<glm::vec2> outline_;
   glm::mat4 model_mat_ = glm::mat4(1.0f);
   glm::vec3 normal_vec_ = glm::vec3(0.0f);
+  float polygon_tolerance_m_ = kDefaultPolygonToleranceM;
 
-  GLuint texture_id_;
+  // Corners of the triangles drawn per edge, shared by both programs.
+  GLuint template_buffer_ = 0;
 
   GLuint shader_program_;
-  GLint attri_vertices_;
+  GLint attri_corner_;
+  GLint attri_edge_start_;
+  GLint attri_edge_end_;
   GLint uniform_mvp_mat_;
-  GLint uniform_texture_;
   GLint uniform_model_mat_;
   GLint uniform_normal_vec_;
+
+  // Batched rendering state.  The batch is rebuilt every frame into one
+  // streaming vertex buffer, read through a vertex array of its own.
+  PlaneBatch batch_;
+  GLuint batch_vertex_array_ = 0;
+  GLuint batch_vertex_buffer_ = 0;
+
+  GLuint batch_shader_program_;
+  GLint batch_attri_corner_;
+  GLint batch_attri_edge_start_;
+  GLint batch_attri_edge_end_;
+  GLint batch_attri_center_;
+  GLint batch_attri_normal_;
+  GLint batch_uniform_view_projection_mat_;
+  bool use_depth_prepass_ = false;
+
+  // GPU culling of the batch.  The culled edges are read through a vertex
+  // array of their own.
+  bool use_gpu_culling_ = false;
+  GLuint edge_cull_program_ = 0;
+  GLint edge_cull_edge_count_uniform_;
+  GLint edge_cull_frustum_planes_uniform_;
+  GLuint culled_edge_buffer_ = 0;
+  GLuint culled_edge_vertex_array_ = 0;
+  GLuint indirect_command_buffer_ = 0;
+  size_t culled_edge_capacity_ = 0;
 };
 }  // namespace hello_ar
 
@@ -0,0 +1,151 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "playback_benchmark.h"
+
+#include <unistd.h>
+
+#include <cstring>
+#include <numeric>
+
+#include "util.h"
+
+namespace hello_ar {
+namespace {
+float ToMilliseconds(std::chrono::nanoseconds duration) {
+  return std::chrono::duration<float, std::milli>(duration).count();
+}
+
+// Current resident set size of the process, or -1 if it cannot be read.
+int64_t ReadResidentSetKb() {
+  FILE* file = fopen("/proc/self/statm", "r");
+  if (file == nullptr) {
+    return -1;
+  }
+  long long size_pages = 0;
+  long long resident_pages = 0;
+  const bool read =
+      fscanf(file, "%lld %lld", &size_pages, &resident_pages) == 2;
+  fclose(file);
+  return read ? resident_pages * (sysconf(_SC_PAGESIZE) / 1024) : -1;
+}
+
+// Largest resident set size the process ever had, or -1 if it cannot be read.
+int64_t ReadPeakResidentSetKb() {
+  FILE* file = fopen("/proc/self/status", "r");
+  if (file == nullptr) {
+    return -1;
+  }
+  int64_t peak_kb = -1;
+  char line[128];
+  while (fgets(line, sizeof(line), file) != nullptr) {
+    long long value_kb = 0;
+    if (sscanf(line, "VmHWM: %lld kB", &value_kb) == 1) {
+      peak_kb = value_kb;
+      break;
+    }
+  }
+  fclose(file);
+  return peak_kb;
+}
+}  // namespace
+
+PlaybackBenchmark::~PlaybackBenchmark() { Finish(); }
+
+bool PlaybackBenchmark::Open(const std::string& csv_path) {
+  Finish();
+  file_ = fopen(csv_path.c_str(), "w");
+  if (file_ == nullptr) {
+    LOGE("PlaybackBenchmark: cannot open %s", csv_path.c_str());
+    return false;
+  }
+  frame_count_ = 0;
+  stage_totals_.fill(std::chrono::nanoseconds::zero());
+  gpu_stage_totals_ms_.fill(0.f);
+  frame_times_ms_.clear();
+
+  fprintf(file_, "frame,timestamp_ns");
+  for (int i = 0; i < kNumFrameStages; ++i) {
+    fprintf(file_, ",%s_ms", GetFrameStageName(static_cast<FrameStage>(i)));
+  }
+  for (int i = 0; i < kNumFrameStages; ++i) {
+    fprintf(file_, ",gpu_%s_ms", GetFrameStageName(static_cast<FrameStage>(i)));
+  }
+  fprintf(file_, ",total_ms,rss_kb\n");
+  return true;
+}
+
+void PlaybackBenchmark::RecordFrame(
+    int64_t timestamp_ns,
+    const std::array<std::chrono::nanoseconds, kNumFrameStages>& stages,
+    const std::array<float, kNumFrameStages>& gpu_stages_ms,
+    std::chrono::nanoseconds total) {
+  if (file_ == nullptr) {
+    return;
+  }
+  fprintf(file_, "%lld,%lld", static_cast<long long>(frame_count_),
+          static_cast<long long>(timestamp_ns));
+  for (int i = 0; i < kNumFrameStages; ++i) {
+    fprintf(file_, ",%.3f", ToMilliseconds(stages[i]));
+    stage_totals_[i] += stages[i];
+  }
+  for (int i = 0; i < kNumFrameStages; ++i) {
+    if (gpu_stages_ms[i] < 0.f) {
+      fprintf(file_, ",");
+      continue;
+    }
+    fprintf(file_, ",%.3f", gpu_stages_ms[i]);
+    gpu_stage_totals_ms_[i] += gpu_stages_ms[i];
+  }
+  const float total_ms = ToMilliseconds(total);
+  fprintf(file_, ",%.3f,%lld\n", total_ms,
+          static_cast<long long>(ReadResidentSetKb()));
+  frame_times_ms_.push_back(total_ms);
+  ++frame_count_;
+}
+
+void PlaybackBenchmark::Finish() {
+  if (file_ == nullptr) {
+    return;
+  }
+  fprintf(file_, "total,");
+  for (int i = 0; i < kNumFrameStages; ++i) {
+    fprintf(file_, ",%.3f", ToMilliseconds(stage_totals_[i]));
+  }
+  for (int i = 0; i < kNumFrameStages; ++i) {
+    fprintf(file_, ",%.3f", gpu_stage_totals_ms_[i]);
+  }
+  const float total_ms =
+      std::accumulate(frame_times_ms_.begin(), frame_times_ms_.end(), 0.f);
+  const int64_t peak_kb = ReadPeakResidentSetKb();
+  fprintf(file_, ",%.3f,%lld\n", total_ms, static_cast<long long>(peak_kb));
+  fclose(file_);
+  file_ = nullptr;
+
+  if (!frame_times_ms_.empty()) {
+    const float average_ms = total_ms / frame_times_ms_.size();
+    const float p50_ms = util::Percentile(&frame_times_ms_, 50);
+    const float p90_ms = util::Percentile(&frame_times_ms_, 90);
+    const float p99_ms = util::Percentile(&frame_times_ms_, 99);
+    LOGI(
+        "PlaybackBenchmark: %lld frames, avg %.3f ms, p50 %.3f ms, p90 %.3f "
+        "ms, p99 %.3f ms, peak RSS %lld KiB",
+        static_cast<long long>(frame_count_), average_ms, p50_ms, p90_ms,
+        p99_ms, static_cast<long long>(peak_kb));
+  }
+}
+
+}  // namespace hello_ar
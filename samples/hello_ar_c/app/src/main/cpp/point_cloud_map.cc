@@ -0,0 +1,334 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "point_cloud_map.h"
+
+#include <algorithm>
+
+namespace hello_ar {
+namespace {
+// Caps the observations averaged into a position, so that refinements of a
+// point by ARCore still move it.
+constexpr float kMaxWeight = 4.0f;
+// Confidence of removed slots, which the vertex shader skips.
+constexpr float kRemovedConfidence = -1.0f;
+}  // namespace
+
+constexpr int PointCloudMap::kPointComponents;
+constexpr int PointCloudMap::kPageSize;
+
+size_t PointCloudMap::CellKeyHash::operator()(const CellKey& key) const {
+  // The usual spatial hash primes.
+  return (static_cast<uint32_t>(key.x) * 73856093u) ^
+         (static_cast<uint32_t>(key.y) * 19349663u) ^
+         (static_cast<uint32_t>(key.z) * 83492791u);
+}
+
+PointCloudMap::PointCloudMap() : PointCloudMap(Options()) {}
+
+PointCloudMap::PointCloudMap(const Options& options)
+    : options_(options),
+      slot_data_(options.max_points * kPointComponents),
+      slots_(options.max_points),
+      dirty_pages_((options.max_points + kPageSize - 1) / kPageSize) {}
+
+void PointCloudMap::Update(const ArSession* ar_session,
+                           const ArPointCloud* ar_point_cloud) {
+  int64_t timestamp_ns = 0;
+  ArPointCloud_getTimestamp(ar_session, ar_point_cloud, &timestamp_ns);
+  if (timestamp_ns == last_timestamp_ns_) {
+    return;
+  }
+  int32_t number_of_points = 0;
+  ArPointCloud_getNumberOfPoints(ar_session, ar_point_cloud,
+                                 &number_of_points);
+  const float* points = nullptr;
+  const int32_t* point_ids = nullptr;
+  if (number_of_points > 0) {
+    ArPointCloud_getData(ar_session, ar_point_cloud, &points);
+    ArPointCloud_getPointIds(ar_session, ar_point_cloud, &point_ids);
+  }
+  if (points == nullptr || point_ids == nullptr) {
+    number_of_points = 0;
+  }
+  Update(timestamp_ns, points, point_ids, number_of_points);
+}
+
+void PointCloudMap::Update(int64_t timestamp_ns, const float* points,
+                           const int32_t* point_ids,
+                           int32_t number_of_points) {
+  if (timestamp_ns == last_timestamp_ns_) {
+    return;
+  }
+  last_timestamp_ns_ = timestamp_ns;
+  ++update_count_;
+
+  for (int32_t i = 0; i < number_of_points; ++i) {
+    const float* point = points + i * kPointComponents;
+    AddPoint(point_ids[i], glm::make_vec3(point), point[3]);
+  }
+  if (update_count_ % options_.decay_interval == 0) {
+    DecayUnseenPoints();
+  }
+}
+
+void PointCloudMap::Clear() {
+  last_timestamp_ns_ = -1;
+  update_count_ = 0;
+  slot_count_ = 0;
+  free_slots_.clear();
+  std::fill(dirty_pages_.begin(), dirty_pages_.end(), false);
+  id_to_slot_.clear();
+  cells_.clear();
+}
+
+void PointCloudMap::AddRestoredPoints(const float* points,
+                                      int32_t number_of_points,
+                                      const glm::mat4& transform) {
+  for (int32_t i = 0; i < number_of_points; ++i) {
+    const float* point = points + i * kPointComponents;
+    const glm::vec3 position(transform *
+                             glm::vec4(glm::make_vec3(point), 1.0f));
+    if (FindNearbySlot(position) >= 0) {
+      continue;
+    }
+    const int32_t slot = AllocateSlot(GetCellKey(position));
+    if (slot < 0) {
+      return;
+    }
+    Slot& info = slots_[slot];
+    info.weight = 1.0f;
+    info.last_seen = update_count_;
+    WriteSlot(slot, position, point[3]);
+  }
+}
+
+void PointCloudMap::TakeDirtyRanges(std::vector<SlotRange>* ranges) {
+  ranges->clear();
+  const int num_pages = (slot_count_ + kPageSize - 1) / kPageSize;
+  for (int page = 0; page < num_pages; ++page) {
+    if (!dirty_pages_[page]) {
+      continue;
+    }
+    dirty_pages_[page] = false;
+    const int32_t first = page * kPageSize;
+    const int32_t count = std::min(kPageSize, slot_count_ - first);
+    if (!ranges->empty() &&
+        ranges->back().first + ranges->back().count == first) {
+      ranges->back().count += count;
+    } else {
+      ranges->push_back({first, count});
+    }
+  }
+}
+
+void PointCloudMap::MarkAllDirty() {
+  std::fill(dirty_pages_.begin(), dirty_pages_.end(), true);
+}
+
+void PointCloudMap::AddPoint(int32_t id, const glm::vec3& position,
+                             float confidence) {
+  int32_t slot = FindSlot(id);
+  if (slot < 0) {
+    slot = FindNearbySlot(position);
+    if (slot < 0) {
+      slot = AllocateSlot(GetCellKey(position));
+      if (slot < 0) {
+        return;
+      }
+      slots_[slot].weight = 0.0f;
+    }
+    id_to_slot_[id] = {slot, slots_[slot].generation};
+  }
+
+  // Running average of the observations, weighted towards recent ones once
+  // the weight is capped.
+  Slot& info = slots_[slot];
+  const float weight = info.weight;
+  const glm::vec3 averaged =
+      weight > 0.0f ? (GetPosition(slot) * weight + position) / (weight + 1.0f)
+                    : position;
+  info.weight = std::min(weight + 1.0f, kMaxWeight);
+  info.last_seen = update_count_;
+  MoveToCell(slot, GetCellKey(averaged));
+  WriteSlot(slot, averaged,
+            weight > 0.0f ? std::max(confidence, GetConfidence(slot))
+                          : confidence);
+}
+
+int32_t PointCloudMap::FindSlot(int32_t id) const {
+  auto it = id_to_slot_.find(id);
+  if (it == id_to_slot_.end() ||
+      it->second.generation != slots_[it->second.slot].generation) {
+    return -1;
+  }
+  return it->second.slot;
+}
+
+int32_t PointCloudMap::FindNearbySlot(const glm::vec3& position) const {
+  const CellKey key = GetCellKey(position);
+  const float max_distance_squared =
+      options_.merge_distance_m * options_.merge_distance_m;
+  int32_t nearest = -1;
+  float nearest_distance_squared = max_distance_squared;
+  for (int dz = -1; dz <= 1; ++dz) {
+    for (int dy = -1; dy <= 1; ++dy) {
+      for (int dx = -1; dx <= 1; ++dx) {
+        auto it = cells_.find(key + CellKey(dx, dy, dz));
+        if (it == cells_.end()) {
+          continue;
+        }
+        for (const int32_t slot : it->second.slots) {
+          const glm::vec3 offset = GetPosition(slot) - position;
+          const float distance_squared = glm::dot(offset, offset);
+          if (distance_squared <= nearest_distance_squared) {
+            nearest = slot;
+            nearest_distance_squared = distance_squared;
+          }
+        }
+      }
+    }
+  }
+  return nearest;
+}
+
+int32_t PointCloudMap::AllocateSlot(const CellKey& cell) {
+  auto it = cells_.find(cell);
+  if (it != cells_.end() && static_cast<int>(it->second.slots.size()) >=
+                                options_.max_points_per_cell) {
+    const std::vector<int32_t>& members = it->second.slots;
+    const int32_t least_recent = *std::min_element(
+        members.begin(), members.end(), [this](int32_t a, int32_t b) {
+          return slots_[a].last_seen < slots_[b].last_seen;
+        });
+    RemoveSlot(least_recent);
+  }
+
+  int32_t slot = -1;
+  if (!free_slots_.empty()) {
+    slot = free_slots_.back();
+    free_slots_.pop_back();
+  } else if (slot_count_ < options_.max_points) {
+    slot = slot_count_++;
+  } else {
+    return -1;
+  }
+  slots_[slot].cell = cell;
+  Cell& members = cells_[cell];
+  members.slots.push_back(slot);
+  members.ordered = false;
+  return slot;
+}
+
+void PointCloudMap::WriteSlot(int32_t slot, const glm::vec3& position,
+                              float confidence) {
+  float* data = &slot_data_[slot * kPointComponents];
+  data[0] = position.x;
+  data[1] = position.y;
+  data[2] = position.z;
+  data[3] = confidence;
+  dirty_pages_[slot / kPageSize] = true;
+  auto it = cells_.find(slots_[slot].cell);
+  if (it != cells_.end()) {
+    it->second.ordered = false;
+  }
+}
+
+void PointCloudMap::RemoveSlot(int32_t slot) {
+  RemoveFromCell(slot);
+  Slot& info = slots_[slot];
+  ++info.generation;
+  WriteSlot(slot, GetPosition(slot), kRemovedConfidence);
+  free_slots_.push_back(slot);
+}
+
+void PointCloudMap::MoveToCell(int32_t slot, const CellKey& cell) {
+  Slot& info = slots_[slot];
+  if (info.cell == cell) {
+    return;
+  }
+  RemoveFromCell(slot);
+  // The new cell may briefly hold more than max_points_per_cell; its next
+  // allocation evicts again.
+  info.cell = cell;
+  Cell& members = cells_[cell];
+  members.slots.push_back(slot);
+  members.ordered = false;
+}
+
+void PointCloudMap::RemoveFromCell(int32_t slot) {
+  auto it = cells_.find(slots_[slot].cell);
+  if (it == cells_.end()) {
+    return;
+  }
+  std::vector<int32_t>& members = it->second.slots;
+  members.erase(std::find(members.begin(), members.end(), slot));
+  if (members.empty()) {
+    cells_.erase(it);
+  }
+}
+
+void PointCloudMap::SortCell(Cell* cell) const {
+  std::sort(cell->slots.begin(), cell->slots.end(),
+            [this](int32_t a, int32_t b) {
+              return GetConfidence(a) > GetConfidence(b);
+            });
+  cell->ordered = true;
+}
+
+void PointCloudMap::DecayUnseenPoints() {
+  const uint32_t interval = static_cast<uint32_t>(options_.decay_interval);
+  for (int32_t slot = 0; slot < slot_count_; ++slot) {
+    const float confidence = GetConfidence(slot);
+    if (confidence < 0.0f ||
+        update_count_ - slots_[slot].last_seen < interval) {
+      continue;
+    }
+    const float decayed = confidence * options_.confidence_decay;
+    if (decayed < options_.min_confidence) {
+      RemoveSlot(slot);
+    } else {
+      WriteSlot(slot, GetPosition(slot), decayed);
+    }
+  }
+  // Drops the ids of removed points.
+  for (auto it = id_to_slot_.begin(); it != id_to_slot_.end();) {
+    if (it->second.generation != slots_[it->second.slot].generation) {
+      it = id_to_slot_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+PointCloudMap::CellKey PointCloudMap::GetCellKey(
+    const glm::vec3& position) const {
+  return CellKey(glm::floor(position / options_.cell_size_m));
+}
+
+glm::vec3 PointCloudMap::GetCellCenter(const CellKey& key) const {
+  return (glm::vec3(key) + 0.5f) * options_.cell_size_m;
+}
+
+glm::vec3 PointCloudMap::GetPosition(int32_t slot) const {
+  return glm::make_vec3(&slot_data_[slot * kPointComponents]);
+}
+
+float PointCloudMap::GetConfidence(int32_t slot) const {
+  return slot_data_[slot * kPointComponents + 3];
+}
+
+}  // namespace hello_ar
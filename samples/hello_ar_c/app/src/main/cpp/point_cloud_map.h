@@ -0,0 +1,191 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_POINT_CLOUD_MAP_H_
+#define C_ARCORE_HELLOE_AR_POINT_CLOUD_MAP_H_
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "arcore_c_api.h"
+#include "glm.h"
+
+namespace hello_ar {
+
+// Feature points accumulated over all frames, in the x, y, z, confidence
+// layout of ArPointCloud.
+//
+// Every point owns a slot of a fixed array that is uploaded as is to a
+// vertex buffer.  Points that ARCore reports again under the same id are
+// updated in place; new ids within merge_distance_m of a known point are
+// merged into it through a hash grid of cell_size_m cells.  Points not seen
+// for decay_interval updates lose confidence and are removed below
+// min_confidence.  A full cell evicts its least recently seen point, which
+// bounds the density of the map, and max_points bounds its memory.
+//
+// Slots are grouped in pages that remember whether they changed, so the
+// renderer only re-uploads the pages that did.  Removed slots keep a
+// negative confidence until they are reused, and belong to no cell.
+//
+// Not thread safe.
+class PointCloudMap {
+ public:
+  static constexpr int kPointComponents = 4;
+
+  struct Options {
+    float cell_size_m = 0.05f;
+    float merge_distance_m = 0.02f;
+    int max_points_per_cell = 8;
+    int max_points = 1 << 16;
+    int decay_interval = 30;
+    // Factor applied to the confidence of unseen points every interval.
+    float confidence_decay = 0.8f;
+    float min_confidence = 0.1f;
+  };
+
+  // Consecutive slots [first, first + count).
+  struct SlotRange {
+    int32_t first = 0;
+    int32_t count = 0;
+  };
+
+  PointCloudMap();
+  explicit PointCloudMap(const Options& options);
+
+  // Adds the points of |ar_point_cloud| unless its timestamp was added
+  // already.
+  void Update(const ArSession* ar_session, const ArPointCloud* ar_point_cloud);
+
+  // Same as above for points already copied out of an ArPointCloud.
+  //
+  // @param points, |number_of_points| x, y, z, confidence tuples.
+  // @param point_ids, the ids of the points, as ArPointCloud_getPointIds.
+  void Update(int64_t timestamp_ns, const float* points,
+              const int32_t* point_ids, int32_t number_of_points);
+
+  void Clear();
+
+  // Adds |number_of_points| x, y, z, confidence tuples saved from another
+  // session, moved into this one by |transform|.  They have no ids, so a
+  // point near one the map already has is dropped, and the others decay
+  // like any point until ARCore observes them again.
+  void AddRestoredPoints(const float* points, int32_t number_of_points,
+                         const glm::mat4& transform);
+
+  // Slot data for the vertex buffer; slots [0, GetSlotCount()) are in use
+  // or removed.
+  const float* GetSlotData() const { return slot_data_.data(); }
+  int32_t GetSlotCount() const { return slot_count_; }
+  int32_t GetMaxSlotCount() const { return options_.max_points; }
+  int32_t GetPointCount() const {
+    return slot_count_ - static_cast<int32_t>(free_slots_.size());
+  }
+
+  // Moves the ranges of slots changed since the previous call to |ranges|.
+  void TakeDirtyRanges(std::vector<SlotRange>* ranges);
+
+  // Makes the next TakeDirtyRanges() return every slot, e.g. for a new
+  // vertex buffer.
+  void MarkAllDirty();
+
+  // Calls |visit| with the center of every grid cell and the slots of its
+  // points, by decreasing confidence, so that any prefix holds the most
+  // reliable points of the cell.  Only cells that changed are re-sorted.
+  template <typename CellVisitor>
+  void ForEachCell(CellVisitor visit);
+
+ private:
+  static constexpr int kPageSize = 256;
+
+  using CellKey = glm::ivec3;
+  struct CellKeyHash {
+    size_t operator()(const CellKey& key) const;
+  };
+
+  struct Cell {
+    std::vector<int32_t> slots;
+    bool ordered = true;
+  };
+
+  struct Slot {
+    CellKey cell = CellKey(0);
+    uint32_t last_seen = 0;
+    // Observations averaged into the position, capped.
+    float weight = 0.0f;
+    // Bumped on removal, invalidates the ids still mapped to the slot.
+    uint32_t generation = 0;
+  };
+
+  struct IdEntry {
+    int32_t slot = 0;
+    uint32_t generation = 0;
+  };
+
+  void AddPoint(int32_t id, const glm::vec3& position, float confidence);
+
+  // The slot mapped to |id|, or -1.
+  int32_t FindSlot(int32_t id) const;
+
+  // A slot within merge_distance_m of |position|, or -1.
+  int32_t FindNearbySlot(const glm::vec3& position) const;
+
+  // A slot for a new point in |cell|, evicting if needed, or -1 if the map
+  // is full.
+  int32_t AllocateSlot(const CellKey& cell);
+
+  void WriteSlot(int32_t slot, const glm::vec3& position, float confidence);
+  void RemoveSlot(int32_t slot);
+  void MoveToCell(int32_t slot, const CellKey& cell);
+  void RemoveFromCell(int32_t slot);
+  void SortCell(Cell* cell) const;
+
+  // Lowers the confidence of the points not seen in the last interval.
+  void DecayUnseenPoints();
+
+  CellKey GetCellKey(const glm::vec3& position) const;
+  glm::vec3 GetCellCenter(const CellKey& key) const;
+  glm::vec3 GetPosition(int32_t slot) const;
+  float GetConfidence(int32_t slot) const;
+
+  Options options_;
+  int64_t last_timestamp_ns_ = -1;
+  uint32_t update_count_ = 0;
+
+  std::vector<float> slot_data_;
+  std::vector<Slot> slots_;
+  int32_t slot_count_ = 0;
+  std::vector<int32_t> free_slots_;
+  std::vector<bool> dirty_pages_;
+
+  std::unordered_map<int32_t, IdEntry> id_to_slot_;
+  std::unordered_map<CellKey, Cell, CellKeyHash> cells_;
+};
+
+template <typename CellVisitor>
+void PointCloudMap::ForEachCell(CellVisitor visit) {
+  for (auto& entry : cells_) {
+    Cell& cell = entry.second;
+    if (!cell.ordered) {
+      SortCell(&cell);
+    }
+    visit(GetCellCenter(entry.first), cell.slots);
+  }
+}
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_POINT_CLOUD_MAP_H_
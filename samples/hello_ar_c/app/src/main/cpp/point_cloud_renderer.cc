@@ -15,17 +15,41 @@
  */
 
 #include "point_cloud_renderer.h"
+
+#include <cmath>
+#include <cstring>
+
+#include "resource_accounting.h"
 #include "util.h"
 
 namespace hello_ar {
 namespace {
-constexpr char kVertexShaderFilename[] = "shaders/point_cloud.vert";
-constexpr char kFragmentShaderFilename[] = "shaders/point_cloud.frag";
+constexpr char kOwner[] = "PointCloudRenderer";
+
+// Depth beyond this is too noisy to be worth drawing.
+constexpr float kDenseMaxDepthMm = 5000.0f;
+
+// Each point is (x, y, z, confidence).
+constexpr int kPointComponents = 4;
+
+constexpr float kPointSize = 5.0f;
+
+// Map points closer than this keep the full size and density.
+constexpr float kMapReferenceDepthM = 1.0f;
+// Smallest scale of the map point size, and of the linear density, with
+// depth.
+constexpr float kMapMinSizeScale = 0.3f;
+// Pixels the map points may cover per frame, about half a 1080p screen.
+constexpr float kMapFillBudgetPixels = 1024.0f * 1024.0f;
+
+// Upper bound on how long to wait for the GPU to release a ring buffer, one
+// frame at 30 fps.  With three buffers this should never be reached.
+constexpr GLuint64 kFenceTimeoutNs = 33 * 1000 * 1000;
 }  // namespace
 
 void PointCloudRenderer::InitializeGlContent(AAssetManager* asset_manager) {
-  shader_program_ = util::CreateProgram(kVertexShaderFilename,
-                                        kFragmentShaderFilename, asset_manager);
+  shader_program_ =
+      util::CreateProgram(ShaderVariant::kPointCloud, asset_manager);
   if (!shader_program_) {
     LOGE("Could not create program.");
   }
@@ -35,41 +59,270 @@ void PointCloudRenderer::InitializeGlContent(AAssetManager* asset_manager) {
       glGetUniformLocation(shader_program_, "u_ModelViewProjection");
   uniform_color_ = glGetUniformLocation(shader_program_, "u_Color");
   uniform_point_size_ = glGetUniformLocation(shader_program_, "u_PointSize");
+  uniform_point_size_attenuation_ =
+      glGetUniformLocation(shader_program_, "u_PointSizeAttenuation");
+
+  dense_shader_program_ =
+      util::CreateProgram(ShaderVariant::kDensePointCloud, asset_manager);
+  if (!dense_shader_program_) {
+    LOGE("Could not create dense point cloud program.");
+  }
+  dense_uniform_mvp_mat_ =
+      glGetUniformLocation(dense_shader_program_, "u_ModelViewProjection");
+  dense_uniform_depth_texture_ =
+      glGetUniformLocation(dense_shader_program_, "u_DepthTexture");
+  dense_uniform_depth_size_ =
+      glGetUniformLocation(dense_shader_program_, "u_DepthSize");
+  dense_uniform_depth_intrinsics_ =
+      glGetUniformLocation(dense_shader_program_, "u_DepthIntrinsics");
+  dense_uniform_confidence_threshold_ = glGetUniformLocation(
+      dense_shader_program_, "u_DepthConfidenceThreshold");
+  dense_uniform_max_depth_ =
+      glGetUniformLocation(dense_shader_program_, "u_MaxDepthMm");
+  dense_uniform_color_ = glGetUniformLocation(dense_shader_program_, "u_Color");
+  dense_uniform_point_size_ =
+      glGetUniformLocation(dense_shader_program_, "u_PointSize");
+
+  glGenBuffers(kNumBuffers, vertex_buffers_.data());
+  buffer_capacities_.fill(0);
+  fences_.fill(nullptr);
+  current_buffer_ = 0;
+  glGenBuffers(1, &map_vertex_buffer_);
+  glGenBuffers(1, &map_index_buffer_);
+  map_buffer_capacity_ = 0;
+  uploaded_bytes_ = 0;
+  uploaded_bytes_total_ = 0;
 
   util::CheckGlError("point_cloud_renderer::InitializeGlContent()");
 }
 
 void PointCloudRenderer::Draw(const glm::mat4& mvp_matrix,
                               ArSession* ar_session,
-                              ArPointCloud* ar_point_cloud) const {
-  CHECK(shader_program_);
-
-  glUseProgram(shader_program_);
-
+                              ArPointCloud* ar_point_cloud) {
   int32_t number_of_points = 0;
   ArPointCloud_getNumberOfPoints(ar_session, ar_point_cloud, &number_of_points);
+  const float* point_cloud_data = nullptr;
+  if (number_of_points > 0) {
+    ArPointCloud_getData(ar_session, ar_point_cloud, &point_cloud_data);
+  }
+  Draw(mvp_matrix, point_cloud_data, number_of_points);
+}
+
+void PointCloudRenderer::Draw(const glm::mat4& mvp_matrix,
+                              const float* point_cloud_data,
+                              int32_t number_of_points) {
+  CHECK(shader_program_);
+
+  uploaded_bytes_ = 0;
   if (number_of_points <= 0) {
     return;
   }
 
-  const float* point_cloud_data;
-  ArPointCloud_getData(ar_session, ar_point_cloud, &point_cloud_data);
+  const int32_t points_drawn =
+      (number_of_points + point_stride_ - 1) / point_stride_;
+  const GLsizeiptr data_size = points_drawn * kPointComponents * sizeof(float);
+  current_buffer_ = (current_buffer_ + 1) % kNumBuffers;
+  WaitForBuffer(current_buffer_);
+
+  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffers_[current_buffer_]);
+  if (buffer_capacities_[current_buffer_] < data_size) {
+    // Grows with headroom so the storage is rarely reallocated as the point
+    // cloud gets denser.
+    buffer_capacities_[current_buffer_] = data_size * 2;
+    glBufferData(GL_ARRAY_BUFFER, buffer_capacities_[current_buffer_],
+                 nullptr, GL_STREAM_DRAW);
+    ResourceAccounting::Get().Track(
+        GpuResourceType::kBuffer, vertex_buffers_[current_buffer_],
+        buffer_capacities_[current_buffer_], kOwner);
+  }
+
+  void* mapped = glMapBufferRange(
+      GL_ARRAY_BUFFER, 0, data_size,
+      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
+          GL_MAP_UNSYNCHRONIZED_BIT);
+  if (mapped == nullptr) {
+    LOGE("PointCloudRenderer::Draw glMapBufferRange failed.");
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return;
+  }
+  if (point_stride_ == 1) {
+    memcpy(mapped, point_cloud_data, data_size);
+  } else {
+    float* destination = static_cast<float*>(mapped);
+    for (int32_t i = 0; i < points_drawn; ++i) {
+      memcpy(destination + i * kPointComponents,
+             point_cloud_data + i * point_stride_ * kPointComponents,
+             kPointComponents * sizeof(float));
+    }
+  }
+  glUnmapBuffer(GL_ARRAY_BUFFER);
+  uploaded_bytes_ = data_size;
+  uploaded_bytes_total_ += data_size;
+
+  PreparePointDraw(mvp_matrix, glm::vec2(0.0f));
+  glDrawArrays(GL_POINTS, 0, points_drawn);
+
+  // Marks when the GPU is done reading this buffer.
+  fences_[current_buffer_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  util::CheckGlError("PointCloudRenderer::Draw");
+}
+
+void PointCloudRenderer::DrawMap(const glm::mat4& mvp_matrix,
+                                 PointCloudMap* map) {
+  CHECK(shader_program_);
+
+  uploaded_bytes_ = 0;
+  glBindBuffer(GL_ARRAY_BUFFER, map_vertex_buffer_);
+  const GLsizeiptr capacity = static_cast<GLsizeiptr>(map->GetMaxSlotCount()) *
+                              kPointComponents * sizeof(float);
+  if (map_buffer_capacity_ < capacity) {
+    // Sized for the whole map once, so slots never move.
+    glBufferData(GL_ARRAY_BUFFER, capacity, nullptr, GL_DYNAMIC_DRAW);
+    ResourceAccounting::Get().Track(GpuResourceType::kBuffer,
+                                    map_vertex_buffer_, capacity, kOwner);
+    map_buffer_capacity_ = capacity;
+    map->MarkAllDirty();
+  }
+
+  map->TakeDirtyRanges(&map_dirty_ranges_);
+  const float* slot_data = map->GetSlotData();
+  for (const PointCloudMap::SlotRange& range : map_dirty_ranges_) {
+    const GLsizeiptr offset = range.first * kPointComponents * sizeof(float);
+    const GLsizeiptr size = range.count * kPointComponents * sizeof(float);
+    glBufferSubData(GL_ARRAY_BUFFER, offset, size,
+                    slot_data + range.first * kPointComponents);
+    uploaded_bytes_ += size;
+  }
+  uploaded_bytes_total_ += uploaded_bytes_;
+
+  // Counts the points to draw per cell.  The pixels a point covers are
+  // estimated at full confidence, an upper bound of what the shader draws.
+  map_cells_.clear();
+  float fill_pixels = 0.0f;
+  map->ForEachCell([&](const glm::vec3& center,
+                       const std::vector<int32_t>& slots) {
+    const float depth = (mvp_matrix * glm::vec4(center, 1.0f)).w;
+    if (depth <= 0.0f) {
+      return;
+    }
+    const float scale =
+        glm::clamp(kMapReferenceDepthM / depth, kMapMinSizeScale, 1.0f);
+    const float point_size = kPointSize * scale;
+    // The area of the cell on screen falls with the square of the depth.
+    const float count = std::ceil(slots.size() * scale * scale);
+    map_cells_.emplace_back(&slots, count);
+    fill_pixels += count * point_size * point_size;
+  });
+
+  // Takes the leading points of every cell, carrying the fractions over so
+  // the total matches the budget.
+  const float budget_scale =
+      fill_pixels > kMapFillBudgetPixels ? kMapFillBudgetPixels / fill_pixels
+                                         : 1.0f;
+  map_indices_.clear();
+  float carry = 0.0f;
+  for (const auto& cell : map_cells_) {
+    carry += cell.second * budget_scale;
+    const int count = static_cast<int>(carry);
+    carry -= count;
+    map_indices_.insert(map_indices_.end(), cell.first->begin(),
+                        cell.first->begin() + count);
+  }
+  map_points_drawn_ = static_cast<int32_t>(map_indices_.size());
+
+  if (!map_indices_.empty()) {
+    // Orphans last frame's storage so the upload does not wait on the GPU.
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, map_index_buffer_);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, map_indices_.size() * sizeof(GLuint),
+                 map_indices_.data(), GL_STREAM_DRAW);
+    ResourceAccounting::Get().Track(GpuResourceType::kBuffer,
+                                    map_index_buffer_,
+                                    map_indices_.size() * sizeof(GLuint),
+                                    kOwner);
+    PreparePointDraw(mvp_matrix,
+                     glm::vec2(kMapReferenceDepthM, kMapMinSizeScale));
+    glDrawElements(GL_POINTS, map_points_drawn_, GL_UNSIGNED_INT, nullptr);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  util::CheckGlError("PointCloudRenderer::DrawMap");
+}
+
+void PointCloudRenderer::PreparePointDraw(const glm::mat4& mvp_matrix,
+                                          const glm::vec2& size_attenuation) {
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
+  gl_state.UseProgram(shader_program_);
+  gl_state.DepthMask(GL_TRUE);
+  gl_state.SetCapability(GL_BLEND, false);
 
   glUniformMatrix4fv(uniform_mvp_mat_, 1, GL_FALSE, glm::value_ptr(mvp_matrix));
 
-  glEnableVertexAttribArray(attribute_vertices_);
-  glVertexAttribPointer(attribute_vertices_, 4, GL_FLOAT, GL_FALSE, 0,
-                        point_cloud_data);
+  gl_state.SetEnabledVertexAttribArrays(1u << attribute_vertices_);
+  glVertexAttribPointer(attribute_vertices_, kPointComponents, GL_FLOAT,
+                        GL_FALSE, 0, nullptr);
 
   // Set cyan color to the point cloud.
   glUniform4f(uniform_color_, 31.0f / 255.0f, 188.0f / 255.0f, 210.0f / 255.0f,
               1.0f);
-  glUniform1f(uniform_point_size_, 5.0f);
+  glUniform1f(uniform_point_size_, kPointSize);
+  glUniform2fv(uniform_point_size_attenuation_, 1,
+               glm::value_ptr(size_attenuation));
+}
 
-  glDrawArrays(GL_POINTS, 0, number_of_points);
+void PointCloudRenderer::DrawDense(const FrameContext& frame_context,
+                                   GLuint depth_texture_id, int depth_width,
+                                   int depth_height,
+                                   float confidence_threshold) {
+  const glm::vec4 depth_intrinsics =
+      frame_context.GetDepthIntrinsics(depth_width, depth_height);
+  if (!dense_shader_program_ || depth_texture_id == 0 || depth_width <= 0 ||
+      depth_height <= 0 || depth_intrinsics.x <= 0.0f) {
+    return;
+  }
 
-  glUseProgram(0);
-  util::CheckGlError("PointCloudRenderer::Draw");
+  const glm::mat4 mvp_matrix = util::MultiplyMatrices(
+      frame_context.view_projection_mat, frame_context.camera_pose_mat);
+
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
+  gl_state.UseProgram(dense_shader_program_);
+  gl_state.DepthMask(GL_TRUE);
+  gl_state.SetCapability(GL_BLEND, false);
+  // Every input comes from gl_VertexID and the depth texture.
+  gl_state.SetEnabledVertexAttribArrays(0);
+
+  gl_state.ActiveTexture(GL_TEXTURE0);
+  gl_state.BindTexture(GL_TEXTURE_2D, depth_texture_id);
+  glUniform1i(dense_uniform_depth_texture_, 0);
+  glUniformMatrix4fv(dense_uniform_mvp_mat_, 1, GL_FALSE,
+                     glm::value_ptr(mvp_matrix));
+  glUniform2i(dense_uniform_depth_size_, depth_width, depth_height);
+  glUniform4fv(dense_uniform_depth_intrinsics_, 1,
+               glm::value_ptr(depth_intrinsics));
+  glUniform1f(dense_uniform_confidence_threshold_, confidence_threshold);
+  glUniform1f(dense_uniform_max_depth_, kDenseMaxDepthMm);
+  glUniform4f(dense_uniform_color_, 31.0f / 255.0f, 188.0f / 255.0f,
+              210.0f / 255.0f, 1.0f);
+  glUniform1f(dense_uniform_point_size_, 2.0f);
+
+  glDrawArrays(GL_POINTS, 0, depth_width * depth_height);
+  util::CheckGlError("PointCloudRenderer::DrawDense");
+}
+
+void PointCloudRenderer::WaitForBuffer(int buffer_index) {
+  GLsync fence = fences_[buffer_index];
+  if (fence == nullptr) {
+    return;
+  }
+  GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                   kFenceTimeoutNs);
+  if (result == GL_TIMEOUT_EXPIRED || result == GL_WAIT_FAILED) {
+    LOGE("PointCloudRenderer: ring buffer %d fence wait failed (0x%x).",
+         buffer_index, result);
+  }
+  glDeleteSync(fence);
+  fences_[buffer_index] = nullptr;
 }
 
 }  // namespace hello_ar
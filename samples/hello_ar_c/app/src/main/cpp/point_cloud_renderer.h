@@ -17,13 +17,20 @@
 #ifndef C_ARCORE_HELLOE_AR_POINT_CLOUD_RENDERER_H_
 #define C_ARCORE_HELLOE_AR_POINT_CLOUD_RENDERER_H_
 
-#include <GLES2/gl2.h>
+// clang-format off
+#include <GLES3/gl3.h>
 #include <GLES2/gl2ext.h>
+// clang-format on
 #include <android/asset_manager.h>
+#include <array>
+#include <cstdint>
 #include <cstdlib>
+#include <utility>
 #include <vector>
 #include "arcore_c_api.h"
+#include "frame_context.h"
 #include "glm.h"
+#include "point_cloud_map.h"
 
 namespace hello_ar {
 
@@ -40,19 +47,115 @@ class PointCloudRenderer {
 
   // Render the AR point cloud.
   //
+  // The points are copied into one buffer of a triple-buffered ring through
+  // an unsynchronized mapping.  A fence per buffer guarantees the GPU is done
+  // reading a buffer before it is written again, so the copy never stalls on
+  // draws still in flight.
+  //
   // @param mvp_matrix, the model view projection matrix of point cloud.
   // @param ar_session, the session that is used to query point cloud points
   //     from ar_point_cloud.
   // @param ar_point_cloud, point cloud data to for rendering.
   void Draw(const glm::mat4& mvp_matrix, ArSession* ar_session,
-            ArPointCloud* ar_point_cloud) const;
+            ArPointCloud* ar_point_cloud);
+
+  // Same as above for points already copied out of an ArPointCloud.
+  //
+  // @param point_cloud_data, |number_of_points| x, y, z, confidence tuples.
+  void Draw(const glm::mat4& mvp_matrix, const float* point_cloud_data,
+            int32_t number_of_points);
+
+  // Renders the points of |map| from a vertex buffer of its own.
+  //
+  // Only the slot ranges that changed since the previous call are uploaded,
+  // with glBufferSubData, so a map that stopped growing costs next to
+  // nothing per frame.
+  //
+  // Distant cells draw smaller points and only a prefix of their points,
+  // keeping the screen density about constant, and all counts are scaled
+  // down to fit a fixed budget of covered pixels per frame.  The indices of
+  // the drawn points are streamed every frame.
+  void DrawMap(const glm::mat4& mvp_matrix, PointCloudMap* map);
+
+  // Returns the number of points the most recent DrawMap call drew.
+  int32_t GetMapPointsDrawn() const { return map_points_drawn_; }
+
+  // Renders one point per texel of a depth texture as a dense point cloud.
+  //
+  // The vertex shader unprojects every texel with the camera intrinsics and
+  // pose, so nothing is read back to the CPU and no vertex buffer is used.
+  // Texels without depth, or below |confidence_threshold| in a raw depth
+  // texture, are dropped.
+  //
+  // @param frame_context, camera pose, texture intrinsics and view
+  //     projection of the frame the depth texture belongs to.
+  // @param depth_texture_id, depth texture in the format written by Texture.
+  void DrawDense(const FrameContext& frame_context, GLuint depth_texture_id,
+                 int depth_width, int depth_height,
+                 float confidence_threshold);
+
+  // Returns the number of bytes uploaded by the most recent Draw or DrawMap
+  // call.
+  size_t GetUploadedBytesLastFrame() const { return uploaded_bytes_; }
+
+  // Returns the total number of bytes uploaded since InitializeGlContent.
+  uint64_t GetUploadedBytesTotal() const { return uploaded_bytes_total_; }
+
+  // Makes Draw() upload and draw only every |stride|-th point, e.g. to save
+  // power while the device is hot.  1 draws all points.
+  void SetPointStride(int stride) { point_stride_ = stride > 1 ? stride : 1; }
+
+  // The program of Draw() and DrawMap(), e.g. to sort passes by.
+  GLuint GetProgram() const { return shader_program_; }
 
  private:
+  static constexpr int kNumBuffers = 3;
+
+  // Makes sure the GPU finished reading from the current ring buffer.
+  void WaitForBuffer(int buffer_index);
+
+  // Sets up the program to draw the points of the bound GL_ARRAY_BUFFER.
+  //
+  // @param size_attenuation, depth up to which points keep their full size
+  //     and the smallest scale of the size beyond it, or 0 for a fixed size.
+  void PreparePointDraw(const glm::mat4& mvp_matrix,
+                        const glm::vec2& size_attenuation);
+
+  std::array<GLuint, kNumBuffers> vertex_buffers_ = {};
+  std::array<GLsizeiptr, kNumBuffers> buffer_capacities_ = {};
+  std::array<GLsync, kNumBuffers> fences_ = {};
+  int current_buffer_ = 0;
+
+  GLuint map_vertex_buffer_ = 0;
+  GLuint map_index_buffer_ = 0;
+  GLsizeiptr map_buffer_capacity_ = 0;
+  std::vector<PointCloudMap::SlotRange> map_dirty_ranges_;
+  // Cells of the map in front of the camera, with their number of points to
+  // draw.
+  std::vector<std::pair<const std::vector<int32_t>*, float>> map_cells_;
+  std::vector<GLuint> map_indices_;
+  int32_t map_points_drawn_ = 0;
+
+  size_t uploaded_bytes_ = 0;
+  uint64_t uploaded_bytes_total_ = 0;
+  int point_stride_ = 1;
+
   GLuint shader_program_;
   GLint attribute_vertices_;
   GLint uniform_mvp_mat_;
   GLint uniform_color_;
   GLint uniform_point_size_;
+  GLint uniform_point_size_attenuation_;
+
+  GLuint dense_shader_program_ = 0;
+  GLint dense_uniform_mvp_mat_ = -1;
+  GLint dense_uniform_depth_texture_ = -1;
+  GLint dense_uniform_depth_size_ = -1;
+  GLint dense_uniform_depth_intrinsics_ = -1;
+  GLint dense_uniform_confidence_threshold_ = -1;
+  GLint dense_uniform_max_depth_ = -1;
+  GLint dense_uniform_color_ = -1;
+  GLint dense_uniform_point_size_ = -1;
 };
 }  // namespace hello_ar
 
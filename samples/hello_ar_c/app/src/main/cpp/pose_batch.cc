@@ -0,0 +1,138 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "pose_batch.h"
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace hello_ar {
+namespace {
+#if defined(__ARM_NEON)
+constexpr size_t kLanes = 4;
+
+// Transposes the rows |a| to |d| in place, turning lane i of each row into
+// row i.
+inline void Transpose(float32x4_t* a, float32x4_t* b, float32x4_t* c,
+                      float32x4_t* d) {
+  const float32x4x2_t ab = vtrnq_f32(*a, *b);
+  const float32x4x2_t cd = vtrnq_f32(*c, *d);
+  *a = vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0]));
+  *b = vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1]));
+  *c = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+  *d = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+}
+#endif  // __ARM_NEON
+}  // namespace
+
+void PoseBatch::Resize(size_t size) {
+  for (int component = 0; component < kNumComponents; ++component) {
+    components_[component].resize(size, component == kQw ? 1.0f : 0.0f);
+  }
+}
+
+void PoseBatch::ReadAnchorPose(const ArSession* session,
+                               const ArAnchor* anchor, ArPose* scratch_pose,
+                               size_t index) {
+  float pose_raw[kNumComponents];
+  ArAnchor_getPose(session, anchor, scratch_pose);
+  ArPose_getPoseRaw(session, scratch_pose, pose_raw);
+  for (int component = 0; component < kNumComponents; ++component) {
+    components_[component][index] = pose_raw[component];
+  }
+}
+
+void PoseBatch::Copy(size_t from, size_t to) {
+  for (std::vector<float>& component : components_) {
+    component[to] = component[from];
+  }
+}
+
+glm::quat PoseBatch::GetRotation(size_t index) const {
+  return glm::quat(components_[kQw][index], components_[kQx][index],
+                   components_[kQy][index], components_[kQz][index]);
+}
+
+void PoseBatch::GetRaw(size_t index, float* pose_raw) const {
+  for (int component = 0; component < kNumComponents; ++component) {
+    pose_raw[component] = components_[component][index];
+  }
+}
+
+glm::vec3 PoseBatch::GetTranslation(size_t index) const {
+  return glm::vec3(components_[kTx][index], components_[kTy][index],
+                   components_[kTz][index]);
+}
+
+glm::mat4 PoseBatch::GetMatrix(size_t index) const {
+  glm::mat4 matrix = glm::mat4_cast(GetRotation(index));
+  matrix[3] = glm::vec4(GetTranslation(index), 1.0f);
+  return matrix;
+}
+
+void PoseBatch::GetMatrices(glm::mat4* matrices) const {
+  const size_t size = GetSize();
+  size_t i = 0;
+#if defined(__ARM_NEON)
+  const float32x4_t one = vdupq_n_f32(1.0f);
+  const float32x4_t zero = vdupq_n_f32(0.0f);
+  for (; i + kLanes <= size; i += kLanes) {
+    const float32x4_t x = vld1q_f32(&components_[kQx][i]);
+    const float32x4_t y = vld1q_f32(&components_[kQy][i]);
+    const float32x4_t z = vld1q_f32(&components_[kQz][i]);
+    const float32x4_t w = vld1q_f32(&components_[kQw][i]);
+    // Products of the quaternion components, doubled, as in
+    // glm::mat3_cast().
+    const float32x4_t x2 = vaddq_f32(x, x);
+    const float32x4_t y2 = vaddq_f32(y, y);
+    const float32x4_t z2 = vaddq_f32(z, z);
+    const float32x4_t xx = vmulq_f32(x, x2);
+    const float32x4_t yy = vmulq_f32(y, y2);
+    const float32x4_t zz = vmulq_f32(z, z2);
+    const float32x4_t xy = vmulq_f32(x, y2);
+    const float32x4_t xz = vmulq_f32(x, z2);
+    const float32x4_t yz = vmulq_f32(y, z2);
+    const float32x4_t wx = vmulq_f32(w, x2);
+    const float32x4_t wy = vmulq_f32(w, y2);
+    const float32x4_t wz = vmulq_f32(w, z2);
+
+    // Element r of column c of all four matrices, one matrix per lane.
+    float32x4_t columns[4][4] = {
+        {vsubq_f32(one, vaddq_f32(yy, zz)), vaddq_f32(xy, wz),
+         vsubq_f32(xz, wy), zero},
+        {vsubq_f32(xy, wz), vsubq_f32(one, vaddq_f32(xx, zz)),
+         vaddq_f32(yz, wx), zero},
+        {vaddq_f32(xz, wy), vsubq_f32(yz, wx),
+         vsubq_f32(one, vaddq_f32(xx, yy)), zero},
+        {vld1q_f32(&components_[kTx][i]), vld1q_f32(&components_[kTy][i]),
+         vld1q_f32(&components_[kTz][i]), one},
+    };
+    for (int c = 0; c < 4; ++c) {
+      float32x4_t* column = columns[c];
+      Transpose(&column[0], &column[1], &column[2], &column[3]);
+      for (size_t lane = 0; lane < kLanes; ++lane) {
+        vst1q_f32(glm::value_ptr(matrices[i + lane][c]), column[lane]);
+      }
+    }
+  }
+#endif  // __ARM_NEON
+  for (; i < size; ++i) {
+    matrices[i] = GetMatrix(i);
+  }
+}
+
+}  // namespace hello_ar
@@ -0,0 +1,72 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_POSE_BATCH_H_
+#define C_ARCORE_HELLOE_AR_POSE_BATCH_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "arcore_c_api.h"
+#include "glm.h"
+
+namespace hello_ar {
+
+// Poses of many anchors as struct of arrays, one array per component of
+// ArPose_getPoseRaw(), so GetMatrices() converts four of them at a time
+// with NEON where available.
+//
+// Reading a pose through one reused ArPose and ArPose_getPoseRaw() skips
+// the ArPose_create()/ArPose_destroy() pair and the matrix computation
+// that util::GetTransformMatrixFromAnchor() does per anchor.  Not thread
+// safe.
+class PoseBatch {
+ public:
+  size_t GetSize() const { return components_[0].size(); }
+
+  // New poses are the identity.
+  void Resize(size_t size);
+
+  // Reads the pose of |anchor| into |index| through |scratch_pose|.
+  void ReadAnchorPose(const ArSession* session, const ArAnchor* anchor,
+                      ArPose* scratch_pose, size_t index);
+
+  // Copies the pose at |from| to |to|, e.g. to swap-remove a pose.
+  void Copy(size_t from, size_t to);
+
+  // Writes the seven floats ArPose_getPoseRaw() returned for |index|.
+  void GetRaw(size_t index, float* pose_raw) const;
+
+  glm::quat GetRotation(size_t index) const;
+  glm::vec3 GetTranslation(size_t index) const;
+  // The matrix ArPose_getMatrix() would return for the pose at |index|.
+  glm::mat4 GetMatrix(size_t index) const;
+
+  // Writes the matrix ArPose_getMatrix() would return for each pose to
+  // |matrices|, which must have room for GetSize() matrices.
+  void GetMatrices(glm::mat4* matrices) const;
+
+ private:
+  // Order of ArPose_getPoseRaw(): the rotation quaternion, then the
+  // translation.
+  enum Component { kQx = 0, kQy, kQz, kQw, kTx, kTy, kTz, kNumComponents };
+
+  std::vector<float> components_[kNumComponents];
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_POSE_BATCH_H_
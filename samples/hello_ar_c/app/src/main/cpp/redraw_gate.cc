@@ -0,0 +1,74 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "redraw_gate.h"
+
+#include <cstdio>
+
+namespace hello_ar {
+
+constexpr std::chrono::milliseconds RedrawGate::kIdleDelay;
+constexpr std::chrono::milliseconds RedrawGate::kIdleFrameInterval;
+
+void RedrawGate::Reset() {
+  draw_next_ = true;
+  idle_ = false;
+  tracking_lost_time_ = std::chrono::steady_clock::time_point();
+}
+
+bool RedrawGate::IsFrameDue(std::chrono::steady_clock::time_point now) {
+  if (!idle_ || draw_next_ || now - last_draw_time_ >= kIdleFrameInterval) {
+    return true;
+  }
+  ++idle_count_;
+  return false;
+}
+
+bool RedrawGate::ShouldDraw(const FrameState& state,
+                            std::chrono::steady_clock::time_point now) {
+  if (state.tracking_state == AR_TRACKING_STATE_TRACKING) {
+    tracking_lost_time_ = std::chrono::steady_clock::time_point();
+  } else if (tracking_lost_time_ == std::chrono::steady_clock::time_point()) {
+    tracking_lost_time_ = now;
+  }
+  idle_ = tracking_lost_time_ != std::chrono::steady_clock::time_point() &&
+          now - tracking_lost_time_ >= kIdleDelay;
+
+  if (!draw_next_ && !state.must_draw &&
+      state.timestamp_ns == last_timestamp_ns_ &&
+      state.tracking_state == last_tracking_state_) {
+    ++unchanged_count_;
+    return false;
+  }
+  draw_next_ = false;
+  last_timestamp_ns_ = state.timestamp_ns;
+  last_tracking_state_ = state.tracking_state;
+  last_draw_time_ = now;
+  ++drawn_count_;
+  return true;
+}
+
+std::string RedrawGate::GetReport() const {
+  char text[128];
+  snprintf(text, sizeof(text),
+           "%lld frames drawn, %lld skipped unchanged, %lld skipped idle%s",
+           static_cast<long long>(drawn_count_),
+           static_cast<long long>(unchanged_count_),
+           static_cast<long long>(idle_count_), idle_ ? ", idle" : "");
+  return text;
+}
+
+}  // namespace hello_ar
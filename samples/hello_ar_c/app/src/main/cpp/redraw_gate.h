@@ -0,0 +1,97 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_REDRAW_GATE_H_
+#define C_ARCORE_HELLOE_AR_REDRAW_GATE_H_
+
+#include <chrono>  // NOLINT
+#include <cstdint>
+#include <string>
+
+#include "arcore_c_api.h"
+
+namespace hello_ar {
+
+// Decides which frames are worth drawing, to save power where the picture
+// would not change.
+//
+// A frame is drawn if its camera timestamp or tracking state differs from
+// the last drawn frame, or if FrameState::must_draw says something else
+// changed, e.g. a touch; otherwise the previous frame can stay on the
+// display.  A latest-camera-image update at display rate returns the same
+// camera image for several frames, which are all skipped.
+//
+// Once the camera has not been tracking for kIdleDelay, the gate is idle:
+// frames are only due every kIdleFrameInterval, so the session is updated,
+// and the camera image shown, at a low rate until tracking resumes.
+//
+// Not thread safe; meant to be used on the thread that updates the session.
+class RedrawGate {
+ public:
+  static constexpr std::chrono::milliseconds kIdleDelay{2000};
+  static constexpr std::chrono::milliseconds kIdleFrameInterval{100};
+
+  // What a frame shows, compared with the last drawn frame.
+  struct FrameState {
+    int64_t timestamp_ns = 0;
+    ArTrackingState tracking_state = AR_TRACKING_STATE_STOPPED;
+    // Something else changes the picture, or the frame cannot be skipped.
+    bool must_draw = false;
+  };
+
+  RedrawGate() = default;
+
+  // Draws the next frame whatever it shows and leaves the idle state, e.g.
+  // for a new surface or after a pause.
+  void Reset();
+
+  // Whether a frame is to be started at |now|, before the session is
+  // updated.  False while idle until kIdleFrameInterval passed since the
+  // last drawn frame.
+  bool IsFrameDue(std::chrono::steady_clock::time_point now);
+
+  // Whether the updated frame |state| has to be drawn, which makes it the
+  // last drawn frame.  Also tracks how long tracking has been lost.
+  bool ShouldDraw(const FrameState& state,
+                  std::chrono::steady_clock::time_point now);
+
+  bool IsIdle() const { return idle_; }
+
+  // The interval frames are due at, 0 for every frame.
+  std::chrono::milliseconds GetFrameInterval() const {
+    return idle_ ? kIdleFrameInterval : std::chrono::milliseconds(0);
+  }
+
+  // Frames drawn and skipped for either reason, since the gate was created.
+  std::string GetReport() const;
+
+ private:
+  bool draw_next_ = true;
+  bool idle_ = false;
+  int64_t last_timestamp_ns_ = 0;
+  ArTrackingState last_tracking_state_ = AR_TRACKING_STATE_STOPPED;
+  std::chrono::steady_clock::time_point last_draw_time_;
+  // Zero while tracking.
+  std::chrono::steady_clock::time_point tracking_lost_time_;
+
+  int64_t drawn_count_ = 0;
+  int64_t unchanged_count_ = 0;
+  int64_t idle_count_ = 0;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_REDRAW_GATE_H_
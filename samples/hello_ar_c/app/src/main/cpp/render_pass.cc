@@ -0,0 +1,54 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "render_pass.h"
+
+#include "util.h"
+
+namespace hello_ar {
+
+void RenderPass::Begin(bool color_covered, const GLfloat clear_color[4]) {
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+  util::GlStateCache::Get().DepthMask(GL_TRUE);
+  if (color_covered && options_.skip_covered_color_clear) {
+    Invalidate(0, 1);
+    glClear(GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+    return;
+  }
+  glClearColor(clear_color[0], clear_color[1], clear_color[2],
+               clear_color[3]);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+}
+
+void RenderPass::End() {
+  if (options_.invalidate_depth_stencil) {
+    Invalidate(1, 2);
+  }
+}
+
+void RenderPass::Invalidate(int first, int count) {
+  // The surface names its buffers differently from framebuffer objects.
+  // Attachments a framebuffer does not have are ignored.
+  static constexpr GLenum kSurfaceAttachments[] = {GL_COLOR, GL_DEPTH,
+                                                   GL_STENCIL};
+  static constexpr GLenum kObjectAttachments[] = {
+      GL_COLOR_ATTACHMENT0, GL_DEPTH_ATTACHMENT, GL_STENCIL_ATTACHMENT};
+  const GLenum* attachments =
+      framebuffer_ == 0 ? kSurfaceAttachments : kObjectAttachments;
+  glInvalidateFramebuffer(GL_FRAMEBUFFER, count, attachments + first);
+}
+
+}  // namespace hello_ar
@@ -0,0 +1,73 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_RENDER_PASS_H_
+#define C_ARCORE_HELLOE_AR_RENDER_PASS_H_
+
+#include <GLES3/gl3.h>
+
+namespace hello_ar {
+
+// Load and store actions of the draws into one framebuffer, for tile based
+// GPUs.  Those draw a tile in on-chip memory, load it from the framebuffer
+// before the first draw unless it was cleared or invalidated, and write back
+// every attachment after the last draw unless it was invalidated.
+//
+// Begin() clears depth and stencil, and the color only if the caller does
+// not overwrite every pixel anyway; a covered color is invalidated, which
+// also avoids the load but skips the clear.  End() invalidates depth and
+// stencil, which nothing reads after the pass, so they never leave the tile.
+// Options switch each action off to A/B test it.  Depth and stencil are
+// always cleared together, since clearing only one of a packed pair makes
+// some GPUs load the other.
+//
+// All methods must be called on the GL thread.
+class RenderPass {
+ public:
+  struct Options {
+    // Invalidates instead of clears the color when Begin() is told the pass
+    // covers it.
+    bool skip_covered_color_clear = true;
+    // Invalidates depth and stencil in End().
+    bool invalidate_depth_stencil = true;
+  };
+
+  // A pass into |framebuffer|, 0 for the surface.
+  explicit RenderPass(GLuint framebuffer = 0) : framebuffer_(framebuffer) {}
+
+  void SetFramebuffer(GLuint framebuffer) { framebuffer_ = framebuffer; }
+  void SetOptions(const Options& options) { options_ = options; }
+
+  // Binds the framebuffer and starts the pass.  |color_covered| means the
+  // first draws write every pixel opaquely, so the previous color is not
+  // needed; otherwise the color is cleared to |clear_color|.  Leaves depth
+  // writes on.
+  void Begin(bool color_covered, const GLfloat clear_color[4]);
+
+  // Ends the pass after its last draw, with its framebuffer still bound.
+  void End();
+
+ private:
+  // Invalidates |count| of color, depth and stencil in that order.
+  void Invalidate(int first, int count);
+
+  GLuint framebuffer_;
+  Options options_;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_RENDER_PASS_H_
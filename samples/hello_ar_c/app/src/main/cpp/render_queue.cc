@@ -0,0 +1,173 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "render_queue.h"
+
+#include <algorithm>
+#include <array>
+#include <utility>
+
+#include "util.h"
+
+namespace hello_ar {
+namespace {
+constexpr int kDigitBits = 8;
+constexpr int kDigitCount = 64 / kDigitBits;
+constexpr size_t kBucketCount = 1 << kDigitBits;
+
+// Layout of a sort key, from the most significant bits:
+//   opaque:       phase, program, material, texture, depth
+//   transparent:  phase, inverted depth, program, material, texture
+//   other phases: phase only
+constexpr int kPhaseBits = 2;
+constexpr int kIdBits = 12;
+constexpr int kDepthBits = 64 - kPhaseBits - 3 * kIdBits;
+constexpr int kPhaseShift = 64 - kPhaseBits;
+constexpr uint64_t kIdMask = (uint64_t{1} << kIdBits) - 1;
+constexpr uint64_t kDepthMask = (uint64_t{1} << kDepthBits) - 1;
+static_assert(static_cast<int>(FrameGraph::Phase::kOverlay) <
+                  (1 << kPhaseBits),
+              "every phase needs to fit the phase bits");
+
+// Ids are GL names or small indices, so their low bits tell them apart.
+uint64_t FoldId(uint32_t id) { return id & kIdMask; }
+
+// Depth bits of |fraction|, in [0, 1].  kDepthMask rounds up to 2^kDepthBits
+// as a float, so the product is computed in double and clamped, otherwise
+// the farthest depth would carry into the bits above the field.
+constexpr uint64_t ScaleDepthFraction(double fraction) {
+  return std::min<uint64_t>(
+      static_cast<uint64_t>(fraction * static_cast<double>(kDepthMask)),
+      kDepthMask);
+}
+static_assert(ScaleDepthFraction(1.0) == kDepthMask,
+              "the farthest depth must stay inside the depth bits");
+static_assert(ScaleDepthFraction(0.5) < ScaleDepthFraction(1.0),
+              "depth keys must ascend with depth");
+static_assert(((kDepthMask - ScaleDepthFraction(1.0)) << (3 * kIdBits)) <
+                  ((kDepthMask - ScaleDepthFraction(0.5)) << (3 * kIdBits)),
+              "far transparent draws must sort before near ones");
+static_assert((kDepthMask << (3 * kIdBits)) < (uint64_t{1} << kPhaseShift),
+              "inverted depth must not reach the phase bits");
+}  // namespace
+
+void RadixSorter::Sort(std::vector<Item>* items) {
+  const size_t count = items->size();
+  if (count < 2) {
+    return;
+  }
+  // One histogram per digit, all counted in a single pass over the keys.
+  std::array<std::array<uint32_t, kBucketCount>, kDigitCount> histograms = {};
+  for (const Item& item : *items) {
+    for (int digit = 0; digit < kDigitCount; ++digit) {
+      ++histograms[digit][(item.key >> (digit * kDigitBits)) &
+                          (kBucketCount - 1)];
+    }
+  }
+
+  scratch_.resize(count);
+  Item* source = items->data();
+  Item* destination = scratch_.data();
+  for (int digit = 0; digit < kDigitCount; ++digit) {
+    const int shift = digit * kDigitBits;
+    std::array<uint32_t, kBucketCount>& histogram = histograms[digit];
+    if (histogram[(source[0].key >> shift) & (kBucketCount - 1)] == count) {
+      continue;  // Every key has the same digit, so the pass changes nothing.
+    }
+    uint32_t offset = 0;
+    for (uint32_t& bucket : histogram) {
+      const uint32_t bucket_count = bucket;
+      bucket = offset;
+      offset += bucket_count;
+    }
+    for (size_t i = 0; i < count; ++i) {
+      const Item& item = source[i];
+      destination[histogram[(item.key >> shift) & (kBucketCount - 1)]++] =
+          item;
+    }
+    std::swap(source, destination);
+  }
+  if (source != items->data()) {
+    std::copy(source, source + count, items->data());
+  }
+}
+
+constexpr float RenderQueue::kMaxSortDepthM;
+
+uint64_t RenderQueue::MakeDepthKey(float view_depth_m) {
+  // Also maps NaN to zero.
+  const float fraction =
+      view_depth_m > 0.0f ? std::min(view_depth_m / kMaxSortDepthM, 1.0f)
+                          : 0.0f;
+  return ScaleDepthFraction(fraction);
+}
+
+uint64_t RenderQueue::MakeKey(FrameGraph::Phase phase, GLuint program,
+                              uint32_t material, GLuint texture,
+                              float view_depth_m) {
+  const uint64_t phase_bits = static_cast<uint64_t>(phase) << kPhaseShift;
+  const uint64_t depth = MakeDepthKey(view_depth_m);
+  switch (phase) {
+    case FrameGraph::Phase::kOpaque:
+      return phase_bits | FoldId(program) << (kDepthBits + 2 * kIdBits) |
+             FoldId(material) << (kDepthBits + kIdBits) |
+             FoldId(texture) << kDepthBits | depth;
+    case FrameGraph::Phase::kTransparent:
+      return phase_bits | (kDepthMask - depth) << (3 * kIdBits) |
+             FoldId(program) << (2 * kIdBits) | FoldId(material) << kIdBits |
+             FoldId(texture);
+    case FrameGraph::Phase::kBackground:
+    case FrameGraph::Phase::kOverlay:
+      break;
+  }
+  // The sort is stable, so equal keys keep their insertion order.
+  return phase_bits;
+}
+
+void RenderQueue::Add(Packet packet) { packets_.push_back(std::move(packet)); }
+
+void RenderQueue::Submit() {
+  order_.clear();
+  for (size_t i = 0; i < packets_.size(); ++i) {
+    order_.push_back({packets_[i].key, static_cast<uint32_t>(i)});
+  }
+  sorter_.Sort(&order_);
+
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
+  int state_changes = 0;
+  const Packet* previous = nullptr;
+  for (const RadixSorter::Item& item : order_) {
+    const Packet& packet = packets_[item.index];
+    if (previous != nullptr) {
+      state_changes +=
+          FrameGraph::CountStateChanges(previous->state, packet.state) +
+          (previous->texture != packet.texture ? 1 : 0);
+    }
+    previous = &packet;
+
+    FrameGraph::ApplyState(packet.state);
+    if (packet.texture != 0) {
+      gl_state.ActiveTexture(GL_TEXTURE0);
+      gl_state.BindTexture(GL_TEXTURE_2D, packet.texture);
+    }
+    packet.draw();
+  }
+  packets_last_submit_ = static_cast<int>(order_.size());
+  state_changes_last_submit_ = state_changes;
+  packets_.clear();
+}
+
+}  // namespace hello_ar
@@ -0,0 +1,122 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_RENDER_QUEUE_H_
+#define C_ARCORE_HELLOE_AR_RENDER_QUEUE_H_
+
+#include <GLES2/gl2.h>
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "frame_graph.h"
+
+namespace hello_ar {
+
+// Stable least significant digit radix sort of 64-bit keys, a byte per pass.
+// Passes over a byte that every key shares are skipped, so keys that only
+// use a few of their bits, e.g. a quantized depth, sort in two or three
+// passes.  The scratch buffer is kept, so sorting does not allocate once it
+// has grown to the largest count.
+class RadixSorter {
+ public:
+  struct Item {
+    uint64_t key;
+    // Index of the sorted element in the caller's array.
+    uint32_t index;
+  };
+
+  RadixSorter() = default;
+
+  RadixSorter(const RadixSorter&) = delete;
+  RadixSorter& operator=(const RadixSorter&) = delete;
+
+  // Sorts |items| by ascending key, keeping the order of equal keys.
+  void Sort(std::vector<Item>* items);
+
+ private:
+  std::vector<Item> scratch_;
+};
+
+// The draws of a frame as packets with a 64-bit sort key, submitted in key
+// order once per frame.
+//
+// The key packs the FrameGraph phase into the top bits, so packets run in
+// the same phase order as passes.  Opaque packets are then ordered by
+// program, material and texture, and last front to back, so state changes
+// are grouped and the depth test rejects as many hidden fragments as
+// possible.  Transparent packets are ordered back to front first, which
+// blending needs, and by state among equal depths.  Background and overlay
+// packets keep the order they were added in.  Program, material and texture
+// ids are folded into 12 bits each, so ids that collide only group less
+// well.
+//
+// Submit() applies the state of each packet through util::GlStateCache like
+// FrameGraph does for passes, so only the differences between consecutive
+// packets reach GL.  All calls must come from the GL thread.
+class RenderQueue {
+ public:
+  struct Packet {
+    uint64_t key = 0;
+    FrameGraph::PassState state;
+    // Bound to texture unit 0 as GL_TEXTURE_2D before the draw, unless 0.
+    GLuint texture = 0;
+    std::function<void()> draw;
+  };
+
+  // Depth beyond which packets are no longer ordered among themselves.
+  static constexpr float kMaxSortDepthM = 128.0f;
+
+  // Sort key of a draw in |phase| whose nearest point, or center for
+  // transparent draws, is at |view_depth_m| in front of the camera.
+  // |material| is any id of the draw's other bindings, e.g. a vertex array.
+  static uint64_t MakeKey(FrameGraph::Phase phase, GLuint program,
+                          uint32_t material, GLuint texture,
+                          float view_depth_m);
+
+  // The depth bits of MakeKey() alone, ascending with |view_depth_m|, e.g.
+  // to sort the instances of one draw front to back.
+  static uint64_t MakeDepthKey(float view_depth_m);
+
+  RenderQueue() = default;
+
+  RenderQueue(const RenderQueue&) = delete;
+  RenderQueue& operator=(const RenderQueue&) = delete;
+
+  void Add(Packet packet);
+
+  // Sorts the packets added since the last call, draws them and removes
+  // them.
+  void Submit();
+
+  int GetPacketsLastSubmit() const { return packets_last_submit_; }
+
+  // Number of PassState fields and textures that changed between
+  // consecutive packets of the last Submit() call.
+  int GetStateChangesLastSubmit() const { return state_changes_last_submit_; }
+
+ private:
+  std::vector<Packet> packets_;
+  std::vector<RadixSorter::Item> order_;
+  RadixSorter sorter_;
+  int packets_last_submit_ = 0;
+  int state_changes_last_submit_ = 0;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_RENDER_QUEUE_H_
@@ -0,0 +1,161 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "resource_accounting.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+
+namespace hello_ar {
+namespace {
+constexpr const char* kGpuResourceTypeNames[kNumGpuResourceTypes] = {
+    "textures", "buffers", "renderbuffers", "programs"};
+constexpr const char* kArHandleTypeNames[kNumArHandleTypes] = {
+    "anchors", "trackables", "images"};
+
+// Bytes per texel of the sized formats in use, 0 for others.
+size_t GetBytesPerTexel(GLenum internal_format) {
+  switch (internal_format) {
+    case GL_R8:
+      return 1;
+    case GL_RG8:
+    case GL_R16F:
+      return 2;
+    case GL_RGB8:
+      return 3;
+    case GL_RGBA8:
+    case GL_RG16F:
+    case GL_DEPTH_COMPONENT24:
+    case GL_DEPTH24_STENCIL8:
+      return 4;
+    case GL_RGB16F:
+      return 6;
+    case GL_RGBA16F:
+      return 8;
+    default:
+      return 0;
+  }
+}
+}  // namespace
+
+size_t GetTextureBytes(GLenum internal_format, int width, int height,
+                       int levels) {
+  const size_t bytes_per_texel = GetBytesPerTexel(internal_format);
+  size_t bytes = 0;
+  for (int level = 0; level < levels; ++level) {
+    bytes += bytes_per_texel * std::max(width >> level, 1) *
+             std::max(height >> level, 1);
+  }
+  return bytes;
+}
+
+size_t ResourceAccounting::OwnerUsage::GetTotalBytes() const {
+  size_t total = 0;
+  for (size_t type_bytes : bytes) {
+    total += type_bytes;
+  }
+  return total;
+}
+
+ResourceAccounting& ResourceAccounting::Get() {
+  static ResourceAccounting accounting;
+  return accounting;
+}
+
+void ResourceAccounting::Track(GpuResourceType type, GLuint name,
+                               size_t bytes, const char* owner) {
+  if (name == 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  Resource& resource = resources_[GetKey(type, name)];
+  resource.owner = owner;
+  resource.bytes = bytes;
+}
+
+void ResourceAccounting::Untrack(GpuResourceType type, GLuint name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  resources_.erase(GetKey(type, name));
+}
+
+void ResourceAccounting::Reset() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  resources_.clear();
+}
+
+std::vector<ResourceAccounting::OwnerUsage> ResourceAccounting::GetUsage()
+    const {
+  std::vector<OwnerUsage> usage;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& entry : resources_) {
+      const Resource& resource = entry.second;
+      auto it = std::find_if(usage.begin(), usage.end(),
+                             [&resource](const OwnerUsage& owner_usage) {
+                               return strcmp(owner_usage.owner,
+                                             resource.owner) == 0;
+                             });
+      if (it == usage.end()) {
+        usage.emplace_back();
+        it = usage.end() - 1;
+        it->owner = resource.owner;
+      }
+      const int type = static_cast<int>(entry.first >> 32);
+      ++it->counts[type];
+      it->bytes[type] += resource.bytes;
+    }
+  }
+  std::sort(usage.begin(), usage.end(),
+            [](const OwnerUsage& a, const OwnerUsage& b) {
+              return a.GetTotalBytes() > b.GetTotalBytes();
+            });
+  return usage;
+}
+
+std::string ResourceAccounting::GetReport() const {
+  std::string report;
+  char line[256];
+  size_t total_bytes = 0;
+  for (const OwnerUsage& usage : GetUsage()) {
+    int length = snprintf(line, sizeof(line), "%s:", usage.owner);
+    for (int type = 0; type < kNumGpuResourceTypes; ++type) {
+      if (usage.counts[type] == 0 || length >= static_cast<int>(sizeof(line))) {
+        continue;
+      }
+      length += snprintf(line + length, sizeof(line) - length,
+                         " %d %s (%.1f KiB)", usage.counts[type],
+                         kGpuResourceTypeNames[type],
+                         usage.bytes[type] / 1024.f);
+    }
+    report += line;
+    report += '\n';
+    total_bytes += usage.GetTotalBytes();
+  }
+  snprintf(line, sizeof(line), "GL total: %.1f KiB\nARCore:",
+           total_bytes / 1024.f);
+  report += line;
+  for (int type = 0; type < kNumArHandleTypes; ++type) {
+    snprintf(line, sizeof(line), " %" PRId64 " %s",
+             GetArHandleCount(static_cast<ArHandleType>(type)),
+             kArHandleTypeNames[type]);
+    report += line;
+  }
+  return report;
+}
+
+}  // namespace hello_ar
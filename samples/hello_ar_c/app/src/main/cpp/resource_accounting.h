@@ -0,0 +1,117 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_RESOURCE_ACCOUNTING_H_
+#define C_ARCORE_HELLOE_AR_RESOURCE_ACCOUNTING_H_
+
+#include <GLES3/gl3.h>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>  // NOLINT
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace hello_ar {
+
+enum class GpuResourceType {
+  kTexture = 0,
+  kBuffer,
+  kRenderbuffer,
+  kProgram,
+  kCount
+};
+
+constexpr int kNumGpuResourceTypes =
+    static_cast<int>(GpuResourceType::kCount);
+
+// ARCore handles the app holds, which ARCore limits or cannot reclaim.
+enum class ArHandleType { kAnchor = 0, kTrackable, kImage, kCount };
+
+constexpr int kNumArHandleTypes = static_cast<int>(ArHandleType::kCount);
+
+// Bytes of |levels| mip levels of a |width| x |height| texture in the sized
+// |internal_format|, or 0 for formats the renderers do not use.
+size_t GetTextureBytes(GLenum internal_format, int width, int height,
+                       int levels = 1);
+
+// The GL objects the renderers allocated, with their size and owner, and the
+// number of ARCore handles held, so leaks and budget overruns show up in soak
+// tests.
+//
+// Renderers call Track() whenever they (re)specify the storage of an object
+// and Untrack() when they delete it.  Drivers keep their own copies and
+// padding, so the sizes are what the app asked for, not what the GPU spends.
+// Like GlStateCache there is one instance for the single GL context; call
+// Reset() whenever a new context is created.  Thread safe.
+class ResourceAccounting {
+ public:
+  struct OwnerUsage {
+    const char* owner = "";
+    std::array<int, kNumGpuResourceTypes> counts = {};
+    std::array<size_t, kNumGpuResourceTypes> bytes = {};
+
+    size_t GetTotalBytes() const;
+  };
+
+  static ResourceAccounting& Get();
+
+  // Records that |name| of |type| holds |bytes| for |owner|, replacing what
+  // was recorded for it before.  |owner| must be a string with static
+  // storage, e.g. the renderer's class name.
+  void Track(GpuResourceType type, GLuint name, size_t bytes,
+             const char* owner);
+  void Untrack(GpuResourceType type, GLuint name);
+
+  // Forgets all GL objects, which went away with the previous context.
+  void Reset();
+
+  // Adds |delta| to the number of held handles of |type|.
+  void AddArHandles(ArHandleType type, int delta) {
+    ar_handles_[static_cast<int>(type)].fetch_add(delta,
+                                                  std::memory_order_relaxed);
+  }
+  int64_t GetArHandleCount(ArHandleType type) const {
+    return ar_handles_[static_cast<int>(type)].load(std::memory_order_relaxed);
+  }
+
+  // Usage per owner, the largest first.
+  std::vector<OwnerUsage> GetUsage() const;
+
+  // GetUsage() and the ARCore handle counts as text, one owner per line.
+  std::string GetReport() const;
+
+ private:
+  struct Resource {
+    const char* owner = "";
+    size_t bytes = 0;
+  };
+
+  static uint64_t GetKey(GpuResourceType type, GLuint name) {
+    return (static_cast<uint64_t>(type) << 32) | name;
+  }
+
+  mutable std::mutex mutex_;
+  std::unordered_map<uint64_t, Resource> resources_;
+  std::array<std::atomic<int64_t>, kNumArHandleTypes> ar_handles_ = {};
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_RESOURCE_ACCOUNTING_H_
@@ -0,0 +1,199 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "scene_graph.h"
+
+#include <cstring>
+
+#include "util.h"
+
+namespace hello_ar {
+
+constexpr uint32_t SceneGraph::kInvalidNode;
+
+uint32_t SceneGraph::CreateNode(uint32_t parent, uint32_t root,
+                                const glm::mat4& local_mat) {
+  const uint32_t id = static_cast<uint32_t>(nodes_.size());
+  Node node;
+  node.parent = parent;
+  node.root = root == kInvalidNode ? id : root;
+  nodes_.push_back(node);
+  local_mats_by_node_.push_back(local_mat);
+  needs_flatten_ = true;
+  return id;
+}
+
+uint32_t SceneGraph::AddAnchorNode(AnchorStore::Handle anchor,
+                                   const glm::mat4& local_mat) {
+  const uint32_t root = CreateNode(kInvalidNode, kInvalidNode, local_mat);
+  Anchor record;
+  record.handle = anchor;
+  record.root = root;
+  anchors_.push_back(record);
+  return root;
+}
+
+uint32_t SceneGraph::AddNode(uint32_t parent, const glm::mat4& local_mat) {
+  if (!IsAlive(parent)) {
+    LOGE("SceneGraph: Cannot add a node below removed node %u.", parent);
+    return kInvalidNode;
+  }
+  return CreateNode(parent, nodes_[parent].root, local_mat);
+}
+
+void SceneGraph::RemoveNode(uint32_t node) {
+  if (!IsAlive(node)) {
+    return;
+  }
+  MarkRemoved(node);
+  needs_flatten_ = true;
+}
+
+void SceneGraph::MarkRemoved(uint32_t node) {
+  nodes_[node].alive = false;
+  // Children have higher ids than their parents, so one pass in id order
+  // reaches the whole subtree.
+  for (uint32_t id = node + 1; id < nodes_.size(); ++id) {
+    Node& candidate = nodes_[id];
+    if (candidate.alive && candidate.root == nodes_[node].root &&
+        !nodes_[candidate.parent].alive) {
+      candidate.alive = false;
+    }
+  }
+}
+
+void SceneGraph::Clear() {
+  nodes_.clear();
+  local_mats_by_node_.clear();
+  flat_nodes_.clear();
+  flat_parents_.clear();
+  local_mats_.clear();
+  world_mats_.clear();
+  anchors_.clear();
+  needs_flatten_ = false;
+}
+
+void SceneGraph::SetLocalMatrix(uint32_t node, const glm::mat4& local_mat) {
+  if (!IsAlive(node)) {
+    return;
+  }
+  local_mats_by_node_[node] = local_mat;
+  if (needs_flatten_) {
+    return;  // Flatten() copies it and recomputes every anchor.
+  }
+  local_mats_[nodes_[node].flat_index] = local_mat;
+  for (Anchor& anchor : anchors_) {
+    if (anchor.root == nodes_[node].root) {
+      anchor.dirty = true;
+      break;
+    }
+  }
+}
+
+void SceneGraph::Flatten() {
+  needs_flatten_ = false;
+  // Drops the anchors whose root was removed and numbers the others.
+  std::vector<uint32_t> anchor_of_root(nodes_.size(), kInvalidNode);
+  size_t live_anchors = 0;
+  for (const Anchor& anchor : anchors_) {
+    if (nodes_[anchor.root].alive) {
+      anchor_of_root[anchor.root] = static_cast<uint32_t>(live_anchors);
+      anchors_[live_anchors++] = anchor;
+    }
+  }
+  anchors_.resize(live_anchors);
+
+  // Counting sort of the live nodes by anchor.  Nodes are visited in id
+  // order, so every parent stays ahead of its children.
+  for (Anchor& anchor : anchors_) {
+    anchor.count = 0;
+  }
+  for (const Node& node : nodes_) {
+    if (node.alive) {
+      ++anchors_[anchor_of_root[node.root]].count;
+    }
+  }
+  uint32_t first = 0;
+  for (Anchor& anchor : anchors_) {
+    // Advanced while placing the nodes and rewound below.
+    anchor.first = first;
+    first += anchor.count;
+    anchor.dirty = true;
+  }
+  flat_nodes_.resize(first);
+  flat_parents_.resize(first);
+  local_mats_.resize(first);
+  world_mats_.assign(first, glm::mat4(1.0f));
+  for (uint32_t id = 0; id < nodes_.size(); ++id) {
+    Node& node = nodes_[id];
+    if (!node.alive) {
+      continue;
+    }
+    Anchor& anchor = anchors_[anchor_of_root[node.root]];
+    node.flat_index = anchor.first++;
+    flat_nodes_[node.flat_index] = id;
+    flat_parents_[node.flat_index] = node.parent == kInvalidNode
+                                         ? kInvalidNode
+                                         : nodes_[node.parent].flat_index;
+    local_mats_[node.flat_index] = local_mats_by_node_[id];
+  }
+  for (Anchor& anchor : anchors_) {
+    anchor.first -= anchor.count;
+  }
+}
+
+int SceneGraph::Update(const AnchorStore& store) {
+  // Anchors the store dropped take their nodes with them.
+  for (const Anchor& anchor : anchors_) {
+    if (store.Get(anchor.handle) == nullptr && nodes_[anchor.root].alive) {
+      MarkRemoved(anchor.root);
+      needs_flatten_ = true;
+    }
+  }
+  if (needs_flatten_) {
+    Flatten();
+  }
+
+  int updated = 0;
+  float raw_pose[7];
+  for (Anchor& anchor : anchors_) {
+    const AnchorStore::Entry& entry = *store.Get(anchor.handle);
+    // The store keeps the last tracked pose of other anchors.
+    if (entry.tracking_state == AR_TRACKING_STATE_TRACKING) {
+      store.GetRawPose(entry, raw_pose);
+      if (memcmp(raw_pose, anchor.raw_pose, sizeof(raw_pose)) != 0) {
+        memcpy(anchor.raw_pose, raw_pose, sizeof(raw_pose));
+        anchor.dirty = true;
+      }
+    }
+    if (!anchor.dirty) {
+      continue;
+    }
+    anchor.dirty = false;
+    const glm::mat4& anchor_mat = store.GetModelMatrix(entry);
+    const uint32_t end = anchor.first + anchor.count;
+    for (uint32_t i = anchor.first; i < end; ++i) {
+      const uint32_t parent = flat_parents_[i];
+      world_mats_[i] =
+          (parent == kInvalidNode ? anchor_mat : world_mats_[parent]) *
+          local_mats_[i];
+    }
+    updated += static_cast<int>(anchor.count);
+  }
+  return updated;
+}
+
+}  // namespace hello_ar
@@ -0,0 +1,136 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_SCENE_GRAPH_H_
+#define C_ARCORE_HELLOE_AR_SCENE_GRAPH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "anchor_store.h"
+#include "glm.h"
+
+namespace hello_ar {
+
+// Hierarchies of nodes hanging off the anchors of an AnchorStore, whose
+// world matrices are only recomputed for anchors that moved.
+//
+// Each anchor has a root node whose world matrix is the anchor pose times
+// its local matrix, and any nodes below it.  The nodes are kept flattened in
+// one array per transform, grouped by anchor with every parent ahead of its
+// children, so updating an anchor is one forward pass over a contiguous
+// range.  Update() compares the raw pose of every anchor with the one its
+// matrices were computed from, and only recomputes the ranges of anchors
+// whose pose changed, or that had a local matrix set.  Anchors at rest,
+// which are most of them, cost a comparison of seven floats per frame.
+//
+// Adding or removing nodes re-flattens the arrays on the next Update(),
+// which is linear in the number of nodes.  Node ids are not reused.  Not
+// thread safe.
+class SceneGraph {
+ public:
+  static constexpr uint32_t kInvalidNode = UINT32_MAX;
+
+  SceneGraph() = default;
+
+  SceneGraph(const SceneGraph&) = delete;
+  SceneGraph& operator=(const SceneGraph&) = delete;
+
+  // Adds the root node of the anchor of |anchor|.  Its world matrix is the
+  // anchor pose times |local_mat|.  The root and the nodes below it are
+  // removed by the first Update() after the anchor was removed from the
+  // store.
+  uint32_t AddAnchorNode(AnchorStore::Handle anchor,
+                         const glm::mat4& local_mat = glm::mat4(1.0f));
+
+  // Adds a node below |parent|, which must not be removed.
+  uint32_t AddNode(uint32_t parent, const glm::mat4& local_mat);
+
+  // Removes |node| and every node below it.
+  void RemoveNode(uint32_t node);
+
+  // Removes all nodes, e.g. along with the anchors.
+  void Clear();
+
+  // Moves |node| relative to its parent.  Its anchor's nodes are recomputed
+  // by the next Update().
+  void SetLocalMatrix(uint32_t node, const glm::mat4& local_mat);
+
+  // Recomputes the world matrices of the anchors whose pose changed since
+  // the last call, with the poses of the last AnchorStore::BeginFrame().
+  // Returns the number of nodes that were recomputed.
+  int Update(const AnchorStore& store);
+
+  // As of the last Update(), so only valid for nodes that existed then.
+  const glm::mat4& GetWorldMatrix(uint32_t node) const {
+    return world_mats_[nodes_[node].flat_index];
+  }
+
+  bool IsAlive(uint32_t node) const {
+    return node < nodes_.size() && nodes_[node].alive;
+  }
+
+  size_t GetNodeCount() const { return flat_nodes_.size(); }
+  size_t GetAnchorCount() const { return anchors_.size(); }
+
+ private:
+  struct Node {
+    uint32_t parent = kInvalidNode;
+    // Root node of the anchor the node hangs off.
+    uint32_t root = kInvalidNode;
+    uint32_t flat_index = 0;
+    bool alive = true;
+  };
+
+  struct Anchor {
+    AnchorStore::Handle handle;
+    uint32_t root = kInvalidNode;
+    // Range of the anchor's nodes in the flattened arrays.
+    uint32_t first = 0;
+    uint32_t count = 0;
+    // ArPose_getPoseRaw() order, see PoseBatch.
+    float raw_pose[7] = {};
+    bool dirty = true;
+  };
+
+  uint32_t CreateNode(uint32_t parent, uint32_t root,
+                      const glm::mat4& local_mat);
+
+  // Rebuilds the flattened arrays from the live nodes.
+  void Flatten();
+
+  // Marks |node| and the nodes below it dead, which takes the anchor with
+  // them if |node| is a root.
+  void MarkRemoved(uint32_t node);
+
+  // Indexed by node id.
+  std::vector<Node> nodes_;
+  // Local matrices by node id, the source the flattened ones are built from.
+  std::vector<glm::mat4> local_mats_by_node_;
+  // Flattened, indexed by Node::flat_index.
+  std::vector<uint32_t> flat_nodes_;
+  // Flat index of the parent, or kInvalidNode for roots.
+  std::vector<uint32_t> flat_parents_;
+  std::vector<glm::mat4> local_mats_;
+  std::vector<glm::mat4> world_mats_;
+  std::vector<Anchor> anchors_;
+  bool needs_flatten_ = false;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_SCENE_GRAPH_H_
@@ -0,0 +1,332 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "semantics_pipeline.h"
+
+// clang-format off
+#include <GLES3/gl31.h>
+// clang-format on
+
+#include <algorithm>
+#include <cmath>
+
+#include "arcore_trace.h"
+#include "resource_accounting.h"
+#include "util.h"
+
+namespace hello_ar {
+
+namespace {
+constexpr char kOwner[] = "SemanticsPipeline";
+constexpr char kCountShaderFileName[] = "shaders/semantic_label_count.comp";
+// Matches the local size of the count shader.
+constexpr int kCountWorkGroupSize = 8;
+constexpr int kComponentsPerTexel = 2;
+}  // namespace
+
+constexpr int SemanticsPipeline::kNumLabels;
+constexpr int SemanticsPipeline::kNumCountBuffers;
+
+void SemanticsPipeline::InitializeGlContent(AAssetManager* asset_manager) {
+  // Objects and fences of a previous context are gone with it.
+  texture_ = 0;
+  width_ = 0;
+  height_ = 0;
+  uploaded_timestamp_ns_ = -1;
+  queried_labels_ = 0;
+  count_program_ = 0;
+  count_buffers_ = {};
+  next_count_buffer_ = 0;
+  pending_count_buffers_ = 0;
+  has_roi_fractions_ = false;
+  if (!util::IsContextVersionAtLeast31()) {
+    return;
+  }
+  count_program_ =
+      util::CreateComputeProgram(kCountShaderFileName, asset_manager);
+  if (!count_program_) {
+    LOGE("Could not create semantic label count program.");
+    return;
+  }
+  uniform_semantics_ = glGetUniformLocation(count_program_, "u_Semantics");
+  uniform_roi_ = glGetUniformLocation(count_program_, "u_Roi");
+  uniform_min_confidence_ =
+      glGetUniformLocation(count_program_, "u_MinConfidence");
+
+  constexpr size_t kCountBytes = kNumLabels * sizeof(GLuint);
+  for (CountBuffer& count_buffer : count_buffers_) {
+    glGenBuffers(1, &count_buffer.buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, count_buffer.buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, kCountBytes, nullptr,
+                 GL_DYNAMIC_READ);
+    ResourceAccounting::Get().Track(GpuResourceType::kBuffer,
+                                    count_buffer.buffer, kCountBytes, kOwner);
+  }
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  util::CheckGlError("SemanticsPipeline::InitializeGlContent()");
+}
+
+bool SemanticsPipeline::Update(const ArSession* session, const ArFrame* frame,
+                               FrameImageCache* frame_images) {
+  session_ = session;
+  frame_ = frame;
+  CollectRoiCounts();
+
+  const ArImage* semantic_image =
+      frame_images->Get(FrameImageCache::ImageType::kSemantic);
+  if (semantic_image == nullptr) {
+    return false;
+  }
+  int64_t timestamp_ns = 0;
+  ArImage_getTimestamp(session, semantic_image, &timestamp_ns);
+  if (timestamp_ns == uploaded_timestamp_ns_) {
+    return false;
+  }
+  // The confidence image is only acquired for a new semantic image.
+  const ArImage* confidence_image =
+      frame_images->Get(FrameImageCache::ImageType::kSemanticConfidence);
+  if (confidence_image == nullptr ||
+      !Upload(*semantic_image, *confidence_image)) {
+    return false;
+  }
+  uploaded_timestamp_ns_ = timestamp_ns;
+  queried_labels_ = 0;
+  return true;
+}
+
+float SemanticsPipeline::GetLabelFraction(ArSemanticLabel label) {
+  const int index = static_cast<int>(label);
+  if (index < 0 || index >= kNumLabels || uploaded_timestamp_ns_ < 0) {
+    return 0.f;
+  }
+  const uint32_t label_bit = 1u << index;
+  if ((queried_labels_ & label_bit) == 0) {
+    float fraction = 0.f;
+    if (traced::ArFrame_getSemanticLabelFraction(session_, frame_, label,
+                                                 &fraction) != AR_SUCCESS) {
+      fraction = 0.f;
+    }
+    label_fractions_[index] = fraction;
+    queried_labels_ |= label_bit;
+  }
+  return label_fractions_[index];
+}
+
+bool SemanticsPipeline::RequestRoiFractions(const glm::vec4& roi_ndc,
+                                            float min_confidence) {
+  if (!count_program_ || !texture_ ||
+      pending_count_buffers_ == kNumCountBuffers) {
+    return false;
+  }
+
+  // The semantic image covers the camera image, which the display may crop
+  // and rotate, so all four corners are mapped.
+  const float corners_ndc[8] = {roi_ndc.x, roi_ndc.y, roi_ndc.z, roi_ndc.y,
+                                roi_ndc.x, roi_ndc.w, roi_ndc.z, roi_ndc.w};
+  float corners_uv[8];
+  ArFrame_transformCoordinates2d(
+      session_, frame_, AR_COORDINATES_2D_OPENGL_NORMALIZED_DEVICE_COORDINATES,
+      4, corners_ndc, AR_COORDINATES_2D_IMAGE_NORMALIZED, corners_uv);
+  glm::vec2 min_uv(1.f);
+  glm::vec2 max_uv(0.f);
+  for (int i = 0; i < 4; ++i) {
+    const glm::vec2 uv(corners_uv[2 * i], corners_uv[2 * i + 1]);
+    min_uv = glm::min(min_uv, uv);
+    max_uv = glm::max(max_uv, uv);
+  }
+  const int first_x =
+      std::max(0, static_cast<int>(std::floor(min_uv.x * width_)));
+  const int first_y =
+      std::max(0, static_cast<int>(std::floor(min_uv.y * height_)));
+  const int end_x =
+      std::min(width_, static_cast<int>(std::ceil(max_uv.x * width_)));
+  const int end_y =
+      std::min(height_, static_cast<int>(std::ceil(max_uv.y * height_)));
+  if (end_x <= first_x || end_y <= first_y) {
+    return false;
+  }
+
+  CountBuffer& count_buffer = count_buffers_[next_count_buffer_];
+  const std::array<GLuint, kNumLabels> zero_counts = {};
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, count_buffer.buffer);
+  glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(zero_counts),
+                  zero_counts.data());
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
+  gl_state.UseProgram(count_program_);
+  gl_state.ActiveTexture(GL_TEXTURE0);
+  gl_state.BindTexture(GL_TEXTURE_2D, texture_);
+  glUniform1i(uniform_semantics_, 0);
+  glUniform4i(uniform_roi_, first_x, first_y, end_x - first_x,
+              end_y - first_y);
+  glUniform1f(uniform_min_confidence_, min_confidence);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, count_buffer.buffer);
+  glDispatchCompute(
+      (end_x - first_x + kCountWorkGroupSize - 1) / kCountWorkGroupSize,
+      (end_y - first_y + kCountWorkGroupSize - 1) / kCountWorkGroupSize, 1);
+  // The counts are read back by mapping the buffer.
+  glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+  count_buffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  // Makes sure the fence gets submitted, so polling it cannot hang.
+  glFlush();
+
+  next_count_buffer_ = (next_count_buffer_ + 1) % kNumCountBuffers;
+  ++pending_count_buffers_;
+  util::CheckGlError("SemanticsPipeline::RequestRoiFractions()");
+  return true;
+}
+
+bool SemanticsPipeline::GetRoiFractions(
+    std::array<float, kNumLabels>* fractions) const {
+  if (!has_roi_fractions_) {
+    return false;
+  }
+  *fractions = roi_fractions_;
+  return true;
+}
+
+void SemanticsPipeline::Allocate(int width, int height) {
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
+  if (texture_) {
+    gl_state.DeleteTexture(texture_);
+  }
+  glGenTextures(1, &texture_);
+  gl_state.BindTexture(GL_TEXTURE_2D, texture_);
+  // Labels cannot be interpolated.
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexStorage2D(GL_TEXTURE_2D, 1, GL_RG8, width, height);
+  ResourceAccounting::Get().Track(GpuResourceType::kTexture, texture_,
+                                  GetTextureBytes(GL_RG8, width, height),
+                                  kOwner);
+  width_ = width;
+  height_ = height;
+}
+
+bool SemanticsPipeline::Upload(const ArImage& semantic_image,
+                               const ArImage& confidence_image) {
+  ArImageFormat semantic_format;
+  ArImageFormat confidence_format;
+  ArImage_getFormat(session_, &semantic_image, &semantic_format);
+  ArImage_getFormat(session_, &confidence_image, &confidence_format);
+  if (semantic_format != AR_IMAGE_FORMAT_Y8 ||
+      confidence_format != AR_IMAGE_FORMAT_Y8) {
+    LOGE("Unexpected semantic image formats 0x%x, 0x%x", semantic_format,
+         confidence_format);
+    return false;
+  }
+
+  int width = 0;
+  int height = 0;
+  int confidence_width = 0;
+  int confidence_height = 0;
+  ArImage_getWidth(session_, &semantic_image, &width);
+  ArImage_getHeight(session_, &semantic_image, &height);
+  ArImage_getWidth(session_, &confidence_image, &confidence_width);
+  ArImage_getHeight(session_, &confidence_image, &confidence_height);
+  if (width != confidence_width || height != confidence_height) {
+    LOGE("Semantic image is %dx%d but its confidence %dx%d", width, height,
+         confidence_width, confidence_height);
+    return false;
+  }
+
+  const uint8_t* label_data = nullptr;
+  const uint8_t* confidence_data = nullptr;
+  int label_size_bytes = 0;
+  int confidence_size_bytes = 0;
+  traced::ArImage_getPlaneData(session_, &semantic_image, /*plane_index=*/0,
+                               &label_data, &label_size_bytes);
+  traced::ArImage_getPlaneData(session_, &confidence_image, /*plane_index=*/0,
+                               &confidence_data, &confidence_size_bytes);
+  if (label_data == nullptr || confidence_data == nullptr || width <= 0 ||
+      height <= 0) {
+    return false;
+  }
+  int label_row_stride = 0;
+  int confidence_row_stride = 0;
+  ArImage_getPlaneRowStride(session_, &semantic_image, 0, &label_row_stride);
+  ArImage_getPlaneRowStride(session_, &confidence_image, 0,
+                            &confidence_row_stride);
+
+  if (width != width_ || height != height_) {
+    Allocate(width, height);
+  }
+
+  // The two planes are interleaved, so one lookup reads both.
+  staging_.resize(width * height * kComponentsPerTexel);
+  for (int y = 0; y < height; ++y) {
+    const uint8_t* label_row = label_data + y * label_row_stride;
+    const uint8_t* confidence_row = confidence_data + y * confidence_row_stride;
+    uint8_t* texel = staging_.data() + y * width * kComponentsPerTexel;
+    for (int x = 0; x < width; ++x) {
+      texel[0] = label_row[x];
+      texel[1] = confidence_row[x];
+      texel += kComponentsPerTexel;
+    }
+  }
+  util::GlStateCache::Get().BindTexture(GL_TEXTURE_2D, texture_);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RG,
+                  GL_UNSIGNED_BYTE, staging_.data());
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  util::CheckGlError("SemanticsPipeline::Upload()");
+  return true;
+}
+
+void SemanticsPipeline::CollectRoiCounts() {
+  // Requests finish in order, so the newest finished one is kept.
+  while (pending_count_buffers_ > 0) {
+    const int oldest = (next_count_buffer_ - pending_count_buffers_ +
+                        kNumCountBuffers) %
+                       kNumCountBuffers;
+    CountBuffer& count_buffer = count_buffers_[oldest];
+    const GLenum result =
+        glClientWaitSync(count_buffer.fence, /*flags=*/0, /*timeout=*/0);
+    if (result == GL_TIMEOUT_EXPIRED) {
+      return;
+    }
+    glDeleteSync(count_buffer.fence);
+    count_buffer.fence = nullptr;
+    --pending_count_buffers_;
+    if (result == GL_WAIT_FAILED) {
+      LOGE("SemanticsPipeline: count buffer %d fence wait failed.", oldest);
+      continue;
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, count_buffer.buffer);
+    const GLuint* counts = static_cast<const GLuint*>(
+        glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0,
+                         kNumLabels * sizeof(GLuint), GL_MAP_READ_BIT));
+    if (counts != nullptr) {
+      uint64_t total = 0;
+      for (int label = 0; label < kNumLabels; ++label) {
+        total += counts[label];
+      }
+      for (int label = 0; label < kNumLabels; ++label) {
+        roi_fractions_[label] =
+            total > 0 ? counts[label] / static_cast<float>(total) : 0.f;
+      }
+      has_roi_fractions_ = true;
+      glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  }
+}
+
+}  // namespace hello_ar
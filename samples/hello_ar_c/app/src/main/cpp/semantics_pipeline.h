@@ -0,0 +1,136 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_SEMANTICS_PIPELINE_H_
+#define C_ARCORE_HELLOE_AR_SEMANTICS_PIPELINE_H_
+
+#include <GLES3/gl3.h>
+#include <android/asset_manager.h>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "arcore_c_api.h"
+#include "frame_image_cache.h"
+#include "glm.h"
+
+namespace hello_ar {
+
+// The Scene Semantics API on the GPU, for effects such as sky replacement or
+// ground detection that need the labels at frame rate.
+//
+// Semantic images arrive at a lower rate than camera frames.  Update()
+// uploads the labels and their confidence into one RG8 texture, red holding
+// the label and green the confidence, and only when the image timestamp
+// changed since the last upload.  The whole-image label fractions are not
+// computed up front: GetLabelFraction() asks ARCore for one label the first
+// time it is called after a new image, and returns the cached value after
+// that.
+//
+// RequestRoiFractions() counts the labels inside a screen rectangle with a
+// compute shader, which needs OpenGL ES 3.1.  The counts are read back a few
+// frames later, once the GPU is done with them, so the results lag the
+// request but reading them never stalls the frame.
+//
+// All methods must be called on the OpenGL thread, which must also be the
+// thread that updates the session.
+class SemanticsPipeline {
+ public:
+  static constexpr int kNumLabels = AR_SEMANTIC_LABEL_WATER + 1;
+
+  SemanticsPipeline() = default;
+  ~SemanticsPipeline() = default;
+
+  SemanticsPipeline(const SemanticsPipeline&) = delete;
+  SemanticsPipeline& operator=(const SemanticsPipeline&) = delete;
+
+  // Initialize the GL content, needs to be called on GL thread.
+  void InitializeGlContent(AAssetManager* asset_manager);
+
+  // Uploads the semantic image of the current frame of |session| from
+  // |frame_images| unless it was uploaded already, and collects the region of
+  // interest counts the GPU finished.  Called once per frame after
+  // ArSession_update.  Returns true if a new image was uploaded.
+  bool Update(const ArSession* session, const ArFrame* frame,
+              FrameImageCache* frame_images);
+
+  // Fraction of the pixels of the latest semantic image that have |label|,
+  // or 0 before the first image.
+  float GetLabelFraction(ArSemanticLabel label);
+
+  // Counts the labels of the uploaded image inside |roi_ndc|, the min (xy) and
+  // max (zw) corners of a screen rectangle in OpenGL normalized device
+  // coordinates.  Labels below |min_confidence|, in [0, 1], are not counted.
+  // Returns false if there is no image yet, compute shaders are unavailable,
+  // or too many earlier requests are still on the GPU.
+  bool RequestRoiFractions(const glm::vec4& roi_ndc, float min_confidence);
+
+  // The label fractions of the latest request the GPU finished, over the
+  // counted pixels of its rectangle.  Returns false until one finished.
+  bool GetRoiFractions(std::array<float, kNumLabels>* fractions) const;
+
+  // RG8 texture of labels and confidences, 0 before the first image.  The
+  // texture object is replaced when the resolution changes.
+  GLuint GetTextureId() const { return texture_; }
+
+ private:
+  static constexpr int kNumCountBuffers = 3;
+
+  struct CountBuffer {
+    GLuint buffer = 0;
+    // Signalled once the counts were written, nullptr while unused.
+    GLsync fence = nullptr;
+  };
+
+  void Allocate(int width, int height);
+  // Uploads the two images of one frame.  Returns false if they do not
+  // match.
+  bool Upload(const ArImage& semantic_image, const ArImage& confidence_image);
+  // Reads back the oldest pending counts if the GPU finished them.
+  void CollectRoiCounts();
+
+  const ArSession* session_ = nullptr;
+  const ArFrame* frame_ = nullptr;
+
+  GLuint texture_ = 0;
+  int width_ = 0;
+  int height_ = 0;
+  int64_t uploaded_timestamp_ns_ = -1;
+  // The image interleaved for upload, reused from one image to the next.
+  std::vector<uint8_t> staging_;
+
+  // Label fractions of the latest image; bit i of |queried_labels_| is set
+  // once label i was queried.
+  std::array<float, kNumLabels> label_fractions_ = {};
+  uint32_t queried_labels_ = 0;
+
+  GLuint count_program_ = 0;
+  GLint uniform_semantics_ = -1;
+  GLint uniform_roi_ = -1;
+  GLint uniform_min_confidence_ = -1;
+  // A ring of count buffers; requests go to |next_count_buffer_| and are
+  // collected in the same order.
+  std::array<CountBuffer, kNumCountBuffers> count_buffers_ = {};
+  int next_count_buffer_ = 0;
+  int pending_count_buffers_ = 0;
+  std::array<float, kNumLabels> roi_fractions_ = {};
+  bool has_roi_fractions_ = false;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_SEMANTICS_PIPELINE_H_
@@ -0,0 +1,310 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "session_capture.h"
+
+#include <GLES3/gl3.h>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <chrono>
+
+#include "frame_telemetry.h"
+#include "util.h"
+
+namespace hello_ar {
+namespace {
+constexpr char kVideoMimeType[] = "video/avc";
+constexpr int32_t kFrameRate = 30;
+constexpr int32_t kIFrameIntervalSeconds = 1;
+// Bits per pixel and frame, about 12 Mbit/s for a 1080p composite.
+constexpr float kBitsPerPixel = 0.2f;
+// MediaCodecInfo.CodecCapabilities.COLOR_FormatSurface.
+constexpr int32_t kColorFormatSurface = 0x7F000789;
+constexpr int64_t kDequeueTimeoutUs = 10000;
+
+// Load the API level 26 encoder surface symbols at runtime, the sample
+// supports older devices.
+using PFAMediaCodec_createInputSurface =
+    media_status_t (*)(AMediaCodec* codec, ANativeWindow** surface);
+using PFAMediaCodec_signalEndOfInputStream =
+    media_status_t (*)(AMediaCodec* codec);
+using PFeglPresentationTimeANDROID = EGLBoolean (*)(EGLDisplay dpy,
+                                                    EGLSurface surface,
+                                                    EGLnsecsANDROID time);
+
+template <typename Function>
+Function LoadMediaNdkFunction(const char* name) {
+  void* libmediandk = dlopen("libmediandk.so", RTLD_NOW);
+  if (libmediandk == nullptr) {
+    return nullptr;
+  }
+  return reinterpret_cast<Function>(dlsym(libmediandk, name));
+}
+
+PFAMediaCodec_createInputSurface LoadCreateInputSurface() {
+  static PFAMediaCodec_createInputSurface function =
+      LoadMediaNdkFunction<PFAMediaCodec_createInputSurface>(
+          "AMediaCodec_createInputSurface");
+  return function;
+}
+
+PFAMediaCodec_signalEndOfInputStream LoadSignalEndOfInputStream() {
+  static PFAMediaCodec_signalEndOfInputStream function =
+      LoadMediaNdkFunction<PFAMediaCodec_signalEndOfInputStream>(
+          "AMediaCodec_signalEndOfInputStream");
+  return function;
+}
+
+PFeglPresentationTimeANDROID LoadPresentationTime() {
+  static PFeglPresentationTimeANDROID function =
+      reinterpret_cast<PFeglPresentationTimeANDROID>(
+          eglGetProcAddress("eglPresentationTimeANDROID"));
+  return function;
+}
+
+// Returns the config of the current context, so the encoder surface can be
+// made current with it.
+EGLConfig GetCurrentConfig(EGLDisplay display) {
+  EGLint config_id = 0;
+  eglQueryContext(display, eglGetCurrentContext(), EGL_CONFIG_ID, &config_id);
+  const EGLint attributes[] = {EGL_CONFIG_ID, config_id, EGL_NONE};
+  EGLConfig config = nullptr;
+  EGLint num_configs = 0;
+  if (!eglChooseConfig(display, attributes, &config, 1, &num_configs) ||
+      num_configs < 1) {
+    return nullptr;
+  }
+  return config;
+}
+}  // namespace
+
+SessionCapture::~SessionCapture() { Stop(); }
+
+bool SessionCapture::Start(ArSession* session, const std::string& video_path,
+                           const std::string& dataset_uri, int width,
+                           int height) {
+  Stop();
+  PFAMediaCodec_createInputSurface create_input_surface =
+      LoadCreateInputSurface();
+  if (create_input_surface == nullptr ||
+      LoadSignalEndOfInputStream() == nullptr) {
+    LOGE("SessionCapture: encoder input surfaces need API level 26");
+    return false;
+  }
+
+  // Encoders expect even dimensions.
+  width_ = width & ~1;
+  height_ = height & ~1;
+
+  AMediaFormat* format = AMediaFormat_new();
+  AMediaFormat_setString(format, AMEDIAFORMAT_KEY_MIME, kVideoMimeType);
+  AMediaFormat_setInt32(format, AMEDIAFORMAT_KEY_WIDTH, width_);
+  AMediaFormat_setInt32(format, AMEDIAFORMAT_KEY_HEIGHT, height_);
+  AMediaFormat_setInt32(format, AMEDIAFORMAT_KEY_COLOR_FORMAT,
+                        kColorFormatSurface);
+  AMediaFormat_setInt32(
+      format, AMEDIAFORMAT_KEY_BIT_RATE,
+      static_cast<int32_t>(width_ * height_ * kFrameRate * kBitsPerPixel));
+  AMediaFormat_setInt32(format, AMEDIAFORMAT_KEY_FRAME_RATE, kFrameRate);
+  AMediaFormat_setInt32(format, AMEDIAFORMAT_KEY_I_FRAME_INTERVAL,
+                        kIFrameIntervalSeconds);
+
+  codec_ = AMediaCodec_createEncoderByType(kVideoMimeType);
+  if (codec_ == nullptr ||
+      AMediaCodec_configure(codec_, format, nullptr, nullptr,
+                            AMEDIACODEC_CONFIGURE_FLAG_ENCODE) != AMEDIA_OK ||
+      create_input_surface(codec_, &input_window_) != AMEDIA_OK ||
+      AMediaCodec_start(codec_) != AMEDIA_OK) {
+    LOGE("SessionCapture: cannot set up the %dx%d encoder", width_, height_);
+    AMediaFormat_delete(format);
+    Release();
+    return false;
+  }
+  AMediaFormat_delete(format);
+
+  display_ = eglGetCurrentDisplay();
+  EGLConfig config = GetCurrentConfig(display_);
+  if (config != nullptr) {
+    encoder_surface_ =
+        eglCreateWindowSurface(display_, config, input_window_, nullptr);
+  }
+  if (encoder_surface_ == EGL_NO_SURFACE) {
+    LOGE("SessionCapture: cannot create the encoder surface: 0x%x",
+         eglGetError());
+    Release();
+    return false;
+  }
+
+  output_fd_ = open(video_path.c_str(), O_CREAT | O_WRONLY | O_TRUNC, 0644);
+  if (output_fd_ < 0) {
+    LOGE("SessionCapture: cannot open %s", video_path.c_str());
+    Release();
+    return false;
+  }
+  muxer_ = AMediaMuxer_new(output_fd_, AMEDIAMUXER_OUTPUT_FORMAT_MPEG_4);
+  if (muxer_ == nullptr) {
+    LOGE("SessionCapture: cannot create the muxer");
+    Release();
+    return false;
+  }
+
+  session_ = session;
+  if (!dataset_uri.empty()) {
+    ArRecordingConfig* recording_config = nullptr;
+    ArRecordingConfig_create(session_, &recording_config);
+    ArRecordingConfig_setMp4DatasetUri(session_, recording_config,
+                                       dataset_uri.c_str());
+    ArRecordingConfig_setAutoStopOnPause(session_, recording_config, true);
+    // The app embeds its FrameTelemetryRecords here while the log runs.
+    FrameTelemetryLog::AddTrack(session_, recording_config);
+    recording_dataset_ =
+        ArSession_startRecording(session_, recording_config) == AR_SUCCESS;
+    ArRecordingConfig_destroy(recording_config);
+    if (!recording_dataset_) {
+      LOGE("SessionCapture: cannot record the dataset to %s",
+           dataset_uri.c_str());
+    }
+  }
+
+  abort_drain_ = false;
+  drain_thread_ = std::thread(&SessionCapture::DrainEncoder, this);
+  LOGI("SessionCapture: recording %dx%d to %s", width_, height_,
+       video_path.c_str());
+  return true;
+}
+
+void SessionCapture::CaptureFrame() {
+  if (encoder_surface_ == EGL_NO_SURFACE) {
+    return;
+  }
+  const EGLSurface view_draw_surface = eglGetCurrentSurface(EGL_DRAW);
+  const EGLSurface view_read_surface = eglGetCurrentSurface(EGL_READ);
+  const EGLContext context = eglGetCurrentContext();
+  EGLint source_width = 0;
+  EGLint source_height = 0;
+  eglQuerySurface(display_, view_draw_surface, EGL_WIDTH, &source_width);
+  eglQuerySurface(display_, view_draw_surface, EGL_HEIGHT, &source_height);
+
+  // Reading from the view's back buffer and drawing into the encoder keeps
+  // the copy on the GPU.
+  if (!eglMakeCurrent(display_, encoder_surface_, view_draw_surface,
+                      context)) {
+    LOGE("SessionCapture: cannot make the encoder surface current: 0x%x",
+         eglGetError());
+    return;
+  }
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+  glBlitFramebuffer(0, 0, source_width, source_height, 0, 0, width_, height_,
+                    GL_COLOR_BUFFER_BIT, GL_LINEAR);
+  util::CheckGlError("SessionCapture::CaptureFrame() error");
+
+  PFeglPresentationTimeANDROID presentation_time = LoadPresentationTime();
+  if (presentation_time != nullptr) {
+    presentation_time(display_, encoder_surface_,
+                      std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::steady_clock::now().time_since_epoch())
+                          .count());
+  }
+  eglSwapBuffers(display_, encoder_surface_);
+
+  eglMakeCurrent(display_, view_draw_surface, view_read_surface, context);
+}
+
+void SessionCapture::Stop() {
+  if (codec_ == nullptr) {
+    return;
+  }
+  if (recording_dataset_) {
+    ArSession_stopRecording(session_);
+    recording_dataset_ = false;
+  }
+  if (drain_thread_.joinable()) {
+    if (LoadSignalEndOfInputStream()(codec_) != AMEDIA_OK) {
+      abort_drain_ = true;
+    }
+    drain_thread_.join();
+  }
+  Release();
+  LOGI("SessionCapture: recording finished");
+}
+
+void SessionCapture::DrainEncoder() {
+  ssize_t track_index = -1;
+  while (true) {
+    AMediaCodecBufferInfo info;
+    const ssize_t index =
+        AMediaCodec_dequeueOutputBuffer(codec_, &info, kDequeueTimeoutUs);
+    if (index == AMEDIACODEC_INFO_OUTPUT_FORMAT_CHANGED) {
+      AMediaFormat* format = AMediaCodec_getOutputFormat(codec_);
+      track_index = AMediaMuxer_addTrack(muxer_, format);
+      AMediaFormat_delete(format);
+      AMediaMuxer_start(muxer_);
+      continue;
+    }
+    if (index < 0) {
+      if (abort_drain_) {
+        break;
+      }
+      continue;
+    }
+
+    // The codec config is already part of the output format.
+    if (track_index >= 0 && info.size > 0 &&
+        (info.flags & AMEDIACODEC_BUFFER_FLAG_CODEC_CONFIG) == 0) {
+      size_t buffer_size = 0;
+      const uint8_t* data =
+          AMediaCodec_getOutputBuffer(codec_, index, &buffer_size);
+      AMediaMuxer_writeSampleData(muxer_, track_index, data, &info);
+    }
+    AMediaCodec_releaseOutputBuffer(codec_, index, false);
+    if ((info.flags & AMEDIACODEC_BUFFER_FLAG_END_OF_STREAM) != 0) {
+      break;
+    }
+  }
+  if (track_index >= 0) {
+    AMediaMuxer_stop(muxer_);
+  }
+}
+
+void SessionCapture::Release() {
+  if (encoder_surface_ != EGL_NO_SURFACE) {
+    eglDestroySurface(display_, encoder_surface_);
+    encoder_surface_ = EGL_NO_SURFACE;
+  }
+  if (codec_ != nullptr) {
+    AMediaCodec_stop(codec_);
+    AMediaCodec_delete(codec_);
+    codec_ = nullptr;
+  }
+  if (input_window_ != nullptr) {
+    ANativeWindow_release(input_window_);
+    input_window_ = nullptr;
+  }
+  if (muxer_ != nullptr) {
+    AMediaMuxer_delete(muxer_);
+    muxer_ = nullptr;
+  }
+  if (output_fd_ >= 0) {
+    close(output_fd_);
+    output_fd_ = -1;
+  }
+  session_ = nullptr;
+}
+
+}  // namespace hello_ar
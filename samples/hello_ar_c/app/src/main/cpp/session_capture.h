@@ -0,0 +1,99 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_SESSION_CAPTURE_H_
+#define C_ARCORE_HELLOE_AR_SESSION_CAPTURE_H_
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <android/native_window.h>
+#include <media/NdkMediaCodec.h>
+#include <media/NdkMediaMuxer.h>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+#include "arcore_c_api.h"
+
+namespace hello_ar {
+
+// Records what the user sees to an H.264 MP4 file with the hardware encoder.
+//
+// The encoder's input surface is wrapped in an EGL window surface that uses
+// the GLSurfaceView context.  After a frame has been composited, CaptureFrame()
+// makes the encoder surface the draw surface and the view's surface the read
+// surface, blits the composite once and swaps it into the encoder.  No pixels
+// are read back to the CPU; a separate thread only moves the encoded samples
+// into the muxer.
+//
+// Optionally an ARCore dataset of the same session is recorded in parallel
+// with ArSession_startRecording, so the capture can be replayed later.
+class SessionCapture {
+ public:
+  SessionCapture() = default;
+  ~SessionCapture();
+
+  SessionCapture(const SessionCapture&) = delete;
+  SessionCapture& operator=(const SessionCapture&) = delete;
+
+  // Starts encoding the |width| x |height| composite into |video_path|.  If
+  // |dataset_uri| is not empty, an ARCore recording of |session| is written
+  // there as well.  Must be called on the OpenGL thread with the GLSurfaceView
+  // context current.  Returns false if the encoder cannot be set up.
+  bool Start(ArSession* session, const std::string& video_path,
+             const std::string& dataset_uri, int width, int height);
+
+  // Blits the frame just drawn into the current draw surface to the encoder.
+  // Must be called on the OpenGL thread before the view swaps its buffers.
+  void CaptureFrame();
+
+  // Finishes the video file and the ARCore recording.  May be called from any
+  // thread while no CaptureFrame() is running.
+  void Stop();
+
+  bool IsCapturing() const { return codec_ != nullptr; }
+
+ private:
+  // Runs on drain_thread_: writes the encoder output into the muxer until the
+  // end of the stream.
+  void DrainEncoder();
+
+  void Release();
+
+  ArSession* session_ = nullptr;
+  bool recording_dataset_ = false;
+
+  AMediaCodec* codec_ = nullptr;
+  AMediaMuxer* muxer_ = nullptr;
+  int output_fd_ = -1;
+  ANativeWindow* input_window_ = nullptr;
+
+  EGLDisplay display_ = EGL_NO_DISPLAY;
+  EGLSurface encoder_surface_ = EGL_NO_SURFACE;
+  int width_ = 0;
+  int height_ = 0;
+
+  std::thread drain_thread_;
+  // Set if the end of the stream could not be signalled and the drain thread
+  // has to stop on its own.
+  std::atomic<bool> abort_drain_{false};
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_SESSION_CAPTURE_H_
@@ -0,0 +1,135 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "session_feature_policy.h"
+
+#include <cstdio>
+
+namespace hello_ar {
+
+constexpr float SessionFeaturePolicy::kResumeCoverageFraction;
+constexpr std::chrono::milliseconds
+    SessionFeaturePolicy::kPlaneEvaluationInterval;
+constexpr std::chrono::seconds SessionFeaturePolicy::kDepthIdleDelay;
+
+namespace {
+bool SearchesHorizontal(ArPlaneFindingMode mode) {
+  return mode == AR_PLANE_FINDING_MODE_HORIZONTAL ||
+         mode == AR_PLANE_FINDING_MODE_HORIZONTAL_AND_VERTICAL;
+}
+
+bool SearchesVertical(ArPlaneFindingMode mode) {
+  return mode == AR_PLANE_FINDING_MODE_VERTICAL ||
+         mode == AR_PLANE_FINDING_MODE_HORIZONTAL_AND_VERTICAL;
+}
+}  // namespace
+
+void SessionFeaturePolicy::Reset(const Options& options,
+                                 std::chrono::steady_clock::time_point now) {
+  options_ = options;
+  search_horizontal_ = SearchesHorizontal(options.plane_finding_mode);
+  search_vertical_ = SearchesVertical(options.plane_finding_mode);
+  depth_enabled_ = true;
+  last_plane_evaluation_ = now;
+  last_depth_needed_ = now;
+  horizontal_m2_ = 0.f;
+  vertical_m2_ = 0.f;
+}
+
+bool SessionFeaturePolicy::Update(const ArSession* session,
+                                  const std::vector<const ArPlane*>& planes,
+                                  bool depth_needed,
+                                  std::chrono::steady_clock::time_point now) {
+  bool changed = false;
+  if (depth_needed) {
+    last_depth_needed_ = now;
+  }
+  const bool depth_enabled =
+      depth_needed || now - last_depth_needed_ < kDepthIdleDelay;
+  if (depth_enabled != depth_enabled_) {
+    depth_enabled_ = depth_enabled;
+    ++depth_changes_;
+    changed = true;
+  }
+
+  if (now - last_plane_evaluation_ < kPlaneEvaluationInterval) {
+    return changed;
+  }
+  last_plane_evaluation_ = now;
+  MeasurePlanes(session, planes);
+  const bool search_horizontal =
+      SearchesHorizontal(options_.plane_finding_mode) &&
+      ShouldSearch(search_horizontal_, horizontal_m2_,
+                   options_.horizontal_target_m2);
+  const bool search_vertical =
+      SearchesVertical(options_.plane_finding_mode) &&
+      ShouldSearch(search_vertical_, vertical_m2_,
+                   options_.vertical_target_m2);
+  if (search_horizontal != search_horizontal_ ||
+      search_vertical != search_vertical_) {
+    search_horizontal_ = search_horizontal;
+    search_vertical_ = search_vertical;
+    ++plane_finding_changes_;
+    changed = true;
+  }
+  return changed;
+}
+
+ArPlaneFindingMode SessionFeaturePolicy::GetPlaneFindingMode() const {
+  if (search_horizontal_ && search_vertical_) {
+    return AR_PLANE_FINDING_MODE_HORIZONTAL_AND_VERTICAL;
+  }
+  if (search_horizontal_) {
+    return AR_PLANE_FINDING_MODE_HORIZONTAL;
+  }
+  return search_vertical_ ? AR_PLANE_FINDING_MODE_VERTICAL
+                          : AR_PLANE_FINDING_MODE_DISABLED;
+}
+
+std::string SessionFeaturePolicy::GetReport() const {
+  char text[160];
+  snprintf(text, sizeof(text),
+           "planes cover %.1f m2 horizontal, %.1f m2 vertical; plane finding "
+           "mode %d (%d changes), depth %s (%d changes)",
+           horizontal_m2_, vertical_m2_, GetPlaneFindingMode(),
+           plane_finding_changes_, depth_enabled_ ? "on" : "off",
+           depth_changes_);
+  return text;
+}
+
+bool SessionFeaturePolicy::ShouldSearch(bool searching, float covered_m2,
+                                        float target_m2) {
+  return searching ? covered_m2 < target_m2
+                   : covered_m2 < target_m2 * kResumeCoverageFraction;
+}
+
+void SessionFeaturePolicy::MeasurePlanes(
+    const ArSession* session, const std::vector<const ArPlane*>& planes) {
+  horizontal_m2_ = 0.f;
+  vertical_m2_ = 0.f;
+  for (const ArPlane* plane : planes) {
+    ArPlaneType type = AR_PLANE_HORIZONTAL_UPWARD_FACING;
+    ArPlane_getType(session, plane, &type);
+    float extent_x = 0.f;
+    float extent_z = 0.f;
+    ArPlane_getExtentX(session, plane, &extent_x);
+    ArPlane_getExtentZ(session, plane, &extent_z);
+    (type == AR_PLANE_VERTICAL ? vertical_m2_ : horizontal_m2_) +=
+        extent_x * extent_z;
+  }
+}
+
+}  // namespace hello_ar
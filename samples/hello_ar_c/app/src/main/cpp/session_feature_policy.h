@@ -0,0 +1,104 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_SESSION_FEATURE_POLICY_H_
+#define C_ARCORE_HELLOE_AR_SESSION_FEATURE_POLICY_H_
+
+#include <chrono>  // NOLINT
+#include <string>
+#include <vector>
+
+#include "arcore_c_api.h"
+
+namespace hello_ar {
+
+// Turns plane finding and depth off while the app does not need them, since
+// both cost ARCore CPU time every frame.
+//
+// Plane finding stops for an orientation once the tracked planes of that
+// orientation cover its target area, e.g. AR_PLANE_FINDING_MODE_HORIZONTAL
+// becomes AR_PLANE_FINDING_MODE_DISABLED once the floor and tables found
+// cover the horizontal target.  Found planes keep tracking without it.  The
+// search resumes if the covered area drops below kResumeCoverageFraction of
+// the target, e.g. after planes were subsumed or lost.  The area of a plane
+// is its extent rectangle, which overestimates irregular polygons a little.
+// The planes are only measured every kPlaneEvaluationInterval.
+//
+// Depth turns on as soon as a frame needs it and off once no frame needed it
+// for kDepthIdleDelay, so it does not flicker while content goes in and out
+// of view.  ARCore needs a few frames to produce depth again afterwards.
+//
+// Update() only decides; the caller reconfigures the session when it
+// returns true.  Not thread safe; meant to be used on the thread that
+// updates the session.
+class SessionFeaturePolicy {
+ public:
+  static constexpr float kResumeCoverageFraction = 0.5f;
+  static constexpr std::chrono::milliseconds kPlaneEvaluationInterval{500};
+  static constexpr std::chrono::seconds kDepthIdleDelay{3};
+
+  struct Options {
+    // What the session searches for while coverage is missing.
+    ArPlaneFindingMode plane_finding_mode = AR_PLANE_FINDING_MODE_HORIZONTAL;
+    // Tracked area in square meters after which the search stops.
+    float horizontal_target_m2 = 6.f;
+    float vertical_target_m2 = 4.f;
+  };
+
+  SessionFeaturePolicy() = default;
+
+  // Starts over for a new session: searches with |options| and keeps depth
+  // on until it has been unneeded for kDepthIdleDelay.
+  void Reset(const Options& options,
+             std::chrono::steady_clock::time_point now);
+
+  // Measures |planes|, the tracking planes that are not subsumed, and
+  // records whether the current frame needs depth.  Returns true if
+  // GetPlaneFindingMode() or IsDepthEnabled() changed.
+  bool Update(const ArSession* session,
+              const std::vector<const ArPlane*>& planes, bool depth_needed,
+              std::chrono::steady_clock::time_point now);
+
+  ArPlaneFindingMode GetPlaneFindingMode() const;
+  bool IsDepthEnabled() const { return depth_enabled_; }
+
+  // The covered areas, the current decisions and how often they changed.
+  std::string GetReport() const;
+
+ private:
+  // Whether the search for an orientation with |target_m2| continues, with
+  // hysteresis around the target.
+  static bool ShouldSearch(bool searching, float covered_m2, float target_m2);
+
+  void MeasurePlanes(const ArSession* session,
+                     const std::vector<const ArPlane*>& planes);
+
+  Options options_;
+  bool search_horizontal_ = false;
+  bool search_vertical_ = false;
+  bool depth_enabled_ = true;
+  std::chrono::steady_clock::time_point last_plane_evaluation_;
+  std::chrono::steady_clock::time_point last_depth_needed_;
+
+  float horizontal_m2_ = 0.f;
+  float vertical_m2_ = 0.f;
+  int plane_finding_changes_ = 0;
+  int depth_changes_ = 0;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_SESSION_FEATURE_POLICY_H_
@@ -0,0 +1,128 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "session_starter.h"
+
+#include <cstdio>
+
+#include "jni_interface.h"
+#include "util.h"
+
+namespace hello_ar {
+
+namespace {
+float ToMilliseconds(std::chrono::steady_clock::duration duration) {
+  return std::chrono::duration<float, std::milli>(duration).count();
+}
+}  // namespace
+
+SessionStarter::~SessionStarter() {
+  Wait();
+  if (session_ != nullptr) {
+    ArSession_destroy(session_);
+  }
+}
+
+bool SessionStarter::Start(JNIEnv* env, jobject context,
+                           Configure configure) {
+  const State state = GetState();
+  if (state != State::kIdle && state != State::kFailed) {
+    return false;
+  }
+  Wait();
+  failure_ = AR_SUCCESS;
+  create_time_ = configure_time_ = resume_time_ = {};
+  state_.store(State::kCreating, std::memory_order_release);
+  // The local reference is only valid on the calling thread.
+  jobject global_context = env->NewGlobalRef(context);
+  worker_ = std::thread(&SessionStarter::Run, this, global_context,
+                        std::move(configure));
+  return true;
+}
+
+ArSession* SessionStarter::TakeSession() {
+  if (GetState() != State::kResumed) {
+    return nullptr;
+  }
+  Wait();
+  ArSession* session = session_;
+  session_ = nullptr;
+  state_.store(State::kIdle, std::memory_order_release);
+  return session;
+}
+
+void SessionStarter::Wait() {
+  if (worker_.joinable()) {
+    worker_.join();
+  }
+}
+
+std::string SessionStarter::GetReport() const {
+  char text[96];
+  snprintf(text, sizeof(text),
+           "create %.1f ms, configure %.1f ms, resume %.1f ms",
+           ToMilliseconds(create_time_), ToMilliseconds(configure_time_),
+           ToMilliseconds(resume_time_));
+  return text;
+}
+
+void SessionStarter::Run(jobject context, Configure configure) {
+  JNIEnv* env = GetJniEnv();
+  auto start = std::chrono::steady_clock::now();
+  ArSession* session = nullptr;
+  const ArStatus create_status = ArSession_create(env, context, &session);
+  env->DeleteGlobalRef(context);
+  create_time_ = std::chrono::steady_clock::now() - start;
+  if (create_status != AR_SUCCESS) {
+    LOGE("SessionStarter: ArSession_create failed: %d", create_status);
+    DetachJniEnv();
+    Fail(create_status);
+    return;
+  }
+
+  state_.store(State::kConfiguring, std::memory_order_release);
+  start = std::chrono::steady_clock::now();
+  const bool configured = configure(session);
+  configure_time_ = std::chrono::steady_clock::now() - start;
+  if (!configured) {
+    ArSession_destroy(session);
+    DetachJniEnv();
+    Fail(AR_ERROR_FATAL);
+    return;
+  }
+
+  state_.store(State::kResuming, std::memory_order_release);
+  start = std::chrono::steady_clock::now();
+  const ArStatus resume_status = ArSession_resume(session);
+  resume_time_ = std::chrono::steady_clock::now() - start;
+  DetachJniEnv();
+  if (resume_status != AR_SUCCESS) {
+    LOGE("SessionStarter: ArSession_resume failed: %d", resume_status);
+    ArSession_destroy(session);
+    Fail(resume_status);
+    return;
+  }
+  session_ = session;
+  LOGI("SessionStarter: %s", GetReport().c_str());
+  state_.store(State::kResumed, std::memory_order_release);
+}
+
+void SessionStarter::Fail(ArStatus status) {
+  failure_ = status;
+  state_.store(State::kFailed, std::memory_order_release);
+}
+
+}  // namespace hello_ar
@@ -0,0 +1,104 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_SESSION_STARTER_H_
+#define C_ARCORE_HELLOE_AR_SESSION_STARTER_H_
+
+#include <jni.h>
+
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <functional>
+#include <string>
+#include <thread>  // NOLINT
+
+#include "arcore_c_api.h"
+
+namespace hello_ar {
+
+// Creates, configures and resumes an ARCore session on a worker thread, so
+// the UI thread returns from onResume right away and the OpenGL thread
+// creates the surface and loads assets meanwhile.
+//
+// Start() launches the worker, which steps through kCreating, kConfiguring
+// and kResuming and ends in kResumed or kFailed.  The thread that draws
+// polls GetState() and takes the session with TakeSession() once it is
+// kResumed.  Until then the session belongs to the worker, and the
+// Configure callback may set up whatever belongs with the session as long
+// as nothing else touches it before TakeSession().
+//
+// ArCoreApk_requestInstall stays with the caller, since it may start an
+// activity and needs the UI thread.
+class SessionStarter {
+ public:
+  enum class State {
+    kIdle,
+    kCreating,
+    kConfiguring,
+    kResuming,
+    kResumed,
+    kFailed,
+  };
+
+  // Runs on the worker between ArSession_create and ArSession_resume.
+  // Returns false if the session cannot be used, which fails the start.
+  using Configure = std::function<bool(ArSession* session)>;
+
+  SessionStarter() = default;
+  // Waits for the worker and destroys a session nobody took.
+  ~SessionStarter();
+
+  SessionStarter(const SessionStarter&) = delete;
+  SessionStarter& operator=(const SessionStarter&) = delete;
+
+  // Starts bringing up a session for the Android |context| with |env| of
+  // the calling thread.  Returns false if a start is still in progress or
+  // its session was not taken yet.
+  bool Start(JNIEnv* env, jobject context, Configure configure);
+
+  State GetState() const { return state_.load(std::memory_order_acquire); }
+
+  // The resumed session, whose ownership passes to the caller, or nullptr
+  // unless GetState() is kResumed.  Goes back to kIdle.
+  ArSession* TakeSession();
+
+  // Blocks until the worker is done, e.g. before the session would be
+  // paused.
+  void Wait();
+
+  // The error of ARCore that failed the last start, AR_SUCCESS otherwise.
+  ArStatus GetFailure() const { return failure_; }
+
+  // How long each step of the last start took.
+  std::string GetReport() const;
+
+ private:
+  void Run(jobject context, Configure configure);
+  void Fail(ArStatus status);
+
+  std::thread worker_;
+  std::atomic<State> state_{State::kIdle};
+  // Written by the worker before it publishes kResumed or kFailed.
+  ArSession* session_ = nullptr;
+  ArStatus failure_ = AR_SUCCESS;
+  std::chrono::steady_clock::duration create_time_{};
+  std::chrono::steady_clock::duration configure_time_{};
+  std::chrono::steady_clock::duration resume_time_{};
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_SESSION_STARTER_H_
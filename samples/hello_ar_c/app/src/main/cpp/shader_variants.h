@@ -0,0 +1,137 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_SHADER_VARIANTS_H_
+#define C_ARCORE_HELLOE_AR_SHADER_VARIANTS_H_
+
+#include <cstddef>
+
+namespace hello_ar {
+
+// Every program the renderers use.  Each one is a pair of shader files and a
+// fixed set of #define values, so the set of programs is known when the app
+// is built instead of growing with the defines passed at runtime.
+enum class ShaderVariant {
+  kCamera = 0,
+  kDepthVisualizer,
+  kDepthPyramid,
+  kObject,
+  kObjectPerFragmentOcclusion,
+  kObjectMaskOcclusion,
+  kOcclusionDepth,
+  kOcclusionResolve,
+  kPlane,
+  kPlaneBatched,
+  kPointCloud,
+  kDensePointCloud,
+  kTsdfMesh,
+  kVirtualContent,
+  kPerformanceHud,
+  kStreetscapeGeometry,
+  kFaceMesh,
+  kEisCamera,
+  kObjectBatched,
+  kOcclusionBlur,
+  kTemporalDepth,
+  kSkinnedObject,
+  kCount
+};
+
+constexpr int kShaderVariantCount = static_cast<int>(ShaderVariant::kCount);
+
+struct ShaderVariantInfo {
+  ShaderVariant variant;
+  const char* vertex_shader_file_name;
+  const char* fragment_shader_file_name;
+  // Prepended to both shaders as is, one "#define NAME VALUE" per line.
+  const char* defines;
+};
+
+// Indexed by ShaderVariant.  The defines of a variant are listed sorted by
+// name, which keeps the binaries persisted by the program cache valid.
+inline constexpr ShaderVariantInfo kShaderVariants[] = {
+    {ShaderVariant::kCamera, "shaders/screenquad.vert",
+     "shaders/screenquad.frag", ""},
+    {ShaderVariant::kDepthVisualizer,
+     "shaders/background_show_depth_color_visualization.vert",
+     "shaders/background_show_depth_color_visualization.frag", ""},
+    {ShaderVariant::kDepthPyramid, "shaders/depth_pyramid.vert",
+     "shaders/depth_pyramid.frag", ""},
+    {ShaderVariant::kObject, "shaders/ar_object.vert",
+     "shaders/ar_object.frag",
+     "#define USE_DEPTH_FOR_OCCLUSION 0\n#define USE_OCCLUSION_MASK 0\n"},
+    {ShaderVariant::kObjectPerFragmentOcclusion, "shaders/ar_object.vert",
+     "shaders/ar_object.frag",
+     "#define USE_DEPTH_FOR_OCCLUSION 1\n#define USE_OCCLUSION_MASK 0\n"},
+    {ShaderVariant::kObjectMaskOcclusion, "shaders/ar_object.vert",
+     "shaders/ar_object.frag",
+     "#define USE_DEPTH_FOR_OCCLUSION 0\n#define USE_OCCLUSION_MASK 1\n"},
+    {ShaderVariant::kOcclusionDepth, "shaders/occlusion_depth.vert",
+     "shaders/occlusion_depth.frag", ""},
+    {ShaderVariant::kOcclusionResolve, "shaders/screenquad.vert",
+     "shaders/occlusion_mask.frag", ""},
+    {ShaderVariant::kPlane, "shaders/plane.vert", "shaders/plane.frag",
+     "#define PLANE_BATCHED 0\n"},
+    {ShaderVariant::kPlaneBatched, "shaders/plane.vert", "shaders/plane.frag",
+     "#define PLANE_BATCHED 1\n"},
+    {ShaderVariant::kPointCloud, "shaders/point_cloud.vert",
+     "shaders/point_cloud.frag", ""},
+    {ShaderVariant::kDensePointCloud, "shaders/dense_point_cloud.vert",
+     "shaders/dense_point_cloud.frag", ""},
+    {ShaderVariant::kTsdfMesh, "shaders/tsdf_mesh.vert",
+     "shaders/tsdf_mesh.frag", ""},
+    {ShaderVariant::kVirtualContent, "shaders/virtual_content.vert",
+     "shaders/virtual_content.frag", ""},
+    {ShaderVariant::kPerformanceHud, "shaders/performance_hud.vert",
+     "shaders/performance_hud.frag", ""},
+    {ShaderVariant::kStreetscapeGeometry, "shaders/streetscape_geometry.vert",
+     "shaders/streetscape_geometry.frag", ""},
+    {ShaderVariant::kFaceMesh, "shaders/face_mesh.vert",
+     "shaders/face_mesh.frag", ""},
+    {ShaderVariant::kEisCamera, "shaders/eis_camera.vert",
+     "shaders/eis_camera.frag", ""},
+    {ShaderVariant::kObjectBatched, "shaders/ar_object_batched.vert",
+     "shaders/ar_object_batched.frag", ""},
+    {ShaderVariant::kOcclusionBlur, "shaders/depth_pyramid.vert",
+     "shaders/occlusion_blur.frag", ""},
+    {ShaderVariant::kTemporalDepth, "shaders/depth_pyramid.vert",
+     "shaders/temporal_depth.frag", ""},
+    {ShaderVariant::kSkinnedObject, "shaders/skinned_object.vert",
+     "shaders/skinned_object.frag", ""},
+};
+
+constexpr bool AreShaderVariantsInOrder() {
+  for (int i = 0; i < kShaderVariantCount; ++i) {
+    if (static_cast<int>(kShaderVariants[i].variant) != i) {
+      return false;
+    }
+  }
+  return true;
+}
+static_assert(sizeof(kShaderVariants) / sizeof(kShaderVariants[0]) ==
+                  static_cast<size_t>(kShaderVariantCount),
+              "kShaderVariants needs one entry per ShaderVariant");
+static_assert(AreShaderVariantsInOrder(),
+              "kShaderVariants must be indexed by ShaderVariant");
+
+constexpr const ShaderVariantInfo& GetShaderVariantInfo(
+    ShaderVariant variant) {
+  return kShaderVariants[static_cast<int>(variant)];
+}
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_SHADER_VARIANTS_H_
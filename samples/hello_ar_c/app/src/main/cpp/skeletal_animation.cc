@@ -0,0 +1,73 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "skeletal_animation.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "util.h"
+
+namespace hello_ar {
+
+void SampleAnimation(const Skeleton& skeleton, const AnimationClip& clip,
+                     float time_s, glm::mat4* world_scratch,
+                     float* out_palette) {
+  const int joint_count = skeleton.GetJointCount();
+  // The clips end on the first frame again, so looping wraps to it.
+  float frame = 0.0f;
+  if (clip.duration_s > 0.0f && clip.frame_count > 1) {
+    float loop_time = std::fmod(time_s, clip.duration_s);
+    if (loop_time < 0.0f) {
+      loop_time += clip.duration_s;
+    }
+    frame = std::fmin(loop_time * clip.sample_rate,
+                      static_cast<float>(clip.frame_count - 1));
+  }
+  const int lower = static_cast<int>(frame);
+  const int upper = std::min(lower + 1, clip.frame_count - 1);
+  const float t = frame - static_cast<float>(lower);
+  const JointPose* lower_poses = &clip.poses[lower * joint_count];
+  const JointPose* upper_poses = &clip.poses[upper * joint_count];
+
+  for (int joint = 0; joint < joint_count; ++joint) {
+    const JointPose& a = lower_poses[joint];
+    const JointPose& b = upper_poses[joint];
+    const glm::vec3 translation = glm::mix(a.translation, b.translation, t);
+    const glm::quat rotation = glm::slerp(a.rotation, b.rotation, t);
+    const glm::vec3 scale = glm::mix(a.scale, b.scale, t);
+
+    glm::mat4 local = glm::mat4_cast(rotation);
+    local[0] *= scale.x;
+    local[1] *= scale.y;
+    local[2] *= scale.z;
+    local[3] = glm::vec4(translation, 1.0f);
+    const int parent = skeleton.parents[joint];
+    world_scratch[joint] = util::MultiplyMatrices(
+        parent < 0 ? skeleton.root_matrix : world_scratch[parent], local);
+
+    const glm::mat4 skinning = util::MultiplyMatrices(
+        world_scratch[joint], skeleton.inverse_bind_matrices[joint]);
+    float* rows = out_palette + joint * kJointPaletteFloats;
+    for (int row = 0; row < 3; ++row) {
+      for (int column = 0; column < 4; ++column) {
+        rows[row * 4 + column] = skinning[column][row];
+      }
+    }
+  }
+}
+
+}  // namespace hello_ar
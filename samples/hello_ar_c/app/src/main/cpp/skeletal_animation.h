@@ -0,0 +1,69 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_SKELETAL_ANIMATION_H_
+#define C_ARCORE_HELLOE_AR_SKELETAL_ANIMATION_H_
+
+#include <vector>
+
+#include "glm.h"
+
+namespace hello_ar {
+
+// Pose of a joint relative to its parent.
+struct JointPose {
+  glm::vec3 translation = glm::vec3(0.0f);
+  glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+  glm::vec3 scale = glm::vec3(1.0f);
+};
+
+struct Skeleton {
+  // Parent of each joint, -1 for the roots.  Parents come before their
+  // children, so a single pass over the joints composes their transforms.
+  std::vector<int> parents;
+  // Model space to joint space in the bind pose, per joint.
+  std::vector<glm::mat4> inverse_bind_matrices;
+  // Parent transform of the roots, that of the nodes above the skeleton.
+  glm::mat4 root_matrix = glm::mat4(1.0f);
+
+  int GetJointCount() const { return static_cast<int>(parents.size()); }
+};
+
+// Joint poses resampled at a fixed rate, as written by
+// tools/gltf_to_skinned_mesh.py.
+struct AnimationClip {
+  float duration_s = 0.0f;
+  float sample_rate = 30.0f;
+  int frame_count = 0;
+  // |frame_count| frames of one JointPose per joint each.
+  std::vector<JointPose> poses;
+};
+
+// Floats SampleAnimation() writes per joint: the top three rows of its
+// skinning matrix, whose bottom row is always (0, 0, 0, 1).
+constexpr int kJointPaletteFloats = 12;
+
+// Samples |clip| at |time_s|, looped over its duration, blending the two
+// nearest frames, and writes kJointPaletteFloats per joint of |skeleton| to
+// |out_palette|: the matrix from the bind pose to the pose in model space.
+// |world_scratch| must hold one matrix per joint.  Thread safe.
+void SampleAnimation(const Skeleton& skeleton, const AnimationClip& clip,
+                     float time_s, glm::mat4* world_scratch,
+                     float* out_palette);
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_SKELETAL_ANIMATION_H_
@@ -0,0 +1,447 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "skinned_obj_renderer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include "job_system.h"
+#include "resource_accounting.h"
+#include "util.h"
+
+namespace hello_ar {
+namespace {
+constexpr char kOwner[] = "SkinnedObjRenderer";
+const glm::vec4 kLightDirection(0.0f, 1.0f, 0.0f, 0.0f);
+
+constexpr uint32_t kSkinnedMeshFileVersion = 3;
+
+// Header of the version 3 meshes of tools/gltf_to_skinned_mesh.py, that of
+// version 2 followed by the skeleton and clip sections.
+struct SkinnedMeshFileHeader {
+  util::MeshFileHeader mesh;
+  uint32_t joint_count;
+  uint32_t clip_count;
+  uint32_t skeleton_data_offset;
+  uint32_t clip_data_offset;
+};
+static_assert(sizeof(SkinnedMeshFileHeader) == 88,
+              "SkinnedMeshFileHeader must match the file layout");
+
+// A util::QuantizedVertex with its joint influences.
+struct SkinnedVertex {
+  util::QuantizedVertex vertex;
+  uint8_t joints[4];
+  // Unsigned normalized, summing to 255.
+  uint8_t weights[4];
+};
+
+constexpr GLsizei kVertexStride = sizeof(SkinnedVertex);
+constexpr size_t kNormalOffset =
+    offsetof(SkinnedVertex, vertex) + offsetof(util::QuantizedVertex, normal);
+constexpr size_t kUvOffset =
+    offsetof(SkinnedVertex, vertex) + offsetof(util::QuantizedVertex, uv);
+constexpr size_t kJointsOffset = offsetof(SkinnedVertex, joints);
+constexpr size_t kWeightsOffset = offsetof(SkinnedVertex, weights);
+
+// A joint record of the skeleton section: the parent and the inverse bind
+// matrix.
+constexpr size_t kJointRecordSize = sizeof(int32_t) + 16 * sizeof(float);
+// Duration, sample rate and frame count of a clip.
+constexpr size_t kClipHeaderSize = 2 * sizeof(float) + sizeof(uint32_t);
+// Translation, rotation (x, y, z, w) and scale of a joint in a frame.
+constexpr size_t kPoseFloats = 10;
+
+// RGBA32F texels per joint, one per row of its skinning matrix.
+constexpr int kTexelsPerJoint = kJointPaletteFloats / 4;
+
+// A mat4 attribute occupies four consecutive vec4 attribute locations.
+constexpr int kMatrixColumns = 4;
+
+// Reads consecutive floats from the unaligned |data|.
+const uint8_t* ReadFloats(const uint8_t* data, float* out, size_t count) {
+  memcpy(out, data, count * sizeof(float));
+  return data + count * sizeof(float);
+}
+}  // namespace
+
+constexpr int SkinnedObjRenderer::kMaxJoints;
+constexpr int SkinnedObjRenderer::kMaxInstancesPerDraw;
+constexpr int SkinnedObjRenderer::kPaletteTextureCount;
+constexpr int SkinnedObjRenderer::kInstancesPerJob;
+
+bool SkinnedObjRenderer::InitializeGlContent(AAssetManager* asset_manager,
+                                             const std::string& mesh_file_name,
+                                             const std::string& png_file_name) {
+  shader_program_ =
+      util::CreateProgram(ShaderVariant::kSkinnedObject, asset_manager);
+  if (!shader_program_) {
+    LOGE("Could not create program.");
+  }
+  position_attrib_ = glGetAttribLocation(shader_program_, "a_Position");
+  normal_attrib_ = glGetAttribLocation(shader_program_, "a_Normal");
+  tex_coord_attrib_ = glGetAttribLocation(shader_program_, "a_TexCoord");
+  joints_attrib_ = glGetAttribLocation(shader_program_, "a_Joints");
+  weights_attrib_ = glGetAttribLocation(shader_program_, "a_Weights");
+  model_mat_attrib_ = glGetAttribLocation(shader_program_, "a_ModelMatrix");
+  color_attrib_ = glGetAttribLocation(shader_program_, "a_ObjColor");
+  view_mat_uniform_ = glGetUniformLocation(shader_program_, "u_View");
+  projection_mat_uniform_ =
+      glGetUniformLocation(shader_program_, "u_Projection");
+  position_offset_uniform_ =
+      glGetUniformLocation(shader_program_, "u_PositionOffset");
+  position_scale_uniform_ =
+      glGetUniformLocation(shader_program_, "u_PositionScale");
+  texture_uniform_ = glGetUniformLocation(shader_program_, "u_Texture");
+  joint_palette_uniform_ =
+      glGetUniformLocation(shader_program_, "u_JointPalette");
+  light_direction_uniform_ =
+      glGetUniformLocation(shader_program_, "u_LightDirection");
+  material_param_uniform_ =
+      glGetUniformLocation(shader_program_, "u_MaterialParameters");
+  color_correction_param_uniform_ =
+      glGetUniformLocation(shader_program_, "u_ColorCorrectionParameters");
+
+  // Objects of a previous context are gone with it.
+  index_count_ = 0;
+  instances_.clear();
+  glGenVertexArrays(1, &vertex_array_);
+  glGenBuffers(1, &vertex_buffer_);
+  glGenBuffers(1, &index_buffer_);
+  glGenBuffers(1, &instance_buffer_);
+  if (!LoadMesh(asset_manager, mesh_file_name)) {
+    index_count_ = 0;
+    return false;
+  }
+  texture_id_ = util::TextureCache::Get().Acquire(
+      png_file_name.c_str(), GL_REPEAT, GL_LINEAR_MIPMAP_NEAREST);
+
+  const int palette_width = skeleton_.GetJointCount() * kTexelsPerJoint;
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
+  glGenTextures(kPaletteTextureCount, palette_textures_.data());
+  for (GLuint texture : palette_textures_) {
+    gl_state.BindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, palette_width,
+                 kMaxInstancesPerDraw, 0, GL_RGBA, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    ResourceAccounting::Get().Track(
+        GpuResourceType::kTexture, texture,
+        static_cast<size_t>(palette_width) * kMaxInstancesPerDraw * 4 *
+            sizeof(float),
+        kOwner);
+  }
+  gl_state.BindTexture(GL_TEXTURE_2D, 0);
+  next_palette_texture_ = 0;
+  util::CheckGlError("SkinnedObjRenderer::InitializeGlContent()");
+  return true;
+}
+
+bool SkinnedObjRenderer::LoadMesh(AAssetManager* asset_manager,
+                                  const std::string& file_name) {
+  AAsset* asset =
+      AAssetManager_open(asset_manager, file_name.c_str(), AASSET_MODE_BUFFER);
+  if (asset == nullptr) {
+    LOGE("Error opening asset %s", file_name.c_str());
+    return false;
+  }
+  const uint8_t* data = static_cast<const uint8_t*>(AAsset_getBuffer(asset));
+  const size_t length = static_cast<size_t>(AAsset_getLength(asset));
+  SkinnedMeshFileHeader header;
+  if (data == nullptr || length < sizeof(header)) {
+    LOGE("Could not map skinned mesh %s", file_name.c_str());
+    AAsset_close(asset);
+    return false;
+  }
+  memcpy(&header, data, sizeof(header));
+
+  const util::MeshFileHeader& mesh = header.mesh;
+  const uint64_t vertex_bytes =
+      static_cast<uint64_t>(mesh.vertex_count) * mesh.vertex_stride;
+  const uint64_t index_bytes =
+      static_cast<uint64_t>(mesh.index_count) * mesh.index_size;
+  const uint64_t skeleton_bytes =
+      16 * sizeof(float) +
+      static_cast<uint64_t>(header.joint_count) * kJointRecordSize;
+  if (memcmp(mesh.magic, "ARMS", sizeof(mesh.magic)) != 0 ||
+      mesh.version != kSkinnedMeshFileVersion ||
+      mesh.vertex_stride != kVertexStride ||
+      (mesh.index_size != 2 && mesh.index_size != 4) ||
+      header.joint_count == 0 || header.joint_count > kMaxJoints ||
+      header.clip_count == 0 ||
+      mesh.vertex_data_offset + vertex_bytes > length ||
+      mesh.index_data_offset + index_bytes > length ||
+      header.skeleton_data_offset + skeleton_bytes > length ||
+      header.clip_data_offset > length) {
+    LOGE("Skinned mesh %s is malformed or has an unsupported version",
+         file_name.c_str());
+    AAsset_close(asset);
+    return false;
+  }
+
+  // Skeleton.
+  const int joint_count = static_cast<int>(header.joint_count);
+  const uint8_t* cursor = data + header.skeleton_data_offset;
+  cursor = ReadFloats(cursor, glm::value_ptr(skeleton_.root_matrix), 16);
+  skeleton_.parents.resize(joint_count);
+  skeleton_.inverse_bind_matrices.resize(joint_count);
+  for (int joint = 0; joint < joint_count; ++joint) {
+    int32_t parent = 0;
+    memcpy(&parent, cursor, sizeof(parent));
+    cursor += sizeof(parent);
+    cursor = ReadFloats(
+        cursor, glm::value_ptr(skeleton_.inverse_bind_matrices[joint]), 16);
+    if (parent >= joint) {
+      LOGE("Skinned mesh %s lists a joint before its parent",
+           file_name.c_str());
+      AAsset_close(asset);
+      return false;
+    }
+    skeleton_.parents[joint] = parent < 0 ? -1 : parent;
+  }
+
+  // Clips.
+  clips_.clear();
+  cursor = data + header.clip_data_offset;
+  const uint8_t* end = data + length;
+  for (uint32_t i = 0; i < header.clip_count; ++i) {
+    AnimationClip clip;
+    uint32_t frame_count = 0;
+    if (static_cast<size_t>(end - cursor) < kClipHeaderSize) {
+      break;
+    }
+    cursor = ReadFloats(cursor, &clip.duration_s, 1);
+    cursor = ReadFloats(cursor, &clip.sample_rate, 1);
+    memcpy(&frame_count, cursor, sizeof(frame_count));
+    cursor += sizeof(frame_count);
+    const uint64_t pose_count =
+        static_cast<uint64_t>(frame_count) * joint_count;
+    if (frame_count == 0 ||
+        static_cast<uint64_t>(end - cursor) <
+            pose_count * kPoseFloats * sizeof(float)) {
+      break;
+    }
+    clip.frame_count = static_cast<int>(frame_count);
+    clip.poses.resize(pose_count);
+    for (JointPose& pose : clip.poses) {
+      float values[kPoseFloats];
+      cursor = ReadFloats(cursor, values, kPoseFloats);
+      pose.translation = glm::make_vec3(values);
+      // glm::quat takes w first.
+      pose.rotation = glm::quat(values[6], values[3], values[4], values[5]);
+      pose.scale = glm::make_vec3(values + 7);
+    }
+    clips_.push_back(std::move(clip));
+  }
+  if (clips_.size() != header.clip_count) {
+    LOGE("Skinned mesh %s has truncated clips", file_name.c_str());
+    AAsset_close(asset);
+    return false;
+  }
+
+  bounding_sphere_ = glm::make_vec4(mesh.bounding_sphere);
+  position_offset_ = glm::make_vec3(mesh.position_offset);
+  position_scale_ = glm::make_vec3(mesh.position_scale);
+  index_count_ = static_cast<GLsizei>(mesh.index_count);
+  index_type_ = mesh.index_size == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
+  gl_state.BindVertexArray(vertex_array_);
+  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+  glBufferData(GL_ARRAY_BUFFER, vertex_bytes, data + mesh.vertex_data_offset,
+               GL_STATIC_DRAW);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_bytes,
+               data + mesh.index_data_offset, GL_STATIC_DRAW);
+  AAsset_close(asset);
+  ResourceAccounting& accounting = ResourceAccounting::Get();
+  accounting.Track(GpuResourceType::kBuffer, vertex_buffer_, vertex_bytes,
+                   kOwner);
+  accounting.Track(GpuResourceType::kBuffer, index_buffer_, index_bytes,
+                   kOwner);
+
+  glEnableVertexAttribArray(position_attrib_);
+  glVertexAttribPointer(position_attrib_, 4, GL_UNSIGNED_SHORT, GL_TRUE,
+                        kVertexStride, nullptr);
+  glEnableVertexAttribArray(normal_attrib_);
+  glVertexAttribPointer(normal_attrib_, 2, GL_SHORT, GL_TRUE, kVertexStride,
+                        reinterpret_cast<const void*>(kNormalOffset));
+  glEnableVertexAttribArray(tex_coord_attrib_);
+  glVertexAttribPointer(tex_coord_attrib_, 2, GL_HALF_FLOAT, GL_FALSE,
+                        kVertexStride,
+                        reinterpret_cast<const void*>(kUvOffset));
+  // The joint indices stay integers to address the palette.
+  glEnableVertexAttribArray(joints_attrib_);
+  glVertexAttribIPointer(joints_attrib_, 4, GL_UNSIGNED_BYTE, kVertexStride,
+                         reinterpret_cast<const void*>(kJointsOffset));
+  glEnableVertexAttribArray(weights_attrib_);
+  glVertexAttribPointer(weights_attrib_, 4, GL_UNSIGNED_BYTE, GL_TRUE,
+                        kVertexStride,
+                        reinterpret_cast<const void*>(kWeightsOffset));
+
+  // The instanced attributes advance once per drawn copy; their pointers
+  // are set for every draw by SetInstanceAttributes().
+  for (int column = 0; column < kMatrixColumns; ++column) {
+    glEnableVertexAttribArray(model_mat_attrib_ + column);
+    glVertexAttribDivisor(model_mat_attrib_ + column, 1);
+  }
+  glEnableVertexAttribArray(color_attrib_);
+  glVertexAttribDivisor(color_attrib_, 1);
+
+  gl_state.BindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  LOGI("Skinned mesh %s: %u vertices, %d joints, %zu clips", file_name.c_str(),
+       mesh.vertex_count, joint_count, clips_.size());
+  return true;
+}
+
+void SkinnedObjRenderer::SetMaterialProperty(float ambient, float diffuse,
+                                             float specular,
+                                             float specular_power) {
+  ambient_ = ambient;
+  diffuse_ = diffuse;
+  specular_ = specular;
+  specular_power_ = specular_power;
+}
+
+void SkinnedObjRenderer::SampleAnimations(const Instance* instances,
+                                          size_t instance_count) {
+  instances_.clear();
+  if (!IsLoaded()) {
+    return;
+  }
+  const int joint_count = skeleton_.GetJointCount();
+  const size_t palette_floats =
+      static_cast<size_t>(joint_count) * kJointPaletteFloats;
+  instances_.resize(instance_count);
+  palettes_.resize(instance_count * palette_floats);
+  for (size_t i = 0; i < instance_count; ++i) {
+    instances_[i].model_mat = instances[i].model_mat;
+    instances_[i].color = instances[i].color;
+  }
+
+  // Every job samples kInstancesPerJob consecutive copies with a scratch
+  // buffer of its own.
+  const size_t job_count =
+      (instance_count + kInstancesPerJob - 1) / kInstancesPerJob;
+  if (world_scratch_.size() < job_count) {
+    world_scratch_.resize(job_count);
+  }
+  for (size_t job = 0; job < job_count; ++job) {
+    world_scratch_[job].resize(joint_count);
+  }
+  const int last_clip = GetClipCount() - 1;
+  util::JobSystem::Get().ParallelFor(
+      0, static_cast<int>(instance_count), kInstancesPerJob,
+      [&](int begin, int end) {
+        glm::mat4* scratch = world_scratch_[begin / kInstancesPerJob].data();
+        for (int i = begin; i < end; ++i) {
+          const int clip = std::min(std::max(instances[i].clip, 0), last_clip);
+          SampleAnimation(skeleton_, clips_[clip], instances[i].time_s,
+                          scratch, &palettes_[i * palette_floats]);
+        }
+      });
+}
+
+void SkinnedObjRenderer::SetInstanceAttributes(size_t first_instance) const {
+  constexpr GLsizei kInstanceStride = sizeof(GpuInstance);
+  const size_t base = first_instance * sizeof(GpuInstance);
+  for (int column = 0; column < kMatrixColumns; ++column) {
+    glVertexAttribPointer(
+        model_mat_attrib_ + column, 4, GL_FLOAT, GL_FALSE, kInstanceStride,
+        reinterpret_cast<const void*>(base +
+                                      offsetof(GpuInstance, model_mat) +
+                                      column * sizeof(glm::vec4)));
+  }
+  glVertexAttribPointer(
+      color_attrib_, 4, GL_FLOAT, GL_FALSE, kInstanceStride,
+      reinterpret_cast<const void*>(base + offsetof(GpuInstance, color)));
+}
+
+void SkinnedObjRenderer::Draw(const glm::mat4& projection_mat,
+                              const glm::mat4& view_mat,
+                              const float* color_correction4) {
+  draw_call_count_ = 0;
+  if (!shader_program_ || !IsLoaded() || instances_.empty() ||
+      !util::TextureCache::Get().IsReady(texture_id_)) {
+    return;
+  }
+
+  // Orphans the previous instance data so the upload does not wait for
+  // draws still in flight.
+  const size_t instance_bytes = instances_.size() * sizeof(GpuInstance);
+  glBindBuffer(GL_ARRAY_BUFFER, instance_buffer_);
+  glBufferData(GL_ARRAY_BUFFER, instance_bytes, instances_.data(),
+               GL_STREAM_DRAW);
+  ResourceAccounting::Get().Track(GpuResourceType::kBuffer, instance_buffer_,
+                                  instance_bytes, kOwner);
+
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
+  gl_state.UseProgram(shader_program_);
+  glUniformMatrix4fv(view_mat_uniform_, 1, GL_FALSE, glm::value_ptr(view_mat));
+  glUniformMatrix4fv(projection_mat_uniform_, 1, GL_FALSE,
+                     glm::value_ptr(projection_mat));
+  glUniform3fv(position_offset_uniform_, 1, glm::value_ptr(position_offset_));
+  glUniform3fv(position_scale_uniform_, 1, glm::value_ptr(position_scale_));
+  glUniform4fv(light_direction_uniform_, 1, glm::value_ptr(kLightDirection));
+  glUniform4f(material_param_uniform_, ambient_, diffuse_, specular_,
+              specular_power_);
+  glUniform4fv(color_correction_param_uniform_, 1, color_correction4);
+  gl_state.ActiveTexture(GL_TEXTURE0);
+  gl_state.BindTexture(GL_TEXTURE_2D, texture_id_);
+  glUniform1i(texture_uniform_, 0);
+  glUniform1i(joint_palette_uniform_, 1);
+
+  gl_state.DepthMask(GL_TRUE);
+  gl_state.SetCapability(GL_BLEND, true);
+  // Same premultiplied alpha as the textures of ObjRenderer.
+  gl_state.BlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+  gl_state.BindVertexArray(vertex_array_);
+
+  // The palettes of each draw's copies go to the next texture of the ring,
+  // one row per copy, which the vertex shader addresses by gl_InstanceID.
+  const int palette_width = skeleton_.GetJointCount() * kTexelsPerJoint;
+  const size_t palette_floats =
+      static_cast<size_t>(skeleton_.GetJointCount()) * kJointPaletteFloats;
+  gl_state.ActiveTexture(GL_TEXTURE1);
+  for (size_t first = 0; first < instances_.size();
+       first += kMaxInstancesPerDraw) {
+    const size_t count = std::min(instances_.size() - first,
+                                  static_cast<size_t>(kMaxInstancesPerDraw));
+    gl_state.BindTexture(GL_TEXTURE_2D,
+                         palette_textures_[next_palette_texture_]);
+    next_palette_texture_ = (next_palette_texture_ + 1) % kPaletteTextureCount;
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, palette_width,
+                    static_cast<GLsizei>(count), GL_RGBA, GL_FLOAT,
+                    &palettes_[first * palette_floats]);
+    SetInstanceAttributes(first);
+    glDrawElementsInstanced(GL_TRIANGLES, index_count_, index_type_, nullptr,
+                            static_cast<GLsizei>(count));
+    ++draw_call_count_;
+  }
+  gl_state.ActiveTexture(GL_TEXTURE0);
+
+  // Other renderers draw from client-side arrays, which requires the default
+  // vertex array object.
+  gl_state.BindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  util::CheckGlError("SkinnedObjRenderer::Draw()");
+}
+
+}  // namespace hello_ar
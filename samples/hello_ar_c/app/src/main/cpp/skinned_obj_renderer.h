@@ -0,0 +1,181 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_SKINNED_OBJ_RENDERER_H_
+#define C_ARCORE_HELLOE_AR_SKINNED_OBJ_RENDERER_H_
+
+// clang-format off
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+// clang-format on
+#include <android/asset_manager.h>
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "glm.h"
+#include "skeletal_animation.h"
+
+namespace hello_ar {
+
+// Draws copies of an animated model, each playing one of the model's clips
+// at a time of its own, skinned on the GPU with one glDrawElementsInstanced
+// call per kMaxInstancesPerDraw copies.
+//
+// Models are the version 3 packed meshes of tools/gltf_to_skinned_mesh.py:
+// util::QuantizedVertex followed by four joint indices and weights per
+// vertex, then the skeleton and the clips resampled at a fixed rate.
+// SampleAnimations() computes the joint matrices of every copy on the
+// JobSystem workers, and Draw() uploads them into a float texture with one
+// row per copy, which skinned_object.vert reads with texelFetch().  Texture
+// buffers need OpenGL ES 3.2 and the 16 KB uniform blocks guaranteed by 3.0
+// hold the palettes of only a few copies, so the palettes go through a 2D
+// RGBA32F texture instead, cycling through kPaletteTextureCount of them so
+// an upload does not wait for the draws of the previous one.
+//
+// Objects are lit like by BatchedObjRenderer, without depth occlusion or
+// Environmental HDR.
+class SkinnedObjRenderer {
+ public:
+  // One copy of the model.
+  struct Instance {
+    glm::mat4 model_mat;
+    // Same as ObjRenderer::Instance::color.
+    glm::vec4 color;
+    // Clip played, in [0, GetClipCount()).
+    int clip = 0;
+    // Position in the clip, which loops.
+    float time_s = 0.0f;
+  };
+
+  // Joint indices are stored as bytes.
+  static constexpr int kMaxJoints = 256;
+  static constexpr int kMaxInstancesPerDraw = 256;
+  static constexpr int kPaletteTextureCount = 3;
+  // Copies whose palettes one job samples.
+  static constexpr int kInstancesPerJob = 8;
+
+  SkinnedObjRenderer() = default;
+  ~SkinnedObjRenderer() = default;
+
+  SkinnedObjRenderer(const SkinnedObjRenderer&) = delete;
+  SkinnedObjRenderer& operator=(const SkinnedObjRenderer&) = delete;
+
+  // Loads the skinned mesh at |mesh_file_name| and the albedo PNG at
+  // |png_file_name|, and sets up the OpenGL resources drawing them.  Must be
+  // called on the OpenGL thread prior to any other calls.  Returns false,
+  // leaving nothing to draw, if the mesh cannot be loaded.
+  bool InitializeGlContent(AAssetManager* asset_manager,
+                           const std::string& mesh_file_name,
+                           const std::string& png_file_name);
+
+  bool IsLoaded() const { return index_count_ > 0; }
+
+  // See ObjRenderer::SetMaterialProperty().
+  void SetMaterialProperty(float ambient, float diffuse, float specular,
+                           float specular_power);
+
+  int GetClipCount() const { return static_cast<int>(clips_.size()); }
+  float GetClipDuration(int clip) const { return clips_[clip].duration_s; }
+
+  // Model-space bounding sphere as center (xyz) and radius (w), enclosing
+  // the model in every frame of every clip.
+  const glm::vec4& GetBoundingSphere() const { return bounding_sphere_; }
+
+  // Samples the joint matrices of every entry of |instances| on the
+  // JobSystem, the calling thread included, and keeps the copies for the
+  // next Draw().
+  void SampleAnimations(const Instance* instances, size_t instance_count);
+
+  // Draws the copies of the last SampleAnimations().
+  void Draw(const glm::mat4& projection_mat, const glm::mat4& view_mat,
+            const float* color_correction4);
+
+  GLuint GetProgram() const { return shader_program_; }
+
+  // Number of draw calls the last Draw() issued.
+  int GetDrawCallCount() const { return draw_call_count_; }
+
+ private:
+  // Per-instance attributes as streamed to the instance buffer, which
+  // a_ModelMatrix and a_ObjColor of skinned_object.vert read.
+  struct GpuInstance {
+    glm::mat4 model_mat;
+    glm::vec4 color;
+  };
+
+  // Reads the skinned mesh, uploads its geometry and keeps its skeleton and
+  // clips.
+  bool LoadMesh(AAssetManager* asset_manager, const std::string& file_name);
+
+  // Points the instanced attributes at the GpuInstance |first_instance| of
+  // instance_buffer_, which GLES 3.0 cannot offset in the draw call.
+  void SetInstanceAttributes(size_t first_instance) const;
+
+  Skeleton skeleton_;
+  std::vector<AnimationClip> clips_;
+  glm::vec4 bounding_sphere_ = glm::vec4(0.0f);
+  glm::vec3 position_offset_ = glm::vec3(0.0f);
+  glm::vec3 position_scale_ = glm::vec3(1.0f);
+
+  // The copies of the last SampleAnimations(), with kJointPaletteFloats per
+  // joint of each in |palettes_|.
+  std::vector<GpuInstance> instances_;
+  std::vector<float> palettes_;
+  // One per job, sized for the joints.
+  std::vector<std::vector<glm::mat4>> world_scratch_;
+  int draw_call_count_ = 0;
+
+  GLuint vertex_array_ = 0;
+  GLuint vertex_buffer_ = 0;
+  GLuint index_buffer_ = 0;
+  GLuint instance_buffer_ = 0;
+  GLsizei index_count_ = 0;
+  GLenum index_type_ = GL_UNSIGNED_SHORT;
+  // Three RGBA32F texels per joint and the palette of one copy per row.
+  std::array<GLuint, kPaletteTextureCount> palette_textures_ = {};
+  int next_palette_texture_ = 0;
+  GLuint texture_id_ = 0;
+
+  float ambient_ = 0.0f;
+  float diffuse_ = 2.0f;
+  float specular_ = 0.5f;
+  float specular_power_ = 6.0f;
+
+  GLuint shader_program_ = 0;
+  GLint position_attrib_ = -1;
+  GLint normal_attrib_ = -1;
+  GLint tex_coord_attrib_ = -1;
+  GLint joints_attrib_ = -1;
+  GLint weights_attrib_ = -1;
+  GLint model_mat_attrib_ = -1;
+  GLint color_attrib_ = -1;
+  GLint view_mat_uniform_ = -1;
+  GLint projection_mat_uniform_ = -1;
+  GLint position_offset_uniform_ = -1;
+  GLint position_scale_uniform_ = -1;
+  GLint texture_uniform_ = -1;
+  GLint joint_palette_uniform_ = -1;
+  GLint light_direction_uniform_ = -1;
+  GLint material_param_uniform_ = -1;
+  GLint color_correction_param_uniform_ = -1;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_SKINNED_OBJ_RENDERER_H_
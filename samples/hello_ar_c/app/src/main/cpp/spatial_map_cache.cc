@@ -0,0 +1,411 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "spatial_map_cache.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+
+#include "util.h"
+
+namespace hello_ar {
+
+constexpr size_t SpatialMapCache::kMaxIdLength;
+
+namespace {
+constexpr uint32_t kFileMagic = 0x50414d53;  // "SMAP"
+constexpr uint32_t kFileVersion = 1;
+// Chunk payloads start at multiples of this, which suits both kinds.
+constexpr size_t kPayloadAlignment = 16;
+constexpr int kPointComponents = 4;
+
+size_t Align(size_t position) {
+  return (position + kPayloadAlignment - 1) / kPayloadAlignment *
+         kPayloadAlignment;
+}
+
+size_t GetElementSize(SpatialMapCache::ChunkType type) {
+  return type == SpatialMapCache::ChunkType::kPoints
+             ? kPointComponents * sizeof(float)
+             : sizeof(TsdfVolume::BlockVoxels);
+}
+
+int64_t GetUnixSeconds() {
+  return std::chrono::duration_cast<std::chrono::seconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+struct ChunkKeyHash {
+  size_t operator()(const glm::ivec3& key) const {
+    return (static_cast<uint32_t>(key.x) * 73856093u) ^
+           (static_cast<uint32_t>(key.y) * 19349663u) ^
+           (static_cast<uint32_t>(key.z) * 83492791u);
+  }
+};
+
+// Indices of the points or blocks of each chunk cube.
+using ChunkIndices =
+    std::unordered_map<glm::ivec3, std::vector<uint32_t>, ChunkKeyHash>;
+}  // namespace
+
+// The file is a FileHeader, map_count MapRecords, chunk_count ChunkRecords
+// and the chunk payloads.
+struct SpatialMapCache::FileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t map_count;
+  uint32_t chunk_count;
+};
+
+struct SpatialMapCache::MapRecord {
+  char anchor_id[kMaxIdLength + 1];
+  int64_t saved_unix_s;
+  float anchor_pose[16];
+  float voxel_size_m;
+  uint32_t first_chunk;
+  uint32_t chunk_count;
+  uint32_t reserved;
+};
+
+struct SpatialMapCache::ChunkRecord {
+  uint32_t type;
+  uint32_t count;
+  uint64_t offset;
+  float center[3];
+  uint32_t reserved;
+};
+
+SpatialMapCache::SpatialMapCache(const Options& options) : options_(options) {}
+
+SpatialMapCache::~SpatialMapCache() {
+  RetireMapping();
+  for (const auto& mapping : retired_mappings_) {
+    munmap(const_cast<uint8_t*>(mapping.first), mapping.second);
+  }
+}
+
+bool SpatialMapCache::Load(const std::string& path) {
+  path_ = path;
+  RetireMapping();
+  return MapFile(path) && map_count_ > 0;
+}
+
+bool SpatialMapCache::FindMap(const std::string& anchor_id, Map* map) const {
+  for (uint32_t i = 0; i < map_count_; ++i) {
+    const MapRecord& record = map_records_[i];
+    if (anchor_id != record.anchor_id) {
+      continue;
+    }
+    if (record.voxel_size_m != options_.voxel_size_m) {
+      LOGE("SpatialMapCache: map of %s has %.3f m voxels, not %.3f m",
+           anchor_id.c_str(), record.voxel_size_m, options_.voxel_size_m);
+      return false;
+    }
+    map->anchor_pose_mat = glm::make_mat4(record.anchor_pose);
+    map->chunks.clear();
+    map->chunks.reserve(record.chunk_count);
+    for (uint32_t c = 0; c < record.chunk_count; ++c) {
+      const ChunkRecord& chunk_record = chunk_records_[record.first_chunk + c];
+      Chunk chunk;
+      chunk.type = static_cast<ChunkType>(chunk_record.type);
+      chunk.center = glm::make_vec3(chunk_record.center);
+      chunk.data = mapping_ + chunk_record.offset;
+      chunk.count = chunk_record.count;
+      map->chunks.push_back(chunk);
+    }
+    return true;
+  }
+  return false;
+}
+
+bool SpatialMapCache::Save(const std::string& anchor_id,
+                           const glm::mat4& anchor_pose_mat,
+                           const float* points, int32_t number_of_points,
+                           const std::vector<TsdfVolume::BlockVoxels>& blocks) {
+  if (path_.empty() || anchor_id.empty() ||
+      anchor_id.size() > kMaxIdLength) {
+    return false;
+  }
+  const auto start = std::chrono::steady_clock::now();
+
+  // Group the new map's points and blocks by chunk cube.
+  ChunkIndices point_chunks;
+  size_t point_count = 0;
+  for (int32_t i = 0; i < number_of_points; ++i) {
+    const float* point = points + i * kPointComponents;
+    if (point[3] < 0.f) {
+      continue;
+    }
+    const glm::ivec3 key(
+        glm::floor(glm::make_vec3(point) / options_.chunk_size_m));
+    point_chunks[key].push_back(static_cast<uint32_t>(i));
+    ++point_count;
+  }
+  ChunkIndices block_chunks;
+  const float block_size_m = options_.voxel_size_m * TsdfVolume::kBlockSize;
+  for (size_t i = 0; i < blocks.size(); ++i) {
+    const glm::vec3 block_center =
+        (glm::vec3(blocks[i].key) + 0.5f) * block_size_m;
+    const glm::ivec3 key(glm::floor(block_center / options_.chunk_size_m));
+    block_chunks[key].push_back(static_cast<uint32_t>(i));
+  }
+
+  // The other maps that are kept, most recently saved first.
+  std::vector<const MapRecord*> kept_maps;
+  for (uint32_t i = 0; i < map_count_; ++i) {
+    if (anchor_id != map_records_[i].anchor_id) {
+      kept_maps.push_back(&map_records_[i]);
+    }
+  }
+  std::sort(kept_maps.begin(), kept_maps.end(),
+            [](const MapRecord* a, const MapRecord* b) {
+              return a->saved_unix_s > b->saved_unix_s;
+            });
+  if (static_cast<int>(kept_maps.size()) > options_.max_maps - 1) {
+    kept_maps.resize(std::max(options_.max_maps - 1, 0));
+  }
+
+  // Lays out the new file, then writes it in one pass.
+  const uint32_t new_chunk_count =
+      static_cast<uint32_t>(point_chunks.size() + block_chunks.size());
+  uint32_t chunk_count = new_chunk_count;
+  for (const MapRecord* map : kept_maps) {
+    chunk_count += map->chunk_count;
+  }
+  const uint32_t map_count = static_cast<uint32_t>(kept_maps.size()) + 1;
+  size_t file_size = Align(sizeof(FileHeader) + map_count * sizeof(MapRecord) +
+                           chunk_count * sizeof(ChunkRecord));
+  const size_t payload_start = file_size;
+  for (const MapRecord* map : kept_maps) {
+    for (uint32_t c = 0; c < map->chunk_count; ++c) {
+      const ChunkRecord& chunk = chunk_records_[map->first_chunk + c];
+      file_size += Align(chunk.count *
+                         GetElementSize(static_cast<ChunkType>(chunk.type)));
+    }
+  }
+  for (const auto& chunk : point_chunks) {
+    file_size +=
+        Align(chunk.second.size() * GetElementSize(ChunkType::kPoints));
+  }
+  for (const auto& chunk : block_chunks) {
+    file_size +=
+        Align(chunk.second.size() * GetElementSize(ChunkType::kTsdfBlocks));
+  }
+
+  // Written next to the cache first, so a crash never leaves a truncated
+  // one behind.
+  const std::string temp_path = path_ + ".tmp";
+  const int fd =
+      open(temp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    LOGE("SpatialMapCache: cannot write %s", temp_path.c_str());
+    return false;
+  }
+  void* mapping = MAP_FAILED;
+  if (ftruncate(fd, file_size) == 0) {
+    mapping = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                   0);
+  }
+  if (mapping == MAP_FAILED) {
+    LOGE("SpatialMapCache: cannot map %zu bytes of %s", file_size,
+         temp_path.c_str());
+    close(fd);
+    unlink(temp_path.c_str());
+    return false;
+  }
+  uint8_t* file = static_cast<uint8_t*>(mapping);
+  const FileHeader header = {kFileMagic, kFileVersion, map_count,
+                             chunk_count};
+  memcpy(file, &header, sizeof(header));
+  MapRecord* map_records =
+      reinterpret_cast<MapRecord*>(file + sizeof(FileHeader));
+  ChunkRecord* chunk_records =
+      reinterpret_cast<ChunkRecord*>(map_records + map_count);
+  uint32_t next_chunk = 0;
+  size_t next_payload = payload_start;
+
+  // The kept maps' chunks are copied from the current mapping, which pages
+  // them in once.
+  for (uint32_t m = 0; m < kept_maps.size(); ++m) {
+    map_records[m] = *kept_maps[m];
+    map_records[m].first_chunk = next_chunk;
+    for (uint32_t c = 0; c < kept_maps[m]->chunk_count; ++c) {
+      const ChunkRecord& source =
+          chunk_records_[kept_maps[m]->first_chunk + c];
+      const size_t size =
+          source.count * GetElementSize(static_cast<ChunkType>(source.type));
+      ChunkRecord& chunk = chunk_records[next_chunk++];
+      chunk = source;
+      chunk.offset = next_payload;
+      memcpy(file + next_payload, mapping_ + source.offset, size);
+      next_payload += Align(size);
+    }
+  }
+
+  MapRecord& map_record = map_records[map_count - 1];
+  memset(&map_record, 0, sizeof(map_record));
+  memcpy(map_record.anchor_id, anchor_id.data(), anchor_id.size());
+  map_record.saved_unix_s = GetUnixSeconds();
+  memcpy(map_record.anchor_pose, glm::value_ptr(anchor_pose_mat),
+         sizeof(map_record.anchor_pose));
+  map_record.voxel_size_m = options_.voxel_size_m;
+  map_record.first_chunk = next_chunk;
+  map_record.chunk_count = new_chunk_count;
+  const auto add_chunk = [&](ChunkType type, const glm::ivec3& key,
+                             const std::vector<uint32_t>& indices) {
+    ChunkRecord& chunk = chunk_records[next_chunk++];
+    memset(&chunk, 0, sizeof(chunk));
+    chunk.type = static_cast<uint32_t>(type);
+    chunk.count = static_cast<uint32_t>(indices.size());
+    chunk.offset = next_payload;
+    const glm::vec3 center = (glm::vec3(key) + 0.5f) * options_.chunk_size_m;
+    memcpy(chunk.center, glm::value_ptr(center), sizeof(chunk.center));
+    const size_t element_size = GetElementSize(type);
+    for (const uint32_t index : indices) {
+      const void* element =
+          type == ChunkType::kPoints
+              ? static_cast<const void*>(points + index * kPointComponents)
+              : static_cast<const void*>(&blocks[index]);
+      memcpy(file + next_payload, element, element_size);
+      next_payload += element_size;
+    }
+    next_payload = Align(next_payload);
+  };
+  for (const auto& chunk : point_chunks) {
+    add_chunk(ChunkType::kPoints, chunk.first, chunk.second);
+  }
+  for (const auto& chunk : block_chunks) {
+    add_chunk(ChunkType::kTsdfBlocks, chunk.first, chunk.second);
+  }
+
+  bool write_ok = munmap(mapping, file_size) == 0;
+  write_ok = (close(fd) == 0) && write_ok;
+  if (!write_ok || rename(temp_path.c_str(), path_.c_str()) != 0) {
+    LOGE("SpatialMapCache: cannot replace %s", path_.c_str());
+    unlink(temp_path.c_str());
+    return false;
+  }
+
+  ++save_count_;
+  saved_points_ += point_count;
+  saved_blocks_ += blocks.size();
+  saved_bytes_ += file_size;
+  save_ms_ += std::chrono::duration<double, std::milli>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
+  // The records handed out by FindMap() point into the current mapping,
+  // which is therefore kept.
+  RetireMapping();
+  MapFile(path_);
+  return true;
+}
+
+std::string SpatialMapCache::GetReport() const {
+  char text[256];
+  snprintf(text, sizeof(text),
+           "%u maps of %u chunks in %zu KiB, %d saves of %zu points and "
+           "%zu blocks, %zu KiB written in %.1f ms",
+           map_count_, chunk_count_, mapping_size_ / 1024, save_count_,
+           saved_points_,
+           saved_blocks_, saved_bytes_ / 1024, save_ms_);
+  return text;
+}
+
+bool SpatialMapCache::MapFile(const std::string& path) {
+  const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat file_stat = {};
+  void* mapping = MAP_FAILED;
+  if (fstat(fd, &file_stat) == 0 &&
+      static_cast<size_t>(file_stat.st_size) >= sizeof(FileHeader)) {
+    mapping = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  // The mapping keeps the file open.
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    return false;
+  }
+  const uint8_t* data = static_cast<const uint8_t*>(mapping);
+  const size_t size = static_cast<size_t>(file_stat.st_size);
+
+  // Checks everything FindMap() and Save() rely on, so that they never read
+  // outside of the mapping.
+  FileHeader header;
+  memcpy(&header, data, sizeof(header));
+  const MapRecord* map_records =
+      reinterpret_cast<const MapRecord*>(data + sizeof(FileHeader));
+  const ChunkRecord* chunk_records =
+      reinterpret_cast<const ChunkRecord*>(map_records + header.map_count);
+  bool valid = header.magic == kFileMagic && header.version == kFileVersion &&
+               header.map_count <= static_cast<uint32_t>(options_.max_maps) &&
+               header.chunk_count <= (size - sizeof(FileHeader)) /
+                                         sizeof(ChunkRecord) &&
+               sizeof(FileHeader) + header.map_count * sizeof(MapRecord) +
+                       header.chunk_count * sizeof(ChunkRecord) <=
+                   size;
+  for (uint32_t i = 0; valid && i < header.map_count; ++i) {
+    const MapRecord& map = map_records[i];
+    valid = memchr(map.anchor_id, '\0', sizeof(map.anchor_id)) != nullptr &&
+            map.first_chunk <= header.chunk_count &&
+            map.chunk_count <= header.chunk_count - map.first_chunk;
+  }
+  for (uint32_t i = 0; valid && i < header.chunk_count; ++i) {
+    const ChunkRecord& chunk = chunk_records[i];
+    valid = chunk.type <= static_cast<uint32_t>(ChunkType::kTsdfBlocks) &&
+            chunk.offset % kPayloadAlignment == 0 && chunk.offset <= size &&
+            chunk.count <=
+                (size - chunk.offset) /
+                    GetElementSize(static_cast<ChunkType>(chunk.type));
+  }
+  if (!valid) {
+    LOGE("SpatialMapCache: %s is not a valid cache", path.c_str());
+    munmap(mapping, size);
+    return false;
+  }
+
+  mapping_ = data;
+  mapping_size_ = size;
+  map_records_ = map_records;
+  map_count_ = header.map_count;
+  chunk_records_ = chunk_records;
+  chunk_count_ = header.chunk_count;
+  return true;
+}
+
+void SpatialMapCache::RetireMapping() {
+  if (mapping_ != nullptr) {
+    retired_mappings_.emplace_back(mapping_, mapping_size_);
+  }
+  mapping_ = nullptr;
+  mapping_size_ = 0;
+  map_records_ = nullptr;
+  map_count_ = 0;
+  chunk_records_ = nullptr;
+  chunk_count_ = 0;
+}
+
+}  // namespace hello_ar
@@ -0,0 +1,141 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_SPATIAL_MAP_CACHE_H_
+#define C_ARCORE_HELLOE_AR_SPATIAL_MAP_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "glm.h"
+#include "tsdf_volume.h"
+
+namespace hello_ar {
+
+// Keeps the point map and the TSDF blocks of past sessions in one file,
+// keyed by the id of a Cloud Anchor, so a session that resolves the anchor
+// again starts with what the earlier one had mapped.
+//
+// Each map is a directory entry with the anchor id, the pose the anchor had
+// when the map was saved, and a range of chunks.  A chunk holds the points
+// or the blocks of one chunk_size_m cube, in the world frame of the session
+// that saved it.  Load() maps the file read only and reads nothing but the
+// directory; the kernel pages a chunk in when it is first read, so maps that
+// are never resolved cost no memory, and a restore can start with the
+// chunks around the camera.
+//
+// Save() writes a new file through a shared mapping, renames it over the old
+// one and maps it in turn.  Earlier mappings are kept until the cache is
+// destroyed, so the chunks of FindMap() stay readable across a Save().  The
+// least recently saved maps are dropped beyond max_maps.
+//
+// Not thread safe.
+class SpatialMapCache {
+ public:
+  static constexpr size_t kMaxIdLength = 127;
+
+  struct Options {
+    // Edge of the chunk cubes, four blocks of the default volume.
+    float chunk_size_m = 1.28f;
+    // Blocks are only restored into volumes of the voxel size they were
+    // saved with.
+    float voxel_size_m = TsdfVolume::Options().voxel_size_m;
+    int max_maps = 4;
+  };
+
+  enum class ChunkType : uint32_t { kPoints, kTsdfBlocks };
+
+  // One chunk of a saved map, pointing into the mapped file.
+  struct Chunk {
+    ChunkType type = ChunkType::kPoints;
+    // Center of the chunk's cube in the world frame of the saving session.
+    glm::vec3 center = glm::vec3(0.f);
+    // |count| x, y, z, confidence tuples for kPoints, |count|
+    // TsdfVolume::BlockVoxels for kTsdfBlocks.
+    const void* data = nullptr;
+    uint32_t count = 0;
+  };
+
+  struct Map {
+    // Pose of the anchor in the world frame of the saving session.
+    glm::mat4 anchor_pose_mat = glm::mat4(1.f);
+    std::vector<Chunk> chunks;
+  };
+
+  SpatialMapCache() : SpatialMapCache(Options()) {}
+  explicit SpatialMapCache(const Options& options);
+  ~SpatialMapCache();
+
+  SpatialMapCache(const SpatialMapCache&) = delete;
+  SpatialMapCache& operator=(const SpatialMapCache&) = delete;
+
+  // Maps the file at |path| if it is a valid cache, and saves there from
+  // then on.  Returns whether any map was loaded.
+  bool Load(const std::string& path);
+
+  // The map saved under |anchor_id| into |map|, or false if there is none of
+  // this voxel size.
+  bool FindMap(const std::string& anchor_id, Map* map) const;
+
+  // Replaces the map of |anchor_id| with |number_of_points| x, y, z,
+  // confidence tuples and |blocks|, all in the world frame where the anchor
+  // has the pose |anchor_pose_mat|.  Tuples with a negative confidence, the
+  // removed slots of a PointCloudMap, are left out.  Returns false if the
+  // file could not be written, which keeps the previous one.
+  bool Save(const std::string& anchor_id, const glm::mat4& anchor_pose_mat,
+            const float* points, int32_t number_of_points,
+            const std::vector<TsdfVolume::BlockVoxels>& blocks);
+
+  // Maps in the file, and what the saves of this session wrote.
+  std::string GetReport() const;
+
+ private:
+  struct FileHeader;
+  struct MapRecord;
+  struct ChunkRecord;
+
+  // Maps |path| and validates its directory.  Leaves the cache empty and
+  // returns false if the file is missing or invalid.
+  bool MapFile(const std::string& path);
+
+  // Moves the current mapping to retired_mappings_.
+  void RetireMapping();
+
+  const Options options_;
+  std::string path_;
+
+  const uint8_t* mapping_ = nullptr;
+  size_t mapping_size_ = 0;
+  const MapRecord* map_records_ = nullptr;
+  uint32_t map_count_ = 0;
+  const ChunkRecord* chunk_records_ = nullptr;
+  uint32_t chunk_count_ = 0;
+  // Address and size of the mappings replaced by Save().
+  std::vector<std::pair<const uint8_t*, size_t>> retired_mappings_;
+
+  int save_count_ = 0;
+  size_t saved_points_ = 0;
+  size_t saved_blocks_ = 0;
+  size_t saved_bytes_ = 0;
+  double save_ms_ = 0.0;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_SPATIAL_MAP_CACHE_H_
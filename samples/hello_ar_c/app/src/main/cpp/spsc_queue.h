@@ -0,0 +1,74 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_SPSC_QUEUE_H_
+#define C_ARCORE_HELLOE_AR_SPSC_QUEUE_H_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <utility>
+
+namespace hello_ar {
+
+// Lock-free single producer, single consumer queue of movable items, e.g. the
+// AppEventQueue from the UI thread.
+//
+// Items are moved into and out of a fixed ring of slots, so items that own
+// storage, e.g. vectors, hand it over without copying.  Neither side ever
+// waits: TryPush() fails while the queue is full and TryPop() while it is
+// empty.
+template <typename T, uint32_t kCapacity>
+class SpscQueue {
+ public:
+  // Producer side.  Moves |*item| into the queue, or leaves it untouched and
+  // returns false if the queue is full.
+  bool TryPush(T* item) {
+    const uint32_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == kCapacity) {
+      return false;
+    }
+    slots_[tail % kCapacity] = std::move(*item);
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side.  Moves the oldest item into |*item|, or returns false if
+  // the queue is empty.
+  bool TryPop(T* item) {
+    const uint32_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    *item = std::move(slots_[head % kCapacity]);
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+ private:
+  static_assert((kCapacity & (kCapacity - 1)) == 0,
+                "kCapacity must divide the index range evenly");
+
+  std::array<T, kCapacity> slots_;
+  // Free running indices; only their difference and their value modulo
+  // kCapacity are used.
+  std::atomic<uint32_t> head_{0};
+  std::atomic<uint32_t> tail_{0};
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_SPSC_QUEUE_H_
@@ -0,0 +1,648 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "state_capture.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "util.h"
+
+namespace hello_ar {
+
+constexpr size_t StateCapture::kChunkSize;
+constexpr uint32_t StateCapture::kChunkCount;
+constexpr size_t StateCapture::kChunkReserve;
+constexpr int StateCapture::kMaxChunkFrames;
+constexpr size_t StateCapture::kMappingWindowSize;
+constexpr std::chrono::milliseconds StateCapture::kFlushInterval;
+
+namespace {
+int16_t ToPolygonUnits(float meters) {
+  const float units = std::round(meters / capture::kPolygonUnitM);
+  return static_cast<int16_t>(
+      std::min(std::max(units, static_cast<float>(INT16_MIN)),
+               static_cast<float>(INT16_MAX)));
+}
+
+int16_t ClampDelta(int32_t delta) {
+  return static_cast<int16_t>(std::min(std::max(delta, INT16_MIN + 0),
+                                       INT16_MAX + 0));
+}
+
+void ReadIntrinsics(const ArSession* session,
+                    const ArCameraIntrinsics* intrinsics,
+                    capture::CameraIntrinsicsRecord* record) {
+  ArCameraIntrinsics_getFocalLength(session, intrinsics, &record->fx,
+                                    &record->fy);
+  ArCameraIntrinsics_getPrincipalPoint(session, intrinsics, &record->cx,
+                                       &record->cy);
+  ArCameraIntrinsics_getImageDimensions(session, intrinsics, &record->width,
+                                        &record->height);
+}
+
+// The affine transform from NDC to |type|, from the images of the origin
+// and the two unit vectors.
+void GetNdcTransform(const ArSession* session, const ArFrame* frame,
+                     ArCoordinates2dType type, float* affine) {
+  const float ndc[6] = {0.f, 0.f, 1.f, 0.f, 0.f, 1.f};
+  float uv[6];
+  ArFrame_transformCoordinates2d(
+      session, frame, AR_COORDINATES_2D_OPENGL_NORMALIZED_DEVICE_COORDINATES,
+      3, ndc, type, uv);
+  affine[0] = uv[2] - uv[0];
+  affine[1] = uv[4] - uv[0];
+  affine[2] = uv[0];
+  affine[3] = uv[3] - uv[1];
+  affine[4] = uv[5] - uv[1];
+  affine[5] = uv[1];
+}
+}  // namespace
+
+StateCapture::~StateCapture() { Stop(); }
+
+bool StateCapture::Start(const ArSession* session, const std::string& path,
+                         const Options& options) {
+  Stop();
+  fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd_ < 0) {
+    LOGE("StateCapture: cannot create %s", path.c_str());
+    return false;
+  }
+  options_ = options;
+  if (chunks_.empty()) {
+    chunks_.resize(kChunkCount);
+    for (Chunk& chunk : chunks_) {
+      chunk.data.reset(new uint8_t[kChunkSize]);
+    }
+  }
+  for (Chunk& chunk : chunks_) {
+    chunk.size = 0;
+    Chunk* free_chunk = &chunk;
+    free_chunks_.TryPush(&free_chunk);
+  }
+  free_chunks_.TryPop(&chunk_);
+  chunk_frames_ = 0;
+  window_ = nullptr;
+  window_offset_ = 0;
+  file_size_ = 0;
+  write_failed_ = false;
+
+  resync_ = true;
+  display_geometry_dirty_ = true;
+  frame_index_ = 0;
+  dropped_frames_ = 0;
+  total_capture_time_ = std::chrono::nanoseconds(0);
+  max_capture_time_ = std::chrono::nanoseconds(0);
+  next_anchor_id_ = 0;
+  point_cloud_timestamp_ns_ = -1;
+  light_estimate_timestamp_ns_ = -1;
+  depth_timestamp_ns_ = -1;
+
+  ArPose_create(session, nullptr, &pose_);
+  ArCameraIntrinsics_create(session, &intrinsics_);
+  ArLightEstimate_create(session, &light_estimate_);
+  ArTrackableList_create(session, &trackables_);
+
+  capture::FileHeader file_header = {};
+  memcpy(file_header.magic, capture::kMagic, sizeof(file_header.magic));
+  file_header.version = capture::kVersion;
+  memcpy(chunk_->data.get(), &file_header, sizeof(file_header));
+  chunk_->size = sizeof(file_header);
+
+  capture::SessionInfoRecord info = {};
+  ArCameraConfig* camera_config = nullptr;
+  ArCameraConfig_create(session, &camera_config);
+  ArSession_getCameraConfig(session, camera_config);
+  ArCameraConfig_getImageDimensions(session, camera_config, &info.image_width,
+                                    &info.image_height);
+  ArCameraConfig_getTextureDimensions(session, camera_config,
+                                      &info.texture_width,
+                                      &info.texture_height);
+  ArCameraConfig_getFpsRange(session, camera_config, &info.min_fps,
+                             &info.max_fps);
+  ArCameraConfig_destroy(camera_config);
+  info.projection_near = options_.projection_near;
+  info.projection_far = options_.projection_far;
+  frame_start_ = chunk_->size;
+  overflowed_ = false;
+  AppendRecord(capture::kSessionInfo, &info, sizeof(info));
+
+  stopping_ = false;
+  flush_thread_ = std::thread(&StateCapture::RunFlushLoop, this);
+  LOGI("StateCapture: capturing to %s", path.c_str());
+  return true;
+}
+
+void StateCapture::Stop() {
+  if (flush_thread_.joinable()) {
+    if (chunk_ != nullptr && chunk_->size > 0) {
+      SubmitChunk();
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    wake_.notify_one();
+    flush_thread_.join();
+    // Chunks submitted while the thread stopped.
+    FlushChunks();
+    LOGI("StateCapture: %u frames, %u dropped, %zu bytes, %.3f ms per frame "
+         "on average, %.3f ms at most",
+         frame_index_, dropped_frames_, file_size_,
+         frame_index_ > 0
+             ? std::chrono::duration<float, std::milli>(total_capture_time_)
+                       .count() /
+                   frame_index_
+             : 0.f,
+         std::chrono::duration<float, std::milli>(max_capture_time_).count());
+  }
+  Chunk* chunk = nullptr;
+  while (free_chunks_.TryPop(&chunk)) {
+  }
+  chunk_ = nullptr;
+  if (window_ != nullptr) {
+    munmap(window_, kMappingWindowSize);
+    window_ = nullptr;
+  }
+  if (fd_ >= 0) {
+    // Cuts off the unused part of the last window.
+    if (ftruncate(fd_, file_size_) != 0) {
+      LOGE("StateCapture: cannot trim the capture");
+    }
+    close(fd_);
+    fd_ = -1;
+  }
+  ReleaseArObjects();
+}
+
+void StateCapture::ReleaseArObjects() {
+  for (const auto& plane : plane_ids_) {
+    ArTrackable_release(ArAsTrackable(plane.first));
+  }
+  plane_ids_.clear();
+  anchor_states_.clear();
+  if (pose_ != nullptr) {
+    ArPose_destroy(pose_);
+    pose_ = nullptr;
+  }
+  if (intrinsics_ != nullptr) {
+    ArCameraIntrinsics_destroy(intrinsics_);
+    intrinsics_ = nullptr;
+  }
+  if (light_estimate_ != nullptr) {
+    ArLightEstimate_destroy(light_estimate_);
+    light_estimate_ = nullptr;
+  }
+  if (trackables_ != nullptr) {
+    ArTrackableList_destroy(trackables_);
+    trackables_ = nullptr;
+  }
+}
+
+void StateCapture::SetDisplayGeometry(int rotation, int width, int height) {
+  display_rotation_ = rotation;
+  display_width_ = width;
+  display_height_ = height;
+  display_geometry_dirty_ = true;
+}
+
+void StateCapture::CaptureFrame(const ArSession* session, const ArFrame* frame,
+                                const ArImage* depth_image,
+                                const AnchorStore& anchors) {
+  if (!IsRunning()) {
+    return;
+  }
+  const auto start = std::chrono::steady_clock::now();
+  if (chunk_ == nullptr && !free_chunks_.TryPop(&chunk_)) {
+    // The flush thread fell behind.
+    ++dropped_frames_;
+    resync_ = true;
+    return;
+  }
+  frame_start_ = chunk_->size;
+  overflowed_ = false;
+
+  capture::FrameRecord frame_record = {};
+  ArFrame_getTimestamp(session, frame, &frame_record.timestamp_ns);
+  frame_record.frame_index = frame_index_;
+  AppendRecord(capture::kFrame, &frame_record, sizeof(frame_record));
+  WriteCamera(session, frame);
+  WriteDisplayGeometry(session, frame);
+  WritePlanes(session, frame);
+  WritePointCloud(session, frame);
+  WriteLightEstimate(session, frame);
+  WriteDepthImage(session, depth_image);
+  WriteAnchors(session, anchors);
+
+  if (overflowed_) {
+    // The frame is cut off and the changes it had are lost, so the next
+    // frame starts over in a new chunk.
+    chunk_->size = frame_start_;
+    ++dropped_frames_;
+    resync_ = true;
+    if (chunk_->size > 0) {
+      SubmitChunk();
+    }
+  } else {
+    ++frame_index_;
+    ++chunk_frames_;
+    resync_ = false;
+    if (kChunkSize - chunk_->size < kChunkReserve ||
+        chunk_frames_ >= kMaxChunkFrames) {
+      SubmitChunk();
+    }
+  }
+
+  const auto capture_time = std::chrono::steady_clock::now() - start;
+  total_capture_time_ += capture_time;
+  max_capture_time_ = std::max<std::chrono::nanoseconds>(max_capture_time_,
+                                                         capture_time);
+}
+
+uint8_t* StateCapture::AppendRecord(capture::RecordType type,
+                                    const void* payload, size_t size,
+                                    size_t extra_size) {
+  const size_t record_size = sizeof(capture::RecordHeader) + size + extra_size;
+  if (overflowed_ || kChunkSize - chunk_->size < record_size) {
+    overflowed_ = true;
+    return nullptr;
+  }
+  uint8_t* data = chunk_->data.get() + chunk_->size;
+  capture::RecordHeader header = {};
+  header.type = type;
+  header.size = static_cast<uint32_t>(size + extra_size);
+  memcpy(data, &header, sizeof(header));
+  memcpy(data + sizeof(header), payload, size);
+  last_record_ = chunk_->size;
+  chunk_->size += record_size;
+  return data + sizeof(header) + size;
+}
+
+void StateCapture::TrimLastRecord(size_t unused_size) {
+  uint8_t* data = chunk_->data.get() + last_record_;
+  capture::RecordHeader header;
+  memcpy(&header, data, sizeof(header));
+  header.size -= static_cast<uint32_t>(unused_size);
+  memcpy(data, &header, sizeof(header));
+  chunk_->size -= unused_size;
+}
+
+void StateCapture::WriteCamera(const ArSession* session,
+                               const ArFrame* frame) {
+  capture::CameraRecord record = {};
+  ArCamera* camera = nullptr;
+  ArFrame_acquireCamera(session, frame, &camera);
+  ArTrackingState tracking_state = AR_TRACKING_STATE_STOPPED;
+  ArCamera_getTrackingState(session, camera, &tracking_state);
+  record.tracking_state = tracking_state;
+  ArCamera_getPose(session, camera, pose_);
+  ArPose_getPoseRaw(session, pose_, record.pose);
+  ArFrame_getAndroidSensorPose(session, frame, pose_);
+  ArPose_getPoseRaw(session, pose_, record.android_sensor_pose);
+  ArCamera_getProjectionMatrix(session, camera, options_.projection_near,
+                               options_.projection_far, record.projection);
+  ArCamera_getImageIntrinsics(session, camera, intrinsics_);
+  ReadIntrinsics(session, intrinsics_, &record.image_intrinsics);
+  ArCamera_getTextureIntrinsics(session, camera, intrinsics_);
+  ReadIntrinsics(session, intrinsics_, &record.texture_intrinsics);
+  ArCamera_release(camera);
+  AppendRecord(capture::kCamera, &record, sizeof(record));
+}
+
+void StateCapture::WriteDisplayGeometry(const ArSession* session,
+                                        const ArFrame* frame) {
+  if (!resync_ && !display_geometry_dirty_) {
+    int32_t geometry_changed = 0;
+    ArFrame_getDisplayGeometryChanged(session, frame, &geometry_changed);
+    if (geometry_changed == 0) {
+      return;
+    }
+  }
+  capture::DisplayGeometryRecord record = {};
+  record.rotation = display_rotation_;
+  record.width = display_width_;
+  record.height = display_height_;
+  GetNdcTransform(session, frame, AR_COORDINATES_2D_TEXTURE_NORMALIZED,
+                  record.ndc_to_texture_normalized);
+  GetNdcTransform(session, frame, AR_COORDINATES_2D_IMAGE_NORMALIZED,
+                  record.ndc_to_image_normalized);
+  if (AppendRecord(capture::kDisplayGeometry, &record, sizeof(record)) !=
+      nullptr) {
+    display_geometry_dirty_ = false;
+  }
+}
+
+void StateCapture::WritePlanes(const ArSession* session,
+                               const ArFrame* frame) {
+  if (resync_) {
+    ArSession_getAllTrackables(session, AR_TRACKABLE_PLANE, trackables_);
+  } else {
+    ArFrame_getUpdatedTrackables(session, frame, AR_TRACKABLE_PLANE,
+                                 trackables_);
+  }
+  int32_t count = 0;
+  ArTrackableList_getSize(session, trackables_, &count);
+  for (int32_t i = 0; i < count; ++i) {
+    ArTrackable* trackable = nullptr;
+    ArTrackableList_acquireItem(session, trackables_, i, &trackable);
+    ArPlane* plane = ArAsPlane(trackable);
+    bool is_new = false;
+    WritePlane(session, plane, GetPlaneId(plane, &is_new));
+  }
+}
+
+void StateCapture::WritePlane(const ArSession* session, ArPlane* plane,
+                              int32_t id) {
+  capture::PlaneRecord record = {};
+  record.id = id;
+  ArPlaneType type = AR_PLANE_HORIZONTAL_UPWARD_FACING;
+  ArPlane_getType(session, plane, &type);
+  record.type = type;
+  ArTrackingState tracking_state = AR_TRACKING_STATE_STOPPED;
+  ArTrackable_getTrackingState(session, ArAsTrackable(plane),
+                               &tracking_state);
+  record.tracking_state = tracking_state;
+  ArPlane* subsumed_by = nullptr;
+  ArPlane_acquireSubsumedBy(session, plane, &subsumed_by);
+  record.subsumed_by = -1;
+  if (subsumed_by != nullptr) {
+    bool is_new = false;
+    record.subsumed_by = GetPlaneId(subsumed_by, &is_new);
+    // A reader must know the plane an id refers to.
+    if (is_new) {
+      WritePlane(session, subsumed_by, record.subsumed_by);
+    }
+  }
+  ArPlane_getCenterPose(session, plane, pose_);
+  ArPose_getPoseRaw(session, pose_, record.center_pose);
+  ArPlane_getExtentX(session, plane, &record.extent_x);
+  ArPlane_getExtentZ(session, plane, &record.extent_z);
+
+  int32_t polygon_size = 0;
+  ArPlane_getPolygonSize(session, plane, &polygon_size);
+  polygon_.resize(polygon_size);
+  if (polygon_size > 0) {
+    ArPlane_getPolygon(session, plane, polygon_.data());
+  }
+  record.vertex_count = static_cast<uint32_t>(polygon_size / 2);
+  uint8_t* vertices =
+      AppendRecord(capture::kPlane, &record, sizeof(record),
+                   record.vertex_count * 2 * sizeof(int16_t));
+  if (vertices == nullptr) {
+    return;
+  }
+  // Deltas are taken from the rounded vertices, so the rounding errors do
+  // not add up along the polygon.
+  int32_t x = 0, z = 0;
+  for (uint32_t i = 0; i < record.vertex_count; ++i) {
+    const int16_t delta[2] = {
+        ClampDelta(ToPolygonUnits(polygon_[2 * i]) - x),
+        ClampDelta(ToPolygonUnits(polygon_[2 * i + 1]) - z)};
+    x += delta[0];
+    z += delta[1];
+    memcpy(vertices + i * sizeof(delta), delta, sizeof(delta));
+  }
+}
+
+int32_t StateCapture::GetPlaneId(ArPlane* plane, bool* is_new) {
+  const auto inserted =
+      plane_ids_.emplace(plane, static_cast<int32_t>(plane_ids_.size()));
+  *is_new = inserted.second;
+  if (!inserted.second) {
+    // The first reference is kept.
+    ArTrackable_release(ArAsTrackable(plane));
+  }
+  return inserted.first->second;
+}
+
+void StateCapture::WritePointCloud(const ArSession* session,
+                                   const ArFrame* frame) {
+  ArPointCloud* point_cloud = nullptr;
+  if (ArFrame_acquirePointCloud(session, frame, &point_cloud) != AR_SUCCESS) {
+    return;
+  }
+  capture::PointCloudRecord record = {};
+  ArPointCloud_getTimestamp(session, point_cloud, &record.timestamp_ns);
+  if (!resync_ && record.timestamp_ns == point_cloud_timestamp_ns_) {
+    ArPointCloud_release(point_cloud);
+    return;
+  }
+  int32_t point_count = 0;
+  ArPointCloud_getNumberOfPoints(session, point_cloud, &point_count);
+  const float* points = nullptr;
+  ArPointCloud_getData(session, point_cloud, &points);
+  const int32_t* ids = nullptr;
+  ArPointCloud_getPointIds(session, point_cloud, &ids);
+  record.point_count = static_cast<uint32_t>(std::max(point_count, 0));
+  const size_t points_size = record.point_count * 4 * sizeof(float);
+  const size_t max_ids_size = record.point_count * capture::kMaxVarintSize;
+  uint8_t* out = AppendRecord(capture::kPointCloud, &record, sizeof(record),
+                              points_size + max_ids_size);
+  if (out != nullptr) {
+    if (points_size > 0) {
+      memcpy(out, points, points_size);
+    }
+    uint8_t* ids_out = out + points_size;
+    size_t ids_size = 0;
+    int32_t previous_id = 0;
+    for (uint32_t i = 0; i < record.point_count; ++i) {
+      ids_size += capture::WriteVarint(
+          capture::ZigZagEncode(ids[i] - previous_id), ids_out + ids_size);
+      previous_id = ids[i];
+    }
+    TrimLastRecord(max_ids_size - ids_size);
+    point_cloud_timestamp_ns_ = record.timestamp_ns;
+  }
+  ArPointCloud_release(point_cloud);
+}
+
+void StateCapture::WriteLightEstimate(const ArSession* session,
+                                      const ArFrame* frame) {
+  ArFrame_getLightEstimate(session, frame, light_estimate_);
+  capture::LightEstimateRecord record = {};
+  ArLightEstimate_getTimestamp(session, light_estimate_,
+                               &record.timestamp_ns);
+  if (!resync_ && record.timestamp_ns == light_estimate_timestamp_ns_) {
+    return;
+  }
+  ArLightEstimateState state = AR_LIGHT_ESTIMATE_STATE_NOT_VALID;
+  ArLightEstimate_getState(session, light_estimate_, &state);
+  record.state = state;
+  if (state == AR_LIGHT_ESTIMATE_STATE_VALID) {
+    ArLightEstimate_getColorCorrection(session, light_estimate_,
+                                       record.color_correction);
+    if (options_.spherical_harmonics) {
+      ArLightEstimate_getEnvironmentalHdrAmbientSphericalHarmonics(
+          session, light_estimate_, record.spherical_harmonics);
+    }
+  }
+  if (AppendRecord(capture::kLightEstimate, &record, sizeof(record)) !=
+      nullptr) {
+    light_estimate_timestamp_ns_ = record.timestamp_ns;
+  }
+}
+
+void StateCapture::WriteDepthImage(const ArSession* session,
+                                   const ArImage* depth_image) {
+  if (depth_image == nullptr) {
+    return;
+  }
+  capture::DepthImageRecord record = {};
+  ArImage_getTimestamp(session, depth_image, &record.timestamp_ns);
+  if (!resync_ && record.timestamp_ns == depth_timestamp_ns_) {
+    return;
+  }
+  int32_t width = 0, height = 0, row_stride = 0, data_size = 0;
+  ArImage_getWidth(session, depth_image, &width);
+  ArImage_getHeight(session, depth_image, &height);
+  ArImage_getPlaneRowStride(session, depth_image, 0, &row_stride);
+  const uint8_t* pixels = nullptr;
+  ArImage_getPlaneData(session, depth_image, 0, &pixels, &data_size);
+  if (pixels == nullptr || width <= 0 || height <= 0 ||
+      width > UINT16_MAX || height > UINT16_MAX ||
+      data_size < row_stride * (height - 1) + 2 * width) {
+    return;
+  }
+  record.width = static_cast<uint16_t>(width);
+  record.height = static_cast<uint16_t>(height);
+  const size_t capacity = capture::GetMaxEncodedDepthSize(width, height);
+  uint8_t* out = AppendRecord(capture::kDepthImage, &record, sizeof(record),
+                              capacity);
+  if (out == nullptr) {
+    return;
+  }
+  const size_t encoded_size =
+      capture::EncodeDepth(pixels, width, height, row_stride, out, capacity);
+  if (encoded_size == 0) {
+    chunk_->size = last_record_;
+    return;
+  }
+  record.encoded_size = static_cast<uint32_t>(encoded_size);
+  memcpy(out - sizeof(record), &record, sizeof(record));
+  TrimLastRecord(capacity - encoded_size);
+  depth_timestamp_ns_ = record.timestamp_ns;
+}
+
+void StateCapture::WriteAnchors(const ArSession* session,
+                                const AnchorStore& anchors) {
+  // Counts from 1, so no anchor was seen in frame 0.
+  const uint32_t seen_frame = frame_index_ + 1;
+  for (const AnchorStore::Entry& entry : anchors.GetEntries()) {
+    const auto inserted = anchor_states_.emplace(entry.sequence, AnchorState());
+    AnchorState& state = inserted.first->second;
+    if (inserted.second) {
+      state.id = next_anchor_id_++;
+    }
+    state.seen_frame = seen_frame;
+    float pose[7];
+    memcpy(pose, state.pose, sizeof(pose));
+    if (entry.tracking_state == AR_TRACKING_STATE_TRACKING) {
+      ArAnchor_getPose(session, entry.anchor, pose_);
+      ArPose_getPoseRaw(session, pose_, pose);
+    }
+    if (!resync_ && !inserted.second &&
+        entry.tracking_state == state.tracking_state &&
+        memcmp(pose, state.pose, sizeof(pose)) == 0) {
+      continue;
+    }
+    state.tracking_state = entry.tracking_state;
+    memcpy(state.pose, pose, sizeof(pose));
+    capture::AnchorRecord record = {};
+    record.id = state.id;
+    record.tracking_state = state.tracking_state;
+    memcpy(record.pose, pose, sizeof(pose));
+    AppendRecord(capture::kAnchor, &record, sizeof(record));
+  }
+  // Anchors the app removed stop tracking for good.
+  for (auto it = anchor_states_.begin(); it != anchor_states_.end();) {
+    if (it->second.seen_frame == seen_frame) {
+      ++it;
+      continue;
+    }
+    capture::AnchorRecord record = {};
+    record.id = it->second.id;
+    record.tracking_state = AR_TRACKING_STATE_STOPPED;
+    memcpy(record.pose, it->second.pose, sizeof(record.pose));
+    AppendRecord(capture::kAnchor, &record, sizeof(record));
+    it = anchor_states_.erase(it);
+  }
+}
+
+void StateCapture::SubmitChunk() {
+  // Only kChunkCount chunks exist, so the queue is never full.
+  submitted_chunks_.TryPush(&chunk_);
+  chunk_ = nullptr;
+  chunk_frames_ = 0;
+}
+
+void StateCapture::RunFlushLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stopping_) {
+    wake_.wait_for(lock, kFlushInterval, [this] { return stopping_; });
+    lock.unlock();
+    FlushChunks();
+    lock.lock();
+  }
+}
+
+void StateCapture::FlushChunks() {
+  Chunk* chunk = nullptr;
+  while (submitted_chunks_.TryPop(&chunk)) {
+    if (!write_failed_ && !WriteToFile(chunk->data.get(), chunk->size)) {
+      LOGE("StateCapture: cannot write the capture, dropping the rest");
+      write_failed_ = true;
+    }
+    chunk->size = 0;
+    free_chunks_.TryPush(&chunk);
+  }
+}
+
+bool StateCapture::WriteToFile(const uint8_t* data, size_t size) {
+  while (size > 0) {
+    if (window_ == nullptr ||
+        file_size_ == window_offset_ + kMappingWindowSize) {
+      if (window_ != nullptr) {
+        munmap(window_, kMappingWindowSize);
+        window_ = nullptr;
+        window_offset_ += kMappingWindowSize;
+      }
+      if (ftruncate(fd_, window_offset_ + kMappingWindowSize) != 0) {
+        return false;
+      }
+      void* mapping = mmap(nullptr, kMappingWindowSize, PROT_READ | PROT_WRITE,
+                           MAP_SHARED, fd_, window_offset_);
+      if (mapping == MAP_FAILED) {
+        return false;
+      }
+      window_ = static_cast<uint8_t*>(mapping);
+    }
+    const size_t offset = file_size_ - window_offset_;
+    const size_t count = std::min(size, kMappingWindowSize - offset);
+    memcpy(window_ + offset, data, count);
+    data += count;
+    size -= count;
+    file_size_ += count;
+  }
+  return true;
+}
+
+}  // namespace hello_ar
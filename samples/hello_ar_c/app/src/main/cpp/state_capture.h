@@ -0,0 +1,203 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_STATE_CAPTURE_H_
+#define C_ARCORE_HELLOE_AR_STATE_CAPTURE_H_
+
+#include <chrono>  // NOLINT
+#include <condition_variable>  // NOLINT
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
+#include <thread>  // NOLINT
+#include <unordered_map>
+#include <vector>
+
+#include "anchor_store.h"
+#include "ar_capture_format.h"
+#include "arcore_c_api.h"
+#include "spsc_queue.h"
+
+namespace hello_ar {
+
+// Captures the ARCore state of every frame into a session capture, see
+// ar_capture_format.h, which tools/arcore_replay plays back on a desktop.
+//
+// CaptureFrame() serializes the frame on the OpenGL thread into a chunk, one
+// of kChunkCount preallocated buffers, and only what changed since the last
+// frame: the planes ARCore updated, polygons delta coded in millimeters, the
+// point cloud, light estimate and depth image when their timestamp changed,
+// anchors whose pose or tracking state changed.  Full chunks go through a
+// lock-free queue to a flush thread, which copies them into a memory-mapped
+// window of the file and hands them back, so the OpenGL thread never waits
+// for the file.  The file grows by kMappingWindowSize and is trimmed to its
+// content by Stop().
+//
+// If no chunk is free because the flush thread fell behind, or a frame does
+// not fit a chunk, the frame is dropped and counted, and the next captured
+// frame writes the full state again so the deltas stay consistent.
+//
+// All methods must be called on the thread that updates the session.
+class StateCapture {
+ public:
+  static constexpr size_t kChunkSize = 1 << 20;
+  static constexpr uint32_t kChunkCount = 8;
+  // A chunk is handed to the flush thread once less than this is left, or
+  // it holds kMaxChunkFrames frames, so the file lags at most ~1 s behind.
+  static constexpr size_t kChunkReserve = 256 << 10;
+  static constexpr int kMaxChunkFrames = 30;
+  static constexpr size_t kMappingWindowSize = 16 << 20;
+  static constexpr std::chrono::milliseconds kFlushInterval{20};
+
+  struct Options {
+    // Clip planes of the captured projection matrices.
+    float projection_near = 0.1f;
+    float projection_far = 100.f;
+    // Whether the session estimates Environmental HDR lighting, the only
+    // mode with spherical harmonics.
+    bool spherical_harmonics = false;
+  };
+
+  StateCapture() = default;
+  ~StateCapture();
+
+  StateCapture(const StateCapture&) = delete;
+  StateCapture& operator=(const StateCapture&) = delete;
+
+  // Creates or truncates |path|, writes the camera config of |session| and
+  // starts the flush thread.  Returns false if the file cannot be created.
+  bool Start(const ArSession* session, const std::string& path,
+             const Options& options);
+
+  // Flushes the captured frames, closes the file and releases what was
+  // acquired from ARCore.  Must be called before the session is destroyed.
+  void Stop();
+
+  bool IsRunning() const { return fd_ >= 0; }
+
+  // The display geometry the session was given, which frames do not report.
+  // May be called while not running.
+  void SetDisplayGeometry(int rotation, int width, int height);
+
+  // Captures |frame| after ArSession_update.  |depth_image| is the frame's
+  // DEPTH16 image or nullptr, and |anchors| the anchors of the app.
+  void CaptureFrame(const ArSession* session, const ArFrame* frame,
+                    const ArImage* depth_image, const AnchorStore& anchors);
+
+ private:
+  struct Chunk {
+    std::unique_ptr<uint8_t[]> data;
+    size_t size = 0;
+  };
+
+  // Keyed by AnchorStore::Entry::sequence.
+  struct AnchorState {
+    int32_t id = 0;
+    int32_t tracking_state = AR_TRACKING_STATE_STOPPED;
+    float pose[7] = {};
+    // Frame in which the anchor was last seen in the AnchorStore.
+    uint32_t seen_frame = 0;
+  };
+
+  // Appends a record of |type| with the |size| bytes of |payload| followed
+  // by room for |extra_size| more, and returns the room, or nullptr and
+  // flags the frame as overflowed if the chunk is too full.
+  uint8_t* AppendRecord(capture::RecordType type, const void* payload,
+                        size_t size, size_t extra_size = 0);
+  // Gives back the last |unused_size| bytes of the last record's room.
+  void TrimLastRecord(size_t unused_size);
+
+  void WriteCamera(const ArSession* session, const ArFrame* frame);
+  void WriteDisplayGeometry(const ArSession* session, const ArFrame* frame);
+  void WritePlanes(const ArSession* session, const ArFrame* frame);
+  void WritePlane(const ArSession* session, ArPlane* plane, int32_t id);
+  void WritePointCloud(const ArSession* session, const ArFrame* frame);
+  void WriteLightEstimate(const ArSession* session, const ArFrame* frame);
+  void WriteDepthImage(const ArSession* session, const ArImage* depth_image);
+  void WriteAnchors(const ArSession* session, const AnchorStore& anchors);
+
+  // The capture id of |plane|, whose reference is taken over.
+  int32_t GetPlaneId(ArPlane* plane, bool* is_new);
+
+  // Hands the current chunk to the flush thread.
+  void SubmitChunk();
+
+  // Runs on flush_thread_.
+  void RunFlushLoop();
+  // Copies the submitted chunks into the file and hands them back.  After a
+  // write error the chunks are only handed back.
+  void FlushChunks();
+  bool WriteToFile(const uint8_t* data, size_t size);
+
+  void ReleaseArObjects();
+
+  Options options_;
+  int display_rotation_ = 0;
+  int display_width_ = 0;
+  int display_height_ = 0;
+
+  std::vector<Chunk> chunks_;
+  SpscQueue<Chunk*, kChunkCount> submitted_chunks_;
+  SpscQueue<Chunk*, kChunkCount> free_chunks_;
+
+  // State of the OpenGL thread.
+  Chunk* chunk_ = nullptr;
+  int chunk_frames_ = 0;
+  size_t frame_start_ = 0;
+  size_t last_record_ = 0;
+  bool overflowed_ = false;
+  // Whether the next frame writes everything instead of the changes.
+  bool resync_ = true;
+  uint32_t frame_index_ = 0;
+  uint32_t dropped_frames_ = 0;
+  std::chrono::nanoseconds total_capture_time_{0};
+  std::chrono::nanoseconds max_capture_time_{0};
+
+  // What was written last, to write only the changes.
+  // Each key holds a reference, so ARCore cannot reuse the handle.
+  std::unordered_map<ArPlane*, int32_t> plane_ids_;
+  std::unordered_map<uint64_t, AnchorState> anchor_states_;
+  int32_t next_anchor_id_ = 0;
+  int64_t point_cloud_timestamp_ns_ = -1;
+  int64_t light_estimate_timestamp_ns_ = -1;
+  int64_t depth_timestamp_ns_ = -1;
+  bool display_geometry_dirty_ = true;
+
+  // Reused ARCore objects and buffers.
+  ArPose* pose_ = nullptr;
+  ArCameraIntrinsics* intrinsics_ = nullptr;
+  ArLightEstimate* light_estimate_ = nullptr;
+  ArTrackableList* trackables_ = nullptr;
+  std::vector<float> polygon_;
+
+  // State of the flush thread.
+  int fd_ = -1;
+  uint8_t* window_ = nullptr;
+  size_t window_offset_ = 0;
+  size_t file_size_ = 0;
+  bool write_failed_ = false;
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  bool stopping_ = false;
+  std::thread flush_thread_;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_STATE_CAPTURE_H_
@@ -0,0 +1,202 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "streetscape_geometry_renderer.h"
+
+#include "resource_accounting.h"
+#include "util.h"
+
+namespace hello_ar {
+namespace {
+constexpr char kOwner[] = "StreetscapeGeometryRenderer";
+
+constexpr int kPositionComponents = 3;
+
+// Straight alpha colors of the terrain and the buildings.
+constexpr float kTerrainColor[4] = {0.5f, 0.85f, 0.5f, 0.5f};
+constexpr float kBuildingColor[4] = {0.95f, 0.95f, 0.95f, 0.6f};
+}  // namespace
+
+void StreetscapeGeometryRenderer::InitializeGlContent(
+    AAssetManager* asset_manager) {
+  shader_program_ =
+      util::CreateProgram(ShaderVariant::kStreetscapeGeometry, asset_manager);
+  if (!shader_program_) {
+    LOGE("Could not create program.");
+  }
+  attribute_position_ = glGetAttribLocation(shader_program_, "a_Position");
+  uniform_model_mat_ = glGetUniformLocation(shader_program_, "u_Model");
+  uniform_view_projection_mat_ =
+      glGetUniformLocation(shader_program_, "u_ViewProjection");
+  uniform_color_ = glGetUniformLocation(shader_program_, "u_Color");
+
+  // Buffers of a previous context are gone with it.
+  for (auto& entry : meshes_) {
+    entry.second.vertex_buffer = 0;
+    entry.second.index_buffer = 0;
+    entry.second.needs_upload = true;
+  }
+  util::CheckGlError("StreetscapeGeometryRenderer::InitializeGlContent()");
+}
+
+void StreetscapeGeometryRenderer::UpdateGeometry(
+    const ArSession& ar_session, ArStreetscapeGeometry* geometry) {
+  ArTrackingState tracking_state = AR_TRACKING_STATE_STOPPED;
+  ArTrackable_getTrackingState(&ar_session, ArAsTrackable(geometry),
+                               &tracking_state);
+  auto it = meshes_.find(geometry);
+  if (tracking_state == AR_TRACKING_STATE_STOPPED) {
+    if (it != meshes_.end()) {
+      DeleteBuffers(&it->second);
+      ArTrackable_release(ArAsTrackable(it->second.geometry));
+      meshes_.erase(it);
+    }
+    ArTrackable_release(ArAsTrackable(geometry));
+    return;
+  }
+
+  if (it == meshes_.end()) {
+    GeometryMesh& mesh = meshes_[geometry];
+    mesh.geometry = geometry;
+    ArStreetscapeGeometryType type = AR_STREETSCAPE_GEOMETRY_TYPE_TERRAIN;
+    ArStreetscapeGeometry_getType(&ar_session, geometry, &type);
+    mesh.is_building = type == AR_STREETSCAPE_GEOMETRY_TYPE_BUILDING;
+    return;
+  }
+  // Already holds a reference to the same geometry.
+  ArTrackable_release(ArAsTrackable(geometry));
+  it->second.needs_upload = true;
+}
+
+void StreetscapeGeometryRenderer::Draw(const ArSession& ar_session,
+                                       const glm::mat4& view_projection_mat,
+                                       ArPose* scratch_pose) {
+  uploaded_bytes_ = 0;
+  if (!shader_program_ || meshes_.empty()) {
+    return;
+  }
+
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
+  gl_state.UseProgram(shader_program_);
+  gl_state.DepthMask(GL_FALSE);
+  // The meshes are seen from inside when the camera is under a roof.
+  gl_state.SetCapability(GL_CULL_FACE, false);
+  gl_state.SetCapability(GL_BLEND, true);
+  gl_state.BlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+  gl_state.SetEnabledVertexAttribArrays(1u << attribute_position_);
+  glUniformMatrix4fv(uniform_view_projection_mat_, 1, GL_FALSE,
+                     glm::value_ptr(view_projection_mat));
+
+  for (auto& entry : meshes_) {
+    GeometryMesh& mesh = entry.second;
+    ArTrackingState tracking_state = AR_TRACKING_STATE_STOPPED;
+    ArTrackable_getTrackingState(&ar_session, ArAsTrackable(mesh.geometry),
+                                 &tracking_state);
+    if (tracking_state != AR_TRACKING_STATE_TRACKING) {
+      continue;
+    }
+    if (mesh.needs_upload) {
+      Upload(ar_session, &mesh);
+    }
+    if (mesh.index_count == 0) {
+      continue;
+    }
+
+    glm::mat4 model_mat(1.0f);
+    ArStreetscapeGeometry_getMeshPose(&ar_session, mesh.geometry,
+                                      scratch_pose);
+    ArPose_getMatrix(&ar_session, scratch_pose, glm::value_ptr(model_mat));
+    glUniformMatrix4fv(uniform_model_mat_, 1, GL_FALSE,
+                       glm::value_ptr(model_mat));
+    glUniform4fv(uniform_color_, 1,
+                 mesh.is_building ? kBuildingColor : kTerrainColor);
+
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.vertex_buffer);
+    glVertexAttribPointer(attribute_position_, kPositionComponents, GL_FLOAT,
+                          GL_FALSE, 0, nullptr);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.index_buffer);
+    glDrawElements(GL_TRIANGLES, mesh.index_count, GL_UNSIGNED_INT, nullptr);
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  util::CheckGlError("StreetscapeGeometryRenderer::Draw()");
+}
+
+void StreetscapeGeometryRenderer::Clear() {
+  for (auto& entry : meshes_) {
+    DeleteBuffers(&entry.second);
+    ArTrackable_release(ArAsTrackable(entry.second.geometry));
+  }
+  meshes_.clear();
+}
+
+void StreetscapeGeometryRenderer::Upload(const ArSession& ar_session,
+                                         GeometryMesh* mesh) {
+  mesh->needs_upload = false;
+  mesh->index_count = 0;
+  ArMesh* ar_mesh = nullptr;
+  ArStreetscapeGeometry_acquireMesh(&ar_session, mesh->geometry, &ar_mesh);
+  if (ar_mesh == nullptr) {
+    return;
+  }
+  int32_t vertex_count = 0;
+  int32_t index_count = 0;
+  const float* vertices = nullptr;
+  const uint32_t* indices = nullptr;
+  ArMesh_getVertexListSize(&ar_session, ar_mesh, &vertex_count);
+  ArMesh_getIndexListSize(&ar_session, ar_mesh, &index_count);
+  ArMesh_getVertexList(&ar_session, ar_mesh, &vertices);
+  ArMesh_getIndexList(&ar_session, ar_mesh, &indices);
+
+  if (vertex_count > 0 && index_count > 0) {
+    if (mesh->vertex_buffer == 0) {
+      glGenBuffers(1, &mesh->vertex_buffer);
+      glGenBuffers(1, &mesh->index_buffer);
+    }
+    // The mesh rarely changes after the first upload.
+    const GLsizeiptr vertex_size =
+        vertex_count * kPositionComponents * sizeof(float);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh->vertex_buffer);
+    glBufferData(GL_ARRAY_BUFFER, vertex_size, vertices, GL_STATIC_DRAW);
+    ResourceAccounting::Get().Track(GpuResourceType::kBuffer,
+                                    mesh->vertex_buffer, vertex_size, kOwner);
+    const GLsizeiptr index_size = index_count * sizeof(uint32_t);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->index_buffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_size, indices,
+                 GL_STATIC_DRAW);
+    ResourceAccounting::Get().Track(GpuResourceType::kBuffer,
+                                    mesh->index_buffer, index_size, kOwner);
+    mesh->index_count = index_count;
+    uploaded_bytes_ += vertex_size + index_size;
+  }
+  ArMesh_release(ar_mesh);
+}
+
+void StreetscapeGeometryRenderer::DeleteBuffers(GeometryMesh* mesh) {
+  if (mesh->vertex_buffer == 0) {
+    return;
+  }
+  glDeleteBuffers(1, &mesh->vertex_buffer);
+  glDeleteBuffers(1, &mesh->index_buffer);
+  ResourceAccounting::Get().Untrack(GpuResourceType::kBuffer,
+                                    mesh->vertex_buffer);
+  ResourceAccounting::Get().Untrack(GpuResourceType::kBuffer,
+                                    mesh->index_buffer);
+  mesh->vertex_buffer = 0;
+  mesh->index_buffer = 0;
+}
+
+}  // namespace hello_ar
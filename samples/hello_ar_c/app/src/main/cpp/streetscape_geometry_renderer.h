@@ -0,0 +1,104 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_STREETSCAPE_GEOMETRY_RENDERER_H_
+#define C_ARCORE_HELLOE_AR_STREETSCAPE_GEOMETRY_RENDERER_H_
+
+#include <GLES3/gl3.h>
+#include <android/asset_manager.h>
+
+#include <cstddef>
+#include <unordered_map>
+
+#include "arcore_c_api.h"
+#include "glm.h"
+
+namespace hello_ar {
+
+// Draws the terrain and building meshes of the Streetscape Geometry API.
+//
+// A city block brings hundreds of meshes, so each one is uploaded into its
+// own vertex and index buffer once and then drawn from there.  Only
+// geometries reported by ArFrame_getUpdatedTrackables() are uploaded again,
+// on their next draw.  The mesh pose, which ARCore refines as it localizes,
+// is queried per draw and passed as the model matrix.
+//
+// All methods must be called on the OpenGL thread, which must also be the
+// thread that updates the session.
+class StreetscapeGeometryRenderer {
+ public:
+  StreetscapeGeometryRenderer() = default;
+  ~StreetscapeGeometryRenderer() = default;
+
+  StreetscapeGeometryRenderer(const StreetscapeGeometryRenderer&) = delete;
+  StreetscapeGeometryRenderer& operator=(const StreetscapeGeometryRenderer&) =
+      delete;
+
+  // Initialize the GL content, needs to be called on GL thread.  Geometries
+  // already known are uploaded again into the new context.
+  void InitializeGlContent(AAssetManager* asset_manager);
+
+  // Takes over the reference to an updated |geometry|.  Its mesh is uploaded
+  // again on the next Draw(), or released if it stopped tracking.
+  void UpdateGeometry(const ArSession& ar_session,
+                      ArStreetscapeGeometry* geometry);
+
+  // Draws every tracking geometry, uploading the meshes that changed.
+  // |scratch_pose| receives the mesh poses.
+  void Draw(const ArSession& ar_session, const glm::mat4& view_projection_mat,
+            ArPose* scratch_pose);
+
+  // Releases the buffers and the geometry references, which must happen
+  // before the session is destroyed.
+  void Clear();
+
+  size_t GetGeometryCount() const { return meshes_.size(); }
+
+  // Number of bytes uploaded by the most recent Draw() call.
+  size_t GetUploadedBytesLastDraw() const { return uploaded_bytes_; }
+
+ private:
+  struct GeometryMesh {
+    // The reference taken over by UpdateGeometry().
+    ArStreetscapeGeometry* geometry = nullptr;
+    GLuint vertex_buffer = 0;
+    GLuint index_buffer = 0;
+    GLsizei index_count = 0;
+    bool is_building = false;
+    // Set while the buffers hold no or an outdated copy of the mesh.
+    bool needs_upload = true;
+  };
+
+  // Copies the mesh of |mesh->geometry| into its buffers.
+  void Upload(const ArSession& ar_session, GeometryMesh* mesh);
+
+  static void DeleteBuffers(GeometryMesh* mesh);
+
+  // Keyed by geometry handle, which ARCore keeps stable while a reference to
+  // it is held.
+  std::unordered_map<const ArStreetscapeGeometry*, GeometryMesh> meshes_;
+  size_t uploaded_bytes_ = 0;
+
+  GLuint shader_program_ = 0;
+  GLint attribute_position_ = -1;
+  GLint uniform_model_mat_ = -1;
+  GLint uniform_view_projection_mat_ = -1;
+  GLint uniform_color_ = -1;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_STREETSCAPE_GEOMETRY_RENDERER_H_
@@ -0,0 +1,154 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "temporal_depth_filter.h"
+
+#include <cstring>
+
+#include "resource_accounting.h"
+#include "util.h"
+
+namespace hello_ar {
+namespace {
+constexpr char kOwner[] = "TemporalDepthFilter";
+
+bool IsHalfFloatRenderable() {
+  GLint num_extensions = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &num_extensions);
+  for (GLint i = 0; i < num_extensions; ++i) {
+    const char* extension = reinterpret_cast<const char*>(
+        glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i)));
+    if (extension != nullptr &&
+        (strcmp(extension, "GL_EXT_color_buffer_half_float") == 0 ||
+         strcmp(extension, "GL_EXT_color_buffer_float") == 0)) {
+      return true;
+    }
+  }
+  return false;
+}
+}  // namespace
+
+void TemporalDepthFilter::InitializeGlContent(AAssetManager* asset_manager) {
+  // Objects of a previous context are gone with it.
+  textures_[0] = textures_[1] = 0;
+  framebuffers_[0] = framebuffers_[1] = 0;
+  width_ = 0;
+  height_ = 0;
+  has_history_ = false;
+  shader_program_ = 0;
+  if (!IsHalfFloatRenderable()) {
+    LOGI("Half float render targets are not supported, depth is not "
+         "filtered over time.");
+    return;
+  }
+
+  shader_program_ =
+      util::CreateProgram(ShaderVariant::kTemporalDepth, asset_manager);
+  if (!shader_program_) {
+    LOGE("Could not create temporal depth program.");
+    return;
+  }
+  uniform_depth_ = glGetUniformLocation(shader_program_, "u_Depth");
+  uniform_history_ = glGetUniformLocation(shader_program_, "u_History");
+  uniform_has_history_ = glGetUniformLocation(shader_program_, "u_HasHistory");
+  uniform_has_confidence_ =
+      glGetUniformLocation(shader_program_, "u_HasConfidence");
+  uniform_intrinsics_ = glGetUniformLocation(shader_program_, "u_Intrinsics");
+  uniform_previous_from_current_ =
+      glGetUniformLocation(shader_program_, "u_PreviousFromCurrent");
+  glGenFramebuffers(2, framebuffers_);
+  util::CheckGlError("TemporalDepthFilter::InitializeGlContent()");
+}
+
+void TemporalDepthFilter::Allocate(int depth_width, int depth_height) {
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
+  width_ = depth_width;
+  height_ = depth_height;
+  has_history_ = false;
+  for (int i = 0; i < 2; ++i) {
+    if (textures_[i]) {
+      gl_state.DeleteTexture(textures_[i]);
+    }
+    glGenTextures(1, &textures_[i]);
+    gl_state.BindTexture(GL_TEXTURE_2D, textures_[i]);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    // Bilinear like the depth texture it stands in for.  The filter itself
+    // only fetches texels.
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RG16F, width_, height_);
+    ResourceAccounting::Get().Track(
+        GpuResourceType::kTexture, textures_[i],
+        GetTextureBytes(GL_RG16F, width_, height_), kOwner);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffers_[i]);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                           textures_[i], 0);
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void TemporalDepthFilter::Update(GLuint depth_texture_id, int depth_width,
+                                 int depth_height, bool has_confidence,
+                                 const glm::vec4& intrinsics,
+                                 const glm::mat4& camera_pose_mat) {
+  if (!shader_program_ || depth_texture_id == 0 || depth_width <= 0 ||
+      depth_height <= 0 || intrinsics.x <= 0.f || intrinsics.y <= 0.f) {
+    return;
+  }
+  if (depth_width != width_ || depth_height != height_ || !textures_[0]) {
+    Allocate(depth_width, depth_height);
+  }
+
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
+  const int next = 1 - current_;
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffers_[next]);
+  glViewport(0, 0, width_, height_);
+  gl_state.SetCapability(GL_DEPTH_TEST, false);
+  gl_state.SetCapability(GL_BLEND, false);
+  gl_state.DepthMask(GL_FALSE);
+  gl_state.UseProgram(shader_program_);
+  // The fullscreen triangle comes from gl_VertexID.
+  gl_state.SetEnabledVertexAttribArrays(0);
+  gl_state.ActiveTexture(GL_TEXTURE0);
+  gl_state.BindTexture(GL_TEXTURE_2D, depth_texture_id);
+  glUniform1i(uniform_depth_, 0);
+  gl_state.ActiveTexture(GL_TEXTURE1);
+  gl_state.BindTexture(GL_TEXTURE_2D, textures_[current_]);
+  glUniform1i(uniform_history_, 1);
+  glUniform1i(uniform_has_history_, has_history_);
+  glUniform1i(uniform_has_confidence_, has_confidence);
+  glUniform4fv(uniform_intrinsics_, 1, glm::value_ptr(intrinsics));
+  const glm::mat4 previous_from_current =
+      previous_world_to_camera_ * camera_pose_mat;
+  glUniformMatrix4fv(uniform_previous_from_current_, 1, GL_FALSE,
+                     glm::value_ptr(previous_from_current));
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+
+  current_ = next;
+  has_history_ = true;
+  previous_world_to_camera_ = glm::inverse(camera_pose_mat);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+  gl_state.SetCapability(GL_DEPTH_TEST, true);
+  util::CheckGlError("TemporalDepthFilter::Update()");
+}
+
+}  // namespace hello_ar
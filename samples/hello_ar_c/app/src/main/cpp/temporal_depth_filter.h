@@ -0,0 +1,100 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_TEMPORAL_DEPTH_FILTER_H_
+#define C_ARCORE_HELLOE_AR_TEMPORAL_DEPTH_FILTER_H_
+
+// clang-format off
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+// clang-format on
+#include <android/asset_manager.h>
+
+#include "glm.h"
+
+namespace hello_ar {
+
+// Steadies depth at edges, where raw and smoothed depth flicker from image to
+// image, by accumulating it over time on the GPU.
+//
+// Update() runs one render pass per new depth image.  Every texel is
+// unprojected at its new depth, moved into the camera of the previous image
+// with the change in camera pose, and looked up in the previous result.
+// Where that history saw the same surface it is blended with the new depth,
+// weighted by both of their confidences; where it did not, for example
+// where the camera uncovered something, the new depth is kept as is.  Depth
+// missing from the new image is carried over from the history with a
+// decaying confidence, so gaps fill in without holding on to stale depth.
+//
+// The result is an RG16F texture in the format Texture writes for raw depth,
+// meters and confidence, so it can replace the depth texture for occlusion.
+// Rendering to it needs GL_EXT_color_buffer_half_float or
+// GL_EXT_color_buffer_float; without either, GetTextureId() stays 0.
+class TemporalDepthFilter {
+ public:
+  TemporalDepthFilter() = default;
+  ~TemporalDepthFilter() = default;
+
+  // Initialize the GL content, needs to be called on GL thread.
+  void InitializeGlContent(AAssetManager* asset_manager);
+
+  // Filters the new image in |depth_texture_id|, which is in the format
+  // written by Texture.
+  //
+  // @param has_confidence, whether the texture holds raw depth and its
+  //     confidence.
+  // @param intrinsics, focal length (xy) and principal point (zw) in depth
+  //     pixels.
+  // @param camera_pose_mat, the camera sensor pose of the image.
+  void Update(GLuint depth_texture_id, int depth_width, int depth_height,
+              bool has_confidence, const glm::vec4& intrinsics,
+              const glm::mat4& camera_pose_mat);
+
+  // Forgets the history, so the next Update() starts over from its image.
+  // Called when the camera poses of consecutive images no longer relate,
+  // e.g. after tracking was lost.
+  void Reset() { has_history_ = false; }
+
+  // The filtered depth of the last image, or 0 until Update() succeeded.
+  GLuint GetTextureId() const {
+    return has_history_ ? textures_[current_] : 0;
+  }
+
+ private:
+  void Allocate(int depth_width, int depth_height);
+
+  // The result of the last Update() is textures_[current_], the other one is
+  // written next.
+  GLuint textures_[2] = {0, 0};
+  GLuint framebuffers_[2] = {0, 0};
+  int current_ = 0;
+  int width_ = 0;
+  int height_ = 0;
+  bool has_history_ = false;
+  glm::mat4 previous_world_to_camera_ = glm::mat4(1.0f);
+
+  GLuint shader_program_ = 0;
+  GLint uniform_depth_ = -1;
+  GLint uniform_history_ = -1;
+  GLint uniform_has_history_ = -1;
+  GLint uniform_has_confidence_ = -1;
+  GLint uniform_intrinsics_ = -1;
+  GLint uniform_previous_from_current_ = -1;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_TEMPORAL_DEPTH_FILTER_H_
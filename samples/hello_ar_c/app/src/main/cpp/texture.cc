@@ -20,66 +20,336 @@
 #include <GLES3/gl31.h>
 #include <GLES2/gl2ext.h>
 // clang-format on
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include <cstdint>
+#include <cstring>
+
+#include "arcore_trace.h"
+#include "resource_accounting.h"
 #include "util.h"
 
 namespace hello_ar {
 
-void Texture::CreateOnGlThread() {
-  GLuint texture_id_array[1];
-  glGenTextures(1, texture_id_array);
-  texture_id_ = texture_id_array[0];
+namespace {
+constexpr char kOwner[] = "DepthTexture";
+constexpr float kMetersPerMillimeter = 0.001f;
+constexpr int64_t kUploadRateWindowNs = 1000000000;
+
+// Half float bits of |value|, which must be zero or a normal half float.
+uint16_t FloatToHalf(float value) {
+  uint32_t bits = 0;
+  memcpy(&bits, &value, sizeof(bits));
+  if ((bits & 0x7fffffff) == 0) {
+    return 0;
+  }
+  // Rebiases the exponent from 127 to 15 and rounds the mantissa to 10 bits;
+  // a carry out of the mantissa correctly bumps the exponent.
+  const uint32_t half = ((bits >> 16) & 0x8000) |
+                        (((bits & 0x7f800000) - 0x38000000) >> 13) |
+                        ((bits >> 13) & 0x03ff);
+  return static_cast<uint16_t>(half + ((bits >> 12) & 1));
+}
 
-  glBindTexture(GL_TEXTURE_2D, texture_id_);
+// Converts |count| depth values from millimeters to half float meters.
+void ConvertDepthRow(const uint16_t* depth_mm, int count,
+                     uint16_t* depth_m) {
+  int i = 0;
+#if defined(__aarch64__)
+  const float32x4_t scale = vdupq_n_f32(kMetersPerMillimeter);
+  for (; i + 8 <= count; i += 8) {
+    const uint16x8_t millimeters = vld1q_u16(depth_mm + i);
+    const float32x4_t low = vmulq_f32(
+        vcvtq_f32_u32(vmovl_u16(vget_low_u16(millimeters))), scale);
+    const float32x4_t high = vmulq_f32(
+        vcvtq_f32_u32(vmovl_u16(vget_high_u16(millimeters))), scale);
+    vst1q_u16(depth_m + i,
+              vcombine_u16(vreinterpret_u16_f16(vcvt_f16_f32(low)),
+                           vreinterpret_u16_f16(vcvt_f16_f32(high))));
+  }
+#endif  // __aarch64__
+  for (; i < count; ++i) {
+    depth_m[i] = FloatToHalf(depth_mm[i] * kMetersPerMillimeter);
+  }
+}
+
+void SetDefaultTextureParameters() {
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 }
+}  // namespace
 
-void Texture::UpdateWithDepthImageOnGlThread(const ArSession& session,
-                                             const ArFrame& frame) {
-  ArImage* depth_image = nullptr;
-  if (ArFrame_acquireDepthImage16Bits(&session, &frame, &depth_image) !=
-      AR_SUCCESS) {
-    // No depth image received for this frame.
-    return;
+void Texture::CreateOnGlThread() {
+  GLuint texture_id_array[1];
+  glGenTextures(1, texture_id_array);
+  texture_id_ = texture_id_array[0];
+
+  // Allocates a placeholder until the first depth image arrives, so that the
+  // texture is complete when sampled.
+  util::GlStateCache::Get().BindTexture(GL_TEXTURE_2D, texture_id_);
+  SetDefaultTextureParameters();
+  glTexStorage2D(GL_TEXTURE_2D, 1, GL_R16F, width_, height_);
+  internal_format_ = GL_R16F;
+  ResourceAccounting::Get().Track(GpuResourceType::kTexture, texture_id_,
+                                  GetTextureBytes(GL_R16F, width_, height_),
+                                  kOwner);
+
+  glGenBuffers(kNumPixelBuffers, pixel_buffers_.data());
+  pixel_buffer_sizes_.fill(0);
+  current_pixel_buffer_ = 0;
+
+  uploaded_timestamp_ns_ = -1;
+  upload_window_start_ns_ = -1;
+  uploads_in_window_ = 0;
+  uploads_per_second_ = 0.f;
+}
+
+void Texture::AllocateStorage(int width, int height,
+                              unsigned int internal_format) {
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
+  gl_state.DeleteTexture(texture_id_);
+  glGenTextures(1, &texture_id_);
+  gl_state.BindTexture(GL_TEXTURE_2D, texture_id_);
+  SetDefaultTextureParameters();
+  glTexStorage2D(GL_TEXTURE_2D, 1, internal_format, width, height);
+  ResourceAccounting::Get().Track(
+      GpuResourceType::kTexture, texture_id_,
+      GetTextureBytes(internal_format, width, height), kOwner);
+  width_ = width;
+  height_ = height;
+  internal_format_ = internal_format;
+}
+
+bool Texture::UpdateWithDepthImageOnGlThread(const ArSession& session,
+                                             FrameImageCache* frame_images) {
+  if (depth_source_ == DepthSource::kRawWithConfidence) {
+    const ArImage* depth_image =
+        frame_images->Get(FrameImageCache::ImageType::kRawDepth);
+    // The confidence image is only acquired for a new depth image.
+    if (depth_image == nullptr || IsUploaded(session, *depth_image)) {
+      return false;
+    }
+    const ArImage* confidence_image =
+        frame_images->Get(FrameImageCache::ImageType::kRawDepthConfidence);
+    return confidence_image != nullptr &&
+           UpdateWithRawDepthImagesOnGlThread(session, *depth_image,
+                                              *confidence_image);
+  }
+
+  const ArImage* depth_image =
+      frame_images->Get(FrameImageCache::ImageType::kDepth);
+  // No depth image received for this frame.
+  return depth_image != nullptr &&
+         UpdateWithDepthImageOnGlThread(session, *depth_image);
+}
+
+bool Texture::UpdateWithDepthImageOnGlThread(const ArSession& session,
+                                             const ArImage& image) {
+  const ArImage* depth_image = &image;
+  if (IsUploaded(session, image)) {
+    return false;
   }
   // Checks that the format is as expected.
   ArImageFormat image_format;
   ArImage_getFormat(&session, depth_image, &image_format);
   if (image_format != AR_IMAGE_FORMAT_D_16) {
     LOGE("Unexpected image format 0x%x", image_format);
-    ArImage_release(depth_image);
     abort();
-    return;
+    return false;
   }
 
   const uint8_t* depth_data = nullptr;
   int plane_size_bytes = 0;
-  ArImage_getPlaneData(&session, depth_image, /*plane_index=*/0, &depth_data,
-                       &plane_size_bytes);
+  traced::ArImage_getPlaneData(&session, depth_image, /*plane_index=*/0,
+                               &depth_data, &plane_size_bytes);
 
   // Bails out if there's no depth_data.
-  if (depth_data == nullptr) {
-    ArImage_release(depth_image);
-    return;
+  if (depth_data == nullptr || plane_size_bytes <= 0) {
+    return false;
   }
 
   // Sets texture sizes.
   int image_width = 0;
   int image_height = 0;
-  int image_pixel_stride = 0;
   int image_row_stride = 0;
   ArImage_getWidth(&session, depth_image, &image_width);
   ArImage_getHeight(&session, depth_image, &image_height);
-  ArImage_getPlanePixelStride(&session, depth_image, 0, &image_pixel_stride);
   ArImage_getPlaneRowStride(&session, depth_image, 0, &image_row_stride);
-  ArImage_release(depth_image);
-  glBindTexture(GL_TEXTURE_2D, texture_id_);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RG8, image_width, image_height, 0, GL_RG,
-               GL_UNSIGNED_BYTE, depth_data);
-  width_ = image_width;
-  height_ = image_height;
+
+  if (image_width != static_cast<int>(width_) ||
+      image_height != static_cast<int>(height_) ||
+      internal_format_ != GL_R16F) {
+    AllocateStorage(image_width, image_height, GL_R16F);
+  }
+
+  // The image plane data is only valid until the image is released, so it is
+  // converted into the staging buffer right away, dropping the row padding.
+  uint16_t* staging = static_cast<uint16_t*>(
+      MapNextPixelBuffer(image_width * image_height * sizeof(uint16_t)));
+  if (staging == nullptr) {
+    return false;
+  }
+  for (int y = 0; y < image_height; ++y) {
+    ConvertDepthRow(
+        reinterpret_cast<const uint16_t*>(depth_data + y * image_row_stride),
+        image_width, staging + y * image_width);
+  }
+  UploadPixelBuffer(image_width, image_height, image_width, GL_RED,
+                    GL_HALF_FLOAT);
+  RecordUpload(session, image);
+  return true;
+}
+
+bool Texture::UpdateWithRawDepthImagesOnGlThread(
+    const ArSession& session, const ArImage& depth_image,
+    const ArImage& confidence_image) {
+  if (IsUploaded(session, depth_image)) {
+    return false;
+  }
+  ArImageFormat depth_format;
+  ArImageFormat confidence_format;
+  ArImage_getFormat(&session, &depth_image, &depth_format);
+  ArImage_getFormat(&session, &confidence_image, &confidence_format);
+  if (depth_format != AR_IMAGE_FORMAT_D_16 ||
+      confidence_format != AR_IMAGE_FORMAT_Y8) {
+    LOGE("Unexpected raw depth image formats 0x%x, 0x%x", depth_format,
+         confidence_format);
+    abort();
+    return false;
+  }
+
+  int width = 0;
+  int height = 0;
+  int confidence_width = 0;
+  int confidence_height = 0;
+  ArImage_getWidth(&session, &depth_image, &width);
+  ArImage_getHeight(&session, &depth_image, &height);
+  ArImage_getWidth(&session, &confidence_image, &confidence_width);
+  ArImage_getHeight(&session, &confidence_image, &confidence_height);
+  if (width != confidence_width || height != confidence_height) {
+    LOGE("Raw depth is %dx%d but its confidence %dx%d", width, height,
+         confidence_width, confidence_height);
+    return false;
+  }
+
+  const uint8_t* depth_data = nullptr;
+  const uint8_t* confidence_data = nullptr;
+  int depth_size_bytes = 0;
+  int confidence_size_bytes = 0;
+  traced::ArImage_getPlaneData(&session, &depth_image, /*plane_index=*/0,
+                               &depth_data, &depth_size_bytes);
+  traced::ArImage_getPlaneData(&session, &confidence_image, /*plane_index=*/0,
+                               &confidence_data, &confidence_size_bytes);
+  if (depth_data == nullptr || confidence_data == nullptr || width <= 0 ||
+      height <= 0) {
+    return false;
+  }
+  int depth_row_stride = 0;
+  int confidence_row_stride = 0;
+  ArImage_getPlaneRowStride(&session, &depth_image, 0, &depth_row_stride);
+  ArImage_getPlaneRowStride(&session, &confidence_image, 0,
+                            &confidence_row_stride);
+
+  if (width != static_cast<int>(width_) ||
+      height != static_cast<int>(height_) || internal_format_ != GL_RG16F) {
+    AllocateStorage(width, height, GL_RG16F);
+  }
+
+  // The two planes are interleaved into depth and confidence, so sampling the
+  // texture once yields both.
+  uint16_t half_confidences[256];
+  for (int confidence = 0; confidence < 256; ++confidence) {
+    half_confidences[confidence] = FloatToHalf(confidence / 255.f);
+  }
+  converted_row_.resize(width);
+  constexpr int kComponentsPerTexel = 2;
+  uint16_t* staging = static_cast<uint16_t*>(MapNextPixelBuffer(
+      width * height * kComponentsPerTexel * sizeof(uint16_t)));
+  if (staging == nullptr) {
+    return false;
+  }
+  for (int y = 0; y < height; ++y) {
+    ConvertDepthRow(
+        reinterpret_cast<const uint16_t*>(depth_data + y * depth_row_stride),
+        width, converted_row_.data());
+    const uint8_t* confidence_row = confidence_data + y * confidence_row_stride;
+    uint16_t* texel = staging + y * width * kComponentsPerTexel;
+    for (int x = 0; x < width; ++x) {
+      texel[0] = converted_row_[x];
+      texel[1] = half_confidences[confidence_row[x]];
+      texel += kComponentsPerTexel;
+    }
+  }
+  UploadPixelBuffer(width, height, width, GL_RG, GL_HALF_FLOAT);
+  RecordUpload(session, depth_image);
+  return true;
+}
+
+bool Texture::IsUploaded(const ArSession& session,
+                         const ArImage& depth_image) const {
+  int64_t timestamp_ns = 0;
+  ArImage_getTimestamp(&session, &depth_image, &timestamp_ns);
+  return timestamp_ns == uploaded_timestamp_ns_;
+}
+
+void Texture::RecordUpload(const ArSession& session,
+                           const ArImage& depth_image) {
+  ArImage_getTimestamp(&session, &depth_image, &uploaded_timestamp_ns_);
+  // The rate is measured in image time, so it is also right for datasets
+  // played back faster or slower than they were recorded.
+  if (upload_window_start_ns_ < 0 ||
+      uploaded_timestamp_ns_ < upload_window_start_ns_) {
+    upload_window_start_ns_ = uploaded_timestamp_ns_;
+    uploads_in_window_ = 0;
+    return;
+  }
+  ++uploads_in_window_;
+  const int64_t elapsed_ns = uploaded_timestamp_ns_ - upload_window_start_ns_;
+  if (elapsed_ns >= kUploadRateWindowNs) {
+    uploads_per_second_ =
+        uploads_in_window_ * 1e9f / static_cast<float>(elapsed_ns);
+    upload_window_start_ns_ = uploaded_timestamp_ns_;
+    uploads_in_window_ = 0;
+  }
+}
+
+void* Texture::MapNextPixelBuffer(int size) {
+  // Invalidating the whole buffer lets the driver hand out fresh memory
+  // instead of waiting for the previous upload from this buffer to finish.
+  current_pixel_buffer_ = (current_pixel_buffer_ + 1) % kNumPixelBuffers;
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixel_buffers_[current_pixel_buffer_]);
+  if (pixel_buffer_sizes_[current_pixel_buffer_] < size) {
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    pixel_buffer_sizes_[current_pixel_buffer_] = size;
+    ResourceAccounting::Get().Track(GpuResourceType::kBuffer,
+                                    pixel_buffers_[current_pixel_buffer_],
+                                    size, kOwner);
+  }
+  void* staging =
+      glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+                       GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+  if (staging == nullptr) {
+    LOGE("Texture::MapNextPixelBuffer glMapBufferRange failed.");
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  }
+  return staging;
+}
+
+void Texture::UploadPixelBuffer(int width, int height, int row_length,
+                                unsigned int format, unsigned int type) {
+  glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+  util::GlStateCache::Get().BindTexture(GL_TEXTURE_2D, texture_id_);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, row_length);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format, type,
+                  nullptr);
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
 }
 
 }  // namespace hello_ar
@@ -17,31 +17,106 @@
 #ifndef THIRD_PARTY_ARCORE_JAVA_COM_GOOGLE_AR_CORE_EXAMPLES_C_HELLOAR_CPP_TEXTURE_H_
 #define THIRD_PARTY_ARCORE_JAVA_COM_GOOGLE_AR_CORE_EXAMPLES_C_HELLOAR_CPP_TEXTURE_H_
 
+#include <array>
+#include <cstdint>
+#include <vector>
+
 #include "arcore_c_api.h"
+#include "frame_image_cache.h"
 
 namespace hello_ar {
 
 /**
  * Handle the creation and update of a GPU texture.
+ *
+ * The texture uses immutable storage that is only reallocated when the depth
+ * resolution changes.  Since immutable storage cannot be resized, this also
+ * replaces the texture object, so callers must re-query GetTextureId() after
+ * each update.  Pixel data is staged through a ring of pixel unpack buffers,
+ * which lets the driver copy into the texture asynchronously.
+ *
+ * Depth is converted to meters on upload and stored as half floats in the
+ * red component, so shaders read it with a single lookup and linear
+ * filtering interpolates depths rather than their bytes.  Raw depth comes
+ * with its confidence in the green component, normalized to [0, 1];
+ * smoothed depth has none and reads zero there.
  **/
 class Texture {
  public:
+  // Which depth images UpdateWithDepthImageOnGlThread(session, frame_images)
+  // reads.  Raw depth is not filtered over time, so it follows fast moving
+  // occluders like hands with less lag, but has holes and noise that the
+  // confidence tells apart.
+  enum class DepthSource { kSmoothed, kRawWithConfidence };
+
   Texture() = default;
   ~Texture() = default;
 
   void CreateOnGlThread();
-  void UpdateWithDepthImageOnGlThread(const ArSession& session,
-                                      const ArFrame& frame);
+  void SetDepthSource(DepthSource depth_source) {
+    depth_source_ = depth_source;
+  }
+  // Uploads the depth image of the current frame from |frame_images|.  Depth
+  // arrives at a lower rate than camera frames, so an image with the
+  // timestamp of the last uploaded one is neither converted nor uploaded.
+  // Returns true if a new image was uploaded.
+  bool UpdateWithDepthImageOnGlThread(const ArSession& session,
+                                      FrameImageCache* frame_images);
+  // Uploads an already acquired depth image, unless it was uploaded already.
+  // The caller keeps ownership of |depth_image|.
+  bool UpdateWithDepthImageOnGlThread(const ArSession& session,
+                                      const ArImage& depth_image);
+  // Uploads already acquired raw depth and raw depth confidence images of the
+  // same frame, unless they were uploaded already.  The caller keeps
+  // ownership of both.
+  bool UpdateWithRawDepthImagesOnGlThread(const ArSession& session,
+                                          const ArImage& depth_image,
+                                          const ArImage& confidence_image);
   unsigned int GetTextureId() { return texture_id_; }
 
   unsigned int GetWidth() { return width_; }
 
   unsigned int GetHeight() { return height_; }
 
+  // Depth images uploaded per second of image time, over the last second.
+  float GetUploadsPerSecond() const { return uploads_per_second_; }
+
  private:
+  static constexpr int kNumPixelBuffers = 3;
+
+  // Replaces the texture with one whose immutable storage matches the given
+  // size and format.
+  void AllocateStorage(int width, int height, unsigned int internal_format);
+
+  // Maps |size| bytes of the next pixel unpack buffer and leaves it bound, or
+  // returns nullptr with nothing bound.
+  void* MapNextPixelBuffer(int size);
+  // Unmaps the bound pixel unpack buffer and copies it into the texture, whose
+  // rows are |row_length| pixels apart in the buffer.
+  void UploadPixelBuffer(int width, int height, int row_length,
+                         unsigned int format, unsigned int type);
+
+  // Whether |depth_image| has the timestamp of the last uploaded image.
+  bool IsUploaded(const ArSession& session, const ArImage& depth_image) const;
+  void RecordUpload(const ArSession& session, const ArImage& depth_image);
+
   unsigned int texture_id_ = 0;
   unsigned int width_ = 1;
   unsigned int height_ = 1;
+  unsigned int internal_format_ = 0;
+  DepthSource depth_source_ = DepthSource::kSmoothed;
+
+  std::array<unsigned int, kNumPixelBuffers> pixel_buffers_ = {};
+  std::array<int, kNumPixelBuffers> pixel_buffer_sizes_ = {};
+  int current_pixel_buffer_ = 0;
+
+  // One converted row of raw depth before it is interleaved.
+  std::vector<uint16_t> converted_row_;
+
+  int64_t uploaded_timestamp_ns_ = -1;
+  int64_t upload_window_start_ns_ = -1;
+  int uploads_in_window_ = 0;
+  float uploads_per_second_ = 0.f;
 };
 }  // namespace hello_ar
 
@@ -0,0 +1,133 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "thermal_governor.h"
+
+#include <dlfcn.h>
+
+#include <cmath>
+#include <limits>
+
+#include "util.h"
+
+namespace hello_ar {
+namespace {
+// Seconds ahead the headroom is forecast for.
+constexpr int kHeadroomForecastSeconds = 10;
+// Headroom above which the governor steps down before the status changes.
+constexpr float kStepDownHeadroom = 0.95f;
+// Headroom below which the device counts as cool.
+constexpr float kStepUpHeadroom = 0.75f;
+// Frames may take this much longer than the budget before a warm device
+// counts as throttled, absorbing the jitter of the display and camera clocks.
+constexpr float kFrameOverrunFactor = 1.25f;
+}  // namespace
+
+ThermalMonitor::ThermalMonitor() {
+  library_ = dlopen("libandroid.so", RTLD_NOW | RTLD_LOCAL);
+  if (library_ == nullptr) {
+    return;
+  }
+  const auto acquire_manager = reinterpret_cast<AcquireManagerFunction>(
+      dlsym(library_, "AThermal_acquireManager"));
+  release_manager_ = reinterpret_cast<ReleaseManagerFunction>(
+      dlsym(library_, "AThermal_releaseManager"));
+  get_status_ = reinterpret_cast<GetStatusFunction>(
+      dlsym(library_, "AThermal_getCurrentThermalStatus"));
+  // Only on Android 12 and later.
+  get_headroom_ = reinterpret_cast<GetHeadroomFunction>(
+      dlsym(library_, "AThermal_getThermalHeadroom"));
+  if (acquire_manager == nullptr || release_manager_ == nullptr ||
+      get_status_ == nullptr) {
+    LOGI("ThermalMonitor: the AThermal API is not available");
+    return;
+  }
+  manager_ = acquire_manager();
+}
+
+ThermalMonitor::~ThermalMonitor() {
+  if (manager_ != nullptr) {
+    release_manager_(manager_);
+  }
+  if (library_ != nullptr) {
+    dlclose(library_);
+  }
+}
+
+ThermalMonitor::Reading ThermalMonitor::Read() {
+  Reading reading;
+  reading.headroom = std::numeric_limits<float>::quiet_NaN();
+  if (manager_ == nullptr) {
+    return reading;
+  }
+  reading.status = get_status_(manager_);
+  if (get_headroom_ != nullptr) {
+    reading.headroom = get_headroom_(manager_, kHeadroomForecastSeconds);
+  }
+  return reading;
+}
+
+constexpr std::chrono::seconds ThermalGovernor::kStepDownInterval;
+constexpr std::chrono::seconds ThermalGovernor::kSevereStepDownInterval;
+constexpr std::chrono::seconds ThermalGovernor::kStepUpDelay;
+constexpr int ThermalGovernor::kNoChange;
+
+void ThermalGovernor::Reset(float frame_budget_ms) {
+  level_ = 0;
+  frame_budget_ms_ = frame_budget_ms;
+  last_change_ = std::chrono::steady_clock::time_point();
+  last_warm_ = std::chrono::steady_clock::now();
+}
+
+int ThermalGovernor::Update(const ThermalMonitor::Reading& reading,
+                            float average_frame_ms,
+                            std::chrono::steady_clock::time_point now) {
+  // A NaN headroom compares false either way and leaves the status alone.
+  const bool has_headroom = !std::isnan(reading.headroom);
+  const bool is_severe = reading.status >= ATHERMAL_STATUS_SEVERE;
+  const bool is_warm = reading.status >= ATHERMAL_STATUS_LIGHT ||
+                       (has_headroom && reading.headroom >= kStepUpHeadroom);
+  const bool is_overrunning =
+      average_frame_ms > frame_budget_ms_ * kFrameOverrunFactor;
+  const bool under_pressure =
+      reading.status >= ATHERMAL_STATUS_MODERATE ||
+      (has_headroom && reading.headroom >= kStepDownHeadroom) ||
+      (is_warm && is_overrunning);
+
+  if (is_warm || is_overrunning) {
+    last_warm_ = now;
+  }
+
+  if (under_pressure) {
+    const auto interval =
+        is_severe ? kSevereStepDownInterval : kStepDownInterval;
+    if (level_ < kNumQualitySteps && now - last_change_ >= interval) {
+      ++level_;
+      last_change_ = now;
+      return level_;
+    }
+    return kNoChange;
+  }
+
+  if (level_ > 0 && now - last_warm_ >= kStepUpDelay &&
+      now - last_change_ >= kStepUpDelay) {
+    --level_;
+    last_change_ = now;
+    return level_;
+  }
+  return kNoChange;
+}
+
+}  // namespace hello_ar
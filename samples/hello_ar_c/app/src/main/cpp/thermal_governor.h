@@ -0,0 +1,121 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef C_ARCORE_HELLOE_AR_THERMAL_GOVERNOR_H_
+#define C_ARCORE_HELLOE_AR_THERMAL_GOVERNOR_H_
+
+#include <android/thermal.h>
+
+#include <chrono>  // NOLINT
+
+namespace hello_ar {
+
+// What the ThermalGovernor gives up under thermal pressure, in this order.
+// Quality level N means the first N steps are taken.
+enum class QualityStep {
+  kDepth = 0,
+  kPointCloudDensity,
+  kLodBias,
+  kRenderResolution,
+  kCameraFps,
+  kInstantPlacement,
+  kCount
+};
+
+constexpr int kNumQualitySteps = static_cast<int>(QualityStep::kCount);
+
+// Whether |step| is taken at quality |level|.
+inline bool IsQualityStepTaken(int level, QualityStep step) {
+  return level > static_cast<int>(step);
+}
+
+// The device's thermal status and headroom, read through the AThermal API of
+// Android 11 (headroom: Android 12).  The library is looked up at runtime,
+// since the sample supports older releases, where nothing is reported.
+class ThermalMonitor {
+ public:
+  struct Reading {
+    AThermalStatus status = ATHERMAL_STATUS_NONE;
+    // Forecast fraction of the headroom to severe throttling that is used up,
+    // 1 meaning severe throttling.  NaN if unknown.
+    float headroom = 0.f;
+  };
+
+  ThermalMonitor();
+  ~ThermalMonitor();
+
+  ThermalMonitor(const ThermalMonitor&) = delete;
+  ThermalMonitor& operator=(const ThermalMonitor&) = delete;
+
+  bool IsSupported() const { return manager_ != nullptr; }
+
+  // The system rate limits headroom queries, so this should be called at most
+  // about once per second.
+  Reading Read();
+
+ private:
+  using AcquireManagerFunction = AThermalManager* (*)();
+  using ReleaseManagerFunction = void (*)(AThermalManager*);
+  using GetStatusFunction = AThermalStatus (*)(AThermalManager*);
+  using GetHeadroomFunction = float (*)(AThermalManager*, int);
+
+  void* library_ = nullptr;
+  AThermalManager* manager_ = nullptr;
+  ReleaseManagerFunction release_manager_ = nullptr;
+  GetStatusFunction get_status_ = nullptr;
+  GetHeadroomFunction get_headroom_ = nullptr;
+};
+
+// Steps the rendering quality down while the device heats up and back up once
+// it has cooled down.
+//
+// The app calls Update() about once a second with a thermal reading and the
+// average frame time since the previous call.  The governor steps down one
+// level when the status reaches moderate, the headroom is nearly used up, or
+// frames overrun the budget while the device is warm.  Steps are at least
+// kStepDownInterval apart so each one gets to show its effect, or
+// kSevereStepDownInterval once throttling is severe.  It steps back up a
+// level after conditions stayed cool for kStepUpDelay, which keeps it from
+// oscillating around a thermal threshold.
+class ThermalGovernor {
+ public:
+  static constexpr std::chrono::seconds kStepDownInterval{10};
+  static constexpr std::chrono::seconds kSevereStepDownInterval{2};
+  static constexpr std::chrono::seconds kStepUpDelay{30};
+  // Returned by Update() if the current level should be kept.
+  static constexpr int kNoChange = -1;
+
+  ThermalGovernor() = default;
+
+  // Starts at full quality with a frame budget of |frame_budget_ms|.
+  void Reset(float frame_budget_ms);
+
+  // Returns the quality level to switch to, or kNoChange.
+  int Update(const ThermalMonitor::Reading& reading, float average_frame_ms,
+             std::chrono::steady_clock::time_point now);
+
+  int GetLevel() const { return level_; }
+
+ private:
+  int level_ = 0;
+  float frame_budget_ms_ = 0.f;
+  std::chrono::steady_clock::time_point last_change_;
+  // The last time conditions were not cool enough to step up.
+  std::chrono::steady_clock::time_point last_warm_;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_THERMAL_GOVERNOR_H_
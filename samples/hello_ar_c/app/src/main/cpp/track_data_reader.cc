@@ -0,0 +1,74 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "track_data_reader.h"
+
+namespace hello_ar {
+
+constexpr int TrackDataReader::kMaxPayloads;
+
+TrackDataReader::~TrackDataReader() { Release(); }
+
+int TrackDataReader::Read(const ArSession* session, const ArFrame* frame,
+                          const uint8_t* track_id) {
+  ReleasePayloads();
+  if (list_ == nullptr) {
+    ArTrackDataList_create(session, &list_);
+  }
+
+  ArFrame_getUpdatedTrackData(session, frame, track_id, list_);
+  int32_t size = 0;
+  ArTrackDataList_getSize(session, list_, &size);
+  for (int32_t i = 0; i < size; ++i) {
+    if (acquired_count_ == kMaxPayloads) {
+      skipped_count_ += size - i;
+      break;
+    }
+    ArTrackData* track_data = nullptr;
+    ArTrackDataList_acquireItem(session, list_, i, &track_data);
+    const uint8_t* data = nullptr;
+    int32_t data_size = 0;
+    ArTrackData_getData(session, track_data, &data, &data_size);
+    if (data == nullptr || data_size <= 0) {
+      ArTrackData_release(track_data);
+      continue;
+    }
+    track_data_[acquired_count_++] = track_data;
+    Payload& payload = payloads_[payload_count_++];
+    payload.data = data;
+    payload.size = static_cast<size_t>(data_size);
+    ArTrackData_getFrameTimestamp(session, track_data, &payload.timestamp_ns);
+  }
+  return payload_count_;
+}
+
+void TrackDataReader::ReleasePayloads() {
+  for (int i = 0; i < acquired_count_; ++i) {
+    ArTrackData_release(track_data_[i]);
+  }
+  acquired_count_ = 0;
+  payload_count_ = 0;
+}
+
+void TrackDataReader::Release() {
+  ReleasePayloads();
+  if (list_ != nullptr) {
+    ArTrackDataList_destroy(list_);
+    list_ = nullptr;
+  }
+}
+
+}  // namespace hello_ar
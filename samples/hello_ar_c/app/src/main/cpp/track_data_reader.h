@@ -0,0 +1,89 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_TRACK_DATA_READER_H_
+#define C_ARCORE_HELLOE_AR_TRACK_DATA_READER_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "arcore_c_api.h"
+
+namespace hello_ar {
+
+// The custom track data a played back dataset has for the current frame,
+// without copying it.
+//
+// Read() acquires the frame's samples of one track into a fixed set of
+// handles and exposes each sample as a Payload pointing into ARCore's
+// buffer.  The payloads stay valid until the next Read() or Release() of the
+// reader, so they must not be kept past the frame; copy out what has to
+// outlive it.  The list and the handles are reused from frame to frame, so
+// reading never allocates after the first call.  Samples beyond
+// kMaxPayloads in one frame are skipped and counted.
+//
+// All methods must be called on the thread that updates the session.
+class TrackDataReader {
+ public:
+  static constexpr int kMaxPayloads = 16;
+
+  // Non-owning view of one sample.
+  struct Payload {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    // Timestamp of the frame the sample was recorded with.
+    int64_t timestamp_ns = 0;
+  };
+
+  TrackDataReader() = default;
+  ~TrackDataReader();
+
+  TrackDataReader(const TrackDataReader&) = delete;
+  TrackDataReader& operator=(const TrackDataReader&) = delete;
+
+  // Releases the previous payloads and acquires those of the track with the
+  // 16 byte |track_id| on |frame|.  Empty samples, which ARCore adds to
+  // sparse tracks, are left out.  Returns the number of payloads.
+  int Read(const ArSession* session, const ArFrame* frame,
+           const uint8_t* track_id);
+
+  int GetPayloadCount() const { return payload_count_; }
+  const Payload& GetPayload(int index) const { return payloads_[index]; }
+
+  // Samples that did not fit kMaxPayloads since the reader was created.
+  int GetSkippedCount() const { return skipped_count_; }
+
+  // Returns the payloads' handles to ARCore, which invalidates the
+  // payloads.  The list is kept for the next Read().
+  void ReleasePayloads();
+
+  // Same, and destroys the list.  Must be called before the session is
+  // destroyed.
+  void Release();
+
+ private:
+  ArTrackDataList* list_ = nullptr;
+  std::array<ArTrackData*, kMaxPayloads> track_data_ = {};
+  std::array<Payload, kMaxPayloads> payloads_;
+  int acquired_count_ = 0;
+  int payload_count_ = 0;
+  int skipped_count_ = 0;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_TRACK_DATA_READER_H_
@@ -0,0 +1,113 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tsdf_mesh_renderer.h"
+
+#include "resource_accounting.h"
+#include "util.h"
+
+namespace hello_ar {
+namespace {
+constexpr char kOwner[] = "TsdfMeshRenderer";
+
+constexpr int kPositionComponents = 3;
+}  // namespace
+
+void TsdfMeshRenderer::InitializeGlContent(AAssetManager* asset_manager) {
+  shader_program_ =
+      util::CreateProgram(ShaderVariant::kTsdfMesh, asset_manager);
+  if (!shader_program_) {
+    LOGE("Could not create program.");
+  }
+  attribute_position_ = glGetAttribLocation(shader_program_, "a_Position");
+  uniform_mvp_mat_ =
+      glGetUniformLocation(shader_program_, "u_ModelViewProjection");
+  uniform_color_ = glGetUniformLocation(shader_program_, "u_Color");
+
+  // Buffers of a previous context are gone with it.
+  blocks_.clear();
+  uploaded_bytes_ = 0;
+  util::CheckGlError("TsdfMeshRenderer::InitializeGlContent()");
+}
+
+void TsdfMeshRenderer::Update(const TsdfVolume::MeshUpdate& update) {
+  uploaded_bytes_ = 0;
+  for (const TsdfVolume::BlockKey& key : update.removed) {
+    DeleteBlock(key);
+  }
+  for (const TsdfVolume::BlockMesh& mesh : update.meshes) {
+    if (mesh.vertices.empty()) {
+      DeleteBlock(mesh.key);
+      continue;
+    }
+    BlockBuffer& block = blocks_[mesh.key];
+    if (block.buffer == 0) {
+      glGenBuffers(1, &block.buffer);
+    }
+    const GLsizeiptr size = mesh.vertices.size() * sizeof(float);
+    glBindBuffer(GL_ARRAY_BUFFER, block.buffer);
+    glBufferData(GL_ARRAY_BUFFER, size, mesh.vertices.data(), GL_DYNAMIC_DRAW);
+    ResourceAccounting::Get().Track(GpuResourceType::kBuffer, block.buffer,
+                                    size, kOwner);
+    block.vertex_count =
+        static_cast<GLsizei>(mesh.vertices.size() / kPositionComponents);
+    uploaded_bytes_ += size;
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  util::CheckGlError("TsdfMeshRenderer::Update()");
+}
+
+void TsdfMeshRenderer::Draw(const glm::mat4& view_projection_mat) {
+  if (!shader_program_ || blocks_.empty()) {
+    return;
+  }
+
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
+  gl_state.UseProgram(shader_program_);
+  gl_state.DepthMask(GL_TRUE);
+  // Triangles of the extracted surface are not consistently wound.
+  gl_state.SetCapability(GL_CULL_FACE, false);
+  gl_state.SetCapability(GL_BLEND, true);
+  gl_state.BlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+  gl_state.SetEnabledVertexAttribArrays(1u << attribute_position_);
+
+  glUniformMatrix4fv(uniform_mvp_mat_, 1, GL_FALSE,
+                     glm::value_ptr(view_projection_mat));
+  glUniform4f(uniform_color_, 1.0f, 1.0f, 1.0f, 0.6f);
+
+  for (const auto& entry : blocks_) {
+    const BlockBuffer& block = entry.second;
+    glBindBuffer(GL_ARRAY_BUFFER, block.buffer);
+    glVertexAttribPointer(attribute_position_, kPositionComponents, GL_FLOAT,
+                          GL_FALSE, 0, nullptr);
+    glDrawArrays(GL_TRIANGLES, 0, block.vertex_count);
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  util::CheckGlError("TsdfMeshRenderer::Draw()");
+}
+
+void TsdfMeshRenderer::DeleteBlock(const TsdfVolume::BlockKey& key) {
+  auto it = blocks_.find(key);
+  if (it == blocks_.end()) {
+    return;
+  }
+  glDeleteBuffers(1, &it->second.buffer);
+  ResourceAccounting::Get().Untrack(GpuResourceType::kBuffer,
+                                    it->second.buffer);
+  blocks_.erase(it);
+}
+
+}  // namespace hello_ar
@@ -0,0 +1,75 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_TSDF_MESH_RENDERER_H_
+#define C_ARCORE_HELLOE_AR_TSDF_MESH_RENDERER_H_
+
+// clang-format off
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+// clang-format on
+#include <android/asset_manager.h>
+
+#include <cstdint>
+#include <unordered_map>
+
+#include "glm.h"
+#include "tsdf_volume.h"
+
+namespace hello_ar {
+
+// Draws the surface reconstructed by a TsdfVolume, with one vertex buffer per
+// block so that an update only re-uploads the blocks that changed.
+class TsdfMeshRenderer {
+ public:
+  TsdfMeshRenderer() = default;
+  ~TsdfMeshRenderer() = default;
+
+  // Initialize the GL content, needs to be called on GL thread.
+  void InitializeGlContent(AAssetManager* asset_manager);
+
+  // Replaces the buffers of the blocks in |update|.  Removed blocks are
+  // applied before the new meshes.
+  void Update(const TsdfVolume::MeshUpdate& update);
+
+  // Draws every block mesh as a translucent, flat shaded surface.
+  void Draw(const glm::mat4& view_projection_mat);
+
+  // Number of bytes uploaded by the most recent Update() call.
+  size_t GetUploadedBytesLastUpdate() const { return uploaded_bytes_; }
+
+ private:
+  struct BlockBuffer {
+    GLuint buffer = 0;
+    GLsizei vertex_count = 0;
+  };
+
+  void DeleteBlock(const TsdfVolume::BlockKey& key);
+
+  std::unordered_map<TsdfVolume::BlockKey, BlockBuffer,
+                     TsdfVolume::BlockKeyHash>
+      blocks_;
+  size_t uploaded_bytes_ = 0;
+
+  GLuint shader_program_ = 0;
+  GLint attribute_position_ = -1;
+  GLint uniform_mvp_mat_ = -1;
+  GLint uniform_color_ = -1;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_TSDF_MESH_RENDERER_H_
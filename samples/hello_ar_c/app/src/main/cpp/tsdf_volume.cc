@@ -0,0 +1,646 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tsdf_volume.h"
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_set>
+#include <utility>
+
+#include "job_system.h"
+
+namespace hello_ar {
+namespace {
+constexpr int kBlockSize = TsdfVolume::kBlockSize;
+constexpr int kLatticeSize = kBlockSize + 1;
+
+// Voxels are not updated more than this many times, so the field keeps
+// following changes to the scene.
+constexpr float kMaxWeight = 64.f;
+// Points closer to the camera than this are not projected.
+constexpr float kMinDepthM = 0.1f;
+// Several tasks per thread even out blocks of different cost.
+constexpr int kTasksPerThread = 4;
+
+// The six tetrahedra around the diagonal from corner 0 to corner 7 of a cell,
+// whose corner i is at offset (i & 1, (i >> 1) & 1, (i >> 2) & 1).
+constexpr int kCellTetrahedra[6][4] = {{0, 1, 3, 7}, {0, 1, 5, 7},
+                                       {0, 2, 3, 7}, {0, 2, 6, 7},
+                                       {0, 4, 5, 7}, {0, 4, 6, 7}};
+
+struct DepthFrame {
+  const uint16_t* depth_mm;
+  int width;
+  int height;
+  int row_stride;
+  glm::vec4 intrinsics;
+  float max_depth_m;
+};
+
+inline int GetVoxelIndex(int x, int y, int z) {
+  return x + kBlockSize * (y + kBlockSize * z);
+}
+
+// Depth in meters of the pixel at (column, row), or 0 if it is unknown.
+inline float GetPixelDepth(const DepthFrame& frame, int column, int row) {
+  const uint16_t* pixels = reinterpret_cast<const uint16_t*>(
+      reinterpret_cast<const uint8_t*>(frame.depth_mm) +
+      row * frame.row_stride);
+  const float depth_m = pixels[column] * 0.001f;
+  return depth_m > frame.max_depth_m ? 0.f : depth_m;
+}
+
+// Depth measured at the projection of the camera space point |p|, or 0 if it
+// projects outside the image or has no depth.
+inline float LookUpDepth(const DepthFrame& frame, const glm::vec3& p) {
+  const float depth = -p.z;
+  if (depth <= kMinDepthM) {
+    return 0.f;
+  }
+  // Pixel centers are at integer coordinates, and image rows grow downwards.
+  const float u = frame.intrinsics.x * p.x / depth + frame.intrinsics.z + 0.5f;
+  const float v =
+      -frame.intrinsics.y * p.y / depth + frame.intrinsics.w + 0.5f;
+  if (!(u >= 0.f && v >= 0.f && u < frame.width && v < frame.height)) {
+    return 0.f;
+  }
+  return GetPixelDepth(frame, static_cast<int>(u), static_cast<int>(v));
+}
+
+// Folds one observation into a voxel |voxel_depth_m| in front of the camera.
+inline void UpdateVoxel(float depth_m, float voxel_depth_m,
+                        float inv_truncation, float* tsdf, float* weight) {
+  if (depth_m <= 0.f) {
+    return;
+  }
+  const float sdf = (depth_m - voxel_depth_m) * inv_truncation;
+  if (sdf < -1.f) {
+    // Hidden behind the surface.
+    return;
+  }
+  *tsdf = (*tsdf * *weight + std::min(sdf, 1.f)) / (*weight + 1.f);
+  *weight = std::min(*weight + 1.f, kMaxWeight);
+}
+
+#if defined(__ARM_NEON)
+inline float32x4_t Divide(float32x4_t a, float32x4_t b) {
+#if defined(__aarch64__)
+  return vdivq_f32(a, b);
+#else
+  // Two Newton-Raphson steps bring the estimate to full precision.
+  float32x4_t reciprocal = vrecpeq_f32(b);
+  reciprocal = vmulq_f32(vrecpsq_f32(b, reciprocal), reciprocal);
+  reciprocal = vmulq_f32(vrecpsq_f32(b, reciprocal), reciprocal);
+  return vmulq_f32(a, reciprocal);
+#endif  // __aarch64__
+}
+
+// Integrates the kBlockSize voxels of one block row, which start at camera
+// space position |start| and are |step| apart, four at a time.  Only the
+// depth lookup runs per lane, as NEON has no gather.
+void IntegrateRowNeon(const DepthFrame& frame, const glm::vec3& start,
+                      const glm::vec3& step, float inv_truncation,
+                      float* tsdf, float* weight) {
+  static_assert(kBlockSize % 4 == 0, "Rows must be whole vectors.");
+  static const float kLaneOffsets[4] = {0.f, 1.f, 2.f, 3.f};
+  const float32x4_t lane_offsets = vld1q_f32(kLaneOffsets);
+  const float32x4_t zero = vdupq_n_f32(0.f);
+  const float32x4_t one = vdupq_n_f32(1.f);
+  const float32x4_t width = vdupq_n_f32(static_cast<float>(frame.width));
+  const float32x4_t height = vdupq_n_f32(static_cast<float>(frame.height));
+  const float32x4_t min_depth = vdupq_n_f32(kMinDepthM);
+
+  for (int i = 0; i < kBlockSize; i += 4) {
+    const float32x4_t offsets =
+        vaddq_f32(lane_offsets, vdupq_n_f32(static_cast<float>(i)));
+    const float32x4_t x = vmlaq_n_f32(vdupq_n_f32(start.x), offsets, step.x);
+    const float32x4_t y = vmlaq_n_f32(vdupq_n_f32(start.y), offsets, step.y);
+    const float32x4_t voxel_depth =
+        vnegq_f32(vmlaq_n_f32(vdupq_n_f32(start.z), offsets, step.z));
+
+    // Same projection as LookUpDepth().
+    const uint32x4_t in_front = vcgtq_f32(voxel_depth, min_depth);
+    const float32x4_t inv_depth =
+        Divide(one, vmaxq_f32(voxel_depth, min_depth));
+    const float32x4_t u = vaddq_f32(
+        vmulq_n_f32(vmulq_f32(x, inv_depth), frame.intrinsics.x),
+        vdupq_n_f32(frame.intrinsics.z + 0.5f));
+    const float32x4_t v = vaddq_f32(
+        vmulq_n_f32(vmulq_f32(y, inv_depth), -frame.intrinsics.y),
+        vdupq_n_f32(frame.intrinsics.w + 0.5f));
+    const uint32x4_t in_image = vandq_u32(
+        vandq_u32(in_front, vandq_u32(vcgeq_f32(u, zero), vcgeq_f32(v, zero))),
+        vandq_u32(vcltq_f32(u, width), vcltq_f32(v, height)));
+
+    int32_t columns[4];
+    int32_t rows[4];
+    uint32_t visible[4];
+    vst1q_s32(columns, vcvtq_s32_f32(u));
+    vst1q_s32(rows, vcvtq_s32_f32(v));
+    vst1q_u32(visible, in_image);
+    float depths[4];
+    for (int lane = 0; lane < 4; ++lane) {
+      depths[lane] =
+          visible[lane] ? GetPixelDepth(frame, columns[lane], rows[lane]) : 0.f;
+    }
+
+    // Same update as UpdateVoxel().
+    const float32x4_t depth = vld1q_f32(depths);
+    const float32x4_t sdf =
+        vmulq_n_f32(vsubq_f32(depth, voxel_depth), inv_truncation);
+    const uint32x4_t update =
+        vandq_u32(vcgtq_f32(depth, zero), vcgeq_f32(sdf, vnegq_f32(one)));
+    const float32x4_t old_tsdf = vld1q_f32(tsdf + i);
+    const float32x4_t old_weight = vld1q_f32(weight + i);
+    const float32x4_t new_weight = vaddq_f32(old_weight, one);
+    const float32x4_t new_tsdf =
+        Divide(vmlaq_f32(vminq_f32(sdf, one), old_tsdf, old_weight),
+               new_weight);
+    vst1q_f32(tsdf + i, vbslq_f32(update, new_tsdf, old_tsdf));
+    vst1q_f32(weight + i,
+              vbslq_f32(update, vminq_f32(new_weight, vdupq_n_f32(kMaxWeight)),
+                        old_weight));
+  }
+}
+#else
+// IntegrateRowNeon() for builds without NEON, one voxel at a time.
+void IntegrateRowScalar(const DepthFrame& frame, const glm::vec3& start,
+                        const glm::vec3& step, float inv_truncation,
+                        float* tsdf, float* weight) {
+  for (int i = 0; i < kBlockSize; ++i) {
+    const glm::vec3 p = start + static_cast<float>(i) * step;
+    UpdateVoxel(LookUpDepth(frame, p), -p.z, inv_truncation, &tsdf[i],
+                &weight[i]);
+  }
+}
+#endif  // __ARM_NEON
+
+void IntegrateBlock(const DepthFrame& frame,
+                    const TsdfVolume::Options& options,
+                    const TsdfVolume::BlockKey& key,
+                    const glm::mat4& world_to_camera, float* tsdf,
+                    float* weight) {
+  const float voxel_size = options.voxel_size_m;
+  const float inv_truncation = 1.f / options.truncation_m;
+  const glm::vec3 first_voxel =
+      (glm::vec3(key * kBlockSize) + 0.5f) * voxel_size;
+  const glm::vec3 origin =
+      glm::vec3(world_to_camera * glm::vec4(first_voxel, 1.f));
+  const glm::vec3 step_x = glm::vec3(world_to_camera[0]) * voxel_size;
+  const glm::vec3 step_y = glm::vec3(world_to_camera[1]) * voxel_size;
+  const glm::vec3 step_z = glm::vec3(world_to_camera[2]) * voxel_size;
+
+  for (int z = 0; z < kBlockSize; ++z) {
+    for (int y = 0; y < kBlockSize; ++y) {
+      const glm::vec3 start = origin + static_cast<float>(y) * step_y +
+                              static_cast<float>(z) * step_z;
+      const int index = GetVoxelIndex(0, y, z);
+#if defined(__ARM_NEON)
+      IntegrateRowNeon(frame, start, step_x, inv_truncation, tsdf + index,
+                       weight + index);
+#else
+      IntegrateRowScalar(frame, start, step_x, inv_truncation, tsdf + index,
+                         weight + index);
+#endif  // __ARM_NEON
+    }
+  }
+}
+
+// Point on the edge from |p1| to |p2| where the distance crosses zero.
+glm::vec3 InterpolateEdge(const glm::vec3& p1, float v1, const glm::vec3& p2,
+                          float v2) {
+  return p1 + (p2 - p1) * (v1 / (v1 - v2));
+}
+
+void AppendTriangle(const glm::vec3& a, const glm::vec3& b,
+                    const glm::vec3& c, std::vector<float>* vertices) {
+  vertices->insert(vertices->end(),
+                   {a.x, a.y, a.z, b.x, b.y, b.z, c.x, c.y, c.z});
+}
+
+// Emits the zero crossing of one tetrahedron, with negative values inside.
+void PolygonizeTetrahedron(const glm::vec3 (&p)[4], const float (&v)[4],
+                           std::vector<float>* vertices) {
+  int inside[4];
+  int outside[4];
+  int num_inside = 0;
+  int num_outside = 0;
+  for (int i = 0; i < 4; ++i) {
+    if (v[i] < 0.f) {
+      inside[num_inside++] = i;
+    } else {
+      outside[num_outside++] = i;
+    }
+  }
+
+  if (num_inside == 1 || num_outside == 1) {
+    // One corner is cut off by a triangle.
+    const int a = num_inside == 1 ? inside[0] : outside[0];
+    glm::vec3 crossings[3];
+    int num_crossings = 0;
+    for (int i = 0; i < 4; ++i) {
+      if (i != a) {
+        crossings[num_crossings++] = InterpolateEdge(p[a], v[a], p[i], v[i]);
+      }
+    }
+    AppendTriangle(crossings[0], crossings[1], crossings[2], vertices);
+  } else if (num_inside == 2) {
+    // The crossing is a quad between the two inside and two outside corners.
+    const int a = inside[0];
+    const int b = inside[1];
+    const int c = outside[0];
+    const int d = outside[1];
+    const glm::vec3 ac = InterpolateEdge(p[a], v[a], p[c], v[c]);
+    const glm::vec3 ad = InterpolateEdge(p[a], v[a], p[d], v[d]);
+    const glm::vec3 bc = InterpolateEdge(p[b], v[b], p[c], v[c]);
+    const glm::vec3 bd = InterpolateEdge(p[b], v[b], p[d], v[d]);
+    AppendTriangle(ac, ad, bd, vertices);
+    AppendTriangle(ac, bd, bc, vertices);
+  }
+}
+
+// ParallelFor() grain that splits |count| items into kTasksPerThread chunks
+// per thread of the job system.
+int GetGrain(int count) {
+  const int num_chunks =
+      util::JobSystem::Get().GetThreadCount() * kTasksPerThread;
+  return std::max(1, (count + num_chunks - 1) / num_chunks);
+}
+}  // namespace
+
+constexpr int TsdfVolume::kBlockSize;
+constexpr int TsdfVolume::kVoxelsPerBlock;
+
+size_t TsdfVolume::BlockKeyHash::operator()(const BlockKey& key) const {
+  // The usual spatial hash primes.  Unsigned arithmetic wraps around.
+  return (static_cast<uint32_t>(key.x) * 73856093u) ^
+         (static_cast<uint32_t>(key.y) * 19349663u) ^
+         (static_cast<uint32_t>(key.z) * 83492791u);
+}
+
+TsdfVolume::TsdfVolume() : TsdfVolume(Options()) {}
+
+TsdfVolume::TsdfVolume(const Options& options) : options_(options) {
+  blocks_.reserve(options_.max_blocks);
+}
+
+void TsdfVolume::Integrate(const uint16_t* depth_mm, int width, int height,
+                           int row_stride, const glm::vec4& intrinsics,
+                           const glm::mat4& camera_pose_mat) {
+  if (depth_mm == nullptr || width <= 0 || height <= 0 ||
+      intrinsics.x <= 0.f || intrinsics.y <= 0.f) {
+    return;
+  }
+  ++integration_count_;
+
+  std::vector<BlockKey> keys;
+  CollectVisibleBlocks(depth_mm, width, height, row_stride, intrinsics,
+                       camera_pose_mat, &keys);
+  if (keys.empty()) {
+    return;
+  }
+
+  // Allocation changes the map, so it happens before any task reads it.
+  std::vector<Block*> targets;
+  targets.reserve(keys.size());
+  for (const BlockKey& key : keys) {
+    std::unique_ptr<Block>& block = blocks_[key];
+    if (block == nullptr) {
+      block = std::make_unique<Block>();
+      block->tsdf.fill(1.f);
+      block->weight.fill(0.f);
+    }
+    block->last_integration = integration_count_;
+    targets.push_back(block.get());
+  }
+
+  const DepthFrame frame = {depth_mm,   width,     height,
+                            row_stride, intrinsics, options_.max_depth_m};
+  const glm::mat4 world_to_camera = glm::inverse(camera_pose_mat);
+  const int num_blocks = static_cast<int>(targets.size());
+  util::JobSystem::Get().ParallelFor(
+      0, num_blocks, GetGrain(num_blocks), [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+          IntegrateBlock(frame, options_, keys[i], world_to_camera,
+                         targets[i]->tsdf.data(), targets[i]->weight.data());
+        }
+      });
+
+  for (const BlockKey& key : keys) {
+    MarkMeshDirty(key);
+  }
+  EvictBlocks();
+}
+
+void TsdfVolume::CollectVisibleBlocks(const uint16_t* depth_mm, int width,
+                                      int height, int row_stride,
+                                      const glm::vec4& intrinsics,
+                                      const glm::mat4& camera_pose_mat,
+                                      std::vector<BlockKey>* keys) const {
+  const DepthFrame frame = {depth_mm,   width,     height,
+                            row_stride, intrinsics, options_.max_depth_m};
+  const float truncation = options_.truncation_m;
+  std::unordered_set<BlockKey, BlockKeyHash> visible;
+  for (int row = 0; row < height; row += options_.pixel_step) {
+    for (int column = 0; column < width; column += options_.pixel_step) {
+      const float depth_m = GetPixelDepth(frame, column, row);
+      if (depth_m <= 0.f) {
+        continue;
+      }
+      // Camera space direction of the pixel at unit depth.
+      const glm::vec3 ray((column - intrinsics.z) / intrinsics.x,
+                          -(row - intrinsics.w) / intrinsics.y, -1.f);
+      // The truncation band is at most one block deep, so its ends and
+      // middle touch every block it crosses.
+      for (float distance :
+           {depth_m - truncation, depth_m, depth_m + truncation}) {
+        const glm::vec4 world =
+            camera_pose_mat * glm::vec4(ray * std::max(distance, 0.f), 1.f);
+        visible.insert(GetBlockKey(glm::vec3(world)));
+      }
+    }
+  }
+  keys->assign(visible.begin(), visible.end());
+}
+
+void TsdfVolume::MarkMeshDirty(const BlockKey& key) {
+  // The cells of a block reach one voxel into its +x, +y and +z neighbours.
+  for (int dz = -1; dz <= 0; ++dz) {
+    for (int dy = -1; dy <= 0; ++dy) {
+      for (int dx = -1; dx <= 0; ++dx) {
+        auto it = blocks_.find(key + BlockKey(dx, dy, dz));
+        if (it != blocks_.end()) {
+          it->second->mesh_dirty = true;
+        }
+      }
+    }
+  }
+}
+
+void TsdfVolume::EvictBlocks() {
+  const int excess = static_cast<int>(blocks_.size()) - options_.max_blocks;
+  if (excess <= 0) {
+    return;
+  }
+  std::vector<std::pair<uint64_t, BlockKey>> ages;
+  ages.reserve(blocks_.size());
+  for (const auto& entry : blocks_) {
+    ages.emplace_back(entry.second->last_integration, entry.first);
+  }
+  std::nth_element(ages.begin(), ages.begin() + excess, ages.end(),
+                   [](const std::pair<uint64_t, BlockKey>& a,
+                      const std::pair<uint64_t, BlockKey>& b) {
+                     return a.first < b.first;
+                   });
+  for (int i = 0; i < excess; ++i) {
+    blocks_.erase(ages[i].second);
+    removed_blocks_.push_back(ages[i].second);
+  }
+  // Neighbours lose the cells they shared with the evicted blocks.
+  for (int i = 0; i < excess; ++i) {
+    MarkMeshDirty(ages[i].second);
+  }
+}
+
+void TsdfVolume::ExtractUpdatedMeshes(MeshUpdate* update) {
+  update->meshes.clear();
+  for (auto& entry : blocks_) {
+    if (entry.second->mesh_dirty) {
+      entry.second->mesh_dirty = false;
+      update->meshes.push_back({entry.first, {}});
+    }
+  }
+  update->removed = std::move(removed_blocks_);
+  removed_blocks_.clear();
+
+  const int num_meshes = static_cast<int>(update->meshes.size());
+  util::JobSystem::Get().ParallelFor(
+      0, num_meshes, GetGrain(num_meshes), [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+          BlockMesh& mesh = update->meshes[i];
+          ExtractBlockMesh(mesh.key, &mesh.vertices);
+        }
+      });
+}
+
+void TsdfVolume::InvalidateMeshes() {
+  for (auto& entry : blocks_) {
+    entry.second->mesh_dirty = true;
+  }
+}
+
+void TsdfVolume::Reset() {
+  for (const auto& entry : blocks_) {
+    removed_blocks_.push_back(entry.first);
+  }
+  blocks_.clear();
+}
+
+void TsdfVolume::ExportBlocks(std::vector<BlockVoxels>* blocks) const {
+  blocks->clear();
+  blocks->reserve(blocks_.size());
+  for (const auto& entry : blocks_) {
+    const Block& block = *entry.second;
+    if (std::none_of(block.weight.begin(), block.weight.end(),
+                     [](float weight) { return weight > 0.f; })) {
+      continue;
+    }
+    blocks->push_back({entry.first, block.tsdf, block.weight});
+  }
+}
+
+void TsdfVolume::ImportBlocks(const BlockVoxels* blocks, size_t count,
+                              const glm::mat4& transform) {
+  const float voxel_size = options_.voxel_size_m;
+  const glm::mat4 inverse_transform = glm::inverse(transform);
+  std::unordered_set<BlockKey, BlockKeyHash> changed;
+  for (size_t i = 0; i < count; ++i) {
+    const BlockVoxels& source = blocks[i];
+    const glm::ivec3 source_first_voxel = source.key * kBlockSize;
+
+    // The blocks of this volume that the transformed source block overlaps.
+    glm::vec3 bounds_min(std::numeric_limits<float>::max());
+    glm::vec3 bounds_max(-std::numeric_limits<float>::max());
+    for (int corner = 0; corner < 8; ++corner) {
+      const glm::ivec3 offset(corner & 1, (corner >> 1) & 1,
+                              (corner >> 2) & 1);
+      const glm::vec3 corner_position =
+          glm::vec3(source_first_voxel + offset * kBlockSize) * voxel_size;
+      const glm::vec3 position(transform * glm::vec4(corner_position, 1.f));
+      bounds_min = glm::min(bounds_min, position);
+      bounds_max = glm::max(bounds_max, position);
+    }
+    const BlockKey key_min = GetBlockKey(bounds_min);
+    const BlockKey key_max = GetBlockKey(bounds_max);
+
+    for (int z = key_min.z; z <= key_max.z; ++z) {
+      for (int y = key_min.y; y <= key_max.y; ++y) {
+        for (int x = key_min.x; x <= key_max.x; ++x) {
+          const BlockKey key(x, y, z);
+          if (ImportIntoBlock(source, inverse_transform, key)) {
+            changed.insert(key);
+          }
+        }
+      }
+    }
+  }
+
+  for (const BlockKey& key : changed) {
+    MarkMeshDirty(key);
+  }
+  EvictBlocks();
+}
+
+bool TsdfVolume::ImportIntoBlock(const BlockVoxels& source,
+                                 const glm::mat4& source_from_world,
+                                 const BlockKey& key) {
+  const float voxel_size = options_.voxel_size_m;
+  const glm::ivec3 source_first_voxel = source.key * kBlockSize;
+  auto it = blocks_.find(key);
+  Block* target = it != blocks_.end() ? it->second.get() : nullptr;
+  bool changed = false;
+  for (int z = 0; z < kBlockSize; ++z) {
+    for (int y = 0; y < kBlockSize; ++y) {
+      for (int x = 0; x < kBlockSize; ++x) {
+        // The source voxel nearest to the center of this one.
+        const glm::vec3 center =
+            (glm::vec3(key * kBlockSize + glm::ivec3(x, y, z)) + 0.5f) *
+            voxel_size;
+        const glm::vec3 source_position(source_from_world *
+                                        glm::vec4(center, 1.f));
+        const glm::ivec3 voxel =
+            glm::ivec3(glm::floor(source_position / voxel_size)) -
+            source_first_voxel;
+        if (glm::any(glm::lessThan(voxel, glm::ivec3(0))) ||
+            glm::any(glm::greaterThanEqual(voxel, glm::ivec3(kBlockSize)))) {
+          continue;
+        }
+        const int source_index = GetVoxelIndex(voxel.x, voxel.y, voxel.z);
+        const float source_weight = source.weight[source_index];
+        if (source_weight <= 0.f) {
+          continue;
+        }
+        if (target == nullptr) {
+          std::unique_ptr<Block>& block = blocks_[key];
+          block = std::make_unique<Block>();
+          block->tsdf.fill(1.f);
+          block->weight.fill(0.f);
+          block->last_integration = integration_count_;
+          target = block.get();
+        }
+        const int index = GetVoxelIndex(x, y, z);
+        const float weight = target->weight[index];
+        target->tsdf[index] = (target->tsdf[index] * weight +
+                               source.tsdf[source_index] * source_weight) /
+                              (weight + source_weight);
+        target->weight[index] = std::min(weight + source_weight, kMaxWeight);
+        changed = true;
+      }
+    }
+  }
+  return changed;
+}
+
+void TsdfVolume::ExtractBlockMesh(const BlockKey& key,
+                                  std::vector<float>* vertices) const {
+  // The block and its neighbours in +x, +y and +z, indexed by offset bits.
+  const Block* neighbours[8] = {};
+  for (int i = 0; i < 8; ++i) {
+    auto it =
+        blocks_.find(key + BlockKey(i & 1, (i >> 1) & 1, (i >> 2) & 1));
+    if (it != blocks_.end()) {
+      neighbours[i] = it->second.get();
+    }
+  }
+
+  // Voxels of the cell corners, with a weight of 0 where nothing is known.
+  std::array<float, kLatticeSize * kLatticeSize * kLatticeSize> tsdf;
+  std::array<float, kLatticeSize * kLatticeSize * kLatticeSize> weight;
+  for (int z = 0; z < kLatticeSize; ++z) {
+    for (int y = 0; y < kLatticeSize; ++y) {
+      for (int x = 0; x < kLatticeSize; ++x) {
+        const int lattice_index = x + kLatticeSize * (y + kLatticeSize * z);
+        const Block* block = neighbours[(x / kBlockSize) |
+                                        ((y / kBlockSize) << 1) |
+                                        ((z / kBlockSize) << 2)];
+        if (block == nullptr) {
+          tsdf[lattice_index] = 1.f;
+          weight[lattice_index] = 0.f;
+          continue;
+        }
+        const int voxel_index = GetVoxelIndex(x % kBlockSize, y % kBlockSize,
+                                              z % kBlockSize);
+        tsdf[lattice_index] = block->tsdf[voxel_index];
+        weight[lattice_index] = block->weight[voxel_index];
+      }
+    }
+  }
+
+  const float voxel_size = options_.voxel_size_m;
+  const glm::vec3 first_voxel =
+      (glm::vec3(key * kBlockSize) + 0.5f) * voxel_size;
+  for (int z = 0; z < kBlockSize; ++z) {
+    for (int y = 0; y < kBlockSize; ++y) {
+      for (int x = 0; x < kBlockSize; ++x) {
+        glm::vec3 corner_positions[8];
+        float corner_values[8];
+        bool observed = true;
+        bool any_inside = false;
+        bool any_outside = false;
+        for (int i = 0; i < 8; ++i) {
+          const int cx = x + (i & 1);
+          const int cy = y + ((i >> 1) & 1);
+          const int cz = z + ((i >> 2) & 1);
+          const int lattice_index =
+              cx + kLatticeSize * (cy + kLatticeSize * cz);
+          observed = observed && weight[lattice_index] > 0.f;
+          corner_values[i] = tsdf[lattice_index];
+          any_inside = any_inside || corner_values[i] < 0.f;
+          any_outside = any_outside || corner_values[i] >= 0.f;
+          corner_positions[i] =
+              first_voxel + glm::vec3(cx, cy, cz) * voxel_size;
+        }
+        if (!observed || !any_inside || !any_outside) {
+          continue;
+        }
+        for (const int(&tetrahedron)[4] : kCellTetrahedra) {
+          const glm::vec3 p[4] = {corner_positions[tetrahedron[0]],
+                                  corner_positions[tetrahedron[1]],
+                                  corner_positions[tetrahedron[2]],
+                                  corner_positions[tetrahedron[3]]};
+          const float v[4] = {
+              corner_values[tetrahedron[0]], corner_values[tetrahedron[1]],
+              corner_values[tetrahedron[2]], corner_values[tetrahedron[3]]};
+          PolygonizeTetrahedron(p, v, vertices);
+        }
+      }
+    }
+  }
+}
+
+TsdfVolume::BlockKey TsdfVolume::GetBlockKey(
+    const glm::vec3& world_position) const {
+  return BlockKey(
+      glm::floor(world_position / (options_.voxel_size_m * kBlockSize)));
+}
+
+}  // namespace hello_ar
@@ -0,0 +1,172 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_TSDF_VOLUME_H_
+#define C_ARCORE_HELLOE_AR_TSDF_VOLUME_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "glm.h"
+
+namespace hello_ar {
+
+// Truncated signed distance field of the surroundings, fused incrementally
+// from depth images.
+//
+// Only blocks of kBlockSize^3 voxels near an observed surface are allocated,
+// and looked up through a hash map keyed by the integer block coordinates.
+// Integrate() splits the blocks seen by a depth image across the JobSystem,
+// with a NEON kernel updating four voxels at a time where available.  Blocks
+// changed since the last ExtractUpdatedMeshes() call are re-meshed there, in
+// parallel as well.  Once more than Options::max_blocks are allocated, the
+// blocks integrated longest ago are evicted.
+//
+// Not thread safe; all calls must come from the same thread.
+class TsdfVolume {
+ public:
+  static constexpr int kBlockSize = 8;
+  static constexpr int kVoxelsPerBlock = kBlockSize * kBlockSize * kBlockSize;
+
+  struct Options {
+    float voxel_size_m = 0.04f;
+    // Distance behind and in front of the surface that is integrated.
+    float truncation_m = 0.12f;
+    // Depth beyond this is too noisy to be fused.
+    float max_depth_m = 4.0f;
+    // Every |pixel_step|-th depth pixel in x and y allocates blocks.
+    int pixel_step = 4;
+    // Bounds the memory to max_blocks * sizeof(Block).
+    int max_blocks = 4096;
+  };
+
+  using BlockKey = glm::ivec3;
+  struct BlockKeyHash {
+    size_t operator()(const BlockKey& key) const;
+  };
+
+  // Triangles of one block as x, y, z world positions, three vertices each.
+  struct BlockMesh {
+    BlockKey key;
+    std::vector<float> vertices;
+  };
+
+  struct MeshUpdate {
+    // Blocks whose mesh changed.  An empty mesh replaces the previous one.
+    std::vector<BlockMesh> meshes;
+    // Blocks evicted since the last update.
+    std::vector<BlockKey> removed;
+  };
+
+  // The voxels of one block, copied out of the volume to be persisted.
+  // Trivially copyable, so it can be written to and read from a file as is.
+  struct BlockVoxels {
+    BlockKey key;
+    std::array<float, kVoxelsPerBlock> tsdf;
+    std::array<float, kVoxelsPerBlock> weight;
+  };
+
+  TsdfVolume();
+  explicit TsdfVolume(const Options& options);
+
+  TsdfVolume(const TsdfVolume&) = delete;
+  TsdfVolume& operator=(const TsdfVolume&) = delete;
+
+  // Fuses one depth image into the volume.
+  //
+  // @param depth_mm, rows of |row_stride| bytes of 16 bit depth in
+  //     millimeters, 0 where depth is unknown.
+  // @param intrinsics, focal length (xy) and principal point (zw) in depth
+  //     pixels.
+  // @param camera_pose_mat, the camera sensor pose the image was taken from,
+  //     in the OpenGL camera convention.
+  void Integrate(const uint16_t* depth_mm, int width, int height,
+                 int row_stride, const glm::vec4& intrinsics,
+                 const glm::mat4& camera_pose_mat);
+
+  // Meshes every block changed since the previous call into |update|.
+  void ExtractUpdatedMeshes(MeshUpdate* update);
+
+  // Makes the next update re-mesh every block, e.g. for a new GL context.
+  void InvalidateMeshes();
+
+  // Drops all blocks.  The next update removes all of their meshes.
+  void Reset();
+
+  // Copies every block with at least one observed voxel into |blocks|.
+  void ExportBlocks(std::vector<BlockVoxels>* blocks) const;
+
+  // Fuses |count| blocks exported from a volume of the same voxel size into
+  // this one.  |transform| maps the world frame of the exported volume to
+  // this one, usually through an anchor both sessions know.  The blocks are
+  // resampled onto this volume's grid by the nearest exported voxel, and
+  // fused with what this volume observed by weight.  Blocks that are
+  // allocated for it count as integrated now for eviction.
+  void ImportBlocks(const BlockVoxels* blocks, size_t count,
+                    const glm::mat4& transform);
+
+  size_t GetBlockCount() const { return blocks_.size(); }
+
+ private:
+  struct Block {
+    // Signed distance divided by the truncation distance, in [-1, 1].
+    std::array<float, kVoxelsPerBlock> tsdf;
+    // Number of observations of each voxel, 0 if it was never seen.
+    std::array<float, kVoxelsPerBlock> weight;
+    // Integrate() call that last updated the block, for eviction.
+    uint64_t last_integration = 0;
+    bool mesh_dirty = false;
+  };
+
+  using BlockMap =
+      std::unordered_map<BlockKey, std::unique_ptr<Block>, BlockKeyHash>;
+
+  // Blocks within the truncation band around the surface seen by the image.
+  void CollectVisibleBlocks(const uint16_t* depth_mm, int width, int height,
+                            int row_stride, const glm::vec4& intrinsics,
+                            const glm::mat4& camera_pose_mat,
+                            std::vector<BlockKey>* keys) const;
+
+  // Marks the blocks whose cells read voxels of |key| for re-meshing.
+  void MarkMeshDirty(const BlockKey& key);
+
+  // Evicts the least recently integrated blocks above max_blocks.
+  void EvictBlocks();
+
+  // Fuses the voxels of |source| that the block |key| overlaps, allocating
+  // it if needed.  Returns whether any voxel changed.
+  bool ImportIntoBlock(const BlockVoxels& source,
+                       const glm::mat4& source_from_world,
+                       const BlockKey& key);
+
+  void ExtractBlockMesh(const BlockKey& key, std::vector<float>* vertices)
+      const;
+
+  BlockKey GetBlockKey(const glm::vec3& world_position) const;
+
+  Options options_;
+  BlockMap blocks_;
+  uint64_t integration_count_ = 0;
+  std::vector<BlockKey> removed_blocks_;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_TSDF_VOLUME_H_
@@ -0,0 +1,43 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ui_state_channel.h"
+
+#include <cstring>
+
+namespace hello_ar {
+
+constexpr uint32_t UiState::kFlagDepthSupported;
+constexpr uint32_t UiState::kFlagPlaybackBenchmarkFinished;
+constexpr uint32_t UiStateChannel::kLayoutVersion;
+
+UiStateChannel::UiStateChannel() {
+  static_assert(offsetof(Block, state) == 8, "layout");
+  static_assert(sizeof(std::atomic<uint32_t>) == 4 &&
+                    std::atomic<uint32_t>::is_always_lock_free,
+                "Java reads the sequence as a plain int");
+}
+
+void UiStateChannel::Publish(const UiState& state) {
+  const uint32_t sequence = block_.sequence.load(std::memory_order_relaxed);
+  block_.sequence.store(sequence + 1, std::memory_order_relaxed);
+  // Keeps the state from being written before the odd sequence.
+  std::atomic_thread_fence(std::memory_order_release);
+  memcpy(&block_.state, &state, sizeof(state));
+  block_.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+}  // namespace hello_ar
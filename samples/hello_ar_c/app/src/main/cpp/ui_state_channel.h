@@ -0,0 +1,104 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_UI_STATE_CHANNEL_H_
+#define C_ARCORE_HELLOE_AR_UI_STATE_CHANNEL_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace hello_ar {
+
+// What the Java UI shows or acts on, published once per frame.
+struct UiState {
+  static constexpr uint32_t kFlagDepthSupported = 1 << 0;
+  static constexpr uint32_t kFlagPlaybackBenchmarkFinished = 1 << 1;
+
+  int64_t frame_timestamp_ns = 0;
+  int32_t frame_count = 0;
+  int32_t plane_count = 0;
+  // ArTrackingState of the camera.
+  int32_t tracking_state = 0;
+  uint32_t flags = 0;
+  float render_scale = 1.f;
+  int32_t anchors_drawn = 0;
+  int32_t anchors_culled = 0;
+  float depth_uploads_per_second = 0.f;
+  float frame_ms = 0.f;
+  // Interval the frames are drawn at while idle, 0 for every frame, see
+  // RedrawGate.
+  int32_t idle_frame_interval_ms = 0;
+};
+
+// Shares UiState with Java through a direct ByteBuffer, so the UI reads it
+// without a JNI call per value and frame.  The buffer is guarded by a
+// sequence lock: Publish() makes the sequence odd while it writes, and a
+// reader retries whenever the sequence was odd or changed while it copied.
+// The writer never waits for readers.
+//
+// The layout is fixed, in native byte order, and mirrored by
+// UiStateChannel.java:
+//
+//   0  uint32 sequence, 0 until the first frame
+//   4  uint32 kLayoutVersion
+//   8  UiState, at the offsets checked below
+//
+// Publish() must be called from one thread at a time; the buffer may be
+// read from any thread until the channel is destroyed.
+class UiStateChannel {
+ public:
+  static constexpr uint32_t kLayoutVersion = 2;
+
+  UiStateChannel();
+
+  UiStateChannel(const UiStateChannel&) = delete;
+  UiStateChannel& operator=(const UiStateChannel&) = delete;
+
+  void Publish(const UiState& state);
+
+  // The memory to wrap with NewDirectByteBuffer().
+  void* GetData() { return &block_; }
+  size_t GetSize() const { return sizeof(block_); }
+
+ private:
+  // Own cache line, so the readers' loads do not contend with the writes to
+  // the application's members.
+  struct alignas(64) Block {
+    std::atomic<uint32_t> sequence{0};
+    uint32_t layout_version = kLayoutVersion;
+    UiState state;
+  };
+
+  Block block_;
+};
+
+static_assert(offsetof(UiState, frame_timestamp_ns) == 0, "layout");
+static_assert(offsetof(UiState, frame_count) == 8, "layout");
+static_assert(offsetof(UiState, plane_count) == 12, "layout");
+static_assert(offsetof(UiState, tracking_state) == 16, "layout");
+static_assert(offsetof(UiState, flags) == 20, "layout");
+static_assert(offsetof(UiState, render_scale) == 24, "layout");
+static_assert(offsetof(UiState, anchors_drawn) == 28, "layout");
+static_assert(offsetof(UiState, anchors_culled) == 32, "layout");
+static_assert(offsetof(UiState, depth_uploads_per_second) == 36, "layout");
+static_assert(offsetof(UiState, frame_ms) == 40, "layout");
+static_assert(offsetof(UiState, idle_frame_interval_ms) == 44, "layout");
+static_assert(sizeof(UiState) == 48, "layout");
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_UI_STATE_CHANNEL_H_
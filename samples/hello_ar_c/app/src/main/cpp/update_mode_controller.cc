@@ -0,0 +1,156 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "update_mode_controller.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "util.h"
+
+namespace hello_ar {
+namespace {
+// Frames apart further than this, e.g. around a pause, are not measured.
+constexpr int64_t kMaxFrameIntervalNs = 200000000;
+
+const char* GetModeName(ArUpdateMode mode) {
+  return mode == AR_UPDATE_MODE_BLOCKING ? "blocking" : "latest camera image";
+}
+}  // namespace
+
+constexpr int UpdateModeController::kWindowFrames;
+constexpr float UpdateModeController::kFastRenderFraction;
+constexpr float UpdateModeController::kSlowRenderFraction;
+constexpr std::chrono::seconds UpdateModeController::kMinSwitchInterval;
+
+void UpdateModeController::Reset() {
+  mode_ = AR_UPDATE_MODE_BLOCKING;
+  last_switch_ = std::chrono::steady_clock::time_point();
+  previous_update_end_ = std::chrono::steady_clock::time_point();
+  previous_camera_timestamp_ns_ = 0;
+  window_frames_ = 0;
+  window_render_ns_ = 0;
+  window_camera_period_ns_ = 0;
+  mean_render_ns_ = 0;
+  camera_period_ns_ = 0;
+}
+
+bool UpdateModeController::RecordUpdate(
+    std::chrono::steady_clock::time_point update_start,
+    std::chrono::nanoseconds update_duration, int64_t camera_timestamp_ns) {
+  const std::chrono::steady_clock::time_point previous_update_end =
+      previous_update_end_;
+  previous_update_end_ = update_start + update_duration;
+  const int64_t blocked_ns = update_duration.count();
+  BlockingStats& stats = blocking_stats_[mode_];
+  ++stats.update_count;
+  stats.blocked_ns += blocked_ns;
+  stats.max_blocked_ns = std::max(stats.max_blocked_ns, blocked_ns);
+
+  const int64_t previous_camera_timestamp_ns = previous_camera_timestamp_ns_;
+  previous_camera_timestamp_ns_ = camera_timestamp_ns;
+  if (previous_update_end == std::chrono::steady_clock::time_point()) {
+    return false;
+  }
+  const int64_t render_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          update_start - previous_update_end)
+          .count();
+  if (render_ns < 0 || render_ns > kMaxFrameIntervalNs) {
+    return false;
+  }
+  stats.elapsed_ns += render_ns + blocked_ns;
+
+  // Latest-camera-image updates repeat the image until the next arrives.
+  const int64_t camera_delta_ns =
+      camera_timestamp_ns - previous_camera_timestamp_ns;
+  if (previous_camera_timestamp_ns != 0 && camera_delta_ns > 0 &&
+      camera_delta_ns < kMaxFrameIntervalNs &&
+      (window_camera_period_ns_ == 0 ||
+       camera_delta_ns < window_camera_period_ns_)) {
+    window_camera_period_ns_ = camera_delta_ns;
+  }
+  window_render_ns_ += render_ns;
+  if (++window_frames_ < kWindowFrames) {
+    return false;
+  }
+  return UpdateMode(update_start);
+}
+
+bool UpdateModeController::UpdateMode(
+    std::chrono::steady_clock::time_point now) {
+  mean_render_ns_ = window_render_ns_ / window_frames_;
+  camera_period_ns_ = window_camera_period_ns_;
+  window_frames_ = 0;
+  window_render_ns_ = 0;
+  window_camera_period_ns_ = 0;
+  // Without camera images, e.g. while the camera is starting, nothing is
+  // known about the period.
+  if (camera_period_ns_ == 0 ||
+      (last_switch_ != std::chrono::steady_clock::time_point() &&
+       now - last_switch_ < kMinSwitchInterval)) {
+    return false;
+  }
+
+  ArUpdateMode mode = mode_;
+  if (mode_ == AR_UPDATE_MODE_BLOCKING &&
+      mean_render_ns_ < kFastRenderFraction * camera_period_ns_) {
+    mode = AR_UPDATE_MODE_LATEST_CAMERA_IMAGE;
+  } else if (mode_ == AR_UPDATE_MODE_LATEST_CAMERA_IMAGE &&
+             mean_render_ns_ > kSlowRenderFraction * camera_period_ns_) {
+    mode = AR_UPDATE_MODE_BLOCKING;
+  }
+  if (mode == mode_) {
+    return false;
+  }
+  LOGI("UpdateModeController: %s updates, render %.2f ms, camera %.2f ms",
+       GetModeName(mode), mean_render_ns_ / 1e6f, camera_period_ns_ / 1e6f);
+  mode_ = mode;
+  last_switch_ = now;
+  ++switch_count_;
+  // The first update after a switch measures across the reconfiguration.
+  previous_update_end_ = std::chrono::steady_clock::time_point();
+  return true;
+}
+
+std::string UpdateModeController::GetReport() const {
+  char text[160];
+  snprintf(text, sizeof(text),
+           "%s updates after %d switches, render %.2f ms, camera %.2f ms",
+           GetModeName(mode_), switch_count_, mean_render_ns_ / 1e6f,
+           camera_period_ns_ / 1e6f);
+  std::string report = text;
+  for (const ArUpdateMode mode :
+       {AR_UPDATE_MODE_BLOCKING, AR_UPDATE_MODE_LATEST_CAMERA_IMAGE}) {
+    const BlockingStats& stats = blocking_stats_[mode];
+    if (stats.update_count == 0) {
+      continue;
+    }
+    snprintf(text, sizeof(text),
+             "\n%s: %lld updates, blocked %.2f ms mean, %.2f ms max, %.1f%% "
+             "of the time",
+             GetModeName(mode), static_cast<long long>(stats.update_count),
+             stats.blocked_ns / 1e6f / stats.update_count,
+             stats.max_blocked_ns / 1e6f,
+             stats.elapsed_ns == 0
+                 ? 0.f
+                 : 100.f * stats.blocked_ns / stats.elapsed_ns);
+    report += text;
+  }
+  return report;
+}
+
+}  // namespace hello_ar
@@ -0,0 +1,109 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_UPDATE_MODE_CONTROLLER_H_
+#define C_ARCORE_HELLOE_AR_UPDATE_MODE_CONTROLLER_H_
+
+#include <chrono>  // NOLINT
+#include <cstdint>
+#include <string>
+
+#include "arcore_c_api.h"
+
+namespace hello_ar {
+
+// Switches ArSession_update between AR_UPDATE_MODE_BLOCKING and
+// AR_UPDATE_MODE_LATEST_CAMERA_IMAGE from the measured render time and
+// camera period.
+//
+// A blocking update waits for the next camera image, so a renderer that is
+// faster than the camera spends the rest of every camera period blocked in
+// ArSession_update.  Once the mean render time, the time between two updates
+// minus the time blocked in the first, stays below kFastRenderFraction of
+// the camera period for a window of kWindowFrames frames, the controller
+// switches to latest-camera-image updates, which return at once.  It goes
+// back to blocking once the render time rises above kSlowRenderFraction of
+// the period.  The camera period is the shortest delta between distinct
+// camera timestamps in the window, which dropped images do not lengthen.
+// Switching reconfigures the session, so switches are at least
+// kMinSwitchInterval apart.
+//
+// The time blocked in ArSession_update is recorded per mode for GetReport(),
+// so devices can be compared.
+//
+// Not thread safe; meant to be used on the thread that updates the session.
+class UpdateModeController {
+ public:
+  static constexpr int kWindowFrames = 60;
+  static constexpr float kFastRenderFraction = 0.7f;
+  static constexpr float kSlowRenderFraction = 0.9f;
+  static constexpr std::chrono::seconds kMinSwitchInterval{5};
+
+  UpdateModeController() = default;
+
+  // Starts over in blocking mode for a new session, keeping the statistics.
+  void Reset();
+
+  // Records an ArSession_update that started at |update_start|, blocked for
+  // |update_duration| and returned the camera image of
+  // |camera_timestamp_ns|.  Returns true if GetMode() changed, after which
+  // the session must be reconfigured with it.
+  bool RecordUpdate(std::chrono::steady_clock::time_point update_start,
+                    std::chrono::nanoseconds update_duration,
+                    int64_t camera_timestamp_ns);
+
+  ArUpdateMode GetMode() const { return mode_; }
+
+  // The current estimates and the blocking time of each mode.
+  std::string GetReport() const;
+
+ private:
+  struct BlockingStats {
+    int64_t update_count = 0;
+    int64_t blocked_ns = 0;
+    int64_t max_blocked_ns = 0;
+    // Time from the first to the last update in the mode, excluding
+    // switches.
+    int64_t elapsed_ns = 0;
+  };
+
+  // Decides on the mode at the end of a window.
+  bool UpdateMode(std::chrono::steady_clock::time_point now);
+
+  ArUpdateMode mode_ = AR_UPDATE_MODE_BLOCKING;
+  std::chrono::steady_clock::time_point last_switch_;
+  int switch_count_ = 0;
+
+  // The previous update, whose render time ends with the next one.
+  std::chrono::steady_clock::time_point previous_update_end_;
+  int64_t previous_camera_timestamp_ns_ = 0;
+
+  // The window being measured.
+  int window_frames_ = 0;
+  int64_t window_render_ns_ = 0;
+  int64_t window_camera_period_ns_ = 0;
+
+  // Estimates of the last full window, 0 until there is one.
+  int64_t mean_render_ns_ = 0;
+  int64_t camera_period_ns_ = 0;
+
+  // Indexed by ArUpdateMode.
+  BlockingStats blocking_stats_[2];
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_UPDATE_MODE_CONTROLLER_H_
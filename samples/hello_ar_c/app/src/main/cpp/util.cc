@@ -15,11 +15,24 @@
  */
 #include "util.h"
 
+// clang-format off
+#include <EGL/egl.h>
+#include <GLES3/gl31.h>
+// clang-format on
 #include <unistd.h>
-#include <sstream>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <memory>
 #include <string>
 
+#include "asset_loader.h"
 #include "jni_interface.h"
+#include "resource_accounting.h"
 
 namespace hello_ar {
 namespace util {
@@ -35,117 +48,1128 @@ void CheckGlError(const char* operation) {
   }
 }
 
+GlStateCache& GlStateCache::Get() {
+  static GlStateCache cache;
+  static bool initialized = false;
+  if (!initialized) {
+    cache.Reset();
+    initialized = true;
+  }
+  return cache;
+}
+
+void GlStateCache::Reset() {
+  program_ = kUnknown;
+  for (GLint& capability : capabilities_) {
+    capability = kUnknown;
+  }
+  depth_mask_ = kUnknown;
+  blend_source_ = kUnknown;
+  blend_destination_ = kUnknown;
+  active_texture_unit_ = kUnknown;
+  for (auto& unit : bound_textures_) {
+    unit[0] = kUnknown;
+    unit[1] = kUnknown;
+  }
+  vertex_array_ = kUnknown;
+  enabled_attribs_ = 0;
+  enabled_attribs_known_ = false;
+}
+
+void GlStateCache::BeginFrame() {
+  eliminated_last_frame_ = eliminated_calls_;
+  eliminated_calls_ = 0;
+}
+
+int GlStateCache::TextureTargetIndex(GLenum target) {
+  switch (target) {
+    case GL_TEXTURE_2D:
+      return 0;
+    case GL_TEXTURE_EXTERNAL_OES:
+      return 1;
+    default:
+      return -1;
+  }
+}
+
+int GlStateCache::CapabilityIndex(GLenum capability) {
+  switch (capability) {
+    case GL_BLEND:
+      return 0;
+    case GL_DEPTH_TEST:
+      return 1;
+    case GL_CULL_FACE:
+      return 2;
+    default:
+      return -1;
+  }
+}
+
+void GlStateCache::UseProgram(GLuint program) {
+  if (program_ == static_cast<GLint>(program)) {
+    ++eliminated_calls_;
+    return;
+  }
+  glUseProgram(program);
+  program_ = program;
+}
+
+void GlStateCache::SetCapability(GLenum capability, bool enabled) {
+  const int index = CapabilityIndex(capability);
+  if (index >= 0 && capabilities_[index] == (enabled ? 1 : 0)) {
+    ++eliminated_calls_;
+    return;
+  }
+  if (enabled) {
+    glEnable(capability);
+  } else {
+    glDisable(capability);
+  }
+  if (index >= 0) {
+    capabilities_[index] = enabled ? 1 : 0;
+  }
+}
+
+void GlStateCache::DepthMask(GLboolean flag) {
+  if (depth_mask_ == flag) {
+    ++eliminated_calls_;
+    return;
+  }
+  glDepthMask(flag);
+  depth_mask_ = flag;
+}
+
+void GlStateCache::BlendFunc(GLenum source_factor,
+                             GLenum destination_factor) {
+  if (blend_source_ == static_cast<GLint>(source_factor) &&
+      blend_destination_ == static_cast<GLint>(destination_factor)) {
+    ++eliminated_calls_;
+    return;
+  }
+  glBlendFunc(source_factor, destination_factor);
+  blend_source_ = source_factor;
+  blend_destination_ = destination_factor;
+}
+
+void GlStateCache::ActiveTexture(GLenum texture_unit) {
+  if (active_texture_unit_ == static_cast<GLint>(texture_unit)) {
+    ++eliminated_calls_;
+    return;
+  }
+  glActiveTexture(texture_unit);
+  active_texture_unit_ = texture_unit;
+}
+
+void GlStateCache::BindTexture(GLenum target, GLuint texture) {
+  const int target_index = TextureTargetIndex(target);
+  const int unit = active_texture_unit_ - GL_TEXTURE0;
+  if (target_index < 0) {
+    glBindTexture(target, texture);
+    return;
+  }
+  if (active_texture_unit_ == kUnknown || unit < 0 ||
+      unit >= kMaxTextureUnits) {
+    // The binding of whichever unit is active changes, so none of the
+    // tracked bindings for this target can be trusted anymore.
+    glBindTexture(target, texture);
+    for (auto& unit_bindings : bound_textures_) {
+      unit_bindings[target_index] = kUnknown;
+    }
+    return;
+  }
+  GLint& bound = bound_textures_[unit][target_index];
+  if (bound == static_cast<GLint>(texture)) {
+    ++eliminated_calls_;
+    return;
+  }
+  glBindTexture(target, texture);
+  bound = texture;
+}
+
+void GlStateCache::BindVertexArray(GLuint vertex_array) {
+  if (vertex_array_ == static_cast<GLint>(vertex_array)) {
+    ++eliminated_calls_;
+    return;
+  }
+  glBindVertexArray(vertex_array);
+  vertex_array_ = vertex_array;
+}
+
+void GlStateCache::SetEnabledVertexAttribArrays(uint32_t attrib_mask) {
+  // Attrib enables of the default vertex array object are only reachable
+  // while it is bound.
+  BindVertexArray(0);
+  for (GLuint index = 0; index < kMaxVertexAttribs; ++index) {
+    const uint32_t bit = 1u << index;
+    const bool enable = (attrib_mask & bit) != 0;
+    if (enabled_attribs_known_ && enable == ((enabled_attribs_ & bit) != 0)) {
+      if (enable) {
+        ++eliminated_calls_;
+      }
+      continue;
+    }
+    if (enable) {
+      glEnableVertexAttribArray(index);
+    } else {
+      glDisableVertexAttribArray(index);
+    }
+  }
+  enabled_attribs_ = attrib_mask;
+  enabled_attribs_known_ = true;
+}
+
+void GlStateCache::DeleteTexture(GLuint texture) {
+  glDeleteTextures(1, &texture);
+  ResourceAccounting::Get().Untrack(GpuResourceType::kTexture, texture);
+  for (auto& unit : bound_textures_) {
+    for (GLint& bound : unit) {
+      if (bound == static_cast<GLint>(texture)) {
+        bound = 0;
+      }
+    }
+  }
+}
+
+namespace {
+constexpr uint8_t kKtx2Identifier[12] = {0xAB, 'K',  'T',  'X', ' ',  '2',
+                                         '0',  0xBB, '\r', '\n', 0x1A, '\n'};
+
+// File header and index of KTX2, see the KTX File Format Specification 2.0.
+struct Ktx2Header {
+  uint8_t identifier[12];
+  uint32_t vk_format;
+  uint32_t type_size;
+  uint32_t pixel_width;
+  uint32_t pixel_height;
+  uint32_t pixel_depth;
+  uint32_t layer_count;
+  uint32_t face_count;
+  uint32_t level_count;
+  uint32_t supercompression_scheme;
+  uint32_t dfd_byte_offset;
+  uint32_t dfd_byte_length;
+  uint32_t kvd_byte_offset;
+  uint32_t kvd_byte_length;
+  uint64_t sgd_byte_offset;
+  uint64_t sgd_byte_length;
+};
+static_assert(sizeof(Ktx2Header) == 80, "KTX2 header must not be padded");
+
+// Follows the header, one per mip level starting with the largest.
+struct Ktx2Level {
+  uint64_t byte_offset;
+  uint64_t byte_length;
+  uint64_t uncompressed_byte_length;
+};
+
+bool HasGlExtension(const char* name) {
+  GLint num_extensions = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &num_extensions);
+  for (GLint i = 0; i < num_extensions; ++i) {
+    const char* extension = reinterpret_cast<const char*>(
+        glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i)));
+    if (extension != nullptr && strcmp(extension, name) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Whether the GPU decodes ASTC.  Must be called from the renderer thread.
+bool IsAstcSupported() {
+  static const bool supported =
+      HasGlExtension("GL_KHR_texture_compression_astc_ldr");
+  return supported;
+}
+
+// Maps the VkFormat of a KTX2 file to the compressed GL format with the same
+// block layout.  ETC2 is core in OpenGL ES 3.0, ASTC needs an extension.
+bool GetCompressedTextureFormat(uint32_t vk_format, bool astc_supported,
+                                GLenum* gl_format) {
+  // VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK to VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK
+  // are in the same order as GL_COMPRESSED_RGB8_ETC2 and its successors.
+  constexpr uint32_t kVkFormatEtc2First = 147;
+  constexpr uint32_t kVkFormatEtc2Last = 152;
+  constexpr GLenum kGlCompressedRgb8Etc2 = 0x9274;
+  // VK_FORMAT_ASTC_4x4_UNORM_BLOCK to VK_FORMAT_ASTC_12x12_SRGB_BLOCK
+  // alternate between UNORM and SRGB for every block size, which GL numbers
+  // from GL_COMPRESSED_RGBA_ASTC_4x4_KHR and
+  // GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR respectively.
+  constexpr uint32_t kVkFormatAstcFirst = 157;
+  constexpr uint32_t kVkFormatAstcLast = 184;
+  constexpr GLenum kGlCompressedRgbaAstc4x4 = 0x93B0;
+  constexpr GLenum kGlCompressedSrgb8Alpha8Astc4x4 = 0x93D0;
+
+  if (vk_format >= kVkFormatEtc2First && vk_format <= kVkFormatEtc2Last) {
+    *gl_format = kGlCompressedRgb8Etc2 + (vk_format - kVkFormatEtc2First);
+    return true;
+  }
+  if (astc_supported && vk_format >= kVkFormatAstcFirst &&
+      vk_format <= kVkFormatAstcLast) {
+    const uint32_t index = vk_format - kVkFormatAstcFirst;
+    *gl_format =
+        ((index % 2) == 0 ? kGlCompressedRgbaAstc4x4
+                          : kGlCompressedSrgb8Alpha8Astc4x4) +
+        index / 2;
+    return true;
+  }
+  return false;
+}
+
+// A mapped KTX2 asset whose header and level index were validated.  Opening
+// it makes no OpenGL calls, so it may happen on any thread.
+class Ktx2Texture {
+ public:
+  Ktx2Texture() = default;
+  ~Ktx2Texture() {
+    if (asset_ != nullptr) {
+      AAsset_close(asset_);
+    }
+  }
+  Ktx2Texture(const Ktx2Texture&) = delete;
+  Ktx2Texture& operator=(const Ktx2Texture&) = delete;
+
+  // Returns false, without logging if the asset does not exist, unless the
+  // texture can be uploaded.
+  bool Open(const char* path, AAssetManager* asset_manager,
+            bool astc_supported) {
+    asset_ = AAssetManager_open(asset_manager, path, AASSET_MODE_BUFFER);
+    if (asset_ == nullptr) {
+      // Not an error, most textures only exist as PNG.
+      return false;
+    }
+    data_ = static_cast<const uint8_t*>(AAsset_getBuffer(asset_));
+    const uint64_t length = static_cast<uint64_t>(AAsset_getLength(asset_));
+    if (data_ == nullptr || length < sizeof(Ktx2Header)) {
+      LOGE("Could not map KTX2 texture %s", path);
+      return false;
+    }
+
+    Ktx2Header header;
+    memcpy(&header, data_, sizeof(header));
+    const uint32_t level_count = std::max(header.level_count, 1u);
+    if (memcmp(header.identifier, kKtx2Identifier, sizeof(kKtx2Identifier)) !=
+            0 ||
+        header.pixel_width == 0 || header.pixel_height == 0 ||
+        header.pixel_depth > 1 || header.layer_count > 1 ||
+        header.face_count != 1 || header.supercompression_scheme != 0 ||
+        level_count > 32 ||
+        sizeof(Ktx2Header) + level_count * sizeof(Ktx2Level) > length) {
+      LOGE("Unsupported KTX2 texture %s", path);
+      return false;
+    }
+    if (!GetCompressedTextureFormat(header.vk_format, astc_supported,
+                                    &format_)) {
+      LOGI("KTX2 texture %s has format %u, which the GPU does not support",
+           path, header.vk_format);
+      return false;
+    }
+
+    levels_.resize(level_count);
+    memcpy(levels_.data(), data_ + sizeof(Ktx2Header),
+           level_count * sizeof(Ktx2Level));
+    for (const Ktx2Level& level : levels_) {
+      if (level.byte_offset > length ||
+          level.byte_length > length - level.byte_offset) {
+        LOGE("KTX2 texture %s is truncated", path);
+        return false;
+      }
+    }
+    width_ = header.pixel_width;
+    height_ = header.pixel_height;
+    return true;
+  }
+
+  // Uploads every level to the texture bound to |target| straight from the
+  // mapped asset and returns their size.  Must be called from the renderer
+  // thread.
+  size_t Upload(int target) const {
+    const uint32_t level_count = static_cast<uint32_t>(levels_.size());
+    size_t uploaded_bytes = 0;
+    for (uint32_t i = 0; i < level_count; ++i) {
+      const GLsizei width = std::max(width_ >> i, 1u);
+      const GLsizei height = std::max(height_ >> i, 1u);
+      glCompressedTexImage2D(target, i, format_, width, height, 0,
+                             static_cast<GLsizei>(levels_[i].byte_length),
+                             data_ + levels_[i].byte_offset);
+      uploaded_bytes += levels_[i].byte_length;
+    }
+    // Compressed textures cannot have mipmaps generated, so the chain ends
+    // with the levels in the file and the texture stays complete either way.
+    glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, level_count - 1);
+    return uploaded_bytes;
+  }
+
+ private:
+  AAsset* asset_ = nullptr;
+  const uint8_t* data_ = nullptr;
+  GLenum format_ = GL_NONE;
+  uint32_t width_ = 0;
+  uint32_t height_ = 0;
+  std::vector<Ktx2Level> levels_;
+};
+
+struct PngJniIds {
+  jclass helper_class = nullptr;
+  jmethodID load_image_method = nullptr;
+  jmethodID load_texture_method = nullptr;
+  jmethodID get_byte_count_method = nullptr;
+  jmethodID get_width_method = nullptr;
+  jmethodID get_height_method = nullptr;
+};
+
+// Put all the JNI values in a structure that is statically initialized on the
+// first call.  That call must come from a thread that Java started, e.g. the
+// renderer thread, since FindClass() on threads attached from native code
+// only sees the system classes.
+const PngJniIds& GetPngJniIds() {
+  static const PngJniIds ids = []() -> PngJniIds {
+    constexpr char kHelperClassName[] =
+        "com/google/ar/core/examples/c/helloar/JniInterface";
+    constexpr char kLoadImageMethodName[] = "loadImage";
+    constexpr char kLoadImageMethodSignature[] =
+        "(Ljava/lang/String;)Landroid/graphics/Bitmap;";
+    constexpr char kLoadTextureMethodName[] = "loadTexture";
+    constexpr char kLoadTextureMethodSignature[] =
+        "(ILandroid/graphics/Bitmap;)V";
+    JNIEnv* env = GetJniEnv();
+    jclass helper_class = FindClass(kHelperClassName);
+    if (!helper_class) {
+      LOGE("hello_ar::util::Could not find Java helper class %s",
+           kHelperClassName);
+      return {};
+    }
+    PngJniIds result;
+    result.helper_class = static_cast<jclass>(env->NewGlobalRef(helper_class));
+    result.load_image_method = env->GetStaticMethodID(
+        result.helper_class, kLoadImageMethodName, kLoadImageMethodSignature);
+    result.load_texture_method =
+        env->GetStaticMethodID(result.helper_class, kLoadTextureMethodName,
+                               kLoadTextureMethodSignature);
+    env->DeleteLocalRef(helper_class);
+    jclass bitmap_class = env->FindClass("android/graphics/Bitmap");
+    if (bitmap_class) {
+      result.get_byte_count_method =
+          env->GetMethodID(bitmap_class, "getByteCount", "()I");
+      result.get_width_method =
+          env->GetMethodID(bitmap_class, "getWidth", "()I");
+      result.get_height_method =
+          env->GetMethodID(bitmap_class, "getHeight", "()I");
+      env->DeleteLocalRef(bitmap_class);
+    }
+    return result;
+  }();
+  return ids;
+}
+
+}  // namespace
+
+// A PNG asset decoded into a Java Bitmap, held by a global reference so that
+// it can be decoded on one thread and uploaded on another, or again into a
+// new context.
+class PngBitmap {
+ public:
+  // Decodes the asset at |path| on the calling thread, which may be any
+  // once GetPngJniIds() has been called.
+  explicit PngBitmap(const char* path) {
+    const PngJniIds& ids = GetPngJniIds();
+    if (!ids.helper_class) {
+      return;
+    }
+    JNIEnv* env = GetJniEnv();
+    jstring j_path = env->NewStringUTF(path);
+    jobject image_obj = env->CallStaticObjectMethod(
+        ids.helper_class, ids.load_image_method, j_path);
+    if (j_path) {
+      env->DeleteLocalRef(j_path);
+    }
+    if (image_obj) {
+      bitmap_ = env->NewGlobalRef(image_obj);
+      env->DeleteLocalRef(image_obj);
+    }
+  }
+  ~PngBitmap() {
+    if (bitmap_) {
+      GetJniEnv()->DeleteGlobalRef(bitmap_);
+    }
+  }
+  PngBitmap(const PngBitmap&) = delete;
+  PngBitmap& operator=(const PngBitmap&) = delete;
+
+  bool IsValid() const { return bitmap_ != nullptr; }
+
+  int GetWidth() const {
+    return GetSize(GetPngJniIds().get_width_method);
+  }
+  int GetHeight() const {
+    return GetSize(GetPngJniIds().get_height_method);
+  }
+
+  // Uploads the bitmap to the texture bound to |target| and returns the
+  // size of its pixels.  Must be called from the renderer thread.
+  size_t Upload(int target) const {
+    const PngJniIds& ids = GetPngJniIds();
+    JNIEnv* env = GetJniEnv();
+    env->CallStaticVoidMethod(ids.helper_class, ids.load_texture_method,
+                              target, bitmap_);
+    if (!ids.get_byte_count_method) {
+      return 0;
+    }
+    return static_cast<size_t>(
+        env->CallIntMethod(bitmap_, ids.get_byte_count_method));
+  }
+
+ private:
+  int GetSize(jmethodID method) const {
+    return method != nullptr && bitmap_ != nullptr
+               ? GetJniEnv()->CallIntMethod(bitmap_, method)
+               : 0;
+  }
+
+  jobject bitmap_ = nullptr;
+};
+
+namespace {
+// The KTX2 asset that replaces the PNG asset at |path|, or an empty string if
+// |path| is not a PNG.
+std::string GetKtx2Path(const std::string& path) {
+  constexpr char kPngExtension[] = ".png";
+  const size_t extension = path.rfind(kPngExtension);
+  if (extension == std::string::npos ||
+      extension + strlen(kPngExtension) != path.size()) {
+    return std::string();
+  }
+  return path.substr(0, extension) + ".ktx2";
+}
+
+bool UsesMipmaps(GLint min_filter) {
+  return min_filter != GL_NEAREST && min_filter != GL_LINEAR;
+}
+
+// Accounts for a texture whose base level of |bytes| was uploaded, with the
+// mipmaps glGenerateMipmap() adds a third more.
+void TrackCachedTexture(GLuint texture, size_t bytes, bool generated_mipmaps) {
+  ResourceAccounting::Get().Track(GpuResourceType::kTexture, texture,
+                                  generated_mipmaps ? bytes * 4 / 3 : bytes,
+                                  "TextureCache");
+}
+}  // namespace
+
+constexpr size_t TextureCache::kMaxRetainedBitmapBytes;
+
+TextureCache& TextureCache::Get() {
+  static TextureCache cache;
+  return cache;
+}
+
+void InitializePngJniIds() { GetPngJniIds(); }
+
+void TextureCache::Reset(AAssetManager* asset_manager,
+                         AssetLoader* asset_loader) {
+  textures_.clear();
+  orphaned_textures_.clear();
+  asset_manager_ = asset_manager;
+  asset_loader_ = asset_loader;
+  // Both need the renderer thread, whereas the loads may run elsewhere.
+  astc_supported_ = IsAstcSupported();
+  GetPngJniIds();
+}
+
+GLuint TextureCache::Acquire(const char* path, GLint wrap_mode,
+                             GLint min_filter) {
+  Entry& entry = textures_[Key{path, wrap_mode, min_filter}];
+  ++entry.references;
+  if (entry.texture != 0) {
+    return entry.texture;
+  }
+  entry.path = path;
+
+  glGenTextures(1, &entry.texture);
+  GlStateCache::Get().BindTexture(GL_TEXTURE_2D, entry.texture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap_mode);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap_mode);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, min_filter);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  const std::string ktx2_path = GetKtx2Path(path);
+  const auto retained = retained_bitmaps_.find(path);
+  if (retained != retained_bitmaps_.end()) {
+    // Lost with the previous context; only the upload is repeated.
+    entry.ready = true;
+    SetImageSize(*retained->second.bitmap, &entry);
+    UploadBitmap(*retained->second.bitmap, min_filter, entry.texture);
+    return entry.texture;
+  }
+  if (asset_loader_ != nullptr) {
+    if (asset_loader_->GetUploadThread() != nullptr) {
+      // The upload thread's context only sees the texture and its
+      // parameters once they were flushed.
+      glFlush();
+    }
+    entry.load_id = ++last_load_id_;
+    SubmitLoad(path, ktx2_path, min_filter, entry.load_id, entry.texture);
+    return entry.texture;
+  }
+
+  entry.ready = true;
+  size_t uploaded_bytes = 0;
+  if (!ktx2_path.empty() && asset_manager_ != nullptr &&
+      LoadKtx2FromAssetManager(GL_TEXTURE_2D, ktx2_path.c_str(),
+                               asset_manager_, &uploaded_bytes)) {
+    TrackCachedTexture(entry.texture, uploaded_bytes, false);
+    return entry.texture;
+  }
+  auto bitmap = std::make_shared<const PngBitmap>(path);
+  if (!bitmap->IsValid()) {
+    LOGE("Could not load png texture %s.", path);
+    return entry.texture;
+  }
+  SetImageSize(*bitmap, &entry);
+  RetainBitmap(path, bitmap, UploadBitmap(*bitmap, min_filter, entry.texture));
+  return entry.texture;
+}
+
+size_t TextureCache::UploadBitmap(const PngBitmap& bitmap, GLint min_filter,
+                                  GLuint texture) {
+  const size_t uploaded_bytes = bitmap.Upload(GL_TEXTURE_2D);
+  if (UsesMipmaps(min_filter)) {
+    glGenerateMipmap(GL_TEXTURE_2D);
+  }
+  TrackCachedTexture(texture, uploaded_bytes, UsesMipmaps(min_filter));
+  return uploaded_bytes;
+}
+
+void TextureCache::SetImageSize(const PngBitmap& bitmap, Entry* entry) {
+  entry->width = bitmap.GetWidth();
+  entry->height = bitmap.GetHeight();
+}
+
+void TextureCache::RetainBitmap(const std::string& path,
+                                std::shared_ptr<const PngBitmap> bitmap,
+                                size_t bytes) {
+  if (retained_bytes_ + bytes > kMaxRetainedBitmapBytes ||
+      retained_bitmaps_.count(path) != 0) {
+    return;
+  }
+  RetainedBitmap& retained = retained_bitmaps_[path];
+  retained.bitmap = std::move(bitmap);
+  retained.bytes = bytes;
+  retained_bytes_ += bytes;
+}
+
+void TextureCache::SubmitLoad(const std::string& path,
+                              const std::string& ktx2_path, GLint min_filter,
+                              uint64_t load_id, GLuint texture) {
+  AAssetManager* asset_manager = asset_manager_;
+  const bool astc_supported = astc_supported_;
+  AssetLoader* asset_loader = asset_loader_;
+  asset_loader_->Submit([this, path, ktx2_path, min_filter, load_id, texture,
+                         asset_manager, astc_supported,
+                         asset_loader]() -> AssetLoader::Upload {
+    auto ktx2 = std::make_shared<Ktx2Texture>();
+    std::shared_ptr<const PngBitmap> bitmap;
+    if (ktx2_path.empty() || asset_manager == nullptr ||
+        !ktx2->Open(ktx2_path.c_str(), asset_manager, astc_supported)) {
+      ktx2 = nullptr;
+      bitmap = std::make_shared<const PngBitmap>(path.c_str());
+    }
+
+    // The texture object exists since Acquire(), and is kept until the load
+    // finished, so the upload thread can fill it by name.
+    GlUploadThread* upload_thread = asset_loader->GetUploadThread();
+    if (upload_thread != nullptr &&
+        upload_thread->Submit([this, ktx2, bitmap, path, min_filter, load_id,
+                               texture]() -> GlUploadThread::Publish {
+          glBindTexture(GL_TEXTURE_2D, texture);
+          size_t bytes = 0;
+          if (ktx2 != nullptr) {
+            bytes = ktx2->Upload(GL_TEXTURE_2D);
+            TrackCachedTexture(texture, bytes, false);
+          } else if (bitmap->IsValid()) {
+            bytes = UploadBitmap(*bitmap, min_filter, texture);
+          }
+          glBindTexture(GL_TEXTURE_2D, 0);
+          return [this, bitmap, path, load_id, bytes] {
+            Entry* entry = FindLoadedEntry(load_id);
+            if (entry == nullptr) {
+              return;
+            }
+            entry->ready = true;
+            if (bitmap == nullptr) {
+              return;
+            }
+            if (!bitmap->IsValid()) {
+              LOGE("Could not load png texture %s.", path.c_str());
+              return;
+            }
+            SetImageSize(*bitmap, entry);
+            RetainBitmap(path, bitmap, bytes);
+          };
+        })) {
+      return AssetLoader::Upload();
+    }
+
+    if (ktx2 != nullptr) {
+      return [this, ktx2, load_id] {
+        Entry* entry = BindForUpload(load_id);
+        if (entry != nullptr) {
+          TrackCachedTexture(entry->texture, ktx2->Upload(GL_TEXTURE_2D),
+                             false);
+          entry->ready = true;
+        }
+      };
+    }
+    return [this, bitmap, path, min_filter, load_id] {
+      Entry* entry = BindForUpload(load_id);
+      if (entry == nullptr) {
+        return;
+      }
+      entry->ready = true;
+      if (!bitmap->IsValid()) {
+        LOGE("Could not load png texture %s.", path.c_str());
+        return;
+      }
+      SetImageSize(*bitmap, entry);
+      RetainBitmap(path, bitmap,
+                   UploadBitmap(*bitmap, min_filter, entry->texture));
+    };
+  });
+}
+
+TextureCache::Entry* TextureCache::BindForUpload(uint64_t load_id) {
+  Entry* entry = FindLoadedEntry(load_id);
+  if (entry != nullptr) {
+    GlStateCache::Get().BindTexture(GL_TEXTURE_2D, entry->texture);
+  }
+  return entry;
+}
+
+TextureCache::Entry* TextureCache::FindLoadedEntry(uint64_t load_id) {
+  for (auto& texture : textures_) {
+    if (texture.second.load_id == load_id) {
+      return &texture.second;
+    }
+  }
+  // Released while loading, or lost with the context.
+  const auto orphaned = orphaned_textures_.find(load_id);
+  if (orphaned != orphaned_textures_.end()) {
+    GlStateCache::Get().DeleteTexture(orphaned->second);
+    orphaned_textures_.erase(orphaned);
+  }
+  return nullptr;
+}
+
+bool TextureCache::IsReady(GLuint texture) const {
+  for (const auto& entry : textures_) {
+    if (entry.second.texture == texture) {
+      return entry.second.ready;
+    }
+  }
+  return false;
+}
+
+bool TextureCache::GetUncompressedSize(GLuint texture, int* width,
+                                       int* height) const {
+  for (const auto& entry : textures_) {
+    if (entry.second.texture == texture) {
+      *width = entry.second.width;
+      *height = entry.second.height;
+      return entry.second.ready && entry.second.width > 0 &&
+             entry.second.height > 0;
+    }
+  }
+  return false;
+}
+
+void TextureCache::Release(GLuint texture) {
+  for (auto it = textures_.begin(); it != textures_.end(); ++it) {
+    if (it->second.texture != texture) {
+      continue;
+    }
+    if (--it->second.references == 0) {
+      if (!it->second.ready && it->second.load_id != 0) {
+        orphaned_textures_[it->second.load_id] = texture;
+      } else {
+        GlStateCache::Get().DeleteTexture(texture);
+      }
+      // Released on purpose, so it is not needed in the next context either.
+      const auto retained = retained_bitmaps_.find(it->second.path);
+      if (retained != retained_bitmaps_.end()) {
+        retained_bytes_ -= retained->second.bytes;
+        retained_bitmaps_.erase(retained);
+      }
+      textures_.erase(it);
+    }
+    return;
+  }
+}
+
 void ThrowJavaException(JNIEnv* env, const char* msg) {
   LOGE("Throw Java exception: %s", msg);
   jclass c = env->FindClass("java/lang/RuntimeException");
   env->ThrowNew(c, msg);
 }
 
-// Convenience function used in CreateProgram below.
-static GLuint LoadShader(GLenum shader_type, const char* shader_source) {
-  GLuint shader = glCreateShader(shader_type);
-  if (!shader) {
-    return shader;
-  }
+namespace {
+// Header written in front of every cached program binary.
+struct ProgramBinaryHeader {
+  uint32_t magic;
+  uint32_t binary_format;
+  uint32_t binary_length;
+};
+constexpr uint32_t kProgramBinaryMagic = 0x50475241;  // 'ARGP'
 
-  glShaderSource(shader, 1, &shader_source, nullptr);
-  glCompileShader(shader);
-  GLint compiled = 0;
-  glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+std::string& ProgramCacheDirectory() {
+  static std::string directory;
+  return directory;
+}
 
-  if (!compiled) {
-    GLint info_len = 0;
+// 64-bit FNV-1a, stable across runs and devices.
+uint64_t HashString(const std::string& text, uint64_t hash) {
+  for (unsigned char c : text) {
+    hash ^= c;
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
 
-    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &info_len);
-    if (!info_len) {
-      return shader;
-    }
+// Returns the cache file path for the given program sources, or an empty
+// string if the cache is disabled or the driver cannot export binaries.
+std::string GetProgramCachePath(const std::string& vertex_shader_content,
+                                const std::string& fragment_shader_content) {
+  const std::string& directory = ProgramCacheDirectory();
+  if (directory.empty()) {
+    return std::string();
+  }
+  GLint num_binary_formats = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_binary_formats);
+  if (num_binary_formats <= 0) {
+    return std::string();
+  }
 
-    char* buf = reinterpret_cast<char*>(malloc(info_len));
-    if (!buf) {
-      return shader;
+  // Binaries are only valid for the driver that produced them, so the driver
+  // strings are part of the key and a driver update naturally misses.
+  uint64_t hash = 14695981039346656037ull;
+  for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+    const GLubyte* value = glGetString(name);
+    if (value != nullptr) {
+      hash = HashString(reinterpret_cast<const char*>(value), hash);
     }
+  }
+  hash = HashString(vertex_shader_content, hash);
+  hash = HashString(std::string(1, '\0'), hash);
+  hash = HashString(fragment_shader_content, hash);
 
-    glGetShaderInfoLog(shader, info_len, nullptr, buf);
-    LOGE("hello_ar::util::Could not compile shader %d:\n%s\n", shader_type,
-         buf);
-    free(buf);
-    glDeleteShader(shader);
-    shader = 0;
+  char file_name[32];
+  snprintf(file_name, sizeof(file_name), "/program_%016llx.bin",
+           static_cast<unsigned long long>(hash));
+  return directory + file_name;
+}
+
+// Tries to create a program from a previously persisted binary.
+// @return the linked program, or 0 on a cache miss or stale binary.
+GLuint LoadCachedProgram(const std::string& path) {
+  FILE* file = fopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    return 0;
+  }
+  ProgramBinaryHeader header;
+  std::vector<uint8_t> binary;
+  bool read_ok = fread(&header, sizeof(header), 1, file) == 1 &&
+                 header.magic == kProgramBinaryMagic &&
+                 header.binary_length > 0;
+  if (read_ok) {
+    binary.resize(header.binary_length);
+    read_ok = fread(binary.data(), 1, binary.size(), file) == binary.size();
+  }
+  fclose(file);
+  if (!read_ok) {
+    return 0;
+  }
+
+  GLuint program = glCreateProgram();
+  if (!program) {
+    return 0;
+  }
+  glProgramBinary(program, header.binary_format, binary.data(),
+                  static_cast<GLsizei>(binary.size()));
+  GLint link_status = GL_FALSE;
+  glGetProgramiv(program, GL_LINK_STATUS, &link_status);
+  // Clears the GL_INVALID_ENUM a driver may raise for a rejected format.
+  while (glGetError() != GL_NO_ERROR) {
+  }
+  if (link_status != GL_TRUE) {
+    // The driver rejected the binary; it is rewritten once the program is
+    // linked from source.
+    glDeleteProgram(program);
+    return 0;
   }
+  return program;
+}
 
-  return shader;
+// Persists the binary of a linked program, ignoring any failure since the
+// cache is only an optimization.
+void StoreCachedProgram(GLuint program, const std::string& path) {
+  GLint binary_length = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binary_length);
+  if (binary_length <= 0) {
+    return;
+  }
+  std::vector<uint8_t> binary(binary_length);
+  ProgramBinaryHeader header;
+  header.magic = kProgramBinaryMagic;
+  GLenum binary_format = 0;
+  GLsizei written_length = 0;
+  glGetProgramBinary(program, binary_length, &written_length, &binary_format,
+                     binary.data());
+  if (written_length <= 0) {
+    return;
+  }
+  header.binary_format = binary_format;
+  header.binary_length = static_cast<uint32_t>(written_length);
+
+  // Writes to a temporary file first so a crash never leaves a truncated
+  // binary behind under the final name.
+  const std::string temp_path = path + ".tmp";
+  FILE* file = fopen(temp_path.c_str(), "wb");
+  if (file == nullptr) {
+    LOGE("Could not write program cache %s: %s", temp_path.c_str(),
+         strerror(errno));
+    return;
+  }
+  bool write_ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                  fwrite(binary.data(), 1, written_length, file) ==
+                      static_cast<size_t>(written_length);
+  write_ok = (fclose(file) == 0) && write_ok;
+  if (!write_ok || rename(temp_path.c_str(), path.c_str()) != 0) {
+    unlink(temp_path.c_str());
+  }
 }
 
-GLuint CreateProgram(const char* vertex_shader_file_name,
-                     const char* fragment_shader_file_name,
-                     AAssetManager* asset_manager) {
-  std::map<std::string, int> empty_define;
-  return CreateProgram(vertex_shader_file_name, fragment_shader_file_name,
-                       asset_manager, empty_define);
+// A program submitted to the driver whose link status was not queried yet.
+struct StartedProgram {
+  GLuint program = 0;
+  // Reloaded from a binary, whose link status is already known.
+  bool from_binary = false;
+  // Where to persist the binary once linked, if anywhere.
+  std::string cache_path;
+};
+
+// Programs from StartProgram() not claimed by CreateProgram() yet, indexed
+// by ShaderVariant.  Unstarted entries have no program.
+StartedProgram* StartedPrograms() {
+  static StartedProgram programs[kShaderVariantCount];
+  return programs;
 }
-GLuint CreateProgram(const char* vertex_shader_file_name,
-                     const char* fragment_shader_file_name,
-                     AAssetManager* asset_manager,
-                     const std::map<std::string, int>& define_values_map) {
-  std::string vertexShaderContent;
-  if (!LoadTextFileFromAssetManager(vertex_shader_file_name, asset_manager,
-                                    &vertexShaderContent)) {
-    LOGE("Failed to load file: %s", vertex_shader_file_name);
+
+// Compiles and links the program without querying any status, which would
+// wait for the driver to finish.
+GLuint SubmitProgram(const std::string& vertex_shader_content,
+                     const std::string& fragment_shader_content,
+                     bool retrievable) {
+  GLuint program = glCreateProgram();
+  if (!program) {
     return 0;
   }
+  const GLenum shader_types[] = {GL_VERTEX_SHADER, GL_FRAGMENT_SHADER};
+  const std::string* shader_sources[] = {&vertex_shader_content,
+                                         &fragment_shader_content};
+  for (int i = 0; i < 2; ++i) {
+    GLuint shader = glCreateShader(shader_types[i]);
+    const char* source = shader_sources[i]->c_str();
+    glShaderSource(shader, 1, &source, nullptr);
+    glCompileShader(shader);
+    glAttachShader(program, shader);
+    CheckGlError("hello_ar::util::glAttachShader");
+    // Only flagged, the shader lives as long as it is attached.
+    glDeleteShader(shader);
+  }
+  if (retrievable) {
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  }
+  glLinkProgram(program);
+  return program;
+}
+
+void LogShaderCompileErrors(GLuint program) {
+  GLuint shaders[2] = {0, 0};
+  GLsizei shader_count = 0;
+  glGetAttachedShaders(program, 2, &shader_count, shaders);
+  for (GLsizei i = 0; i < shader_count; ++i) {
+    GLint compiled = GL_FALSE;
+    glGetShaderiv(shaders[i], GL_COMPILE_STATUS, &compiled);
+    if (compiled) {
+      continue;
+    }
+    GLint shader_type = 0;
+    glGetShaderiv(shaders[i], GL_SHADER_TYPE, &shader_type);
+    GLint info_len = 0;
+    glGetShaderiv(shaders[i], GL_INFO_LOG_LENGTH, &info_len);
+    std::string info_log(std::max(info_len, 1), '\0');
+    glGetShaderInfoLog(shaders[i], info_len, nullptr, &info_log[0]);
+    LOGE("hello_ar::util::Could not compile shader %d:\n%s\n", shader_type,
+         info_log.c_str());
+  }
+}
 
-  std::string fragmentShaderContent;
-  if (!LoadTextFileFromAssetManager(fragment_shader_file_name, asset_manager,
-                                    &fragmentShaderContent)) {
-    LOGE("Failed to load file: %s", fragment_shader_file_name);
+// Waits for |program| from SubmitProgram() to link.
+// @return the program, or 0 after deleting it if it did not link.
+GLuint FinishProgram(GLuint program, const std::string& cache_path) {
+  GLint link_status = GL_FALSE;
+  glGetProgramiv(program, GL_LINK_STATUS, &link_status);
+  if (link_status != GL_TRUE) {
+    LogShaderCompileErrors(program);
+    GLint buf_length = 0;
+    glGetProgramiv(program, GL_INFO_LOG_LENGTH, &buf_length);
+    if (buf_length) {
+      char* buf = reinterpret_cast<char*>(malloc(buf_length));
+      if (buf) {
+        glGetProgramInfoLog(program, buf_length, nullptr, buf);
+        LOGE("hello_ar::util::Could not link program:\n%s\n", buf);
+        free(buf);
+      }
+    }
+    glDeleteProgram(program);
     return 0;
   }
+  if (!cache_path.empty()) {
+    StoreCachedProgram(program, cache_path);
+  }
+  return program;
+}
+
+// Loads the shader sources of |info| with its defines prepended and submits
+// the program, or reloads its cached binary.
+bool BeginProgram(const ShaderVariantInfo& info, AAssetManager* asset_manager,
+                  StartedProgram* started) {
+  std::string vertexShaderContent = info.defines;
+  std::string shader_source;
+  if (!LoadTextFileFromAssetManager(info.vertex_shader_file_name,
+                                    asset_manager, &shader_source)) {
+    LOGE("Failed to load file: %s", info.vertex_shader_file_name);
+    return false;
+  }
+  vertexShaderContent += shader_source;
 
-  // Prepend any #define values specified during this run.
-  std::stringstream defines;
-  for (const auto& entry : define_values_map) {
-    defines << "#define " << entry.first << " " << entry.second << "\n";
+  std::string fragmentShaderContent = info.defines;
+  if (!LoadTextFileFromAssetManager(info.fragment_shader_file_name,
+                                    asset_manager, &shader_source)) {
+    LOGE("Failed to load file: %s", info.fragment_shader_file_name);
+    return false;
   }
-  fragmentShaderContent = defines.str() + fragmentShaderContent;
-  vertexShaderContent = defines.str() + vertexShaderContent;
+  fragmentShaderContent += shader_source;
 
-  // Compiles shader code.
-  GLuint vertexShader =
-      LoadShader(GL_VERTEX_SHADER, vertexShaderContent.c_str());
-  if (!vertexShader) {
-    return 0;
+  const std::string cache_path =
+      GetProgramCachePath(vertexShaderContent, fragmentShaderContent);
+  if (!cache_path.empty()) {
+    GLuint cached_program = LoadCachedProgram(cache_path);
+    if (cached_program) {
+      started->program = cached_program;
+      started->from_binary = true;
+      return true;
+    }
+  }
+
+  started->program = SubmitProgram(vertexShaderContent, fragmentShaderContent,
+                                   !cache_path.empty());
+  started->cache_path = cache_path;
+  return started->program != 0;
+}
+}  // namespace
+
+void SetProgramCacheDirectory(const std::string& directory) {
+  ProgramCacheDirectory() = directory;
+}
+
+void ResetStartedPrograms() {
+  // The names belong to the previous context.
+  std::fill_n(StartedPrograms(), kShaderVariantCount, StartedProgram());
+  if (HasGlExtension("GL_KHR_parallel_shader_compile")) {
+    auto max_shader_compiler_threads =
+        reinterpret_cast<PFNGLMAXSHADERCOMPILERTHREADSKHRPROC>(
+            eglGetProcAddress("glMaxShaderCompilerThreadsKHR"));
+    if (max_shader_compiler_threads != nullptr) {
+      // 0xFFFFFFFF leaves the number of threads to the driver.
+      max_shader_compiler_threads(0xFFFFFFFFu);
+    }
+  }
+}
+
+void StartProgram(ShaderVariant variant, AAssetManager* asset_manager) {
+  StartedProgram& started = StartedPrograms()[static_cast<int>(variant)];
+  if (started.program != 0) {
+    return;
+  }
+  if (!BeginProgram(GetShaderVariantInfo(variant), asset_manager, &started)) {
+    started = StartedProgram();
+  }
+}
+
+void StartAllPrograms(AAssetManager* asset_manager) {
+  for (const ShaderVariantInfo& info : kShaderVariants) {
+    StartProgram(info.variant, asset_manager);
   }
+}
 
-  GLuint fragment_shader =
-      LoadShader(GL_FRAGMENT_SHADER, fragmentShaderContent.c_str());
-  if (!fragment_shader) {
+GLuint CreateProgram(ShaderVariant variant, AAssetManager* asset_manager) {
+  const ShaderVariantInfo& info = GetShaderVariantInfo(variant);
+  StartedProgram& pending = StartedPrograms()[static_cast<int>(variant)];
+  StartedProgram started;
+  if (pending.program != 0) {
+    started = pending;
+    pending = StartedProgram();
+  } else if (!BeginProgram(info, asset_manager, &started)) {
     return 0;
   }
+  const GLuint program =
+      started.from_binary
+          ? started.program
+          : FinishProgram(started.program, started.cache_path);
+  if (program) {
+    // The binary length is the closest to the program's size GL reports.
+    GLint binary_length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binary_length);
+    ResourceAccounting::Get().Track(GpuResourceType::kProgram, program,
+                                    static_cast<size_t>(binary_length),
+                                    info.fragment_shader_file_name);
+  }
+  return program;
+}
 
+bool IsContextVersionAtLeast31() {
+  GLint major = 0;
+  GLint minor = 0;
+  glGetIntegerv(GL_MAJOR_VERSION, &major);
+  glGetIntegerv(GL_MINOR_VERSION, &minor);
+  return major > 3 || (major == 3 && minor >= 1);
+}
+
+GLuint CreateComputeProgram(const char* file_name,
+                            AAssetManager* asset_manager) {
+  std::string shader_source;
+  if (!LoadTextFileFromAssetManager(file_name, asset_manager,
+                                    &shader_source)) {
+    LOGE("Failed to load file: %s", file_name);
+    return 0;
+  }
   GLuint program = glCreateProgram();
+  if (!program) {
+    return 0;
+  }
+  GLuint shader = glCreateShader(GL_COMPUTE_SHADER);
+  const char* source = shader_source.c_str();
+  glShaderSource(shader, 1, &source, nullptr);
+  glCompileShader(shader);
+  glAttachShader(program, shader);
+  CheckGlError("hello_ar::util::glAttachShader");
+  glDeleteShader(shader);
+  glLinkProgram(program);
+  program = FinishProgram(program, std::string());
   if (program) {
-    glAttachShader(program, vertexShader);
-    CheckGlError("hello_ar::util::glAttachShader");
-    glAttachShader(program, fragment_shader);
-    CheckGlError("hello_ar::util::glAttachShader");
-    glLinkProgram(program);
-    GLint link_status = GL_FALSE;
-    glGetProgramiv(program, GL_LINK_STATUS, &link_status);
-    if (link_status != GL_TRUE) {
-      GLint buf_length = 0;
-      glGetProgramiv(program, GL_INFO_LOG_LENGTH, &buf_length);
-      if (buf_length) {
-        char* buf = reinterpret_cast<char*>(malloc(buf_length));
-        if (buf) {
-          glGetProgramInfoLog(program, buf_length, nullptr, buf);
-          LOGE("hello_ar::util::Could not link program:\n%s\n", buf);
-          free(buf);
-        }
-      }
-      glDeleteProgram(program);
-      program = 0;
-    }
+    GLint binary_length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binary_length);
+    ResourceAccounting::Get().Track(GpuResourceType::kProgram, program,
+                                    static_cast<size_t>(binary_length),
+                                    file_name);
   }
   return program;
 }
@@ -177,242 +1201,232 @@ bool LoadTextFileFromAssetManager(const char* file_name,
   return true;
 }
 
-bool LoadPngFromAssetManager(int target, const char* path) {
-  JNIEnv* env = GetJniEnv();
-
-  // Put all the JNI values in a structure that is statically initialized on the
-  // first call to this method.  This makes it thread safe in the unlikely case
-  // of multiple threads calling this method.
-  static struct JNIData {
-    jclass helper_class;
-    jmethodID load_image_method;
-    jmethodID load_texture_method;
-  } jniIds = [env]() -> JNIData {
-    constexpr char kHelperClassName[] =
-        "com/google/ar/core/examples/c/helloar/JniInterface";
-    constexpr char kLoadImageMethodName[] = "loadImage";
-    constexpr char kLoadImageMethodSignature[] =
-        "(Ljava/lang/String;)Landroid/graphics/Bitmap;";
-    constexpr char kLoadTextureMethodName[] = "loadTexture";
-    constexpr char kLoadTextureMethodSignature[] =
-        "(ILandroid/graphics/Bitmap;)V";
-    jclass helper_class = FindClass(kHelperClassName);
-    if (helper_class) {
-      helper_class = static_cast<jclass>(env->NewGlobalRef(helper_class));
-      jmethodID load_image_method = env->GetStaticMethodID(
-          helper_class, kLoadImageMethodName, kLoadImageMethodSignature);
-      jmethodID load_texture_method = env->GetStaticMethodID(
-          helper_class, kLoadTextureMethodName, kLoadTextureMethodSignature);
-      return {helper_class, load_image_method, load_texture_method};
-    }
-    LOGE("hello_ar::util::Could not find Java helper class %s",
-         kHelperClassName);
-    return {};
-  }();
-
-  if (!jniIds.helper_class) {
+bool LoadPngFromAssetManager(int target, const char* path,
+                             size_t* uploaded_bytes) {
+  const PngBitmap bitmap(path);
+  if (!bitmap.IsValid()) {
     return false;
   }
-
-  jstring j_path = env->NewStringUTF(path);
-
-  jobject image_obj = env->CallStaticObjectMethod(
-      jniIds.helper_class, jniIds.load_image_method, j_path);
-
-  if (j_path) {
-    env->DeleteLocalRef(j_path);
+  const size_t bytes = bitmap.Upload(target);
+  if (uploaded_bytes != nullptr) {
+    *uploaded_bytes = bytes;
   }
-
-  env->CallStaticVoidMethod(jniIds.helper_class, jniIds.load_texture_method,
-                            target, image_obj);
   return true;
 }
 
-bool LoadObjFile(const std::string& file_name, AAssetManager* asset_manager,
-                 std::vector<GLfloat>* out_vertices,
-                 std::vector<GLfloat>* out_normals,
-                 std::vector<GLfloat>* out_uv,
-                 std::vector<GLushort>* out_indices) {
-  std::vector<GLfloat> temp_positions;
-  std::vector<GLfloat> temp_normals;
-  std::vector<GLfloat> temp_uvs;
-  std::vector<GLushort> vertex_indices;
-  std::vector<GLushort> normal_indices;
-  std::vector<GLushort> uv_indices;
-
-  std::string file_buffer;
-  bool read_success = LoadTextFileFromAssetManager(file_name.c_str(),
-                                                   asset_manager, &file_buffer);
-  if (!read_success) {
+bool LoadKtx2FromAssetManager(int target, const char* path,
+                              AAssetManager* asset_manager,
+                              size_t* uploaded_bytes) {
+  Ktx2Texture texture;
+  if (!texture.Open(path, asset_manager, IsAstcSupported())) {
     return false;
   }
-  std::stringstream file_string_stream(file_buffer);
-
-  while (!file_string_stream.eof()) {
-    char line_header[128];
-    file_string_stream.getline(line_header, 128);
-
-    if (line_header[0] == 'v' && line_header[1] == 'n') {
-      // Parse vertex normal.
-      GLfloat normal[3];
-      int matches = sscanf(line_header, "vn %f %f %f\n", &normal[0], &normal[1],
-                           &normal[2]);
-      if (matches != 3) {
-        LOGE("Format of 'vn float float float' required for each normal line");
-        return false;
-      }
+  const size_t bytes = texture.Upload(target);
+  if (uploaded_bytes != nullptr) {
+    *uploaded_bytes = bytes;
+  }
+  return true;
+}
 
-      temp_normals.push_back(normal[0]);
-      temp_normals.push_back(normal[1]);
-      temp_normals.push_back(normal[2]);
-    } else if (line_header[0] == 'v' && line_header[1] == 't') {
-      // Parse texture uv.
-      GLfloat uv[2];
-      int matches = sscanf(line_header, "vt %f %f\n", &uv[0], &uv[1]);
-      if (matches != 2) {
-        LOGE("Format of 'vt float float' required for each texture uv line");
-        return false;
-      }
+namespace {
+constexpr char kMeshFileMagic[4] = {'A', 'R', 'M', 'S'};
+constexpr uint32_t kFloatMeshFileVersion = 1;
+constexpr uint32_t kQuantizedMeshFileVersion = 2;
+// Version 1 headers end before the position decoding fields.
+constexpr size_t kFloatMeshFileHeaderSize =
+    offsetof(MeshFileHeader, position_offset);
 
-      temp_uvs.push_back(uv[0]);
-      temp_uvs.push_back(uv[1]);
-    } else if (line_header[0] == 'v') {
-      // Parse vertex.
-      GLfloat vertex[3];
-      int matches = sscanf(line_header, "v %f %f %f\n", &vertex[0], &vertex[1],
-                           &vertex[2]);
-      if (matches != 3) {
-        LOGE("Format of 'v float float float' required for each vertex line");
-        return false;
-      }
+static_assert(sizeof(QuantizedVertex) == 16,
+              "QuantizedVertex must match tools/obj_to_mesh.py");
 
-      temp_positions.push_back(vertex[0]);
-      temp_positions.push_back(vertex[1]);
-      temp_positions.push_back(vertex[2]);
-    } else if (line_header[0] == 'f') {
-      // Actual faces information starts from the second character.
-      char* face_line = &line_header[1];
-
-      unsigned int vertex_index[4];
-      unsigned int normal_index[4];
-      unsigned int texture_index[4];
-
-      std::vector<char*> per_vert_info_list;
-      char* per_vert_info_list_c_str;
-      char* face_line_iter = face_line;
-      while ((per_vert_info_list_c_str =
-                  strtok_r(face_line_iter, " ", &face_line_iter))) {
-        // Divide each faces information into individual positions.
-        per_vert_info_list.push_back(per_vert_info_list_c_str);
-      }
+// Rounds to the nearest half float, saturating to infinity.
+uint16_t FloatToHalf(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+  const int32_t float_exponent = static_cast<int32_t>((bits >> 23) & 0xff);
+  uint32_t mantissa = bits & 0x7fffff;
+  if (float_exponent == 0xff) {
+    return sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0);
+  }
+  const int32_t exponent = float_exponent - 127 + 15;
+  if (exponent >= 31) {
+    return sign | 0x7c00;
+  }
+  if (exponent <= 0) {
+    if (exponent < -10) {
+      return sign;
+    }
+    // Subnormal half, including the implicit leading one.
+    mantissa |= 0x800000;
+    const int shift = 14 - exponent;
+    uint32_t half = mantissa >> shift;
+    if ((mantissa >> (shift - 1)) & 1) {
+      ++half;
+    }
+    return sign | static_cast<uint16_t>(half);
+  }
+  uint32_t half = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+  if (mantissa & 0x1000) {
+    ++half;  // A carry into the exponent is still the right rounding.
+  }
+  return sign | static_cast<uint16_t>(half);
+}
 
-      bool is_normal_available = false;
-      bool is_uv_available = false;
-      for (int i = 0; i < per_vert_info_list.size(); ++i) {
-        char* per_vert_info;
-        int per_vert_infor_count = 0;
-
-        bool is_vertex_normal_only_face =
-            (strstr(per_vert_info_list[i], "//") != nullptr);
-
-        char* per_vert_info_iter = per_vert_info_list[i];
-        while ((per_vert_info =
-                    strtok_r(per_vert_info_iter, "/", &per_vert_info_iter))) {
-          // write only normal and vert values.
-          switch (per_vert_infor_count) {
-            case 0:
-              // Write to vertex indices.
-              vertex_index[i] = atoi(per_vert_info);  // NOLINT
-              break;
-            case 1:
-              // Write to texture indices.
-              if (is_vertex_normal_only_face) {
-                normal_index[i] = atoi(per_vert_info);  // NOLINT
-                is_normal_available = true;
-              } else {
-                texture_index[i] = atoi(per_vert_info);  // NOLINT
-                is_uv_available = true;
-              }
-              break;
-            case 2:
-              // Write to normal indices.
-              if (!is_vertex_normal_only_face) {
-                normal_index[i] = atoi(per_vert_info);  // NOLINT
-                is_normal_available = true;
-                break;
-              }
-              [[clang::fallthrough]];
-            // Intentionally falling to default error case because vertex
-            // normal face only has two values.
-            default:
-              // Error formatting.
-              LOGE(
-                  "Format of 'f int/int/int int/int/int int/int/int "
-                  "(int/int/int)' "
-                  "or 'f int//int int//int int//int (int//int)' required for "
-                  "each face");
-              return false;
-          }
-          per_vert_infor_count++;
-        }
-      }
+int16_t ToSignedNormalized(float value) {
+  return static_cast<int16_t>(
+      std::lround(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f));
+}
 
-      int vertices_count = per_vert_info_list.size();
-      for (int i = 2; i < vertices_count; ++i) {
-        vertex_indices.push_back(vertex_index[0] - 1);
-        vertex_indices.push_back(vertex_index[i - 1] - 1);
-        vertex_indices.push_back(vertex_index[i] - 1);
+// Projects |normal| on the octahedron and unfolds the lower half over the
+// corners, see "A Survey of Efficient Representations for Independent Unit
+// Vectors" (Cigolle et al. 2014).
+glm::vec2 EncodeOctahedral(const glm::vec3& normal) {
+  const float l1_norm =
+      std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+  if (l1_norm == 0.0f) {
+    return glm::vec2(0.0f);
+  }
+  glm::vec2 p = glm::vec2(normal) / l1_norm;
+  if (normal.z < 0.0f) {
+    p = (1.0f - glm::abs(glm::vec2(p.y, p.x))) *
+        glm::vec2(p.x >= 0.0f ? 1.0f : -1.0f, p.y >= 0.0f ? 1.0f : -1.0f);
+  }
+  return p;
+}
+}  // namespace
 
-        if (is_normal_available) {
-          normal_indices.push_back(normal_index[0] - 1);
-          normal_indices.push_back(normal_index[i - 1] - 1);
-          normal_indices.push_back(normal_index[i] - 1);
-        }
+void QuantizeVertices(const float* vertices, size_t vertex_count,
+                      std::vector<QuantizedVertex>* out_vertices,
+                      glm::vec3* out_position_offset,
+                      glm::vec3* out_position_scale) {
+  constexpr int kComponents = ObjMesh::kVertexComponents;
+  glm::vec3 lower(0.0f);
+  glm::vec3 upper(0.0f);
+  for (size_t i = 0; i < vertex_count; ++i) {
+    const glm::vec3 position = glm::make_vec3(&vertices[i * kComponents]);
+    lower = i == 0 ? position : glm::min(lower, position);
+    upper = i == 0 ? position : glm::max(upper, position);
+  }
+  const glm::vec3 extent = upper - lower;
+  *out_position_offset = lower;
+  *out_position_scale = extent;
 
-        if (is_uv_available) {
-          uv_indices.push_back(texture_index[0] - 1);
-          uv_indices.push_back(texture_index[i - 1] - 1);
-          uv_indices.push_back(texture_index[i] - 1);
-        }
-      }
+  out_vertices->resize(vertex_count);
+  for (size_t i = 0; i < vertex_count; ++i) {
+    const float* v = &vertices[i * kComponents];
+    QuantizedVertex& quantized = (*out_vertices)[i];
+    for (int axis = 0; axis < 3; ++axis) {
+      const float unit =
+          extent[axis] > 0.0f ? (v[axis] - lower[axis]) / extent[axis] : 0.0f;
+      quantized.position[axis] = static_cast<uint16_t>(
+          std::lround(std::min(std::max(unit, 0.0f), 1.0f) * 65535.0f));
     }
+    quantized.position[3] = 0xffff;
+    const glm::vec2 normal = EncodeOctahedral(glm::make_vec3(v + 3));
+    quantized.normal[0] = ToSignedNormalized(normal.x);
+    quantized.normal[1] = ToSignedNormalized(normal.y);
+    quantized.uv[0] = FloatToHalf(v[6]);
+    quantized.uv[1] = FloatToHalf(v[7]);
   }
+}
 
-  bool is_normal_available = (!normal_indices.empty());
-  bool is_uv_available = (!uv_indices.empty());
+MeshAsset::~MeshAsset() {
+  if (asset_ != nullptr) {
+    AAsset_close(asset_);
+  }
+}
 
-  if (is_normal_available && normal_indices.size() != vertex_indices.size()) {
-    LOGE("Obj normal indices does not equal to vertex indices.");
+bool MeshAsset::Open(const char* file_name, AAssetManager* asset_manager) {
+  asset_ = AAssetManager_open(asset_manager, file_name, AASSET_MODE_BUFFER);
+  if (asset_ == nullptr) {
+    LOGE("Error opening asset %s", file_name);
+    return false;
+  }
+  data_ = static_cast<const uint8_t*>(AAsset_getBuffer(asset_));
+  const size_t length = static_cast<size_t>(AAsset_getLength(asset_));
+  if (data_ == nullptr || length < kFloatMeshFileHeaderSize) {
+    LOGE("Could not map mesh %s", file_name);
     return false;
   }
 
-  if (is_uv_available && uv_indices.size() != vertex_indices.size()) {
-    LOGE("Obj UV indices does not equal to vertex indices.");
+  header_ = reinterpret_cast<const MeshFileHeader*>(data_);
+  const bool quantized = header_->version == kQuantizedMeshFileVersion;
+  const uint64_t vertex_bytes =
+      static_cast<uint64_t>(header_->vertex_count) * header_->vertex_stride;
+  const uint64_t index_bytes =
+      static_cast<uint64_t>(header_->index_count) * header_->index_size;
+  if (memcmp(header_->magic, kMeshFileMagic, sizeof(kMeshFileMagic)) != 0 ||
+      (header_->version != kFloatMeshFileVersion && !quantized) ||
+      (quantized && length < sizeof(MeshFileHeader)) ||
+      (header_->index_size != 2 && header_->index_size != 4) ||
+      header_->vertex_data_offset + vertex_bytes > length ||
+      header_->index_data_offset + index_bytes > length) {
+    LOGE("Mesh %s is malformed or has an unsupported version", file_name);
+    header_ = nullptr;
     return false;
   }
+  return true;
+}
 
-  for (unsigned int i = 0; i < vertex_indices.size(); i++) {
-    unsigned int vertex_index = vertex_indices[i];
-    out_vertices->push_back(temp_positions[vertex_index * 3]);
-    out_vertices->push_back(temp_positions[vertex_index * 3 + 1]);
-    out_vertices->push_back(temp_positions[vertex_index * 3 + 2]);
-    out_indices->push_back(i);
+const void* MeshAsset::GetVertexData() const {
+  return data_ + header_->vertex_data_offset;
+}
 
-    if (is_normal_available) {
-      unsigned int normal_index = normal_indices[i];
-      out_normals->push_back(temp_normals[normal_index * 3]);
-      out_normals->push_back(temp_normals[normal_index * 3 + 1]);
-      out_normals->push_back(temp_normals[normal_index * 3 + 2]);
-    }
+size_t MeshAsset::GetVertexDataSize() const {
+  return static_cast<size_t>(header_->vertex_count) * header_->vertex_stride;
+}
 
-    if (is_uv_available) {
-      unsigned int uv_index = uv_indices[i];
-      out_uv->push_back(temp_uvs[uv_index * 2]);
-      out_uv->push_back(temp_uvs[uv_index * 2 + 1]);
-    }
+const void* MeshAsset::GetIndexData() const {
+  return data_ + header_->index_data_offset;
+}
+
+size_t MeshAsset::GetIndexDataSize() const {
+  return static_cast<size_t>(header_->index_count) * header_->index_size;
+}
+
+GLenum MeshAsset::GetIndexType() const {
+  return header_->index_size == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+bool LoadObjFile(const std::string& file_name, AAssetManager* asset_manager,
+                 ObjMesh* out_mesh) {
+  // Parses straight out of the mapped asset instead of copying it first.
+  AAsset* asset =
+      AAssetManager_open(asset_manager, file_name.c_str(), AASSET_MODE_BUFFER);
+  if (asset == nullptr) {
+    LOGE("Error opening asset %s", file_name.c_str());
+    return false;
+  }
+  const char* data = static_cast<const char*>(AAsset_getBuffer(asset));
+  const size_t length = static_cast<size_t>(AAsset_getLength(asset));
+  std::string error;
+  const bool parsed =
+      data != nullptr && ParseObj(data, length, out_mesh, &error);
+  AAsset_close(asset);
+  if (!parsed) {
+    LOGE("Could not parse obj file %s: %s", file_name.c_str(),
+         data == nullptr ? "asset could not be mapped" : error.c_str());
   }
+  return parsed;
+}
 
-  return true;
+glm::mat4 MultiplyMatrices(const glm::mat4& a, const glm::mat4& b) {
+  return glm::mat4(glm::aligned_mat4(a) * glm::aligned_mat4(b));
+}
+
+glm::mat4 MultiplyMatrices(const glm::mat4& a, const glm::mat4& b,
+                           const glm::mat4& c) {
+  return glm::mat4(glm::aligned_mat4(a) * glm::aligned_mat4(b) *
+                   glm::aligned_mat4(c));
+}
+
+glm::mat4 InvertMatrix(const glm::mat4& matrix) {
+  return glm::mat4(glm::inverse(glm::aligned_mat4(matrix)));
+}
+
+glm::vec4 NormalizeVector(const glm::vec4& vector) {
+  return glm::vec4(glm::normalize(glm::aligned_vec4(vector)));
 }
 
 void Log4x4Matrix(const float raw_matrix[16]) {
@@ -427,6 +1441,12 @@ void Log4x4Matrix(const float raw_matrix[16]) {
       raw_matrix[14], raw_matrix[15]);
 }
 
+float Percentile(std::vector<float>* values, int percent) {
+  const size_t index = (values->size() - 1) * percent / 100;
+  std::nth_element(values->begin(), values->begin() + index, values->end());
+  return (*values)[index];
+}
+
 void GetTransformMatrixFromAnchor(const ArAnchor& ar_anchor,
                                   ArSession* ar_session,
                                   glm::mat4* out_model_mat) {
@@ -435,9 +1455,19 @@ void GetTransformMatrixFromAnchor(const ArAnchor& ar_anchor,
     return;
   }
   util::ScopedArPose pose(ar_session);
-  ArAnchor_getPose(ar_session, &ar_anchor, pose.GetArPose());
-  ArPose_getMatrix(ar_session, pose.GetArPose(),
-                   glm::value_ptr(*out_model_mat));
+  GetTransformMatrixFromAnchor(ar_anchor, ar_session, pose.GetArPose(),
+                               out_model_mat);
+}
+
+void GetTransformMatrixFromAnchor(const ArAnchor& ar_anchor,
+                                  ArSession* ar_session, ArPose* scratch_pose,
+                                  glm::mat4* out_model_mat) {
+  if (out_model_mat == nullptr) {
+    LOGE("util::GetTransformMatrixFromAnchor model_mat is null.");
+    return;
+  }
+  ArAnchor_getPose(ar_session, &ar_anchor, scratch_pose);
+  ArPose_getMatrix(ar_session, scratch_pose, glm::value_ptr(*out_model_mat));
 }
 
 glm::vec3 GetPlaneNormal(const ArSession& ar_session,
@@ -468,5 +1498,113 @@ float CalculateDistanceToPlane(const ArSession& ar_session,
   return glm::dot(normal, camera_P_plane);
 }
 
+float CalculateDistanceToPlane(const ArSession& ar_session,
+                               const ArPose& plane_pose,
+                               const glm::vec3& camera_position) {
+  float plane_pose_raw[7] = {0.f};
+  ArPose_getPoseRaw(&ar_session, &plane_pose, plane_pose_raw);
+  glm::vec3 plane_position(plane_pose_raw[4], plane_pose_raw[5],
+                           plane_pose_raw[6]);
+  glm::vec3 normal = GetPlaneNormal(ar_session, plane_pose);
+  return glm::dot(normal, camera_position - plane_position);
+}
+
+Frustum ExtractFrustum(const glm::mat4& view_projection_mat) {
+  // Gribb/Hartmann: each clip plane is the sum or difference of the last row
+  // and one of the other rows of the matrix.
+  const glm::mat4 rows = glm::transpose(view_projection_mat);
+  Frustum frustum;
+  frustum.planes[0] = rows[3] + rows[0];  // Left.
+  frustum.planes[1] = rows[3] - rows[0];  // Right.
+  frustum.planes[2] = rows[3] + rows[1];  // Bottom.
+  frustum.planes[3] = rows[3] - rows[1];  // Top.
+  frustum.planes[4] = rows[3] + rows[2];  // Near.
+  frustum.planes[5] = rows[3] - rows[2];  // Far.
+  for (glm::vec4& plane : frustum.planes) {
+    plane /= glm::length(glm::vec3(plane));
+  }
+  return frustum;
+}
+
+bool IsSphereInFrustum(const Frustum& frustum, const glm::vec3& center,
+                       float radius) {
+  for (const glm::vec4& plane : frustum.planes) {
+    if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+      return false;
+    }
+  }
+  return true;
+}
+
+namespace {
+// Positions of the quad vertices in clip space (X, Y).
+constexpr GLfloat kScreenQuadPositions[] = {
+    -1.0f, -1.0f, +1.0f, -1.0f, -1.0f, +1.0f, +1.0f, +1.0f,
+};
+constexpr GLsizeiptr kScreenQuadUvSetSize =
+    ScreenQuad::kNumUvComponents * sizeof(GLfloat);
+}  // namespace
+
+void ScreenQuad::InitializeGlContent(int uv_set_count) {
+  CHECK(uv_set_count >= 0 && uv_set_count <= kMaxUvSets);
+  static_assert(sizeof(kScreenQuadPositions) == kScreenQuadUvSetSize,
+                "Positions and texture coordinates must have the same size");
+  uv_set_count_ = uv_set_count;
+  for (auto& uvs : uvs_) {
+    std::fill(std::begin(uvs), std::end(uvs), 0.0f);
+  }
+
+  // The positions never change; the texture coordinates start out zeroed and
+  // are filled in by SetUvs().
+  glGenBuffers(1, &vertex_buffer_);
+  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+  glBufferData(GL_ARRAY_BUFFER, (1 + uv_set_count) * kScreenQuadUvSetSize,
+               nullptr, GL_STATIC_DRAW);
+  ResourceAccounting::Get().Track(GpuResourceType::kBuffer, vertex_buffer_,
+                                  (1 + uv_set_count) * kScreenQuadUvSetSize,
+                                  "ScreenQuad");
+  glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(kScreenQuadPositions),
+                  kScreenQuadPositions);
+  for (int i = 0; i < uv_set_count; ++i) {
+    glBufferSubData(GL_ARRAY_BUFFER, (1 + i) * kScreenQuadUvSetSize,
+                    kScreenQuadUvSetSize, uvs_[i]);
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void ScreenQuad::TransformCorners(const ArSession* session,
+                                  const ArFrame* frame,
+                                  ArCoordinates2dType uv_type,
+                                  float* out_uvs) {
+  ArFrame_transformCoordinates2d(
+      session, frame, AR_COORDINATES_2D_OPENGL_NORMALIZED_DEVICE_COORDINATES,
+      kNumVertices, kScreenQuadPositions, uv_type, out_uvs);
+}
+
+void ScreenQuad::SetUvs(int uv_set, const float* uvs) {
+  if (uv_set < 0 || uv_set >= uv_set_count_ ||
+      std::equal(uvs, uvs + kNumUvComponents, uvs_[uv_set])) {
+    return;
+  }
+  std::copy(uvs, uvs + kNumUvComponents, uvs_[uv_set]);
+  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+  glBufferSubData(GL_ARRAY_BUFFER, (1 + uv_set) * kScreenQuadUvSetSize,
+                  kScreenQuadUvSetSize, uvs);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void ScreenQuad::Draw(GLuint position_attrib, const GLuint* uv_attribs) const {
+  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+  glVertexAttribPointer(position_attrib, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+  for (int i = 0; i < uv_set_count_; ++i) {
+    glVertexAttribPointer(
+        uv_attribs[i], 2, GL_FLOAT, GL_FALSE, 0,
+        reinterpret_cast<const void*>((1 + i) * kScreenQuadUvSetSize));
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  glDrawArrays(GL_TRIANGLE_STRIP, 0, kNumVertices);
+}
+
 }  // namespace util
 }  // namespace hello_ar
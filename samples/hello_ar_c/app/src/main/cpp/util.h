@@ -27,10 +27,14 @@
 #include <cstdint>
 #include <cstdlib>
 #include <map>
+#include <memory>
+#include <string>
 #include <vector>
 
 #include "arcore_c_api.h"
 #include "glm.h"
+#include "obj_parser.h"
+#include "shader_variants.h"
 
 #ifndef LOGI
 #define LOGI(...) \
@@ -61,6 +65,8 @@
 
 namespace hello_ar {
 
+class AssetLoader;
+
 // Utilities for C hello AR project.
 namespace util {
 
@@ -86,34 +92,287 @@ class ScopedArPose {
 // @param operation, the name of the GL function call.
 void CheckGlError(const char* operation);
 
+// Shadows the GL state that the renderers commonly change and skips calls that
+// would not change it.  The samples render from a single GL context, so one
+// instance is shared by all renderers; call Reset() whenever a new context is
+// created.  Renderers set the state they need before each draw instead of
+// restoring defaults afterwards, which is what makes most calls redundant.
+//
+// Vertex attrib array enables are per vertex array object, so they are only
+// tracked for the default vertex array object.
+class GlStateCache {
+ public:
+  static GlStateCache& Get();
+
+  // Marks all state as unknown, so the next call of each kind reaches GL.
+  void Reset();
+
+  // Latches the number of skipped calls for the frame that just ended.  Call
+  // once at the start of every frame.
+  void BeginFrame();
+
+  // Returns the number of calls skipped during the previous frame.
+  int GetEliminatedCallsLastFrame() const { return eliminated_last_frame_; }
+
+  void UseProgram(GLuint program);
+  void SetCapability(GLenum capability, bool enabled);
+  void DepthMask(GLboolean flag);
+  void BlendFunc(GLenum source_factor, GLenum destination_factor);
+  void ActiveTexture(GLenum texture_unit);
+  void BindTexture(GLenum target, GLuint texture);
+  void BindVertexArray(GLuint vertex_array);
+
+  // Enables exactly the attrib arrays whose bit is set in |attrib_mask| on the
+  // default vertex array object, and disables all others, so no stale client
+  // arrays from another renderer stay enabled.
+  void SetEnabledVertexAttribArrays(uint32_t attrib_mask);
+
+  // Deletes a texture and forgets any binding to it.
+  void DeleteTexture(GLuint texture);
+
+ private:
+  static constexpr int kMaxTextureUnits = 8;
+  // GLES guarantees at least 16 vertex attribs.
+  static constexpr GLuint kMaxVertexAttribs = 16;
+  static constexpr GLint kUnknown = -1;
+
+  // Index of a tracked texture target in bound_textures_, or -1.
+  static int TextureTargetIndex(GLenum target);
+  // Index of a tracked capability in capabilities_, or -1.
+  static int CapabilityIndex(GLenum capability);
+
+  GLint program_ = kUnknown;
+  GLint capabilities_[3] = {kUnknown, kUnknown, kUnknown};
+  GLint depth_mask_ = kUnknown;
+  GLint blend_source_ = kUnknown;
+  GLint blend_destination_ = kUnknown;
+  GLint active_texture_unit_ = kUnknown;
+  GLint bound_textures_[kMaxTextureUnits][2];
+  GLint vertex_array_ = kUnknown;
+  uint32_t enabled_attribs_ = 0;
+  bool enabled_attribs_known_ = false;
+
+  int eliminated_calls_ = 0;
+  int eliminated_last_frame_ = 0;
+};
+
+class PngBitmap;
+
+// Textures decoded from PNG assets, shared by all renderers that sample the
+// same asset the same way, so that each asset is decoded and stored on the GPU
+// once.  Like GlStateCache there is one instance for the single GL context;
+// call Reset() whenever a new context is created.
+//
+// A compressed KTX2 asset next to the PNG, e.g. models/andy.ktx2 for
+// models/andy.png, is preferred if the GPU supports its format; see
+// LoadKtx2FromAssetManager().
+//
+// With an AssetLoader, textures are read and decoded on the job system and
+// uploaded by AssetLoader::RunUploads(), or on its GlUploadThread if that
+// runs; until then they have no image and IsReady() returns false.
+//
+// The decoded images of the PNG textures in use are kept, up to
+// kMaxRetainedBitmapBytes, so that textures acquired again after Reset() for
+// a new context are uploaded right away instead of decoded through Java.
+class TextureCache {
+ public:
+  static constexpr size_t kMaxRetainedBitmapBytes = 32 << 20;
+
+  static TextureCache& Get();
+
+  // Forgets all textures without deleting them, since their names are not
+  // valid in a new context, but keeps their decoded images.  KTX2 assets are
+  // looked up in |asset_manager|.
+  // Textures are loaded synchronously by Acquire() if |asset_loader| is null.
+  void Reset(AAssetManager* asset_manager, AssetLoader* asset_loader);
+
+  // Returns the 2D texture of the asset at |path| with |wrap_mode| on both
+  // axes and |min_filter|, loading it on the first request.  Mipmaps of PNG
+  // assets are generated if |min_filter| uses them, KTX2 assets bring their
+  // own.  Every call adds a reference that is dropped by Release().
+  GLuint Acquire(const char* path, GLint wrap_mode, GLint min_filter);
+
+  // Drops a reference to |texture| from Acquire() and deletes the texture and
+  // its decoded image with the last one.
+  void Release(GLuint texture);
+
+  // Whether the image of |texture| from Acquire() was uploaded, or failed to
+  // load.  Renderers skip drawing with textures that are not ready.
+  bool IsReady(GLuint texture) const;
+
+  // Size of the image of |texture| from Acquire() if it was decoded from a
+  // PNG, whose uncompressed pixels can be copied through a framebuffer, e.g.
+  // into the layers of a MaterialAtlas.  Returns false while the texture is
+  // not ready, if it failed to load, or if it came from a KTX2 asset.
+  bool GetUncompressedSize(GLuint texture, int* width, int* height) const;
+
+  // Number of distinct textures currently loaded.
+  int GetTextureCount() const { return static_cast<int>(textures_.size()); }
+
+ private:
+  struct Key {
+    std::string path;
+    GLint wrap_mode;
+    GLint min_filter;
+
+    bool operator<(const Key& other) const {
+      if (path != other.path) return path < other.path;
+      if (wrap_mode != other.wrap_mode) return wrap_mode < other.wrap_mode;
+      return min_filter < other.min_filter;
+    }
+  };
+  struct Entry {
+    std::string path;
+    GLuint texture = 0;
+    int references = 0;
+    bool ready = false;
+    // Size of the PNG image, zero for KTX2 textures.
+    int width = 0;
+    int height = 0;
+    // Identifies the asynchronous load of this entry, whose upload finds the
+    // entry by it.  Texture names may be reused once deleted, load ids not.
+    uint64_t load_id = 0;
+  };
+
+  void SubmitLoad(const std::string& path, const std::string& ktx2_path,
+                  GLint min_filter, uint64_t load_id, GLuint texture);
+
+  struct RetainedBitmap {
+    std::shared_ptr<const PngBitmap> bitmap;
+    size_t bytes = 0;
+  };
+
+  // Binds the texture of the entry with |load_id|, or returns nullptr if
+  // there is none anymore.
+  Entry* BindForUpload(uint64_t load_id);
+  // The entry with |load_id|, or nullptr after deleting the texture if it
+  // was released while loading.
+  Entry* FindLoadedEntry(uint64_t load_id);
+
+  // Uploads |bitmap| to the bound |texture| and returns the uploaded bytes.
+  static size_t UploadBitmap(const PngBitmap& bitmap, GLint min_filter,
+                             GLuint texture);
+  // Records the size of |bitmap| as that of the texture of |entry|.
+  static void SetImageSize(const PngBitmap& bitmap, Entry* entry);
+  // Keeps |bitmap| of |bytes| for the next context if it fits the budget.
+  void RetainBitmap(const std::string& path,
+                    std::shared_ptr<const PngBitmap> bitmap, size_t bytes);
+
+  std::map<Key, Entry> textures_;
+  // By asset path.  Only used on the OpenGL thread, like the rest.
+  std::map<std::string, RetainedBitmap> retained_bitmaps_;
+  size_t retained_bytes_ = 0;
+  AAssetManager* asset_manager_ = nullptr;
+  AssetLoader* asset_loader_ = nullptr;
+  bool astc_supported_ = false;
+  uint64_t last_load_id_ = 0;
+  // Textures released while their load ran, by load id.  The upload thread
+  // may still fill them, so the load deletes them when it finishes.
+  std::map<uint64_t, GLuint> orphaned_textures_;
+};
+
+// Fullscreen quad drawn as a triangle strip from a static vertex buffer.  The
+// buffer holds the clip space corner positions followed by up to kMaxUvSets
+// sets of corner texture coordinates, which are only re-uploaded when they
+// change, e.g. after a display geometry change.
+class ScreenQuad {
+ public:
+  static constexpr int kNumVertices = 4;
+  // Number of floats in one set of corner texture coordinates.
+  static constexpr int kNumUvComponents = kNumVertices * 2;
+  static constexpr int kMaxUvSets = 2;
+
+  ScreenQuad() = default;
+
+  ScreenQuad(const ScreenQuad&) = delete;
+  ScreenQuad& operator=(const ScreenQuad&) = delete;
+
+  // Creates the vertex buffer with |uv_set_count| texture coordinate sets.
+  // Must be called on the OpenGL thread before any other method.
+  void InitializeGlContent(int uv_set_count);
+
+  // Maps the quad corners to |uv_type| coordinates of |frame|, writing
+  // kNumUvComponents floats to |out_uvs|.
+  static void TransformCorners(const ArSession* session, const ArFrame* frame,
+                               ArCoordinates2dType uv_type, float* out_uvs);
+
+  // Uploads |uvs| as texture coordinate set |uv_set| unless the buffer already
+  // holds them.
+  void SetUvs(int uv_set, const float* uvs);
+
+  // Points |position_attrib| at the corner positions and |uv_attribs[i]| at
+  // texture coordinate set i, then draws the quad.  The attrib arrays must be
+  // enabled by the caller.
+  void Draw(GLuint position_attrib, const GLuint* uv_attribs) const;
+
+ private:
+  GLuint vertex_buffer_ = 0;
+  int uv_set_count_ = 0;
+  float uvs_[kMaxUvSets][kNumUvComponents] = {};
+};
+
 // Throw a Java exception.
 //
 // @param env, the JNIEnv.
 // @param msg, the message of this exception.
 void ThrowJavaException(JNIEnv* env, const char* msg);
 
-// Create a shader program ID.
+// Looks up the Java methods PNG textures are decoded and uploaded with.
+// TextureCache::Reset() does so too, so this is only needed if the renderer
+// thread was attached from native code, where FindClass() does not see the
+// app's classes.  Must be called on a thread that Java started first.
+void InitializePngJniIds();
+
+// Set the directory where linked program binaries are persisted. When set,
+// CreateProgram() first tries to reload a binary keyed by the shader sources,
+// the #define values and the GL driver, and only compiles from source on a
+// miss. Pass an empty string to disable the cache.
 //
+// @param directory, absolute path to a writable directory, e.g. the app's
+// cache directory.
+void SetProgramCacheDirectory(const std::string& directory);
+
+// Forgets the programs started by StartProgram() and lets the driver use as
+// many compiler threads as it likes if it supports
+// GL_KHR_parallel_shader_compile.  Call it whenever a new context is created.
+void ResetStartedPrograms();
+
+// Starts compiling and linking the program that CreateProgram() returns for
+// |variant|, without waiting for the driver.  CreateProgram() then only waits
+// for the link to finish, so starting programs before creating the first lets
+// the driver compile them in parallel instead of one after another.
+//
+// @param variant, the shader files and #define values, see kShaderVariants.
 // @param asset_manager, AAssetManager pointer.
-// @param vertex_shader_file_name, the vertex shader source file.
-// @param fragment_shader_file_name, the fragment shader source file.
-// @return a non-zero value if the shader is created successfully, otherwise 0.
-GLuint CreateProgram(const char* vertex_shader_file_name,
-                     const char* fragment_shader_file_name,
-                     AAssetManager* asset_manager);
+void StartProgram(ShaderVariant variant, AAssetManager* asset_manager);
+
+// StartProgram() for every entry of kShaderVariants, to warm up all programs
+// the renderers can ask for.
+void StartAllPrograms(AAssetManager* asset_manager);
 
 // Create a shader program ID.
 //
+// @param variant, the shader files and #define values, see kShaderVariants.
+// Its fragment shader file name is the program's owner in ResourceAccounting.
 // @param asset_manager, AAssetManager pointer.
-// @param vertex_shader_file_name, the vertex shader source file.
-// @param fragment_shader_file_name, the fragment shader source file.
-// @param define_values_map The #define values to add to the top of the shader
-// source code.
 // @return a non-zero value if the shader is created successfully, otherwise 0.
-GLuint CreateProgram(const char* vertex_shader_file_name,
-                     const char* fragment_shader_file_name,
-                     AAssetManager* asset_manager,
-                     const std::map<std::string, int>& define_values_map);
+GLuint CreateProgram(ShaderVariant variant, AAssetManager* asset_manager);
+
+// Whether the current context is OpenGL ES 3.1 or later, which compute shaders
+// and indirect draws need.  Must be called on the OpenGL thread.
+bool IsContextVersionAtLeast31();
+
+// Create a program from a single compute shader.  Compute programs need
+// OpenGL ES 3.1, so they are not part of kShaderVariants and are neither
+// started early nor persisted by the program cache.
+//
+// @param file_name, path to the shader, relative to the assets folder.  It is
+// the program's owner in ResourceAccounting.
+// @param asset_manager, AAssetManager pointer.
+// @return a non-zero value if the program is created successfully, otherwise
+// 0.
+GLuint CreateComputeProgram(const char* file_name,
+                            AAssetManager* asset_manager);
 
 // Load a text file from assets folder.
 //
@@ -131,33 +390,140 @@ bool LoadTextFileFromAssetManager(const char* file_name,
 //
 // @param target, openGL texture target to load the image into.
 // @param path, path to the file, relative to the assets folder.
+// @param uploaded_bytes, if not null, receives the size of the uploaded level.
 // @return true if png is loaded correctly, otherwise false.
-bool LoadPngFromAssetManager(int target, const char* path);
+bool LoadPngFromAssetManager(int target, const char* path,
+                             size_t* uploaded_bytes = nullptr);
+
+// Load a KTX2 texture with an ETC2 or ASTC payload from the assets folder and
+// upload all of its mip levels to the texture bound to |target| with
+// glCompressedTexImage2D, straight from the mapped asset.  Unlike
+// LoadPngFromAssetManager() this does not call into Java.  The file must not
+// be supercompressed; tools/png_to_ktx2.py writes suitable files.  Must be
+// called from the renderer thread.
+//
+// @param target, openGL texture target to load the image into.
+// @param path, path to the file, relative to the assets folder.
+// @param asset_manager, AAssetManager pointer.
+// @param uploaded_bytes, if not null, receives the size of all levels.
+// @return true if the texture is uploaded, false if the asset does not exist,
+// is malformed or the GPU does not support its format.
+bool LoadKtx2FromAssetManager(int target, const char* path,
+                              AAssetManager* asset_manager,
+                              size_t* uploaded_bytes = nullptr);
 
 // Load obj file from assets folder from the app.
 //
 // @param asset_manager, AAssetManager pointer.
 // @param file_name, name of the obj file.
-// @param out_vertices, output vertices.
-// @param out_normals, output normals.
-// @param out_uv, output texture UV coordinates.
-// @param out_indices, output triangle indices.
+// @param out_mesh, output mesh with interleaved vertices and 32-bit indices.
 // @return true if obj is loaded correctly, otherwise false.
 bool LoadObjFile(const std::string& file_name, AAssetManager* asset_manager,
-                 std::vector<GLfloat>* out_vertices,
-                 std::vector<GLfloat>* out_normals,
-                 std::vector<GLfloat>* out_uv,
-                 std::vector<GLushort>* out_indices);
+                 ObjMesh* out_mesh);
+
+// Header of the packed binary mesh format produced by tools/obj_to_mesh.py.
+// Version 1 vertices are interleaved position (3), normal (3) and uv (2)
+// floats, version 2 vertices are QuantizedVertex.
+struct MeshFileHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t vertex_count;
+  uint32_t index_count;
+  // Size of one index in bytes, 2 or 4.
+  uint32_t index_size;
+  uint32_t vertex_stride;
+  // Center (xyz) and radius (w) of a sphere enclosing all vertices.
+  float bounding_sphere[4];
+  uint32_t vertex_data_offset;
+  uint32_t index_data_offset;
+  // Version 2 only: decodes QuantizedVertex::position into
+  // position_offset + position_scale * position.
+  float position_offset[3];
+  float position_scale[3];
+};
+
+// Vertex of the quantized layout, 16 bytes instead of the 32 of the float
+// layout.  Decoded by the vertex shader.
+struct QuantizedVertex {
+  // Position in the bounding box of the mesh, unsigned normalized, with the
+  // w component 1.
+  uint16_t position[4];
+  // Octahedral encoded unit normal, signed normalized.
+  int16_t normal[2];
+  // Texture coordinate as half floats.
+  uint16_t uv[2];
+};
+
+// Quantizes |vertex_count| interleaved position (3), normal (3) and uv (2)
+// float vertices like tools/obj_to_mesh.py.  |out_position_offset| and
+// |out_position_scale| receive the bounding box decoding the positions.
+void QuantizeVertices(const float* vertices, size_t vertex_count,
+                      std::vector<QuantizedVertex>* out_vertices,
+                      glm::vec3* out_position_offset,
+                      glm::vec3* out_position_scale);
+
+// A binary mesh asset mapped in place with AAsset_getBuffer. The vertex and
+// index pointers refer directly to the asset memory, so they can be handed to
+// glBufferData without copying, and stay valid until the MeshAsset is
+// destroyed. The asset must be stored uncompressed in the APK for the mapping
+// to avoid a copy.
+class MeshAsset {
+ public:
+  MeshAsset() = default;
+  ~MeshAsset();
+  MeshAsset(const MeshAsset&) = delete;
+  MeshAsset& operator=(const MeshAsset&) = delete;
+
+  // Maps and validates the mesh.
+  //
+  // @param file_name, path to the file, relative to the assets folder.
+  // @param asset_manager, AAssetManager pointer.
+  // @return true if the mesh is mapped and well formed, otherwise false.
+  bool Open(const char* file_name, AAssetManager* asset_manager);
+
+  const MeshFileHeader& GetHeader() const { return *header_; }
+  const void* GetVertexData() const;
+  size_t GetVertexDataSize() const;
+  const void* GetIndexData() const;
+  size_t GetIndexDataSize() const;
+  // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT.
+  GLenum GetIndexType() const;
+
+ private:
+  AAsset* asset_ = nullptr;
+  const uint8_t* data_ = nullptr;
+  const MeshFileHeader* header_ = nullptr;
+};
+
+// Matrix math through glm's aligned types, which GLM implements with NEON
+// (SSE on x86) intrinsics.  glm::mat4 and glm::vec4 stay packed so vertex
+// layouts do not change, which keeps their operators scalar; use these on the
+// per-draw and per-frame paths instead.
+glm::mat4 MultiplyMatrices(const glm::mat4& a, const glm::mat4& b);
+glm::mat4 MultiplyMatrices(const glm::mat4& a, const glm::mat4& b,
+                           const glm::mat4& c);
+glm::mat4 InvertMatrix(const glm::mat4& matrix);
+glm::vec4 NormalizeVector(const glm::vec4& vector);
 
 // Format and output the matrix to logcat file.
 // Note that this function output matrix in row major.
 void Log4x4Matrix(const float raw_matrix[16]);
 
+// Returns the |percent| percentile of |values|, reordering them.  |values|
+// must not be empty.
+float Percentile(std::vector<float>* values, int percent);
+
 // Get transformation matrix from ArAnchor.
 void GetTransformMatrixFromAnchor(const ArAnchor& ar_anchor,
                                   ArSession* ar_session,
                                   glm::mat4* out_model_mat);
 
+// Get transformation matrix from ArAnchor, using |scratch_pose| to read the
+// anchor pose instead of creating a temporary ArPose.
+void GetTransformMatrixFromAnchor(const ArAnchor& ar_anchor,
+                                  ArSession* ar_session, ArPose* scratch_pose,
+                                  glm::mat4* out_model_mat);
+
 // Get the plane's normal from center pose.
 glm::vec3 GetPlaneNormal(const ArSession& ar_session, const ArPose& plane_pose);
 
@@ -167,6 +533,26 @@ glm::vec3 GetPlaneNormal(const ArSession& ar_session, const ArPose& plane_pose);
 float CalculateDistanceToPlane(const ArSession& ar_session,
                                const ArPose& plane_pose,
                                const ArPose& camera_pose);
+
+// Same as above, taking the camera position instead of its pose.
+float CalculateDistanceToPlane(const ArSession& ar_session,
+                               const ArPose& plane_pose,
+                               const glm::vec3& camera_position);
+
+// The six clip planes of a view frustum in world space.  Each plane is
+// (normal, distance) with the normal pointing into the frustum and unit
+// length, so dot(plane.xyz, p) + plane.w is the signed distance of p.
+struct Frustum {
+  glm::vec4 planes[6];
+};
+
+// Extracts the frustum planes from a view projection matrix.
+Frustum ExtractFrustum(const glm::mat4& view_projection_mat);
+
+// Returns false if the sphere lies entirely outside the frustum.  Spheres
+// near a frustum corner may be reported as visible.
+bool IsSphereInFrustum(const Frustum& frustum, const glm::vec3& center,
+                       float radius);
 }  // namespace util
 }  // namespace hello_ar
 
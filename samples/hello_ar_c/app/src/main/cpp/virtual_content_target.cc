@@ -0,0 +1,226 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "virtual_content_target.h"
+
+#include <EGL/egl.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "resource_accounting.h"
+#include "util.h"
+
+namespace hello_ar {
+namespace {
+constexpr char kOwner[] = "VirtualContentTarget";
+constexpr GLfloat kTransparent[4] = {0.f, 0.f, 0.f, 0.f};
+
+bool HasMultisampledRenderToTextureExtension() {
+  GLint num_extensions = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &num_extensions);
+  for (GLint i = 0; i < num_extensions; ++i) {
+    const char* extension = reinterpret_cast<const char*>(
+        glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i)));
+    if (extension != nullptr &&
+        strcmp(extension, "GL_EXT_multisampled_render_to_texture") == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+}  // namespace
+
+constexpr int RenderScaleGovernor::kNumScales;
+constexpr float RenderScaleGovernor::kScales[];
+constexpr float RenderScaleGovernor::kStepUpHeadroom;
+constexpr float RenderScaleGovernor::kNoChange;
+
+void RenderScaleGovernor::Reset(float gpu_budget_ms) {
+  gpu_budget_ms_ = gpu_budget_ms;
+  level_ = 0;
+  skip_next_update_ = false;
+}
+
+float RenderScaleGovernor::Update(float gpu_ms) {
+  if (skip_next_update_) {
+    skip_next_update_ = false;
+    return kNoChange;
+  }
+  if (gpu_ms > gpu_budget_ms_ && level_ + 1 < kNumScales) {
+    ++level_;
+    skip_next_update_ = true;
+    return GetScale();
+  }
+  if (level_ > 0) {
+    const float ratio = kScales[level_ - 1] / kScales[level_];
+    const float predicted_ms = gpu_ms * ratio * ratio;
+    if (predicted_ms < gpu_budget_ms_ * (1.f - kStepUpHeadroom)) {
+      --level_;
+      skip_next_update_ = true;
+      return GetScale();
+    }
+  }
+  return kNoChange;
+}
+
+void VirtualContentTarget::InitializeGlContent(AAssetManager* asset_manager) {
+  shader_program_ =
+      util::CreateProgram(ShaderVariant::kVirtualContent, asset_manager);
+  if (!shader_program_) {
+    LOGE("Could not create virtual content composite program.");
+  }
+  uniform_texture_ = glGetUniformLocation(shader_program_, "u_VirtualContent");
+
+  // Objects of a previous context are gone with it.
+  glGenFramebuffers(1, &framebuffer_);
+  render_pass_.SetFramebuffer(framebuffer_);
+  color_texture_ = 0;
+  depth_renderbuffer_ = 0;
+  allocated_width_ = 0;
+  allocated_height_ = 0;
+  allocated_samples_ = 0;
+  is_complete_ = false;
+
+  framebuffer_texture_2d_ = nullptr;
+  renderbuffer_storage_ = nullptr;
+  max_samples_ = 1;
+  if (HasMultisampledRenderToTextureExtension()) {
+    framebuffer_texture_2d_ =
+        reinterpret_cast<PFNGLFRAMEBUFFERTEXTURE2DMULTISAMPLEEXTPROC>(
+            eglGetProcAddress("glFramebufferTexture2DMultisampleEXT"));
+    renderbuffer_storage_ =
+        reinterpret_cast<PFNGLRENDERBUFFERSTORAGEMULTISAMPLEEXTPROC>(
+            eglGetProcAddress("glRenderbufferStorageMultisampleEXT"));
+    if (framebuffer_texture_2d_ != nullptr &&
+        renderbuffer_storage_ != nullptr) {
+      glGetIntegerv(GL_MAX_SAMPLES_EXT, &max_samples_);
+    }
+  }
+  SetSamples(requested_samples_);
+  util::CheckGlError("VirtualContentTarget::InitializeGlContent()");
+}
+
+void VirtualContentTarget::SetSamples(int samples) {
+  requested_samples_ = samples;
+  samples_ = std::max(std::min(samples, max_samples_), 1);
+}
+
+void VirtualContentTarget::SetSize(int surface_width, int surface_height,
+                                   float scale) {
+  scale_ = scale;
+  surface_width_ = std::max(surface_width, 1);
+  surface_height_ = std::max(surface_height, 1);
+  width_ = std::max(static_cast<int>(std::lround(surface_width_ * scale)), 1);
+  height_ =
+      std::max(static_cast<int>(std::lround(surface_height_ * scale)), 1);
+}
+
+void VirtualContentTarget::Allocate() {
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
+  // Storage of the color texture is immutable, so a new size needs a new
+  // texture.
+  if (color_texture_) {
+    gl_state.DeleteTexture(color_texture_);
+  }
+  glGenTextures(1, &color_texture_);
+  gl_state.BindTexture(GL_TEXTURE_2D, color_texture_);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  // Upscaled bilinearly when composited.
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width_, height_);
+  ResourceAccounting& accounting = ResourceAccounting::Get();
+  accounting.Track(GpuResourceType::kTexture, color_texture_,
+                   GetTextureBytes(GL_RGBA8, width_, height_), kOwner);
+
+  if (!depth_renderbuffer_) {
+    glGenRenderbuffers(1, &depth_renderbuffer_);
+  }
+  glBindRenderbuffer(GL_RENDERBUFFER, depth_renderbuffer_);
+  if (samples_ > 1) {
+    renderbuffer_storage_(GL_RENDERBUFFER, samples_, GL_DEPTH_COMPONENT24,
+                          width_, height_);
+  } else {
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width_,
+                          height_);
+  }
+  // Multisampled depth normally only lives in tile memory, but is accounted
+  // like the single sampled storage a driver may still back it with.
+  accounting.Track(GpuResourceType::kRenderbuffer, depth_renderbuffer_,
+                   GetTextureBytes(GL_DEPTH_COMPONENT24, width_, height_),
+                   kOwner);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+  if (samples_ > 1) {
+    framebuffer_texture_2d_(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                            GL_TEXTURE_2D, color_texture_, 0, samples_);
+  } else {
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                           GL_TEXTURE_2D, color_texture_, 0);
+  }
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                            GL_RENDERBUFFER, depth_renderbuffer_);
+  is_complete_ =
+      glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+  if (!is_complete_) {
+    LOGE("VirtualContentTarget: framebuffer is incomplete.");
+  }
+  allocated_width_ = width_;
+  allocated_height_ = height_;
+  allocated_samples_ = samples_;
+  util::CheckGlError("VirtualContentTarget::Allocate()");
+}
+
+bool VirtualContentTarget::Bind() {
+  if (!IsActive()) {
+    return false;
+  }
+  if (width_ != allocated_width_ || height_ != allocated_height_ ||
+      samples_ != allocated_samples_) {
+    Allocate();
+  }
+  if (!is_complete_) {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return false;
+  }
+  glViewport(0, 0, width_, height_);
+  // Only part of the target is drawn, so the color is always cleared.
+  render_pass_.Begin(/*color_covered=*/false, kTransparent);
+  return true;
+}
+
+void VirtualContentTarget::Composite() {
+  // The depth is not needed anymore, so tiled GPUs need not write it back.
+  render_pass_.End();
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glViewport(0, 0, surface_width_, surface_height_);
+
+  util::GlStateCache& gl_state = util::GlStateCache::Get();
+  gl_state.UseProgram(shader_program_);
+  // The fullscreen triangle comes from gl_VertexID.
+  gl_state.SetEnabledVertexAttribArrays(0);
+  gl_state.ActiveTexture(GL_TEXTURE0);
+  gl_state.BindTexture(GL_TEXTURE_2D, color_texture_);
+  glUniform1i(uniform_texture_, 0);
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+  util::CheckGlError("VirtualContentTarget::Composite()");
+}
+
+}  // namespace hello_ar
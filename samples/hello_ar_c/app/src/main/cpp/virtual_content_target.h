@@ -0,0 +1,158 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_VIRTUAL_CONTENT_TARGET_H_
+#define C_ARCORE_HELLOE_AR_VIRTUAL_CONTENT_TARGET_H_
+
+// clang-format off
+#include <GLES3/gl3.h>
+#include <GLES2/gl2ext.h>
+// clang-format on
+#include <android/asset_manager.h>
+
+#include "render_pass.h"
+
+namespace hello_ar {
+
+// Picks the resolution scale of the virtual content from its GPU time.
+//
+// The app calls Update() a few times a second with the average GPU time the
+// virtual content took per frame.  The governor steps the scale down when it
+// exceeds the budget, and back up when the time predicted for the next larger
+// scale, assuming it grows with the number of pixels, stays kStepUpHeadroom
+// below it, which keeps it from oscillating between two scales.  The first
+// Update() after a change is skipped, since its frames were partly drawn at
+// the previous scale.
+class RenderScaleGovernor {
+ public:
+  static constexpr int kNumScales = 5;
+  static constexpr float kScales[kNumScales] = {1.f, 0.875f, 0.75f, 0.625f,
+                                                0.5f};
+  static constexpr float kStepUpHeadroom = 0.25f;
+  // Returned by Update() if the current scale should be kept.
+  static constexpr float kNoChange = -1.f;
+
+  RenderScaleGovernor() = default;
+
+  // Starts at full resolution with a budget of |gpu_budget_ms| per frame.
+  void Reset(float gpu_budget_ms);
+
+  // Returns the scale to switch to, or kNoChange.
+  float Update(float gpu_ms);
+
+  float GetScale() const { return kScales[level_]; }
+
+ private:
+  float gpu_budget_ms_ = 0.f;
+  // Index into kScales.
+  int level_ = 0;
+  bool skip_next_update_ = false;
+};
+
+// Offscreen color and depth target the virtual content is drawn into at a
+// fraction of the surface resolution, which Composite() then blends over the
+// camera image at full resolution.  Fill rate bound devices keep their frame
+// rate while the camera image stays sharp.
+//
+// The target holds premultiplied color, like everything the renderers blend,
+// and is cleared to transparent black, so compositing it with the
+// premultiplied alpha blend gives the same result as drawing directly.  At
+// scale 1 the target is inactive and the content is drawn directly, unless
+// it is multisampled.  All methods must be called on the GL thread.
+//
+// With samples through EXT_multisampled_render_to_texture, the samples only
+// live in tile memory and are resolved as a tile is written back, so
+// antialiasing costs no bandwidth beyond the single sampled texture.
+class VirtualContentTarget {
+ public:
+  VirtualContentTarget() = default;
+  ~VirtualContentTarget() = default;
+
+  VirtualContentTarget(const VirtualContentTarget&) = delete;
+  VirtualContentTarget& operator=(const VirtualContentTarget&) = delete;
+
+  // Creates the composite program in a new context.  The objects of the
+  // previous context are abandoned with it.
+  void InitializeGlContent(AAssetManager* asset_manager);
+
+  // Draws with up to |samples| per pixel, which keeps the target active at
+  // scale 1, or single sampled with 0 or 1 or without the extension.  Takes
+  // effect with the next Bind().
+  void SetSamples(int samples);
+  // Samples per pixel of the target, 1 if it is single sampled.
+  int GetSamples() const { return samples_; }
+
+  void SetRenderPassOptions(const RenderPass::Options& options) {
+    render_pass_.SetOptions(options);
+  }
+
+  // Sizes the target for a |surface_width| x |surface_height| surface at
+  // |scale|.  The textures are reallocated by the next Bind().
+  void SetSize(int surface_width, int surface_height, float scale);
+
+  bool IsActive() const {
+    return (scale_ < 1.f || samples_ > 1) && shader_program_ != 0;
+  }
+
+  // Size the virtual content is drawn at, the surface size while inactive.
+  int GetWidth() const { return width_; }
+  int GetHeight() const { return height_; }
+
+  GLuint GetProgram() const { return shader_program_; }
+
+  // Binds and clears the target with its viewport.  Returns false, leaving
+  // the default framebuffer bound, if the target cannot be rendered into.
+  bool Bind();
+
+  // Binds the default framebuffer with the surface viewport and blends the
+  // target over it.  Expects the blend, depth and cull state of a
+  // premultiplied alpha overlay.
+  void Composite();
+
+ private:
+  void Allocate();
+
+  float scale_ = 1.f;
+  int requested_samples_ = 1;
+  // At most the extension's limit, 1 without the extension.
+  int samples_ = 1;
+  int max_samples_ = 1;
+  PFNGLFRAMEBUFFERTEXTURE2DMULTISAMPLEEXTPROC framebuffer_texture_2d_ =
+      nullptr;
+  PFNGLRENDERBUFFERSTORAGEMULTISAMPLEEXTPROC renderbuffer_storage_ = nullptr;
+  int surface_width_ = 1;
+  int surface_height_ = 1;
+  int width_ = 1;
+  int height_ = 1;
+  // Size and samples the textures were allocated with, 0 if they need to
+  // be.
+  int allocated_width_ = 0;
+  int allocated_height_ = 0;
+  int allocated_samples_ = 0;
+  bool is_complete_ = false;
+
+  GLuint framebuffer_ = 0;
+  GLuint color_texture_ = 0;
+  GLuint depth_renderbuffer_ = 0;
+  RenderPass render_pass_;
+
+  GLuint shader_program_ = 0;
+  GLint uniform_texture_ = -1;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_VIRTUAL_CONTENT_TARGET_H_
@@ -0,0 +1,253 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "vps_availability_cache.h"
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <vector>
+
+#include "util.h"
+
+namespace hello_ar {
+
+constexpr int VpsAvailabilityCache::kGeohashBits;
+constexpr int VpsAvailabilityCache::kMaxEntries;
+constexpr std::chrono::seconds VpsAvailabilityCache::kErrorRetryInterval;
+
+namespace {
+constexpr uint32_t kFileMagic = 0x41535056;  // "VPSA"
+constexpr uint32_t kFileVersion = 1;
+
+struct FileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t count;
+  uint32_t reserved;
+};
+
+struct FileRecord {
+  uint64_t cell;
+  int64_t checked_unix_s;
+  int32_t availability;
+  int32_t reserved;
+};
+
+bool IsError(ArVpsAvailability availability) { return availability < 0; }
+}  // namespace
+
+VpsAvailabilityCache::VpsAvailabilityCache(std::chrono::seconds ttl)
+    : ttl_(ttl) {}
+
+VpsAvailabilityCache::~VpsAvailabilityCache() {
+  if (!pending_.empty()) {
+    LOGE("VpsAvailabilityCache: destroyed with %zu checks outstanding",
+         pending_.size());
+  }
+}
+
+void VpsAvailabilityCache::Load(const std::string& path) {
+  path_ = path;
+  FILE* file = fopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    return;
+  }
+  FileHeader header = {};
+  std::vector<FileRecord> records;
+  if (fread(&header, sizeof(header), 1, file) == 1 &&
+      header.magic == kFileMagic && header.version == kFileVersion &&
+      header.count <= static_cast<uint32_t>(kMaxEntries)) {
+    records.resize(header.count);
+    if (fread(records.data(), sizeof(FileRecord), records.size(), file) !=
+        records.size()) {
+      records.clear();
+    }
+  }
+  fclose(file);
+
+  const int64_t now_unix_s = GetUnixSeconds();
+  for (const FileRecord& record : records) {
+    Entry entry;
+    entry.availability = static_cast<ArVpsAvailability>(record.availability);
+    entry.checked_unix_s = record.checked_unix_s;
+    if (!IsError(entry.availability) && IsFresh(entry, now_unix_s)) {
+      entries_[record.cell] = entry;
+    }
+  }
+}
+
+ArVpsAvailability VpsAvailabilityCache::Check(ArSession* session,
+                                              double latitude,
+                                              double longitude) {
+  const uint64_t cell = GetGeohashCell(latitude, longitude);
+  const auto entry = entries_.find(cell);
+  if (entry != entries_.end() &&
+      IsFresh(entry->second, GetUnixSeconds())) {
+    ++hit_count_;
+    return entry->second.availability;
+  }
+  if (pending_.count(cell) != 0) {
+    ++shared_count_;
+    return AR_VPS_AVAILABILITY_UNKNOWN;
+  }
+
+  ArVpsAvailabilityFuture* future = nullptr;
+  const ArStatus status = ArSession_checkVpsAvailabilityAsync(
+      session, latitude, longitude, /*context=*/nullptr,
+      /*callback=*/nullptr, &future);
+  if (status != AR_SUCCESS) {
+    LOGE("VpsAvailabilityCache: check failed to start: %d", status);
+    // Backs off like a failed check.
+    Insert(cell, AR_VPS_AVAILABILITY_ERROR_INTERNAL);
+    return AR_VPS_AVAILABILITY_ERROR_INTERNAL;
+  }
+  ++started_count_;
+  pending_[cell] = future;
+  return AR_VPS_AVAILABILITY_UNKNOWN;
+}
+
+void VpsAvailabilityCache::Update(const ArSession* session) {
+  bool changed = false;
+  for (auto it = pending_.begin(); it != pending_.end();) {
+    ArFutureState state = AR_FUTURE_STATE_PENDING;
+    ArFuture_getState(session, ArAsFuture(it->second), &state);
+    if (state == AR_FUTURE_STATE_PENDING) {
+      ++it;
+      continue;
+    }
+    ArVpsAvailability availability = AR_VPS_AVAILABILITY_UNKNOWN;
+    if (state == AR_FUTURE_STATE_DONE) {
+      ArVpsAvailabilityFuture_getResult(session, it->second, &availability);
+    }
+    // A cancelled check caches nothing, so the next Check() starts over.
+    if (IsError(availability)) {
+      LOGE("VpsAvailabilityCache: check failed: %d", availability);
+      Insert(it->first, availability);
+    } else if (availability != AR_VPS_AVAILABILITY_UNKNOWN) {
+      Insert(it->first, availability);
+      changed = true;
+    }
+    ArFuture_release(ArAsFuture(it->second));
+    it = pending_.erase(it);
+  }
+  if (changed) {
+    Save();
+  }
+}
+
+void VpsAvailabilityCache::Clear(const ArSession* session) {
+  for (const auto& pending : pending_) {
+    int32_t was_cancelled = 0;
+    ArFuture_cancel(session, ArAsFuture(pending.second), &was_cancelled);
+    ArFuture_release(ArAsFuture(pending.second));
+  }
+  pending_.clear();
+}
+
+uint64_t VpsAvailabilityCache::GetGeohashCell(double latitude,
+                                              double longitude) {
+  double latitude_range[2] = {-90.0, 90.0};
+  double longitude_range[2] = {-180.0, 180.0};
+  uint64_t cell = 0;
+  for (int bit = 0; bit < kGeohashBits; ++bit) {
+    // Even bits halve the longitude range, odd bits the latitude range.
+    double* range = bit % 2 == 0 ? longitude_range : latitude_range;
+    const double value = bit % 2 == 0 ? longitude : latitude;
+    const double middle = (range[0] + range[1]) / 2;
+    cell <<= 1;
+    if (value >= middle) {
+      cell |= 1;
+      range[0] = middle;
+    } else {
+      range[1] = middle;
+    }
+  }
+  return cell;
+}
+
+std::string VpsAvailabilityCache::GetReport() const {
+  char text[128];
+  snprintf(text, sizeof(text),
+           "%zu cells, %d hits, %d shared checks, %d checks started",
+           entries_.size(), hit_count_, shared_count_, started_count_);
+  return text;
+}
+
+int64_t VpsAvailabilityCache::GetUnixSeconds() {
+  return std::chrono::duration_cast<std::chrono::seconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+bool VpsAvailabilityCache::IsFresh(const Entry& entry,
+                                   int64_t now_unix_s) const {
+  const int64_t age_s = now_unix_s - entry.checked_unix_s;
+  const std::chrono::seconds lifetime =
+      IsError(entry.availability) ? kErrorRetryInterval : ttl_;
+  // A clock set back makes the age negative, which is not trusted either.
+  return age_s >= 0 && age_s < lifetime.count();
+}
+
+void VpsAvailabilityCache::Insert(uint64_t cell,
+                                  ArVpsAvailability availability) {
+  if (entries_.size() >= static_cast<size_t>(kMaxEntries) &&
+      entries_.count(cell) == 0) {
+    auto oldest = entries_.begin();
+    for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+      if (it->second.checked_unix_s < oldest->second.checked_unix_s) {
+        oldest = it;
+      }
+    }
+    entries_.erase(oldest);
+  }
+  Entry& entry = entries_[cell];
+  entry.availability = availability;
+  entry.checked_unix_s = GetUnixSeconds();
+}
+
+void VpsAvailabilityCache::Save() const {
+  if (path_.empty()) {
+    return;
+  }
+  std::vector<FileRecord> records;
+  records.reserve(entries_.size());
+  for (const auto& entry : entries_) {
+    if (!IsError(entry.second.availability)) {
+      records.push_back({entry.first, entry.second.checked_unix_s,
+                         static_cast<int32_t>(entry.second.availability), 0});
+    }
+  }
+  const FileHeader header = {kFileMagic, kFileVersion,
+                             static_cast<uint32_t>(records.size()), 0};
+  // Written next to the cache first, so a crash never leaves a truncated
+  // one behind.
+  const std::string temp_path = path_ + ".tmp";
+  FILE* file = fopen(temp_path.c_str(), "wb");
+  if (file == nullptr) {
+    LOGE("VpsAvailabilityCache: cannot write %s", temp_path.c_str());
+    return;
+  }
+  bool write_ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                  fwrite(records.data(), sizeof(FileRecord), records.size(),
+                         file) == records.size();
+  write_ok = (fclose(file) == 0) && write_ok;
+  if (!write_ok || rename(temp_path.c_str(), path_.c_str()) != 0) {
+    unlink(temp_path.c_str());
+  }
+}
+
+}  // namespace hello_ar
@@ -0,0 +1,110 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_HELLOE_AR_VPS_AVAILABILITY_CACHE_H_
+#define C_ARCORE_HELLOE_AR_VPS_AVAILABILITY_CACHE_H_
+
+#include <chrono>  // NOLINT
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include "arcore_c_api.h"
+
+namespace hello_ar {
+
+// Remembers the VPS availability of geohash cells, so a location is only
+// sent to the ARCore API once per cell and TTL.
+//
+// Check() returns the cached availability of the cell of a location right
+// away.  For a cell that is not cached or expired it starts one
+// ArSession_checkVpsAvailabilityAsync and returns
+// AR_VPS_AVAILABILITY_UNKNOWN, and until that future is done, every other
+// Check() of the cell shares it instead of starting another.  Update(),
+// called once per frame, polls the futures without callbacks and caches
+// their results.
+//
+// Available and unavailable results are kept for the TTL and written to a
+// small file after each new result, so the next launch starts with them.
+// Errors are only kept for kErrorRetryInterval, which stops a failing check
+// from being repeated every frame, and are never written.
+//
+// Not thread safe; meant to be used on the thread that updates the session.
+class VpsAvailabilityCache {
+ public:
+  // 7 geohash characters, cells of about 150 x 150 m.
+  static constexpr int kGeohashBits = 35;
+  // The cells checked least recently are dropped beyond this.
+  static constexpr int kMaxEntries = 512;
+  static constexpr std::chrono::seconds kErrorRetryInterval{30};
+
+  explicit VpsAvailabilityCache(std::chrono::seconds ttl);
+  ~VpsAvailabilityCache();
+
+  VpsAvailabilityCache(const VpsAvailabilityCache&) = delete;
+  VpsAvailabilityCache& operator=(const VpsAvailabilityCache&) = delete;
+
+  // Reads the cells at |path| that have not expired, and writes the cache
+  // there from then on.
+  void Load(const std::string& path);
+
+  // The availability of the cell of the location, see the class comment.
+  ArVpsAvailability Check(ArSession* session, double latitude,
+                          double longitude);
+
+  // Caches the results of the checks that finished.
+  void Update(const ArSession* session);
+
+  // Cancels and releases the outstanding futures.  Must be called before the
+  // session is destroyed.
+  void Clear(const ArSession* session);
+
+  // The kGeohashBits geohash of the location, longitude bit first.
+  static uint64_t GetGeohashCell(double latitude, double longitude);
+
+  size_t GetPendingCount() const { return pending_.size(); }
+
+  // Hits, shared and started checks since the cache was created.
+  std::string GetReport() const;
+
+ private:
+  struct Entry {
+    ArVpsAvailability availability = AR_VPS_AVAILABILITY_UNKNOWN;
+    // Wall clock time of the result, which stays meaningful across launches.
+    int64_t checked_unix_s = 0;
+  };
+
+  static int64_t GetUnixSeconds();
+
+  // Whether |entry| still answers a Check() at |now_unix_s|.
+  bool IsFresh(const Entry& entry, int64_t now_unix_s) const;
+
+  void Insert(uint64_t cell, ArVpsAvailability availability);
+
+  void Save() const;
+
+  const std::chrono::seconds ttl_;
+  std::string path_;
+  std::unordered_map<uint64_t, Entry> entries_;
+  std::unordered_map<uint64_t, ArVpsAvailabilityFuture*> pending_;
+  int hit_count_ = 0;
+  int shared_count_ = 0;
+  int started_count_ = 0;
+};
+
+}  // namespace hello_ar
+
+#endif  // C_ARCORE_HELLOE_AR_VPS_AVAILABILITY_CACHE_H_
@@ -17,17 +17,25 @@
 package com.google.ar.core.examples.c.helloar;
 
 import android.content.DialogInterface;
+import android.content.pm.PackageManager;
 import android.content.res.Resources;
 import android.hardware.display.DisplayManager;
+import android.net.Uri;
 import android.opengl.GLES20;
 import android.opengl.GLSurfaceView;
 import android.os.Bundle;
 import android.os.Handler;
 import android.util.Log;
+import android.view.Choreographer;
+import android.view.Display;
 import android.view.GestureDetector;
 import android.view.MenuItem;
 import android.view.MotionEvent;
+import android.view.Surface;
+import android.view.SurfaceHolder;
+import android.view.SurfaceView;
 import android.view.View;
+import android.view.ViewGroup;
 import android.view.WindowManager;
 import android.widget.ImageButton;
 import android.widget.PopupMenu;
@@ -35,6 +43,7 @@ import android.widget.Toast;
 import androidx.appcompat.app.AlertDialog;
 import androidx.appcompat.app.AppCompatActivity;
 import com.google.android.material.snackbar.Snackbar;
+import java.io.File;
 import javax.microedition.khronos.egl.EGLConfig;
 import javax.microedition.khronos.opengles.GL10;
 
@@ -49,12 +58,85 @@ public class HelloArActivity extends AppCompatActivity
   private static final int NUM_DEPTH_SETTINGS_CHECKBOXES = 2;
   private static final int NUM_INSTANT_PLACEMENT_SETTINGS_CHECKBOXES = 1;
 
-  private GLSurfaceView surfaceView;
+  /**
+   * Intent extra with the URI of an MP4 dataset to benchmark. The results are written to
+   * playback_benchmark.csv in the app's external files directory, e.g. with {@code adb shell am
+   * start -n com.google.ar.core.examples.c.helloar/.HelloArActivity --es benchmark_dataset_uri
+   * file:///sdcard/dataset.mp4}.
+   */
+  public static final String EXTRA_BENCHMARK_DATASET_URI = "benchmark_dataset_uri";
+
+  /**
+   * Boolean intent extra that runs the native math benchmark on a background thread and logs its
+   * results, e.g. with {@code adb shell am start -n
+   * com.google.ar.core.examples.c.helloar/.HelloArActivity --ez run_math_benchmark true}.
+   */
+  public static final String EXTRA_RUN_MATH_BENCHMARK = "run_math_benchmark";
+
+  /**
+   * Boolean intent extra that compares the camera texture modes instead of running the playback
+   * benchmark, over the dataset of {@link #EXTRA_BENCHMARK_DATASET_URI} if given and the live
+   * camera otherwise. The report is written to camera_texture_benchmark.txt in the app's external
+   * files directory, e.g. with {@code adb shell am start -n
+   * com.google.ar.core.examples.c.helloar/.HelloArActivity --ez compare_camera_texture_modes
+   * true}.
+   */
+  public static final String EXTRA_COMPARE_CAMERA_TEXTURE_MODES = "compare_camera_texture_modes";
+
+  /**
+   * Int intent extra with the camera texture mode to run with, one of the CAMERA_TEXTURE_MODE
+   * values of {@link JniInterface}, e.g. {@code --ei camera_texture_mode 1} for hardware buffers.
+   */
+  public static final String EXTRA_CAMERA_TEXTURE_MODE = "camera_texture_mode";
+
+  /**
+   * Boolean intent extra that profiles the ARCore C API calls against the live session instead of
+   * running a benchmark. The report is written to arcore_api_profile.json in the app's external
+   * files directory, e.g. with {@code adb shell am start -n
+   * com.google.ar.core.examples.c.helloar/.HelloArActivity --ez profile_arcore_api true}.
+   */
+  public static final String EXTRA_PROFILE_ARCORE_API = "profile_arcore_api";
+
+  private static final String BENCHMARK_CSV_FILE_NAME = "playback_benchmark.csv";
+
+  private static final String CAMERA_TEXTURE_BENCHMARK_FILE_NAME = "camera_texture_benchmark.txt";
+
+  private static final String ARCORE_API_PROFILE_FILE_NAME = "arcore_api_profile.json";
+
+  private static final String TELEMETRY_FILE_NAME = "frame_telemetry.bin";
+
+  private static final String STATE_CAPTURE_FILE_NAME = "session_state.arcapture";
+
+  private static final String SCREENSHOT_FILE_NAME = "screenshot.ppm";
+
+  private SurfaceView surfaceView;
+  // The same view if it renders, null if the native frame loop does.
+  private GLSurfaceView glSurfaceView;
+  // The surface the native frame loop draws into, only accessed on the UI thread.
+  private Surface nativeSurface;
+
+  private boolean benchmarkRunning = false;
+
+  // Whether the composited output is being recorded, only accessed on the UI thread.
+  private boolean captureRunning = false;
+
+  // Whether the native performance overlay is shown, only accessed on the UI thread.
+  private boolean performanceHudEnabled = false;
+
+  // Whether the native telemetry log is written, only accessed on the UI thread.
+  private boolean telemetryLogEnabled = false;
+
+  // Whether the native state capture is written, only accessed on the UI thread.
+  private boolean stateCaptureEnabled = false;
 
   private boolean viewportChanged = false;
   private int viewportWidth;
   private int viewportHeight;
 
+  // Fraction of the view size the surface is rendered at, lowered by the native thermal governor.
+  // Written on the GL thread, read when scaling touches on the UI thread.
+  private volatile float renderScale = 1.0f;
+
   private final DepthSettings depthSettings = new DepthSettings();
   private boolean[] depthSettingsMenuDialogCheckboxes = new boolean[NUM_DEPTH_SETTINGS_CHECKBOXES];
 
@@ -62,8 +144,27 @@ public class HelloArActivity extends AppCompatActivity
   private boolean[] instantPlacementSettingsMenuDialogCheckboxes =
       new boolean[NUM_INSTANT_PLACEMENT_SETTINGS_CHECKBOXES];
 
+  // Milliseconds between the frames the GLSurfaceView is asked for while the native side is idle,
+  // 0 while it renders continuously. Only accessed on the UI thread.
+  private int idleFrameIntervalMs = 0;
+  // The last interval the GL thread saw in the published state.
+  private int glThreadIdleFrameIntervalMs = 0;
+  private Handler idleRenderHandler;
+  private final Runnable idleRenderRunnable =
+      new Runnable() {
+        @Override
+        public void run() {
+          glSurfaceView.requestRender();
+          idleRenderHandler.postDelayed(this, idleFrameIntervalMs);
+        }
+      };
+
   // Opaque native pointer to the native application instance.
   private long nativeApplication;
+  // The state published by the native frames, one reader for the UI and one for the GL thread,
+  // which the UI thread uses instead with the native frame loop.
+  private UiStateChannel uiThreadState;
+  private UiStateChannel glThreadState;
   private GestureDetector gestureDetector;
 
   private Snackbar snackbar;
@@ -74,7 +175,7 @@ public class HelloArActivity extends AppCompatActivity
         public void run() {
           // The runnable is executed on main UI thread.
           try {
-            if (JniInterface.hasDetectedPlanes(nativeApplication)) {
+            if (uiThreadState.read() && uiThreadState.planeCount > 0) {
               if (snackbar != null) {
                 snackbar.dismiss();
               }
@@ -89,11 +190,51 @@ public class HelloArActivity extends AppCompatActivity
         }
       };
 
+  // With the native frame loop, reads the published state once per frame like onDrawFrame.
+  private final Choreographer.FrameCallback frameStateCallback =
+      new Choreographer.FrameCallback() {
+        @Override
+        public void doFrame(long frameTimeNanos) {
+          if (nativeApplication == 0) {
+            return;
+          }
+          readGlThreadState();
+          Choreographer.getInstance().postFrameCallback(this);
+        }
+      };
+
+  private final SurfaceHolder.Callback nativeWindowCallback =
+      new SurfaceHolder.Callback() {
+        @Override
+        public void surfaceCreated(SurfaceHolder holder) {}
+
+        @Override
+        public void surfaceChanged(SurfaceHolder holder, int format, int width, int height) {
+          nativeSurface = holder.getSurface();
+          viewportWidth = width;
+          viewportHeight = height;
+          onNativeWindowChanged();
+        }
+
+        @Override
+        public void surfaceDestroyed(SurfaceHolder holder) {
+          nativeSurface = null;
+          onNativeWindowChanged();
+        }
+      };
+
   @Override
   protected void onCreate(Bundle savedInstanceState) {
     super.onCreate(savedInstanceState);
     setContentView(R.layout.activity_main);
-    surfaceView = (GLSurfaceView) findViewById(R.id.surfaceview);
+    surfaceView = findViewById(R.id.surfaceview);
+    if (JniInterface.usesNativeFrameLoop()) {
+      // A GLSurfaceView cannot be used without its renderer thread.
+      surfaceView = replaceWithSurfaceView(surfaceView);
+      surfaceView.getHolder().addCallback(nativeWindowCallback);
+    } else {
+      glSurfaceView = (GLSurfaceView) surfaceView;
+    }
 
     // Set up touch listener.
     gestureDetector =
@@ -106,8 +247,11 @@ public class HelloArActivity extends AppCompatActivity
                 // depth-based occlusion. This dialog needs to be spawned on the UI thread.
                 HelloArActivity.this.runOnUiThread(() -> showOcclusionDialogIfNeeded());
 
-                surfaceView.queueEvent(
-                    () -> JniInterface.onTouched(nativeApplication, e.getX(), e.getY()));
+                // The touch is queued natively and hit tested with the next frame, so it does
+                // not need to be posted to the GL thread.
+                // Touches are in view coordinates, the surface may be smaller.
+                JniInterface.onTouched(
+                    nativeApplication, e.getX() * renderScale, e.getY() * renderScale);
                 return true;
               }
 
@@ -120,18 +264,72 @@ public class HelloArActivity extends AppCompatActivity
     surfaceView.setOnTouchListener(
         (View v, MotionEvent event) -> gestureDetector.onTouchEvent(event));
 
-    // Set up renderer.
-    surfaceView.setPreserveEGLContextOnPause(true);
-    surfaceView.setEGLContextClientVersion(2);
-    surfaceView.setEGLConfigChooser(8, 8, 8, 8, 16, 0); // Alpha used for plane blending.
-    surfaceView.setRenderer(this);
-    surfaceView.setRenderMode(GLSurfaceView.RENDERMODE_CONTINUOUSLY);
+    // Set up renderer. The native frame loop configures its context the same way.
+    if (glSurfaceView != null) {
+      glSurfaceView.setPreserveEGLContextOnPause(true);
+      glSurfaceView.setEGLContextClientVersion(3);
+      glSurfaceView.setEGLConfigChooser(8, 8, 8, 8, 16, 0); // Alpha used for plane blending.
+      glSurfaceView.setRenderer(this);
+      glSurfaceView.setRenderMode(GLSurfaceView.RENDERMODE_CONTINUOUSLY);
+    }
     surfaceView.setWillNotDraw(false);
 
     JniInterface.assetManager = getAssets();
-    nativeApplication = JniInterface.createNativeApplication(getAssets());
+    nativeApplication =
+        JniInterface.createNativeApplication(
+            getAssets(), getCodeCacheDir().getAbsolutePath());
+    uiThreadState = new UiStateChannel(JniInterface.getUiStateBuffer(nativeApplication));
+    glThreadState = new UiStateChannel(JniInterface.getUiStateBuffer(nativeApplication));
+    if (JniInterface.rendersAtDisplayRate()) {
+      requestHighestRefreshRate();
+    }
+
+    String benchmarkDatasetUri = getIntent().getStringExtra(EXTRA_BENCHMARK_DATASET_URI);
+    if (getIntent().hasExtra(EXTRA_CAMERA_TEXTURE_MODE)) {
+      JniInterface.setCameraTextureMode(
+          nativeApplication, getIntent().getIntExtra(EXTRA_CAMERA_TEXTURE_MODE, 0));
+    }
+    if (getIntent().getBooleanExtra(EXTRA_PROFILE_ARCORE_API, false)) {
+      File reportFile = new File(getExternalFilesDir(null), ARCORE_API_PROFILE_FILE_NAME);
+      benchmarkRunning =
+          JniInterface.startArCoreApiProfiler(
+              nativeApplication, reportFile.getAbsolutePath(), getArCoreVersion());
+      if (!benchmarkRunning) {
+        Log.e(TAG, "Could not start the ARCore API profiler");
+      }
+    } else if (getIntent().getBooleanExtra(EXTRA_COMPARE_CAMERA_TEXTURE_MODES, false)) {
+      File reportFile = new File(getExternalFilesDir(null), CAMERA_TEXTURE_BENCHMARK_FILE_NAME);
+      benchmarkRunning =
+          JniInterface.startCameraTextureBenchmark(
+              nativeApplication,
+              benchmarkDatasetUri != null ? benchmarkDatasetUri : "",
+              reportFile.getAbsolutePath());
+      if (!benchmarkRunning) {
+        Log.e(TAG, "Could not start the camera texture benchmark");
+      }
+    } else if (benchmarkDatasetUri != null) {
+      File csvFile = new File(getExternalFilesDir(null), BENCHMARK_CSV_FILE_NAME);
+      benchmarkRunning =
+          JniInterface.startPlaybackBenchmark(
+              nativeApplication, benchmarkDatasetUri, csvFile.getAbsolutePath());
+      if (!benchmarkRunning) {
+        Log.e(TAG, "Could not start the playback benchmark");
+      }
+    }
+
+    if (getIntent().getBooleanExtra(EXTRA_RUN_MATH_BENCHMARK, false)) {
+      new Thread(
+              () -> {
+                for (String line : JniInterface.runMathBenchmark().split("\n")) {
+                  Log.i(TAG, line);
+                }
+              },
+              "MathBenchmark")
+          .start();
+    }
 
     planeStatusCheckingHandler = new Handler();
+    idleRenderHandler = new Handler();
 
     depthSettings.onCreate(this);
     instantPlacementSettings.onCreate(this);
@@ -143,6 +341,9 @@ public class HelloArActivity extends AppCompatActivity
             PopupMenu popup = new PopupMenu(HelloArActivity.this, v);
             popup.setOnMenuItemClickListener(HelloArActivity.this::settingsMenuClick);
             popup.inflate(R.menu.settings_menu);
+            popup.getMenu().findItem(R.id.performance_hud).setChecked(performanceHudEnabled);
+            popup.getMenu().findItem(R.id.telemetry_log).setChecked(telemetryLogEnabled);
+            popup.getMenu().findItem(R.id.state_capture).setChecked(stateCaptureEnabled);
             popup.show();
           }
         });
@@ -156,6 +357,22 @@ public class HelloArActivity extends AppCompatActivity
     } else if (item.getItemId() == R.id.instant_placement_settings) {
       launchInstantPlacementSettingsMenuDialog();
       return true;
+    } else if (item.getItemId() == R.id.record_session) {
+      toggleCapture();
+      return true;
+    } else if (item.getItemId() == R.id.performance_hud) {
+      performanceHudEnabled = !performanceHudEnabled;
+      JniInterface.setPerformanceHudEnabled(nativeApplication, performanceHudEnabled);
+      return true;
+    } else if (item.getItemId() == R.id.telemetry_log) {
+      toggleTelemetryLog();
+      return true;
+    } else if (item.getItemId() == R.id.state_capture) {
+      toggleStateCapture();
+      return true;
+    } else if (item.getItemId() == R.id.screenshot) {
+      captureScreenshot();
+      return true;
     }
     return false;
   }
@@ -173,8 +390,19 @@ public class HelloArActivity extends AppCompatActivity
     try {
       JniInterface.onSettingsChange(
         nativeApplication, instantPlacementSettings.isInstantPlacementEnabled());
+      if (glSurfaceView == null) {
+        JniInterface.setFrameLoopDepthSettings(
+            nativeApplication,
+            depthSettings.depthColorVisualizationEnabled(),
+            depthSettings.useDepthForOcclusion());
+      }
+      // Also resumes the native frame loop.
       JniInterface.onResume(nativeApplication, getApplicationContext(), this);
-      surfaceView.onResume();
+      if (glSurfaceView != null) {
+        glSurfaceView.onResume();
+      } else {
+        Choreographer.getInstance().postFrameCallback(frameStateCallback);
+      }
     } catch (Exception e) {
       Log.e(TAG, "Exception creating session", e);
       displayInSnackbar(e.getMessage());
@@ -193,8 +421,17 @@ public class HelloArActivity extends AppCompatActivity
   @Override
   public void onPause() {
     super.onPause();
-    surfaceView.onPause();
+    if (glSurfaceView != null) {
+      glSurfaceView.onPause();
+      // The native side draws the first frames after a resume at full rate.
+      applyIdleFrameInterval(0);
+    } else {
+      Choreographer.getInstance().removeFrameCallback(frameStateCallback);
+    }
+    // Also pauses the native frame loop and finishes a running capture and state capture.
     JniInterface.onPause(nativeApplication);
+    captureRunning = false;
+    stateCaptureEnabled = false;
 
     planeStatusCheckingHandler.removeCallbacks(planeStatusCheckingRunnable);
 
@@ -205,11 +442,17 @@ public class HelloArActivity extends AppCompatActivity
   public void onDestroy() {
     super.onDestroy();
 
-    // Synchronized to avoid racing onDrawFrame.
+    // Synchronized to avoid racing onDrawFrame. Frames and events only use the native application
+    // while holding the lock, so once it is cleared, it can be destroyed without the lock, which
+    // events that wait for it on the native frame loop would otherwise deadlock with.
+    long application;
     synchronized (this) {
-      JniInterface.destroyNativeApplication(nativeApplication);
+      application = nativeApplication;
       nativeApplication = 0;
+      uiThreadState = null;
+      glThreadState = null;
     }
+    JniInterface.destroyNativeApplication(application);
   }
 
   @Override
@@ -260,9 +503,127 @@ public class HelloArActivity extends AppCompatActivity
           nativeApplication,
           depthSettings.depthColorVisualizationEnabled(),
           depthSettings.useDepthForOcclusion());
+      readGlThreadState();
+    }
+  }
+
+  /** Returns the version name of the installed Google Play Services for AR. */
+  private String getArCoreVersion() {
+    try {
+      return getPackageManager().getPackageInfo("com.google.ar.core", 0).versionName;
+    } catch (PackageManager.NameNotFoundException e) {
+      return "unknown";
+    }
+  }
+
+  /** Follows the render scale and the benchmark in the state published by the latest frame. */
+  private void readGlThreadState() {
+    glThreadState.read();
+    float scale = glThreadState.renderScale;
+    if (scale != renderScale) {
+      renderScale = scale;
+      runOnUiThread(() -> applyRenderScale(scale));
+    }
+    if (benchmarkRunning && glThreadState.playbackBenchmarkFinished) {
+      benchmarkRunning = false;
+      Log.i(TAG, "Playback benchmark finished");
+      runOnUiThread(this::finish);
+    }
+    // The native frame loop paces itself.
+    int interval = glThreadState.idleFrameIntervalMs;
+    if (glSurfaceView != null && interval != glThreadIdleFrameIntervalMs) {
+      glThreadIdleFrameIntervalMs = interval;
+      runOnUiThread(() -> applyIdleFrameInterval(interval));
     }
   }
 
+  /**
+   * Renders a frame every {@code intervalMs} instead of continuously, for the low frame rate the
+   * native side wants while tracking is lost, or continuously again for 0.
+   */
+  private void applyIdleFrameInterval(int intervalMs) {
+    if (intervalMs == idleFrameIntervalMs) {
+      return;
+    }
+    idleFrameIntervalMs = intervalMs;
+    idleRenderHandler.removeCallbacks(idleRenderRunnable);
+    if (intervalMs == 0) {
+      glSurfaceView.setRenderMode(GLSurfaceView.RENDERMODE_CONTINUOUSLY);
+      return;
+    }
+    glSurfaceView.setRenderMode(GLSurfaceView.RENDERMODE_WHEN_DIRTY);
+    idleRenderHandler.postDelayed(idleRenderRunnable, intervalMs);
+  }
+
+  /** Puts a plain SurfaceView with the same id and layout in place of {@code view}. */
+  private SurfaceView replaceWithSurfaceView(SurfaceView view) {
+    SurfaceView replacement = new SurfaceView(this);
+    replacement.setId(view.getId());
+    ViewGroup parent = (ViewGroup) view.getParent();
+    int index = parent.indexOfChild(view);
+    parent.removeView(view);
+    parent.addView(replacement, index, view.getLayoutParams());
+    return replacement;
+  }
+
+  /** Passes the current surface and display rotation to the native frame loop. */
+  private void onNativeWindowChanged() {
+    if (nativeApplication == 0) {
+      return;
+    }
+    int displayRotation = getWindowManager().getDefaultDisplay().getRotation();
+    JniInterface.onNativeWindowChanged(
+        nativeApplication, nativeSurface, displayRotation, viewportWidth, viewportHeight);
+  }
+
+  /**
+   * Runs {@code event} on the thread that renders, before its next frame, with the GL context
+   * current.
+   */
+  private void queueRenderEvent(Runnable event) {
+    if (glSurfaceView != null) {
+      glSurfaceView.queueEvent(event);
+    } else if (nativeApplication != 0) {
+      JniInterface.postToFrameLoop(nativeApplication, event);
+    }
+  }
+
+  /**
+   * Resizes the surface to {@code scale} times the view, which scales it back up when composited.
+   * The new size reaches onSurfaceChanged like any other.
+   */
+  private void applyRenderScale(float scale) {
+    if (scale == 1.0f) {
+      surfaceView.getHolder().setSizeFromLayout();
+      return;
+    }
+    surfaceView
+        .getHolder()
+        .setFixedSize(
+            Math.round(surfaceView.getWidth() * scale),
+            Math.round(surfaceView.getHeight() * scale));
+  }
+
+  /**
+   * Asks for the display mode with the highest refresh rate at the current resolution, since the
+   * native side draws predicted frames in between camera frames.
+   */
+  private void requestHighestRefreshRate() {
+    Display display = getWindowManager().getDefaultDisplay();
+    Display.Mode current = display.getMode();
+    Display.Mode best = current;
+    for (Display.Mode mode : display.getSupportedModes()) {
+      if (mode.getPhysicalWidth() == current.getPhysicalWidth()
+          && mode.getPhysicalHeight() == current.getPhysicalHeight()
+          && mode.getRefreshRate() > best.getRefreshRate()) {
+        best = mode;
+      }
+    }
+    WindowManager.LayoutParams params = getWindow().getAttributes();
+    params.preferredDisplayModeId = best.getModeId();
+    getWindow().setAttributes(params);
+  }
+
   @Override
   public void onRequestPermissionsResult(int requestCode, String[] permissions, int[] results) {
     super.onRequestPermissionsResult(requestCode, permissions, results);
@@ -277,6 +638,139 @@ public class HelloArActivity extends AppCompatActivity
     }
   }
 
+  /**
+   * Starts or stops recording the composited output and an ARCore dataset of the session into the
+   * app's external files directory.
+   */
+  private void toggleCapture() {
+    if (captureRunning) {
+      captureRunning = false;
+      queueRenderEvent(
+          () -> {
+            // Synchronized to avoid racing onDestroy.
+            synchronized (this) {
+              if (nativeApplication != 0) {
+                JniInterface.stopCapture(nativeApplication);
+              }
+            }
+          });
+      Toast.makeText(this, "Recording saved", Toast.LENGTH_SHORT).show();
+      return;
+    }
+
+    String name = "session_" + System.currentTimeMillis();
+    File directory = getExternalFilesDir(null);
+    String videoPath = new File(directory, name + "_composite.mp4").getAbsolutePath();
+    String datasetUri = Uri.fromFile(new File(directory, name + "_dataset.mp4")).toString();
+    captureRunning = true;
+    queueRenderEvent(
+        () -> {
+          boolean started;
+          synchronized (this) {
+            started =
+                nativeApplication != 0
+                    && JniInterface.startCapture(nativeApplication, videoPath, datasetUri);
+          }
+          if (!started) {
+            runOnUiThread(
+                () -> {
+                  captureRunning = false;
+                  Toast.makeText(this, "Could not start recording", Toast.LENGTH_LONG).show();
+                });
+          }
+        });
+  }
+
+  /**
+   * Starts or stops writing the native per-frame telemetry to the app's external files directory.
+   * A new log replaces the previous one.
+   */
+  private void toggleTelemetryLog() {
+    if (telemetryLogEnabled) {
+      telemetryLogEnabled = false;
+      queueRenderEvent(
+          () -> {
+            synchronized (this) {
+              if (nativeApplication != 0) {
+                JniInterface.stopTelemetryLog(nativeApplication);
+              }
+            }
+          });
+      return;
+    }
+
+    String path = new File(getExternalFilesDir(null), TELEMETRY_FILE_NAME).getAbsolutePath();
+    telemetryLogEnabled = true;
+    queueRenderEvent(
+        () -> {
+          boolean started;
+          synchronized (this) {
+            started =
+                nativeApplication != 0 && JniInterface.startTelemetryLog(nativeApplication, path);
+          }
+          if (!started) {
+            runOnUiThread(
+                () -> {
+                  telemetryLogEnabled = false;
+                  Toast.makeText(this, "Could not start the telemetry log", Toast.LENGTH_LONG)
+                      .show();
+                });
+          }
+        });
+  }
+
+  /**
+   * Starts or stops capturing the native per-frame ARCore state to the app's external files
+   * directory, for the desktop replay in tools/arcore_replay. A new capture replaces the previous
+   * one.
+   */
+  private void toggleStateCapture() {
+    if (stateCaptureEnabled) {
+      stateCaptureEnabled = false;
+      queueRenderEvent(
+          () -> {
+            synchronized (this) {
+              if (nativeApplication != 0) {
+                JniInterface.stopStateCapture(nativeApplication);
+              }
+            }
+          });
+      return;
+    }
+
+    String path = new File(getExternalFilesDir(null), STATE_CAPTURE_FILE_NAME).getAbsolutePath();
+    stateCaptureEnabled = true;
+    queueRenderEvent(
+        () -> {
+          boolean started;
+          synchronized (this) {
+            started =
+                nativeApplication != 0 && JniInterface.startStateCapture(nativeApplication, path);
+          }
+          if (!started) {
+            runOnUiThread(
+                () -> {
+                  stateCaptureEnabled = false;
+                  Toast.makeText(this, "Could not start the state capture", Toast.LENGTH_LONG)
+                      .show();
+                });
+          }
+        });
+  }
+
+  /** Writes the next frame to the app's external files directory, replacing the last one. */
+  private void captureScreenshot() {
+    String path = new File(getExternalFilesDir(null), SCREENSHOT_FILE_NAME).getAbsolutePath();
+    queueRenderEvent(
+        () -> {
+          synchronized (this) {
+            if (nativeApplication != 0) {
+              JniInterface.captureScreenshot(nativeApplication, path);
+            }
+          }
+        });
+  }
+
   /**
    * Display the message in the snackbar.
    */
@@ -380,6 +874,12 @@ public class HelloArActivity extends AppCompatActivity
 
     JniInterface.onSettingsChange(
         nativeApplication, instantPlacementSettings.isInstantPlacementEnabled());
+    if (glSurfaceView == null) {
+      JniInterface.setFrameLoopDepthSettings(
+          nativeApplication,
+          depthSettings.depthColorVisualizationEnabled(),
+          depthSettings.useDepthForOcclusion());
+    }
   }
 
   private void resetSettingsMenuDialogCheckboxes() {
@@ -399,5 +899,8 @@ public class HelloArActivity extends AppCompatActivity
   @Override
   public void onDisplayChanged(int displayId) {
     viewportChanged = true;
+    if (nativeSurface != null) {
+      onNativeWindowChanged();
+    }
   }
 }
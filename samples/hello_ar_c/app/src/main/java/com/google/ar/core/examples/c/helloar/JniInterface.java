@@ -22,9 +22,15 @@ import android.graphics.Bitmap;
 import android.graphics.BitmapFactory;
 import android.opengl.GLUtils;
 import android.util.Log;
+import android.view.Surface;
+import dalvik.annotation.optimization.CriticalNative;
 import java.io.IOException;
+import java.nio.ByteBuffer;
 
-/** JNI interface to native layer. */
+/**
+ * JNI interface to native layer. The natives are registered when the library is loaded, so a
+ * method added here must also be added to the tables in jni_interface.cc.
+ */
 public class JniInterface {
   static {
     System.loadLibrary("hello_ar_native");
@@ -33,7 +39,16 @@ public class JniInterface {
   private static final String TAG = "JniInterface";
   static AssetManager assetManager;
 
-  public static native long createNativeApplication(AssetManager assetManager);
+  /** Names of the timed frame stages, in the order used by {@link #getFrameStageStats}. */
+  public static final String[] FRAME_STAGE_NAMES = {
+    "ArSession_update", "Background", "DepthUpload", "Planes", "Anchors", "PointCloud"
+  };
+
+  /** Number of values returned by {@link #getFrameStageStats} per frame stage. */
+  public static final int FRAME_STAGE_STAT_COUNT = 4;
+
+  public static native long createNativeApplication(
+      AssetManager assetManager, String programCacheDirectory);
 
   public static native void destroyNativeApplication(long nativeApplication);
 
@@ -51,14 +66,47 @@ public class JniInterface {
   public static native void onDisplayGeometryChanged(
       long nativeApplication, int displayRotation, int width, int height);
 
-  /** Main render loop, called on the OpenGL thread. */
+  /**
+   * Main render loop, called on the OpenGL thread. Not a @CriticalNative or @FastNative method
+   * since a frame takes milliseconds and calls back into Java to load textures, during which the
+   * thread could not be suspended for the garbage collector.
+   */
   public static native void onGlSurfaceDrawFrame(
       long nativeApplication, boolean depthColorVisualizationEnabled, boolean useDepthForOcclusion);
 
-  /** OnTouch event, called on the OpenGL thread. */
+  /**
+   * OnTouch event, called on the UI thread. Touches are queued and hit tested in one pass with the
+   * next frame.
+   */
+  @CriticalNative
   public static native void onTouched(long nativeApplication, float x, float y);
 
+  /**
+   * Queues a Terrain anchor, or a Rooftop anchor if onRooftop is set, altitude meters above the
+   * surface at the WGS84 location and facing heading degrees clockwise from north. The nearest
+   * queued anchors are resolved first, a few at a time. Only used if the native code is built with
+   * kUseGeospatialAnchors. Called on the UI thread, like onTouched.
+   */
+  public static native void resolveGeospatialAnchor(
+      long nativeApplication,
+      boolean onRooftop,
+      double latitude,
+      double longitude,
+      double altitude,
+      float heading);
+
+  /**
+   * Queues a Cloud Anchor id for resolving; an Andy is drawn where it resolves. Only used if the
+   * native code is built with kUseCloudAnchors, which also hosts every placed anchor. Called on the
+   * UI thread, like onTouched.
+   */
+  public static native void resolveCloudAnchor(long nativeApplication, String cloudAnchorId);
+
+  /** Returns the Cloud Anchor counts and latencies as text. Can be called from any thread. */
+  public static native String getCloudAnchorReport(long nativeApplication);
+
   /** Get plane count in current session. Used to disable the "searching for surfaces" snackbar. */
+  @CriticalNative
   public static native boolean hasDetectedPlanes(long nativeApplication);
 
   public static native boolean isDepthSupported(long nativeApplication);
@@ -66,6 +114,193 @@ public class JniInterface {
   public static native void onSettingsChange(
       long nativeApplication, boolean isInstantPlacementEnabled);
 
+  /**
+   * Returns the fraction of the view size the thermal governor wants the surface rendered at, 1 at
+   * full quality. Can be called from any thread.
+   */
+  @CriticalNative
+  public static native float getRenderScale(long nativeApplication);
+
+  /**
+   * Returns true if frames are drawn at display rate with predicted camera poses, so the display
+   * should run at its highest refresh rate.
+   */
+  public static native boolean rendersAtDisplayRate();
+
+  /**
+   * Returns true if the native code draws from its own thread paced by vsync, so the activity hands
+   * its surface to {@link #onNativeWindowChanged} instead of drawing from a GLSurfaceView.
+   */
+  public static native boolean usesNativeFrameLoop();
+
+  /**
+   * Hands the surface to the native frame loop whenever it or the display rotation changes, and
+   * null once it is destroyed, in which case it returns once nothing draws into it anymore.
+   */
+  public static native void onNativeWindowChanged(
+      long nativeApplication, Surface surface, int displayRotation, int width, int height);
+
+  /** Sets the depth options the native frame loop draws with. Can be called from any thread. */
+  public static native void setFrameLoopDepthSettings(
+      long nativeApplication, boolean depthColorVisualizationEnabled, boolean useDepthForOcclusion);
+
+  /**
+   * Runs {@code event} on the native frame loop before its next frame, the counterpart of {@link
+   * android.opengl.GLSurfaceView#queueEvent}.
+   */
+  public static native void postToFrameLoop(long nativeApplication, Runnable event);
+
+  /**
+   * Shows or hides the native overlay with the frame time graph, stage timings and counters. Can be
+   * called from any thread.
+   */
+  public static native void setPerformanceHudEnabled(long nativeApplication, boolean enabled);
+
+  /**
+   * Returns the GL objects and ARCore handles the native code holds, per owner, as text. Can be
+   * called from any thread.
+   */
+  public static native String getResourceReport();
+
+  /**
+   * Times the matrix math of the renderers with and without glm's SIMD code and returns one line
+   * per operation. Takes about a second, so it must not be called on the UI or GL thread.
+   */
+  public static native String runMathBenchmark();
+
+  /**
+   * Returns rolling timing statistics of the native frame stages named by {@link
+   * #FRAME_STAGE_NAMES}. Each stage contributes {@link #FRAME_STAGE_STAT_COUNT} values: the minimum,
+   * average and 95th percentile duration in milliseconds, followed by the number of samples they
+   * were computed from. Can be called from any thread.
+   */
+  public static native float[] getFrameStageStats(long nativeApplication);
+
+  /**
+   * Same layout as {@link #getFrameStageStats} for the GPU execution time of the frame stages, as
+   * measured by GL timer queries. ArSession_update and stages of GPUs without timer queries have no
+   * samples. Can be called from any thread.
+   */
+  public static native float[] getGpuFrameStageStats(long nativeApplication);
+
+  /**
+   * Returns the number of anchored objects drawn and the number skipped by frustum culling in the
+   * last frame, in that order. Can be called from any thread.
+   */
+  public static native int[] getAnchorCullingStats(long nativeApplication);
+
+  /**
+   * Returns the number of depth images uploaded to the depth texture per second. Frames that share
+   * a depth image do not upload it again. Can be called from any thread.
+   */
+  public static native float getDepthUploadsPerSecond(long nativeApplication);
+
+  /**
+   * Returns a direct buffer over the state the native code publishes after every frame, to be read
+   * with {@link UiStateChannel}. The buffer must not be read after destroyNativeApplication.
+   */
+  public static native ByteBuffer getUiStateBuffer(long nativeApplication);
+
+  /**
+   * Plays back an MP4 dataset instead of the live camera and writes per-frame stage timings to a
+   * CSV file. Must be called before the first onResume. Returns false if the CSV file cannot be
+   * created.
+   */
+  public static native boolean startPlaybackBenchmark(
+      long nativeApplication, String datasetUri, String csvPath);
+
+  /** Returns true once the playback benchmark reached the end of the dataset. */
+  public static native boolean isPlaybackBenchmarkFinished(long nativeApplication);
+
+  /** {@link #setCameraTextureMode} value for ArSession_setCameraTextureName. */
+  public static final int CAMERA_TEXTURE_MODE_TEXTURE_NAME = 0;
+
+  /** {@link #setCameraTextureMode} value for AR_TEXTURE_UPDATE_MODE_EXPOSE_HARDWARE_BUFFER. */
+  public static final int CAMERA_TEXTURE_MODE_HARDWARE_BUFFER = 1;
+
+  /**
+   * Alternates the camera texture modes, playing back an MP4 dataset unless {@code datasetUri} is
+   * empty, and writes a comparison of their CPU, GPU and latency costs on this device to a text
+   * file. Must be called before the first onResume. Returns false if the report cannot be created.
+   * The end is reported like that of the playback benchmark.
+   */
+  public static native boolean startCameraTextureBenchmark(
+      long nativeApplication, String datasetUri, String reportPath);
+
+  /**
+   * Switches how the camera image reaches the background texture, one of the CAMERA_TEXTURE_MODE
+   * values. Hardware buffers fall back to the texture name where they are not supported.
+   */
+  public static native void setCameraTextureMode(long nativeApplication, int mode);
+
+  /**
+   * Times single ARCore C API calls in tight loops against the live session and writes their cost
+   * per call and per element on this device to a JSON file, noting {@code arcoreVersion}. Returns
+   * false if the report cannot be created. The end is reported like that of the playback
+   * benchmark.
+   */
+  public static native boolean startArCoreApiProfiler(
+      long nativeApplication, String reportPath, String arcoreVersion);
+
+  /**
+   * Starts recording the composited output to an MP4 file with the hardware encoder and, if
+   * datasetUri is not null, an ARCore dataset of the session. Must be called on the GL thread.
+   * Returns false if the recording cannot be started.
+   */
+  public static native boolean startCapture(
+      long nativeApplication, String videoPath, String datasetUri);
+
+  /** Finishes the recording started by startCapture. Must be called on the GL thread. */
+  public static native void stopCapture(long nativeApplication);
+
+  /**
+   * Starts recording an ARCore dataset of the session to datasetUri, without the video of
+   * startCapture. Called on the UI thread; ARCore is told on a thread of its own, so drawing is not
+   * held up. Returns false if the previous start or stop is still running.
+   */
+  public static native boolean startDatasetRecording(long nativeApplication, String datasetUri);
+
+  /** Stops the dataset recording. Called on the UI thread, like startDatasetRecording. */
+  public static native boolean stopDatasetRecording(long nativeApplication);
+
+  /**
+   * Embeds marker as text in the running dataset recording with one of the next frames. Called on
+   * the UI thread. Returns false if too many markers are queued.
+   */
+  public static native boolean recordDatasetMarker(long nativeApplication, String marker);
+
+  /**
+   * Returns the frame times with and without a dataset recording, and the recordings' start and
+   * stop latencies, as text. Can be called from any thread.
+   */
+  public static native String getDatasetRecordingReport(long nativeApplication);
+
+  /**
+   * Starts logging the timestamp, tracking state, plane and anchor counts, stage timings and thermal
+   * status of every frame to a binary file at path, and into ARCore recordings made meanwhile. Must
+   * be called on the GL thread. Returns false if the file cannot be written.
+   */
+  public static native boolean startTelemetryLog(long nativeApplication, String path);
+
+  /** Closes the file written since startTelemetryLog. Must be called on the GL thread. */
+  public static native void stopTelemetryLog(long nativeApplication);
+
+  /**
+   * Starts capturing the camera, planes, point cloud, anchors, light estimate and depth of every
+   * frame to a binary file at path, which tools/arcore_replay plays back on a desktop. Must be
+   * called on the GL thread. Returns false if the file cannot be written.
+   */
+  public static native boolean startStateCapture(long nativeApplication, String path);
+
+  /** Finishes the file written since startStateCapture. Must be called on the GL thread. */
+  public static native void stopStateCapture(long nativeApplication);
+
+  /**
+   * Writes the next drawn frame to path as a binary PPM image. The pixels are read back and written
+   * in the background. Must be called on the GL thread.
+   */
+  public static native void captureScreenshot(long nativeApplication, String path);
+
   public static Bitmap loadImage(String imageName) {
 
     try {
@@ -0,0 +1,130 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.google.ar.core.examples.c.helloar;
+
+import android.os.Build;
+import java.lang.invoke.VarHandle;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+
+/**
+ * Reads the state the native code publishes after every frame from memory it shares with Java, so
+ * polling it takes no JNI call. The layout and the sequence lock are those of UiStateChannel in
+ * ui_state_channel.h. Each thread that reads the state needs its own instance.
+ */
+final class UiStateChannel {
+  private static final int SEQUENCE_OFFSET = 0;
+  private static final int LAYOUT_VERSION_OFFSET = 4;
+  private static final int STATE_OFFSET = 8;
+  private static final int FRAME_TIMESTAMP_OFFSET = STATE_OFFSET;
+  private static final int FRAME_COUNT_OFFSET = STATE_OFFSET + 8;
+  private static final int PLANE_COUNT_OFFSET = STATE_OFFSET + 12;
+  private static final int TRACKING_STATE_OFFSET = STATE_OFFSET + 16;
+  private static final int FLAGS_OFFSET = STATE_OFFSET + 20;
+  private static final int RENDER_SCALE_OFFSET = STATE_OFFSET + 24;
+  private static final int ANCHORS_DRAWN_OFFSET = STATE_OFFSET + 28;
+  private static final int ANCHORS_CULLED_OFFSET = STATE_OFFSET + 32;
+  private static final int DEPTH_UPLOADS_OFFSET = STATE_OFFSET + 36;
+  private static final int FRAME_MS_OFFSET = STATE_OFFSET + 40;
+  private static final int IDLE_FRAME_INTERVAL_OFFSET = STATE_OFFSET + 44;
+
+  private static final int LAYOUT_VERSION = 2;
+  private static final int FLAG_DEPTH_SUPPORTED = 1 << 0;
+  private static final int FLAG_PLAYBACK_BENCHMARK_FINISHED = 1 << 1;
+
+  private static final Object fenceLock = new Object();
+
+  private final ByteBuffer buffer;
+
+  // The last snapshot read().
+  long frameTimestampNs;
+  int frameCount;
+  int planeCount;
+  int trackingState;
+  boolean depthSupported;
+  boolean playbackBenchmarkFinished;
+  float renderScale = 1.0f;
+  int anchorsDrawn;
+  int anchorsCulled;
+  float depthUploadsPerSecond;
+  float frameMs;
+  // Milliseconds between the frames the native code wants while idle, 0 for every frame.
+  int idleFrameIntervalMs;
+
+  /** Wraps the buffer of {@link JniInterface#getUiStateBuffer}. */
+  UiStateChannel(ByteBuffer buffer) {
+    this.buffer = buffer.order(ByteOrder.nativeOrder());
+    if (buffer.getInt(LAYOUT_VERSION_OFFSET) != LAYOUT_VERSION) {
+      throw new IllegalStateException("Native UI state layout mismatch");
+    }
+  }
+
+  /**
+   * Copies the latest state into the fields, retrying while the native code writes it. Returns
+   * false, leaving the fields as they were, if no frame has been drawn yet.
+   */
+  boolean read() {
+    while (true) {
+      int sequence = buffer.getInt(SEQUENCE_OFFSET);
+      if (sequence == 0) {
+        return false;
+      }
+      if ((sequence & 1) != 0) {
+        Thread.yield();
+        continue;
+      }
+      loadFence();
+      long frameTimestampNs = buffer.getLong(FRAME_TIMESTAMP_OFFSET);
+      int frameCount = buffer.getInt(FRAME_COUNT_OFFSET);
+      int planeCount = buffer.getInt(PLANE_COUNT_OFFSET);
+      int trackingState = buffer.getInt(TRACKING_STATE_OFFSET);
+      int flags = buffer.getInt(FLAGS_OFFSET);
+      float renderScale = buffer.getFloat(RENDER_SCALE_OFFSET);
+      int anchorsDrawn = buffer.getInt(ANCHORS_DRAWN_OFFSET);
+      int anchorsCulled = buffer.getInt(ANCHORS_CULLED_OFFSET);
+      float depthUploadsPerSecond = buffer.getFloat(DEPTH_UPLOADS_OFFSET);
+      float frameMs = buffer.getFloat(FRAME_MS_OFFSET);
+      int idleFrameIntervalMs = buffer.getInt(IDLE_FRAME_INTERVAL_OFFSET);
+      loadFence();
+      if (buffer.getInt(SEQUENCE_OFFSET) != sequence) {
+        continue;
+      }
+      this.frameTimestampNs = frameTimestampNs;
+      this.frameCount = frameCount;
+      this.planeCount = planeCount;
+      this.trackingState = trackingState;
+      this.depthSupported = (flags & FLAG_DEPTH_SUPPORTED) != 0;
+      this.playbackBenchmarkFinished = (flags & FLAG_PLAYBACK_BENCHMARK_FINISHED) != 0;
+      this.renderScale = renderScale;
+      this.anchorsDrawn = anchorsDrawn;
+      this.anchorsCulled = anchorsCulled;
+      this.depthUploadsPerSecond = depthUploadsPerSecond;
+      this.frameMs = frameMs;
+      this.idleFrameIntervalMs = idleFrameIntervalMs;
+      return true;
+    }
+  }
+
+  /** Keeps the buffer reads on either side from being reordered with each other. */
+  private static void loadFence() {
+    if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.TIRAMISU) {
+      VarHandle.loadLoadFence();
+    } else {
+      // Older versions have no fence API, but ART emits full barriers for monitors.
+      synchronized (fenceLock) {}
+    }
+  }
+}
@@ -13,19 +13,30 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#version 450
 
 precision mediump float;
 
-uniform sampler2D u_Texture;
+layout (set = 0, binding = 0) uniform FrameUniforms {
+    mat4 u_View;
+    mat4 u_ViewProjection;
+    vec4 u_LightingParameters;
+    vec4 u_MaterialParameters;
+    vec4 u_ColorCorrectionParameters;
+};
 
-uniform vec4 u_LightingParameters;
-uniform vec4 u_MaterialParameters;
-uniform vec4 u_ColorCorrectionParameters;
+layout (set = 0, binding = 1) uniform sampler2D u_Texture;
 
-varying vec3 v_ViewPosition;
-varying vec3 v_ViewNormal;
-varying vec2 v_TexCoord;
-uniform vec4 u_ObjColor;
+layout (push_constant) uniform PushConstants {
+    mat4 u_Model;
+    vec4 u_ObjColor;
+};
+
+layout (location = 0) in vec3 v_ViewPosition;
+layout (location = 1) in vec3 v_ViewNormal;
+layout (location = 2) in vec2 v_TexCoord;
+
+layout (location = 0) out vec4 o_FragColor;
 
 void main() {
     // We support approximate sRGB gamma.
@@ -48,7 +59,7 @@ void main() {
     vec3 viewNormal = normalize(v_ViewNormal);
 
     // Flip the y-texture coordinate to address the texture from top-left.
-    vec4 objectColor = texture2D(u_Texture, vec2(v_TexCoord.x, 1.0 - v_TexCoord.y));
+    vec4 objectColor = texture(u_Texture, vec2(v_TexCoord.x, 1.0 - v_TexCoord.y));
 
     // Apply color to grayscale image only if the alpha of u_ObjColor is
     // greater and equal to 255.0.
@@ -76,6 +87,5 @@ void main() {
     color.rgb = pow(color, vec3(kGamma));
     // Apply average pixel intensity and color shift
     color *= colorShift * (averagePixelIntensity / kMiddleGrayGamma);
-    gl_FragColor.rgb = color;
-    gl_FragColor.a = objectColor.a;
+    o_FragColor = vec4(color, objectColor.a);
 }
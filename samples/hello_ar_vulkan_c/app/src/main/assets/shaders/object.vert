@@ -13,21 +13,34 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#version 450
 
-uniform mat4 u_ModelView;
-uniform mat4 u_ModelViewProjection;
+// Shared by all objects of the frame.
+layout (set = 0, binding = 0) uniform FrameUniforms {
+    mat4 u_View;
+    mat4 u_ViewProjection;
+    vec4 u_LightingParameters;
+    vec4 u_MaterialParameters;
+    vec4 u_ColorCorrectionParameters;
+};
 
-attribute vec4 a_Position;
-attribute vec3 a_Normal;
-attribute vec2 a_TexCoord;
+layout (push_constant) uniform PushConstants {
+    mat4 u_Model;
+    vec4 u_ObjColor;
+};
 
-varying vec3 v_ViewPosition;
-varying vec3 v_ViewNormal;
-varying vec2 v_TexCoord;
+layout (location = 0) in vec3 a_Position;
+layout (location = 1) in vec3 a_Normal;
+layout (location = 2) in vec2 a_TexCoord;
+
+layout (location = 0) out vec3 v_ViewPosition;
+layout (location = 1) out vec3 v_ViewNormal;
+layout (location = 2) out vec2 v_TexCoord;
 
 void main() {
-    v_ViewPosition = (u_ModelView * a_Position).xyz;
-    v_ViewNormal = normalize((u_ModelView * vec4(a_Normal, 0.0)).xyz);
+    vec4 world_position = u_Model * vec4(a_Position, 1.0);
+    v_ViewPosition = (u_View * world_position).xyz;
+    v_ViewNormal = normalize((u_View * (u_Model * vec4(a_Normal, 0.0))).xyz);
     v_TexCoord = a_TexCoord;
-    gl_Position = u_ModelViewProjection * a_Position;
+    gl_Position = u_ViewProjection * world_position;
 }
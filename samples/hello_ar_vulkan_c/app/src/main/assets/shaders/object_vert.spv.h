@@ -0,0 +1,109 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef C_ARCORE_SIMPLE_VULKAN_OBJECT_VERT_H_
+#define C_ARCORE_SIMPLE_VULKAN_OBJECT_VERT_H_
+
+// Generated from object.vert.spvasm by
+// tools/spirv_asm_to_header.py. Do not edit.
+#pragma once
+const uint32_t object_vert[] = {
+    0x07230203, 0x00010000, 0x00000000, 0x0000003a, 0x00000000, 0x00020011,
+    0x00000001, 0x0006000b, 0x00000001, 0x4c534c47, 0x6474732e, 0x3035342e,
+    0x00000000, 0x0003000e, 0x00000000, 0x00000001, 0x000c000f, 0x00000000,
+    0x00000002, 0x6e69616d, 0x00000000, 0x00000003, 0x00000004, 0x00000005,
+    0x00000006, 0x00000007, 0x00000008, 0x00000009, 0x00030003, 0x00000002,
+    0x000001c2, 0x00040005, 0x00000002, 0x6e69616d, 0x00000000, 0x00060005,
+    0x0000000a, 0x6d617246, 0x696e5565, 0x6d726f66, 0x00000073, 0x00050006,
+    0x0000000a, 0x00000000, 0x69565f75, 0x00007765, 0x00080006, 0x0000000a,
+    0x00000001, 0x69565f75, 0x72507765, 0x63656a6f, 0x6e6f6974, 0x00000000,
+    0x00090006, 0x0000000a, 0x00000002, 0x694c5f75, 0x69746867, 0x6150676e,
+    0x656d6172, 0x73726574, 0x00000000, 0x00090006, 0x0000000a, 0x00000003,
+    0x614d5f75, 0x69726574, 0x61506c61, 0x656d6172, 0x73726574, 0x00000000,
+    0x000a0006, 0x0000000a, 0x00000004, 0x6f435f75, 0x43726f6c, 0x6572726f,
+    0x6f697463, 0x7261506e, 0x74656d61, 0x00737265, 0x00030005, 0x0000000b,
+    0x00000000, 0x00060005, 0x0000000c, 0x68737550, 0x736e6f43, 0x746e6174,
+    0x00000073, 0x00050006, 0x0000000c, 0x00000000, 0x6f4d5f75, 0x006c6564,
+    0x00060006, 0x0000000c, 0x00000001, 0x624f5f75, 0x6c6f436a, 0x0000726f,
+    0x00030005, 0x0000000d, 0x00000000, 0x00050005, 0x00000003, 0x6f505f61,
+    0x69746973, 0x00006e6f, 0x00050005, 0x00000005, 0x6f4e5f61, 0x6c616d72,
+    0x00000000, 0x00050005, 0x00000008, 0x65545f61, 0x6f6f4378, 0x00006472,
+    0x00060005, 0x00000004, 0x69565f76, 0x6f507765, 0x69746973, 0x00006e6f,
+    0x00060005, 0x00000006, 0x69565f76, 0x6f4e7765, 0x6c616d72, 0x00000000,
+    0x00050005, 0x00000007, 0x65545f76, 0x6f6f4378, 0x00006472, 0x00060005,
+    0x0000000e, 0x505f6c67, 0x65567265, 0x78657472, 0x00000000, 0x00060006,
+    0x0000000e, 0x00000000, 0x505f6c67, 0x7469736f, 0x006e6f69, 0x00030005,
+    0x00000009, 0x00000000, 0x00040048, 0x0000000a, 0x00000000, 0x00000005,
+    0x00050048, 0x0000000a, 0x00000000, 0x00000023, 0x00000000, 0x00050048,
+    0x0000000a, 0x00000000, 0x00000007, 0x00000010, 0x00040048, 0x0000000a,
+    0x00000001, 0x00000005, 0x00050048, 0x0000000a, 0x00000001, 0x00000023,
+    0x00000040, 0x00050048, 0x0000000a, 0x00000001, 0x00000007, 0x00000010,
+    0x00050048, 0x0000000a, 0x00000002, 0x00000023, 0x00000080, 0x00050048,
+    0x0000000a, 0x00000003, 0x00000023, 0x00000090, 0x00050048, 0x0000000a,
+    0x00000004, 0x00000023, 0x000000a0, 0x00030047, 0x0000000a, 0x00000002,
+    0x00040047, 0x0000000b, 0x00000022, 0x00000000, 0x00040047, 0x0000000b,
+    0x00000021, 0x00000000, 0x00040048, 0x0000000c, 0x00000000, 0x00000005,
+    0x00050048, 0x0000000c, 0x00000000, 0x00000023, 0x00000000, 0x00050048,
+    0x0000000c, 0x00000000, 0x00000007, 0x00000010, 0x00050048, 0x0000000c,
+    0x00000001, 0x00000023, 0x00000040, 0x00030047, 0x0000000c, 0x00000002,
+    0x00040047, 0x00000003, 0x0000001e, 0x00000000, 0x00040047, 0x00000005,
+    0x0000001e, 0x00000001, 0x00040047, 0x00000008, 0x0000001e, 0x00000002,
+    0x00040047, 0x00000004, 0x0000001e, 0x00000000, 0x00040047, 0x00000006,
+    0x0000001e, 0x00000001, 0x00040047, 0x00000007, 0x0000001e, 0x00000002,
+    0x00050048, 0x0000000e, 0x00000000, 0x0000000b, 0x00000000, 0x00030047,
+    0x0000000e, 0x00000002, 0x00020013, 0x0000000f, 0x00030021, 0x00000010,
+    0x0000000f, 0x00030016, 0x00000011, 0x00000020, 0x00040015, 0x00000012,
+    0x00000020, 0x00000001, 0x00040017, 0x00000013, 0x00000011, 0x00000002,
+    0x00040017, 0x00000014, 0x00000011, 0x00000003, 0x00040017, 0x00000015,
+    0x00000011, 0x00000004, 0x00040018, 0x00000016, 0x00000015, 0x00000004,
+    0x0007001e, 0x0000000a, 0x00000016, 0x00000016, 0x00000015, 0x00000015,
+    0x00000015, 0x00040020, 0x00000017, 0x00000002, 0x0000000a, 0x0004003b,
+    0x00000017, 0x0000000b, 0x00000002, 0x0004001e, 0x0000000c, 0x00000016,
+    0x00000015, 0x00040020, 0x00000018, 0x00000009, 0x0000000c, 0x0004003b,
+    0x00000018, 0x0000000d, 0x00000009, 0x00040020, 0x00000019, 0x00000002,
+    0x00000016, 0x00040020, 0x0000001a, 0x00000009, 0x00000016, 0x00040020,
+    0x0000001b, 0x00000001, 0x00000013, 0x00040020, 0x0000001c, 0x00000001,
+    0x00000014, 0x00040020, 0x0000001d, 0x00000003, 0x00000013, 0x00040020,
+    0x0000001e, 0x00000003, 0x00000014, 0x00040020, 0x0000001f, 0x00000003,
+    0x00000015, 0x0004003b, 0x0000001c, 0x00000003, 0x00000001, 0x0004003b,
+    0x0000001c, 0x00000005, 0x00000001, 0x0004003b, 0x0000001b, 0x00000008,
+    0x00000001, 0x0004003b, 0x0000001e, 0x00000004, 0x00000003, 0x0004003b,
+    0x0000001e, 0x00000006, 0x00000003, 0x0004003b, 0x0000001d, 0x00000007,
+    0x00000003, 0x0003001e, 0x0000000e, 0x00000015, 0x00040020, 0x00000020,
+    0x00000003, 0x0000000e, 0x0004003b, 0x00000020, 0x00000009, 0x00000003,
+    0x0004002b, 0x00000012, 0x00000021, 0x00000000, 0x0004002b, 0x00000012,
+    0x00000022, 0x00000001, 0x0004002b, 0x00000011, 0x00000023, 0x00000000,
+    0x0004002b, 0x00000011, 0x00000024, 0x3f800000, 0x00050036, 0x0000000f,
+    0x00000002, 0x00000000, 0x00000010, 0x000200f8, 0x00000025, 0x00050041,
+    0x0000001a, 0x00000026, 0x0000000d, 0x00000021, 0x0004003d, 0x00000016,
+    0x00000027, 0x00000026, 0x0004003d, 0x00000014, 0x00000028, 0x00000003,
+    0x00050050, 0x00000015, 0x00000029, 0x00000028, 0x00000024, 0x00050091,
+    0x00000015, 0x0000002a, 0x00000027, 0x00000029, 0x00050041, 0x00000019,
+    0x0000002b, 0x0000000b, 0x00000021, 0x0004003d, 0x00000016, 0x0000002c,
+    0x0000002b, 0x00050091, 0x00000015, 0x0000002d, 0x0000002c, 0x0000002a,
+    0x0008004f, 0x00000014, 0x0000002e, 0x0000002d, 0x0000002d, 0x00000000,
+    0x00000001, 0x00000002, 0x0003003e, 0x00000004, 0x0000002e, 0x0004003d,
+    0x00000014, 0x0000002f, 0x00000005, 0x00050050, 0x00000015, 0x00000030,
+    0x0000002f, 0x00000023, 0x00050091, 0x00000015, 0x00000031, 0x00000027,
+    0x00000030, 0x00050091, 0x00000015, 0x00000032, 0x0000002c, 0x00000031,
+    0x0008004f, 0x00000014, 0x00000033, 0x00000032, 0x00000032, 0x00000000,
+    0x00000001, 0x00000002, 0x0006000c, 0x00000014, 0x00000034, 0x00000001,
+    0x00000045, 0x00000033, 0x0003003e, 0x00000006, 0x00000034, 0x0004003d,
+    0x00000013, 0x00000035, 0x00000008, 0x0003003e, 0x00000007, 0x00000035,
+    0x00050041, 0x00000019, 0x00000036, 0x0000000b, 0x00000022, 0x0004003d,
+    0x00000016, 0x00000037, 0x00000036, 0x00050091, 0x00000015, 0x00000038,
+    0x00000037, 0x0000002a, 0x00050041, 0x0000001f, 0x00000039, 0x00000009,
+    0x00000021, 0x0003003e, 0x00000039, 0x00000038, 0x000100fd, 0x00010038};
+#endif
@@ -13,18 +13,28 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#version 450
 
 precision highp float;
-uniform sampler2D u_Texture;
-uniform vec4 u_gridControl;  // dotThreshold, lineThreshold, lineFadeShrink, occlusionShrink
-varying vec3 v_TexCoordAlpha;
+
+layout (set = 0, binding = 0) uniform sampler2D u_Texture;
+
+// After the 96 bytes of the vertex stage.
+layout (push_constant) uniform PushConstants {
+   // dotThreshold, lineThreshold, lineFadeShrink, occlusionShrink
+   layout (offset = 96) vec4 u_GridControl;
+};
+
+layout (location = 0) in vec3 v_TexCoordAlpha;
+layout (location = 0) out vec4 o_FragColor;
 
 void main() {
-  vec4 control = texture2D(u_Texture, v_TexCoordAlpha.xy);
+  vec4 control = texture(u_Texture, v_TexCoordAlpha.xy);
   float dotScale = v_TexCoordAlpha.z;
-  float lineFade = max(0.0, u_gridControl.z * v_TexCoordAlpha.z - (u_gridControl.z - 1.0));
-  float alpha = (control.r * dotScale > u_gridControl.x) ? 1.0
-              : (control.g > u_gridControl.y)            ? lineFade
+  float lineFade = max(0.0, u_GridControl.z * v_TexCoordAlpha.z - (u_GridControl.z - 1.0));
+  float alpha = (control.r * dotScale > u_GridControl.x) ? 1.0
+              : (control.g > u_GridControl.y)            ? lineFade
                                                          : (0.25 * lineFade);
-  gl_FragColor = vec4(alpha * v_TexCoordAlpha.z);
+  // Premultiplied white.
+  o_FragColor = vec4(alpha * v_TexCoordAlpha.z);
 }
@@ -13,29 +13,36 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#version 450
 
-uniform mat4 u_Model;
-uniform mat4 u_ModelViewProjection;
-uniform mat2 u_PlaneUvMatrix;
-uniform vec3 u_Normal;
+// PlaneRenderer transforms the vertices of the planes into world space on the
+// CPU, so only the view projection and the normal change from plane to plane.
+layout (push_constant) uniform PushConstants {
+   mat4 u_ViewProjection;
+   vec4 u_Normal;
+   // Columns of the 2x2 transform of the plane coordinates into uv
+   // coordinates of the grid texture.
+   vec4 u_PlaneUvMatrix;
+};
 
-attribute vec3 a_XZPositionAlpha; // (x, z, alpha)
+// (x, y, z, alpha)
+layout (location = 0) in vec4 a_WorldPositionAlpha;
 
-varying vec3 v_TexCoordAlpha;
+layout (location = 0) out vec3 v_TexCoordAlpha;
 
 void main() {
-   vec4 local_pos = vec4(a_XZPositionAlpha.x, 0.0, a_XZPositionAlpha.y, 1.0);
-   vec4 world_pos = u_Model * local_pos;
+   vec4 world_pos = vec4(a_WorldPositionAlpha.xyz, 1.0);
 
    // Construct two vectors that are orthogonal to the normal.
    // This arbitrary choice is not co-linear with either horizontal
    // or vertical plane normals.
    const vec3 arbitrary = vec3(1.0, 1.0, 0.0);
-   vec3 vec_u = normalize(cross(u_Normal, arbitrary));
-   vec3 vec_v = normalize(cross(u_Normal, vec_u));
+   vec3 vec_u = normalize(cross(u_Normal.xyz, arbitrary));
+   vec3 vec_v = normalize(cross(u_Normal.xyz, vec_u));
 
    // Project vertices in world frame onto vec_u and vec_v.
    vec2 uv = vec2(dot(world_pos.xyz, vec_u), dot(world_pos.xyz, vec_v));
-   v_TexCoordAlpha = vec3(u_PlaneUvMatrix * uv, a_XZPositionAlpha.z);
-   gl_Position = u_ModelViewProjection * local_pos;
+   mat2 plane_uv_matrix = mat2(u_PlaneUvMatrix.xy, u_PlaneUvMatrix.zw);
+   v_TexCoordAlpha = vec3(plane_uv_matrix * uv, a_WorldPositionAlpha.w);
+   gl_Position = u_ViewProjection * world_pos;
 }
@@ -0,0 +1,77 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef C_ARCORE_SIMPLE_VULKAN_PLANE_FRAG_H_
+#define C_ARCORE_SIMPLE_VULKAN_PLANE_FRAG_H_
+
+// Generated from plane.frag.spvasm by
+// tools/spirv_asm_to_header.py. Do not edit.
+#pragma once
+const uint32_t plane_frag[] = {
+    0x07230203, 0x00010000, 0x00000000, 0x00000034, 0x00000000, 0x00020011,
+    0x00000001, 0x0006000b, 0x00000001, 0x4c534c47, 0x6474732e, 0x3035342e,
+    0x00000000, 0x0003000e, 0x00000000, 0x00000001, 0x0007000f, 0x00000004,
+    0x00000002, 0x6e69616d, 0x00000000, 0x00000003, 0x00000004, 0x00030010,
+    0x00000002, 0x00000007, 0x00030003, 0x00000002, 0x000001c2, 0x00040005,
+    0x00000002, 0x6e69616d, 0x00000000, 0x00050005, 0x00000005, 0x65545f75,
+    0x72757478, 0x00000065, 0x00060005, 0x00000003, 0x65545f76, 0x6f6f4378,
+    0x6c416472, 0x00616870, 0x00060005, 0x00000006, 0x68737550, 0x736e6f43,
+    0x746e6174, 0x00000073, 0x00070006, 0x00000006, 0x00000000, 0x72475f75,
+    0x6f436469, 0x6f72746e, 0x0000006c, 0x00030005, 0x00000007, 0x00000000,
+    0x00050005, 0x00000004, 0x72465f6f, 0x6f436761, 0x00726f6c, 0x00040047,
+    0x00000005, 0x00000022, 0x00000000, 0x00040047, 0x00000005, 0x00000021,
+    0x00000000, 0x00040047, 0x00000003, 0x0000001e, 0x00000000, 0x00050048,
+    0x00000006, 0x00000000, 0x00000023, 0x00000060, 0x00030047, 0x00000006,
+    0x00000002, 0x00040047, 0x00000004, 0x0000001e, 0x00000000, 0x00020013,
+    0x00000008, 0x00030021, 0x00000009, 0x00000008, 0x00030016, 0x0000000a,
+    0x00000020, 0x00020014, 0x0000000b, 0x00040015, 0x0000000c, 0x00000020,
+    0x00000001, 0x00040017, 0x0000000d, 0x0000000a, 0x00000002, 0x00040017,
+    0x0000000e, 0x0000000a, 0x00000003, 0x00040017, 0x0000000f, 0x0000000a,
+    0x00000004, 0x00090019, 0x00000010, 0x0000000a, 0x00000001, 0x00000000,
+    0x00000000, 0x00000000, 0x00000001, 0x00000000, 0x0003001b, 0x00000011,
+    0x00000010, 0x00040020, 0x00000012, 0x00000000, 0x00000011, 0x0004003b,
+    0x00000012, 0x00000005, 0x00000000, 0x00040020, 0x00000013, 0x00000001,
+    0x0000000e, 0x0004003b, 0x00000013, 0x00000003, 0x00000001, 0x0003001e,
+    0x00000006, 0x0000000f, 0x00040020, 0x00000014, 0x00000009, 0x00000006,
+    0x0004003b, 0x00000014, 0x00000007, 0x00000009, 0x00040020, 0x00000015,
+    0x00000009, 0x0000000f, 0x00040020, 0x00000016, 0x00000003, 0x0000000f,
+    0x0004003b, 0x00000016, 0x00000004, 0x00000003, 0x0004002b, 0x0000000c,
+    0x00000017, 0x00000000, 0x0004002b, 0x0000000a, 0x00000018, 0x00000000,
+    0x0004002b, 0x0000000a, 0x00000019, 0x3f800000, 0x0004002b, 0x0000000a,
+    0x0000001a, 0x3e800000, 0x00050036, 0x00000008, 0x00000002, 0x00000000,
+    0x00000009, 0x000200f8, 0x0000001b, 0x0004003d, 0x00000011, 0x0000001c,
+    0x00000005, 0x0004003d, 0x0000000e, 0x0000001d, 0x00000003, 0x0007004f,
+    0x0000000d, 0x0000001e, 0x0000001d, 0x0000001d, 0x00000000, 0x00000001,
+    0x00050057, 0x0000000f, 0x0000001f, 0x0000001c, 0x0000001e, 0x00050051,
+    0x0000000a, 0x00000020, 0x0000001d, 0x00000002, 0x00050041, 0x00000015,
+    0x00000021, 0x00000007, 0x00000017, 0x0004003d, 0x0000000f, 0x00000022,
+    0x00000021, 0x00050051, 0x0000000a, 0x00000023, 0x00000022, 0x00000002,
+    0x00050085, 0x0000000a, 0x00000024, 0x00000023, 0x00000020, 0x00050083,
+    0x0000000a, 0x00000025, 0x00000023, 0x00000019, 0x00050083, 0x0000000a,
+    0x00000026, 0x00000024, 0x00000025, 0x0007000c, 0x0000000a, 0x00000027,
+    0x00000001, 0x00000028, 0x00000018, 0x00000026, 0x00050051, 0x0000000a,
+    0x00000028, 0x0000001f, 0x00000000, 0x00050085, 0x0000000a, 0x00000029,
+    0x00000028, 0x00000020, 0x00050051, 0x0000000a, 0x0000002a, 0x00000022,
+    0x00000000, 0x000500ba, 0x0000000b, 0x0000002b, 0x00000029, 0x0000002a,
+    0x00050051, 0x0000000a, 0x0000002c, 0x0000001f, 0x00000001, 0x00050051,
+    0x0000000a, 0x0000002d, 0x00000022, 0x00000001, 0x000500ba, 0x0000000b,
+    0x0000002e, 0x0000002c, 0x0000002d, 0x00050085, 0x0000000a, 0x0000002f,
+    0x0000001a, 0x00000027, 0x000600a9, 0x0000000a, 0x00000030, 0x0000002e,
+    0x00000027, 0x0000002f, 0x000600a9, 0x0000000a, 0x00000031, 0x0000002b,
+    0x00000019, 0x00000030, 0x00050085, 0x0000000a, 0x00000032, 0x00000031,
+    0x00000020, 0x00070050, 0x0000000f, 0x00000033, 0x00000032, 0x00000032,
+    0x00000032, 0x00000032, 0x0003003e, 0x00000004, 0x00000033, 0x000100fd,
+    0x00010038};
+#endif
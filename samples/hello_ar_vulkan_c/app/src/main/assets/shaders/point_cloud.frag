@@ -13,10 +13,14 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
-
+#version 330
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
 precision mediump float;
-varying vec4 v_Color;
+
+layout (location = 0) in vec4 v_Color;
+layout (location = 0) out vec4 o_FragColor;
 
 void main() {
-    gl_FragColor = v_Color;
+    o_FragColor = v_Color;
 }
@@ -13,14 +13,18 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#version 330
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
 
-uniform mat4 u_ModelViewProjection;
-uniform vec4 u_Color;
-uniform float u_PointSize;
+layout (push_constant) uniform PushConstants {
+   mat4 u_ModelViewProjection;
+   vec4 u_Color;
+   float u_PointSize;
+};
 
-attribute vec4 a_Position;
-
-varying vec4 v_Color;
+layout (location = 0) in vec4 a_Position;
+layout (location = 0) out vec4 v_Color;
 
 void main() {
    v_Color = u_Color;
@@ -0,0 +1,42 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef C_ARCORE_SIMPLE_VULKAN_POINT_CLOUD_FRAG_H_
+#define C_ARCORE_SIMPLE_VULKAN_POINT_CLOUD_FRAG_H_
+
+// Generated from point_cloud.frag.spvasm by
+// tools/spirv_asm_to_header.py. Do not edit.
+#pragma once
+const uint32_t point_cloud_frag[] = {
+    0x07230203, 0x00010000, 0x00000000, 0x0000000d, 0x00000000, 0x00020011,
+    0x00000001, 0x0006000b, 0x00000001, 0x4c534c47, 0x6474732e, 0x3035342e,
+    0x00000000, 0x0003000e, 0x00000000, 0x00000001, 0x0007000f, 0x00000004,
+    0x00000002, 0x6e69616d, 0x00000000, 0x00000003, 0x00000004, 0x00030010,
+    0x00000002, 0x00000007, 0x00030003, 0x00000002, 0x0000014a, 0x00090004,
+    0x415f4c47, 0x735f4252, 0x72617065, 0x5f657461, 0x64616873, 0x6f5f7265,
+    0x63656a62, 0x00007374, 0x00090004, 0x415f4c47, 0x735f4252, 0x69646168,
+    0x6c5f676e, 0x75676e61, 0x5f656761, 0x70303234, 0x006b6361, 0x00040005,
+    0x00000002, 0x6e69616d, 0x00000000, 0x00050005, 0x00000003, 0x72465f6f,
+    0x6f436761, 0x00726f6c, 0x00040005, 0x00000004, 0x6f435f76, 0x00726f6c,
+    0x00040047, 0x00000003, 0x0000001e, 0x00000000, 0x00040047, 0x00000004,
+    0x0000001e, 0x00000000, 0x00020013, 0x00000005, 0x00030021, 0x00000006,
+    0x00000005, 0x00030016, 0x00000007, 0x00000020, 0x00040017, 0x00000008,
+    0x00000007, 0x00000004, 0x00040020, 0x00000009, 0x00000003, 0x00000008,
+    0x0004003b, 0x00000009, 0x00000003, 0x00000003, 0x00040020, 0x0000000a,
+    0x00000001, 0x00000008, 0x0004003b, 0x0000000a, 0x00000004, 0x00000001,
+    0x00050036, 0x00000005, 0x00000002, 0x00000000, 0x00000006, 0x000200f8,
+    0x0000000b, 0x0004003d, 0x00000008, 0x0000000c, 0x00000004, 0x0003003e,
+    0x00000003, 0x0000000c, 0x000100fd, 0x00010038};
+#endif
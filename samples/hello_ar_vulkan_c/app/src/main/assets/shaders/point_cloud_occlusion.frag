@@ -0,0 +1,76 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#version 450
+#version 450
+
+// The point cloud faded out where the ARCore depth image is in front of it,
+// like the virtual objects of hello_ar_c. Used with point_cloud.vert.
+precision mediump float;
+
+// After the 84 bytes of the vertex stage.
+layout (push_constant) uniform PushConstants {
+   // Rows of the transform of framebuffer pixel coordinates into uv
+   // coordinates of the depth image.
+   layout (offset = 96) vec4 u_DepthUvFromPixelX;
+   vec4 u_DepthUvFromPixelY;
+};
+
+// Millimeters.
+layout (set = 0, binding = 0) uniform usampler2D u_DepthTexture;
+
+layout (location = 0) in vec4 v_Color;
+layout (location = 0) out vec4 o_FragColor;
+
+// Returns linear interpolation position of value between min and max bounds.
+// E.g., DepthInverseLerp(1100, 1000, 2000) returns 0.1.
+float DepthInverseLerp(in float value, in float min_bound, in float max_bound) {
+  return clamp((value - min_bound) / (max_bound - min_bound), 0.0, 1.0);
+}
+
+// Returns a value between 0.0 (not visible) and 1.0 (completely visible)
+// Which represents how visible or occluded is the pixel in relation to the
+// depth map.
+float DepthGetVisibility(in float depth_mm, in float asset_depth_mm) {
+  // Instead of a hard z-buffer test, allow the asset to fade into the
+  // background along a 2 * kDepthTolerancePerMm * asset_depth_mm
+  // range centered on the background depth.
+  const float kDepthTolerancePerMm = 0.015;
+  float visibility_occlusion = clamp(0.5 * (depth_mm - asset_depth_mm) /
+    (kDepthTolerancePerMm * asset_depth_mm) + 0.5, 0.0, 1.0);
+
+  // Depth close to zero is most likely invalid, do not use it for occlusions.
+  float visibility_depth_near = 1.0 - DepthInverseLerp(
+      depth_mm, /*min_depth_mm=*/150.0, /*max_depth_mm=*/200.0);
+
+  // Same for very high depth values.
+  float visibility_depth_far = DepthInverseLerp(
+      depth_mm, /*min_depth_mm=*/7500.0, /*max_depth_mm=*/8000.0);
+
+  return max(visibility_occlusion,
+             max(visibility_depth_near, visibility_depth_far));
+}
+
+void main() {
+  vec3 pixel = vec3(gl_FragCoord.xy, 1.0);
+  vec2 depth_uv = vec2(dot(u_DepthUvFromPixelX.xyz, pixel),
+                       dot(u_DepthUvFromPixelY.xyz, pixel));
+  float depth_mm = float(texture(u_DepthTexture, depth_uv).r);
+  // gl_FragCoord.w is 1 / w of the clip position, which is the distance
+  // along the view direction.
+  float asset_depth_mm = 1000.0 / gl_FragCoord.w;
+  o_FragColor = vec4(v_Color.rgb,
+                     v_Color.a * DepthGetVisibility(depth_mm, asset_depth_mm));
+}
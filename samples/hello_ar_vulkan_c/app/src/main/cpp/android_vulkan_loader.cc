@@ -17,955 +17,695 @@
 
 #include <dlfcn.h>
 
+#include <cstring>
+
 namespace simple_vulkan {
+namespace {
 
-bool LoadVulkan() {
-  void* libvulkan = dlopen("libvulkan.so", RTLD_NOW | RTLD_LOCAL);
-  if (!libvulkan) {
-    return false;
-  }
+// What a function is resolved with, see LoadVulkan().
+enum class Level { kGlobal, kInstance, kDevice };
+
+struct Function {
+  Level level;
+  const char* name;
+  PFN_vkVoidFunction* pointer;
+};
+
+#define GLOBAL_FUNCTION(name) \
+  { Level::kGlobal, #name, reinterpret_cast<PFN_vkVoidFunction*>(&name) }
+#define INSTANCE_FUNCTION(name) \
+  { Level::kInstance, #name, reinterpret_cast<PFN_vkVoidFunction*>(&name) }
+#define DEVICE_FUNCTION(name) \
+  { Level::kDevice, #name, reinterpret_cast<PFN_vkVoidFunction*>(&name) }
+
+// vkGetInstanceProcAddr is left out, it comes from dlsym.
+const Function kCore0Functions[] = {
+    GLOBAL_FUNCTION(vkCreateInstance),
+    INSTANCE_FUNCTION(vkDestroyInstance),
+    INSTANCE_FUNCTION(vkEnumeratePhysicalDevices),
+    INSTANCE_FUNCTION(vkGetPhysicalDeviceFeatures),
+    INSTANCE_FUNCTION(vkGetPhysicalDeviceFormatProperties),
+    INSTANCE_FUNCTION(vkGetPhysicalDeviceImageFormatProperties),
+    INSTANCE_FUNCTION(vkGetPhysicalDeviceProperties),
+    INSTANCE_FUNCTION(vkGetPhysicalDeviceQueueFamilyProperties),
+    INSTANCE_FUNCTION(vkGetPhysicalDeviceMemoryProperties),
+    INSTANCE_FUNCTION(vkGetDeviceProcAddr),
+    INSTANCE_FUNCTION(vkCreateDevice),
+    DEVICE_FUNCTION(vkDestroyDevice),
+    GLOBAL_FUNCTION(vkEnumerateInstanceExtensionProperties),
+    INSTANCE_FUNCTION(vkEnumerateDeviceExtensionProperties),
+    GLOBAL_FUNCTION(vkEnumerateInstanceLayerProperties),
+    INSTANCE_FUNCTION(vkEnumerateDeviceLayerProperties),
+    DEVICE_FUNCTION(vkGetDeviceQueue),
+    DEVICE_FUNCTION(vkQueueSubmit),
+    DEVICE_FUNCTION(vkQueueWaitIdle),
+    DEVICE_FUNCTION(vkDeviceWaitIdle),
+    DEVICE_FUNCTION(vkAllocateMemory),
+    DEVICE_FUNCTION(vkFreeMemory),
+    DEVICE_FUNCTION(vkMapMemory),
+    DEVICE_FUNCTION(vkUnmapMemory),
+    DEVICE_FUNCTION(vkFlushMappedMemoryRanges),
+    DEVICE_FUNCTION(vkInvalidateMappedMemoryRanges),
+    DEVICE_FUNCTION(vkGetDeviceMemoryCommitment),
+    DEVICE_FUNCTION(vkBindBufferMemory),
+    DEVICE_FUNCTION(vkBindImageMemory),
+    DEVICE_FUNCTION(vkGetBufferMemoryRequirements),
+    DEVICE_FUNCTION(vkGetImageMemoryRequirements),
+    DEVICE_FUNCTION(vkGetImageSparseMemoryRequirements),
+    INSTANCE_FUNCTION(vkGetPhysicalDeviceSparseImageFormatProperties),
+    DEVICE_FUNCTION(vkQueueBindSparse),
+    DEVICE_FUNCTION(vkCreateFence),
+    DEVICE_FUNCTION(vkDestroyFence),
+    DEVICE_FUNCTION(vkResetFences),
+    DEVICE_FUNCTION(vkGetFenceStatus),
+    DEVICE_FUNCTION(vkWaitForFences),
+    DEVICE_FUNCTION(vkCreateSemaphore),
+    DEVICE_FUNCTION(vkDestroySemaphore),
+    DEVICE_FUNCTION(vkCreateEvent),
+    DEVICE_FUNCTION(vkDestroyEvent),
+    DEVICE_FUNCTION(vkGetEventStatus),
+    DEVICE_FUNCTION(vkSetEvent),
+    DEVICE_FUNCTION(vkResetEvent),
+    DEVICE_FUNCTION(vkCreateQueryPool),
+    DEVICE_FUNCTION(vkDestroyQueryPool),
+    DEVICE_FUNCTION(vkGetQueryPoolResults),
+    DEVICE_FUNCTION(vkCreateBuffer),
+    DEVICE_FUNCTION(vkDestroyBuffer),
+    DEVICE_FUNCTION(vkCreateBufferView),
+    DEVICE_FUNCTION(vkDestroyBufferView),
+    DEVICE_FUNCTION(vkCreateImage),
+    DEVICE_FUNCTION(vkDestroyImage),
+    DEVICE_FUNCTION(vkGetImageSubresourceLayout),
+    DEVICE_FUNCTION(vkCreateImageView),
+    DEVICE_FUNCTION(vkDestroyImageView),
+    DEVICE_FUNCTION(vkCreateShaderModule),
+    DEVICE_FUNCTION(vkDestroyShaderModule),
+    DEVICE_FUNCTION(vkCreatePipelineCache),
+    DEVICE_FUNCTION(vkDestroyPipelineCache),
+    DEVICE_FUNCTION(vkGetPipelineCacheData),
+    DEVICE_FUNCTION(vkMergePipelineCaches),
+    DEVICE_FUNCTION(vkCreateGraphicsPipelines),
+    DEVICE_FUNCTION(vkCreateComputePipelines),
+    DEVICE_FUNCTION(vkDestroyPipeline),
+    DEVICE_FUNCTION(vkCreatePipelineLayout),
+    DEVICE_FUNCTION(vkDestroyPipelineLayout),
+    DEVICE_FUNCTION(vkCreateSampler),
+    DEVICE_FUNCTION(vkDestroySampler),
+    DEVICE_FUNCTION(vkCreateDescriptorSetLayout),
+    DEVICE_FUNCTION(vkDestroyDescriptorSetLayout),
+    DEVICE_FUNCTION(vkCreateDescriptorPool),
+    DEVICE_FUNCTION(vkDestroyDescriptorPool),
+    DEVICE_FUNCTION(vkResetDescriptorPool),
+    DEVICE_FUNCTION(vkAllocateDescriptorSets),
+    DEVICE_FUNCTION(vkFreeDescriptorSets),
+    DEVICE_FUNCTION(vkUpdateDescriptorSets),
+    DEVICE_FUNCTION(vkCreateFramebuffer),
+    DEVICE_FUNCTION(vkDestroyFramebuffer),
+    DEVICE_FUNCTION(vkCreateRenderPass),
+    DEVICE_FUNCTION(vkDestroyRenderPass),
+    DEVICE_FUNCTION(vkGetRenderAreaGranularity),
+    DEVICE_FUNCTION(vkCreateCommandPool),
+    DEVICE_FUNCTION(vkDestroyCommandPool),
+    DEVICE_FUNCTION(vkResetCommandPool),
+    DEVICE_FUNCTION(vkAllocateCommandBuffers),
+    DEVICE_FUNCTION(vkFreeCommandBuffers),
+    DEVICE_FUNCTION(vkBeginCommandBuffer),
+    DEVICE_FUNCTION(vkEndCommandBuffer),
+    DEVICE_FUNCTION(vkResetCommandBuffer),
+    DEVICE_FUNCTION(vkCmdBindPipeline),
+    DEVICE_FUNCTION(vkCmdSetViewport),
+    DEVICE_FUNCTION(vkCmdSetScissor),
+    DEVICE_FUNCTION(vkCmdSetLineWidth),
+    DEVICE_FUNCTION(vkCmdSetDepthBias),
+    DEVICE_FUNCTION(vkCmdSetBlendConstants),
+    DEVICE_FUNCTION(vkCmdSetDepthBounds),
+    DEVICE_FUNCTION(vkCmdSetStencilCompareMask),
+    DEVICE_FUNCTION(vkCmdSetStencilWriteMask),
+    DEVICE_FUNCTION(vkCmdSetStencilReference),
+    DEVICE_FUNCTION(vkCmdBindDescriptorSets),
+    DEVICE_FUNCTION(vkCmdBindIndexBuffer),
+    DEVICE_FUNCTION(vkCmdBindVertexBuffers),
+    DEVICE_FUNCTION(vkCmdDraw),
+    DEVICE_FUNCTION(vkCmdDrawIndexed),
+    DEVICE_FUNCTION(vkCmdDrawIndirect),
+    DEVICE_FUNCTION(vkCmdDrawIndexedIndirect),
+    DEVICE_FUNCTION(vkCmdDispatch),
+    DEVICE_FUNCTION(vkCmdDispatchIndirect),
+    DEVICE_FUNCTION(vkCmdCopyBuffer),
+    DEVICE_FUNCTION(vkCmdCopyImage),
+    DEVICE_FUNCTION(vkCmdBlitImage),
+    DEVICE_FUNCTION(vkCmdCopyBufferToImage),
+    DEVICE_FUNCTION(vkCmdCopyImageToBuffer),
+    DEVICE_FUNCTION(vkCmdUpdateBuffer),
+    DEVICE_FUNCTION(vkCmdFillBuffer),
+    DEVICE_FUNCTION(vkCmdClearColorImage),
+    DEVICE_FUNCTION(vkCmdClearDepthStencilImage),
+    DEVICE_FUNCTION(vkCmdClearAttachments),
+    DEVICE_FUNCTION(vkCmdResolveImage),
+    DEVICE_FUNCTION(vkCmdSetEvent),
+    DEVICE_FUNCTION(vkCmdResetEvent),
+    DEVICE_FUNCTION(vkCmdWaitEvents),
+    DEVICE_FUNCTION(vkCmdPipelineBarrier),
+    DEVICE_FUNCTION(vkCmdBeginQuery),
+    DEVICE_FUNCTION(vkCmdEndQuery),
+    DEVICE_FUNCTION(vkCmdResetQueryPool),
+    DEVICE_FUNCTION(vkCmdWriteTimestamp),
+    DEVICE_FUNCTION(vkCmdCopyQueryPoolResults),
+    DEVICE_FUNCTION(vkCmdPushConstants),
+    DEVICE_FUNCTION(vkCmdBeginRenderPass),
+    DEVICE_FUNCTION(vkCmdNextSubpass),
+    DEVICE_FUNCTION(vkCmdEndRenderPass),
+    DEVICE_FUNCTION(vkCmdExecuteCommands),
+};
+
+const Function kCore1Functions[] = {
+    GLOBAL_FUNCTION(vkEnumerateInstanceVersion),
+    DEVICE_FUNCTION(vkBindBufferMemory2),
+    DEVICE_FUNCTION(vkBindImageMemory2),
+    DEVICE_FUNCTION(vkGetDeviceGroupPeerMemoryFeatures),
+    DEVICE_FUNCTION(vkCmdSetDeviceMask),
+    DEVICE_FUNCTION(vkCmdDispatchBase),
+    INSTANCE_FUNCTION(vkEnumeratePhysicalDeviceGroups),
+    DEVICE_FUNCTION(vkGetImageMemoryRequirements2),
+    DEVICE_FUNCTION(vkGetBufferMemoryRequirements2),
+    DEVICE_FUNCTION(vkGetImageSparseMemoryRequirements2),
+    INSTANCE_FUNCTION(vkGetPhysicalDeviceFeatures2),
+    INSTANCE_FUNCTION(vkGetPhysicalDeviceProperties2),
+    INSTANCE_FUNCTION(vkGetPhysicalDeviceFormatProperties2),
+    INSTANCE_FUNCTION(vkGetPhysicalDeviceImageFormatProperties2),
+    INSTANCE_FUNCTION(vkGetPhysicalDeviceQueueFamilyProperties2),
+    INSTANCE_FUNCTION(vkGetPhysicalDeviceMemoryProperties2),
+    INSTANCE_FUNCTION(vkGetPhysicalDeviceSparseImageFormatProperties2),
+    DEVICE_FUNCTION(vkTrimCommandPool),
+    DEVICE_FUNCTION(vkGetDeviceQueue2),
+    DEVICE_FUNCTION(vkCreateSamplerYcbcrConversion),
+    DEVICE_FUNCTION(vkDestroySamplerYcbcrConversion),
+    DEVICE_FUNCTION(vkCreateDescriptorUpdateTemplate),
+    DEVICE_FUNCTION(vkDestroyDescriptorUpdateTemplate),
+    DEVICE_FUNCTION(vkUpdateDescriptorSetWithTemplate),
+    INSTANCE_FUNCTION(vkGetPhysicalDeviceExternalBufferProperties),
+    INSTANCE_FUNCTION(vkGetPhysicalDeviceExternalFenceProperties),
+    INSTANCE_FUNCTION(vkGetPhysicalDeviceExternalSemaphoreProperties),
+    DEVICE_FUNCTION(vkGetDescriptorSetLayoutSupport),
+};
+
+const Function kCore2Functions[] = {
+    DEVICE_FUNCTION(vkCmdDrawIndirectCount),
+    DEVICE_FUNCTION(vkCmdDrawIndexedIndirectCount),
+    DEVICE_FUNCTION(vkCreateRenderPass2),
+    DEVICE_FUNCTION(vkCmdBeginRenderPass2),
+    DEVICE_FUNCTION(vkCmdNextSubpass2),
+    DEVICE_FUNCTION(vkCmdEndRenderPass2),
+    DEVICE_FUNCTION(vkResetQueryPool),
+    DEVICE_FUNCTION(vkGetSemaphoreCounterValue),
+    DEVICE_FUNCTION(vkWaitSemaphores),
+    DEVICE_FUNCTION(vkSignalSemaphore),
+    DEVICE_FUNCTION(vkGetBufferDeviceAddress),
+    DEVICE_FUNCTION(vkGetBufferOpaqueCaptureAddress),
+    DEVICE_FUNCTION(vkGetDeviceMemoryOpaqueCaptureAddress),
+};
+
+const Function kCore3Functions[] = {
+    INSTANCE_FUNCTION(vkGetPhysicalDeviceToolProperties),
+    DEVICE_FUNCTION(vkCreatePrivateDataSlot),
+    DEVICE_FUNCTION(vkDestroyPrivateDataSlot),
+    DEVICE_FUNCTION(vkSetPrivateData),
+    DEVICE_FUNCTION(vkGetPrivateData),
+    DEVICE_FUNCTION(vkCmdSetEvent2),
+    DEVICE_FUNCTION(vkCmdResetEvent2),
+    DEVICE_FUNCTION(vkCmdWaitEvents2),
+    DEVICE_FUNCTION(vkCmdPipelineBarrier2),
+    DEVICE_FUNCTION(vkCmdWriteTimestamp2),
+    DEVICE_FUNCTION(vkQueueSubmit2),
+    DEVICE_FUNCTION(vkCmdCopyBuffer2),
+    DEVICE_FUNCTION(vkCmdCopyImage2),
+    DEVICE_FUNCTION(vkCmdCopyBufferToImage2),
+    DEVICE_FUNCTION(vkCmdCopyImageToBuffer2),
+    DEVICE_FUNCTION(vkCmdBlitImage2),
+    DEVICE_FUNCTION(vkCmdResolveImage2),
+    DEVICE_FUNCTION(vkCmdBeginRendering),
+    DEVICE_FUNCTION(vkCmdEndRendering),
+    DEVICE_FUNCTION(vkCmdSetCullMode),
+    DEVICE_FUNCTION(vkCmdSetFrontFace),
+    DEVICE_FUNCTION(vkCmdSetPrimitiveTopology),
+    DEVICE_FUNCTION(vkCmdSetViewportWithCount),
+    DEVICE_FUNCTION(vkCmdSetScissorWithCount),
+    DEVICE_FUNCTION(vkCmdBindVertexBuffers2),
+    DEVICE_FUNCTION(vkCmdSetDepthTestEnable),
+    DEVICE_FUNCTION(vkCmdSetDepthWriteEnable),
+    DEVICE_FUNCTION(vkCmdSetDepthCompareOp),
+    DEVICE_FUNCTION(vkCmdSetDepthBoundsTestEnable),
+    DEVICE_FUNCTION(vkCmdSetStencilTestEnable),
+    DEVICE_FUNCTION(vkCmdSetStencilOp),
+    DEVICE_FUNCTION(vkCmdSetRasterizerDiscardEnable),
+    DEVICE_FUNCTION(vkCmdSetDepthBiasEnable),
+    DEVICE_FUNCTION(vkCmdSetPrimitiveRestartEnable),
+    DEVICE_FUNCTION(vkGetDeviceBufferMemoryRequirements),
+    DEVICE_FUNCTION(vkGetDeviceImageMemoryRequirements),
+    DEVICE_FUNCTION(vkGetDeviceImageSparseMemoryRequirements),
+};
+
+const Function kKhrSurfaceFunctions[] = {
+    INSTANCE_FUNCTION(vkDestroySurfaceKHR),
+    INSTANCE_FUNCTION(vkGetPhysicalDeviceSurfaceSupportKHR),
+    INSTANCE_FUNCTION(vkGetPhysicalDeviceSurfaceCapabilitiesKHR),
+    INSTANCE_FUNCTION(vkGetPhysicalDeviceSurfaceFormatsKHR),
+    INSTANCE_FUNCTION(vkGetPhysicalDeviceSurfacePresentModesKHR),
+};
+
+const Function kKhrSwapchainFunctions[] = {
+    DEVICE_FUNCTION(vkCreateSwapchainKHR),
+    DEVICE_FUNCTION(vkDestroySwapchainKHR),
+    DEVICE_FUNCTION(vkGetSwapchainImagesKHR),
+    DEVICE_FUNCTION(vkAcquireNextImageKHR),
+    DEVICE_FUNCTION(vkQueuePresentKHR),
+    DEVICE_FUNCTION(vkGetDeviceGroupPresentCapabilitiesKHR),
+    DEVICE_FUNCTION(vkGetDeviceGroupSurfacePresentModesKHR),
+    INSTANCE_FUNCTION(vkGetPhysicalDevicePresentRectanglesKHR),
+    DEVICE_FUNCTION(vkAcquireNextImage2KHR),
+};
+
+const Function kKhrDisplayFunctions[] = {
+    INSTANCE_FUNCTION(vkGetPhysicalDeviceDisplayPropertiesKHR),
+    INSTANCE_FUNCTION(vkGetPhysicalDeviceDisplayPlanePropertiesKHR),
+    INSTANCE_FUNCTION(vkGetDisplayPlaneSupportedDisplaysKHR),
+    INSTANCE_FUNCTION(vkGetDisplayModePropertiesKHR),
+    INSTANCE_FUNCTION(vkCreateDisplayModeKHR),
+    INSTANCE_FUNCTION(vkGetDisplayPlaneCapabilitiesKHR),
+    INSTANCE_FUNCTION(vkCreateDisplayPlaneSurfaceKHR),
+};
+
+const Function kKhrDisplaySwapchainFunctions[] = {
+    DEVICE_FUNCTION(vkCreateSharedSwapchainsKHR),
+};
+
+const Function kKhrDynamicRenderingFunctions[] = {
+    DEVICE_FUNCTION(vkCmdBeginRenderingKHR),
+    DEVICE_FUNCTION(vkCmdEndRenderingKHR),
+};
+
+const Function kKhrGetPhysicalDeviceProperties2Functions[] = {
+    INSTANCE_FUNCTION(vkGetPhysicalDeviceFeatures2KHR),
+    INSTANCE_FUNCTION(vkGetPhysicalDeviceProperties2KHR),
+    INSTANCE_FUNCTION(vkGetPhysicalDeviceFormatProperties2KHR),
+    INSTANCE_FUNCTION(vkGetPhysicalDeviceImageFormatProperties2KHR),
+    INSTANCE_FUNCTION(vkGetPhysicalDeviceQueueFamilyProperties2KHR),
+    INSTANCE_FUNCTION(vkGetPhysicalDeviceMemoryProperties2KHR),
+    INSTANCE_FUNCTION(vkGetPhysicalDeviceSparseImageFormatProperties2KHR),
+};
+
+const Function kKhrDeviceGroupFunctions[] = {
+    DEVICE_FUNCTION(vkGetDeviceGroupPeerMemoryFeaturesKHR),
+    DEVICE_FUNCTION(vkCmdSetDeviceMaskKHR),
+    DEVICE_FUNCTION(vkCmdDispatchBaseKHR),
+};
+
+const Function kKhrMaintenance1Functions[] = {
+    DEVICE_FUNCTION(vkTrimCommandPoolKHR),
+};
+
+const Function kKhrDeviceGroupCreationFunctions[] = {
+    INSTANCE_FUNCTION(vkEnumeratePhysicalDeviceGroupsKHR),
+};
+
+const Function kKhrExternalMemoryCapabilitiesFunctions[] = {
+    INSTANCE_FUNCTION(vkGetPhysicalDeviceExternalBufferPropertiesKHR),
+};
+
+const Function kKhrExternalMemoryFdFunctions[] = {
+    DEVICE_FUNCTION(vkGetMemoryFdKHR),
+    DEVICE_FUNCTION(vkGetMemoryFdPropertiesKHR),
+};
+
+const Function kKhrExternalSemaphoreCapabilitiesFunctions[] = {
+    INSTANCE_FUNCTION(vkGetPhysicalDeviceExternalSemaphorePropertiesKHR),
+};
+
+const Function kKhrExternalSemaphoreFdFunctions[] = {
+    DEVICE_FUNCTION(vkImportSemaphoreFdKHR),
+    DEVICE_FUNCTION(vkGetSemaphoreFdKHR),
+};
+
+const Function kKhrPushDescriptorFunctions[] = {
+    DEVICE_FUNCTION(vkCmdPushDescriptorSetKHR),
+    DEVICE_FUNCTION(vkCmdPushDescriptorSetWithTemplateKHR),
+};
+
+const Function kKhrDescriptorUpdateTemplateFunctions[] = {
+    DEVICE_FUNCTION(vkCreateDescriptorUpdateTemplateKHR),
+    DEVICE_FUNCTION(vkDestroyDescriptorUpdateTemplateKHR),
+    DEVICE_FUNCTION(vkUpdateDescriptorSetWithTemplateKHR),
+};
+
+const Function kKhrCreateRenderpass2Functions[] = {
+    DEVICE_FUNCTION(vkCreateRenderPass2KHR),
+    DEVICE_FUNCTION(vkCmdBeginRenderPass2KHR),
+    DEVICE_FUNCTION(vkCmdNextSubpass2KHR),
+    DEVICE_FUNCTION(vkCmdEndRenderPass2KHR),
+};
+
+const Function kKhrSharedPresentableImageFunctions[] = {
+    DEVICE_FUNCTION(vkGetSwapchainStatusKHR),
+};
+
+const Function kKhrExternalFenceCapabilitiesFunctions[] = {
+    INSTANCE_FUNCTION(vkGetPhysicalDeviceExternalFencePropertiesKHR),
+};
+
+const Function kKhrExternalFenceFdFunctions[] = {
+    DEVICE_FUNCTION(vkImportFenceFdKHR),
+    DEVICE_FUNCTION(vkGetFenceFdKHR),
+};
+
+const Function kKhrPerformanceQueryFunctions[] = {
+    INSTANCE_FUNCTION(
+        vkEnumeratePhysicalDeviceQueueFamilyPerformanceQueryCountersKHR),
+    INSTANCE_FUNCTION(vkGetPhysicalDeviceQueueFamilyPerformanceQueryPassesKHR),
+    DEVICE_FUNCTION(vkAcquireProfilingLockKHR),
+    DEVICE_FUNCTION(vkReleaseProfilingLockKHR),
+};
+
+const Function kKhrGetSurfaceCapabilities2Functions[] = {
+    INSTANCE_FUNCTION(vkGetPhysicalDeviceSurfaceCapabilities2KHR),
+    INSTANCE_FUNCTION(vkGetPhysicalDeviceSurfaceFormats2KHR),
+};
+
+const Function kKhrGetDisplayProperties2Functions[] = {
+    INSTANCE_FUNCTION(vkGetPhysicalDeviceDisplayProperties2KHR),
+    INSTANCE_FUNCTION(vkGetPhysicalDeviceDisplayPlaneProperties2KHR),
+    INSTANCE_FUNCTION(vkGetDisplayModeProperties2KHR),
+    INSTANCE_FUNCTION(vkGetDisplayPlaneCapabilities2KHR),
+};
+
+const Function kKhrGetMemoryRequirements2Functions[] = {
+    DEVICE_FUNCTION(vkGetImageMemoryRequirements2KHR),
+    DEVICE_FUNCTION(vkGetBufferMemoryRequirements2KHR),
+    DEVICE_FUNCTION(vkGetImageSparseMemoryRequirements2KHR),
+};
+
+const Function kKhrSamplerYcbcrConversionFunctions[] = {
+    DEVICE_FUNCTION(vkCreateSamplerYcbcrConversionKHR),
+    DEVICE_FUNCTION(vkDestroySamplerYcbcrConversionKHR),
+};
+
+const Function kKhrBindMemory2Functions[] = {
+    DEVICE_FUNCTION(vkBindBufferMemory2KHR),
+    DEVICE_FUNCTION(vkBindImageMemory2KHR),
+};
+
+const Function kKhrMaintenance3Functions[] = {
+    DEVICE_FUNCTION(vkGetDescriptorSetLayoutSupportKHR),
+};
+
+const Function kKhrDrawIndirectCountFunctions[] = {
+    DEVICE_FUNCTION(vkCmdDrawIndirectCountKHR),
+    DEVICE_FUNCTION(vkCmdDrawIndexedIndirectCountKHR),
+};
+
+const Function kKhrTimelineSemaphoreFunctions[] = {
+    DEVICE_FUNCTION(vkGetSemaphoreCounterValueKHR),
+    DEVICE_FUNCTION(vkWaitSemaphoresKHR),
+    DEVICE_FUNCTION(vkSignalSemaphoreKHR),
+};
+
+const Function kKhrFragmentShadingRateFunctions[] = {
+    INSTANCE_FUNCTION(vkGetPhysicalDeviceFragmentShadingRatesKHR),
+    DEVICE_FUNCTION(vkCmdSetFragmentShadingRateKHR),
+};
 
-  // Vulkan supported, set function addresses
-  LoadCommonFunctions0(libvulkan);
-  LoadCommonFunctions1(libvulkan);
+const Function kKhrPresentWaitFunctions[] = {
+    DEVICE_FUNCTION(vkWaitForPresentKHR),
+};
+
+const Function kKhrBufferDeviceAddressFunctions[] = {
+    DEVICE_FUNCTION(vkGetBufferDeviceAddressKHR),
+    DEVICE_FUNCTION(vkGetBufferOpaqueCaptureAddressKHR),
+    DEVICE_FUNCTION(vkGetDeviceMemoryOpaqueCaptureAddressKHR),
+};
+
+const Function kKhrDeferredHostOperationsFunctions[] = {
+    DEVICE_FUNCTION(vkCreateDeferredOperationKHR),
+    DEVICE_FUNCTION(vkDestroyDeferredOperationKHR),
+    DEVICE_FUNCTION(vkGetDeferredOperationMaxConcurrencyKHR),
+    DEVICE_FUNCTION(vkGetDeferredOperationResultKHR),
+    DEVICE_FUNCTION(vkDeferredOperationJoinKHR),
+};
+
+const Function kKhrPipelineExecutablePropertiesFunctions[] = {
+    DEVICE_FUNCTION(vkGetPipelineExecutablePropertiesKHR),
+    DEVICE_FUNCTION(vkGetPipelineExecutableStatisticsKHR),
+    DEVICE_FUNCTION(vkGetPipelineExecutableInternalRepresentationsKHR),
+};
+
+const Function kKhrSynchronization2Functions[] = {
+    DEVICE_FUNCTION(vkCmdSetEvent2KHR),
+    DEVICE_FUNCTION(vkCmdResetEvent2KHR),
+    DEVICE_FUNCTION(vkCmdWaitEvents2KHR),
+    DEVICE_FUNCTION(vkCmdPipelineBarrier2KHR),
+    DEVICE_FUNCTION(vkCmdWriteTimestamp2KHR),
+    DEVICE_FUNCTION(vkQueueSubmit2KHR),
+    DEVICE_FUNCTION(vkCmdWriteBufferMarker2AMD),
+    DEVICE_FUNCTION(vkGetQueueCheckpointData2NV),
+};
+
+const Function kKhrCopyCommands2Functions[] = {
+    DEVICE_FUNCTION(vkCmdCopyBuffer2KHR),
+    DEVICE_FUNCTION(vkCmdCopyImage2KHR),
+    DEVICE_FUNCTION(vkCmdCopyBufferToImage2KHR),
+    DEVICE_FUNCTION(vkCmdCopyImageToBuffer2KHR),
+    DEVICE_FUNCTION(vkCmdBlitImage2KHR),
+    DEVICE_FUNCTION(vkCmdResolveImage2KHR),
+};
+
+const Function kKhrMaintenance4Functions[] = {
+    DEVICE_FUNCTION(vkGetDeviceBufferMemoryRequirementsKHR),
+    DEVICE_FUNCTION(vkGetDeviceImageMemoryRequirementsKHR),
+    DEVICE_FUNCTION(vkGetDeviceImageSparseMemoryRequirementsKHR),
+};
+
+const Function kKhrAccelerationStructureFunctions[] = {
+    DEVICE_FUNCTION(vkCreateAccelerationStructureKHR),
+    DEVICE_FUNCTION(vkDestroyAccelerationStructureKHR),
+    DEVICE_FUNCTION(vkCmdBuildAccelerationStructuresKHR),
+    DEVICE_FUNCTION(vkCmdBuildAccelerationStructuresIndirectKHR),
+    DEVICE_FUNCTION(vkBuildAccelerationStructuresKHR),
+    DEVICE_FUNCTION(vkCopyAccelerationStructureKHR),
+    DEVICE_FUNCTION(vkCopyAccelerationStructureToMemoryKHR),
+    DEVICE_FUNCTION(vkCopyMemoryToAccelerationStructureKHR),
+    DEVICE_FUNCTION(vkWriteAccelerationStructuresPropertiesKHR),
+    DEVICE_FUNCTION(vkCmdCopyAccelerationStructureKHR),
+    DEVICE_FUNCTION(vkCmdCopyAccelerationStructureToMemoryKHR),
+    DEVICE_FUNCTION(vkCmdCopyMemoryToAccelerationStructureKHR),
+    DEVICE_FUNCTION(vkGetAccelerationStructureDeviceAddressKHR),
+    DEVICE_FUNCTION(vkCmdWriteAccelerationStructuresPropertiesKHR),
+    DEVICE_FUNCTION(vkGetDeviceAccelerationStructureCompatibilityKHR),
+    DEVICE_FUNCTION(vkGetAccelerationStructureBuildSizesKHR),
+};
+
+const Function kKhrRayTracingPipelineFunctions[] = {
+    DEVICE_FUNCTION(vkCmdTraceRaysKHR),
+    DEVICE_FUNCTION(vkCreateRayTracingPipelinesKHR),
+    DEVICE_FUNCTION(vkGetRayTracingCaptureReplayShaderGroupHandlesKHR),
+    DEVICE_FUNCTION(vkCmdTraceRaysIndirectKHR),
+    DEVICE_FUNCTION(vkGetRayTracingShaderGroupStackSizeKHR),
+    DEVICE_FUNCTION(vkCmdSetRayTracingPipelineStackSizeKHR),
+};
 
 #ifdef VK_USE_PLATFORM_ANDROID_KHR
-  vkCreateAndroidSurfaceKHR = reinterpret_cast<PFN_vkCreateAndroidSurfaceKHR>(
-      dlsym(libvulkan, "vkCreateAndroidSurfaceKHR"));
-  vkGetAndroidHardwareBufferPropertiesANDROID =
-      reinterpret_cast<PFN_vkGetAndroidHardwareBufferPropertiesANDROID>(
-          dlsym(libvulkan, "vkGetAndroidHardwareBufferPropertiesANDROID"));
-#endif
-
-#ifdef VK_USE_PLATFORM_WAYLAND_KHR
-  vkCreateWaylandSurfaceKHR = reinterpret_cast<PFN_vkCreateWaylandSurfaceKHR>(
-      dlsym(libvulkan, "vkCreateWaylandSurfaceKHR"));
-  vkGetPhysicalDeviceWaylandPresentationSupportKHR =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceWaylandPresentationSupportKHR>(
-          dlsym(libvulkan, "vkGetPhysicalDeviceWaylandPresentationSupportKHR"));
-#endif
-
-#ifdef VK_USE_PLATFORM_WIN32_KHR
-  vkCreateWin32SurfaceKHR = reinterpret_cast<PFN_vkCreateWin32SurfaceKHR>(
-      dlsym(libvulkan, "vkCreateWin32SurfaceKHR"));
-  vkGetPhysicalDeviceWin32PresentationSupportKHR =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceWin32PresentationSupportKHR>(
-          dlsym(libvulkan, "vkGetPhysicalDeviceWin32PresentationSupportKHR"));
-  vkGetMemoryWin32HandleKHR = reinterpret_cast<PFN_vkGetMemoryWin32HandleKHR>(
-      dlsym(libvulkan, "vkGetMemoryWin32HandleKHR"));
-  vkGetMemoryWin32HandlePropertiesKHR =
-      reinterpret_cast<PFN_vkGetMemoryWin32HandlePropertiesKHR>(
-          dlsym(libvulkan, "vkGetMemoryWin32HandlePropertiesKHR"));
-  vkImportSemaphoreWin32HandleKHR =
-      reinterpret_cast<PFN_vkImportSemaphoreWin32HandleKHR>(
-          dlsym(libvulkan, "vkImportSemaphoreWin32HandleKHR"));
-  vkGetSemaphoreWin32HandleKHR =
-      reinterpret_cast<PFN_vkGetSemaphoreWin32HandleKHR>(
-          dlsym(libvulkan, "vkGetSemaphoreWin32HandleKHR"));
-  vkImportFenceWin32HandleKHR =
-      reinterpret_cast<PFN_vkImportFenceWin32HandleKHR>(
-          dlsym(libvulkan, "vkImportFenceWin32HandleKHR"));
-  vkGetFenceWin32HandleKHR = reinterpret_cast<PFN_vkGetFenceWin32HandleKHR>(
-      dlsym(libvulkan, "vkGetFenceWin32HandleKHR"));
-#endif
-
-#ifdef VK_USE_PLATFORM_XCB_KHR
-  vkCreateXcbSurfaceKHR = reinterpret_cast<PFN_vkCreateXcbSurfaceKHR>(
-      dlsym(libvulkan, "vkCreateXcbSurfaceKHR"));
-  vkGetPhysicalDeviceXcbPresentationSupportKHR =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceXcbPresentationSupportKHR>(
-          dlsym(libvulkan, "vkGetPhysicalDeviceXcbPresentationSupportKHR"));
-#endif
-
-#ifdef VK_USE_PLATFORM_XLIB_KHR
-  vkCreateXlibSurfaceKHR = reinterpret_cast<PFN_vkCreateXlibSurfaceKHR>(
-      dlsym(libvulkan, "vkCreateXlibSurfaceKHR"));
-  vkGetPhysicalDeviceXlibPresentationSupportKHR =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceXlibPresentationSupportKHR>(
-          dlsym(libvulkan, "vkGetPhysicalDeviceXlibPresentationSupportKHR"));
-#endif
-
-#ifdef VK_ENABLE_BETA_EXTENSIONS
-  vkGetPhysicalDeviceVideoCapabilitiesKHR =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceVideoCapabilitiesKHR>(
-          dlsym(libvulkan, "vkGetPhysicalDeviceVideoCapabilitiesKHR"));
-  vkGetPhysicalDeviceVideoFormatPropertiesKHR =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceVideoFormatPropertiesKHR>(
-          dlsym(libvulkan, "vkGetPhysicalDeviceVideoFormatPropertiesKHR"));
-  vkCreateVideoSessionKHR = reinterpret_cast<PFN_vkCreateVideoSessionKHR>(
-      dlsym(libvulkan, "vkCreateVideoSessionKHR"));
-  vkDestroyVideoSessionKHR = reinterpret_cast<PFN_vkDestroyVideoSessionKHR>(
-      dlsym(libvulkan, "vkDestroyVideoSessionKHR"));
-  vkGetVideoSessionMemoryRequirementsKHR =
-      reinterpret_cast<PFN_vkGetVideoSessionMemoryRequirementsKHR>(
-          dlsym(libvulkan, "vkGetVideoSessionMemoryRequirementsKHR"));
-  vkBindVideoSessionMemoryKHR =
-      reinterpret_cast<PFN_vkBindVideoSessionMemoryKHR>(
-          dlsym(libvulkan, "vkBindVideoSessionMemoryKHR"));
-  vkCreateVideoSessionParametersKHR =
-      reinterpret_cast<PFN_vkCreateVideoSessionParametersKHR>(
-          dlsym(libvulkan, "vkCreateVideoSessionParametersKHR"));
-  vkUpdateVideoSessionParametersKHR =
-      reinterpret_cast<PFN_vkUpdateVideoSessionParametersKHR>(
-          dlsym(libvulkan, "vkUpdateVideoSessionParametersKHR"));
-  vkDestroyVideoSessionParametersKHR =
-      reinterpret_cast<PFN_vkDestroyVideoSessionParametersKHR>(
-          dlsym(libvulkan, "vkDestroyVideoSessionParametersKHR"));
-  vkCmdBeginVideoCodingKHR = reinterpret_cast<PFN_vkCmdBeginVideoCodingKHR>(
-      dlsym(libvulkan, "vkCmdBeginVideoCodingKHR"));
-  vkCmdEndVideoCodingKHR = reinterpret_cast<PFN_vkCmdEndVideoCodingKHR>(
-      dlsym(libvulkan, "vkCmdEndVideoCodingKHR"));
-  vkCmdControlVideoCodingKHR = reinterpret_cast<PFN_vkCmdControlVideoCodingKHR>(
-      dlsym(libvulkan, "vkCmdControlVideoCodingKHR"));
-#endif
-
-#ifdef VK_ENABLE_BETA_EXTENSIONS
-  vkCmdDecodeVideoKHR = reinterpret_cast<PFN_vkCmdDecodeVideoKHR>(
-      dlsym(libvulkan, "vkCmdDecodeVideoKHR"));
-  vkCmdEncodeVideoKHR = reinterpret_cast<PFN_vkCmdEncodeVideoKHR>(
-      dlsym(libvulkan, "vkCmdEncodeVideoKHR"));
-#endif
+const Function kKhrAndroidSurfaceFunctions[] = {
+    INSTANCE_FUNCTION(vkCreateAndroidSurfaceKHR),
+};
+#endif  // VK_USE_PLATFORM_ANDROID_KHR
 
-  vkGetInstanceProcAddr = reinterpret_cast<PFN_vkGetInstanceProcAddr>(
-      dlsym(libvulkan, "vkGetInstanceProcAddr"));
+#ifdef VK_USE_PLATFORM_ANDROID_KHR
+const Function kAndroidExternalMemoryAndroidHardwareBufferFunctions[] = {
+    DEVICE_FUNCTION(vkGetAndroidHardwareBufferPropertiesANDROID),
+    DEVICE_FUNCTION(vkGetMemoryAndroidHardwareBufferANDROID),
+};
+#endif  // VK_USE_PLATFORM_ANDROID_KHR
+
+const Function kExtDebugUtilsFunctions[] = {
+    INSTANCE_FUNCTION(vkCreateDebugUtilsMessengerEXT),
+    INSTANCE_FUNCTION(vkDestroyDebugUtilsMessengerEXT),
+};
+
+#undef GLOBAL_FUNCTION
+#undef INSTANCE_FUNCTION
+#undef DEVICE_FUNCTION
+
+// The functions a core version or an extension adds.
+struct Feature {
+  // nullptr for a core version.
+  const char* extension;
+  // The core version, or 0 for an extension.
+  uint32_t version;
+  const Function* functions;
+  size_t function_count;
+};
+
+template <size_t N>
+constexpr size_t CountOf(const Function (&)[N]) {
+  return N;
+}
+
+#define CORE_FEATURE(minor, functions) \
+  { nullptr, VK_MAKE_VERSION(1, minor, 0), functions, CountOf(functions) }
+#define EXTENSION_FEATURE(extension, functions) \
+  { extension, 0, functions, CountOf(functions) }
+
+const Feature kFeatures[] = {
+    CORE_FEATURE(0, kCore0Functions),
+    CORE_FEATURE(1, kCore1Functions),
+    CORE_FEATURE(2, kCore2Functions),
+    CORE_FEATURE(3, kCore3Functions),
+    EXTENSION_FEATURE("VK_KHR_surface", kKhrSurfaceFunctions),
+    EXTENSION_FEATURE("VK_KHR_swapchain", kKhrSwapchainFunctions),
+    EXTENSION_FEATURE("VK_KHR_display", kKhrDisplayFunctions),
+    EXTENSION_FEATURE("VK_KHR_display_swapchain",
+                      kKhrDisplaySwapchainFunctions),
+    EXTENSION_FEATURE("VK_KHR_dynamic_rendering",
+                      kKhrDynamicRenderingFunctions),
+    EXTENSION_FEATURE("VK_KHR_get_physical_device_properties2",
+                      kKhrGetPhysicalDeviceProperties2Functions),
+    EXTENSION_FEATURE("VK_KHR_device_group", kKhrDeviceGroupFunctions),
+    EXTENSION_FEATURE("VK_KHR_maintenance1", kKhrMaintenance1Functions),
+    EXTENSION_FEATURE("VK_KHR_device_group_creation",
+                      kKhrDeviceGroupCreationFunctions),
+    EXTENSION_FEATURE("VK_KHR_external_memory_capabilities",
+                      kKhrExternalMemoryCapabilitiesFunctions),
+    EXTENSION_FEATURE("VK_KHR_external_memory_fd",
+                      kKhrExternalMemoryFdFunctions),
+    EXTENSION_FEATURE("VK_KHR_external_semaphore_capabilities",
+                      kKhrExternalSemaphoreCapabilitiesFunctions),
+    EXTENSION_FEATURE("VK_KHR_external_semaphore_fd",
+                      kKhrExternalSemaphoreFdFunctions),
+    EXTENSION_FEATURE("VK_KHR_push_descriptor", kKhrPushDescriptorFunctions),
+    EXTENSION_FEATURE("VK_KHR_descriptor_update_template",
+                      kKhrDescriptorUpdateTemplateFunctions),
+    EXTENSION_FEATURE("VK_KHR_create_renderpass2",
+                      kKhrCreateRenderpass2Functions),
+    EXTENSION_FEATURE("VK_KHR_shared_presentable_image",
+                      kKhrSharedPresentableImageFunctions),
+    EXTENSION_FEATURE("VK_KHR_external_fence_capabilities",
+                      kKhrExternalFenceCapabilitiesFunctions),
+    EXTENSION_FEATURE("VK_KHR_external_fence_fd", kKhrExternalFenceFdFunctions),
+    EXTENSION_FEATURE("VK_KHR_performance_query",
+                      kKhrPerformanceQueryFunctions),
+    EXTENSION_FEATURE("VK_KHR_get_surface_capabilities2",
+                      kKhrGetSurfaceCapabilities2Functions),
+    EXTENSION_FEATURE("VK_KHR_get_display_properties2",
+                      kKhrGetDisplayProperties2Functions),
+    EXTENSION_FEATURE("VK_KHR_get_memory_requirements2",
+                      kKhrGetMemoryRequirements2Functions),
+    EXTENSION_FEATURE("VK_KHR_sampler_ycbcr_conversion",
+                      kKhrSamplerYcbcrConversionFunctions),
+    EXTENSION_FEATURE("VK_KHR_bind_memory2", kKhrBindMemory2Functions),
+    EXTENSION_FEATURE("VK_KHR_maintenance3", kKhrMaintenance3Functions),
+    EXTENSION_FEATURE("VK_KHR_draw_indirect_count",
+                      kKhrDrawIndirectCountFunctions),
+    EXTENSION_FEATURE("VK_KHR_timeline_semaphore",
+                      kKhrTimelineSemaphoreFunctions),
+    EXTENSION_FEATURE("VK_KHR_fragment_shading_rate",
+                      kKhrFragmentShadingRateFunctions),
+    EXTENSION_FEATURE("VK_KHR_present_wait", kKhrPresentWaitFunctions),
+    EXTENSION_FEATURE("VK_KHR_buffer_device_address",
+                      kKhrBufferDeviceAddressFunctions),
+    EXTENSION_FEATURE("VK_KHR_deferred_host_operations",
+                      kKhrDeferredHostOperationsFunctions),
+    EXTENSION_FEATURE("VK_KHR_pipeline_executable_properties",
+                      kKhrPipelineExecutablePropertiesFunctions),
+    EXTENSION_FEATURE("VK_KHR_synchronization2", kKhrSynchronization2Functions),
+    EXTENSION_FEATURE("VK_KHR_copy_commands2", kKhrCopyCommands2Functions),
+    EXTENSION_FEATURE("VK_KHR_maintenance4", kKhrMaintenance4Functions),
+    EXTENSION_FEATURE("VK_KHR_acceleration_structure",
+                      kKhrAccelerationStructureFunctions),
+    EXTENSION_FEATURE("VK_KHR_ray_tracing_pipeline",
+                      kKhrRayTracingPipelineFunctions),
+#ifdef VK_USE_PLATFORM_ANDROID_KHR
+    EXTENSION_FEATURE("VK_KHR_android_surface", kKhrAndroidSurfaceFunctions),
+    EXTENSION_FEATURE("VK_ANDROID_external_memory_android_hardware_buffer",
+                      kAndroidExternalMemoryAndroidHardwareBufferFunctions),
+#endif  // VK_USE_PLATFORM_ANDROID_KHR
+    EXTENSION_FEATURE("VK_EXT_debug_utils", kExtDebugUtilsFunctions),
+};
+
+#undef CORE_FEATURE
+#undef EXTENSION_FEATURE
 
-  return true;
+bool IsEnabled(const Feature& feature, uint32_t api_version,
+               uint32_t extension_count, const char* const* extensions) {
+  if (feature.extension == nullptr) {
+    return api_version >= feature.version;
+  }
+  for (uint32_t i = 0; i < extension_count; ++i) {
+    if (strcmp(extensions[i], feature.extension) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Sets the functions of |level| of every enabled feature to what |resolve|
+// returns for their name.
+template <typename Resolve>
+void ResolveFunctions(Level level, uint32_t api_version,
+                      uint32_t extension_count, const char* const* extensions,
+                      Resolve resolve) {
+  for (const Feature& feature : kFeatures) {
+    if (!IsEnabled(feature, api_version, extension_count, extensions)) {
+      continue;
+    }
+    for (size_t i = 0; i < feature.function_count; ++i) {
+      const Function& function = feature.functions[i];
+      if (function.level == level) {
+        *function.pointer = resolve(function.name);
+      }
+    }
+  }
 }
+}  // namespace
 
-void LoadCommonFunctions0(void* libvulkan) {
-  vkCreateInstance = reinterpret_cast<PFN_vkCreateInstance>(
-      dlsym(libvulkan, "vkCreateInstance"));
-  vkDestroyInstance = reinterpret_cast<PFN_vkDestroyInstance>(
-      dlsym(libvulkan, "vkDestroyInstance"));
-  vkEnumeratePhysicalDevices = reinterpret_cast<PFN_vkEnumeratePhysicalDevices>(
-      dlsym(libvulkan, "vkEnumeratePhysicalDevices"));
-  vkGetPhysicalDeviceFeatures =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures>(
-          dlsym(libvulkan, "vkGetPhysicalDeviceFeatures"));
-  vkGetPhysicalDeviceFormatProperties =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceFormatProperties>(
-          dlsym(libvulkan, "vkGetPhysicalDeviceFormatProperties"));
-  vkGetPhysicalDeviceImageFormatProperties =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceImageFormatProperties>(
-          dlsym(libvulkan, "vkGetPhysicalDeviceImageFormatProperties"));
-  vkGetPhysicalDeviceProperties =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceProperties>(
-          dlsym(libvulkan, "vkGetPhysicalDeviceProperties"));
-  vkGetPhysicalDeviceQueueFamilyProperties =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceQueueFamilyProperties>(
-          dlsym(libvulkan, "vkGetPhysicalDeviceQueueFamilyProperties"));
-  vkGetPhysicalDeviceMemoryProperties =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties>(
-          dlsym(libvulkan, "vkGetPhysicalDeviceMemoryProperties"));
+bool LoadVulkan() {
+  static void* libvulkan = dlopen("libvulkan.so", RTLD_NOW | RTLD_LOCAL);
+  if (!libvulkan) {
+    return false;
+  }
   vkGetInstanceProcAddr = reinterpret_cast<PFN_vkGetInstanceProcAddr>(
       dlsym(libvulkan, "vkGetInstanceProcAddr"));
-  vkGetDeviceProcAddr = reinterpret_cast<PFN_vkGetDeviceProcAddr>(
-      dlsym(libvulkan, "vkGetDeviceProcAddr"));
-  vkCreateDevice =
-      reinterpret_cast<PFN_vkCreateDevice>(dlsym(libvulkan, "vkCreateDevice"));
-  vkDestroyDevice = reinterpret_cast<PFN_vkDestroyDevice>(
-      dlsym(libvulkan, "vkDestroyDevice"));
-  vkEnumerateInstanceExtensionProperties =
-      reinterpret_cast<PFN_vkEnumerateInstanceExtensionProperties>(
-          dlsym(libvulkan, "vkEnumerateInstanceExtensionProperties"));
-  vkEnumerateDeviceExtensionProperties =
-      reinterpret_cast<PFN_vkEnumerateDeviceExtensionProperties>(
-          dlsym(libvulkan, "vkEnumerateDeviceExtensionProperties"));
-  vkEnumerateInstanceLayerProperties =
-      reinterpret_cast<PFN_vkEnumerateInstanceLayerProperties>(
-          dlsym(libvulkan, "vkEnumerateInstanceLayerProperties"));
-  vkEnumerateDeviceLayerProperties =
-      reinterpret_cast<PFN_vkEnumerateDeviceLayerProperties>(
-          dlsym(libvulkan, "vkEnumerateDeviceLayerProperties"));
-  vkGetDeviceQueue = reinterpret_cast<PFN_vkGetDeviceQueue>(
-      dlsym(libvulkan, "vkGetDeviceQueue"));
-  vkQueueSubmit =
-      reinterpret_cast<PFN_vkQueueSubmit>(dlsym(libvulkan, "vkQueueSubmit"));
-  vkQueueWaitIdle = reinterpret_cast<PFN_vkQueueWaitIdle>(
-      dlsym(libvulkan, "vkQueueWaitIdle"));
-  vkDeviceWaitIdle = reinterpret_cast<PFN_vkDeviceWaitIdle>(
-      dlsym(libvulkan, "vkDeviceWaitIdle"));
-  vkAllocateMemory = reinterpret_cast<PFN_vkAllocateMemory>(
-      dlsym(libvulkan, "vkAllocateMemory"));
-  vkFreeMemory =
-      reinterpret_cast<PFN_vkFreeMemory>(dlsym(libvulkan, "vkFreeMemory"));
-  vkMapMemory =
-      reinterpret_cast<PFN_vkMapMemory>(dlsym(libvulkan, "vkMapMemory"));
-  vkUnmapMemory =
-      reinterpret_cast<PFN_vkUnmapMemory>(dlsym(libvulkan, "vkUnmapMemory"));
-  vkFlushMappedMemoryRanges = reinterpret_cast<PFN_vkFlushMappedMemoryRanges>(
-      dlsym(libvulkan, "vkFlushMappedMemoryRanges"));
-  vkInvalidateMappedMemoryRanges =
-      reinterpret_cast<PFN_vkInvalidateMappedMemoryRanges>(
-          dlsym(libvulkan, "vkInvalidateMappedMemoryRanges"));
-  vkGetDeviceMemoryCommitment =
-      reinterpret_cast<PFN_vkGetDeviceMemoryCommitment>(
-          dlsym(libvulkan, "vkGetDeviceMemoryCommitment"));
-  vkBindBufferMemory = reinterpret_cast<PFN_vkBindBufferMemory>(
-      dlsym(libvulkan, "vkBindBufferMemory"));
-  vkBindImageMemory = reinterpret_cast<PFN_vkBindImageMemory>(
-      dlsym(libvulkan, "vkBindImageMemory"));
-  vkGetBufferMemoryRequirements =
-      reinterpret_cast<PFN_vkGetBufferMemoryRequirements>(
-          dlsym(libvulkan, "vkGetBufferMemoryRequirements"));
-  vkGetImageMemoryRequirements =
-      reinterpret_cast<PFN_vkGetImageMemoryRequirements>(
-          dlsym(libvulkan, "vkGetImageMemoryRequirements"));
-  vkGetImageSparseMemoryRequirements =
-      reinterpret_cast<PFN_vkGetImageSparseMemoryRequirements>(
-          dlsym(libvulkan, "vkGetImageSparseMemoryRequirements"));
-  vkGetPhysicalDeviceSparseImageFormatProperties =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceSparseImageFormatProperties>(
-          dlsym(libvulkan, "vkGetPhysicalDeviceSparseImageFormatProperties"));
-  vkQueueBindSparse = reinterpret_cast<PFN_vkQueueBindSparse>(
-      dlsym(libvulkan, "vkQueueBindSparse"));
-  vkCreateFence =
-      reinterpret_cast<PFN_vkCreateFence>(dlsym(libvulkan, "vkCreateFence"));
-  vkDestroyFence =
-      reinterpret_cast<PFN_vkDestroyFence>(dlsym(libvulkan, "vkDestroyFence"));
-  vkResetFences =
-      reinterpret_cast<PFN_vkResetFences>(dlsym(libvulkan, "vkResetFences"));
-  vkGetFenceStatus = reinterpret_cast<PFN_vkGetFenceStatus>(
-      dlsym(libvulkan, "vkGetFenceStatus"));
-  vkWaitForFences = reinterpret_cast<PFN_vkWaitForFences>(
-      dlsym(libvulkan, "vkWaitForFences"));
-  vkCreateSemaphore = reinterpret_cast<PFN_vkCreateSemaphore>(
-      dlsym(libvulkan, "vkCreateSemaphore"));
-  vkDestroySemaphore = reinterpret_cast<PFN_vkDestroySemaphore>(
-      dlsym(libvulkan, "vkDestroySemaphore"));
-  vkCreateEvent =
-      reinterpret_cast<PFN_vkCreateEvent>(dlsym(libvulkan, "vkCreateEvent"));
-  vkDestroyEvent =
-      reinterpret_cast<PFN_vkDestroyEvent>(dlsym(libvulkan, "vkDestroyEvent"));
-  vkGetEventStatus = reinterpret_cast<PFN_vkGetEventStatus>(
-      dlsym(libvulkan, "vkGetEventStatus"));
-  vkSetEvent = reinterpret_cast<PFN_vkSetEvent>(dlsym(libvulkan, "vkSetEvent"));
-  vkResetEvent =
-      reinterpret_cast<PFN_vkResetEvent>(dlsym(libvulkan, "vkResetEvent"));
-  vkCreateQueryPool = reinterpret_cast<PFN_vkCreateQueryPool>(
-      dlsym(libvulkan, "vkCreateQueryPool"));
-  vkDestroyQueryPool = reinterpret_cast<PFN_vkDestroyQueryPool>(
-      dlsym(libvulkan, "vkDestroyQueryPool"));
-  vkGetQueryPoolResults = reinterpret_cast<PFN_vkGetQueryPoolResults>(
-      dlsym(libvulkan, "vkGetQueryPoolResults"));
-  vkCreateBuffer =
-      reinterpret_cast<PFN_vkCreateBuffer>(dlsym(libvulkan, "vkCreateBuffer"));
-  vkDestroyBuffer = reinterpret_cast<PFN_vkDestroyBuffer>(
-      dlsym(libvulkan, "vkDestroyBuffer"));
-  vkCreateBufferView = reinterpret_cast<PFN_vkCreateBufferView>(
-      dlsym(libvulkan, "vkCreateBufferView"));
-  vkDestroyBufferView = reinterpret_cast<PFN_vkDestroyBufferView>(
-      dlsym(libvulkan, "vkDestroyBufferView"));
-  vkCreateImage =
-      reinterpret_cast<PFN_vkCreateImage>(dlsym(libvulkan, "vkCreateImage"));
-  vkDestroyImage =
-      reinterpret_cast<PFN_vkDestroyImage>(dlsym(libvulkan, "vkDestroyImage"));
-  vkGetImageSubresourceLayout =
-      reinterpret_cast<PFN_vkGetImageSubresourceLayout>(
-          dlsym(libvulkan, "vkGetImageSubresourceLayout"));
-  vkCreateImageView = reinterpret_cast<PFN_vkCreateImageView>(
-      dlsym(libvulkan, "vkCreateImageView"));
-  vkDestroyImageView = reinterpret_cast<PFN_vkDestroyImageView>(
-      dlsym(libvulkan, "vkDestroyImageView"));
-  vkCreateShaderModule = reinterpret_cast<PFN_vkCreateShaderModule>(
-      dlsym(libvulkan, "vkCreateShaderModule"));
-  vkDestroyShaderModule = reinterpret_cast<PFN_vkDestroyShaderModule>(
-      dlsym(libvulkan, "vkDestroyShaderModule"));
-  vkCreatePipelineCache = reinterpret_cast<PFN_vkCreatePipelineCache>(
-      dlsym(libvulkan, "vkCreatePipelineCache"));
-  vkDestroyPipelineCache = reinterpret_cast<PFN_vkDestroyPipelineCache>(
-      dlsym(libvulkan, "vkDestroyPipelineCache"));
-  vkGetPipelineCacheData = reinterpret_cast<PFN_vkGetPipelineCacheData>(
-      dlsym(libvulkan, "vkGetPipelineCacheData"));
-  vkMergePipelineCaches = reinterpret_cast<PFN_vkMergePipelineCaches>(
-      dlsym(libvulkan, "vkMergePipelineCaches"));
-  vkCreateGraphicsPipelines = reinterpret_cast<PFN_vkCreateGraphicsPipelines>(
-      dlsym(libvulkan, "vkCreateGraphicsPipelines"));
-  vkCreateComputePipelines = reinterpret_cast<PFN_vkCreateComputePipelines>(
-      dlsym(libvulkan, "vkCreateComputePipelines"));
-  vkDestroyPipeline = reinterpret_cast<PFN_vkDestroyPipeline>(
-      dlsym(libvulkan, "vkDestroyPipeline"));
-  vkCreatePipelineLayout = reinterpret_cast<PFN_vkCreatePipelineLayout>(
-      dlsym(libvulkan, "vkCreatePipelineLayout"));
-  vkDestroyPipelineLayout = reinterpret_cast<PFN_vkDestroyPipelineLayout>(
-      dlsym(libvulkan, "vkDestroyPipelineLayout"));
-  vkCreateSampler = reinterpret_cast<PFN_vkCreateSampler>(
-      dlsym(libvulkan, "vkCreateSampler"));
-  vkDestroySampler = reinterpret_cast<PFN_vkDestroySampler>(
-      dlsym(libvulkan, "vkDestroySampler"));
-  vkCreateDescriptorSetLayout =
-      reinterpret_cast<PFN_vkCreateDescriptorSetLayout>(
-          dlsym(libvulkan, "vkCreateDescriptorSetLayout"));
-  vkDestroyDescriptorSetLayout =
-      reinterpret_cast<PFN_vkDestroyDescriptorSetLayout>(
-          dlsym(libvulkan, "vkDestroyDescriptorSetLayout"));
-  vkCreateDescriptorPool = reinterpret_cast<PFN_vkCreateDescriptorPool>(
-      dlsym(libvulkan, "vkCreateDescriptorPool"));
-  vkDestroyDescriptorPool = reinterpret_cast<PFN_vkDestroyDescriptorPool>(
-      dlsym(libvulkan, "vkDestroyDescriptorPool"));
-  vkResetDescriptorPool = reinterpret_cast<PFN_vkResetDescriptorPool>(
-      dlsym(libvulkan, "vkResetDescriptorPool"));
-  vkAllocateDescriptorSets = reinterpret_cast<PFN_vkAllocateDescriptorSets>(
-      dlsym(libvulkan, "vkAllocateDescriptorSets"));
-  vkFreeDescriptorSets = reinterpret_cast<PFN_vkFreeDescriptorSets>(
-      dlsym(libvulkan, "vkFreeDescriptorSets"));
-  vkUpdateDescriptorSets = reinterpret_cast<PFN_vkUpdateDescriptorSets>(
-      dlsym(libvulkan, "vkUpdateDescriptorSets"));
-  vkCreateFramebuffer = reinterpret_cast<PFN_vkCreateFramebuffer>(
-      dlsym(libvulkan, "vkCreateFramebuffer"));
-  vkDestroyFramebuffer = reinterpret_cast<PFN_vkDestroyFramebuffer>(
-      dlsym(libvulkan, "vkDestroyFramebuffer"));
-  vkCreateRenderPass = reinterpret_cast<PFN_vkCreateRenderPass>(
-      dlsym(libvulkan, "vkCreateRenderPass"));
-  vkDestroyRenderPass = reinterpret_cast<PFN_vkDestroyRenderPass>(
-      dlsym(libvulkan, "vkDestroyRenderPass"));
-  vkGetRenderAreaGranularity = reinterpret_cast<PFN_vkGetRenderAreaGranularity>(
-      dlsym(libvulkan, "vkGetRenderAreaGranularity"));
-  vkCreateCommandPool = reinterpret_cast<PFN_vkCreateCommandPool>(
-      dlsym(libvulkan, "vkCreateCommandPool"));
-  vkDestroyCommandPool = reinterpret_cast<PFN_vkDestroyCommandPool>(
-      dlsym(libvulkan, "vkDestroyCommandPool"));
-  vkResetCommandPool = reinterpret_cast<PFN_vkResetCommandPool>(
-      dlsym(libvulkan, "vkResetCommandPool"));
-  vkAllocateCommandBuffers = reinterpret_cast<PFN_vkAllocateCommandBuffers>(
-      dlsym(libvulkan, "vkAllocateCommandBuffers"));
-  vkFreeCommandBuffers = reinterpret_cast<PFN_vkFreeCommandBuffers>(
-      dlsym(libvulkan, "vkFreeCommandBuffers"));
-  vkBeginCommandBuffer = reinterpret_cast<PFN_vkBeginCommandBuffer>(
-      dlsym(libvulkan, "vkBeginCommandBuffer"));
-  vkEndCommandBuffer = reinterpret_cast<PFN_vkEndCommandBuffer>(
-      dlsym(libvulkan, "vkEndCommandBuffer"));
-  vkResetCommandBuffer = reinterpret_cast<PFN_vkResetCommandBuffer>(
-      dlsym(libvulkan, "vkResetCommandBuffer"));
-  vkCmdBindPipeline = reinterpret_cast<PFN_vkCmdBindPipeline>(
-      dlsym(libvulkan, "vkCmdBindPipeline"));
-  vkCmdSetViewport = reinterpret_cast<PFN_vkCmdSetViewport>(
-      dlsym(libvulkan, "vkCmdSetViewport"));
-  vkCmdSetScissor = reinterpret_cast<PFN_vkCmdSetScissor>(
-      dlsym(libvulkan, "vkCmdSetScissor"));
-  vkCmdSetLineWidth = reinterpret_cast<PFN_vkCmdSetLineWidth>(
-      dlsym(libvulkan, "vkCmdSetLineWidth"));
-  vkCmdSetDepthBias = reinterpret_cast<PFN_vkCmdSetDepthBias>(
-      dlsym(libvulkan, "vkCmdSetDepthBias"));
-  vkCmdSetBlendConstants = reinterpret_cast<PFN_vkCmdSetBlendConstants>(
-      dlsym(libvulkan, "vkCmdSetBlendConstants"));
-  vkCmdSetDepthBounds = reinterpret_cast<PFN_vkCmdSetDepthBounds>(
-      dlsym(libvulkan, "vkCmdSetDepthBounds"));
-  vkCmdSetStencilCompareMask = reinterpret_cast<PFN_vkCmdSetStencilCompareMask>(
-      dlsym(libvulkan, "vkCmdSetStencilCompareMask"));
-  vkCmdSetStencilWriteMask = reinterpret_cast<PFN_vkCmdSetStencilWriteMask>(
-      dlsym(libvulkan, "vkCmdSetStencilWriteMask"));
-  vkCmdSetStencilReference = reinterpret_cast<PFN_vkCmdSetStencilReference>(
-      dlsym(libvulkan, "vkCmdSetStencilReference"));
-  vkCmdBindDescriptorSets = reinterpret_cast<PFN_vkCmdBindDescriptorSets>(
-      dlsym(libvulkan, "vkCmdBindDescriptorSets"));
-  vkCmdBindIndexBuffer = reinterpret_cast<PFN_vkCmdBindIndexBuffer>(
-      dlsym(libvulkan, "vkCmdBindIndexBuffer"));
-  vkCmdBindVertexBuffers = reinterpret_cast<PFN_vkCmdBindVertexBuffers>(
-      dlsym(libvulkan, "vkCmdBindVertexBuffers"));
-  vkCmdDraw = reinterpret_cast<PFN_vkCmdDraw>(dlsym(libvulkan, "vkCmdDraw"));
-  vkCmdDrawIndexed = reinterpret_cast<PFN_vkCmdDrawIndexed>(
-      dlsym(libvulkan, "vkCmdDrawIndexed"));
-  vkCmdDrawIndirect = reinterpret_cast<PFN_vkCmdDrawIndirect>(
-      dlsym(libvulkan, "vkCmdDrawIndirect"));
-  vkCmdDrawIndexedIndirect = reinterpret_cast<PFN_vkCmdDrawIndexedIndirect>(
-      dlsym(libvulkan, "vkCmdDrawIndexedIndirect"));
-  vkCmdDispatch =
-      reinterpret_cast<PFN_vkCmdDispatch>(dlsym(libvulkan, "vkCmdDispatch"));
-  vkCmdDispatchIndirect = reinterpret_cast<PFN_vkCmdDispatchIndirect>(
-      dlsym(libvulkan, "vkCmdDispatchIndirect"));
-  vkCmdCopyBuffer = reinterpret_cast<PFN_vkCmdCopyBuffer>(
-      dlsym(libvulkan, "vkCmdCopyBuffer"));
-  vkCmdCopyImage =
-      reinterpret_cast<PFN_vkCmdCopyImage>(dlsym(libvulkan, "vkCmdCopyImage"));
-  vkCmdBlitImage =
-      reinterpret_cast<PFN_vkCmdBlitImage>(dlsym(libvulkan, "vkCmdBlitImage"));
-  vkCmdCopyBufferToImage = reinterpret_cast<PFN_vkCmdCopyBufferToImage>(
-      dlsym(libvulkan, "vkCmdCopyBufferToImage"));
-  vkCmdCopyImageToBuffer = reinterpret_cast<PFN_vkCmdCopyImageToBuffer>(
-      dlsym(libvulkan, "vkCmdCopyImageToBuffer"));
-  vkCmdUpdateBuffer = reinterpret_cast<PFN_vkCmdUpdateBuffer>(
-      dlsym(libvulkan, "vkCmdUpdateBuffer"));
-  vkCmdFillBuffer = reinterpret_cast<PFN_vkCmdFillBuffer>(
-      dlsym(libvulkan, "vkCmdFillBuffer"));
-  vkCmdClearColorImage = reinterpret_cast<PFN_vkCmdClearColorImage>(
-      dlsym(libvulkan, "vkCmdClearColorImage"));
-  vkCmdClearDepthStencilImage =
-      reinterpret_cast<PFN_vkCmdClearDepthStencilImage>(
-          dlsym(libvulkan, "vkCmdClearDepthStencilImage"));
-  vkCmdClearAttachments = reinterpret_cast<PFN_vkCmdClearAttachments>(
-      dlsym(libvulkan, "vkCmdClearAttachments"));
-  vkCmdResolveImage = reinterpret_cast<PFN_vkCmdResolveImage>(
-      dlsym(libvulkan, "vkCmdResolveImage"));
-  vkCmdSetEvent =
-      reinterpret_cast<PFN_vkCmdSetEvent>(dlsym(libvulkan, "vkCmdSetEvent"));
-  vkCmdResetEvent = reinterpret_cast<PFN_vkCmdResetEvent>(
-      dlsym(libvulkan, "vkCmdResetEvent"));
-  vkCmdWaitEvents = reinterpret_cast<PFN_vkCmdWaitEvents>(
-      dlsym(libvulkan, "vkCmdWaitEvents"));
-  vkCmdPipelineBarrier = reinterpret_cast<PFN_vkCmdPipelineBarrier>(
-      dlsym(libvulkan, "vkCmdPipelineBarrier"));
-  vkCmdBeginQuery = reinterpret_cast<PFN_vkCmdBeginQuery>(
-      dlsym(libvulkan, "vkCmdBeginQuery"));
-  vkCmdEndQuery =
-      reinterpret_cast<PFN_vkCmdEndQuery>(dlsym(libvulkan, "vkCmdEndQuery"));
-  vkCmdResetQueryPool = reinterpret_cast<PFN_vkCmdResetQueryPool>(
-      dlsym(libvulkan, "vkCmdResetQueryPool"));
-  vkCmdWriteTimestamp = reinterpret_cast<PFN_vkCmdWriteTimestamp>(
-      dlsym(libvulkan, "vkCmdWriteTimestamp"));
-  vkCmdCopyQueryPoolResults = reinterpret_cast<PFN_vkCmdCopyQueryPoolResults>(
-      dlsym(libvulkan, "vkCmdCopyQueryPoolResults"));
-  vkCmdPushConstants = reinterpret_cast<PFN_vkCmdPushConstants>(
-      dlsym(libvulkan, "vkCmdPushConstants"));
-  vkCmdBeginRenderPass = reinterpret_cast<PFN_vkCmdBeginRenderPass>(
-      dlsym(libvulkan, "vkCmdBeginRenderPass"));
-  vkCmdNextSubpass = reinterpret_cast<PFN_vkCmdNextSubpass>(
-      dlsym(libvulkan, "vkCmdNextSubpass"));
-  vkCmdEndRenderPass = reinterpret_cast<PFN_vkCmdEndRenderPass>(
-      dlsym(libvulkan, "vkCmdEndRenderPass"));
-  vkCmdExecuteCommands = reinterpret_cast<PFN_vkCmdExecuteCommands>(
-      dlsym(libvulkan, "vkCmdExecuteCommands"));
-  vkEnumerateInstanceVersion = reinterpret_cast<PFN_vkEnumerateInstanceVersion>(
-      dlsym(libvulkan, "vkEnumerateInstanceVersion"));
-  vkBindBufferMemory2 = reinterpret_cast<PFN_vkBindBufferMemory2>(
-      dlsym(libvulkan, "vkBindBufferMemory2"));
-  vkBindImageMemory2 = reinterpret_cast<PFN_vkBindImageMemory2>(
-      dlsym(libvulkan, "vkBindImageMemory2"));
-  vkGetDeviceGroupPeerMemoryFeatures =
-      reinterpret_cast<PFN_vkGetDeviceGroupPeerMemoryFeatures>(
-          dlsym(libvulkan, "vkGetDeviceGroupPeerMemoryFeatures"));
-  vkCmdSetDeviceMask = reinterpret_cast<PFN_vkCmdSetDeviceMask>(
-      dlsym(libvulkan, "vkCmdSetDeviceMask"));
-  vkCmdDispatchBase = reinterpret_cast<PFN_vkCmdDispatchBase>(
-      dlsym(libvulkan, "vkCmdDispatchBase"));
-  vkEnumeratePhysicalDeviceGroups =
-      reinterpret_cast<PFN_vkEnumeratePhysicalDeviceGroups>(
-          dlsym(libvulkan, "vkEnumeratePhysicalDeviceGroups"));
-  vkGetImageMemoryRequirements2 =
-      reinterpret_cast<PFN_vkGetImageMemoryRequirements2>(
-          dlsym(libvulkan, "vkGetImageMemoryRequirements2"));
-  vkGetBufferMemoryRequirements2 =
-      reinterpret_cast<PFN_vkGetBufferMemoryRequirements2>(
-          dlsym(libvulkan, "vkGetBufferMemoryRequirements2"));
-  vkGetImageSparseMemoryRequirements2 =
-      reinterpret_cast<PFN_vkGetImageSparseMemoryRequirements2>(
-          dlsym(libvulkan, "vkGetImageSparseMemoryRequirements2"));
-  vkGetPhysicalDeviceFeatures2 =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2>(
-          dlsym(libvulkan, "vkGetPhysicalDeviceFeatures2"));
-  vkGetPhysicalDeviceProperties2 =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceProperties2>(
-          dlsym(libvulkan, "vkGetPhysicalDeviceProperties2"));
-  vkGetPhysicalDeviceFormatProperties2 =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceFormatProperties2>(
-          dlsym(libvulkan, "vkGetPhysicalDeviceFormatProperties2"));
-  vkGetPhysicalDeviceImageFormatProperties2 =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceImageFormatProperties2>(
-          dlsym(libvulkan, "vkGetPhysicalDeviceImageFormatProperties2"));
-  vkGetPhysicalDeviceQueueFamilyProperties2 =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceQueueFamilyProperties2>(
-          dlsym(libvulkan, "vkGetPhysicalDeviceQueueFamilyProperties2"));
-  vkGetPhysicalDeviceMemoryProperties2 =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties2>(
-          dlsym(libvulkan, "vkGetPhysicalDeviceMemoryProperties2"));
-  vkGetPhysicalDeviceSparseImageFormatProperties2 =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceSparseImageFormatProperties2>(
-          dlsym(libvulkan, "vkGetPhysicalDeviceSparseImageFormatProperties2"));
-  vkTrimCommandPool = reinterpret_cast<PFN_vkTrimCommandPool>(
-      dlsym(libvulkan, "vkTrimCommandPool"));
-  vkGetDeviceQueue2 = reinterpret_cast<PFN_vkGetDeviceQueue2>(
-      dlsym(libvulkan, "vkGetDeviceQueue2"));
-  vkCreateSamplerYcbcrConversion =
-      reinterpret_cast<PFN_vkCreateSamplerYcbcrConversion>(
-          dlsym(libvulkan, "vkCreateSamplerYcbcrConversion"));
-  vkDestroySamplerYcbcrConversion =
-      reinterpret_cast<PFN_vkDestroySamplerYcbcrConversion>(
-          dlsym(libvulkan, "vkDestroySamplerYcbcrConversion"));
-  vkCreateDescriptorUpdateTemplate =
-      reinterpret_cast<PFN_vkCreateDescriptorUpdateTemplate>(
-          dlsym(libvulkan, "vkCreateDescriptorUpdateTemplate"));
-  vkDestroyDescriptorUpdateTemplate =
-      reinterpret_cast<PFN_vkDestroyDescriptorUpdateTemplate>(
-          dlsym(libvulkan, "vkDestroyDescriptorUpdateTemplate"));
-  vkUpdateDescriptorSetWithTemplate =
-      reinterpret_cast<PFN_vkUpdateDescriptorSetWithTemplate>(
-          dlsym(libvulkan, "vkUpdateDescriptorSetWithTemplate"));
-  vkGetPhysicalDeviceExternalBufferProperties =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceExternalBufferProperties>(
-          dlsym(libvulkan, "vkGetPhysicalDeviceExternalBufferProperties"));
-  vkGetPhysicalDeviceExternalFenceProperties =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceExternalFenceProperties>(
-          dlsym(libvulkan, "vkGetPhysicalDeviceExternalFenceProperties"));
-  vkGetPhysicalDeviceExternalSemaphoreProperties =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceExternalSemaphoreProperties>(
-          dlsym(libvulkan, "vkGetPhysicalDeviceExternalSemaphoreProperties"));
-  vkGetDescriptorSetLayoutSupport =
-      reinterpret_cast<PFN_vkGetDescriptorSetLayoutSupport>(
-          dlsym(libvulkan, "vkGetDescriptorSetLayoutSupport"));
-  vkCmdDrawIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndirectCount>(
-      dlsym(libvulkan, "vkCmdDrawIndirectCount"));
-  vkCmdDrawIndexedIndirectCount =
-      reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCount>(
-          dlsym(libvulkan, "vkCmdDrawIndexedIndirectCount"));
-  vkCreateRenderPass2 = reinterpret_cast<PFN_vkCreateRenderPass2>(
-      dlsym(libvulkan, "vkCreateRenderPass2"));
-  vkCmdBeginRenderPass2 = reinterpret_cast<PFN_vkCmdBeginRenderPass2>(
-      dlsym(libvulkan, "vkCmdBeginRenderPass2"));
-  vkCmdNextSubpass2 = reinterpret_cast<PFN_vkCmdNextSubpass2>(
-      dlsym(libvulkan, "vkCmdNextSubpass2"));
-  vkCmdEndRenderPass2 = reinterpret_cast<PFN_vkCmdEndRenderPass2>(
-      dlsym(libvulkan, "vkCmdEndRenderPass2"));
-  vkResetQueryPool = reinterpret_cast<PFN_vkResetQueryPool>(
-      dlsym(libvulkan, "vkResetQueryPool"));
-  vkGetSemaphoreCounterValue = reinterpret_cast<PFN_vkGetSemaphoreCounterValue>(
-      dlsym(libvulkan, "vkGetSemaphoreCounterValue"));
-  vkWaitSemaphores = reinterpret_cast<PFN_vkWaitSemaphores>(
-      dlsym(libvulkan, "vkWaitSemaphores"));
-  vkSignalSemaphore = reinterpret_cast<PFN_vkSignalSemaphore>(
-      dlsym(libvulkan, "vkSignalSemaphore"));
-  vkGetBufferDeviceAddress = reinterpret_cast<PFN_vkGetBufferDeviceAddress>(
-      dlsym(libvulkan, "vkGetBufferDeviceAddress"));
-  vkGetBufferOpaqueCaptureAddress =
-      reinterpret_cast<PFN_vkGetBufferOpaqueCaptureAddress>(
-          dlsym(libvulkan, "vkGetBufferOpaqueCaptureAddress"));
-  vkGetDeviceMemoryOpaqueCaptureAddress =
-      reinterpret_cast<PFN_vkGetDeviceMemoryOpaqueCaptureAddress>(
-          dlsym(libvulkan, "vkGetDeviceMemoryOpaqueCaptureAddress"));
-  vkGetPhysicalDeviceToolProperties =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceToolProperties>(
-          dlsym(libvulkan, "vkGetPhysicalDeviceToolProperties"));
-  vkCreatePrivateDataSlot = reinterpret_cast<PFN_vkCreatePrivateDataSlot>(
-      dlsym(libvulkan, "vkCreatePrivateDataSlot"));
-  vkDestroyPrivateDataSlot = reinterpret_cast<PFN_vkDestroyPrivateDataSlot>(
-      dlsym(libvulkan, "vkDestroyPrivateDataSlot"));
-  vkSetPrivateData = reinterpret_cast<PFN_vkSetPrivateData>(
-      dlsym(libvulkan, "vkSetPrivateData"));
-  vkGetPrivateData = reinterpret_cast<PFN_vkGetPrivateData>(
-      dlsym(libvulkan, "vkGetPrivateData"));
-  vkCmdSetEvent2 =
-      reinterpret_cast<PFN_vkCmdSetEvent2>(dlsym(libvulkan, "vkCmdSetEvent2"));
-  vkCmdResetEvent2 = reinterpret_cast<PFN_vkCmdResetEvent2>(
-      dlsym(libvulkan, "vkCmdResetEvent2"));
-  vkCmdWaitEvents2 = reinterpret_cast<PFN_vkCmdWaitEvents2>(
-      dlsym(libvulkan, "vkCmdWaitEvents2"));
-  vkCmdPipelineBarrier2 = reinterpret_cast<PFN_vkCmdPipelineBarrier2>(
-      dlsym(libvulkan, "vkCmdPipelineBarrier2"));
-  vkCmdWriteTimestamp2 = reinterpret_cast<PFN_vkCmdWriteTimestamp2>(
-      dlsym(libvulkan, "vkCmdWriteTimestamp2"));
-  vkQueueSubmit2 =
-      reinterpret_cast<PFN_vkQueueSubmit2>(dlsym(libvulkan, "vkQueueSubmit2"));
-  vkCmdCopyBuffer2 = reinterpret_cast<PFN_vkCmdCopyBuffer2>(
-      dlsym(libvulkan, "vkCmdCopyBuffer2"));
-  vkCmdCopyImage2 = reinterpret_cast<PFN_vkCmdCopyImage2>(
-      dlsym(libvulkan, "vkCmdCopyImage2"));
-  vkCmdCopyBufferToImage2 = reinterpret_cast<PFN_vkCmdCopyBufferToImage2>(
-      dlsym(libvulkan, "vkCmdCopyBufferToImage2"));
-  vkCmdCopyImageToBuffer2 = reinterpret_cast<PFN_vkCmdCopyImageToBuffer2>(
-      dlsym(libvulkan, "vkCmdCopyImageToBuffer2"));
-  vkCmdBlitImage2 = reinterpret_cast<PFN_vkCmdBlitImage2>(
-      dlsym(libvulkan, "vkCmdBlitImage2"));
-  vkCmdResolveImage2 = reinterpret_cast<PFN_vkCmdResolveImage2>(
-      dlsym(libvulkan, "vkCmdResolveImage2"));
-  vkCmdBeginRendering = reinterpret_cast<PFN_vkCmdBeginRendering>(
-      dlsym(libvulkan, "vkCmdBeginRendering"));
-  vkCmdEndRendering = reinterpret_cast<PFN_vkCmdEndRendering>(
-      dlsym(libvulkan, "vkCmdEndRendering"));
-  vkCmdSetCullMode = reinterpret_cast<PFN_vkCmdSetCullMode>(
-      dlsym(libvulkan, "vkCmdSetCullMode"));
-  vkCmdSetFrontFace = reinterpret_cast<PFN_vkCmdSetFrontFace>(
-      dlsym(libvulkan, "vkCmdSetFrontFace"));
-  vkCmdSetPrimitiveTopology = reinterpret_cast<PFN_vkCmdSetPrimitiveTopology>(
-      dlsym(libvulkan, "vkCmdSetPrimitiveTopology"));
-  vkCmdSetViewportWithCount = reinterpret_cast<PFN_vkCmdSetViewportWithCount>(
-      dlsym(libvulkan, "vkCmdSetViewportWithCount"));
-  vkCmdSetScissorWithCount = reinterpret_cast<PFN_vkCmdSetScissorWithCount>(
-      dlsym(libvulkan, "vkCmdSetScissorWithCount"));
-  vkCmdBindVertexBuffers2 = reinterpret_cast<PFN_vkCmdBindVertexBuffers2>(
-      dlsym(libvulkan, "vkCmdBindVertexBuffers2"));
-  vkCmdSetDepthTestEnable = reinterpret_cast<PFN_vkCmdSetDepthTestEnable>(
-      dlsym(libvulkan, "vkCmdSetDepthTestEnable"));
-  vkCmdSetDepthWriteEnable = reinterpret_cast<PFN_vkCmdSetDepthWriteEnable>(
-      dlsym(libvulkan, "vkCmdSetDepthWriteEnable"));
-  vkCmdSetDepthCompareOp = reinterpret_cast<PFN_vkCmdSetDepthCompareOp>(
-      dlsym(libvulkan, "vkCmdSetDepthCompareOp"));
-  vkCmdSetDepthBoundsTestEnable =
-      reinterpret_cast<PFN_vkCmdSetDepthBoundsTestEnable>(
-          dlsym(libvulkan, "vkCmdSetDepthBoundsTestEnable"));
-  vkCmdSetStencilTestEnable = reinterpret_cast<PFN_vkCmdSetStencilTestEnable>(
-      dlsym(libvulkan, "vkCmdSetStencilTestEnable"));
-  vkCmdSetStencilOp = reinterpret_cast<PFN_vkCmdSetStencilOp>(
-      dlsym(libvulkan, "vkCmdSetStencilOp"));
-  vkCmdSetRasterizerDiscardEnable =
-      reinterpret_cast<PFN_vkCmdSetRasterizerDiscardEnable>(
-          dlsym(libvulkan, "vkCmdSetRasterizerDiscardEnable"));
-  vkCmdSetDepthBiasEnable = reinterpret_cast<PFN_vkCmdSetDepthBiasEnable>(
-      dlsym(libvulkan, "vkCmdSetDepthBiasEnable"));
-  vkCmdSetPrimitiveRestartEnable =
-      reinterpret_cast<PFN_vkCmdSetPrimitiveRestartEnable>(
-          dlsym(libvulkan, "vkCmdSetPrimitiveRestartEnable"));
-  vkGetDeviceBufferMemoryRequirements =
-      reinterpret_cast<PFN_vkGetDeviceBufferMemoryRequirements>(
-          dlsym(libvulkan, "vkGetDeviceBufferMemoryRequirements"));
-  vkGetDeviceImageMemoryRequirements =
-      reinterpret_cast<PFN_vkGetDeviceImageMemoryRequirements>(
-          dlsym(libvulkan, "vkGetDeviceImageMemoryRequirements"));
-  vkGetDeviceImageSparseMemoryRequirements =
-      reinterpret_cast<PFN_vkGetDeviceImageSparseMemoryRequirements>(
-          dlsym(libvulkan, "vkGetDeviceImageSparseMemoryRequirements"));
-  vkDestroySurfaceKHR = reinterpret_cast<PFN_vkDestroySurfaceKHR>(
-      dlsym(libvulkan, "vkDestroySurfaceKHR"));
-  vkGetPhysicalDeviceSurfaceSupportKHR =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceSurfaceSupportKHR>(
-          dlsym(libvulkan, "vkGetPhysicalDeviceSurfaceSupportKHR"));
-  vkGetPhysicalDeviceSurfaceCapabilitiesKHR =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceSurfaceCapabilitiesKHR>(
-          dlsym(libvulkan, "vkGetPhysicalDeviceSurfaceCapabilitiesKHR"));
-  vkGetPhysicalDeviceSurfaceFormatsKHR =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceSurfaceFormatsKHR>(
-          dlsym(libvulkan, "vkGetPhysicalDeviceSurfaceFormatsKHR"));
-  vkGetPhysicalDeviceSurfacePresentModesKHR =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceSurfacePresentModesKHR>(
-          dlsym(libvulkan, "vkGetPhysicalDeviceSurfacePresentModesKHR"));
+  if (!vkGetInstanceProcAddr) {
+    return false;
+  }
+  // The global functions of every core version, e.g. vkEnumerateInstanceVersion
+  // to find out which one to create the instance with.
+  ResolveFunctions(Level::kGlobal, UINT32_MAX, 0, nullptr,
+                   [](const char* name) {
+                     return vkGetInstanceProcAddr(VK_NULL_HANDLE, name);
+                   });
+  return vkCreateInstance != nullptr;
+}
+
+void LoadInstanceFunctions(VkInstance instance, uint32_t api_version,
+                           uint32_t extension_count,
+                           const char* const* extensions) {
+  ResolveFunctions(Level::kInstance, api_version, extension_count, extensions,
+                   [instance](const char* name) {
+                     return vkGetInstanceProcAddr(instance, name);
+                   });
 }
 
-void LoadCommonFunctions1(void* libvulkan) {
-  vkCreateSwapchainKHR = reinterpret_cast<PFN_vkCreateSwapchainKHR>(
-      dlsym(libvulkan, "vkCreateSwapchainKHR"));
-  vkDestroySwapchainKHR = reinterpret_cast<PFN_vkDestroySwapchainKHR>(
-      dlsym(libvulkan, "vkDestroySwapchainKHR"));
-  vkGetSwapchainImagesKHR = reinterpret_cast<PFN_vkGetSwapchainImagesKHR>(
-      dlsym(libvulkan, "vkGetSwapchainImagesKHR"));
-  vkAcquireNextImageKHR = reinterpret_cast<PFN_vkAcquireNextImageKHR>(
-      dlsym(libvulkan, "vkAcquireNextImageKHR"));
-  vkQueuePresentKHR = reinterpret_cast<PFN_vkQueuePresentKHR>(
-      dlsym(libvulkan, "vkQueuePresentKHR"));
-  vkGetDeviceGroupPresentCapabilitiesKHR =
-      reinterpret_cast<PFN_vkGetDeviceGroupPresentCapabilitiesKHR>(
-          dlsym(libvulkan, "vkGetDeviceGroupPresentCapabilitiesKHR"));
-  vkGetDeviceGroupSurfacePresentModesKHR =
-      reinterpret_cast<PFN_vkGetDeviceGroupSurfacePresentModesKHR>(
-          dlsym(libvulkan, "vkGetDeviceGroupSurfacePresentModesKHR"));
-  vkGetPhysicalDevicePresentRectanglesKHR =
-      reinterpret_cast<PFN_vkGetPhysicalDevicePresentRectanglesKHR>(
-          dlsym(libvulkan, "vkGetPhysicalDevicePresentRectanglesKHR"));
-  vkAcquireNextImage2KHR = reinterpret_cast<PFN_vkAcquireNextImage2KHR>(
-      dlsym(libvulkan, "vkAcquireNextImage2KHR"));
-  vkGetPhysicalDeviceDisplayPropertiesKHR =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceDisplayPropertiesKHR>(
-          dlsym(libvulkan, "vkGetPhysicalDeviceDisplayPropertiesKHR"));
-  vkGetPhysicalDeviceDisplayPlanePropertiesKHR =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceDisplayPlanePropertiesKHR>(
-          dlsym(libvulkan, "vkGetPhysicalDeviceDisplayPlanePropertiesKHR"));
-  vkGetDisplayPlaneSupportedDisplaysKHR =
-      reinterpret_cast<PFN_vkGetDisplayPlaneSupportedDisplaysKHR>(
-          dlsym(libvulkan, "vkGetDisplayPlaneSupportedDisplaysKHR"));
-  vkGetDisplayModePropertiesKHR =
-      reinterpret_cast<PFN_vkGetDisplayModePropertiesKHR>(
-          dlsym(libvulkan, "vkGetDisplayModePropertiesKHR"));
-  vkCreateDisplayModeKHR = reinterpret_cast<PFN_vkCreateDisplayModeKHR>(
-      dlsym(libvulkan, "vkCreateDisplayModeKHR"));
-  vkGetDisplayPlaneCapabilitiesKHR =
-      reinterpret_cast<PFN_vkGetDisplayPlaneCapabilitiesKHR>(
-          dlsym(libvulkan, "vkGetDisplayPlaneCapabilitiesKHR"));
-  vkCreateDisplayPlaneSurfaceKHR =
-      reinterpret_cast<PFN_vkCreateDisplayPlaneSurfaceKHR>(
-          dlsym(libvulkan, "vkCreateDisplayPlaneSurfaceKHR"));
-  vkCreateSharedSwapchainsKHR =
-      reinterpret_cast<PFN_vkCreateSharedSwapchainsKHR>(
-          dlsym(libvulkan, "vkCreateSharedSwapchainsKHR"));
-  vkCmdBeginRenderingKHR = reinterpret_cast<PFN_vkCmdBeginRenderingKHR>(
-      dlsym(libvulkan, "vkCmdBeginRenderingKHR"));
-  vkCmdEndRenderingKHR = reinterpret_cast<PFN_vkCmdEndRenderingKHR>(
-      dlsym(libvulkan, "vkCmdEndRenderingKHR"));
-  vkGetPhysicalDeviceFeatures2KHR =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(
-          dlsym(libvulkan, "vkGetPhysicalDeviceFeatures2KHR"));
-  vkGetPhysicalDeviceProperties2KHR =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceProperties2KHR>(
-          dlsym(libvulkan, "vkGetPhysicalDeviceProperties2KHR"));
-  vkGetPhysicalDeviceFormatProperties2KHR =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceFormatProperties2KHR>(
-          dlsym(libvulkan, "vkGetPhysicalDeviceFormatProperties2KHR"));
-  vkGetPhysicalDeviceImageFormatProperties2KHR =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceImageFormatProperties2KHR>(
-          dlsym(libvulkan, "vkGetPhysicalDeviceImageFormatProperties2KHR"));
-  vkGetPhysicalDeviceQueueFamilyProperties2KHR =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceQueueFamilyProperties2KHR>(
-          dlsym(libvulkan, "vkGetPhysicalDeviceQueueFamilyProperties2KHR"));
-  vkGetPhysicalDeviceMemoryProperties2KHR =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties2KHR>(
-          dlsym(libvulkan, "vkGetPhysicalDeviceMemoryProperties2KHR"));
-  vkGetPhysicalDeviceSparseImageFormatProperties2KHR =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceSparseImageFormatProperties2KHR>(
-          dlsym(libvulkan,
-                "vkGetPhysicalDeviceSparseImageFormatProperties2KHR"));
-  vkGetDeviceGroupPeerMemoryFeaturesKHR =
-      reinterpret_cast<PFN_vkGetDeviceGroupPeerMemoryFeaturesKHR>(
-          dlsym(libvulkan, "vkGetDeviceGroupPeerMemoryFeaturesKHR"));
-  vkCmdSetDeviceMaskKHR = reinterpret_cast<PFN_vkCmdSetDeviceMaskKHR>(
-      dlsym(libvulkan, "vkCmdSetDeviceMaskKHR"));
-  vkCmdDispatchBaseKHR = reinterpret_cast<PFN_vkCmdDispatchBaseKHR>(
-      dlsym(libvulkan, "vkCmdDispatchBaseKHR"));
-  vkTrimCommandPoolKHR = reinterpret_cast<PFN_vkTrimCommandPoolKHR>(
-      dlsym(libvulkan, "vkTrimCommandPoolKHR"));
-  vkEnumeratePhysicalDeviceGroupsKHR =
-      reinterpret_cast<PFN_vkEnumeratePhysicalDeviceGroupsKHR>(
-          dlsym(libvulkan, "vkEnumeratePhysicalDeviceGroupsKHR"));
-  vkGetPhysicalDeviceExternalBufferPropertiesKHR =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceExternalBufferPropertiesKHR>(
-          dlsym(libvulkan, "vkGetPhysicalDeviceExternalBufferPropertiesKHR"));
-  vkGetMemoryFdKHR = reinterpret_cast<PFN_vkGetMemoryFdKHR>(
-      dlsym(libvulkan, "vkGetMemoryFdKHR"));
-  vkGetMemoryFdPropertiesKHR = reinterpret_cast<PFN_vkGetMemoryFdPropertiesKHR>(
-      dlsym(libvulkan, "vkGetMemoryFdPropertiesKHR"));
-  vkGetPhysicalDeviceExternalSemaphorePropertiesKHR =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceExternalSemaphorePropertiesKHR>(
-          dlsym(libvulkan,
-                "vkGetPhysicalDeviceExternalSemaphorePropertiesKHR"));
-  vkImportSemaphoreFdKHR = reinterpret_cast<PFN_vkImportSemaphoreFdKHR>(
-      dlsym(libvulkan, "vkImportSemaphoreFdKHR"));
-  vkGetSemaphoreFdKHR = reinterpret_cast<PFN_vkGetSemaphoreFdKHR>(
-      dlsym(libvulkan, "vkGetSemaphoreFdKHR"));
-  vkCmdPushDescriptorSetKHR = reinterpret_cast<PFN_vkCmdPushDescriptorSetKHR>(
-      dlsym(libvulkan, "vkCmdPushDescriptorSetKHR"));
-  vkCmdPushDescriptorSetWithTemplateKHR =
-      reinterpret_cast<PFN_vkCmdPushDescriptorSetWithTemplateKHR>(
-          dlsym(libvulkan, "vkCmdPushDescriptorSetWithTemplateKHR"));
-  vkCreateDescriptorUpdateTemplateKHR =
-      reinterpret_cast<PFN_vkCreateDescriptorUpdateTemplateKHR>(
-          dlsym(libvulkan, "vkCreateDescriptorUpdateTemplateKHR"));
-  vkDestroyDescriptorUpdateTemplateKHR =
-      reinterpret_cast<PFN_vkDestroyDescriptorUpdateTemplateKHR>(
-          dlsym(libvulkan, "vkDestroyDescriptorUpdateTemplateKHR"));
-  vkUpdateDescriptorSetWithTemplateKHR =
-      reinterpret_cast<PFN_vkUpdateDescriptorSetWithTemplateKHR>(
-          dlsym(libvulkan, "vkUpdateDescriptorSetWithTemplateKHR"));
-  vkCreateRenderPass2KHR = reinterpret_cast<PFN_vkCreateRenderPass2KHR>(
-      dlsym(libvulkan, "vkCreateRenderPass2KHR"));
-  vkCmdBeginRenderPass2KHR = reinterpret_cast<PFN_vkCmdBeginRenderPass2KHR>(
-      dlsym(libvulkan, "vkCmdBeginRenderPass2KHR"));
-  vkCmdNextSubpass2KHR = reinterpret_cast<PFN_vkCmdNextSubpass2KHR>(
-      dlsym(libvulkan, "vkCmdNextSubpass2KHR"));
-  vkCmdEndRenderPass2KHR = reinterpret_cast<PFN_vkCmdEndRenderPass2KHR>(
-      dlsym(libvulkan, "vkCmdEndRenderPass2KHR"));
-  vkGetSwapchainStatusKHR = reinterpret_cast<PFN_vkGetSwapchainStatusKHR>(
-      dlsym(libvulkan, "vkGetSwapchainStatusKHR"));
-  vkGetPhysicalDeviceExternalFencePropertiesKHR =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceExternalFencePropertiesKHR>(
-          dlsym(libvulkan, "vkGetPhysicalDeviceExternalFencePropertiesKHR"));
-  vkImportFenceFdKHR = reinterpret_cast<PFN_vkImportFenceFdKHR>(
-      dlsym(libvulkan, "vkImportFenceFdKHR"));
-  vkGetFenceFdKHR = reinterpret_cast<PFN_vkGetFenceFdKHR>(
-      dlsym(libvulkan, "vkGetFenceFdKHR"));
-  vkEnumeratePhysicalDeviceQueueFamilyPerformanceQueryCountersKHR =
-      reinterpret_cast<
-          PFN_vkEnumeratePhysicalDeviceQueueFamilyPerformanceQueryCountersKHR>(
-          dlsym(libvulkan,
-                "vkEnumeratePhysicalDeviceQueueFamilyPerformanceQueryCountersKH"
-                "R"));
-  vkGetPhysicalDeviceQueueFamilyPerformanceQueryPassesKHR = reinterpret_cast<
-      PFN_vkGetPhysicalDeviceQueueFamilyPerformanceQueryPassesKHR>(dlsym(
-      libvulkan, "vkGetPhysicalDeviceQueueFamilyPerformanceQueryPassesKHR"));
-  vkAcquireProfilingLockKHR = reinterpret_cast<PFN_vkAcquireProfilingLockKHR>(
-      dlsym(libvulkan, "vkAcquireProfilingLockKHR"));
-  vkReleaseProfilingLockKHR = reinterpret_cast<PFN_vkReleaseProfilingLockKHR>(
-      dlsym(libvulkan, "vkReleaseProfilingLockKHR"));
-  vkGetPhysicalDeviceSurfaceCapabilities2KHR =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceSurfaceCapabilities2KHR>(
-          dlsym(libvulkan, "vkGetPhysicalDeviceSurfaceCapabilities2KHR"));
-  vkGetPhysicalDeviceSurfaceFormats2KHR =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceSurfaceFormats2KHR>(
-          dlsym(libvulkan, "vkGetPhysicalDeviceSurfaceFormats2KHR"));
-  vkGetPhysicalDeviceDisplayProperties2KHR =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceDisplayProperties2KHR>(
-          dlsym(libvulkan, "vkGetPhysicalDeviceDisplayProperties2KHR"));
-  vkGetPhysicalDeviceDisplayPlaneProperties2KHR =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceDisplayPlaneProperties2KHR>(
-          dlsym(libvulkan, "vkGetPhysicalDeviceDisplayPlaneProperties2KHR"));
-  vkGetDisplayModeProperties2KHR =
-      reinterpret_cast<PFN_vkGetDisplayModeProperties2KHR>(
-          dlsym(libvulkan, "vkGetDisplayModeProperties2KHR"));
-  vkGetDisplayPlaneCapabilities2KHR =
-      reinterpret_cast<PFN_vkGetDisplayPlaneCapabilities2KHR>(
-          dlsym(libvulkan, "vkGetDisplayPlaneCapabilities2KHR"));
-  vkGetImageMemoryRequirements2KHR =
-      reinterpret_cast<PFN_vkGetImageMemoryRequirements2KHR>(
-          dlsym(libvulkan, "vkGetImageMemoryRequirements2KHR"));
-  vkGetBufferMemoryRequirements2KHR =
-      reinterpret_cast<PFN_vkGetBufferMemoryRequirements2KHR>(
-          dlsym(libvulkan, "vkGetBufferMemoryRequirements2KHR"));
-  vkGetImageSparseMemoryRequirements2KHR =
-      reinterpret_cast<PFN_vkGetImageSparseMemoryRequirements2KHR>(
-          dlsym(libvulkan, "vkGetImageSparseMemoryRequirements2KHR"));
-  vkCreateSamplerYcbcrConversionKHR =
-      reinterpret_cast<PFN_vkCreateSamplerYcbcrConversionKHR>(
-          dlsym(libvulkan, "vkCreateSamplerYcbcrConversionKHR"));
-  vkDestroySamplerYcbcrConversionKHR =
-      reinterpret_cast<PFN_vkDestroySamplerYcbcrConversionKHR>(
-          dlsym(libvulkan, "vkDestroySamplerYcbcrConversionKHR"));
-  vkBindBufferMemory2KHR = reinterpret_cast<PFN_vkBindBufferMemory2KHR>(
-      dlsym(libvulkan, "vkBindBufferMemory2KHR"));
-  vkBindImageMemory2KHR = reinterpret_cast<PFN_vkBindImageMemory2KHR>(
-      dlsym(libvulkan, "vkBindImageMemory2KHR"));
-  vkGetDescriptorSetLayoutSupportKHR =
-      reinterpret_cast<PFN_vkGetDescriptorSetLayoutSupportKHR>(
-          dlsym(libvulkan, "vkGetDescriptorSetLayoutSupportKHR"));
-  vkCmdDrawIndirectCountKHR = reinterpret_cast<PFN_vkCmdDrawIndirectCountKHR>(
-      dlsym(libvulkan, "vkCmdDrawIndirectCountKHR"));
-  vkCmdDrawIndexedIndirectCountKHR =
-      reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
-          dlsym(libvulkan, "vkCmdDrawIndexedIndirectCountKHR"));
-  vkGetSemaphoreCounterValueKHR =
-      reinterpret_cast<PFN_vkGetSemaphoreCounterValueKHR>(
-          dlsym(libvulkan, "vkGetSemaphoreCounterValueKHR"));
-  vkWaitSemaphoresKHR = reinterpret_cast<PFN_vkWaitSemaphoresKHR>(
-      dlsym(libvulkan, "vkWaitSemaphoresKHR"));
-  vkSignalSemaphoreKHR = reinterpret_cast<PFN_vkSignalSemaphoreKHR>(
-      dlsym(libvulkan, "vkSignalSemaphoreKHR"));
-  vkGetPhysicalDeviceFragmentShadingRatesKHR =
-      reinterpret_cast<PFN_vkGetPhysicalDeviceFragmentShadingRatesKHR>(
-          dlsym(libvulkan, "vkGetPhysicalDeviceFragmentShadingRatesKHR"));
-  vkCmdSetFragmentShadingRateKHR =
-      reinterpret_cast<PFN_vkCmdSetFragmentShadingRateKHR>(
-          dlsym(libvulkan, "vkCmdSetFragmentShadingRateKHR"));
-  vkWaitForPresentKHR = reinterpret_cast<PFN_vkWaitForPresentKHR>(
-      dlsym(libvulkan, "vkWaitForPresentKHR"));
-  vkGetBufferDeviceAddressKHR =
-      reinterpret_cast<PFN_vkGetBufferDeviceAddressKHR>(
-          dlsym(libvulkan, "vkGetBufferDeviceAddressKHR"));
-  vkGetBufferOpaqueCaptureAddressKHR =
-      reinterpret_cast<PFN_vkGetBufferOpaqueCaptureAddressKHR>(
-          dlsym(libvulkan, "vkGetBufferOpaqueCaptureAddressKHR"));
-  vkGetDeviceMemoryOpaqueCaptureAddressKHR =
-      reinterpret_cast<PFN_vkGetDeviceMemoryOpaqueCaptureAddressKHR>(
-          dlsym(libvulkan, "vkGetDeviceMemoryOpaqueCaptureAddressKHR"));
-  vkCreateDeferredOperationKHR =
-      reinterpret_cast<PFN_vkCreateDeferredOperationKHR>(
-          dlsym(libvulkan, "vkCreateDeferredOperationKHR"));
-  vkDestroyDeferredOperationKHR =
-      reinterpret_cast<PFN_vkDestroyDeferredOperationKHR>(
-          dlsym(libvulkan, "vkDestroyDeferredOperationKHR"));
-  vkGetDeferredOperationMaxConcurrencyKHR =
-      reinterpret_cast<PFN_vkGetDeferredOperationMaxConcurrencyKHR>(
-          dlsym(libvulkan, "vkGetDeferredOperationMaxConcurrencyKHR"));
-  vkGetDeferredOperationResultKHR =
-      reinterpret_cast<PFN_vkGetDeferredOperationResultKHR>(
-          dlsym(libvulkan, "vkGetDeferredOperationResultKHR"));
-  vkDeferredOperationJoinKHR = reinterpret_cast<PFN_vkDeferredOperationJoinKHR>(
-      dlsym(libvulkan, "vkDeferredOperationJoinKHR"));
-  vkGetPipelineExecutablePropertiesKHR =
-      reinterpret_cast<PFN_vkGetPipelineExecutablePropertiesKHR>(
-          dlsym(libvulkan, "vkGetPipelineExecutablePropertiesKHR"));
-  vkGetPipelineExecutableStatisticsKHR =
-      reinterpret_cast<PFN_vkGetPipelineExecutableStatisticsKHR>(
-          dlsym(libvulkan, "vkGetPipelineExecutableStatisticsKHR"));
-  vkGetPipelineExecutableInternalRepresentationsKHR =
-      reinterpret_cast<PFN_vkGetPipelineExecutableInternalRepresentationsKHR>(
-          dlsym(libvulkan,
-                "vkGetPipelineExecutableInternalRepresentationsKHR"));
-  vkCmdSetEvent2KHR = reinterpret_cast<PFN_vkCmdSetEvent2KHR>(
-      dlsym(libvulkan, "vkCmdSetEvent2KHR"));
-  vkCmdResetEvent2KHR = reinterpret_cast<PFN_vkCmdResetEvent2KHR>(
-      dlsym(libvulkan, "vkCmdResetEvent2KHR"));
-  vkCmdWaitEvents2KHR = reinterpret_cast<PFN_vkCmdWaitEvents2KHR>(
-      dlsym(libvulkan, "vkCmdWaitEvents2KHR"));
-  vkCmdPipelineBarrier2KHR = reinterpret_cast<PFN_vkCmdPipelineBarrier2KHR>(
-      dlsym(libvulkan, "vkCmdPipelineBarrier2KHR"));
-  vkCmdWriteTimestamp2KHR = reinterpret_cast<PFN_vkCmdWriteTimestamp2KHR>(
-      dlsym(libvulkan, "vkCmdWriteTimestamp2KHR"));
-  vkQueueSubmit2KHR = reinterpret_cast<PFN_vkQueueSubmit2KHR>(
-      dlsym(libvulkan, "vkQueueSubmit2KHR"));
-  vkCmdWriteBufferMarker2AMD = reinterpret_cast<PFN_vkCmdWriteBufferMarker2AMD>(
-      dlsym(libvulkan, "vkCmdWriteBufferMarker2AMD"));
-  vkGetQueueCheckpointData2NV =
-      reinterpret_cast<PFN_vkGetQueueCheckpointData2NV>(
-          dlsym(libvulkan, "vkGetQueueCheckpointData2NV"));
-  vkCmdCopyBuffer2KHR = reinterpret_cast<PFN_vkCmdCopyBuffer2KHR>(
-      dlsym(libvulkan, "vkCmdCopyBuffer2KHR"));
-  vkCmdCopyImage2KHR = reinterpret_cast<PFN_vkCmdCopyImage2KHR>(
-      dlsym(libvulkan, "vkCmdCopyImage2KHR"));
-  vkCmdCopyBufferToImage2KHR = reinterpret_cast<PFN_vkCmdCopyBufferToImage2KHR>(
-      dlsym(libvulkan, "vkCmdCopyBufferToImage2KHR"));
-  vkCmdCopyImageToBuffer2KHR = reinterpret_cast<PFN_vkCmdCopyImageToBuffer2KHR>(
-      dlsym(libvulkan, "vkCmdCopyImageToBuffer2KHR"));
-  vkCmdBlitImage2KHR = reinterpret_cast<PFN_vkCmdBlitImage2KHR>(
-      dlsym(libvulkan, "vkCmdBlitImage2KHR"));
-  vkCmdResolveImage2KHR = reinterpret_cast<PFN_vkCmdResolveImage2KHR>(
-      dlsym(libvulkan, "vkCmdResolveImage2KHR"));
-  vkGetDeviceBufferMemoryRequirementsKHR =
-      reinterpret_cast<PFN_vkGetDeviceBufferMemoryRequirementsKHR>(
-          dlsym(libvulkan, "vkGetDeviceBufferMemoryRequirementsKHR"));
-  vkGetDeviceImageMemoryRequirementsKHR =
-      reinterpret_cast<PFN_vkGetDeviceImageMemoryRequirementsKHR>(
-          dlsym(libvulkan, "vkGetDeviceImageMemoryRequirementsKHR"));
-  vkGetDeviceImageSparseMemoryRequirementsKHR =
-      reinterpret_cast<PFN_vkGetDeviceImageSparseMemoryRequirementsKHR>(
-          dlsym(libvulkan, "vkGetDeviceImageSparseMemoryRequirementsKHR"));
-  vkCreateAccelerationStructureKHR =
-      reinterpret_cast<PFN_vkCreateAccelerationStructureKHR>(
-          dlsym(libvulkan, "vkCreateAccelerationStructureKHR"));
-  vkDestroyAccelerationStructureKHR =
-      reinterpret_cast<PFN_vkDestroyAccelerationStructureKHR>(
-          dlsym(libvulkan, "vkDestroyAccelerationStructureKHR"));
-  vkCmdBuildAccelerationStructuresKHR =
-      reinterpret_cast<PFN_vkCmdBuildAccelerationStructuresKHR>(
-          dlsym(libvulkan, "vkCmdBuildAccelerationStructuresKHR"));
-  vkCmdBuildAccelerationStructuresIndirectKHR =
-      reinterpret_cast<PFN_vkCmdBuildAccelerationStructuresIndirectKHR>(
-          dlsym(libvulkan, "vkCmdBuildAccelerationStructuresIndirectKHR"));
-  vkBuildAccelerationStructuresKHR =
-      reinterpret_cast<PFN_vkBuildAccelerationStructuresKHR>(
-          dlsym(libvulkan, "vkBuildAccelerationStructuresKHR"));
-  vkCopyAccelerationStructureKHR =
-      reinterpret_cast<PFN_vkCopyAccelerationStructureKHR>(
-          dlsym(libvulkan, "vkCopyAccelerationStructureKHR"));
-  vkCopyAccelerationStructureToMemoryKHR =
-      reinterpret_cast<PFN_vkCopyAccelerationStructureToMemoryKHR>(
-          dlsym(libvulkan, "vkCopyAccelerationStructureToMemoryKHR"));
-  vkCopyMemoryToAccelerationStructureKHR =
-      reinterpret_cast<PFN_vkCopyMemoryToAccelerationStructureKHR>(
-          dlsym(libvulkan, "vkCopyMemoryToAccelerationStructureKHR"));
-  vkWriteAccelerationStructuresPropertiesKHR =
-      reinterpret_cast<PFN_vkWriteAccelerationStructuresPropertiesKHR>(
-          dlsym(libvulkan, "vkWriteAccelerationStructuresPropertiesKHR"));
-  vkCmdCopyAccelerationStructureKHR =
-      reinterpret_cast<PFN_vkCmdCopyAccelerationStructureKHR>(
-          dlsym(libvulkan, "vkCmdCopyAccelerationStructureKHR"));
-  vkCmdCopyAccelerationStructureToMemoryKHR =
-      reinterpret_cast<PFN_vkCmdCopyAccelerationStructureToMemoryKHR>(
-          dlsym(libvulkan, "vkCmdCopyAccelerationStructureToMemoryKHR"));
-  vkCmdCopyMemoryToAccelerationStructureKHR =
-      reinterpret_cast<PFN_vkCmdCopyMemoryToAccelerationStructureKHR>(
-          dlsym(libvulkan, "vkCmdCopyMemoryToAccelerationStructureKHR"));
-  vkGetAccelerationStructureDeviceAddressKHR =
-      reinterpret_cast<PFN_vkGetAccelerationStructureDeviceAddressKHR>(
-          dlsym(libvulkan, "vkGetAccelerationStructureDeviceAddressKHR"));
-  vkCmdWriteAccelerationStructuresPropertiesKHR =
-      reinterpret_cast<PFN_vkCmdWriteAccelerationStructuresPropertiesKHR>(
-          dlsym(libvulkan, "vkCmdWriteAccelerationStructuresPropertiesKHR"));
-  vkGetDeviceAccelerationStructureCompatibilityKHR =
-      reinterpret_cast<PFN_vkGetDeviceAccelerationStructureCompatibilityKHR>(
-          dlsym(libvulkan, "vkGetDeviceAccelerationStructureCompatibilityKHR"));
-  vkGetAccelerationStructureBuildSizesKHR =
-      reinterpret_cast<PFN_vkGetAccelerationStructureBuildSizesKHR>(
-          dlsym(libvulkan, "vkGetAccelerationStructureBuildSizesKHR"));
-  vkCmdTraceRaysKHR = reinterpret_cast<PFN_vkCmdTraceRaysKHR>(
-      dlsym(libvulkan, "vkCmdTraceRaysKHR"));
-  vkCreateRayTracingPipelinesKHR =
-      reinterpret_cast<PFN_vkCreateRayTracingPipelinesKHR>(
-          dlsym(libvulkan, "vkCreateRayTracingPipelinesKHR"));
-  vkGetRayTracingCaptureReplayShaderGroupHandlesKHR =
-      reinterpret_cast<PFN_vkGetRayTracingCaptureReplayShaderGroupHandlesKHR>(
-          dlsym(libvulkan,
-                "vkGetRayTracingCaptureReplayShaderGroupHandlesKHR"));
-  vkCmdTraceRaysIndirectKHR = reinterpret_cast<PFN_vkCmdTraceRaysIndirectKHR>(
-      dlsym(libvulkan, "vkCmdTraceRaysIndirectKHR"));
-  vkGetRayTracingShaderGroupStackSizeKHR =
-      reinterpret_cast<PFN_vkGetRayTracingShaderGroupStackSizeKHR>(
-          dlsym(libvulkan, "vkGetRayTracingShaderGroupStackSizeKHR"));
-  vkCmdSetRayTracingPipelineStackSizeKHR =
-      reinterpret_cast<PFN_vkCmdSetRayTracingPipelineStackSizeKHR>(
-          dlsym(libvulkan, "vkCmdSetRayTracingPipelineStackSizeKHR"));
+void LoadDeviceFunctions(VkInstance instance, VkDevice device,
+                         uint32_t api_version, uint32_t extension_count,
+                         const char* const* extensions) {
+  ResolveFunctions(Level::kDevice, api_version, extension_count, extensions,
+                   [device](const char* name) {
+                     return vkGetDeviceProcAddr(device, name);
+                   });
+  // Device extensions may also add functions of the physical device, which
+  // only come from the instance.  The core ones are resolved already.
+  ResolveFunctions(Level::kInstance, /*api_version=*/0, extension_count,
+                   extensions, [instance](const char* name) {
+                     return vkGetInstanceProcAddr(instance, name);
+                   });
 }
 
 PFN_vkCreateInstance vkCreateInstance;
@@ -1330,156 +1070,6 @@ PFN_vkGetDeviceBufferMemoryRequirementsKHR
 PFN_vkGetDeviceImageMemoryRequirementsKHR vkGetDeviceImageMemoryRequirementsKHR;
 PFN_vkGetDeviceImageSparseMemoryRequirementsKHR
     vkGetDeviceImageSparseMemoryRequirementsKHR;
-PFN_vkCreateDebugReportCallbackEXT vkCreateDebugReportCallbackEXT;
-PFN_vkDestroyDebugReportCallbackEXT vkDestroyDebugReportCallbackEXT;
-PFN_vkDebugReportMessageEXT vkDebugReportMessageEXT;
-PFN_vkDebugMarkerSetObjectTagEXT vkDebugMarkerSetObjectTagEXT;
-PFN_vkDebugMarkerSetObjectNameEXT vkDebugMarkerSetObjectNameEXT;
-PFN_vkCmdDebugMarkerBeginEXT vkCmdDebugMarkerBeginEXT;
-PFN_vkCmdDebugMarkerEndEXT vkCmdDebugMarkerEndEXT;
-PFN_vkCmdDebugMarkerInsertEXT vkCmdDebugMarkerInsertEXT;
-PFN_vkCmdBindTransformFeedbackBuffersEXT vkCmdBindTransformFeedbackBuffersEXT;
-PFN_vkCmdBeginTransformFeedbackEXT vkCmdBeginTransformFeedbackEXT;
-PFN_vkCmdEndTransformFeedbackEXT vkCmdEndTransformFeedbackEXT;
-PFN_vkCmdBeginQueryIndexedEXT vkCmdBeginQueryIndexedEXT;
-PFN_vkCmdEndQueryIndexedEXT vkCmdEndQueryIndexedEXT;
-PFN_vkCmdDrawIndirectByteCountEXT vkCmdDrawIndirectByteCountEXT;
-PFN_vkCreateCuModuleNVX vkCreateCuModuleNVX;
-PFN_vkCreateCuFunctionNVX vkCreateCuFunctionNVX;
-PFN_vkDestroyCuModuleNVX vkDestroyCuModuleNVX;
-PFN_vkDestroyCuFunctionNVX vkDestroyCuFunctionNVX;
-PFN_vkCmdCuLaunchKernelNVX vkCmdCuLaunchKernelNVX;
-PFN_vkGetImageViewHandleNVX vkGetImageViewHandleNVX;
-PFN_vkGetImageViewAddressNVX vkGetImageViewAddressNVX;
-PFN_vkCmdDrawIndirectCountAMD vkCmdDrawIndirectCountAMD;
-PFN_vkCmdDrawIndexedIndirectCountAMD vkCmdDrawIndexedIndirectCountAMD;
-PFN_vkGetShaderInfoAMD vkGetShaderInfoAMD;
-PFN_vkGetPhysicalDeviceExternalImageFormatPropertiesNV
-    vkGetPhysicalDeviceExternalImageFormatPropertiesNV;
-PFN_vkCmdBeginConditionalRenderingEXT vkCmdBeginConditionalRenderingEXT;
-PFN_vkCmdEndConditionalRenderingEXT vkCmdEndConditionalRenderingEXT;
-PFN_vkCmdSetViewportWScalingNV vkCmdSetViewportWScalingNV;
-PFN_vkReleaseDisplayEXT vkReleaseDisplayEXT;
-PFN_vkGetPhysicalDeviceSurfaceCapabilities2EXT
-    vkGetPhysicalDeviceSurfaceCapabilities2EXT;
-PFN_vkDisplayPowerControlEXT vkDisplayPowerControlEXT;
-PFN_vkRegisterDeviceEventEXT vkRegisterDeviceEventEXT;
-PFN_vkRegisterDisplayEventEXT vkRegisterDisplayEventEXT;
-PFN_vkGetSwapchainCounterEXT vkGetSwapchainCounterEXT;
-PFN_vkGetRefreshCycleDurationGOOGLE vkGetRefreshCycleDurationGOOGLE;
-PFN_vkGetPastPresentationTimingGOOGLE vkGetPastPresentationTimingGOOGLE;
-PFN_vkCmdSetDiscardRectangleEXT vkCmdSetDiscardRectangleEXT;
-PFN_vkSetHdrMetadataEXT vkSetHdrMetadataEXT;
-PFN_vkSetDebugUtilsObjectNameEXT vkSetDebugUtilsObjectNameEXT;
-PFN_vkSetDebugUtilsObjectTagEXT vkSetDebugUtilsObjectTagEXT;
-PFN_vkQueueBeginDebugUtilsLabelEXT vkQueueBeginDebugUtilsLabelEXT;
-PFN_vkQueueEndDebugUtilsLabelEXT vkQueueEndDebugUtilsLabelEXT;
-PFN_vkQueueInsertDebugUtilsLabelEXT vkQueueInsertDebugUtilsLabelEXT;
-PFN_vkCmdBeginDebugUtilsLabelEXT vkCmdBeginDebugUtilsLabelEXT;
-PFN_vkCmdEndDebugUtilsLabelEXT vkCmdEndDebugUtilsLabelEXT;
-PFN_vkCmdInsertDebugUtilsLabelEXT vkCmdInsertDebugUtilsLabelEXT;
-PFN_vkCreateDebugUtilsMessengerEXT vkCreateDebugUtilsMessengerEXT;
-PFN_vkDestroyDebugUtilsMessengerEXT vkDestroyDebugUtilsMessengerEXT;
-PFN_vkSubmitDebugUtilsMessageEXT vkSubmitDebugUtilsMessageEXT;
-PFN_vkCmdSetSampleLocationsEXT vkCmdSetSampleLocationsEXT;
-PFN_vkGetPhysicalDeviceMultisamplePropertiesEXT
-    vkGetPhysicalDeviceMultisamplePropertiesEXT;
-PFN_vkGetImageDrmFormatModifierPropertiesEXT
-    vkGetImageDrmFormatModifierPropertiesEXT;
-PFN_vkCreateValidationCacheEXT vkCreateValidationCacheEXT;
-PFN_vkDestroyValidationCacheEXT vkDestroyValidationCacheEXT;
-PFN_vkMergeValidationCachesEXT vkMergeValidationCachesEXT;
-PFN_vkGetValidationCacheDataEXT vkGetValidationCacheDataEXT;
-PFN_vkCmdBindShadingRateImageNV vkCmdBindShadingRateImageNV;
-PFN_vkCmdSetViewportShadingRatePaletteNV vkCmdSetViewportShadingRatePaletteNV;
-PFN_vkCmdSetCoarseSampleOrderNV vkCmdSetCoarseSampleOrderNV;
-PFN_vkCreateAccelerationStructureNV vkCreateAccelerationStructureNV;
-PFN_vkDestroyAccelerationStructureNV vkDestroyAccelerationStructureNV;
-PFN_vkGetAccelerationStructureMemoryRequirementsNV
-    vkGetAccelerationStructureMemoryRequirementsNV;
-PFN_vkBindAccelerationStructureMemoryNV vkBindAccelerationStructureMemoryNV;
-PFN_vkCmdBuildAccelerationStructureNV vkCmdBuildAccelerationStructureNV;
-PFN_vkCmdCopyAccelerationStructureNV vkCmdCopyAccelerationStructureNV;
-PFN_vkCmdTraceRaysNV vkCmdTraceRaysNV;
-PFN_vkCreateRayTracingPipelinesNV vkCreateRayTracingPipelinesNV;
-PFN_vkGetRayTracingShaderGroupHandlesKHR vkGetRayTracingShaderGroupHandlesKHR;
-PFN_vkGetRayTracingShaderGroupHandlesNV vkGetRayTracingShaderGroupHandlesNV;
-PFN_vkGetAccelerationStructureHandleNV vkGetAccelerationStructureHandleNV;
-PFN_vkCmdWriteAccelerationStructuresPropertiesNV
-    vkCmdWriteAccelerationStructuresPropertiesNV;
-PFN_vkCompileDeferredNV vkCompileDeferredNV;
-PFN_vkGetMemoryHostPointerPropertiesEXT vkGetMemoryHostPointerPropertiesEXT;
-PFN_vkCmdWriteBufferMarkerAMD vkCmdWriteBufferMarkerAMD;
-PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT
-    vkGetPhysicalDeviceCalibrateableTimeDomainsEXT;
-PFN_vkGetCalibratedTimestampsEXT vkGetCalibratedTimestampsEXT;
-PFN_vkCmdDrawMeshTasksNV vkCmdDrawMeshTasksNV;
-PFN_vkCmdSetExclusiveScissorNV vkCmdSetExclusiveScissorNV;
-PFN_vkCmdSetCheckpointNV vkCmdSetCheckpointNV;
-PFN_vkGetQueueCheckpointDataNV vkGetQueueCheckpointDataNV;
-PFN_vkInitializePerformanceApiINTEL vkInitializePerformanceApiINTEL;
-PFN_vkUninitializePerformanceApiINTEL vkUninitializePerformanceApiINTEL;
-PFN_vkCmdSetPerformanceMarkerINTEL vkCmdSetPerformanceMarkerINTEL;
-PFN_vkCmdSetPerformanceStreamMarkerINTEL vkCmdSetPerformanceStreamMarkerINTEL;
-PFN_vkCmdSetPerformanceOverrideINTEL vkCmdSetPerformanceOverrideINTEL;
-PFN_vkAcquirePerformanceConfigurationINTEL
-    vkAcquirePerformanceConfigurationINTEL;
-PFN_vkReleasePerformanceConfigurationINTEL
-    vkReleasePerformanceConfigurationINTEL;
-PFN_vkQueueSetPerformanceConfigurationINTEL
-    vkQueueSetPerformanceConfigurationINTEL;
-PFN_vkGetPerformanceParameterINTEL vkGetPerformanceParameterINTEL;
-PFN_vkSetLocalDimmingAMD vkSetLocalDimmingAMD;
-PFN_vkGetBufferDeviceAddressEXT vkGetBufferDeviceAddressEXT;
-PFN_vkGetPhysicalDeviceToolPropertiesEXT vkGetPhysicalDeviceToolPropertiesEXT;
-PFN_vkGetPhysicalDeviceCooperativeMatrixPropertiesNV
-    vkGetPhysicalDeviceCooperativeMatrixPropertiesNV;
-PFN_vkGetPhysicalDeviceSupportedFramebufferMixedSamplesCombinationsNV
-    vkGetPhysicalDeviceSupportedFramebufferMixedSamplesCombinationsNV;
-PFN_vkCreateHeadlessSurfaceEXT vkCreateHeadlessSurfaceEXT;
-PFN_vkCmdSetLineStippleEXT vkCmdSetLineStippleEXT;
-PFN_vkResetQueryPoolEXT vkResetQueryPoolEXT;
-PFN_vkCmdSetCullModeEXT vkCmdSetCullModeEXT;
-PFN_vkCmdSetFrontFaceEXT vkCmdSetFrontFaceEXT;
-PFN_vkCmdSetPrimitiveTopologyEXT vkCmdSetPrimitiveTopologyEXT;
-PFN_vkCmdSetViewportWithCountEXT vkCmdSetViewportWithCountEXT;
-PFN_vkCmdSetScissorWithCountEXT vkCmdSetScissorWithCountEXT;
-PFN_vkCmdBindVertexBuffers2EXT vkCmdBindVertexBuffers2EXT;
-PFN_vkCmdSetDepthTestEnableEXT vkCmdSetDepthTestEnableEXT;
-PFN_vkCmdSetDepthWriteEnableEXT vkCmdSetDepthWriteEnableEXT;
-PFN_vkCmdSetDepthCompareOpEXT vkCmdSetDepthCompareOpEXT;
-PFN_vkCmdSetDepthBoundsTestEnableEXT vkCmdSetDepthBoundsTestEnableEXT;
-PFN_vkCmdSetStencilTestEnableEXT vkCmdSetStencilTestEnableEXT;
-PFN_vkCmdSetStencilOpEXT vkCmdSetStencilOpEXT;
-PFN_vkGetGeneratedCommandsMemoryRequirementsNV
-    vkGetGeneratedCommandsMemoryRequirementsNV;
-PFN_vkCmdPreprocessGeneratedCommandsNV vkCmdPreprocessGeneratedCommandsNV;
-PFN_vkCmdExecuteGeneratedCommandsNV vkCmdExecuteGeneratedCommandsNV;
-PFN_vkCmdBindPipelineShaderGroupNV vkCmdBindPipelineShaderGroupNV;
-PFN_vkCreateIndirectCommandsLayoutNV vkCreateIndirectCommandsLayoutNV;
-PFN_vkDestroyIndirectCommandsLayoutNV vkDestroyIndirectCommandsLayoutNV;
-PFN_vkAcquireDrmDisplayEXT vkAcquireDrmDisplayEXT;
-PFN_vkGetDrmDisplayEXT vkGetDrmDisplayEXT;
-PFN_vkCreatePrivateDataSlotEXT vkCreatePrivateDataSlotEXT;
-PFN_vkDestroyPrivateDataSlotEXT vkDestroyPrivateDataSlotEXT;
-PFN_vkSetPrivateDataEXT vkSetPrivateDataEXT;
-PFN_vkGetPrivateDataEXT vkGetPrivateDataEXT;
-PFN_vkCmdSetFragmentShadingRateEnumNV vkCmdSetFragmentShadingRateEnumNV;
-PFN_vkCmdSetVertexInputEXT vkCmdSetVertexInputEXT;
-PFN_vkGetDeviceSubpassShadingMaxWorkgroupSizeHUAWEI
-    vkGetDeviceSubpassShadingMaxWorkgroupSizeHUAWEI;
-PFN_vkCmdSubpassShadingHUAWEI vkCmdSubpassShadingHUAWEI;
-PFN_vkCmdBindInvocationMaskHUAWEI vkCmdBindInvocationMaskHUAWEI;
-PFN_vkGetMemoryRemoteAddressNV vkGetMemoryRemoteAddressNV;
-PFN_vkCmdSetPatchControlPointsEXT vkCmdSetPatchControlPointsEXT;
-PFN_vkCmdSetRasterizerDiscardEnableEXT vkCmdSetRasterizerDiscardEnableEXT;
-PFN_vkCmdSetDepthBiasEnableEXT vkCmdSetDepthBiasEnableEXT;
-PFN_vkCmdSetLogicOpEXT vkCmdSetLogicOpEXT;
-PFN_vkCmdSetPrimitiveRestartEnableEXT vkCmdSetPrimitiveRestartEnableEXT;
-PFN_vkCmdSetColorWriteEnableEXT vkCmdSetColorWriteEnableEXT;
-PFN_vkCmdDrawMultiEXT vkCmdDrawMultiEXT;
-PFN_vkCmdDrawMultiIndexedEXT vkCmdDrawMultiIndexedEXT;
-PFN_vkSetDeviceMemoryPriorityEXT vkSetDeviceMemoryPriorityEXT;
 PFN_vkCreateAccelerationStructureKHR vkCreateAccelerationStructureKHR;
 PFN_vkDestroyAccelerationStructureKHR vkDestroyAccelerationStructureKHR;
 PFN_vkCmdBuildAccelerationStructuresKHR vkCmdBuildAccelerationStructuresKHR;
@@ -1515,12 +1105,14 @@ PFN_vkGetRayTracingShaderGroupStackSizeKHR
     vkGetRayTracingShaderGroupStackSizeKHR;
 PFN_vkCmdSetRayTracingPipelineStackSizeKHR
     vkCmdSetRayTracingPipelineStackSizeKHR;
-
+#ifdef VK_USE_PLATFORM_ANDROID_KHR
 PFN_vkCreateAndroidSurfaceKHR vkCreateAndroidSurfaceKHR;
-
 PFN_vkGetAndroidHardwareBufferPropertiesANDROID
     vkGetAndroidHardwareBufferPropertiesANDROID;
 PFN_vkGetMemoryAndroidHardwareBufferANDROID
     vkGetMemoryAndroidHardwareBufferANDROID;
+#endif  // VK_USE_PLATFORM_ANDROID_KHR
+PFN_vkCreateDebugUtilsMessengerEXT vkCreateDebugUtilsMessengerEXT;
+PFN_vkDestroyDebugUtilsMessengerEXT vkDestroyDebugUtilsMessengerEXT;
 
 }  // namespace simple_vulkan
@@ -19,11 +19,34 @@
 #include <vulkan/vulkan.h>
 #include <vulkan/vulkan_android.h>
 
+#include <cstdint>
+
 namespace simple_vulkan {
 
+// The functions below are resolved in the steps that make them usable, each
+// only for the core versions and extensions it is given, instead of all of
+// them through dlsym at startup.  Functions of anything not enabled stay
+// nullptr.
+//
+// LoadVulkan() opens libvulkan.so and resolves the global functions needed to
+// create an instance.  LoadInstanceFunctions() resolves the functions taking
+// an instance or physical device once the instance exists.
+// LoadDeviceFunctions() resolves the rest through vkGetDeviceProcAddr once
+// the device exists, which returns the driver's own entry points, so calls,
+// e.g. the vkCmd* ones while recording, skip the loader's dispatch.  The
+// pointers are global, so there can be only one instance and device at a
+// time.
 bool LoadVulkan();
-void LoadCommonFunctions0(void* libvulkan);
-void LoadCommonFunctions1(void* libvulkan);
+// |api_version| is the apiVersion of the instance and |extensions| its
+// enabled extensions.
+void LoadInstanceFunctions(VkInstance instance, uint32_t api_version,
+                           uint32_t extension_count,
+                           const char* const* extensions);
+// |device| was created on |instance| with |api_version| and the enabled
+// device |extensions|.
+void LoadDeviceFunctions(VkInstance instance, VkDevice device,
+                         uint32_t api_version, uint32_t extension_count,
+                         const char* const* extensions);
 
 // VK_core_0
 extern PFN_vkCreateInstance vkCreateInstance;
@@ -538,6 +561,8 @@ extern PFN_vkCmdSetRayTracingPipelineStackSizeKHR
 #ifdef VK_USE_PLATFORM_ANDROID_KHR
 // VK_KHR_android_surface
 extern PFN_vkCreateAndroidSurfaceKHR vkCreateAndroidSurfaceKHR;
+
+// VK_ANDROID_external_memory_android_hardware_buffer
 extern PFN_vkGetAndroidHardwareBufferPropertiesANDROID
     vkGetAndroidHardwareBufferPropertiesANDROID;
 extern PFN_vkGetMemoryAndroidHardwareBufferANDROID
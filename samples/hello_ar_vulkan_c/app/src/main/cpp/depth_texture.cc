@@ -0,0 +1,356 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "depth_texture.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "util.h"
+
+namespace simple_vulkan {
+namespace {
+constexpr VkFormat kDepthFormat = VK_FORMAT_R16_UINT;
+constexpr int32_t kDepthPixelSize = sizeof(uint16_t);
+// Copies start at a multiple of the texel size and of 4 bytes.
+constexpr VkDeviceSize kStagingAlignment = 16;
+constexpr VkImageSubresourceRange kColorRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0,
+                                                 1, 0, 1};
+}  // namespace
+
+DepthTexture::DepthTexture(VulkanHandler* vulkan_handler)
+    : vulkan_handler_(vulkan_handler),
+      use_transfer_queue_(vulkan_handler->GetTransferQueue() !=
+                          VK_NULL_HANDLE) {
+  if (use_transfer_queue_) {
+    const VkCommandPoolCreateInfo pool_create_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .queueFamilyIndex = vulkan_handler_->GetTransferQueueFamilyIndex(),
+    };
+    CALL_VK(vkCreateCommandPool(vulkan_handler_->GetLogicalDevice(),
+                                &pool_create_info, /* pAllocator=*/nullptr,
+                                &transfer_command_pool_));
+  }
+  frame_slots_.assign(vulkan_handler_->GetMaxFramesInFlight(), -1);
+}
+
+DepthTexture::~DepthTexture() {
+  vulkan_handler_->WaitForAllFrames();
+  DestroySlots();
+  if (transfer_command_pool_ != VK_NULL_HANDLE) {
+    vkDestroyCommandPool(vulkan_handler_->GetLogicalDevice(),
+                         transfer_command_pool_, /* pAllocator=*/nullptr);
+  }
+}
+
+void DepthTexture::Update(int current_frame, const ArSession* ar_session,
+                          const ArImage* depth_image) {
+  // The frame's previous draw is done, so it no longer samples its slot.
+  frame_slots_[current_frame] = -1;
+
+  int64_t timestamp_ns = 0;
+  ArImage_getTimestamp(ar_session, depth_image, &timestamp_ns);
+  if (timestamp_ns != latest_timestamp_ns_) {
+    int32_t width = 0;
+    int32_t height = 0;
+    int32_t row_stride = 0;
+    const uint8_t* data = nullptr;
+    int32_t data_length = 0;
+    ArImage_getWidth(ar_session, depth_image, &width);
+    ArImage_getHeight(ar_session, depth_image, &height);
+    ArImage_getPlaneRowStride(ar_session, depth_image, /* plane_index=*/0,
+                              &row_stride);
+    ArImage_getPlaneData(ar_session, depth_image, /* plane_index=*/0, &data,
+                         &data_length);
+    // The last row may end right after its pixels.
+    if (data == nullptr || width <= 0 || height <= 0 ||
+        row_stride % kDepthPixelSize != 0 ||
+        data_length < (height - 1) * row_stride + width * kDepthPixelSize) {
+      LOGE("DepthTexture: unexpected %dx%d depth image with %d byte rows.",
+           width, height, row_stride);
+      return;
+    }
+
+    // The depth image only changes size with the camera config.
+    if (static_cast<uint32_t>(width) != extent_.width ||
+        static_cast<uint32_t>(height) != extent_.height ||
+        row_stride != row_stride_) {
+      vulkan_handler_->WaitForAllFrames();
+      DestroySlots();
+      CreateSlots({static_cast<uint32_t>(width), static_cast<uint32_t>(height)},
+                  row_stride);
+    }
+
+    const int slot_index = FindFreeSlot();
+    if (slot_index >= 0) {
+      Slot& slot = slots_[slot_index];
+      memcpy(staging_allocation_.mapped + slot.staging_offset, data,
+             std::min(data_length, height * row_stride));
+      RecordUpload(current_frame, slot);
+      latest_slot_ = slot_index;
+      latest_timestamp_ns_ = timestamp_ns;
+    }
+  }
+  frame_slots_[current_frame] = latest_slot_;
+}
+
+VkImageView DepthTexture::GetImageView(int current_frame) const {
+  const int slot_index = frame_slots_[current_frame];
+  return slot_index < 0 ? VK_NULL_HANDLE : slots_[slot_index].image_view;
+}
+
+void DepthTexture::CreateSlots(VkExtent2D extent, int32_t row_stride) {
+  extent_ = extent;
+  row_stride_ = row_stride;
+  VkDevice logical_device = vulkan_handler_->GetLogicalDevice();
+  // Each frame in flight may sample a different image, and one more is
+  // needed for the next upload.
+  slots_.resize(vulkan_handler_->GetMaxFramesInFlight() + 1);
+  const VkDeviceSize slot_size =
+      (static_cast<VkDeviceSize>(row_stride) * extent.height +
+       kStagingAlignment - 1) /
+      kStagingAlignment * kStagingAlignment;
+  vulkan_handler_->CreateBuffer(slot_size * slots_.size(),
+                                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                staging_buffer_, staging_allocation_);
+
+  for (size_t i = 0; i < slots_.size(); ++i) {
+    Slot& slot = slots_[i];
+    slot.staging_offset = slot_size * i;
+    const VkImageCreateInfo image_create_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .flags = 0,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = kDepthFormat,
+        .extent = {extent.width, extent.height, 1u},
+        .mipLevels = 1u,
+        .arrayLayers = 1u,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = 0,
+        .pQueueFamilyIndices = nullptr,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+    vulkan_handler_->CreateImage(image_create_info, slot.image,
+                                 slot.allocation);
+
+    const VkImageViewCreateInfo view_create_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .flags = 0,
+        .image = slot.image,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = kDepthFormat,
+        .components =
+            {
+                VK_COMPONENT_SWIZZLE_IDENTITY,
+                VK_COMPONENT_SWIZZLE_IDENTITY,
+                VK_COMPONENT_SWIZZLE_IDENTITY,
+                VK_COMPONENT_SWIZZLE_IDENTITY,
+            },
+        .subresourceRange = kColorRange,
+    };
+    CALL_VK(vkCreateImageView(logical_device, &view_create_info,
+                              /* pAllocator=*/nullptr, &slot.image_view));
+
+    if (use_transfer_queue_) {
+      const VkCommandBufferAllocateInfo allocate_info = {
+          .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+          .commandPool = transfer_command_pool_,
+          .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+          .commandBufferCount = 1,
+      };
+      CALL_VK(vkAllocateCommandBuffers(logical_device, &allocate_info,
+                                       &slot.transfer_commands));
+      const VkFenceCreateInfo fence_create_info = {
+          .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+          .flags = 0,
+      };
+      CALL_VK(vkCreateFence(logical_device, &fence_create_info,
+                            /* pAllocator=*/nullptr, &slot.fence));
+      const VkSemaphoreCreateInfo semaphore_create_info = {
+          .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+          .flags = 0,
+      };
+      CALL_VK(vkCreateSemaphore(logical_device, &semaphore_create_info,
+                                /* pAllocator=*/nullptr, &slot.semaphore));
+    }
+  }
+  LOGI("DepthTexture: %u images of %ux%u depth, %s.",
+       static_cast<uint32_t>(slots_.size()), extent.width, extent.height,
+       use_transfer_queue_ ? "copied on the transfer queue"
+                           : "copied in the frames");
+}
+
+void DepthTexture::DestroySlots() {
+  VkDevice logical_device = vulkan_handler_->GetLogicalDevice();
+  for (const Slot& slot : slots_) {
+    if (slot.transfer_pending) {
+      CALL_VK(vkWaitForFences(logical_device, /* fenceCount=*/1, &slot.fence,
+                              VK_TRUE, UINT64_MAX));
+    }
+    if (slot.transfer_commands != VK_NULL_HANDLE) {
+      vkFreeCommandBuffers(logical_device, transfer_command_pool_, 1,
+                           &slot.transfer_commands);
+      vkDestroyFence(logical_device, slot.fence, /* pAllocator=*/nullptr);
+      vkDestroySemaphore(logical_device, slot.semaphore,
+                         /* pAllocator=*/nullptr);
+    }
+    vkDestroyImageView(logical_device, slot.image_view,
+                       /* pAllocator=*/nullptr);
+    vulkan_handler_->DestroyImage(slot.image, slot.allocation);
+  }
+  slots_.clear();
+  if (staging_buffer_ != VK_NULL_HANDLE) {
+    vulkan_handler_->DestroyBuffer(staging_buffer_, staging_allocation_);
+    staging_buffer_ = VK_NULL_HANDLE;
+  }
+  std::fill(frame_slots_.begin(), frame_slots_.end(), -1);
+  latest_slot_ = -1;
+  latest_timestamp_ns_ = -1;
+  extent_ = {};
+  row_stride_ = 0;
+}
+
+int DepthTexture::FindFreeSlot() {
+  VkDevice logical_device = vulkan_handler_->GetLogicalDevice();
+  for (size_t i = 0; i < slots_.size(); ++i) {
+    const int slot_index = static_cast<int>(i);
+    if (slot_index == latest_slot_ ||
+        std::find(frame_slots_.begin(), frame_slots_.end(), slot_index) !=
+            frame_slots_.end()) {
+      continue;
+    }
+    Slot& slot = slots_[i];
+    if (slot.transfer_pending) {
+      // Polled rather than waited for, the next frame tries again.
+      if (vkGetFenceStatus(logical_device, slot.fence) != VK_SUCCESS) {
+        continue;
+      }
+      CALL_VK(vkResetFences(logical_device, 1, &slot.fence));
+      slot.transfer_pending = false;
+    }
+    return slot_index;
+  }
+  return -1;
+}
+
+void DepthTexture::RecordUpload(int current_frame, Slot& slot) {
+  // The previous contents are overwritten, and no frame samples them
+  // anymore.
+  const VkImageMemoryBarrier to_transfer = {
+      .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+      .srcAccessMask = 0,
+      .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+      .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+      .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .image = slot.image,
+      .subresourceRange = kColorRange,
+  };
+  const VkBufferImageCopy region = {
+      .bufferOffset = slot.staging_offset,
+      .bufferRowLength = static_cast<uint32_t>(row_stride_ / kDepthPixelSize),
+      .bufferImageHeight = 0,
+      .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+      .imageOffset = {0, 0, 0},
+      .imageExtent = {extent_.width, extent_.height, 1u},
+  };
+  VkImageMemoryBarrier to_read = GetReadBarrier(slot);
+  VkCommandBuffer frame_command_buffer =
+      vulkan_handler_->GetFrameCommandBuffer(current_frame);
+
+  if (!use_transfer_queue_) {
+    vkCmdPipelineBarrier(frame_command_buffer,
+                         VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                         nullptr, 1, &to_transfer);
+    vkCmdCopyBufferToImage(frame_command_buffer, staging_buffer_, slot.image,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+    vkCmdPipelineBarrier(frame_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr,
+                         0, nullptr, 1, &to_read);
+    return;
+  }
+
+  VkCommandBuffer command_buffer = slot.transfer_commands;
+  CALL_VK(vkResetCommandBuffer(command_buffer, /* flags=*/0));
+  const VkCommandBufferBeginInfo begin_info = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+  };
+  CALL_VK(vkBeginCommandBuffer(command_buffer, &begin_info));
+  vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &to_transfer);
+  vkCmdCopyBufferToImage(command_buffer, staging_buffer_, slot.image,
+                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+  // Release to the graphics queue. The access on the acquiring side is made
+  // visible by the acquire barrier.
+  to_read.dstAccessMask = 0;
+  vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &to_read);
+  CALL_VK(vkEndCommandBuffer(command_buffer));
+
+  const VkSubmitInfo submit_info = {
+      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+      .waitSemaphoreCount = 0,
+      .commandBufferCount = 1,
+      .pCommandBuffers = &command_buffer,
+      .signalSemaphoreCount = 1,
+      .pSignalSemaphores = &slot.semaphore,
+  };
+  CALL_VK(vkQueueSubmit(vulkan_handler_->GetTransferQueue(), 1, &submit_info,
+                        slot.fence));
+  slot.transfer_pending = true;
+
+  // The frame only waits for the copy where it samples the depth, so its
+  // camera background and vertex work overlap with it.
+  vulkan_handler_->AddSubmitWaitSemaphore(
+      slot.semaphore, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+  to_read = GetReadBarrier(slot);
+  to_read.srcAccessMask = 0;
+  vkCmdPipelineBarrier(frame_command_buffer,
+                       VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                       VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &to_read);
+}
+
+VkImageMemoryBarrier DepthTexture::GetReadBarrier(const Slot& slot) const {
+  return {
+      .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+      .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+      .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      .newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+      .srcQueueFamilyIndex =
+          use_transfer_queue_ ? vulkan_handler_->GetTransferQueueFamilyIndex()
+                              : VK_QUEUE_FAMILY_IGNORED,
+      .dstQueueFamilyIndex =
+          use_transfer_queue_ ? vulkan_handler_->GetGraphicsQueueFamilyIndex()
+                              : VK_QUEUE_FAMILY_IGNORED,
+      .image = slot.image,
+      .subresourceRange = kColorRange,
+  };
+}
+
+}  // namespace simple_vulkan
@@ -0,0 +1,113 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_SIMPLE_VULKAN_DEPTH_TEXTURE_H_
+#define C_ARCORE_SIMPLE_VULKAN_DEPTH_TEXTURE_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "arcore_c_api.h"
+#include "android_vulkan_loader.h"
+#include "vulkan_handler.h"
+#include "vulkan_memory_allocator.h"
+
+namespace simple_vulkan {
+
+// DepthTexture keeps the latest ARCore depth image in a device local
+// R16_UINT image, in millimeters, for the occlusion of the content.
+//
+// The depth image changes at a lower rate than the frames are drawn, so it is
+// only copied when its timestamp changes. The rows are written as they are
+// into a staging buffer that stays mapped, and the copy runs on the transfer
+// queue of the handler if it has one. The ownership of the image is then
+// handed to the graphics queue by a barrier pair, and the frame only waits
+// for the copy before its fragment shaders, so neither queue idles. Without
+// a transfer queue the copy is recorded into the frame before the render
+// pass.
+//
+// There are more images than frames in flight, so that an upload never
+// overwrites an image an earlier frame may still sample.
+class DepthTexture {
+ public:
+  // The handler must outlive the texture.
+  explicit DepthTexture(VulkanHandler* vulkan_handler);
+  ~DepthTexture();
+
+  DepthTexture(const DepthTexture&) = delete;
+  DepthTexture& operator=(const DepthTexture&) = delete;
+
+  // Uploads |depth_image|, from ArFrame_acquireDepthImage16Bits(), unless its
+  // timestamp is that of the previous upload, and makes the frame sample it.
+  // The depth of earlier frames is kept if all images are still in use.
+  //
+  // Must be called between VulkanHandler::BeginRecordingCommandBuffer() and
+  // BeginRenderPass() of the frame, and before its submit.
+  //
+  // @param current_frame the index of current frame in the flight.
+  void Update(int current_frame, const ArSession* ar_session,
+              const ArImage* depth_image);
+
+  // The image the frame samples, in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+  // or VK_NULL_HANDLE before the first upload.
+  VkImageView GetImageView(int current_frame) const;
+
+ private:
+  struct Slot {
+    VkImage image = VK_NULL_HANDLE;
+    VulkanMemoryAllocator::Allocation allocation;
+    VkImageView image_view = VK_NULL_HANDLE;
+    // Offset of the slot's rows in staging_buffer_.
+    VkDeviceSize staging_offset = 0;
+    // Only with a transfer queue: the copy, signaled when it is done.
+    VkCommandBuffer transfer_commands = VK_NULL_HANDLE;
+    VkFence fence = VK_NULL_HANDLE;
+    VkSemaphore semaphore = VK_NULL_HANDLE;
+    bool transfer_pending = false;
+  };
+
+  // Sizes the images and the staging buffer for depth images of |extent|
+  // whose rows are |row_stride| bytes apart.
+  void CreateSlots(VkExtent2D extent, int32_t row_stride);
+  void DestroySlots();
+  // A slot that no frame samples and whose last copy is done, or -1.
+  int FindFreeSlot();
+  // Copies staging rows of |slot| into its image, on the transfer queue if
+  // there is one, or else into the frame's command buffer.
+  void RecordUpload(int current_frame, Slot& slot);
+  // The layout transition, and with a transfer queue the ownership release
+  // or acquire, between the copy and the fragment shaders.
+  VkImageMemoryBarrier GetReadBarrier(const Slot& slot) const;
+
+  VulkanHandler* const vulkan_handler_;
+  const bool use_transfer_queue_;
+  VkCommandPool transfer_command_pool_ = VK_NULL_HANDLE;
+
+  VkExtent2D extent_ = {};
+  int32_t row_stride_ = 0;
+  VkBuffer staging_buffer_ = VK_NULL_HANDLE;
+  VulkanMemoryAllocator::Allocation staging_allocation_;
+  std::vector<Slot> slots_;
+  // Slot each frame in flight samples, -1 for none.
+  std::vector<int> frame_slots_;
+  // Slot of the latest upload, and the timestamp of its depth image.
+  int latest_slot_ = -1;
+  int64_t latest_timestamp_ns_ = -1;
+};
+
+}  // namespace simple_vulkan
+
+#endif  // C_ARCORE_SIMPLE_VULKAN_DEPTH_TEXTURE_H_
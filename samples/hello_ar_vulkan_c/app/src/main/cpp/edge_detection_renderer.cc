@@ -0,0 +1,563 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "edge_detection_renderer.h"
+
+#include <algorithm>
+#include <cstddef>
+
+#include "../assets/shaders/background_frag.spv.h"
+#include "../assets/shaders/background_vert.spv.h"
+#include "../assets/shaders/edge_detection_comp.spv.h"
+#include "util.h"
+
+namespace simple_vulkan {
+namespace {
+// Matches the local size of edge_detection.comp. The edge images are a
+// multiple of it, so the shader needs no bounds check.
+constexpr uint32_t kWorkGroupSize = 8;
+// Edges are found at this fraction of the camera resolution.
+constexpr uint32_t kDownscale = 2;
+constexpr VkFormat kEdgeFormat = VK_FORMAT_R8G8B8A8_UNORM;
+
+// The descriptors a template writes, in the order of the bindings.
+struct ComputeDescriptors {
+  VkDescriptorImageInfo camera_image;
+  VkDescriptorImageInfo edge_image;
+};
+
+uint32_t GetEdgeSize(uint32_t camera_size) {
+  return std::max(camera_size / kDownscale / kWorkGroupSize, 1u) *
+         kWorkGroupSize;
+}
+}  // namespace
+
+EdgeDetectionRenderer::EdgeDetectionRenderer(VulkanHandler* vulkan_handler)
+    : vulkan_handler_(vulkan_handler) {
+  CreateCompositePipeline(vulkan_handler_->GetLogicalDevice());
+  composite_sets_.assign(vulkan_handler_->GetMaxFramesInFlight(),
+                         VK_NULL_HANDLE);
+}
+
+EdgeDetectionRenderer::~EdgeDetectionRenderer() {
+  vulkan_handler_->WaitForAllFrames();
+  VkDevice logical_device = vulkan_handler_->GetLogicalDevice();
+  DestroyEdgeImages();
+  if (compute_pipeline_ != VK_NULL_HANDLE) {
+    vkDestroyPipeline(logical_device, compute_pipeline_,
+                      /* pAllocator=*/nullptr);
+    vkDestroyPipelineLayout(logical_device, compute_pipeline_layout_,
+                            /* pAllocator=*/nullptr);
+    vkDestroyDescriptorUpdateTemplate(logical_device, compute_template_,
+                                      /* pAllocator=*/nullptr);
+    vkDestroyDescriptorSetLayout(logical_device, compute_set_layout_,
+                                 /* pAllocator=*/nullptr);
+  }
+  vkDestroyPipeline(logical_device, composite_pipeline_,
+                    /* pAllocator=*/nullptr);
+  vkDestroyPipelineLayout(logical_device, composite_pipeline_layout_,
+                          /* pAllocator=*/nullptr);
+  vkDestroyDescriptorUpdateTemplate(logical_device, composite_template_,
+                                    /* pAllocator=*/nullptr);
+  vkDestroyDescriptorSetLayout(logical_device, composite_set_layout_,
+                               /* pAllocator=*/nullptr);
+  vkDestroySampler(logical_device, edge_sampler_, /* pAllocator=*/nullptr);
+}
+
+void EdgeDetectionRenderer::Dispatch(
+    int current_frame, const VulkanHandler::CameraImage& camera_image) {
+  if (compute_pipeline_ == VK_NULL_HANDLE) {
+    CreateComputePipeline(vulkan_handler_->GetLogicalDevice(),
+                          vulkan_handler_->GetCameraSampler());
+  }
+  // The camera image only changes size with the camera config.
+  if (camera_image.extent.width != camera_extent_.width ||
+      camera_image.extent.height != camera_extent_.height) {
+    vulkan_handler_->WaitForAllFrames();
+    DestroyEdgeImages();
+    CreateEdgeImages(camera_image.extent);
+  }
+
+  const EdgeImage& edge_image = edge_images_[current_frame];
+  VkDescriptorSet compute_set = vulkan_handler_->AllocateFrameDescriptorSet(
+      current_frame, compute_set_layout_);
+  VkDescriptorSet composite_set = vulkan_handler_->AllocateFrameDescriptorSet(
+      current_frame, composite_set_layout_);
+  if (compute_set == VK_NULL_HANDLE || composite_set == VK_NULL_HANDLE) {
+    return;
+  }
+  VkDevice logical_device = vulkan_handler_->GetLogicalDevice();
+  const ComputeDescriptors compute_descriptors = {
+      .camera_image = {.sampler = VK_NULL_HANDLE,
+                       .imageView = camera_image.image_view,
+                       .imageLayout = VK_IMAGE_LAYOUT_GENERAL},
+      .edge_image = {.sampler = VK_NULL_HANDLE,
+                     .imageView = edge_image.image_view,
+                     .imageLayout = VK_IMAGE_LAYOUT_GENERAL},
+  };
+  vkUpdateDescriptorSetWithTemplate(logical_device, compute_set,
+                                    compute_template_, &compute_descriptors);
+  vkUpdateDescriptorSetWithTemplate(logical_device, composite_set,
+                                    composite_template_,
+                                    &compute_descriptors.edge_image);
+
+  VkCommandBuffer command_buffer =
+      vulkan_handler_->GetFrameCommandBuffer(current_frame);
+  // The previous contents are overwritten, and the last draw that sampled
+  // them only needs to be done.
+  VkImageMemoryBarrier barrier = {
+      .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+      .srcAccessMask = 0,
+      .dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+      .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+      .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+      .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .image = edge_image.image,
+      .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+  };
+  vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &barrier);
+
+  vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    compute_pipeline_);
+  vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          compute_pipeline_layout_, 0, 1, &compute_set, 0,
+                          nullptr);
+  vkCmdDispatch(command_buffer, edge_extent_.width / kWorkGroupSize,
+                edge_extent_.height / kWorkGroupSize, 1);
+
+  // The render pass samples the edges once they are written.
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+  vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &barrier);
+  composite_sets_[current_frame] = composite_set;
+}
+
+void EdgeDetectionRenderer::Draw(int current_frame,
+                                 VkCommandBuffer command_buffer,
+                                 const VulkanHandler::VertexInfo* vertices) {
+  VkDescriptorSet composite_set = composite_sets_[current_frame];
+  if (composite_set == VK_NULL_HANDLE) {
+    return;
+  }
+  // The set goes with the frame's descriptor pool once the frame is done.
+  composite_sets_[current_frame] = VK_NULL_HANDLE;
+
+  VkBuffer vertex_buffer;
+  VkDeviceSize offset;
+  void* vertex_data;
+  if (!vulkan_handler_->AllocateFrameData(
+          current_frame, 4 * sizeof(VulkanHandler::VertexInfo),
+          sizeof(float), &vertex_buffer, &offset, &vertex_data)) {
+    return;
+  }
+  // Drawn as a strip, which crosses from the top right to the bottom left.
+  VulkanHandler::VertexInfo* strip =
+      static_cast<VulkanHandler::VertexInfo*>(vertex_data);
+  strip[0] = vertices[0];
+  strip[1] = vertices[1];
+  strip[2] = vertices[3];
+  strip[3] = vertices[2];
+
+  const VkExtent2D extent = vulkan_handler_->GetExtent();
+  const VkViewport viewport = {
+      .x = 0,
+      .y = 0,
+      .width = static_cast<float>(extent.width),
+      .height = static_cast<float>(extent.height),
+      .minDepth = 0.0,
+      .maxDepth = 1.0};
+  const VkRect2D scissor = {.offset = {0, 0}, .extent = extent};
+
+  vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    composite_pipeline_);
+  vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+  vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+  vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          composite_pipeline_layout_, 0, 1, &composite_set, 0,
+                          nullptr);
+  vkCmdBindVertexBuffers(command_buffer, 0, 1, &vertex_buffer, &offset);
+  vkCmdDraw(command_buffer, /* vertexCount=*/4, /* instanceCount=*/1,
+            /* firstVertex=*/0, /* firstInstance=*/0);
+}
+
+void EdgeDetectionRenderer::CreateComputePipeline(VkDevice logical_device,
+                                                  VkSampler camera_sampler) {
+  // The camera image can only be sampled with the immutable sampler of its
+  // YCbCr conversion.
+  const VkDescriptorSetLayoutBinding bindings[2] = {
+      {
+          .binding = 0,
+          .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+          .descriptorCount = 1,
+          .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+          .pImmutableSamplers = &camera_sampler,
+      },
+      {
+          .binding = 1,
+          .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+          .descriptorCount = 1,
+          .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+          .pImmutableSamplers = nullptr,
+      },
+  };
+  const VkDescriptorSetLayoutCreateInfo layout_info = {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+      .bindingCount = 2,
+      .pBindings = bindings,
+  };
+  CALL_VK(vkCreateDescriptorSetLayout(logical_device, &layout_info,
+                                      /* pAllocator=*/nullptr,
+                                      &compute_set_layout_));
+  compute_template_ = vulkan_handler_->CreateDescriptorUpdateTemplate(
+      compute_set_layout_,
+      {
+          {
+              .dstBinding = 0,
+              .dstArrayElement = 0,
+              .descriptorCount = 1,
+              .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+              .offset = offsetof(ComputeDescriptors, camera_image),
+              .stride = sizeof(VkDescriptorImageInfo),
+          },
+          {
+              .dstBinding = 1,
+              .dstArrayElement = 0,
+              .descriptorCount = 1,
+              .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+              .offset = offsetof(ComputeDescriptors, edge_image),
+              .stride = sizeof(VkDescriptorImageInfo),
+          },
+      });
+
+  const VkPipelineLayoutCreateInfo pipeline_layout_create_info{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+      .setLayoutCount = 1,
+      .pSetLayouts = &compute_set_layout_,
+      .pushConstantRangeCount = 0,
+      .pPushConstantRanges = nullptr,
+  };
+  CALL_VK(vkCreatePipelineLayout(logical_device, &pipeline_layout_create_info,
+                                 /* pAllocator=*/nullptr,
+                                 &compute_pipeline_layout_));
+
+  VkShaderModule compute_shader = vulkan_handler_->LoadShader(
+      logical_device, edge_detection_comp, sizeof(edge_detection_comp));
+  const VkComputePipelineCreateInfo pipeline_create_info = {
+      .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+      .flags = 0,
+      .stage =
+          {
+              .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+              .flags = 0,
+              .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+              .module = compute_shader,
+              .pName = "main",
+              .pSpecializationInfo = nullptr,
+          },
+      .layout = compute_pipeline_layout_,
+      .basePipelineHandle = VK_NULL_HANDLE,
+      .basePipelineIndex = 0,
+  };
+  CALL_VK(vkCreateComputePipelines(
+      logical_device, vulkan_handler_->GetPipelineCache(), 1,
+      &pipeline_create_info, /* pAllocator=*/nullptr, &compute_pipeline_));
+  vkDestroyShaderModule(logical_device, compute_shader,
+                        /* pAllocator=*/nullptr);
+}
+
+void EdgeDetectionRenderer::CreateCompositePipeline(VkDevice logical_device) {
+  const VkSamplerCreateInfo sampler_create_info = {
+      .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+      .magFilter = VK_FILTER_LINEAR,
+      .minFilter = VK_FILTER_LINEAR,
+      .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+      .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+      .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+      .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+      .mipLodBias = 0.0f,
+      .anisotropyEnable = VK_FALSE,
+      .maxAnisotropy = 1,
+      .compareEnable = VK_FALSE,
+      .compareOp = VK_COMPARE_OP_NEVER,
+      .minLod = 0.0f,
+      .maxLod = 0.0f,
+      .borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK,
+      .unnormalizedCoordinates = VK_FALSE,
+  };
+  CALL_VK(vkCreateSampler(logical_device, &sampler_create_info,
+                          /* pAllocator=*/nullptr, &edge_sampler_));
+
+  const VkDescriptorSetLayoutBinding binding = {
+      .binding = 0,
+      .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+      .descriptorCount = 1,
+      .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+      .pImmutableSamplers = &edge_sampler_,
+  };
+  const VkDescriptorSetLayoutCreateInfo layout_info = {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+      .bindingCount = 1,
+      .pBindings = &binding,
+  };
+  CALL_VK(vkCreateDescriptorSetLayout(logical_device, &layout_info,
+                                      /* pAllocator=*/nullptr,
+                                      &composite_set_layout_));
+  composite_template_ = vulkan_handler_->CreateDescriptorUpdateTemplate(
+      composite_set_layout_,
+      {{
+          .dstBinding = 0,
+          .dstArrayElement = 0,
+          .descriptorCount = 1,
+          .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+          .offset = 0,
+          .stride = sizeof(VkDescriptorImageInfo),
+      }});
+
+  const VkPipelineLayoutCreateInfo pipeline_layout_create_info{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+      .setLayoutCount = 1,
+      .pSetLayouts = &composite_set_layout_,
+      .pushConstantRangeCount = 0,
+      .pPushConstantRanges = nullptr,
+  };
+  CALL_VK(vkCreatePipelineLayout(logical_device, &pipeline_layout_create_info,
+                                 /* pAllocator=*/nullptr,
+                                 &composite_pipeline_layout_));
+
+  // The background shaders draw the edges the way they draw the camera
+  // image.
+  VkShaderModule vertex_shader = vulkan_handler_->LoadShader(
+      logical_device, background_vert, sizeof(background_vert));
+  VkShaderModule fragment_shader = vulkan_handler_->LoadShader(
+      logical_device, background_frag, sizeof(background_frag));
+
+  const VkPipelineShaderStageCreateInfo shader_stages[2] = {
+      {
+          .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+          .flags = 0,
+          .stage = VK_SHADER_STAGE_VERTEX_BIT,
+          .module = vertex_shader,
+          .pName = "main",
+          .pSpecializationInfo = nullptr,
+      },
+      {
+          .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+          .flags = 0,
+          .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+          .module = fragment_shader,
+          .pName = "main",
+          .pSpecializationInfo = nullptr,
+      },
+  };
+
+  const VkPipelineViewportStateCreateInfo viewport_info{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+      .viewportCount = 1,
+      .pViewports = nullptr,
+      .scissorCount = 1,
+      .pScissors = nullptr,
+  };
+
+  const VkSampleMask sample_mask = ~0u;
+  const VkPipelineMultisampleStateCreateInfo multisample_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+      .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+      .sampleShadingEnable = VK_FALSE,
+      .minSampleShading = 0,
+      .pSampleMask = &sample_mask,
+      .alphaToCoverageEnable = VK_FALSE,
+      .alphaToOneEnable = VK_FALSE,
+  };
+
+  // The edge strength is the alpha of the overlay.
+  const VkPipelineColorBlendAttachmentState attachment_states = {
+      .blendEnable = VK_TRUE,
+      .srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA,
+      .dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+      .colorBlendOp = VK_BLEND_OP_ADD,
+      .srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
+      .dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+      .alphaBlendOp = VK_BLEND_OP_ADD,
+      .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                        VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+  };
+  const VkPipelineColorBlendStateCreateInfo color_blend_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+      .flags = 0,
+      .logicOpEnable = VK_FALSE,
+      .logicOp = VK_LOGIC_OP_COPY,
+      .attachmentCount = 1,
+      .pAttachments = &attachment_states,
+  };
+
+  const VkPipelineRasterizationStateCreateInfo raster_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+      .depthClampEnable = VK_FALSE,
+      .rasterizerDiscardEnable = VK_FALSE,
+      .polygonMode = VK_POLYGON_MODE_FILL,
+      .cullMode = VK_CULL_MODE_NONE,
+      .frontFace = VK_FRONT_FACE_CLOCKWISE,
+      .depthBiasEnable = VK_FALSE,
+      .lineWidth = 1,
+  };
+
+  const VkPipelineInputAssemblyStateCreateInfo input_assembly_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+      .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP,
+      .primitiveRestartEnable = VK_FALSE,
+  };
+
+  const VkVertexInputBindingDescription vertex_input_binding = {
+      .binding = 0,
+      .stride = sizeof(VulkanHandler::VertexInfo),
+      .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+  };
+  const VkVertexInputAttributeDescription vertex_input_attributes[2] = {
+      {
+          .location = 0,
+          .binding = 0,
+          .format = VK_FORMAT_R32G32_SFLOAT,
+          .offset = offsetof(VulkanHandler::VertexInfo, pos_x),
+      },
+      {
+          .location = 1,
+          .binding = 0,
+          .format = VK_FORMAT_R32G32_SFLOAT,
+          .offset = offsetof(VulkanHandler::VertexInfo, tex_u),
+      },
+  };
+  const VkPipelineVertexInputStateCreateInfo vertex_input_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+      .vertexBindingDescriptionCount = 1,
+      .pVertexBindingDescriptions = &vertex_input_binding,
+      .vertexAttributeDescriptionCount = 2,
+      .pVertexAttributeDescriptions = vertex_input_attributes,
+  };
+
+  const VkDynamicState dynamic_state_enables[2] = {
+      VK_DYNAMIC_STATE_VIEWPORT,
+      VK_DYNAMIC_STATE_SCISSOR,
+  };
+  const VkPipelineDynamicStateCreateInfo dynamic_state_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+      .dynamicStateCount = 2,
+      .pDynamicStates = dynamic_state_enables};
+
+  // Like the background, the overlay is behind everything else.
+  const VkPipelineDepthStencilStateCreateInfo depth_stencil = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+      .depthTestEnable = VK_FALSE,
+      .depthWriteEnable = VK_FALSE,
+      .depthCompareOp = VK_COMPARE_OP_ALWAYS,
+      .depthBoundsTestEnable = VK_FALSE,
+      .stencilTestEnable = VK_FALSE};
+
+  const VkGraphicsPipelineCreateInfo pipeline_create_info = {
+      .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+      .flags = 0,
+      .stageCount = 2,
+      .pStages = shader_stages,
+      .pVertexInputState = &vertex_input_info,
+      .pInputAssemblyState = &input_assembly_info,
+      .pTessellationState = nullptr,
+      .pViewportState = &viewport_info,
+      .pRasterizationState = &raster_info,
+      .pMultisampleState = &multisample_info,
+      .pDepthStencilState = &depth_stencil,
+      .pColorBlendState = &color_blend_info,
+      .pDynamicState = &dynamic_state_info,
+      .layout = composite_pipeline_layout_,
+      .renderPass = vulkan_handler_->GetRenderPass(),
+      .subpass = 0,
+      .basePipelineHandle = VK_NULL_HANDLE,
+      .basePipelineIndex = 0,
+  };
+  CALL_VK(vkCreateGraphicsPipelines(
+      logical_device, vulkan_handler_->GetPipelineCache(), 1,
+      &pipeline_create_info, /* pAllocator=*/nullptr, &composite_pipeline_));
+
+  vkDestroyShaderModule(logical_device, vertex_shader, /* pAllocator=*/nullptr);
+  vkDestroyShaderModule(logical_device, fragment_shader,
+                        /* pAllocator=*/nullptr);
+}
+
+void EdgeDetectionRenderer::CreateEdgeImages(VkExtent2D camera_extent) {
+  camera_extent_ = camera_extent;
+  edge_extent_ = {GetEdgeSize(camera_extent.width),
+                  GetEdgeSize(camera_extent.height)};
+  VkDevice logical_device = vulkan_handler_->GetLogicalDevice();
+  edge_images_.resize(vulkan_handler_->GetMaxFramesInFlight());
+  for (EdgeImage& edge_image : edge_images_) {
+    const VkImageCreateInfo image_create_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .flags = 0,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = kEdgeFormat,
+        .extent = {edge_extent_.width, edge_extent_.height, 1u},
+        .mipLevels = 1u,
+        .arrayLayers = 1u,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = 0,
+        .pQueueFamilyIndices = nullptr,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+    vulkan_handler_->CreateImage(image_create_info, edge_image.image,
+                                 edge_image.allocation);
+
+    const VkImageViewCreateInfo view_create_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .flags = 0,
+        .image = edge_image.image,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = kEdgeFormat,
+        .components =
+            {
+                VK_COMPONENT_SWIZZLE_IDENTITY,
+                VK_COMPONENT_SWIZZLE_IDENTITY,
+                VK_COMPONENT_SWIZZLE_IDENTITY,
+                VK_COMPONENT_SWIZZLE_IDENTITY,
+            },
+        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+    };
+    CALL_VK(vkCreateImageView(logical_device, &view_create_info,
+                              /* pAllocator=*/nullptr,
+                              &edge_image.image_view));
+  }
+  LOGI("EdgeDetectionRenderer: %ux%u edges of a %ux%u camera image.",
+       edge_extent_.width, edge_extent_.height, camera_extent.width,
+       camera_extent.height);
+}
+
+void EdgeDetectionRenderer::DestroyEdgeImages() {
+  VkDevice logical_device = vulkan_handler_->GetLogicalDevice();
+  for (const EdgeImage& edge_image : edge_images_) {
+    vkDestroyImageView(logical_device, edge_image.image_view,
+                       /* pAllocator=*/nullptr);
+    vulkan_handler_->DestroyImage(edge_image.image, edge_image.allocation);
+  }
+  edge_images_.clear();
+}
+
+}  // namespace simple_vulkan
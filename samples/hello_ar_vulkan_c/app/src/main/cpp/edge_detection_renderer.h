@@ -0,0 +1,105 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_SIMPLE_VULKAN_EDGE_DETECTION_RENDERER_H_
+#define C_ARCORE_SIMPLE_VULKAN_EDGE_DETECTION_RENDERER_H_
+
+#include <vector>
+
+#include "android_vulkan_loader.h"
+#include "vulkan_handler.h"
+#include "vulkan_memory_allocator.h"
+
+namespace simple_vulkan {
+
+// EdgeDetectionRenderer runs a Sobel filter over the camera image in a compute
+// shader and blends the edges over the background. The shader samples the
+// imported camera image through the YCbCr conversion of the background, so
+// the frame is never copied to the CPU.
+//
+// The edges are written at half the resolution of the camera image into a
+// storage image per frame in flight, and pipeline barriers order the
+// dispatch before the render pass that samples them.
+class EdgeDetectionRenderer {
+ public:
+  // The handler must outlive the renderer.
+  explicit EdgeDetectionRenderer(VulkanHandler* vulkan_handler);
+  ~EdgeDetectionRenderer();
+
+  EdgeDetectionRenderer(const EdgeDetectionRenderer&) = delete;
+  EdgeDetectionRenderer& operator=(const EdgeDetectionRenderer&) = delete;
+
+  // Records the filter of |camera_image| into the primary command buffer of
+  // the frame, between VulkanHandler::BeginRecordingCommandBuffer() and
+  // BeginRenderPass(), and after VulkanHandler::WaitForFrame() for the frame.
+  //
+  // @param current_frame the index of current frame in the flight.
+  // @param camera_image the camera image of the frame.
+  void Dispatch(int current_frame,
+                const VulkanHandler::CameraImage& camera_image);
+
+  // Records the draw of the edges of the frame into |command_buffer|, a
+  // content command buffer of the frame from VulkanHandler::RecordContent().
+  // Can run on any thread. Does nothing if Dispatch() was not called for the
+  // frame.
+  //
+  // @param current_frame the index of current frame in the flight.
+  // @param command_buffer the command buffer to record into.
+  // @param vertices the corners of the background, top left, top right,
+  // bottom right and bottom left, since the edges map onto the camera image
+  // the same way.
+  void Draw(int current_frame, VkCommandBuffer command_buffer,
+            const VulkanHandler::VertexInfo* vertices);
+
+ private:
+  struct EdgeImage {
+    VkImage image = VK_NULL_HANDLE;
+    VulkanMemoryAllocator::Allocation allocation;
+    VkImageView image_view = VK_NULL_HANDLE;
+  };
+
+  // The compute pipeline needs the camera sampler, which only exists once a
+  // camera image was imported.
+  void CreateComputePipeline(VkDevice logical_device, VkSampler camera_sampler);
+  void CreateCompositePipeline(VkDevice logical_device);
+  void CreateEdgeImages(VkExtent2D camera_extent);
+  void DestroyEdgeImages();
+
+  VulkanHandler* const vulkan_handler_;
+
+  VkDescriptorSetLayout compute_set_layout_ = VK_NULL_HANDLE;
+  VkDescriptorUpdateTemplate compute_template_ = VK_NULL_HANDLE;
+  VkPipelineLayout compute_pipeline_layout_ = VK_NULL_HANDLE;
+  VkPipeline compute_pipeline_ = VK_NULL_HANDLE;
+
+  VkSampler edge_sampler_ = VK_NULL_HANDLE;
+  VkDescriptorSetLayout composite_set_layout_ = VK_NULL_HANDLE;
+  VkDescriptorUpdateTemplate composite_template_ = VK_NULL_HANDLE;
+  VkPipelineLayout composite_pipeline_layout_ = VK_NULL_HANDLE;
+  VkPipeline composite_pipeline_ = VK_NULL_HANDLE;
+
+  // Size of the camera image the edge images were created for, and theirs.
+  VkExtent2D camera_extent_ = {};
+  VkExtent2D edge_extent_ = {};
+  // One per frame in flight.
+  std::vector<EdgeImage> edge_images_;
+  // The set Draw() binds, written by Dispatch() and cleared by Draw().
+  std::vector<VkDescriptorSet> composite_sets_;
+};
+
+}  // namespace simple_vulkan
+
+#endif  // C_ARCORE_SIMPLE_VULKAN_EDGE_DETECTION_RENDERER_H_
@@ -30,6 +30,10 @@ namespace {
 // maintain a reference to the JVM so we can use it later.
 static JavaVM *g_vm = nullptr;
 
+// The JNIEnv of the current thread, so that GetJniEnv() only goes through
+// the JVM on a thread's first call.
+thread_local JNIEnv *t_env = nullptr;
+
 inline jlong jptr(
     simple_vulkan::SimpleVulkanApplication *native_simple_vulkan_application) {
   return reinterpret_cast<intptr_t>(native_simple_vulkan_application);
@@ -47,9 +51,13 @@ jint JNI_OnLoad(JavaVM *vm, void *) {
 }
 
 JNI_METHOD(jlong, createNativeApplication)
-(JNIEnv *env, jclass, jobject j_asset_manager) {
+(JNIEnv *env, jclass, jobject j_asset_manager, jstring j_cache_dir) {
   AAssetManager *asset_manager = AAssetManager_fromJava(env, j_asset_manager);
-  return jptr(new simple_vulkan::SimpleVulkanApplication(asset_manager));
+  const char *cache_dir = env->GetStringUTFChars(j_cache_dir, nullptr);
+  simple_vulkan::SimpleVulkanApplication *application =
+      new simple_vulkan::SimpleVulkanApplication(asset_manager, cache_dir);
+  env->ReleaseStringUTFChars(j_cache_dir, cache_dir);
+  return jptr(application);
 }
 
 JNI_METHOD(void, destroyNativeApplication)
@@ -85,10 +93,60 @@ JNI_METHOD(void, onSurfaceDrawFrame)
   native(native_application)->OnDrawFrame();
 }
 
+JNI_METHOD(void, onTouched)
+(JNIEnv *, jclass, jlong native_application, jfloat x, jfloat y) {
+  native(native_application)->OnTouched(x, y);
+}
+
+JNI_METHOD(jfloatArray, getRenderPassGpuStats)
+(JNIEnv *env, jclass, jlong native_application) {
+  const simple_vulkan::VulkanHandler::GpuTimeStats stats =
+      native(native_application)->GetRenderPassGpuStats();
+  const jfloat values[4] = {stats.min_ms, stats.avg_ms, stats.p95_ms,
+                            static_cast<jfloat>(stats.sample_count)};
+  jfloatArray result = env->NewFloatArray(4);
+  if (result != nullptr) {
+    env->SetFloatArrayRegion(result, 0, 4, values);
+  }
+  return result;
+}
+
+JNI_METHOD(void, setLowLatencyPacing)
+(JNIEnv *, jclass, jlong native_application, jboolean enabled) {
+  using PacingMode = simple_vulkan::VulkanHandler::PacingMode;
+  native(native_application)
+      ->SetPacingMode(enabled ? PacingMode::kLowLatency
+                              : PacingMode::kThroughput);
+}
+
+JNI_METHOD(jboolean, startPlaybackBenchmark)
+(JNIEnv *env, jclass, jlong native_application, jstring j_dataset_uri,
+ jstring j_csv_path) {
+  const char *dataset_uri = env->GetStringUTFChars(j_dataset_uri, nullptr);
+  const char *csv_path = env->GetStringUTFChars(j_csv_path, nullptr);
+  const bool started = native(native_application)
+                           ->StartPlaybackBenchmark(dataset_uri, csv_path);
+  env->ReleaseStringUTFChars(j_csv_path, csv_path);
+  env->ReleaseStringUTFChars(j_dataset_uri, dataset_uri);
+  return static_cast<jboolean>(started ? JNI_TRUE : JNI_FALSE);
+}
+
+JNI_METHOD(jboolean, isPlaybackBenchmarkFinished)
+(JNIEnv *, jclass, jlong native_application) {
+  return static_cast<jboolean>(
+      native(native_application)->IsPlaybackBenchmarkFinished() ? JNI_TRUE
+                                                                : JNI_FALSE);
+}
+
 JNIEnv *GetJniEnv() {
-  JNIEnv *env;
-  jint result = g_vm->AttachCurrentThread(&env, nullptr);
-  return result == JNI_OK ? env : nullptr;
+  if (t_env == nullptr) {
+    JNIEnv *env = nullptr;
+    if (g_vm->AttachCurrentThread(&env, nullptr) != JNI_OK) {
+      return nullptr;
+    }
+    t_env = env;
+  }
+  return t_env;
 }
 
 jclass FindClass(const char *classname) {
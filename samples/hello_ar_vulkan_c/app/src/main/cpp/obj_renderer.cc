@@ -0,0 +1,464 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "obj_renderer.h"
+
+#include <cstddef>
+#include <cstring>
+
+#include "../assets/shaders/object_frag.spv.h"
+#include "../assets/shaders/object_vert.spv.h"
+#include "util.h"
+
+namespace simple_vulkan {
+namespace {
+// Light from above, in world space.
+const glm::vec4 kLightDirection(0.0f, 1.0f, 0.0f, 0.0f);
+// Ambient, diffuse, specular and specular power of the material.
+const glm::vec4 kMaterialParameters(0.0f, 2.0f, 0.5f, 6.0f);
+
+// The least minUniformBufferOffsetAlignment devices may require.
+constexpr VkDeviceSize kUniformAlignment = 256;
+
+// Matches the FrameUniforms block of object.vert and object.frag.
+struct FrameUniforms {
+  glm::mat4 view;
+  glm::mat4 view_projection;
+  glm::vec4 lighting_parameters;
+  glm::vec4 material_parameters;
+  glm::vec4 color_correction_parameters;
+};
+static_assert(offsetof(FrameUniforms, lighting_parameters) == 128,
+              "Unexpected layout");
+static_assert(sizeof(FrameUniforms) == 176, "Unexpected layout");
+
+// Matches the PushConstants block of object.vert and object.frag.
+struct PushConstants {
+  glm::mat4 model;
+  glm::vec4 color;
+};
+static_assert(offsetof(PushConstants, color) == 64, "Unexpected layout");
+
+// What the template of the frame set writes, in the order of the bindings.
+struct FrameDescriptors {
+  VkDescriptorBufferInfo uniforms;
+  VkDescriptorImageInfo texture;
+};
+}  // namespace
+
+ObjRenderer::ObjRenderer(VulkanHandler* vulkan_handler,
+                         AAssetManager* asset_manager,
+                         const char* obj_file_name, const char* png_file_name)
+    : vulkan_handler_(vulkan_handler), texture_(vulkan_handler, png_file_name) {
+  LoadMesh(asset_manager, obj_file_name);
+  VkDevice logical_device = vulkan_handler_->GetLogicalDevice();
+  CreateFrameSetLayout(logical_device);
+  pipeline_layout_ = CreatePipelineLayout(logical_device);
+  pipeline_ = CreatePipeline(logical_device, pipeline_layout_);
+}
+
+ObjRenderer::~ObjRenderer() {
+  vulkan_handler_->WaitForAllFrames();
+  VkDevice logical_device = vulkan_handler_->GetLogicalDevice();
+  vkDestroyPipeline(logical_device, pipeline_, /* pAllocator=*/nullptr);
+  vkDestroyPipelineLayout(logical_device, pipeline_layout_,
+                          /* pAllocator=*/nullptr);
+  vkDestroyDescriptorUpdateTemplate(logical_device, frame_template_,
+                                    /* pAllocator=*/nullptr);
+  vkDestroyDescriptorSetLayout(logical_device, frame_set_layout_,
+                               /* pAllocator=*/nullptr);
+  vkDestroySampler(logical_device, sampler_, /* pAllocator=*/nullptr);
+  if (mesh_buffer_ != VK_NULL_HANDLE) {
+    vulkan_handler_->DestroyBuffer(mesh_buffer_, mesh_allocation_);
+  }
+}
+
+void ObjRenderer::LoadMesh(AAssetManager* asset_manager,
+                           const char* obj_file_name) {
+  std::vector<util::ObjVertex> vertices;
+  std::vector<uint16_t> indices;
+  if (!util::LoadObjFile(obj_file_name, asset_manager, &vertices, &indices) ||
+      indices.empty()) {
+    LOGE("Could not load the mesh %s", obj_file_name);
+    return;
+  }
+
+  // The mesh never changes, so unlike the streamed points it lives in device
+  // local memory, the vertices followed by the indices.
+  const VkDeviceSize vertices_size = vertices.size() * sizeof(util::ObjVertex);
+  const VkDeviceSize indices_size = indices.size() * sizeof(uint16_t);
+  vulkan_handler_->CreateBuffer(
+      vertices_size + indices_size,
+      VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+          VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mesh_buffer_, mesh_allocation_);
+  vulkan_handler_->UploadToBuffer(mesh_buffer_, /* offset=*/0,
+                                  vertices.data(), vertices_size,
+                                  VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                                  VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+  vulkan_handler_->UploadToBuffer(mesh_buffer_, vertices_size, indices.data(),
+                                  indices_size,
+                                  VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                                  VK_ACCESS_INDEX_READ_BIT);
+  index_offset_ = vertices_size;
+  index_count_ = indices.size();
+}
+
+void ObjRenderer::Draw(int current_frame, VkCommandBuffer command_buffer,
+                       const glm::mat4& view_mat,
+                       const glm::mat4& view_projection_mat,
+                       const glm::vec4& color_correction,
+                       const std::vector<Instance>& instances) {
+  if (instances.empty() || index_count_ == 0 || !texture_.IsLoaded()) {
+    return;
+  }
+
+  VkBuffer uniform_buffer;
+  VkDeviceSize uniform_offset;
+  void* uniform_data;
+  if (!vulkan_handler_->AllocateFrameData(current_frame, sizeof(FrameUniforms),
+                                          kUniformAlignment, &uniform_buffer,
+                                          &uniform_offset, &uniform_data)) {
+    return;
+  }
+  // The light direction in view space. The fourth component is unused.
+  glm::vec4 view_light_direction = glm::normalize(view_mat * kLightDirection);
+  view_light_direction.w = 1.0f;
+  const FrameUniforms uniforms = {
+      .view = view_mat,
+      .view_projection = view_projection_mat,
+      .lighting_parameters = view_light_direction,
+      .material_parameters = kMaterialParameters,
+      .color_correction_parameters = color_correction,
+  };
+  memcpy(uniform_data, &uniforms, sizeof(uniforms));
+
+  const VkDescriptorSet frame_set = vulkan_handler_->AllocateFrameDescriptorSet(
+      current_frame, frame_set_layout_);
+  if (frame_set == VK_NULL_HANDLE) {
+    return;
+  }
+  const FrameDescriptors descriptors = {
+      .uniforms =
+          {
+              .buffer = uniform_buffer,
+              .offset = uniform_offset,
+              .range = sizeof(FrameUniforms),
+          },
+      .texture =
+          {
+              .sampler = VK_NULL_HANDLE,
+              .imageView = texture_.GetImageView(),
+              .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+          },
+  };
+  vkUpdateDescriptorSetWithTemplate(vulkan_handler_->GetLogicalDevice(),
+                                    frame_set, frame_template_, &descriptors);
+
+  const VkExtent2D extent = vulkan_handler_->GetExtent();
+  const VkViewport viewport = {
+      .x = 0,
+      .y = 0,
+      .width = static_cast<float>(extent.width),
+      .height = static_cast<float>(extent.height),
+      .minDepth = 0.0,
+      .maxDepth = 1.0};
+  const VkRect2D scissor = {.offset = {0, 0}, .extent = extent};
+
+  vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    pipeline_);
+  vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+  vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+  vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          pipeline_layout_, /* firstSet=*/0, 1, &frame_set,
+                          /* dynamicOffsetCount=*/0, nullptr);
+  const VkDeviceSize vertex_offset = 0;
+  vkCmdBindVertexBuffers(command_buffer, 0, 1, &mesh_buffer_, &vertex_offset);
+  vkCmdBindIndexBuffer(command_buffer, mesh_buffer_, index_offset_,
+                       VK_INDEX_TYPE_UINT16);
+
+  for (const Instance& instance : instances) {
+    const PushConstants push_constants = {
+        .model = instance.model_mat,
+        .color = instance.color,
+    };
+    vkCmdPushConstants(
+        command_buffer, pipeline_layout_,
+        VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+        /* offset=*/0, sizeof(push_constants), &push_constants);
+    vkCmdDrawIndexed(command_buffer, index_count_, /* instanceCount=*/1,
+                     /* firstIndex=*/0, /* vertexOffset=*/0,
+                     /* firstInstance=*/0);
+  }
+}
+
+void ObjRenderer::CreateFrameSetLayout(VkDevice logical_device) {
+  const VkSamplerCreateInfo sampler_create_info = {
+      .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+      .magFilter = VK_FILTER_LINEAR,
+      .minFilter = VK_FILTER_LINEAR,
+      .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+      .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+      .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+      .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+      .mipLodBias = 0.0f,
+      .anisotropyEnable = VK_FALSE,
+      .maxAnisotropy = 1,
+      .compareEnable = VK_FALSE,
+      .compareOp = VK_COMPARE_OP_NEVER,
+      .minLod = 0.0f,
+      .maxLod = 0.0f,
+      .borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK,
+      .unnormalizedCoordinates = VK_FALSE,
+  };
+  CALL_VK(vkCreateSampler(logical_device, &sampler_create_info,
+                          /* pAllocator=*/nullptr, &sampler_));
+
+  const VkDescriptorSetLayoutBinding bindings[2] = {
+      {
+          .binding = 0,
+          .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+          .descriptorCount = 1,
+          .stageFlags =
+              VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+          .pImmutableSamplers = nullptr,
+      },
+      {
+          .binding = 1,
+          .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+          .descriptorCount = 1,
+          .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+          .pImmutableSamplers = &sampler_,
+      },
+  };
+  const VkDescriptorSetLayoutCreateInfo layout_info = {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+      .bindingCount = 2,
+      .pBindings = bindings,
+  };
+  CALL_VK(vkCreateDescriptorSetLayout(logical_device, &layout_info,
+                                      /* pAllocator=*/nullptr,
+                                      &frame_set_layout_));
+  frame_template_ = vulkan_handler_->CreateDescriptorUpdateTemplate(
+      frame_set_layout_,
+      {
+          {
+              .dstBinding = 0,
+              .dstArrayElement = 0,
+              .descriptorCount = 1,
+              .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+              .offset = offsetof(FrameDescriptors, uniforms),
+              .stride = sizeof(VkDescriptorBufferInfo),
+          },
+          {
+              .dstBinding = 1,
+              .dstArrayElement = 0,
+              .descriptorCount = 1,
+              .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+              .offset = offsetof(FrameDescriptors, texture),
+              .stride = sizeof(VkDescriptorImageInfo),
+          },
+      });
+}
+
+VkPipelineLayout ObjRenderer::CreatePipelineLayout(VkDevice logical_device) {
+  VkPipelineLayout pipeline_layout;
+  // Both stages declare the whole block.
+  const VkPushConstantRange push_constant_range = {
+      .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+      .offset = 0,
+      .size = sizeof(PushConstants),
+  };
+  const VkPipelineLayoutCreateInfo pipeline_layout_create_info{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+      .setLayoutCount = 1,
+      .pSetLayouts = &frame_set_layout_,
+      .pushConstantRangeCount = 1,
+      .pPushConstantRanges = &push_constant_range,
+  };
+  CALL_VK(vkCreatePipelineLayout(logical_device, &pipeline_layout_create_info,
+                                 /* pAllocator=*/nullptr, &pipeline_layout));
+  return pipeline_layout;
+}
+
+VkPipeline ObjRenderer::CreatePipeline(VkDevice logical_device,
+                                       VkPipelineLayout pipeline_layout) {
+  VkPipeline pipeline;
+
+  VkShaderModule vertex_shader = vulkan_handler_->LoadShader(
+      logical_device, object_vert, sizeof(object_vert));
+  VkShaderModule fragment_shader = vulkan_handler_->LoadShader(
+      logical_device, object_frag, sizeof(object_frag));
+
+  const VkPipelineShaderStageCreateInfo shader_stages[2] = {
+      {
+          .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+          .flags = 0,
+          .stage = VK_SHADER_STAGE_VERTEX_BIT,
+          .module = vertex_shader,
+          .pName = "main",
+          .pSpecializationInfo = nullptr,
+      },
+      {
+          .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+          .flags = 0,
+          .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+          .module = fragment_shader,
+          .pName = "main",
+          .pSpecializationInfo = nullptr,
+      },
+  };
+
+  const VkPipelineViewportStateCreateInfo viewport_info{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+      .viewportCount = 1,
+      .pViewports = nullptr,
+      .scissorCount = 1,
+      .pScissors = nullptr,
+  };
+
+  const VkSampleMask sample_mask = ~0u;
+  const VkPipelineMultisampleStateCreateInfo multisample_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+      .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+      .sampleShadingEnable = VK_FALSE,
+      .minSampleShading = 0,
+      .pSampleMask = &sample_mask,
+      .alphaToCoverageEnable = VK_FALSE,
+      .alphaToOneEnable = VK_FALSE,
+  };
+
+  const VkPipelineColorBlendAttachmentState attachment_states = {
+      .blendEnable = VK_FALSE,
+      .srcColorBlendFactor = VK_BLEND_FACTOR_ONE,
+      .dstColorBlendFactor = VK_BLEND_FACTOR_ZERO,
+      .colorBlendOp = VK_BLEND_OP_ADD,
+      .srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+      .dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
+      .alphaBlendOp = VK_BLEND_OP_ADD,
+      .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                        VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+  };
+  const VkPipelineColorBlendStateCreateInfo color_blend_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+      .flags = 0,
+      .logicOpEnable = VK_FALSE,
+      .logicOp = VK_LOGIC_OP_COPY,
+      .attachmentCount = 1,
+      .pAttachments = &attachment_states,
+  };
+
+  // The winding of OBJ files is not reliable, so nothing is culled, as in
+  // hello_ar_c.
+  const VkPipelineRasterizationStateCreateInfo raster_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+      .depthClampEnable = VK_FALSE,
+      .rasterizerDiscardEnable = VK_FALSE,
+      .polygonMode = VK_POLYGON_MODE_FILL,
+      .cullMode = VK_CULL_MODE_NONE,
+      .frontFace = VK_FRONT_FACE_CLOCKWISE,
+      .depthBiasEnable = VK_FALSE,
+      .lineWidth = 1,
+  };
+
+  const VkPipelineInputAssemblyStateCreateInfo input_assembly_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+      .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+      .primitiveRestartEnable = VK_FALSE,
+  };
+
+  const VkVertexInputBindingDescription vertex_input_binding = {
+      .binding = 0,
+      .stride = sizeof(util::ObjVertex),
+      .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+  };
+  const VkVertexInputAttributeDescription vertex_input_attributes[3] = {
+      {
+          .location = 0,
+          .binding = 0,
+          .format = VK_FORMAT_R32G32B32_SFLOAT,
+          .offset = offsetof(util::ObjVertex, position),
+      },
+      {
+          .location = 1,
+          .binding = 0,
+          .format = VK_FORMAT_R32G32B32_SFLOAT,
+          .offset = offsetof(util::ObjVertex, normal),
+      },
+      {
+          .location = 2,
+          .binding = 0,
+          .format = VK_FORMAT_R32G32_SFLOAT,
+          .offset = offsetof(util::ObjVertex, uv),
+      },
+  };
+  const VkPipelineVertexInputStateCreateInfo vertex_input_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+      .vertexBindingDescriptionCount = 1,
+      .pVertexBindingDescriptions = &vertex_input_binding,
+      .vertexAttributeDescriptionCount = 3,
+      .pVertexAttributeDescriptions = vertex_input_attributes,
+  };
+
+  const VkDynamicState dynamic_state_enables[2] = {
+      VK_DYNAMIC_STATE_VIEWPORT,
+      VK_DYNAMIC_STATE_SCISSOR,
+  };
+  const VkPipelineDynamicStateCreateInfo dynamic_state_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+      .dynamicStateCount = 2,
+      .pDynamicStates = dynamic_state_enables};
+
+  const VkPipelineDepthStencilStateCreateInfo depth_stencil = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+      .depthTestEnable = VK_TRUE,
+      .depthWriteEnable = VK_TRUE,
+      .depthCompareOp = VK_COMPARE_OP_LESS,
+      .depthBoundsTestEnable = VK_FALSE,
+      .stencilTestEnable = VK_FALSE};
+
+  const VkGraphicsPipelineCreateInfo pipeline_create_info = {
+      .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+      .flags = 0,
+      .stageCount = 2,
+      .pStages = shader_stages,
+      .pVertexInputState = &vertex_input_info,
+      .pInputAssemblyState = &input_assembly_info,
+      .pTessellationState = nullptr,
+      .pViewportState = &viewport_info,
+      .pRasterizationState = &raster_info,
+      .pMultisampleState = &multisample_info,
+      .pDepthStencilState = &depth_stencil,
+      .pColorBlendState = &color_blend_info,
+      .pDynamicState = &dynamic_state_info,
+      .layout = pipeline_layout,
+      .renderPass = vulkan_handler_->GetRenderPass(),
+      .subpass = 0,
+      .basePipelineHandle = VK_NULL_HANDLE,
+      .basePipelineIndex = 0,
+  };
+  CALL_VK(vkCreateGraphicsPipelines(
+      logical_device, vulkan_handler_->GetPipelineCache(), 1,
+      &pipeline_create_info, /* pAllocator=*/nullptr, &pipeline));
+
+  vkDestroyShaderModule(logical_device, vertex_shader, /* pAllocator=*/nullptr);
+  vkDestroyShaderModule(logical_device, fragment_shader,
+                        /* pAllocator=*/nullptr);
+
+  return pipeline;
+}
+
+}  // namespace simple_vulkan
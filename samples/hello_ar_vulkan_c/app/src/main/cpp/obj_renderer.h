@@ -0,0 +1,103 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_SIMPLE_VULKAN_OBJ_RENDERER_H_
+#define C_ARCORE_SIMPLE_VULKAN_OBJ_RENDERER_H_
+
+#include <android/asset_manager.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "android_vulkan_loader.h"
+#include "glm.h"
+#include "texture.h"
+#include "vulkan_handler.h"
+#include "vulkan_memory_allocator.h"
+
+namespace simple_vulkan {
+
+// ObjRenderer draws copies of a textured OBJ mesh into the render pass of a
+// VulkanHandler, lit like the objects of hello_ar_c.
+//
+// The mesh is uploaded once into device local buffers. The camera and the
+// lighting are shared by all copies through a uniform buffer in the frame
+// data of the handler, and only the model matrix and color of each copy are
+// pushed with its draw.
+class ObjRenderer {
+ public:
+  // One copy of the mesh.
+  struct Instance {
+    glm::mat4 model_mat;
+    // In [0, 255]. The texture is tinted by the color if its alpha is 255.
+    glm::vec4 color;
+  };
+
+  // The handler must outlive the renderer. Loads |obj_file_name| and
+  // |png_file_name|, relative to the assets folder. Nothing is drawn if
+  // either cannot be loaded.
+  ObjRenderer(VulkanHandler* vulkan_handler, AAssetManager* asset_manager,
+              const char* obj_file_name, const char* png_file_name);
+  ~ObjRenderer();
+
+  ObjRenderer(const ObjRenderer&) = delete;
+  ObjRenderer& operator=(const ObjRenderer&) = delete;
+
+  // Records the draw of |instances| into |command_buffer|, a content command
+  // buffer of the frame from VulkanHandler::RecordContent(). Can run on any
+  // thread.
+  //
+  // The uniforms are copied into the frame data of the handler, so this must
+  // be called after VulkanHandler::WaitForFrame() for the frame.
+  //
+  // @param current_frame the index of current frame in the flight.
+  // @param command_buffer the command buffer to record into.
+  // @param view_mat the view matrix of the camera.
+  // @param view_projection_mat the view projection matrix, in Vulkan clip
+  // space.
+  // @param color_correction the color correction of the light estimate.
+  // @param instances the copies to draw.
+  void Draw(int current_frame, VkCommandBuffer command_buffer,
+            const glm::mat4& view_mat, const glm::mat4& view_projection_mat,
+            const glm::vec4& color_correction,
+            const std::vector<Instance>& instances);
+
+ private:
+  void LoadMesh(AAssetManager* asset_manager, const char* obj_file_name);
+  void CreateFrameSetLayout(VkDevice logical_device);
+  VkPipelineLayout CreatePipelineLayout(VkDevice logical_device);
+  VkPipeline CreatePipeline(VkDevice logical_device,
+                            VkPipelineLayout pipeline_layout);
+
+  VulkanHandler* const vulkan_handler_;
+  Texture texture_;
+
+  // Vertices followed by the indices, see LoadMesh().
+  VkBuffer mesh_buffer_ = VK_NULL_HANDLE;
+  VulkanMemoryAllocator::Allocation mesh_allocation_;
+  VkDeviceSize index_offset_ = 0;
+  uint32_t index_count_ = 0;
+
+  VkSampler sampler_ = VK_NULL_HANDLE;
+  VkDescriptorSetLayout frame_set_layout_ = VK_NULL_HANDLE;
+  VkDescriptorUpdateTemplate frame_template_ = VK_NULL_HANDLE;
+  VkPipelineLayout pipeline_layout_ = VK_NULL_HANDLE;
+  VkPipeline pipeline_ = VK_NULL_HANDLE;
+};
+
+}  // namespace simple_vulkan
+
+#endif  // C_ARCORE_SIMPLE_VULKAN_OBJ_RENDERER_H_
@@ -0,0 +1,509 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "plane_renderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+
+#include "../assets/shaders/plane_frag.spv.h"
+#include "../assets/shaders/plane_vert.spv.h"
+#include "util.h"
+
+namespace simple_vulkan {
+namespace {
+constexpr char kTexturePath[] = "models/trigrid.png";
+
+// Feather distance 0.2 meters.
+constexpr float kFeatherLength = 0.2f;
+// Feather scale over the distance between plane center and vertices.
+constexpr float kFeatherScale = 0.2f;
+
+// Density of the dots of the grid, and the height of its equilateral
+// triangles relative to their width.
+constexpr float kDotsPerMeter = 10.0f;
+const float kEquilateralTriangleScale = 1.0f / std::sqrt(3.0f);
+// Rotation of the grid of each plane relative to the previous one, so that
+// overlapping planes do not line up.
+constexpr float kPlaneAngleRadians = 0.144f;
+
+// Matches the PushConstants block of plane.vert. The view projection is
+// pushed once per draw, the rest once per plane.
+struct PushConstants {
+  glm::mat4 view_projection;
+  glm::vec4 normal;
+  glm::vec4 plane_uv_matrix;
+};
+constexpr uint32_t kPlanePushConstantsOffset =
+    offsetof(PushConstants, normal);
+static_assert(kPlanePushConstantsOffset == 64, "Unexpected layout");
+static_assert(offsetof(PushConstants, plane_uv_matrix) == 80,
+              "Unexpected layout");
+
+// Matches the PushConstants block of plane.frag, which follows that of the
+// vertex shader.
+constexpr uint32_t kGridControlOffset = 96;
+static_assert(sizeof(PushConstants) <= kGridControlOffset,
+              "Overlapping push constants");
+// dotThreshold, lineThreshold, lineFadeShrink, occlusionShrink
+const glm::vec4 kGridControl(0.2f, 0.4f, 2.0f, 1.5f);
+}  // namespace
+
+PlaneRenderer::PlaneRenderer(VulkanHandler* vulkan_handler)
+    : vulkan_handler_(vulkan_handler), texture_(vulkan_handler, kTexturePath) {
+  VkDevice logical_device = vulkan_handler_->GetLogicalDevice();
+  CreateTextureSetLayout(logical_device);
+  pipeline_layout_ = CreatePipelineLayout(logical_device);
+  pipeline_ = CreatePipeline(logical_device, pipeline_layout_);
+}
+
+PlaneRenderer::~PlaneRenderer() {
+  vulkan_handler_->WaitForAllFrames();
+  VkDevice logical_device = vulkan_handler_->GetLogicalDevice();
+  vkDestroyPipeline(logical_device, pipeline_, /* pAllocator=*/nullptr);
+  vkDestroyPipelineLayout(logical_device, pipeline_layout_,
+                          /* pAllocator=*/nullptr);
+  vkDestroyDescriptorUpdateTemplate(logical_device, texture_template_,
+                                    /* pAllocator=*/nullptr);
+  vkDestroyDescriptorSetLayout(logical_device, texture_set_layout_,
+                               /* pAllocator=*/nullptr);
+  vkDestroySampler(logical_device, sampler_, /* pAllocator=*/nullptr);
+}
+
+void PlaneRenderer::Draw(int current_frame, VkCommandBuffer command_buffer,
+                         const glm::mat4& view_projection_mat,
+                         const ArSession* ar_session,
+                         const std::vector<ArPlane*>& planes) {
+  if (!texture_.IsLoaded()) {
+    return;
+  }
+  vertices_.clear();
+  indices_.clear();
+  meshes_.clear();
+  for (size_t i = 0; i < planes.size(); ++i) {
+    AppendPlaneMesh(ar_session, planes[i], i);
+  }
+  if (meshes_.empty()) {
+    return;
+  }
+
+  // Like the points, the meshes change every frame and are read once, so
+  // they are written straight into host visible memory.
+  const VkDeviceSize vertices_size = vertices_.size() * sizeof(glm::vec4);
+  const VkDeviceSize indices_size = indices_.size() * sizeof(uint16_t);
+  VkBuffer vertex_buffer;
+  VkDeviceSize vertex_offset;
+  void* vertex_data;
+  VkBuffer index_buffer;
+  VkDeviceSize index_offset;
+  void* index_data;
+  if (!vulkan_handler_->AllocateFrameData(current_frame, vertices_size,
+                                          sizeof(float), &vertex_buffer,
+                                          &vertex_offset, &vertex_data) ||
+      !vulkan_handler_->AllocateFrameData(current_frame, indices_size,
+                                          sizeof(uint16_t), &index_buffer,
+                                          &index_offset, &index_data)) {
+    return;
+  }
+  memcpy(vertex_data, vertices_.data(), vertices_size);
+  memcpy(index_data, indices_.data(), indices_size);
+
+  const VkDescriptorSet texture_set =
+      vulkan_handler_->AllocateFrameDescriptorSet(current_frame,
+                                                  texture_set_layout_);
+  if (texture_set == VK_NULL_HANDLE) {
+    return;
+  }
+  const VkDescriptorImageInfo texture_image = {
+      .sampler = VK_NULL_HANDLE,
+      .imageView = texture_.GetImageView(),
+      .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+  };
+  vkUpdateDescriptorSetWithTemplate(vulkan_handler_->GetLogicalDevice(),
+                                    texture_set, texture_template_,
+                                    &texture_image);
+
+  const VkExtent2D extent = vulkan_handler_->GetExtent();
+  const VkViewport viewport = {
+      .x = 0,
+      .y = 0,
+      .width = static_cast<float>(extent.width),
+      .height = static_cast<float>(extent.height),
+      .minDepth = 0.0,
+      .maxDepth = 1.0};
+  const VkRect2D scissor = {.offset = {0, 0}, .extent = extent};
+
+  vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    pipeline_);
+  vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+  vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+  vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          pipeline_layout_, /* firstSet=*/0, 1, &texture_set,
+                          /* dynamicOffsetCount=*/0, nullptr);
+  vkCmdPushConstants(command_buffer, pipeline_layout_,
+                     VK_SHADER_STAGE_VERTEX_BIT, /* offset=*/0,
+                     sizeof(view_projection_mat), &view_projection_mat);
+  vkCmdPushConstants(command_buffer, pipeline_layout_,
+                     VK_SHADER_STAGE_FRAGMENT_BIT, kGridControlOffset,
+                     sizeof(kGridControl), &kGridControl);
+  vkCmdBindVertexBuffers(command_buffer, 0, 1, &vertex_buffer,
+                         &vertex_offset);
+  vkCmdBindIndexBuffer(command_buffer, index_buffer, index_offset,
+                       VK_INDEX_TYPE_UINT16);
+
+  for (const PlaneMesh& mesh : meshes_) {
+    // glm matrices are column major, as is the mat2 of the shader.
+    const float angle = mesh.plane_index * kPlaneAngleRadians;
+    const float u_scale = kDotsPerMeter;
+    const float v_scale = kDotsPerMeter * kEquilateralTriangleScale;
+    const glm::vec4 plane_push_constants[2] = {
+        glm::vec4(mesh.normal, 0.0f),
+        glm::vec4(std::cos(angle) * u_scale, -std::sin(angle) * v_scale,
+                  std::sin(angle) * u_scale, std::cos(angle) * v_scale),
+    };
+    vkCmdPushConstants(command_buffer, pipeline_layout_,
+                       VK_SHADER_STAGE_VERTEX_BIT, kPlanePushConstantsOffset,
+                       sizeof(plane_push_constants), plane_push_constants);
+    vkCmdDrawIndexed(command_buffer, mesh.index_count, /* instanceCount=*/1,
+                     mesh.first_index, mesh.vertex_offset,
+                     /* firstInstance=*/0);
+  }
+}
+
+void PlaneRenderer::AppendPlaneMesh(const ArSession* ar_session,
+                                    ArPlane* ar_plane, size_t plane_index) {
+  ArTrackingState tracking_state = AR_TRACKING_STATE_STOPPED;
+  ArTrackable_getTrackingState(ar_session, ArAsTrackable(ar_plane),
+                               &tracking_state);
+  ArPlane* subsumed_by = nullptr;
+  ArPlane_acquireSubsumedBy(ar_session, ar_plane, &subsumed_by);
+  if (subsumed_by != nullptr) {
+    ArTrackable_release(ArAsTrackable(subsumed_by));
+  }
+  if (tracking_state != AR_TRACKING_STATE_TRACKING || subsumed_by != nullptr) {
+    return;
+  }
+
+  // The following code generates a triangle mesh filling a convex polygon,
+  // including a feathered edge for blending.
+  //
+  // The indices shown in the diagram are used in comments below.
+  // _______________     0_______________1
+  // |             |      |4___________5|
+  // |             |      | |         | |
+  // |             | =>   | |         | |
+  // |             |      | |         | |
+  // |             |      |7-----------6|
+  // ---------------     3---------------2
+  int32_t polygon_length = 0;
+  ArPlane_getPolygonSize(ar_session, ar_plane, &polygon_length);
+  const int32_t vertices_size = polygon_length / 2;
+  // The indices of each plane start from its first vertex.
+  if (vertices_size < 3 ||
+      2 * vertices_size > std::numeric_limits<uint16_t>::max()) {
+    return;
+  }
+  polygon_.resize(polygon_length);
+  ArPlane_getPolygon(ar_session, ar_plane, polygon_.data());
+
+  util::ScopedArPose scoped_pose(ar_session);
+  ArPlane_getCenterPose(ar_session, ar_plane, scoped_pose.GetArPose());
+  glm::mat4 model_mat;
+  ArPose_getMatrix(ar_session, scoped_pose.GetArPose(),
+                   glm::value_ptr(model_mat));
+
+  PlaneMesh mesh;
+  mesh.normal = glm::vec3(model_mat * glm::vec4(0.0f, 1.0f, 0.0f, 0.0f));
+  mesh.plane_index = plane_index;
+  mesh.first_index = indices_.size();
+  mesh.vertex_offset = vertices_.size();
+
+  // Fill vertex 0 to 3, the polygon in the x and z of the plane, with alpha
+  // 0, then vertex 4 to 7, shrunk towards the center, with alpha 1.
+  for (int32_t i = 0; i < vertices_size; ++i) {
+    const glm::vec4 position =
+        model_mat * glm::vec4(polygon_[2 * i], 0.0f, polygon_[2 * i + 1], 1.0f);
+    vertices_.push_back(glm::vec4(glm::vec3(position), 0.0f));
+  }
+  for (int32_t i = 0; i < vertices_size; ++i) {
+    // Vector from plane center to current point.
+    const glm::vec2 v(polygon_[2 * i], polygon_[2 * i + 1]);
+    const float scale =
+        1.0f - std::min((kFeatherLength / glm::length(v)), kFeatherScale);
+    const glm::vec4 position =
+        model_mat * glm::vec4(scale * v.x, 0.0f, scale * v.y, 1.0f);
+    vertices_.push_back(glm::vec4(glm::vec3(position), 1.0f));
+  }
+
+  // Generate triangle (4, 5, 6) and (4, 6, 7).
+  const int32_t n = vertices_size;
+  for (int32_t i = n + 1; i < 2 * n - 1; ++i) {
+    indices_.push_back(n);
+    indices_.push_back(i);
+    indices_.push_back(i + 1);
+  }
+
+  // Generate triangle (0, 1, 4), (4, 1, 5), (5, 1, 2), (5, 2, 6),
+  // (6, 2, 3), (6, 3, 7), (7, 3, 0), (7, 0, 4)
+  for (int32_t i = 0; i < n; ++i) {
+    indices_.push_back(i);
+    indices_.push_back((i + 1) % n);
+    indices_.push_back(i + n);
+
+    indices_.push_back(i + n);
+    indices_.push_back((i + 1) % n);
+    indices_.push_back((i + 1) % n + n);
+  }
+
+  mesh.index_count = indices_.size() - mesh.first_index;
+  meshes_.push_back(mesh);
+}
+
+void PlaneRenderer::CreateTextureSetLayout(VkDevice logical_device) {
+  // The grid repeats over the whole plane.
+  const VkSamplerCreateInfo sampler_create_info = {
+      .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+      .magFilter = VK_FILTER_LINEAR,
+      .minFilter = VK_FILTER_LINEAR,
+      .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+      .addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+      .addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+      .addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+      .mipLodBias = 0.0f,
+      .anisotropyEnable = VK_FALSE,
+      .maxAnisotropy = 1,
+      .compareEnable = VK_FALSE,
+      .compareOp = VK_COMPARE_OP_NEVER,
+      .minLod = 0.0f,
+      .maxLod = 0.0f,
+      .borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK,
+      .unnormalizedCoordinates = VK_FALSE,
+  };
+  CALL_VK(vkCreateSampler(logical_device, &sampler_create_info,
+                          /* pAllocator=*/nullptr, &sampler_));
+
+  const VkDescriptorSetLayoutBinding binding = {
+      .binding = 0,
+      .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+      .descriptorCount = 1,
+      .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+      .pImmutableSamplers = &sampler_,
+  };
+  const VkDescriptorSetLayoutCreateInfo layout_info = {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+      .bindingCount = 1,
+      .pBindings = &binding,
+  };
+  CALL_VK(vkCreateDescriptorSetLayout(logical_device, &layout_info,
+                                      /* pAllocator=*/nullptr,
+                                      &texture_set_layout_));
+  texture_template_ = vulkan_handler_->CreateDescriptorUpdateTemplate(
+      texture_set_layout_,
+      {{
+          .dstBinding = 0,
+          .dstArrayElement = 0,
+          .descriptorCount = 1,
+          .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+          .offset = 0,
+          .stride = sizeof(VkDescriptorImageInfo),
+      }});
+}
+
+VkPipelineLayout PlaneRenderer::CreatePipelineLayout(VkDevice logical_device) {
+  VkPipelineLayout pipeline_layout;
+  const VkPushConstantRange push_constant_ranges[2] = {
+      {
+          .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+          .offset = 0,
+          .size = sizeof(PushConstants),
+      },
+      {
+          .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+          .offset = kGridControlOffset,
+          .size = sizeof(kGridControl),
+      },
+  };
+  const VkPipelineLayoutCreateInfo pipeline_layout_create_info{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+      .setLayoutCount = 1,
+      .pSetLayouts = &texture_set_layout_,
+      .pushConstantRangeCount = 2,
+      .pPushConstantRanges = push_constant_ranges,
+  };
+  CALL_VK(vkCreatePipelineLayout(logical_device, &pipeline_layout_create_info,
+                                 /* pAllocator=*/nullptr, &pipeline_layout));
+  return pipeline_layout;
+}
+
+VkPipeline PlaneRenderer::CreatePipeline(VkDevice logical_device,
+                                         VkPipelineLayout pipeline_layout) {
+  VkPipeline pipeline;
+
+  VkShaderModule vertex_shader = vulkan_handler_->LoadShader(
+      logical_device, plane_vert, sizeof(plane_vert));
+  VkShaderModule fragment_shader = vulkan_handler_->LoadShader(
+      logical_device, plane_frag, sizeof(plane_frag));
+
+  const VkPipelineShaderStageCreateInfo shader_stages[2] = {
+      {
+          .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+          .flags = 0,
+          .stage = VK_SHADER_STAGE_VERTEX_BIT,
+          .module = vertex_shader,
+          .pName = "main",
+          .pSpecializationInfo = nullptr,
+      },
+      {
+          .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+          .flags = 0,
+          .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+          .module = fragment_shader,
+          .pName = "main",
+          .pSpecializationInfo = nullptr,
+      },
+  };
+
+  const VkPipelineViewportStateCreateInfo viewport_info{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+      .viewportCount = 1,
+      .pViewports = nullptr,
+      .scissorCount = 1,
+      .pScissors = nullptr,
+  };
+
+  const VkSampleMask sample_mask = ~0u;
+  const VkPipelineMultisampleStateCreateInfo multisample_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+      .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+      .sampleShadingEnable = VK_FALSE,
+      .minSampleShading = 0,
+      .pSampleMask = &sample_mask,
+      .alphaToCoverageEnable = VK_FALSE,
+      .alphaToOneEnable = VK_FALSE,
+  };
+
+  // The shader outputs premultiplied alpha, like the textures of hello_ar_c.
+  const VkPipelineColorBlendAttachmentState attachment_states = {
+      .blendEnable = VK_TRUE,
+      .srcColorBlendFactor = VK_BLEND_FACTOR_ONE,
+      .dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+      .colorBlendOp = VK_BLEND_OP_ADD,
+      .srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
+      .dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+      .alphaBlendOp = VK_BLEND_OP_ADD,
+      .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                        VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+  };
+  const VkPipelineColorBlendStateCreateInfo color_blend_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+      .flags = 0,
+      .logicOpEnable = VK_FALSE,
+      .logicOp = VK_LOGIC_OP_COPY,
+      .attachmentCount = 1,
+      .pAttachments = &attachment_states,
+  };
+
+  // Planes are seen from both sides.
+  const VkPipelineRasterizationStateCreateInfo raster_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+      .depthClampEnable = VK_FALSE,
+      .rasterizerDiscardEnable = VK_FALSE,
+      .polygonMode = VK_POLYGON_MODE_FILL,
+      .cullMode = VK_CULL_MODE_NONE,
+      .frontFace = VK_FRONT_FACE_CLOCKWISE,
+      .depthBiasEnable = VK_FALSE,
+      .lineWidth = 1,
+  };
+
+  const VkPipelineInputAssemblyStateCreateInfo input_assembly_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+      .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+      .primitiveRestartEnable = VK_FALSE,
+  };
+
+  const VkVertexInputBindingDescription vertex_input_binding = {
+      .binding = 0,
+      .stride = sizeof(glm::vec4),
+      .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+  };
+  const VkVertexInputAttributeDescription vertex_input_attribute = {
+      .location = 0,
+      .binding = 0,
+      .format = VK_FORMAT_R32G32B32A32_SFLOAT,
+      .offset = 0,
+  };
+  const VkPipelineVertexInputStateCreateInfo vertex_input_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+      .vertexBindingDescriptionCount = 1,
+      .pVertexBindingDescriptions = &vertex_input_binding,
+      .vertexAttributeDescriptionCount = 1,
+      .pVertexAttributeDescriptions = &vertex_input_attribute,
+  };
+
+  const VkDynamicState dynamic_state_enables[2] = {
+      VK_DYNAMIC_STATE_VIEWPORT,
+      VK_DYNAMIC_STATE_SCISSOR,
+  };
+  const VkPipelineDynamicStateCreateInfo dynamic_state_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+      .dynamicStateCount = 2,
+      .pDynamicStates = dynamic_state_enables};
+
+  // The grid is drawn over the objects it is in front of, but does not hide
+  // what is drawn after it.
+  const VkPipelineDepthStencilStateCreateInfo depth_stencil = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+      .depthTestEnable = VK_TRUE,
+      .depthWriteEnable = VK_FALSE,
+      .depthCompareOp = VK_COMPARE_OP_LESS,
+      .depthBoundsTestEnable = VK_FALSE,
+      .stencilTestEnable = VK_FALSE};
+
+  const VkGraphicsPipelineCreateInfo pipeline_create_info = {
+      .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+      .flags = 0,
+      .stageCount = 2,
+      .pStages = shader_stages,
+      .pVertexInputState = &vertex_input_info,
+      .pInputAssemblyState = &input_assembly_info,
+      .pTessellationState = nullptr,
+      .pViewportState = &viewport_info,
+      .pRasterizationState = &raster_info,
+      .pMultisampleState = &multisample_info,
+      .pDepthStencilState = &depth_stencil,
+      .pColorBlendState = &color_blend_info,
+      .pDynamicState = &dynamic_state_info,
+      .layout = pipeline_layout,
+      .renderPass = vulkan_handler_->GetRenderPass(),
+      .subpass = 0,
+      .basePipelineHandle = VK_NULL_HANDLE,
+      .basePipelineIndex = 0,
+  };
+  CALL_VK(vkCreateGraphicsPipelines(
+      logical_device, vulkan_handler_->GetPipelineCache(), 1,
+      &pipeline_create_info, /* pAllocator=*/nullptr, &pipeline));
+
+  vkDestroyShaderModule(logical_device, vertex_shader, /* pAllocator=*/nullptr);
+  vkDestroyShaderModule(logical_device, fragment_shader,
+                        /* pAllocator=*/nullptr);
+
+  return pipeline;
+}
+
+}  // namespace simple_vulkan
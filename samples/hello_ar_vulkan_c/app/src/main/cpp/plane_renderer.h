@@ -0,0 +1,104 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_SIMPLE_VULKAN_PLANE_RENDERER_H_
+#define C_ARCORE_SIMPLE_VULKAN_PLANE_RENDERER_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "arcore_c_api.h"
+#include "android_vulkan_loader.h"
+#include "glm.h"
+#include "texture.h"
+#include "vulkan_handler.h"
+
+namespace simple_vulkan {
+
+// PlaneRenderer draws the planes ARCore detected into the render pass of a
+// VulkanHandler, as the triangle grid of trigrid.png fading out towards the
+// outline of each plane.
+//
+// The outlines change every frame, so the meshes of all planes are built on
+// the CPU, in world space, into the frame data of the handler, and drawn
+// with one pipeline that only the normal and grid orientation are pushed to
+// per plane. The grid is blended over the scene without writing depth.
+class PlaneRenderer {
+ public:
+  // The handler must outlive the renderer.
+  explicit PlaneRenderer(VulkanHandler* vulkan_handler);
+  ~PlaneRenderer();
+
+  PlaneRenderer(const PlaneRenderer&) = delete;
+  PlaneRenderer& operator=(const PlaneRenderer&) = delete;
+
+  // Records the draw of |planes| into |command_buffer|, a content command
+  // buffer of the frame from VulkanHandler::RecordContent(). Can run on any
+  // thread, but not concurrently with another Draw(). Planes that are not
+  // tracking or were merged into another plane are skipped.
+  //
+  // The meshes are copied into the frame data of the handler, so this must be
+  // called after VulkanHandler::WaitForFrame() for the frame.
+  //
+  // @param current_frame the index of current frame in the flight.
+  // @param command_buffer the command buffer to record into.
+  // @param view_projection_mat the view projection matrix, in Vulkan clip
+  // space.
+  // @param ar_session the session that is used to query plane data.
+  // @param planes the planes of the session.
+  void Draw(int current_frame, VkCommandBuffer command_buffer,
+            const glm::mat4& view_projection_mat, const ArSession* ar_session,
+            const std::vector<ArPlane*>& planes);
+
+ private:
+  // Vertices and indices of one plane in vertices_ and indices_.
+  struct PlaneMesh {
+    glm::vec3 normal;
+    // Position of the plane in |planes|, which rotates its grid.
+    size_t plane_index;
+    uint32_t first_index;
+    uint32_t index_count;
+    int32_t vertex_offset;
+  };
+
+  // Appends the mesh of |ar_plane| to vertices_, indices_ and meshes_, unless
+  // the plane is not drawn.
+  void AppendPlaneMesh(const ArSession* ar_session, ArPlane* ar_plane,
+                       size_t plane_index);
+  void CreateTextureSetLayout(VkDevice logical_device);
+  VkPipelineLayout CreatePipelineLayout(VkDevice logical_device);
+  VkPipeline CreatePipeline(VkDevice logical_device,
+                            VkPipelineLayout pipeline_layout);
+
+  VulkanHandler* const vulkan_handler_;
+  Texture texture_;
+  VkSampler sampler_ = VK_NULL_HANDLE;
+  VkDescriptorSetLayout texture_set_layout_ = VK_NULL_HANDLE;
+  VkDescriptorUpdateTemplate texture_template_ = VK_NULL_HANDLE;
+  VkPipelineLayout pipeline_layout_ = VK_NULL_HANDLE;
+  VkPipeline pipeline_ = VK_NULL_HANDLE;
+
+  // Scratch of Draw(), kept so that their capacity is reused. Each vertex is
+  // the world position and the alpha of the feathered outline.
+  std::vector<float> polygon_;
+  std::vector<glm::vec4> vertices_;
+  std::vector<uint16_t> indices_;
+  std::vector<PlaneMesh> meshes_;
+};
+
+}  // namespace simple_vulkan
+
+#endif  // C_ARCORE_SIMPLE_VULKAN_PLANE_RENDERER_H_
@@ -0,0 +1,63 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_SIMPLE_VULKAN_PLAYBACK_BENCHMARK_H_
+#define C_ARCORE_SIMPLE_VULKAN_PLAYBACK_BENCHMARK_H_
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace simple_vulkan {
+
+// Writes the per-frame timings of a benchmark run to a CSV file.
+//
+// Every frame is one row of the frame index, camera timestamp, total frame
+// time in milliseconds and resident set size in KiB.  Finish() appends a
+// "total" row with the summed frame time and the peak resident set size, and
+// logs the frame time distribution.  The columns match those of hello_ar_c's
+// benchmark, which adds per-stage times, so tools/playback_regression.py
+// reads the files of all samples alike.
+class PlaybackBenchmark {
+ public:
+  PlaybackBenchmark() = default;
+  ~PlaybackBenchmark();
+
+  PlaybackBenchmark(const PlaybackBenchmark&) = delete;
+  PlaybackBenchmark& operator=(const PlaybackBenchmark&) = delete;
+
+  // Creates |csv_path| and writes the header.  Returns false if the file
+  // cannot be written.
+  bool Open(const std::string& csv_path);
+
+  bool IsOpen() const { return file_ != nullptr; }
+
+  void RecordFrame(int64_t timestamp_ns, std::chrono::nanoseconds total);
+
+  // Writes the totals and closes the file.
+  void Finish();
+
+ private:
+  FILE* file_ = nullptr;
+  int64_t frame_count_ = 0;
+  std::vector<float> frame_times_ms_;
+};
+
+}  // namespace simple_vulkan
+
+#endif  // C_ARCORE_SIMPLE_VULKAN_PLAYBACK_BENCHMARK_H_
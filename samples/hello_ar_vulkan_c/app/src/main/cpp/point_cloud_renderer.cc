@@ -0,0 +1,421 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "point_cloud_renderer.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+#include "../assets/shaders/point_cloud_frag.spv.h"
+#include "../assets/shaders/point_cloud_occlusion_frag.spv.h"
+#include "../assets/shaders/point_cloud_vert.spv.h"
+#include "util.h"
+
+namespace simple_vulkan {
+namespace {
+// Each point is (x, y, z, confidence).
+constexpr int kPointComponents = 4;
+constexpr VkDeviceSize kPointSize = kPointComponents * sizeof(float);
+// ARCore rarely tracks more than a few hundred points at once. The handler's
+// frame arenas hold several times this much.
+constexpr int32_t kMaxPointsPerFrame = 4096;
+
+// Matches the PushConstants block of point_cloud.vert.
+struct PushConstants {
+  glm::mat4 model_view_projection;
+  glm::vec4 color;
+  float point_size;
+};
+static_assert(offsetof(PushConstants, color) == 64, "Unexpected layout");
+static_assert(offsetof(PushConstants, point_size) == 80, "Unexpected layout");
+
+// Matches the PushConstants block of point_cloud_occlusion.frag, which
+// follows that of the vertex shader.
+struct OcclusionPushConstants {
+  glm::vec4 depth_uv_from_pixel_x;
+  glm::vec4 depth_uv_from_pixel_y;
+};
+constexpr uint32_t kOcclusionPushConstantsOffset = 96;
+static_assert(sizeof(PushConstants) <= kOcclusionPushConstantsOffset,
+              "Overlapping push constants");
+// The least maxPushConstantsSize devices have.
+static_assert(kOcclusionPushConstantsOffset +
+                      sizeof(OcclusionPushConstants) <= 128,
+              "Push constants too large");
+}  // namespace
+
+PointCloudRenderer::PointCloudRenderer(VulkanHandler* vulkan_handler)
+    : vulkan_handler_(vulkan_handler) {
+  VkDevice logical_device = vulkan_handler_->GetLogicalDevice();
+  pipeline_layout_ =
+      CreatePipelineLayout(logical_device, /* set_layout=*/VK_NULL_HANDLE);
+  pipeline_ = CreatePipeline(logical_device, pipeline_layout_,
+                             point_cloud_frag, sizeof(point_cloud_frag),
+                             /* blend=*/false);
+  CreateDepthSetLayout(logical_device);
+  occlusion_pipeline_layout_ =
+      CreatePipelineLayout(logical_device, depth_set_layout_);
+  occlusion_pipeline_ = CreatePipeline(
+      logical_device, occlusion_pipeline_layout_, point_cloud_occlusion_frag,
+      sizeof(point_cloud_occlusion_frag), /* blend=*/true);
+}
+
+PointCloudRenderer::~PointCloudRenderer() {
+  vulkan_handler_->WaitForAllFrames();
+  VkDevice logical_device = vulkan_handler_->GetLogicalDevice();
+  vkDestroyPipeline(logical_device, pipeline_, /* pAllocator=*/nullptr);
+  vkDestroyPipelineLayout(logical_device, pipeline_layout_,
+                          /* pAllocator=*/nullptr);
+  vkDestroyPipeline(logical_device, occlusion_pipeline_,
+                    /* pAllocator=*/nullptr);
+  vkDestroyPipelineLayout(logical_device, occlusion_pipeline_layout_,
+                          /* pAllocator=*/nullptr);
+  vkDestroyDescriptorUpdateTemplate(logical_device, depth_template_,
+                                    /* pAllocator=*/nullptr);
+  vkDestroyDescriptorSetLayout(logical_device, depth_set_layout_,
+                               /* pAllocator=*/nullptr);
+  vkDestroySampler(logical_device, depth_sampler_, /* pAllocator=*/nullptr);
+}
+
+void PointCloudRenderer::Draw(int current_frame,
+                              VkCommandBuffer command_buffer,
+                              const glm::mat4& mvp_matrix,
+                              const ArSession* ar_session,
+                              const ArPointCloud* ar_point_cloud,
+                              VkImageView depth_image_view,
+                              const glm::mat3& depth_uv_from_pixel) {
+  int32_t number_of_points = 0;
+  ArPointCloud_getNumberOfPoints(ar_session, ar_point_cloud, &number_of_points);
+  if (number_of_points <= 0) {
+    return;
+  }
+  number_of_points = std::min(number_of_points, kMaxPointsPerFrame);
+  const float* point_cloud_data = nullptr;
+  ArPointCloud_getData(ar_session, ar_point_cloud, &point_cloud_data);
+
+  // The points change every frame and are read once by the GPU, so they are
+  // written straight into host visible memory rather than staged into device
+  // local memory.
+  VkBuffer vertex_buffer;
+  VkDeviceSize offset;
+  void* vertex_data;
+  if (!vulkan_handler_->AllocateFrameData(current_frame,
+                                          number_of_points * kPointSize,
+                                          sizeof(float), &vertex_buffer,
+                                          &offset, &vertex_data)) {
+    return;
+  }
+  memcpy(vertex_data, point_cloud_data, number_of_points * kPointSize);
+
+  const VkExtent2D extent = vulkan_handler_->GetExtent();
+  const VkViewport viewport = {
+      .x = 0,
+      .y = 0,
+      .width = static_cast<float>(extent.width),
+      .height = static_cast<float>(extent.height),
+      .minDepth = 0.0,
+      .maxDepth = 1.0};
+  const VkRect2D scissor = {.offset = {0, 0}, .extent = extent};
+
+  // Set cyan color to the point cloud.
+  const PushConstants push_constants = {
+      .model_view_projection = mvp_matrix,
+      .color = glm::vec4(31.0f / 255.0f, 188.0f / 255.0f, 210.0f / 255.0f,
+                         1.0f),
+      .point_size = 5.0f,
+  };
+
+  VkDescriptorSet depth_set = VK_NULL_HANDLE;
+  if (depth_image_view != VK_NULL_HANDLE) {
+    depth_set = vulkan_handler_->AllocateFrameDescriptorSet(current_frame,
+                                                            depth_set_layout_);
+  }
+  VkPipelineLayout pipeline_layout = pipeline_layout_;
+  if (depth_set != VK_NULL_HANDLE) {
+    const VkDescriptorImageInfo depth_image = {
+        .sampler = VK_NULL_HANDLE,
+        .imageView = depth_image_view,
+        .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+    };
+    vkUpdateDescriptorSetWithTemplate(vulkan_handler_->GetLogicalDevice(),
+                                      depth_set, depth_template_,
+                                      &depth_image);
+    pipeline_layout = occlusion_pipeline_layout_;
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                      occlusion_pipeline_);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            pipeline_layout, /* firstSet=*/0, 1, &depth_set,
+                            /* dynamicOffsetCount=*/0, nullptr);
+    // glm matrices are column major.
+    const glm::mat3& m = depth_uv_from_pixel;
+    const OcclusionPushConstants occlusion_push_constants = {
+        .depth_uv_from_pixel_x = glm::vec4(m[0][0], m[1][0], m[2][0], 0.0f),
+        .depth_uv_from_pixel_y = glm::vec4(m[0][1], m[1][1], m[2][1], 0.0f),
+    };
+    vkCmdPushConstants(command_buffer, pipeline_layout,
+                       VK_SHADER_STAGE_FRAGMENT_BIT,
+                       kOcclusionPushConstantsOffset,
+                       sizeof(occlusion_push_constants),
+                       &occlusion_push_constants);
+  } else {
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                      pipeline_);
+  }
+  vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+  vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+  vkCmdPushConstants(command_buffer, pipeline_layout,
+                     VK_SHADER_STAGE_VERTEX_BIT, /* offset=*/0,
+                     sizeof(push_constants), &push_constants);
+  vkCmdBindVertexBuffers(command_buffer, 0, 1, &vertex_buffer, &offset);
+  vkCmdDraw(command_buffer, number_of_points, /* instanceCount=*/1,
+            /* firstVertex=*/0, /* firstInstance=*/0);
+}
+
+VkPipelineLayout PointCloudRenderer::CreatePipelineLayout(
+    VkDevice logical_device, VkDescriptorSetLayout set_layout) {
+  VkPipelineLayout pipeline_layout;
+  // The per-draw values are small enough to be pushed with the commands,
+  // which spares a uniform buffer and descriptor set per frame.
+  const VkPushConstantRange push_constant_ranges[2] = {
+      {
+          .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+          .offset = 0,
+          .size = sizeof(PushConstants),
+      },
+      {
+          .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+          .offset = kOcclusionPushConstantsOffset,
+          .size = sizeof(OcclusionPushConstants),
+      },
+  };
+  const bool occlusion = set_layout != VK_NULL_HANDLE;
+  const VkPipelineLayoutCreateInfo pipeline_layout_create_info{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+      .setLayoutCount = occlusion ? 1u : 0u,
+      .pSetLayouts = occlusion ? &set_layout : nullptr,
+      .pushConstantRangeCount = occlusion ? 2u : 1u,
+      .pPushConstantRanges = push_constant_ranges,
+  };
+  CALL_VK(vkCreatePipelineLayout(logical_device, &pipeline_layout_create_info,
+                                 /* pAllocator=*/nullptr, &pipeline_layout));
+  return pipeline_layout;
+}
+
+void PointCloudRenderer::CreateDepthSetLayout(VkDevice logical_device) {
+  // Integer images cannot be filtered.
+  const VkSamplerCreateInfo sampler_create_info = {
+      .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+      .magFilter = VK_FILTER_NEAREST,
+      .minFilter = VK_FILTER_NEAREST,
+      .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+      .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+      .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+      .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+      .mipLodBias = 0.0f,
+      .anisotropyEnable = VK_FALSE,
+      .maxAnisotropy = 1,
+      .compareEnable = VK_FALSE,
+      .compareOp = VK_COMPARE_OP_NEVER,
+      .minLod = 0.0f,
+      .maxLod = 0.0f,
+      .borderColor = VK_BORDER_COLOR_INT_TRANSPARENT_BLACK,
+      .unnormalizedCoordinates = VK_FALSE,
+  };
+  CALL_VK(vkCreateSampler(logical_device, &sampler_create_info,
+                          /* pAllocator=*/nullptr, &depth_sampler_));
+
+  const VkDescriptorSetLayoutBinding binding = {
+      .binding = 0,
+      .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+      .descriptorCount = 1,
+      .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+      .pImmutableSamplers = &depth_sampler_,
+  };
+  const VkDescriptorSetLayoutCreateInfo layout_info = {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+      .bindingCount = 1,
+      .pBindings = &binding,
+  };
+  CALL_VK(vkCreateDescriptorSetLayout(logical_device, &layout_info,
+                                      /* pAllocator=*/nullptr,
+                                      &depth_set_layout_));
+  depth_template_ = vulkan_handler_->CreateDescriptorUpdateTemplate(
+      depth_set_layout_,
+      {{
+          .dstBinding = 0,
+          .dstArrayElement = 0,
+          .descriptorCount = 1,
+          .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+          .offset = 0,
+          .stride = sizeof(VkDescriptorImageInfo),
+      }});
+}
+
+VkPipeline PointCloudRenderer::CreatePipeline(
+    VkDevice logical_device, VkPipelineLayout pipeline_layout,
+    const uint32_t* fragment_shader_code, size_t fragment_shader_size,
+    bool blend) {
+  VkPipeline pipeline;
+
+  VkShaderModule vertex_shader = vulkan_handler_->LoadShader(
+      logical_device, point_cloud_vert, sizeof(point_cloud_vert));
+  VkShaderModule fragment_shader = vulkan_handler_->LoadShader(
+      logical_device, fragment_shader_code, fragment_shader_size);
+
+  const VkPipelineShaderStageCreateInfo shader_stages[2] = {
+      {
+          .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+          .flags = 0,
+          .stage = VK_SHADER_STAGE_VERTEX_BIT,
+          .module = vertex_shader,
+          .pName = "main",
+          .pSpecializationInfo = nullptr,
+      },
+      {
+          .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+          .flags = 0,
+          .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+          .module = fragment_shader,
+          .pName = "main",
+          .pSpecializationInfo = nullptr,
+      },
+  };
+
+  const VkPipelineViewportStateCreateInfo viewport_info{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+      .viewportCount = 1,
+      .pViewports = nullptr,
+      .scissorCount = 1,
+      .pScissors = nullptr,
+  };
+
+  const VkSampleMask sample_mask = ~0u;
+  const VkPipelineMultisampleStateCreateInfo multisample_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+      .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+      .sampleShadingEnable = VK_FALSE,
+      .minSampleShading = 0,
+      .pSampleMask = &sample_mask,
+      .alphaToCoverageEnable = VK_FALSE,
+      .alphaToOneEnable = VK_FALSE,
+  };
+
+  const VkPipelineColorBlendAttachmentState attachment_states = {
+      .blendEnable = blend ? VK_TRUE : VK_FALSE,
+      .srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA,
+      .dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+      .colorBlendOp = VK_BLEND_OP_ADD,
+      .srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
+      .dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+      .alphaBlendOp = VK_BLEND_OP_ADD,
+      .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                        VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+  };
+  const VkPipelineColorBlendStateCreateInfo color_blend_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+      .flags = 0,
+      .logicOpEnable = VK_FALSE,
+      .logicOp = VK_LOGIC_OP_COPY,
+      .attachmentCount = 1,
+      .pAttachments = &attachment_states,
+  };
+
+  const VkPipelineRasterizationStateCreateInfo raster_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+      .depthClampEnable = VK_FALSE,
+      .rasterizerDiscardEnable = VK_FALSE,
+      .polygonMode = VK_POLYGON_MODE_FILL,
+      .cullMode = VK_CULL_MODE_NONE,
+      .frontFace = VK_FRONT_FACE_CLOCKWISE,
+      .depthBiasEnable = VK_FALSE,
+      .lineWidth = 1,
+  };
+
+  const VkPipelineInputAssemblyStateCreateInfo input_assembly_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+      .topology = VK_PRIMITIVE_TOPOLOGY_POINT_LIST,
+      .primitiveRestartEnable = VK_FALSE,
+  };
+
+  const VkVertexInputBindingDescription vertex_input_binding = {
+      .binding = 0,
+      .stride = kPointSize,
+      .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+  };
+  const VkVertexInputAttributeDescription vertex_input_attribute = {
+      .location = 0,
+      .binding = 0,
+      .format = VK_FORMAT_R32G32B32A32_SFLOAT,
+      .offset = 0,
+  };
+  const VkPipelineVertexInputStateCreateInfo vertex_input_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+      .vertexBindingDescriptionCount = 1,
+      .pVertexBindingDescriptions = &vertex_input_binding,
+      .vertexAttributeDescriptionCount = 1,
+      .pVertexAttributeDescriptions = &vertex_input_attribute,
+  };
+
+  const VkDynamicState dynamic_state_enables[2] = {
+      VK_DYNAMIC_STATE_VIEWPORT,
+      VK_DYNAMIC_STATE_SCISSOR,
+  };
+  const VkPipelineDynamicStateCreateInfo dynamic_state_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+      .dynamicStateCount = 2,
+      .pDynamicStates = dynamic_state_enables};
+
+  const VkPipelineDepthStencilStateCreateInfo depth_stencil = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+      .depthTestEnable = VK_TRUE,
+      .depthWriteEnable = VK_TRUE,
+      .depthCompareOp = VK_COMPARE_OP_LESS,
+      .depthBoundsTestEnable = VK_FALSE,
+      .stencilTestEnable = VK_FALSE};
+
+  const VkGraphicsPipelineCreateInfo pipeline_create_info = {
+      .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+      .flags = 0,
+      .stageCount = 2,
+      .pStages = shader_stages,
+      .pVertexInputState = &vertex_input_info,
+      .pInputAssemblyState = &input_assembly_info,
+      .pTessellationState = nullptr,
+      .pViewportState = &viewport_info,
+      .pRasterizationState = &raster_info,
+      .pMultisampleState = &multisample_info,
+      .pDepthStencilState = &depth_stencil,
+      .pColorBlendState = &color_blend_info,
+      .pDynamicState = &dynamic_state_info,
+      .layout = pipeline_layout,
+      .renderPass = vulkan_handler_->GetRenderPass(),
+      .subpass = 0,
+      .basePipelineHandle = VK_NULL_HANDLE,
+      .basePipelineIndex = 0,
+  };
+  CALL_VK(vkCreateGraphicsPipelines(
+      logical_device, vulkan_handler_->GetPipelineCache(), 1,
+      &pipeline_create_info, /* pAllocator=*/nullptr, &pipeline));
+
+  vkDestroyShaderModule(logical_device, vertex_shader, /* pAllocator=*/nullptr);
+  vkDestroyShaderModule(logical_device, fragment_shader,
+                        /* pAllocator=*/nullptr);
+
+  return pipeline;
+}
+
+}  // namespace simple_vulkan
@@ -0,0 +1,88 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_SIMPLE_VULKAN_POINT_CLOUD_RENDERER_H_
+#define C_ARCORE_SIMPLE_VULKAN_POINT_CLOUD_RENDERER_H_
+
+#include <cstdint>
+
+#include "arcore_c_api.h"
+#include "android_vulkan_loader.h"
+#include "glm.h"
+#include "vulkan_handler.h"
+
+namespace simple_vulkan {
+
+// PointCloudRenderer draws the ARCore feature points into the render pass of
+// a VulkanHandler, depth tested against the rest of the scene. With a depth
+// image, points behind the real world fade out the way the virtual objects
+// of hello_ar_c do.
+class PointCloudRenderer {
+ public:
+  // The handler must outlive the renderer.
+  explicit PointCloudRenderer(VulkanHandler* vulkan_handler);
+  ~PointCloudRenderer();
+
+  PointCloudRenderer(const PointCloudRenderer&) = delete;
+  PointCloudRenderer& operator=(const PointCloudRenderer&) = delete;
+
+  // Records the draw of the point cloud into |command_buffer|, a content
+  // command buffer of the frame from VulkanHandler::RecordContent(). Can run
+  // on any thread.
+  //
+  // The points are copied into the frame data of the handler, so this must be
+  // called after VulkanHandler::WaitForFrame() for the frame. Points past
+  // the first 4096 are dropped.
+  //
+  // @param current_frame the index of current frame in the flight.
+  // @param command_buffer the command buffer to record into.
+  // @param mvp_matrix the model-view-projection matrix, in Vulkan clip space.
+  // @param ar_session the session that is used to query point cloud data.
+  // @param ar_point_cloud the point cloud data to draw.
+  // @param depth_image_view the depth of the frame from DepthTexture, or
+  // VK_NULL_HANDLE to draw without occlusion.
+  // @param depth_uv_from_pixel transform of framebuffer pixel coordinates
+  // into uv coordinates of the depth image.
+  void Draw(int current_frame, VkCommandBuffer command_buffer,
+            const glm::mat4& mvp_matrix,
+            const ArSession* ar_session, const ArPointCloud* ar_point_cloud,
+            VkImageView depth_image_view,
+            const glm::mat3& depth_uv_from_pixel);
+
+ private:
+  VkPipelineLayout CreatePipelineLayout(VkDevice logical_device,
+                                        VkDescriptorSetLayout set_layout);
+  // The occluded points are blended, as they fade out.
+  VkPipeline CreatePipeline(VkDevice logical_device,
+                            VkPipelineLayout pipeline_layout,
+                            const uint32_t* fragment_shader_code,
+                            size_t fragment_shader_size, bool blend);
+  void CreateDepthSetLayout(VkDevice logical_device);
+
+  VulkanHandler* const vulkan_handler_;
+  VkPipelineLayout pipeline_layout_ = VK_NULL_HANDLE;
+  VkPipeline pipeline_ = VK_NULL_HANDLE;
+
+  VkSampler depth_sampler_ = VK_NULL_HANDLE;
+  VkDescriptorSetLayout depth_set_layout_ = VK_NULL_HANDLE;
+  VkDescriptorUpdateTemplate depth_template_ = VK_NULL_HANDLE;
+  VkPipelineLayout occlusion_pipeline_layout_ = VK_NULL_HANDLE;
+  VkPipeline occlusion_pipeline_ = VK_NULL_HANDLE;
+};
+
+}  // namespace simple_vulkan
+
+#endif  // C_ARCORE_SIMPLE_VULKAN_POINT_CLOUD_RENDERER_H_
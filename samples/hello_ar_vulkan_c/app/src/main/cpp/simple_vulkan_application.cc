@@ -21,9 +21,16 @@
 
 #include <array>
 #include <cstdint>
+#include <vector>
 
 #include "arcore_c_api.h"
 #include "android_vulkan_loader.h"
+#include "depth_texture.h"
+#include "edge_detection_renderer.h"
+#include "glm.h"
+#include "obj_renderer.h"
+#include "plane_renderer.h"
+#include "point_cloud_renderer.h"
 #include "util.h"
 #include "vulkan_handler.h"
 
@@ -32,6 +39,16 @@ namespace {
 
 constexpr size_t kMaxNumberOfAndroidsToRender = 20;
 
+constexpr char kPipelineCacheFileName[] = "vulkan_pipeline_cache.bin";
+
+// Whether to overlay the edges of the camera image, found by a compute
+// shader, see EdgeDetectionRenderer.
+constexpr bool kDetectEdges = false;
+
+// Whether to fade out the points behind the real world, with the depth image
+// of ARCore on devices that support it, see DepthTexture.
+constexpr bool kUseDepthForOcclusion = false;
+
 // The coordinates of vertices in the Android view.
 const float kVertices[] = {
     0.0f, 0.0f,  // Top Left
@@ -51,6 +68,50 @@ const float kVertices[] = {
 // in front of them.
 constexpr float kApproximateDistanceMeters = 1.0f;
 
+constexpr float kNearPlane = 0.1f;
+constexpr float kFarPlane = 100.0f;
+
+// ARCore returns OpenGL projection matrices. Vulkan's clip space has y
+// pointing down and z in [0, 1] instead of [-1, 1].
+const glm::mat4 kGlToVulkanClip(1.0f, 0.0f, 0.0f, 0.0f,   //
+                                0.0f, -1.0f, 0.0f, 0.0f,  //
+                                0.0f, 0.0f, 0.5f, 0.0f,   //
+                                0.0f, 0.0f, 0.5f, 1.0f);
+
+// Rotation of the clip space by the pre-transform of the swapchain images, in
+// the direction the compositor undoes it.
+glm::mat4 GetPreRotation(VkSurfaceTransformFlagBitsKHR pre_transform) {
+  float degrees = 0.0f;
+  if (pre_transform & VK_SURFACE_TRANSFORM_ROTATE_90_BIT_KHR) {
+    degrees = 90.0f;
+  } else if (pre_transform & VK_SURFACE_TRANSFORM_ROTATE_180_BIT_KHR) {
+    degrees = 180.0f;
+  } else if (pre_transform & VK_SURFACE_TRANSFORM_ROTATE_270_BIT_KHR) {
+    degrees = 270.0f;
+  }
+  return glm::rotate(glm::mat4(1.0f), glm::radians(degrees),
+                     glm::vec3(0.0f, 0.0f, 1.0f));
+}
+
+// Transform of framebuffer pixel coordinates into the uv coordinates of the
+// depth image, from that of the OpenGL normalized device coordinates of the
+// view.
+glm::mat3 GetDepthUvFromPixel(const glm::mat3& depth_uv_from_ndc,
+                              VkExtent2D extent,
+                              VkSurfaceTransformFlagBitsKHR pre_transform) {
+  const glm::mat3 ndc_from_pixel(2.0f / extent.width, 0.0f, 0.0f,   //
+                                 0.0f, 2.0f / extent.height, 0.0f,  //
+                                 -1.0f, -1.0f, 1.0f);
+  // Undoes the pre-rotation, a rotation about z, and the flip of y of
+  // kGlToVulkanClip.
+  const glm::mat3 unrotate =
+      glm::transpose(glm::mat3(GetPreRotation(pre_transform)));
+  const glm::mat3 flip_y(1.0f, 0.0f, 0.0f,   //
+                         0.0f, -1.0f, 0.0f,  //
+                         0.0f, 0.0f, 1.0f);
+  return depth_uv_from_ndc * flip_y * unrotate * ndc_from_pixel;
+}
+
 void SetColor(float r, float g, float b, float a, float* color4f) {
   color4f[0] = r;
   color4f[1] = g;
@@ -58,13 +119,86 @@ void SetColor(float r, float g, float b, float a, float* color4f) {
   color4f[3] = a;
 }
 
+// Distance of |camera_pose| from the plane of |plane_pose| along the normal
+// of the plane, negative behind it.
+float CalculateDistanceToPlane(const ArSession* ar_session,
+                               const ArPose* plane_pose,
+                               const ArPose* camera_pose) {
+  float plane_pose_raw[7] = {0.0f};
+  ArPose_getPoseRaw(ar_session, plane_pose, plane_pose_raw);
+  float camera_pose_raw[7] = {0.0f};
+  ArPose_getPoseRaw(ar_session, camera_pose, camera_pose_raw);
+  // The raw poses are the quaternion (x, y, z, w) followed by the position.
+  const glm::quat plane_rotation(plane_pose_raw[3], plane_pose_raw[0],
+                                 plane_pose_raw[1], plane_pose_raw[2]);
+  const glm::vec3 normal = plane_rotation * glm::vec3(0.0f, 1.0f, 0.0f);
+  const glm::vec3 plane_to_camera(camera_pose_raw[4] - plane_pose_raw[4],
+                                  camera_pose_raw[5] - plane_pose_raw[5],
+                                  camera_pose_raw[6] - plane_pose_raw[6]);
+  return glm::dot(normal, plane_to_camera);
+}
+
+// Whether an Andy can be placed at |ar_hit| on |ar_trackable|: inside a plane
+// seen from its front, or on a point with an estimated surface normal. Sets
+// |color4f| to the color of the Andys on the type of trackable.
+bool IsPlaceableHit(const ArSession* ar_session, const ArFrame* ar_frame,
+                    const ArHitResult* ar_hit, ArTrackable* ar_trackable,
+                    float* color4f) {
+  ArTrackableType ar_trackable_type = AR_TRACKABLE_NOT_VALID;
+  ArTrackable_getType(ar_session, ar_trackable, &ar_trackable_type);
+  if (ar_trackable_type == AR_TRACKABLE_PLANE) {
+    util::ScopedArPose hit_pose(ar_session);
+    ArHitResult_getHitPose(ar_session, ar_hit, hit_pose.GetArPose());
+    int32_t in_polygon = 0;
+    ArPlane_isPoseInPolygon(ar_session, ArAsPlane(ar_trackable),
+                            hit_pose.GetArPose(), &in_polygon);
+
+    // Use hit pose and camera pose to check if hittest is from the back of
+    // the plane, if it is, no need to create the anchor.
+    util::ScopedArPose camera_pose(ar_session);
+    ArCamera* ar_camera;
+    ArFrame_acquireCamera(ar_session, ar_frame, &ar_camera);
+    ArCamera_getPose(ar_session, ar_camera, camera_pose.GetArPose());
+    ArCamera_release(ar_camera);
+    if (!in_polygon ||
+        CalculateDistanceToPlane(ar_session, hit_pose.GetArPose(),
+                                 camera_pose.GetArPose()) < 0) {
+      return false;
+    }
+    // Green.
+    SetColor(139.0f, 195.0f, 74.0f, 255.0f, color4f);
+    return true;
+  }
+  if (ar_trackable_type == AR_TRACKABLE_POINT) {
+    ArPointOrientationMode mode;
+    ArPoint_getOrientationMode(ar_session, ArAsPoint(ar_trackable), &mode);
+    if (mode != AR_POINT_ORIENTATION_ESTIMATED_SURFACE_NORMAL) {
+      return false;
+    }
+    // Blue.
+    SetColor(66.0f, 133.0f, 244.0f, 255.0f, color4f);
+    return true;
+  }
+  return false;
+}
+
 }  // namespace
 
-SimpleVulkanApplication::SimpleVulkanApplication(AAssetManager* asset_manager)
-    : asset_manager_(asset_manager) {}
+constexpr int SimpleVulkanApplication::MAX_FRAMES_IN_FLIGHT;
+
+SimpleVulkanApplication::SimpleVulkanApplication(AAssetManager* asset_manager,
+                                                 const std::string& cache_dir)
+    : asset_manager_(asset_manager),
+      pipeline_cache_path_(cache_dir.empty()
+                               ? std::string()
+                               : cache_dir + "/" + kPipelineCacheFileName) {}
 
 SimpleVulkanApplication::~SimpleVulkanApplication() {
   if (ar_session_ != nullptr) {
+    for (const ColoredAnchor& colored_anchor : anchors_) {
+      ArAnchor_release(colored_anchor.anchor);
+      ArTrackable_release(colored_anchor.trackable);
+    }
     ArSession_destroy(ar_session_);
     ArFrame_destroy(ar_frame_);
   }
@@ -74,6 +208,9 @@ void SimpleVulkanApplication::OnPause() {
   if (ar_session_ != nullptr) {
     ArSession_pause(ar_session_);
   }
+  if (vulkan_handler_ != nullptr) {
+    vulkan_handler_->SavePipelineCache();
+  }
 }
 
 void SimpleVulkanApplication::OnResume(JNIEnv* env, void* context,
@@ -112,6 +249,14 @@ void SimpleVulkanApplication::OnResume(JNIEnv* env, void* context,
     ConfigureSession();
     ArFrame_create(ar_session_, &ar_frame_);
 
+    if (!benchmark_dataset_uri_.empty()) {
+      // The dataset can only be set while the session has not been resumed.
+      CHECKANDTHROW(ArSession_setPlaybackDatasetUri(
+                        ar_session_, benchmark_dataset_uri_.c_str()) ==
+                        AR_SUCCESS,
+                    env, "Failed to set the playback benchmark dataset.");
+    }
+
     ArSession_setDisplayGeometry(ar_session_, display_rotation_, width_,
                                  height_);
   }
@@ -122,9 +267,54 @@ void SimpleVulkanApplication::OnResume(JNIEnv* env, void* context,
 
 void SimpleVulkanApplication::OnSurfaceCreated(JNIEnv* env,
                                                jobject surface_obj) {
+  point_cloud_renderer_.reset();
+  plane_renderer_.reset();
+  andy_renderer_.reset();
+  edge_detection_renderer_.reset();
+  depth_texture_.reset();
+  vulkan_handler_.reset();
   window_.reset(ANativeWindow_fromSurface(env, surface_obj));
-  vulkan_handler_ =
-      std::make_unique<VulkanHandler>(window_.get(), MAX_FRAMES_IN_FLIGHT);
+  CreateVulkanHandler();
+}
+
+void SimpleVulkanApplication::SetPacingMode(
+    VulkanHandler::PacingMode pacing_mode) {
+  if (pacing_mode == pacing_mode_) {
+    return;
+  }
+  pacing_mode_ = pacing_mode;
+  if (vulkan_handler_ == nullptr) {
+    return;
+  }
+  // The present mode is fixed for the lifetime of the swapchain. The new
+  // handler starts from the pipelines the old one compiled.
+  vulkan_handler_->SavePipelineCache();
+  point_cloud_renderer_.reset();
+  plane_renderer_.reset();
+  andy_renderer_.reset();
+  edge_detection_renderer_.reset();
+  depth_texture_.reset();
+  vulkan_handler_.reset();
+  CreateVulkanHandler();
+}
+
+void SimpleVulkanApplication::CreateVulkanHandler() {
+  vulkan_handler_ = std::make_unique<VulkanHandler>(
+      window_.get(), MAX_FRAMES_IN_FLIGHT, pipeline_cache_path_, pacing_mode_);
+  point_cloud_renderer_ =
+      std::make_unique<PointCloudRenderer>(vulkan_handler_.get());
+  plane_renderer_ = std::make_unique<PlaneRenderer>(vulkan_handler_.get());
+  andy_renderer_ = std::make_unique<ObjRenderer>(
+      vulkan_handler_.get(), asset_manager_, "models/andy.obj",
+      "models/andy.png");
+  if (kDetectEdges) {
+    edge_detection_renderer_ =
+        std::make_unique<EdgeDetectionRenderer>(vulkan_handler_.get());
+  }
+  if (kUseDepthForOcclusion) {
+    depth_texture_ = std::make_unique<DepthTexture>(vulkan_handler_.get());
+  }
+  current_frame_ = 0;
 }
 
 void SimpleVulkanApplication::OnDisplayGeometryChanged(int display_rotation,
@@ -135,9 +325,74 @@ void SimpleVulkanApplication::OnDisplayGeometryChanged(int display_rotation,
   if (ar_session_ != nullptr) {
     ArSession_setDisplayGeometry(ar_session_, display_rotation, width, height);
   }
+  // A rotation is a new transform and extent of the same surface, so only
+  // the swapchain is replaced and the frames draw rotated by the new
+  // transform.
+  if (vulkan_handler_ != nullptr) {
+    vulkan_handler_->RecreateSwapchain();
+  }
+}
+
+VulkanHandler::GpuTimeStats SimpleVulkanApplication::GetRenderPassGpuStats()
+    const {
+  if (vulkan_handler_ == nullptr) {
+    return VulkanHandler::GpuTimeStats();
+  }
+  return vulkan_handler_->GetRenderPassGpuStats();
+}
+
+bool SimpleVulkanApplication::StartPlaybackBenchmark(
+    const std::string& dataset_uri, const std::string& csv_path) {
+  if (!playback_benchmark_.Open(csv_path)) {
+    return false;
+  }
+  LOGI("Playback benchmark of %s into %s", dataset_uri.c_str(),
+       csv_path.c_str());
+  benchmark_dataset_uri_ = dataset_uri;
+  benchmark_finished_ = false;
+  // Frames are timed as fast as they can be drawn: MAILBOX does not block on
+  // the display like FIFO does.
+  pacing_mode_ = VulkanHandler::PacingMode::kLowLatency;
+  return true;
 }
 
 void SimpleVulkanApplication::OnDrawFrame() {
+  if (!playback_benchmark_.IsOpen()) {
+    DrawFrame();
+    return;
+  }
+  const auto frame_start = std::chrono::steady_clock::now();
+  DrawFrame();
+  // Waits for the GPU so the frame time includes the command buffer's
+  // execution, which would otherwise overlap with the next frames.
+  if (vulkan_handler_ != nullptr) {
+    vulkan_handler_->WaitForAllFrames();
+  }
+  RecordBenchmarkFrame(std::chrono::steady_clock::now() - frame_start);
+}
+
+void SimpleVulkanApplication::RecordBenchmarkFrame(
+    std::chrono::nanoseconds frame_time) {
+  if (ar_session_ == nullptr) {
+    return;
+  }
+  int64_t timestamp_ns = 0;
+  ArFrame_getTimestamp(ar_session_, ar_frame_, &timestamp_ns);
+  playback_benchmark_.RecordFrame(timestamp_ns, frame_time);
+
+  ArPlaybackStatus playback_status = AR_PLAYBACK_NONE;
+  ArSession_getPlaybackStatus(ar_session_, &playback_status);
+  if (playback_status == AR_PLAYBACK_FINISHED ||
+      playback_status == AR_PLAYBACK_IO_ERROR) {
+    if (playback_status == AR_PLAYBACK_IO_ERROR) {
+      LOGE("Playback benchmark stopped by a dataset read error");
+    }
+    playback_benchmark_.Finish();
+    benchmark_finished_ = true;
+  }
+}
+
+void SimpleVulkanApplication::DrawFrame() {
   if (ar_session_ == nullptr) return;
 
   if (ArSession_update(ar_session_, ar_frame_) != AR_SUCCESS) {
@@ -153,12 +408,19 @@ void SimpleVulkanApplication::OnDrawFrame() {
     return;
   }
 
+  // Rotations by 180 degrees keep the size of the surface, so they only show
+  // up as a swapchain that no longer matches it.
+  if (vulkan_handler_->IsSwapchainOutOfDate() &&
+      !vulkan_handler_->RecreateSwapchain()) {
+    return;
+  }
+
   vulkan_handler_->WaitForFrame(current_frame_);
 
   const uint32_t next_swapchain_image_index =
       vulkan_handler_->AcquireNextImage(current_frame_);
   // If next index is invalid, return directly.
-  if (next_swapchain_image_index < 0) {
+  if (next_swapchain_image_index == static_cast<uint32_t>(-1)) {
     return;
   }
 
@@ -166,58 +428,282 @@ void SimpleVulkanApplication::OnDrawFrame() {
   // re-query the uv coordinates for the on-screen portion of the camera image.
   // Since there is slight difference between the return results of
   // `ArFrame_transformCoordinates2d`, if geometry changed, we will refresh
-  // all the frames in the flight.
+  // all the frames in the flight. The number of frames in flight can change,
+  // so each frame catches up with uv_version_ the next time it is drawn.
   int32_t geometry_changed = 0;
   ArFrame_getDisplayGeometryChanged(ar_session_, ar_frame_, &geometry_changed);
-  if (geometry_changed != 0 ||
-      (!vulkan_handler_->IsVerticesSetForFrame(current_frame_) &&
-       frames_to_set_vertices == 0)) {
+  const bool uvs_changed = geometry_changed != 0 || uv_version_ == 0;
+  if (uvs_changed) {
     ArFrame_transformCoordinates2d(
         ar_session_, ar_frame_, AR_COORDINATES_2D_VIEW_NORMALIZED, kNumVertices,
         kVertices, AR_COORDINATES_2D_TEXTURE_NORMALIZED, transformed_uvs_);
-    frames_to_set_vertices = MAX_FRAMES_IN_FLIGHT;
-  }
-
-  if (frames_to_set_vertices > 0) {
-    // These vertices represent 4 corners of the screen. One tuple is one
-    // vertex. The first two floats in the tuple represent the screen
-    // coordinates in vulkan (Details: http://vulkano.rs/guide/vertex-input).
-    // The later two represent the texture coordinates which is fetched from
-    // ARCore `ArFrame_transformCoordinates2d`.
-    const std::vector<VulkanHandler::VertexInfo> vertices = {
-        {-1.0f, -1.0f, transformed_uvs_[0], transformed_uvs_[1]},  // Top Left
-        {1.0f, -1.0f, transformed_uvs_[2], transformed_uvs_[3]},   // Top Right
-        {1.0f, 1.0f, transformed_uvs_[4], transformed_uvs_[5]},  // Bottom Right
-        {-1.0f, 1.0f, transformed_uvs_[6], transformed_uvs_[7]},  // Bottom Left
+    // The depth image covers the camera image, and the transform from the
+    // view is affine, so three points define it.
+    const float ndc_points[] = {0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f};
+    float uvs[6];
+    ArFrame_transformCoordinates2d(
+        ar_session_, ar_frame_,
+        AR_COORDINATES_2D_OPENGL_NORMALIZED_DEVICE_COORDINATES, 3, ndc_points,
+        AR_COORDINATES_2D_TEXTURE_NORMALIZED, uvs);
+    depth_uv_from_ndc_ =
+        glm::mat3(uvs[2] - uvs[0], uvs[3] - uvs[1], 0.0f,  //
+                  uvs[4] - uvs[0], uvs[5] - uvs[1], 0.0f,  //
+                  uvs[0], uvs[1], 1.0f);
+  }
+  if (uvs_changed ||
+      vulkan_handler_->GetPreTransform() != vertex_pre_transform_) {
+    vertex_pre_transform_ = vulkan_handler_->GetPreTransform();
+    // These vertices represent 4 corners of the screen. The first two floats
+    // of a vertex represent the screen coordinates in vulkan (Details:
+    // http://vulkano.rs/guide/vertex-input), rotated to where the corners of
+    // the view are in the pre-rotated swapchain image. The later two
+    // represent the texture coordinates which is fetched from ARCore
+    // `ArFrame_transformCoordinates2d`.
+    const float corners[] = {
+        -1.0f, -1.0f,  // Top Left
+        1.0f,  -1.0f,  // Top Right
+        1.0f,  1.0f,   // Bottom Right
+        -1.0f, 1.0f,   // Bottom Left
     };
+    const glm::mat4 pre_rotation = GetPreRotation(vertex_pre_transform_);
+    for (int i = 0; i < kNumVertices; ++i) {
+      const glm::vec4 position =
+          pre_rotation * glm::vec4(corners[2 * i], corners[2 * i + 1], 0, 1);
+      background_vertices_[i] = {position.x, position.y,
+                                 transformed_uvs_[2 * i],
+                                 transformed_uvs_[2 * i + 1]};
+    }
+    uv_version_++;
+  }
 
+  if (frame_uv_versions_[current_frame_] != uv_version_ ||
+      !vulkan_handler_->IsVerticesSetForFrame(current_frame_)) {
     // The indices of above vertices. The first 3 and the later 3 integer
     // represents two triangles covering the whole screen.
-    std::vector<uint16_t> indices = {0, 1, 2, 2, 3, 0};
-    vulkan_handler_->SetVerticesAndIndicesForFrame(current_frame_, vertices,
-                                                   indices);
-    frames_to_set_vertices--;
+    const uint16_t indices[] = {0, 1, 2, 2, 3, 0};
+    vulkan_handler_->SetVerticesAndIndicesForFrame(
+        current_frame_, background_vertices_, kNumVertices, indices,
+        sizeof(indices) / sizeof(indices[0]));
+    frame_uv_versions_[current_frame_] = uv_version_;
   }
 
+  AHardwareBuffer* hardware_buffer =
+      reinterpret_cast<AHardwareBuffer*>(native_hardware_buffer);
   vulkan_handler_->BeginRecordingCommandBuffer(current_frame_);
+  // Compute work cannot run inside the render pass.
+  if (edge_detection_renderer_ != nullptr) {
+    edge_detection_renderer_->Dispatch(
+        current_frame_, vulkan_handler_->GetCameraImage(hardware_buffer));
+  }
+  UpdateDepthTexture();
   vulkan_handler_->BeginRenderPass(current_frame_, next_swapchain_image_index);
-  vulkan_handler_->RenderFromHardwareBuffer(
-      current_frame_,
-      reinterpret_cast<AHardwareBuffer*>(native_hardware_buffer));
-  vulkan_handler_->EndRenderPass(current_frame_);
-  vulkan_handler_->FinishRecordingCommandBuffer(current_frame_);
-  vulkan_handler_->SubmitRecordingCommandBuffer(current_frame_);
-  vulkan_handler_->PresentRecordingCommandBuffer(current_frame_,
-                                                 next_swapchain_image_index);
+  vulkan_handler_->RenderFromHardwareBuffer(current_frame_, hardware_buffer);
 
   ArCamera* ar_camera;
   ArFrame_acquireCamera(ar_session_, ar_frame_, &ar_camera);
 
   ArTrackingState camera_tracking_state;
   ArCamera_getTrackingState(ar_session_, ar_camera, &camera_tracking_state);
+  RenderContent(ar_camera,
+                camera_tracking_state == AR_TRACKING_STATE_TRACKING);
   ArCamera_release(ar_camera);
 
-  current_frame_ = (current_frame_ + 1) % MAX_FRAMES_IN_FLIGHT;
+  vulkan_handler_->EndRenderPass(current_frame_);
+  vulkan_handler_->FinishRecordingCommandBuffer(current_frame_);
+  vulkan_handler_->SubmitRecordingCommandBuffer(current_frame_);
+  vulkan_handler_->PresentRecordingCommandBuffer(current_frame_,
+                                                 next_swapchain_image_index);
+
+  current_frame_ = (current_frame_ + 1) % vulkan_handler_->GetFramesInFlight();
+}
+
+void SimpleVulkanApplication::OnTouched(float x, float y) {
+  if (ar_session_ == nullptr) {
+    return;
+  }
+  ArHitResultList* hit_result_list = nullptr;
+  ArHitResultList_create(ar_session_, &hit_result_list);
+  CHECK(hit_result_list);
+  ArFrame_hitTest(ar_session_, ar_frame_, x, y, hit_result_list);
+  int32_t hit_result_list_size = 0;
+  ArHitResultList_getSize(ar_session_, hit_result_list, &hit_result_list_size);
+
+  // The hitTest method sorts the resulting list by distance from the camera,
+  // increasing, so the Andy goes on the first hit that can hold one.
+  ArHitResult* ar_hit = nullptr;
+  ArHitResult_create(ar_session_, &ar_hit);
+  ColoredAnchor colored_anchor = {nullptr, nullptr, {}};
+  for (int32_t i = 0; i < hit_result_list_size; ++i) {
+    ArHitResultList_getItem(ar_session_, hit_result_list, i, ar_hit);
+    ArTrackable* ar_trackable = nullptr;
+    ArHitResult_acquireTrackable(ar_session_, ar_hit, &ar_trackable);
+    if (IsPlaceableHit(ar_session_, ar_frame_, ar_hit, ar_trackable,
+                       colored_anchor.color) &&
+        ArHitResult_acquireNewAnchor(ar_session_, ar_hit,
+                                     &colored_anchor.anchor) == AR_SUCCESS) {
+      colored_anchor.trackable = ar_trackable;
+      break;
+    }
+    ArTrackable_release(ar_trackable);
+  }
+  ArHitResult_destroy(ar_hit);
+  ArHitResultList_destroy(hit_result_list);
+  if (colored_anchor.anchor == nullptr) {
+    return;
+  }
+
+  ArTrackingState tracking_state = AR_TRACKING_STATE_STOPPED;
+  ArAnchor_getTrackingState(ar_session_, colored_anchor.anchor,
+                            &tracking_state);
+  if (tracking_state != AR_TRACKING_STATE_TRACKING) {
+    ArAnchor_release(colored_anchor.anchor);
+    ArTrackable_release(colored_anchor.trackable);
+    return;
+  }
+
+  // The oldest Andy makes room for the new one.
+  if (anchors_.size() >= kMaxNumberOfAndroidsToRender) {
+    ArAnchor_detach(ar_session_, anchors_[0].anchor);
+    ArAnchor_release(anchors_[0].anchor);
+    ArTrackable_release(anchors_[0].trackable);
+    anchors_.erase(anchors_.begin());
+  }
+  anchors_.push_back(colored_anchor);
+}
+
+void SimpleVulkanApplication::UpdateDepthTexture() {
+  if (depth_texture_ == nullptr) {
+    return;
+  }
+  ArImage* depth_image = nullptr;
+  // Not available for the first frames, or if the device has no depth.
+  if (ArFrame_acquireDepthImage16Bits(ar_session_, ar_frame_, &depth_image) !=
+      AR_SUCCESS) {
+    return;
+  }
+  depth_texture_->Update(current_frame_, ar_session_, depth_image);
+  ArImage_release(depth_image);
+}
+
+void SimpleVulkanApplication::RenderContent(ArCamera* ar_camera,
+                                            bool is_tracking) {
+  glm::mat4 view_mat;
+  glm::mat4 projection_mat;
+  ArCamera_getViewMatrix(ar_session_, ar_camera, glm::value_ptr(view_mat));
+  ArCamera_getProjectionMatrix(ar_session_, ar_camera, kNearPlane, kFarPlane,
+                               glm::value_ptr(projection_mat));
+
+  const glm::mat4 view_projection_mat =
+      GetPreRotation(vulkan_handler_->GetPreTransform()) * kGlToVulkanClip *
+      projection_mat * view_mat;
+
+  // Every renderer records into its own command buffer, possibly on another
+  // thread. The ARCore objects they read are acquired here and released once
+  // RecordContent() has returned.
+  std::vector<VulkanHandler::ContentRecorder>& recorders = content_recorders_;
+  recorders.clear();
+
+  // The edges belong to the camera image, so they go first.
+  if (edge_detection_renderer_ != nullptr) {
+    recorders.push_back([&](VkCommandBuffer command_buffer) {
+      edge_detection_renderer_->Draw(current_frame_, command_buffer,
+                                     background_vertices_);
+    });
+  }
+
+  // Update and render point cloud. If the camera isn't tracking don't bother
+  // rendering other objects.
+  const VkImageView depth_image_view =
+      depth_texture_ != nullptr ? depth_texture_->GetImageView(current_frame_)
+                                : VK_NULL_HANDLE;
+  const glm::mat3 depth_uv_from_pixel = GetDepthUvFromPixel(
+      depth_uv_from_ndc_, vulkan_handler_->GetExtent(),
+      vulkan_handler_->GetPreTransform());
+  ArPointCloud* ar_point_cloud = nullptr;
+  if (is_tracking && ArFrame_acquirePointCloud(ar_session_, ar_frame_,
+                                               &ar_point_cloud) == AR_SUCCESS) {
+    recorders.push_back([&](VkCommandBuffer command_buffer) {
+      point_cloud_renderer_->Draw(current_frame_, command_buffer,
+                                  view_projection_mat, ar_session_,
+                                  ar_point_cloud, depth_image_view,
+                                  depth_uv_from_pixel);
+    });
+  }
+
+  // The Andys on the anchors that are tracking, tinted by the light estimate.
+  andy_instances_.clear();
+  glm::vec4 color_correction(1.0f);
+  if (is_tracking) {
+    util::ScopedArPose anchor_pose(ar_session_);
+    for (const ColoredAnchor& colored_anchor : anchors_) {
+      ArTrackingState tracking_state = AR_TRACKING_STATE_STOPPED;
+      ArAnchor_getTrackingState(ar_session_, colored_anchor.anchor,
+                                &tracking_state);
+      if (tracking_state != AR_TRACKING_STATE_TRACKING) {
+        continue;
+      }
+      ArAnchor_getPose(ar_session_, colored_anchor.anchor,
+                       anchor_pose.GetArPose());
+      ObjRenderer::Instance instance;
+      ArPose_getMatrix(ar_session_, anchor_pose.GetArPose(),
+                       glm::value_ptr(instance.model_mat));
+      instance.color = glm::make_vec4(colored_anchor.color);
+      andy_instances_.push_back(instance);
+    }
+
+    ArLightEstimate* ar_light_estimate;
+    ArLightEstimate_create(ar_session_, &ar_light_estimate);
+    ArFrame_getLightEstimate(ar_session_, ar_frame_, ar_light_estimate);
+    ArLightEstimateState ar_light_estimate_state;
+    ArLightEstimate_getState(ar_session_, ar_light_estimate,
+                             &ar_light_estimate_state);
+    if (ar_light_estimate_state == AR_LIGHT_ESTIMATE_STATE_VALID) {
+      ArLightEstimate_getColorCorrection(ar_session_, ar_light_estimate,
+                                         glm::value_ptr(color_correction));
+    }
+    ArLightEstimate_destroy(ar_light_estimate);
+  }
+  if (!andy_instances_.empty()) {
+    recorders.push_back([&](VkCommandBuffer command_buffer) {
+      andy_renderer_->Draw(current_frame_, command_buffer, view_mat,
+                           view_projection_mat, color_correction,
+                           andy_instances_);
+    });
+  }
+
+  // The planes are blended over everything else, so they go last.
+  planes_.clear();
+  if (is_tracking) {
+    ArTrackableList* plane_list = nullptr;
+    ArTrackableList_create(ar_session_, &plane_list);
+    CHECK(plane_list != nullptr);
+    ArSession_getAllTrackables(ar_session_, AR_TRACKABLE_PLANE, plane_list);
+    int32_t plane_list_size = 0;
+    ArTrackableList_getSize(ar_session_, plane_list, &plane_list_size);
+    for (int32_t i = 0; i < plane_list_size; ++i) {
+      ArTrackable* ar_trackable = nullptr;
+      ArTrackableList_acquireItem(ar_session_, plane_list, i, &ar_trackable);
+      planes_.push_back(ArAsPlane(ar_trackable));
+    }
+    ArTrackableList_destroy(plane_list);
+  }
+  if (!planes_.empty()) {
+    recorders.push_back([&](VkCommandBuffer command_buffer) {
+      plane_renderer_->Draw(current_frame_, command_buffer,
+                            view_projection_mat, ar_session_, planes_);
+    });
+  }
+
+  vulkan_handler_->RecordContent(current_frame_, recorders);
+  recorders.clear();
+
+  if (ar_point_cloud != nullptr) {
+    ArPointCloud_release(ar_point_cloud);
+  }
+  for (ArPlane* ar_plane : planes_) {
+    ArTrackable_release(ArAsTrackable(ar_plane));
+  }
+  planes_.clear();
 }
 
 void SimpleVulkanApplication::ConfigureSession() {
@@ -226,6 +712,16 @@ void SimpleVulkanApplication::ConfigureSession() {
 
   ArConfig_setTextureUpdateMode(ar_session_, ar_config,
                                 AR_TEXTURE_UPDATE_MODE_EXPOSE_HARDWARE_BUFFER);
+  if (kUseDepthForOcclusion) {
+    int32_t is_depth_supported = 0;
+    ArSession_isDepthModeSupported(ar_session_, AR_DEPTH_MODE_AUTOMATIC,
+                                   &is_depth_supported);
+    if (is_depth_supported) {
+      ArConfig_setDepthMode(ar_session_, ar_config, AR_DEPTH_MODE_AUTOMATIC);
+    } else {
+      LOGI("Depth is not supported, the points are drawn without occlusion.");
+    }
+  }
 
   CHECK(ar_config);
   CHECK(ArSession_configure(ar_session_, ar_config) == AR_SUCCESS);
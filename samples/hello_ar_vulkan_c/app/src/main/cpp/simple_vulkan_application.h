@@ -21,13 +21,25 @@
 #include <android/native_window.h>
 #include <jni.h>
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <memory>
 #include <set>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "arcore_c_api.h"
 #include "android_vulkan_loader.h"
+#include "depth_texture.h"
+#include "edge_detection_renderer.h"
+#include "glm.h"
+#include "obj_renderer.h"
+#include "plane_renderer.h"
+#include "playback_benchmark.h"
+#include "point_cloud_renderer.h"
 #include "util.h"
 #include "vulkan_handler.h"
 
@@ -36,10 +48,15 @@ namespace simple_vulkan {
 // SimpleVulkanApplication handles all application logics.
 class SimpleVulkanApplication {
  public:
-  const int MAX_FRAMES_IN_FLIGHT = 4;
+  // Upper bound of the frames in flight, the handler may cycle through fewer.
+  static constexpr int MAX_FRAMES_IN_FLIGHT = 4;
 
   // Constructor and deconstructor.
-  explicit SimpleVulkanApplication(AAssetManager* asset_manager);
+  //
+  // @param cache_dir, writable directory used to persist the Vulkan pipeline
+  // cache across launches.
+  SimpleVulkanApplication(AAssetManager* asset_manager,
+                          const std::string& cache_dir);
   ~SimpleVulkanApplication();
 
   // OnPause is called on the UI thread from the Activity's onPause method.
@@ -62,6 +79,31 @@ class SimpleVulkanApplication {
   // OnDrawFrame is called on the OpenGL thread to render the next frame.
   void OnDrawFrame();
 
+  // OnTouched is called on the UI thread, like OnDrawFrame, to place an
+  // Andy where the tap at (x, y), in view pixels, hits a plane or an oriented
+  // point.
+  void OnTouched(float x, float y);
+
+  // GPU time of the render pass of the frames drawn on the current surface.
+  // Called on the UI thread, like OnDrawFrame.
+  VulkanHandler::GpuTimeStats GetRenderPassGpuStats() const;
+
+  // Switches between steady and low latency presentation, see
+  // VulkanHandler::PacingMode. Recreates the swapchain and everything built
+  // on it if a surface exists. Called on the UI thread, like OnDrawFrame.
+  void SetPacingMode(VulkanHandler::PacingMode pacing_mode);
+
+  // Switches the application to the playback benchmark mode: the session
+  // plays |dataset_uri| back instead of using the camera, and the time of
+  // every frame is written to |csv_path|.  Must be called before the first
+  // OnResume() and OnSurfaceCreated().  Returns false if the CSV file cannot
+  // be created.
+  bool StartPlaybackBenchmark(const std::string& dataset_uri,
+                              const std::string& csv_path);
+
+  // Returns true once the whole benchmark recording has been played back.
+  bool IsPlaybackBenchmarkFinished() const { return benchmark_finished_; }
+
  private:
   /**
    *  Custom deleter for ANativeWindow.
@@ -70,24 +112,77 @@ class SimpleVulkanApplication {
     void operator()(ANativeWindow* window) { ANativeWindow_release(window); }
   };
 
+  // An anchor placed by a tap, and the trackable it is attached to.
+  struct ColoredAnchor {
+    ArAnchor* anchor;
+    ArTrackable* trackable;
+    float color[4];
+  };
+
   static constexpr int kNumVertices = 4;
   float transformed_uvs_[kNumVertices * 2];
+  // The background quad, set from transformed_uvs_ and the pre-transform.
+  VulkanHandler::VertexInfo background_vertices_[kNumVertices];
 
   ArSession* ar_session_ = nullptr;
   ArFrame* ar_frame_ = nullptr;
+  // Oldest first.
+  std::vector<ColoredAnchor> anchors_;
 
   bool install_requested_ = false;
   int width_ = 1;
   int height_ = 1;
   int display_rotation_ = 0;
   int current_frame_ = 0;
-  int frames_to_set_vertices = 0;
+  // Bumped whenever transformed_uvs_ or the pre-transform of the swapchain
+  // change, and the version each frame's vertices were last set from.
+  uint64_t uv_version_ = 0;
+  VkSurfaceTransformFlagBitsKHR vertex_pre_transform_ =
+      VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
+  std::array<uint64_t, MAX_FRAMES_IN_FLIGHT> frame_uv_versions_ = {};
+  // Transform of OpenGL normalized device coordinates of the view into uv
+  // coordinates of the depth image, set with transformed_uvs_.
+  glm::mat3 depth_uv_from_ndc_ = glm::mat3(1.0f);
+  VulkanHandler::PacingMode pacing_mode_ =
+      VulkanHandler::PacingMode::kThroughput;
 
   AAssetManager* const asset_manager_;
+  const std::string pipeline_cache_path_;
   std::unique_ptr<VulkanHandler> vulkan_handler_;
+  // Declared after vulkan_handler_ so that they are destroyed first.
+  std::unique_ptr<PointCloudRenderer> point_cloud_renderer_;
+  std::unique_ptr<PlaneRenderer> plane_renderer_;
+  std::unique_ptr<ObjRenderer> andy_renderer_;
+  std::unique_ptr<EdgeDetectionRenderer> edge_detection_renderer_;
+  std::unique_ptr<DepthTexture> depth_texture_;
   std::unique_ptr<ANativeWindow, ANativeWindowDeleter> window_;
+  // Recorders of the frame being drawn, kept so the vector's capacity is
+  // reused.  Empty between frames, as they reference the frame's locals.
+  std::vector<VulkanHandler::ContentRecorder> content_recorders_;
+  // The planes and Andys of the frame being drawn, kept for the same reason.
+  std::vector<ArPlane*> planes_;
+  std::vector<ObjRenderer::Instance> andy_instances_;
+
+  // Playback benchmark state, see StartPlaybackBenchmark().
+  std::string benchmark_dataset_uri_;
+  PlaybackBenchmark playback_benchmark_;
+  std::atomic<bool> benchmark_finished_{false};
 
   void ConfigureSession();
+  // Records and submits one frame; OnDrawFrame() wraps it with the benchmark
+  // timing.
+  void DrawFrame();
+  // Writes the time of the frame just drawn and stops the benchmark at the
+  // end of the recording.
+  void RecordBenchmarkFrame(std::chrono::nanoseconds frame_time);
+  // Creates the handler and its renderers for window_.
+  void CreateVulkanHandler();
+  // Uploads the depth image of the frame, if there is a new one. Must be
+  // called before the render pass.
+  void UpdateDepthTexture();
+  // Records the AR content of the frame into the render pass. Only the edges
+  // are drawn while the camera is not tracking.
+  void RenderContent(ArCamera* ar_camera, bool is_tracking);
 };
 }  // namespace simple_vulkan
 
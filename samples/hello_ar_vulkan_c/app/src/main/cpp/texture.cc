@@ -0,0 +1,90 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "texture.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "util.h"
+
+namespace simple_vulkan {
+namespace {
+constexpr VkFormat kTextureFormat = VK_FORMAT_R8G8B8A8_UNORM;
+constexpr VkDeviceSize kTexelSize = 4;
+}  // namespace
+
+Texture::Texture(VulkanHandler* vulkan_handler, const char* path)
+    : vulkan_handler_(vulkan_handler) {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  std::vector<uint8_t> pixels;
+  if (!util::LoadPngPixelsFromAssetManager(path, &width, &height, &pixels)) {
+    LOGE("Could not load the texture %s", path);
+    return;
+  }
+
+  const VkImageCreateInfo image_create_info = {
+      .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+      .flags = 0,
+      .imageType = VK_IMAGE_TYPE_2D,
+      .format = kTextureFormat,
+      .extent = {width, height, 1u},
+      .mipLevels = 1u,
+      .arrayLayers = 1u,
+      .samples = VK_SAMPLE_COUNT_1_BIT,
+      .tiling = VK_IMAGE_TILING_OPTIMAL,
+      .usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+      .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+      .queueFamilyIndexCount = 0,
+      .pQueueFamilyIndices = nullptr,
+      .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+  };
+  vulkan_handler_->CreateImage(image_create_info, image_, allocation_);
+  vulkan_handler_->UploadToImage(image_, {width, height}, pixels.data(),
+                                 kTexelSize * width * height);
+
+  const VkImageViewCreateInfo view_create_info = {
+      .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+      .flags = 0,
+      .image = image_,
+      .viewType = VK_IMAGE_VIEW_TYPE_2D,
+      .format = kTextureFormat,
+      .components =
+          {
+              VK_COMPONENT_SWIZZLE_IDENTITY,
+              VK_COMPONENT_SWIZZLE_IDENTITY,
+              VK_COMPONENT_SWIZZLE_IDENTITY,
+              VK_COMPONENT_SWIZZLE_IDENTITY,
+          },
+      .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+  };
+  CALL_VK(vkCreateImageView(vulkan_handler_->GetLogicalDevice(),
+                            &view_create_info, /* pAllocator=*/nullptr,
+                            &image_view_));
+}
+
+Texture::~Texture() {
+  if (image_ == VK_NULL_HANDLE) {
+    return;
+  }
+  vulkan_handler_->WaitForAllFrames();
+  vkDestroyImageView(vulkan_handler_->GetLogicalDevice(), image_view_,
+                     /* pAllocator=*/nullptr);
+  vulkan_handler_->DestroyImage(image_, allocation_);
+}
+
+}  // namespace simple_vulkan
@@ -0,0 +1,55 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_SIMPLE_VULKAN_TEXTURE_H_
+#define C_ARCORE_SIMPLE_VULKAN_TEXTURE_H_
+
+#include "android_vulkan_loader.h"
+#include "vulkan_handler.h"
+#include "vulkan_memory_allocator.h"
+
+namespace simple_vulkan {
+
+// Texture is a PNG of the assets, decoded once into a device local RGBA image
+// that the content renderers sample. The texels keep the sRGB encoding of the
+// file, since the shaders apply the gamma themselves like those of
+// hello_ar_c.
+class Texture {
+ public:
+  // The handler must outlive the texture. Loads |path|, relative to the
+  // assets folder. The texture is empty if it cannot be loaded.
+  Texture(VulkanHandler* vulkan_handler, const char* path);
+  ~Texture();
+
+  Texture(const Texture&) = delete;
+  Texture& operator=(const Texture&) = delete;
+
+  bool IsLoaded() const { return image_view_ != VK_NULL_HANDLE; }
+
+  // The image, in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, or VK_NULL_HANDLE
+  // if the texture is empty.
+  VkImageView GetImageView() const { return image_view_; }
+
+ private:
+  VulkanHandler* const vulkan_handler_;
+  VkImage image_ = VK_NULL_HANDLE;
+  VulkanMemoryAllocator::Allocation allocation_;
+  VkImageView image_view_ = VK_NULL_HANDLE;
+};
+
+}  // namespace simple_vulkan
+
+#endif  // C_ARCORE_SIMPLE_VULKAN_TEXTURE_H_
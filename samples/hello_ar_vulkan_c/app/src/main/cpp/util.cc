@@ -17,6 +17,11 @@
 
 #include <unistd.h>
 
+#include <android/bitmap.h>
+
+#include <array>
+#include <cstdio>
+#include <cstring>
 #include <sstream>
 #include <string>
 
@@ -24,6 +29,45 @@
 
 namespace simple_vulkan {
 namespace util {
+namespace {
+
+// Methods of the JniInterface Java class that decode the PNG files of the
+// assets.
+struct JniIds {
+  jclass helper_class;
+  jmethodID load_image_method;
+  jmethodID load_texture_method;
+};
+
+// Looks the methods up on the first call. This makes it thread safe in the
+// unlikely case of multiple threads loading images.
+const JniIds& GetJniIds(JNIEnv* env) {
+  static const JniIds jni_ids = [env]() -> JniIds {
+    constexpr char kHelperClassName[] =
+        "com/google/ar/core/examples/c/simplevulkan/JniInterface";
+    constexpr char kLoadImageMethodName[] = "loadImage";
+    constexpr char kLoadImageMethodSignature[] =
+        "(Ljava/lang/String;)Landroid/graphics/Bitmap;";
+    constexpr char kLoadTextureMethodName[] = "loadTexture";
+    constexpr char kLoadTextureMethodSignature[] =
+        "(ILandroid/graphics/Bitmap;)V";
+    jclass helper_class = FindClass(kHelperClassName);
+    if (helper_class) {
+      helper_class = static_cast<jclass>(env->NewGlobalRef(helper_class));
+      jmethodID load_image_method = env->GetStaticMethodID(
+          helper_class, kLoadImageMethodName, kLoadImageMethodSignature);
+      jmethodID load_texture_method = env->GetStaticMethodID(
+          helper_class, kLoadTextureMethodName, kLoadTextureMethodSignature);
+      return {helper_class, load_image_method, load_texture_method};
+    }
+    LOGE("simple_vulkan::util::Could not find Java helper class %s",
+         kHelperClassName);
+    return {};
+  }();
+  return jni_ids;
+}
+
+}  // namespace
 
 void ThrowJavaException(JNIEnv* env, const char* msg) {
   LOGE("Throw Java exception: %s", msg);
@@ -60,55 +104,201 @@ bool LoadTextFileFromAssetManager(const char* file_name,
 
 bool LoadPngFromAssetManager(int target, const char* path) {
   JNIEnv* env = GetJniEnv();
-
-  // Put all the JNI values in a structure that is statically initialized on the
-  // first call to this method.  This makes it thread safe in the unlikely case
-  // of multiple threads calling this method.
-  static struct JNIData {
-    jclass helper_class;
-    jmethodID load_image_method;
-    jmethodID load_texture_method;
-  } jniIds = [env]() -> JNIData {
-    constexpr char kHelperClassName[] =
-        "com/google/ar/core/examples/c/simplevulkan/JniInterface";
-    constexpr char kLoadImageMethodName[] = "loadImage";
-    constexpr char kLoadImageMethodSignature[] =
-        "(Ljava/lang/String;)Landroid/graphics/Bitmap;";
-    constexpr char kLoadTextureMethodName[] = "loadTexture";
-    constexpr char kLoadTextureMethodSignature[] =
-        "(ILandroid/graphics/Bitmap;)V";
-    jclass helper_class = FindClass(kHelperClassName);
-    if (helper_class) {
-      helper_class = static_cast<jclass>(env->NewGlobalRef(helper_class));
-      jmethodID load_image_method = env->GetStaticMethodID(
-          helper_class, kLoadImageMethodName, kLoadImageMethodSignature);
-      jmethodID load_texture_method = env->GetStaticMethodID(
-          helper_class, kLoadTextureMethodName, kLoadTextureMethodSignature);
-      return {helper_class, load_image_method, load_texture_method};
-    }
-    LOGE("simple_vulkan::util::Could not find Java helper class %s",
-         kHelperClassName);
-    return {};
-  }();
-
-  if (!jniIds.helper_class) {
+  const JniIds& jni_ids = GetJniIds(env);
+  if (!jni_ids.helper_class) {
     return false;
   }
 
   jstring j_path = env->NewStringUTF(path);
 
   jobject image_obj = env->CallStaticObjectMethod(
-      jniIds.helper_class, jniIds.load_image_method, j_path);
+      jni_ids.helper_class, jni_ids.load_image_method, j_path);
 
   if (j_path) {
     env->DeleteLocalRef(j_path);
   }
 
-  env->CallStaticVoidMethod(jniIds.helper_class, jniIds.load_texture_method,
+  env->CallStaticVoidMethod(jni_ids.helper_class, jni_ids.load_texture_method,
                             target, image_obj);
   return true;
 }
 
+bool LoadPngPixelsFromAssetManager(const char* path, uint32_t* out_width,
+                                   uint32_t* out_height,
+                                   std::vector<uint8_t>* out_pixels) {
+  JNIEnv* env = GetJniEnv();
+  const JniIds& jni_ids = GetJniIds(env);
+  if (!jni_ids.helper_class) {
+    return false;
+  }
+
+  jstring j_path = env->NewStringUTF(path);
+  jobject image_obj = env->CallStaticObjectMethod(
+      jni_ids.helper_class, jni_ids.load_image_method, j_path);
+  if (j_path) {
+    env->DeleteLocalRef(j_path);
+  }
+  if (image_obj == nullptr) {
+    return false;
+  }
+
+  AndroidBitmapInfo info;
+  void* pixels = nullptr;
+  bool loaded = false;
+  if (AndroidBitmap_getInfo(env, image_obj, &info) !=
+      ANDROID_BITMAP_RESULT_SUCCESS) {
+    LOGE("Could not read the bitmap of %s", path);
+  } else if (info.format != ANDROID_BITMAP_FORMAT_RGBA_8888) {
+    LOGE("Bitmap of %s is in format %d, not RGBA_8888", path, info.format);
+  } else if (AndroidBitmap_lockPixels(env, image_obj, &pixels) !=
+             ANDROID_BITMAP_RESULT_SUCCESS) {
+    LOGE("Could not lock the pixels of %s", path);
+  } else {
+    // Rows of the bitmap may be padded.
+    const size_t row_size = info.width * 4;
+    out_pixels->resize(row_size * info.height);
+    for (uint32_t y = 0; y < info.height; ++y) {
+      memcpy(out_pixels->data() + y * row_size,
+             static_cast<const uint8_t*>(pixels) + y * info.stride, row_size);
+    }
+    AndroidBitmap_unlockPixels(env, image_obj);
+    *out_width = info.width;
+    *out_height = info.height;
+    loaded = true;
+  }
+  env->DeleteLocalRef(image_obj);
+  return loaded;
+}
+
+bool LoadObjFile(const char* file_name, AAssetManager* asset_manager,
+                 std::vector<ObjVertex>* out_vertices,
+                 std::vector<uint16_t>* out_indices) {
+  std::string file_buffer;
+  if (!LoadTextFileFromAssetManager(file_name, asset_manager, &file_buffer)) {
+    return false;
+  }
+
+  std::vector<std::array<float, 3>> positions;
+  std::vector<std::array<float, 3>> normals;
+  std::vector<std::array<float, 2>> uvs;
+  // Position, texture coordinate and normal indices of a face vertex, from 1,
+  // to the vertex they became.
+  std::map<std::array<int, 3>, uint16_t> vertex_indices;
+  out_vertices->clear();
+  out_indices->clear();
+
+  std::istringstream file_stream(file_buffer);
+  std::string line;
+  while (std::getline(file_stream, line)) {
+    std::istringstream line_stream(line);
+    std::string type;
+    line_stream >> type;
+    if (type == "v") {
+      std::array<float, 3> position = {};
+      line_stream >> position[0] >> position[1] >> position[2];
+      positions.push_back(position);
+    } else if (type == "vn") {
+      std::array<float, 3> normal = {};
+      line_stream >> normal[0] >> normal[1] >> normal[2];
+      normals.push_back(normal);
+    } else if (type == "vt") {
+      std::array<float, 2> uv = {};
+      line_stream >> uv[0] >> uv[1];
+      uvs.push_back(uv);
+    } else if (type == "f") {
+      std::vector<uint16_t> face;
+      std::string corner;
+      while (line_stream >> corner) {
+        // v/vt/vn, where vt or vn may be left out and are 0 then.
+        std::array<int, 3> key = {0, 0, 0};
+        std::istringstream corner_stream(corner);
+        std::string index;
+        for (int i = 0; i < 3 && std::getline(corner_stream, index, '/');
+             ++i) {
+          key[i] = atoi(index.c_str());
+        }
+        if (key[0] < 1 || key[0] > static_cast<int>(positions.size()) ||
+            key[1] < 0 || key[1] > static_cast<int>(uvs.size()) ||
+            key[2] < 0 || key[2] > static_cast<int>(normals.size())) {
+          LOGE("Face vertex %s out of range in %s", corner.c_str(), file_name);
+          return false;
+        }
+        auto it = vertex_indices.find(key);
+        if (it == vertex_indices.end()) {
+          if (out_vertices->size() > UINT16_MAX) {
+            LOGE("Too many vertices in %s", file_name);
+            return false;
+          }
+          ObjVertex vertex = {};
+          memcpy(vertex.position, positions[key[0] - 1].data(),
+                 sizeof(vertex.position));
+          if (key[1] > 0) {
+            memcpy(vertex.uv, uvs[key[1] - 1].data(), sizeof(vertex.uv));
+          }
+          if (key[2] > 0) {
+            memcpy(vertex.normal, normals[key[2] - 1].data(),
+                   sizeof(vertex.normal));
+          }
+          it = vertex_indices
+                   .emplace(key, static_cast<uint16_t>(out_vertices->size()))
+                   .first;
+          out_vertices->push_back(vertex);
+        }
+        face.push_back(it->second);
+      }
+      // Polygons are split into a fan of triangles around their first vertex.
+      for (size_t i = 2; i < face.size(); ++i) {
+        out_indices->push_back(face[0]);
+        out_indices->push_back(face[i - 1]);
+        out_indices->push_back(face[i]);
+      }
+    }
+  }
+  if (out_indices->empty()) {
+    LOGE("No faces in %s", file_name);
+    return false;
+  }
+  return true;
+}
+
+bool ReadFile(const std::string& path, std::vector<uint8_t>* out_data) {
+  FILE* file = fopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    return false;
+  }
+  bool read_ok = fseek(file, 0, SEEK_END) == 0;
+  const long size = read_ok ? ftell(file) : -1;
+  read_ok = size >= 0 && fseek(file, 0, SEEK_SET) == 0;
+  if (read_ok) {
+    out_data->resize(size);
+    read_ok = fread(out_data->data(), 1, size, file) ==
+              static_cast<size_t>(size);
+  }
+  fclose(file);
+  if (!read_ok) {
+    LOGE("Could not read %s", path.c_str());
+    out_data->clear();
+  }
+  return read_ok;
+}
+
+bool WriteFileAtomically(const std::string& path, const void* data,
+                         size_t size) {
+  const std::string temp_path = path + ".tmp";
+  FILE* file = fopen(temp_path.c_str(), "wb");
+  if (file == nullptr) {
+    LOGE("Could not write %s: %s", temp_path.c_str(), strerror(errno));
+    return false;
+  }
+  bool write_ok = fwrite(data, 1, size, file) == size;
+  write_ok = (fclose(file) == 0) && write_ok;
+  if (!write_ok || rename(temp_path.c_str(), path.c_str()) != 0) {
+    unlink(temp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
 void Log4x4Matrix(const float raw_matrix[16]) {
   LOGI(
       "%f, %f, %f, %f\n"
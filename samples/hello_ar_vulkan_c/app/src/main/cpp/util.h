@@ -25,6 +25,7 @@
 #include <cstdint>
 #include <cstdlib>
 #include <map>
+#include <string>
 #include <vector>
 
 #include "arcore_c_api.h"
@@ -103,6 +104,51 @@ bool LoadTextFileFromAssetManager(const char* file_name,
 // @return true if png is loaded correctly, otherwise false.
 bool LoadPngFromAssetManager(int target, const char* path);
 
+// Decode a png file from assets folder into RGBA pixels, with the rows from
+// the top and the alpha premultiplied as Android decodes them.
+//
+// @param path, path to the file, relative to the assets folder.
+// @param out_width, out_height, size of the image.
+// @param out_pixels, output 4 bytes per pixel, without padding.
+// @return true if png is loaded correctly, otherwise false.
+bool LoadPngPixelsFromAssetManager(const char* path, uint32_t* out_width,
+                                   uint32_t* out_height,
+                                   std::vector<uint8_t>* out_pixels);
+
+// A vertex of a mesh loaded by LoadObjFile().
+struct ObjVertex {
+  float position[3];
+  float normal[3];
+  float uv[2];
+};
+
+// Load an obj file from assets folder. Every distinct combination of the
+// position, texture coordinates and normal of a face corner is one vertex,
+// and faces with more than three corners are split into triangles.
+//
+// @param file_name, path to the file, relative to the assets folder.
+// @param asset_manager, AAssetManager pointer.
+// @param out_vertices, output vertices of the mesh.
+// @param out_indices, output indices of the triangles of the mesh.
+// @return true if the mesh is loaded correctly, otherwise false.
+bool LoadObjFile(const char* file_name, AAssetManager* asset_manager,
+                 std::vector<ObjVertex>* out_vertices,
+                 std::vector<uint16_t>* out_indices);
+
+// Read a whole file from the app's storage.
+//
+// @param path, absolute path to the file.
+// @param out_data, output bytes of the file.
+// @return true if the file is read, otherwise false.
+bool ReadFile(const std::string& path, std::vector<uint8_t>* out_data);
+
+// Write |size| bytes to |path| through a temporary file, so that a crash never
+// leaves a truncated file under the final name.
+//
+// @return true if the file is written, otherwise false.
+bool WriteFileAtomically(const std::string& path, const void* data,
+                         size_t size);
+
 // Format and output the matrix to logcat file.
 // Note that this function output matrix in row major.
 void Log4x4Matrix(const float raw_matrix[16]);
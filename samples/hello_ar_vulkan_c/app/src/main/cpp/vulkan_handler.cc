@@ -17,89 +17,258 @@
 #include "vulkan_handler.h"
 
 #include <android/log.h>
+#include <time.h>
 #include <vulkan/vulkan.h>
 
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <cstdint>
 #include <cstring>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
 #include <vector>
 
 #include "../assets/shaders/background_frag.spv.h"
 #include "../assets/shaders/background_vert.spv.h"
 #include "android_vulkan_loader.h"
 #include "util.h"
+#include "vulkan_memory_allocator.h"
+#include "worker_pool.h"
 
 namespace simple_vulkan {
 const uint64_t kFenceTimeoutNs = 100L * 1000L * 1000L;
+// ARCore cycles through a small pool of camera buffers.  The cache has to hold
+// more buffers than there are frames in flight.
+const size_t kMaxImportedBuffers = 8;
+// Buffers not drawn for this many frames are taken to be gone, e.g. after a
+// camera config change.  Must exceed the number of frames in flight.
+const uint64_t kImportedBufferIdleFrames = 30;
+// Capacity of the geometry of one frame in flight.
+const size_t kMaxVerticesPerFrame = 1024;
+const size_t kMaxIndicesPerFrame = 3 * kMaxVerticesPerFrame;
+// Keeps the vertex and index ranges of every frame on their own cache lines.
+const VkDeviceSize kGeometryAlignment = 256;
+// Every device supports 16 bit depth attachments.
+const VkFormat kDepthFormat = VK_FORMAT_D16_UNORM;
+// Per frame memory for data streamed by the renderers, like the point cloud.
+const VkDeviceSize kFrameArenaSize = 256 * 1024;
+// Descriptor sets per frame in flight, and descriptors of each type.
+const uint32_t kMaxFrameDescriptorSets = 64;
+const uint32_t kMaxFrameDescriptorsPerType = 128;
+// Geometry version of background commands that were never recorded.
+const uint64_t kNotRecorded = 0;
+// Frames in flight to start low latency pacing with: one being rendered while
+// the next is recorded.
+const int kLowLatencyFramesInFlight = 2;
+// MAILBOX needs an image to render into besides the displayed and the queued
+// one.
+const uint32_t kMailboxMinImageCount = 3;
+// Presents per adaptation of the frames in flight, and the share of them that
+// may miss their vsync before a frame is added.
+const int kPacingWindowPresents = 120;
+const int kMaxMissedPresentsPerWindow = kPacingWindowPresents / 20;
+// Slack added to the measured render time when picking the vsync of a frame,
+// for the CPU work between the submit and the GPU starting on it.
+const uint64_t kPresentSlackNs = 2L * 1000L * 1000L;
+// The instance is created with, and the loader resolves the core functions
+// of, this version.
+const uint32_t kApiVersion = VK_MAKE_VERSION(1, 2, 0);
+
+namespace {
+VkDeviceSize AlignGeometryOffset(VkDeviceSize offset) {
+  return (offset + kGeometryAlignment - 1) / kGeometryAlignment *
+         kGeometryAlignment;
+}
+
+// Whether |data| starts with the pipeline cache header of |properties|'s
+// device and driver. Drivers reject foreign data, but may not do so
+// gracefully.
+bool HasDeviceExtension(VkPhysicalDevice physical_device, const char* name) {
+  uint32_t extension_count = 0;
+  vkEnumerateDeviceExtensionProperties(physical_device, /* pLayerName=*/nullptr,
+                                       &extension_count, nullptr);
+  std::vector<VkExtensionProperties> extensions(extension_count);
+  vkEnumerateDeviceExtensionProperties(physical_device, /* pLayerName=*/nullptr,
+                                       &extension_count, extensions.data());
+  for (const VkExtensionProperties& extension : extensions) {
+    if (strcmp(extension.extensionName, name) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// The surface reports its extent in the current orientation of the display.
+// With the images pre-rotated, they keep the size of the natural orientation.
+VkExtent2D GetIdentityExtent(const VkSurfaceCapabilitiesKHR& capabilities) {
+  const VkExtent2D extent = capabilities.currentExtent;
+  const VkSurfaceTransformFlagsKHR quarter_turns =
+      VK_SURFACE_TRANSFORM_ROTATE_90_BIT_KHR |
+      VK_SURFACE_TRANSFORM_ROTATE_270_BIT_KHR;
+  if (capabilities.currentTransform & quarter_turns) {
+    return {.width = extent.height, .height = extent.width};
+  }
+  return extent;
+}
 
-VulkanHandler::VulkanHandler(ANativeWindow* window, int max_frames_in_flight) {
+// CLOCK_MONOTONIC, the clock of the VK_GOOGLE_display_timing times.
+uint64_t GetMonotonicTimeNs() {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<uint64_t>(now.tv_sec) * 1000000000ull +
+         static_cast<uint64_t>(now.tv_nsec);
+}
+
+bool IsPipelineCacheCompatible(const std::vector<uint8_t>& data,
+                               const VkPhysicalDeviceProperties& properties) {
+  // The VK_PIPELINE_CACHE_HEADER_VERSION_ONE layout.
+  struct {
+    uint32_t header_size;
+    uint32_t header_version;
+    uint32_t vendor_id;
+    uint32_t device_id;
+    uint8_t uuid[VK_UUID_SIZE];
+  } header;
+  static_assert(sizeof(header) == 16 + VK_UUID_SIZE, "Header is not packed");
+  if (data.size() < sizeof(header)) {
+    return false;
+  }
+  memcpy(&header, data.data(), sizeof(header));
+  return header.header_size >= sizeof(header) &&
+         header.header_version == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+         header.vendor_id == properties.vendorID &&
+         header.device_id == properties.deviceID &&
+         memcmp(header.uuid, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+}  // namespace
+
+constexpr size_t VulkanHandler::kMaxContentSlots;
+constexpr int VulkanHandler::kGpuTimeWindowSize;
+
+VulkanHandler::VulkanHandler(ANativeWindow* window, int max_frames_in_flight,
+                             const std::string& pipeline_cache_path,
+                             PacingMode pacing_mode)
+    : pipeline_cache_path_(pipeline_cache_path), pacing_mode_(pacing_mode) {
   CHECK(LoadVulkan());
 
   max_frames_in_flight_ = max_frames_in_flight;
+  frames_in_flight_ =
+      pacing_mode_ == PacingMode::kLowLatency
+          ? std::min(kLowLatencyFramesInFlight, max_frames_in_flight_)
+          : max_frames_in_flight_;
+  CHECK(static_cast<size_t>(max_frames_in_flight_) < kMaxImportedBuffers);
+  CHECK(static_cast<uint64_t>(max_frames_in_flight_) <
+        kImportedBufferIdleFrames);
 
   instance_ = CreateInstance();
   surface_ = CreateSurface(instance_, window);
   physical_device_ = CreatePhysicalDevice(instance_);
   queue_family_index_ = GetQueueFamilyIndex(physical_device_);
+  transfer_queue_family_index_ =
+      GetTransferQueueFamilyIndex(physical_device_, queue_family_index_);
+  display_timing_enabled_ =
+      pacing_mode_ == PacingMode::kLowLatency &&
+      HasDeviceExtension(physical_device_,
+                         VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME);
   logical_device_ = CreateLogicalDevice(physical_device_, queue_family_index_);
   vkGetDeviceQueue(logical_device_, queue_family_index_, /* queueIndex=*/0,
                    &queue_);
+  if (transfer_queue_family_index_ != queue_family_index_) {
+    vkGetDeviceQueue(logical_device_, transfer_queue_family_index_,
+                     /* queueIndex=*/0, &transfer_queue_);
+  }
+  memory_allocator_ = std::make_unique<VulkanMemoryAllocator>(
+      physical_device_, logical_device_);
 
+  pipeline_cache_ = CreatePipelineCache(physical_device_, logical_device_);
   render_pass_ = CreateRenderPass(logical_device_);
-  command_pool_ = CreateCommandPool(logical_device_, queue_family_index_);
-  descriptor_pool_ =
-      CreateDescriptorPool(logical_device_, max_frames_in_flight_);
+  command_pool_ = CreateCommandPool(
+      logical_device_, queue_family_index_,
+      VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+  transfer_command_pool_ =
+      CreateCommandPool(logical_device_, queue_family_index_,
+                        VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+  descriptor_pool_ = CreateDescriptorPool(logical_device_, kMaxImportedBuffers);
   vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physical_device_, surface_,
                                             &surface_capabilities_);
   surface_format_ = GetSurfaceFormat(surface_, physical_device_);
-  swapchain_ = CreateSwapchain(logical_device_, surface_, surface_capabilities_,
-                               surface_format_, queue_family_index_);
-  CALL_VK(vkGetSwapchainImagesKHR(logical_device_, swapchain_,
-                                  &swapchain_length_,
-                                  /* pSwapchainImages=*/nullptr));
-
-  InitSwapchainImageRelatives(logical_device_, swapchain_, render_pass_,
-                              surface_capabilities_, surface_format_,
-                              swapchain_length_);
-
-  descriptor_sets_.resize(max_frames_in_flight_);
-  texture_image_infos_.resize(max_frames_in_flight_);
-  vertex_buffers_.resize(max_frames_in_flight_);
-  vertex_buffers_memory_.resize(max_frames_in_flight_);
-  index_buffers_.resize(max_frames_in_flight_);
-  index_buffers_memory_.resize(max_frames_in_flight_);
-  index_count_.resize(max_frames_in_flight_);
+  present_mode_ = ChoosePresentMode(physical_device_, surface_);
+  InitSwapchain(/* old_swapchain=*/VK_NULL_HANDLE);
+  InitDisplayTiming();
+
+  InitGeometryBuffer(max_frames_in_flight_);
+  for (int i = 0; i < max_frames_in_flight_; i++) {
+    frame_descriptor_pools_.push_back(
+        CreateFrameDescriptorPool(logical_device_));
+  }
+  for (int i = 0; i < max_frames_in_flight_; i++) {
+    frame_arenas_.push_back(std::make_unique<LinearArena>(
+        memory_allocator_.get(), kFrameArenaSize,
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT));
+  }
 
   InitCommandBuffers(logical_device_, command_pool_, max_frames_in_flight_);
+  // The calling thread records one of the slots itself.
+  recording_workers_ = std::make_unique<WorkerPool>(
+      std::min(WorkerPool::GetDefaultWorkerCount(),
+               static_cast<int>(kMaxContentSlots) - 1));
   // Init semaphores and fences
   InitSyncObjects(logical_device_, max_frames_in_flight_);
+  InitTimestampQueries(max_frames_in_flight_);
 }
 
 VulkanHandler::~VulkanHandler() {
-  CALL_VK(vkWaitForFences(logical_device_, fences_.size(), fences_.data(),
-                          VK_TRUE, kFenceTimeoutNs));
-  for (uint32_t i = 0; i < max_frames_in_flight_; i++) {
-    CleanTextureImageInfo(i);
-    CleanVertiesAndIndies(i);
+  WaitForAllFrames();
+  for (const PendingSubmission& submission : pending_submissions_) {
+    CALL_VK(vkWaitForFences(logical_device_, /* fenceCount=*/1,
+                            &submission.fence, VK_TRUE, kFenceTimeoutNs));
+  }
+  ReclaimFinishedSubmissions();
+  for (VkFence fence : free_transfer_fences_) {
+    vkDestroyFence(logical_device_, fence, /* pAllocator=*/nullptr);
   }
+  for (const ImportedBuffer& imported_buffer : imported_buffers_) {
+    CleanImportedBuffer(imported_buffer);
+  }
+  imported_buffers_.clear();
+  CleanGeometryBuffer();
+  frame_arenas_.clear();
 
   vkDestroySamplerYcbcrConversion(logical_device_, conversion_,
                                   /* pAllocator=*/nullptr);
   vkDestroySampler(logical_device_, sampler_, /* pAllocator=*/nullptr);
   vkDestroyPipelineLayout(logical_device_, pipeline_layout_,
                           /* pAllocator=*/nullptr);
+  if (camera_descriptor_template_ != VK_NULL_HANDLE) {
+    vkDestroyDescriptorUpdateTemplate(logical_device_,
+                                      camera_descriptor_template_,
+                                      /* pAllocator=*/nullptr);
+  }
   vkDestroyDescriptorSetLayout(logical_device_, descriptor_set_layout_,
                                /* pAllocator=*/nullptr);
 
   vkDestroyDescriptorPool(logical_device_, descriptor_pool_,
                           /* pAllocator=*/nullptr);
+  for (VkDescriptorPool frame_descriptor_pool : frame_descriptor_pools_) {
+    vkDestroyDescriptorPool(logical_device_, frame_descriptor_pool,
+                            /* pAllocator=*/nullptr);
+  }
 
   vkDestroyPipeline(logical_device_, graphics_pipeline_,
                     /* pAllocator=*/nullptr);
+  vkDestroyPipelineCache(logical_device_, pipeline_cache_,
+                         /* pAllocator=*/nullptr);
 
   vkFreeCommandBuffers(logical_device_, command_pool_, max_frames_in_flight_,
                        command_buffers_.data());
+  // Frees the content command buffers with them.
+  for (VkCommandPool content_command_pool : content_command_pools_) {
+    vkDestroyCommandPool(logical_device_, content_command_pool,
+                         /* pAllocator=*/nullptr);
+  }
   for (size_t i = 0; i < max_frames_in_flight_; i++) {
     vkDestroySemaphore(logical_device_, render_finished_semaphores[i],
                        /* pAllocator=*/nullptr);
@@ -107,19 +276,19 @@ VulkanHandler::~VulkanHandler() {
                        /* pAllocator=*/nullptr);
     vkDestroyFence(logical_device_, fences_[i], /* pAllocator=*/nullptr);
   }
+  if (timestamp_query_pool_ != VK_NULL_HANDLE) {
+    vkDestroyQueryPool(logical_device_, timestamp_query_pool_,
+                       /* pAllocator=*/nullptr);
+  }
 
   vkDestroyCommandPool(logical_device_, command_pool_, /* pAllocator=*/nullptr);
-  vkDestroyRenderPass(logical_device_, render_pass_, /* pAllocator=*/nullptr);
-  for (uint32_t i = 0; i < swapchain_length_; i++) {
-    vkDestroyFramebuffer(logical_device_,
-                         swapchain_image_relatives_[i].frame_buffer,
-                         /*pAllocator=*/nullptr);
-    vkDestroyImageView(logical_device_,
-                       swapchain_image_relatives_[i].swapchain_view,
+  vkDestroyCommandPool(logical_device_, transfer_command_pool_,
                        /* pAllocator=*/nullptr);
-  }
+  vkDestroyRenderPass(logical_device_, render_pass_, /* pAllocator=*/nullptr);
+  CleanSwapchainImageRelatives();
   vkDestroySwapchainKHR(logical_device_, swapchain_,
                         /* pAllocator=*/nullptr);
+  memory_allocator_.reset();
 
   vkDestroyDevice(logical_device_, /* pAllocator=*/nullptr);
   vkDestroySurfaceKHR(instance_, surface_, /* pAllocator=*/nullptr);
@@ -128,10 +297,21 @@ VulkanHandler::~VulkanHandler() {
 
 uint32_t VulkanHandler::AcquireNextImage(int current_frame) {
   uint32_t out_next_index = -1;
-  CALL_VK(vkAcquireNextImageKHR(logical_device_, swapchain_,
-                                /* timeout=*/UINT64_MAX,
-                                image_available_semaphores[current_frame],
-                                /* fence=*/VK_NULL_HANDLE, &out_next_index));
+  const VkResult result = vkAcquireNextImageKHR(
+      logical_device_, swapchain_,
+      /* timeout=*/UINT64_MAX, image_available_semaphores[current_frame],
+      /* fence=*/VK_NULL_HANDLE, &out_next_index);
+  if (result == VK_SUBOPTIMAL_KHR) {
+    // The image can still be presented, the swapchain is replaced after it.
+    swapchain_out_of_date_ = true;
+  } else if (result != VK_SUCCESS) {
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+      swapchain_out_of_date_ = true;
+    } else {
+      LOGE("Failed to acquire the next image due to error code %d", result);
+    }
+    return -1;
+  }
 
   return out_next_index;
 }
@@ -139,268 +319,127 @@ uint32_t VulkanHandler::AcquireNextImage(int current_frame) {
 void VulkanHandler::WaitForFrame(int current_frame) {
   CALL_VK(vkWaitForFences(logical_device_, /* fenceCount=*/1,
                           &fences_[current_frame], VK_TRUE, kFenceTimeoutNs));
+  ReclaimFinishedSubmissions();
+  ReadFrameTimestamps(current_frame);
+  std::lock_guard<std::mutex> lock(frame_arena_mutex_);
+  frame_arenas_[current_frame]->Reset();
+  CALL_VK(vkResetDescriptorPool(logical_device_,
+                                frame_descriptor_pools_[current_frame],
+                                /* flags=*/0));
 }
 
 void VulkanHandler::RenderFromHardwareBuffer(int current_frame,
                                              AHardwareBuffer* hardware_buffer) {
-  CleanTextureImageInfo(current_frame);
-
-  AHardwareBuffer_Desc buffer_desc = {};
-
-  if (__builtin_available(android 27, *)) {
-    AHardwareBuffer_describe(hardware_buffer, &buffer_desc);
-  } else {
-    LOGE("Android API 27+ Required.");
-    exit(0);
-  }
-
-  // Contains how to sample the image
-  VkAndroidHardwareBufferFormatPropertiesANDROID format_info = {
-      .sType =
-          VK_STRUCTURE_TYPE_ANDROID_HARDWARE_BUFFER_FORMAT_PROPERTIES_ANDROID,
-  };
-  // Contains only memory information (size and type)
-  VkAndroidHardwareBufferPropertiesANDROID properties = {
-      .sType = VK_STRUCTURE_TYPE_ANDROID_HARDWARE_BUFFER_PROPERTIES_ANDROID,
-      .pNext = &format_info,
-  };
-  CALL_VK(vkGetAndroidHardwareBufferPropertiesANDROID(
-      logical_device_, hardware_buffer, &properties));
-
-  // Create an image to bind to our AHardwareBuffer
-  const VkExternalFormatANDROID external_format = {
-      .sType = VK_STRUCTURE_TYPE_EXTERNAL_FORMAT_ANDROID,
-      .externalFormat = format_info.externalFormat,
-  };
-  const VkExternalMemoryImageCreateInfo external_create_info = {
-      .sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_IMAGE_CREATE_INFO,
-      .pNext = &external_format,
-      .handleTypes =
-          VK_EXTERNAL_MEMORY_HANDLE_TYPE_ANDROID_HARDWARE_BUFFER_BIT_ANDROID,
-  };
-  const VkImageCreateInfo create_info = {
-      .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
-      .pNext = &external_create_info,
-      .flags = 0u,
-      .imageType = VK_IMAGE_TYPE_2D,
-      .format = format_info.format,
-      .extent =
-          {
-              buffer_desc.width,
-              buffer_desc.height,
-              1u,
-          },
-      .mipLevels = 1u,
-      .arrayLayers = 1u,
-      .samples = VK_SAMPLE_COUNT_1_BIT,
-      .tiling = VK_IMAGE_TILING_OPTIMAL,
-      .usage = VK_IMAGE_USAGE_SAMPLED_BIT,
-      .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-      .queueFamilyIndexCount = 0,
-      .pQueueFamilyIndices = nullptr,
-      .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-  };
-  CALL_VK(vkCreateImage(logical_device_, &create_info, nullptr,
-                        &texture_image_infos_[current_frame].texture_image));
-
-  // Allocate the device memory for the image
-  const VkImportAndroidHardwareBufferInfoANDROID android_hardware_buffer_info =
-      {
-          .sType =
-              VK_STRUCTURE_TYPE_IMPORT_ANDROID_HARDWARE_BUFFER_INFO_ANDROID,
-          .buffer = hardware_buffer,
-      };
-  const VkMemoryDedicatedAllocateInfo memory_dedicated_allocate_info = {
-      .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO,
-      .pNext = &android_hardware_buffer_info,
-      .image = texture_image_infos_[current_frame].texture_image,
-      .buffer = VK_NULL_HANDLE,
-  };
-  const VkMemoryAllocateInfo memory_allocate_info = {
-      .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-      .pNext = &memory_dedicated_allocate_info,
-      .allocationSize = properties.allocationSize,
-      .memoryTypeIndex =
-          FindMemoryType(physical_device_, properties.memoryTypeBits, 0),
-  };
-  CALL_VK(
-      vkAllocateMemory(logical_device_, &memory_allocate_info, nullptr,
-                       &texture_image_infos_[current_frame].texture_memory));
-
-  // Bind the allocated memory to the image
-  CALL_VK(vkBindImageMemory(
-      logical_device_, texture_image_infos_[current_frame].texture_image,
-      texture_image_infos_[current_frame].texture_memory, 0));
-
-  // Create YUV conversion, this is needed to sample a texture image with
-  // external format
-  if (conversion_ == VK_NULL_HANDLE) {
-    const VkSamplerYcbcrConversionCreateInfo conversion_create_info = {
-        .sType = VK_STRUCTURE_TYPE_SAMPLER_YCBCR_CONVERSION_CREATE_INFO,
-        .pNext = &external_format,
-        .format = format_info.format,
-        .ycbcrModel = format_info.suggestedYcbcrModel,
-        .ycbcrRange = format_info.suggestedYcbcrRange,
-        .components = format_info.samplerYcbcrConversionComponents,
-        .xChromaOffset = format_info.suggestedXChromaOffset,
-        .yChromaOffset = format_info.suggestedYChromaOffset,
-        .chromaFilter = VK_FILTER_NEAREST,
-        .forceExplicitReconstruction = VK_FALSE,
-    };
-
-    CALL_VK(vkCreateSamplerYcbcrConversion(
-        logical_device_, &conversion_create_info, nullptr, &conversion_));
-  }
-
-  VkSamplerYcbcrConversionInfo sampler_conversion_info = {
-      .sType = VK_STRUCTURE_TYPE_SAMPLER_YCBCR_CONVERSION_INFO,
-      .conversion = conversion_,
-  };
-
-  if (sampler_ == VK_NULL_HANDLE) {
-    sampler_ = CreateSampler(logical_device_, sampler_conversion_info);
-  }
-
-  if (descriptor_set_layout_ == VK_NULL_HANDLE) {
-    descriptor_set_layout_ =
-        CreateDescriptorSetLayout(logical_device_, sampler_);
-    InitDescriptorSets(logical_device_, descriptor_pool_,
-                       descriptor_set_layout_, max_frames_in_flight_);
+  ++frame_count_;
+  EvictIdleImportedBuffers();
+  ImportedBuffer& imported_buffer = GetImportedBuffer(hardware_buffer);
+
+  // The draw only changes with the geometry of the frame, so the commands
+  // recorded for the buffer are replayed until then.
+  VkCommandBuffer background_commands =
+      imported_buffer.background_commands[current_frame];
+  if (imported_buffer.background_geometry_versions[current_frame] !=
+      geometry_versions_[current_frame]) {
+    RecordBackgroundCommands(current_frame, imported_buffer.descriptor_set,
+                             background_commands);
+    imported_buffer.background_geometry_versions[current_frame] =
+        geometry_versions_[current_frame];
   }
+  frame_background_commands_[current_frame] = background_commands;
+}
 
-  if (pipeline_layout_ == VK_NULL_HANDLE) {
-    pipeline_layout_ =
-        CreatePipelineLayout(logical_device_, descriptor_set_layout_);
-    graphics_pipeline_ =
-        CreateGraphicsPipeline(logical_device_, render_pass_, pipeline_layout_);
-  }
+VulkanHandler::CameraImage VulkanHandler::GetCameraImage(
+    AHardwareBuffer* hardware_buffer) {
+  const ImportedBuffer& imported_buffer = GetImportedBuffer(hardware_buffer);
+  return {.image_view = imported_buffer.image_view,
+          .extent = imported_buffer.extent};
+}
 
-  // Update image and view
-  const VkImageViewCreateInfo view_create_info{
-      .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
-      .pNext = &sampler_conversion_info,
-      .flags = 0,
-      .image = texture_image_infos_[current_frame].texture_image,
-      .viewType = VK_IMAGE_VIEW_TYPE_2D,
-      .format = VK_FORMAT_UNDEFINED,
-      .components =
-          {
-              VK_COMPONENT_SWIZZLE_IDENTITY,
-              VK_COMPONENT_SWIZZLE_IDENTITY,
-              VK_COMPONENT_SWIZZLE_IDENTITY,
-              VK_COMPONENT_SWIZZLE_IDENTITY,
-          },
-      .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+void VulkanHandler::RecordBackgroundCommands(int current_frame,
+                                             VkDescriptorSet descriptor_set,
+                                             VkCommandBuffer command_buffer) {
+  // Any framebuffer of the render pass can execute the commands.
+  const VkCommandBufferInheritanceInfo inheritance_info{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+      .renderPass = render_pass_,
+      .subpass = 0,
+      .framebuffer = VK_NULL_HANDLE,
+      .occlusionQueryEnable = VK_FALSE,
+      .queryFlags = 0,
+      .pipelineStatistics = 0,
   };
-  CALL_VK(vkCreateImageView(
-      logical_device_, &view_create_info,
-      /* pAllocator=*/nullptr,
-      &texture_image_infos_[current_frame].texture_image_view));
-
-  // Transfer Image Layout
-  TransitionImageLayout(texture_image_infos_[current_frame].texture_image,
-                        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-
-  // Update Descriptor Sets
-  VkDescriptorImageInfo image_info{
-      .sampler = sampler_,
-      .imageView = texture_image_infos_[current_frame].texture_image_view,
-      .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+  const VkCommandBufferBeginInfo begin_info{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+      .pInheritanceInfo = &inheritance_info,
   };
-
-  VkWriteDescriptorSet descriptor_writes[1];
-
-  descriptor_writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-  descriptor_writes[0].dstSet = descriptor_sets_[current_frame];
-  descriptor_writes[0].dstBinding = 0;
-  descriptor_writes[0].dstArrayElement = 0;
-  descriptor_writes[0].descriptorType =
-      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-  descriptor_writes[0].descriptorCount = 1;
-  descriptor_writes[0].pImageInfo = &image_info;
-
-  vkUpdateDescriptorSets(logical_device_, 1, descriptor_writes, 0, nullptr);
+  CALL_VK(vkBeginCommandBuffer(command_buffer, &begin_info));
 
   // Update Viewport and scissor
   VkViewport viewport = {
       .x = 0,
       .y = 0,
-      .width = static_cast<float>(surface_capabilities_.currentExtent.width),
-      .height = static_cast<float>(surface_capabilities_.currentExtent.height),
+      .width = static_cast<float>(swapchain_extent_.width),
+      .height = static_cast<float>(swapchain_extent_.height),
       .minDepth = 0.0,
       .maxDepth = 1.0};
 
   VkRect2D scissor = {
-      .extent = {.width = static_cast<uint32_t>(
-                     surface_capabilities_.currentExtent.width),
-                 .height = static_cast<uint32_t>(
-                     surface_capabilities_.currentExtent.height)},
+      .extent = swapchain_extent_,
   };
 
   scissor.offset = {.x = 0, .y = 0};
 
   // Bind to the command buffer.
-  vkCmdBindPipeline(command_buffers_[current_frame],
-                    VK_PIPELINE_BIND_POINT_GRAPHICS, graphics_pipeline_);
-  vkCmdSetViewport(command_buffers_[current_frame], 0, 1, &viewport);
-  vkCmdSetScissor(command_buffers_[current_frame], 0, 1, &scissor);
+  vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    graphics_pipeline_);
+  vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+  vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+
+  const VkDeviceSize vertex_offset = GetVertexOffset(current_frame);
+  vkCmdBindVertexBuffers(command_buffer, 0, 1, &geometry_buffer_,
+                         &vertex_offset);
 
-  VkDeviceSize offset = 0;
-  vkCmdBindVertexBuffers(command_buffers_[current_frame], 0, 1,
-                         &vertex_buffers_[current_frame], &offset);
+  vkCmdBindIndexBuffer(command_buffer, geometry_buffer_,
+                       GetIndexOffset(current_frame), VK_INDEX_TYPE_UINT16);
 
-  vkCmdBindIndexBuffer(command_buffers_[current_frame],
-                       index_buffers_[current_frame], 0, VK_INDEX_TYPE_UINT16);
+  vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          pipeline_layout_, 0, 1, &descriptor_set, 0, nullptr);
+  vkCmdDrawIndexed(command_buffer, index_count_[current_frame], 1, 0, 0, 0);
 
-  vkCmdBindDescriptorSets(command_buffers_[current_frame],
-                          VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_, 0,
-                          1, &descriptor_sets_[current_frame], 0, nullptr);
-  vkCmdDrawIndexed(command_buffers_[current_frame], index_count_[current_frame],
-                   1, 0, 0, 0);
+  CALL_VK(vkEndCommandBuffer(command_buffer));
 }
 
 bool VulkanHandler::IsVerticesSetForFrame(int current_frame) {
-  return vertex_buffers_[current_frame] != VK_NULL_HANDLE;
+  return index_count_[current_frame] > 0;
 }
 
-void VulkanHandler::SetVerticesAndIndicesForFrame(
-    int current_frame, std::vector<VertexInfo> vertices,
-    std::vector<uint16_t> indices) {
-  CleanVertiesAndIndies(current_frame);
-
-  VkDeviceSize vertex_buffer_size = sizeof(vertices[0]) * vertices.size();
-  CreateBuffer(
-      physical_device_, vertex_buffer_size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-      vertex_buffers_[current_frame], vertex_buffers_memory_[current_frame]);
-
-  void* vertex_data;
-  CALL_VK(vkMapMemory(logical_device_, vertex_buffers_memory_[current_frame], 0,
-                      vertex_buffer_size, 0, &vertex_data));
-  memcpy(vertex_data, vertices.data(), vertex_buffer_size);
-  vkUnmapMemory(logical_device_, vertex_buffers_memory_[current_frame]);
-
-  // Create an index buffer to draw square textures.
-  VkDeviceSize index_buffer_size = sizeof(indices[0]) * indices.size();
-  CreateBuffer(
-      physical_device_, index_buffer_size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-      index_buffers_[current_frame], index_buffers_memory_[current_frame]);
-
-  void* index_data;
-  vkMapMemory(logical_device_, index_buffers_memory_[current_frame], 0,
-              index_buffer_size, 0, &index_data);
-  memcpy(index_data, indices.data(), index_buffer_size);
-  vkUnmapMemory(logical_device_, index_buffers_memory_[current_frame]);
-
-  index_count_[current_frame] = indices.size();
+void VulkanHandler::SetVerticesAndIndicesForFrame(int current_frame,
+                                                  const VertexInfo* vertices,
+                                                  size_t vertex_count,
+                                                  const uint16_t* indices,
+                                                  size_t index_count) {
+  CHECK(vertex_count <= kMaxVerticesPerFrame);
+  CHECK(index_count <= kMaxIndicesPerFrame);
+
+  // The memory is host coherent, so the writes need neither a flush nor an
+  // unmap before the frame is submitted.
+  memcpy(geometry_data_ + GetVertexOffset(current_frame), vertices,
+         sizeof(VertexInfo) * vertex_count);
+  memcpy(geometry_data_ + GetIndexOffset(current_frame), indices,
+         sizeof(uint16_t) * index_count);
+
+  index_count_[current_frame] = index_count;
+  // The background commands of the frame bind the old index count.
+  ++geometry_versions_[current_frame];
 }
 
 void VulkanHandler::BeginRenderPass(int current_frame,
                                     uint32_t swapchain_image_index) {
-  const VkClearValue clear_vals{.color = {.float32 = {0.0f, 1.0f, 0.0f, 1.0f}}};
+  const VkClearValue clear_vals[2] = {
+      {.color = {.float32 = {0.0f, 1.0f, 0.0f, 1.0f}}},
+      {.depthStencil = {.depth = 1.0f, .stencil = 0}},
+  };
   const VkRenderPassBeginInfo render_pass_begin_info{
       .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
       .renderPass = render_pass_,
@@ -413,16 +452,85 @@ void VulkanHandler::BeginRenderPass(int current_frame,
                       .x = 0,
                       .y = 0,
                   },
-              .extent = surface_capabilities_.currentExtent,
+              .extent = swapchain_extent_,
           },
-      .clearValueCount = 1,
-      .pClearValues = &clear_vals};
+      .clearValueCount = 2,
+      .pClearValues = clear_vals};
+  if (timestamp_query_pool_ != VK_NULL_HANDLE) {
+    // Queries can only be reset outside of a render pass.
+    vkCmdResetQueryPool(command_buffers_[current_frame], timestamp_query_pool_,
+                        /* firstQuery=*/current_frame * 2,
+                        /* queryCount=*/2);
+    vkCmdWriteTimestamp(command_buffers_[current_frame],
+                        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                        timestamp_query_pool_, current_frame * 2);
+  }
   vkCmdBeginRenderPass(command_buffers_[current_frame], &render_pass_begin_info,
-                       VK_SUBPASS_CONTENTS_INLINE);
+                       VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+  frame_framebuffers_[current_frame] =
+      swapchain_image_relatives_[swapchain_image_index].frame_buffer;
+  frame_background_commands_[current_frame] = VK_NULL_HANDLE;
+  content_slot_counts_[current_frame] = 0;
+}
+
+void VulkanHandler::RecordContent(
+    int current_frame, const std::vector<ContentRecorder>& recorders) {
+  CHECK(recorders.size() <= kMaxContentSlots);
+  const VkCommandBufferInheritanceInfo inheritance_info{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+      .renderPass = render_pass_,
+      .subpass = 0,
+      .framebuffer = frame_framebuffers_[current_frame],
+      .occlusionQueryEnable = VK_FALSE,
+      .queryFlags = 0,
+      .pipelineStatistics = 0,
+  };
+  const VkCommandBufferBeginInfo begin_info{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+               VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+      .pInheritanceInfo = &inheritance_info,
+  };
+
+  // Every slot has its own pool, so the workers never share one.
+  recording_workers_->Run(recorders.size(), [&](int slot) {
+    const size_t index = GetContentSlotIndex(current_frame, slot);
+    CALL_VK(vkResetCommandPool(logical_device_, content_command_pools_[index],
+                               /* flags=*/0));
+    VkCommandBuffer command_buffer = content_command_buffers_[index];
+    CALL_VK(vkBeginCommandBuffer(command_buffer, &begin_info));
+    recorders[slot](command_buffer);
+    CALL_VK(vkEndCommandBuffer(command_buffer));
+  });
+  content_slot_counts_[current_frame] = recorders.size();
 }
 
 void VulkanHandler::EndRenderPass(int current_frame) {
+  // The camera image goes first, everything else is drawn over it in the
+  // order of the recorders.
+  VkCommandBuffer secondary_command_buffers[kMaxContentSlots + 1];
+  uint32_t secondary_command_buffer_count = 0;
+  if (frame_background_commands_[current_frame] != VK_NULL_HANDLE) {
+    secondary_command_buffers[secondary_command_buffer_count++] =
+        frame_background_commands_[current_frame];
+  }
+  for (size_t slot = 0; slot < content_slot_counts_[current_frame]; slot++) {
+    secondary_command_buffers[secondary_command_buffer_count++] =
+        content_command_buffers_[GetContentSlotIndex(current_frame, slot)];
+  }
+  if (secondary_command_buffer_count > 0) {
+    vkCmdExecuteCommands(command_buffers_[current_frame],
+                         secondary_command_buffer_count,
+                         secondary_command_buffers);
+  }
   vkCmdEndRenderPass(command_buffers_[current_frame]);
+  if (timestamp_query_pool_ != VK_NULL_HANDLE) {
+    vkCmdWriteTimestamp(command_buffers_[current_frame],
+                        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                        timestamp_query_pool_, current_frame * 2 + 1);
+    frame_timestamps_written_[current_frame] = true;
+  }
 }
 
 void VulkanHandler::BeginRecordingCommandBuffer(int current_frame) {
@@ -443,15 +551,17 @@ void VulkanHandler::FinishRecordingCommandBuffer(int current_frame) {
 void VulkanHandler::SubmitRecordingCommandBuffer(int current_frame) {
   CALL_VK(vkResetFences(logical_device_, 1, &fences_[current_frame]));
 
-  VkSemaphore wait_semaphores[] = {image_available_semaphores[current_frame]};
+  submit_wait_semaphores_.insert(submit_wait_semaphores_.begin(),
+                                 image_available_semaphores[current_frame]);
+  submit_wait_stages_.insert(submit_wait_stages_.begin(),
+                             VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
   VkSemaphore signal_semaphores[] = {render_finished_semaphores[current_frame]};
-  VkPipelineStageFlags waitStages[] = {
-      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
   const VkSubmitInfo submit_info = {
       .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-      .waitSemaphoreCount = 1,
-      .pWaitSemaphores = wait_semaphores,
-      .pWaitDstStageMask = waitStages,
+      .waitSemaphoreCount =
+          static_cast<uint32_t>(submit_wait_semaphores_.size()),
+      .pWaitSemaphores = submit_wait_semaphores_.data(),
+      .pWaitDstStageMask = submit_wait_stages_.data(),
       .commandBufferCount = 1,
       .pCommandBuffers = &command_buffers_[current_frame],
       .signalSemaphoreCount = 1,
@@ -459,16 +569,38 @@ void VulkanHandler::SubmitRecordingCommandBuffer(int current_frame) {
 
   VkResult result =
       vkQueueSubmit(queue_, 1, &submit_info, fences_[current_frame]);
+  submit_wait_semaphores_.clear();
+  submit_wait_stages_.clear();
   if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
     LOGE("Failed to submit command buffer due to error code %d", result);
   }
 }
 
+void VulkanHandler::AddSubmitWaitSemaphore(VkSemaphore semaphore,
+                                           VkPipelineStageFlags stage) {
+  submit_wait_semaphores_.push_back(semaphore);
+  submit_wait_stages_.push_back(stage);
+}
+
 void VulkanHandler::PresentRecordingCommandBuffer(
     int current_frame, uint32_t swapchain_image_index) {
   VkSemaphore signal_semaphores[] = {render_finished_semaphores[current_frame]};
+  if (display_timing_enabled_) {
+    UpdatePresentTimings();
+  }
+  const VkPresentTimeGOOGLE present_time{
+      .presentID = next_present_id_++,
+      .desiredPresentTime =
+          display_timing_enabled_ ? GetDesiredPresentTime() : 0,
+  };
+  const VkPresentTimesInfoGOOGLE present_times_info{
+      .sType = VK_STRUCTURE_TYPE_PRESENT_TIMES_INFO_GOOGLE,
+      .swapchainCount = 1,
+      .pTimes = &present_time,
+  };
   VkPresentInfoKHR present_info = {
       .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+      .pNext = display_timing_enabled_ ? &present_times_info : nullptr,
       .waitSemaphoreCount = 1,
       .pWaitSemaphores = signal_semaphores,
       .swapchainCount = 1,
@@ -477,11 +609,146 @@ void VulkanHandler::PresentRecordingCommandBuffer(
   };
 
   VkResult result = vkQueuePresentKHR(queue_, &present_info);
-  if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+  if (result == VK_SUBOPTIMAL_KHR || result == VK_ERROR_OUT_OF_DATE_KHR) {
+    // Typically the display rotated, so the transform no longer matches.
+    swapchain_out_of_date_ = true;
+  } else if (result != VK_SUCCESS) {
     LOGE("Failed to present due to error code %d", result);
   }
 }
 
+void VulkanHandler::SavePipelineCache() {
+  if (pipeline_cache_path_.empty()) {
+    return;
+  }
+  size_t size = 0;
+  CALL_VK(vkGetPipelineCacheData(logical_device_, pipeline_cache_, &size,
+                                 /* pData=*/nullptr));
+  // Entries are only ever added, so an unchanged size means nothing new was
+  // compiled since the cache was loaded or last saved.
+  if (size == saved_pipeline_cache_size_) {
+    return;
+  }
+  std::vector<uint8_t> data(size);
+  CALL_VK(vkGetPipelineCacheData(logical_device_, pipeline_cache_, &size,
+                                 data.data()));
+  if (util::WriteFileAtomically(pipeline_cache_path_, data.data(), size)) {
+    saved_pipeline_cache_size_ = size;
+  }
+}
+
+bool VulkanHandler::AllocateFrameData(int current_frame, VkDeviceSize size,
+                                      VkDeviceSize alignment, VkBuffer* buffer,
+                                      VkDeviceSize* offset, void** data) {
+  std::lock_guard<std::mutex> lock(frame_arena_mutex_);
+  if (!frame_arenas_[current_frame]->Allocate(size, alignment, buffer, offset,
+                                              data)) {
+    LOGE("VulkanHandler: frame data of %llu bytes does not fit.",
+         static_cast<unsigned long long>(size));
+    return false;
+  }
+  return true;
+}
+
+VkDescriptorSet VulkanHandler::AllocateFrameDescriptorSet(
+    int current_frame, VkDescriptorSetLayout layout) {
+  const VkDescriptorSetAllocateInfo alloc_info{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+      .descriptorPool = frame_descriptor_pools_[current_frame],
+      .descriptorSetCount = 1,
+      .pSetLayouts = &layout,
+  };
+  VkDescriptorSet descriptor_set = VK_NULL_HANDLE;
+  std::lock_guard<std::mutex> lock(frame_arena_mutex_);
+  const VkResult result =
+      vkAllocateDescriptorSets(logical_device_, &alloc_info, &descriptor_set);
+  if (result != VK_SUCCESS) {
+    LOGE("VulkanHandler: frame descriptor pool is exhausted (%d).", result);
+    return VK_NULL_HANDLE;
+  }
+  return descriptor_set;
+}
+
+VkDescriptorUpdateTemplate VulkanHandler::CreateDescriptorUpdateTemplate(
+    VkDescriptorSetLayout layout,
+    const std::vector<VkDescriptorUpdateTemplateEntry>& entries) const {
+  const VkDescriptorUpdateTemplateCreateInfo template_info{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO,
+      .descriptorUpdateEntryCount = static_cast<uint32_t>(entries.size()),
+      .pDescriptorUpdateEntries = entries.data(),
+      .templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET,
+      .descriptorSetLayout = layout,
+  };
+  VkDescriptorUpdateTemplate update_template;
+  CALL_VK(vkCreateDescriptorUpdateTemplate(logical_device_, &template_info,
+                                           /* pAllocator=*/nullptr,
+                                           &update_template));
+  return update_template;
+}
+
+VulkanMemoryAllocator::Stats VulkanHandler::GetMemoryStats() const {
+  return memory_allocator_->GetStats();
+}
+
+VulkanHandler::GpuTimeStats VulkanHandler::GetRenderPassGpuStats() const {
+  GpuTimeStats stats;
+  if (gpu_time_count_ == 0) {
+    return stats;
+  }
+  // Before the window wrapped the samples are its prefix; afterwards all of
+  // it is valid.
+  std::array<float, kGpuTimeWindowSize> sorted = render_pass_gpu_times_ms_;
+  float sum_ms = 0.f;
+  for (int i = 0; i < gpu_time_count_; i++) {
+    sum_ms += sorted[i];
+  }
+  const int p95_index = (gpu_time_count_ - 1) * 95 / 100;
+  std::nth_element(sorted.begin(), sorted.begin() + p95_index,
+                   sorted.begin() + gpu_time_count_);
+  stats.p95_ms = sorted[p95_index];
+  stats.min_ms =
+      *std::min_element(sorted.begin(), sorted.begin() + p95_index + 1);
+  stats.avg_ms = sum_ms / gpu_time_count_;
+  stats.sample_count = gpu_time_count_;
+  return stats;
+}
+
+void VulkanHandler::WaitForAllFrames() {
+  CALL_VK(vkWaitForFences(logical_device_, fences_.size(), fences_.data(),
+                          VK_TRUE, kFenceTimeoutNs));
+}
+
+bool VulkanHandler::RecreateSwapchain() {
+  CALL_VK(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(
+      physical_device_, surface_, &surface_capabilities_));
+  const VkExtent2D extent = GetIdentityExtent(surface_capabilities_);
+  if (extent.width == 0 || extent.height == 0) {
+    return false;
+  }
+  if (!swapchain_out_of_date_ && extent.width == swapchain_extent_.width &&
+      extent.height == swapchain_extent_.height &&
+      surface_capabilities_.currentTransform == pre_transform_) {
+    return true;
+  }
+
+  // The framebuffers of the old images may still be in use.
+  WaitForAllFrames();
+  CleanSwapchainImageRelatives();
+  const VkSwapchainKHR old_swapchain = swapchain_;
+  InitSwapchain(old_swapchain);
+  // The new swapchain retired the old one, whose images are no longer used.
+  vkDestroySwapchainKHR(logical_device_, old_swapchain,
+                        /* pAllocator=*/nullptr);
+  // The background commands set the viewport of the old extent.
+  for (uint64_t& geometry_version : geometry_versions_) {
+    ++geometry_version;
+  }
+  swapchain_out_of_date_ = false;
+  LOGI("VulkanHandler: swapchain recreated at %ux%u, transform %d.",
+       swapchain_extent_.width, swapchain_extent_.height, pre_transform_);
+  return true;
+}
+
 // ============================= Private =============================
 
 VkInstance VulkanHandler::CreateInstance() {
@@ -500,7 +767,7 @@ VkInstance VulkanHandler::CreateInstance() {
       .applicationVersion = VK_MAKE_VERSION(1, 0, 0),
       .pEngineName = "vulkan",
       .engineVersion = VK_MAKE_VERSION(1, 0, 0),
-      .apiVersion = VK_MAKE_VERSION(1, 2, 0),
+      .apiVersion = kApiVersion,
   };
   const VkInstanceCreateInfo instance_create_info{
       .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
@@ -513,6 +780,9 @@ VkInstance VulkanHandler::CreateInstance() {
   };
   CALL_VK(vkCreateInstance(&instance_create_info,
                            /* pAllocator=*/nullptr, &instance));
+  LoadInstanceFunctions(instance, kApiVersion,
+                        instance_create_info.enabledExtensionCount,
+                        instance_create_info.ppEnabledExtensionNames);
 
   return instance;
 }
@@ -571,13 +841,35 @@ uint32_t VulkanHandler::GetQueueFamilyIndex(VkPhysicalDevice physical_device) {
   return queue_family_index;
 }
 
-VkDevice VulkanHandler::CreateLogicalDevice(VkPhysicalDevice physical_device,
-                                            uint32_t queue_family_index) {
-  VkDevice logical_device;
-  std::vector<const char*> device_extensions;
-  device_extensions.push_back("VK_KHR_swapchain");
-  device_extensions.push_back(
-      "VK_ANDROID_external_memory_android_hardware_buffer");
+uint32_t VulkanHandler::GetTransferQueueFamilyIndex(
+    VkPhysicalDevice physical_device, uint32_t queue_family_index) {
+  uint32_t queue_family_count;
+  vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_family_count,
+                                           nullptr);
+  std::vector<VkQueueFamilyProperties> queue_family_properties(
+      queue_family_count);
+  vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_family_count,
+                                           queue_family_properties.data());
+
+  for (uint32_t i = 0; i < queue_family_count; i++) {
+    const VkQueueFlags flags = queue_family_properties[i].queueFlags;
+    if ((flags & VK_QUEUE_TRANSFER_BIT) &&
+        !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) &&
+        queue_family_properties[i].queueCount > 0) {
+      LOGI("Copies run on a dedicated transfer queue of family %u.", i);
+      return i;
+    }
+  }
+  return queue_family_index;
+}
+
+VkDevice VulkanHandler::CreateLogicalDevice(VkPhysicalDevice physical_device,
+                                            uint32_t queue_family_index) {
+  VkDevice logical_device;
+  std::vector<const char*> device_extensions;
+  device_extensions.push_back("VK_KHR_swapchain");
+  device_extensions.push_back(
+      "VK_ANDROID_external_memory_android_hardware_buffer");
   device_extensions.push_back("VK_KHR_sampler_ycbcr_conversion");
   device_extensions.push_back("VK_KHR_maintenance1");
   device_extensions.push_back("VK_KHR_bind_memory2");
@@ -585,16 +877,28 @@ VkDevice VulkanHandler::CreateLogicalDevice(VkPhysicalDevice physical_device,
   device_extensions.push_back("VK_KHR_external_memory");
   device_extensions.push_back("VK_EXT_queue_family_foreign");
   device_extensions.push_back("VK_KHR_dedicated_allocation");
+  if (display_timing_enabled_) {
+    device_extensions.push_back(VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME);
+  }
 
   float priorities[] = {
       1.0f,
   };
-  const VkDeviceQueueCreateInfo queue_create_info{
-      .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-      .flags = 0,
-      .queueFamilyIndex = queue_family_index,
-      .queueCount = 1,
-      .pQueuePriorities = priorities,
+  const VkDeviceQueueCreateInfo queue_create_infos[2] = {
+      {
+          .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+          .flags = 0,
+          .queueFamilyIndex = queue_family_index,
+          .queueCount = 1,
+          .pQueuePriorities = priorities,
+      },
+      {
+          .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+          .flags = 0,
+          .queueFamilyIndex = transfer_queue_family_index_,
+          .queueCount = 1,
+          .pQueuePriorities = priorities,
+      },
   };
 
   const VkPhysicalDeviceVulkan11Features physicalDeviceFeatures{
@@ -605,8 +909,9 @@ VkDevice VulkanHandler::CreateLogicalDevice(VkPhysicalDevice physical_device,
   const VkDeviceCreateInfo device_create_info{
       .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
       .pNext = &physicalDeviceFeatures,
-      .queueCreateInfoCount = 1,
-      .pQueueCreateInfos = &queue_create_info,
+      .queueCreateInfoCount =
+          transfer_queue_family_index_ != queue_family_index ? 2u : 1u,
+      .pQueueCreateInfos = queue_create_infos,
       .enabledLayerCount = 0,
       .ppEnabledLayerNames = nullptr,
       .enabledExtensionCount = static_cast<uint32_t>(device_extensions.size()),
@@ -616,6 +921,9 @@ VkDevice VulkanHandler::CreateLogicalDevice(VkPhysicalDevice physical_device,
 
   CALL_VK(vkCreateDevice(physical_device, &device_create_info,
                          /* pAllocator=*/nullptr, &logical_device));
+  LoadDeviceFunctions(instance_, logical_device, kApiVersion,
+                      device_create_info.enabledExtensionCount,
+                      device_create_info.ppEnabledExtensionNames);
   return logical_device;
 }
 
@@ -644,32 +952,63 @@ VkSurfaceFormatKHR VulkanHandler::GetSurfaceFormat(
   return surface_format;
 }
 
+VkPresentModeKHR VulkanHandler::ChoosePresentMode(
+    VkPhysicalDevice physical_device, VkSurfaceKHR surface) {
+  // FIFO is the only mode every surface supports.
+  if (pacing_mode_ != PacingMode::kLowLatency) {
+    return VK_PRESENT_MODE_FIFO_KHR;
+  }
+  uint32_t mode_count = 0;
+  vkGetPhysicalDeviceSurfacePresentModesKHR(physical_device, surface,
+                                            &mode_count, nullptr);
+  std::vector<VkPresentModeKHR> modes(mode_count);
+  vkGetPhysicalDeviceSurfacePresentModesKHR(physical_device, surface,
+                                            &mode_count, modes.data());
+  if (std::find(modes.begin(), modes.end(), VK_PRESENT_MODE_MAILBOX_KHR) !=
+      modes.end()) {
+    return VK_PRESENT_MODE_MAILBOX_KHR;
+  }
+  LOGI("VulkanHandler: MAILBOX is not supported, pacing with FIFO.");
+  return VK_PRESENT_MODE_FIFO_KHR;
+}
+
 VkSwapchainKHR VulkanHandler::CreateSwapchain(
     VkDevice logical_device, VkSurfaceKHR surface,
     VkSurfaceCapabilitiesKHR surface_capabilities,
-    VkSurfaceFormatKHR surface_format, uint32_t queue_family_index) {
+    VkSurfaceFormatKHR surface_format, uint32_t queue_family_index,
+    VkPresentModeKHR present_mode, VkExtent2D extent,
+    VkSwapchainKHR old_swapchain) {
   VkSwapchainKHR swapchain;
   memset(&swapchain, 0, sizeof(swapchain));
 
-  // Create a swap chain (here we choose the minimum available number of surface
-  // in the chain)
+  // Create a swap chain with the minimum available number of surfaces in the
+  // chain, or the fewest MAILBOX can replace queued images with.
+  uint32_t image_count = surface_capabilities.minImageCount;
+  if (present_mode == VK_PRESENT_MODE_MAILBOX_KHR) {
+    image_count = std::max(image_count, kMailboxMinImageCount);
+    if (surface_capabilities.maxImageCount != 0) {
+      image_count = std::min(image_count, surface_capabilities.maxImageCount);
+    }
+  }
   const VkSwapchainCreateInfoKHR swapchain_create_info{
       .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
       .surface = surface,
-      .minImageCount = surface_capabilities.minImageCount,
+      .minImageCount = image_count,
       .imageFormat = surface_format.format,
       .imageColorSpace = surface_format.colorSpace,
-      .imageExtent = surface_capabilities.currentExtent,
+      .imageExtent = extent,
       .imageArrayLayers = 1,
       .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
       .imageSharingMode = VK_SHARING_MODE_EXCLUSIVE,
       .queueFamilyIndexCount = 1,
       .pQueueFamilyIndices = &queue_family_index,
-      .preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR,
+      // The images are drawn rotated, see GetPreTransform(). Otherwise the
+      // compositor rotates every frame, which can cost a GPU pass.
+      .preTransform = surface_capabilities.currentTransform,
       .compositeAlpha = VK_COMPOSITE_ALPHA_INHERIT_BIT_KHR,
-      .presentMode = VK_PRESENT_MODE_FIFO_KHR,
+      .presentMode = present_mode,
       .clipped = VK_FALSE,
-      .oldSwapchain = VK_NULL_HANDLE,
+      .oldSwapchain = old_swapchain,
   };
 
   CALL_VK(vkCreateSwapchainKHR(logical_device, &swapchain_create_info,
@@ -678,21 +1017,62 @@ VkSwapchainKHR VulkanHandler::CreateSwapchain(
   return swapchain;
 }
 
+VkPipelineCache VulkanHandler::CreatePipelineCache(
+    VkPhysicalDevice physical_device, VkDevice logical_device) {
+  std::vector<uint8_t> initial_data;
+  if (!pipeline_cache_path_.empty() &&
+      util::ReadFile(pipeline_cache_path_, &initial_data)) {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physical_device, &properties);
+    if (!IsPipelineCacheCompatible(initial_data, properties)) {
+      LOGI("Discarding pipeline cache of another device or driver.");
+      initial_data.clear();
+    }
+  }
+
+  VkPipelineCache pipeline_cache;
+  const VkPipelineCacheCreateInfo pipeline_cache_create_info{
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+      .flags = 0,
+      .initialDataSize = initial_data.size(),
+      .pInitialData = initial_data.empty() ? nullptr : initial_data.data(),
+  };
+  CALL_VK(vkCreatePipelineCache(logical_device, &pipeline_cache_create_info,
+                                /* pAllocator=*/nullptr, &pipeline_cache));
+  saved_pipeline_cache_size_ = initial_data.size();
+  return pipeline_cache;
+}
+
 VkRenderPass VulkanHandler::CreateRenderPass(VkDevice logical_device) {
   VkRenderPass render_pass;
-  const VkAttachmentDescription attachment_descriptions{
-      .format = VK_FORMAT_R8G8B8A8_UNORM,
-      .samples = VK_SAMPLE_COUNT_1_BIT,
-      .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-      .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-      .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-      .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-      .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-      .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+  const VkAttachmentDescription attachment_descriptions[2] = {
+      {
+          .format = VK_FORMAT_R8G8B8A8_UNORM,
+          .samples = VK_SAMPLE_COUNT_1_BIT,
+          .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+          .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+          .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+          .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+          .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+          .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+      },
+      {
+          .format = kDepthFormat,
+          .samples = VK_SAMPLE_COUNT_1_BIT,
+          .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+          .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+          .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+          .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+          .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+          .finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+      },
   };
 
   const VkAttachmentReference colour_reference = {
       .attachment = 0, .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+  const VkAttachmentReference depth_reference = {
+      .attachment = 1,
+      .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
 
   const VkSubpassDescription subpass_description{
       .flags = 0,
@@ -702,30 +1082,45 @@ VkRenderPass VulkanHandler::CreateRenderPass(VkDevice logical_device) {
       .colorAttachmentCount = 1,
       .pColorAttachments = &colour_reference,
       .pResolveAttachments = nullptr,
-      .pDepthStencilAttachment = nullptr,
+      .pDepthStencilAttachment = &depth_reference,
       .preserveAttachmentCount = 0,
       .pPreserveAttachments = nullptr,
   };
+  // The depth image of a swapchain image is cleared again by the next frame
+  // drawing to it, which must wait for the previous frame's depth tests.
+  const VkSubpassDependency dependency{
+      .srcSubpass = VK_SUBPASS_EXTERNAL,
+      .dstSubpass = 0,
+      .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                      VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+      .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                      VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+      .srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                       VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+      .dependencyFlags = 0,
+  };
   const VkRenderPassCreateInfo render_pass_create_info{
       .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
-      .attachmentCount = 1,
-      .pAttachments = &attachment_descriptions,
+      .attachmentCount = 2,
+      .pAttachments = attachment_descriptions,
       .subpassCount = 1,
       .pSubpasses = &subpass_description,
-      .dependencyCount = 0,
-      .pDependencies = nullptr,
+      .dependencyCount = 1,
+      .pDependencies = &dependency,
   };
   CALL_VK(vkCreateRenderPass(logical_device, &render_pass_create_info,
                              /* pAllocator=*/nullptr, &render_pass));
   return render_pass;
 }
 
-VkCommandPool VulkanHandler::CreateCommandPool(VkDevice logical_device,
-                                               uint32_t queue_family_index) {
+VkCommandPool VulkanHandler::CreateCommandPool(
+    VkDevice logical_device, uint32_t queue_family_index,
+    VkCommandPoolCreateFlags flags) {
   VkCommandPool command_pool;
   const VkCommandPoolCreateInfo cmd_pool_create_info{
       .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
-      .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+      .flags = flags,
       .queueFamilyIndex = queue_family_index,
   };
   CALL_VK(vkCreateCommandPool(logical_device, &cmd_pool_create_info,
@@ -734,16 +1129,18 @@ VkCommandPool VulkanHandler::CreateCommandPool(VkDevice logical_device,
 }
 
 VkDescriptorPool VulkanHandler::CreateDescriptorPool(VkDevice logical_device,
-                                                     int max_frames_in_flight) {
+                                                     uint32_t max_sets) {
   VkDescriptorPool descriptor_pool;
   VkDescriptorPoolSize pool_size{
       .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-      .descriptorCount = static_cast<uint32_t>(max_frames_in_flight),
+      .descriptorCount = max_sets,
   };
 
+  // Sets are freed one by one as imported buffers are evicted.
   VkDescriptorPoolCreateInfo pool_info{
       .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-      .maxSets = static_cast<uint32_t>(max_frames_in_flight),
+      .flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT,
+      .maxSets = max_sets,
       .poolSizeCount = 1,
       .pPoolSizes = &pool_size,
   };
@@ -753,6 +1150,31 @@ VkDescriptorPool VulkanHandler::CreateDescriptorPool(VkDevice logical_device,
   return descriptor_pool;
 }
 
+VkDescriptorPool VulkanHandler::CreateFrameDescriptorPool(
+    VkDevice logical_device) {
+  const VkDescriptorPoolSize pool_sizes[] = {
+      {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, kMaxFrameDescriptorsPerType},
+      {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, kMaxFrameDescriptorsPerType},
+      {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, kMaxFrameDescriptorsPerType},
+      {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, kMaxFrameDescriptorsPerType},
+  };
+
+  // Without VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT, allocating is
+  // a pointer bump and the sets go with vkResetDescriptorPool().
+  const VkDescriptorPoolCreateInfo pool_info{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+      .flags = 0,
+      .maxSets = kMaxFrameDescriptorSets,
+      .poolSizeCount = sizeof(pool_sizes) / sizeof(pool_sizes[0]),
+      .pPoolSizes = pool_sizes,
+  };
+
+  VkDescriptorPool descriptor_pool;
+  CALL_VK(vkCreateDescriptorPool(logical_device, &pool_info,
+                                 /* pAllocator=*/nullptr, &descriptor_pool));
+  return descriptor_pool;
+}
+
 VkSampler VulkanHandler::CreateSampler(
     VkDevice logical_device,
     VkSamplerYcbcrConversionInfo sampler_conversion_info) {
@@ -946,10 +1368,11 @@ VkPipeline VulkanHandler::CreateGraphicsPipeline(
       .dynamicStateCount = 2,
       .pDynamicStates = dynamic_state_enables};
 
+  // The camera image is behind everything else.
   VkPipelineDepthStencilStateCreateInfo depth_stencil = {
       .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
-      .depthTestEnable = VK_TRUE,
-      .depthWriteEnable = VK_TRUE,
+      .depthTestEnable = VK_FALSE,
+      .depthWriteEnable = VK_FALSE,
       .depthCompareOp = VK_COMPARE_OP_LESS,
       .depthBoundsTestEnable = VK_FALSE,
       .stencilTestEnable = VK_FALSE};
@@ -977,7 +1400,7 @@ VkPipeline VulkanHandler::CreateGraphicsPipeline(
       .basePipelineHandle = VK_NULL_HANDLE,
       .basePipelineIndex = 0,
   };
-  CALL_VK(vkCreateGraphicsPipelines(logical_device, VK_NULL_HANDLE, 1,
+  CALL_VK(vkCreateGraphicsPipelines(logical_device, pipeline_cache_, 1,
                                     &pipeline_create_info, nullptr,
                                     &graphics_pipeline));
 
@@ -987,27 +1410,25 @@ VkPipeline VulkanHandler::CreateGraphicsPipeline(
   return graphics_pipeline;
 }
 
-void VulkanHandler::InitDescriptorSets(
-    VkDevice logical_device, VkDescriptorPool descriptor_pool,
-    VkDescriptorSetLayout descriptor_set_layout, int max_frames_in_flight) {
-  descriptor_sets_.resize(max_frames_in_flight);
-  std::vector<VkDescriptorSetLayout> layouts(max_frames_in_flight,
-                                             descriptor_set_layout);
-  VkDescriptorSetAllocateInfo alloc_info{
-      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-      .descriptorPool = descriptor_pool,
-      .descriptorSetCount = static_cast<uint32_t>(max_frames_in_flight),
-      .pSetLayouts = layouts.data(),
-  };
+void VulkanHandler::InitSwapchain(VkSwapchainKHR old_swapchain) {
+  swapchain_extent_ = GetIdentityExtent(surface_capabilities_);
+  pre_transform_ = surface_capabilities_.currentTransform;
+  swapchain_ = CreateSwapchain(logical_device_, surface_, surface_capabilities_,
+                               surface_format_, queue_family_index_,
+                               present_mode_, swapchain_extent_, old_swapchain);
+  CALL_VK(vkGetSwapchainImagesKHR(logical_device_, swapchain_,
+                                  &swapchain_length_,
+                                  /* pSwapchainImages=*/nullptr));
 
-  CALL_VK(vkAllocateDescriptorSets(logical_device, &alloc_info,
-                                   descriptor_sets_.data()));
+  InitSwapchainImageRelatives(logical_device_, swapchain_, render_pass_,
+                              swapchain_extent_, surface_format_,
+                              swapchain_length_);
 }
 
 void VulkanHandler::InitSwapchainImageRelatives(
     VkDevice logical_device, VkSwapchainKHR swapchain, VkRenderPass render_pass,
-    VkSurfaceCapabilitiesKHR surface_capabilities,
-    VkSurfaceFormatKHR surface_format, uint32_t swapchain_length) {
+    VkExtent2D extent, VkSurfaceFormatKHR surface_format,
+    uint32_t swapchain_length) {
   std::vector<VkImage> swapchain_images;
   swapchain_images.resize(swapchain_length);
   CALL_VK(vkGetSwapchainImagesKHR(logical_device, swapchain, &swapchain_length,
@@ -1042,18 +1463,19 @@ void VulkanHandler::InitSwapchainImageRelatives(
                               /* pAllocator=*/nullptr,
                               &swapchain_image_relatives_[i].swapchain_view));
 
+    CreateDepthImage(extent, &swapchain_image_relatives_[i]);
+
     VkImageView attachments[2] = {
         swapchain_image_relatives_[i].swapchain_view,
+        swapchain_image_relatives_[i].depth_view,
     };
     VkFramebufferCreateInfo fb_create_info{
         .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
         .renderPass = render_pass,
-        .attachmentCount = 1,  // 2 if using depth
+        .attachmentCount = 2,
         .pAttachments = attachments,
-        .width =
-            static_cast<uint32_t>(surface_capabilities.currentExtent.width),
-        .height =
-            static_cast<uint32_t>(surface_capabilities.currentExtent.height),
+        .width = extent.width,
+        .height = extent.height,
         .layers = 1,
     };
 
@@ -1063,6 +1485,50 @@ void VulkanHandler::InitSwapchainImageRelatives(
   }
 }
 
+void VulkanHandler::CreateDepthImage(VkExtent2D extent,
+                                     SwapchinImageRelative* relative) {
+  const VkImageCreateInfo image_create_info = {
+      .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+      .flags = 0,
+      .imageType = VK_IMAGE_TYPE_2D,
+      .format = kDepthFormat,
+      .extent = {extent.width, extent.height, 1u},
+      .mipLevels = 1u,
+      .arrayLayers = 1u,
+      .samples = VK_SAMPLE_COUNT_1_BIT,
+      .tiling = VK_IMAGE_TILING_OPTIMAL,
+      // The depth is only needed within the render pass, so tilers can keep
+      // it in on-chip memory.
+      .usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+               VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+      .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+      .queueFamilyIndexCount = 0,
+      .pQueueFamilyIndices = nullptr,
+      .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+  };
+  CHECK(memory_allocator_->CreateImage(
+      image_create_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+      &relative->depth_image, &relative->depth_allocation));
+
+  const VkImageViewCreateInfo view_create_info = {
+      .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+      .flags = 0,
+      .image = relative->depth_image,
+      .viewType = VK_IMAGE_VIEW_TYPE_2D,
+      .format = kDepthFormat,
+      .components =
+          {
+              VK_COMPONENT_SWIZZLE_IDENTITY,
+              VK_COMPONENT_SWIZZLE_IDENTITY,
+              VK_COMPONENT_SWIZZLE_IDENTITY,
+              VK_COMPONENT_SWIZZLE_IDENTITY,
+          },
+      .subresourceRange = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1},
+  };
+  CALL_VK(vkCreateImageView(logical_device_, &view_create_info,
+                            /* pAllocator=*/nullptr, &relative->depth_view));
+}
+
 void VulkanHandler::InitCommandBuffers(VkDevice logical_device,
                                        VkCommandPool command_pool,
                                        int max_frames_in_flight) {
@@ -1075,6 +1541,48 @@ void VulkanHandler::InitCommandBuffers(VkDevice logical_device,
   };
   CALL_VK(vkAllocateCommandBuffers(logical_device, &cmd_buffer_create_info,
                                    command_buffers_.data()));
+
+  // One pool per content slot of every frame, reset as a whole by the
+  // worker recording the slot.
+  const size_t content_slot_count = max_frames_in_flight * kMaxContentSlots;
+  content_command_pools_.resize(content_slot_count);
+  content_command_buffers_.resize(content_slot_count);
+  for (size_t i = 0; i < content_slot_count; i++) {
+    content_command_pools_[i] =
+        CreateCommandPool(logical_device, queue_family_index_,
+                          VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+    const VkCommandBufferAllocateInfo secondary_create_info{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = content_command_pools_[i],
+        .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+        .commandBufferCount = 1,
+    };
+    CALL_VK(vkAllocateCommandBuffers(logical_device, &secondary_create_info,
+                                     &content_command_buffers_[i]));
+  }
+  content_slot_counts_.assign(max_frames_in_flight, 0);
+  frame_framebuffers_.assign(max_frames_in_flight, VK_NULL_HANDLE);
+  frame_background_commands_.assign(max_frames_in_flight, VK_NULL_HANDLE);
+}
+
+void VulkanHandler::InitGeometryBuffer(int max_frames_in_flight) {
+  geometry_slot_size_ =
+      AlignGeometryOffset(sizeof(VertexInfo) * kMaxVerticesPerFrame) +
+      AlignGeometryOffset(sizeof(uint16_t) * kMaxIndicesPerFrame);
+  const VkDeviceSize size = geometry_slot_size_ * max_frames_in_flight;
+  CreateBuffer(size,
+               VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                   VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+               geometry_buffer_, geometry_allocation_);
+
+  // The allocator keeps host visible memory mapped.
+  geometry_data_ = geometry_allocation_.mapped;
+
+  index_count_.assign(max_frames_in_flight, 0);
+  // Above the kNotRecorded versions of the background commands.
+  geometry_versions_.assign(max_frames_in_flight, kNotRecorded + 1);
 }
 
 void VulkanHandler::InitSyncObjects(VkDevice logical_device,
@@ -1103,41 +1611,451 @@ void VulkanHandler::InitSyncObjects(VkDevice logical_device,
   }
 }
 
-void VulkanHandler::CleanTextureImageInfo(int index) {
-  if (texture_image_infos_[index].texture_image != VK_NULL_HANDLE) {
-    vkDestroyImageView(logical_device_,
-                       texture_image_infos_[index].texture_image_view,
-                       /* vkDestroyImageView=*/nullptr);
-    texture_image_infos_[index].texture_image_view = VK_NULL_HANDLE;
-    vkFreeMemory(logical_device_, texture_image_infos_[index].texture_memory,
-                 /* pAllocator=*/nullptr);
-    texture_image_infos_[index].texture_memory = VK_NULL_HANDLE;
-    vkDestroyImage(logical_device_, texture_image_infos_[index].texture_image,
-                   /* pAllocator=*/nullptr);
-    texture_image_infos_[index].texture_image = VK_NULL_HANDLE;
+void VulkanHandler::InitTimestampQueries(int max_frames_in_flight) {
+  frame_timestamps_written_.assign(max_frames_in_flight, false);
+
+  uint32_t queue_family_count = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(physical_device_,
+                                           &queue_family_count, nullptr);
+  std::vector<VkQueueFamilyProperties> queue_family_properties(
+      queue_family_count);
+  vkGetPhysicalDeviceQueueFamilyProperties(physical_device_,
+                                           &queue_family_count,
+                                           queue_family_properties.data());
+  const uint32_t valid_bits =
+      queue_family_properties[queue_family_index_].timestampValidBits;
+  if (valid_bits == 0) {
+    LOGI("VulkanHandler: the queue does not support timestamps.");
+    return;
   }
+  timestamp_mask_ = valid_bits >= 64 ? ~0ull : (1ull << valid_bits) - 1;
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physical_device_, &properties);
+  timestamp_period_ns_ = properties.limits.timestampPeriod;
+
+  const VkQueryPoolCreateInfo create_info{
+      .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+      .queryType = VK_QUERY_TYPE_TIMESTAMP,
+      .queryCount = static_cast<uint32_t>(max_frames_in_flight * 2),
+  };
+  CALL_VK(vkCreateQueryPool(logical_device_, &create_info,
+                            /* pAllocator=*/nullptr, &timestamp_query_pool_));
 }
 
-void VulkanHandler::CleanVertiesAndIndies(int frame_index) {
-  if (vertex_buffers_[frame_index] != VK_NULL_HANDLE) {
-    index_count_[frame_index] = 0;
+void VulkanHandler::ReadFrameTimestamps(int current_frame) {
+  if (!frame_timestamps_written_[current_frame]) {
+    return;
+  }
+  frame_timestamps_written_[current_frame] = false;
+
+  // The frame's fence is signaled, so the results are available without
+  // VK_QUERY_RESULT_WAIT_BIT.
+  uint64_t timestamps[2] = {};
+  const VkResult result = vkGetQueryPoolResults(
+      logical_device_, timestamp_query_pool_,
+      /* firstQuery=*/current_frame * 2, /* queryCount=*/2, sizeof(timestamps),
+      timestamps, /* stride=*/sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+  if (result != VK_SUCCESS) {
+    return;
+  }
+  const uint64_t ticks = (timestamps[1] - timestamps[0]) & timestamp_mask_;
+  render_pass_gpu_times_ms_[next_gpu_time_] =
+      ticks * timestamp_period_ns_ / 1e6f;
+  next_gpu_time_ = (next_gpu_time_ + 1) % kGpuTimeWindowSize;
+  gpu_time_count_ = std::min(gpu_time_count_ + 1, kGpuTimeWindowSize);
+}
 
-    vkDestroyBuffer(logical_device_, index_buffers_[frame_index],
-                    /* pAllocator=*/nullptr);
-    index_buffers_[frame_index] = VK_NULL_HANDLE;
-    vkFreeMemory(logical_device_, index_buffers_memory_[frame_index],
-                 /* pAllocator=*/nullptr);
-    index_buffers_memory_[frame_index] = VK_NULL_HANDLE;
+void VulkanHandler::InitDisplayTiming() {
+  if (!display_timing_enabled_) {
+    return;
+  }
+  // Device extension functions are not exported by libvulkan.
+  get_refresh_cycle_duration_ =
+      reinterpret_cast<PFN_vkGetRefreshCycleDurationGOOGLE>(
+          vkGetDeviceProcAddr(logical_device_,
+                              "vkGetRefreshCycleDurationGOOGLE"));
+  get_past_presentation_timing_ =
+      reinterpret_cast<PFN_vkGetPastPresentationTimingGOOGLE>(
+          vkGetDeviceProcAddr(logical_device_,
+                              "vkGetPastPresentationTimingGOOGLE"));
+  VkRefreshCycleDurationGOOGLE refresh_cycle = {};
+  if (get_refresh_cycle_duration_ == nullptr ||
+      get_past_presentation_timing_ == nullptr ||
+      get_refresh_cycle_duration_(logical_device_, swapchain_,
+                                  &refresh_cycle) != VK_SUCCESS ||
+      refresh_cycle.refreshDuration == 0) {
+    LOGE("VulkanHandler: VK_GOOGLE_display_timing is unusable.");
+    display_timing_enabled_ = false;
+    return;
+  }
+  refresh_duration_ns_ = refresh_cycle.refreshDuration;
+}
 
-    vkDestroyBuffer(logical_device_, vertex_buffers_[frame_index],
-                    /* pAllocator=*/nullptr);
-    vertex_buffers_[frame_index] = VK_NULL_HANDLE;
-    vkFreeMemory(logical_device_, vertex_buffers_memory_[frame_index],
+uint64_t VulkanHandler::GetDesiredPresentTime() {
+  if (last_actual_present_ns_ == 0) {
+    return 0;
+  }
+  // The frame was just submitted, so it is ready once the GPU has rendered
+  // it. Vsyncs happen every refresh_duration_ns_ from the last present.
+  const uint64_t ready_ns =
+      GetMonotonicTimeNs() +
+      static_cast<uint64_t>(GetRenderPassGpuStats().p95_ms * 1e6f) +
+      kPresentSlackNs;
+  if (ready_ns <= last_actual_present_ns_) {
+    return last_actual_present_ns_ + refresh_duration_ns_;
+  }
+  const uint64_t refreshes =
+      (ready_ns - last_actual_present_ns_ + refresh_duration_ns_ - 1) /
+      refresh_duration_ns_;
+  return last_actual_present_ns_ + refreshes * refresh_duration_ns_;
+}
+
+void VulkanHandler::UpdatePresentTimings() {
+  uint32_t timing_count = 0;
+  if (get_past_presentation_timing_(logical_device_, swapchain_,
+                                    &timing_count, nullptr) != VK_SUCCESS ||
+      timing_count == 0) {
+    return;
+  }
+  std::vector<VkPastPresentationTimingGOOGLE> timings(timing_count);
+  const VkResult result = get_past_presentation_timing_(
+      logical_device_, swapchain_, &timing_count, timings.data());
+  if (result != VK_SUCCESS && result != VK_INCOMPLETE) {
+    return;
+  }
+
+  for (uint32_t i = 0; i < timing_count; i++) {
+    const VkPastPresentationTimingGOOGLE& timing = timings[i];
+    last_actual_present_ns_ =
+        std::max(last_actual_present_ns_, timing.actualPresentTime);
+    // Half a refresh absorbs the jitter of the reported times.
+    if (timing.desiredPresentTime != 0 &&
+        timing.actualPresentTime >
+            timing.desiredPresentTime + refresh_duration_ns_ / 2) {
+      window_missed_presents_++;
+    }
+    window_min_margin_ns_ =
+        std::min(window_min_margin_ns_, timing.presentMargin);
+    window_presents_++;
+  }
+  if (window_presents_ < kPacingWindowPresents) {
+    return;
+  }
+
+  // A frame more gives the GPU a refresh more for every frame, a frame less
+  // only fits if every frame was ready a refresh early.
+  if (window_missed_presents_ > kMaxMissedPresentsPerWindow &&
+      frames_in_flight_ < max_frames_in_flight_) {
+    frames_in_flight_++;
+    LOGI("VulkanHandler: %d frames in flight.", frames_in_flight_);
+  } else if (window_missed_presents_ == 0 && frames_in_flight_ > 1 &&
+             window_min_margin_ns_ > refresh_duration_ns_) {
+    frames_in_flight_--;
+    LOGI("VulkanHandler: %d frames in flight.", frames_in_flight_);
+  }
+  window_presents_ = 0;
+  window_missed_presents_ = 0;
+  window_min_margin_ns_ = UINT64_MAX;
+}
+
+VulkanHandler::ImportedBuffer& VulkanHandler::GetImportedBuffer(
+    AHardwareBuffer* hardware_buffer) {
+  for (ImportedBuffer& imported_buffer : imported_buffers_) {
+    if (imported_buffer.hardware_buffer == hardware_buffer) {
+      imported_buffer.last_used_frame = frame_count_;
+      return imported_buffer;
+    }
+  }
+
+  if (imported_buffers_.size() >= kMaxImportedBuffers) {
+    // Every frame draws one buffer, so the least recently used one of more
+    // than max_frames_in_flight_ buffers is no longer read by the GPU.
+    auto oldest = std::min_element(
+        imported_buffers_.begin(), imported_buffers_.end(),
+        [](const ImportedBuffer& a, const ImportedBuffer& b) {
+          return a.last_used_frame < b.last_used_frame;
+        });
+    CleanImportedBuffer(*oldest);
+    *oldest = imported_buffers_.back();
+    imported_buffers_.pop_back();
+  }
+
+  imported_buffers_.push_back(ImportHardwareBuffer(hardware_buffer));
+  imported_buffers_.back().last_used_frame = frame_count_;
+  return imported_buffers_.back();
+}
+
+VulkanHandler::ImportedBuffer VulkanHandler::ImportHardwareBuffer(
+    AHardwareBuffer* hardware_buffer) {
+  ImportedBuffer imported_buffer = {};
+  imported_buffer.hardware_buffer = hardware_buffer;
+
+  AHardwareBuffer_Desc buffer_desc = {};
+
+  if (__builtin_available(android 27, *)) {
+    AHardwareBuffer_describe(hardware_buffer, &buffer_desc);
+    // Keeps the pointer from being reused for another buffer while the entry
+    // is cached.
+    AHardwareBuffer_acquire(hardware_buffer);
+  } else {
+    LOGE("Android API 27+ Required.");
+    exit(0);
+  }
+
+  // Contains how to sample the image
+  VkAndroidHardwareBufferFormatPropertiesANDROID format_info = {
+      .sType =
+          VK_STRUCTURE_TYPE_ANDROID_HARDWARE_BUFFER_FORMAT_PROPERTIES_ANDROID,
+  };
+  // Contains only memory information (size and type)
+  VkAndroidHardwareBufferPropertiesANDROID properties = {
+      .sType = VK_STRUCTURE_TYPE_ANDROID_HARDWARE_BUFFER_PROPERTIES_ANDROID,
+      .pNext = &format_info,
+  };
+  CALL_VK(vkGetAndroidHardwareBufferPropertiesANDROID(
+      logical_device_, hardware_buffer, &properties));
+
+  // Create an image to bind to our AHardwareBuffer
+  const VkExternalFormatANDROID external_format = {
+      .sType = VK_STRUCTURE_TYPE_EXTERNAL_FORMAT_ANDROID,
+      .externalFormat = format_info.externalFormat,
+  };
+  const VkExternalMemoryImageCreateInfo external_create_info = {
+      .sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_IMAGE_CREATE_INFO,
+      .pNext = &external_format,
+      .handleTypes =
+          VK_EXTERNAL_MEMORY_HANDLE_TYPE_ANDROID_HARDWARE_BUFFER_BIT_ANDROID,
+  };
+  const VkImageCreateInfo create_info = {
+      .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+      .pNext = &external_create_info,
+      .flags = 0u,
+      .imageType = VK_IMAGE_TYPE_2D,
+      .format = format_info.format,
+      .extent =
+          {
+              buffer_desc.width,
+              buffer_desc.height,
+              1u,
+          },
+      .mipLevels = 1u,
+      .arrayLayers = 1u,
+      .samples = VK_SAMPLE_COUNT_1_BIT,
+      .tiling = VK_IMAGE_TILING_OPTIMAL,
+      .usage = VK_IMAGE_USAGE_SAMPLED_BIT,
+      .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+      .queueFamilyIndexCount = 0,
+      .pQueueFamilyIndices = nullptr,
+      .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+  };
+  CALL_VK(vkCreateImage(logical_device_, &create_info, nullptr,
+                        &imported_buffer.image));
+  imported_buffer.extent = {buffer_desc.width, buffer_desc.height};
+
+  // Allocate the device memory for the image
+  const VkImportAndroidHardwareBufferInfoANDROID android_hardware_buffer_info =
+      {
+          .sType =
+              VK_STRUCTURE_TYPE_IMPORT_ANDROID_HARDWARE_BUFFER_INFO_ANDROID,
+          .buffer = hardware_buffer,
+      };
+  const VkMemoryDedicatedAllocateInfo memory_dedicated_allocate_info = {
+      .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO,
+      .pNext = &android_hardware_buffer_info,
+      .image = imported_buffer.image,
+      .buffer = VK_NULL_HANDLE,
+  };
+  const VkMemoryAllocateInfo memory_allocate_info = {
+      .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+      .pNext = &memory_dedicated_allocate_info,
+      .allocationSize = properties.allocationSize,
+      .memoryTypeIndex =
+          FindMemoryType(physical_device_, properties.memoryTypeBits, 0),
+  };
+  CALL_VK(vkAllocateMemory(logical_device_, &memory_allocate_info, nullptr,
+                           &imported_buffer.memory));
+
+  // Bind the allocated memory to the image
+  CALL_VK(vkBindImageMemory(logical_device_, imported_buffer.image,
+                            imported_buffer.memory, 0));
+
+  // Create YUV conversion, this is needed to sample a texture image with
+  // external format
+  if (conversion_ == VK_NULL_HANDLE) {
+    const VkSamplerYcbcrConversionCreateInfo conversion_create_info = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_YCBCR_CONVERSION_CREATE_INFO,
+        .pNext = &external_format,
+        .format = format_info.format,
+        .ycbcrModel = format_info.suggestedYcbcrModel,
+        .ycbcrRange = format_info.suggestedYcbcrRange,
+        .components = format_info.samplerYcbcrConversionComponents,
+        .xChromaOffset = format_info.suggestedXChromaOffset,
+        .yChromaOffset = format_info.suggestedYChromaOffset,
+        .chromaFilter = VK_FILTER_NEAREST,
+        .forceExplicitReconstruction = VK_FALSE,
+    };
+
+    CALL_VK(vkCreateSamplerYcbcrConversion(
+        logical_device_, &conversion_create_info, nullptr, &conversion_));
+  }
+
+  VkSamplerYcbcrConversionInfo sampler_conversion_info = {
+      .sType = VK_STRUCTURE_TYPE_SAMPLER_YCBCR_CONVERSION_INFO,
+      .conversion = conversion_,
+  };
+
+  if (sampler_ == VK_NULL_HANDLE) {
+    sampler_ = CreateSampler(logical_device_, sampler_conversion_info);
+  }
+
+  if (descriptor_set_layout_ == VK_NULL_HANDLE) {
+    descriptor_set_layout_ =
+        CreateDescriptorSetLayout(logical_device_, sampler_);
+    camera_descriptor_template_ = CreateDescriptorUpdateTemplate(
+        descriptor_set_layout_,
+        {{
+            .dstBinding = 0,
+            .dstArrayElement = 0,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .offset = 0,
+            .stride = sizeof(VkDescriptorImageInfo),
+        }});
+  }
+
+  if (pipeline_layout_ == VK_NULL_HANDLE) {
+    pipeline_layout_ =
+        CreatePipelineLayout(logical_device_, descriptor_set_layout_);
+    graphics_pipeline_ =
+        CreateGraphicsPipeline(logical_device_, render_pass_, pipeline_layout_);
+  }
+
+  // Update image and view
+  const VkImageViewCreateInfo view_create_info{
+      .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+      .pNext = &sampler_conversion_info,
+      .flags = 0,
+      .image = imported_buffer.image,
+      .viewType = VK_IMAGE_VIEW_TYPE_2D,
+      .format = VK_FORMAT_UNDEFINED,
+      .components =
+          {
+              VK_COMPONENT_SWIZZLE_IDENTITY,
+              VK_COMPONENT_SWIZZLE_IDENTITY,
+              VK_COMPONENT_SWIZZLE_IDENTITY,
+              VK_COMPONENT_SWIZZLE_IDENTITY,
+          },
+      .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+  };
+  CALL_VK(vkCreateImageView(logical_device_, &view_create_info,
+                            /* pAllocator=*/nullptr,
+                            &imported_buffer.image_view));
+
+  // Transfer Image Layout, once for the lifetime of the import.
+  TransitionImageLayout(imported_buffer.image, VK_IMAGE_LAYOUT_UNDEFINED,
+                        VK_IMAGE_LAYOUT_GENERAL);
+
+  // The descriptor set is written once and then only bound.
+  const VkDescriptorSetAllocateInfo alloc_info{
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+      .descriptorPool = descriptor_pool_,
+      .descriptorSetCount = 1,
+      .pSetLayouts = &descriptor_set_layout_,
+  };
+  CALL_VK(vkAllocateDescriptorSets(logical_device_, &alloc_info,
+                                   &imported_buffer.descriptor_set));
+
+  // Update Descriptor Sets
+  const VkDescriptorImageInfo image_info{
+      .sampler = sampler_,
+      .imageView = imported_buffer.image_view,
+      .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+  };
+  vkUpdateDescriptorSetWithTemplate(logical_device_,
+                                    imported_buffer.descriptor_set,
+                                    camera_descriptor_template_, &image_info);
+
+  // Recorded by the first frame drawing the buffer in each slot.
+  imported_buffer.background_commands.resize(max_frames_in_flight_);
+  const VkCommandBufferAllocateInfo command_buffer_alloc_info{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+      .commandPool = command_pool_,
+      .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+      .commandBufferCount = static_cast<uint32_t>(max_frames_in_flight_),
+  };
+  CALL_VK(vkAllocateCommandBuffers(logical_device_, &command_buffer_alloc_info,
+                                   imported_buffer.background_commands.data()));
+  imported_buffer.background_geometry_versions.assign(max_frames_in_flight_,
+                                                      kNotRecorded);
+
+  return imported_buffer;
+}
+
+void VulkanHandler::EvictIdleImportedBuffers() {
+  for (size_t i = 0; i < imported_buffers_.size();) {
+    if (frame_count_ - imported_buffers_[i].last_used_frame <
+        kImportedBufferIdleFrames) {
+      i++;
+      continue;
+    }
+    CleanImportedBuffer(imported_buffers_[i]);
+    imported_buffers_[i] = imported_buffers_.back();
+    imported_buffers_.pop_back();
+  }
+}
+
+void VulkanHandler::CleanImportedBuffer(const ImportedBuffer& imported_buffer) {
+  vkFreeCommandBuffers(logical_device_, command_pool_,
+                       imported_buffer.background_commands.size(),
+                       imported_buffer.background_commands.data());
+  CALL_VK(vkFreeDescriptorSets(logical_device_, descriptor_pool_, 1,
+                               &imported_buffer.descriptor_set));
+  vkDestroyImageView(logical_device_, imported_buffer.image_view,
+                     /* pAllocator=*/nullptr);
+  vkFreeMemory(logical_device_, imported_buffer.memory,
+               /* pAllocator=*/nullptr);
+  vkDestroyImage(logical_device_, imported_buffer.image,
                  /* pAllocator=*/nullptr);
-    vertex_buffers_memory_[frame_index] = VK_NULL_HANDLE;
+  if (__builtin_available(android 26, *)) {
+    AHardwareBuffer_release(imported_buffer.hardware_buffer);
   }
 }
 
+void VulkanHandler::CleanSwapchainImageRelatives() {
+  for (const SwapchinImageRelative& relative : swapchain_image_relatives_) {
+    vkDestroyFramebuffer(logical_device_, relative.frame_buffer,
+                         /*pAllocator=*/nullptr);
+    vkDestroyImageView(logical_device_, relative.swapchain_view,
+                       /* pAllocator=*/nullptr);
+    vkDestroyImageView(logical_device_, relative.depth_view,
+                       /* pAllocator=*/nullptr);
+    memory_allocator_->DestroyImage(relative.depth_image,
+                                    relative.depth_allocation);
+  }
+  swapchain_image_relatives_.clear();
+}
+
+void VulkanHandler::CleanGeometryBuffer() {
+  geometry_data_ = nullptr;
+  DestroyBuffer(geometry_buffer_, geometry_allocation_);
+  geometry_buffer_ = VK_NULL_HANDLE;
+  geometry_allocation_ = VulkanMemoryAllocator::Allocation();
+}
+
+size_t VulkanHandler::GetContentSlotIndex(int frame_index, int slot) const {
+  return frame_index * kMaxContentSlots + slot;
+}
+
+VkDeviceSize VulkanHandler::GetVertexOffset(int frame_index) const {
+  return frame_index * geometry_slot_size_;
+}
+
+VkDeviceSize VulkanHandler::GetIndexOffset(int frame_index) const {
+  return GetVertexOffset(frame_index) +
+         AlignGeometryOffset(sizeof(VertexInfo) * kMaxVerticesPerFrame);
+}
+
 uint32_t VulkanHandler::FindMemoryType(VkPhysicalDevice physical_device,
                                        uint32_t typeFilter,
                                        VkMemoryPropertyFlags properties) {
@@ -1171,52 +2089,36 @@ VkShaderModule VulkanHandler::LoadShader(VkDevice logical_device,
   return shader;
 }
 
-void VulkanHandler::CreateBuffer(VkPhysicalDevice physical_device,
-                                 VkDeviceSize size, VkBufferUsageFlags usage,
-                                 VkMemoryPropertyFlags properties,
-                                 VkBuffer& buffer,
-                                 VkDeviceMemory& buffer_memory) {
-  VkBufferCreateInfo buffer_info{.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-                                 .size = size,
-                                 .usage = usage,
-                                 .sharingMode = VK_SHARING_MODE_EXCLUSIVE};
-
-  CALL_VK(vkCreateBuffer(logical_device_, &buffer_info, nullptr, &buffer));
-
-  VkMemoryRequirements mem_requirements;
-  vkGetBufferMemoryRequirements(logical_device_, buffer, &mem_requirements);
+void VulkanHandler::CreateBuffer(
+    VkDeviceSize size, VkBufferUsageFlags usage,
+    VkMemoryPropertyFlags properties, VkBuffer& buffer,
+    VulkanMemoryAllocator::Allocation& allocation) {
+  CHECK(memory_allocator_->CreateBuffer(size, usage, properties, &buffer,
+                                        &allocation));
+}
 
-  VkMemoryAllocateInfo alloc_info{
-      .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-      .allocationSize = mem_requirements.size,
-      .memoryTypeIndex = FindMemoryType(
-          physical_device, mem_requirements.memoryTypeBits, properties)};
+void VulkanHandler::DestroyBuffer(
+    VkBuffer buffer, const VulkanMemoryAllocator::Allocation& allocation) {
+  memory_allocator_->DestroyBuffer(buffer, allocation);
+}
 
-  CALL_VK(
-      vkAllocateMemory(logical_device_, &alloc_info, nullptr, &buffer_memory));
+void VulkanHandler::CreateImage(
+    const VkImageCreateInfo& image_create_info, VkImage& image,
+    VulkanMemoryAllocator::Allocation& allocation) {
+  CHECK(memory_allocator_->CreateImage(image_create_info,
+                                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                       &image, &allocation));
+}
 
-  vkBindBufferMemory(logical_device_, buffer, buffer_memory, 0);
+void VulkanHandler::DestroyImage(
+    VkImage image, const VulkanMemoryAllocator::Allocation& allocation) {
+  memory_allocator_->DestroyImage(image, allocation);
 }
 
 void VulkanHandler::TransitionImageLayout(VkImage image,
                                           VkImageLayout old_layout,
                                           VkImageLayout new_layout) {
-  VkCommandBufferAllocateInfo alloc_info{
-      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-      .commandPool = command_pool_,
-      .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-      .commandBufferCount = 1,
-  };
-
-  VkCommandBuffer command_buffer;
-  vkAllocateCommandBuffers(logical_device_, &alloc_info, &command_buffer);
-
-  VkCommandBufferBeginInfo begin_info{
-      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
-  };
-
-  vkBeginCommandBuffer(command_buffer, &begin_info);
+  VkCommandBuffer command_buffer = BeginOneTimeCommands();
 
   VkImageMemoryBarrier barrier{
       .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
@@ -1243,18 +2145,179 @@ void VulkanHandler::TransitionImageLayout(VkImage image,
   barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
   vkCmdPipelineBarrier(command_buffer, source_stage, destination_stage, 0, 0,
                        nullptr, 0, nullptr, 1, &barrier);
-  vkEndCommandBuffer(command_buffer);
+
+  SubmitOneTimeCommands(command_buffer, VK_NULL_HANDLE,
+                        VulkanMemoryAllocator::Allocation());
+}
+
+VkCommandBuffer VulkanHandler::BeginOneTimeCommands() {
+  VkCommandBufferAllocateInfo alloc_info{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+      .commandPool = transfer_command_pool_,
+      .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+      .commandBufferCount = 1,
+  };
+
+  VkCommandBuffer command_buffer;
+  CALL_VK(vkAllocateCommandBuffers(logical_device_, &alloc_info,
+                                   &command_buffer));
+
+  VkCommandBufferBeginInfo begin_info{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+  };
+  CALL_VK(vkBeginCommandBuffer(command_buffer, &begin_info));
+  return command_buffer;
+}
+
+void VulkanHandler::SubmitOneTimeCommands(
+    VkCommandBuffer command_buffer, VkBuffer staging_buffer,
+    const VulkanMemoryAllocator::Allocation& staging_allocation) {
+  CALL_VK(vkEndCommandBuffer(command_buffer));
+
+  PendingSubmission submission = {
+      .command_buffer = command_buffer,
+      .fence = VK_NULL_HANDLE,
+      .staging_buffer = staging_buffer,
+      .staging_allocation = staging_allocation,
+  };
+  if (free_transfer_fences_.empty()) {
+    const VkFenceCreateInfo fence_create_info{
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+        .flags = 0,
+    };
+    CALL_VK(vkCreateFence(logical_device_, &fence_create_info,
+                          /* pAllocator=*/nullptr, &submission.fence));
+  } else {
+    submission.fence = free_transfer_fences_.back();
+    free_transfer_fences_.pop_back();
+  }
 
   VkSubmitInfo submit_info{
       .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
       .commandBufferCount = 1,
       .pCommandBuffers = &command_buffer,
   };
+  // The barriers recorded in |command_buffer| also order every later
+  // submission to queue_ after it, so nothing waits here. The fence only
+  // tells when the command buffer and staging memory can be freed.
+  CALL_VK(vkQueueSubmit(queue_, 1, &submit_info, submission.fence));
+  pending_submissions_.push_back(submission);
+}
+
+void VulkanHandler::ReclaimFinishedSubmissions() {
+  for (size_t i = 0; i < pending_submissions_.size();) {
+    const PendingSubmission& submission = pending_submissions_[i];
+    if (vkGetFenceStatus(logical_device_, submission.fence) != VK_SUCCESS) {
+      i++;
+      continue;
+    }
+    vkFreeCommandBuffers(logical_device_, transfer_command_pool_, 1,
+                         &submission.command_buffer);
+    if (submission.staging_buffer != VK_NULL_HANDLE) {
+      DestroyBuffer(submission.staging_buffer, submission.staging_allocation);
+    }
+    CALL_VK(vkResetFences(logical_device_, 1, &submission.fence));
+    free_transfer_fences_.push_back(submission.fence);
+    pending_submissions_[i] = pending_submissions_.back();
+    pending_submissions_.pop_back();
+  }
+}
+
+void VulkanHandler::UploadToBuffer(VkBuffer buffer, VkDeviceSize offset,
+                                   const void* data, VkDeviceSize size,
+                                   VkPipelineStageFlags dst_stage,
+                                   VkAccessFlags dst_access) {
+  VkBuffer staging_buffer;
+  VulkanMemoryAllocator::Allocation staging_allocation;
+  CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+               staging_buffer, staging_allocation);
+  memcpy(staging_allocation.mapped, data, size);
+
+  VkCommandBuffer command_buffer = BeginOneTimeCommands();
+  const VkBufferCopy region{
+      .srcOffset = 0,
+      .dstOffset = offset,
+      .size = size,
+  };
+  vkCmdCopyBuffer(command_buffer, staging_buffer, buffer, 1, &region);
+  const VkBufferMemoryBarrier barrier{
+      .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+      .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+      .dstAccessMask = dst_access,
+      .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .buffer = buffer,
+      .offset = offset,
+      .size = size,
+  };
+  vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       dst_stage, 0, 0, nullptr, 1, &barrier, 0, nullptr);
 
-  vkQueueSubmit(queue_, 1, &submit_info, VK_NULL_HANDLE);
-  vkQueueWaitIdle(queue_);
+  SubmitOneTimeCommands(command_buffer, staging_buffer, staging_allocation);
+}
+
+void VulkanHandler::UploadToImage(VkImage image, VkExtent2D extent,
+                                  const void* data, VkDeviceSize size) {
+  VkBuffer staging_buffer;
+  VulkanMemoryAllocator::Allocation staging_allocation;
+  CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+               staging_buffer, staging_allocation);
+  memcpy(staging_allocation.mapped, data, size);
+
+  VkCommandBuffer command_buffer = BeginOneTimeCommands();
+  VkImageMemoryBarrier barrier{
+      .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+      .srcAccessMask = 0,
+      .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+      .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+      .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .image = image,
+      .subresourceRange =
+          {
+              .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+              .baseMipLevel = 0,
+              .levelCount = 1,
+              .baseArrayLayer = 0,
+              .layerCount = 1,
+          },
+  };
+  vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &barrier);
+
+  const VkBufferImageCopy region{
+      .bufferOffset = 0,
+      .bufferRowLength = 0,
+      .bufferImageHeight = 0,
+      .imageSubresource =
+          {
+              .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+              .mipLevel = 0,
+              .baseArrayLayer = 0,
+              .layerCount = 1,
+          },
+      .imageOffset = {0, 0, 0},
+      .imageExtent = {extent.width, extent.height, 1},
+  };
+  vkCmdCopyBufferToImage(command_buffer, staging_buffer, image,
+                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr,
+                       0, nullptr, 1, &barrier);
 
-  vkFreeCommandBuffers(logical_device_, command_pool_, 1, &command_buffer);
+  SubmitOneTimeCommands(command_buffer, staging_buffer, staging_allocation);
 }
 
 }  // namespace simple_vulkan
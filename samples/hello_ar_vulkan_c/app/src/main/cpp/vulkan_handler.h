@@ -24,10 +24,16 @@
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
 #include <vector>
 
 #include "android_vulkan_loader.h"
 #include "util.h"
+#include "vulkan_memory_allocator.h"
+#include "worker_pool.h"
 
 // Vulkan call wrapper
 #define CALL_VK(func)                                                         \
@@ -51,6 +57,27 @@ class VulkanHandler {
  public:
   enum class ShaderType { kVertexShader, kFragmentShader };
 
+  // How frames are queued for presentation.
+  enum class PacingMode {
+    // FIFO presentation with every frame in flight, which keeps the frame rate
+    // steady at the cost of latency.
+    kThroughput,
+    // MAILBOX presentation if the surface supports it, and only as many frames
+    // in flight as it takes to keep up with the display. With
+    // VK_GOOGLE_display_timing, frames are also presented at the first vsync
+    // they can be rendered by, which keeps the camera image on screen the
+    // least time after it was captured.
+    kLowLatency,
+  };
+
+  // Number of secondary command buffers the content of a frame can be
+  // recorded into in parallel, see RecordContent().
+  static constexpr size_t kMaxContentSlots = 4;
+
+  // Records draws into a secondary command buffer that continues the render
+  // pass. It must set its own dynamic state.
+  using ContentRecorder = std::function<void(VkCommandBuffer command_buffer)>;
+
   /**
    * @struct Vertex Information to be processed in the vertex shader.
    */
@@ -70,12 +97,46 @@ class VulkanHandler {
   };
 
   /**
-   * Structure with texture image.
+   * Camera hardware buffer imported as a sampled image. ARCore hands out the
+   * same few buffers over and over, so the import is kept until the buffer
+   * stops showing up.
+   */
+  struct ImportedBuffer {
+    // Acquired for as long as the entry exists, which keeps its address from
+    // being reused by another buffer.
+    AHardwareBuffer* hardware_buffer;
+    VkImage image;
+    VkDeviceMemory memory;
+    VkImageView image_view;
+    VkExtent2D extent;
+    VkDescriptorSet descriptor_set;
+    // Value of frame_count_ when the buffer was last drawn.
+    uint64_t last_used_frame;
+    // Secondary command buffers drawing the buffer as the background, one per
+    // frame in flight since each frame has its own geometry, and the
+    // geometry_versions_ they were recorded with.
+    std::vector<VkCommandBuffer> background_commands;
+    std::vector<uint64_t> background_geometry_versions;
+  };
+
+  /**
+   * The camera image of a hardware buffer, as it is imported for the
+   * background. It is sampled as RGB through GetCameraSampler().
+   */
+  struct CameraImage {
+    VkImageView image_view;
+    VkExtent2D extent;
+  };
+
+  /**
+   * One-time commands submitted outside of a frame, with the staging buffer
+   * they read from, if any. Freed once the fence is signaled.
    */
-  struct TextureImageInfo {
-    VkImageView texture_image_view;
-    VkDeviceMemory texture_memory;
-    VkImage texture_image;
+  struct PendingSubmission {
+    VkCommandBuffer command_buffer;
+    VkFence fence;
+    VkBuffer staging_buffer;
+    VulkanMemoryAllocator::Allocation staging_allocation;
   };
 
   /**
@@ -84,6 +145,21 @@ class VulkanHandler {
   struct SwapchinImageRelative {
     VkImageView swapchain_view;
     VkFramebuffer frame_buffer;
+    VkImage depth_image;
+    VulkanMemoryAllocator::Allocation depth_allocation;
+    VkImageView depth_view;
+  };
+
+  /**
+   * Rolling statistics of the GPU time of the render pass, over the last
+   * kGpuTimeWindowSize frames whose timestamps were read back.
+   */
+  struct GpuTimeStats {
+    float min_ms = 0.f;
+    float avg_ms = 0.f;
+    float p95_ms = 0.f;
+    // 0 if the queue does not support timestamps.
+    int sample_count = 0;
   };
 
   /**
@@ -92,14 +168,28 @@ class VulkanHandler {
    * @param window C counterpart of the android.view.Surface object in Java.
    * @param max_frames_in_flight maximum frames allowed to be computed. Details:
    * https://vulkan-tutorial.com/Drawing_a_triangle/Drawing/max_frames_in_flight
+   * @param pipeline_cache_path file the pipeline cache is loaded from and saved
+   * to by SavePipelineCache(). Empty to keep the cache in memory only.
+   * @param pacing_mode how frames are presented, which cannot change for the
+   * lifetime of the swapchain.
    */
-  VulkanHandler(ANativeWindow* window, int max_frames_in_flight);
+  VulkanHandler(ANativeWindow* window, int max_frames_in_flight,
+                const std::string& pipeline_cache_path,
+                PacingMode pacing_mode);
 
   /**
    * Vulkan Handler Deconstructor
    */
   ~VulkanHandler();
 
+  /**
+   * Number of frames to cycle through, at most max_frames_in_flight. In low
+   * latency mode it is adjusted by PresentRecordingCommandBuffer(), so the
+   * frame after |current_frame| is (current_frame + 1) % GetFramesInFlight().
+   */
+  int GetFramesInFlight() const { return frames_in_flight_; }
+  int GetMaxFramesInFlight() const { return max_frames_in_flight_; }
+
   /**
    * Get the framebuffer index we should draw in.
    *
@@ -118,8 +208,10 @@ class VulkanHandler {
   void WaitForFrame(int current_frame);
 
   /**
-   * Create image based on the provided hardware buffer and bind the rendering
-   * command to the command buffer.
+   * Draw the provided hardware buffer as the background of the frame. The
+   * buffer is imported as an image the first time it is seen, and later frames
+   * reuse the import and the commands recorded for it until the geometry of
+   * the frame changes.
    *
    * @param current_frame the index of current frame in the flight.
    * @param hardware_buffer the chunk of memory containing the ARCore camera
@@ -128,6 +220,13 @@ class VulkanHandler {
   void RenderFromHardwareBuffer(int current_frame,
                                 AHardwareBuffer* hardware_buffer);
 
+  /**
+   * The camera image of |hardware_buffer|, for work that reads it outside of
+   * the render pass, such as compute dispatches. Shares the import with
+   * RenderFromHardwareBuffer(), so it stays valid for the frames in flight.
+   */
+  CameraImage GetCameraImage(AHardwareBuffer* hardware_buffer);
+
   /**
    * Check whether the vertices are set for the frame.
    *
@@ -140,14 +239,21 @@ class VulkanHandler {
   /**
    * Set the vertices and indices for the frame if it is not set.
    *
+   * The geometry is written in place into the frame's range of a buffer that
+   * stays mapped, so this must be called after WaitForFrame() for the frame.
+   *
    * @param current_frame the index of current frame in the flight.
    * @param vertices the vertices for the frame, usually 4 corners.
+   * @param vertex_count the number of vertices, at most 1024.
    * @param indices the indices for the frame, usually 2 triangles covering
    * 4 corners' vertices.
+   * @param index_count the number of indices, at most 3072.
    */
   void SetVerticesAndIndicesForFrame(int current_frame,
-                                     std::vector<VertexInfo> vertices,
-                                     std::vector<uint16_t> indices);
+                                     const VertexInfo* vertices,
+                                     size_t vertex_count,
+                                     const uint16_t* indices,
+                                     size_t index_count);
 
   /**
    * Begin the render pass.
@@ -215,6 +321,186 @@ class VulkanHandler {
   void PresentRecordingCommandBuffer(int current_frame,
                                      uint32_t swapchain_image_index);
 
+  /**
+   * Copy |size| bytes of |data| into the device-local |buffer| at |offset|
+   * through a staging buffer.
+   *
+   * The copy is submitted right away without waiting for it. Work submitted
+   * later only reads the range from |dst_stage| with |dst_access| after the
+   * copy, and the staging buffer is freed once the GPU is done with it.
+   */
+  void UploadToBuffer(VkBuffer buffer, VkDeviceSize offset, const void* data,
+                      VkDeviceSize size, VkPipelineStageFlags dst_stage,
+                      VkAccessFlags dst_access);
+
+  /**
+   * Copy tightly packed texels of |extent| into the first mip level of the
+   * device-local color |image| through a staging buffer, the same way as
+   * UploadToBuffer(). The image is left in
+   * VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL for the fragment shaders.
+   */
+  void UploadToImage(VkImage image, VkExtent2D extent, const void* data,
+                     VkDeviceSize size);
+
+  /**
+   * Make the next SubmitRecordingCommandBuffer() wait for |semaphore| before
+   * |stage| of the frame, e.g. for a copy on GetTransferQueue() that the
+   * frame reads. The wait is consumed by that submit.
+   */
+  void AddSubmitWaitSemaphore(VkSemaphore semaphore,
+                              VkPipelineStageFlags stage);
+
+  /**
+   * Write the pipeline cache back to its file if pipelines were compiled since
+   * it was loaded, so that the next start can skip compiling them.
+   */
+  void SavePipelineCache();
+
+  /**
+   * Wait until the GPU has finished all submitted frames, e.g. before
+   * destroying objects that recorded frames may still use.
+   */
+  void WaitForAllFrames();
+
+  /**
+   * Rebuild the swapchain for the current size and transform of the surface,
+   * e.g. after the display rotated. The new swapchain is created from the old
+   * one, and the render pass, pipelines and imported camera images do not
+   * depend on it, so only the images and their framebuffers are replaced
+   * once the frames in flight are done. Does nothing if the surface did not
+   * change and the swapchain is not out of date.
+   *
+   * @return false if the surface has no area, e.g. while it is hidden. The
+   * old swapchain is kept then.
+   */
+  bool RecreateSwapchain();
+
+  /**
+   * Whether an acquire or present reported that the swapchain no longer
+   * matches the surface, and RecreateSwapchain() should be called before the
+   * next frame.
+   */
+  bool IsSwapchainOutOfDate() const { return swapchain_out_of_date_; }
+
+  /**
+   * Reserve |size| bytes of host visible memory that the GPU reads within the
+   * frame, e.g. vertices streamed every frame. The memory is reused once
+   * WaitForFrame() returns for the frame again.
+   *
+   * @param current_frame the index of current frame in the flight.
+   * @param buffer, offset where the data lives for the draw commands.
+   * @param data where to write the data.
+   *
+   * @return false if the frame's arena is full.
+   *
+   * Thread safe, so that content recorders can call it.
+   */
+  bool AllocateFrameData(int current_frame, VkDeviceSize size,
+                         VkDeviceSize alignment, VkBuffer* buffer,
+                         VkDeviceSize* offset, void** data);
+
+  /**
+   * Allocate a descriptor set of |layout| that the frame binds, e.g. for
+   * uniforms in AllocateFrameData() memory. The sets come from a pool of the
+   * frame that is reset as a whole once WaitForFrame() returns for it again,
+   * so they are never freed one by one. Fill them with an update template
+   * from CreateDescriptorUpdateTemplate().
+   *
+   * @return VK_NULL_HANDLE if the frame's pool is exhausted.
+   *
+   * Thread safe, so that content recorders can call it.
+   */
+  VkDescriptorSet AllocateFrameDescriptorSet(int current_frame,
+                                             VkDescriptorSetLayout layout);
+
+  /**
+   * Create a template that writes all descriptors of a set of |layout| from
+   * one struct, laid out as described by |entries|, with a single
+   * vkUpdateDescriptorSetWithTemplate() call. The caller destroys it.
+   */
+  VkDescriptorUpdateTemplate CreateDescriptorUpdateTemplate(
+      VkDescriptorSetLayout layout,
+      const std::vector<VkDescriptorUpdateTemplateEntry>& entries) const;
+
+  /**
+   * Device memory blocks and how much of them is in use.
+   */
+  VulkanMemoryAllocator::Stats GetMemoryStats() const;
+
+  /**
+   * GPU time from the start to the end of the render pass. Each frame writes
+   * a timestamp on either side of it, which are read once WaitForFrame()
+   * returns for the frame again, max_frames_in_flight frames later, so
+   * reading them never stalls.
+   */
+  GpuTimeStats GetRenderPassGpuStats() const;
+
+  /**
+   * Objects renderers drawing into the render pass build their pipelines and
+   * buffers with. They stay valid for the lifetime of the handler.
+   */
+  VkPhysicalDevice GetPhysicalDevice() const { return physical_device_; }
+  VkDevice GetLogicalDevice() const { return logical_device_; }
+  VkRenderPass GetRenderPass() const { return render_pass_; }
+  VkPipelineCache GetPipelineCache() const { return pipeline_cache_; }
+  // Size of the swapchain images, in the natural orientation of the display.
+  VkExtent2D GetExtent() const { return swapchain_extent_; }
+  // The immutable sampler, with the YCbCr conversion of the camera images,
+  // that descriptor set layouts reading them must use. VK_NULL_HANDLE until
+  // the first camera image is imported.
+  VkSampler GetCameraSampler() const { return sampler_; }
+  // Primary command buffer of the frame, for commands recorded between
+  // BeginRecordingCommandBuffer() and BeginRenderPass().
+  VkCommandBuffer GetFrameCommandBuffer(int current_frame) const {
+    return command_buffers_[current_frame];
+  }
+  // Family of the queue the frames are submitted to.
+  uint32_t GetGraphicsQueueFamilyIndex() const { return queue_family_index_; }
+  // Queue of a family with transfers but no graphics, for copies that run
+  // alongside the frames, and its family. VK_NULL_HANDLE and the graphics
+  // family if the device has no such queue. Only the thread drawing the
+  // frames may submit to it.
+  VkQueue GetTransferQueue() const { return transfer_queue_; }
+  uint32_t GetTransferQueueFamilyIndex() const {
+    return transfer_queue_family_index_;
+  }
+  // Rotation the compositor expects the images to already have, so that it
+  // does not have to rotate them itself. Content is drawn rotated by it in
+  // clip space, and the camera image too.
+  VkSurfaceTransformFlagBitsKHR GetPreTransform() const {
+    return pre_transform_;
+  }
+
+  /**
+   * Record the content of the frame, between BeginRenderPass() and
+   * EndRenderPass() of the frame and at most once per frame.
+   *
+   * Each recorder gets a secondary command buffer from a command pool of its
+   * own, and the recorders run concurrently on worker threads. Whatever the
+   * order they finish in, the buffers are executed after the background in
+   * the order of |recorders|. Of the handler, recorders may only call
+   * AllocateFrameData().
+   *
+   * @param current_frame the index of current frame in the flight.
+   * @param recorders at most kMaxContentSlots recorders.
+   */
+  void RecordContent(int current_frame,
+                     const std::vector<ContentRecorder>& recorders);
+
+  VkShaderModule LoadShader(VkDevice logical_device,
+                            const uint32_t* const content, size_t size) const;
+  // Buffers sub-allocated from the blocks of the handler's allocator.
+  void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
+                    VkMemoryPropertyFlags properties, VkBuffer& buffer,
+                    VulkanMemoryAllocator::Allocation& allocation);
+  void DestroyBuffer(VkBuffer buffer,
+                     const VulkanMemoryAllocator::Allocation& allocation);
+  // Device local images sub-allocated the same way.
+  void CreateImage(const VkImageCreateInfo& image_create_info, VkImage& image,
+                   VulkanMemoryAllocator::Allocation& allocation);
+  void DestroyImage(VkImage image,
+                    const VulkanMemoryAllocator::Allocation& allocation);
+
  private:
   // Creation function of vulkan class. Dependent classes are put into
   // the parametes.
@@ -222,19 +508,32 @@ class VulkanHandler {
   VkSurfaceKHR CreateSurface(VkInstance instance, ANativeWindow* window);
   VkPhysicalDevice CreatePhysicalDevice(VkInstance instance);
   uint32_t GetQueueFamilyIndex(VkPhysicalDevice physical_device);
+  // A family with transfers but neither graphics nor compute, which is
+  // usually a DMA engine, else |queue_family_index|.
+  uint32_t GetTransferQueueFamilyIndex(VkPhysicalDevice physical_device,
+                                       uint32_t queue_family_index);
   VkDevice CreateLogicalDevice(VkPhysicalDevice physical_device,
                                uint32_t queue_family_index);
   VkSurfaceFormatKHR GetSurfaceFormat(VkSurfaceKHR surface,
                                       VkPhysicalDevice physical_device);
+  VkPresentModeKHR ChoosePresentMode(VkPhysicalDevice physical_device,
+                                     VkSurfaceKHR surface);
   VkSwapchainKHR CreateSwapchain(VkDevice logical_device, VkSurfaceKHR surface,
                                  VkSurfaceCapabilitiesKHR surface_capabilities,
                                  VkSurfaceFormatKHR surface_format,
-                                 uint32_t queue_family_index);
+                                 uint32_t queue_family_index,
+                                 VkPresentModeKHR present_mode,
+                                 VkExtent2D extent,
+                                 VkSwapchainKHR old_swapchain);
+  VkPipelineCache CreatePipelineCache(VkPhysicalDevice physical_device,
+                                      VkDevice logical_device);
   VkRenderPass CreateRenderPass(VkDevice logical_device);
   VkCommandPool CreateCommandPool(VkDevice logical_device,
-                                  uint32_t queue_family_index);
+                                  uint32_t queue_family_index,
+                                  VkCommandPoolCreateFlags flags);
   VkDescriptorPool CreateDescriptorPool(VkDevice logical_device,
-                                        int max_frames_in_flight);
+                                        uint32_t max_sets);
+  VkDescriptorPool CreateFrameDescriptorPool(VkDevice logical_device);
 
   VkSampler CreateSampler(VkDevice logical_device,
                           VkSamplerYcbcrConversionInfo sampler_conversion_info);
@@ -246,68 +545,184 @@ class VulkanHandler {
                                     VkRenderPass render_pass,
                                     VkPipelineLayout pipeline_layout);
 
-  void InitDescriptorSets(VkDevice logical_device,
-                          VkDescriptorPool descriptor_pool,
-                          VkDescriptorSetLayout descriptor_set_layout,
-                          int max_frames_in_flight);
-  void InitSwapchainImageRelatives(
-      VkDevice logical_device, VkSwapchainKHR swapchain,
-      VkRenderPass render_pass, VkSurfaceCapabilitiesKHR surface_capabilities,
-      VkSurfaceFormatKHR surface_format, uint32_t swapchain_length);
+  // Creates swapchain_ for surface_capabilities_ from |old_swapchain|, if
+  // any, and the views and framebuffers of its images.
+  void InitSwapchain(VkSwapchainKHR old_swapchain);
+  void InitSwapchainImageRelatives(VkDevice logical_device,
+                                   VkSwapchainKHR swapchain,
+                                   VkRenderPass render_pass, VkExtent2D extent,
+                                   VkSurfaceFormatKHR surface_format,
+                                   uint32_t swapchain_length);
+  void CreateDepthImage(VkExtent2D extent, SwapchinImageRelative* relative);
   void InitCommandBuffers(VkDevice logical_device, VkCommandPool command_pool,
                           int max_frames_in_flight);
   void InitSyncObjects(VkDevice logical_device, int max_frames_in_flight);
+  void InitGeometryBuffer(int max_frames_in_flight);
+
+  // Imported camera buffers. GetImportedBuffer() returns the cached import of
+  // |hardware_buffer|, importing it on a miss and evicting the least recently
+  // used entry if the cache is full.
+  ImportedBuffer& GetImportedBuffer(AHardwareBuffer* hardware_buffer);
+  ImportedBuffer ImportHardwareBuffer(AHardwareBuffer* hardware_buffer);
+  void EvictIdleImportedBuffers();
 
   // Cleanup functions
-  void CleanTextureImageInfo(int index);
-  void CleanVertiesAndIndies(int index);
+  void CleanImportedBuffer(const ImportedBuffer& imported_buffer);
+  void CleanGeometryBuffer();
+  void CleanSwapchainImageRelatives();
 
   // Other reference functions.
+  // Offsets of the vertices and indices of a frame in geometry_buffer_.
+  VkDeviceSize GetVertexOffset(int frame_index) const;
+  VkDeviceSize GetIndexOffset(int frame_index) const;
+  // Index of a content slot of a frame in content_command_pools_ and
+  // content_command_buffers_.
+  size_t GetContentSlotIndex(int frame_index, int slot) const;
+  void RecordBackgroundCommands(int current_frame,
+                                VkDescriptorSet descriptor_set,
+                                VkCommandBuffer command_buffer);
   uint32_t FindMemoryType(VkPhysicalDevice physical_device, uint32_t typeFilter,
                           VkMemoryPropertyFlags properties);
-  VkShaderModule LoadShader(VkDevice logical_device,
-                            const uint32_t* const content, size_t size) const;
-  void CreateBuffer(VkPhysicalDevice physical_device, VkDeviceSize size,
-                    VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
-                    VkBuffer& buffer, VkDeviceMemory& buffer_memory);
   void TransitionImageLayout(VkImage image, VkImageLayout old_layout,
                              VkImageLayout new_layout);
 
+  // One-time commands from transfer_command_pool_. SubmitOneTimeCommands()
+  // ends and submits |command_buffer| with a fence and takes ownership of the
+  // staging buffer, if any. ReclaimFinishedSubmissions() frees the resources
+  // of the submissions whose fence is signaled, without blocking.
+  VkCommandBuffer BeginOneTimeCommands();
+  void SubmitOneTimeCommands(VkCommandBuffer command_buffer,
+                             VkBuffer staging_buffer,
+                             const VulkanMemoryAllocator::Allocation&
+                                 staging_allocation);
+  void ReclaimFinishedSubmissions();
+
+  // Timestamp queries around the render pass, two per frame in flight.
+  // Leaves timestamp_query_pool_ null if the queue has no timestamps.
+  void InitTimestampQueries(int max_frames_in_flight);
+  // Adds the render pass time of the frame, if its timestamps were written.
+  void ReadFrameTimestamps(int current_frame);
+
+  // VK_GOOGLE_display_timing, see PacingMode::kLowLatency. InitDisplayTiming()
+  // leaves display_timing_enabled_ false if the functions are missing.
+  void InitDisplayTiming();
+  // The first vsync the frame being presented can be rendered by, or 0 to
+  // present as soon as possible.
+  uint64_t GetDesiredPresentTime();
+  // Reads the timings of the presents that reached the display since the
+  // last call, and changes frames_in_flight_ if frames keep missing their
+  // vsync or the queue holds more than a frame too many.
+  void UpdatePresentTimings();
+
   VkInstance instance_;
   VkSurfaceKHR surface_;
   VkPhysicalDevice physical_device_ = VK_NULL_HANDLE;
   VkDevice logical_device_ = VK_NULL_HANDLE;
   VkQueue queue_ = VK_NULL_HANDLE;
+  // VK_NULL_HANDLE if transfer_queue_family_index_ is queue_family_index_.
+  VkQueue transfer_queue_ = VK_NULL_HANDLE;
+  // All buffers and images but the imported camera images, which are bound
+  // to the memory of their hardware buffer.
+  std::unique_ptr<VulkanMemoryAllocator> memory_allocator_;
+  // Streamed data of each frame in flight.
+  std::vector<std::unique_ptr<LinearArena>> frame_arenas_;
+  // Guards frame_arenas_ and frame_descriptor_pools_.
+  std::mutex frame_arena_mutex_;
+  std::unique_ptr<WorkerPool> recording_workers_;
   VkSurfaceCapabilitiesKHR surface_capabilities_;
   VkSurfaceFormatKHR surface_format_;
   VkSwapchainKHR swapchain_ = VK_NULL_HANDLE;
+  VkExtent2D swapchain_extent_ = {};
+  VkSurfaceTransformFlagBitsKHR pre_transform_ =
+      VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
+  bool swapchain_out_of_date_ = false;
   VkSamplerYcbcrConversion conversion_ = VK_NULL_HANDLE;
   VkSampler sampler_ = VK_NULL_HANDLE;
   VkDescriptorSetLayout descriptor_set_layout_ = VK_NULL_HANDLE;
+  // Writes the camera image of an imported buffer into its descriptor set.
+  VkDescriptorUpdateTemplate camera_descriptor_template_ = VK_NULL_HANDLE;
   VkPipelineLayout pipeline_layout_ = VK_NULL_HANDLE;
   VkPipeline graphics_pipeline_ = VK_NULL_HANDLE;
+  VkPipelineCache pipeline_cache_ = VK_NULL_HANDLE;
+  const std::string pipeline_cache_path_;
+  // Size of the cache data in pipeline_cache_path_.
+  size_t saved_pipeline_cache_size_ = 0;
   VkRenderPass render_pass_ = VK_NULL_HANDLE;
   VkCommandPool command_pool_ = VK_NULL_HANDLE;
+  VkCommandPool transfer_command_pool_ = VK_NULL_HANDLE;
   VkDescriptorPool descriptor_pool_;
+  // Descriptor sets of each frame in flight, see AllocateFrameDescriptorSet().
+  std::vector<VkDescriptorPool> frame_descriptor_pools_;
+  // Vertices and indices of all frames in flight, one slot per frame.
+  VkBuffer geometry_buffer_ = VK_NULL_HANDLE;
+  VulkanMemoryAllocator::Allocation geometry_allocation_;
+  uint8_t* geometry_data_ = nullptr;
+  VkDeviceSize geometry_slot_size_ = 0;
 
   int max_frames_in_flight_ = 0;
+  int frames_in_flight_ = 0;
+  const PacingMode pacing_mode_;
+  VkPresentModeKHR present_mode_ = VK_PRESENT_MODE_FIFO_KHR;
+
+  bool display_timing_enabled_ = false;
+  PFN_vkGetRefreshCycleDurationGOOGLE get_refresh_cycle_duration_ = nullptr;
+  PFN_vkGetPastPresentationTimingGOOGLE get_past_presentation_timing_ =
+      nullptr;
+  uint64_t refresh_duration_ns_ = 0;
+  uint32_t next_present_id_ = 1;
+  // Latest present that reached the display, which the vsyncs of later
+  // frames are predicted from.
+  uint64_t last_actual_present_ns_ = 0;
+  // Presents of the current adaptation window, those of them that missed
+  // their vsync, and the least time any of them was ready before it was
+  // needed.
+  int window_presents_ = 0;
+  int window_missed_presents_ = 0;
+  uint64_t window_min_margin_ns_ = UINT64_MAX;
+  // Number of RenderFromHardwareBuffer() calls so far.
+  uint64_t frame_count_ = 0;
 
   uint32_t queue_family_index_;
+  uint32_t transfer_queue_family_index_;
   uint32_t swapchain_length_;
 
   // array of frame buffers and views
-  std::vector<TextureImageInfo> texture_image_infos_;
+  std::vector<ImportedBuffer> imported_buffers_;
   std::vector<VkCommandBuffer> command_buffers_;
+  // kMaxContentSlots pools with one secondary command buffer each, for every
+  // frame in flight.
+  std::vector<VkCommandPool> content_command_pools_;
+  std::vector<VkCommandBuffer> content_command_buffers_;
+  // Content slots the frame being recorded executes, and its framebuffer.
+  std::vector<size_t> content_slot_counts_;
+  std::vector<VkFramebuffer> frame_framebuffers_;
+  // Background commands the frame being recorded executes, if any.
+  std::vector<VkCommandBuffer> frame_background_commands_;
   std::vector<SwapchinImageRelative> swapchain_image_relatives_;
-  std::vector<VkDescriptorSet> descriptor_sets_;
-  std::vector<VkBuffer> index_buffers_;
-  std::vector<VkDeviceMemory> index_buffers_memory_;
   std::vector<uint32_t> index_count_;
-  std::vector<VkBuffer> vertex_buffers_;
-  std::vector<VkDeviceMemory> vertex_buffers_memory_;
+  // Bumped whenever the geometry of a frame is set.
+  std::vector<uint64_t> geometry_versions_;
   std::vector<VkSemaphore> image_available_semaphores;
   std::vector<VkSemaphore> render_finished_semaphores;
   std::vector<VkFence> fences_;
+  // Semaphores the next frame submit waits for, after the swapchain image,
+  // see AddSubmitWaitSemaphore().
+  std::vector<VkSemaphore> submit_wait_semaphores_;
+  std::vector<VkPipelineStageFlags> submit_wait_stages_;
+  std::vector<PendingSubmission> pending_submissions_;
+  // Unsignaled fences of finished submissions, for reuse.
+  std::vector<VkFence> free_transfer_fences_;
+
+  static constexpr int kGpuTimeWindowSize = 240;
+  VkQueryPool timestamp_query_pool_ = VK_NULL_HANDLE;
+  // Nanoseconds per timestamp tick, and the bits of the ticks that are valid.
+  float timestamp_period_ns_ = 0.f;
+  uint64_t timestamp_mask_ = 0;
+  // Whether the frame's timestamps were recorded and not read back yet.
+  std::vector<bool> frame_timestamps_written_;
+  std::array<float, kGpuTimeWindowSize> render_pass_gpu_times_ms_ = {};
+  int next_gpu_time_ = 0;
+  int gpu_time_count_ = 0;
 };
 
 }  // namespace simple_vulkan
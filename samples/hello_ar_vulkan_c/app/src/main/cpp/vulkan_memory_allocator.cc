@@ -0,0 +1,336 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "vulkan_memory_allocator.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include "util.h"
+
+namespace simple_vulkan {
+namespace {
+// Enough for the buffers and depth images of the sample in one block per
+// memory type.
+constexpr VkDeviceSize kBlockSize = 16 * 1024 * 1024;
+
+VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+}  // namespace
+
+VulkanMemoryAllocator::VulkanMemoryAllocator(VkPhysicalDevice physical_device,
+                                             VkDevice logical_device)
+    : logical_device_(logical_device) {
+  vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_properties_);
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physical_device, &properties);
+  buffer_image_granularity_ =
+      std::max<VkDeviceSize>(1, properties.limits.bufferImageGranularity);
+}
+
+VulkanMemoryAllocator::~VulkanMemoryAllocator() {
+  for (const std::unique_ptr<Block>& block : blocks_) {
+    if (block->allocation_count > 0) {
+      LOGE("VulkanMemoryAllocator: %zu allocations leaked in a block.",
+           block->allocation_count);
+    }
+    if (block->mapped != nullptr) {
+      vkUnmapMemory(logical_device_, block->memory);
+    }
+    vkFreeMemory(logical_device_, block->memory, /* pAllocator=*/nullptr);
+  }
+}
+
+bool VulkanMemoryAllocator::Allocate(const VkMemoryRequirements& requirements,
+                                     VkMemoryPropertyFlags properties,
+                                     Allocation* allocation) {
+  uint32_t memory_type;
+  if (!FindMemoryType(requirements.memoryTypeBits, properties, &memory_type)) {
+    LOGE("VulkanMemoryAllocator: no memory type with properties 0x%x.",
+         properties);
+    return false;
+  }
+  const VkDeviceSize alignment =
+      std::max(requirements.alignment, buffer_image_granularity_);
+
+  if (requirements.size > kBlockSize / 2) {
+    Block* block = CreateBlock(memory_type, requirements.size,
+                               /* dedicated=*/true);
+    return block != nullptr &&
+           AllocateFromBlock(block, requirements.size, alignment, allocation);
+  }
+
+  for (const std::unique_ptr<Block>& block : blocks_) {
+    if (block->memory_type == memory_type && !block->dedicated &&
+        AllocateFromBlock(block.get(), requirements.size, alignment,
+                          allocation)) {
+      return true;
+    }
+  }
+  Block* block = CreateBlock(memory_type, kBlockSize, /* dedicated=*/false);
+  return block != nullptr &&
+         AllocateFromBlock(block, requirements.size, alignment, allocation);
+}
+
+void VulkanMemoryAllocator::Free(const Allocation& allocation) {
+  Block* block = allocation.block;
+  if (block == nullptr) {
+    return;
+  }
+  block->used_bytes -= allocation.size;
+  --block->allocation_count;
+
+  // Insert the range and merge it with the free ranges right before and
+  // after it.
+  VkDeviceSize offset = allocation.offset;
+  VkDeviceSize size = allocation.size;
+  auto next = block->free_ranges.lower_bound(offset);
+  if (next != block->free_ranges.begin()) {
+    auto previous = std::prev(next);
+    if (previous->first + previous->second == offset) {
+      offset = previous->first;
+      size += previous->second;
+      block->free_ranges.erase(previous);
+    }
+  }
+  if (next != block->free_ranges.end() && offset + size == next->first) {
+    size += next->second;
+    block->free_ranges.erase(next);
+  }
+  block->free_ranges[offset] = size;
+
+  if (block->allocation_count > 0) {
+    return;
+  }
+  // Keep one empty block per memory type around for the next allocations.
+  const bool has_other_block =
+      std::any_of(blocks_.begin(), blocks_.end(),
+                  [block](const std::unique_ptr<Block>& other) {
+                    return other.get() != block && !other->dedicated &&
+                           other->memory_type == block->memory_type;
+                  });
+  if (block->dedicated || has_other_block) {
+    DestroyBlock(block);
+  }
+}
+
+bool VulkanMemoryAllocator::CreateBuffer(VkDeviceSize size,
+                                         VkBufferUsageFlags usage,
+                                         VkMemoryPropertyFlags properties,
+                                         VkBuffer* buffer,
+                                         Allocation* allocation) {
+  const VkBufferCreateInfo buffer_info{
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .size = size,
+      .usage = usage,
+      .sharingMode = VK_SHARING_MODE_EXCLUSIVE};
+  if (vkCreateBuffer(logical_device_, &buffer_info, /* pAllocator=*/nullptr,
+                     buffer) != VK_SUCCESS) {
+    LOGE("VulkanMemoryAllocator: vkCreateBuffer failed.");
+    return false;
+  }
+
+  VkMemoryRequirements requirements;
+  vkGetBufferMemoryRequirements(logical_device_, *buffer, &requirements);
+  if (!Allocate(requirements, properties, allocation)) {
+    vkDestroyBuffer(logical_device_, *buffer, /* pAllocator=*/nullptr);
+    *buffer = VK_NULL_HANDLE;
+    return false;
+  }
+  return vkBindBufferMemory(logical_device_, *buffer, allocation->memory,
+                            allocation->offset) == VK_SUCCESS;
+}
+
+void VulkanMemoryAllocator::DestroyBuffer(VkBuffer buffer,
+                                          const Allocation& allocation) {
+  vkDestroyBuffer(logical_device_, buffer, /* pAllocator=*/nullptr);
+  Free(allocation);
+}
+
+bool VulkanMemoryAllocator::CreateImage(const VkImageCreateInfo& create_info,
+                                        VkMemoryPropertyFlags properties,
+                                        VkImage* image,
+                                        Allocation* allocation) {
+  if (vkCreateImage(logical_device_, &create_info, /* pAllocator=*/nullptr,
+                    image) != VK_SUCCESS) {
+    LOGE("VulkanMemoryAllocator: vkCreateImage failed.");
+    return false;
+  }
+
+  VkMemoryRequirements requirements;
+  vkGetImageMemoryRequirements(logical_device_, *image, &requirements);
+  if (!Allocate(requirements, properties, allocation)) {
+    vkDestroyImage(logical_device_, *image, /* pAllocator=*/nullptr);
+    *image = VK_NULL_HANDLE;
+    return false;
+  }
+  return vkBindImageMemory(logical_device_, *image, allocation->memory,
+                           allocation->offset) == VK_SUCCESS;
+}
+
+void VulkanMemoryAllocator::DestroyImage(VkImage image,
+                                         const Allocation& allocation) {
+  vkDestroyImage(logical_device_, image, /* pAllocator=*/nullptr);
+  Free(allocation);
+}
+
+VulkanMemoryAllocator::Stats VulkanMemoryAllocator::GetStats() const {
+  Stats stats;
+  VkDeviceSize free_bytes = 0;
+  VkDeviceSize largest_free_range = 0;
+  for (const std::unique_ptr<Block>& block : blocks_) {
+    ++stats.block_count;
+    stats.allocation_count += block->allocation_count;
+    stats.reserved_bytes += block->size;
+    stats.used_bytes += block->used_bytes;
+    for (const auto& range : block->free_ranges) {
+      free_bytes += range.second;
+      largest_free_range = std::max(largest_free_range, range.second);
+    }
+  }
+  if (free_bytes > 0) {
+    stats.fragmentation =
+        1.0f - static_cast<float>(largest_free_range) / free_bytes;
+  }
+  return stats;
+}
+
+bool VulkanMemoryAllocator::FindMemoryType(uint32_t type_bits,
+                                           VkMemoryPropertyFlags properties,
+                                           uint32_t* memory_type) const {
+  for (uint32_t i = 0; i < memory_properties_.memoryTypeCount; i++) {
+    if ((type_bits & (1 << i)) &&
+        (memory_properties_.memoryTypes[i].propertyFlags & properties) ==
+            properties) {
+      *memory_type = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+VulkanMemoryAllocator::Block* VulkanMemoryAllocator::CreateBlock(
+    uint32_t memory_type, VkDeviceSize size, bool dedicated) {
+  const VkMemoryAllocateInfo alloc_info{
+      .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+      .allocationSize = size,
+      .memoryTypeIndex = memory_type,
+  };
+  VkDeviceMemory memory;
+  if (vkAllocateMemory(logical_device_, &alloc_info, /* pAllocator=*/nullptr,
+                       &memory) != VK_SUCCESS) {
+    LOGE("VulkanMemoryAllocator: failed to allocate %llu bytes.",
+         static_cast<unsigned long long>(size));
+    return nullptr;
+  }
+
+  void* mapped = nullptr;
+  if (memory_properties_.memoryTypes[memory_type].propertyFlags &
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+    if (vkMapMemory(logical_device_, memory, /* offset=*/0, VK_WHOLE_SIZE,
+                    /* flags=*/0, &mapped) != VK_SUCCESS) {
+      LOGE("VulkanMemoryAllocator: failed to map a block.");
+      vkFreeMemory(logical_device_, memory, /* pAllocator=*/nullptr);
+      return nullptr;
+    }
+  }
+
+  blocks_.push_back(std::unique_ptr<Block>(new Block{
+      .memory = memory,
+      .size = size,
+      .mapped = static_cast<uint8_t*>(mapped),
+      .memory_type = memory_type,
+      .dedicated = dedicated,
+      .free_ranges = {{0, size}},
+      .used_bytes = 0,
+      .allocation_count = 0,
+  }));
+  return blocks_.back().get();
+}
+
+void VulkanMemoryAllocator::DestroyBlock(Block* block) {
+  if (block->mapped != nullptr) {
+    vkUnmapMemory(logical_device_, block->memory);
+  }
+  vkFreeMemory(logical_device_, block->memory, /* pAllocator=*/nullptr);
+  blocks_.erase(std::find_if(blocks_.begin(), blocks_.end(),
+                             [block](const std::unique_ptr<Block>& other) {
+                               return other.get() == block;
+                             }));
+}
+
+bool VulkanMemoryAllocator::AllocateFromBlock(Block* block, VkDeviceSize size,
+                                              VkDeviceSize alignment,
+                                              Allocation* allocation) {
+  for (auto range = block->free_ranges.begin();
+       range != block->free_ranges.end(); ++range) {
+    const VkDeviceSize range_begin = range->first;
+    const VkDeviceSize range_end = range->first + range->second;
+    const VkDeviceSize offset = AlignUp(range_begin, alignment);
+    if (offset + size > range_end) {
+      continue;
+    }
+
+    // The alignment padding and the rest of the range stay free.
+    block->free_ranges.erase(range);
+    if (offset > range_begin) {
+      block->free_ranges[range_begin] = offset - range_begin;
+    }
+    if (offset + size < range_end) {
+      block->free_ranges[offset + size] = range_end - offset - size;
+    }
+    block->used_bytes += size;
+    ++block->allocation_count;
+
+    allocation->memory = block->memory;
+    allocation->offset = offset;
+    allocation->size = size;
+    allocation->mapped =
+        block->mapped != nullptr ? block->mapped + offset : nullptr;
+    allocation->block = block;
+    return true;
+  }
+  return false;
+}
+
+LinearArena::LinearArena(VulkanMemoryAllocator* allocator,
+                         VkDeviceSize capacity, VkBufferUsageFlags usage)
+    : allocator_(allocator) {
+  CHECK(allocator_->CreateBuffer(capacity, usage,
+                                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                 &buffer_, &allocation_));
+}
+
+LinearArena::~LinearArena() { allocator_->DestroyBuffer(buffer_, allocation_); }
+
+bool LinearArena::Allocate(VkDeviceSize size, VkDeviceSize alignment,
+                           VkBuffer* buffer, VkDeviceSize* offset,
+                           void** data) {
+  const VkDeviceSize begin =
+      AlignUp(head_, std::max<VkDeviceSize>(1, alignment));
+  if (begin + size > allocation_.size) {
+    return false;
+  }
+  head_ = begin + size;
+  *buffer = buffer_;
+  *offset = begin;
+  *data = allocation_.mapped + begin;
+  return true;
+}
+
+}  // namespace simple_vulkan
@@ -0,0 +1,166 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef C_ARCORE_SIMPLE_VULKAN_VULKAN_MEMORY_ALLOCATOR_H_
+#define C_ARCORE_SIMPLE_VULKAN_VULKAN_MEMORY_ALLOCATOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "android_vulkan_loader.h"
+
+namespace simple_vulkan {
+
+/**
+ * Sub-allocates buffers and images from a few large VkDeviceMemory blocks per
+ * memory type, since drivers limit the number of allocations and make each
+ * one expensive.
+ *
+ * Every block keeps its free ranges sorted by offset. Allocations take the
+ * first range they fit in and freed ranges merge with their neighbours.
+ * Host visible blocks are mapped once for their whole lifetime.
+ */
+class VulkanMemoryAllocator {
+ public:
+  struct Block;
+
+  /**
+   * A range of a block, returned by Allocate().
+   */
+  struct Allocation {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    // Host address of the range, or nullptr if the memory is not host visible.
+    uint8_t* mapped = nullptr;
+    Block* block = nullptr;
+  };
+
+  /**
+   * Memory use over all blocks.
+   */
+  struct Stats {
+    size_t block_count = 0;
+    size_t allocation_count = 0;
+    // Bytes of all blocks.
+    VkDeviceSize reserved_bytes = 0;
+    // Bytes handed out, alignment padding excluded.
+    VkDeviceSize used_bytes = 0;
+    // 1 - largest free range / free bytes. 0 when the free space is in one
+    // piece, close to 1 when it is scattered into small ranges.
+    float fragmentation = 0.0f;
+  };
+
+  VulkanMemoryAllocator(VkPhysicalDevice physical_device,
+                        VkDevice logical_device);
+  // All allocations must have been freed.
+  ~VulkanMemoryAllocator();
+
+  VulkanMemoryAllocator(const VulkanMemoryAllocator&) = delete;
+  VulkanMemoryAllocator& operator=(const VulkanMemoryAllocator&) = delete;
+
+  /**
+   * Allocate memory of a type with |properties| that satisfies
+   * |requirements|. Allocations larger than half a block get a block of
+   * their own.
+   *
+   * @return false if no memory type or device memory is left.
+   */
+  bool Allocate(const VkMemoryRequirements& requirements,
+                VkMemoryPropertyFlags properties, Allocation* allocation);
+  void Free(const Allocation& allocation);
+
+  /**
+   * Create |buffer| or |image| and bind it to a new allocation.
+   */
+  bool CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
+                    VkMemoryPropertyFlags properties, VkBuffer* buffer,
+                    Allocation* allocation);
+  void DestroyBuffer(VkBuffer buffer, const Allocation& allocation);
+  bool CreateImage(const VkImageCreateInfo& create_info,
+                   VkMemoryPropertyFlags properties, VkImage* image,
+                   Allocation* allocation);
+  void DestroyImage(VkImage image, const Allocation& allocation);
+
+  Stats GetStats() const;
+
+  struct Block {
+    VkDeviceMemory memory;
+    VkDeviceSize size;
+    uint8_t* mapped;
+    uint32_t memory_type;
+    // Holds a single allocation, and is released with it.
+    bool dedicated;
+    // Offset to size of the unused ranges.
+    std::map<VkDeviceSize, VkDeviceSize> free_ranges;
+    VkDeviceSize used_bytes;
+    size_t allocation_count;
+  };
+
+ private:
+  bool FindMemoryType(uint32_t type_bits, VkMemoryPropertyFlags properties,
+                      uint32_t* memory_type) const;
+  Block* CreateBlock(uint32_t memory_type, VkDeviceSize size, bool dedicated);
+  void DestroyBlock(Block* block);
+  bool AllocateFromBlock(Block* block, VkDeviceSize size,
+                         VkDeviceSize alignment, Allocation* allocation);
+
+  VkDevice logical_device_;
+  VkPhysicalDeviceMemoryProperties memory_properties_;
+  // Linear and optimally tiled resources sharing a block must be this far
+  // apart, so every allocation is aligned to it.
+  VkDeviceSize buffer_image_granularity_;
+  std::vector<std::unique_ptr<Block>> blocks_;
+};
+
+/**
+ * Bump allocator over a host visible buffer, for data that is written by the
+ * CPU and read by the GPU within one frame. Reset() makes the whole buffer
+ * available again once the GPU is done with the frame.
+ */
+class LinearArena {
+ public:
+  LinearArena(VulkanMemoryAllocator* allocator, VkDeviceSize capacity,
+              VkBufferUsageFlags usage);
+  ~LinearArena();
+
+  LinearArena(const LinearArena&) = delete;
+  LinearArena& operator=(const LinearArena&) = delete;
+
+  /**
+   * Reserve |size| bytes at a multiple of |alignment|.
+   *
+   * @return false if the arena is full.
+   */
+  bool Allocate(VkDeviceSize size, VkDeviceSize alignment, VkBuffer* buffer,
+                VkDeviceSize* offset, void** data);
+  void Reset() { head_ = 0; }
+
+  VkDeviceSize GetUsedBytes() const { return head_; }
+
+ private:
+  VulkanMemoryAllocator* const allocator_;
+  VkBuffer buffer_ = VK_NULL_HANDLE;
+  VulkanMemoryAllocator::Allocation allocation_;
+  VkDeviceSize head_ = 0;
+};
+
+}  // namespace simple_vulkan
+
+#endif  // C_ARCORE_SIMPLE_VULKAN_VULKAN_MEMORY_ALLOCATOR_H_
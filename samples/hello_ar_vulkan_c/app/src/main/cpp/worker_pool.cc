@@ -0,0 +1,153 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+
+namespace simple_vulkan {
+namespace {
+// Returns the maximum frequency of |cpu| in kHz, or 0 if it is unknown.
+int64_t GetCpuMaxFrequency(int cpu) {
+  const std::string path = "/sys/devices/system/cpu/cpu" +
+                           std::to_string(cpu) + "/cpufreq/cpuinfo_max_freq";
+  FILE* file = fopen(path.c_str(), "r");
+  if (file == nullptr) {
+    return 0;
+  }
+  long long frequency = 0;
+  if (fscanf(file, "%lld", &frequency) != 1) {
+    frequency = 0;
+  }
+  fclose(file);
+  return frequency;
+}
+}  // namespace
+
+WorkerPool::WorkerPool() : WorkerPool(GetDefaultWorkerCount()) {}
+
+WorkerPool::WorkerPool(int num_workers) {
+  for (int i = 0; i < num_workers; ++i) {
+    workers_.emplace_back(&WorkerPool::WorkerLoop, this);
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_all();
+  for (std::thread& worker : workers_) {
+    worker.join();
+  }
+}
+
+int WorkerPool::GetDefaultWorkerCount() {
+  const int num_cores =
+      std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  std::vector<int64_t> frequencies;
+  for (int cpu = 0; cpu < num_cores; ++cpu) {
+    frequencies.push_back(GetCpuMaxFrequency(cpu));
+  }
+  const int64_t slowest =
+      *std::min_element(frequencies.begin(), frequencies.end());
+  // Every core but those of the slowest cluster counts as a big core.
+  int num_big_cores = 0;
+  for (int64_t frequency : frequencies) {
+    if (frequency > slowest) {
+      ++num_big_cores;
+    }
+  }
+  if (slowest == 0 || num_big_cores == 0) {
+    num_big_cores = num_cores;
+  }
+  return num_big_cores - 1;
+}
+
+void WorkerPool::Run(int num_tasks, const std::function<void(int)>& task) {
+  if (num_tasks <= 0) {
+    return;
+  }
+  if (workers_.empty() || num_tasks == 1) {
+    for (int i = 0; i < num_tasks; ++i) {
+      task(i);
+    }
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    task_ = &task;
+    num_tasks_ = num_tasks;
+    next_task_.store(0, std::memory_order_relaxed);
+    pending_tasks_.store(num_tasks, std::memory_order_relaxed);
+    ++generation_;
+  }
+  wake_.notify_all();
+
+  RunTasks(task);
+
+  // Workers that have not joined yet will find no job.  Those that did are
+  // counted, so waiting for them makes it safe to return.
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    task_ = nullptr;
+  }
+  while (pending_tasks_.load(std::memory_order_acquire) > 0 ||
+         workers_in_job_.load(std::memory_order_acquire) > 0) {
+    std::this_thread::yield();
+  }
+}
+
+void WorkerPool::WorkerLoop() {
+  uint64_t seen_generation = 0;
+  while (true) {
+    const std::function<void(int)>* task = nullptr;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_.wait(lock, [this, seen_generation] {
+        return stopping_ || generation_ != seen_generation;
+      });
+      if (stopping_) {
+        return;
+      }
+      seen_generation = generation_;
+      if (task_ == nullptr) {
+        continue;
+      }
+      task = task_;
+      workers_in_job_.fetch_add(1, std::memory_order_relaxed);
+    }
+    RunTasks(*task);
+    workers_in_job_.fetch_sub(1, std::memory_order_release);
+  }
+}
+
+void WorkerPool::RunTasks(const std::function<void(int)>& task) {
+  while (true) {
+    const int index = next_task_.fetch_add(1, std::memory_order_relaxed);
+    if (index >= num_tasks_) {
+      return;
+    }
+    task(index);
+    pending_tasks_.fetch_sub(1, std::memory_order_release);
+  }
+}
+
+}  // namespace simple_vulkan
@@ -34,7 +34,8 @@ public class JniInterface {
   private static final String TAG = "JniInterface";
   static AssetManager assetManager;
 
-  public static native long createNativeApplication(AssetManager assetManager);
+  public static native long createNativeApplication(
+      AssetManager assetManager, String pipelineCacheDirectory);
 
   public static native void destroyNativeApplication(long nativeApplication);
 
@@ -52,6 +53,35 @@ public class JniInterface {
   /** Main render loop. */
   public static native void onSurfaceDrawFrame(long nativeApplication);
 
+  /** Places an object where the tap at (x, y), in view pixels, hits. Called on the UI thread. */
+  public static native void onTouched(long nativeApplication, float x, float y);
+
+  /**
+   * Returns the GPU time of the render pass over recent frames: the minimum, average and 95th
+   * percentile in milliseconds, followed by the number of frames they were computed from, which is
+   * 0 if the GPU has no timestamps. Uses the same layout as a frame stage of the hello_ar_c sample.
+   * Called on the UI thread.
+   */
+  public static native float[] getRenderPassGpuStats(long nativeApplication);
+
+  /**
+   * Switches between FIFO presentation with every frame in flight and low latency presentation,
+   * which uses MAILBOX if supported, adapts the number of frames in flight and aligns present times
+   * to vsync. Recreates the swapchain. Called on the UI thread.
+   */
+  public static native void setLowLatencyPacing(long nativeApplication, boolean enabled);
+
+  /**
+   * Plays back an MP4 dataset instead of the live camera and writes per-frame timings to a CSV
+   * file. Must be called before the first onResume and onSurfaceCreated. Returns false if the CSV
+   * file cannot be created.
+   */
+  public static native boolean startPlaybackBenchmark(
+      long nativeApplication, String datasetUri, String csvPath);
+
+  /** Returns true once the playback benchmark reached the end of the dataset. */
+  public static native boolean isPlaybackBenchmarkFinished(long nativeApplication);
+
   public static Bitmap loadImage(String imageName) {
 
     try {
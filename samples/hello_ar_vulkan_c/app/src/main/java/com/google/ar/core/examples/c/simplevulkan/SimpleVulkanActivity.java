@@ -20,12 +20,14 @@ import android.hardware.display.DisplayManager;
 import android.os.Bundle;
 import android.util.Log;
 import android.view.GestureDetector;
+import android.view.MotionEvent;
 import android.view.Surface;
 import android.view.View;
 import android.view.WindowManager;
 import android.widget.Toast;
 import androidx.appcompat.app.AppCompatActivity;
 import com.google.android.material.snackbar.Snackbar;
+import java.io.File;
 
 /**
  * This is a simple example that shows how to create a Vulkan rendering application using the ARCore
@@ -36,8 +38,20 @@ public class SimpleVulkanActivity extends AppCompatActivity
   private static final String TAG = SimpleVulkanActivity.class.getSimpleName();
   private static final int SNACKBAR_UPDATE_INTERVAL_MILLIS = 1000; // In milliseconds.
 
+  /**
+   * Intent extra with the URI of an MP4 dataset to benchmark. The results are written to
+   * playback_benchmark.csv in the app's external files directory, e.g. with {@code adb shell am
+   * start -n com.google.ar.core.examples.c.simplevulkan/.SimpleVulkanActivity --es
+   * benchmark_dataset_uri file:///sdcard/dataset.mp4}.
+   */
+  public static final String EXTRA_BENCHMARK_DATASET_URI = "benchmark_dataset_uri";
+
+  private static final String BENCHMARK_CSV_FILE_NAME = "playback_benchmark.csv";
+
   private VulkanSurfaceView surfaceView;
 
+  private boolean benchmarkRunning = false;
+
   private boolean viewportChanged = false;
   private int viewportWidth;
   private int viewportHeight;
@@ -55,8 +69,45 @@ public class SimpleVulkanActivity extends AppCompatActivity
     surfaceView = (VulkanSurfaceView) findViewById(R.id.surfaceview);
     surfaceView.setRenderer(this);
 
+    // Frames are drawn on the UI thread too, so taps are handled right away.
+    gestureDetector =
+        new GestureDetector(
+            this,
+            new GestureDetector.SimpleOnGestureListener() {
+              @Override
+              public boolean onSingleTapUp(final MotionEvent e) {
+                // Synchronized to avoid racing onDestroy.
+                synchronized (SimpleVulkanActivity.this) {
+                  if (nativeApplication != 0) {
+                    JniInterface.onTouched(nativeApplication, e.getX(), e.getY());
+                  }
+                }
+                return true;
+              }
+
+              @Override
+              public boolean onDown(MotionEvent e) {
+                return true;
+              }
+            });
+    surfaceView.setOnTouchListener(
+        (View v, MotionEvent event) -> gestureDetector.onTouchEvent(event));
+
     JniInterface.assetManager = getAssets();
-    nativeApplication = JniInterface.createNativeApplication(getAssets());
+    nativeApplication =
+        JniInterface.createNativeApplication(
+            getAssets(), getCodeCacheDir().getAbsolutePath());
+
+    String benchmarkDatasetUri = getIntent().getStringExtra(EXTRA_BENCHMARK_DATASET_URI);
+    if (benchmarkDatasetUri != null) {
+      File csvFile = new File(getExternalFilesDir(null), BENCHMARK_CSV_FILE_NAME);
+      benchmarkRunning =
+          JniInterface.startPlaybackBenchmark(
+              nativeApplication, benchmarkDatasetUri, csvFile.getAbsolutePath());
+      if (!benchmarkRunning) {
+        Log.e(TAG, "Could not start the playback benchmark");
+      }
+    }
   }
 
   @Override
@@ -146,6 +197,11 @@ public class SimpleVulkanActivity extends AppCompatActivity
         viewportChanged = false;
       }
       JniInterface.onSurfaceDrawFrame(nativeApplication);
+      if (benchmarkRunning && JniInterface.isPlaybackBenchmarkFinished(nativeApplication)) {
+        benchmarkRunning = false;
+        Log.i(TAG, "Playback benchmark finished");
+        runOnUiThread(this::finish);
+      }
     }
   }
 
@@ -0,0 +1,1518 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Desktop replay of the subset of the ARCore C API the C samples use, fed by
+// a session capture of hello_ar_c (see ar_capture_format.h) instead of the
+// camera and sensors, so the samples' application classes run on Linux with
+// deterministic inputs, e.g. under headless EGL in CI.
+//
+// Build it as a drop-in for the ARCore library from the repository root:
+//
+//   g++ -O2 -std=c++17 -shared -fPIC -Ilibraries/include
+//       -Isamples/hello_ar_c/app/src/main/cpp
+//       tools/arcore_replay/*.cc
+//       samples/hello_ar_c/app/src/main/cpp/ar_capture_format.cc
+//       -o libarcore_sdk_c.so
+//
+// The capture is the dataset set with ArSession_setPlaybackDatasetUri(), a
+// path or file:// URI, or else the ARCORE_REPLAY_CAPTURE environment
+// variable.  Every ArSession_update() plays exactly one captured frame, so
+// a run does not depend on timing; once the capture is played back the last
+// frame repeats and the playback status is AR_PLAYBACK_FINISHED.
+//
+// Replayed:
+// - the camera pose, view and projection matrices and intrinsics,
+// - the display geometry's texture coordinate transforms,
+// - planes, with their polygons, subsumption and hit tests against them,
+// - the point cloud, light estimate and depth images,
+// - anchors: the i-th anchor the app creates follows the i-th anchor of the
+//   capture, or else the plane it was attached to.
+// The camera texture is not written, and camera images are synthetic, see
+// ArSession_::GetCameraImage().  Cloud anchors, Geospatial, Streetscape
+// Geometry, faces, augmented images, semantics, image metadata and recording
+// report that they are unsupported or not available.
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "arcore_c_api.h"
+#include "replay_math.h"
+#include "replay_objects.h"
+
+namespace capture = hello_ar::capture;
+
+namespace {
+
+void ToNdc(const ArSession_* session, const ArFrame_* frame,
+           ArCoordinates2dType type, float x, float y, float* ndc) {
+  const capture::DisplayGeometryRecord& display = frame->display;
+  const float* affine = nullptr;
+  float scale_x = 1.f, scale_y = 1.f;
+  switch (type) {
+    case AR_COORDINATES_2D_OPENGL_NORMALIZED_DEVICE_COORDINATES:
+      ndc[0] = x;
+      ndc[1] = y;
+      return;
+    case AR_COORDINATES_2D_VIEW:
+      x /= std::max(1, display.width);
+      y /= std::max(1, display.height);
+      [[fallthrough]];
+    case AR_COORDINATES_2D_VIEW_NORMALIZED:
+      ndc[0] = 2.f * x - 1.f;
+      ndc[1] = 1.f - 2.f * y;
+      return;
+    case AR_COORDINATES_2D_TEXTURE_TEXELS:
+      scale_x = std::max(1, session->info.texture_width);
+      scale_y = std::max(1, session->info.texture_height);
+      [[fallthrough]];
+    case AR_COORDINATES_2D_TEXTURE_NORMALIZED:
+      affine = display.ndc_to_texture_normalized;
+      break;
+    case AR_COORDINATES_2D_IMAGE_PIXELS:
+      scale_x = std::max(1, session->info.image_width);
+      scale_y = std::max(1, session->info.image_height);
+      [[fallthrough]];
+    case AR_COORDINATES_2D_IMAGE_NORMALIZED:
+      affine = display.ndc_to_image_normalized;
+      break;
+    default:
+      ndc[0] = x;
+      ndc[1] = y;
+      return;
+  }
+  // Inverts u = a x + b y + c, v = d x + e y + f.
+  const float u = x / scale_x - affine[2];
+  const float v = y / scale_y - affine[5];
+  const float determinant = affine[0] * affine[4] - affine[1] * affine[3];
+  if (determinant == 0.f) {
+    ndc[0] = ndc[1] = 0.f;
+    return;
+  }
+  ndc[0] = (affine[4] * u - affine[1] * v) / determinant;
+  ndc[1] = (affine[0] * v - affine[3] * u) / determinant;
+}
+
+void FromNdc(const ArSession_* session, const ArFrame_* frame,
+             ArCoordinates2dType type, const float* ndc, float* out) {
+  const capture::DisplayGeometryRecord& display = frame->display;
+  const float* affine = nullptr;
+  float scale_x = 1.f, scale_y = 1.f;
+  switch (type) {
+    case AR_COORDINATES_2D_OPENGL_NORMALIZED_DEVICE_COORDINATES:
+      out[0] = ndc[0];
+      out[1] = ndc[1];
+      return;
+    case AR_COORDINATES_2D_VIEW:
+      scale_x = std::max(1, display.width);
+      scale_y = std::max(1, display.height);
+      [[fallthrough]];
+    case AR_COORDINATES_2D_VIEW_NORMALIZED:
+      out[0] = scale_x * 0.5f * (ndc[0] + 1.f);
+      out[1] = scale_y * 0.5f * (1.f - ndc[1]);
+      return;
+    case AR_COORDINATES_2D_TEXTURE_TEXELS:
+      scale_x = std::max(1, session->info.texture_width);
+      scale_y = std::max(1, session->info.texture_height);
+      [[fallthrough]];
+    case AR_COORDINATES_2D_TEXTURE_NORMALIZED:
+      affine = display.ndc_to_texture_normalized;
+      break;
+    case AR_COORDINATES_2D_IMAGE_PIXELS:
+      scale_x = std::max(1, session->info.image_width);
+      scale_y = std::max(1, session->info.image_height);
+      [[fallthrough]];
+    case AR_COORDINATES_2D_IMAGE_NORMALIZED:
+      affine = display.ndc_to_image_normalized;
+      break;
+    default:
+      out[0] = ndc[0];
+      out[1] = ndc[1];
+      return;
+  }
+  out[0] = scale_x * (affine[0] * ndc[0] + affine[1] * ndc[1] + affine[2]);
+  out[1] = scale_y * (affine[3] * ndc[0] + affine[4] * ndc[1] + affine[5]);
+}
+
+// Projection of |camera| for other clip planes than the recorded ones: only
+// the depth terms of ARCore's projection depend on them.
+void GetProjection(const ArCamera_* camera, float near, float far,
+                   float* out) {
+  memcpy(out, camera->record.projection, 16 * sizeof(float));
+  out[10] = (far + near) / (near - far);
+  out[14] = 2.f * far * near / (near - far);
+}
+
+// Inverts a 4x4 column major matrix, returns false if it is singular.
+bool InvertMatrix(const float* m, float* out) {
+  float inv[16];
+  inv[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] +
+           m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+  inv[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] +
+           m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] +
+           m[12] * m[7] * m[10];
+  inv[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] +
+           m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+  inv[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] +
+            m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] +
+            m[12] * m[6] * m[9];
+  inv[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] +
+           m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] +
+           m[13] * m[3] * m[10];
+  inv[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] +
+           m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+  inv[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] +
+           m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] +
+           m[12] * m[3] * m[9];
+  inv[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] +
+            m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+  inv[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15] +
+           m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+  inv[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15] -
+           m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+  inv[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15] +
+            m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+  inv[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] +
+            m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6] +
+            m[12] * m[2] * m[5];
+  inv[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11] -
+           m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+  inv[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11] +
+           m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+  inv[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11] -
+            m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+  inv[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10] +
+            m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+  const float determinant =
+      m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+  if (determinant == 0.f) {
+    return false;
+  }
+  for (int i = 0; i < 16; ++i) {
+    out[i] = inv[i] / determinant;
+  }
+  return true;
+}
+
+void MultiplyPoint(const float* m, const float* point, float* out) {
+  for (int row = 0; row < 4; ++row) {
+    out[row] = m[row] * point[0] + m[4 + row] * point[1] +
+               m[8 + row] * point[2] + m[12 + row] * point[3];
+  }
+}
+
+ArAnchor_* CreateAnchor(ArSession_* session, const float* pose) {
+  session->anchors.emplace_back(new ArAnchor_);
+  ArAnchor_* anchor = session->anchors.back().get();
+  anchor->id = static_cast<int32_t>(session->anchors.size()) - 1;
+  memcpy(anchor->pose, pose, sizeof(anchor->pose));
+  return anchor;
+}
+
+ArAnchor_* CreatePlaneAnchor(ArSession_* session, ArTrackable_* plane,
+                             const float* pose) {
+  ArAnchor_* anchor = CreateAnchor(session, pose);
+  anchor->plane = plane;
+  float inverse_center[7];
+  arcore_replay::InvertPose(plane->record.center_pose, inverse_center);
+  arcore_replay::ComposePoses(inverse_center, pose, anchor->plane_pose);
+  return anchor;
+}
+
+void AddPlanes(const ArSession_* session, ArTrackableType filter_type,
+               ArTrackableList_* list) {
+  if (filter_type != AR_TRACKABLE_PLANE &&
+      filter_type != AR_TRACKABLE_BASE_TRACKABLE) {
+    return;
+  }
+  for (const std::unique_ptr<ArTrackable_>& plane : session->planes) {
+    list->items.push_back(plane.get());
+  }
+}
+
+}  // namespace
+
+extern "C" {
+
+// Session.
+
+ArStatus ArCoreApk_requestInstall(void*, void*, int32_t,
+                                  ArInstallStatus* out_install_status) {
+  *out_install_status = AR_INSTALL_STATUS_INSTALLED;
+  return AR_SUCCESS;
+}
+
+ArStatus ArSession_create(void*, void*, ArSession** out_session_pointer) {
+  if (out_session_pointer == nullptr) {
+    return AR_ERROR_INVALID_ARGUMENT;
+  }
+  ArSession_* session = new ArSession_;
+  const char* path = getenv("ARCORE_REPLAY_CAPTURE");
+  if (path != nullptr) {
+    session->OpenCapture(path);
+  }
+  *out_session_pointer = session;
+  return AR_SUCCESS;
+}
+
+void ArSession_destroy(ArSession* session) { delete session; }
+
+ArStatus ArSession_setPlaybackDatasetUri(ArSession* session,
+                                         const char* mp4_dataset_uri) {
+  if (session->resumed) {
+    return AR_ERROR_SESSION_NOT_PAUSED;
+  }
+  if (mp4_dataset_uri == nullptr) {
+    session->reader.Close();
+    return AR_SUCCESS;
+  }
+  std::string path = mp4_dataset_uri;
+  if (path.compare(0, 7, "file://") == 0) {
+    path.erase(0, 7);
+  }
+  return session->OpenCapture(path) ? AR_SUCCESS : AR_ERROR_PLAYBACK_FAILED;
+}
+
+void ArSession_getPlaybackStatus(ArSession* session,
+                                 ArPlaybackStatus* out_playback_status) {
+  *out_playback_status = session->playback_status;
+}
+
+ArStatus ArSession_configure(ArSession* session, const ArConfig* config) {
+  session->config = *config;
+  return AR_SUCCESS;
+}
+
+void ArSession_getConfig(ArSession* session, ArConfig* out_config) {
+  *out_config = session->config;
+}
+
+ArStatus ArSession_resume(ArSession* session) {
+  if (!session->reader.IsOpen()) {
+    return AR_ERROR_PLAYBACK_FAILED;
+  }
+  session->resumed = true;
+  if (session->playback_status == AR_PLAYBACK_NONE) {
+    session->playback_status = AR_PLAYBACK_OK;
+  }
+  return AR_SUCCESS;
+}
+
+ArStatus ArSession_pause(ArSession* session) {
+  session->resumed = false;
+  return AR_SUCCESS;
+}
+
+ArStatus ArSession_update(ArSession* session, ArFrame* out_frame) {
+  return session->Update(out_frame);
+}
+
+void ArSession_setDisplayGeometry(ArSession* session, int32_t rotation,
+                                  int32_t width, int32_t height) {
+  if (rotation != session->display_rotation ||
+      width != session->display_width || height != session->display_height) {
+    session->display_geometry_changed = true;
+  }
+  session->display_rotation = rotation;
+  session->display_width = width;
+  session->display_height = height;
+}
+
+void ArSession_setCameraTextureName(ArSession* session, uint32_t texture_id) {
+  session->camera_texture_name = texture_id;
+}
+
+void ArSession_setCameraTextureNames(ArSession* session,
+                                     int32_t number_of_textures,
+                                     const uint32_t* texture_ids) {
+  if (number_of_textures > 0) {
+    // The camera texture never changes, so there is nothing to rotate.
+    session->camera_texture_name = texture_ids[0];
+  }
+}
+
+void ArSession_getAllTrackables(const ArSession* session,
+                                ArTrackableType filter_type,
+                                ArTrackableList* out_trackable_list) {
+  out_trackable_list->items.clear();
+  AddPlanes(session, filter_type, out_trackable_list);
+}
+
+ArStatus ArSession_acquireNewAnchor(ArSession* session, const ArPose* pose,
+                                    ArAnchor** out_anchor) {
+  if (session->camera.record.tracking_state != AR_TRACKING_STATE_TRACKING) {
+    return AR_ERROR_NOT_TRACKING;
+  }
+  *out_anchor = CreateAnchor(session, pose->raw);
+  return AR_SUCCESS;
+}
+
+void ArSession_isDepthModeSupported(const ArSession*,
+                                    ArDepthMode depth_mode,
+                                    int32_t* out_is_supported) {
+  // Whether the capture holds depth is only known once it is played, so
+  // depth is supported and frames without it have no depth image yet.
+  *out_is_supported = depth_mode == AR_DEPTH_MODE_DISABLED ||
+                      depth_mode == AR_DEPTH_MODE_AUTOMATIC ||
+                      depth_mode == AR_DEPTH_MODE_RAW_DEPTH_ONLY;
+}
+
+void ArSession_isSemanticModeSupported(const ArSession*,
+                                       ArSemanticMode semantic_mode,
+                                       int32_t* out_is_supported) {
+  *out_is_supported = semantic_mode == AR_SEMANTIC_MODE_DISABLED;
+}
+
+void ArSession_isGeospatialModeSupported(const ArSession*,
+                                         ArGeospatialMode geospatial_mode,
+                                         int32_t* out_is_supported) {
+  *out_is_supported = geospatial_mode == AR_GEOSPATIAL_MODE_DISABLED;
+}
+
+void ArSession_isImageStabilizationModeSupported(
+    const ArSession*, ArImageStabilizationMode image_stabilization_mode,
+    int32_t* out_is_supported) {
+  *out_is_supported =
+      image_stabilization_mode == AR_IMAGE_STABILIZATION_MODE_OFF;
+}
+
+void ArSession_getCameraConfig(const ArSession* session,
+                               ArCameraConfig* out_camera_config) {
+  out_camera_config->info = session->info;
+}
+
+void ArSession_getSupportedCameraConfigsWithFilter(
+    const ArSession* session, const ArCameraConfigFilter*,
+    ArCameraConfigList* list) {
+  list->configs.assign(1, session->info);
+}
+
+ArStatus ArSession_setCameraConfig(const ArSession*, const ArCameraConfig*) {
+  return AR_SUCCESS;
+}
+
+ArStatus ArSession_startRecording(ArSession*, const ArRecordingConfig*) {
+  return AR_ERROR_RECORDING_FAILED;
+}
+
+ArStatus ArSession_stopRecording(ArSession*) {
+  return AR_ERROR_RECORDING_FAILED;
+}
+
+void ArSession_getRecordingStatus(ArSession*,
+                                  ArRecordingStatus* out_recording_status) {
+  *out_recording_status = AR_RECORDING_NONE;
+}
+
+ArStatus ArSession_estimateFeatureMapQualityForHosting(
+    const ArSession*, const ArPose*,
+    ArFeatureMapQuality* out_feature_map_quality) {
+  *out_feature_map_quality = AR_FEATURE_MAP_QUALITY_INSUFFICIENT;
+  return AR_ERROR_UNSUPPORTED_CONFIGURATION;
+}
+
+ArStatus ArSession_hostCloudAnchorAsync(ArSession*, const ArAnchor*, int32_t,
+                                        void*, ArHostCloudAnchorCallback,
+                                        ArHostCloudAnchorFuture** out_future) {
+  if (out_future != nullptr) {
+    *out_future = nullptr;
+  }
+  return AR_ERROR_UNSUPPORTED_CONFIGURATION;
+}
+
+ArStatus ArSession_resolveCloudAnchorAsync(
+    ArSession*, const char*, void*, ArResolveCloudAnchorCallback,
+    ArResolveCloudAnchorFuture** out_future) {
+  if (out_future != nullptr) {
+    *out_future = nullptr;
+  }
+  return AR_ERROR_UNSUPPORTED_CONFIGURATION;
+}
+
+ArStatus ArSession_checkVpsAvailabilityAsync(
+    ArSession*, double, double, void*, ArVpsAvailabilityCallback,
+    ArVpsAvailabilityFuture** out_future) {
+  if (out_future != nullptr) {
+    *out_future = nullptr;
+  }
+  return AR_ERROR_UNSUPPORTED_CONFIGURATION;
+}
+
+void ArSession_acquireEarth(const ArSession*, ArEarth** out_earth) {
+  *out_earth = nullptr;
+}
+
+// Config and camera configs.
+
+void ArConfig_create(const ArSession*, ArConfig** out_config) {
+  *out_config = new ArConfig_;
+}
+
+void ArConfig_destroy(ArConfig* config) { delete config; }
+
+void ArConfig_setDepthMode(const ArSession*, ArConfig* config,
+                           ArDepthMode mode) {
+  config->depth_mode = mode;
+}
+
+void ArConfig_setLightEstimationMode(
+    const ArSession*, ArConfig* config,
+    ArLightEstimationMode light_estimation_mode) {
+  config->light_estimation_mode = light_estimation_mode;
+}
+
+void ArConfig_setPlaneFindingMode(const ArSession*, ArConfig* config,
+                                  ArPlaneFindingMode plane_finding_mode) {
+  config->plane_finding_mode = plane_finding_mode;
+}
+
+void ArConfig_setUpdateMode(const ArSession*, ArConfig* config,
+                            ArUpdateMode update_mode) {
+  config->update_mode = update_mode;
+}
+
+void ArConfig_setFocusMode(const ArSession*, ArConfig* config,
+                           ArFocusMode focus_mode) {
+  config->focus_mode = focus_mode;
+}
+
+void ArConfig_getFocusMode(const ArSession*, ArConfig* config,
+                           ArFocusMode* focus_mode) {
+  *focus_mode = config->focus_mode;
+}
+
+void ArConfig_setTextureUpdateMode(const ArSession*, ArConfig* config,
+                                   ArTextureUpdateMode texture_update_mode) {
+  config->texture_update_mode = texture_update_mode;
+}
+
+void ArConfig_setAugmentedFaceMode(const ArSession*, ArConfig*,
+                                   ArAugmentedFaceMode) {}
+void ArConfig_setAugmentedImageDatabase(const ArSession*, ArConfig*,
+                                        const ArAugmentedImageDatabase*) {}
+void ArConfig_setCloudAnchorMode(const ArSession*, ArConfig*,
+                                 ArCloudAnchorMode) {}
+void ArConfig_setGeospatialMode(const ArSession*, ArConfig*,
+                                ArGeospatialMode) {}
+void ArConfig_setImageStabilizationMode(const ArSession*, ArConfig*,
+                                        ArImageStabilizationMode) {}
+void ArConfig_setInstantPlacementMode(const ArSession*, ArConfig*,
+                                      ArInstantPlacementMode) {}
+void ArConfig_setSemanticMode(const ArSession*, ArConfig*, ArSemanticMode) {}
+void ArConfig_setStreetscapeGeometryMode(const ArSession*, ArConfig*,
+                                         ArStreetscapeGeometryMode) {}
+
+void ArCameraConfig_create(const ArSession*,
+                           ArCameraConfig** out_camera_config) {
+  *out_camera_config = new ArCameraConfig_;
+}
+
+void ArCameraConfig_destroy(ArCameraConfig* camera_config) {
+  delete camera_config;
+}
+
+void ArCameraConfig_getImageDimensions(const ArSession*,
+                                       const ArCameraConfig* camera_config,
+                                       int32_t* out_width,
+                                       int32_t* out_height) {
+  *out_width = camera_config->info.image_width;
+  *out_height = camera_config->info.image_height;
+}
+
+void ArCameraConfig_getTextureDimensions(const ArSession*,
+                                         const ArCameraConfig* camera_config,
+                                         int32_t* out_width,
+                                         int32_t* out_height) {
+  *out_width = camera_config->info.texture_width;
+  *out_height = camera_config->info.texture_height;
+}
+
+void ArCameraConfig_getFpsRange(const ArSession*,
+                                const ArCameraConfig* camera_config,
+                                int32_t* out_min_fps, int32_t* out_max_fps) {
+  *out_min_fps = camera_config->info.min_fps;
+  *out_max_fps = camera_config->info.max_fps;
+}
+
+void ArCameraConfigList_create(const ArSession*,
+                               ArCameraConfigList** out_list) {
+  *out_list = new ArCameraConfigList_;
+}
+
+void ArCameraConfigList_destroy(ArCameraConfigList* list) { delete list; }
+
+void ArCameraConfigList_getSize(const ArSession*,
+                                const ArCameraConfigList* list,
+                                int32_t* out_size) {
+  *out_size = static_cast<int32_t>(list->configs.size());
+}
+
+void ArCameraConfigList_getItem(const ArSession*,
+                                const ArCameraConfigList* list, int32_t index,
+                                ArCameraConfig* out_camera_config) {
+  out_camera_config->info = list->configs[index];
+}
+
+void ArCameraConfigFilter_create(const ArSession*,
+                                 ArCameraConfigFilter** out_filter) {
+  *out_filter = new ArCameraConfigFilter_;
+}
+
+void ArCameraConfigFilter_destroy(ArCameraConfigFilter* filter) {
+  delete filter;
+}
+
+void ArCameraConfigFilter_setDepthSensorUsage(const ArSession*,
+                                              ArCameraConfigFilter*,
+                                              uint32_t) {}
+void ArCameraConfigFilter_setFacingDirection(const ArSession*,
+                                             ArCameraConfigFilter*,
+                                             ArCameraConfigFacingDirection) {}
+void ArCameraConfigFilter_setStereoCameraUsage(const ArSession*,
+                                               ArCameraConfigFilter*,
+                                               uint32_t) {}
+void ArCameraConfigFilter_setTargetFps(const ArSession*,
+                                       ArCameraConfigFilter*, uint32_t) {}
+
+// Frame.
+
+void ArFrame_create(const ArSession*, ArFrame** out_frame) {
+  *out_frame = new ArFrame_;
+}
+
+void ArFrame_destroy(ArFrame* frame) { delete frame; }
+
+void ArFrame_getTimestamp(const ArSession*, const ArFrame* frame,
+                          int64_t* out_timestamp_ns) {
+  *out_timestamp_ns = frame->timestamp_ns;
+}
+
+void ArFrame_getDisplayGeometryChanged(const ArSession*, const ArFrame* frame,
+                                       int32_t* out_geometry_changed) {
+  *out_geometry_changed = frame->display_geometry_changed ? 1 : 0;
+}
+
+void ArFrame_getCameraTextureName(const ArSession*, const ArFrame* frame,
+                                  uint32_t* out_texture_id) {
+  *out_texture_id = frame->camera_texture_name;
+}
+
+ArStatus ArFrame_getHardwareBuffer(const ArSession*, const ArFrame*,
+                                   void** out_hardware_buffer) {
+  *out_hardware_buffer = nullptr;
+  return AR_ERROR_NOT_YET_AVAILABLE;
+}
+
+void ArFrame_transformCoordinates2d(const ArSession* session,
+                                    const ArFrame* frame,
+                                    ArCoordinates2dType input_coordinates,
+                                    int32_t number_of_vertices,
+                                    const float* vertices_2d,
+                                    ArCoordinates2dType output_coordinates,
+                                    float* out_vertices_2d) {
+  for (int32_t i = 0; i < number_of_vertices; ++i) {
+    float ndc[2];
+    ToNdc(session, frame, input_coordinates, vertices_2d[2 * i],
+          vertices_2d[2 * i + 1], ndc);
+    FromNdc(session, frame, output_coordinates, ndc, out_vertices_2d + 2 * i);
+  }
+}
+
+void ArFrame_transformCoordinates3d(const ArSession* session,
+                                    const ArFrame* frame,
+                                    ArCoordinates2dType input_coordinates,
+                                    int32_t number_of_vertices,
+                                    const float* vertices_2d,
+                                    ArCoordinates3dType output_coordinates,
+                                    float* out_vertices_3d) {
+  // Without stabilization the 3D coordinates are the 2D ones at depth 1.
+  const ArCoordinates2dType output_2d =
+      output_coordinates == AR_COORDINATES_3D_EIS_TEXTURE_NORMALIZED
+          ? AR_COORDINATES_2D_TEXTURE_NORMALIZED
+          : AR_COORDINATES_2D_OPENGL_NORMALIZED_DEVICE_COORDINATES;
+  for (int32_t i = 0; i < number_of_vertices; ++i) {
+    float ndc[2];
+    ToNdc(session, frame, input_coordinates, vertices_2d[2 * i],
+          vertices_2d[2 * i + 1], ndc);
+    FromNdc(session, frame, output_2d, ndc, out_vertices_3d + 3 * i);
+    out_vertices_3d[3 * i + 2] = 1.f;
+  }
+}
+
+void ArFrame_acquireCamera(const ArSession*, const ArFrame* frame,
+                           ArCamera** out_camera) {
+  *out_camera = const_cast<ArCamera_*>(&frame->camera);
+}
+
+void ArFrame_getAndroidSensorPose(const ArSession*, const ArFrame* frame,
+                                  ArPose* out_pose) {
+  memcpy(out_pose->raw, frame->camera.record.android_sensor_pose,
+         sizeof(out_pose->raw));
+}
+
+void ArFrame_getUpdatedTrackables(const ArSession*, const ArFrame* frame,
+                                  ArTrackableType filter_type,
+                                  ArTrackableList* out_trackable_list) {
+  out_trackable_list->items.clear();
+  if (filter_type == AR_TRACKABLE_PLANE ||
+      filter_type == AR_TRACKABLE_BASE_TRACKABLE) {
+    out_trackable_list->items = frame->updated_planes;
+  }
+}
+
+void ArFrame_getLightEstimate(const ArSession* session, const ArFrame* frame,
+                              ArLightEstimate* out_light_estimate) {
+  out_light_estimate->record = frame->light_estimate;
+  out_light_estimate->enabled =
+      session->config.light_estimation_mode !=
+      AR_LIGHT_ESTIMATION_MODE_DISABLED;
+}
+
+ArStatus ArFrame_acquirePointCloud(const ArSession* session, const ArFrame*,
+                                   ArPointCloud** out_point_cloud) {
+  if (session->camera.record.tracking_state != AR_TRACKING_STATE_TRACKING) {
+    return AR_ERROR_NOT_TRACKING;
+  }
+  *out_point_cloud = const_cast<ArPointCloud_*>(&session->point_cloud);
+  return AR_SUCCESS;
+}
+
+ArStatus ArFrame_acquireCameraImage(ArSession* session, ArFrame*,
+                                    ArImage** out_image) {
+  if (session->info.image_width <= 0 || session->info.image_height <= 0) {
+    return AR_ERROR_NOT_YET_AVAILABLE;
+  }
+  ArImage_* image = new ArImage_;
+  session->GetCameraImage(image);
+  *out_image = image;
+  return AR_SUCCESS;
+}
+
+ArStatus ArFrame_acquireDepthImage16Bits(const ArSession* session,
+                                         const ArFrame*,
+                                         ArImage** out_depth_image) {
+  if (session->config.depth_mode == AR_DEPTH_MODE_DISABLED) {
+    return AR_ERROR_ILLEGAL_STATE;
+  }
+  ArImage_* image = new ArImage_;
+  if (!session->GetDepthImage(image)) {
+    delete image;
+    return AR_ERROR_NOT_YET_AVAILABLE;
+  }
+  *out_depth_image = image;
+  return AR_SUCCESS;
+}
+
+ArStatus ArFrame_acquireRawDepthImage16Bits(const ArSession* session,
+                                            const ArFrame* frame,
+                                            ArImage** out_depth_image) {
+  return ArFrame_acquireDepthImage16Bits(session, frame, out_depth_image);
+}
+
+ArStatus ArFrame_acquireRawDepthConfidenceImage(
+    const ArSession* session, const ArFrame*, ArImage** out_confidence_image) {
+  if (session->config.depth_mode == AR_DEPTH_MODE_DISABLED) {
+    return AR_ERROR_ILLEGAL_STATE;
+  }
+  if (session->depth_timestamp_ns < 0) {
+    return AR_ERROR_NOT_YET_AVAILABLE;
+  }
+  // Captures hold the smoothed depth only, which is fully confident.
+  ArImage_* image = new ArImage_;
+  image->format = AR_IMAGE_FORMAT_Y8;
+  image->width = session->depth_width;
+  image->height = session->depth_height;
+  image->timestamp_ns = session->depth_timestamp_ns;
+  image->plane_count = 1;
+  image->planes[0].assign(session->depth.size(), 255);
+  image->row_strides[0] = session->depth_width;
+  image->pixel_strides[0] = 1;
+  *out_confidence_image = image;
+  return AR_SUCCESS;
+}
+
+ArStatus ArFrame_acquireSemanticImage(const ArSession*, const ArFrame*,
+                                      ArImage**) {
+  return AR_ERROR_NOT_YET_AVAILABLE;
+}
+
+ArStatus ArFrame_acquireSemanticConfidenceImage(const ArSession*,
+                                                const ArFrame*, ArImage**) {
+  return AR_ERROR_NOT_YET_AVAILABLE;
+}
+
+ArStatus ArFrame_getSemanticLabelFraction(const ArSession*, const ArFrame*,
+                                          ArSemanticLabel,
+                                          float* out_fraction) {
+  *out_fraction = 0.f;
+  return AR_ERROR_NOT_YET_AVAILABLE;
+}
+
+ArStatus ArFrame_acquireImageMetadata(const ArSession*, const ArFrame*,
+                                      ArImageMetadata** out_metadata) {
+  *out_metadata = nullptr;
+  return AR_ERROR_NOT_YET_AVAILABLE;
+}
+
+void ArFrame_getUpdatedTrackData(const ArSession*, const ArFrame*,
+                                 const uint8_t*, ArTrackDataList*) {}
+
+ArStatus ArFrame_recordTrackData(ArSession*, const ArFrame*, const uint8_t*,
+                                 const void*, size_t) {
+  return AR_ERROR_ILLEGAL_STATE;
+}
+
+void ArFrame_hitTestRay(const ArSession* session, const ArFrame*,
+                        const float* ray_origin_3,
+                        const float* ray_direction_3,
+                        ArHitResultList* hit_result_list) {
+  session->HitTestRay(ray_origin_3, ray_direction_3, hit_result_list);
+}
+
+void ArFrame_hitTest(const ArSession* session, const ArFrame* frame,
+                     float pixel_x, float pixel_y,
+                     ArHitResultList* hit_result_list) {
+  hit_result_list->hits.clear();
+  const capture::CameraRecord& camera = frame->camera.record;
+  float view[16], inverse_pose[7], view_projection[16], inverse[16];
+  arcore_replay::InvertPose(camera.pose, inverse_pose);
+  arcore_replay::PoseToMatrix(inverse_pose, view);
+  for (int column = 0; column < 4; ++column) {
+    MultiplyPoint(camera.projection, view + 4 * column,
+                  view_projection + 4 * column);
+  }
+  if (!InvertMatrix(view_projection, inverse)) {
+    return;
+  }
+  float ndc[2];
+  ToNdc(session, frame, AR_COORDINATES_2D_VIEW, pixel_x, pixel_y, ndc);
+  const float near_point[4] = {ndc[0], ndc[1], -1.f, 1.f};
+  const float far_point[4] = {ndc[0], ndc[1], 1.f, 1.f};
+  float near_world[4], far_world[4];
+  MultiplyPoint(inverse, near_point, near_world);
+  MultiplyPoint(inverse, far_point, far_world);
+  const float origin[3] = {near_world[0] / near_world[3],
+                           near_world[1] / near_world[3],
+                           near_world[2] / near_world[3]};
+  const float direction[3] = {far_world[0] / far_world[3] - origin[0],
+                              far_world[1] / far_world[3] - origin[1],
+                              far_world[2] / far_world[3] - origin[2]};
+  session->HitTestRay(origin, direction, hit_result_list);
+}
+
+void ArFrame_hitTestInstantPlacement(const ArSession*, const ArFrame*, float,
+                                     float, float,
+                                     ArHitResultList* hit_result_list) {
+  hit_result_list->hits.clear();
+}
+
+// Camera.
+
+void ArCamera_release(ArCamera*) {}
+
+void ArCamera_getPose(const ArSession*, const ArCamera* camera,
+                      ArPose* out_pose) {
+  memcpy(out_pose->raw, camera->record.pose, sizeof(out_pose->raw));
+}
+
+void ArCamera_getTrackingState(const ArSession*, const ArCamera* camera,
+                               ArTrackingState* out_tracking_state) {
+  *out_tracking_state =
+      static_cast<ArTrackingState>(camera->record.tracking_state);
+}
+
+void ArCamera_getViewMatrix(const ArSession*, const ArCamera* camera,
+                            float* out_col_major_4x4) {
+  float inverse_pose[7];
+  arcore_replay::InvertPose(camera->record.pose, inverse_pose);
+  arcore_replay::PoseToMatrix(inverse_pose, out_col_major_4x4);
+}
+
+void ArCamera_getProjectionMatrix(const ArSession*, const ArCamera* camera,
+                                  float near, float far,
+                                  float* dest_col_major_4x4) {
+  GetProjection(camera, near, far, dest_col_major_4x4);
+}
+
+void ArCamera_getImageIntrinsics(const ArSession*, const ArCamera* camera,
+                                 ArCameraIntrinsics* out_camera_intrinsics) {
+  out_camera_intrinsics->values = camera->record.image_intrinsics;
+}
+
+void ArCamera_getTextureIntrinsics(const ArSession*, const ArCamera* camera,
+                                   ArCameraIntrinsics* out_camera_intrinsics) {
+  out_camera_intrinsics->values = camera->record.texture_intrinsics;
+}
+
+void ArCameraIntrinsics_create(const ArSession*,
+                               ArCameraIntrinsics** out_camera_intrinsics) {
+  *out_camera_intrinsics = new ArCameraIntrinsics_;
+}
+
+void ArCameraIntrinsics_destroy(ArCameraIntrinsics* camera_intrinsics) {
+  delete camera_intrinsics;
+}
+
+void ArCameraIntrinsics_getFocalLength(const ArSession*,
+                                       const ArCameraIntrinsics* intrinsics,
+                                       float* out_fx, float* out_fy) {
+  *out_fx = intrinsics->values.fx;
+  *out_fy = intrinsics->values.fy;
+}
+
+void ArCameraIntrinsics_getPrincipalPoint(
+    const ArSession*, const ArCameraIntrinsics* intrinsics, float* out_cx,
+    float* out_cy) {
+  *out_cx = intrinsics->values.cx;
+  *out_cy = intrinsics->values.cy;
+}
+
+void ArCameraIntrinsics_getImageDimensions(
+    const ArSession*, const ArCameraIntrinsics* intrinsics,
+    int32_t* out_width, int32_t* out_height) {
+  *out_width = intrinsics->values.width;
+  *out_height = intrinsics->values.height;
+}
+
+// Poses.
+
+void ArPose_create(const ArSession*, const float* pose_raw,
+                   ArPose** out_pose) {
+  ArPose_* pose = new ArPose_;
+  if (pose_raw != nullptr) {
+    memcpy(pose->raw, pose_raw, sizeof(pose->raw));
+  }
+  *out_pose = pose;
+}
+
+void ArPose_destroy(ArPose* pose) { delete pose; }
+
+void ArPose_getPoseRaw(const ArSession*, const ArPose* pose,
+                       float* out_pose_raw_7) {
+  memcpy(out_pose_raw_7, pose->raw, sizeof(pose->raw));
+}
+
+void ArPose_getMatrix(const ArSession*, const ArPose* pose,
+                      float* out_matrix_col_major_4x4) {
+  arcore_replay::PoseToMatrix(pose->raw, out_matrix_col_major_4x4);
+}
+
+// Trackables and planes.
+
+void ArTrackableList_create(const ArSession*,
+                            ArTrackableList** out_trackable_list) {
+  *out_trackable_list = new ArTrackableList_;
+}
+
+void ArTrackableList_destroy(ArTrackableList* trackable_list) {
+  delete trackable_list;
+}
+
+void ArTrackableList_getSize(const ArSession*,
+                             const ArTrackableList* trackable_list,
+                             int32_t* out_size) {
+  *out_size = static_cast<int32_t>(trackable_list->items.size());
+}
+
+void ArTrackableList_acquireItem(const ArSession*,
+                                 const ArTrackableList* trackable_list,
+                                 int32_t index, ArTrackable** out_trackable) {
+  *out_trackable = trackable_list->items[index];
+}
+
+void ArTrackable_release(ArTrackable*) {}
+
+void ArTrackable_getType(const ArSession*, const ArTrackable* trackable,
+                         ArTrackableType* out_trackable_type) {
+  *out_trackable_type = trackable->type;
+}
+
+void ArTrackable_getTrackingState(const ArSession*,
+                                  const ArTrackable* trackable,
+                                  ArTrackingState* out_tracking_state) {
+  *out_tracking_state =
+      static_cast<ArTrackingState>(trackable->record.tracking_state);
+}
+
+ArStatus ArTrackable_acquireNewAnchor(ArSession* session,
+                                      ArTrackable* trackable, ArPose* pose,
+                                      ArAnchor** out_anchor) {
+  if (trackable->record.tracking_state != AR_TRACKING_STATE_TRACKING) {
+    return AR_ERROR_NOT_TRACKING;
+  }
+  *out_anchor = CreatePlaneAnchor(session, trackable, pose->raw);
+  return AR_SUCCESS;
+}
+
+void ArPlane_getType(const ArSession*, const ArPlane* plane,
+                     ArPlaneType* out_plane_type) {
+  *out_plane_type = static_cast<ArPlaneType>(
+      reinterpret_cast<const ArTrackable_*>(plane)->record.type);
+}
+
+void ArPlane_getCenterPose(const ArSession*, const ArPlane* plane,
+                           ArPose* out_pose) {
+  memcpy(out_pose->raw,
+         reinterpret_cast<const ArTrackable_*>(plane)->record.center_pose,
+         sizeof(out_pose->raw));
+}
+
+void ArPlane_getExtentX(const ArSession*, const ArPlane* plane,
+                        float* out_extent_x) {
+  *out_extent_x = reinterpret_cast<const ArTrackable_*>(plane)->record.extent_x;
+}
+
+void ArPlane_getExtentZ(const ArSession*, const ArPlane* plane,
+                        float* out_extent_z) {
+  *out_extent_z = reinterpret_cast<const ArTrackable_*>(plane)->record.extent_z;
+}
+
+void ArPlane_getPolygonSize(const ArSession*, const ArPlane* plane,
+                            int32_t* out_polygon_size) {
+  *out_polygon_size = static_cast<int32_t>(
+      reinterpret_cast<const ArTrackable_*>(plane)->polygon.size());
+}
+
+void ArPlane_getPolygon(const ArSession*, const ArPlane* plane,
+                        float* out_polygon_xz) {
+  const std::vector<float>& polygon =
+      reinterpret_cast<const ArTrackable_*>(plane)->polygon;
+  memcpy(out_polygon_xz, polygon.data(), polygon.size() * sizeof(float));
+}
+
+void ArPlane_acquireSubsumedBy(const ArSession* session, const ArPlane* plane,
+                               ArPlane** out_subsumed_by) {
+  const int32_t id =
+      reinterpret_cast<const ArTrackable_*>(plane)->record.subsumed_by;
+  *out_subsumed_by =
+      id >= 0 && id < static_cast<int32_t>(session->planes.size())
+          ? reinterpret_cast<ArPlane*>(session->planes[id].get())
+          : nullptr;
+}
+
+void ArPlane_isPoseInPolygon(const ArSession*, const ArPlane* plane,
+                             const ArPose* pose, int32_t* out_pose_in_polygon) {
+  const ArTrackable_* trackable = reinterpret_cast<const ArTrackable_*>(plane);
+  float inverse_center[7], local[3];
+  arcore_replay::InvertPose(trackable->record.center_pose, inverse_center);
+  arcore_replay::TransformPoint(inverse_center, pose->raw + 4, local);
+  *out_pose_in_polygon =
+      arcore_replay::IsInPolygon(
+          trackable->polygon.data(),
+          static_cast<int>(trackable->record.vertex_count), local[0],
+          local[2])
+          ? 1
+          : 0;
+}
+
+void ArPoint_getOrientationMode(const ArSession*, const ArPoint*,
+                                ArPointOrientationMode* out_orientation_mode) {
+  *out_orientation_mode = AR_POINT_ORIENTATION_INITIALIZED_TO_IDENTITY;
+}
+
+void ArInstantPlacementPoint_getTrackingMethod(
+    const ArSession*, const ArInstantPlacementPoint*,
+    ArInstantPlacementPointTrackingMethod* out_tracking_method) {
+  *out_tracking_method =
+      AR_INSTANT_PLACEMENT_POINT_TRACKING_METHOD_NOT_TRACKING;
+}
+
+// Anchors.
+
+void ArAnchor_release(ArAnchor*) {}
+
+void ArAnchor_getPose(const ArSession*, const ArAnchor* anchor,
+                      ArPose* out_pose) {
+  memcpy(out_pose->raw, anchor->pose, sizeof(out_pose->raw));
+}
+
+void ArAnchor_getTrackingState(const ArSession*, const ArAnchor* anchor,
+                               ArTrackingState* out_tracking_state) {
+  *out_tracking_state = anchor->tracking_state;
+}
+
+// Hit results.
+
+void ArHitResultList_create(const ArSession*,
+                            ArHitResultList** out_hit_result_list) {
+  *out_hit_result_list = new ArHitResultList_;
+}
+
+void ArHitResultList_destroy(ArHitResultList* hit_result_list) {
+  delete hit_result_list;
+}
+
+void ArHitResultList_getSize(const ArSession*,
+                             const ArHitResultList* hit_result_list,
+                             int32_t* out_size) {
+  *out_size = static_cast<int32_t>(hit_result_list->hits.size());
+}
+
+void ArHitResultList_getItem(const ArSession*,
+                             const ArHitResultList* hit_result_list,
+                             int32_t index, ArHitResult* out_hit_result) {
+  *out_hit_result = hit_result_list->hits[index];
+}
+
+void ArHitResult_create(const ArSession*, ArHitResult** out_hit_result) {
+  *out_hit_result = new ArHitResult_;
+}
+
+void ArHitResult_destroy(ArHitResult* hit_result) { delete hit_result; }
+
+void ArHitResult_getHitPose(const ArSession*, const ArHitResult* hit_result,
+                            ArPose* out_pose) {
+  memcpy(out_pose->raw, hit_result->pose, sizeof(out_pose->raw));
+}
+
+void ArHitResult_acquireTrackable(const ArSession*,
+                                  const ArHitResult* hit_result,
+                                  ArTrackable** out_trackable) {
+  *out_trackable = hit_result->trackable;
+}
+
+ArStatus ArHitResult_acquireNewAnchor(ArSession* session,
+                                      ArHitResult* hit_result,
+                                      ArAnchor** out_anchor) {
+  if (hit_result->trackable == nullptr) {
+    return AR_ERROR_INVALID_ARGUMENT;
+  }
+  *out_anchor =
+      CreatePlaneAnchor(session, hit_result->trackable, hit_result->pose);
+  return AR_SUCCESS;
+}
+
+// Point cloud.
+
+void ArPointCloud_release(ArPointCloud*) {}
+
+void ArPointCloud_getNumberOfPoints(const ArSession*,
+                                    const ArPointCloud* point_cloud,
+                                    int32_t* out_number_of_points) {
+  *out_number_of_points = static_cast<int32_t>(point_cloud->ids.size());
+}
+
+void ArPointCloud_getData(const ArSession*, const ArPointCloud* point_cloud,
+                          const float** out_point_cloud_data) {
+  *out_point_cloud_data = point_cloud->points.data();
+}
+
+void ArPointCloud_getPointIds(const ArSession*,
+                              const ArPointCloud* point_cloud,
+                              const int32_t** out_point_ids) {
+  *out_point_ids = point_cloud->ids.data();
+}
+
+void ArPointCloud_getTimestamp(const ArSession*,
+                               const ArPointCloud* point_cloud,
+                               int64_t* out_timestamp_ns) {
+  *out_timestamp_ns = point_cloud->timestamp_ns;
+}
+
+// Light estimate.
+
+void ArLightEstimate_create(const ArSession*,
+                            ArLightEstimate** out_light_estimate) {
+  *out_light_estimate = new ArLightEstimate_;
+}
+
+void ArLightEstimate_destroy(ArLightEstimate* light_estimate) {
+  delete light_estimate;
+}
+
+void ArLightEstimate_getState(const ArSession*,
+                              const ArLightEstimate* light_estimate,
+                              ArLightEstimateState* out_light_estimate_state) {
+  *out_light_estimate_state =
+      light_estimate->enabled
+          ? static_cast<ArLightEstimateState>(light_estimate->record.state)
+          : AR_LIGHT_ESTIMATE_STATE_NOT_VALID;
+}
+
+void ArLightEstimate_getTimestamp(const ArSession*,
+                                  const ArLightEstimate* light_estimate,
+                                  int64_t* out_timestamp_ns) {
+  *out_timestamp_ns = light_estimate->record.timestamp_ns;
+}
+
+void ArLightEstimate_getColorCorrection(const ArSession*,
+                                        const ArLightEstimate* light_estimate,
+                                        float* out_color_correction_4) {
+  memcpy(out_color_correction_4, light_estimate->record.color_correction,
+         sizeof(light_estimate->record.color_correction));
+}
+
+void ArLightEstimate_getEnvironmentalHdrAmbientSphericalHarmonics(
+    const ArSession*, const ArLightEstimate* light_estimate,
+    float* out_coefficients_27) {
+  memcpy(out_coefficients_27, light_estimate->record.spherical_harmonics,
+         sizeof(light_estimate->record.spherical_harmonics));
+}
+
+void ArLightEstimate_acquireEnvironmentalHdrCubemap(
+    const ArSession*, const ArLightEstimate*, ArImageCubemap out_textures_6) {
+  // Captures hold no cubemaps, the lighting falls back to the harmonics.
+  for (int i = 0; i < 6; ++i) {
+    out_textures_6[i] = nullptr;
+  }
+}
+
+// Images.
+
+void ArImage_release(ArImage* image) { delete image; }
+
+void ArImage_getWidth(const ArSession*, const ArImage* image,
+                      int32_t* out_width) {
+  *out_width = image->width;
+}
+
+void ArImage_getHeight(const ArSession*, const ArImage* image,
+                       int32_t* out_height) {
+  *out_height = image->height;
+}
+
+void ArImage_getFormat(const ArSession*, const ArImage* image,
+                       ArImageFormat* out_format) {
+  *out_format = image->format;
+}
+
+void ArImage_getTimestamp(const ArSession*, const ArImage* image,
+                          int64_t* out_timestamp_ns) {
+  *out_timestamp_ns = image->timestamp_ns;
+}
+
+void ArImage_getNumberOfPlanes(const ArSession*, const ArImage* image,
+                               int32_t* out_num_planes) {
+  *out_num_planes = image->plane_count;
+}
+
+void ArImage_getPlaneData(const ArSession*, const ArImage* image,
+                          int32_t plane_index, const uint8_t** out_data,
+                          int32_t* out_data_length) {
+  *out_data = image->planes[plane_index].data();
+  *out_data_length = static_cast<int32_t>(image->planes[plane_index].size());
+}
+
+void ArImage_getPlanePixelStride(const ArSession*, const ArImage* image,
+                                 int32_t plane_index,
+                                 int32_t* out_pixel_stride) {
+  *out_pixel_stride = image->pixel_strides[plane_index];
+}
+
+void ArImage_getPlaneRowStride(const ArSession*, const ArImage* image,
+                               int32_t plane_index, int32_t* out_row_stride) {
+  *out_row_stride = image->row_strides[plane_index];
+}
+
+void ArImageMetadata_release(ArImageMetadata*) {}
+
+void ArImageMetadata_getAllKeys(const ArSession*, const ArImageMetadata*,
+                                int32_t* out_number_of_tags,
+                                const uint32_t** out_tags) {
+  *out_number_of_tags = 0;
+  *out_tags = nullptr;
+}
+
+ArStatus ArImageMetadata_getConstEntry(const ArSession*,
+                                       const ArImageMetadata*, uint32_t,
+                                       ArImageMetadata_const_entry*) {
+  return AR_ERROR_METADATA_NOT_FOUND;
+}
+
+// Custom tracks and recording, which the replay does not record.
+
+void ArTrackDataList_create(const ArSession*,
+                            ArTrackDataList** out_track_data_list) {
+  *out_track_data_list = new ArTrackDataList_;
+}
+
+void ArTrackDataList_destroy(ArTrackDataList* track_data_list) {
+  delete track_data_list;
+}
+
+void ArTrackDataList_getSize(const ArSession*, const ArTrackDataList*,
+                             int32_t* out_size) {
+  *out_size = 0;
+}
+
+void ArTrackDataList_acquireItem(const ArSession*, const ArTrackDataList*,
+                                 int32_t, ArTrackData** out_track_data) {
+  *out_track_data = nullptr;
+}
+
+void ArTrackData_getData(const ArSession*, const ArTrackData*,
+                         const uint8_t** out_data, int32_t* out_size) {
+  *out_data = nullptr;
+  *out_size = 0;
+}
+
+void ArTrackData_getFrameTimestamp(const ArSession*, const ArTrackData*,
+                                   int64_t* out_timestamp_ns) {
+  *out_timestamp_ns = 0;
+}
+
+void ArTrackData_release(ArTrackData*) {}
+
+void ArTrack_create(const ArSession*, ArTrack** out_track) {
+  *out_track = new ArTrack_;
+}
+
+void ArTrack_destroy(ArTrack* track) { delete track; }
+
+void ArTrack_setId(const ArSession*, ArTrack*, const uint8_t*) {}
+void ArTrack_setMetadata(const ArSession*, ArTrack*, const uint8_t*, size_t) {
+}
+void ArTrack_setMimeType(const ArSession*, ArTrack*, const char*) {}
+
+void ArRecordingConfig_create(const ArSession*,
+                              ArRecordingConfig** out_config) {
+  *out_config = new ArRecordingConfig_;
+}
+
+void ArRecordingConfig_destroy(ArRecordingConfig* config) { delete config; }
+
+void ArRecordingConfig_addTrack(const ArSession*, ArRecordingConfig*,
+                                const ArTrack*) {}
+void ArRecordingConfig_setAutoStopOnPause(const ArSession*,
+                                          ArRecordingConfig*, int32_t) {}
+void ArRecordingConfig_setMp4DatasetUri(const ArSession*, ArRecordingConfig*,
+                                        const char*) {}
+
+// Features the replay does not support.  Their objects are never created, so
+// the getters are never reached with a valid object.
+
+void ArAugmentedImageDatabase_create(
+    const ArSession*, ArAugmentedImageDatabase** out_augmented_image_database) {
+  *out_augmented_image_database = new ArAugmentedImageDatabase_;
+}
+
+void ArAugmentedImageDatabase_destroy(
+    ArAugmentedImageDatabase* augmented_image_database) {
+  delete augmented_image_database;
+}
+
+ArStatus ArAugmentedImageDatabase_deserialize(
+    const ArSession*, const uint8_t*, int64_t,
+    ArAugmentedImageDatabase** out_augmented_image_database) {
+  *out_augmented_image_database = new ArAugmentedImageDatabase_;
+  return AR_SUCCESS;
+}
+
+void ArAugmentedImageDatabase_serialize(
+    const ArSession*, const ArAugmentedImageDatabase*,
+    uint8_t** out_image_database_raw_bytes,
+    int64_t* out_image_database_raw_bytes_size) {
+  *out_image_database_raw_bytes = nullptr;
+  *out_image_database_raw_bytes_size = 0;
+}
+
+ArStatus ArAugmentedImageDatabase_addImage(const ArSession*,
+                                           ArAugmentedImageDatabase*,
+                                           const char*, const uint8_t*,
+                                           int32_t, int32_t, int32_t,
+                                           int32_t* out_index) {
+  *out_index = -1;
+  return AR_ERROR_IMAGE_INSUFFICIENT_QUALITY;
+}
+
+ArStatus ArAugmentedImageDatabase_addImageWithPhysicalSize(
+    const ArSession*, ArAugmentedImageDatabase*, const char*, const uint8_t*,
+    int32_t, int32_t, int32_t, float, int32_t* out_index) {
+  *out_index = -1;
+  return AR_ERROR_IMAGE_INSUFFICIENT_QUALITY;
+}
+
+void ArAugmentedImageDatabase_getNumImages(const ArSession*,
+                                           const ArAugmentedImageDatabase*,
+                                           int32_t* out_number_of_images) {
+  *out_number_of_images = 0;
+}
+
+void ArAugmentedImage_getCenterPose(const ArSession*, const ArAugmentedImage*,
+                                    ArPose*) {}
+void ArAugmentedImage_getExtentX(const ArSession*, const ArAugmentedImage*,
+                                 float* out_extent_x) {
+  *out_extent_x = 0.f;
+}
+void ArAugmentedImage_getExtentZ(const ArSession*, const ArAugmentedImage*,
+                                 float* out_extent_z) {
+  *out_extent_z = 0.f;
+}
+void ArAugmentedImage_getIndex(const ArSession*, const ArAugmentedImage*,
+                               int32_t* out_index) {
+  *out_index = -1;
+}
+
+void ArAugmentedFace_getCenterPose(const ArSession*, const ArAugmentedFace*,
+                                   ArPose*) {}
+void ArAugmentedFace_getMeshVertices(const ArSession*, const ArAugmentedFace*,
+                                     const float** out_vertices,
+                                     int32_t* out_number_of_vertices) {
+  *out_vertices = nullptr;
+  *out_number_of_vertices = 0;
+}
+void ArAugmentedFace_getMeshNormals(const ArSession*, const ArAugmentedFace*,
+                                    const float** out_normals,
+                                    int32_t* out_number_of_normals) {
+  *out_normals = nullptr;
+  *out_number_of_normals = 0;
+}
+void ArAugmentedFace_getMeshTextureCoordinates(
+    const ArSession*, const ArAugmentedFace*,
+    const float** out_texture_coordinates,
+    int32_t* out_number_of_texture_coordinates) {
+  *out_texture_coordinates = nullptr;
+  *out_number_of_texture_coordinates = 0;
+}
+void ArAugmentedFace_getMeshTriangleIndices(
+    const ArSession*, const ArAugmentedFace*,
+    const uint16_t** out_triangle_indices, int32_t* out_number_of_triangles) {
+  *out_triangle_indices = nullptr;
+  *out_number_of_triangles = 0;
+}
+
+void ArEarth_getCameraGeospatialPose(const ArSession*, const ArEarth*,
+                                     ArGeospatialPose*) {}
+
+ArStatus ArEarth_resolveAnchorOnTerrainAsync(
+    ArSession*, ArEarth*, double, double, double, const float*, void*,
+    ArResolveAnchorOnTerrainCallback,
+    ArResolveAnchorOnTerrainFuture** out_future) {
+  if (out_future != nullptr) {
+    *out_future = nullptr;
+  }
+  return AR_ERROR_UNSUPPORTED_CONFIGURATION;
+}
+
+ArStatus ArEarth_resolveAnchorOnRooftopAsync(
+    ArSession*, ArEarth*, double, double, double, const float*, void*,
+    ArResolveAnchorOnRooftopCallback,
+    ArResolveAnchorOnRooftopFuture** out_future) {
+  if (out_future != nullptr) {
+    *out_future = nullptr;
+  }
+  return AR_ERROR_UNSUPPORTED_CONFIGURATION;
+}
+
+void ArGeospatialPose_create(const ArSession*, ArGeospatialPose** out_pose) {
+  *out_pose = new ArGeospatialPose_;
+}
+
+void ArGeospatialPose_destroy(ArGeospatialPose* pose) { delete pose; }
+
+void ArGeospatialPose_getLatitudeLongitude(const ArSession*,
+                                           const ArGeospatialPose*,
+                                           double* out_latitude_degrees,
+                                           double* out_longitude_degrees) {
+  *out_latitude_degrees = 0.0;
+  *out_longitude_degrees = 0.0;
+}
+
+void ArStreetscapeGeometry_acquireMesh(const ArSession*,
+                                       const ArStreetscapeGeometry*,
+                                       ArMesh** out_mesh) {
+  *out_mesh = nullptr;
+}
+void ArStreetscapeGeometry_getMeshPose(const ArSession*,
+                                       const ArStreetscapeGeometry*, ArPose*) {
+}
+void ArStreetscapeGeometry_getType(const ArSession*,
+                                   const ArStreetscapeGeometry*,
+                                   ArStreetscapeGeometryType* out_type) {
+  *out_type = AR_STREETSCAPE_GEOMETRY_TYPE_TERRAIN;
+}
+
+void ArMesh_release(ArMesh*) {}
+void ArMesh_getIndexListSize(const ArSession*, const ArMesh*,
+                             int32_t* out_num_indices) {
+  *out_num_indices = 0;
+}
+void ArMesh_getIndexList(const ArSession*, const ArMesh*,
+                         const uint32_t** out_indices) {
+  *out_indices = nullptr;
+}
+void ArMesh_getVertexListSize(const ArSession*, const ArMesh*,
+                              int32_t* out_num_vertices) {
+  *out_num_vertices = 0;
+}
+void ArMesh_getVertexList(const ArSession*, const ArMesh*,
+                          const float** out_vertex_positions_xyz) {
+  *out_vertex_positions_xyz = nullptr;
+}
+
+void ArFuture_getState(const ArSession*, const ArFuture*,
+                       ArFutureState* out_state) {
+  *out_state = AR_FUTURE_STATE_CANCELLED;
+}
+void ArFuture_cancel(const ArSession*, ArFuture*, int32_t* out_was_cancelled) {
+  if (out_was_cancelled != nullptr) {
+    *out_was_cancelled = 0;
+  }
+}
+void ArFuture_release(ArFuture*) {}
+
+void ArHostCloudAnchorFuture_getResultCloudAnchorState(
+    const ArSession*, const ArHostCloudAnchorFuture*,
+    ArCloudAnchorState* out_cloud_anchor_state) {
+  *out_cloud_anchor_state = AR_CLOUD_ANCHOR_STATE_ERROR_INTERNAL;
+}
+void ArHostCloudAnchorFuture_acquireResultCloudAnchorId(
+    const ArSession*, const ArHostCloudAnchorFuture*,
+    char** out_cloud_anchor_id) {
+  *out_cloud_anchor_id = nullptr;
+}
+void ArResolveCloudAnchorFuture_getResultCloudAnchorState(
+    const ArSession*, const ArResolveCloudAnchorFuture*,
+    ArCloudAnchorState* out_cloud_anchor_state) {
+  *out_cloud_anchor_state = AR_CLOUD_ANCHOR_STATE_ERROR_INTERNAL;
+}
+void ArResolveCloudAnchorFuture_acquireResultAnchor(
+    const ArSession*, const ArResolveCloudAnchorFuture*,
+    ArAnchor** out_anchor) {
+  *out_anchor = nullptr;
+}
+void ArResolveAnchorOnTerrainFuture_getResultTerrainAnchorState(
+    const ArSession*, const ArResolveAnchorOnTerrainFuture*,
+    ArTerrainAnchorState* out_terrain_anchor_state) {
+  *out_terrain_anchor_state =
+      AR_TERRAIN_ANCHOR_STATE_ERROR_UNSUPPORTED_LOCATION;
+}
+void ArResolveAnchorOnTerrainFuture_acquireResultAnchor(
+    const ArSession*, const ArResolveAnchorOnTerrainFuture*,
+    ArAnchor** out_anchor) {
+  *out_anchor = nullptr;
+}
+void ArResolveAnchorOnRooftopFuture_getResultRooftopAnchorState(
+    const ArSession*, const ArResolveAnchorOnRooftopFuture*,
+    ArRooftopAnchorState* out_rooftop_anchor_state) {
+  *out_rooftop_anchor_state =
+      AR_ROOFTOP_ANCHOR_STATE_ERROR_UNSUPPORTED_LOCATION;
+}
+void ArResolveAnchorOnRooftopFuture_acquireResultAnchor(
+    const ArSession*, const ArResolveAnchorOnRooftopFuture*,
+    ArAnchor** out_anchor) {
+  *out_anchor = nullptr;
+}
+void ArVpsAvailabilityFuture_getResult(
+    const ArSession*, const ArVpsAvailabilityFuture*,
+    ArVpsAvailability* out_result_availability) {
+  *out_result_availability = AR_VPS_AVAILABILITY_UNKNOWN;
+}
+
+void ArString_release(char* str) { free(str); }
+void ArByteArray_release(uint8_t* byte_array) { free(byte_array); }
+
+}  // extern "C"
@@ -0,0 +1,119 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "capture_reader.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+
+namespace arcore_replay {
+
+namespace capture = hello_ar::capture;
+
+CaptureReader::~CaptureReader() { Close(); }
+
+bool CaptureReader::Open(const std::string& path) {
+  Close();
+  const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    fprintf(stderr, "arcore_replay: Cannot open %s\n", path.c_str());
+    return false;
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 ||
+      file_stat.st_size < static_cast<off_t>(sizeof(capture::FileHeader))) {
+    fprintf(stderr, "arcore_replay: %s is not a capture\n", path.c_str());
+    close(fd);
+    return false;
+  }
+  void* mapping = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd,
+                       /*offset=*/0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    fprintf(stderr, "arcore_replay: Cannot map %s\n", path.c_str());
+    return false;
+  }
+  data_ = static_cast<const uint8_t*>(mapping);
+  size_ = static_cast<size_t>(file_stat.st_size);
+
+  capture::FileHeader header;
+  memcpy(&header, data_, sizeof(header));
+  if (memcmp(header.magic, capture::kMagic, sizeof(header.magic)) != 0 ||
+      header.version != capture::kVersion) {
+    fprintf(stderr, "arcore_replay: %s is not a version %u capture\n",
+            path.c_str(), capture::kVersion);
+    Close();
+    return false;
+  }
+
+  // Replay reads the frames in order, but indexing them up front keeps the
+  // cost of a frame independent of where it is in the file.
+  first_record_ = sizeof(header);
+  size_t offset = first_record_;
+  while (offset + sizeof(capture::RecordHeader) <= size_) {
+    capture::RecordHeader record;
+    memcpy(&record, data_ + offset, sizeof(record));
+    const size_t next = offset + sizeof(record) + record.size;
+    if (next > size_) {
+      break;
+    }
+    if (record.type == capture::kFrame) {
+      frames_.push_back(offset);
+    }
+    offset = next;
+  }
+  end_ = offset;
+  madvise(mapping, size_, MADV_SEQUENTIAL);
+  return true;
+}
+
+void CaptureReader::Close() {
+  if (data_ != nullptr) {
+    munmap(const_cast<uint8_t*>(data_), size_);
+  }
+  data_ = nullptr;
+  size_ = 0;
+  frames_.clear();
+  end_ = 0;
+}
+
+void CaptureReader::GetFrameRecords(int index,
+                                    std::vector<CaptureRecord>* records) const {
+  records->clear();
+  if (index < 0 || index >= GetFrameCount()) {
+    return;
+  }
+  size_t offset = index == 0 ? first_record_ : frames_[index];
+  const size_t end =
+      index + 1 < GetFrameCount() ? frames_[index + 1] : end_;
+  while (offset < end) {
+    capture::RecordHeader header;
+    memcpy(&header, data_ + offset, sizeof(header));
+    CaptureRecord record;
+    record.type = header.type;
+    record.data = data_ + offset + sizeof(header);
+    record.size = header.size;
+    records->push_back(record);
+    offset += sizeof(header) + header.size;
+  }
+}
+
+}  // namespace arcore_replay
@@ -0,0 +1,70 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TOOLS_ARCORE_REPLAY_CAPTURE_READER_H_
+#define TOOLS_ARCORE_REPLAY_CAPTURE_READER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ar_capture_format.h"
+
+namespace arcore_replay {
+
+// One record of a capture, pointing into the mapped file.
+struct CaptureRecord {
+  uint16_t type = 0;
+  const uint8_t* data = nullptr;
+  uint32_t size = 0;
+};
+
+// Maps a session capture, see ar_capture_format.h, and indexes its frames.
+// The records stay valid until Close().
+class CaptureReader {
+ public:
+  CaptureReader() = default;
+  ~CaptureReader();
+
+  CaptureReader(const CaptureReader&) = delete;
+  CaptureReader& operator=(const CaptureReader&) = delete;
+
+  // Maps |path| and checks its header.  A capture cut short, e.g. by the app
+  // being killed, ends at its last complete record.  Returns false if the
+  // file cannot be mapped or is not a capture.
+  bool Open(const std::string& path);
+  void Close();
+
+  bool IsOpen() const { return data_ != nullptr; }
+  int GetFrameCount() const { return static_cast<int>(frames_.size()); }
+
+  // Returns the records of frame |index|, starting with its kFrame record,
+  // and the records before the first frame for index 0.
+  void GetFrameRecords(int index, std::vector<CaptureRecord>* records) const;
+
+ private:
+  const uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+  // Offset of the first record and of every kFrame record.
+  size_t first_record_ = 0;
+  std::vector<size_t> frames_;
+  size_t end_ = 0;
+};
+
+}  // namespace arcore_replay
+
+#endif  // TOOLS_ARCORE_REPLAY_CAPTURE_READER_H_
@@ -0,0 +1,113 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TOOLS_ARCORE_REPLAY_REPLAY_MATH_H_
+#define TOOLS_ARCORE_REPLAY_REPLAY_MATH_H_
+
+#include <cmath>
+
+namespace arcore_replay {
+
+// Rigid transforms in ARCore's raw pose layout: quaternion x, y, z, w, then
+// the translation.
+
+inline void RotateVector(const float* pose, const float* vector, float* out) {
+  const float x = pose[0], y = pose[1], z = pose[2], w = pose[3];
+  // t = 2 q.xyz x v, v' = v + w t + q.xyz x t
+  const float tx = 2.f * (y * vector[2] - z * vector[1]);
+  const float ty = 2.f * (z * vector[0] - x * vector[2]);
+  const float tz = 2.f * (x * vector[1] - y * vector[0]);
+  out[0] = vector[0] + w * tx + (y * tz - z * ty);
+  out[1] = vector[1] + w * ty + (z * tx - x * tz);
+  out[2] = vector[2] + w * tz + (x * ty - y * tx);
+}
+
+inline void TransformPoint(const float* pose, const float* point,
+                           float* out) {
+  RotateVector(pose, point, out);
+  out[0] += pose[4];
+  out[1] += pose[5];
+  out[2] += pose[6];
+}
+
+inline void InvertPose(const float* pose, float* out) {
+  out[0] = -pose[0];
+  out[1] = -pose[1];
+  out[2] = -pose[2];
+  out[3] = pose[3];
+  const float translation[3] = {-pose[4], -pose[5], -pose[6]};
+  RotateVector(out, translation, out + 4);
+}
+
+// |a| applied after |b|.
+inline void ComposePoses(const float* a, const float* b, float* out) {
+  const float ax = a[0], ay = a[1], az = a[2], aw = a[3];
+  const float bx = b[0], by = b[1], bz = b[2], bw = b[3];
+  float translation[3];
+  TransformPoint(a, b + 4, translation);
+  out[0] = aw * bx + ax * bw + ay * bz - az * by;
+  out[1] = aw * by - ax * bz + ay * bw + az * bx;
+  out[2] = aw * bz + ax * by - ay * bx + az * bw;
+  out[3] = aw * bw - ax * bx - ay * by - az * bz;
+  out[4] = translation[0];
+  out[5] = translation[1];
+  out[6] = translation[2];
+}
+
+inline void PoseToMatrix(const float* pose, float* out_col_major_4x4) {
+  const float x = pose[0], y = pose[1], z = pose[2], w = pose[3];
+  float* m = out_col_major_4x4;
+  m[0] = 1.f - 2.f * (y * y + z * z);
+  m[1] = 2.f * (x * y + z * w);
+  m[2] = 2.f * (x * z - y * w);
+  m[3] = 0.f;
+  m[4] = 2.f * (x * y - z * w);
+  m[5] = 1.f - 2.f * (x * x + z * z);
+  m[6] = 2.f * (y * z + x * w);
+  m[7] = 0.f;
+  m[8] = 2.f * (x * z + y * w);
+  m[9] = 2.f * (y * z - x * w);
+  m[10] = 1.f - 2.f * (x * x + y * y);
+  m[11] = 0.f;
+  m[12] = pose[4];
+  m[13] = pose[5];
+  m[14] = pose[6];
+  m[15] = 1.f;
+}
+
+inline float Dot3(const float* a, const float* b) {
+  return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+// Whether the x, z point is inside the convex or concave |polygon| of
+// |vertex_count| x, z pairs, by the even-odd rule.
+inline bool IsInPolygon(const float* polygon, int vertex_count, float x,
+                        float z) {
+  bool inside = false;
+  for (int i = 0, j = vertex_count - 1; i < vertex_count; j = i++) {
+    const float xi = polygon[2 * i], zi = polygon[2 * i + 1];
+    const float xj = polygon[2 * j], zj = polygon[2 * j + 1];
+    if ((zi > z) != (zj > z) &&
+        x < (xj - xi) * (z - zi) / (zj - zi) + xi) {
+      inside = !inside;
+    }
+  }
+  return inside;
+}
+
+}  // namespace arcore_replay
+
+#endif  // TOOLS_ARCORE_REPLAY_REPLAY_MATH_H_
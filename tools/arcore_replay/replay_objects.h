@@ -0,0 +1,197 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TOOLS_ARCORE_REPLAY_REPLAY_OBJECTS_H_
+#define TOOLS_ARCORE_REPLAY_REPLAY_OBJECTS_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ar_capture_format.h"
+#include "arcore_c_api.h"
+#include "capture_reader.h"
+
+// Definitions of the opaque ARCore types the replay hands out.  The C API
+// only ever passes pointers to them, so their layout is the replay's own.
+//
+// Trackables, anchors, the camera and the point cloud belong to the session
+// and their release functions only drop the handle.  Images, lists, poses
+// and the other objects the app creates or acquires are owned by the app.
+
+struct ArPose_ {
+  float raw[7] = {0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f};
+};
+
+struct ArConfig_ {
+  ArDepthMode depth_mode = AR_DEPTH_MODE_DISABLED;
+  ArLightEstimationMode light_estimation_mode =
+      AR_LIGHT_ESTIMATION_MODE_AMBIENT_INTENSITY;
+  ArPlaneFindingMode plane_finding_mode = AR_PLANE_FINDING_MODE_HORIZONTAL;
+  ArUpdateMode update_mode = AR_UPDATE_MODE_BLOCKING;
+  ArFocusMode focus_mode = AR_FOCUS_MODE_FIXED;
+  ArTextureUpdateMode texture_update_mode =
+      AR_TEXTURE_UPDATE_MODE_BIND_TO_TEXTURE_EXTERNAL_OES;
+};
+
+struct ArCameraConfig_ {
+  hello_ar::capture::SessionInfoRecord info = {};
+};
+
+struct ArCameraConfigList_ {
+  std::vector<hello_ar::capture::SessionInfoRecord> configs;
+};
+
+struct ArCameraConfigFilter_ {};
+
+struct ArCameraIntrinsics_ {
+  hello_ar::capture::CameraIntrinsicsRecord values = {};
+};
+
+struct ArCamera_ {
+  hello_ar::capture::CameraRecord record = {};
+};
+
+struct ArLightEstimate_ {
+  hello_ar::capture::LightEstimateRecord record = {};
+  // Whether the session's config asks for a light estimate.
+  bool enabled = false;
+};
+
+// Planes are the only trackables a capture holds.
+struct ArTrackable_ {
+  ArTrackableType type = AR_TRACKABLE_PLANE;
+  hello_ar::capture::PlaneRecord record = {};
+  // Decoded x, z pairs in meters.
+  std::vector<float> polygon;
+};
+
+struct ArAnchor_ {
+  int32_t id = 0;
+  ArTrackingState tracking_state = AR_TRACKING_STATE_TRACKING;
+  float pose[7] = {0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f};
+  // Plane the anchor was attached to and its pose relative to the plane,
+  // followed while the capture has no record of the anchor.
+  ArTrackable_* plane = nullptr;
+  float plane_pose[7] = {};
+  bool recorded = false;
+};
+
+struct ArTrackableList_ {
+  std::vector<ArTrackable_*> items;
+};
+
+struct ArHitResult_ {
+  float pose[7] = {0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f};
+  float distance = 0.f;
+  ArTrackable_* trackable = nullptr;
+};
+
+struct ArHitResultList_ {
+  std::vector<ArHitResult_> hits;
+};
+
+struct ArPointCloud_ {
+  int64_t timestamp_ns = 0;
+  std::vector<float> points;
+  std::vector<int32_t> ids;
+};
+
+struct ArImage_ {
+  ArImageFormat format = AR_IMAGE_FORMAT_INVALID;
+  int32_t width = 0;
+  int32_t height = 0;
+  int64_t timestamp_ns = 0;
+  int32_t plane_count = 0;
+  std::vector<uint8_t> planes[3];
+  int32_t row_strides[3] = {};
+  int32_t pixel_strides[3] = {};
+};
+
+struct ArTrackDataList_ {};
+struct ArTrack_ {};
+struct ArRecordingConfig_ {};
+struct ArGeospatialPose_ {};
+struct ArAugmentedImageDatabase_ {};
+
+struct ArFrame_ {
+  int64_t timestamp_ns = 0;
+  ArCamera_ camera;
+  hello_ar::capture::DisplayGeometryRecord display = {};
+  bool display_geometry_changed = false;
+  hello_ar::capture::LightEstimateRecord light_estimate = {};
+  // Planes the frame's records updated.
+  std::vector<ArTrackable_*> updated_planes;
+  uint32_t camera_texture_name = 0;
+};
+
+struct ArSession_ {
+  // Opens the capture at |path| and reads its session info.
+  bool OpenCapture(const std::string& path);
+
+  // Applies the records of the next frame to the session and |frame|.
+  // Keeps the last frame once the capture is played back.
+  ArStatus Update(ArFrame_* frame);
+
+  // Adds the planes |ray_origin| + t |ray_direction| hits to |hits|, the
+  // nearest first.
+  void HitTestRay(const float* ray_origin, const float* ray_direction,
+                  ArHitResultList_* hits) const;
+
+  // Fills |image| with the frame's depth image, or returns false if the
+  // capture holds none.
+  bool GetDepthImage(ArImage_* image) const;
+
+  // Fills |image| with a YUV_420_888 image of the recorded size whose
+  // luminance ramp moves with the frame index, as captures hold no camera
+  // images.
+  void GetCameraImage(ArImage_* image) const;
+
+  arcore_replay::CaptureReader reader;
+  std::string capture_path;
+  ArConfig_ config;
+  hello_ar::capture::SessionInfoRecord info = {};
+  bool resumed = false;
+  int next_frame = 0;
+  ArPlaybackStatus playback_status = AR_PLAYBACK_NONE;
+
+  std::vector<std::unique_ptr<ArTrackable_>> planes;
+  std::vector<std::unique_ptr<ArAnchor_>> anchors;
+  ArPointCloud_ point_cloud;
+  int64_t depth_timestamp_ns = -1;
+  int32_t depth_width = 0;
+  int32_t depth_height = 0;
+  std::vector<uint16_t> depth;
+
+  // Latest state, copied into every frame.
+  int64_t timestamp_ns = 0;
+  ArCamera_ camera;
+  hello_ar::capture::DisplayGeometryRecord display = {};
+  hello_ar::capture::LightEstimateRecord light_estimate = {};
+  // The app's display geometry, which only flags a geometry change: the
+  // texture coordinates are the recorded ones.
+  int32_t display_rotation = 0;
+  int32_t display_width = 0;
+  int32_t display_height = 0;
+  bool display_geometry_changed = true;
+  uint32_t camera_texture_name = 0;
+
+  // Records of the frame being applied, kept for their capacity.
+  std::vector<arcore_replay::CaptureRecord> records;
+};
+
+#endif  // TOOLS_ARCORE_REPLAY_REPLAY_OBJECTS_H_
@@ -0,0 +1,308 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include "replay_math.h"
+#include "replay_objects.h"
+
+namespace capture = hello_ar::capture;
+
+namespace {
+
+template <typename T>
+bool ReadRecord(const arcore_replay::CaptureRecord& record, T* out) {
+  if (record.size < sizeof(T)) {
+    return false;
+  }
+  memcpy(out, record.data, sizeof(T));
+  return true;
+}
+
+void ApplyPlane(const arcore_replay::CaptureRecord& record,
+                std::vector<std::unique_ptr<ArTrackable_>>* planes,
+                std::vector<ArTrackable_*>* updated_planes) {
+  capture::PlaneRecord plane_record;
+  if (!ReadRecord(record, &plane_record) || plane_record.id < 0 ||
+      record.size < sizeof(plane_record) +
+                        plane_record.vertex_count * 2 * sizeof(int16_t)) {
+    return;
+  }
+  // Ids are dense, in the order the capture first saw the planes.
+  while (static_cast<int32_t>(planes->size()) <= plane_record.id) {
+    planes->emplace_back(new ArTrackable_);
+  }
+  ArTrackable_* plane = (*planes)[plane_record.id].get();
+  plane->record = plane_record;
+  plane->polygon.resize(2 * plane_record.vertex_count);
+  const uint8_t* vertices = record.data + sizeof(plane_record);
+  int32_t x = 0, z = 0;
+  for (uint32_t i = 0; i < plane_record.vertex_count; ++i) {
+    int16_t delta[2];
+    memcpy(delta, vertices + i * sizeof(delta), sizeof(delta));
+    x += delta[0];
+    z += delta[1];
+    plane->polygon[2 * i] = x * capture::kPolygonUnitM;
+    plane->polygon[2 * i + 1] = z * capture::kPolygonUnitM;
+  }
+  updated_planes->push_back(plane);
+}
+
+void ApplyPointCloud(const arcore_replay::CaptureRecord& record,
+                     ArPointCloud_* point_cloud) {
+  capture::PointCloudRecord cloud_record;
+  if (!ReadRecord(record, &cloud_record)) {
+    return;
+  }
+  const size_t points_size = cloud_record.point_count * 4 * sizeof(float);
+  if (record.size < sizeof(cloud_record) + points_size) {
+    return;
+  }
+  point_cloud->timestamp_ns = cloud_record.timestamp_ns;
+  point_cloud->points.resize(cloud_record.point_count * 4);
+  if (points_size > 0) {
+    memcpy(point_cloud->points.data(), record.data + sizeof(cloud_record),
+           points_size);
+  }
+  point_cloud->ids.resize(cloud_record.point_count);
+  const uint8_t* ids = record.data + sizeof(cloud_record) + points_size;
+  const uint8_t* end = record.data + record.size;
+  int32_t id = 0;
+  for (uint32_t i = 0; i < cloud_record.point_count; ++i) {
+    uint32_t delta = 0;
+    if (!capture::ReadVarint(&ids, end, &delta)) {
+      point_cloud->points.resize(i * 4);
+      point_cloud->ids.resize(i);
+      return;
+    }
+    id += capture::ZigZagDecode(delta);
+    point_cloud->ids[i] = id;
+  }
+}
+
+}  // namespace
+
+bool ArSession_::OpenCapture(const std::string& path) {
+  if (!reader.Open(path)) {
+    return false;
+  }
+  capture_path = path;
+  next_frame = 0;
+  reader.GetFrameRecords(0, &records);
+  for (const arcore_replay::CaptureRecord& record : records) {
+    if (record.type == capture::kSessionInfo) {
+      ReadRecord(record, &info);
+    }
+  }
+  return true;
+}
+
+ArStatus ArSession_::Update(ArFrame_* frame) {
+  if (!resumed) {
+    return AR_ERROR_SESSION_PAUSED;
+  }
+  frame->updated_planes.clear();
+  if (next_frame < reader.GetFrameCount()) {
+    reader.GetFrameRecords(next_frame++, &records);
+    for (const arcore_replay::CaptureRecord& record : records) {
+      switch (record.type) {
+        case capture::kSessionInfo:
+          ReadRecord(record, &info);
+          break;
+        case capture::kFrame: {
+          capture::FrameRecord frame_record;
+          if (ReadRecord(record, &frame_record)) {
+            timestamp_ns = frame_record.timestamp_ns;
+          }
+          break;
+        }
+        case capture::kCamera:
+          ReadRecord(record, &camera.record);
+          break;
+        case capture::kDisplayGeometry:
+          if (ReadRecord(record, &display)) {
+            display_geometry_changed = true;
+          }
+          break;
+        case capture::kPlane:
+          ApplyPlane(record, &planes, &frame->updated_planes);
+          break;
+        case capture::kPointCloud:
+          ApplyPointCloud(record, &point_cloud);
+          break;
+        case capture::kAnchor: {
+          capture::AnchorRecord anchor_record;
+          if (ReadRecord(record, &anchor_record) && anchor_record.id >= 0 &&
+              anchor_record.id < static_cast<int32_t>(anchors.size())) {
+            ArAnchor_* anchor = anchors[anchor_record.id].get();
+            anchor->tracking_state =
+                static_cast<ArTrackingState>(anchor_record.tracking_state);
+            memcpy(anchor->pose, anchor_record.pose, sizeof(anchor->pose));
+            anchor->recorded = true;
+          }
+          break;
+        }
+        case capture::kLightEstimate:
+          ReadRecord(record, &light_estimate);
+          break;
+        case capture::kDepthImage: {
+          capture::DepthImageRecord depth_record;
+          if (!ReadRecord(record, &depth_record) ||
+              record.size < sizeof(depth_record) + depth_record.encoded_size) {
+            break;
+          }
+          depth.resize(depth_record.width * depth_record.height);
+          if (capture::DecodeDepth(record.data + sizeof(depth_record),
+                                   depth_record.encoded_size,
+                                   depth_record.width, depth_record.height,
+                                   depth.data())) {
+            depth_timestamp_ns = depth_record.timestamp_ns;
+            depth_width = depth_record.width;
+            depth_height = depth_record.height;
+          }
+          break;
+        }
+        default:
+          // Records of later versions.
+          break;
+      }
+    }
+    playback_status = AR_PLAYBACK_OK;
+  } else {
+    playback_status = AR_PLAYBACK_FINISHED;
+  }
+
+  // Anchors the capture knows nothing about follow the plane they are on.
+  const bool camera_tracking =
+      camera.record.tracking_state == AR_TRACKING_STATE_TRACKING;
+  for (const std::unique_ptr<ArAnchor_>& anchor : anchors) {
+    if (anchor->recorded ||
+        anchor->tracking_state == AR_TRACKING_STATE_STOPPED) {
+      continue;
+    }
+    if (anchor->plane != nullptr) {
+      arcore_replay::ComposePoses(anchor->plane->record.center_pose,
+                                  anchor->plane_pose, anchor->pose);
+    }
+    anchor->tracking_state =
+        camera_tracking ? AR_TRACKING_STATE_TRACKING : AR_TRACKING_STATE_PAUSED;
+  }
+
+  frame->timestamp_ns = timestamp_ns;
+  frame->camera = camera;
+  frame->display = display;
+  frame->display_geometry_changed = display_geometry_changed;
+  display_geometry_changed = false;
+  frame->light_estimate = light_estimate;
+  frame->camera_texture_name = camera_texture_name;
+  return AR_SUCCESS;
+}
+
+void ArSession_::HitTestRay(const float* ray_origin, const float* ray_direction,
+                            ArHitResultList_* hits) const {
+  hits->hits.clear();
+  if (camera.record.tracking_state != AR_TRACKING_STATE_TRACKING) {
+    return;
+  }
+  for (const std::unique_ptr<ArTrackable_>& plane : planes) {
+    const capture::PlaneRecord& record = plane->record;
+    if (record.tracking_state != AR_TRACKING_STATE_TRACKING ||
+        record.subsumed_by >= 0) {
+      continue;
+    }
+    // Planes are only hit from the side their normal, the local y axis,
+    // points to.
+    const float up[3] = {0.f, 1.f, 0.f};
+    float normal[3];
+    arcore_replay::RotateVector(record.center_pose, up, normal);
+    const float facing = arcore_replay::Dot3(ray_direction, normal);
+    if (facing >= 0.f) {
+      continue;
+    }
+    const float to_center[3] = {record.center_pose[4] - ray_origin[0],
+                                record.center_pose[5] - ray_origin[1],
+                                record.center_pose[6] - ray_origin[2]};
+    const float t = arcore_replay::Dot3(to_center, normal) / facing;
+    if (t <= 0.f) {
+      continue;
+    }
+    const float hit[3] = {ray_origin[0] + t * ray_direction[0],
+                          ray_origin[1] + t * ray_direction[1],
+                          ray_origin[2] + t * ray_direction[2]};
+    float inverse_center[7];
+    arcore_replay::InvertPose(record.center_pose, inverse_center);
+    float local[3];
+    arcore_replay::TransformPoint(inverse_center, hit, local);
+    if (!arcore_replay::IsInPolygon(plane->polygon.data(),
+                                    static_cast<int>(record.vertex_count),
+                                    local[0], local[2])) {
+      continue;
+    }
+    ArHitResult_ result;
+    memcpy(result.pose, record.center_pose, 4 * sizeof(float));
+    memcpy(result.pose + 4, hit, sizeof(hit));
+    result.distance = t * std::sqrt(arcore_replay::Dot3(ray_direction,
+                                                        ray_direction));
+    result.trackable = plane.get();
+    hits->hits.push_back(result);
+  }
+  std::sort(hits->hits.begin(), hits->hits.end(),
+            [](const ArHitResult_& a, const ArHitResult_& b) {
+              return a.distance < b.distance;
+            });
+}
+
+bool ArSession_::GetDepthImage(ArImage_* image) const {
+  if (depth_timestamp_ns < 0) {
+    return false;
+  }
+  image->format = AR_IMAGE_FORMAT_DEPTH16;
+  image->width = depth_width;
+  image->height = depth_height;
+  image->timestamp_ns = depth_timestamp_ns;
+  image->plane_count = 1;
+  image->planes[0].resize(depth.size() * sizeof(uint16_t));
+  memcpy(image->planes[0].data(), depth.data(), image->planes[0].size());
+  image->row_strides[0] = depth_width * sizeof(uint16_t);
+  image->pixel_strides[0] = sizeof(uint16_t);
+  return true;
+}
+
+void ArSession_::GetCameraImage(ArImage_* image) const {
+  const int32_t width = info.image_width;
+  const int32_t height = info.image_height;
+  image->format = AR_IMAGE_FORMAT_YUV_420_888;
+  image->width = width;
+  image->height = height;
+  image->timestamp_ns = timestamp_ns;
+  image->plane_count = 3;
+  image->planes[0].resize(static_cast<size_t>(width) * height);
+  for (int32_t y = 0; y < height; ++y) {
+    uint8_t* row = image->planes[0].data() + static_cast<size_t>(y) * width;
+    for (int32_t x = 0; x < width; ++x) {
+      row[x] = static_cast<uint8_t>(x + y + 4 * next_frame);
+    }
+  }
+  image->row_strides[0] = width;
+  image->pixel_strides[0] = 1;
+  for (int i = 1; i < 3; ++i) {
+    image->planes[i].assign(static_cast<size_t>(width / 2) * (height / 2),
+                            128);
+    image->row_strides[i] = width / 2;
+    image->pixel_strides[i] = 1;
+  }
+}
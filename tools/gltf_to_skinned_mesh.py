@@ -0,0 +1,529 @@
+# Copyright 2024 Google LLC
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Converts a skinned glTF model into the packed skinned mesh format.
+
+The output is version 3 of the format of obj_to_mesh.py, loaded by
+SkinnedObjRenderer in the C samples. The header is that of version 2,
+followed by:
+
+  offset  size  field
+  72      4     joint_count, at most 256
+  76      4     clip_count
+  80      4     skeleton_data_offset
+  84      4     clip_data_offset
+
+Vertices are 24 bytes, the 16 of version 2 followed by:
+
+  16      4     joint indices, 4 unsigned bytes
+  20      4     joint weights, 4 unsigned normalized bytes summing to 255
+
+The skeleton, at skeleton_data_offset, is a column-major 4x4 float matrix
+applied to the root joints, the transform of the nodes above them, then per
+joint its parent (int32, -1 for roots) and its inverse bind matrix (16
+floats). Parents come before their children.
+
+The clips follow at clip_data_offset, each a header of its duration in
+seconds (float), its sample rate (float) and its frame count (uint32), then
+per frame and joint the pose relative to the parent: translation (3 floats),
+rotation quaternion (x, y, z, w) and scale (3 floats). Every glTF animation
+becomes one clip resampled at --sample-rate; CUBICSPLINE channels are
+resampled as if they were LINEAR. A model without animations gets one clip
+of its rest pose.
+
+The bounding sphere in the header encloses the model in every frame of every
+clip, so it can be culled without sampling its animation first. Only the
+first mesh with a skin is converted, and the transform of its own node is
+ignored, as glTF prescribes for skinned meshes. Triangles and vertices are
+reordered like by obj_to_mesh.py unless --no-reorder is given.
+"""
+import argparse
+import base64
+import json
+import math
+import os
+import struct
+
+import obj_to_mesh
+
+SKINNED_VERSION = 3
+SKINNED_HEADER_FORMAT = obj_to_mesh.QUANTIZED_HEADER_FORMAT + '4I'
+SKIN_VERTEX_FORMAT = '<4B4B'
+JOINT_FORMAT = '<i16f'
+CLIP_HEADER_FORMAT = '<2fI'
+POSE_FORMAT = '<10f'
+MAX_JOINTS = 256
+MAX_INFLUENCES = 4
+
+GLB_MAGIC = b'glTF'
+GLB_JSON_CHUNK = 0x4E4F534A
+GLB_BIN_CHUNK = 0x004E4942
+
+COMPONENT_FORMATS = {
+    5120: ('b', 127.0),
+    5121: ('B', 255.0),
+    5122: ('h', 32767.0),
+    5123: ('H', 65535.0),
+    5125: ('I', None),
+    5126: ('f', None),
+}
+TYPE_SIZES = {'SCALAR': 1, 'VEC2': 2, 'VEC3': 3, 'VEC4': 4, 'MAT4': 16}
+TRIANGLES = 4
+
+IDENTITY = [1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0,
+            0.0, 0.0, 1.0]
+
+
+def load_gltf(path):
+  """Returns the glTF JSON and the bytes of each of its buffers."""
+  with open(path, 'rb') as fp:
+    data = fp.read()
+  glb_buffer = None
+  if data[:4] == GLB_MAGIC:
+    offset = 12
+    document = None
+    while offset < len(data):
+      length, chunk_type = struct.unpack_from('<2I', data, offset)
+      chunk = data[offset + 8:offset + 8 + length]
+      if chunk_type == GLB_JSON_CHUNK:
+        document = json.loads(chunk.decode('utf-8'))
+      elif chunk_type == GLB_BIN_CHUNK:
+        glb_buffer = chunk
+      offset += 8 + length
+  else:
+    document = json.loads(data.decode('utf-8'))
+
+  buffers = []
+  for buffer in document.get('buffers', []):
+    uri = buffer.get('uri')
+    if uri is None:
+      buffers.append(glb_buffer)
+    elif uri.startswith('data:'):
+      buffers.append(base64.b64decode(uri.split(',', 1)[1]))
+    else:
+      with open(os.path.join(os.path.dirname(path), uri), 'rb') as fp:
+        buffers.append(fp.read())
+  return document, buffers
+
+
+def read_accessor(document, buffers, index):
+  """Returns the elements of an accessor as tuples, normalized if flagged."""
+  accessor = document['accessors'][index]
+  component, scale = COMPONENT_FORMATS[accessor['componentType']]
+  size = TYPE_SIZES[accessor['type']]
+  count = accessor['count']
+  normalized = accessor.get('normalized', False) and scale is not None
+  if 'bufferView' not in accessor:
+    return [(0.0,) * size] * count
+  view = document['bufferViews'][accessor['bufferView']]
+  data = buffers[view['buffer']]
+  element_format = '<%d%s' % (size, component)
+  stride = view.get('byteStride', struct.calcsize(element_format))
+  start = view.get('byteOffset', 0) + accessor.get('byteOffset', 0)
+  elements = []
+  for i in range(count):
+    element = struct.unpack_from(element_format, data, start + i * stride)
+    if normalized:
+      element = tuple(max(c / scale, -1.0) for c in element)
+    elements.append(element)
+  return elements
+
+
+def multiply(a, b):
+  """Returns the product of two column-major 4x4 matrices."""
+  return [
+      sum(a[k * 4 + row] * b[column * 4 + k] for k in range(4))
+      for column in range(4)
+      for row in range(4)
+  ]
+
+
+def transform_point(m, p):
+  return [m[row] * p[0] + m[4 + row] * p[1] + m[8 + row] * p[2] + m[12 + row]
+          for row in range(3)]
+
+
+def compose(translation, rotation, scale):
+  """Returns the column-major matrix T * R * S."""
+  x, y, z, w = rotation
+  rotation_matrix = [
+      1 - 2 * (y * y + z * z), 2 * (x * y + z * w), 2 * (x * z - y * w),
+      2 * (x * y - z * w), 1 - 2 * (x * x + z * z), 2 * (y * z + x * w),
+      2 * (x * z + y * w), 2 * (y * z - x * w), 1 - 2 * (x * x + y * y)
+  ]
+  m = []
+  for column in range(3):
+    m.extend(rotation_matrix[column * 3 + row] * scale[column]
+             for row in range(3))
+    m.append(0.0)
+  m.extend(translation)
+  m.append(1.0)
+  return m
+
+
+def decompose(m):
+  """Returns the translation, rotation and scale of a matrix without shear."""
+  translation = tuple(m[12:15])
+  scale = tuple(math.sqrt(sum(m[column * 4 + row]**2 for row in range(3)))
+                for column in range(3))
+  r = [[m[column * 4 + row] / (scale[column] or 1.0)
+        for column in range(3)]
+       for row in range(3)]
+  trace = r[0][0] + r[1][1] + r[2][2]
+  if trace > 0.0:
+    s = math.sqrt(trace + 1.0) * 2.0
+    rotation = ((r[2][1] - r[1][2]) / s, (r[0][2] - r[2][0]) / s,
+                (r[1][0] - r[0][1]) / s, 0.25 * s)
+  elif r[0][0] > r[1][1] and r[0][0] > r[2][2]:
+    s = math.sqrt(1.0 + r[0][0] - r[1][1] - r[2][2]) * 2.0
+    rotation = (0.25 * s, (r[0][1] + r[1][0]) / s, (r[0][2] + r[2][0]) / s,
+                (r[2][1] - r[1][2]) / s)
+  elif r[1][1] > r[2][2]:
+    s = math.sqrt(1.0 + r[1][1] - r[0][0] - r[2][2]) * 2.0
+    rotation = ((r[0][1] + r[1][0]) / s, 0.25 * s, (r[1][2] + r[2][1]) / s,
+                (r[0][2] - r[2][0]) / s)
+  else:
+    s = math.sqrt(1.0 + r[2][2] - r[0][0] - r[1][1]) * 2.0
+    rotation = ((r[0][2] + r[2][0]) / s, (r[1][2] + r[2][1]) / s, 0.25 * s,
+                (r[1][0] - r[0][1]) / s)
+  return translation, rotation, scale
+
+
+def node_pose(node):
+  """Returns the rest translation, rotation and scale of a node."""
+  if 'matrix' in node:
+    return decompose(node['matrix'])
+  return (tuple(node.get('translation', (0.0, 0.0, 0.0))),
+          tuple(node.get('rotation', (0.0, 0.0, 0.0, 1.0))),
+          tuple(node.get('scale', (1.0, 1.0, 1.0))))
+
+
+def node_matrix(node):
+  return list(node['matrix']) if 'matrix' in node else compose(
+      *node_pose(node))
+
+
+def slerp(a, b, t):
+  dot = sum(x * y for x, y in zip(a, b))
+  if dot < 0.0:
+    b = tuple(-x for x in b)
+    dot = -dot
+  if dot > 0.9995:
+    result = [x + (y - x) * t for x, y in zip(a, b)]
+  else:
+    angle = math.acos(dot)
+    wa = math.sin((1.0 - t) * angle) / math.sin(angle)
+    wb = math.sin(t * angle) / math.sin(angle)
+    result = [wa * x + wb * y for x, y in zip(a, b)]
+  length = math.sqrt(sum(x * x for x in result)) or 1.0
+  return tuple(x / length for x in result)
+
+
+def sample_channel(times, values, interpolation, path, time):
+  """Evaluates an animation sampler at |time|."""
+  if interpolation == 'CUBICSPLINE':
+    # Keeps the values between the in and out tangents.
+    values = values[1::3]
+  if time <= times[0]:
+    return values[0]
+  if time >= times[-1]:
+    return values[-1]
+  upper = next(i for i, t in enumerate(times) if t > time)
+  lower = upper - 1
+  if interpolation == 'STEP':
+    return values[lower]
+  t = (time - times[lower]) / (times[upper] - times[lower])
+  if path == 'rotation':
+    return slerp(values[lower], values[upper], t)
+  return tuple(a + (b - a) * t for a, b in zip(values[lower], values[upper]))
+
+
+def build_skeleton(document, skin):
+  """Returns the joint nodes, parents first, their parents and the root matrix."""
+  nodes = document['nodes']
+  node_parents = {}
+  for index, node in enumerate(nodes):
+    for child in node.get('children', []):
+      node_parents[child] = index
+
+  skin_joints = skin['joints']
+  joint_set = set(skin_joints)
+  if len(skin_joints) > MAX_JOINTS:
+    raise ValueError('%d joints, at most %d are supported' %
+                     (len(skin_joints), MAX_JOINTS))
+
+  def joint_parent(node):
+    parent = node_parents.get(node)
+    while parent is not None and parent not in joint_set:
+      parent = node_parents.get(parent)
+    return parent
+
+  # Depth first from the roots keeps parents ahead of their children.
+  children = {node: [] for node in skin_joints}
+  roots = []
+  for node in skin_joints:
+    parent = joint_parent(node)
+    if parent is None:
+      roots.append(node)
+    else:
+      children[parent].append(node)
+  ordered = []
+  stack = list(reversed(roots))
+  while stack:
+    node = stack.pop()
+    ordered.append(node)
+    stack.extend(reversed(children[node]))
+
+  # The nodes above the first root; glTF skeletons have one common root.
+  root_matrix = IDENTITY
+  ancestor = node_parents.get(roots[0])
+  while ancestor is not None:
+    root_matrix = multiply(node_matrix(nodes[ancestor]), root_matrix)
+    ancestor = node_parents.get(ancestor)
+
+  order = {node: i for i, node in enumerate(ordered)}
+  parents = [
+      order[joint_parent(node)] if joint_parent(node) is not None else -1
+      for node in ordered
+  ]
+  return ordered, parents, root_matrix
+
+
+def read_clips(document, buffers, joint_nodes, sample_rate):
+  """Returns (duration, frames) per animation, frames of per joint poses."""
+  nodes = document['nodes']
+  joint_index = {node: i for i, node in enumerate(joint_nodes)}
+  rest = [node_pose(nodes[node]) for node in joint_nodes]
+  clips = []
+  for animation in document.get('animations', []):
+    channels = []
+    duration = 0.0
+    for channel in animation['channels']:
+      target = channel['target']
+      if target.get('node') not in joint_index or target['path'] not in (
+          'translation', 'rotation', 'scale'):
+        continue
+      sampler = animation['samplers'][channel['sampler']]
+      times = [t[0] for t in read_accessor(document, buffers, sampler['input'])]
+      values = read_accessor(document, buffers, sampler['output'])
+      duration = max(duration, times[-1])
+      channels.append((joint_index[target['node']], target['path'], times,
+                       values, sampler.get('interpolation', 'LINEAR')))
+    frame_count = max(1, int(math.ceil(duration * sample_rate)) + 1)
+    frames = []
+    for frame in range(frame_count):
+      time = min(frame / sample_rate, duration)
+      poses = [list(pose) for pose in rest]
+      for joint, path, times, values, interpolation in channels:
+        slot = ('translation', 'rotation', 'scale').index(path)
+        poses[joint][slot] = sample_channel(times, values, interpolation, path,
+                                            time)
+      frames.append(poses)
+    clips.append((duration, frames))
+  if not clips:
+    clips.append((0.0, [[list(pose) for pose in rest]]))
+  return clips
+
+
+def skinning_matrices(parents, root_matrix, inverse_binds, poses):
+  """Returns the skinning matrix of every joint for one frame of poses."""
+  world = []
+  for joint, pose in enumerate(poses):
+    local = compose(*pose)
+    parent = root_matrix if parents[joint] < 0 else world[parents[joint]]
+    world.append(multiply(parent, local))
+  return [multiply(w, b) for w, b in zip(world, inverse_binds)]
+
+
+def animated_bounding_sphere(vertices, parents, root_matrix, inverse_binds,
+                             clips):
+  """Returns a sphere enclosing the vertices in every frame of every clip.
+
+  The bind pose sphere is moved and scaled by the skinning matrix of every
+  joint that influences a vertex, which encloses any blend of them.
+  """
+  center = obj_to_mesh.bounding_sphere(vertices)[:3]
+  radius = obj_to_mesh.bounding_sphere(vertices)[3]
+  used = set()
+  for v in vertices:
+    used.update(j for j, w in zip(v[8:12], v[12:16]) if w > 0)
+  spheres = []
+  for _, frames in clips:
+    for poses in frames:
+      for joint, m in enumerate(
+          skinning_matrices(parents, root_matrix, inverse_binds, poses)):
+        if joint not in used:
+          continue
+        scale = max(math.sqrt(sum(m[column * 4 + row]**2 for row in range(3)))
+                    for column in range(3))
+        spheres.append((transform_point(m, center), radius * scale))
+  lower = [min(c[axis] - r for c, r in spheres) for axis in range(3)]
+  upper = [max(c[axis] + r for c, r in spheres) for axis in range(3)]
+  sphere_center = [(lower[axis] + upper[axis]) * 0.5 for axis in range(3)]
+  sphere_radius = max(
+      math.sqrt(sum((c[axis] - sphere_center[axis])**2
+                    for axis in range(3))) + r for c, r in spheres)
+  return tuple(sphere_center) + (sphere_radius,)
+
+
+def quantize_weights(joints, weights):
+  """Returns the 4 strongest influences with byte weights summing to 255."""
+  influences = sorted(zip(weights, joints), reverse=True)[:MAX_INFLUENCES]
+  total = sum(w for w, _ in influences)
+  if total <= 0.0:
+    return (0, 0, 0, 0), (255, 0, 0, 0)
+  byte_weights = [int(round(w / total * 255.0)) for w, _ in influences]
+  # Rounding error goes to the strongest influence.
+  byte_weights[0] += 255 - sum(byte_weights)
+  return tuple(j for _, j in influences), tuple(byte_weights)
+
+
+def read_mesh(document, buffers, mesh, joint_remap):
+  """Returns the vertices of |mesh| as tuples of position, normal, uv, joint
+  indices and byte weights, and its triangle indices."""
+  vertices = []
+  indices = []
+  for primitive in mesh['primitives']:
+    if primitive.get('mode', TRIANGLES) != TRIANGLES:
+      continue
+    attributes = primitive['attributes']
+    positions = read_accessor(document, buffers, attributes['POSITION'])
+    count = len(positions)
+    normals = (read_accessor(document, buffers, attributes['NORMAL'])
+               if 'NORMAL' in attributes else [(0.0, 0.0, 0.0)] * count)
+    uvs = (read_accessor(document, buffers, attributes['TEXCOORD_0'])
+           if 'TEXCOORD_0' in attributes else [(0.0, 0.0)] * count)
+    joints = read_accessor(document, buffers, attributes['JOINTS_0'])
+    weights = read_accessor(document, buffers, attributes['WEIGHTS_0'])
+    base = len(vertices)
+    for i in range(count):
+      joint_indices, byte_weights = quantize_weights(
+          [joint_remap[int(j)] for j in joints[i]], weights[i])
+      # glTF addresses textures from the top left, OBJ from the bottom left.
+      uv = (uvs[i][0], 1.0 - uvs[i][1])
+      vertices.append(
+          tuple(positions[i]) + tuple(normals[i]) + uv + joint_indices +
+          byte_weights)
+    if 'indices' in primitive:
+      indices.extend(base + i[0] for i in read_accessor(
+          document, buffers, primitive['indices']))
+    else:
+      indices.extend(range(base, base + count))
+  return vertices, indices
+
+
+def write_skinned_mesh(path, vertices, indices, parents, root_matrix,
+                       inverse_binds, clips, sample_rate):
+  index_size = 2 if len(vertices) <= obj_to_mesh.MAX_16_BIT_VERTICES else 4
+  sphere = animated_bounding_sphere(vertices, parents, root_matrix,
+                                    inverse_binds, clips)
+  packed, offset, scale = obj_to_mesh.quantize(vertices)
+  vertex_stride = (struct.calcsize(obj_to_mesh.QUANTIZED_VERTEX_FORMAT) +
+                   struct.calcsize(SKIN_VERTEX_FORMAT))
+  vertex_data_offset = struct.calcsize(SKINNED_HEADER_FORMAT)
+  index_data_offset = vertex_data_offset + len(vertices) * vertex_stride
+  index_bytes = len(indices) * index_size
+  # Keeps the floats that follow aligned.
+  padding = (4 - index_bytes % 4) % 4
+  skeleton_data_offset = index_data_offset + index_bytes + padding
+  clip_data_offset = (skeleton_data_offset + 16 * 4 +
+                      len(parents) * struct.calcsize(JOINT_FORMAT))
+
+  header = [
+      obj_to_mesh.MAGIC, SKINNED_VERSION,
+      len(vertices),
+      len(indices), index_size, vertex_stride, sphere[0], sphere[1], sphere[2],
+      sphere[3], vertex_data_offset, index_data_offset
+  ]
+  header.extend(offset + scale)
+  header.extend(
+      (len(parents), len(clips), skeleton_data_offset, clip_data_offset))
+  with open(path, 'wb') as fp:
+    fp.write(struct.pack(SKINNED_HEADER_FORMAT, *header))
+    for vertex, quantized in zip(vertices, packed):
+      fp.write(quantized)
+      fp.write(struct.pack(SKIN_VERTEX_FORMAT, *vertex[8:16]))
+    index_format = '<%d%s' % (len(indices), 'H' if index_size == 2 else 'I')
+    fp.write(struct.pack(index_format, *indices))
+    fp.write(b'\0' * padding)
+    fp.write(struct.pack('<16f', *root_matrix))
+    for parent, inverse_bind in zip(parents, inverse_binds):
+      fp.write(struct.pack(JOINT_FORMAT, parent, *inverse_bind))
+    for duration, frames in clips:
+      fp.write(struct.pack(CLIP_HEADER_FORMAT, duration, sample_rate,
+                           len(frames)))
+      for poses in frames:
+        for translation, rotation, scale in poses:
+          fp.write(
+              struct.pack(POSE_FORMAT, *(tuple(translation) +
+                                         tuple(rotation) + tuple(scale))))
+
+
+def main():
+  parser = argparse.ArgumentParser(
+      description='Convert a skinned glTF model into the packed skinned mesh '
+      'format.')
+  parser.add_argument('input', help='input .gltf or .glb file')
+  parser.add_argument(
+      '-o', '--output', dest='output', required=True, help='output .mesh file')
+  parser.add_argument(
+      '--sample-rate',
+      dest='sample_rate',
+      type=float,
+      default=30.0,
+      help='frames per second the clips are resampled at')
+  parser.add_argument(
+      '--no-reorder',
+      dest='reorder',
+      action='store_false',
+      help='keep the triangle and vertex order of the glTF file')
+
+  args = parser.parse_args()
+
+  document, buffers = load_gltf(args.input)
+  skinned_node = next((node for node in document.get('nodes', [])
+                       if 'mesh' in node and 'skin' in node), None)
+  if skinned_node is None:
+    raise ValueError('%s has no skinned mesh' % args.input)
+  skin = document['skins'][skinned_node['skin']]
+  joint_nodes, parents, root_matrix = build_skeleton(document, skin)
+  order = {node: i for i, node in enumerate(joint_nodes)}
+  # JOINTS_0 indexes skin.joints, which the skeleton reorders.
+  joint_remap = [order[node] for node in skin['joints']]
+  if 'inverseBindMatrices' in skin:
+    skin_inverse_binds = [
+        list(m) for m in read_accessor(document, buffers,
+                                       skin['inverseBindMatrices'])
+    ]
+  else:
+    skin_inverse_binds = [IDENTITY] * len(skin['joints'])
+  inverse_binds = [None] * len(joint_nodes)
+  for skin_index, joint in enumerate(joint_remap):
+    inverse_binds[joint] = skin_inverse_binds[skin_index]
+
+  vertices, indices = read_mesh(document, buffers,
+                                document['meshes'][skinned_node['mesh']],
+                                joint_remap)
+  if args.reorder:
+    vertices, indices = obj_to_mesh.optimize_mesh(vertices, indices)
+  clips = read_clips(document, buffers, joint_nodes, args.sample_rate)
+  write_skinned_mesh(args.output, vertices, indices, parents, root_matrix,
+                     inverse_binds, clips, args.sample_rate)
+  print('%s: %d vertices, %d triangles, %d joints, %d clips' %
+        (args.output, len(vertices), len(indices) // 3, len(joint_nodes),
+         len(clips)))
+
+
+if __name__ == '__main__':
+  main()
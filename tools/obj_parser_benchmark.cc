@@ -0,0 +1,361 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Host benchmark comparing hello_ar_c's single-pass OBJ parser against the
+// stringstream/sscanf/strtok_r loader it replaced.
+//
+// Build and run from the repository root:
+//
+//   g++ -O2 -std=c++17 -Isamples/hello_ar_c/app/src/main/cpp
+//       tools/obj_parser_benchmark.cc
+//       samples/hello_ar_c/app/src/main/cpp/obj_parser.cc
+//       -o /tmp/obj_parser_benchmark
+//   /tmp/obj_parser_benchmark [model.obj]
+//
+// Without an argument a ~7 MB sphere model is generated in memory. Besides
+// timing both parsers, the benchmark checks that every face corner decodes to
+// the same position with either of them.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "obj_parser.h"
+
+namespace {
+
+using GLfloat = float;
+using GLushort = unsigned short;
+
+#define LOGE(...)                 \
+  do {                            \
+    fprintf(stderr, __VA_ARGS__); \
+    fputc('\n', stderr);          \
+  } while (0)
+
+// Verbatim copy of the previous hello_ar::util::LoadObjFile, minus the asset
+// read, kept as the baseline.
+bool LegacyParseObj(const std::string& file_buffer,
+                    std::vector<GLfloat>* out_vertices,
+                    std::vector<GLfloat>* out_normals,
+                    std::vector<GLfloat>* out_uv,
+                    std::vector<GLushort>* out_indices) {
+  std::vector<GLfloat> temp_positions;
+  std::vector<GLfloat> temp_normals;
+  std::vector<GLfloat> temp_uvs;
+  std::vector<GLushort> vertex_indices;
+  std::vector<GLushort> normal_indices;
+  std::vector<GLushort> uv_indices;
+
+  std::stringstream file_string_stream(file_buffer);
+
+  while (!file_string_stream.eof()) {
+    char line_header[128];
+    file_string_stream.getline(line_header, 128);
+
+    if (line_header[0] == 'v' && line_header[1] == 'n') {
+      // Parse vertex normal.
+      GLfloat normal[3];
+      int matches = sscanf(line_header, "vn %f %f %f\n", &normal[0], &normal[1],
+                           &normal[2]);
+      if (matches != 3) {
+        LOGE("Format of 'vn float float float' required for each normal line");
+        return false;
+      }
+
+      temp_normals.push_back(normal[0]);
+      temp_normals.push_back(normal[1]);
+      temp_normals.push_back(normal[2]);
+    } else if (line_header[0] == 'v' && line_header[1] == 't') {
+      // Parse texture uv.
+      GLfloat uv[2];
+      int matches = sscanf(line_header, "vt %f %f\n", &uv[0], &uv[1]);
+      if (matches != 2) {
+        LOGE("Format of 'vt float float' required for each texture uv line");
+        return false;
+      }
+
+      temp_uvs.push_back(uv[0]);
+      temp_uvs.push_back(uv[1]);
+    } else if (line_header[0] == 'v') {
+      // Parse vertex.
+      GLfloat vertex[3];
+      int matches = sscanf(line_header, "v %f %f %f\n", &vertex[0], &vertex[1],
+                           &vertex[2]);
+      if (matches != 3) {
+        LOGE("Format of 'v float float float' required for each vertex line");
+        return false;
+      }
+
+      temp_positions.push_back(vertex[0]);
+      temp_positions.push_back(vertex[1]);
+      temp_positions.push_back(vertex[2]);
+    } else if (line_header[0] == 'f') {
+      // Actual faces information starts from the second character.
+      char* face_line = &line_header[1];
+
+      unsigned int vertex_index[4];
+      unsigned int normal_index[4];
+      unsigned int texture_index[4];
+
+      std::vector<char*> per_vert_info_list;
+      char* per_vert_info_list_c_str;
+      char* face_line_iter = face_line;
+      while ((per_vert_info_list_c_str =
+                  strtok_r(face_line_iter, " ", &face_line_iter))) {
+        // Divide each faces information into individual positions.
+        per_vert_info_list.push_back(per_vert_info_list_c_str);
+      }
+
+      bool is_normal_available = false;
+      bool is_uv_available = false;
+      for (int i = 0; i < per_vert_info_list.size(); ++i) {
+        char* per_vert_info;
+        int per_vert_infor_count = 0;
+
+        bool is_vertex_normal_only_face =
+            (strstr(per_vert_info_list[i], "//") != nullptr);
+
+        char* per_vert_info_iter = per_vert_info_list[i];
+        while ((per_vert_info =
+                    strtok_r(per_vert_info_iter, "/", &per_vert_info_iter))) {
+          // write only normal and vert values.
+          switch (per_vert_infor_count) {
+            case 0:
+              // Write to vertex indices.
+              vertex_index[i] = atoi(per_vert_info);  // NOLINT
+              break;
+            case 1:
+              // Write to texture indices.
+              if (is_vertex_normal_only_face) {
+                normal_index[i] = atoi(per_vert_info);  // NOLINT
+                is_normal_available = true;
+              } else {
+                texture_index[i] = atoi(per_vert_info);  // NOLINT
+                is_uv_available = true;
+              }
+              break;
+            case 2:
+              // Write to normal indices.
+              if (!is_vertex_normal_only_face) {
+                normal_index[i] = atoi(per_vert_info);  // NOLINT
+                is_normal_available = true;
+                break;
+              }
+              [[clang::fallthrough]];
+            // Intentionally falling to default error case because vertex
+            // normal face only has two values.
+            default:
+              // Error formatting.
+              LOGE(
+                  "Format of 'f int/int/int int/int/int int/int/int "
+                  "(int/int/int)' "
+                  "or 'f int//int int//int int//int (int//int)' required for "
+                  "each face");
+              return false;
+          }
+          per_vert_infor_count++;
+        }
+      }
+
+      int vertices_count = per_vert_info_list.size();
+      for (int i = 2; i < vertices_count; ++i) {
+        vertex_indices.push_back(vertex_index[0] - 1);
+        vertex_indices.push_back(vertex_index[i - 1] - 1);
+        vertex_indices.push_back(vertex_index[i] - 1);
+
+        if (is_normal_available) {
+          normal_indices.push_back(normal_index[0] - 1);
+          normal_indices.push_back(normal_index[i - 1] - 1);
+          normal_indices.push_back(normal_index[i] - 1);
+        }
+
+        if (is_uv_available) {
+          uv_indices.push_back(texture_index[0] - 1);
+          uv_indices.push_back(texture_index[i - 1] - 1);
+          uv_indices.push_back(texture_index[i] - 1);
+        }
+      }
+    }
+  }
+
+  bool is_normal_available = (!normal_indices.empty());
+  bool is_uv_available = (!uv_indices.empty());
+
+  if (is_normal_available && normal_indices.size() != vertex_indices.size()) {
+    LOGE("Obj normal indices does not equal to vertex indices.");
+    return false;
+  }
+
+  if (is_uv_available && uv_indices.size() != vertex_indices.size()) {
+    LOGE("Obj UV indices does not equal to vertex indices.");
+    return false;
+  }
+
+  for (unsigned int i = 0; i < vertex_indices.size(); i++) {
+    unsigned int vertex_index = vertex_indices[i];
+    out_vertices->push_back(temp_positions[vertex_index * 3]);
+    out_vertices->push_back(temp_positions[vertex_index * 3 + 1]);
+    out_vertices->push_back(temp_positions[vertex_index * 3 + 2]);
+    out_indices->push_back(i);
+
+    if (is_normal_available) {
+      unsigned int normal_index = normal_indices[i];
+      out_normals->push_back(temp_normals[normal_index * 3]);
+      out_normals->push_back(temp_normals[normal_index * 3 + 1]);
+      out_normals->push_back(temp_normals[normal_index * 3 + 2]);
+    }
+
+    if (is_uv_available) {
+      unsigned int uv_index = uv_indices[i];
+      out_uv->push_back(temp_uvs[uv_index * 2]);
+      out_uv->push_back(temp_uvs[uv_index * 2 + 1]);
+    }
+  }
+
+  return true;
+}
+
+// Generates a UV sphere with positions, uvs and normals on every corner.
+std::string GenerateSphereObj(int segments) {
+  std::string obj;
+  char line[128];
+  const float kPi = 3.14159265358979f;
+  for (int ring = 0; ring <= segments; ++ring) {
+    const float theta = kPi * ring / segments;
+    for (int slice = 0; slice <= segments; ++slice) {
+      const float phi = 2.0f * kPi * slice / segments;
+      const float x = std::sin(theta) * std::cos(phi);
+      const float y = std::cos(theta);
+      const float z = std::sin(theta) * std::sin(phi);
+      snprintf(line, sizeof(line), "v %.6f %.6f %.6f\n", x, y, z);
+      obj += line;
+      snprintf(line, sizeof(line), "vn %.6f %.6f %.6f\n", x, y, z);
+      obj += line;
+      snprintf(line, sizeof(line), "vt %.6f %.6f\n",
+               static_cast<float>(slice) / segments,
+               static_cast<float>(ring) / segments);
+      obj += line;
+    }
+  }
+  for (int ring = 0; ring < segments; ++ring) {
+    for (int slice = 0; slice < segments; ++slice) {
+      const int a = ring * (segments + 1) + slice + 1;
+      const int b = a + segments + 1;
+      snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a,
+               b, b, b, a + 1, a + 1, a + 1);
+      obj += line;
+      snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d\n", a + 1,
+               a + 1, a + 1, b, b, b, b + 1, b + 1, b + 1);
+      obj += line;
+    }
+  }
+  return obj;
+}
+
+template <typename Function>
+double MedianMilliseconds(int iterations, Function function) {
+  std::vector<double> samples;
+  for (int i = 0; i < iterations; ++i) {
+    const auto start = std::chrono::steady_clock::now();
+    function();
+    const auto end = std::chrono::steady_clock::now();
+    samples.push_back(
+        std::chrono::duration<double, std::milli>(end - start).count());
+  }
+  std::sort(samples.begin(), samples.end());
+  return samples[samples.size() / 2];
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  constexpr int kIterations = 9;
+  constexpr int kSphereSegments = 200;
+
+  std::string obj;
+  if (argc > 1) {
+    std::ifstream file(argv[1], std::ios::binary);
+    if (!file) {
+      fprintf(stderr, "Could not open %s\n", argv[1]);
+      return 1;
+    }
+    std::stringstream contents;
+    contents << file.rdbuf();
+    obj = contents.str();
+  } else {
+    obj = GenerateSphereObj(kSphereSegments);
+  }
+  const double megabytes = obj.size() / (1024.0 * 1024.0);
+
+  std::vector<GLfloat> legacy_vertices;
+  std::vector<GLushort> legacy_indices;
+  bool legacy_ok = true;
+  const double legacy_ms = MedianMilliseconds(kIterations, [&]() {
+    std::vector<GLfloat> normals;
+    std::vector<GLfloat> uvs;
+    legacy_vertices.clear();
+    legacy_indices.clear();
+    legacy_ok = LegacyParseObj(obj, &legacy_vertices, &normals, &uvs,
+                               &legacy_indices);
+  });
+
+  hello_ar::ObjMesh mesh;
+  std::string error;
+  bool parsed = true;
+  const double parser_ms = MedianMilliseconds(kIterations, [&]() {
+    parsed = hello_ar::ParseObj(obj.data(), obj.size(), &mesh, &error);
+  });
+  if (!parsed) {
+    fprintf(stderr, "ParseObj failed: %s\n", error.c_str());
+    return 1;
+  }
+
+  // The legacy loader emits one vertex per corner in face order, so corner i
+  // of both meshes must land on the same position.  Its 16-bit indices wrap
+  // past 65536 corners, so the legacy vertex array is read directly.
+  float max_position_error = 0.0f;
+  if (legacy_ok && legacy_vertices.size() == mesh.indices.size() * 3) {
+    for (size_t i = 0; i < mesh.indices.size(); ++i) {
+      const float* expected = &legacy_vertices[i * 3];
+      const float* actual =
+          &mesh.vertices[mesh.indices[i] * hello_ar::ObjMesh::kVertexComponents];
+      for (int axis = 0; axis < 3; ++axis) {
+        max_position_error = std::max(
+            max_position_error, std::fabs(expected[axis] - actual[axis]));
+      }
+    }
+  }
+
+  printf("input: %.2f MB\n", megabytes);
+  printf("legacy LoadObjFile: %8.2f ms  %7.1f MB/s  %zu vertices  %zu indices%s\n",
+         legacy_ms, megabytes / (legacy_ms / 1000.0),
+         legacy_vertices.size() / 3, legacy_indices.size(),
+         legacy_ok ? "" : "  (failed)");
+  printf("ParseObj:           %8.2f ms  %7.1f MB/s  %zu vertices  %zu indices\n",
+         parser_ms, megabytes / (parser_ms / 1000.0), mesh.GetVertexCount(),
+         mesh.indices.size());
+  printf("speedup: %.1fx  max position difference: %g\n",
+         legacy_ms / parser_ms, max_position_error);
+  return 0;
+}
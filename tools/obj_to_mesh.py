@@ -0,0 +1,438 @@
+# Copyright 2024 Google LLC
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Converts a Wavefront OBJ model into the packed binary mesh format.
+
+The output is loaded by util::MeshAsset in the C samples, which maps the
+asset in place and uploads it to OpenGL without any parsing. All values are
+little-endian:
+
+  offset  size  field
+  0       4     magic, b'ARMS'
+  4       4     version, currently 1
+  8       4     vertex_count
+  12      4     index_count
+  16      4     index_size, 2 or 4 bytes
+  20      4     vertex_stride, 32 bytes
+  24      16    bounding sphere center (xyz) and radius
+  40      4     vertex_data_offset
+  44      4     index_data_offset
+  48      12    position offset (xyz), version 2 only
+  60      12    position scale (xyz), version 2 only
+
+Version 2 vertices are quantized to 16 bytes, matching ObjRenderer's vertex
+layout (util::QuantizedVertex):
+
+  0       8     position, 4 unsigned normalized shorts; xyz in the bounding
+                box (offset + scale * xyz), w = 1
+  8       4     octahedral encoded normal, 2 signed normalized shorts
+  12      4     texture coordinate, 2 half floats
+
+With --float, version 1 vertices are written instead: position (3 floats),
+normal (3 floats) and texture coordinate (2 floats), as BatchedObjRenderer
+expects. Faces with more than three corners are triangulated as fans.
+Attributes missing from the OBJ file are written as zeros.
+
+Unless --no-reorder is given, the triangles are reordered for the
+post-transform vertex cache and then in clusters for less overdraw, and the
+vertices in the order the triangles first use them. The average cache miss
+ratio (ACMR, transformed vertices per triangle) is printed for each step.
+"""
+import argparse
+import collections
+import math
+import struct
+
+MAGIC = b'ARMS'
+FLOAT_VERSION = 1
+QUANTIZED_VERSION = 2
+FLOAT_HEADER_FORMAT = '<4s5I4f2I'
+QUANTIZED_HEADER_FORMAT = FLOAT_HEADER_FORMAT + '6f'
+FLOAT_VERTEX_FORMAT = '<8f'
+QUANTIZED_VERTEX_FORMAT = '<4H2h2e'
+MAX_16_BIT_VERTICES = 0xFFFF + 1
+
+# Vertex cache optimization, see optimize_vertex_cache(). The ACMR is
+# reported for a FIFO cache of FIFO_CACHE_SIZE entries, a common size among
+# mobile GPUs.
+LRU_CACHE_SIZE = 32
+CACHE_DECAY_POWER = 1.5
+LAST_TRIANGLE_SCORE = 0.75
+VALENCE_BOOST_SCALE = 2.0
+VALENCE_BOOST_POWER = 0.5
+FIFO_CACHE_SIZE = 16
+# Overdraw clusters may raise the ACMR by at most this factor.
+OVERDRAW_ACMR_THRESHOLD = 1.05
+
+
+def resolve_index(token, count):
+  """Converts a 1-based or negative OBJ index into a 0-based one."""
+  if not token:
+    return None
+  index = int(token)
+  return index - 1 if index > 0 else count + index
+
+
+def parse_obj(path):
+  """Returns deduplicated interleaved vertices and triangle indices."""
+  positions = []
+  normals = []
+  uvs = []
+  vertices = []
+  indices = []
+  vertex_lookup = {}
+
+  with open(path, 'r') as fp:
+    for line in fp:
+      fields = line.split()
+      if not fields:
+        continue
+      tag = fields[0]
+      if tag == 'v':
+        positions.append(tuple(float(x) for x in fields[1:4]))
+      elif tag == 'vn':
+        normals.append(tuple(float(x) for x in fields[1:4]))
+      elif tag == 'vt':
+        uvs.append(tuple(float(x) for x in fields[1:3]))
+      elif tag == 'f':
+        corners = []
+        for corner in fields[1:]:
+          parts = (corner.split('/') + ['', ''])[:3]
+          key = (resolve_index(parts[0], len(positions)),
+                 resolve_index(parts[1], len(uvs)),
+                 resolve_index(parts[2], len(normals)))
+          index = vertex_lookup.get(key)
+          if index is None:
+            index = len(vertices)
+            vertex_lookup[key] = index
+            position = positions[key[0]]
+            uv = uvs[key[1]] if key[1] is not None else (0.0, 0.0)
+            normal = normals[key[2]] if key[2] is not None else (0.0, 0.0, 0.0)
+            vertices.append(position + normal + uv)
+          corners.append(index)
+        for i in range(1, len(corners) - 1):
+          indices.extend((corners[0], corners[i], corners[i + 1]))
+  return vertices, indices
+
+
+def bounding_sphere(vertices):
+  """Returns a sphere centered on the bounding box that contains all points."""
+  if not vertices:
+    return (0.0, 0.0, 0.0, 0.0)
+  lower = [min(v[axis] for v in vertices) for axis in range(3)]
+  upper = [max(v[axis] for v in vertices) for axis in range(3)]
+  center = [(lower[axis] + upper[axis]) * 0.5 for axis in range(3)]
+  radius = max(
+      math.sqrt(sum((v[axis] - center[axis])**2 for axis in range(3)))
+      for v in vertices)
+  return (center[0], center[1], center[2], radius)
+
+
+def encode_octahedral(normal):
+  """Returns the octahedral encoding of a normal in [-1, 1]^2."""
+  l1_norm = sum(abs(c) for c in normal)
+  if l1_norm == 0.0:
+    return (0.0, 0.0)
+  x, y = normal[0] / l1_norm, normal[1] / l1_norm
+  if normal[2] < 0.0:
+    x, y = ((1.0 - abs(y)) * (1.0 if x >= 0.0 else -1.0),
+            (1.0 - abs(x)) * (1.0 if y >= 0.0 else -1.0))
+  return (x, y)
+
+
+def quantize(vertices):
+  """Returns the packed version 2 vertices and the position offset and scale."""
+  if vertices:
+    lower = [min(v[axis] for v in vertices) for axis in range(3)]
+    upper = [max(v[axis] for v in vertices) for axis in range(3)]
+  else:
+    lower = upper = [0.0, 0.0, 0.0]
+  scale = [upper[axis] - lower[axis] for axis in range(3)]
+
+  def unorm(value, axis):
+    unit = (value - lower[axis]) / scale[axis] if scale[axis] > 0.0 else 0.0
+    return int(round(min(max(unit, 0.0), 1.0) * 65535.0))
+
+  def snorm(value):
+    return int(round(min(max(value, -1.0), 1.0) * 32767.0))
+
+  packed = []
+  for v in vertices:
+    normal = encode_octahedral(v[3:6])
+    packed.append(
+        struct.pack(QUANTIZED_VERTEX_FORMAT, unorm(v[0], 0), unorm(v[1], 1),
+                    unorm(v[2], 2), 0xFFFF, snorm(normal[0]), snorm(normal[1]),
+                    v[6], v[7]))
+  return packed, lower, scale
+
+
+def simulate_fifo(indices, cache_size=FIFO_CACHE_SIZE):
+  """Returns the cache misses of every triangle in a FIFO vertex cache."""
+  cache = collections.deque()
+  cached = set()
+  misses = []
+  for t in range(0, len(indices), 3):
+    triangle_misses = 0
+    for index in indices[t:t + 3]:
+      if index in cached:
+        continue
+      triangle_misses += 1
+      cache.append(index)
+      cached.add(index)
+      if len(cache) > cache_size:
+        cached.discard(cache.popleft())
+    misses.append(triangle_misses)
+  return misses
+
+
+def acmr(indices):
+  """Average cache miss ratio: transformed vertices per triangle."""
+  triangle_count = len(indices) // 3
+  if triangle_count == 0:
+    return 0.0
+  return sum(simulate_fifo(indices)) / float(triangle_count)
+
+
+def vertex_score(cache_position, valence):
+  """Scores a vertex by its cache position and its remaining triangles."""
+  if valence == 0:
+    return -1.0
+  score = 0.0
+  if cache_position >= 0:
+    if cache_position < 3:
+      # The vertices of the last triangle get a fixed score, so that the
+      # next triangle does not simply reuse the same edge.
+      score = LAST_TRIANGLE_SCORE
+    else:
+      scale = 1.0 / (LRU_CACHE_SIZE - 3)
+      score = (1.0 - (cache_position - 3) * scale)**CACHE_DECAY_POWER
+  return score + VALENCE_BOOST_SCALE * valence**-VALENCE_BOOST_POWER
+
+
+def optimize_vertex_cache(indices, vertex_count):
+  """Reorders triangles for post-transform cache locality.
+
+  Tom Forsyth's "Linear-Speed Vertex Cache Optimisation": greedily emits the
+  triangle whose vertices score highest in a simulated LRU cache.
+  """
+  triangle_count = len(indices) // 3
+  vertex_triangles = [[] for _ in range(vertex_count)]
+  for t in range(triangle_count):
+    for index in indices[3 * t:3 * t + 3]:
+      vertex_triangles[index].append(t)
+  valence = [len(triangles) for triangles in vertex_triangles]
+  cache_position = [-1] * vertex_count
+  scores = [vertex_score(-1, v) for v in valence]
+  triangle_scores = [
+      sum(scores[i] for i in indices[3 * t:3 * t + 3])
+      for t in range(triangle_count)
+  ]
+  emitted = [False] * triangle_count
+  cache = []
+  result = []
+  next_unemitted = 0
+
+  best = max(range(triangle_count), key=lambda t: triangle_scores[t],
+             default=None)
+  while best is not None:
+    emitted[best] = True
+    corners = indices[3 * best:3 * best + 3]
+    result.extend(corners)
+    for index in corners:
+      valence[index] -= 1
+      vertex_triangles[index].remove(best)
+
+    # Moves the corners to the front of the cache.
+    cache = corners + [i for i in cache if i not in corners]
+    evicted = cache[LRU_CACHE_SIZE:]
+    cache = cache[:LRU_CACHE_SIZE]
+    for index in evicted:
+      cache_position[index] = -1
+    touched = set(evicted)
+    for position, index in enumerate(cache):
+      cache_position[index] = position
+      touched.add(index)
+    for index in touched:
+      new_score = vertex_score(cache_position[index], valence[index])
+      delta = new_score - scores[index]
+      scores[index] = new_score
+      for t in vertex_triangles[index]:
+        triangle_scores[t] += delta
+
+    best = None
+    best_score = -1.0
+    for index in cache:
+      for t in vertex_triangles[index]:
+        if triangle_scores[t] > best_score:
+          best = t
+          best_score = triangle_scores[t]
+    if best is None:
+      # Dead end: continue with the next triangle in input order.
+      while next_unemitted < triangle_count and emitted[next_unemitted]:
+        next_unemitted += 1
+      if next_unemitted < triangle_count:
+        best = next_unemitted
+  return result
+
+
+def optimize_overdraw(indices, vertices, threshold=OVERDRAW_ACMR_THRESHOLD):
+  """Reorders clusters of the cache-optimized triangles to reduce overdraw.
+
+  After Sander et al., "Fast Triangle Reordering for Vertex Locality and
+  Reduced Overdraw": the sequence is split where the cache restarts, i.e. at
+  triangles missing all three vertices, but only where the ACMR so far stays
+  within |threshold| of the whole mesh. The clusters are then drawn outermost
+  first, ordered by how far their centroid lies in front of the mesh centroid
+  along their average normal, so that they tend to occlude the rest.
+  """
+  triangle_count = len(indices) // 3
+  if triangle_count == 0:
+    return list(indices)
+  misses = simulate_fifo(indices)
+  target = threshold * sum(misses) / float(triangle_count)
+  starts = [0]
+  cluster_misses = 0
+  for t in range(triangle_count):
+    if misses[t] == 3 and t > starts[-1]:
+      if cluster_misses / float(t - starts[-1]) <= target:
+        starts.append(t)
+        cluster_misses = 0
+    cluster_misses += misses[t]
+  starts.append(triangle_count)
+
+  def position(index):
+    return vertices[index][0:3]
+
+  mesh_centroid = [
+      sum(v[axis] for v in vertices) / len(vertices) for axis in range(3)
+  ]
+  clusters = []
+  for begin, end in zip(starts, starts[1:]):
+    area_normal = [0.0, 0.0, 0.0]
+    centroid = [0.0, 0.0, 0.0]
+    area_sum = 0.0
+    for t in range(begin, end):
+      a, b, c = (position(i) for i in indices[3 * t:3 * t + 3])
+      u = [b[axis] - a[axis] for axis in range(3)]
+      v = [c[axis] - a[axis] for axis in range(3)]
+      normal = [
+          u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2],
+          u[0] * v[1] - u[1] * v[0]
+      ]
+      area = math.sqrt(sum(n * n for n in normal)) * 0.5
+      for axis in range(3):
+        area_normal[axis] += normal[axis]
+        centroid[axis] += (a[axis] + b[axis] + c[axis]) / 3.0 * area
+      area_sum += area
+    length = math.sqrt(sum(n * n for n in area_normal))
+    if area_sum > 0.0 and length > 0.0:
+      occlusion = sum((centroid[axis] / area_sum - mesh_centroid[axis]) *
+                      area_normal[axis] / length for axis in range(3))
+    else:
+      occlusion = 0.0
+    clusters.append((occlusion, begin, end))
+
+  clusters.sort(key=lambda cluster: -cluster[0])
+  result = []
+  for _, begin, end in clusters:
+    result.extend(indices[3 * begin:3 * end])
+  return result
+
+
+def optimize_vertex_fetch(vertices, indices):
+  """Renumbers the vertices in the order the indices first use them."""
+  remap = {}
+  ordered = []
+  for index in indices:
+    if index not in remap:
+      remap[index] = len(ordered)
+      ordered.append(vertices[index])
+  return ordered, [remap[index] for index in indices]
+
+
+def optimize_mesh(vertices, indices):
+  """Runs the three reordering passes and reports the ACMR of each."""
+  before = acmr(indices)
+  indices = optimize_vertex_cache(indices, len(vertices))
+  after_cache = acmr(indices)
+  indices = optimize_overdraw(indices, vertices)
+  after_overdraw = acmr(indices)
+  vertices, indices = optimize_vertex_fetch(vertices, indices)
+  print('ACMR (%d entry FIFO): %.3f before, %.3f after vertex cache, %.3f '
+        'after overdraw' % (FIFO_CACHE_SIZE, before, after_cache,
+                            after_overdraw))
+  return vertices, indices
+
+
+def write_mesh(path, vertices, indices, quantized):
+  index_size = 2 if len(vertices) <= MAX_16_BIT_VERTICES else 4
+  sphere = bounding_sphere(vertices)
+  if quantized:
+    packed, offset, scale = quantize(vertices)
+    header_format = QUANTIZED_HEADER_FORMAT
+    version = QUANTIZED_VERSION
+    vertex_stride = struct.calcsize(QUANTIZED_VERTEX_FORMAT)
+  else:
+    packed = [struct.pack(FLOAT_VERTEX_FORMAT, *v) for v in vertices]
+    header_format = FLOAT_HEADER_FORMAT
+    version = FLOAT_VERSION
+    vertex_stride = struct.calcsize(FLOAT_VERTEX_FORMAT)
+  vertex_data_offset = struct.calcsize(header_format)
+  index_data_offset = vertex_data_offset + len(vertices) * vertex_stride
+
+  header = [
+      MAGIC, version,
+      len(vertices),
+      len(indices), index_size, vertex_stride, sphere[0], sphere[1], sphere[2],
+      sphere[3], vertex_data_offset, index_data_offset
+  ]
+  if quantized:
+    header.extend(offset + scale)
+  with open(path, 'wb') as fp:
+    fp.write(struct.pack(header_format, *header))
+    for vertex in packed:
+      fp.write(vertex)
+    index_format = '<%d%s' % (len(indices), 'H' if index_size == 2 else 'I')
+    fp.write(struct.pack(index_format, *indices))
+
+
+def main():
+  parser = argparse.ArgumentParser(
+      description='Convert an OBJ model into the packed binary mesh format.')
+  parser.add_argument('input', help='input .obj file')
+  parser.add_argument(
+      '-o', '--output', dest='output', required=True, help='output .mesh file')
+  parser.add_argument(
+      '--float',
+      dest='quantized',
+      action='store_false',
+      help='write unquantized version 1 float vertices')
+  parser.add_argument(
+      '--no-reorder',
+      dest='reorder',
+      action='store_false',
+      help='keep the triangle and vertex order of the OBJ file')
+
+  args = parser.parse_args()
+
+  vertices, indices = parse_obj(args.input)
+  if args.reorder:
+    vertices, indices = optimize_mesh(vertices, indices)
+  write_mesh(args.output, vertices, indices, args.quantized)
+  print('%s: %d vertices, %d triangles' %
+        (args.output, len(vertices), len(indices) // 3))
+
+
+if __name__ == '__main__':
+  main()
@@ -0,0 +1,240 @@
+# Copyright 2024 Google LLC
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Runs the C samples' playback benchmarks and compares them to a baseline.
+
+Every sample started with the benchmark_dataset_uri intent extra plays the
+MP4 recording back instead of the camera, times each frame and writes
+playback_benchmark.csv to its external files directory; see PlaybackBenchmark
+in the samples. This script runs every installed sample over every dataset,
+pulls the CSV files and writes a JSON report of the frame time distribution,
+the mean stage times (CPU and, in hello_ar_c, GPU) and the peak resident set
+size of each run, e.g.
+
+  tools/playback_regression.py --dataset office.mp4 --dataset street.mp4 \
+      --baseline baseline.json --output out
+
+The samples must be installed with the same build type as the baseline's.
+Each dataset is pushed to the app's external files directory, so no storage
+permission is needed. The exit status is 1 if a metric of a run exceeds its
+baseline by more than the tolerance, so the script can gate a change.
+--update-baseline writes the measured metrics as the new baseline instead.
+To compare CSV files pulled earlier, pass --skip-run with the same --output.
+"""
+import argparse
+import csv
+import json
+import os
+import subprocess
+import sys
+import time
+
+# Sample directory: (application id, activity).
+SAMPLES = {
+    'hello_ar_c': ('com.google.ar.core.examples.c.helloar', '.HelloArActivity'),
+    'hardwarebuffer_c': ('com.google.ar.core.examples.c.helloarhardwarebuffer',
+                         '.HelloArActivity'),
+    'augmented_image_c': ('com.google.ar.core.examples.c.augmentedimage',
+                          '.AugmentedImageActivity'),
+    'computervision_c': ('com.google.ar.core.examples.c.computervision',
+                         '.ComputerVisionActivity'),
+    'hello_ar_vulkan_c': ('com.google.ar.core.examples.c.simplevulkan',
+                          '.SimpleVulkanActivity'),
+}
+
+CSV_FILE_NAME = 'playback_benchmark.csv'
+# Metrics that fail the run when they grow past --time-tolerance and
+# --memory-tolerance.
+TIME_METRICS = ['total_ms_p50', 'total_ms_p90', 'total_ms_p99']
+MEMORY_METRICS = ['peak_rss_kb']
+
+
+def adb(args, serial, check=True):
+  command = ['adb'] + (['-s', serial] if serial else []) + args
+  result = subprocess.run(
+      command, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True)
+  if check and result.returncode != 0:
+    raise RuntimeError('%s failed: %s' % (' '.join(command), result.stdout))
+  return result.stdout
+
+
+def external_files_dir(package):
+  return '/sdcard/Android/data/%s/files' % package
+
+
+def run_benchmark(sample, dataset, serial, timeout_s, csv_path):
+  """Plays |dataset| back in |sample| and pulls its CSV to |csv_path|."""
+  package, activity = SAMPLES[sample]
+  files_dir = external_files_dir(package)
+  device_dataset = '%s/datasets/%s' % (files_dir, os.path.basename(dataset))
+  device_csv = '%s/%s' % (files_dir, CSV_FILE_NAME)
+
+  adb(['shell', 'am', 'force-stop', package], serial)
+  adb(['shell', 'pm', 'grant', package, 'android.permission.CAMERA'], serial)
+  adb(['shell', 'mkdir', '-p', os.path.dirname(device_dataset)], serial)
+  adb(['push', dataset, device_dataset], serial)
+  adb(['shell', 'rm', '-f', device_csv], serial)
+  adb([
+      'shell', 'am', 'start', '-W', '-n', package + '/' + activity, '--es',
+      'benchmark_dataset_uri', 'file://' + device_dataset
+  ], serial)
+
+  # The totals row is written once the playback reached the end.
+  deadline = time.time() + timeout_s
+  while not adb(['shell', 'tail', '-n', '1', device_csv], serial,
+                check=False).startswith('total,'):
+    if time.time() > deadline:
+      adb(['shell', 'am', 'force-stop', package], serial)
+      raise RuntimeError('%s did not finish %s within %d s' %
+                         (sample, dataset, timeout_s))
+    time.sleep(2)
+  adb(['pull', device_csv, csv_path], serial)
+  adb(['shell', 'am', 'force-stop', package], serial)
+
+
+def percentile(sorted_values, percent):
+  """Same nearest rank percentile as PlaybackBenchmark's log."""
+  return sorted_values[(len(sorted_values) - 1) * percent // 100]
+
+
+def summarize(csv_path):
+  """Returns the metrics of one benchmark CSV."""
+  with open(csv_path, newline='') as fp:
+    rows = list(csv.DictReader(fp))
+  frames = [row for row in rows if row['frame'] != 'total']
+  totals = [row for row in rows if row['frame'] == 'total']
+  if not frames or not totals:
+    raise RuntimeError('%s: no frames or no totals row' % csv_path)
+
+  frame_ms = sorted(float(row['total_ms']) for row in frames)
+  metrics = {
+      'frames': len(frames),
+      'total_ms_mean': sum(frame_ms) / len(frame_ms),
+      'total_ms_p50': percentile(frame_ms, 50),
+      'total_ms_p90': percentile(frame_ms, 90),
+      'total_ms_p99': percentile(frame_ms, 99),
+      'total_ms_max': frame_ms[-1],
+      'peak_rss_kb': int(totals[0]['rss_kb']),
+  }
+  # Stage columns, empty where no value was measured, e.g. GPU times before
+  # the first timer query result.
+  for column in frames[0]:
+    if not column.endswith('_ms') or column == 'total_ms':
+      continue
+    values = [float(row[column]) for row in frames if row[column]]
+    if values:
+      metrics[column + '_mean'] = sum(values) / len(values)
+  return metrics
+
+
+def compare(key, metrics, baseline, time_tolerance, memory_tolerance):
+  """Returns a message for every metric of |key| past its baseline."""
+  if key not in baseline:
+    return []
+  regressions = []
+  for name, tolerance in ([(m, time_tolerance) for m in TIME_METRICS] +
+                          [(m, memory_tolerance) for m in MEMORY_METRICS]):
+    reference = baseline[key].get(name)
+    if not reference or name not in metrics:
+      continue
+    if metrics[name] > reference * (1.0 + tolerance):
+      regressions.append(
+          '%s: %s %.3f vs. baseline %.3f (+%.1f%%)' %
+          (key, name, metrics[name], reference,
+           (metrics[name] / reference - 1.0) * 100.0))
+  return regressions
+
+
+def main():
+  parser = argparse.ArgumentParser(
+      description='Run the C samples\' playback benchmarks against a baseline.')
+  parser.add_argument(
+      '--dataset',
+      action='append',
+      required=True,
+      help='MP4 recording to play back, may be repeated')
+  parser.add_argument(
+      '--sample',
+      action='append',
+      choices=sorted(SAMPLES),
+      help='sample to run, may be repeated; all by default')
+  parser.add_argument(
+      '--output', required=True, help='directory for the CSV files and report')
+  parser.add_argument('--baseline', help='baseline JSON to compare against')
+  parser.add_argument(
+      '--update-baseline',
+      action='store_true',
+      help='write the measured metrics to --baseline')
+  parser.add_argument(
+      '--time-tolerance',
+      type=float,
+      default=0.1,
+      help='allowed growth of the frame time percentiles, 0.1 for 10%%')
+  parser.add_argument(
+      '--memory-tolerance',
+      type=float,
+      default=0.05,
+      help='allowed growth of the peak resident set size')
+  parser.add_argument(
+      '--timeout', type=int, default=600, help='seconds per playback')
+  parser.add_argument('--serial', help='device serial, see adb devices')
+  parser.add_argument(
+      '--skip-run',
+      action='store_true',
+      help='summarize the CSV files already in --output')
+
+  args = parser.parse_args()
+  if args.update_baseline and not args.baseline:
+    sys.exit('--update-baseline needs --baseline.')
+
+  os.makedirs(args.output, exist_ok=True)
+  baseline = {}
+  if args.baseline and not args.update_baseline:
+    with open(args.baseline) as fp:
+      baseline = json.load(fp)
+
+  runs = {}
+  regressions = []
+  for sample in args.sample or sorted(SAMPLES):
+    for dataset in args.dataset:
+      name = os.path.splitext(os.path.basename(dataset))[0]
+      key = '%s/%s' % (sample, name)
+      csv_path = os.path.join(args.output, '%s_%s.csv' % (sample, name))
+      if not args.skip_run:
+        print('Running %s' % key)
+        run_benchmark(sample, dataset, args.serial, args.timeout, csv_path)
+      runs[key] = summarize(csv_path)
+      regressions.extend(
+          compare(key, runs[key], baseline, args.time_tolerance,
+                  args.memory_tolerance))
+
+  report_path = os.path.join(args.output, 'report.json')
+  report = {'runs': runs, 'regressions': regressions}
+  with open(report_path, 'w') as fp:
+    json.dump(report, fp, indent=2, sort_keys=True)
+  print('Wrote %s' % report_path)
+
+  if args.update_baseline:
+    with open(args.baseline, 'w') as fp:
+      json.dump(runs, fp, indent=2, sort_keys=True)
+    print('Wrote %s' % args.baseline)
+    return
+  for regression in regressions:
+    print('REGRESSION %s' % regression)
+  if regressions:
+    sys.exit(1)
+
+
+if __name__ == '__main__':
+  main()
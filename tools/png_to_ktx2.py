@@ -0,0 +1,114 @@
+# Copyright 2024 Google LLC
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Converts PNG textures into ASTC compressed KTX2 files with mipmaps.
+
+The output is loaded by util::LoadKtx2FromAssetManager in the C samples,
+which maps the asset in place and uploads every mip level with
+glCompressedTexImage2D. util::TextureCache picks up foo.ktx2 in place of
+foo.png, so the KTX2 files are written next to their PNGs, e.g.
+
+  tools/png_to_ktx2.py samples/hello_ar_c/app/src/main/assets/models
+
+Encoding is done by toktx from KTX-Software, which must be on the PATH. The
+files are written without supercompression and with a linear transfer
+function, since the PNGs are sampled as linear RGBA8 today. Textures that
+are looked up by value rather than looked at, like depth_color_palette.png,
+should be left uncompressed with --exclude.
+"""
+import argparse
+import os
+import struct
+import subprocess
+import sys
+
+KTX2_IDENTIFIER = b'\xabKTX 20\xbb\r\n\x1a\n'
+# vkFormat, ..., levelCount, supercompressionScheme.
+KTX2_HEADER_FORMAT = '<12s9I'
+
+
+def find_pngs(inputs, excluded):
+  """Returns the PNG files among |inputs| and in the directories of it."""
+  pngs = []
+  for path in inputs:
+    if os.path.isdir(path):
+      names = sorted(os.listdir(path))
+      pngs.extend(os.path.join(path, name) for name in names)
+    else:
+      pngs.append(path)
+  return [
+      png for png in pngs if png.lower().endswith('.png') and
+      os.path.basename(png) not in excluded
+  ]
+
+
+def check_ktx2(path):
+  """Returns an error message if |path| cannot be loaded, otherwise None."""
+  with open(path, 'rb') as fp:
+    data = fp.read(struct.calcsize(KTX2_HEADER_FORMAT))
+  if len(data) < struct.calcsize(KTX2_HEADER_FORMAT):
+    return 'truncated header'
+  fields = struct.unpack(KTX2_HEADER_FORMAT, data)
+  if fields[0] != KTX2_IDENTIFIER:
+    return 'not a KTX2 file'
+  if fields[9] != 0:
+    return 'supercompressed, which cannot be uploaded directly'
+  return None
+
+
+def convert(png, block_size, quality):
+  ktx2 = os.path.splitext(png)[0] + '.ktx2'
+  subprocess.check_call([
+      'toktx', '--t2', '--encode', 'astc', '--astc_blk_d', block_size,
+      '--astc_quality', quality, '--genmipmap', '--assign_oetf', 'linear',
+      '--target_type', 'RGBA', ktx2, png
+  ])
+  error = check_ktx2(ktx2)
+  if error:
+    raise RuntimeError('%s: %s' % (ktx2, error))
+  print('%s: %d -> %d bytes' %
+        (ktx2, os.path.getsize(png), os.path.getsize(ktx2)))
+
+
+def main():
+  parser = argparse.ArgumentParser(
+      description='Convert PNG textures into ASTC compressed KTX2 files.')
+  parser.add_argument(
+      'inputs', nargs='+', help='.png files or directories containing them')
+  parser.add_argument(
+      '--block-size',
+      default='6x6',
+      help='ASTC block size, 4x4 for 8 bits per pixel, 6x6 for 3.56, 8x8 '
+      'for 2')
+  parser.add_argument(
+      '--quality',
+      default='thorough',
+      help='astcenc quality preset: fast, medium, thorough or exhaustive')
+  parser.add_argument(
+      '--exclude',
+      action='append',
+      default=['depth_color_palette.png'],
+      help='file name to leave uncompressed, may be repeated')
+
+  args = parser.parse_args()
+
+  pngs = find_pngs(args.inputs, set(args.exclude))
+  if not pngs:
+    sys.exit('No PNG files found.')
+  for png in pngs:
+    convert(png, args.block_size, args.quality)
+
+
+if __name__ == '__main__':
+  main()
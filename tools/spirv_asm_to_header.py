@@ -0,0 +1,497 @@
+# Copyright 2024 Google LLC
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Assembles SPIR-V assembly into the shader headers of hello_ar_vulkan_c.
+
+Most SPIR-V headers of the Vulkan sample are compiled from their GLSL source
+with glslang, see generate_vulkan_files.md. The shaders that were written
+without that toolchain keep their SPIR-V as assembly next to the GLSL, in a
+.spvasm file in the syntax of spirv-as from SPIRV-Tools, and their header is
+generated from it by this script:
+
+  python3 tools/spirv_asm_to_header.py \\
+      samples/hello_ar_vulkan_c/app/src/main/assets/shaders/point_cloud.vert.spvasm
+
+writes point_cloud_vert.spv.h beside it. The .spvasm must be kept in step
+with the GLSL by hand; once glslang is available, the header can be compiled
+from the GLSL instead and the .spvasm dropped.
+
+Only the subset of spirv-as the sample needs is understood: one instruction
+per line, ids as %names, numeric and string literals, and the enumerants and
+GLSL.std.450 instructions listed below. Ids are numbered in the order they
+first appear, like spirv-as does. The generator word of the module is 0,
+since no registered tool wrote it, and nothing is validated, so run spirv-val
+on the output where SPIRV-Tools is available.
+"""
+import argparse
+import os
+import re
+import struct
+import sys
+
+MAGIC = 0x07230203
+VERSION_1_0 = 0x00010000
+GENERATOR = 0
+
+ENUMS = {
+    'Capability': {
+        'Matrix': 0, 'Shader': 1, 'Geometry': 2, 'Tessellation': 3,
+        'Float16': 9, 'Float64': 10, 'Int64': 11, 'Int16': 22,
+        'ImageGatherExtended': 25, 'StorageImageMultisample': 27,
+        'ClipDistance': 32, 'CullDistance': 33, 'SampleRateShading': 35,
+        'Sampled1D': 43, 'Image1D': 44, 'SampledBuffer': 46,
+        'ImageBuffer': 47, 'ImageQuery': 50, 'DerivativeControl': 51,
+        'StorageImageExtendedFormats': 49,
+        'StorageImageReadWithoutFormat': 55,
+        'StorageImageWriteWithoutFormat': 56,
+    },
+    'AddressingModel': {'Logical': 0},
+    'MemoryModel': {'Simple': 0, 'GLSL450': 1},
+    'ExecutionModel': {
+        'Vertex': 0, 'TessellationControl': 1, 'TessellationEvaluation': 2,
+        'Geometry': 3, 'Fragment': 4, 'GLCompute': 5,
+    },
+    'ExecutionMode': {
+        'OriginUpperLeft': 7, 'OriginLowerLeft': 8, 'EarlyFragmentTests': 9,
+        'DepthReplacing': 12, 'DepthGreater': 14, 'DepthLess': 15,
+        'DepthUnchanged': 16, 'LocalSize': 17,
+    },
+    'SourceLanguage': {'Unknown': 0, 'ESSL': 1, 'GLSL': 2},
+    'StorageClass': {
+        'UniformConstant': 0, 'Input': 1, 'Uniform': 2, 'Output': 3,
+        'Workgroup': 4, 'CrossWorkgroup': 5, 'Private': 6, 'Function': 7,
+        'Generic': 8, 'PushConstant': 9, 'AtomicCounter': 10, 'Image': 11,
+        'StorageBuffer': 12,
+    },
+    'Dim': {
+        '1D': 0, '2D': 1, '3D': 2, 'Cube': 3, 'Rect': 4, 'Buffer': 5,
+        'SubpassData': 6,
+    },
+    'ImageFormat': {
+        'Unknown': 0, 'Rgba32f': 1, 'Rgba16f': 2, 'R32f': 3, 'Rgba8': 4,
+        'Rgba8Snorm': 5, 'Rg32f': 6, 'Rg16f': 7, 'R16f': 9, 'Rgba16': 10,
+        'R8': 15, 'R32ui': 34, 'R16ui': 38, 'R8ui': 39,
+    },
+    'AccessQualifier': {'ReadOnly': 0, 'WriteOnly': 1, 'ReadWrite': 2},
+    'Decoration': {
+        'RelaxedPrecision': 0, 'SpecId': 1, 'Block': 2, 'BufferBlock': 3,
+        'RowMajor': 4, 'ColMajor': 5, 'ArrayStride': 6, 'MatrixStride': 7,
+        'BuiltIn': 11, 'NoPerspective': 13, 'Flat': 14, 'Centroid': 16,
+        'Sample': 17, 'Invariant': 18, 'Restrict': 19, 'Aliased': 20,
+        'Volatile': 21, 'Coherent': 23, 'NonWritable': 24,
+        'NonReadable': 25, 'Location': 30, 'Component': 31, 'Index': 32,
+        'Binding': 33, 'DescriptorSet': 34, 'Offset': 35,
+    },
+    'BuiltIn': {
+        'Position': 0, 'PointSize': 1, 'ClipDistance': 3, 'CullDistance': 4,
+        'VertexId': 5, 'InstanceId': 6, 'FragCoord': 15, 'PointCoord': 16,
+        'FrontFacing': 17, 'FragDepth': 22, 'HelperInvocation': 23,
+        'NumWorkgroups': 24, 'WorkgroupSize': 25, 'WorkgroupId': 26,
+        'LocalInvocationId': 27, 'GlobalInvocationId': 28,
+        'LocalInvocationIndex': 29, 'VertexIndex': 42, 'InstanceIndex': 43,
+    },
+    # Masks, written as names joined by '|'.
+    'FunctionControl': {
+        'None': 0, 'Inline': 1, 'DontInline': 2, 'Pure': 4, 'Const': 8,
+    },
+    'SelectionControl': {'None': 0, 'Flatten': 1, 'DontFlatten': 2},
+    'LoopControl': {'None': 0, 'Unroll': 1, 'DontUnroll': 2},
+    'MemoryAccess': {'None': 0, 'Volatile': 1, 'Aligned': 2, 'Nontemporal': 4},
+    'ImageOperands': {
+        'None': 0, 'Bias': 1, 'Lod': 2, 'Grad': 4, 'ConstOffset': 8,
+        'Offset': 16, 'ConstOffsets': 32, 'Sample': 64, 'MinLod': 128,
+    },
+}
+
+GLSL_STD_450 = {
+    'Round': 1, 'RoundEven': 2, 'Trunc': 3, 'FAbs': 4, 'SAbs': 5, 'FSign': 6,
+    'SSign': 7, 'Floor': 8, 'Ceil': 9, 'Fract': 10, 'Radians': 11,
+    'Degrees': 12, 'Sin': 13, 'Cos': 14, 'Tan': 15, 'Asin': 16, 'Acos': 17,
+    'Atan': 18, 'Atan2': 25, 'Pow': 26, 'Exp': 27, 'Log': 28, 'Exp2': 29,
+    'Log2': 30, 'Sqrt': 31, 'InverseSqrt': 32, 'Determinant': 33,
+    'MatrixInverse': 34, 'FMin': 37, 'UMin': 38, 'SMin': 39, 'FMax': 40,
+    'UMax': 41, 'SMax': 42, 'FClamp': 43, 'UClamp': 44, 'SClamp': 45,
+    'FMix': 46, 'Step': 48, 'SmoothStep': 49, 'Fma': 50, 'Length': 66,
+    'Distance': 67, 'Cross': 68, 'Normalize': 69, 'FaceForward': 70,
+    'Reflect': 71, 'Refract': 72,
+}
+
+# Operand kinds: 'id', 'lit' (integer), 'str', 'num' (integer or float, as
+# written), an ENUMS key, 'decoration' (the decoration and its literals),
+# 'mode' (the execution mode and its literals), 'ext' (a GLSL.std.450
+# instruction). A trailing '?' makes an operand optional, a trailing '*'
+# repeats it. Every optional or repeated operand is last or followed only by
+# more of them.
+_ID_LIST = ['id*']
+_UNARY = ['id']
+_BINARY = ['id', 'id']
+
+# name: (opcode, has result type, has result id, operands)
+OPCODES = {
+    'OpNop': (0, False, False, []),
+    'OpUndef': (1, True, True, []),
+    'OpSource': (3, False, False, ['SourceLanguage', 'lit', 'id?', 'str?']),
+    'OpSourceExtension': (4, False, False, ['str']),
+    'OpName': (5, False, False, ['id', 'str']),
+    'OpMemberName': (6, False, False, ['id', 'lit', 'str']),
+    'OpString': (7, False, True, ['str']),
+    'OpExtension': (10, False, False, ['str']),
+    'OpExtInstImport': (11, False, True, ['str']),
+    'OpExtInst': (12, True, True, ['id', 'ext', 'id*']),
+    'OpMemoryModel': (14, False, False, ['AddressingModel', 'MemoryModel']),
+    'OpEntryPoint': (15, False, False, ['ExecutionModel', 'id', 'str',
+                                        'id*']),
+    'OpExecutionMode': (16, False, False, ['id', 'mode']),
+    'OpCapability': (17, False, False, ['Capability']),
+    'OpTypeVoid': (19, False, True, []),
+    'OpTypeBool': (20, False, True, []),
+    'OpTypeInt': (21, False, True, ['lit', 'lit']),
+    'OpTypeFloat': (22, False, True, ['lit']),
+    'OpTypeVector': (23, False, True, ['id', 'lit']),
+    'OpTypeMatrix': (24, False, True, ['id', 'lit']),
+    'OpTypeImage': (25, False, True, ['id', 'Dim', 'lit', 'lit', 'lit', 'lit',
+                                      'ImageFormat', 'AccessQualifier?']),
+    'OpTypeSampler': (26, False, True, []),
+    'OpTypeSampledImage': (27, False, True, ['id']),
+    'OpTypeArray': (28, False, True, ['id', 'id']),
+    'OpTypeRuntimeArray': (29, False, True, ['id']),
+    'OpTypeStruct': (30, False, True, ['id*']),
+    'OpTypePointer': (32, False, True, ['StorageClass', 'id']),
+    'OpTypeFunction': (33, False, True, ['id', 'id*']),
+    'OpConstantTrue': (41, True, True, []),
+    'OpConstantFalse': (42, True, True, []),
+    'OpConstant': (43, True, True, ['num']),
+    'OpConstantComposite': (44, True, True, _ID_LIST),
+    'OpConstantNull': (46, True, True, []),
+    'OpFunction': (54, True, True, ['FunctionControl', 'id']),
+    'OpFunctionParameter': (55, True, True, []),
+    'OpFunctionEnd': (56, False, False, []),
+    'OpFunctionCall': (57, True, True, ['id', 'id*']),
+    'OpVariable': (59, True, True, ['StorageClass', 'id?']),
+    'OpLoad': (61, True, True, ['id', 'MemoryAccess?']),
+    'OpStore': (62, False, False, ['id', 'id', 'MemoryAccess?']),
+    'OpAccessChain': (65, True, True, ['id', 'id*']),
+    'OpDecorate': (71, False, False, ['id', 'decoration']),
+    'OpMemberDecorate': (72, False, False, ['id', 'lit', 'decoration']),
+    'OpVectorExtractDynamic': (77, True, True, _BINARY),
+    'OpVectorInsertDynamic': (78, True, True, ['id', 'id', 'id']),
+    'OpVectorShuffle': (79, True, True, ['id', 'id', 'lit*']),
+    'OpCompositeConstruct': (80, True, True, _ID_LIST),
+    'OpCompositeExtract': (81, True, True, ['id', 'lit*']),
+    'OpCompositeInsert': (82, True, True, ['id', 'id', 'lit*']),
+    'OpCopyObject': (83, True, True, _UNARY),
+    'OpTranspose': (84, True, True, _UNARY),
+    'OpSampledImage': (86, True, True, _BINARY),
+    'OpImageSampleImplicitLod': (87, True, True, ['id', 'id',
+                                                  'ImageOperands?', 'id*']),
+    'OpImageSampleExplicitLod': (88, True, True, ['id', 'id',
+                                                  'ImageOperands', 'id*']),
+    'OpImageFetch': (95, True, True, ['id', 'id', 'ImageOperands?', 'id*']),
+    'OpImageRead': (98, True, True, ['id', 'id', 'ImageOperands?', 'id*']),
+    'OpImageWrite': (99, False, False, ['id', 'id', 'id', 'ImageOperands?',
+                                        'id*']),
+    'OpImage': (100, True, True, _UNARY),
+    'OpImageQuerySizeLod': (103, True, True, _BINARY),
+    'OpImageQuerySize': (104, True, True, _UNARY),
+    'OpConvertFToU': (109, True, True, _UNARY),
+    'OpConvertFToS': (110, True, True, _UNARY),
+    'OpConvertSToF': (111, True, True, _UNARY),
+    'OpConvertUToF': (112, True, True, _UNARY),
+    'OpUConvert': (113, True, True, _UNARY),
+    'OpSConvert': (114, True, True, _UNARY),
+    'OpFConvert': (115, True, True, _UNARY),
+    'OpBitcast': (124, True, True, _UNARY),
+    'OpSNegate': (126, True, True, _UNARY),
+    'OpFNegate': (127, True, True, _UNARY),
+    'OpIAdd': (128, True, True, _BINARY),
+    'OpFAdd': (129, True, True, _BINARY),
+    'OpISub': (130, True, True, _BINARY),
+    'OpFSub': (131, True, True, _BINARY),
+    'OpIMul': (132, True, True, _BINARY),
+    'OpFMul': (133, True, True, _BINARY),
+    'OpUDiv': (134, True, True, _BINARY),
+    'OpSDiv': (135, True, True, _BINARY),
+    'OpFDiv': (136, True, True, _BINARY),
+    'OpUMod': (137, True, True, _BINARY),
+    'OpSRem': (138, True, True, _BINARY),
+    'OpSMod': (139, True, True, _BINARY),
+    'OpFRem': (140, True, True, _BINARY),
+    'OpFMod': (141, True, True, _BINARY),
+    'OpVectorTimesScalar': (142, True, True, _BINARY),
+    'OpMatrixTimesScalar': (143, True, True, _BINARY),
+    'OpVectorTimesMatrix': (144, True, True, _BINARY),
+    'OpMatrixTimesVector': (145, True, True, _BINARY),
+    'OpMatrixTimesMatrix': (146, True, True, _BINARY),
+    'OpOuterProduct': (147, True, True, _BINARY),
+    'OpDot': (148, True, True, _BINARY),
+    'OpAny': (154, True, True, _UNARY),
+    'OpAll': (155, True, True, _UNARY),
+    'OpIsNan': (156, True, True, _UNARY),
+    'OpIsInf': (157, True, True, _UNARY),
+    'OpLogicalEqual': (164, True, True, _BINARY),
+    'OpLogicalNotEqual': (165, True, True, _BINARY),
+    'OpLogicalOr': (166, True, True, _BINARY),
+    'OpLogicalAnd': (167, True, True, _BINARY),
+    'OpLogicalNot': (168, True, True, _UNARY),
+    'OpSelect': (169, True, True, ['id', 'id', 'id']),
+    'OpIEqual': (170, True, True, _BINARY),
+    'OpINotEqual': (171, True, True, _BINARY),
+    'OpUGreaterThan': (172, True, True, _BINARY),
+    'OpSGreaterThan': (173, True, True, _BINARY),
+    'OpUGreaterThanEqual': (174, True, True, _BINARY),
+    'OpSGreaterThanEqual': (175, True, True, _BINARY),
+    'OpULessThan': (176, True, True, _BINARY),
+    'OpSLessThan': (177, True, True, _BINARY),
+    'OpULessThanEqual': (178, True, True, _BINARY),
+    'OpSLessThanEqual': (179, True, True, _BINARY),
+    'OpFOrdEqual': (180, True, True, _BINARY),
+    'OpFOrdNotEqual': (182, True, True, _BINARY),
+    'OpFOrdLessThan': (184, True, True, _BINARY),
+    'OpFOrdGreaterThan': (186, True, True, _BINARY),
+    'OpFOrdLessThanEqual': (188, True, True, _BINARY),
+    'OpFOrdGreaterThanEqual': (190, True, True, _BINARY),
+    'OpShiftRightLogical': (194, True, True, _BINARY),
+    'OpShiftRightArithmetic': (195, True, True, _BINARY),
+    'OpShiftLeftLogical': (196, True, True, _BINARY),
+    'OpBitwiseOr': (197, True, True, _BINARY),
+    'OpBitwiseXor': (198, True, True, _BINARY),
+    'OpBitwiseAnd': (199, True, True, _BINARY),
+    'OpNot': (200, True, True, _UNARY),
+    'OpDPdx': (207, True, True, _UNARY),
+    'OpDPdy': (208, True, True, _UNARY),
+    'OpFwidth': (209, True, True, _UNARY),
+    'OpPhi': (245, True, True, _ID_LIST),
+    'OpLoopMerge': (246, False, False, ['id', 'id', 'LoopControl']),
+    'OpSelectionMerge': (247, False, False, ['id', 'SelectionControl']),
+    'OpLabel': (248, False, True, []),
+    'OpBranch': (249, False, False, ['id']),
+    'OpBranchConditional': (250, False, False, ['id', 'id', 'id', 'lit*']),
+    'OpKill': (252, False, False, []),
+    'OpReturn': (253, False, False, []),
+    'OpReturnValue': (254, False, False, ['id']),
+    'OpUnreachable': (255, False, False, []),
+}
+
+_TOKEN = re.compile(r'"(?:[^"\\]|\\.)*"|[^\s"]+')
+
+
+class AssemblyError(Exception):
+  pass
+
+
+def tokenize(line):
+  return _TOKEN.findall(strip_comment(line))
+
+
+def strip_comment(line):
+  """Drops what follows a ';' outside of a string."""
+  in_string = False
+  escaped = False
+  for i, c in enumerate(line):
+    if escaped:
+      escaped = False
+    elif c == '\\':
+      escaped = True
+    elif c == '"':
+      in_string = not in_string
+    elif c == ';' and not in_string:
+      return line[:i]
+  return line
+
+
+def string_words(token):
+  text = re.sub(r'\\(.)', r'\1', token[1:-1])
+  data = text.encode('utf-8') + b'\0'
+  data += b'\0' * (-len(data) % 4)
+  return list(struct.unpack('<%dI' % (len(data) // 4), data))
+
+
+def number_word(token):
+  if re.fullmatch(r'-?\d+', token):
+    return int(token) & 0xFFFFFFFF
+  if re.fullmatch(r'0x[0-9a-fA-F]+', token):
+    return int(token, 16)
+  try:
+    return struct.unpack('<I', struct.pack('<f', float(token)))[0]
+  except ValueError:
+    raise AssemblyError('not a number: %s' % token)
+
+
+def enum_word(kind, token):
+  values = ENUMS[kind]
+  word = 0
+  for name in token.split('|'):
+    if name not in values:
+      raise AssemblyError('unknown %s: %s' % (kind, name))
+    word |= values[name]
+  return word
+
+
+class Assembler(object):
+  """Turns the lines of a .spvasm file into 32-bit SPIR-V words."""
+
+  def __init__(self):
+    self.ids = {}
+    self.body = []
+
+  def id_word(self, token):
+    if not token.startswith('%'):
+      raise AssemblyError('expected an id: %s' % token)
+    if token not in self.ids:
+      self.ids[token] = len(self.ids) + 1
+    return self.ids[token]
+
+  def operand_words(self, kind, tokens):
+    """Encodes the operands of |kind| at the front of |tokens|, consuming them."""
+    if kind == 'id':
+      return [self.id_word(tokens.pop(0))]
+    if kind == 'lit':
+      return [number_word(tokens.pop(0))]
+    if kind == 'num':
+      return [number_word(tokens.pop(0))]
+    if kind == 'str':
+      token = tokens.pop(0)
+      if not token.startswith('"'):
+        raise AssemblyError('expected a string: %s' % token)
+      return string_words(token)
+    if kind == 'ext':
+      name = tokens.pop(0)
+      if name not in GLSL_STD_450:
+        raise AssemblyError('unknown GLSL.std.450 instruction: %s' % name)
+      return [GLSL_STD_450[name]]
+    if kind == 'decoration':
+      name = tokens.pop(0)
+      words = [enum_word('Decoration', name)]
+      if name == 'BuiltIn':
+        words.append(enum_word('BuiltIn', tokens.pop(0)))
+      while tokens:
+        words.append(number_word(tokens.pop(0)))
+      return words
+    if kind == 'mode':
+      words = [enum_word('ExecutionMode', tokens.pop(0))]
+      while tokens:
+        words.append(number_word(tokens.pop(0)))
+      return words
+    return [enum_word(kind, tokens.pop(0))]
+
+  def add_line(self, line):
+    tokens = tokenize(line)
+    if not tokens:
+      return
+    result = None
+    if len(tokens) > 2 and tokens[1] == '=':
+      result = tokens[0]
+      tokens = tokens[2:]
+    name = tokens.pop(0)
+    if name not in OPCODES:
+      raise AssemblyError('unknown instruction: %s' % name)
+    opcode, has_type, has_result, kinds = OPCODES[name]
+    if has_result != (result is not None):
+      raise AssemblyError('%s %s a result id' %
+                          (name, 'needs' if has_result else 'has no'))
+    words = []
+    if has_type:
+      words += self.operand_words('id', tokens)
+    if has_result:
+      words.append(self.id_word(result))
+    for kind in kinds:
+      if kind.endswith('*'):
+        while tokens:
+          words += self.operand_words(kind[:-1], tokens)
+      elif kind.endswith('?'):
+        if tokens:
+          words += self.operand_words(kind[:-1], tokens)
+      else:
+        if not tokens:
+          raise AssemblyError('%s is missing operands' % name)
+        words += self.operand_words(kind, tokens)
+    if tokens:
+      raise AssemblyError('%s has extra operands: %s' %
+                          (name, ' '.join(tokens)))
+    self.body.append(((len(words) + 1) << 16) | opcode)
+    self.body += words
+
+  def words(self):
+    return [MAGIC, VERSION_1_0, GENERATOR, len(self.ids) + 1, 0] + self.body
+
+
+def assemble(text):
+  assembler = Assembler()
+  for number, line in enumerate(text.splitlines(), 1):
+    try:
+      assembler.add_line(line)
+    except (AssemblyError, IndexError) as error:
+      raise AssemblyError('line %d: %s' % (number, error or 'bad operands'))
+  return assembler.words()
+
+
+LICENSE = """/*
+ * Copyright %d Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+"""
+
+
+def header_text(words, array_name, source_name, year):
+  guard = 'C_ARCORE_SIMPLE_VULKAN_%s_H_' % array_name.upper()
+  rows = []
+  for i in range(0, len(words), 6):
+    rows.append('    ' + ', '.join('0x%08x' % w for w in words[i:i + 6]))
+  return (LICENSE % year + '#ifndef %s\n#define %s\n\n' % (guard, guard) +
+          '// Generated from %s by\n'
+          '// tools/spirv_asm_to_header.py. Do not edit.\n' % source_name + '#pragma once\n' +
+          'const uint32_t %s[] = {\n' % array_name + ',\n'.join(rows) +
+          '};\n#endif\n')
+
+
+def main():
+  parser = argparse.ArgumentParser(
+      description='Assemble a .spvasm shader into a SPIR-V header of '
+      'hello_ar_vulkan_c.')
+  parser.add_argument('input', nargs='+',
+                      help='<shader>.<stage>.spvasm files, e.g. '
+                      'point_cloud.vert.spvasm')
+  parser.add_argument('--year', type=int, default=2024,
+                      help='year of the license header')
+  args = parser.parse_args()
+  for path in args.input:
+    base = os.path.basename(path)
+    match = re.fullmatch(r'(\w+)\.(\w+)\.spvasm', base)
+    if not match:
+      sys.exit('%s: expected <shader>.<stage>.spvasm' % path)
+    array_name = '%s_%s' % match.groups()
+    with open(path) as f:
+      try:
+        words = assemble(f.read())
+      except AssemblyError as error:
+        sys.exit('%s: %s' % (path, error))
+    output = os.path.join(os.path.dirname(path), array_name + '.spv.h')
+    with open(output, 'w') as f:
+      f.write(header_text(words, array_name, base, args.year))
+    print('%s: %d words' % (output, len(words)))
+
+
+if __name__ == '__main__':
+  main()